@@ -165,6 +165,7 @@ function(setupBuildFlags)
         iconv
         cups
         bsm
+        EndpointSecurity
         xar
         c++abi
         "-framework AppKit"
@@ -378,6 +379,10 @@ function(setupBuildFlags)
     message(FATAL_ERROR "Platform not supported!")
   endif()
 
+  if(OSQUERY_ENABLE_TRACING)
+    list(APPEND osquery_defines OSQUERY_TRACING)
+  endif()
+
   add_library(osquery_cxx_settings INTERFACE)
   target_link_libraries(osquery_cxx_settings INTERFACE
     cxx_settings
@@ -13,6 +13,10 @@
 #include <osquery/remote/utility.h>
 // clang-format on
 
+#include <future>
+#include <mutex>
+#include <vector>
+
 #include <osquery/carver/carver.h>
 #include <osquery/carver/carver_utils.h>
 #include <osquery/database/database.h>
@@ -25,6 +29,7 @@
 #include <osquery/utils/conversions/split.h>
 #include <osquery/core/system.h>
 #include <osquery/utils/base64.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/system/system.h>
 #include <osquery/utils/system/time.h>
@@ -67,11 +72,23 @@ CLI_FLAG(uint32,
          "Seconds to store successful carve result metadata (in carves table)");
 
 DECLARE_bool(disable_carver);
-DECLARE_uint64(read_max);
+
+/// Carve blocks in flight at once during an upload.
+CLI_FLAG(uint32,
+         carver_parallel_uploads,
+         1,
+         "Number of carve blocks posted concurrently (default 1)");
+
+/// Attempts to post each carved block before the carve fails.
+const size_t kCarverBlockAttempts{3};
+
+/// Posted blocks between persisting the resume point of an upload.
+const size_t kCarverProgressBlocks{16};
 
 std::atomic<bool> CarverRunnable::running_{false};
 
 void CarverRunnable::start() {
+  bool resumable = false;
   std::vector<std::string> carves;
   scanDatabaseKeys(kCarves, carves, kCarverDBPrefix);
 
@@ -111,12 +128,24 @@ void CarverRunnable::start() {
       }
     }
 
-    if (status != kCarverStatusScheduled) {
+    if (status == kCarverStatusUploading) {
+      uint64_t start_time(doc["time"].GetUint());
+      if (getUnixTime() - start_time > FLAGS_carver_expiry) {
+        VLOG(1) << "Expiring interrupted carve upload for GUID: " << guid;
+        updateCarveValue(guid, "status", "DATA POST FAILED");
+        if (doc.HasMember("upload_path") && doc["upload_path"].IsString()) {
+          fs::path uploadPath(doc["upload_path"].GetString());
+          fs::remove_all(uploadPath.parent_path());
+        }
+        continue;
+      }
+    } else if (status != kCarverStatusScheduled) {
       continue;
+    } else {
+      // Schedule the carve.
+      updateCarveValue(guid, "status", "STARTING");
     }
 
-    // Schedule the carve.
-    updateCarveValue(guid, "status", "STARTING");
     std::set<std::string> paths;
     for (const auto& path : osquery::split(doc["path"].GetString(), ",")) {
       paths.insert(path);
@@ -124,10 +153,17 @@ void CarverRunnable::start() {
 
     auto requestId = Distributed::getCurrentRequestId();
     doCarve(paths, guid, requestId);
+
+    // An interrupted upload is resumed when the carves are scheduled again.
+    JSON after;
+    if (getCarveValues(guid, after).ok() && after.doc().HasMember("status") &&
+        after.doc()["status"] == kCarverStatusUploading.c_str()) {
+      resumable = true;
+    }
   }
 
   // All pending carves have been started.
-  kCarverPendingCarves = false;
+  kCarverPendingCarves = resumable;
 }
 
 Carver::Carver(const std::set<std::string>& paths,
@@ -164,54 +200,93 @@ Status Carver::createPaths() {
 };
 
 Carver::~Carver() {
-  fs::remove_all(carveDir_);
+  if (!keepCarveDir_) {
+    fs::remove_all(carveDir_);
+  }
+}
+
+bool Carver::resumePaths(fs::path& uploadPath) {
+  JSON tree;
+  if (!getCarveValues(carveGuid_, tree).ok()) {
+    return false;
+  }
+
+  const auto& doc = tree.doc();
+  if (!doc.HasMember("status") ||
+      doc["status"] != kCarverStatusUploading.c_str() ||
+      !doc.HasMember("upload_path") || !doc["upload_path"].IsString()) {
+    return false;
+  }
+
+  uploadPath = doc["upload_path"].GetString();
+  carveDir_ = uploadPath.parent_path();
+  if (!pathExists(uploadPath).ok()) {
+    // The archive is gone, the carve starts over.
+    fs::remove_all(carveDir_);
+    carveDir_.clear();
+    updateCarveValue(carveGuid_, "session_id", "");
+    return false;
+  }
+
+  if (doc.HasMember("request_id") && doc["request_id"].IsString()) {
+    requestId_ = doc["request_id"].GetString();
+  }
+  return true;
 }
 
 Status Carver::carve() {
+  fs::path resumePath;
+  if (resumePaths(resumePath)) {
+    VLOG(1) << "Resuming the upload of carve " << carveGuid_;
+    auto s = postCarve(resumePath);
+    if (!s.ok()) {
+      VLOG(1) << "Failed to post carve: " << s.getMessage();
+      keepCarveDir_ = true;
+    }
+    return s;
+  }
+
   auto s = createPaths();
   if (!s.ok()) {
     updateCarveValue(carveGuid_, "status", "CREATE PATHS FAILED");
     return s;
   }
 
+  // The sources are archived and compressed in one pass into the upload file,
+  // hashing the upload as it is written.
   const auto carvedFiles = carveAll();
-  s = archive(carvedFiles, archivePath_, FLAGS_carver_block_size);
+  const auto& uploadPath =
+      FLAGS_carver_compression ? compressPath_ : archivePath_;
+  Hash uploadHash(HashType::HASH_TYPE_SHA256);
+  s = streamArchive(carvedFiles,
+                    uploadPath,
+                    FLAGS_carver_block_size,
+                    FLAGS_carver_compression,
+                    [&uploadHash](const void* data, size_t size) {
+                      uploadHash.update(data, size);
+                    });
   if (!s.ok()) {
     VLOG(1) << "Failed to create carve archive: " << s.getMessage();
     updateCarveValue(carveGuid_, "status", "ARCHIVE FAILED");
     return s;
   }
 
-  fs::path uploadPath;
-  if (FLAGS_carver_compression) {
-    uploadPath = compressPath_;
-    s = compress(archivePath_, compressPath_);
-    if (!s.ok()) {
-      VLOG(1) << "Failed to compress carve archive: " << s.getMessage();
-      updateCarveValue(carveGuid_, "status", "COMPRESS FAILED");
-      return s;
-    }
-  } else {
-    uploadPath = archivePath_;
-  }
-
   PlatformFile uploadFile(uploadPath, PF_OPEN_EXISTING | PF_READ);
   updateCarveValue(carveGuid_, "size", std::to_string(uploadFile.size()));
-
-  std::string uploadHash =
-      (uploadFile.size() > FLAGS_read_max)
-          ? "-1"
-          : hashFromFile(HashType::HASH_TYPE_SHA256, uploadPath.string());
-  if (uploadHash == "-1") {
-    VLOG(1)
-        << "Archive file size exceeds read max, skipping integrity computation";
-  }
-  updateCarveValue(carveGuid_, "sha256", uploadHash);
+  updateCarveValue(carveGuid_, "sha256", uploadHash.digest());
 
   s = postCarve(uploadPath);
   if (!s.ok()) {
     VLOG(1) << "Failed to post carve: " << s.getMessage();
-    updateCarveValue(carveGuid_, "status", "DATA POST FAILED");
+    JSON tree;
+    if (getCarveValues(carveGuid_, tree).ok() &&
+        tree.doc().HasMember("status") &&
+        tree.doc()["status"] == kCarverStatusUploading.c_str()) {
+      // The session was created, keep the archive to resume the upload.
+      keepCarveDir_ = true;
+    } else {
+      updateCarveValue(carveGuid_, "status", "DATA POST FAILED");
+    }
     return s;
   }
   return Status::success();
@@ -226,42 +301,54 @@ std::set<fs::path> Carver::carveAll() {
       VLOG(1) << "File does not exist on disk or is subdirectory: " << srcPath;
       continue;
     }
-    const auto dstPath = carveDir_ / srcPath.leaf();
-    PlatformFile dst(dstPath, PF_CREATE_NEW | PF_WRITE);
-    if (!dst.isValid()) {
-      VLOG(1) << "Destination temporary file is invalid: " << dstPath;
-      continue;
-    }
-    Status s = blockwiseCopy(src, dst);
-    if (s.ok()) {
-      carvedFiles.insert(dstPath);
-    } else {
-      VLOG(1) << "Failed to copy file from " << srcPath << " to " << dstPath
-              << " " << s.getMessage();
-    }
+    carvedFiles.insert(srcPath);
   }
   return carvedFiles;
 }
 
-Status Carver::blockwiseCopy(PlatformFile& src, PlatformFile& dst) {
-  auto blkCount = ceil(static_cast<double>(src.size()) /
-                       static_cast<double>(FLAGS_carver_block_size));
-
-  std::vector<char> inBuff(FLAGS_carver_block_size, 0);
-  for (size_t i = 0; i < blkCount; i++) {
-    auto bytesRead = src.read(inBuff.data(), FLAGS_carver_block_size);
-    if (bytesRead > 0) {
-      auto bytesWritten = dst.write(inBuff.data(), bytesRead);
-      if (bytesWritten < 0) {
-        return Status(1, "Error writing bytes to tmp fs");
-      }
+Status Carver::postCarve(const boost::filesystem::path& path) {
+  PlatformFile pFile(path, PF_OPEN_EXISTING | PF_READ);
+  auto blkCount =
+      static_cast<size_t>(ceil(static_cast<double>(pFile.size()) /
+                               static_cast<double>(FLAGS_carver_block_size)));
+
+  // Resume a persisted session of this carve when its archive is unchanged.
+  std::string session_id;
+  size_t first = 0;
+  JSON tree;
+  if (getCarveValues(carveGuid_, tree).ok()) {
+    const auto& doc = tree.doc();
+    if (doc.HasMember("session_id") && doc["session_id"].IsString() &&
+        doc.HasMember("block_count") && doc["block_count"].IsString() &&
+        doc["block_count"] == std::to_string(blkCount).c_str() &&
+        doc.HasMember("resume_block") && doc["resume_block"].IsString()) {
+      session_id = doc["session_id"].GetString();
+      first = tryTo<size_t>(std::string(doc["resume_block"].GetString()))
+                  .takeOr(size_t{0});
     }
   }
 
+  if (session_id.empty()) {
+    auto status = startSession(path, blkCount, session_id);
+    if (!status.ok()) {
+      return status;
+    }
+  } else {
+    VLOG(1) << "Resuming carve " << carveGuid_ << " upload at block " << first;
+  }
+
+  auto status = postBlocks(path, session_id, first, blkCount);
+  if (!status.ok()) {
+    return status;
+  }
+
+  updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
   return Status::success();
 };
 
-Status Carver::postCarve(const boost::filesystem::path& path) {
+Status Carver::startSession(const boost::filesystem::path& path,
+                            size_t blkCount,
+                            std::string& session_id) {
   // Construct the uri we post our data back to:
   auto startUri = TLSRequestHelper::makeURI(FLAGS_carver_start_endpoint);
   Request<TLSTransport, JSONSerializer> startRequest(startUri);
@@ -269,9 +356,6 @@ Status Carver::postCarve(const boost::filesystem::path& path) {
 
   // Perform the start request to get the session id
   PlatformFile pFile(path, PF_OPEN_EXISTING | PF_READ);
-  auto blkCount =
-      static_cast<size_t>(ceil(static_cast<double>(pFile.size()) /
-                               static_cast<double>(FLAGS_carver_block_size)));
   JSON startParams;
 
   startParams.add("block_count", blkCount);
@@ -301,41 +385,126 @@ Status Carver::postCarve(const boost::filesystem::path& path) {
     return Status(1, "Invalid session_id received from remote endpoint");
   }
 
-  std::string session_id = it->value.GetString();
+  session_id = it->value.GetString();
   if (session_id.empty()) {
     return Status(1, "Empty session_id received from remote endpoint");
   }
 
-  auto contUri = TLSRequestHelper::makeURI(FLAGS_carver_continue_endpoint);
-  Request<TLSTransport, JSONSerializer> contRequest(contUri);
-  contRequest.setOption("hostname", FLAGS_tls_hostname);
-  for (size_t i = 0; i < blkCount; i++) {
-    std::vector<char> block(FLAGS_carver_block_size, 0);
-    auto r = pFile.read(block.data(), FLAGS_carver_block_size);
-
-    if (r != FLAGS_carver_block_size && r > 0) {
-      // resize the buffer to size we read as last block is likely smaller
-      block.resize(r);
+  // Persist the session, a failed or stopped upload resumes from it.
+  updateCarveValue(carveGuid_, "upload_path", path.string());
+  updateCarveValue(carveGuid_, "request_id", requestId_);
+  updateCarveValue(carveGuid_, "session_id", session_id);
+  updateCarveValue(carveGuid_, "block_count", std::to_string(blkCount));
+  updateCarveValue(carveGuid_, "resume_block", "0");
+  updateCarveValue(carveGuid_, "status", kCarverStatusUploading);
+  return Status::success();
+}
+
+static Status postBlock(Request<TLSTransport, JSONSerializer>& request,
+                        PlatformFile& file,
+                        std::string& block,
+                        size_t i,
+                        const std::string& session_id,
+                        const std::string& requestId) {
+  file.seek(static_cast<off_t>(i * block.size()), PF_SEEK_BEGIN);
+  auto r = file.read(&block[0], block.size());
+  if (r < 0) {
+    return Status::failure("Cannot read carved block " + std::to_string(i));
+  }
+
+  // Only the final, partial, block needs a copy of its bytes. The encoded
+  // data is referenced by the parameters rather than copied into them.
+  auto data = (static_cast<size_t>(r) == block.size())
+                  ? base64::encode(block)
+                  : base64::encode(block.substr(0, r));
+  const std::string data_key = "data";
+
+  JSON params;
+  params.add("block_id", i);
+  params.add("session_id", session_id);
+  params.add("request_id", requestId);
+  params.addRef(data_key, data);
+
+  Status status;
+  for (size_t attempt = 1; attempt <= kCarverBlockAttempts; attempt++) {
+    status = request.call(params);
+    if (status.ok()) {
+      break;
+    }
+    VLOG(1) << "Post of carved block " << i << " (attempt " << attempt
+            << ") failed: " << status.getMessage();
+    if (attempt < kCarverBlockAttempts) {
+      sleepFor(RemoteBackoff::get().retryDelay(attempt));
     }
+  }
+  return status;
+}
 
-    JSON params;
-    params.add("block_id", i);
-    params.add("session_id", session_id);
-    params.add("request_id", requestId_);
-    params.add("data", base64::encode(std::string(block.begin(), block.end())));
+Status Carver::postBlocks(const boost::filesystem::path& path,
+                          const std::string& session_id,
+                          size_t first,
+                          size_t count) {
+  if (first >= count) {
+    return Status::success();
+  }
 
-    // TODO: Error sending files.
-    status = contRequest.call(params);
-    if (!status.ok()) {
-      VLOG(1) << "Post of carved block " << i
-              << " failed: " << status.getMessage();
-      continue;
+  auto contUri = TLSRequestHelper::makeURI(FLAGS_carver_continue_endpoint);
+  std::atomic<size_t> next{first};
+  std::atomic<bool> failed{false};
+
+  std::mutex progress_mutex;
+  std::vector<bool> posted(count - first, false);
+  size_t resume = first;
+  size_t persisted = first;
+  Status failure;
+
+  auto upload = [&]() {
+    Request<TLSTransport, JSONSerializer> request(contUri);
+    request.setOption("hostname", FLAGS_tls_hostname);
+    PlatformFile file(path, PF_OPEN_EXISTING | PF_READ);
+    std::string block(FLAGS_carver_block_size, '\0');
+    while (!failed) {
+      auto i = next++;
+      if (i >= count) {
+        break;
+      }
+
+      auto status = postBlock(request, file, block, i, session_id, requestId_);
+      std::lock_guard<std::mutex> lock(progress_mutex);
+      if (!status.ok()) {
+        failed = true;
+        failure = status;
+        break;
+      }
+
+      // Blocks finish out of order, resume after the contiguous prefix.
+      posted[i - first] = true;
+      while (resume < count && posted[resume - first]) {
+        resume++;
+      }
+      if (resume - persisted >= kCarverProgressBlocks) {
+        updateCarveValue(carveGuid_, "resume_block", std::to_string(resume));
+        persisted = resume;
+      }
     }
+  };
+
+  auto workers = std::min<size_t>(
+      std::max<size_t>(FLAGS_carver_parallel_uploads, 1), count - first);
+  std::vector<std::future<void>> uploads;
+  for (size_t i = 1; i < workers; i++) {
+    uploads.push_back(std::async(std::launch::async, upload));
+  }
+  upload();
+  for (auto& pending : uploads) {
+    pending.wait();
   }
 
-  updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
-  return Status::success();
-};
+  if (resume != persisted) {
+    updateCarveValue(carveGuid_, "resume_block", std::to_string(resume));
+  }
+  return failed ? failure : Status::success();
+}
 
 void scheduleCarves() {
   if (!FLAGS_disable_carver && kCarverPendingCarves &&
@@ -107,21 +107,13 @@ class Carver {
 
  protected:
   /**
-   * @brief A helper function that 'carves' all files from disk.
+   * @brief A helper function that selects the files to carve from disk.
    *
-   * This function copies all source files to a temporary directory and returns
-   * a list of all destination files.
+   * This function returns the requested paths that are flat files on disk,
+   * they are read directly into the carve archive.
    */
   std::set<boost::filesystem::path> carveAll();
 
-  /**
-   * @brief A helper function that does a blockwise copy from src to dst.
-   *
-   * This function copies the source file to the destination file, doing so
-   * by blocks specified with FLAGS_carver_block_size (defaults to 8K).
-   */
-  Status blockwiseCopy(PlatformFile& src, PlatformFile& dst);
-
   /**
    * @brief Helper function to POST a carve to the graph endpoint.
    *
@@ -131,6 +123,30 @@ class Carver {
    */
   virtual Status postCarve(const boost::filesystem::path& path);
 
+  /**
+   * @brief Find the archive of an interrupted upload of this carve.
+   *
+   * An upload session that failed, or was stopped with the process, keeps its
+   * archive and progress. The next carve of the same GUID resumes it.
+   */
+  bool resumePaths(boost::filesystem::path& uploadPath);
+
+  /// Create an upload session and persist it so the upload can resume.
+  Status startSession(const boost::filesystem::path& path,
+                      size_t blkCount,
+                      std::string& session_id);
+
+  /**
+   * @brief POST the blocks from first to count of an upload session.
+   *
+   * Up to carver_parallel_uploads blocks are in flight. The index below which
+   * every block was posted is persisted as the carve's resume_block.
+   */
+  Status postBlocks(const boost::filesystem::path& path,
+                    const std::string& session_id,
+                    size_t first,
+                    size_t count);
+
   /// Helper function to return the carve directory.
   boost::filesystem::path getCarveDir() {
     return carveDir_;
@@ -140,9 +156,8 @@ class Carver {
   /**
    * @brief a variable to keep track of the temp path used in carving.
    *
-   * This variable represents the location in which we store all of our carved
-   * files. When a carve has completed all of the desired files, as well
-   * as the tar archive should reside in this directory.
+   * This variable represents the location in which we store the carve
+   * archive while it is uploaded.
    */
   boost::filesystem::path carveDir_;
 
@@ -158,15 +173,15 @@ class Carver {
    * @brief a helper variable for keeping track of the posix tar archive.
    *
    * This variable is the absolute location of the tar archive created from
-   * tar'ing all of the carved files from the carve temp dir.
+   * all of the carved files, when compression is disabled.
    */
   boost::filesystem::path archivePath_;
 
   /**
    * @brief a helper variable for keeping track of the compressed tar.
    *
-   * This variable is the absolute location of the tar archive created from
-   * zstd of the archive.
+   * This variable is the absolute location of the tar archive compressed
+   * with zstd as it is created, when compression is enabled.
    */
   boost::filesystem::path compressPath_;
 
@@ -186,6 +201,9 @@ class Carver {
    * aggregated, to tie together a distributed query with the carve data.
    */
   std::string requestId_;
+
+  /// Keep the carve directory of an upload that can resume.
+  bool keepCarveDir_{false};
 };
 
 /**
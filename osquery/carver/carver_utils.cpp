@@ -26,6 +26,20 @@ CLI_FLAG(bool,
 
 std::atomic<bool> kCarverPendingCarves{true};
 
+Status getCarveValues(const std::string& guid, JSON& tree) {
+  std::string carve;
+  auto s = getDatabaseValue(kCarves, kCarverDBPrefix + guid, carve);
+  if (!s.ok()) {
+    return s;
+  }
+
+  s = tree.fromString(carve);
+  if (!s.ok() || !tree.doc().IsObject()) {
+    return Status::failure("Failed to parse carve entries for " + guid);
+  }
+  return Status::success();
+}
+
 /// Helper function to update values related to a carve
 void updateCarveValue(const std::string& guid,
                       const std::string& key,
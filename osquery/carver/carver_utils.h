@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <osquery/utils/json/json.h>
 #include <osquery/utils/status/status.h>
 
 #include <atomic>
@@ -32,6 +33,9 @@ const std::string kCarverStatusSuccess = "SUCCESS";
 /// Internal carver 'status' indicating a carve request scheduled.
 const std::string kCarverStatusScheduled = "SCHEDULED";
 
+/// Internal carver 'status' indicating an upload session that can resume.
+const std::string kCarverStatusUploading = "UPLOADING";
+
 /**
  * @brief This flag is an optimization attempt used by the CarverRunner.
  *
@@ -45,6 +49,9 @@ const std::string kCarverStatusScheduled = "SCHEDULED";
  */
 extern std::atomic<bool> kCarverPendingCarves;
 
+/// Read the attributes of a given carve GUID.
+Status getCarveValues(const std::string& guid, JSON& tree);
+
 /// Update an attribute for a given carve GUID.
 void updateCarveValue(const std::string& guid,
                       const std::string& key,
@@ -22,6 +22,7 @@
 #include <osquery/hashing/hashing.h>
 #include <osquery/registry/registry.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/system/time.h>
 
 namespace osquery {
 
@@ -38,11 +39,16 @@ class FakeCarver : public Carver {
       : Carver(paths, guid, requestId) {}
 
  protected:
-  Status postCarve(const boost::filesystem::path&) override {
+  Status postCarve(const boost::filesystem::path& path) override {
+    posted_ = path;
     updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
     return Status::success();
   }
 
+ public:
+  /// The path of the last upload.
+  boost::filesystem::path posted_;
+
  private:
   friend class CarverTests;
   FRIEND_TEST(CarverTests, test_carve_files_locally);
@@ -258,6 +264,31 @@ TEST_F(CarverTests, test_carve_files_not_exists) {
   EXPECT_TRUE(carves.empty());
 }
 
+TEST_F(CarverTests, test_carve_resume_upload) {
+  auto guid = genGuid();
+  const auto carveDir = getWorkingDir() / "resume";
+  fs::create_directories(carveDir);
+  const auto uploadPath = carveDir / "carve.tar";
+  ASSERT_TRUE(writeTextFile(uploadPath, "archive").ok());
+
+  JSON tree;
+  tree.add("carve_guid", guid);
+  tree.add("time", getUnixTime());
+  tree.add("status", kCarverStatusUploading);
+  tree.add("upload_path", uploadPath.string());
+  std::string carve;
+  ASSERT_TRUE(tree.toString(carve).ok());
+  ASSERT_TRUE(setDatabaseValue(kCarves, kCarverDBPrefix + guid, carve).ok());
+
+  {
+    // The interrupted upload is posted again without archiving the sources.
+    FakeCarver carver(getCarvePaths(), guid, "");
+    ASSERT_TRUE(carver.carve().ok());
+    EXPECT_EQ(carver.posted_, uploadPath);
+  }
+  deleteDatabaseValue(kCarves, kCarverDBPrefix + guid);
+}
+
 TEST_F(CarverTests, test_compression_decompression) {
   auto const test_data_file = getWorkingDir() / "test.data";
   writeTextFile(test_data_file, R"raw_text(
@@ -285,4 +316,32 @@ oqADd9Ckcdtplx3k7bcLU[U04j8WWUtUccmB+4e2KS]i3x7WDKviPY/sWy9xFapv
                    (getWorkingDir() / fs::path("test.data.extract")).string()),
       hashFromFile(HashType::HASH_TYPE_SHA256, test_data_file.string()));
 }
+
+TEST_F(CarverTests, test_stream_archive) {
+  std::set<fs::path> paths;
+  for (const auto& path : getCarvePaths()) {
+    paths.insert(path);
+  }
+
+  const auto tarPath = getWorkingDir() / "stream.tar";
+  auto s = streamArchive(paths, tarPath, 8, false);
+  ASSERT_TRUE(s.ok()) << s.what();
+
+  // The observer sees exactly the bytes written to the compressed archive.
+  const auto zstdPath = getWorkingDir() / "stream.tar.zst";
+  Hash observed(HashType::HASH_TYPE_SHA256);
+  s = streamArchive(
+      paths, zstdPath, 8, true, [&observed](const void* data, size_t size) {
+        observed.update(data, size);
+      });
+  ASSERT_TRUE(s.ok()) << s.what();
+  EXPECT_EQ(observed.digest(),
+            hashFromFile(HashType::HASH_TYPE_SHA256, zstdPath.string()));
+
+  const auto extractPath = getWorkingDir() / "stream.tar.extract";
+  s = decompress(zstdPath, extractPath);
+  ASSERT_TRUE(s.ok()) << s.what();
+  EXPECT_EQ(hashFromFile(HashType::HASH_TYPE_SHA256, extractPath.string()),
+            hashFromFile(HashType::HASH_TYPE_SHA256, tarPath.string()));
+}
 } // namespace osquery
@@ -12,6 +12,7 @@
 #include <functional>
 #include <map>
 #include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -32,6 +33,7 @@
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/remote/backoff.h>
 
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
@@ -52,6 +54,25 @@ const int kMaxConfigSize = 1024 * 1024;
 using ConfigMap = std::map<std::string, std::string>;
 
 std::atomic<bool> is_first_time_refresh(true);
+
+std::string hashConfigValue(const rapidjson::Value& value) {
+  std::string content;
+  JSON::newFromValue(value).toString(content);
+  return hashFromBuffer(HASH_TYPE_SHA1, content.data(), content.size());
+}
+
+/// The keys used by every config parser.
+std::set<std::string> configParserKeys() {
+  std::set<std::string> keys;
+  for (const auto& plugin : RegistryFactory::get().plugins("config_parser")) {
+    auto parser = std::dynamic_pointer_cast<ConfigParserPlugin>(plugin.second);
+    if (parser != nullptr) {
+      const auto& parser_keys = parser->keys();
+      keys.insert(parser_keys.begin(), parser_keys.end());
+    }
+  }
+  return keys;
+}
 }; // namespace
 
 /**
@@ -267,12 +288,21 @@ PackRef& Schedule::last() {
  * For configurations pulled from the network this assures that configuration
  * is fresh when re-attaching.
  */
-class ConfigRefreshRunner : public InternalRunnable {
+class ConfigRefreshRunner : public PeriodicRunnable {
  public:
-  ConfigRefreshRunner() : InternalRunnable("ConfigRefreshRunner") {}
+  ConfigRefreshRunner() : PeriodicRunnable("ConfigRefreshRunner") {}
+
+ protected:
+  /// Refresh the configuration, then wait the configured, jittered, period.
+  std::chrono::milliseconds tick() override;
 
-  /// A simple wait/interruptible lock.
-  void start() override;
+  /// At t=0 the config was read, wait a period before the first refresh.
+  std::chrono::milliseconds firstDelay() override {
+    return refreshDelay();
+  }
+
+ private:
+  std::chrono::milliseconds refreshDelay() const;
 
  private:
   /// The current refresh rate in seconds.
@@ -351,6 +381,7 @@ void Config::addPack(const std::string& name,
     RecursiveLock wlock(config_schedule_mutex_);
     try {
       schedule_->add(std::make_unique<Pack>(pack_name, source, pack_obj));
+      schedule_generation_++;
       if (schedule_->last()->shouldPackExecute()) {
         applyParsers(source + FLAGS_pack_delimiter + pack_name, pack_obj, true);
       }
@@ -378,7 +409,8 @@ void Config::addPack(const std::string& name,
 
 void Config::removePack(const std::string& pack) {
   RecursiveLock wlock(config_schedule_mutex_);
-  return schedule_->remove(pack);
+  schedule_->remove(pack);
+  schedule_generation_++;
 }
 
 void Config::addFile(const std::string& source,
@@ -440,6 +472,7 @@ void Config::scheduledQueries(
           // The denylisted query passed the expiration time (remove).
           schedule_->denylist_.erase(denylisted_query);
           saveScheduleDenylist(schedule_->denylist_);
+          schedule_generation_++;
           it.second.denylisted = false;
         } else {
           // The query is still denylisted.
@@ -663,13 +696,22 @@ Status Config::updateSource(const std::string& source,
     return Status(2);
   }
 
-  {
+  bool reconfigure = false;
+  return applySource(source, json, reconfigure);
+}
+
+Status Config::applySource(const std::string& source,
+                           const std::string& json,
+                           bool& reconfigure) {
+  // Content that cannot be used removes the source's packs and files.
+  auto removeSource = [this, &source](Status status) {
     RecursiveLock lock(config_schedule_mutex_);
-    // Remove all packs from this source.
     schedule_->removeAll(source);
-    // Remove all files from this source.
+    schedule_generation_++;
     removeFiles(source);
-  }
+    sections_.erase(source);
+    return status;
+  };
 
   // load the config (source.second) into a JSON object.
   auto doc = JSON::newObject();
@@ -679,24 +721,25 @@ Status Config::updateSource(const std::string& source,
   // Since we use iterative parsing, we limit the size of the JSON
   // string to a sane value to avoid memory exhaustion.
   if (clone.size() > kMaxConfigSize) {
-    return Status::failure(
+    return removeSource(Status::failure(
         "Error parsing the config JSON: the config size exceeds the limit "
         "of " +
-        std::to_string(kMaxConfigSize) + " bytes");
+        std::to_string(kMaxConfigSize) + " bytes"));
   }
 
   if (!doc.fromString(clone, JSON::ParseMode::Iterative) ||
       !doc.doc().IsObject()) {
-    return Status::failure("Error parsing the config JSON");
+    return removeSource(Status::failure("Error parsing the config JSON"));
   }
 
   auto status = validateConfig(doc);
   if (!status.ok()) {
-    return Status::failure("Error validating the config JSON: " +
-                           status.getMessage());
+    return removeSource(Status::failure("Error validating the config JSON: " +
+                                        status.getMessage()));
   }
 
-  // extract the "schedule" key and store it as the main pack
+  // Collect the packs in order, the "schedule" key is the main pack.
+  std::vector<std::pair<std::string, JSON>> packs;
   auto& rf = RegistryFactory::get();
   if (doc.doc().HasMember("schedule") && !rf.external()) {
     auto& schedule = doc.doc()["schedule"];
@@ -705,33 +748,142 @@ Status Config::updateSource(const std::string& source,
       auto queries_obj = main_doc.getObject();
       main_doc.copyFrom(schedule, queries_obj);
       main_doc.add("queries", queries_obj);
-      addPack("main", source, main_doc.doc());
+      packs.emplace_back("main", std::move(main_doc));
     }
   }
 
-  // extract the "packs" key into additional pack objects
   if (doc.doc().HasMember("packs") && !rf.external()) {
-    auto& packs = doc.doc()["packs"];
-    if (packs.IsObject()) {
-      for (const auto& pack : packs.GetObject()) {
+    auto& packs_obj = doc.doc()["packs"];
+    if (packs_obj.IsObject()) {
+      for (const auto& pack : packs_obj.GetObject()) {
         std::string pack_name = pack.name.GetString();
         if (pack.value.IsObject()) {
           // The pack is a JSON object, treat the content as pack data.
-          addPack(pack_name, source, pack.value);
+          packs.emplace_back(pack_name, JSON::newFromValue(pack.value));
         } else if (pack.value.IsString()) {
-          genPack(pack_name, source, pack.value.GetString());
+          auto pack_doc = JSON::newObject();
+          if (genPackDocument(pack_name, pack.value.GetString(), pack_doc)
+                  .ok()) {
+            packs.emplace_back(pack_name, std::move(pack_doc));
+          }
+        }
+      }
+    }
+  }
+
+  // Hash each section of the content.
+  auto parser_keys = configParserKeys();
+  SourceSections sections;
+  for (const auto& pack : packs) {
+    auto& section = sections.packs[pack.first];
+    section.hash = hashConfigValue(pack.second.doc());
+
+    auto addKeys = [&section, &parser_keys](const rapidjson::Value& obj) {
+      for (const auto& member : obj.GetObject()) {
+        if (parser_keys.count(member.name.GetString()) > 0) {
+          section.keys.insert(member.name.GetString());
+        }
+      }
+    };
+    if (pack.first == "*") {
+      // A multi-pack generated by the config plugin.
+      for (const auto& multi_pack : pack.second.doc().GetObject()) {
+        if (multi_pack.value.IsObject()) {
+          section.names.push_back(multi_pack.name.GetString());
+          addKeys(multi_pack.value);
         }
       }
+    } else {
+      section.names.push_back(pack.first);
+      addKeys(pack.second.doc());
+    }
+  }
+
+  for (const auto& member : doc.doc().GetObject()) {
+    std::string key = member.name.GetString();
+    if (key != "schedule" && key != "packs") {
+      sections.keys[key] = hashConfigValue(member.value);
+    }
+  }
+
+  RecursiveLock lock(config_schedule_mutex_);
+  auto previous = sections_.find(source);
+  if (previous == sections_.end()) {
+    // The source is new, plugins have not seen its content.
+    reconfigure = true;
+    previous = sections_.emplace(source, SourceSections()).first;
+  }
+
+  std::set<std::string> changed_keys;
+  auto packHash = [](const SourceSections& from, const std::string& name) {
+    auto pack = from.packs.find(name);
+    return (pack == from.packs.end()) ? std::string() : pack->second.hash;
+  };
+
+  // Packs that were removed or changed leave the schedule.
+  for (const auto& pack : previous->second.packs) {
+    if (packHash(sections, pack.first) != pack.second.hash) {
+      for (const auto& name : pack.second.names) {
+        schedule_->remove(name, source);
+      }
+      schedule_generation_++;
+      changed_keys.insert(pack.second.keys.begin(), pack.second.keys.end());
+    }
+  }
+
+  // Packs that were added or changed join the schedule.
+  for (const auto& pack : packs) {
+    const auto& section = sections.packs[pack.first];
+    if (packHash(previous->second, pack.first) != section.hash) {
+      addPack(pack.first, source, pack.second.doc());
+      changed_keys.insert(section.keys.begin(), section.keys.end());
+    }
+  }
+
+  // Top-level keys that were added, removed or changed.
+  std::set<std::string> changed_parser_keys;
+  for (const auto& key : previous->second.keys) {
+    auto current = sections.keys.find(key.first);
+    if (current == sections.keys.end() || current->second != key.second) {
+      changed_parser_keys.insert(key.first);
+    }
+  }
+  for (const auto& key : sections.keys) {
+    if (previous->second.keys.count(key.first) == 0) {
+      changed_parser_keys.insert(key.first);
     }
   }
 
-  applyParsers(source, doc.doc(), false);
+  if (!changed_parser_keys.empty()) {
+    applyParsers(source, doc.doc(), false, &changed_parser_keys);
+    changed_keys.insert(changed_parser_keys.begin(),
+                        changed_parser_keys.end());
+  }
+
+  if (!changed_keys.empty()) {
+    reconfigure = true;
+  }
+  previous->second = std::move(sections);
   return Status::success();
 }
 
 Status Config::genPack(const std::string& name,
                        const std::string& source,
                        const std::string& target) {
+  auto doc = JSON::newObject();
+  auto status = genPackDocument(name, target, doc);
+  if (status.ok()) {
+    addPack(name, source, doc.doc());
+  } else if (status.getCode() == 2) {
+    // The pack content was empty or malformed, and a warning was logged.
+    return Status::success();
+  }
+  return status;
+}
+
+Status Config::genPackDocument(const std::string& name,
+                               const std::string& target,
+                               JSON& doc) {
   // If the pack value is a string (and not a JSON object) then it is a
   // resource to be handled by the config plugin.
   PluginResponse response;
@@ -746,15 +898,13 @@ Status Config::genPack(const std::string& name,
   auto clone = response[0][name];
   if (clone.empty()) {
     LOG(WARNING) << "Error reading the query pack named: " << name;
-    return Status::success();
+    return Status(2);
   }
 
   stripConfigComments(clone);
-  auto doc = JSON::newObject();
   if (!doc.fromString(clone) || !doc.doc().IsObject()) {
     LOG(WARNING) << "Error parsing the \"" << name << "\" pack JSON";
-  } else {
-    addPack(name, source, doc.doc());
+    return Status(2);
   }
 
   return Status::success();
@@ -762,7 +912,8 @@ Status Config::genPack(const std::string& name,
 
 void Config::applyParsers(const std::string& source,
                           const rj::Value& obj,
-                          bool pack) {
+                          bool pack,
+                          const std::set<std::string>* keys) {
   assert(obj.IsObject());
 
   auto applyParser = [=](const std::shared_ptr<ConfigParserPlugin>& parser,
@@ -795,6 +946,17 @@ void Config::applyParsers(const std::string& source,
     } catch (const std::bad_cast& /* e */) {
       LOG(ERROR) << "Error casting config parser plugin: " << name;
     }
+    if (parser != nullptr && keys != nullptr) {
+      // Parsers whose keys did not change keep their state.
+      const auto& parser_keys = parser->keys();
+      if (std::none_of(parser_keys.begin(),
+                       parser_keys.end(),
+                       [keys](const std::string& key) {
+                         return keys->count(key) > 0;
+                       })) {
+        return std::shared_ptr<ConfigParserPlugin>(nullptr);
+      }
+    }
     return parser;
   };
 
@@ -844,28 +1006,29 @@ Status Config::update(const ConfigMap& config) {
     }
   }
 
-  // Iterate though each source and overwrite config data.
-  // This will add/overwrite pack data, append to the schedule, change watched
-  // files, set options, etc.
-  // Before this occurs, take an opportunity to purge stale state.
-  purge();
-
-  bool needs_reconfigure = false;
+  // Only sources whose content changed are applied.
+  std::vector<const ConfigMap::value_type*> changed_sources;
   for (const auto& source : config) {
-    auto status = updateSource(source.first, source.second);
-    if (status.getCode() == 2) {
-      // The source content did not change.
-      continue;
+    if (hashSource(source.first, source.second)) {
+      changed_sources.push_back(&source);
     }
+  }
 
+  // Before the schedule changes, take an opportunity to purge stale state.
+  if (!changed_sources.empty()) {
+    purge();
+  }
+
+  // Iterate though each changed source and apply the sections that changed.
+  // This will add/replace pack data, change watched files, set options, etc.
+  bool needs_reconfigure = false;
+  for (const auto* source : changed_sources) {
+    auto status = applySource(source->first, source->second, needs_reconfigure);
     if (!status.ok()) {
       LOG(ERROR) << "updateSource failed to parse config, of source: "
-                 << source.first << " and content: " << source.second;
+                 << source->first << " and content: " << source->second;
       return status;
     }
-    // If a source was updated and the content has changed, then the registry
-    // should be reconfigured. File watches may have changed, etc.
-    needs_reconfigure = true;
   }
 
   if (loaded_ && needs_reconfigure) {
@@ -881,6 +1044,9 @@ Status Config::update(const ConfigMap& config) {
     }
 
     EventFactory::configUpdate();
+  } else if (loaded_ && !changed_sources.empty()) {
+    // Only packs and queries changed, publishers keep their watches.
+    EventFactory::scheduleUpdate();
   }
 
   // This cannot be under the previous if block because on extensions loaded_
@@ -963,9 +1129,11 @@ void Config::reset() {
   setStartTime(getUnixTime());
 
   schedule_ = std::make_unique<Schedule>();
+  schedule_generation_++;
   std::map<std::string, QueryPerformance>().swap(performance_);
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
+  std::map<std::string, SourceSections>().swap(sections_);
   valid_ = false;
   loaded_ = false;
   is_first_time_refresh = true;
@@ -1001,6 +1169,34 @@ void Config::recordQueryPerformance(const std::string& name,
                                     uint64_t delay,
                                     const Row& r0,
                                     const Row& r1) {
+  // Only columns available in both rows are compared.
+  auto L_ReadColumns = [&r0, &r1](const std::string& column,
+                                  uint64_t& v0,
+                                  uint64_t& v1) {
+    if (r0.at(column).empty() || r1.at(column).empty()) {
+      return;
+    }
+
+    auto c0 = tryTo<unsigned long long>(r0.at(column));
+    auto c1 = tryTo<unsigned long long>(r1.at(column));
+    if (c0 && c1) {
+      v0 = c0.take();
+      v1 = c1.take();
+    }
+  };
+
+  QueryResourceUsage u0;
+  QueryResourceUsage u1;
+  L_ReadColumns("user_time", u0.user_time, u1.user_time);
+  L_ReadColumns("system_time", u0.system_time, u1.system_time);
+  L_ReadColumns("resident_size", u0.resident_size, u1.resident_size);
+  recordQueryPerformance(name, delay, u0, u1);
+}
+
+void Config::recordQueryPerformance(const std::string& name,
+                                    uint64_t delay,
+                                    const QueryResourceUsage& r0,
+                                    const QueryResourceUsage& r1) {
   RecursiveLock lock(config_performance_mutex_);
   if (performance_.count(name) == 0) {
     performance_[name] = QueryPerformance();
@@ -1008,33 +1204,19 @@ void Config::recordQueryPerformance(const std::string& name,
 
   // Grab access to the non-const schedule item.
   auto& query = performance_.at(name);
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time += diff;
-    }
+  if (r1.user_time > r0.user_time) {
+    query.user_time += r1.user_time - r0.user_time;
   }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time += diff;
-    }
+  if (r1.system_time > r0.system_time) {
+    query.system_time += r1.system_time - r0.system_time;
   }
 
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-    }
+  if (r1.resident_size > r0.resident_size) {
+    auto diff = r1.resident_size - r0.resident_size;
+    // Memory is stored as an average of RSS changes between query executions.
+    query.average_memory = (query.average_memory * query.executions) + diff;
+    query.average_memory = (query.average_memory / (query.executions + 1));
   }
 
   query.wall_time += delay;
@@ -1056,6 +1238,13 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::denylistQuery(const std::string& name) {
+  RecursiveLock lock(config_schedule_mutex_);
+  schedule_->denylist_[name] = getUnixTime() + 86400;
+  saveScheduleDenylist(schedule_->denylist_);
+  schedule_generation_++;
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) const {
@@ -1192,19 +1381,14 @@ Status ConfigParserPlugin::setUp() {
   return Status::success();
 }
 
-void ConfigRefreshRunner::start() {
-  while (!interrupted()) {
-    // Cool off and time wait the configured period.
-    // Apply this interruption initially as at t=0 the config was read.
-    pause(std::chrono::seconds(refresh_sec_));
-    // Since the pause occurs before the logic, we need to check for an
-    // interruption request.
-    if (interrupted()) {
-      return;
-    }
+std::chrono::milliseconds ConfigRefreshRunner::refreshDelay() const {
+  return std::chrono::milliseconds(
+      RemoteBackoff::get().jitter(refresh_sec_ * 1000));
+}
 
-    VLOG(1) << "Refreshing configuration state";
-    Config::get().refresh();
-  }
+std::chrono::milliseconds ConfigRefreshRunner::tick() {
+  VLOG(1) << "Refreshing configuration state";
+  Config::get().refresh();
+  return refreshDelay();
 }
 } // namespace osquery
@@ -9,9 +9,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <osquery/core/plugins/plugin.h>
@@ -95,6 +97,19 @@ class Config : private boost::noncopyable {
                               const Row& r0,
                               const Row& r1);
 
+  /**
+   * @brief Record performance (monitoring) information about a scheduled query.
+   *
+   * @param name The unique name of the scheduled item
+   * @param delay Number of seconds (wall time) taken by the query
+   * @param r0 the resource usage before the query
+   * @param r1 the resource usage after the query
+   */
+  void recordQueryPerformance(const std::string& name,
+                              uint64_t delay,
+                              const QueryResourceUsage& r0,
+                              const QueryResourceUsage& r1);
+
   /**
    * @brief Record a query 'initialization', meaning the query will run.
    *
@@ -108,6 +123,16 @@ class Config : private boost::noncopyable {
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief Denylist a scheduled query that was stopped while executing.
+   *
+   * This applies the same denylist as a query that caused the worker to fail,
+   * including the query's "denylist" option.
+   *
+   * @param name The unique name of the scheduled item
+   */
+  void denylistQuery(const std::string& name);
+
   /**
    * @brief Calculate the hash of the osquery config
    *
@@ -185,6 +210,17 @@ class Config : private boost::noncopyable {
           predicate,
       bool denylisted = false) const;
 
+  /**
+   * @brief A counter that changes whenever the schedule changes.
+   *
+   * Packs being added or removed, and queries entering or leaving the
+   * denylist, change the generation. Pack discovery queries are evaluated
+   * lazily by scheduledQueries and do not.
+   */
+  uint64_t scheduleGeneration() const {
+    return schedule_generation_;
+  }
+
   /**
    * @brief Map a function across the set of configured files
    *
@@ -272,6 +308,21 @@ class Config : private boost::noncopyable {
   /// A step method for Config::update.
   Status updateSource(const std::string& source, const std::string& json);
 
+  /**
+   * @brief Apply the sections of a source's content that changed.
+   *
+   * Only packs with new content are replaced in the schedule, and only the
+   * config parsers whose keys changed are updated.
+   *
+   * @param source The config content source identifier.
+   * @param json The source's content.
+   * @param reconfigure Set if plugins should be reconfigured, because the
+   * source is new or keys other than the schedule changed.
+   */
+  Status applySource(const std::string& source,
+                     const std::string& json,
+                     bool& reconfigure);
+
   /**
    * @brief Generate pack content from a resource handled by the Plugin.
    *
@@ -291,6 +342,11 @@ class Config : private boost::noncopyable {
                  const std::string& source,
                  const std::string& target);
 
+  /// Parse the pack content generated by the ConfigPlugin, @see genPack.
+  Status genPackDocument(const std::string& name,
+                         const std::string& target,
+                         JSON& doc);
+
   /**
    * @brief Apply each ConfigParser to an input JSON document.
    *
@@ -305,10 +361,12 @@ class Config : private boost::noncopyable {
    * @param source The input configuration source name.
    * @param obj The input configuration JSON.
    * @param pack True if the JSON was built from pack data, otherwise false.
+   * @param keys If set, only parsers using one of these keys are applied.
    */
   void applyParsers(const std::string& source,
                     const rapidjson::Value& obj,
-                    bool pack = false);
+                    bool pack = false,
+                    const std::set<std::string>* keys = nullptr);
 
   /**
    * @brief When config sources are updated the config will 'purge'.
@@ -340,6 +398,30 @@ class Config : private boost::noncopyable {
   /// A set of hashes for each source of the config.
   std::map<std::string, std::string> hash_;
 
+  /// The hashed sections of a source, compared when the source changes.
+  struct SourceSections {
+    struct PackSection {
+      std::string hash;
+
+      /// The packs in the schedule, a "*" pack adds several.
+      std::vector<std::string> names;
+
+      /// The config parser keys within the pack content.
+      std::set<std::string> keys;
+    };
+
+    /// Top-level keys, other than the schedule and packs.
+    std::map<std::string, std::string> keys;
+
+    std::map<std::string, PackSection> packs;
+  };
+
+  /// The sections of each source of the config.
+  std::map<std::string, SourceSections> sections_;
+
+  /// Incremented by each change to the schedule.
+  mutable std::atomic<uint64_t> schedule_generation_{0};
+
   /// Check if the config received valid/parsable content from a config plugin.
   bool valid_{false};
 
@@ -255,6 +255,20 @@ void Pack::initialize(const std::string& name,
       });
     }
 
+    // Scans are throttled as configured by the query, its pack or the flag.
+    if (q.value.HasMember("throttle")) {
+      query.options["throttle"] = JSON::valueToBool(q.value["throttle"]);
+    } else if (obj.HasMember("throttle")) {
+      query.options["throttle"] = JSON::valueToBool(obj["throttle"]);
+    }
+
+    // Unchanged snapshots log their fingerprint, see --snapshot_fingerprint.
+    if (q.value.HasMember("fingerprint")) {
+      query.options["fingerprint"] = JSON::valueToBool(q.value["fingerprint"]);
+    } else if (obj.HasMember("fingerprint")) {
+      query.options["fingerprint"] = JSON::valueToBool(obj["fingerprint"]);
+    }
+
     schedule_.emplace(std::make_pair(q.name.GetString(), std::move(query)));
   }
 }
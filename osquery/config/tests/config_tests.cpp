@@ -96,6 +96,12 @@ class ConfigTests : public testing::Test {
     Config::get().loaded_ = true;
   }
 
+  Status applySource(const std::string& source,
+                     const std::string& json,
+                     bool& reconfigure) {
+    return Config::get().applySource(source, json, reconfigure);
+  }
+
   Config& get() {
     return Config::get();
   }
@@ -449,6 +455,62 @@ TEST_F(ConfigTests, test_content_update) {
   EXPECT_EQ(count, 0U);
 }
 
+TEST_F(ConfigTests, test_incremental_update) {
+  const std::string source{"incremental"};
+  auto makeContent = [](size_t interval, const std::string& extra) {
+    return "{" + extra +
+           "\"packs\": {\"a\": {\"queries\": {\"qa\": {\"query\": "
+           "\"select 1\", \"interval\": 60}}}, \"b\": {\"queries\": "
+           "{\"qb\": {\"query\": \"select 2\", \"interval\": " +
+           std::to_string(interval) + "}}}}}";
+  };
+
+  std::map<std::string, const Pack*> packs;
+  auto packCollector = [&packs](const Pack& pack) {
+    packs[pack.getName()] = &pack;
+  };
+
+  bool reconfigure = false;
+  ASSERT_TRUE(applySource(source, makeContent(60, ""), reconfigure).ok());
+  // Plugins have not seen a new source.
+  EXPECT_TRUE(reconfigure);
+  get().packs(packCollector);
+  ASSERT_EQ(packs.size(), 2U);
+  auto pack_a = packs["a"];
+
+  // Only the changed pack is replaced, and plugins are not reconfigured.
+  auto generation = get().scheduleGeneration();
+  reconfigure = false;
+  ASSERT_TRUE(applySource(source, makeContent(120, ""), reconfigure).ok());
+  EXPECT_FALSE(reconfigure);
+  EXPECT_GT(get().scheduleGeneration(), generation);
+  packs.clear();
+  get().packs(packCollector);
+  ASSERT_EQ(packs.size(), 2U);
+  EXPECT_EQ(packs["a"], pack_a);
+  EXPECT_EQ(packs["b"]->getSchedule().at("qb").interval, 120U);
+
+  // The same content leaves the schedule alone.
+  generation = get().scheduleGeneration();
+  ASSERT_TRUE(applySource(source, makeContent(120, ""), reconfigure).ok());
+  EXPECT_FALSE(reconfigure);
+  EXPECT_EQ(get().scheduleGeneration(), generation);
+
+  // A changed top-level key reconfigures, the schedule is unchanged.
+  auto file_paths = "\"file_paths\": {\"new\": [\"/new\"]}, ";
+  ASSERT_TRUE(
+      applySource(source, makeContent(120, file_paths), reconfigure).ok());
+  EXPECT_TRUE(reconfigure);
+  EXPECT_EQ(get().scheduleGeneration(), generation);
+
+  size_t count = 0;
+  get().files([&count](const std::string& category,
+                       const std::vector<std::string>& files) {
+    count += files.size();
+  });
+  EXPECT_EQ(count, 1U);
+}
+
 TEST_F(ConfigTests, test_get_scheduled_queries) {
   std::vector<std::string> query_names;
   get().addPack("unrestricted_pack", "", getUnrestrictedPack().doc());
@@ -181,6 +181,28 @@ TEST_F(PacksTests, test_schedule) {
   EXPECT_EQ(fpack.getSchedule().size(), 1U);
 }
 
+TEST_F(PacksTests, test_throttle_option) {
+  auto doc = JSON::newObject();
+  doc.fromString(
+      "{\"throttle\": true, \"queries\": {"
+      "\"pack\": {\"query\": \"select * from hash\", \"interval\": 60},"
+      "\"query\": {\"query\": \"select * from hash\", \"interval\": 60, "
+      "\"throttle\": false}}}");
+
+  // Queries use the pack's option unless they set their own.
+  Pack pack("throttle_pack", doc.doc());
+  const auto& schedule = pack.getSchedule();
+  ASSERT_EQ(schedule.size(), 2U);
+  EXPECT_TRUE(schedule.at("pack").options.at("throttle"));
+  EXPECT_FALSE(schedule.at("query").options.at("throttle"));
+
+  // Without either the option is not set and the flag applies.
+  Pack fpack("discovery_pack", getPackWithDiscovery().doc());
+  for (const auto& query : fpack.getSchedule()) {
+    EXPECT_EQ(query.second.options.count("throttle"), 0U);
+  }
+}
+
 TEST_F(PacksTests, test_discovery_cache) {
   Config c;
   // This pack and discovery query are valid, expect the SQL to execute.
@@ -11,7 +11,9 @@
 #include <future>
 #include <iostream>
 #include <random>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <signal.h>
 #include <stdio.h>
@@ -29,11 +31,14 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 #include <osquery/config/config.h>
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/tables.h>
 #include <osquery/core/watcher.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
@@ -131,6 +136,37 @@ bool Initializer::isWorker_{false};
 
 namespace {
 
+/// Times the phases of a daemon or shell start.
+class StartupPhases {
+ public:
+  /// End the current phase, the next phase starts now.
+  void end(const std::string& phase) {
+    auto now = std::chrono::steady_clock::now();
+    phases_.emplace_back(
+        phase,
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - start_)
+            .count());
+    start_ = now;
+  }
+
+  /// Publish the phase durations, once the monitoring plugin is active.
+  void record() const {
+    for (const auto& phase : phases_) {
+      VLOG(1) << "Startup phase " << phase.first << " took " << phase.second
+              << "ms";
+      if (FLAGS_enable_numeric_monitoring) {
+        monitoring::record("startup." + phase.first + ".duration_ms",
+                           static_cast<monitoring::ValueType>(phase.second));
+      }
+    }
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_{
+      std::chrono::steady_clock::now()};
+  std::vector<std::pair<std::string, uint64_t>> phases_;
+};
+
 static inline bool hasWorkerVariable() {
   return getEnvVar("OSQUERY_WORKER").is_initialized();
 }
@@ -292,6 +328,9 @@ Initializer::Initializer(int& argc,
   // Let gflags parse the non-help options/flags.
   GFLAGS_NAMESPACE::ParseCommandLineFlags(argc_, argv_, isShell());
 
+  // The allocator is configured before other threads allocate.
+  configureAllocator();
+
   if (isShell()) {
     // Do not set these values before calling ParseCommandLineFlags.
     // These values are force-set and ignore the configuration and CLI.
@@ -471,6 +510,13 @@ void Initializer::initWorker(const std::string& name) const {
   // In this case the parent process is called the 'watcher' process.
   Dispatcher::addService(std::make_shared<WatcherWatcherRunner>(
       PlatformProcess::getLauncherProcess()));
+
+  // Tables generating rows in parallel must stay within the CPU utilization
+  // limit enforced by the watcher, a percentage of all CPUs.
+  size_t cpus = std::max(boost::thread::physical_concurrency(), 1U);
+  auto budget =
+      getWorkerLimit(WatchdogLimitType::UTILIZATION_LIMIT) * cpus / 100;
+  setTableWorkerBudget(std::max<size_t>(budget, 1));
 }
 
 void Initializer::initWorkerWatcher(const std::string& name) const {
@@ -523,6 +569,7 @@ void Initializer::start() const {
     FLAGS_disable_extensions = true;
   }
 
+  StartupPhases phases;
   if (!isWatcher()) {
     setDatabaseAllowOpen();
     auto status = initDatabasePlugin();
@@ -539,6 +586,7 @@ void Initializer::start() const {
       return;
     }
   }
+  phases.end("database");
 
   // Bind to an extensions socket and wait for registry additions.
   // After starting the extension manager, osquery MUST shutdown using the
@@ -556,12 +604,14 @@ void Initializer::start() const {
           << error_message;
     }
   }
+  phases.end("extensions");
 
   // Then set the config plugin, which uses a single/active plugin.
   initActivePlugin("config", FLAGS_config_plugin);
 
   // Run the setup for all lazy registries (tables, SQL).
   Registry::setUp();
+  phases.end("registry");
 
   if (FLAGS_config_check) {
     // The initiator requested an initialization and config check.
@@ -591,6 +641,7 @@ void Initializer::start() const {
       VLOG(1) << message;
     }
   }
+  phases.end("config");
 
   // Initialize the status and result plugin logger.
   if (!FLAGS_disable_logging) {
@@ -607,10 +658,13 @@ void Initializer::start() const {
     initActivePlugin(monitoring::registryName(),
                      FLAGS_numeric_monitoring_plugins);
   }
+  phases.end("plugins");
 
   // Start event threads.
   attachEvents();
   EventFactory::delay();
+  phases.end("events");
+  phases.record();
 }
 
 /**
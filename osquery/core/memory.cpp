@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstdlib>
+#include <utility>
+
+// __GLIBC__ is defined by the C library headers.
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+FLAG(uint32,
+     malloc_arena_max,
+     0,
+     "Maximum heap arenas, fewer arenas fragment less (glibc, 0 is the "
+     "allocator's default)");
+
+FLAG(uint32,
+     malloc_trim_threshold,
+     64,
+     "Megabytes of free heap above which the scheduler returns memory to "
+     "the system while idle (glibc, 0 disables)");
+
+namespace {
+
+struct MemoryReporters {
+  Mutex mutex;
+  std::vector<std::pair<std::string, MemoryReporter>> reporters;
+};
+
+MemoryReporters& getMemoryReporters() {
+  static MemoryReporters reporters;
+  return reporters;
+}
+
+} // namespace
+
+bool registerMemoryReporter(const std::string& subsystem,
+                            MemoryReporter reporter) {
+  auto& reporters = getMemoryReporters();
+  WriteLock lock(reporters.mutex);
+  reporters.reporters.emplace_back(subsystem, std::move(reporter));
+  return true;
+}
+
+std::vector<SubsystemMemory> getSubsystemMemory() {
+  std::vector<std::pair<std::string, MemoryReporter>> reporters;
+  {
+    auto& registered = getMemoryReporters();
+    ReadLock lock(registered.mutex);
+    reporters = registered.reporters;
+  }
+
+  std::vector<SubsystemMemory> memory;
+  for (const auto& reporter : reporters) {
+    auto first = memory.size();
+    reporter.second(memory);
+    for (auto i = first; i < memory.size(); ++i) {
+      memory[i].subsystem = reporter.first;
+    }
+  }
+  return memory;
+}
+
+Status getAllocatorStats(AllocatorStats& stats) {
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+  auto info = mallinfo2();
+#else
+  auto info = mallinfo();
+#endif
+  stats.allocator = "glibc";
+  stats.heap = static_cast<uint64_t>(info.arena) + info.hblkhd;
+  stats.in_use = static_cast<uint64_t>(info.uordblks) + info.hblkhd;
+  stats.free = static_cast<uint64_t>(info.fordblks);
+  stats.free_chunks = static_cast<uint64_t>(info.ordblks);
+  stats.mapped = static_cast<uint64_t>(info.hblkhd);
+  stats.releasable = static_cast<uint64_t>(info.keepcost);
+  return Status::success();
+#else
+  return Status::failure("Allocator statistics are not supported");
+#endif
+}
+
+bool releaseAllocatorMemory(uint64_t min_free) {
+#if defined(__GLIBC__)
+  if (min_free > 0) {
+    AllocatorStats stats;
+    if (!getAllocatorStats(stats).ok() || stats.free < min_free) {
+      return false;
+    }
+  }
+  return malloc_trim(0) == 1;
+#else
+  return false;
+#endif
+}
+
+void configureAllocator() {
+#if defined(__GLIBC__)
+  if (FLAGS_malloc_arena_max > 0 &&
+      mallopt(M_ARENA_MAX, static_cast<int>(FLAGS_malloc_arena_max)) != 1) {
+    LOG(WARNING) << "Cannot set the maximum heap arenas to "
+                 << FLAGS_malloc_arena_max;
+  }
+#endif
+}
+
+} // namespace osquery
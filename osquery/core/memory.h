@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// Memory held by one part of a subsystem, as reported by the subsystem.
+struct SubsystemMemory {
+  /// The subsystem, such as sql, database, logger or events.
+  std::string subsystem;
+
+  /// The part of the subsystem measured.
+  std::string name;
+
+  /// Bytes held, or -1 if only the items are known.
+  int64_t bytes{-1};
+
+  /// Buffered items such as logs or rows, or -1 if not counted.
+  int64_t items{-1};
+};
+
+/// Append the memory held by a subsystem, it must be cheap and thread safe.
+using MemoryReporter = std::function<void(std::vector<SubsystemMemory>&)>;
+
+/**
+ * @brief Register a reporter of the memory held by a subsystem.
+ *
+ * Subsystems register as they are initialized, usually with a static
+ * initializer. The osquery_memory table and numeric monitoring call every
+ * reporter.
+ *
+ * @return true, so the result may initialize a static.
+ */
+bool registerMemoryReporter(const std::string& subsystem,
+                            MemoryReporter reporter);
+
+/// Collect the memory reported by every subsystem, in registration order.
+std::vector<SubsystemMemory> getSubsystemMemory();
+
+/// Statistics of the process's heap allocator.
+struct AllocatorStats {
+  /// The allocator, such as glibc.
+  std::string allocator;
+
+  /// Bytes of heap obtained from the system, including mapped chunks.
+  uint64_t heap{0};
+
+  /// Bytes of allocations in use.
+  uint64_t in_use{0};
+
+  /// Bytes of free heap still held by the allocator.
+  uint64_t free{0};
+
+  /// The number of free chunks, many small chunks mean fragmentation.
+  uint64_t free_chunks{0};
+
+  /// Bytes of allocations made with mmap, returned when freed.
+  uint64_t mapped{0};
+
+  /// Bytes at the top of the heap that may be released.
+  uint64_t releasable{0};
+};
+
+/// Read the heap allocator's statistics, fails if they are not supported.
+Status getAllocatorStats(AllocatorStats& stats);
+
+/**
+ * @brief Return free heap memory to the system.
+ *
+ * Memory freed by long running threads stays in the allocator's arenas and
+ * counts towards the watchdog memory limit until it is released.
+ *
+ * @param min_free release only if at least this many bytes are free.
+ * @return true if memory was released.
+ */
+bool releaseAllocatorMemory(uint64_t min_free = 0);
+
+/// Apply the allocator flags, called once at startup after flags are parsed.
+void configureAllocator();
+
+} // namespace osquery
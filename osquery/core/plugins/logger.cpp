@@ -43,11 +43,47 @@ void deserializeIntermediateLog(const PluginRequest& request,
 
 }
 
+namespace {
+
+/// Log each line of a newline-terminated batch, returning the last failure.
+template <typename LogLine>
+Status logLines(const std::string& batch, LogLine log_line) {
+  Status status;
+  size_t start = 0;
+  while (start < batch.size()) {
+    auto end = batch.find('\n', start);
+    if (end == std::string::npos) {
+      end = batch.size();
+    }
+
+    auto line_status = log_line(batch.substr(start, end - start));
+    if (!line_status.ok()) {
+      status = line_status;
+    }
+    start = end + 1;
+  }
+  return status;
+}
+
+} // namespace
+
+Status LoggerPlugin::logStringBatch(const std::string& batch) {
+  return logLines(batch,
+                  [this](const std::string& line) { return logString(line); });
+}
+
+Status LoggerPlugin::logEventBatch(const std::string& batch) {
+  return logLines(batch,
+                  [this](const std::string& line) { return logEvent(line); });
+}
+
 Status LoggerPlugin::call(const PluginRequest& request,
                           PluginResponse& response) {
   std::vector<StatusLogLine> intermediate_logs;
   if (request.count("string") > 0) {
     return this->logString(request.at("string"));
+  } else if (request.count("string_batch") > 0) {
+    return this->logStringBatch(request.at("string_batch"));
   } else if (request.count("snapshot") > 0) {
     return this->logSnapshot(request.at("snapshot"));
   } else if (request.count("init") > 0) {
@@ -60,6 +96,8 @@ Status LoggerPlugin::call(const PluginRequest& request,
     return this->logStatus(intermediate_logs);
   } else if (request.count("event") > 0) {
     return this->logEvent(request.at("event"));
+  } else if (request.count("event_batch") > 0) {
+    return this->logEventBatch(request.at("event_batch"));
   } else if (request.count("action") && request.at("action") == "features") {
     size_t features = 0;
     features |= (usesLogStatus()) ? LOGGER_FEATURE_LOGSTATUS : 0;
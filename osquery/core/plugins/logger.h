@@ -161,6 +161,18 @@ class LoggerPlugin : public Plugin {
    */
   virtual Status logString(const std::string& s) = 0;
 
+  /**
+   * @brief Optionally handle a batch of query results at once.
+   *
+   * The batch holds one serialized result per line, each terminated by a
+   * newline. Plugins that write results to a stream can write the batch
+   * directly. Otherwise each line is forwarded to logString.
+   *
+   * @param batch The newline-terminated results.
+   * @return log status
+   */
+  virtual Status logStringBatch(const std::string& batch);
+
   /**
    * @brief See the usesLogStatus method, log a Glog status.
    *
@@ -196,6 +208,17 @@ class LoggerPlugin : public Plugin {
     return Status(1, "Not enabled");
   }
 
+  /**
+   * @brief Optionally handle a batch of published events at once.
+   *
+   * The batch holds one serialized event per line, each terminated by a
+   * newline. Otherwise each line is forwarded to logEvent.
+   *
+   * @param batch The newline-terminated events.
+   * @return log status
+   */
+  virtual Status logEventBatch(const std::string& batch);
+
  protected:
   /**
    * @brief Initialize the logger with the name of the binary and any status
@@ -8,12 +8,15 @@
  */
 
 #include <algorithm>
+#include <set>
 #include <string>
 #include <vector>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/query.h>
+#include <osquery/core/sql/hashed_results.h>
+#include <osquery/core/trace.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 
@@ -32,6 +35,19 @@ FLAG(bool,
      "Use numeric JSON syntax for numeric values");
 FLAG_ALIAS(bool, log_numerics_as_numbers, logger_numerics);
 
+FLAG(bool,
+     schedule_differential_digests,
+     false,
+     "Store per-row content digests for differential scheduled queries");
+
+/// Decode stored results in either the JSON or the hashed record format.
+static Status deserializeStoredResults(std::string raw, QueryBatch& results) {
+  if (isHashedResults(raw)) {
+    return deserializeHashedResults(raw, results);
+  }
+  return deserializeQueryBatchJSON(std::move(raw), results);
+}
+
 uint64_t Query::getPreviousEpoch() const {
   uint64_t epoch = 0;
   std::string raw;
@@ -63,13 +79,36 @@ Status Query::getPreviousQueryResults(QueryDataSet& results) const {
     return status;
   }
 
-  status = deserializeQueryDataJSON(raw, results);
+  if (isHashedResults(raw)) {
+    QueryBatch batch;
+    status = deserializeHashedResults(raw, batch);
+    if (!status.ok()) {
+      return status;
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+      results.insert(batch.row(i));
+    }
+    return Status::success();
+  }
+
+  status = deserializeQueryDataJSON(std::move(raw), results);
   if (!status.ok()) {
     return status;
   }
   return Status::success();
 }
 
+Status Query::getPreviousQueryResults(QueryBatch& results) const {
+  std::string raw;
+  auto status = getDatabaseValue(kQueries, name_, raw);
+  if (!status.ok()) {
+    return status;
+  }
+
+  return deserializeStoredResults(std::move(raw), results);
+}
+
 std::vector<std::string> Query::getStoredQueryNames() {
   std::vector<std::string> results;
   scanDatabaseKeys(kQueries, results);
@@ -99,14 +138,13 @@ Status Query::addNewResults(QueryDataTyped qd,
   return addNewResults(std::move(qd), epoch, counter, dr, false);
 }
 
-Status Query::addNewResults(QueryDataTyped current_qd,
-                            const uint64_t current_epoch,
-                            uint64_t& counter,
-                            DiffResults& dr,
-                            bool calculate_diff) const {
+void Query::checkResultsState(uint64_t current_epoch,
+                              bool calculate_diff,
+                              bool& fresh_results,
+                              bool& new_query) const {
   // The current results are 'fresh' when not calculating a differential.
-  bool fresh_results = !calculate_diff;
-  bool new_query = false;
+  fresh_results = !calculate_diff;
+  new_query = false;
   if (!isQueryNameInDatabase()) {
     // This is the first encounter of the scheduled query.
     fresh_results = true;
@@ -122,12 +160,38 @@ Status Query::addNewResults(QueryDataTyped current_qd,
     LOG(INFO) << "Scheduled query has been updated: " + name_;
     saveQuery(name_, query_);
   }
+}
+
+void Query::batchResults(std::string json,
+                         uint64_t epoch,
+                         DatabaseStringValueList& batch) const {
+  // Replace the "previous" query data with the current.
+  batch.push_back(std::make_pair(name_, std::move(json)));
+  batch.push_back(std::make_pair(name_ + "epoch", std::to_string(epoch)));
+}
+
+void Query::batchCounter(bool reset,
+                         uint64_t& counter,
+                         DatabaseStringValueList& batch) const {
+  counter = getQueryCounter(reset);
+  batch.push_back(std::make_pair(name_ + "counter", std::to_string(counter)));
+}
+
+Status Query::addNewResults(QueryDataTyped current_qd,
+                            const uint64_t current_epoch,
+                            uint64_t& counter,
+                            DiffResults& dr,
+                            bool calculate_diff) const {
+  bool fresh_results = false;
+  bool new_query = false;
+  checkResultsState(current_epoch, calculate_diff, fresh_results, new_query);
 
   // Use a 'target' avoid copying the query data when serializing and saving.
   // If a differential is requested and needed the target remains the original
   // query data, otherwise the content is moved to the differential's added set.
   const auto* target_gd = &current_qd;
   bool update_db = true;
+  DatabaseStringValueList batch;
   if (!fresh_results && calculate_diff) {
     // Get the rows from the last run of this query name.
     QueryDataSet previous_qd;
@@ -137,6 +201,7 @@ Status Query::addNewResults(QueryDataTyped current_qd,
     }
 
     // Calculate the differential between previous and current query results.
+    OSQUERY_TRACE_SPAN_DETAIL("query", "diff", name_);
     dr = diff(previous_qd, current_qd);
 
     update_db = (!dr.added.empty() || !dr.removed.empty());
@@ -146,34 +211,94 @@ Status Query::addNewResults(QueryDataTyped current_qd,
   }
 
   if (update_db) {
-    // Replace the "previous" query data with the current.
+    OSQUERY_TRACE_SPAN_DETAIL("query", "serialize", name_);
     std::string json;
     auto status = serializeQueryDataJSON(*target_gd, json, true);
     if (!status.ok()) {
       return status;
     }
 
-    status = setDatabaseValue(kQueries, name_, json);
+    batchResults(std::move(json), current_epoch, batch);
+  }
+
+  if (update_db || fresh_results || new_query) {
+    batchCounter(fresh_results || new_query, counter, batch);
+  }
+
+  // The results, epoch and counter are stored with a single write.
+  if (batch.empty()) {
+    return Status::success();
+  }
+  return setDatabaseBatch(kQueries, batch);
+}
+
+Status Query::addNewResults(QueryBatch current_qd,
+                            const uint64_t current_epoch,
+                            uint64_t& counter,
+                            DiffResults& dr,
+                            bool calculate_diff) const {
+  bool fresh_results = false;
+  bool new_query = false;
+  checkResultsState(current_epoch, calculate_diff, fresh_results, new_query);
+
+  bool update_db = true;
+  DatabaseStringValueList batch;
+  std::string stored;
+  if (!fresh_results && calculate_diff) {
+    // Get the rows from the last run of this query name.
+    std::string previous;
+    auto status = getDatabaseValue(kQueries, name_, previous);
     if (!status.ok()) {
       return status;
     }
 
-    status = setDatabaseValue(
-        kQueries, name_ + "epoch", std::to_string(current_epoch));
-    if (!status.ok()) {
-      return status;
+    OSQUERY_TRACE_SPAN_DETAIL("query", "diff", name_);
+    if (FLAGS_schedule_differential_digests && isHashedResults(previous)) {
+      // Only digests are compared, unchanged rows are never parsed.
+      status = diffHashedResults(previous, current_qd, dr, stored);
+      if (!status.ok()) {
+        return status;
+      }
+    } else {
+      QueryBatch previous_qd;
+      status = deserializeStoredResults(std::move(previous), previous_qd);
+      if (!status.ok()) {
+        return status;
+      }
+
+      // Calculate the differential between previous and current results.
+      dr = diff(previous_qd, current_qd);
     }
+
+    update_db = (!dr.added.empty() || !dr.removed.empty());
+  } else {
+    dr.added = current_qd.toRows();
   }
 
-  if (update_db || fresh_results || new_query) {
-    counter = getQueryCounter(fresh_results || new_query);
-    auto status =
-        setDatabaseValue(kQueries, name_ + "counter", std::to_string(counter));
-    if (!status.ok()) {
-      return status;
+  if (update_db) {
+    if (stored.empty()) {
+      // The batch is serialized directly, without materializing rows.
+      OSQUERY_TRACE_SPAN_DETAIL("query", "serialize", name_);
+      auto status = FLAGS_schedule_differential_digests
+                         ? serializeHashedResults(current_qd, stored)
+                         : serializeQueryBatchJSON(current_qd, stored, true);
+      if (!status.ok()) {
+        return status;
+      }
     }
+
+    batchResults(std::move(stored), current_epoch, batch);
   }
-  return Status::success();
+
+  if (update_db || fresh_results || new_query) {
+    batchCounter(fresh_results || new_query, counter, batch);
+  }
+
+  // The results, epoch and counter are stored with a single write.
+  if (batch.empty()) {
+    return Status::success();
+  }
+  return setDatabaseBatch(kQueries, batch);
 }
 
 Status deserializeDiffResults(const rj::Value& doc, DiffResults& dr) {
@@ -252,6 +377,9 @@ Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc) {
     }
 
     doc.add("diffResults", obj);
+  } else if (item.snapshot_unchanged) {
+    doc.addRef("fingerprint", item.snapshot_fingerprint);
+    doc.addRef("action", "snapshot_unchanged");
   } else {
     auto arr = doc.getArray();
     auto status = serializeQueryData(
@@ -261,6 +389,9 @@ Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc) {
     }
 
     doc.add("snapshot", arr);
+    if (!item.snapshot_fingerprint.empty()) {
+      doc.addRef("fingerprint", item.snapshot_fingerprint);
+    }
     doc.addRef("action", "snapshot");
   }
 
@@ -314,14 +445,121 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& doc) {
   return Status::success();
 }
 
+namespace {
+
+/// Event buffers beyond this size are released after use.
+const size_t kMaxRetainedEventBuffer = 1024 * 1024;
+
+/// Members of a serialized item that a top-level decoration could replace.
+const std::set<std::string> kQueryLogItemMembers = {
+    "diffResults",
+    "snapshot",
+    "fingerprint",
+    "action",
+    "name",
+    "hostIdentifier",
+    "calendarTime",
+    "unixTime",
+    "epoch",
+    "counter",
+    "numerics",
+};
+
+void writeMember(rj::Writer<rj::StringBuffer>& writer,
+                 const std::string& key,
+                 const std::string& value) {
+  writer.Key(key.data(), static_cast<rj::SizeType>(key.size()));
+  writer.String(value.data(), static_cast<rj::SizeType>(value.size()));
+}
+
+/// Write the members added by addLegacyFieldsAndDecorations.
+void writeLegacyFieldsAndDecorations(const QueryLogItem& item,
+                                     rj::Writer<rj::StringBuffer>& writer) {
+  writeMember(writer, "name", item.name);
+  writeMember(writer, "hostIdentifier", item.identifier);
+  writeMember(writer, "calendarTime", item.calendar_time);
+  writer.Key("unixTime");
+  writer.Uint64(item.time);
+  writer.Key("epoch");
+  writer.Uint64(item.epoch);
+  writer.Key("counter");
+  writer.Uint64(item.counter);
+  writer.Key("numerics");
+  writer.Bool(FLAGS_logger_numerics);
+
+  if (item.decorations.empty()) {
+    return;
+  }
+
+  if (!FLAGS_decorations_top_level) {
+    writer.Key("decorations");
+    writer.StartObject();
+  }
+  for (const auto& name : item.decorations) {
+    writeMember(writer, name.first, name.second);
+  }
+  if (!FLAGS_decorations_top_level) {
+    writer.EndObject();
+  }
+}
+
+/// Append the events of one action, each is the envelope, columns and action.
+void writeEventLines(const std::string& envelope,
+                     const std::string& action,
+                     const QueryDataTyped& rows,
+                     rj::StringBuffer& sb,
+                     rj::Writer<rj::StringBuffer>& writer) {
+  auto suffix = ",\"action\":\"" + action + "\"}\n";
+  for (const auto& row : rows) {
+    std::copy(envelope.begin(), envelope.end(), sb.Push(envelope.size()));
+    writer.Reset(sb);
+    writeRow(row, writer, FLAGS_logger_numerics);
+    std::copy(suffix.begin(), suffix.end(), sb.Push(suffix.size()));
+  }
+}
+
+} // namespace
+
 Status serializeQueryLogItemJSON(const QueryLogItem& item, std::string& json) {
-  auto doc = JSON::newObject();
-  auto status = serializeQueryLogItem(item, doc);
-  if (!status.ok()) {
-    return status;
+  if (FLAGS_decorations_top_level) {
+    for (const auto& name : item.decorations) {
+      if (kQueryLogItemMembers.count(name.first) > 0) {
+        // A decoration replaces an item member, use the document encoding.
+        auto doc = JSON::newObject();
+        auto status = serializeQueryLogItem(item, doc);
+        if (!status.ok()) {
+          return status;
+        }
+        return doc.toString(json);
+      }
+    }
   }
 
-  return doc.toString(json);
+  // Write the item directly, a document would copy every row's members.
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  writer.StartObject();
+  if (!item.results.added.empty() || !item.results.removed.empty()) {
+    writer.Key("diffResults");
+    writeDiffResults(item.results, writer, FLAGS_logger_numerics);
+  } else if (item.snapshot_unchanged) {
+    writeMember(writer, "fingerprint", item.snapshot_fingerprint);
+    writer.Key("action");
+    writer.String("snapshot_unchanged");
+  } else {
+    writer.Key("snapshot");
+    writeQueryData(item.snapshot_results, writer, FLAGS_logger_numerics);
+    if (!item.snapshot_fingerprint.empty()) {
+      writeMember(writer, "fingerprint", item.snapshot_fingerprint);
+    }
+    writer.Key("action");
+    writer.String("snapshot");
+  }
+  writeLegacyFieldsAndDecorations(item, writer);
+  writer.EndObject();
+
+  json.assign(sb.GetString(), sb.GetSize());
+  return Status::success();
 }
 
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& item,
@@ -342,4 +580,53 @@ Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& item,
   return Status::success();
 }
 
+Status serializeQueryLogItemAsEventLines(const QueryLogItem& item,
+                                         std::string& lines) {
+  lines.clear();
+  if (item.results.added.empty() && item.results.removed.empty() &&
+      item.snapshot_results.empty()) {
+    return Status(1, "No differential or snapshot results");
+  }
+
+  if (FLAGS_decorations_top_level && (item.decorations.count("columns") > 0 ||
+                                      item.decorations.count("action") > 0)) {
+    // A decoration replaces the event member, use the document encoding.
+    std::vector<std::string> items;
+    auto status = serializeQueryLogItemAsEventsJSON(item, items);
+    for (const auto& event : items) {
+      lines.append(event);
+      lines.push_back('\n');
+    }
+    return status;
+  }
+
+  // Every event shares the legacy fields and decorations, encode them once.
+  std::string envelope;
+  {
+    auto doc = JSON::newObject();
+    addLegacyFieldsAndDecorations(item, doc, doc.doc());
+    doc.toString(envelope);
+  }
+  envelope.back() = ',';
+  envelope.append("\"columns\":");
+
+  // The buffer keeps its capacity between the result batches of a thread.
+  thread_local rj::StringBuffer sb;
+  sb.Clear();
+  rj::Writer<rj::StringBuffer> writer(sb);
+  if (!item.results.added.empty() || !item.results.removed.empty()) {
+    writeEventLines(envelope, "removed", item.results.removed, sb, writer);
+    writeEventLines(envelope, "added", item.results.added, sb, writer);
+  } else {
+    writeEventLines(envelope, "snapshot", item.snapshot_results, sb, writer);
+  }
+
+  lines.assign(sb.GetString(), sb.GetSize());
+  sb.Clear();
+  if (lines.size() > kMaxRetainedEventBuffer) {
+    sb.ShrinkToFit();
+  }
+  return Status::success();
+}
+
 }
@@ -20,6 +20,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/sql/diff_results.h>
 #include <osquery/core/sql/scheduled_query.h>
+#include <osquery/database/idatabaseinterface.h>
 #include <osquery/utils/json/json.h>
 
 namespace osquery {
@@ -41,6 +42,12 @@ struct QueryLogItem {
   /// Optional snapshot results, no differential applied.
   QueryDataTyped snapshot_results;
 
+  /// Optional digest of the snapshot results, logged with them.
+  std::string snapshot_fingerprint;
+
+  /// The snapshot results match the last logged ones, only log the digest.
+  bool snapshot_unchanged{false};
+
   /// The name of the scheduled query.
   std::string name;
 
@@ -116,6 +123,21 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& json);
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& i,
                                          std::vector<std::string>& items);
 
+/**
+ * @brief Serialize a QueryLogItem object into newline-terminated JSON events.
+ *
+ * The output is identical to the lines of serializeQueryLogItemAsEventsJSON,
+ * but the item's shared fields are encoded once and all events are written
+ * into a single buffer.
+ *
+ * @param item the QueryLogItem to serialize
+ * @param lines [output] the events, each followed by a newline
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status serializeQueryLogItemAsEventLines(const QueryLogItem& item,
+                                         std::string& lines);
+
 /**
  * @brief Interact with the historical on-disk storage for a given query.
  */
@@ -145,6 +167,15 @@ class Query {
    */
   Status getPreviousQueryResults(QueryDataSet& results) const;
 
+  /**
+   * @brief Retrieve the previous results from RocksDB in columnar form.
+   *
+   * @param results the output QueryBatch.
+   *
+   * @return the success or failure of the operation.
+   */
+  Status getPreviousQueryResults(QueryBatch& results) const;
+
   /**
    * @brief Get the epoch associated with the previous query results.
    *
@@ -220,6 +251,27 @@ class Query {
                        DiffResults& dr,
                        bool calculate_diff = true) const;
 
+  /**
+   * @brief Add a new columnar set of results to the persistent storage and
+   * get back the differential results.
+   *
+   * This behaves like the QueryDataTyped variant but the previous results are
+   * loaded and diffed as a QueryBatch, avoiding per-row map construction.
+   *
+   * @param qd the QueryBatch object containing query results to store.
+   * @param epoch the epoch associated with QueryData
+   * @param counter the output that holds the query execution counter.
+   * @param dr an output to a DiffResults object populated based on last run.
+   * @param calculate_diff default true to populate dr.
+   *
+   * @return the success or failure of the operation.
+   */
+  Status addNewResults(QueryBatch qd,
+                       uint64_t epoch,
+                       uint64_t& counter,
+                       DiffResults& dr,
+                       bool calculate_diff = true) const;
+
   /**
    * @brief The most recent result set for a scheduled query.
    *
@@ -241,6 +293,27 @@ class Query {
    */
   static std::vector<std::string> getStoredQueryNames();
 
+ private:
+  /**
+   * @brief Determine if results are fresh or belong to an altered query.
+   *
+   * Records the query string for new or altered queries as a side effect.
+   */
+  void checkResultsState(uint64_t epoch,
+                         bool calculate_diff,
+                         bool& fresh_results,
+                         bool& new_query) const;
+
+  /// Add the serialized results and epoch for the next differential to batch.
+  void batchResults(std::string json,
+                    uint64_t epoch,
+                    DatabaseStringValueList& batch) const;
+
+  /// Add the updated execution counter to batch.
+  void batchCounter(bool reset,
+                    uint64_t& counter,
+                    DatabaseStringValueList& batch) const;
+
  private:
   /// The scheduled query's query string.
   std::string query_;
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "binary_row.h"
+
+namespace osquery {
+
+const char kBinaryRowMarker{'\x01'};
+
+namespace {
+
+/// Schema column names are identifiers, a newline never appears in them.
+const char kSchemaDelimiter{'\n'};
+
+void writeVarint(std::string& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+bool readVarint(const std::string& in, size_t& offset, uint64_t& v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && offset < in.size(); shift += 7) {
+    auto byte = static_cast<unsigned char>(in[offset++]);
+    v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool sameColumns(const Row& r, const ColumnNames& schema) {
+  if (r.size() != schema.size()) {
+    return false;
+  }
+
+  auto column = schema.begin();
+  for (const auto& cell : r) {
+    if (cell.first != *column++) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+RowSchemaID RowSchemaCatalog::getID(const Row& r, bool& added) {
+  added = false;
+  if (last_schema_ != nullptr && sameColumns(r, *last_schema_)) {
+    return last_id_;
+  }
+
+  ColumnNames schema;
+  schema.reserve(r.size());
+  for (const auto& cell : r) {
+    schema.push_back(cell.first);
+  }
+
+  auto it = ids_.find(schema);
+  if (it == ids_.end()) {
+    added = true;
+    while (schemas_.count(next_id_) > 0) {
+      next_id_++;
+    }
+    it = ids_.emplace(schema, next_id_).first;
+    schemas_[next_id_] = std::move(schema);
+    next_id_++;
+  }
+
+  last_id_ = it->second;
+  last_schema_ = &schemas_.at(last_id_);
+  return last_id_;
+}
+
+const ColumnNames* RowSchemaCatalog::getSchema(RowSchemaID id) const {
+  auto it = schemas_.find(id);
+  return (it == schemas_.end()) ? nullptr : &it->second;
+}
+
+void RowSchemaCatalog::addSchema(RowSchemaID id, ColumnNames schema) {
+  ids_[schema] = id;
+  schemas_[id] = std::move(schema);
+  if (id >= next_id_) {
+    next_id_ = id + 1;
+  }
+}
+
+void RowSchemaCatalog::clear() {
+  ids_.clear();
+  schemas_.clear();
+  last_id_ = 0;
+  last_schema_ = nullptr;
+  next_id_ = 1;
+}
+
+bool isBinaryRow(const std::string& encoded) {
+  return !encoded.empty() && encoded[0] == kBinaryRowMarker;
+}
+
+Status serializeRowBinary(const Row& r,
+                          RowSchemaID id,
+                          const ColumnNames& schema,
+                          std::string& encoded) {
+  encoded.clear();
+  encoded.push_back(kBinaryRowMarker);
+  writeVarint(encoded, id);
+
+  // Both the Row and the schema are ordered by column name.
+  size_t matched = 0;
+  auto cell = r.begin();
+  for (const auto& column : schema) {
+    if (cell != r.end() && cell->first == column) {
+      // A zero length marks an absent column, present values are offset by 1.
+      writeVarint(encoded, cell->second.size() + 1);
+      encoded.append(cell->second);
+      ++cell;
+      matched++;
+    } else {
+      writeVarint(encoded, 0);
+    }
+  }
+
+  if (matched != r.size()) {
+    return Status::failure("Row contains columns outside of its schema");
+  }
+  return Status::success();
+}
+
+Status getRowBinarySchema(const std::string& encoded, RowSchemaID& id) {
+  if (!isBinaryRow(encoded)) {
+    return Status::failure("Not a binary encoded row");
+  }
+
+  size_t offset = 1;
+  uint64_t value = 0;
+  if (!readVarint(encoded, offset, value)) {
+    return Status::failure("Truncated binary row schema");
+  }
+  id = static_cast<RowSchemaID>(value);
+  return Status::success();
+}
+
+Status deserializeRowBinary(const std::string& encoded,
+                            const ColumnNames& schema,
+                            Row& r) {
+  if (!isBinaryRow(encoded)) {
+    return Status::failure("Not a binary encoded row");
+  }
+
+  size_t offset = 1;
+  uint64_t value = 0;
+  if (!readVarint(encoded, offset, value)) {
+    return Status::failure("Truncated binary row schema");
+  }
+
+  for (const auto& column : schema) {
+    if (!readVarint(encoded, offset, value)) {
+      return Status::failure("Truncated binary row value length");
+    }
+
+    if (value == 0) {
+      continue;
+    }
+
+    auto length = static_cast<size_t>(value - 1);
+    if (encoded.size() - offset < length) {
+      return Status::failure("Truncated binary row value");
+    }
+    r.emplace_hint(r.end(), column, encoded.substr(offset, length));
+    offset += length;
+  }
+
+  if (offset != encoded.size()) {
+    return Status::failure("Binary row does not match its schema");
+  }
+  return Status::success();
+}
+
+std::string serializeRowSchema(const ColumnNames& schema) {
+  std::string stored;
+  for (const auto& column : schema) {
+    if (!stored.empty()) {
+      stored.push_back(kSchemaDelimiter);
+    }
+    stored.append(column);
+  }
+  return stored;
+}
+
+ColumnNames deserializeRowSchema(const std::string& stored) {
+  ColumnNames schema;
+  if (stored.empty()) {
+    return schema;
+  }
+
+  size_t start = 0;
+  while (true) {
+    auto end = stored.find(kSchemaDelimiter, start);
+    schema.push_back(stored.substr(start, end - start));
+    if (end == std::string::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+  return schema;
+}
+
+} // namespace osquery
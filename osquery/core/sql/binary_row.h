@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <osquery/core/sql/row.h>
+
+namespace osquery {
+
+/// An identifier for a set of column names, unique within a catalog.
+using RowSchemaID = std::uint32_t;
+
+/**
+ * @brief The leading byte of a binary encoded Row.
+ *
+ * JSON encoded rows always begin with '{', so stored values in either format
+ * can be told apart by their first byte.
+ */
+extern const char kBinaryRowMarker;
+
+/**
+ * @brief A catalog of the column name sets (schemas) used by binary rows.
+ *
+ * A binary row only stores its schema identifier and the column values, the
+ * column names are held once per schema by the catalog. The catalog is not
+ * thread safe; owners are expected to provide locking.
+ */
+class RowSchemaCatalog {
+ public:
+  /**
+   * @brief Lookup, or assign, the schema identifier for a row's columns.
+   *
+   * @param r the row whose key set is the schema.
+   * @param added [output] true if a new schema was assigned and must be
+   * persisted by the caller.
+   *
+   * @return the schema identifier.
+   */
+  RowSchemaID getID(const Row& r, bool& added);
+
+  /// Access a schema by identifier, nullptr if it is unknown.
+  const ColumnNames* getSchema(RowSchemaID id) const;
+
+  /// Restore a persisted schema.
+  void addSchema(RowSchemaID id, ColumnNames schema);
+
+  /// The number of known schemas.
+  size_t size() const {
+    return schemas_.size();
+  }
+
+  /// Remove all schemas.
+  void clear();
+
+ private:
+  /// The schema identifiers by column name set.
+  std::map<ColumnNames, RowSchemaID> ids_;
+
+  /// The column name sets by schema identifier.
+  std::map<RowSchemaID, ColumnNames> schemas_;
+
+  /// The most recently assigned or matched schema, rows rarely change shape.
+  RowSchemaID last_id_{0};
+  const ColumnNames* last_schema_{nullptr};
+
+  /// The next identifier to assign.
+  RowSchemaID next_id_{1};
+};
+
+/// Check if a stored value is a binary encoded Row.
+bool isBinaryRow(const std::string& encoded);
+
+/**
+ * @brief Encode a Row as its schema identifier and length-prefixed values.
+ *
+ * @param r the Row to serialize, its columns must be a subset of schema.
+ * @param id the schema identifier.
+ * @param schema the ordered schema column names.
+ * @param encoded [output] the binary encoding.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeRowBinary(const Row& r,
+                          RowSchemaID id,
+                          const ColumnNames& schema,
+                          std::string& encoded);
+
+/**
+ * @brief Read the schema identifier of a binary encoded Row.
+ *
+ * @param encoded the binary encoding.
+ * @param id [output] the schema identifier.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status getRowBinarySchema(const std::string& encoded, RowSchemaID& id);
+
+/**
+ * @brief Decode a binary encoded Row.
+ *
+ * @param encoded the binary encoding.
+ * @param schema the schema named by the encoding's identifier.
+ * @param r [output] the output Row structure.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status deserializeRowBinary(const std::string& encoded,
+                            const ColumnNames& schema,
+                            Row& r);
+
+/// Serialize a schema for storage.
+std::string serializeRowSchema(const ColumnNames& schema);
+
+/// Inverse of serializeRowSchema.
+ColumnNames deserializeRowSchema(const std::string& stored);
+
+} // namespace osquery
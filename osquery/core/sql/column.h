@@ -72,6 +72,14 @@ enum class ColumnOptions {
 
   /// This column should be hidden from '*'' selects.
   HIDDEN = 16,
+
+  /*
+   * @brief The table can generate rows ordered by this column.
+   *
+   * If a query orders by this column alone, SQLite skips its own sort and the
+   * table must emit rows in the requested direction, see QueryContext::orderBy.
+   */
+  SORTABLE = 32,
 };
 
 /// Treat column options as a set of flags.
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <unordered_map>
+
 #include "diff_results.h"
 
 namespace rj = rapidjson;
@@ -37,17 +39,25 @@ Status serializeDiffResults(const DiffResults& d,
   return Status::success();
 }
 
+void writeDiffResults(const DiffResults& d,
+                      rj::Writer<rj::StringBuffer>& writer,
+                      bool asNumeric) {
+  writer.StartObject();
+  writer.Key("removed");
+  writeQueryData(d.removed, writer, asNumeric);
+  writer.Key("added");
+  writeQueryData(d.added, writer, asNumeric);
+  writer.EndObject();
+}
+
 Status serializeDiffResultsJSON(const DiffResults& d,
                                 std::string& json,
                                 bool asNumeric) {
-  auto doc = JSON::newObject();
-
-  ColumnNames cols;
-  auto status = serializeDiffResults(d, doc, doc.doc(), asNumeric);
-  if (!status.ok()) {
-    return status;
-  }
-  return doc.toString(json);
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  writeDiffResults(d, writer, asNumeric);
+  json.assign(sb.GetString(), sb.GetSize());
+  return Status::success();
 }
 
 DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
@@ -69,4 +79,39 @@ DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
   return r;
 }
 
+DiffResults diff(const QueryBatch& old, const QueryBatch& current) {
+  DiffResults r;
+
+  std::unordered_multimap<size_t, size_t> old_rows;
+  old_rows.reserve(old.size());
+  for (size_t i = 0; i < old.size(); i++) {
+    old_rows.emplace(old.rowHash(i), i);
+  }
+
+  std::vector<bool> matched(old.size(), false);
+  for (size_t i = 0; i < current.size(); i++) {
+    bool found = false;
+    auto range = old_rows.equal_range(current.rowHash(i));
+    for (auto it = range.first; it != range.second; ++it) {
+      if (!matched[it->second] && current.rowEquals(i, old, it->second)) {
+        matched[it->second] = true;
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      r.added.push_back(current.row(i));
+    }
+  }
+
+  for (size_t i = 0; i < old.size(); i++) {
+    if (!matched[i]) {
+      r.removed.push_back(old.row(i));
+    }
+  }
+
+  return r;
+}
+
 } // namespace osquery
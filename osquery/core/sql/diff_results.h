@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <osquery/core/sql/query_batch.h>
 #include <osquery/core/sql/query_data.h>
 
 namespace osquery {
@@ -70,6 +71,17 @@ Status serializeDiffResults(const DiffResults& d,
                             rapidjson::Document& obj,
                             bool asNumeric);
 
+/**
+ * @brief Write a DiffResults as a JSON object, without building a document.
+ *
+ * @param d the DiffResults to write, "removed" is written first.
+ * @param writer [output] the writer receiving the object.
+ * @param asNumeric true iff numeric values are serialized as such
+ */
+void writeDiffResults(const DiffResults& d,
+                      rapidjson::Writer<rapidjson::StringBuffer>& writer,
+                      bool asNumeric);
+
 /**
  * @brief Serialize a DiffResults object into a JSON string.
  *
@@ -96,4 +108,18 @@ Status serializeDiffResultsJSON(const DiffResults& d,
  */
 DiffResults diff(QueryDataSet& old_, QueryDataTyped& new_);
 
+/**
+ * @brief Diff two columnar QueryBatch objects and create a DiffResults object
+ *
+ * Rows are matched by content hash and then compared cell-by-cell, so the
+ * cost is linear in the number of rows rather than requiring an ordered set.
+ * Duplicate rows are matched one-to-one, as with the QueryDataSet variant.
+ *
+ * @param old_ the "old" set of results.
+ * @param new_ the "new" set of results.
+ *
+ * @return a DiffResults object which indicates the change from old_ to new_
+ */
+DiffResults diff(const QueryBatch& old_, const QueryBatch& new_);
+
 } // namespace osquery
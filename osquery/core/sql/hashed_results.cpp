@@ -0,0 +1,350 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "hashed_results.h"
+
+namespace osquery {
+
+const std::string kHashedResultsMagic{"\0HR2", 4};
+
+namespace {
+
+/// Records of the first format interleave digests with rows, in row order.
+const std::string kHashedResultsMagicV1{"\0HR1", 4};
+
+/// Size of a version 1 entry header: two 64-bit digest words and a length.
+const size_t kHashedEntryHeader = 20;
+
+/// Size of a row count, row length or row offset.
+const size_t kHashedWord = 4;
+
+/// Size of an index entry: two 64-bit digest words and a row offset.
+const size_t kHashedIndexEntry = 20;
+
+/// A single row entry within a stored hashed record.
+struct HashedEntry {
+  RowDigest digest;
+  size_t offset;
+  size_t length;
+};
+
+uint64_t readUint(const std::string& in, size_t offset, size_t width) {
+  uint64_t v = 0;
+  for (size_t i = width; i > 0; i--) {
+    v = (v << 8) | static_cast<unsigned char>(in[offset + i - 1]);
+  }
+  return v;
+}
+
+void writeUint(std::string& out, uint64_t v, size_t width) {
+  for (size_t i = 0; i < width; i++) {
+    out.push_back(static_cast<char>((v >> (i * 8)) & 0xff));
+  }
+}
+
+void replaceUint(std::string& out, size_t offset, uint64_t v, size_t width) {
+  for (size_t i = 0; i < width; i++) {
+    out[offset + i] = static_cast<char>((v >> (i * 8)) & 0xff);
+  }
+}
+
+bool hasMagic(const std::string& stored, const std::string& magic) {
+  return stored.compare(0, magic.size(), magic) == 0;
+}
+
+Status parseEntriesV1(const std::string& stored,
+                      std::vector<HashedEntry>& entries) {
+  size_t offset = kHashedResultsMagicV1.size();
+  while (offset < stored.size()) {
+    if (stored.size() - offset < kHashedEntryHeader) {
+      return Status::failure("Truncated hashed record entry");
+    }
+
+    HashedEntry entry;
+    entry.digest = {readUint(stored, offset, 8),
+                    readUint(stored, offset + 8, 8)};
+    entry.length = readUint(stored, offset + 16, 4);
+    entry.offset = offset + kHashedEntryHeader;
+    if (stored.size() - entry.offset < entry.length) {
+      return Status::failure("Truncated hashed record row");
+    }
+
+    offset = entry.offset + entry.length;
+    entries.push_back(entry);
+  }
+  return Status::success();
+}
+
+/**
+ * @brief The digest-ordered entries of a stored record.
+ *
+ * Current records begin with an index sorted by digest, which is read in
+ * place. Version 1 records are parsed and sorted once when opened.
+ */
+class HashedIndex {
+ public:
+  explicit HashedIndex(const std::string& stored) : stored_(stored) {}
+
+  Status open() {
+    if (hasMagic(stored_, kHashedResultsMagicV1)) {
+      auto status = parseEntriesV1(stored_, entries_);
+      std::stable_sort(entries_.begin(),
+                       entries_.end(),
+                       [](const HashedEntry& l, const HashedEntry& r) {
+                         return l.digest < r.digest;
+                       });
+      count_ = entries_.size();
+      return status;
+    }
+
+    if (!hasMagic(stored_, kHashedResultsMagic)) {
+      return Status::failure("Stored results are not a hashed record");
+    }
+
+    auto header = kHashedResultsMagic.size() + kHashedWord;
+    if (stored_.size() < header) {
+      return Status::failure("Truncated hashed record index");
+    }
+
+    count_ = readUint(stored_, kHashedResultsMagic.size(), kHashedWord);
+    if ((stored_.size() - header) / kHashedIndexEntry < count_) {
+      return Status::failure("Truncated hashed record index");
+    }
+    rows_ = header + count_ * kHashedIndexEntry;
+    return Status::success();
+  }
+
+  size_t size() const {
+    return count_;
+  }
+
+  /// The offset of the first row, rows follow the index in result order.
+  size_t rows() const {
+    return rows_;
+  }
+
+  Status at(size_t i, HashedEntry& entry) const {
+    if (!entries_.empty()) {
+      entry = entries_[i];
+      return Status::success();
+    }
+
+    auto offset = kHashedResultsMagic.size() + kHashedWord +
+                  i * kHashedIndexEntry;
+    entry.digest = {readUint(stored_, offset, 8),
+                    readUint(stored_, offset + 8, 8)};
+    return readRow(stored_, readUint(stored_, offset + 16, kHashedWord), entry);
+  }
+
+  /// Read the length-prefixed row at an offset.
+  static Status readRow(const std::string& stored,
+                        size_t offset,
+                        HashedEntry& entry) {
+    if (offset > stored.size() || stored.size() - offset < kHashedWord) {
+      return Status::failure("Truncated hashed record entry");
+    }
+
+    entry.length = readUint(stored, offset, kHashedWord);
+    entry.offset = offset + kHashedWord;
+    if (stored.size() - entry.offset < entry.length) {
+      return Status::failure("Truncated hashed record row");
+    }
+    return Status::success();
+  }
+
+ private:
+  const std::string& stored_;
+  std::vector<HashedEntry> entries_;
+  size_t count_{0};
+  size_t rows_{0};
+};
+
+/// A row of the current results and its digest, ordered by digest.
+using DigestOrder = std::vector<std::pair<RowDigest, size_t>>;
+
+DigestOrder sortedDigests(const QueryBatch& b) {
+  DigestOrder order;
+  order.reserve(b.size());
+  for (size_t i = 0; i < b.size(); i++) {
+    order.emplace_back(b.rowDigest(i), i);
+  }
+  std::sort(order.begin(), order.end());
+  return order;
+}
+
+/**
+ * @brief Encode rows, in result order, behind an index sorted by digest.
+ *
+ * Rows found in the previous record are copied from their matched entry,
+ * others are serialized.
+ */
+Status writeRecord(const QueryBatch& b,
+                   const DigestOrder& order,
+                   const std::string& previous,
+                   const std::vector<HashedEntry>& matches,
+                   const std::vector<bool>& found,
+                   std::string& out) {
+  out = kHashedResultsMagic;
+  out.reserve(previous.size());
+  writeUint(out, b.size(), kHashedWord);
+  out.resize(out.size() + b.size() * kHashedIndexEntry);
+
+  std::vector<size_t> offsets(b.size());
+  std::string json;
+  for (size_t i = 0; i < b.size(); i++) {
+    offsets[i] = out.size();
+    if (found[i]) {
+      const auto& entry = matches[i];
+      writeUint(out, entry.length, kHashedWord);
+      out.append(previous, entry.offset, entry.length);
+      continue;
+    }
+
+    json.clear();
+    auto status = serializeQueryBatchRowJSON(b, i, json, true);
+    if (!status.ok()) {
+      return status;
+    }
+    writeUint(out, json.size(), kHashedWord);
+    out.append(json);
+  }
+
+  auto offset = kHashedResultsMagic.size() + kHashedWord;
+  for (const auto& row : order) {
+    replaceUint(out, offset, row.first[0], 8);
+    replaceUint(out, offset + 8, row.first[1], 8);
+    replaceUint(out, offset + 16, offsets[row.second], kHashedWord);
+    offset += kHashedIndexEntry;
+  }
+  return Status::success();
+}
+
+Status deserializeEntry(const std::string& stored,
+                        const HashedEntry& entry,
+                        RowTyped& r) {
+  return deserializeRowJSON(stored.substr(entry.offset, entry.length), r);
+}
+
+} // namespace
+
+bool isHashedResults(const std::string& stored) {
+  return hasMagic(stored, kHashedResultsMagic) ||
+         hasMagic(stored, kHashedResultsMagicV1);
+}
+
+Status serializeHashedResults(const QueryBatch& b, std::string& stored) {
+  std::vector<bool> found(b.size(), false);
+  return writeRecord(b, sortedDigests(b), std::string(), {}, found, stored);
+}
+
+Status deserializeHashedResults(const std::string& stored, QueryBatch& b) {
+  std::vector<HashedEntry> entries;
+  if (hasMagic(stored, kHashedResultsMagicV1)) {
+    auto status = parseEntriesV1(stored, entries);
+    if (!status.ok()) {
+      return status;
+    }
+  } else {
+    HashedIndex index(stored);
+    auto status = index.open();
+    if (!status.ok()) {
+      return status;
+    }
+
+    // Rows are walked in result order, their count must match the index.
+    HashedEntry entry;
+    for (auto offset = index.rows(); offset < stored.size();
+         offset = entry.offset + entry.length) {
+      status = HashedIndex::readRow(stored, offset, entry);
+      if (!status.ok()) {
+        return status;
+      }
+      entries.push_back(entry);
+    }
+    if (entries.size() != index.size()) {
+      return Status::failure("Hashed record rows do not match the index");
+    }
+  }
+
+  b.reserve(b.size() + entries.size());
+  for (const auto& entry : entries) {
+    RowTyped r;
+    auto status = deserializeEntry(stored, entry, r);
+    if (!status.ok()) {
+      return status;
+    }
+    b.appendRow(r);
+  }
+  return Status::success();
+}
+
+Status diffHashedResults(const std::string& previous,
+                         const QueryBatch& current,
+                         DiffResults& dr,
+                         std::string& next) {
+  HashedIndex index(previous);
+  auto status = index.open();
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Both sides are ordered by digest, rows are matched by a merge.
+  auto order = sortedDigests(current);
+  std::vector<HashedEntry> matches(current.size());
+  std::vector<bool> found(current.size(), false);
+  std::vector<size_t> removed;
+
+  size_t p = 0;
+  size_t c = 0;
+  HashedEntry entry;
+  while (p < index.size()) {
+    status = index.at(p, entry);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (c < order.size() && order[c].first < entry.digest) {
+      c++;
+    } else if (c < order.size() && order[c].first == entry.digest) {
+      matches[order[c].second] = entry;
+      found[order[c].second] = true;
+      c++;
+      p++;
+    } else {
+      removed.push_back(p++);
+    }
+  }
+
+  for (size_t i = 0; i < current.size(); i++) {
+    if (!found[i]) {
+      dr.added.push_back(current.row(i));
+    }
+  }
+
+  for (auto i : removed) {
+    index.at(i, entry);
+    RowTyped r;
+    status = deserializeEntry(previous, entry, r);
+    if (!status.ok()) {
+      return status;
+    }
+    dr.removed.push_back(std::move(r));
+  }
+
+  if (dr.hasNoResults()) {
+    return Status::success();
+  }
+  return writeRecord(current, order, previous, matches, found, next);
+}
+
+} // namespace osquery
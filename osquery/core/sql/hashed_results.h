@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osquery/core/sql/diff_results.h>
+#include <osquery/core/sql/query_batch.h>
+
+namespace osquery {
+
+/**
+ * @brief Leading bytes that identify a hashed differential result record.
+ *
+ * Legacy stored results are JSON arrays and always begin with '['. Records
+ * written before the digest index was added are still read and diffed.
+ */
+extern const std::string kHashedResultsMagic;
+
+/**
+ * @brief Check if a stored result value uses the hashed record format.
+ */
+bool isHashedResults(const std::string& stored);
+
+/**
+ * @brief Encode a QueryBatch as a hashed differential result record.
+ *
+ * The record begins with a fixed-width index of every row's 128-bit
+ * RowDigest and offset, sorted by digest, followed by the length-prefixed JSON
+ * serialization of each row in result order. Later differentials merge the
+ * index with the current digests in place; row JSON is parsed solely for
+ * removed rows.
+ *
+ * @param b the current results.
+ * @param stored [output] the encoded record.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeHashedResults(const QueryBatch& b, std::string& stored);
+
+/**
+ * @brief Decode every row of a hashed differential result record.
+ *
+ * @param stored an encoded record.
+ * @param b [output] the decoded results.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status deserializeHashedResults(const std::string& stored, QueryBatch& b);
+
+/**
+ * @brief Compute a differential against a hashed result record.
+ *
+ * Rows are matched by RowDigest only, by merging the stored index with the
+ * sorted current digests, so the previous record is not copied or indexed.
+ * Rows that are still present are copied into the next record byte-for-byte,
+ * added rows are serialized once, and only removed rows are deserialized.
+ *
+ * @param previous the stored record from the last execution.
+ * @param current the current results.
+ * @param dr [output] the differential results.
+ * @param next [output] the record to store, untouched if nothing changed.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status diffHashedResults(const std::string& previous,
+                         const QueryBatch& current,
+                         DiffResults& dr,
+                         std::string& next);
+
+} // namespace osquery
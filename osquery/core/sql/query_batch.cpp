@@ -0,0 +1,572 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include <boost/functional/hash.hpp>
+
+#include "query_batch.h"
+
+#include <osquery/utils/conversions/castvariant.h>
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+namespace {
+
+inline uint64_t rotl64(uint64_t x, int8_t r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+inline uint64_t readBlock(const unsigned char* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+/// MurmurHash3_x64_128, endian-independent variant with a zero seed.
+RowDigest murmur3(const std::string& data) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+  const size_t len = data.size();
+  const size_t nblocks = len / 16;
+
+  uint64_t h1 = 0;
+  uint64_t h2 = 0;
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+  for (size_t i = 0; i < nblocks; i++) {
+    uint64_t k1 = readBlock(bytes + i * 16);
+    uint64_t k2 = readBlock(bytes + i * 16 + 8);
+
+    k1 *= c1;
+    k1 = rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+    h1 = rotl64(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    h2 = rotl64(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const auto* tail = bytes + nblocks * 16;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  size_t rem = len & 15;
+  for (size_t i = rem; i > 8; i--) {
+    k2 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+  }
+  if (rem > 8) {
+    k2 *= c2;
+    k2 = rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+  }
+  for (size_t i = std::min<size_t>(rem, 8); i > 0; i--) {
+    k1 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+  }
+  if (rem > 0) {
+    k1 *= c1;
+    k1 = rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= len;
+  h2 ^= len;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+  return {h1, h2};
+}
+
+inline void appendUint64(std::string& out, uint64_t v) {
+  for (int i = 0; i < 8; i++) {
+    out.push_back(static_cast<char>((v >> (i * 8)) & 0xff));
+  }
+}
+
+/// Canonical, length-prefixed encoding of a cell used for digests.
+class DigestEncoder : public boost::static_visitor<> {
+ public:
+  explicit DigestEncoder(std::string& out) : out_(out) {}
+
+  void operator()(const long long& i) const {
+    out_.push_back('i');
+    appendUint64(out_, static_cast<uint64_t>(i));
+  }
+
+  void operator()(const double& d) const {
+    uint64_t bits = 0;
+    static_assert(sizeof(bits) == sizeof(d), "double must be 64 bits");
+    std::memcpy(&bits, &d, sizeof(bits));
+    out_.push_back('d');
+    appendUint64(out_, bits);
+  }
+
+  void operator()(const std::string& str) const {
+    out_.push_back('s');
+    appendUint64(out_, str.size());
+    out_.append(str);
+  }
+
+ private:
+  std::string& out_;
+};
+
+} // namespace
+
+QueryBatch::QueryBatch(const ColumnNames& columns) {
+  for (const auto& column : columns) {
+    addColumn(column);
+  }
+}
+
+QueryBatch QueryBatch::fromRows(const QueryDataTyped& rows) {
+  QueryBatch batch;
+  if (!rows.empty()) {
+    // Rows from a single statement share columns, seed the dictionary once.
+    for (const auto& column : rows.front()) {
+      batch.addColumn(column.first);
+    }
+  }
+
+  batch.reserve(rows.size());
+  for (const auto& row : rows) {
+    batch.appendRow(row);
+  }
+  return batch;
+}
+
+size_t QueryBatch::addColumn(const std::string& name) {
+  auto it = column_index_.find(name);
+  if (it != column_index_.end()) {
+    return it->second;
+  }
+
+  auto index = columns_.size();
+  columns_.push_back(name);
+  column_index_[name] = index;
+  column_hashes_.push_back(boost::hash<std::string>()(name));
+
+  // Existing rows do not have a value for a column added later.
+  values_.emplace_back(rows_);
+  values_.back().reserve(values_.front().capacity());
+  sorted_columns_.clear();
+  return index;
+}
+
+size_t QueryBatch::columnIndex(const std::string& name) const {
+  auto it = column_index_.find(name);
+  return (it == column_index_.end()) ? columns_.size() : it->second;
+}
+
+void QueryBatch::reserve(size_t rows) {
+  for (auto& column : values_) {
+    column.reserve(rows);
+  }
+}
+
+QueryBatch::Cell QueryBatch::makeCell(const RowDataTyped& value) {
+  Cell cell;
+  if (const auto* str = boost::get<std::string>(&value)) {
+    cell.type = Cell::Type::Text;
+    cell.text = strings_.intern(*str);
+  } else if (const auto* integer = boost::get<long long>(&value)) {
+    cell.type = Cell::Type::Integer;
+    cell.integer = *integer;
+  } else {
+    cell.type = Cell::Type::Real;
+    cell.real = boost::get<double>(value);
+  }
+  return cell;
+}
+
+RowDataTyped QueryBatch::value(const Cell& cell) const {
+  switch (cell.type) {
+  case Cell::Type::Integer:
+    return cell.integer;
+  case Cell::Type::Real:
+    return cell.real;
+  default:
+    return strings_.get(cell.text);
+  }
+}
+
+bool QueryBatch::cellEquals(const Cell& cell,
+                            const QueryBatch& other,
+                            const Cell& other_cell) const {
+  if (cell.type != other_cell.type) {
+    return false;
+  }
+
+  switch (cell.type) {
+  case Cell::Type::Integer:
+    return cell.integer == other_cell.integer;
+  case Cell::Type::Real:
+    return cell.real == other_cell.real;
+  default:
+    // Ids only compare within a dictionary, hashes reject most mismatches.
+    if (&other == this) {
+      return cell.text == other_cell.text;
+    }
+    return strings_.hash(cell.text) == other.strings_.hash(other_cell.text) &&
+           strings_.get(cell.text) == other.strings_.get(other_cell.text);
+  }
+}
+
+void QueryBatch::appendRow(const RowTyped& row) {
+  for (const auto& cell : row) {
+    addColumn(cell.first);
+  }
+
+  for (size_t i = 0; i < columns_.size(); i++) {
+    auto it = row.find(columns_[i]);
+    if (it != row.end()) {
+      values_[i].push_back(makeCell(it->second));
+    } else {
+      values_[i].emplace_back();
+    }
+  }
+  rows_++;
+}
+
+void QueryBatch::appendRow(std::vector<RowDataTyped> cells) {
+  for (size_t i = 0; i < columns_.size(); i++) {
+    if (i < cells.size()) {
+      values_[i].push_back(makeCell(cells[i]));
+    } else {
+      values_[i].emplace_back();
+    }
+  }
+  rows_++;
+}
+
+bool QueryBatch::has(size_t row, size_t column) const {
+  return column < columns_.size() && row < rows_ &&
+         values_[column][row].type != Cell::Type::Missing;
+}
+
+boost::optional<RowDataTyped> QueryBatch::cell(size_t row,
+                                               size_t column) const {
+  if (!has(row, column)) {
+    return boost::none;
+  }
+  return value(values_[column][row]);
+}
+
+const std::string* QueryBatch::text(size_t row, size_t column) const {
+  if (!has(row, column) || values_[column][row].type != Cell::Type::Text) {
+    return nullptr;
+  }
+  return &strings_.get(values_[column][row].text);
+}
+
+void QueryBatch::transformStrings(
+    const std::function<void(std::string&)>& transform) {
+  // Distinct strings may become equal, re-intern them into a new dictionary.
+  StringDictionary strings;
+  std::vector<uint32_t> ids(strings_.size());
+  for (uint32_t id = 0; id < strings_.size(); id++) {
+    auto str = strings_.get(id);
+    transform(str);
+    ids[id] = strings.intern(str);
+  }
+
+  for (auto& column : values_) {
+    for (auto& cell : column) {
+      if (cell.type == Cell::Type::Text) {
+        cell.text = ids[cell.text];
+      }
+    }
+  }
+  strings_ = std::move(strings);
+}
+
+RowTyped QueryBatch::row(size_t index) const {
+  RowTyped r;
+  for (size_t i = 0; i < columns_.size(); i++) {
+    const auto& cell = values_[i][index];
+    if (cell.type != Cell::Type::Missing) {
+      r[columns_[i]] = value(cell);
+    }
+  }
+  return r;
+}
+
+QueryDataTyped QueryBatch::toRows() const {
+  QueryDataTyped rows;
+  rows.reserve(rows_);
+  for (size_t i = 0; i < rows_; i++) {
+    rows.push_back(row(i));
+  }
+  return rows;
+}
+
+const std::vector<size_t>& QueryBatch::columnsByName() const {
+  if (sorted_columns_.size() != columns_.size()) {
+    sorted_columns_.resize(columns_.size());
+    std::iota(sorted_columns_.begin(), sorted_columns_.end(), 0);
+    std::sort(sorted_columns_.begin(),
+              sorted_columns_.end(),
+              [this](size_t a, size_t b) { return columns_[a] < columns_[b]; });
+  }
+  return sorted_columns_;
+}
+
+size_t QueryBatch::rowHash(size_t row) const {
+  // Names and strings are hashed once, rows combine the cached hashes.
+  size_t seed = 0;
+  for (auto i : columnsByName()) {
+    const auto& cell = values_[i][row];
+    if (cell.type == Cell::Type::Missing) {
+      continue;
+    }
+
+    boost::hash_combine(seed, column_hashes_[i]);
+    boost::hash_combine(seed, static_cast<int>(cell.type));
+    switch (cell.type) {
+    case Cell::Type::Integer:
+      boost::hash_combine(seed, cell.integer);
+      break;
+    case Cell::Type::Real:
+      boost::hash_combine(seed, cell.real);
+      break;
+    default:
+      boost::hash_combine(seed, strings_.hash(cell.text));
+    }
+  }
+  return seed;
+}
+
+RowDigest QueryBatch::rowDigest(size_t row) const {
+  std::string encoded;
+  DigestEncoder encoder(encoded);
+  for (auto i : columnsByName()) {
+    const auto& cell = values_[i][row];
+    if (cell.type == Cell::Type::Missing) {
+      continue;
+    }
+
+    appendUint64(encoded, columns_[i].size());
+    encoded.append(columns_[i]);
+    switch (cell.type) {
+    case Cell::Type::Integer:
+      encoder(cell.integer);
+      break;
+    case Cell::Type::Real:
+      encoder(cell.real);
+      break;
+    default:
+      encoder(strings_.get(cell.text));
+    }
+  }
+  return murmur3(encoded);
+}
+
+bool QueryBatch::rowEquals(size_t row,
+                           const QueryBatch& other,
+                           size_t other_row) const {
+  size_t cells = 0;
+  for (size_t i = 0; i < columns_.size(); i++) {
+    const auto& cell = values_[i][row];
+    if (cell.type == Cell::Type::Missing) {
+      continue;
+    }
+
+    auto other_column = other.columnIndex(columns_[i]);
+    if (!other.has(other_row, other_column) ||
+        !cellEquals(cell, other, other.values_[other_column][other_row])) {
+      return false;
+    }
+    cells++;
+  }
+
+  // The other row may have cells for columns this row does not.
+  size_t other_cells = 0;
+  for (size_t i = 0; i < other.columns_.size(); i++) {
+    if (other.values_[i][other_row].type != Cell::Type::Missing) {
+      other_cells++;
+    }
+  }
+  return cells == other_cells;
+}
+
+void QueryBatch::clear() {
+  columns_.clear();
+  column_index_.clear();
+  column_hashes_.clear();
+  values_.clear();
+  strings_.clear();
+  sorted_columns_.clear();
+  rows_ = 0;
+}
+
+bool QueryBatch::operator==(const QueryBatch& comp) const {
+  if (rows_ != comp.rows_) {
+    return false;
+  }
+
+  for (size_t i = 0; i < rows_; i++) {
+    if (!rowEquals(i, comp, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void serializeBatchRow(const QueryBatch& b,
+                              size_t r,
+                              JSON& doc,
+                              rj::Value& row_obj,
+                              bool asNumeric) {
+  // Emit members in column name order to match a serialized RowTyped.
+  for (auto c : b.columnsByName()) {
+    const auto& name = b.columns()[c];
+    if (const auto* str = b.text(r, c)) {
+      doc.addRef(name, *str, row_obj);
+      continue;
+    }
+
+    auto value = b.cell(r, c);
+    if (!value) {
+      continue;
+    }
+
+    if (asNumeric) {
+      boost::apply_visitor(
+          [&doc, &row_obj, &name](auto v) { doc.add(name, v, row_obj); },
+          *value);
+    } else {
+      doc.addCopy(name, castVariant(*value), row_obj);
+    }
+  }
+}
+
+Status serializeQueryBatch(const QueryBatch& b,
+                           JSON& doc,
+                           rj::Document& arr,
+                           bool asNumeric) {
+  for (size_t r = 0; r < b.size(); r++) {
+    auto row_obj = doc.getObject();
+    serializeBatchRow(b, r, doc, row_obj, asNumeric);
+    doc.push(row_obj, arr);
+  }
+  return Status::success();
+}
+
+Status serializeQueryBatchRowJSON(const QueryBatch& b,
+                                  size_t row,
+                                  std::string& json,
+                                  bool asNumeric) {
+  auto doc = JSON::newObject();
+  serializeBatchRow(b, row, doc, doc.doc(), asNumeric);
+  return doc.toString(json);
+}
+
+Status serializeQueryBatchJSON(const QueryBatch& b,
+                               std::string& json,
+                               bool asNumeric) {
+  auto doc = JSON::newArray();
+
+  auto status = serializeQueryBatch(b, doc, doc.doc(), asNumeric);
+  if (!status.ok()) {
+    return status;
+  }
+  return doc.toString(json);
+}
+
+Status deserializeQueryBatch(const rj::Value& arr, QueryBatch& b) {
+  if (!arr.IsArray()) {
+    return Status(1, "JSON object was not an array");
+  }
+
+  b.reserve(b.size() + arr.Size());
+  for (const auto& i : arr.GetArray()) {
+    if (!i.IsObject()) {
+      return Status(1);
+    }
+
+    std::vector<RowDataTyped> cells(b.columns().size());
+    std::vector<bool> present(b.columns().size(), false);
+    for (const auto& member : i.GetObject()) {
+      std::string name(member.name.GetString());
+      if (name.empty()) {
+        continue;
+      }
+
+      auto index = b.addColumn(name);
+      if (index >= cells.size()) {
+        cells.resize(index + 1);
+        present.resize(index + 1, false);
+      }
+
+      if (member.value.IsString()) {
+        cells[index] = std::string(member.value.GetString());
+      } else if (member.value.IsDouble()) {
+        cells[index] = member.value.GetDouble();
+      } else if (member.value.IsInt64()) {
+        // Cast required for linux-x86_64
+        cells[index] = (long long)member.value.GetInt64();
+      } else {
+        continue;
+      }
+      present[index] = true;
+    }
+
+    if (std::all_of(present.begin(), present.end(), [](bool p) { return p; })) {
+      b.appendRow(std::move(cells));
+    } else {
+      // Sparse rows are rare, fall back to the map-based append.
+      RowTyped r;
+      for (size_t c = 0; c < present.size(); c++) {
+        if (present[c]) {
+          r[b.columns()[c]] = std::move(cells[c]);
+        }
+      }
+      b.appendRow(r);
+    }
+  }
+  return Status::success();
+}
+
+Status deserializeQueryBatchJSON(std::string json, QueryBatch& b) {
+  // Values are copied into the batch, the document is only read.
+  rj::Document doc;
+  if (doc.ParseInsitu(&json[0]).HasParseError()) {
+    return Status(1, "Error serializing JSON");
+  }
+  return deserializeQueryBatch(doc, b);
+}
+
+} // namespace osquery
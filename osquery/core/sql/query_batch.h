@@ -0,0 +1,263 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/core/sql/string_dictionary.h>
+
+namespace osquery {
+
+/**
+ * @brief A 128-bit content digest of a single row.
+ *
+ * Digests are persisted alongside stored differential results, so the input
+ * encoding and hash function must remain stable across builds and platforms.
+ */
+using RowDigest = std::array<uint64_t, 2>;
+
+/// Hash support for containers keyed by RowDigest.
+struct RowDigestHash {
+  size_t operator()(const RowDigest& d) const {
+    return static_cast<size_t>(d[0] ^ (d[1] * 0x9E3779B97F4A7C15ULL));
+  }
+};
+
+/**
+ * @brief A columnar, typed representation of a query result set.
+ *
+ * QueryDataTyped stores every cell inside a per-row std::map, each keeping its
+ * own copy of the column name. A QueryBatch holds the column names once and
+ * keeps one typed vector of cells per column. String values are interned in a
+ * dictionary owned by the batch, so values repeated across rows are stored
+ * once and compared by id. The scheduler and database use it to diff and
+ * store large result sets without per-cell tree nodes.
+ *
+ * Rows within a batch may omit columns (for example, when they were
+ * deserialized from a heterogeneous JSON array). Missing cells are tracked
+ * so that round-tripping through RowTyped is lossless.
+ */
+class QueryBatch {
+ public:
+  QueryBatch() = default;
+
+  /// Create an empty batch with a known set of columns, in order.
+  explicit QueryBatch(const ColumnNames& columns);
+
+  /// Build a batch from a row-based result set.
+  static QueryBatch fromRows(const QueryDataTyped& rows);
+
+  /// The number of rows in the batch.
+  size_t size() const {
+    return rows_;
+  }
+
+  /// True if the batch contains no rows.
+  bool empty() const {
+    return rows_ == 0;
+  }
+
+  /// The ordered column name dictionary shared by all rows.
+  const ColumnNames& columns() const {
+    return columns_;
+  }
+
+  /// Lookup or insert a column, returning its index.
+  size_t addColumn(const std::string& name);
+
+  /**
+   * @brief Lookup a column index by name.
+   *
+   * @return the column index or columns().size() if it does not exist.
+   */
+  size_t columnIndex(const std::string& name) const;
+
+  /// Reserve capacity for a number of rows in each column.
+  void reserve(size_t rows);
+
+  /// Append a row-based result, adding any new columns.
+  void appendRow(const RowTyped& row);
+
+  /// Append a row whose cells are already in column order.
+  void appendRow(std::vector<RowDataTyped> cells);
+
+  /// True if the row has a value for the column.
+  bool has(size_t row, size_t column) const;
+
+  /// Copy a cell, none if the row does not have a value for the column.
+  boost::optional<RowDataTyped> cell(size_t row, size_t column) const;
+
+  /// Access a string cell, nullptr if the cell does not hold a string.
+  const std::string* text(size_t row, size_t column) const;
+
+  /**
+   * @brief Rewrite every string value of the batch.
+   *
+   * The function is called once per distinct string rather than per cell.
+   */
+  void transformStrings(const std::function<void(std::string&)>& transform);
+
+  /// The number of distinct string values.
+  size_t distinctStrings() const {
+    return strings_.size();
+  }
+
+  /// Materialize a single row into the map-based representation.
+  RowTyped row(size_t index) const;
+
+  /// Materialize the entire batch into the row-based representation.
+  QueryDataTyped toRows() const;
+
+  /**
+   * @brief A content hash of a row that is stable across batches.
+   *
+   * Column names are hashed alongside values and combined in name order, so
+   * two batches with different column orders hash equal rows identically.
+   */
+  size_t rowHash(size_t row) const;
+
+  /**
+   * @brief A persistent 128-bit content digest of a row.
+   *
+   * Unlike rowHash this is computed over a canonical byte encoding of the
+   * row (column names in order, type tags, little-endian values) using
+   * MurmurHash3, and may be stored and compared across process restarts.
+   */
+  RowDigest rowDigest(size_t row) const;
+
+  /// Compare a row to a row in another (possibly differently ordered) batch.
+  bool rowEquals(size_t row, const QueryBatch& other, size_t other_row) const;
+
+  /// Remove all rows and columns.
+  void clear();
+
+  /// Column indexes sorted by column name, matches RowTyped iteration order.
+  const std::vector<size_t>& columnsByName() const;
+
+  /// Row-wise equality, independent of column order.
+  bool operator==(const QueryBatch& comp) const;
+
+  bool operator!=(const QueryBatch& comp) const {
+    return !(*this == comp);
+  }
+
+ private:
+  /// A typed cell, strings are ids in the batch's value dictionary.
+  struct Cell {
+    /// Matches the RowDataTyped alternatives, Missing has no value.
+    enum class Type : uint8_t { Integer, Real, Text, Missing };
+
+    Type type{Type::Missing};
+    union {
+      long long integer{0};
+      double real;
+      uint32_t text;
+    };
+  };
+
+  /// Convert a value into a cell, interning strings.
+  Cell makeCell(const RowDataTyped& value);
+
+  /// Convert a present cell back into a value.
+  RowDataTyped value(const Cell& cell) const;
+
+  /// Compare present cells, the other cell may belong to another batch.
+  bool cellEquals(const Cell& cell,
+                  const QueryBatch& other,
+                  const Cell& other_cell) const;
+
+ private:
+  /// The shared column name dictionary.
+  ColumnNames columns_;
+
+  /// Lookup from a column name to its index in columns_.
+  std::unordered_map<std::string, size_t> column_index_;
+
+  /// Hashes of the column names, for row hashes.
+  std::vector<size_t> column_hashes_;
+
+  /// One vector of typed cells per column, each of length rows_.
+  std::vector<std::vector<Cell>> values_;
+
+  /// The string values of every column.
+  StringDictionary strings_;
+
+  /// Lazily computed name-ordered column indexes.
+  mutable std::vector<size_t> sorted_columns_;
+
+  /// The number of rows.
+  size_t rows_{0};
+};
+
+/**
+ * @brief Serialize a QueryBatch into a JSON array.
+ *
+ * The output is identical to serializeQueryData of the equivalent
+ * QueryDataTyped.
+ *
+ * @param b the QueryBatch to serialize.
+ * @param doc the managed JSON document.
+ * @param arr [output] the output JSON array.
+ * @param asNumeric true iff numeric values are serialized as such
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryBatch(const QueryBatch& b,
+                           JSON& doc,
+                           rapidjson::Document& arr,
+                           bool asNumeric);
+
+/**
+ * @brief Serialize a QueryBatch into a JSON string.
+ *
+ * @param b the QueryBatch to serialize.
+ * @param json [output] the output JSON string.
+ * @param asNumeric true iff numeric values are serialized as such
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryBatchJSON(const QueryBatch& b,
+                               std::string& json,
+                               bool asNumeric);
+
+/**
+ * @brief Serialize a single row of a QueryBatch into a JSON object string.
+ *
+ * @param b the QueryBatch containing the row.
+ * @param row the row index.
+ * @param json [output] the output JSON string.
+ * @param asNumeric true iff numeric values are serialized as such
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryBatchRowJSON(const QueryBatch& b,
+                                  size_t row,
+                                  std::string& json,
+                                  bool asNumeric);
+
+/// Inverse of serializeQueryBatch, convert a JSON array to a QueryBatch.
+Status deserializeQueryBatch(const rapidjson::Value& arr, QueryBatch& b);
+
+/**
+ * @brief Inverse of serializeQueryBatchJSON, convert a JSON string to a
+ * QueryBatch.
+ *
+ * The string is parsed in place, move it in when it is no longer needed.
+ */
+Status deserializeQueryBatchJSON(std::string json, QueryBatch& b);
+
+} // namespace osquery
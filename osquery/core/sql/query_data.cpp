@@ -50,27 +50,36 @@ Status serializeQueryDataJSON(const QueryData& q, JSON& doc) {
   return status;
 }
 
-Status serializeQueryDataJSON(const QueryData& q, std::string& json) {
-  JSON doc;
-  auto status = serializeQueryDataJSON(q, doc);
-
-  if (!status.ok()) {
-    return status;
+void writeQueryData(const QueryDataTyped& q,
+                    rj::Writer<rj::StringBuffer>& writer,
+                    bool asNumeric) {
+  writer.StartArray();
+  for (const auto& r : q) {
+    writeRow(r, writer, asNumeric);
   }
+  writer.EndArray();
+}
 
-  return doc.toString(json);
+Status serializeQueryDataJSON(const QueryData& q, std::string& json) {
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  writer.StartArray();
+  for (const auto& r : q) {
+    writeRow(r, {}, writer);
+  }
+  writer.EndArray();
+  json.assign(sb.GetString(), sb.GetSize());
+  return Status::success();
 }
 
 Status serializeQueryDataJSON(const QueryDataTyped& q,
                               std::string& json,
                               bool asNumeric) {
-  auto doc = JSON::newArray();
-
-  auto status = serializeQueryData(q, doc, doc.doc(), asNumeric);
-  if (!status.ok()) {
-    return status;
-  }
-  return doc.toString(json);
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  writeQueryData(q, writer, asNumeric);
+  json.assign(sb.GetString(), sb.GetSize());
+  return Status::success();
 }
 
 Status deserializeQueryData(const rj::Value& arr, QueryData& qd) {
@@ -131,16 +140,17 @@ Status deserializeQueryDataJSON(const JSON& doc, QueryData& qd) {
 
 Status deserializeQueryDataJSON(const std::string& json, QueryData& qd) {
   auto doc = JSON::newArray();
-  if (!doc.fromString(json)) {
+  if (!doc.fromStringInsitu(json)) {
     return Status(1, "Cannot deserializing JSON");
   }
 
   return deserializeQueryDataJSON(doc, qd);
 }
 
-Status deserializeQueryDataJSON(const std::string& json, QueryDataSet& qd) {
+Status deserializeQueryDataJSON(std::string json, QueryDataSet& qd) {
+  // Values are copied into the rows, the document is only read.
   rj::Document doc;
-  if (doc.Parse(json.c_str()).HasParseError()) {
+  if (doc.ParseInsitu(&json[0]).HasParseError()) {
     return Status(1, "Error serializing JSON");
   }
   return deserializeQueryData(doc, qd);
@@ -70,6 +70,17 @@ Status serializeQueryData(const QueryDataTyped& q,
                           rapidjson::Document& arr,
                           bool asNumeric);
 
+/**
+ * @brief Write a QueryDataTyped as a JSON array, without building a document.
+ *
+ * @param q the QueryDataTyped to write.
+ * @param writer [output] the writer receiving the array.
+ * @param asNumeric true iff numeric values are serialized as such
+ */
+void writeQueryData(const QueryDataTyped& q,
+                    rapidjson::Writer<rapidjson::StringBuffer>& writer,
+                    bool asNumeric);
+
 /**
  * @brief Serialize a QueryData object into a JSON document.
  *
@@ -117,8 +128,13 @@ Status deserializeQueryDataJSON(const JSON& doc, QueryData& qd);
 /// Inverse of serializeQueryDataJSON, convert a JSON string to QueryData.
 Status deserializeQueryDataJSON(const std::string& json, QueryData& qd);
 
-/// Inverse of serializeQueryDataJSON, convert a JSON string to QueryDataSet.
-Status deserializeQueryDataJSON(const std::string& json, QueryDataSet& qd);
+/**
+ * @brief Inverse of serializeQueryDataJSON, convert a JSON string to
+ * QueryDataSet.
+ *
+ * The string is parsed in place, move it in when it is no longer needed.
+ */
+Status deserializeQueryDataJSON(std::string json, QueryDataSet& qd);
 
 /**
  * @brief Add a Row to a QueryData if the Row hasn't appeared in the QueryData
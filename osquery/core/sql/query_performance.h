@@ -10,6 +10,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 namespace osquery {
 
@@ -36,4 +37,21 @@ struct QueryPerformance {
   unsigned long long int average_memory{0};
 };
 
+/**
+ * @brief A sample of the resources used while executing queries.
+ *
+ * CPU times are in milliseconds and the resident size is in bytes, matching
+ * the units of the processes table.
+ */
+struct QueryResourceUsage {
+  /// User time (milliseconds)
+  uint64_t user_time{0};
+
+  /// System time (milliseconds)
+  uint64_t system_time{0};
+
+  /// Resident memory size (bytes)
+  uint64_t resident_size{0};
+};
+
 } // namespace osquery
@@ -71,25 +71,65 @@ Status serializeRow(const RowTyped& r,
   return Status::success();
 }
 
-Status serializeRowJSON(const RowTyped& r, std::string& json, bool asNumeric) {
-  auto doc = JSON::newObject();
-  auto status = serializeRow(r, doc, doc.doc(), asNumeric);
-  if (!status.ok()) {
-    return status;
+void writeRow(const Row& r,
+              const ColumnNames& cols,
+              rj::Writer<rj::StringBuffer>& writer) {
+  writer.StartObject();
+  if (cols.empty()) {
+    for (const auto& i : r) {
+      writer.Key(i.first.data(), static_cast<rj::SizeType>(i.first.size()));
+      writer.String(i.second.data(),
+                    static_cast<rj::SizeType>(i.second.size()));
+    }
+  } else {
+    for (const auto& c : cols) {
+      auto i = r.find(c);
+      if (i != r.end()) {
+        writer.Key(c.data(), static_cast<rj::SizeType>(c.size()));
+        writer.String(i->second.data(),
+                      static_cast<rj::SizeType>(i->second.size()));
+      }
+    }
+  }
+  writer.EndObject();
+}
+
+void writeRow(const RowTyped& r,
+              rj::Writer<rj::StringBuffer>& writer,
+              bool asNumeric) {
+  writer.StartObject();
+  for (const auto& i : r) {
+    writer.Key(i.first.data(), static_cast<rj::SizeType>(i.first.size()));
+    if (const auto* str = boost::get<std::string>(&i.second)) {
+      writer.String(str->data(), static_cast<rj::SizeType>(str->size()));
+    } else if (!asNumeric) {
+      auto value = castVariant(i.second);
+      writer.String(value.data(), static_cast<rj::SizeType>(value.size()));
+    } else if (const auto* integer = boost::get<long long>(&i.second)) {
+      writer.Int64(*integer);
+    } else {
+      writer.Double(boost::get<double>(i.second));
+    }
   }
-  return doc.toString(json);
+  writer.EndObject();
+}
+
+Status serializeRowJSON(const RowTyped& r, std::string& json, bool asNumeric) {
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  writeRow(r, writer, asNumeric);
+  json.assign(sb.GetString(), sb.GetSize());
+  return Status::success();
 }
 
 Status serializeRowJSON(const Row& r, std::string& json) {
-  auto doc = JSON::newObject();
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
 
   // An empty column list will traverse the row map.
-  ColumnNames cols;
-  auto status = serializeRow(r, cols, doc, doc.doc());
-  if (!status.ok()) {
-    return status;
-  }
-  return doc.toString(json);
+  writeRow(r, {}, writer);
+  json.assign(sb.GetString(), sb.GetSize());
+  return Status::success();
 }
 
 Status deserializeRow(const rj::Value& doc, Row& r) {
@@ -129,7 +169,7 @@ Status deserializeRow(const rj::Value& doc, RowTyped& r) {
 
 Status deserializeRowJSON(const std::string& json, Row& r) {
   auto doc = JSON::newObject();
-  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+  if (!doc.fromStringInsitu(json) || !doc.doc().IsObject()) {
     return Status(1, "Cannot deserializing JSON");
   }
   return deserializeRow(doc.doc(), r);
@@ -137,7 +177,7 @@ Status deserializeRowJSON(const std::string& json, Row& r) {
 
 Status deserializeRowJSON(const std::string& json, RowTyped& r) {
   auto doc = JSON::newObject();
-  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+  if (!doc.fromStringInsitu(json) || !doc.doc().IsObject()) {
     return Status(1, "Cannot deserializing JSON");
   }
   return deserializeRow(doc.doc(), r);
@@ -84,6 +84,28 @@ Status serializeRow(const RowTyped& r,
                     rapidjson::Value& obj,
                     bool asNumeric);
 
+/**
+ * @brief Write a Row as a JSON object, without building a document.
+ *
+ * @param r the Row to write.
+ * @param cols the column order, an empty list traverses the row.
+ * @param writer [output] the writer receiving the object.
+ */
+void writeRow(const Row& r,
+              const ColumnNames& cols,
+              rapidjson::Writer<rapidjson::StringBuffer>& writer);
+
+/**
+ * @brief Write a RowTyped as a JSON object, without building a document.
+ *
+ * @param r the RowTyped to write.
+ * @param writer [output] the writer receiving the object.
+ * @param asNumeric true iff numeric values are serialized as such
+ */
+void writeRow(const RowTyped& r,
+              rapidjson::Writer<rapidjson::StringBuffer>& writer,
+              bool asNumeric);
+
 /**
  * @brief Serialize a Row object into a JSON string.
  *
@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <functional>
+#include <limits>
+
+#include "string_dictionary.h"
+
+namespace osquery {
+
+namespace {
+
+const uint32_t kEmptySlot = std::numeric_limits<uint32_t>::max();
+
+const size_t kMinIndexSlots = 16;
+
+} // namespace
+
+uint32_t StringDictionary::intern(std::string_view value) {
+  // Keep at most half of the slots used, probes stay short.
+  if ((strings_.size() + 1) * 2 > index_.size()) {
+    grow();
+  }
+
+  auto hash = std::hash<std::string_view>()(value);
+  auto mask = index_.size() - 1;
+  for (auto i = hash & mask;; i = (i + 1) & mask) {
+    auto id = index_[i];
+    if (id == kEmptySlot) {
+      id = static_cast<uint32_t>(strings_.size());
+      strings_.emplace_back(value);
+      hashes_.push_back(hash);
+      index_[i] = id;
+      return id;
+    }
+    if (hashes_[id] == hash && strings_[id] == value) {
+      return id;
+    }
+  }
+}
+
+void StringDictionary::grow() {
+  std::vector<uint32_t> index(
+      index_.empty() ? kMinIndexSlots : index_.size() * 2, kEmptySlot);
+  auto mask = index.size() - 1;
+  for (uint32_t id = 0; id < strings_.size(); id++) {
+    auto i = hashes_[id] & mask;
+    while (index[i] != kEmptySlot) {
+      i = (i + 1) & mask;
+    }
+    index[i] = id;
+  }
+  index_ = std::move(index);
+}
+
+void StringDictionary::clear() {
+  strings_.clear();
+  hashes_.clear();
+  index_.clear();
+}
+
+} // namespace osquery
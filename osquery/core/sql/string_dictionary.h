@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief Interns the distinct strings of a result set.
+ *
+ * Each distinct string is stored once, with its hash, and referred to by a
+ * dense id. Within a dictionary, equal ids are equal strings, so repeated
+ * values such as user names or paths cost one copy and compare as integers.
+ *
+ * The index is an open addressing table of ids, a string costs no allocation
+ * beyond its own.
+ */
+class StringDictionary {
+ public:
+  /// Lookup or insert a string, returning its id.
+  uint32_t intern(std::string_view value);
+
+  /// The string of an id, valid until the next intern.
+  const std::string& get(uint32_t id) const {
+    return strings_[id];
+  }
+
+  /// The hash of the string of an id, the same in every dictionary.
+  size_t hash(uint32_t id) const {
+    return hashes_[id];
+  }
+
+  /// The number of distinct strings.
+  size_t size() const {
+    return strings_.size();
+  }
+
+  /// Remove every string.
+  void clear();
+
+ private:
+  /// Rebuild the index with twice the slots.
+  void grow();
+
+ private:
+  /// Distinct strings, by id.
+  std::vector<std::string> strings_;
+
+  /// Hashes of the strings, by id.
+  std::vector<size_t> hashes_;
+
+  /// Open addressing index of ids, a power of two in size.
+  std::vector<uint32_t> index_;
+};
+
+} // namespace osquery
@@ -84,6 +84,12 @@ CLI_FLAG(bool,
          false,
          "Force osqueryd to kill previously-running daemons");
 
+CLI_FLAG(bool,
+         lazy_startup,
+         false,
+         "Attach tables on first use, index stored events in the background, "
+         "and defer startup database compaction");
+
 FLAG(string,
      host_identifier,
      "hostname",
@@ -12,21 +12,380 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
+#include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/conversions/tryto.h>
-
+#include <osquery/utils/info/version.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/system/time.h>
+#include <osquery/utils/system/uptime.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <map>
+#include <memory>
+#include <regex>
+#include <thread>
 
 namespace osquery {
 
 FLAG(bool, disable_caching, false, "Disable scheduled query caching");
 
+FLAG(uint64,
+     boot_cache_max_age,
+     3600,
+     "Seconds the results of boot static tables are reused (0 until reboot)");
+
+FLAG(uint32,
+     table_threads,
+     4,
+     "Maximum threads a table may use to generate rows for many items");
+
+FLAG(uint32,
+     table_io_threads,
+     16,
+     "Maximum concurrent network and IPC requests of I/O-bound tables");
+
+FLAG(bool,
+     scan_throttle,
+     false,
+     "Pace file hashing and scanning tables by host pressure, packs and "
+     "queries may override this with a 'throttle' option");
+
+FLAG(uint32,
+     scan_throttle_pressure,
+     10,
+     "Host pressure, the percent of time tasks are stalled, above which "
+     "throttled scans pause between files");
+
 CREATE_LAZY_REGISTRY(TablePlugin, "table");
 
 uint64_t TablePlugin::kCacheInterval = 0;
 uint64_t TablePlugin::kCacheStep = 0;
 
+namespace {
+
+class TableRowsIterator : public TableRowIterator {
+ public:
+  explicit TableRowsIterator(TableRows rows) : rows_(std::move(rows)) {}
+
+  bool next(TableRowHolder& row) override {
+    if (next_ >= rows_.size()) {
+      return false;
+    }
+    row = std::move(rows_[next_++]);
+    return true;
+  }
+
+ private:
+  TableRows rows_;
+  size_t next_{0};
+};
+
+/// Cursors left unread for this long are dropped, the reader went away.
+const std::chrono::seconds kTableCursorExpiry{300};
+
+/// Rows returned by a cursor next action that does not request a batch size.
+const size_t kTableCursorBatchRows{1024};
+
+/// Scans are throttled by the pressure they would add, this bounds the ratio.
+const double kMaxScanThrottlePressure{90};
+
+/// The longest pause after an item of work.
+const std::chrono::seconds kMaxScanThrottlePause{1};
+
+/// The host pressure is sampled at most this often.
+const std::chrono::seconds kHostPressureInterval{1};
+
+/// The scan throttling of the thread, -1 to use the flag.
+thread_local int kScanThrottle{-1};
+
+/**
+ * @brief Table scans opened with the cursor actions.
+ *
+ * A reader may stop reading, or go away, without closing its cursor. These
+ * are dropped once they expire, when another cursor is opened.
+ */
+class TableCursors : private boost::noncopyable {
+ public:
+  /// Keep an iterator and return its cursor identifier.
+  std::string open(TableRowIteratorRef iterator) {
+    auto cursor = std::make_unique<Cursor>();
+    cursor->iterator = std::move(iterator);
+    cursor->used = std::chrono::steady_clock::now();
+
+    auto id = std::to_string(++next_id_);
+    WriteLock lock(mutex_);
+    for (auto it = cursors_.begin(); it != cursors_.end();) {
+      if (cursor->used - it->second->used > kTableCursorExpiry) {
+        it = cursors_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    cursors_[id] = std::move(cursor);
+    return id;
+  }
+
+  /// Read up to count rows, a finished cursor is closed.
+  Status next(const std::string& id, size_t count, TableRows& rows) {
+    // Read without the lock, other cursors may be read concurrently.
+    std::unique_ptr<Cursor> cursor;
+    {
+      WriteLock lock(mutex_);
+      auto it = cursors_.find(id);
+      if (it == cursors_.end()) {
+        return Status::failure("Unknown table cursor: " + id);
+      }
+      cursor = std::move(it->second);
+      cursors_.erase(it);
+    }
+
+    TableRowHolder row;
+    while (rows.size() < count && cursor->iterator->next(row)) {
+      rows.push_back(std::move(row));
+    }
+
+    if (rows.size() == count) {
+      cursor->used = std::chrono::steady_clock::now();
+      WriteLock lock(mutex_);
+      cursors_[id] = std::move(cursor);
+    }
+    return Status::success();
+  }
+
+  void close(const std::string& id) {
+    WriteLock lock(mutex_);
+    cursors_.erase(id);
+  }
+
+ private:
+  struct Cursor {
+    TableRowIteratorRef iterator;
+    std::chrono::steady_clock::time_point used;
+  };
+
+  Mutex mutex_;
+  std::atomic<uint64_t> next_id_{0};
+  std::map<std::string, std::unique_ptr<Cursor>> cursors_;
+};
+
+TableCursors kTableCursors;
+
+/// The CPU budget for parallel table generation, 0 is unlimited.
+std::atomic<size_t> kTableWorkerBudget{0};
+
+/// A set of tasks from one runTableTasks call, shared with helping workers.
+struct TableTaskGroup {
+  TableTaskGroup(size_t c, const std::function<void(size_t)>& t)
+      : count(c), task(t) {}
+
+  /// A single task owned by the group, no caller waits on it.
+  explicit TableTaskGroup(std::function<void(size_t)> t)
+      : count(1), owned(std::move(t)), task(owned) {}
+
+  /// Run tasks until none are left to claim.
+  void work() {
+    size_t index = 0;
+    while ((index = next++) < count) {
+      std::exception_ptr failure;
+      try {
+        task(index);
+      } catch (...) {
+        failure = std::current_exception();
+      }
+
+      WriteLock lock(mutex);
+      if (failure != nullptr && error == nullptr) {
+        error = failure;
+      }
+      if (++done == count) {
+        finished.notify_all();
+      }
+    }
+  }
+
+  const size_t count;
+
+  /// The task of a group without a waiting caller.
+  const std::function<void(size_t)> owned;
+
+  /// Only called for a claimed index, the caller outlives every claim.
+  const std::function<void(size_t)>& task;
+
+  std::atomic<size_t> next{0};
+
+  Mutex mutex;
+  ConditionVariable finished;
+  size_t done{0};
+  std::exception_ptr error;
+};
+
+/**
+ * @brief The worker threads shared by every table scan.
+ *
+ * Threads are started on first use and never exceed the largest worker count
+ * requested, concurrent scans share them. Tasks waiting on I/O use a second
+ * pool, they would otherwise hold the workers budgeted for CPU-bound work.
+ */
+class TableWorkerPool {
+ public:
+  static TableWorkerPool& get() {
+    static TableWorkerPool pool;
+    return pool;
+  }
+
+  static TableWorkerPool& getIO() {
+    static TableWorkerPool pool;
+    return pool;
+  }
+
+  ~TableWorkerPool() {
+    {
+      WriteLock lock(mutex_);
+      stop_ = true;
+    }
+    pending_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void run(size_t count,
+           size_t concurrency,
+           const std::function<void(size_t)>& task) {
+    auto group = std::make_shared<TableTaskGroup>(count, task);
+    auto helpers = std::min(concurrency, count) - 1;
+    if (helpers > 0) {
+      WriteLock lock(mutex_);
+      while (threads_.size() < helpers) {
+        threads_.emplace_back([this]() { work(); });
+      }
+      queue_.insert(queue_.end(), helpers, group);
+      pending_.notify_all();
+    }
+
+    group->work();
+
+    WriteLock lock(group->mutex);
+    group->finished.wait(
+        lock, [&group]() { return group->done == group->count; });
+    if (group->error != nullptr) {
+      std::rethrow_exception(group->error);
+    }
+  }
+
+  /// Queue a task without waiting for it, a worker runs it.
+  void start(std::function<void(size_t)> task, size_t concurrency) {
+    auto group = std::make_shared<TableTaskGroup>(std::move(task));
+    WriteLock lock(mutex_);
+    if (threads_.size() < concurrency) {
+      threads_.emplace_back([this]() { work(); });
+    }
+    queue_.push_back(std::move(group));
+    pending_.notify_one();
+  }
+
+ private:
+  TableWorkerPool() = default;
+
+  void work() {
+    while (true) {
+      std::shared_ptr<TableTaskGroup> group;
+      {
+        WriteLock lock(mutex_);
+        pending_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          return;
+        }
+        group = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      // A group whose tasks were all claimed by others returns immediately.
+      group->work();
+    }
+  }
+
+ private:
+  Mutex mutex_;
+  ConditionVariable pending_;
+  std::deque<std::shared_ptr<TableTaskGroup>> queue_;
+  std::vector<std::thread> threads_;
+  bool stop_{false};
+};
+
+/// Check if an integer is representable by another integer type.
+template <typename To, typename From>
+bool integerFits(From value) {
+  if constexpr (std::is_signed<From>::value) {
+    if (value < 0) {
+      return std::is_signed<To>::value &&
+             static_cast<long long>(value) >=
+                 static_cast<long long>(std::numeric_limits<To>::min());
+    }
+  }
+  return static_cast<unsigned long long>(value) <=
+         static_cast<unsigned long long>(std::numeric_limits<To>::max());
+}
+
+} // namespace
+
+void Constraint::setText(std::string text) {
+  expr = std::move(text);
+  type = SQLITE_TEXT;
+  int_value = 0;
+  double_value = 0;
+}
+
+void Constraint::setInteger(long long value, std::string text) {
+  expr = std::move(text);
+  type = SQLITE_INTEGER;
+  int_value = value;
+  double_value = 0;
+}
+
+void Constraint::setDouble(double value, std::string text) {
+  expr = std::move(text);
+  type = SQLITE_FLOAT;
+  int_value = 0;
+  double_value = value;
+}
+
+template <typename T>
+bool Constraint::getValue(T& value) const {
+  if constexpr (std::is_integral<T>::value) {
+    if (type == SQLITE_INTEGER && integerFits<T>(int_value)) {
+      value = static_cast<T>(int_value);
+      return true;
+    }
+
+    auto parsed = tryTo<T>(expr);
+    if (!parsed) {
+      return false;
+    }
+    value = parsed.take();
+  } else {
+    value = expr;
+  }
+  return true;
+}
+
+template bool Constraint::getValue<int>(int&) const;
+template bool Constraint::getValue<long long>(long long&) const;
+template bool Constraint::getValue<unsigned long long>(
+    unsigned long long&) const;
+template bool Constraint::getValue<std::string>(std::string&) const;
+
 #define kDisableRowId "WITHOUT ROWID"
 
 // Columns used bitmask
@@ -37,6 +396,170 @@ static constexpr R bitmask(unsigned int const onecount) {
          (static_cast<R>(-1) >> ((sizeof(R) * CHAR_BIT) - onecount));
 }
 
+TableRowIteratorRef makeTableRowIterator(TableRows rows) {
+  return std::make_unique<TableRowsIterator>(std::move(rows));
+}
+
+void setTableWorkerBudget(size_t threads) {
+  kTableWorkerBudget = threads;
+}
+
+size_t getTableWorkerCount() {
+  size_t threads = std::max<size_t>(FLAGS_table_threads, 1);
+  size_t budget = kTableWorkerBudget;
+  if (budget == 0) {
+    budget = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  return std::min(threads, budget);
+}
+
+void runTableTasks(size_t count, const std::function<void(size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  auto concurrency = getTableWorkerCount();
+  if (concurrency == 1 || count == 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::function<void(size_t)> throttled_task =
+      [&task, throttle = ScanThrottleScope::enabled()](size_t i) {
+        ScanThrottleScope scope(throttle);
+        task(i);
+      };
+  TableWorkerPool::get().run(count, concurrency, throttled_task);
+}
+
+size_t getTableIOWorkerCount() {
+  return std::max<size_t>(FLAGS_table_io_threads, 1);
+}
+
+void runTableIOTasks(size_t count, const std::function<void(size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  auto concurrency = getTableIOWorkerCount();
+  if (concurrency == 1 || count == 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  TableWorkerPool::getIO().run(count, concurrency, task);
+}
+
+void startTableIOTask(std::function<void()> task) {
+  if (FLAGS_table_io_threads == 0) {
+    task();
+    return;
+  }
+
+  TableWorkerPool::getIO().start(
+      [task = std::move(task)](size_t) { task(); }, FLAGS_table_io_threads);
+}
+
+ScanThrottleScope::ScanThrottleScope(bool throttle)
+    : previous_(kScanThrottle) {
+  kScanThrottle = throttle ? 1 : 0;
+}
+
+ScanThrottleScope::~ScanThrottleScope() {
+  kScanThrottle = previous_;
+}
+
+bool ScanThrottleScope::enabled() {
+  if (kScanThrottle < 0) {
+    return FLAGS_scan_throttle;
+  }
+  return kScanThrottle == 1;
+}
+
+double parsePressureStall(const std::string& content) {
+  // some avg10=1.53 avg60=0.87 avg300=0.37 total=2251963
+  if (content.compare(0, 5, "some ") != 0) {
+    return 0;
+  }
+
+  auto avg10 = content.find("avg10=");
+  auto line_end = content.find('\n');
+  if (avg10 == std::string::npos || avg10 > line_end) {
+    return 0;
+  }
+
+  auto pressure = std::strtod(content.c_str() + avg10 + 6, nullptr);
+  return std::min(std::max(pressure, 0.0), 100.0);
+}
+
+static double sampleHostPressure() {
+#if defined(__linux__)
+  double pressure = 0;
+  for (const auto& resource : {"cpu", "io", "memory"}) {
+    std::string content;
+    if (readFile(std::string("/proc/pressure/") + resource, content).ok()) {
+      pressure = std::max(pressure, parsePressureStall(content));
+    }
+  }
+  return pressure;
+#elif !defined(WIN32)
+  // Tasks beyond the CPU count are waiting for one.
+  double load = 0;
+  auto cpus = static_cast<double>(std::thread::hardware_concurrency());
+  if (getloadavg(&load, 1) != 1 || cpus == 0 || load <= cpus) {
+    return 0;
+  }
+  return (load - cpus) * 100 / load;
+#else
+  return 0;
+#endif
+}
+
+double getHostPressure() {
+  static std::atomic<double> pressure{0};
+  static std::atomic<std::chrono::steady_clock::rep> next_sample{0};
+
+  auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+  auto next = next_sample.load();
+  if (now >= next && next_sample.compare_exchange_strong(
+                         next,
+                         now + std::chrono::steady_clock::duration(
+                                   kHostPressureInterval)
+                                   .count())) {
+    pressure = sampleHostPressure();
+  }
+  return pressure;
+}
+
+std::chrono::steady_clock::duration getScanThrottlePause(
+    std::chrono::steady_clock::duration work_time, double pressure) {
+  if (pressure <= FLAGS_scan_throttle_pressure) {
+    return std::chrono::steady_clock::duration::zero();
+  }
+
+  // Idle as long as the stalled share of the host's time, relative to ours.
+  pressure = std::min(pressure, kMaxScanThrottlePressure);
+  auto pause = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      work_time * (pressure / (100 - pressure)));
+  return std::min<std::chrono::steady_clock::duration>(pause,
+                                                       kMaxScanThrottlePause);
+}
+
+void throttleScanItem(std::chrono::steady_clock::duration work_time) {
+  if (!ScanThrottleScope::enabled()) {
+    return;
+  }
+
+  auto pause = getScanThrottlePause(work_time, getHostPressure());
+  if (pause > std::chrono::steady_clock::duration::zero()) {
+    std::this_thread::sleep_for(pause);
+  }
+}
+
 Status TablePlugin::addExternal(const std::string& name,
                                 const PluginResponse& response) {
   // Attach the table.
@@ -58,33 +581,8 @@ void TablePlugin::removeExternal(const std::string& name) {
 
 void TablePlugin::setRequestFromContext(const QueryContext& context,
                                         PluginRequest& request) {
-  auto doc = JSON::newObject();
-  auto constraints = doc.getArray();
-
-  // The QueryContext contains a constraint map from column to type information
-  // and the list of operand/expression constraints applied to that column from
-  // the query given.
-  for (const auto& constraint : context.constraints) {
-    auto child = doc.getObject();
-    doc.addRef("name", constraint.first, child);
-    constraint.second.serialize(doc, child);
-    doc.push(child, constraints);
-  }
-
-  doc.add("constraints", constraints);
-
-  if (context.colsUsed) {
-    auto colsUsed = doc.getArray();
-    for (const auto& columnName : *context.colsUsed) {
-      doc.pushCopy(columnName, colsUsed);
-    }
-    doc.add("colsUsed", colsUsed);
-  }
-
-  if (context.colsUsedBitset) {
-    doc.add("colsUsedBitset", context.colsUsedBitset->to_ullong());
-  }
-
+  JSON doc;
+  serializeQueryContextJSON(context, doc);
   doc.toString(request["context"]);
 }
 
@@ -142,6 +640,34 @@ Status TablePlugin::call(const PluginRequest& request,
     auto context = getContextFromRequest(request);
     TableRows result = generate(context);
     response = tableRowsToPluginResponse(result);
+  } else if (action == "open") {
+    auto context = getContextFromRequest(request);
+    auto cursor = kTableCursors.open(iterate(std::move(context)));
+    response.push_back({{"cursor", cursor}});
+  } else if (action == "next" || action == "close") {
+    auto cursor = request.find("cursor");
+    if (cursor == request.end()) {
+      return Status(1, "Table cursor actions must include a cursor");
+    }
+
+    if (action == "close") {
+      kTableCursors.close(cursor->second);
+      return Status::success();
+    }
+
+    auto batch = request.find("batch");
+    auto count = kTableCursorBatchRows;
+    if (batch != request.end()) {
+      count = std::max<size_t>(
+          tryTo<size_t>(batch->second).takeOr(kTableCursorBatchRows), 1);
+    }
+
+    TableRows rows;
+    auto status = kTableCursors.next(cursor->second, count, rows);
+    if (!status.ok()) {
+      return status;
+    }
+    response = tableRowsToPluginResponse(rows);
   } else if (action == "delete") {
     auto context = getContextFromRequest(request);
     response = delete_(context, request);
@@ -189,15 +715,19 @@ PluginResponse TablePlugin::routeInfo() const {
     }
   }
 
+  // Every table plugin implements the cursor actions.
+  auto table_attributes = attributes() | TableAttributes::CURSOR_ACTIONS;
   response.push_back(
       {{"id", "attributes"},
-       {"attributes", INTEGER(static_cast<size_t>(attributes()))}});
+       {"attributes", INTEGER(static_cast<size_t>(table_attributes))}});
   return response;
 }
 
-static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
-  if (!ctx.useCache() || !ctx.defaultColumnsUsed()) {
-    // The query execution did not request use of the warm cache.
+/// Results of constrained lookups, ordered or truncated, are not shared.
+static bool resultsShareable(const TableColumns& cols,
+                             const QueryContext& ctx) {
+  if (!ctx.orderBy.empty() || ctx.limit) {
+    // Ordered or truncated results cannot be shared with other queries.
     return false;
   }
 
@@ -212,6 +742,14 @@ static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
   return true;
 }
 
+static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
+  if (!ctx.useCache() || !ctx.defaultColumnsUsed()) {
+    // The query execution did not request use of the warm cache.
+    return false;
+  }
+  return resultsShareable(cols, ctx);
+}
+
 bool TablePlugin::isCached(uint64_t step, const QueryContext& ctx) const {
   if (FLAGS_disable_caching) {
     return false;
@@ -248,6 +786,67 @@ void TablePlugin::setCache(uint64_t step,
   }
 }
 
+/// Boot static results are stored under this prefix and the table name.
+const std::string kBootCachePrefix{"boot_cache."};
+
+/// Results of another boot or osquery version are not used.
+static const std::string& bootCacheKey() {
+  static const std::string key = [] {
+    auto boot_id = getBootId();
+    return boot_id.empty() ? boot_id : boot_id + " " + kVersion;
+  }();
+  return key;
+}
+
+bool TablePlugin::getBootCache(const QueryContext& ctx,
+                               TableRows& results) const {
+  if (FLAGS_disable_caching || bootCacheKey().empty() ||
+      !resultsShareable(columns(), ctx)) {
+    return false;
+  }
+
+  // The stored value is the boot key, the time stored, then the rows.
+  std::string content;
+  if (!getDatabaseValue(kQueries, kBootCachePrefix + getName(), content)
+           .ok()) {
+    return false;
+  }
+
+  auto key_end = content.find('\n');
+  auto time_end = content.find('\n', key_end + 1);
+  if (time_end == std::string::npos ||
+      content.compare(0, key_end, bootCacheKey()) != 0) {
+    return false;
+  }
+
+  if (FLAGS_boot_cache_max_age > 0) {
+    auto stored =
+        tryTo<uint64_t>(content.substr(key_end + 1, time_end - key_end - 1));
+    if (stored.isError() ||
+        getUnixTime() >= stored.get() + FLAGS_boot_cache_max_age) {
+      return false;
+    }
+  }
+
+  VLOG(1) << "Retrieving boot static results for table: " << getName();
+  return deserializeTableRowsJSON(content.substr(time_end + 1), results).ok();
+}
+
+void TablePlugin::setBootCache(const QueryContext& ctx,
+                               const TableRows& results) {
+  if (FLAGS_disable_caching || bootCacheKey().empty() ||
+      !ctx.defaultColumnsUsed() || !resultsShareable(columns(), ctx)) {
+    return;
+  }
+
+  std::string json;
+  if (serializeTableRowsJSON(results, json)) {
+    auto content =
+        bootCacheKey() + "\n" + std::to_string(getUnixTime()) + "\n" + json;
+    setDatabaseValue(kQueries, kBootCachePrefix + getName(), content);
+  }
+}
+
 std::string columnDefinition(const TableColumns& columns, bool is_extension) {
   std::map<std::string, bool> epilog;
   bool indexed = false;
@@ -406,21 +1005,21 @@ template <typename T>
 bool ConstraintList::literal_matches(const T& base_expr) const {
   bool aggregate = true;
   for (size_t i = 0; i < constraints_.size(); ++i) {
-    auto constraint_expr = tryTo<T>(constraints_[i].expr);
-    if (!constraint_expr) {
+    T constraint_expr{};
+    if (!constraints_[i].getValue(constraint_expr)) {
       // Cannot cast input constraint to column type.
       return false;
     }
     if (constraints_[i].op == EQUALS) {
-      aggregate = aggregate && (base_expr == constraint_expr.take());
+      aggregate = aggregate && (base_expr == constraint_expr);
     } else if (constraints_[i].op == GREATER_THAN) {
-      aggregate = aggregate && (base_expr > constraint_expr.take());
+      aggregate = aggregate && (base_expr > constraint_expr);
     } else if (constraints_[i].op == LESS_THAN) {
-      aggregate = aggregate && (base_expr < constraint_expr.take());
+      aggregate = aggregate && (base_expr < constraint_expr);
     } else if (constraints_[i].op == GREATER_THAN_OR_EQUALS) {
-      aggregate = aggregate && (base_expr >= constraint_expr.take());
+      aggregate = aggregate && (base_expr >= constraint_expr);
     } else if (constraints_[i].op == LESS_THAN_OR_EQUALS) {
-      aggregate = aggregate && (base_expr <= constraint_expr.take());
+      aggregate = aggregate && (base_expr <= constraint_expr);
     } else {
       // Unsupported constraint. Should match every thing.
       return true;
@@ -444,13 +1043,33 @@ std::set<std::string> ConstraintList::getAll(ConstraintOperator op) const {
   return set;
 }
 
+template <typename T>
+bool ConstraintList::integerMatches(T expr) const {
+  if (affinity == INTEGER_TYPE) {
+    return integerFits<INTEGER_LITERAL>(expr) &&
+           literal_matches<INTEGER_LITERAL>(static_cast<INTEGER_LITERAL>(expr));
+  } else if (affinity == BIGINT_TYPE) {
+    return integerFits<BIGINT_LITERAL>(expr) &&
+           literal_matches<BIGINT_LITERAL>(static_cast<BIGINT_LITERAL>(expr));
+  } else if (affinity == UNSIGNED_BIGINT_TYPE) {
+    return integerFits<UNSIGNED_BIGINT_LITERAL>(expr) &&
+           literal_matches<UNSIGNED_BIGINT_LITERAL>(
+               static_cast<UNSIGNED_BIGINT_LITERAL>(expr));
+  }
+  return matches(std::to_string(expr));
+}
+
+template bool ConstraintList::integerMatches<long long>(long long) const;
+template bool ConstraintList::integerMatches<unsigned long long>(
+    unsigned long long) const;
+
 template <typename T>
 std::set<T> ConstraintList::getAll(ConstraintOperator /* op */) const {
   std::set<T> cs;
   for (const auto& item : constraints_) {
-    auto exp = tryTo<T>(item.expr);
-    if (exp) {
-      cs.insert(exp.take());
+    T value{};
+    if (item.getValue(value)) {
+      cs.insert(value);
     }
   }
   return cs;
@@ -509,6 +1128,16 @@ bool QueryContext::isColumnUsed(const std::string& colName) const {
   return !colsUsed || colsUsed->find(colName) != colsUsed->end();
 }
 
+bool QueryContext::isOrderedBy(const std::string& column,
+                               bool& descending) const {
+  if (orderBy.size() != 1 || orderBy[0].column != column) {
+    return false;
+  }
+
+  descending = orderBy[0].descending;
+  return true;
+}
+
 bool QueryContext::isAnyColumnUsed(
     std::initializer_list<std::string> colNames) const {
   for (auto& colName : colNames) {
@@ -545,6 +1174,17 @@ TableRowHolder QueryContext::getCache(const std::string& index) {
   return table_->cache[index]->clone();
 }
 
+std::shared_ptr<QueryScope> QueryContext::getQueryScope() {
+  if (query_scope_ == nullptr) {
+    query_scope_ = std::make_shared<QueryScope>();
+  }
+  return query_scope_;
+}
+
+void QueryContext::setQueryScope(std::shared_ptr<QueryScope> query_scope) {
+  query_scope_ = std::move(query_scope);
+}
+
 bool QueryContext::hasConstraint(const std::string& column,
                                  ConstraintOperator op) const {
   if (constraints.count(column) == 0) {
@@ -568,6 +1208,141 @@ Status QueryContext::expandConstraints(
   return Status(0);
 }
 
+namespace {
+
+bool isPathSeparator(char c) {
+  return c == '/' || c == '\\';
+}
+
+/// Reduce an anchored regular expression to its literal prefix.
+bool regexLiteralPrefix(const std::string& expr,
+                        std::string& literal,
+                        bool& exact) {
+  exact = false;
+  if (expr.empty() || expr[0] != '^' || expr.find('|') != std::string::npos) {
+    // Alternations may match outside of the prefix.
+    return false;
+  }
+
+  for (size_t i = 1; i < expr.size(); i++) {
+    auto c = expr[i];
+    if (c == '\\') {
+      if (i + 1 == expr.size() ||
+          std::isalnum(static_cast<unsigned char>(expr[i + 1]))) {
+        // Character classes such as \d or \w end the literal.
+        break;
+      }
+      literal += expr[++i];
+      continue;
+    }
+
+    if (c == '$' && i + 1 == expr.size()) {
+      exact = true;
+      break;
+    }
+
+    if (c == '*' || c == '?' || c == '{') {
+      // The preceding character may not be present.
+      if (!literal.empty()) {
+        literal.pop_back();
+      }
+      break;
+    }
+
+    if (std::strchr(".[]()+^$}", c) != nullptr) {
+      break;
+    }
+    literal += c;
+  }
+  return true;
+}
+
+} // namespace
+
+bool pathConstraintToFilePattern(ConstraintOperator op,
+                                 const std::string& expr,
+                                 std::string& pattern) {
+  pattern.clear();
+  if (op == LIKE) {
+    pattern = expr;
+    std::replace(pattern.begin(), pattern.end(), '_', '?');
+    return !pattern.empty();
+  }
+
+  if (op == GLOB) {
+    // SQLite negates a character class with '^', filesystem globbing uses '!'.
+    for (size_t i = 0; i < expr.size(); i++) {
+      pattern += expr[i];
+      if (expr[i] == '[' && i + 1 < expr.size() && expr[i + 1] == '^') {
+        pattern += '!';
+        i++;
+      }
+    }
+    return !pattern.empty();
+  }
+
+  if (op == REGEXP) {
+    std::string literal;
+    bool exact = false;
+    if (!regexLiteralPrefix(expr, literal, exact)) {
+      return false;
+    }
+
+    if (exact) {
+      pattern = literal;
+      return !pattern.empty();
+    }
+
+    // Enumerate below the last complete directory of the literal prefix.
+    auto it = std::find_if(literal.rbegin(), literal.rend(), isPathSeparator);
+    if (it == literal.rend()) {
+      return false;
+    }
+    pattern = std::string(literal.begin(), it.base()) + kSQLGlobRecursive;
+    return true;
+  }
+
+  return false;
+}
+
+Status QueryContext::expandPathConstraints(const std::string& column,
+                                           GlobLimits limits,
+                                           std::set<std::string>& output) {
+  for (auto op : {LIKE, GLOB, REGEXP}) {
+    for (const auto& expr : constraints[column].getAll(op)) {
+      std::string pattern;
+      if (!pathConstraintToFilePattern(op, expr, pattern)) {
+        VLOG(1) << "Cannot resolve " << column << " constraint: " << expr;
+        continue;
+      }
+
+      std::vector<std::string> resolved;
+      auto status = resolveFilePattern(pattern, resolved, limits);
+      if (!status.ok()) {
+        return status;
+      }
+
+      if (op != REGEXP) {
+        output.insert(resolved.begin(), resolved.end());
+        continue;
+      }
+
+      // Only keep the entries below the prefix that match the expression.
+      try {
+        std::regex regex(expr);
+        for (const auto& path : resolved) {
+          if (std::regex_search(path, regex)) {
+            output.insert(path);
+          }
+        }
+      } catch (const std::regex_error& e) {
+        VLOG(1) << "Invalid " << column << " regex: " << e.what();
+      }
+    }
+  }
+  return Status::success();
+}
+
 Status deserializeQueryContextJSON(const JSON& json_helper,
                                    QueryContext& context) {
   const auto& rapidjson_doc = json_helper.doc();
@@ -584,6 +1359,28 @@ Status deserializeQueryContextJSON(const JSON& json_helper,
     context.colsUsedBitset = rapidjson_doc["colsUsedBitset"].GetUint64();
   }
 
+  // Ordering and row count hints, the table may use them to generate less.
+  if (rapidjson_doc.HasMember("orderBy") &&
+      rapidjson_doc["orderBy"].IsArray()) {
+    for (const auto& term : rapidjson_doc["orderBy"].GetArray()) {
+      if (!term.IsObject() || !term.HasMember("column") ||
+          !term["column"].IsString()) {
+        continue;
+      }
+
+      OrderByTerm order_by;
+      order_by.column = term["column"].GetString();
+      order_by.descending = term.HasMember("descending") &&
+                            term["descending"].IsBool() &&
+                            term["descending"].GetBool();
+      context.orderBy.push_back(std::move(order_by));
+    }
+  }
+
+  if (rapidjson_doc.HasMember("limit") && rapidjson_doc["limit"].IsUint64()) {
+    context.limit = static_cast<size_t>(rapidjson_doc["limit"].GetUint64());
+  }
+
   if (!rapidjson_doc.HasMember("constraints")) {
     return Status::failure(1, "Missing contraints field in JSON");
   }
@@ -628,6 +1425,21 @@ void serializeQueryContextJSON(const QueryContext& context, JSON& json_helper) {
   if (context.colsUsedBitset) {
     json_helper.add("colsUsedBitset", context.colsUsedBitset->to_ullong());
   }
+
+  if (!context.orderBy.empty()) {
+    auto order_by = json_helper.getArray();
+    for (const auto& term : context.orderBy) {
+      auto child = json_helper.getObject();
+      json_helper.addCopy("column", term.column, child);
+      json_helper.add("descending", term.descending, child);
+      json_helper.push(child, order_by);
+    }
+    json_helper.add("orderBy", order_by);
+  }
+
+  if (context.limit) {
+    json_helper.add("limit", static_cast<uint64_t>(*context.limit));
+  }
 }
 
 } // namespace osquery
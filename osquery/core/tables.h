@@ -10,15 +10,22 @@
 #pragma once
 
 #include <bitset>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <boost/core/ignore_unused.hpp>
 #include <boost/coroutine2/coroutine.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
 #include <sqlite3.h>
 
@@ -26,6 +33,7 @@
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/core/query.h>
 #include <osquery/core/sql/column.h>
+#include <osquery/utils/mutex.h>
 
 #include <gtest/gtest_prod.h>
 
@@ -163,6 +171,21 @@ struct Constraint {
   unsigned char op;
   std::string expr;
 
+  /**
+   * @brief The SQLite datatype of the expression value.
+   *
+   * Expressions bound by SQLite keep their original type, an integer value
+   * is also stored in int_value and a float in double_value. Expressions
+   * from other sources, such as extensions, are SQLITE_TEXT.
+   */
+  int type{SQLITE_TEXT};
+
+  /// The expression value if type is SQLITE_INTEGER.
+  long long int_value{0};
+
+  /// The expression value if type is SQLITE_FLOAT.
+  double double_value{0};
+
   /// Construct a Constraint with the most-basic information, the operator.
   explicit Constraint(unsigned char _op) {
     op = _op;
@@ -171,6 +194,27 @@ struct Constraint {
   // A constraint list in a context knows only the operator at creation.
   explicit Constraint(unsigned char _op, std::string _expr)
       : op(_op), expr(std::move(_expr)) {}
+
+  /// Set a text expression, clearing any typed value.
+  void setText(std::string text);
+
+  /// Set an integer expression, the text is kept for string accessors.
+  void setInteger(long long value, std::string text);
+
+  /// Set a float expression, the text is kept for string accessors.
+  void setDouble(double value, std::string text);
+
+  /**
+   * @brief Read the expression as a literal type.
+   *
+   * Integer expressions are converted without a string round trip when the
+   * value fits the requested type, otherwise the text is parsed.
+   *
+   * @param value [output] the literal value, untouched on failure.
+   * @return false if the expression cannot be represented by the type.
+   */
+  template <typename T>
+  bool getValue(T& value) const;
 };
 
 /**
@@ -194,6 +238,33 @@ enum class TableAttributes {
 
   /// (Deprecated) This table's data requires an osquery kernel module.
   KERNEL_REQUIRED = 16,
+
+  /*
+   * @brief Lookups by an index column may be batched into a single scan.
+   *
+   * The table accepts many EQUALS values for a column at once, and a scan
+   * without constraints returns every row such a lookup would. Repeated
+   * lookups, e.g. from the inner loop of a JOIN, are served from that scan.
+   */
+  BATCHED_LOOKUPS = 32,
+
+  /*
+   * @brief The plugin serves rows in batches with cursor actions.
+   *
+   * Set by every TablePlugin's route info, so the core reads tables from
+   * extensions built with this SDK in batches with the open, next, and close
+   * actions rather than receiving the whole result of a generate.
+   */
+  CURSOR_ACTIONS = 64,
+
+  /*
+   * @brief The results do not change until the system reboots.
+   *
+   * Results are stored in the database keyed by the boot, and reused by
+   * later queries and processes until a reboot, an osquery update or the
+   * boot_cache_max_age.
+   */
+  BOOT_STATIC = 128,
 };
 
 /// Treat table attributes as a set of flags.
@@ -261,9 +332,24 @@ struct ConstraintList : private boost::noncopyable {
    */
   template <typename T>
   bool matches(const T& expr) const {
-    return matches(SQL_TEXT(expr));
+    if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+      return integerMatches<long long>(expr);
+    } else if constexpr (std::is_integral<T>::value) {
+      return integerMatches<unsigned long long>(expr);
+    } else {
+      return matches(SQL_TEXT(expr));
+    }
   }
 
+  /**
+   * @brief Match an integer expression without converting it to text.
+   *
+   * The expression is compared using the affinity's literal type, it does not
+   * match if it cannot be represented by that type.
+   */
+  template <typename T>
+  bool integerMatches(T expr) const;
+
   /**
    * @brief Check and return if there are constraints on this column.
    *
@@ -376,10 +462,100 @@ using ConstraintSet = std::vector<std::pair<std::string, struct Constraint>>;
 /// Keep track of which columns are used
 using UsedColumns = std::unordered_set<std::string>;
 
+/// Filesystem globbing limits, see osquery/filesystem/filesystem.h.
+enum GlobLimits : size_t;
+
+/**
+ * @brief Convert a pattern constraint on a path column into a file pattern.
+ *
+ * The output follows the resolveFilePattern convention, where '%' matches
+ * within a directory and '%%' recurses. A LIKE '_' matches any character and
+ * GLOB wildcards and character classes are kept. A REGEXP must be anchored
+ * with '^'; it is reduced to the directory of its literal prefix followed by
+ * a recursive wildcard, so resolved paths must still be matched.
+ *
+ * Patterns may select a superset of the constraint, SQLite filters again.
+ *
+ * @param op LIKE, GLOB, or REGEXP.
+ * @param expr the constraint expression.
+ * @param pattern [output] the file pattern.
+ * @return false if the constraint cannot be expressed as a file pattern.
+ */
+bool pathConstraintToFilePattern(ConstraintOperator op,
+                                 const std::string& expr,
+                                 std::string& pattern);
+
 /// Keep track of which columns are used, as a bitset
 using UsedColumnsBitset = std::bitset<
     std::numeric_limits<decltype(sqlite3_index_info().colUsed)>::digits>;
 
+/// An ORDER BY term a table agreed to satisfy.
+struct OrderByTerm {
+  std::string column;
+  bool descending{false};
+};
+
+using OrderBy = std::vector<OrderByTerm>;
+
+/**
+ * @brief Ordering and row count hints accepted within xBestIndex.
+ *
+ * The LIMIT and OFFSET values are only known within xFilter, the hints record
+ * which xFilter arguments hold them.
+ */
+struct QueryPlanHints {
+  /// The ORDER BY terms the table consumed, empty if SQLite sorts the rows.
+  OrderBy orderBy;
+
+  /// The 1-based xFilter argument holding the LIMIT, 0 if there is none.
+  size_t limitArgument{0};
+
+  /// The 1-based xFilter argument holding the OFFSET, 0 if there is none.
+  size_t offsetArgument{0};
+
+  /// Constraints whose xFilter argument holds every value of an IN list.
+  std::set<size_t> inConstraints;
+};
+
+/// The rows of a scan without constraints, grouped by one column's values.
+struct BatchedScan {
+  /// The number of lookups answered by the table before the scan.
+  size_t lookups{0};
+
+  /// True once the scan was generated.
+  bool generated{false};
+
+  /// The scan rows by column value.
+  std::unordered_map<std::string, TableRows> rows;
+};
+
+/**
+ * @brief State shared by every table scanned within a single query.
+ *
+ * Tables reading the same expensive source may keep a snapshot of it here, so
+ * a join across them reads the source once and every table sees the same
+ * data. The scope, and everything in it, is released when the query
+ * completes. Entries are created on first use and may be used from table
+ * worker threads.
+ */
+class QueryScope final {
+ public:
+  /// Get, or default-construct, the entry for a key.
+  template <typename T>
+  std::shared_ptr<T> get(const std::string& key) {
+    WriteLock lock(mutex_);
+    auto& entry = entries_[key];
+    if (entry == nullptr) {
+      entry = std::make_shared<T>();
+    }
+    return std::static_pointer_cast<T>(entry);
+  }
+
+ private:
+  Mutex mutex_;
+  std::map<std::string, std::shared_ptr<void>> entries_;
+};
+
 /**
  * @brief osquery table content descriptor.
  *
@@ -423,6 +599,12 @@ struct VirtualTableContent {
   /// Transient set of virtual table used columns (as bitmasks)
   std::unordered_map<size_t, UsedColumnsBitset> colsUsedBitsets;
 
+  /// Transient set of virtual table ordering and limit hints.
+  std::unordered_map<size_t, QueryPlanHints> hints;
+
+  /// Transient scans serving repeated lookups of BATCHED_LOOKUPS tables.
+  std::unordered_map<size_t, BatchedScan> batchedScans;
+
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -444,6 +626,168 @@ struct VirtualTableContent {
 using RowGenerator = boost::coroutines2::coroutine<TableRowHolder>;
 using RowYield = RowGenerator::push_type;
 
+/**
+ * @brief A pull-based source of table rows.
+ *
+ * The virtual table cursor requests one row at a time as SQLite steps and
+ * destroys the iterator once the statement stops stepping, for example when
+ * a LIMIT is reached. Iterators that build each row on request only hold the
+ * current row in memory.
+ */
+class TableRowIterator {
+ public:
+  virtual ~TableRowIterator() = default;
+
+  /**
+   * @brief Produce the next row.
+   *
+   * @param row [output] the next row.
+   * @return false if there are no more rows.
+   */
+  virtual bool next(TableRowHolder& row) = 0;
+};
+
+using TableRowIteratorRef = std::unique_ptr<TableRowIterator>;
+
+/// Iterate over an already generated set of rows.
+TableRowIteratorRef makeTableRowIterator(TableRows rows);
+
+/**
+ * @brief Limit parallel table generation to a CPU budget, in threads.
+ *
+ * A watched worker sets this from the watchdog utilization limit so tables
+ * fanning out work do not trip the watchdog. A budget of 0 is unlimited.
+ */
+void setTableWorkerBudget(size_t threads);
+
+/// The number of threads a single table scan may use, at least 1.
+size_t getTableWorkerCount();
+
+/**
+ * @brief Run a number of independent tasks on the shared table workers.
+ *
+ * The calling thread takes part in the work, so this is safe to call from
+ * within another task. Returns when every task has completed; the first
+ * exception thrown by a task is rethrown to the caller.
+ *
+ * @param count the number of tasks, each is called with its index.
+ * @param task a thread-safe callable.
+ */
+void runTableTasks(size_t count, const std::function<void(size_t)>& task);
+
+/// The number of concurrent requests a single I/O-bound table may make.
+size_t getTableIOWorkerCount();
+
+/**
+ * @brief Run a number of independent I/O-bound tasks on the table I/O workers.
+ *
+ * Like runTableTasks, for tasks that mostly wait on network or IPC requests.
+ * The I/O workers are not limited by the watchdog CPU budget, a table may
+ * have up to --table_io_threads requests outstanding.
+ *
+ * @param count the number of tasks, each is called with its index.
+ * @param task a thread-safe callable.
+ */
+void runTableIOTasks(size_t count, const std::function<void(size_t)>& task);
+
+/// Queue a task on the table I/O workers, it runs inline if there are none.
+void startTableIOTask(std::function<void()> task);
+
+/**
+ * @brief Start an I/O-bound request and return the future of its result.
+ *
+ * A table overlaps many requests by starting each one before waiting on any
+ * of the futures. An exception thrown by the request is rethrown by the
+ * future. A request must not wait on another request's future, every worker
+ * may be waiting already.
+ *
+ * @param function a callable taking no arguments.
+ * @return the future of the callable's result.
+ */
+template <typename Function>
+std::future<std::invoke_result_t<Function>> runTableIOTask(Function function) {
+  using Result = std::invoke_result_t<Function>;
+  auto task =
+      std::make_shared<std::packaged_task<Result()>>(std::move(function));
+  auto result = task->get_future();
+  startTableIOTask([task]() { (*task)(); });
+  return result;
+}
+
+/**
+ * @brief Generate the rows for many independent items in parallel.
+ *
+ * Intended for tables that do expensive work per constraint value, such as
+ * hashing a file. The generator is called once per item, possibly from a
+ * table worker thread, and must not touch the QueryContext cache. Rows are
+ * merged in item order.
+ *
+ * @param items the items, for example the paths named by constraints.
+ * @param generator a callable taking an item and a TableRows output.
+ * @return the merged rows of every item.
+ */
+template <typename Item, typename Generator>
+TableRows generateRowsParallel(const std::vector<Item>& items,
+                               Generator generator) {
+  std::vector<TableRows> results(items.size());
+  runTableTasks(items.size(),
+                [&](size_t i) { generator(items[i], results[i]); });
+
+  TableRows rows;
+  for (auto& result : results) {
+    rows.insert(rows.end(),
+                std::make_move_iterator(result.begin()),
+                std::make_move_iterator(result.end()));
+  }
+  return rows;
+}
+
+/**
+ * @brief Throttle, or not, the scans of queries run by the calling thread.
+ *
+ * The scheduler sets this while a query runs, from the query's or its pack's
+ * "throttle" option. Queries without one use --scan_throttle. Table worker
+ * tasks are throttled like the thread that started them.
+ */
+class ScanThrottleScope : private boost::noncopyable {
+ public:
+  explicit ScanThrottleScope(bool throttle);
+  ~ScanThrottleScope();
+
+  /// Check if scans on the calling thread are throttled.
+  static bool enabled();
+
+ private:
+  int previous_;
+};
+
+/**
+ * @brief Pause a throttled table scan after an item of work.
+ *
+ * Tables hashing or scanning many files call this after each item with the
+ * time it took. While the host pressure is above --scan_throttle_pressure
+ * the scan idles in proportion to its work, so a scan runs at full speed on
+ * an idle host and yields to the workloads stalled on a busy one.
+ */
+void throttleScanItem(std::chrono::steady_clock::duration work_time);
+
+/// The pause after an item of work, at a host pressure in percent.
+std::chrono::steady_clock::duration getScanThrottlePause(
+    std::chrono::steady_clock::duration work_time, double pressure);
+
+/**
+ * @brief The host pressure, the percent of time tasks are stalled.
+ *
+ * On Linux this is the largest 10 second "some" average of the CPU, IO and
+ * memory pressure stall information. Other POSIX platforms estimate the CPU
+ * pressure from the load average, on Windows it is 0. The pressure is sampled
+ * at most once a second.
+ */
+double getHostPressure();
+
+/// Parse the 10 second "some" average of a /proc/pressure file, in percent.
+double parsePressureStall(const std::string& content);
+
 /**
  * @brief A QueryContext is provided to every table generator for optimization
  * on query components like predicate constraints and limits.
@@ -471,9 +815,13 @@ struct QueryContext {
   QueryContext(QueryContext&& other)
       : constraints(std::move(other.constraints)),
         colsUsed(std::move(other.colsUsed)),
+        colsUsedBitset(std::move(other.colsUsedBitset)),
+        orderBy(std::move(other.orderBy)),
+        limit(std::move(other.limit)),
         enable_cache_(other.enable_cache_),
         use_cache_(other.use_cache_),
-        table_(other.table_) {
+        table_(other.table_),
+        query_scope_(std::move(other.query_scope_)) {
     other.enable_cache_ = false;
     other.table_ = nullptr;
   }
@@ -482,9 +830,13 @@ struct QueryContext {
   QueryContext& operator=(QueryContext&& other) {
     std::swap(constraints, other.constraints);
     std::swap(colsUsed, other.colsUsed);
+    std::swap(colsUsedBitset, other.colsUsedBitset);
+    std::swap(orderBy, other.orderBy);
+    std::swap(limit, other.limit);
     std::swap(enable_cache_, other.enable_cache_);
     std::swap(use_cache_, other.use_cache_);
     std::swap(table_, other.table_);
+    std::swap(query_scope_, other.query_scope_);
 
     return *this;
   }
@@ -571,6 +923,21 @@ struct QueryContext {
       std::function<Status(const std::string& constraint,
                            std::set<std::string>& output)> predicate);
 
+  /**
+   * @brief Resolve LIKE, GLOB and REGEXP constraints on a path-like column.
+   *
+   * Each pattern is converted with pathConstraintToFilePattern and resolved
+   * on the filesystem, such that tables only enumerate matching entries.
+   *
+   * @param column The name of a path or directory column within this table.
+   * @param limits The resolveFilePattern match types, e.g., files, folders.
+   * @param output The output parameter, a set of resolved paths.
+   * @return An aggregate status, if any pattern fails the operation fails.
+   */
+  Status expandPathConstraints(const std::string& column,
+                               GlobLimits limits,
+                               std::set<std::string>& output);
+
   /// Check if the given column is used by the query
   bool isColumnUsed(const std::string& colName) const;
 
@@ -619,6 +986,17 @@ struct QueryContext {
     }
   }
 
+  /**
+   * @brief Check if the query requested rows ordered by a SORTABLE column.
+   *
+   * When true SQLite does not sort the results, the table must emit them in
+   * the requested order.
+   *
+   * @param column the column name.
+   * @param descending [output] true if the order is descending.
+   */
+  bool isOrderedBy(const std::string& column, bool& descending) const;
+
   /// Check if a table-defined index exists within the query cache.
   bool isCached(const std::string& index) const;
 
@@ -634,12 +1012,34 @@ struct QueryContext {
   /// Set the entire cache for an index.
   void setCache(const std::string& index, const TableRowHolder& _cache);
 
+  /**
+   * @brief The state shared with the other tables of the query.
+   *
+   * A context that is not part of an SQL query, for example one a table
+   * builds to call another table's generator, has a scope of its own.
+   */
+  std::shared_ptr<QueryScope> getQueryScope();
+
+  /// Share the state of the query this context is part of.
+  void setQueryScope(std::shared_ptr<QueryScope> query_scope);
+
   /// The map of column name to constraint list.
   ConstraintMap constraints;
 
   boost::optional<UsedColumns> colsUsed;
   boost::optional<UsedColumnsBitset> colsUsedBitset;
 
+  /// The ORDER BY terms the table must satisfy, see isOrderedBy.
+  OrderBy orderBy;
+
+  /**
+   * @brief The most rows the query may read, including any OFFSET.
+   *
+   * SQLite still applies the LIMIT and OFFSET, a table may stop generating
+   * once it emitted this many rows.
+   */
+  boost::optional<size_t> limit;
+
  private:
   /// If false then the context is maintaining an ephemeral cache.
   bool enable_cache_{false};
@@ -650,6 +1050,9 @@ struct QueryContext {
   /// Persistent table content for table caching.
   std::shared_ptr<VirtualTableContent> table_;
 
+  /// State shared by the tables of the query, created on first use.
+  std::shared_ptr<QueryScope> query_scope_;
+
  private:
   friend class TablePlugin;
 };
@@ -786,6 +1189,27 @@ class TablePlugin : public Plugin {
     return false;
   }
 
+  /**
+   * @brief Generate a table representation one row at a time.
+   *
+   * For tables that set iterator=True in their spec's implementation, the
+   * cursor pulls a row from the returned iterator for each SQLite step rather
+   * than materializing every row in xFilter. Generation stops as soon as the
+   * query stops stepping. Unlike the generator method, no coroutine stack is
+   * needed. The iterator owns the query context.
+   *
+   * @param context a query context filled in by SQLite's virtual table API.
+   * @return an iterator over the table rows.
+   */
+  virtual TableRowIteratorRef iterate(QueryContext context) {
+    return makeTableRowIterator(generate(context));
+  }
+
+  /// Override and return true to use the iterate method.
+  virtual bool usesIterator() const {
+    return false;
+  }
+
  protected:
   /// An SQL table containing the table definition/syntax.
   std::string columnDefinition(bool is_extension = false) const;
@@ -841,6 +1265,26 @@ class TablePlugin : public Plugin {
                 const QueryContext& ctx,
                 const TableRows& results);
 
+  /**
+   * @brief Lookup the results a BOOT_STATIC table stored during this boot.
+   *
+   * Unlike the schedule cache, these results are kept across queries and
+   * process restarts, and serve queries selecting any set of columns.
+   *
+   * @param ctx The query context.
+   * @param results [output] The deserialized row data of cached results.
+   * @return True if results of this boot were found.
+   */
+  bool getBootCache(const QueryContext& ctx, TableRows& results) const;
+
+  /**
+   * @brief Store the results of a BOOT_STATIC table for this boot.
+   *
+   * Results are only stored if every column was generated, and no
+   * constraints limited them.
+   */
+  void setBootCache(const QueryContext& ctx, const TableRows& results);
+
  private:
   /// The last time in seconds the table data results were saved to cache.
   uint64_t last_cached_{0};
@@ -869,6 +1313,10 @@ class TablePlugin : public Plugin {
    * handle requests and responses from extensions. The TablePlugin uses an
    * "action" key, which can be:
    *   - generate: call the plugin's row generate method (defined in spec).
+   *   - open: start iterating the rows, returns a "cursor" identifier.
+   *   - next: return up to "batch" rows from a "cursor", a short batch means
+   *     the cursor is finished and was closed.
+   *   - close: stop iterating a "cursor" before it is finished.
    *   - columns: return a list of column name and SQLite types.
    *   - definition: return an SQL statement for table creation.
    *
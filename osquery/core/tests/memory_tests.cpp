@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/memory.h>
+
+namespace osquery {
+
+class MemoryTests : public testing::Test {};
+
+TEST_F(MemoryTests, test_subsystem_memory) {
+  registerMemoryReporter("memory_tests", [](std::vector<SubsystemMemory>& m) {
+    SubsystemMemory buffer;
+    buffer.name = "buffer";
+    buffer.bytes = 1024;
+    m.push_back(buffer);
+
+    SubsystemMemory rows;
+    rows.name = "rows";
+    rows.items = 3;
+    m.push_back(rows);
+  });
+
+  std::vector<SubsystemMemory> reported;
+  for (const auto& held : getSubsystemMemory()) {
+    if (held.subsystem == "memory_tests") {
+      reported.push_back(held);
+    }
+  }
+
+  // Reporters do not name their subsystem, it is set for them.
+  ASSERT_EQ(2U, reported.size());
+  EXPECT_EQ("buffer", reported[0].name);
+  EXPECT_EQ(1024, reported[0].bytes);
+  EXPECT_EQ(-1, reported[0].items);
+  EXPECT_EQ("rows", reported[1].name);
+  EXPECT_EQ(-1, reported[1].bytes);
+  EXPECT_EQ(3, reported[1].items);
+}
+
+TEST_F(MemoryTests, test_allocator_stats) {
+  AllocatorStats stats;
+  if (!getAllocatorStats(stats).ok()) {
+    // Not every platform's allocator provides statistics.
+    EXPECT_FALSE(releaseAllocatorMemory());
+    return;
+  }
+
+  EXPECT_FALSE(stats.allocator.empty());
+  EXPECT_GT(stats.heap, 0U);
+  EXPECT_LE(stats.in_use, stats.heap);
+
+  // Freed chunks are kept by the allocator until released.
+  {
+    std::vector<std::unique_ptr<char[]>> chunks;
+    for (size_t i = 0; i < 64; ++i) {
+      chunks.emplace_back(new char[4096]);
+    }
+  }
+
+  AllocatorStats freed;
+  ASSERT_TRUE(getAllocatorStats(freed).ok());
+  EXPECT_FALSE(releaseAllocatorMemory(freed.free + 1));
+}
+
+} // namespace osquery
@@ -10,13 +10,24 @@
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
 
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 namespace osquery {
 
+DECLARE_bool(scan_throttle);
+DECLARE_uint32(scan_throttle_pressure);
+DECLARE_uint32(table_threads);
+DECLARE_uint32(table_io_threads);
+
 class TablesTests : public testing::Test {
 protected:
  void SetUp() {
@@ -116,6 +127,69 @@ TEST_F(TablesTests, test_constraint_matching) {
   EXPECT_TRUE(cl3.matches(1));
 }
 
+TEST_F(TablesTests, test_constraint_typed) {
+  auto constraint = Constraint(GREATER_THAN);
+  constraint.setInteger(4294967296LL, "4294967296");
+  EXPECT_EQ(constraint.type, SQLITE_INTEGER);
+
+  long long bigint = 0;
+  EXPECT_TRUE(constraint.getValue(bigint));
+  EXPECT_EQ(bigint, 4294967296LL);
+
+  // The value does not fit an INTEGER literal.
+  int integer = 0;
+  EXPECT_FALSE(constraint.getValue(integer));
+  EXPECT_EQ(integer, 0);
+
+  std::string text;
+  EXPECT_TRUE(constraint.getValue(text));
+  EXPECT_EQ(text, "4294967296");
+
+  struct ConstraintList cl;
+  cl.affinity = BIGINT_TYPE;
+  cl.add(constraint);
+  constraint = Constraint(LESS_THAN, "4294967300");
+  cl.add(constraint);
+
+  EXPECT_TRUE(cl.matches(4294967297LL));
+  EXPECT_TRUE(cl.matches("4294967297"));
+  EXPECT_FALSE(cl.matches(4294967296LL));
+  EXPECT_FALSE(cl.matches(4294967300ULL));
+
+  auto all = cl.getAll<long long>(GREATER_THAN);
+  EXPECT_EQ(all, std::set<long long>({4294967296LL, 4294967300LL}));
+
+  // Text expressions clear a previously typed value.
+  constraint.setText("12");
+  EXPECT_EQ(constraint.type, SQLITE_TEXT);
+  EXPECT_TRUE(constraint.getValue(integer));
+  EXPECT_EQ(integer, 12);
+}
+
+TEST_F(TablesTests, test_path_constraint_to_file_pattern) {
+  std::string pattern;
+  EXPECT_TRUE(pathConstraintToFilePattern(LIKE, "/etc/%_conf", pattern));
+  EXPECT_EQ(pattern, "/etc/%?conf");
+
+  EXPECT_TRUE(pathConstraintToFilePattern(GLOB, "/etc/[^a]*.conf", pattern));
+  EXPECT_EQ(pattern, "/etc/[!a]*.conf");
+
+  // An anchored expression is resolved below its literal directory prefix.
+  EXPECT_TRUE(
+      pathConstraintToFilePattern(REGEXP, "^/etc/ssh/.*\\.conf$", pattern));
+  EXPECT_EQ(pattern, "/etc/ssh/%%");
+  EXPECT_TRUE(pathConstraintToFilePattern(REGEXP, "^/etc/hosts?", pattern));
+  EXPECT_EQ(pattern, "/etc/%%");
+  EXPECT_TRUE(pathConstraintToFilePattern(REGEXP, "^/etc/\\.env$", pattern));
+  EXPECT_EQ(pattern, "/etc/.env");
+
+  // Unanchored expressions and alternations are not resolved.
+  EXPECT_FALSE(pathConstraintToFilePattern(REGEXP, "/etc/.*", pattern));
+  EXPECT_FALSE(pathConstraintToFilePattern(REGEXP, "^/etc|^/var", pattern));
+  EXPECT_FALSE(pathConstraintToFilePattern(REGEXP, "^[a-z]", pattern));
+  EXPECT_FALSE(pathConstraintToFilePattern(EQUALS, "/etc/hosts", pattern));
+}
+
 TEST_F(TablesTests, test_constraint_map) {
   ConstraintMap cm;
 
@@ -162,6 +236,24 @@ class TestTablePlugin : public TablePlugin {
     ctx.useCache(true);
     return isCached(interval, ctx);
   }
+
+  void testSetBootCache(QueryData rows) {
+    QueryContext ctx;
+    setBootCache(ctx, tableRowsFromQueryData(std::move(rows)));
+  }
+
+  bool testGetBootCache(QueryData& rows) {
+    QueryContext ctx;
+    TableRows results;
+    if (!getBootCache(ctx, results)) {
+      return false;
+    }
+    rows.clear();
+    for (const auto& row : results) {
+      rows.push_back(static_cast<Row>(*row));
+    }
+    return true;
+  }
 };
 
 TEST_F(TablesTests, test_caching) {
@@ -189,4 +281,184 @@ TEST_F(TablesTests, test_caching) {
   EXPECT_TRUE(test.testIsCached(6));
   EXPECT_FALSE(test.testIsCached(7));
 }
+
+TEST_F(TablesTests, test_boot_caching) {
+  TestTablePlugin test;
+  test.setName("boot_static_test");
+  deleteDatabaseValue(kQueries, "boot_cache.boot_static_test");
+
+  QueryData rows;
+  EXPECT_FALSE(test.testGetBootCache(rows));
+
+  // Results stored during this boot are found by later queries.
+  test.testSetBootCache({{{"model", "static"}}});
+  ASSERT_TRUE(test.testGetBootCache(rows));
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["model"], "static");
+
+  // Results of another boot are not used.
+  setDatabaseValue(
+      kQueries, "boot_cache.boot_static_test", "other boot\n0\n[]");
+  EXPECT_FALSE(test.testGetBootCache(rows));
+}
+
+TEST_F(TablesTests, test_parallel_table_tasks) {
+  auto threads = FLAGS_table_threads;
+  FLAGS_table_threads = 4;
+
+  // The budget caps the flag, and at least one thread is always used.
+  setTableWorkerBudget(2);
+  EXPECT_EQ(getTableWorkerCount(), 2U);
+  FLAGS_table_threads = 0;
+  EXPECT_EQ(getTableWorkerCount(), 1U);
+  FLAGS_table_threads = 4;
+  setTableWorkerBudget(0);
+
+  // Every task runs exactly once.
+  std::vector<size_t> results(500, 0);
+  std::atomic<size_t> calls{0};
+  runTableTasks(results.size(), [&](size_t i) {
+    results[i] += i * 2;
+    calls++;
+  });
+  EXPECT_EQ(calls, results.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(results[i], i * 2);
+  }
+
+  // Tasks may fan out again from within a worker.
+  std::atomic<size_t> nested{0};
+  runTableTasks(8, [&](size_t) {
+    runTableTasks(8, [&](size_t) { nested++; });
+  });
+  EXPECT_EQ(nested, 64U);
+
+  // A failing task does not stop the others, and the error is rethrown.
+  calls = 0;
+  EXPECT_THROW(runTableTasks(16,
+                             [&](size_t i) {
+                               calls++;
+                               if (i == 3) {
+                                 throw std::runtime_error("failed");
+                               }
+                             }),
+               std::runtime_error);
+  EXPECT_EQ(calls, 16U);
+
+  // Rows from every item are merged.
+  std::vector<size_t> items = {3, 0, 1, 2};
+  auto rows = generateRowsParallel(items, [](size_t item, TableRows& out) {
+    out.resize(item);
+  });
+  EXPECT_EQ(rows.size(), 6U);
+
+  FLAGS_table_threads = threads;
+}
+
+TEST_F(TablesTests, test_table_io_tasks) {
+  auto io_threads = FLAGS_table_io_threads;
+  FLAGS_table_io_threads = 8;
+
+  // Requests are outstanding together, beyond the CPU budget.
+  setTableWorkerBudget(1);
+  std::atomic<size_t> waiting{0};
+  std::atomic<size_t> most_waiting{0};
+  runTableIOTasks(8, [&](size_t) {
+    auto now_waiting = ++waiting;
+    auto most = most_waiting.load();
+    while (now_waiting > most &&
+           !most_waiting.compare_exchange_weak(most, now_waiting)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    waiting--;
+  });
+  EXPECT_GT(most_waiting, 1U);
+  setTableWorkerBudget(0);
+
+  // Started requests complete through their futures.
+  std::vector<std::future<size_t>> results;
+  for (size_t i = 0; i < 32; i++) {
+    results.push_back(runTableIOTask([i]() { return i * 2; }));
+  }
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(results[i].get(), i * 2);
+  }
+
+  auto failed = runTableIOTask([]() -> int {
+    throw std::runtime_error("failed");
+  });
+  EXPECT_THROW(failed.get(), std::runtime_error);
+
+  // Without I/O workers a request runs on the calling thread.
+  FLAGS_table_io_threads = 0;
+  auto caller = std::this_thread::get_id();
+  auto inline_result =
+      runTableIOTask([]() { return std::this_thread::get_id(); });
+  EXPECT_EQ(inline_result.get(), caller);
+
+  FLAGS_table_io_threads = io_threads;
+}
+
+TEST_F(TablesTests, test_scan_throttle_scope) {
+  auto throttle = FLAGS_scan_throttle;
+  auto threads = FLAGS_table_threads;
+  FLAGS_table_threads = 4;
+
+  // Without a scope the flag applies.
+  FLAGS_scan_throttle = true;
+  EXPECT_TRUE(ScanThrottleScope::enabled());
+  FLAGS_scan_throttle = false;
+  EXPECT_FALSE(ScanThrottleScope::enabled());
+
+  {
+    ScanThrottleScope scope(true);
+    EXPECT_TRUE(ScanThrottleScope::enabled());
+    {
+      ScanThrottleScope inner(false);
+      EXPECT_FALSE(ScanThrottleScope::enabled());
+    }
+    EXPECT_TRUE(ScanThrottleScope::enabled());
+
+    // Table workers throttle like the thread that started them.
+    std::atomic<size_t> throttled{0};
+    runTableTasks(64, [&](size_t) {
+      if (ScanThrottleScope::enabled()) {
+        throttled++;
+      }
+    });
+    EXPECT_EQ(throttled, 64U);
+  }
+  EXPECT_FALSE(ScanThrottleScope::enabled());
+
+  FLAGS_scan_throttle = throttle;
+  FLAGS_table_threads = threads;
+}
+
+TEST_F(TablesTests, test_scan_throttle_pause) {
+  auto pressure = FLAGS_scan_throttle_pressure;
+  FLAGS_scan_throttle_pressure = 10;
+
+  using std::chrono::milliseconds;
+  EXPECT_EQ(getScanThrottlePause(milliseconds(100), 0), milliseconds(0));
+  EXPECT_EQ(getScanThrottlePause(milliseconds(100), 10), milliseconds(0));
+
+  // Above the threshold the pause grows with the pressure.
+  EXPECT_EQ(getScanThrottlePause(milliseconds(100), 20), milliseconds(25));
+  EXPECT_EQ(getScanThrottlePause(milliseconds(100), 50), milliseconds(100));
+  EXPECT_EQ(getScanThrottlePause(milliseconds(100), 100), milliseconds(900));
+  EXPECT_EQ(getScanThrottlePause(milliseconds(500), 100), milliseconds(1000));
+
+  FLAGS_scan_throttle_pressure = pressure;
+
+  EXPECT_DOUBLE_EQ(
+      parsePressureStall("some avg10=12.50 avg60=3.00 avg300=1.00 total=10\n"
+                         "full avg10=2.00 avg60=1.00 avg300=0.50 total=5\n"),
+      12.5);
+  EXPECT_DOUBLE_EQ(parsePressureStall(""), 0);
+  EXPECT_DOUBLE_EQ(parsePressureStall("full avg10=2.00 avg60=1.00\n"), 0);
+
+  auto host = getHostPressure();
+  EXPECT_GE(host, 0);
+  EXPECT_LE(host, 100);
+}
 }
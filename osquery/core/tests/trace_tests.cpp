@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/trace.h>
+#include <osquery/utils/json/json.h>
+
+namespace osquery {
+
+DECLARE_bool(trace_spans);
+
+class TraceTests : public testing::Test {
+ protected:
+  void TearDown() override {
+    FLAGS_trace_spans = false;
+  }
+
+  /// Count the serialized spans with the given name and detail.
+  size_t countSpans(const std::string& name, const std::string& detail) {
+    std::string json;
+    EXPECT_TRUE(serializeTrace(json).ok());
+    auto doc = JSON::newObject();
+    EXPECT_TRUE(doc.fromString(json).ok());
+
+    size_t count = 0;
+    for (const auto& event : doc.doc()["traceEvents"].GetArray()) {
+      if (name == event["name"].GetString() && event.HasMember("args") &&
+          detail == event["args"]["detail"].GetString()) {
+        EXPECT_EQ(std::string("X"), event["ph"].GetString());
+        count++;
+      }
+    }
+    return count;
+  }
+};
+
+TEST_F(TraceTests, test_spans_disabled) {
+  FLAGS_trace_spans = false;
+  { TraceSpan span("test", "disabled", "trace_tests_disabled"); }
+  EXPECT_EQ(0U, countSpans("disabled", "trace_tests_disabled"));
+}
+
+TEST_F(TraceTests, test_spans_recorded) {
+  FLAGS_trace_spans = true;
+  {
+    TraceSpan outer("test", "outer", "trace_tests_recorded");
+    { TraceSpan inner("test", "inner", "trace_tests_recorded"); }
+  }
+  std::thread([] {
+    TraceSpan span("test", "thread", "trace_tests_recorded");
+  }).join();
+
+  EXPECT_EQ(1U, countSpans("outer", "trace_tests_recorded"));
+  EXPECT_EQ(1U, countSpans("inner", "trace_tests_recorded"));
+  // Spans of exited threads are kept.
+  EXPECT_EQ(1U, countSpans("thread", "trace_tests_recorded"));
+}
+
+TEST_F(TraceTests, test_spans_truncate_detail) {
+  FLAGS_trace_spans = true;
+  std::string detail(kTraceDetailSize * 2, 'a');
+  { TraceSpan span("test", "truncated", detail); }
+  EXPECT_EQ(1U,
+            countSpans("truncated", detail.substr(0, kTraceDetailSize - 1)));
+}
+} // namespace osquery
@@ -25,6 +25,7 @@ using namespace testing;
 namespace osquery {
 
 DECLARE_uint64(watchdog_delay);
+DECLARE_uint64(watchdog_utilization_burst);
 
 class WatcherTests : public testing::Test {
  protected:
@@ -279,6 +280,40 @@ TEST_F(WatcherTests, test_watcherrunner_watcherhealth) {
   EXPECT_EQ(2U, state.sustained_latency);
 }
 
+TEST_F(WatcherTests, test_watcherrunner_utilization_burst) {
+  FakeWatcherRunner runner(0, nullptr, true);
+  auto test_process = PlatformProcess::getCurrentProcess();
+
+  Row r;
+  r["parent"] = INTEGER(1);
+  r["user_time"] = INTEGER(100);
+  r["system_time"] = INTEGER(0);
+  r["resident_size"] = INTEGER(100);
+  runner.setProcessRow({r});
+
+  PerformanceState state;
+  EXPECT_TRUE(runner.isWatcherHealthy(*test_process, state));
+
+  // Allow far more CPU time above the limit than this test will use.
+  auto burst = FLAGS_watchdog_utilization_burst;
+  FLAGS_watchdog_utilization_burst = 1024 * 1024;
+
+  r["user_time"] = INTEGER(1024 * 1024 * 100);
+  runner.setProcessRow({r});
+  runner.isWatcherHealthy(*test_process, state);
+  EXPECT_EQ(0U, state.sustained_latency);
+  EXPECT_GT(state.burst_used, 0U);
+
+  // Without an allowance the same increase counts as latency.
+  FLAGS_watchdog_utilization_burst = 0;
+  r["user_time"] = INTEGER(1024 * 1024 * 200);
+  runner.setProcessRow({r});
+  runner.isWatcherHealthy(*test_process, state);
+  EXPECT_EQ(1U, state.sustained_latency);
+
+  FLAGS_watchdog_utilization_burst = burst;
+}
+
 TEST_F(WatcherTests, test_watcherrunner_unhealthy_delay) {
   FakeWatcherRunner runner(0, nullptr, true);
 
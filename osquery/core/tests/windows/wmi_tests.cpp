@@ -119,4 +119,26 @@ TEST_F(WmiTests, test_methodcall_outparams) {
   EXPECT_EQ(domain_name, "NT AUTHORITY");
 }
 
+TEST_F(WmiTests, test_stream_and_shared_connection) {
+  auto query = "SELECT * FROM Win32_Process WHERE Name = \"wininit.exe\"";
+
+  size_t streamed = 0U;
+  std::string name;
+  auto status = WmiRequest::stream(query, [&](const WmiResultItem& item) {
+    item.GetString("Name", name);
+    streamed++;
+  });
+  EXPECT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(streamed, 1U);
+  EXPECT_EQ(name, "wininit.exe");
+
+  // Later requests reuse the namespace connection
+  WmiRequest req(query);
+  EXPECT_TRUE(req.getStatus().ok());
+  EXPECT_EQ(req.results().size(), streamed);
+
+  status = WmiRequest::stream("SELECT * FROM Win32_DoesNotExist",
+                              [](const WmiResultItem&) {});
+  EXPECT_FALSE(status.ok());
+}
 } // namespace osquery
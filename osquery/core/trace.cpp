@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/trace.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/process/process.h>
+#include <osquery/utils/json/json.h>
+
+namespace osquery {
+
+FLAG(bool,
+     trace_spans,
+     false,
+     "Record spans of table planning and generation, differentials, "
+     "database writes and logger sends");
+
+namespace {
+
+/// The most recent spans kept for each thread.
+const size_t kTraceRingSize = 4096;
+
+/// The rings of exited threads kept until newer threads replace them.
+const size_t kTraceExitedRings = 16;
+
+struct TraceEvent {
+  const char* category{nullptr};
+  const char* name{nullptr};
+  uint64_t start{0};
+  uint64_t duration{0};
+  char detail[kTraceDetailSize];
+};
+
+struct TraceRing {
+  explicit TraceRing(uint64_t thread) : id(thread), events(kTraceRingSize) {}
+
+  const uint64_t id;
+
+  /// Only contended while the spans are serialized.
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+  size_t next{0};
+  size_t size{0};
+
+  std::atomic<bool> exited{false};
+};
+
+class TraceRings {
+ public:
+  static TraceRings& get() {
+    static TraceRings instance;
+    return instance;
+  }
+
+  std::shared_ptr<TraceRing> add() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto exited = static_cast<size_t>(std::count_if(
+        rings_.begin(), rings_.end(), [](const auto& ring) {
+          return ring->exited.load();
+        }));
+    // Forget the oldest exited threads, thread pools create new threads.
+    for (auto it = rings_.begin();
+         it != rings_.end() && exited > kTraceExitedRings;) {
+      if ((*it)->exited) {
+        it = rings_.erase(it);
+        exited--;
+      } else {
+        ++it;
+      }
+    }
+
+    rings_.push_back(std::make_shared<TraceRing>(++threads_));
+    return rings_.back();
+  }
+
+  std::vector<std::shared_ptr<TraceRing>> rings() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rings_;
+  }
+
+ private:
+  std::vector<std::shared_ptr<TraceRing>> rings_;
+  uint64_t threads_{0};
+  std::mutex mutex_;
+};
+
+struct TraceThread {
+  ~TraceThread() {
+    if (ring != nullptr) {
+      ring->exited = true;
+    }
+  }
+
+  std::shared_ptr<TraceRing> ring;
+};
+
+TraceRing& traceRing() {
+  thread_local TraceThread thread;
+  if (thread.ring == nullptr) {
+    thread.ring = TraceRings::get().add();
+  }
+  return *thread.ring;
+}
+
+uint64_t traceNow() {
+  static const auto origin = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - origin)
+      .count();
+}
+
+} // namespace
+
+TraceSpan::TraceSpan(const char* category, const char* name) {
+  if (!FLAGS_trace_spans) {
+    return;
+  }
+  category_ = category;
+  name_ = name;
+  detail_[0] = '\0';
+  start_ = traceNow();
+}
+
+TraceSpan::TraceSpan(const char* category,
+                     const char* name,
+                     const std::string& detail) {
+  if (!FLAGS_trace_spans) {
+    return;
+  }
+  category_ = category;
+  name_ = name;
+  auto size = std::min(detail.size(), kTraceDetailSize - 1);
+  std::memcpy(detail_, detail.data(), size);
+  detail_[size] = '\0';
+  start_ = traceNow();
+}
+
+TraceSpan::~TraceSpan() {
+  if (category_ == nullptr) {
+    return;
+  }
+
+  auto end = traceNow();
+  auto& ring = traceRing();
+  std::lock_guard<std::mutex> lock(ring.mutex);
+  auto& event = ring.events[ring.next];
+  event.category = category_;
+  event.name = name_;
+  event.start = start_;
+  event.duration = end - start_;
+  std::memcpy(event.detail, detail_, sizeof(detail_));
+  ring.next = (ring.next + 1) % kTraceRingSize;
+  ring.size = std::min(ring.size + 1, kTraceRingSize);
+}
+
+Status serializeTrace(std::string& json) {
+  auto doc = JSON::newObject();
+  auto events = doc.getArray();
+  auto pid = PlatformProcess::getCurrentPid();
+  for (const auto& ring : TraceRings::get().rings()) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    auto first = (ring->next + kTraceRingSize - ring->size) % kTraceRingSize;
+    for (size_t i = 0; i < ring->size; i++) {
+      const auto& event = ring->events[(first + i) % kTraceRingSize];
+      auto obj = doc.getObject();
+      doc.add("name", event.name, obj);
+      doc.add("cat", event.category, obj);
+      doc.add("ph", "X", obj);
+      doc.add("ts", static_cast<unsigned long long>(event.start), obj);
+      doc.add("dur", static_cast<unsigned long long>(event.duration), obj);
+      doc.add("pid", pid, obj);
+      doc.add("tid", static_cast<unsigned long long>(ring->id), obj);
+      if (event.detail[0] != '\0') {
+        auto args = doc.getObject();
+        doc.add("detail", event.detail, args);
+        doc.add("args", args, obj);
+      }
+      doc.push(obj, events);
+    }
+  }
+  doc.add("traceEvents", events);
+  doc.add("displayTimeUnit", "ms");
+  return doc.toString(json);
+}
+
+Status writeTrace(const std::string& path) {
+  std::string json;
+  auto status = serializeTrace(json);
+  if (!status.ok()) {
+    return status;
+  }
+  return writeTextFile(path, json, 0640, PF_CREATE_ALWAYS | PF_WRITE);
+}
+
+} // namespace osquery
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The bytes of a span's detail kept, longer details are truncated.
+constexpr size_t kTraceDetailSize = 48;
+
+/**
+ * @brief Record the duration of a scope into the calling thread's trace ring.
+ *
+ * Spans are only recorded while --trace_spans is enabled. Each thread owns a
+ * ring of the most recent spans, recording a span never takes a shared lock.
+ * Use the OSQUERY_TRACE_SPAN macros, builds configured without
+ * OSQUERY_ENABLE_TRACING compile the instrumentation out.
+ */
+class TraceSpan : private boost::noncopyable {
+ public:
+  /// The category and name must be string literals.
+  TraceSpan(const char* category, const char* name);
+
+  /// The detail, such as a table or query name, is copied.
+  TraceSpan(const char* category, const char* name, const std::string& detail);
+
+  ~TraceSpan();
+
+ private:
+  const char* category_{nullptr};
+  const char* name_{nullptr};
+  uint64_t start_{0};
+  char detail_[kTraceDetailSize];
+};
+
+/// Serialize the recorded spans of every thread as a Chrome trace document.
+Status serializeTrace(std::string& json);
+
+/// Write the recorded spans to a file, readable by Perfetto or about:tracing.
+Status writeTrace(const std::string& path);
+
+} // namespace osquery
+
+#ifdef OSQUERY_TRACING
+#define OSQUERY_TRACE_CONCAT_(a, b) a##b
+#define OSQUERY_TRACE_CONCAT(a, b) OSQUERY_TRACE_CONCAT_(a, b)
+#define OSQUERY_TRACE_SPAN(category, name)                                     \
+  ::osquery::TraceSpan OSQUERY_TRACE_CONCAT(trace_span_, __LINE__)(category,   \
+                                                                   name)
+#define OSQUERY_TRACE_SPAN_DETAIL(category, name, detail)                      \
+  ::osquery::TraceSpan OSQUERY_TRACE_CONCAT(trace_span_, __LINE__)(            \
+      category, name, detail)
+#else
+#define OSQUERY_TRACE_SPAN(category, name)                                     \
+  do {                                                                         \
+  } while (false)
+#define OSQUERY_TRACE_SPAN_DETAIL(category, name, detail)                      \
+  do {                                                                         \
+  } while (false)
+#endif
@@ -8,16 +8,24 @@
  */
 
 #include <chrono>
+#include <map>
 #include <cstring>
 
 #include <math.h>
 #include <signal.h>
 
 #ifndef WIN32
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __APPLE__
+#include <libproc.h>
 #endif
 
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
 
 #include <osquery/config/config.h>
@@ -32,6 +40,7 @@
 #include <osquery/process/process.h>
 #include <osquery/sql/sql.h>
 
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/tool_type.h>
 #include <osquery/utils/system/time.h>
@@ -128,11 +137,178 @@ CLI_FLAG(bool,
 
 CLI_FLAG(bool, disable_watchdog, false, "Disable userland watchdog process");
 
+CLI_FLAG(uint64,
+         watchdog_utilization_window,
+         0,
+         "Seconds over which watchdog CPU utilization is averaged (default 0, "
+         "each interval is checked alone)");
+
+CLI_FLAG(uint64,
+         watchdog_utilization_burst,
+         0,
+         "Seconds of CPU time above the utilization limit tolerated before "
+         "the latency limit applies (default 0)");
+
+namespace {
+
+#ifdef __linux__
+/// Milliseconds in a clock tick, the unit of /proc/<pid>/stat CPU times.
+const auto kMSInClockTick = 1000 / std::max(sysconf(_SC_CLK_TCK), 1L);
+
+const auto kPageSize = sysconf(_SC_PAGESIZE);
+
+/**
+ * @brief Sample a process from procfs, keeping its stat files open.
+ *
+ * The watcher checks the same few processes every interval. Reading an open
+ * descriptor of a process that exited fails, so a reused pid is reopened.
+ */
+class ProcessSampler : private boost::noncopyable {
+ public:
+  ~ProcessSampler() {
+    for (auto& files : files_) {
+      closeFiles(files.second);
+    }
+  }
+
+  bool sample(pid_t pid, Row& r) {
+    std::string stat;
+    std::string statm;
+    for (size_t attempt = 0; attempt < 2; attempt++) {
+      auto& files = files_[pid];
+      if (files.stat == -1 && !openFiles(pid, files)) {
+        files_.erase(pid);
+        return false;
+      }
+      if (readFile(files.stat, stat) && readFile(files.statm, statm)) {
+        break;
+      }
+      closeFiles(files);
+      files_.erase(pid);
+      stat.clear();
+    }
+
+    // The command may contain spaces, fields are counted after it.
+    auto command_end = stat.rfind(')');
+    if (stat.empty() || command_end == std::string::npos) {
+      return false;
+    }
+    auto fields = osquery::split(stat.substr(command_end + 2), " ");
+    auto resident = osquery::split(statm, " ");
+    if (fields.size() < 13 || resident.size() < 2) {
+      return false;
+    }
+
+    auto ticks = [](const std::string& value) {
+      return tryTo<long long>(value).takeOr(0LL) * kMSInClockTick;
+    };
+    r["parent"] = fields[1];
+    r["user_time"] = BIGINT(ticks(fields[11]));
+    r["system_time"] = BIGINT(ticks(fields[12]));
+    r["resident_size"] =
+        BIGINT(tryTo<long long>(resident[1]).takeOr(0LL) * kPageSize);
+
+    // Drop the files of processes no longer watched.
+    if (files_.size() > kMaxSampledProcesses) {
+      for (auto& files : files_) {
+        if (files.first != pid) {
+          closeFiles(files.second);
+        }
+      }
+      auto current = files_[pid];
+      files_.clear();
+      files_[pid] = current;
+    }
+    return true;
+  }
+
+ private:
+  struct Files {
+    int stat{-1};
+    int statm{-1};
+  };
+
+  static bool openFiles(pid_t pid, Files& files) {
+    auto path = "/proc/" + std::to_string(pid);
+    files.stat = ::open((path + "/stat").c_str(), O_RDONLY | O_CLOEXEC);
+    files.statm = ::open((path + "/statm").c_str(), O_RDONLY | O_CLOEXEC);
+    if (files.stat == -1 || files.statm == -1) {
+      closeFiles(files);
+      return false;
+    }
+    return true;
+  }
+
+  static void closeFiles(Files& files) {
+    if (files.stat != -1) {
+      ::close(files.stat);
+    }
+    if (files.statm != -1) {
+      ::close(files.statm);
+    }
+    files.stat = -1;
+    files.statm = -1;
+  }
+
+  static bool readFile(int fd, std::string& content) {
+    char buffer[1024];
+    auto size = ::pread(fd, buffer, sizeof(buffer) - 1, 0);
+    if (size <= 0) {
+      return false;
+    }
+    content.assign(buffer, static_cast<size_t>(size));
+    return true;
+  }
+
+ private:
+  /// The worker, the watcher and each autoloaded extension.
+  static const size_t kMaxSampledProcesses{64};
+
+  std::map<pid_t, Files> files_;
+};
+#endif
+
+/// Sample a process without the processes table, false if unsupported.
+bool sampleProcess(pid_t pid, Row& r) {
+#if defined(__linux__)
+  static Mutex sampler_mutex;
+  static ProcessSampler sampler;
+  WriteLock lock(sampler_mutex);
+  return sampler.sample(pid, r);
+#elif defined(__APPLE__)
+  struct proc_bsdshortinfo info;
+  if (proc_pidinfo(pid, PROC_PIDT_SHORTBSDINFO, 1, &info, sizeof(info)) !=
+      sizeof(info)) {
+    return false;
+  }
+
+  struct rusage_info_v2 usage;
+  if (proc_pid_rusage(pid, RUSAGE_INFO_V2, (rusage_info_t*)&usage) != 0) {
+    return false;
+  }
+
+  // Match the processes table, which reports CPU times in milliseconds.
+  r["parent"] = BIGINT(info.pbsi_ppid);
+  r["user_time"] = BIGINT(usage.ri_user_time / 1000000);
+  r["system_time"] = BIGINT(usage.ri_system_time / 1000000);
+  r["resident_size"] = BIGINT(usage.ri_resident_size);
+  return true;
+#else
+  (void)pid;
+  (void)r;
+  return false;
+#endif
+}
+
+} // namespace
+
 void Watcher::resetWorkerCounters(uint64_t respawn_time) {
   // Reset the monitoring counters for the watcher.
   state_.sustained_latency = 0;
   state_.user_time = 0;
   state_.system_time = 0;
+  state_.average_cpu_time = 0;
+  state_.burst_used = 0;
   state_.last_respawn_time = respawn_time;
 }
 
@@ -143,6 +319,8 @@ void Watcher::resetExtensionCounters(const std::string& extension,
   state.sustained_latency = 0;
   state.user_time = 0;
   state.system_time = 0;
+  state.average_cpu_time = 0;
+  state.burst_used = 0;
   state.last_respawn_time = respawn_time;
 }
 
@@ -420,6 +598,35 @@ PerformanceChange getChange(const Row& r, PerformanceState& state) {
   auto sys_time_diff = system_time - state.system_time;
   UNSIGNED_BIGINT_LITERAL cpu_utilization_time = user_time_diff + sys_time_diff;
 
+  // Optionally average the CPU time of recent intervals.
+  if (FLAGS_watchdog_utilization_window > change.iv &&
+      state.user_time + state.system_time > 0) {
+    auto alpha = static_cast<double>(change.iv) /
+                 static_cast<double>(FLAGS_watchdog_utilization_window);
+    state.average_cpu_time = alpha * static_cast<double>(cpu_utilization_time) +
+                             (1 - alpha) * state.average_cpu_time;
+    cpu_utilization_time =
+        static_cast<UNSIGNED_BIGINT_LITERAL>(state.average_cpu_time);
+  } else {
+    state.average_cpu_time = static_cast<double>(cpu_utilization_time);
+  }
+
+  // CPU time above the limit first spends the burst allowance, and time
+  // below the limit earns it back.
+  auto burst = FLAGS_watchdog_utilization_burst * 1000;
+  if (cpu_utilization_time > cpu_ul) {
+    auto excess = cpu_utilization_time - cpu_ul;
+    if (state.burst_used + excess <= burst) {
+      state.burst_used += excess;
+      cpu_utilization_time = cpu_ul;
+    } else {
+      state.burst_used = burst;
+    }
+  } else {
+    auto unused = cpu_ul - cpu_utilization_time;
+    state.burst_used -= std::min(state.burst_used, unused);
+  }
+
   if (cpu_utilization_time > cpu_ul) {
     state.sustained_latency++;
   } else {
@@ -493,6 +700,14 @@ QueryData WatcherRunner::getProcessRow(pid_t pid) const {
 #ifdef WIN32
   p = (pid == ULONG_MAX) ? -1 : pid;
 #endif
+
+  // Avoid a processes table query, which enumerates processes, when the
+  // platform can sample a single process directly.
+  Row r;
+  if (p > 0 && sampleProcess(pid, r)) {
+    return {r};
+  }
+
   return SQL::selectFrom(
       {"parent", "user_time", "system_time", "resident_size"},
       "processes",
@@ -63,6 +63,10 @@ struct PerformanceState {
   uint64_t user_time;
   /// The last checked system CPU time.
   uint64_t system_time;
+  /// The averaged CPU time of an interval, see watchdog_utilization_window.
+  double average_cpu_time;
+  /// CPU time above the limit spent from the watchdog_utilization_burst.
+  uint64_t burst_used;
   /// A timestamp when the process/worker was last created.
   uint64_t last_respawn_time;
 
@@ -73,6 +77,8 @@ struct PerformanceState {
     sustained_latency = 0;
     user_time = 0;
     system_time = 0;
+    average_cpu_time = 0;
+    burst_used = 0;
     last_respawn_time = 0;
     initial_footprint = 0;
   }
@@ -305,7 +311,7 @@ class WatcherRunner : public InternalRunnable {
   virtual Status isWatcherHealthy(const PlatformProcess& watcher,
                                   PerformanceState& watcher_state) const;
 
-  /// Get row data from the processes table for a given pid.
+  /// Get CPU and memory usage for a given pid, as processes table columns.
   virtual QueryData getProcessRow(pid_t pid) const;
 
  private:
@@ -351,6 +357,7 @@ class WatcherRunner : public InternalRunnable {
   FRIEND_TEST(WatcherTests, test_watcherrunner_loop_disabled);
   FRIEND_TEST(WatcherTests, test_watcherrunner_watcherhealth);
   FRIEND_TEST(WatcherTests, test_watcherrunner_unhealthy_delay);
+  FRIEND_TEST(WatcherTests, test_watcherrunner_utilization_burst);
 };
 
 /// The WatcherWatcher is spawned within the worker and watches the watcher.
@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <array>
 #include <locale>
+#include <mutex>
 #include <string>
 
 #include <osquery/core/windows/wmi.h>
@@ -16,6 +18,184 @@
 
 namespace osquery {
 
+namespace {
+
+/// Objects requested from a WMI enumerator per round trip
+const ULONG kWmiEnumBatchSize = 64U;
+
+using WmiServicesRef = std::shared_ptr<IWbemServices>;
+
+/// The WMI connections shared by every request, one per namespace
+struct WmiConnections final {
+  std::mutex mutex;
+  std::unique_ptr<IWbemLocator, impl::WmiObjectDeleter> locator{nullptr};
+  std::unordered_map<std::wstring, WmiServicesRef> services;
+};
+
+WmiConnections& wmiConnections() {
+  // Never destroyed: COM may already be uninitialized at static destruction
+  static auto* connections = new WmiConnections;
+  return *connections;
+}
+
+/// Returns true if the error means the cached connection must be replaced
+bool isWmiDisconnected(HRESULT hr) {
+  return hr == RPC_E_DISCONNECTED || hr == RPC_E_SERVER_DIED ||
+         hr == RPC_E_SERVER_DIED_DNE || hr == WBEM_E_TRANSPORT_FAILURE ||
+         hr == HRESULT_FROM_WIN32(RPC_S_SERVER_UNAVAILABLE) ||
+         hr == HRESULT_FROM_WIN32(RPC_S_CALL_FAILED);
+}
+
+Status getWmiServices(const std::wstring& nspace, WmiServicesRef& services) {
+  static std::once_flag security_initialized;
+  std::call_once(security_initialized, []() {
+    ::CoInitializeSecurity(nullptr,
+                           -1,
+                           nullptr,
+                           nullptr,
+                           RPC_C_AUTHN_LEVEL_DEFAULT,
+                           RPC_C_IMP_LEVEL_IMPERSONATE,
+                           nullptr,
+                           EOAC_NONE,
+                           nullptr);
+  });
+
+  auto& connections = wmiConnections();
+  std::lock_guard<std::mutex> lock(connections.mutex);
+
+  auto it = connections.services.find(nspace);
+  if (it != connections.services.end()) {
+    services = it->second;
+    return Status::success();
+  }
+
+  if (connections.locator == nullptr) {
+    IWbemLocator* locator = nullptr;
+    auto hr = ::CoCreateInstance(CLSID_WbemLocator,
+                                 0,
+                                 CLSCTX_INPROC_SERVER,
+                                 IID_IWbemLocator,
+                                 (LPVOID*)&locator);
+    if (hr != S_OK) {
+      return Status::failure("Failed to create the WMI locator");
+    }
+    connections.locator.reset(locator);
+  }
+
+  BSTR nspace_str = SysAllocString(nspace.c_str());
+  if (nullptr == nspace_str) {
+    return Status::failure("Out of memory");
+  }
+
+  IWbemServices* raw_services = nullptr;
+  auto hr = connections.locator->ConnectServer(nspace_str,
+                                               nullptr,
+                                               nullptr,
+                                               nullptr,
+                                               0,
+                                               nullptr,
+                                               nullptr,
+                                               &raw_services);
+  SysFreeString(nspace_str);
+
+  if (hr != S_OK) {
+    return Status::failure("Failed to connect to the WMI namespace " +
+                           wstringToString(nspace.c_str()));
+  }
+
+  services =
+      WmiServicesRef(raw_services, [](IWbemServices* ptr) { ptr->Release(); });
+  connections.services.insert({nspace, services});
+  return Status::success();
+}
+
+void dropWmiServices(const std::wstring& nspace,
+                     const WmiServicesRef& services) {
+  auto& connections = wmiConnections();
+  std::lock_guard<std::mutex> lock(connections.mutex);
+
+  auto it = connections.services.find(nspace);
+  if (it != connections.services.end() && it->second == services) {
+    connections.services.erase(it);
+  }
+}
+
+/// Starts a semi-synchronous query; the objects are fetched as the
+/// enumerator is walked
+Status execWmiQuery(const std::string& query,
+                    const std::wstring& nspace,
+                    WmiServicesRef& services,
+                    IEnumWbemClassObject*& wbem_enum) {
+  BSTR language_str = SysAllocString(L"WQL");
+  if (nullptr == language_str) {
+    return Status::failure("Out of memory");
+  }
+
+  BSTR wql_str = SysAllocString(stringToWstring(query).c_str());
+  if (nullptr == wql_str) {
+    SysFreeString(language_str);
+    return Status::failure("Out of memory");
+  }
+
+  Status status;
+  for (std::size_t attempt = 0U; attempt < 2U; ++attempt) {
+    status = getWmiServices(nspace, services);
+    if (!status.ok()) {
+      break;
+    }
+
+    auto hr = services->ExecQuery(
+        language_str,
+        wql_str,
+        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+        nullptr,
+        &wbem_enum);
+    if (hr == S_OK) {
+      status = Status::success();
+      break;
+    }
+
+    status = Status::failure("Failed to execute the WMI query");
+    if (!isWmiDisconnected(hr)) {
+      break;
+    }
+
+    // The WMI service was restarted; reconnect once
+    dropWmiServices(nspace, services);
+    services.reset();
+  }
+
+  SysFreeString(wql_str);
+  SysFreeString(language_str);
+  return status;
+}
+
+/// Walks an enumerator in batches, passing each object to the callback
+template <typename Callback>
+Status forEachWmiResult(IEnumWbemClassObject* wbem_enum,
+                        const Callback& callback) {
+  HRESULT hr = WBEM_S_NO_ERROR;
+  while (hr == WBEM_S_NO_ERROR) {
+    std::array<IWbemClassObject*, kWmiEnumBatchSize> objects{};
+    ULONG result_count = 0U;
+
+    hr = wbem_enum->Next(
+        WBEM_INFINITE, kWmiEnumBatchSize, objects.data(), &result_count);
+    if (FAILED(hr)) {
+      return Status::failure("Failed to enumerate the WMI query results");
+    }
+
+    for (ULONG i = 0U; i < result_count; ++i) {
+      WmiResultItem item(objects[i]);
+      callback(item);
+    }
+  }
+
+  return Status::success();
+}
+
+} // namespace
+
 WmiMethodArgs::WmiMethodArgs(WmiMethodArgs&& src) {
   std::swap(arguments, src.arguments);
 }
@@ -361,81 +541,34 @@ Status WmiResultItem::GetVectorOfLongs(const std::string& name,
 }
 
 WmiRequest::WmiRequest(const std::string& query, std::wstring nspace) {
-  std::wstring wql = stringToWstring(query);
-
-  HRESULT hr = E_FAIL;
-
-  IWbemLocator* locator = nullptr;
-  hr = ::CoInitializeSecurity(nullptr,
-                              -1,
-                              nullptr,
-                              nullptr,
-                              RPC_C_AUTHN_LEVEL_DEFAULT,
-                              RPC_C_IMP_LEVEL_IMPERSONATE,
-                              nullptr,
-                              EOAC_NONE,
-                              nullptr);
-  hr = ::CoCreateInstance(CLSID_WbemLocator,
-                          0,
-                          CLSCTX_INPROC_SERVER,
-                          IID_IWbemLocator,
-                          (LPVOID*)&locator);
-  if (hr != S_OK) {
-    return;
-  }
-  locator_.reset(locator);
-
-  IWbemServices* services = nullptr;
-  BSTR nspace_str = SysAllocString(nspace.c_str());
-  if (nullptr == nspace_str) {
-    return;
-  }
-
-  hr = locator_->ConnectServer(
-      nspace_str, nullptr, nullptr, nullptr, 0, nullptr, nullptr, &services);
-  SysFreeString(nspace_str);
-
-  if (hr != S_OK) {
-    return;
-  }
-  services_.reset(services);
-
   IEnumWbemClassObject* wbem_enum = nullptr;
-
-  BSTR language_str = SysAllocString(L"WQL");
-  if (nullptr == language_str) {
-    return;
-  }
-
-  BSTR wql_str = SysAllocString(wql.c_str());
-  if (nullptr == wql_str) {
-    SysFreeString(language_str);
-    return;
-  }
-
-  hr = services_->ExecQuery(
-      language_str, wql_str, WBEM_FLAG_FORWARD_ONLY, nullptr, &wbem_enum);
-
-  SysFreeString(wql_str);
-  SysFreeString(language_str);
-  if (hr != S_OK) {
+  if (!execWmiQuery(query, nspace, services_, wbem_enum).ok()) {
     return;
   }
 
   enum_.reset(wbem_enum);
 
-  hr = WBEM_S_NO_ERROR;
-  while (hr == WBEM_S_NO_ERROR) {
-    IWbemClassObject* result = nullptr;
-    ULONG result_count = 0;
+  forEachWmiResult(enum_.get(), [this](WmiResultItem& item) {
+    results_.push_back(std::move(item));
+  });
 
-    hr = enum_->Next(WBEM_INFINITE, 1, &result, &result_count);
-    if (SUCCEEDED(hr) && result_count > 0) {
-      results_.emplace_back(result);
-    }
+  status_ = Status(0);
+}
+
+Status WmiRequest::stream(const std::string& query,
+                          const WmiResultCallback& callback,
+                          std::wstring nspace) {
+  WmiServicesRef services;
+  IEnumWbemClassObject* raw_enum = nullptr;
+  auto status = execWmiQuery(query, nspace, services, raw_enum);
+  if (!status.ok()) {
+    return status;
   }
 
-  status_ = Status(0);
+  std::unique_ptr<IEnumWbemClassObject, impl::WmiObjectDeleter> wbem_enum(
+      raw_enum);
+  return forEachWmiResult(
+      wbem_enum.get(), [&callback](WmiResultItem& item) { callback(item); });
 }
 
 Status WmiRequest::ExecMethod(const WmiResultItem& object,
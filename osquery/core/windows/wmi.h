@@ -218,11 +218,18 @@ class WmiResultItem {
   std::unique_ptr<IWbemClassObject, impl::WmiObjectDeleter> result_{nullptr};
 };
 
+/// Called for each object returned by a streamed WMI query
+using WmiResultCallback = std::function<void(const WmiResultItem& item)>;
+
 /**
  * @brief Windows wrapper class for querying WMI
  *
  * This class abstracts away the WMI querying logic and
  * will return WMI results given a query string.
+ *
+ * Connections to a WMI namespace are shared by every request and kept open
+ * for the life of the process; a connection is only re-established if WMI
+ * reports it as disconnected.
  */
 class WmiRequest {
  public:
@@ -254,12 +261,21 @@ class WmiRequest {
                     const WmiMethodArgs& args,
                     WmiResultItem& out_result) const;
 
+  /**
+   * @brief Run a WMI query, passing each object to the callback as WMI
+   * returns it instead of buffering every result
+   *
+   * @returns Status indicating the success of the query
+   */
+  static Status stream(const std::string& query,
+                       const WmiResultCallback& callback,
+                       std::wstring nspace = L"ROOT\\CIMV2");
+
  private:
   Status status_;
   std::vector<WmiResultItem> results_;
 
   std::unique_ptr<IEnumWbemClassObject, impl::WmiObjectDeleter> enum_{nullptr};
-  std::unique_ptr<IWbemLocator, impl::WmiObjectDeleter> locator_{nullptr};
-  std::unique_ptr<IWbemServices, impl::WmiObjectDeleter> services_{nullptr};
+  std::shared_ptr<IWbemServices> services_{nullptr};
 };
 } // namespace osquery
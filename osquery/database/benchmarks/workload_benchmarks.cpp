@@ -0,0 +1,372 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+/**
+ * Benchmark the storage access patterns of a running daemon.
+ *
+ * Every benchmark takes the backend as its first argument: 0 for the
+ * ephemeral plugin and 1 for RocksDB in a temporary directory. The data sizes
+ * default to a small and a large workload and may be overridden with:
+ *   - OSQUERY_BENCHMARK_EVENTS: events stored before each sweep or retrieval.
+ *   - OSQUERY_BENCHMARK_LOGS: buffered log lines drained per iteration.
+ *   - OSQUERY_BENCHMARK_ROWS: rows of each differential result set.
+ *
+ * Throughput is reported as items (events, lines or rows) per second, which
+ * is the figure to compare against a host's event rate when sizing
+ * --events_max and --events_expiry.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/query.h>
+#include <osquery/core/sql/query_batch.h>
+#include <osquery/database/database.h>
+#include <osquery/events/eventpublisher.h>
+#include <osquery/events/eventsubscriber.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/env.h>
+#include <osquery/utils/system/time.h>
+
+#include <plugins/logger/buffered.h>
+
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_string(database_path);
+
+namespace {
+
+/// The database plugins selected by the first benchmark argument.
+const std::vector<std::string> kBackends = {"ephemeral", "rocksdb"};
+
+/// Events stored per publisher callback by the sweep and retrieval benchmarks.
+const size_t kEventsPerBatch{100};
+
+int64_t benchmarkSize(const std::string& variable, int64_t size) {
+  auto value = getEnvVar(variable);
+  if (value.is_initialized()) {
+    return tryTo<int64_t>(*value).takeOr(size);
+  }
+  return size;
+}
+
+/// Use a fresh database of the selected backend for the scope of a benchmark.
+class BackendDatabase {
+ public:
+  explicit BackendDatabase(int64_t backend) : name_(kBackends.at(backend)) {
+    auto& rf = RegistryFactory::get();
+    previous_plugin_ = rf.getActive("database");
+    rf.plugin("database", previous_plugin_)->tearDown();
+
+    previous_path_ = FLAGS_database_path;
+    path_ = fs::temp_directory_path() /
+            fs::unique_path("osquery.benchmark.%%%%.%%%%.db");
+    FLAGS_database_path = path_.string();
+
+    auto plugin =
+        std::dynamic_pointer_cast<DatabasePlugin>(rf.plugin("database", name_));
+    plugin->reset();
+    rf.setActive("database", name_);
+  }
+
+  ~BackendDatabase() {
+    auto& rf = RegistryFactory::get();
+    rf.plugin("database", name_)->tearDown();
+    rf.setActive("database", previous_plugin_);
+    fs::remove_all(path_);
+    FLAGS_database_path = previous_path_;
+  }
+
+ private:
+  std::string name_;
+  std::string previous_plugin_;
+  std::string previous_path_;
+  fs::path path_;
+};
+
+class BenchmarkEventPublisher
+    : public EventPublisher<SubscriptionContext, EventContext> {
+  DECLARE_PUBLISHER("database_benchmark");
+};
+
+class BenchmarkEventSubscriber
+    : public EventSubscriber<BenchmarkEventPublisher> {
+ public:
+  BenchmarkEventSubscriber() {
+    setName("database_benchmark");
+  }
+
+  /// Store a batch of process-like events, as a publisher callback would.
+  Status store(size_t count) {
+    std::vector<Row> rows;
+    rows.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      auto pid = std::to_string(next_pid_++);
+      rows.push_back({{"pid", pid},
+                      {"uid", std::to_string(next_pid_ % 500)},
+                      {"path", "/usr/local/bin/example_" + pid},
+                      {"cmdline", "example_" + pid + " --flag value"}});
+    }
+    return addBatch(rows);
+  }
+
+ private:
+  size_t next_pid_{1};
+};
+
+/**
+ * @brief Store events, then index them as a restarting subscriber would.
+ *
+ * The benchmarks that sweep or read events work on the returned context.
+ */
+Status storeEvents(BenchmarkEventSubscriber& sub,
+                   size_t events,
+                   EventSubscriberPlugin::Context& context) {
+  for (size_t stored = 0; stored < events; stored += kEventsPerBatch) {
+    auto status = sub.store(std::min(kEventsPerBatch, events - stored));
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  context.event_index.clear();
+  EventSubscriberPlugin::setDatabaseNamespace(
+      context, sub.getType(), sub.getName());
+  return EventSubscriberPlugin::generateEventDataIndex(context,
+                                                       getOsqueryDatabase());
+}
+
+/// Remove every stored event.
+void clearEvents(EventSubscriberPlugin::Context& context) {
+  EventSubscriberPlugin::expireEventBatches(
+      context, getOsqueryDatabase(), 1, getUnixTime() + 2);
+}
+
+void eventArguments(benchmark::internal::Benchmark* b) {
+  auto events = benchmarkSize("OSQUERY_BENCHMARK_EVENTS", 0);
+  for (int64_t backend = 0; backend < 2; backend++) {
+    if (events > 0) {
+      b->Args({backend, events});
+    } else {
+      b->Args({backend, 10000});
+      b->Args({backend, 100000});
+    }
+  }
+}
+
+class BenchmarkLogForwarder : public BufferedLogForwarder {
+ public:
+  BenchmarkLogForwarder()
+      : BufferedLogForwarder("BenchmarkLogForwarder",
+                             "database_benchmark",
+                             std::chrono::seconds(0),
+                             1024) {}
+
+  using BufferedLogForwarder::check;
+
+ protected:
+  Status send(std::vector<std::string>& log_data,
+              const std::string& log_type) override {
+    return Status::success();
+  }
+};
+
+/// A differential result set where every tenth row depends on the version.
+QueryBatch getExampleResults(size_t rows, size_t version) {
+  QueryDataTyped qd;
+  qd.reserve(rows);
+  for (size_t i = 0; i < rows; i++) {
+    RowTyped r;
+    r["pid"] = static_cast<long long>(i);
+    r["uid"] = static_cast<long long>(i % 500);
+    r["path"] = "/usr/local/bin/example_" + std::to_string(i);
+    r["value"] = static_cast<long long>((i % 10 == 0) ? i + version : i);
+    qd.push_back(std::move(r));
+  }
+  return QueryBatch::fromRows(qd);
+}
+
+} // namespace
+
+static void DATABASE_events_ingest(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+  BenchmarkEventSubscriber sub;
+
+  size_t events = 0;
+  while (state.KeepRunning()) {
+    sub.store(state.range(1));
+    events += state.range(1);
+  }
+  state.SetItemsProcessed(events);
+
+  // Index the ingested events so they can be removed.
+  EventSubscriberPlugin::Context context;
+  storeEvents(sub, 0, context);
+  clearEvents(context);
+}
+
+// Arguments are the backend and the number of events per publisher callback.
+BENCHMARK(DATABASE_events_ingest)
+    ->Args({0, 1})
+    ->Args({0, 100})
+    ->Args({1, 1})
+    ->Args({1, 100});
+
+static void DATABASE_events_expire(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+  BenchmarkEventSubscriber sub;
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    EventSubscriberPlugin::Context context;
+    storeEvents(sub, state.range(1), context);
+    state.ResumeTiming();
+
+    // Every stored event is older than the expiry.
+    EventSubscriberPlugin::expireEventBatches(
+        context, getOsqueryDatabase(), 1, getUnixTime() + 2);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+BENCHMARK(DATABASE_events_expire)->Apply(eventArguments);
+
+static void DATABASE_events_overflow(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+  BenchmarkEventSubscriber sub;
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    EventSubscriberPlugin::Context context;
+    storeEvents(sub, state.range(1), context);
+    state.ResumeTiming();
+
+    // The oldest 90% of the events are removed, as when exceeding events_max.
+    EventSubscriberPlugin::removeOverflowingEventBatches(
+        context, getOsqueryDatabase(), state.range(1) / 10);
+
+    state.PauseTiming();
+    clearEvents(context);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+BENCHMARK(DATABASE_events_overflow)->Apply(eventArguments);
+
+static void DATABASE_events_retrieve(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+  BenchmarkEventSubscriber sub;
+  EventSubscriberPlugin::Context context;
+  storeEvents(sub, state.range(1), context);
+
+  size_t rows = 0;
+  while (state.KeepRunning()) {
+    EventSubscriberPlugin::generateRows(
+        context,
+        getOsqueryDatabase(),
+        [&rows](Row row) { rows++; },
+        0,
+        getUnixTime() + 1);
+  }
+  state.SetItemsProcessed(rows);
+
+  clearEvents(context);
+}
+
+BENCHMARK(DATABASE_events_retrieve)->Apply(eventArguments);
+
+static void DATABASE_events_reindex(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+  BenchmarkEventSubscriber sub;
+  EventSubscriberPlugin::Context context;
+  storeEvents(sub, state.range(1), context);
+
+  // The index every subscriber builds from its stored events at start.
+  while (state.KeepRunning()) {
+    EventSubscriberPlugin::Context restarted;
+    EventSubscriberPlugin::setDatabaseNamespace(
+        restarted, sub.getType(), sub.getName());
+    EventSubscriberPlugin::generateEventDataIndex(restarted,
+                                                  getOsqueryDatabase());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+
+  clearEvents(context);
+}
+
+BENCHMARK(DATABASE_events_reindex)->Apply(eventArguments);
+
+static void DATABASE_logs_fifo(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+  BenchmarkLogForwarder forwarder;
+  forwarder.setUp();
+
+  std::string line(state.range(2), 'x');
+  while (state.KeepRunning()) {
+    // Buffer a log period of lines, then send and remove them.
+    for (int64_t i = 0; i < state.range(1); i++) {
+      forwarder.logString(line);
+    }
+    forwarder.check();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+// Arguments are the backend, lines per log period and bytes per line.
+BENCHMARK(DATABASE_logs_fifo)->Apply([](benchmark::internal::Benchmark* b) {
+  auto lines = benchmarkSize("OSQUERY_BENCHMARK_LOGS", 1024);
+  for (int64_t backend = 0; backend < 2; backend++) {
+    b->Args({backend, lines, 256});
+    b->Args({backend, lines, 4096});
+  }
+});
+
+static void DATABASE_differential_rewrite(benchmark::State& state) {
+  BackendDatabase database(state.range(0));
+
+  // Alternate two result sets so every execution stores a changed blob.
+  std::vector<QueryBatch> results = {getExampleResults(state.range(1), 0),
+                                     getExampleResults(state.range(1), 1)};
+  auto query = getOsqueryScheduledQuery();
+  auto dbq = Query("database_benchmark", query);
+
+  uint64_t counter = 0;
+  size_t version = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    auto current = results[version++ % 2];
+    state.ResumeTiming();
+
+    DiffResults dr;
+    dbq.addNewResults(std::move(current), 0, counter, dr);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+BENCHMARK(DATABASE_differential_rewrite)
+    ->Apply([](benchmark::internal::Benchmark* b) {
+      auto rows = benchmarkSize("OSQUERY_BENCHMARK_ROWS", 0);
+      for (int64_t backend = 0; backend < 2; backend++) {
+        if (rows > 0) {
+          b->Args({backend, rows});
+        } else {
+          b->Args({backend, 1000});
+          b->Args({backend, 100000});
+        }
+      }
+    });
+} // namespace osquery
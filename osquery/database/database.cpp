@@ -7,12 +7,16 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/io/detail/quoted_manip.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
+#include <osquery/core/trace.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
@@ -45,14 +49,23 @@ const std::string kQueries = "queries";
 const std::string kEvents = "events";
 const std::string kCarves = "carves";
 const std::string kLogs = "logs";
+const std::string kHashes = "hashes";
+const std::string kYaraRules = "yara_rules";
+const std::string kAuthenticode = "authenticode";
 
 const std::string kDbEpochSuffix = "epoch";
 const std::string kDbCounterSuffix = "counter";
 
 const std::string kDbVersionKey = "results_version";
 
-const std::vector<std::string> kDomains = {
-    kPersistentSettings, kQueries, kEvents, kLogs, kCarves};
+const std::vector<std::string> kDomains = {kPersistentSettings,
+                                           kQueries,
+                                           kEvents,
+                                           kLogs,
+                                           kCarves,
+                                           kHashes,
+                                           kYaraRules,
+                                           kAuthenticode};
 
 std::atomic<bool> kDBAllowOpen(false);
 std::atomic<bool> kDBInitialized(false);
@@ -106,6 +119,18 @@ bool DatabasePlugin::checkingDB() const {
   return kDBChecking;
 }
 
+Status DatabasePlugin::getBatch(const std::string& domain,
+                                const std::vector<std::string>& keys,
+                                std::vector<std::string>& values) const {
+  values.clear();
+  values.resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    // A missing key is not an error, its value is left empty.
+    get(domain, keys[i], values[i]);
+  }
+  return Status::success();
+}
+
 Status DatabasePlugin::scan(const std::string& domain,
                             std::vector<std::string>& results,
                             const std::string& prefix,
@@ -113,6 +138,54 @@ Status DatabasePlugin::scan(const std::string& domain,
   return Status::success();
 }
 
+Status DatabasePlugin::scanValues(const std::string& domain,
+                                  DatabaseStringValueList& results,
+                                  const std::string& prefix,
+                                  uint64_t max) const {
+  std::vector<std::string> keys;
+  auto status = scan(domain, keys, prefix, max);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::vector<std::string> values;
+  status = getBatch(domain, keys, values);
+  if (!status.ok()) {
+    return status;
+  }
+
+  results.reserve(results.size() + keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    results.push_back(std::make_pair(std::move(keys[i]), std::move(values[i])));
+  }
+  return Status::success();
+}
+
+Status DatabasePlugin::openCursor(const std::string& domain,
+                                  const DatabaseCursorOptions& options,
+                                  DatabaseCursorRef& cursor) const {
+  DatabaseStringValueList pairs;
+  auto status = scanValues(domain, pairs, options.prefix, 0);
+  cursor = std::make_unique<DatabaseListCursor>(
+      std::move(pairs), options, status);
+  return status;
+}
+
+Status DatabasePlugin::maintain() {
+  return Status::success();
+}
+
+Status DatabasePlugin::getMemoryUsage(DatabaseMemoryUsage& usage) const {
+  usage = DatabaseMemoryUsage();
+  return Status::success();
+}
+
+Status DatabasePlugin::getDomainStats(
+    std::vector<DatabaseDomainStats>& stats) const {
+  stats.clear();
+  return Status::success();
+}
+
 Status DatabasePlugin::call(const PluginRequest& request,
                             PluginResponse& response) {
   if (request.count("action") == 0) {
@@ -204,19 +277,40 @@ Status DatabasePlugin::call(const PluginRequest& request,
       response.push_back({{"k", k}});
     }
     return status;
+  } else if (request.at("action") == "scan_values") {
+    size_t max = 0;
+    if (request.count("max") > 0) {
+      max = std::stoul(request.at("max"));
+    }
+
+    DatabaseStringValueList values;
+    auto status = this->scanValues(domain, values, request.at("prefix"), max);
+    for (auto& value : values) {
+      response.push_back(
+          {{"k", std::move(value.first)}, {"v", std::move(value.second)}});
+    }
+    return status;
   }
 
   return Status(1, "Unknown database plugin action");
 }
 
-static inline std::shared_ptr<DatabasePlugin> getDatabasePlugin() {
-  auto& rf = RegistryFactory::get();
-  if (!rf.exists("database", rf.getActive("database"), true)) {
-    return nullptr;
-  }
+namespace {
+
+/// The active database plugin, resolved again when the registry changes.
+const PluginHandle<DatabasePlugin> kActiveDatabase("database");
 
-  auto plugin = rf.plugin("database", rf.getActive("database"));
-  return std::dynamic_pointer_cast<DatabasePlugin>(plugin);
+} // namespace
+
+/**
+ * @brief Access the active, internal, database plugin.
+ *
+ * Database calls from core go directly to the typed plugin methods. The plugin
+ * is resolved from the registry once and is looked up again only when the
+ * registry changes, avoiding the registry's item checks and casts.
+ */
+static inline std::shared_ptr<DatabasePlugin> getDatabasePlugin() {
+  return kActiveDatabase.get();
 }
 
 namespace {
@@ -266,6 +360,43 @@ Status sendPutDatabaseRequest(const std::string& domain,
 }
 } // namespace
 
+DatabaseListCursor::DatabaseListCursor(DatabaseStringValueList pairs,
+                                       const DatabaseCursorOptions& options,
+                                       Status status)
+    : pairs_(std::move(pairs)), options_(options), status_(std::move(status)) {
+  // Some stores, such as SQLite, scan in insertion order.
+  if (!std::is_sorted(pairs_.begin(), pairs_.end())) {
+    std::sort(pairs_.begin(), pairs_.end());
+  }
+
+  const auto& start = options_.start();
+  while (position_ < pairs_.size() && pairs_[position_].first < start) {
+    position_++;
+  }
+}
+
+bool DatabaseListCursor::valid() const {
+  return position_ < pairs_.size() && options_.within(pairs_[position_].first);
+}
+
+void DatabaseListCursor::next() {
+  if (valid()) {
+    position_++;
+  }
+}
+
+std::string DatabaseListCursor::key() const {
+  return pairs_[position_].first;
+}
+
+std::string DatabaseListCursor::value() const {
+  return pairs_[position_].second;
+}
+
+Status DatabaseListCursor::status() const {
+  return status_;
+}
+
 Status getDatabaseValue(const std::string& domain,
                         const std::string& key,
                         std::string& value) {
@@ -309,10 +440,116 @@ Status getDatabaseValue(const std::string& domain,
   return s;
 }
 
+Status getDatabaseValues(const std::string& domain,
+                         const std::vector<std::string>& keys,
+                         std::vector<std::string>& values) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // Extensions route each lookup through the registry.
+    values.clear();
+    values.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      auto status = getDatabaseValue(domain, keys[i], values[i]);
+      if (!status.ok()) {
+        values[i].clear();
+      }
+    }
+    return Status::success();
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot get database values");
+  }
+
+  auto plugin = getDatabasePlugin();
+  return plugin->getBatch(domain, keys, values);
+}
+
+Status getDatabaseMemoryUsage(DatabaseMemoryUsage& usage) {
+  if (RegistryFactory::get().external()) {
+    return Status::failure("Extensions do not have an active database");
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::failure("Database is not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status::failure("No active database plugin");
+  }
+  return plugin->getMemoryUsage(usage);
+}
+
+namespace {
+
+/// Report the database caches, the bulk of the database's memory.
+void reportDatabaseMemory(std::vector<SubsystemMemory>& memory) {
+  DatabaseMemoryUsage usage;
+  if (!getDatabaseMemoryUsage(usage).ok()) {
+    return;
+  }
+
+  auto add = [&memory](const std::string& name, uint64_t bytes) {
+    SubsystemMemory held;
+    held.name = name;
+    held.bytes = static_cast<int64_t>(bytes);
+    memory.push_back(std::move(held));
+  };
+
+  // Memtables budgeted by the block cache are also counted by it.
+  add("block_cache", usage.block_cache);
+  add("memtables", usage.memtables);
+  add("table_readers", usage.table_readers);
+}
+
+const bool kDatabaseMemoryReporter =
+    registerMemoryReporter("database", reportDatabaseMemory);
+
+} // namespace
+
+Status getDatabaseDomainStats(std::vector<DatabaseDomainStats>& stats) {
+  if (RegistryFactory::get().external()) {
+    return Status::failure("Extensions do not have an active database");
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::failure("Database is not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status::failure("No active database plugin");
+  }
+  return plugin->getDomainStats(stats);
+}
+
 Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         const std::string& value) {
-  return setDatabaseBatch(domain, {std::make_pair(key, value)});
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    return sendPutDatabaseRequest(domain, {std::make_pair(key, value)});
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot set database values");
+  }
+
+  // The value is passed through to the plugin without building a batch.
+  OSQUERY_TRACE_SPAN_DETAIL("database", "put", domain);
+  auto plugin = getDatabasePlugin();
+  return plugin->put(domain, key, value);
 }
 
 Status setDatabaseBatch(const std::string& domain,
@@ -336,6 +573,7 @@ Status setDatabaseBatch(const std::string& domain,
     throw std::runtime_error("Cannot set database values");
   }
 
+  OSQUERY_TRACE_SPAN_DETAIL("database", "putBatch", domain);
   auto plugin = getDatabasePlugin();
   return plugin->putBatch(domain, data);
 }
@@ -343,7 +581,7 @@ Status setDatabaseBatch(const std::string& domain,
 Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         int value) {
-  return setDatabaseBatch(domain, {std::make_pair(key, std::to_string(value))});
+  return setDatabaseValue(domain, key, std::to_string(value));
 }
 
 Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
@@ -437,6 +675,86 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status scanDatabaseValues(const std::string& domain,
+                          DatabaseStringValueList& values,
+                          const std::string& prefix,
+                          uint64_t max) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "scan_values"},
+                             {"domain", domain},
+                             {"prefix", prefix},
+                             {"max", std::to_string(max)}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+
+    for (auto& item : response) {
+      if (item.count("k") > 0 && item.count("v") > 0) {
+        values.push_back(
+            std::make_pair(std::move(item["k"]), std::move(item["v"])));
+      }
+    }
+    return status;
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot scan database values: " + prefix);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanValues(domain, values, prefix, max);
+  }
+}
+
+Status openDatabaseCursor(const std::string& domain,
+                          const DatabaseCursorOptions& options,
+                          DatabaseCursorRef& cursor) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    DatabaseStringValueList pairs;
+    auto status = scanDatabaseValues(domain, pairs, options.prefix);
+    cursor = std::make_unique<DatabaseListCursor>(
+        std::move(pairs), options, status);
+    return status;
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::failure("Database is not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status::failure("No active database plugin");
+  }
+  return plugin->openCursor(domain, options, cursor);
+}
+
+Status maintainDatabase() {
+  if (RegistryFactory::get().external()) {
+    return Status::failure("Extensions do not have an active database");
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::failure("Database is not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status::failure("No active database plugin");
+  }
+  return plugin->maintain();
+}
+
 void resetDatabase() {
   PluginRequest request = {{"action", "reset"}};
   Registry::call("database", request);
@@ -444,17 +762,16 @@ void resetDatabase() {
 
 void dumpDatabase() {
   for (const auto& domain : kDomains) {
-    std::vector<std::string> keys;
-    if (!scanDatabaseKeys(domain, keys)) {
+    DatabaseCursorRef cursor;
+    if (!openDatabaseCursor(domain, DatabaseCursorOptions(), cursor)) {
       continue;
     }
-    for (const auto& key : keys) {
-      std::string value;
-      if (!getDatabaseValue(domain, key, value)) {
-        continue;
-      }
-      fprintf(
-          stdout, "%s[%s]: %s\n", domain.c_str(), key.c_str(), value.c_str());
+    for (; cursor->valid(); cursor->next()) {
+      fprintf(stdout,
+              "%s[%s]: %s\n",
+              domain.c_str(),
+              cursor->key().c_str(),
+              cursor->value().c_str());
     }
   }
   fflush(stdout);
@@ -693,6 +1010,13 @@ class OsqueryDatabase final : public IDatabaseInterface {
     return osquery::getDatabaseValue(domain, key, value);
   }
 
+  virtual Status getDatabaseValues(
+      const std::string& domain,
+      const std::vector<std::string>& keys,
+      std::vector<std::string>& values) const override {
+    return osquery::getDatabaseValues(domain, keys, values);
+  }
+
   virtual Status setDatabaseValue(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) const override {
@@ -734,6 +1058,19 @@ class OsqueryDatabase final : public IDatabaseInterface {
                                   size_t max) const override {
     return osquery::scanDatabaseKeys(domain, keys, prefix, max);
   }
+
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    DatabaseStringValueList& values,
+                                    const std::string& prefix,
+                                    size_t max) const override {
+    return osquery::scanDatabaseValues(domain, values, prefix, max);
+  }
+
+  virtual Status openDatabaseCursor(const std::string& domain,
+                                    const DatabaseCursorOptions& options,
+                                    DatabaseCursorRef& cursor) const override {
+    return osquery::openDatabaseCursor(domain, options, cursor);
+  }
 };
 
 IDatabaseInterface& getOsqueryDatabase() {
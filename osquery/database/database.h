@@ -49,6 +49,16 @@ extern const std::string kEvents;
 /// The "domain" where the results of carve queries are stored.
 extern const std::string kCarves;
 
+/// The "domain" where file hashes are cached, keyed by the file's attributes.
+extern const std::string kHashes;
+
+/// The "domain" where compiled YARA rules are kept, keyed by their sources.
+extern const std::string kYaraRules;
+
+/// The "domain" where Authenticode verification results are cached, keyed by
+/// the file's identity.
+extern const std::string kAuthenticode;
+
 /// The key for the DB version
 extern const std::string kDbVersionKey;
 
@@ -68,6 +78,53 @@ extern const std::string kLogs;
 using DatabaseStringValueList =
     std::vector<std::pair<std::string, std::string>>;
 
+/// Memory held by a backing store, in bytes.
+struct DatabaseMemoryUsage {
+  /// The configured bound on cache and write buffer memory, 0 is unbounded.
+  uint64_t budget{0};
+
+  /// Cached blocks, and memory reserved by memtables within the budget.
+  uint64_t block_cache{0};
+
+  /// Cached blocks currently referenced and not evictable.
+  uint64_t block_cache_pinned{0};
+
+  /// Memtables across every domain.
+  uint64_t memtables{0};
+
+  /// Table reader memory held outside of the block cache.
+  uint64_t table_readers{0};
+};
+
+/// Storage and write pressure of a single domain, as estimated by the store.
+struct DatabaseDomainStats {
+  /// The storage domain.
+  std::string domain;
+
+  /// Estimated number of keys.
+  uint64_t keys{0};
+
+  /// Bytes held by the domain's memtables.
+  uint64_t memtables{0};
+
+  /// Number, and bytes, of table files across every level.
+  uint64_t sst_files{0};
+  uint64_t sst_bytes{0};
+
+  /// Estimated bytes of live data, less overwritten and removed keys.
+  uint64_t live_bytes{0};
+
+  /// Bytes that compactions must rewrite to bring the levels within bounds.
+  uint64_t pending_compaction_bytes{0};
+
+  /// Writes slowed down, and stopped, since the database was opened.
+  uint64_t write_slowdowns{0};
+  uint64_t write_stops{0};
+
+  /// True while writes are stopped for the database.
+  bool write_stopped{false};
+};
+
 /**
  * @brief An osquery backing storage (database) type that persists executions.
  *
@@ -104,6 +161,22 @@ class DatabasePlugin : public Plugin {
                      const std::string& key,
                      int& value) const = 0;
 
+  /**
+   * @brief Perform a lookup of several keys within a domain.
+   *
+   * The default implementation calls get for every key; backing stores that
+   * support a bulk read should override this.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param keys The lookup/retrieval keys.
+   * @param values The output values, one per key and left empty if the key
+   * does not exist.
+   * @return Failure if the data could not be accessed.
+   */
+  virtual Status getBatch(const std::string& domain,
+                          const std::vector<std::string>& keys,
+                          std::vector<std::string>& values) const;
+
   /**
    * @brief Store a string-represented value using a domain and key index.
    *
@@ -139,6 +212,69 @@ class DatabasePlugin : public Plugin {
                       const std::string& prefix,
                       uint64_t max) const;
 
+  /**
+   * @brief Scan keys, and their values, that begin with a prefix.
+   *
+   * Pairs are returned in ascending key order. The default implementation
+   * performs a scan followed by a getBatch; backing stores with iterators
+   * should read both in a single pass.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param results The output key/value pairs.
+   * @param prefix Only keys beginning with this prefix are returned.
+   * @param max The maximum number of pairs to return, 0 for unlimited.
+   * @return Failure if the data could not be accessed.
+   */
+  virtual Status scanValues(const std::string& domain,
+                            DatabaseStringValueList& results,
+                            const std::string& prefix,
+                            uint64_t max) const;
+
+  /**
+   * @brief Open a cursor over the key/value pairs of a domain.
+   *
+   * The default implementation materializes the pairs using scanValues;
+   * backing stores with iterators should stream them instead.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param options The key bounds and read options.
+   * @param cursor The output cursor.
+   * @return Failure if the cursor could not be opened.
+   */
+  virtual Status openCursor(const std::string& domain,
+                            const DatabaseCursorOptions& options,
+                            DatabaseCursorRef& cursor) const;
+
+  /**
+   * @brief Perform background maintenance, such as reclaiming removed space.
+   *
+   * The scheduler calls this during idle periods. The default implementation
+   * does nothing for stores without compactions.
+   *
+   * @return Failure if the maintenance could not be completed.
+   */
+  virtual Status maintain();
+
+  /**
+   * @brief Report the memory held by the backing store.
+   *
+   * The default implementation reports nothing for stores without caches.
+   *
+   * @param usage The output memory usage.
+   * @return Failure if the usage could not be read.
+   */
+  virtual Status getMemoryUsage(DatabaseMemoryUsage& usage) const;
+
+  /**
+   * @brief Report the storage statistics of each domain.
+   *
+   * The default implementation reports nothing for stores without estimates.
+   *
+   * @param stats The output statistics, one per domain.
+   * @return Failure if the statistics could not be read.
+   */
+  virtual Status getDomainStats(std::vector<DatabaseDomainStats>& stats) const;
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -177,6 +313,31 @@ class DatabasePlugin : public Plugin {
   std::string path_;
 };
 
+/**
+ * @brief A cursor over already materialized key/value pairs.
+ *
+ * This serves stores without native iterators, extensions, and snapshots of
+ * stores without snapshot reads. The pairs are visited in ascending key order.
+ */
+class DatabaseListCursor : public DatabaseCursor {
+ public:
+  DatabaseListCursor(DatabaseStringValueList pairs,
+                     const DatabaseCursorOptions& options,
+                     Status status = Status::success());
+
+  bool valid() const override;
+  void next() override;
+  std::string key() const override;
+  std::string value() const override;
+  Status status() const override;
+
+ private:
+  DatabaseStringValueList pairs_;
+  DatabaseCursorOptions options_;
+  Status status_;
+  size_t position_{0};
+};
+
 /**
  * @brief Lookup a value from the active osquery DatabasePlugin storage.
  *
@@ -197,6 +358,19 @@ Status getDatabaseValue(const std::string& domain,
                         const std::string& key,
                         int& value);
 
+/**
+ * @brief Lookup several values from the active DatabasePlugin storage.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param keys The lookup/retrieval keys.
+ * @param values The output values, one per key and left empty if the key does
+ * not exist.
+ * @return Storage operation status.
+ */
+Status getDatabaseValues(const std::string& domain,
+                         const std::vector<std::string>& keys,
+                         std::vector<std::string>& values);
+
 /**
  * @brief Set or put a value into the active osquery DatabasePlugin storage.
  *
@@ -239,6 +413,45 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         uint64_t max = 0);
 
+/// Report the memory held by the active DatabasePlugin storage.
+Status getDatabaseMemoryUsage(DatabaseMemoryUsage& usage);
+
+/// Report the storage statistics of each domain in the active DatabasePlugin.
+Status getDatabaseDomainStats(std::vector<DatabaseDomainStats>& stats);
+
+/**
+ * @brief Get the keys, and values, beginning with a prefix in a domain.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param values The output key/value pairs, in ascending key order.
+ * @param prefix Only keys beginning with this prefix are returned.
+ * @param max The maximum number of pairs to return, 0 for unlimited.
+ * @return Storage operation status.
+ */
+Status scanDatabaseValues(const std::string& domain,
+                          DatabaseStringValueList& values,
+                          const std::string& prefix,
+                          uint64_t max = 0);
+
+/**
+ * @brief Open a cursor over the key/value pairs of a domain.
+ *
+ * Prefer a cursor to scanDatabaseValues when a domain may hold many keys.
+ * Extensions do not have an active database, their cursors materialize the
+ * pairs through the registry.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param options The key bounds and read options.
+ * @param cursor The output cursor.
+ * @return Storage operation status.
+ */
+Status openDatabaseCursor(const std::string& domain,
+                          const DatabaseCursorOptions& options,
+                          DatabaseCursorRef& cursor);
+
+/// Run maintenance on the active DatabasePlugin storage.
+Status maintainDatabase();
+
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
@@ -9,28 +9,118 @@
 
 #include <osquery/database/database.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/mutex.h>
 
 #include <boost/variant.hpp>
 
-#include <iostream>
+#include <map>
+#include <memory>
 
 namespace osquery {
 
+namespace {
+
+using EphemeralValue = boost::variant<int, std::string>;
+using DomainType = std::map<std::string, EphemeralValue>;
+
+/**
+ * @brief The ordered pairs of a single domain.
+ *
+ * Each domain has its own lock so event ingestion, query state and buffered
+ * logs do not contend with each other. Readers share the lock.
+ */
+struct EphemeralDomain {
+  mutable Mutex mutex;
+  DomainType data;
+};
+
+/// Stored integers are not visible as strings, as with get.
+std::string stringValue(const EphemeralValue& value) {
+  auto string_value = boost::get<std::string>(&value);
+  return (string_value == nullptr) ? std::string() : *string_value;
+}
+
+bool startsWith(const std::string& key, const std::string& prefix) {
+  return key.compare(0, prefix.size(), prefix) == 0;
+}
+
+/**
+ * @brief A cursor over a domain's ordered map.
+ *
+ * The cursor seeks past the last visited key on each step rather than holding
+ * a map iterator, so visited keys may be removed while it is open. The domain
+ * lock is only held while seeking.
+ */
+class EphemeralDatabaseCursor : public DatabaseCursor {
+ public:
+  EphemeralDatabaseCursor(const EphemeralDomain* domain,
+                          const DatabaseCursorOptions& options)
+      : domain_(domain), options_(options) {
+    seek(options_.start(), true);
+  }
+
+  bool valid() const override {
+    return valid_;
+  }
+
+  void next() override {
+    if (valid_) {
+      seek(key_, false);
+    }
+  }
+
+  std::string key() const override {
+    return key_;
+  }
+
+  std::string value() const override {
+    return value_;
+  }
+
+  Status status() const override {
+    return Status::success();
+  }
+
+ private:
+  /// Position on the first key at, or after, the target.
+  void seek(const std::string& target, bool inclusive) {
+    valid_ = false;
+    if (domain_ == nullptr) {
+      return;
+    }
+
+    ReadLock lock(domain_->mutex);
+    const auto& data = domain_->data;
+    auto it = inclusive ? data.lower_bound(target) : data.upper_bound(target);
+    if (it != data.end() && options_.within(it->first)) {
+      valid_ = true;
+      key_ = it->first;
+      value_ = stringValue(it->second);
+    }
+  }
+
+ private:
+  const EphemeralDomain* domain_{nullptr};
+  DatabaseCursorOptions options_;
+  bool valid_{false};
+  std::string key_;
+  std::string value_;
+};
+
+} // namespace
+
 class EphemeralDatabasePlugin : public DatabasePlugin {
-  using DBType =
-      std::map<std::string,
-               std::map<std::string, boost::variant<int, std::string>>>;
   template <typename T>
   Status getAny(const std::string& domain,
                 const std::string& key,
                 T& value) const;
 
  private:
-  void setValue(const std::string& domain,
-                const std::string& key,
-                const std::string& value);
+  /// Lookup an existing domain, nullptr if nothing was stored to it.
+  const EphemeralDomain* findDomain(const std::string& domain) const;
 
-  void setValue(const std::string& domain, const std::string& key, int value);
+  /// Lookup, or create, a domain to store to.
+  EphemeralDomain& getDomain(const std::string& domain);
 
  public:
   /// Data retrieval method.
@@ -65,31 +155,72 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value lookup method.
+  Status scanValues(const std::string& domain,
+                    DatabaseStringValueList& results,
+                    const std::string& prefix,
+                    uint64_t max) const override;
+
+  /// Key and value cursor method.
+  Status openCursor(const std::string& domain,
+                    const DatabaseCursorOptions& options,
+                    DatabaseCursorRef& cursor) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override {
-    DBType().swap(db_);
+    WriteLock lock(domains_mutex_);
+    domains_.clear();
     return Status(0);
   }
 
  private:
-  DBType db_;
+  /// Protects the set of domains, not their contents.
+  mutable Mutex domains_mutex_;
+
+  /// Domains are created on first write and live until the next setUp.
+  std::map<std::string, std::unique_ptr<EphemeralDomain>> domains_;
 };
 
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(EphemeralDatabasePlugin, "database", "ephemeral");
 
+const EphemeralDomain* EphemeralDatabasePlugin::findDomain(
+    const std::string& domain) const {
+  ReadLock lock(domains_mutex_);
+  auto it = domains_.find(domain);
+  return (it == domains_.end()) ? nullptr : it->second.get();
+}
+
+EphemeralDomain& EphemeralDatabasePlugin::getDomain(const std::string& domain) {
+  {
+    ReadLock lock(domains_mutex_);
+    auto it = domains_.find(domain);
+    if (it != domains_.end()) {
+      return *it->second;
+    }
+  }
+
+  WriteLock lock(domains_mutex_);
+  auto& entry = domains_[domain];
+  if (entry == nullptr) {
+    entry = std::make_unique<EphemeralDomain>();
+  }
+  return *entry;
+}
+
 template <typename T>
 Status EphemeralDatabasePlugin::getAny(const std::string& domain,
                                        const std::string& key,
                                        T& value) const {
-  auto domainIterator = db_.find(domain);
-  if (domainIterator == db_.end()) {
+  auto d = findDomain(domain);
+  if (d == nullptr) {
     return Status(1, "Domain " + domain + " does not exist");
   }
 
-  auto keyIterator = domainIterator->second.find(key);
-  if (keyIterator == domainIterator->second.end()) {
+  ReadLock lock(d->mutex);
+  auto keyIterator = d->data.find(key);
+  if (keyIterator == d->data.end()) {
     return Status(1, "Key " + key + " in domain " + domain + " does not exist");
   }
 
@@ -114,39 +245,31 @@ Status EphemeralDatabasePlugin::get(const std::string& domain,
   return this->getAny(domain, key, value);
 }
 
-void EphemeralDatabasePlugin::setValue(const std::string& domain,
-                                       const std::string& key,
-                                       const std::string& value) {
-  db_[domain][key] = value;
-}
-
-void EphemeralDatabasePlugin::setValue(const std::string& domain,
-                                       const std::string& key,
-                                       int value) {
-  db_[domain][key] = value;
-}
-
 Status EphemeralDatabasePlugin::put(const std::string& domain,
                                     const std::string& key,
                                     const std::string& value) {
-  setValue(domain, key, value);
+  auto& d = getDomain(domain);
+  WriteLock lock(d.mutex);
+  d.data[key] = value;
   return Status(0);
 }
 
 Status EphemeralDatabasePlugin::put(const std::string& domain,
                                     const std::string& key,
                                     int value) {
-  setValue(domain, key, value);
+  auto& d = getDomain(domain);
+  WriteLock lock(d.mutex);
+  d.data[key] = value;
   return Status(0);
 }
 
 Status EphemeralDatabasePlugin::putBatch(const std::string& domain,
                                          const DatabaseStringValueList& data) {
+  // A batch is applied under a single lock, readers see all or none of it.
+  auto& d = getDomain(domain);
+  WriteLock lock(d.mutex);
   for (const auto& p : data) {
-    const auto& key = p.first;
-    const auto& value = p.second;
-
-    setValue(domain, key, value);
+    d.data[p.first] = p.second;
   }
 
   return Status::success();
@@ -154,7 +277,9 @@ Status EphemeralDatabasePlugin::putBatch(const std::string& domain,
 
 Status EphemeralDatabasePlugin::remove(const std::string& domain,
                                        const std::string& k) {
-  db_[domain].erase(k);
+  auto& d = getDomain(domain);
+  WriteLock lock(d.mutex);
+  d.data.erase(k);
   return Status(0);
 }
 
@@ -165,16 +290,9 @@ Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
     return Status::failure("Invalid range: low > high");
   }
 
-  std::vector<std::string> keys;
-  for (const auto& it : db_[domain]) {
-    if (it.first >= low && it.first <= high) {
-      keys.push_back(it.first);
-    }
-  }
-
-  for (const auto& key : keys) {
-    db_[domain].erase(key);
-  }
+  auto& d = getDomain(domain);
+  WriteLock lock(d.mutex);
+  d.data.erase(d.data.lower_bound(low), d.data.upper_bound(high));
   return Status(0);
 }
 
@@ -182,21 +300,65 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
                                      std::vector<std::string>& results,
                                      const std::string& prefix,
                                      uint64_t max) const {
-  if (db_.count(domain) == 0) {
+  auto d = findDomain(domain);
+  if (d == nullptr) {
     return Status(0);
   }
 
-  for (const auto& key : db_.at(domain)) {
-    if (!prefix.empty() &&
-        !(std::mismatch(prefix.begin(), prefix.end(), key.first.begin())
-              .first == prefix.end())) {
-      continue;
-    }
-    results.push_back(key.first);
+  ReadLock lock(d->mutex);
+  for (auto it = d->data.lower_bound(prefix);
+       it != d->data.end() && startsWith(it->first, prefix);
+       ++it) {
+    results.push_back(it->first);
     if (max > 0 && results.size() >= max) {
       break;
     }
   }
   return Status(0);
 }
+
+Status EphemeralDatabasePlugin::scanValues(const std::string& domain,
+                                           DatabaseStringValueList& results,
+                                           const std::string& prefix,
+                                           uint64_t max) const {
+  auto d = findDomain(domain);
+  if (d == nullptr) {
+    return Status(0);
+  }
+
+  ReadLock lock(d->mutex);
+  uint64_t count = 0;
+  for (auto it = d->data.lower_bound(prefix);
+       it != d->data.end() && startsWith(it->first, prefix);
+       ++it) {
+    results.push_back(std::make_pair(it->first, stringValue(it->second)));
+    if (max > 0 && ++count >= max) {
+      break;
+    }
+  }
+  return Status(0);
+}
+
+Status EphemeralDatabasePlugin::openCursor(const std::string& domain,
+                                           const DatabaseCursorOptions& options,
+                                           DatabaseCursorRef& cursor) const {
+  auto d = findDomain(domain);
+  if (!options.snapshot || d == nullptr) {
+    cursor = std::make_unique<EphemeralDatabaseCursor>(d, options);
+    return Status::success();
+  }
+
+  // The map has no snapshots, copy the pairs within the bounds.
+  DatabaseStringValueList pairs;
+  {
+    ReadLock lock(d->mutex);
+    for (auto it = d->data.lower_bound(options.start());
+         it != d->data.end() && options.within(it->first);
+         ++it) {
+      pairs.push_back(std::make_pair(it->first, stringValue(it->second)));
+    }
+  }
+  cursor = std::make_unique<DatabaseListCursor>(std::move(pairs), options);
+  return Status::success();
+}
 } // namespace osquery
@@ -20,6 +20,62 @@ namespace osquery {
 using DatabaseStringValueList =
     std::vector<std::pair<std::string, std::string>>;
 
+/// Bounds and read options for a DatabaseCursor.
+struct DatabaseCursorOptions {
+  /// Only keys beginning with this prefix are visited.
+  std::string prefix;
+
+  /// The first key to visit, empty to begin at the prefix.
+  std::string lower;
+
+  /// Stop before this key, empty for no upper bound.
+  std::string upper;
+
+  /// Read from a consistent view of the domain taken when the cursor opens.
+  bool snapshot{false};
+
+  /// The key a cursor seeks to when opened.
+  const std::string& start() const {
+    return (lower > prefix) ? lower : prefix;
+  }
+
+  /// Check if a key, at or after start(), is within the bounds.
+  bool within(const std::string& key) const {
+    return key.compare(0, prefix.size(), prefix) == 0 &&
+           (upper.empty() || key < upper);
+  }
+};
+
+/**
+ * @brief A forward cursor over the key/value pairs of a domain.
+ *
+ * Pairs are visited in ascending key order without materializing the domain.
+ * Keys may be written or removed while a cursor is open; unless the cursor
+ * reads from a snapshot those changes may or may not be visited. A cursor
+ * must be released before the database is reset or closed.
+ */
+class DatabaseCursor {
+ public:
+  virtual ~DatabaseCursor() = default;
+
+  /// True while the cursor is positioned on a pair within its bounds.
+  virtual bool valid() const = 0;
+
+  /// Advance to the next pair.
+  virtual void next() = 0;
+
+  /// The key of the current pair, the cursor must be valid.
+  virtual std::string key() const = 0;
+
+  /// The value of the current pair, the cursor must be valid.
+  virtual std::string value() const = 0;
+
+  /// Failure if the cursor stopped early because of a read error.
+  virtual Status status() const = 0;
+};
+
+using DatabaseCursorRef = std::unique_ptr<DatabaseCursor>;
+
 class IDatabaseInterface {
  public:
   IDatabaseInterface() = default;
@@ -33,6 +89,10 @@ class IDatabaseInterface {
                                   const std::string& key,
                                   int& value) const = 0;
 
+  virtual Status getDatabaseValues(const std::string& domain,
+                                   const std::vector<std::string>& keys,
+                                   std::vector<std::string>& values) const = 0;
+
   virtual Status setDatabaseValue(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) const = 0;
@@ -60,6 +120,15 @@ class IDatabaseInterface {
                                   const std::string& prefix,
                                   size_t max) const = 0;
 
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    DatabaseStringValueList& values,
+                                    const std::string& prefix,
+                                    size_t max) const = 0;
+
+  virtual Status openDatabaseCursor(const std::string& domain,
+                                    const DatabaseCursorOptions& options,
+                                    DatabaseCursorRef& cursor) const = 0;
+
   IDatabaseInterface(const IDatabaseInterface&) = delete;
   IDatabaseInterface& operator=(const IDatabaseInterface&) = delete;
 };
@@ -7,10 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/core/flags.h>
 #include <osquery/database/database.h>
 
 #include <osquery/core/query.h>
 #include <osquery/core/sql/diff_results.h>
+#include <osquery/core/sql/hashed_results.h>
+#include <osquery/core/sql/query_batch.h>
 #include <osquery/core/sql/query_data.h>
 #include <osquery/sql/tests/sql_test_utils.h>
 
@@ -126,6 +129,235 @@ TEST_F(ResultsTests, test_serialize_query_log_item_json) {
   EXPECT_EQ(results.first, json);
 }
 
+TEST_F(ResultsTests, test_serialize_query_log_item_json_decorations) {
+  auto results = getSerializedQueryLogItem();
+  results.second.decorations["host_uuid"] = "uuid";
+
+  // The direct encoding matches the document for every decoration layout.
+  auto top_level = Flag::getValue("decorations_top_level");
+  for (const auto& layout : {"false", "true"}) {
+    Flag::updateValue("decorations_top_level", layout);
+    auto doc = JSON::newObject();
+    ASSERT_TRUE(serializeQueryLogItem(results.second, doc).ok());
+    std::string expected;
+    doc.toString(expected);
+
+    std::string json;
+    ASSERT_TRUE(serializeQueryLogItemJSON(results.second, json).ok());
+    EXPECT_EQ(json, expected);
+  }
+
+  // A top-level decoration replacing a member uses the document encoding.
+  results.second.decorations["name"] = "decorated";
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(serializeQueryLogItem(results.second, doc).ok());
+  std::string expected;
+  doc.toString(expected);
+
+  std::string json;
+  ASSERT_TRUE(serializeQueryLogItemJSON(results.second, json).ok());
+  EXPECT_EQ(json, expected);
+  Flag::updateValue("decorations_top_level", top_level);
+}
+
+TEST_F(ResultsTests, test_serialize_query_log_item_event_lines) {
+  auto results = getSerializedQueryLogItem();
+  results.second.decorations["host_uuid"] = "uuid";
+
+  std::vector<std::string> items;
+  auto s = serializeQueryLogItemAsEventsJSON(results.second, items);
+  ASSERT_TRUE(s.ok());
+
+  std::string expected;
+  for (const auto& item : items) {
+    expected += item + "\n";
+  }
+
+  std::string lines;
+  s = serializeQueryLogItemAsEventLines(results.second, lines);
+  ASSERT_TRUE(s.ok());
+  EXPECT_EQ(lines, expected);
+
+  // The output buffer is reused between items.
+  s = serializeQueryLogItemAsEventLines(results.second, lines);
+  ASSERT_TRUE(s.ok());
+  EXPECT_EQ(lines, expected);
+
+  QueryLogItem empty;
+  EXPECT_FALSE(serializeQueryLogItemAsEventLines(empty, lines).ok());
+}
+
+TEST_F(ResultsTests, test_query_batch_round_trip) {
+  auto results = getSerializedQueryData();
+  auto batch = QueryBatch::fromRows(results.second);
+  EXPECT_EQ(batch.size(), results.second.size());
+  EXPECT_EQ(batch.toRows(), results.second);
+
+  // A sparse row adds a column that earlier rows do not have.
+  RowTyped sparse;
+  sparse["only_here"] = 1LL;
+  batch.appendRow(sparse);
+  EXPECT_EQ(batch.row(batch.size() - 1), sparse);
+  EXPECT_FALSE(batch.cell(0, batch.columnIndex("only_here")));
+}
+
+TEST_F(ResultsTests, test_query_batch_interned_strings) {
+  RowTyped r1, r2;
+  r1["user"] = "root";
+  r1["path"] = "/bin/sh";
+  r2["user"] = "root";
+  r2["path"] = "root";
+
+  // Values repeated across rows and columns are stored once.
+  auto batch = QueryBatch::fromRows({r1, r2, r1});
+  EXPECT_EQ(batch.distinctStrings(), 2U);
+  EXPECT_EQ(batch.toRows(), QueryDataTyped({r1, r2, r1}));
+  EXPECT_TRUE(batch.rowEquals(0, batch, 2));
+  EXPECT_FALSE(batch.rowEquals(0, batch, 1));
+
+  // Strings that become equal share an id afterwards.
+  batch.transformStrings([](std::string& str) { str = "x"; });
+  EXPECT_EQ(batch.distinctStrings(), 1U);
+  EXPECT_TRUE(batch.rowEquals(0, batch, 1));
+  EXPECT_EQ(*batch.text(1, batch.columnIndex("path")), "x");
+}
+
+TEST_F(ResultsTests, test_serialize_query_batch) {
+  auto results = getSerializedQueryData();
+  auto batch = QueryBatch::fromRows(results.second);
+  auto doc = JSON::newArray();
+  auto s = serializeQueryBatch(batch, doc, doc.doc(), true);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(results.first.doc(), doc.doc());
+}
+
+TEST_F(ResultsTests, test_deserialize_query_batch_json) {
+  auto results = getSerializedQueryDataJSON();
+  QueryBatch output;
+  auto s = deserializeQueryBatchJSON(results.first, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, QueryBatch::fromRows(results.second));
+}
+
+TEST_F(ResultsTests, test_query_batch_diff) {
+  RowTyped r1, r2, r3;
+  r1["foo"] = "bar";
+  r1["num"] = 1LL;
+  r2["foo"] = "baz";
+  r2["num"] = 2LL;
+  r3["foo"] = "boo";
+  r3["num"] = 3.0;
+
+  auto old_batch = QueryBatch::fromRows({r1, r2, r2});
+  auto new_batch = QueryBatch::fromRows({r2, r3, r1});
+
+  auto results = diff(old_batch, new_batch);
+  EXPECT_EQ(results.added, QueryDataTyped({r3}));
+  EXPECT_EQ(results.removed, QueryDataTyped({r2}));
+
+  // Column order does not change row identity.
+  QueryBatch reordered(ColumnNames{"num", "foo"});
+  reordered.appendRow(r1);
+  reordered.appendRow(r2);
+  reordered.appendRow(r2);
+  EXPECT_TRUE(diff(old_batch, reordered).hasNoResults());
+}
+
+TEST_F(ResultsTests, test_hashed_results_round_trip) {
+  auto results = getSerializedQueryData();
+  auto batch = QueryBatch::fromRows(results.second);
+
+  std::string stored;
+  EXPECT_TRUE(serializeHashedResults(batch, stored).ok());
+  EXPECT_TRUE(isHashedResults(stored));
+
+  QueryBatch output;
+  EXPECT_TRUE(deserializeHashedResults(stored, output).ok());
+  EXPECT_EQ(output, batch);
+
+  // Truncated records are rejected rather than partially decoded.
+  QueryBatch truncated;
+  stored.resize(stored.size() - 1);
+  EXPECT_FALSE(deserializeHashedResults(stored, truncated).ok());
+}
+
+TEST_F(ResultsTests, test_hashed_results_diff) {
+  RowTyped r1, r2, r3;
+  r1["foo"] = "bar";
+  r1["num"] = 1LL;
+  r2["foo"] = "baz";
+  r2["num"] = 2LL;
+  r3["foo"] = "boo";
+  r3["num"] = 3.0;
+
+  std::string stored;
+  EXPECT_TRUE(
+      serializeHashedResults(QueryBatch::fromRows({r1, r2, r2}), stored).ok());
+
+  // Rows with the same content produce the same digest in any batch.
+  EXPECT_EQ(QueryBatch::fromRows({r1}).rowDigest(0),
+            QueryBatch::fromRows({r2, r1}).rowDigest(1));
+  EXPECT_NE(QueryBatch::fromRows({r1}).rowDigest(0),
+            QueryBatch::fromRows({r2}).rowDigest(0));
+
+  DiffResults dr;
+  std::string next;
+  auto current = QueryBatch::fromRows({r2, r3, r1});
+  EXPECT_TRUE(diffHashedResults(stored, current, dr, next).ok());
+  EXPECT_EQ(dr.added, QueryDataTyped({r3}));
+  EXPECT_EQ(dr.removed, QueryDataTyped({r2}));
+
+  // The next record is equivalent to serializing the current results.
+  QueryBatch decoded;
+  EXPECT_TRUE(deserializeHashedResults(next, decoded).ok());
+  EXPECT_EQ(decoded, current);
+
+  // Without changes the next record is not produced.
+  DiffResults unchanged;
+  std::string untouched;
+  EXPECT_TRUE(diffHashedResults(next, current, unchanged, untouched).ok());
+  EXPECT_TRUE(unchanged.hasNoResults());
+  EXPECT_TRUE(untouched.empty());
+}
+
+TEST_F(ResultsTests, test_hashed_results_previous_format) {
+  RowTyped r1, r2;
+  r1["foo"] = "bar";
+  r2["foo"] = "baz";
+  auto previous = QueryBatch::fromRows({r1, r2});
+
+  // A record of the first format interleaves each digest with its row.
+  std::string stored("\0HR1", 4);
+  auto write = [&stored](uint64_t v, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+      stored.push_back(static_cast<char>((v >> (i * 8)) & 0xff));
+    }
+  };
+  for (size_t i = 0; i < previous.size(); i++) {
+    std::string json;
+    ASSERT_TRUE(serializeQueryBatchRowJSON(previous, i, json, true).ok());
+    write(previous.rowDigest(i)[0], 8);
+    write(previous.rowDigest(i)[1], 8);
+    write(json.size(), 4);
+    stored += json;
+  }
+  EXPECT_TRUE(isHashedResults(stored));
+
+  QueryBatch decoded;
+  EXPECT_TRUE(deserializeHashedResults(stored, decoded).ok());
+  EXPECT_EQ(decoded, previous);
+
+  // Changed results are stored in the current format.
+  DiffResults dr;
+  std::string next;
+  auto current = QueryBatch::fromRows({r2});
+  EXPECT_TRUE(diffHashedResults(stored, current, dr, next).ok());
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_EQ(dr.removed, QueryDataTyped({r1}));
+  EXPECT_EQ(next.compare(0, kHashedResultsMagic.size(), kHashedResultsMagic),
+            0);
+}
+
 TEST_F(ResultsTests, test_adding_duplicate_rows_to_query_data) {
   RowTyped r1, r2, r3;
   r1["foo"] = "bar";
@@ -35,6 +35,38 @@ class EphemeralDatabasePluginTests : public DatabasePluginTests {
 // Define the default set of database plugin operation tests.
 CREATE_DATABASE_TESTS(EphemeralDatabasePluginTests);
 
+TEST_F(EphemeralDatabasePluginTests, test_concurrent_domains) {
+  auto writer = [this](const std::string& domain) {
+    for (size_t i = 0; i < 1000; i++) {
+      getPlugin()->put(domain, "key" + std::to_string(i), "value");
+    }
+  };
+
+  auto events = std::async(std::launch::async, writer, kEvents);
+  auto logs = std::async(std::launch::async, writer, kLogs);
+
+  // Readers and cursors may run while both domains are written.
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < 100; i++) {
+    keys.clear();
+    getPlugin()->scan(kEvents, keys, "key", 0);
+
+    DatabaseCursorRef cursor;
+    getPlugin()->openCursor(kLogs, DatabaseCursorOptions(), cursor);
+    for (; cursor->valid(); cursor->next()) {
+    }
+  }
+  events.get();
+  logs.get();
+
+  keys.clear();
+  getPlugin()->scan(kEvents, keys, "key", 0);
+  EXPECT_EQ(keys.size(), 1000U);
+  keys.clear();
+  getPlugin()->scan(kLogs, keys, "key", 0);
+  EXPECT_EQ(keys.size(), 1000U);
+}
+
 void DatabasePluginTests::SetUp() {
   platformSetup();
   registryAndPluginInit();
@@ -188,6 +220,22 @@ void DatabasePluginTests::testGet() {
   reset.get();
 }
 
+void DatabasePluginTests::testGetBatch() {
+  getPlugin()->putBatch(kQueries,
+                        {{"test_get_batch1", "one"}, {"test_get_batch2", "two"}});
+
+  std::vector<std::string> values;
+  auto s = getPlugin()->getBatch(
+      kQueries,
+      {"test_get_batch2", "test_get_batch_missing", "test_get_batch1"},
+      values);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(values.size(), 3U);
+  EXPECT_EQ(values[0], "two");
+  EXPECT_TRUE(values[1].empty());
+  EXPECT_EQ(values[2], "one");
+}
+
 void DatabasePluginTests::testDelete() {
   getPlugin()->put(kQueries, "test_delete", "baz");
   auto s = getPlugin()->remove(kQueries, "test_delete");
@@ -269,4 +317,92 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testScanValues() {
+  getPlugin()->put(kQueries, "test_scan_values_foo2", "bar2");
+  getPlugin()->put(kQueries, "test_scan_values_foo1", "bar1");
+  getPlugin()->put(kQueries, "test_scan_values_foo3", "bar3");
+  getPlugin()->put(kQueries, "test_scan_other", "baz");
+
+  DatabaseStringValueList values;
+  DatabaseStringValueList expected = {{"test_scan_values_foo1", "bar1"},
+                                      {"test_scan_values_foo2", "bar2"},
+                                      {"test_scan_values_foo3", "bar3"}};
+  auto s = getPlugin()->scanValues(kQueries, values, "test_scan_values_", 0);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(expected, values);
+
+  values.clear();
+  s = getPlugin()->scanValues(kQueries, values, "test_scan_values_", 2);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(values.size(), 2U);
+  EXPECT_EQ(values[1].first, "test_scan_values_foo2");
+}
+
+void DatabasePluginTests::testCursor() {
+  getPlugin()->put(kQueries, "test_cursor_foo2", "bar2");
+  getPlugin()->put(kQueries, "test_cursor_foo1", "bar1");
+  getPlugin()->put(kQueries, "test_cursor_foo3", "bar3");
+  getPlugin()->put(kQueries, "test_cursor_other", "baz");
+  getPlugin()->put(kQueries, "test_cursos", "baz");
+
+  DatabaseCursorOptions options;
+  options.prefix = "test_cursor_foo";
+  DatabaseCursorRef cursor;
+  auto s = getPlugin()->openCursor(kQueries, options, cursor);
+  ASSERT_TRUE(s.ok());
+
+  DatabaseStringValueList values;
+  for (; cursor->valid(); cursor->next()) {
+    values.push_back(std::make_pair(cursor->key(), cursor->value()));
+  }
+  EXPECT_TRUE(cursor->status().ok());
+
+  DatabaseStringValueList expected = {{"test_cursor_foo1", "bar1"},
+                                      {"test_cursor_foo2", "bar2"},
+                                      {"test_cursor_foo3", "bar3"}};
+  EXPECT_EQ(expected, values);
+
+  // The lower and upper bounds narrow the prefix range.
+  options.lower = "test_cursor_foo2";
+  options.upper = "test_cursor_foo3";
+  s = getPlugin()->openCursor(kQueries, options, cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(cursor->valid());
+  EXPECT_EQ(cursor->key(), "test_cursor_foo2");
+  cursor->next();
+  EXPECT_FALSE(cursor->valid());
+
+  // A snapshot cursor does not see later writes or removals.
+  options = DatabaseCursorOptions();
+  options.prefix = "test_cursor_foo";
+  options.snapshot = true;
+  s = getPlugin()->openCursor(kQueries, options, cursor);
+  ASSERT_TRUE(s.ok());
+  getPlugin()->remove(kQueries, "test_cursor_foo2");
+  getPlugin()->put(kQueries, "test_cursor_foo4", "bar4");
+
+  values.clear();
+  for (; cursor->valid(); cursor->next()) {
+    values.push_back(std::make_pair(cursor->key(), cursor->value()));
+  }
+  EXPECT_EQ(expected, values);
+  cursor.reset();
+
+  // Keys may be removed while a cursor is visiting them.
+  options.snapshot = false;
+  s = getPlugin()->openCursor(kQueries, options, cursor);
+  ASSERT_TRUE(s.ok());
+  size_t visited = 0;
+  for (; cursor->valid(); cursor->next()) {
+    getPlugin()->remove(kQueries, cursor->key());
+    visited++;
+  }
+  EXPECT_EQ(visited, 3U);
+  cursor.reset();
+
+  std::vector<std::string> keys;
+  getPlugin()->scan(kQueries, keys, "test_cursor_foo", 0);
+  EXPECT_TRUE(keys.empty());
+}
 } // namespace osquery
@@ -30,6 +30,9 @@
   TEST_F(n, test_get) {                                                        \
     testGet();                                                                 \
   }                                                                            \
+  TEST_F(n, test_getBatch) {                                                   \
+    testGetBatch();                                                            \
+  }                                                                            \
   TEST_F(n, test_delete) {                                                     \
     testDelete();                                                              \
   }                                                                            \
@@ -41,6 +44,12 @@
   }                                                                            \
   TEST_F(n, test_scan_limit) {                                                 \
     testScanLimit();                                                           \
+  }                                                                            \
+  TEST_F(n, test_scan_values) {                                                \
+    testScanValues();                                                          \
+  }                                                                            \
+  TEST_F(n, test_cursor) {                                                     \
+    testCursor();                                                              \
   }
 
 namespace osquery {
@@ -91,9 +100,12 @@ class DatabasePluginTests : public testing::Test {
   void testPut();
   void testPutBatch();
   void testGet();
+  void testGetBatch();
   void testDelete();
   void testDeleteRange();
   void testScan();
   void testScanLimit();
+  void testScanValues();
+  void testCursor();
 };
 } // namespace osquery
@@ -91,12 +91,13 @@ std::string generateRow(const Row& r,
       size = column.size() - utf8StringSize(FLAGS_nullvalue);
       out += FLAGS_nullvalue;
     } else {
+      // Values longer than the column, sized from earlier rows, overflow it.
       int buffer_size =
           static_cast<int>(lengths.at(column) - utf8StringSize(r.at(column)));
-      if (buffer_size >= 0) {
+      if (buffer_size > 0) {
         size = static_cast<size_t>(buffer_size);
-        out += r.at(column);
       }
+      out += r.at(column);
     }
     out += std::string(size + 1, ' ');
   }
@@ -60,10 +60,16 @@ namespace osquery {
 SHELL_FLAG(bool, csv, false, "Set output mode to 'csv'");
 SHELL_FLAG(bool, json, false, "Set output mode to 'json'");
 SHELL_FLAG(bool, json_pretty, false, "Set output mode to 'json_pretty'");
+SHELL_FLAG(bool, jsonl, false, "Set output mode to 'jsonl'");
 SHELL_FLAG(bool, line, false, "Set output mode to 'line'");
 SHELL_FLAG(bool, list, false, "Set output mode to 'list'");
 SHELL_FLAG(string, separator, "|", "Set output field separator, default '|'");
 SHELL_FLAG(bool, header, true, "Toggle column headers true/false");
+SHELL_FLAG(uint64,
+           pretty_window,
+           0,
+           "Size pretty columns from the first N rows then print each row as "
+           "it is returned (0 sizes them from all rows)");
 SHELL_FLAG(string, pack, "", "Run all queries in a pack");
 
 /// Define short-hand shell switches.
@@ -97,6 +103,7 @@ static char zHelp[] =
     ".mode MODE       Set output mode where MODE is one of:\n"
     "                   csv      Comma-separated values\n"
     "                   column   Left-aligned columns see .width\n"
+    "                   jsonl    One JSON object per line\n"
     "                   line     One value per line\n"
     "                   list     Values delimited by .separator string\n"
     "                   pretty   Pretty printed SQL results (default)\n"
@@ -122,6 +129,7 @@ static char zTimerHelp[] =
 #define MODE_Semi 3 // Same as MODE_List but append ";" to each line
 #define MODE_Csv 4 // Quote strings, numbers are plain
 #define MODE_Pretty 5 // Pretty print the SQL results
+#define MODE_JsonLines 6 // One JSON object per record
 
 static const char* modeDescr[] = {
     "line",
@@ -130,6 +138,7 @@ static const char* modeDescr[] = {
     "semi",
     "csv",
     "pretty",
+    "jsonl",
 };
 
 // ctype macros that work with signed characters
@@ -358,6 +367,13 @@ struct prettyprint_data {
   osquery::QueryData results;
   std::vector<std::string> columns;
   std::map<std::string, size_t> lengths;
+
+  /* Rows are printed as they are returned, after the header */
+  bool streaming{false};
+  std::string separator;
+
+  /* Number of rows printed by the streaming JSON output */
+  size_t json_rows{0};
 };
 
 /*
@@ -514,6 +530,59 @@ static void interrupt_handler(int signal) {
 }
 #endif
 
+/*
+** Build an osquery row from the values of a query result.
+*/
+static osquery::Row shell_row(int nArg,
+                              const char** azArg,
+                              const char** azCol) {
+  osquery::Row r;
+  for (int i = 0; i < nArg; ++i) {
+    if (azCol[i] != nullptr) {
+      r[std::string(azCol[i])] = (azArg[i] == nullptr)
+                                     ? osquery::FLAGS_nullvalue
+                                     : std::string(azArg[i]);
+    }
+  }
+  return r;
+}
+
+/*
+** Print a row of the JSON array output, opening the array first.
+*/
+static void json_print_row(struct callback_data* p, const osquery::Row& r) {
+  std::string row_string;
+  if (!osquery::serializeRowJSON(r, row_string).ok()) {
+    return;
+  }
+
+  printf("%s  %s",
+         p->prettyPrint->json_rows == 0 ? "[\n" : ",\n",
+         row_string.c_str());
+  p->prettyPrint->json_rows++;
+}
+
+/*
+** Print the header sized from the rows buffered so far, then those rows.
+** Further rows are printed as they are returned, longer values overflow
+** their column.
+*/
+static void pretty_print_start_streaming(struct callback_data* p) {
+  auto* pp = p->prettyPrint;
+  osquery::computeRowLengths(pp->results.front(), pp->lengths, true);
+  pp->separator = osquery::generateToken(pp->lengths, pp->columns);
+  auto header = pp->separator +
+                osquery::generateHeader(pp->lengths, pp->columns) +
+                pp->separator;
+  printf("%s", header.c_str());
+
+  for (const auto& row : pp->results) {
+    printf("%s", osquery::generateRow(row, pp->lengths, pp->columns).c_str());
+  }
+  pp->results.clear();
+  pp->streaming = true;
+}
+
 /*
 ** This is the callback routine that the shell
 ** invokes for each row of a query result.
@@ -534,16 +603,35 @@ static int shell_callback(void* pArg,
       }
     }
 
-    osquery::Row r;
-    for (i = 0; i < nArg; ++i) {
-      if (azCol[i] != nullptr) {
-        r[std::string(azCol[i])] = (azArg[i] == nullptr)
-                                       ? osquery::FLAGS_nullvalue
-                                       : std::string(azArg[i]);
-      }
+    auto r = shell_row(nArg, azArg, azCol);
+    if (osquery::FLAGS_json && !osquery::FLAGS_json_pretty) {
+      // The JSON array is printed as rows are returned.
+      json_print_row(p, r);
+      break;
     }
+
+    if (p->prettyPrint->streaming) {
+      printf("%s",
+             osquery::generateRow(
+                 r, p->prettyPrint->lengths, p->prettyPrint->columns)
+                 .c_str());
+      break;
+    }
+
     osquery::computeRowLengths(r, p->prettyPrint->lengths);
-    p->prettyPrint->results.push_back(r);
+    p->prettyPrint->results.push_back(std::move(r));
+    if (osquery::FLAGS_pretty_window > 0 && !osquery::FLAGS_json_pretty &&
+        p->prettyPrint->results.size() >= osquery::FLAGS_pretty_window) {
+      pretty_print_start_streaming(p);
+    }
+    break;
+  }
+  case MODE_JsonLines: {
+    std::string row_string;
+    if (osquery::serializeRowJSON(shell_row(nArg, azArg, azCol), row_string)
+            .ok()) {
+      fprintf(p->out, "%s\n", row_string.c_str());
+    }
     break;
   }
   case MODE_Line: {
@@ -773,7 +861,12 @@ static void pretty_print_if_needed(struct callback_data* pArg) {
     if (osquery::FLAGS_json_pretty) {
       osquery::jsonPrettyPrint(pArg->prettyPrint->results);
     } else if (osquery::FLAGS_json) {
-      osquery::jsonPrint(pArg->prettyPrint->results);
+      // The rows were printed as they were returned, close the array.
+      printf("%s\n]\n", pArg->prettyPrint->json_rows == 0 ? "[\n" : "");
+      pArg->prettyPrint->json_rows = 0;
+    } else if (pArg->prettyPrint->streaming) {
+      printf("%s", pArg->prettyPrint->separator.c_str());
+      pArg->prettyPrint->streaming = false;
     } else {
       osquery::prettyPrint(pArg->prettyPrint->results,
                            pArg->prettyPrint->columns,
@@ -1364,10 +1457,12 @@ static int do_meta_command(char* zLine, struct callback_data* p) {
     } else if (n2 == 3 && strncmp(azArg[1], "csv", n2) == 0) {
       p->mode = MODE_Csv;
       sqlite3_snprintf(sizeof(p->separator), p->separator, ",");
+    } else if (n2 == 5 && strncmp(azArg[1], "jsonl", n2) == 0) {
+      p->mode = MODE_JsonLines;
     } else {
       fprintf(stderr,
               "Error: mode should be one of: "
-              "column csv line list pretty\n");
+              "column csv jsonl line list pretty\n");
       rc = 1;
     }
   } else if (c == 'n' && strncmp(azArg[0], "nullvalue", n) == 0 && nArg == 2) {
@@ -1742,6 +1837,8 @@ int launchIntoShell(int argc, char** argv) {
   } else if (FLAGS_csv) {
     data.mode = MODE_Csv;
     data.separator[0] = ',';
+  } else if (FLAGS_jsonl) {
+    data.mode = MODE_JsonLines;
   } else {
     data.mode = MODE_Pretty;
   }
@@ -93,6 +93,16 @@ TEST_F(PrinterTests, test_generate_row) {
   EXPECT_EQ(results, expected);
 }
 
+TEST_F(PrinterTests, test_generate_row_overflow) {
+  // Columns sized from the first row only, as the streaming output does.
+  std::map<std::string, size_t> lengths;
+  computeRowLengths(q.front(), lengths);
+
+  auto results = generateRow(q.back(), lengths, order);
+  auto expected = "| Doctor Who | 2000 | fish sticks and custard | 11 |\n";
+  EXPECT_EQ(results, expected);
+}
+
 TEST_F(PrinterTests, test_unicode) {
   Row r = {{"name", "Àlex Smith"}};
   std::map<std::string, size_t> lengths;
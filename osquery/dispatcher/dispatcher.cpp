@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+
 #include <osquery/core/flags.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/logger/logger.h>
@@ -14,8 +16,160 @@
 
 namespace osquery {
 
-/// The worker_threads define the default thread pool size.
-FLAG(int32, worker_threads, 4, "Number of work dispatch threads");
+/// The worker_threads run the periodic services.
+FLAG(int32,
+     worker_threads,
+     4,
+     "Number of threads shared by the periodic services (0 gives each its "
+     "own thread)");
+
+/**
+ * @brief The threads running the ticks of the periodic services.
+ *
+ * Services wait in a single queue ordered by the time of their next tick,
+ * any idle thread runs the next one due. The threads are started with the
+ * first service and stopped once every service ended.
+ */
+class PeriodicServicePool : private boost::noncopyable {
+ public:
+  static PeriodicServicePool& instance() {
+    static PeriodicServicePool pool;
+    return pool;
+  }
+
+  ~PeriodicServicePool();
+
+  /// Schedule the first tick of a service.
+  void add(std::shared_ptr<PeriodicRunnable> service);
+
+  /// End the interrupted services waiting for their next tick.
+  void cancelInterrupted();
+
+  /// Wait for every service to end, then stop the threads.
+  void join();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  /// The loop of a pool thread.
+  void work();
+
+  /// Stop and join the threads, dropping the queued services.
+  void stop(std::unique_lock<std::mutex>& lock);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  /// Services by the time of their next tick.
+  std::multimap<Clock::time_point, std::shared_ptr<PeriodicRunnable>> queue_;
+
+  /// Services queued or running a tick.
+  size_t services_{0};
+
+  std::vector<std::thread> threads_;
+  bool stopping_{false};
+};
+
+void PeriodicServicePool::add(std::shared_ptr<PeriodicRunnable> service) {
+  service->run_ = true;
+  auto delay = std::max(service->firstDelay(), std::chrono::milliseconds(0));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  services_++;
+  queue_.emplace(Clock::now() + delay, std::move(service));
+  if (threads_.empty()) {
+    auto count = static_cast<size_t>(std::max(FLAGS_worker_threads, 1));
+    for (size_t i = 0; i < count; i++) {
+      threads_.emplace_back(&PeriodicServicePool::work, this);
+    }
+  }
+  cv_.notify_one();
+}
+
+void PeriodicServicePool::work() {
+  setThreadName("PeriodicServices");
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (queue_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+
+    auto next = queue_.begin();
+    if (next->first > Clock::now() && !next->second->interrupted()) {
+      // Other threads may take this service while waiting.
+      auto deadline = next->first;
+      cv_.wait_until(lock, deadline);
+      continue;
+    }
+
+    auto service = std::move(next->second);
+    queue_.erase(next);
+
+    // Another thread may run the next service while this one ticks.
+    cv_.notify_one();
+    lock.unlock();
+    auto delay = service->interrupted() ? PeriodicRunnable::kDone
+                                        : service->tick();
+    if (service->interrupted() || delay < std::chrono::milliseconds(0)) {
+      // The Dispatcher lock is taken before the pool lock, never after.
+      Dispatcher::removeService(service.get());
+      lock.lock();
+      services_--;
+      cv_.notify_all();
+      continue;
+    }
+
+    lock.lock();
+    queue_.emplace(Clock::now() + delay, std::move(service));
+  }
+}
+
+void PeriodicServicePool::cancelInterrupted() {
+  // The pool threads end the interrupted services.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = queue_.begin(); it != queue_.end();) {
+    if (it->second->interrupted()) {
+      auto service = std::move(it->second);
+      it = queue_.erase(it);
+      queue_.emplace(Clock::time_point::min(), std::move(service));
+    } else {
+      ++it;
+    }
+  }
+  cv_.notify_all();
+}
+
+void PeriodicServicePool::join() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return services_ == 0; });
+  stop(lock);
+}
+
+void PeriodicServicePool::stop(std::unique_lock<std::mutex>& lock) {
+  std::vector<std::thread> threads;
+  threads.swap(threads_);
+  stopping_ = true;
+  cv_.notify_all();
+
+  lock.unlock();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  lock.lock();
+
+  queue_.clear();
+  services_ = 0;
+  stopping_ = false;
+}
+
+PeriodicServicePool::~PeriodicServicePool() {
+  // Services were not joined, the process is exiting.
+  std::unique_lock<std::mutex> lock(mutex_);
+  stop(lock);
+}
 
 void InterruptibleRunnable::interrupt() {
   // Set the service as interrupted.
@@ -40,6 +194,17 @@ void InterruptibleRunnable::pause(std::chrono::milliseconds milli) {
   }
 }
 
+void PeriodicRunnable::start() {
+  auto delay = std::max(firstDelay(), std::chrono::milliseconds(0));
+  while (!interrupted() && delay >= std::chrono::milliseconds(0)) {
+    pause(delay);
+    if (interrupted()) {
+      break;
+    }
+    delay = tick();
+  }
+}
+
 void InternalRunnable::run() {
   run_ = true;
   setThreadName(name());
@@ -73,6 +238,15 @@ Status Dispatcher::addService(InternalRunnableRef service) {
       return Status(1, "Cannot add service, dispatcher is stopping");
     }
 
+    auto periodic = std::dynamic_pointer_cast<PeriodicRunnable>(service);
+    if (periodic != nullptr && FLAGS_worker_threads > 0) {
+      VLOG(1) << "Adding new periodic service: " << service->name() << " ("
+              << service.get() << ") in process " << platformGetPid();
+      self.services_.push_back(std::move(service));
+      PeriodicServicePool::instance().add(std::move(periodic));
+      return Status::success();
+    }
+
     auto thread = std::make_unique<std::thread>(
         std::bind(&InternalRunnable::run, &*service));
     VLOG(1) << "Adding new service: " << service->name() << " ("
@@ -131,7 +305,6 @@ void Dispatcher::joinServices() {
         thread = std::move(self.service_threads_.back());
         self.service_threads_.pop_back();
       } else {
-        self.services_.clear();
         break;
       }
     }
@@ -141,6 +314,13 @@ void Dispatcher::joinServices() {
     }
   }
 
+  // Then wait for the periodic services to end.
+  PeriodicServicePool::instance().join();
+  {
+    WriteLock lock(self.mutex_);
+    self.services_.clear();
+  }
+
   VLOG(1) << "Services and threads have been cleared";
 }
 
@@ -155,5 +335,8 @@ void Dispatcher::stopServices() {
     service->interrupt();
     VLOG(1) << "Service: " << service.get() << " has been interrupted";
   }
+
+  // Queued periodic services are not waiting on their own pause.
+  PeriodicServicePool::instance().cancelInterrupted();
 }
 } // namespace osquery
@@ -27,6 +27,7 @@ namespace osquery {
 
 class Status;
 class Dispatcher;
+class PeriodicServicePool;
 
 class InterruptibleRunnable {
  public:
@@ -110,6 +111,44 @@ class InternalRunnable : private boost::noncopyable,
 
  private:
   std::atomic<bool> run_{false};
+
+ private:
+  friend class PeriodicServicePool;
+};
+
+/**
+ * @brief A service doing periodic work on threads shared with other services.
+ *
+ * Polling services loop doing some work then pausing, most of their thread's
+ * life is spent sleeping. A periodic service implements one round of that
+ * work as `tick`, which the Dispatcher runs on the --worker_threads shared by
+ * every periodic service. Between ticks the service holds no thread.
+ *
+ * A tick should not block for long. Services waiting on I/O or events, such
+ * as event publishers, remain InternalRunnable%s with threads of their own.
+ */
+class PeriodicRunnable : public InternalRunnable {
+ public:
+  explicit PeriodicRunnable(const std::string& name) : InternalRunnable(name) {}
+
+  /// The delay returned by `tick` to end the service.
+  static constexpr std::chrono::milliseconds kDone{-1};
+
+ protected:
+  /// Do one round of work, returning the delay until the next one.
+  virtual std::chrono::milliseconds tick() = 0;
+
+  /// The delay before the first tick.
+  virtual std::chrono::milliseconds firstDelay() {
+    return std::chrono::milliseconds(0);
+  }
+
+ private:
+  /// Run the ticks on a thread of its own, if --worker_threads is 0.
+  void start() override final;
+
+ private:
+  friend class PeriodicServicePool;
 };
 
 /// An internal runnable used throughout osquery as dispatcher services.
@@ -134,7 +173,12 @@ class Dispatcher : private boost::noncopyable {
    */
   static Dispatcher& instance();
 
-  /// See `add`, but services are not limited to a thread poll size.
+  /**
+   * @brief Start a service.
+   *
+   * Each InternalRunnable gets a thread of its own. PeriodicRunnable%s are
+   * scheduled on the shared --worker_threads instead.
+   */
   static Status addService(InternalRunnableRef service);
 
   /// See `join`, but applied to osquery services.
@@ -188,6 +232,7 @@ class Dispatcher : private boost::noncopyable {
 
  private:
   friend class InternalRunnable;
+  friend class PeriodicServicePool;
 
   // Tests
   friend class ConfigTests;
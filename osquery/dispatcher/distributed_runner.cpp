@@ -13,6 +13,7 @@
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/distributed/distributed.h>
+#include <osquery/remote/backoff.h>
 
 #include <osquery/utils/system/time.h>
 #include <osquery/dispatcher/distributed_runner.h>
@@ -26,6 +27,7 @@ FLAG(uint64,
      "Seconds between polling for new queries (default 60)")
 
 DECLARE_bool(disable_distributed);
+DECLARE_uint64(distributed_long_poll);
 DECLARE_string(distributed_plugin);
 
 const size_t kDistributedAccelerationInterval = 5;
@@ -33,9 +35,23 @@ const size_t kDistributedAccelerationInterval = 5;
 void DistributedRunner::start() {
   auto dist = Distributed();
   while (!interrupted()) {
+    auto poll_start = std::chrono::steady_clock::now();
     dist.pullUpdates();
+    auto poll_time = std::chrono::steady_clock::now() - poll_start;
     if (dist.getPendingQueryCount() > 0) {
       dist.runQueries();
+      if (FLAGS_distributed_long_poll > 0) {
+        // More queries may be waiting, ask for them right away.
+        continue;
+      }
+    }
+
+    // A server that held the request until the long poll expired is asked
+    // again right away, a server that does not hold requests is polled at
+    // the distributed_interval.
+    if (FLAGS_distributed_long_poll > 0 &&
+        poll_time >= std::chrono::seconds(FLAGS_distributed_long_poll)) {
+      continue;
     }
 
     std::string accelerate_checkins_expire_str = "-1";
@@ -45,7 +61,9 @@ void DistributedRunner::start() {
     if (!status.ok() || getUnixTime() > tryTo<unsigned long int>(
                                             accelerate_checkins_expire_str, 10)
                                             .takeOr(0ul)) {
-      pause(std::chrono::seconds(FLAGS_distributed_interval));
+      // Nodes started together should not poll together.
+      pause(std::chrono::milliseconds(
+          RemoteBackoff::get().jitter(FLAGS_distributed_interval * 1000)));
     } else {
       pause(std::chrono::seconds(kDistributedAccelerationInterval));
     }
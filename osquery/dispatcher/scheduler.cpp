@@ -8,7 +8,16 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <thread>
 
 #include <boost/format.hpp>
 #include <boost/io/detail/quoted_manip.hpp>
@@ -17,13 +26,17 @@
 #include <osquery/config/config.h>
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
 #include <osquery/core/query.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/tables.h>
+#include <osquery/core/trace.h>
 #include <osquery/database/database.h>
+#include <osquery/hashing/hashing.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
-#include <osquery/process/process.h>
 #include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/query_resource_meter.h>
 
 #include <osquery/utils/system/time.h>
 
@@ -43,21 +56,202 @@ FLAG(uint64, schedule_max_drift, 60, "Max time drift in seconds");
 FLAG(uint64,
      schedule_reload,
      3600,
-     "Interval in seconds to reload database arenas");
+     "Interval in seconds to reload database arenas, 0 disables reloads");
+
+FLAG(uint32,
+     schedule_reload_fragmentation,
+     0,
+     "Reload when this percent of the heap stays free after releasing "
+     "memory, or when memory outgrows its bounds, instead of every "
+     "schedule_reload seconds (0 disables)");
 
 FLAG(uint64, schedule_epoch, 0, "Epoch for scheduled queries");
 
+FLAG(bool,
+     schedule_cost_splay,
+     false,
+     "Offset scheduled query executions to balance their measured cost");
+
+FLAG(uint64,
+     schedule_threads,
+     0,
+     "Number of threads running due scheduled queries in parallel (0 or 1 "
+     "runs them sequentially)");
+
+FLAG(uint64,
+     schedule_maintenance,
+     900,
+     "Interval in seconds to compact database space freed by expired events "
+     "and results (0 disables)");
+
+FLAG(uint64,
+     schedule_query_cpu_budget,
+     0,
+     "Milliseconds of CPU time a scheduled query execution may use before it "
+     "is stopped and denylisted (0 for no limit)");
+
+FLAG(uint64,
+     schedule_query_memory_budget,
+     0,
+     "Megabytes of resident memory a scheduled query execution may add "
+     "before it is stopped and denylisted (0 for no limit)");
+
+FLAG(bool,
+     snapshot_fingerprint,
+     false,
+     "Log only the fingerprint of snapshot results that did not change");
+
+FLAG(uint64,
+     snapshot_fingerprint_refresh,
+     3600,
+     "Seconds between full logs of unchanged snapshot results (0 logs them "
+     "only when they change)");
+
 HIDDEN_FLAG(bool,
             schedule_reload_sql,
             false,
             "Reload the SQL implementation during schedule reload");
 
+/// Steps between rebalancing the schedule with updated query costs.
+const uint64_t kScheduleBalanceInterval{3600};
+
+/// Upper bound on the phases considered for a single query.
+const uint64_t kMaxSchedulePhases{300};
+
+/// Steps without due queries required before database maintenance starts.
+const uint64_t kMaintenanceIdleSteps{5};
+
+/// Steps before the first maintenance compacts a database opened lazily.
+const uint64_t kStartupMaintenanceDelay{60};
+
+/// Steps between compiles of an unchanged schedule.
+///
+/// Pack discovery queries and denylist expirations are only evaluated while
+/// the config's schedule is read.
+const uint64_t kScheduleCompileInterval{60};
+
+/// Steps between recording database statistics to numeric monitoring.
+const uint64_t kDatabaseStatsInterval{60};
+
+/// Steps between memory measurements deciding an adaptive reload.
+const uint64_t kScheduleReloadCheckInterval{60};
+
+/// Minimum steps between two adaptive reloads.
+const uint64_t kScheduleReloadMinInterval{300};
+
+/// Steps between recording memory statistics to numeric monitoring.
+const uint64_t kMemoryStatsInterval{60};
+
+/// Steps between checks for free heap memory to release.
+const uint64_t kMemoryReleaseInterval{60};
+
 /// Used to bypass (optimize-out) the set-differential of query results.
 DECLARE_bool(events_optimize);
 DECLARE_bool(enable_numeric_monitoring);
+DECLARE_bool(lazy_startup);
+DECLARE_uint32(malloc_trim_threshold);
+
+namespace {
+
+/// The last fully logged snapshot of a query.
+struct LoggedSnapshot {
+  std::string fingerprint;
+  uint64_t time{0};
+};
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
-  if (FLAGS_enable_numeric_monitoring) {
+/// Protects kLoggedSnapshots.
+Mutex kLoggedSnapshotsMutex;
+
+/// The last fully logged snapshot of each fingerprinted query.
+std::map<std::string, LoggedSnapshot> kLoggedSnapshots;
+
+bool useSnapshotFingerprint(const ScheduledQuery& query) {
+  auto it = query.options.find("fingerprint");
+  return (it != query.options.end()) ? it->second : FLAGS_snapshot_fingerprint;
+}
+
+/// Check if the snapshot matches the last one logged, within the refresh.
+bool isSnapshotUnchanged(const std::string& name,
+                         const std::string& fingerprint,
+                         uint64_t time) {
+  ReadLock lock(kLoggedSnapshotsMutex);
+  auto it = kLoggedSnapshots.find(name);
+  if (it == kLoggedSnapshots.end() || it->second.fingerprint != fingerprint) {
+    return false;
+  }
+  return FLAGS_snapshot_fingerprint_refresh == 0 ||
+         time < it->second.time + FLAGS_snapshot_fingerprint_refresh;
+}
+
+void recordLoggedSnapshot(const std::string& name,
+                          const std::string& fingerprint,
+                          uint64_t time) {
+  WriteLock lock(kLoggedSnapshotsMutex);
+  kLoggedSnapshots[name] = {fingerprint, time};
+}
+
+void updateFingerprint(Hash& hash, const std::string& value) {
+  auto size = static_cast<uint64_t>(value.size());
+  hash.update(&size, sizeof(size));
+  hash.update(value.data(), value.size());
+}
+
+/// Set while a maintenance runner exists, only one runs at a time.
+std::atomic<bool> kDatabaseMaintenanceRunning{false};
+
+/**
+ * @brief Run database maintenance off the scheduler thread.
+ *
+ * Compactions block their caller until they complete, this ephemeral runner
+ * keeps the schedule on time while they are written at a throttled rate.
+ */
+class DatabaseMaintenanceRunner : public InternalRunnable {
+ public:
+  DatabaseMaintenanceRunner() : InternalRunnable("DatabaseMaintenanceRunner") {
+    kDatabaseMaintenanceRunning = true;
+  }
+
+  void start() override {
+    auto status = maintainDatabase();
+    if (!status.ok()) {
+      VLOG(1) << "Database maintenance failed: " << status.getMessage();
+    }
+    kDatabaseMaintenanceRunning = false;
+  }
+};
+
+/// Check a query execution against the scheduled query budgets.
+Status checkQueryBudget(const QueryResourceUsage& start) {
+  auto usage = QueryResourceMeter::sample();
+  auto cpu_time = (usage.user_time + usage.system_time) -
+                  std::min(usage.user_time + usage.system_time,
+                           start.user_time + start.system_time);
+  if (FLAGS_schedule_query_cpu_budget > 0 &&
+      cpu_time > FLAGS_schedule_query_cpu_budget) {
+    return Status::failure("Query exceeded its CPU budget of " +
+                           std::to_string(FLAGS_schedule_query_cpu_budget) +
+                           "ms");
+  }
+
+  auto memory = usage.resident_size -
+                std::min(usage.resident_size, start.resident_size);
+  if (FLAGS_schedule_query_memory_budget > 0 &&
+      memory > FLAGS_schedule_query_memory_budget * 1024 * 1024) {
+    return Status::failure("Query exceeded its memory budget of " +
+                           std::to_string(FLAGS_schedule_query_memory_budget) +
+                           "MB");
+  }
+  return Status::success();
+}
+
+SQLInternal runMonitored(const std::string& name,
+                         const ScheduledQuery& query,
+                         bool columnar,
+                         const ScheduledQueryMetrics* metrics) {
+  if (FLAGS_enable_numeric_monitoring && metrics != nullptr) {
+    CodeProfiler profiler(metrics->profiler);
+    return SQLInternal(query.query, true, columnar);
+  } else if (FLAGS_enable_numeric_monitoring) {
     CodeProfiler profiler(
         {(boost::format("scheduler.pack.%s") % query.pack_name).str(),
          (boost::format("scheduler.global.query.%s.%s") % query.pack_name %
@@ -71,39 +265,104 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
           monitoring::hostIdentifierKeys().scheme % query.pack_name %
           query.name)
              .str()});
-    return SQLInternal(query.query, true);
+    return SQLInternal(query.query, true, columnar);
   } else {
     // Snapshot the performance and times for the worker before running.
-    auto pid = std::to_string(PlatformProcess::getCurrentPid());
-    auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
+    QueryResourceMeter meter;
     auto t0 = getUnixTime();
     Config::get().recordQueryStart(name);
-    SQLInternal sql(query.query, true);
+    SQLInternal sql(query.query, true, columnar);
     // Snapshot the performance after, and compare.
     auto t1 = getUnixTime();
-    auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
-    if (r0.size() > 0 && r1.size() > 0) {
-      // Always called while processes table is working.
-      Config::get().recordQueryPerformance(name, t1 - t0, r0[0], r1[0]);
-    }
+    Config::get().recordQueryPerformance(
+        name, t1 - t0, meter.start(), QueryResourceMeter::sample());
     return sql;
   }
 }
 
-Status launchQuery(const std::string& name, const ScheduledQuery& query) {
+} // namespace
+
+std::string getSnapshotFingerprint(const QueryDataTyped& rows) {
+  // Rows are hashed in sorted order, a query may return them in any order.
+  std::vector<const RowTyped*> sorted;
+  sorted.reserve(rows.size());
+  for (const auto& row : rows) {
+    sorted.push_back(&row);
+  }
+  std::sort(sorted.begin(),
+            sorted.end(),
+            [](const RowTyped* a, const RowTyped* b) { return *a < *b; });
+
+  Hash hash(HASH_TYPE_SHA256);
+  for (const auto* row : sorted) {
+    auto columns = static_cast<uint64_t>(row->size());
+    hash.update(&columns, sizeof(columns));
+    for (const auto& column : *row) {
+      updateFingerprint(hash, column.first);
+
+      // Values of different types are different, "1" is not 1.
+      char type = static_cast<char>(column.second.which());
+      hash.update(&type, sizeof(type));
+      if (auto value = boost::get<long long>(&column.second)) {
+        updateFingerprint(hash, std::to_string(*value));
+      } else if (auto value = boost::get<double>(&column.second)) {
+        char buffer[32];
+        auto size = snprintf(buffer, sizeof(buffer), "%.17g", *value);
+        updateFingerprint(hash, std::string(buffer, size));
+      } else {
+        updateFingerprint(hash, boost::get<std::string>(column.second));
+      }
+    }
+  }
+  return hash.digest();
+}
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const ScheduledQueryMetrics* metrics) {
+  // Differential queries are diffed and stored in columnar form.
+  bool columnar = !query.isSnapshotQuery();
+
+  // Stop a query that exceeds its budget, rather than the whole worker.
+  std::unique_ptr<QueryInterruptCheck> budget;
+  if (FLAGS_schedule_query_cpu_budget > 0 ||
+      FLAGS_schedule_query_memory_budget > 0) {
+    budget = std::make_unique<QueryInterruptCheck>(
+        [start = QueryResourceMeter::sample()]() {
+          return checkQueryBudget(start);
+        });
+  }
+
+  // File scans yield to the host when the query or its pack asks for it.
+  auto throttle = query.options.find("throttle");
+  ScanThrottleScope scan_throttle(throttle != query.options.end()
+                                      ? throttle->second
+                                      : ScanThrottleScope::enabled());
+
+  auto sql = runMonitored(name, query, columnar, metrics);
+  if (budget != nullptr && !budget->getStatus().ok()) {
+    LOG(WARNING) << "Scheduled query " << name
+                 << " was stopped: " << budget->getStatus().getMessage();
+    monitoring::record(
+        (boost::format("scheduler.query.%s.%s.budget_exceeded") %
+         query.pack_name % query.name)
+            .str(),
+        1,
+        monitoring::PreAggregationType::Sum,
+        true);
+    Config::get().denylistQuery(name);
+  }
+  return sql;
+}
+
+Status launchQuery(const std::string& name,
+                   const ScheduledQuery& query,
+                   const ScheduledQueryMetrics* metrics) {
   // Execute the scheduled query and create a named query object.
   VLOG(1) << "Executing scheduled query " << name << ": " << query.query;
   runDecorators(DECORATE_ALWAYS);
 
-  auto sql = monitor(name, query);
+  auto sql = monitor(name, query, metrics);
   if (!sql.getStatus().ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getStatus().toString();
@@ -126,7 +385,19 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   if (query.isSnapshotQuery()) {
     // This is a snapshot query, emit results with a differential or state.
     item.snapshot_results = std::move(sql.rowsTyped());
-    logSnapshotQuery(item);
+    if (!useSnapshotFingerprint(query)) {
+      logSnapshotQuery(item);
+      return Status::success();
+    }
+
+    item.snapshot_fingerprint = getSnapshotFingerprint(item.snapshot_results);
+    if (isSnapshotUnchanged(name, item.snapshot_fingerprint, item.time)) {
+      item.snapshot_unchanged = true;
+      item.snapshot_results.clear();
+      logSnapshotQuery(item);
+    } else if (logSnapshotQuery(item).ok()) {
+      recordLoggedSnapshot(name, item.snapshot_fingerprint, item.time);
+    }
     return Status::success();
   }
 
@@ -141,7 +412,7 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   // was executed by exact matching each row.
   if (!FLAGS_events_optimize || !sql.eventBased()) {
     status = dbQuery.addNewResults(
-        std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
+        std::move(sql.rowsBatch()), item.epoch, item.counter, diff_results);
     if (!status.ok()) {
       std::string message = "Error adding new results to database for query " +
                             name + ": " + status.what();
@@ -173,6 +444,186 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   return status;
 }
 
+/**
+ * @brief A bounded set of threads executing the scheduled queries of a step.
+ *
+ * Each step's queries are submitted together and the scheduler waits for all
+ * of them before continuing, so a query never overlaps with its own next
+ * execution and the step duration still feeds the drift accounting.
+ */
+class ScheduledQueryWorkers {
+ public:
+  explicit ScheduledQueryWorkers(size_t thread_count) {
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads_.emplace_back([this]() { work(); });
+    }
+  }
+
+  ~ScheduledQueryWorkers() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    work_condition_.notify_all();
+
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  /// Run every task on the workers and return when all have completed.
+  void run(std::vector<std::function<void()>> tasks) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_ += tasks.size();
+    for (auto& task : tasks) {
+      queue_.push_back(std::move(task));
+    }
+    work_condition_.notify_all();
+
+    done_condition_.wait(lock, [this]() { return pending_ == 0; });
+  }
+
+ private:
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_condition_.wait(lock,
+                           [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+
+      auto task = std::move(queue_.front());
+      queue_.pop_front();
+
+      lock.unlock();
+      task();
+      lock.lock();
+
+      if (--pending_ == 0) {
+        done_condition_.notify_all();
+      }
+    }
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  size_t pending_{0};
+  bool stopping_{false};
+};
+
+namespace {
+
+/// Scheduled queries are move-only, workers need a copy outside the schedule.
+std::shared_ptr<ScheduledQuery> copyScheduledQuery(
+    const ScheduledQuery& query) {
+  auto copy = std::make_shared<ScheduledQuery>(
+      query.pack_name, query.name, query.query);
+  copy->oncall = query.oncall;
+  copy->interval = query.interval;
+  copy->splayed_interval = query.splayed_interval;
+  copy->denylisted = query.denylisted;
+  copy->options = query.options;
+  return copy;
+}
+
+void runScheduledQuery(const std::string& name,
+                       const ScheduledQuery& query,
+                       const ScheduledQueryMetrics* metrics) {
+  OSQUERY_TRACE_SPAN_DETAIL("schedule", "query", name);
+  const auto status = launchQuery(name, query, metrics);
+  if (metrics != nullptr) {
+    (status.ok() ? metrics->success : metrics->failure).record(1);
+    return;
+  }
+
+  monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
+                      query.pack_name % query.name %
+                      (status.ok() ? "success" : "failure"))
+                         .str(),
+                     1,
+                     monitoring::PreAggregationType::Sum,
+                     true);
+}
+
+} // namespace
+
+ScheduledQueryMetrics::ScheduledQueryMetrics(const ScheduledQuery& query)
+    : oncall(query.oncall),
+      profiler(
+          {(boost::format("scheduler.pack.%s") % query.pack_name).str(),
+           (boost::format("scheduler.global.query.%s.%s") % query.pack_name %
+            query.name)
+               .str(),
+           (boost::format("scheduler.assigned.query.%s.%s.%s") %
+            query.oncall % query.pack_name % query.name)
+               .str(),
+           (boost::format("scheduler.owners.%s") % query.oncall).str(),
+           (boost::format("scheduler.query.%s.%s.%s") %
+            monitoring::hostIdentifierKeys().scheme % query.pack_name %
+            query.name)
+               .str()}),
+      success(monitoring::Metric::get(
+          (boost::format("scheduler.query.%s.%s.status.success") %
+           query.pack_name % query.name)
+              .str(),
+          monitoring::PreAggregationType::Sum)),
+      failure(monitoring::Metric::get(
+          (boost::format("scheduler.query.%s.%s.status.failure") %
+           query.pack_name % query.name)
+              .str(),
+          monitoring::PreAggregationType::Sum)) {}
+
+SchedulerRunner::~SchedulerRunner() = default;
+
+std::map<std::string, uint64_t> balanceSchedulePhases(
+    std::vector<ScheduledQueryCost> queries) {
+  // Place expensive queries first, order by name for a stable result.
+  std::sort(queries.begin(),
+            queries.end(),
+            [](const ScheduledQueryCost& a, const ScheduledQueryCost& b) {
+              if (a.cost != b.cost) {
+                return a.cost > b.cost;
+              }
+              return a.name < b.name;
+            });
+
+  std::map<std::string, uint64_t> phases;
+  std::vector<std::pair<const ScheduledQueryCost*, uint64_t>> placed;
+  for (const auto& query : queries) {
+    if (query.interval == 0) {
+      continue;
+    }
+
+    uint64_t best_phase = 0;
+    double best_overlap = 0;
+    auto candidates = std::min(query.interval, kMaxSchedulePhases);
+    for (uint64_t phase = 0; phase < candidates; ++phase) {
+      double overlap = 0;
+      for (const auto& other : placed) {
+        auto gcd = std::gcd(query.interval, other.first->interval);
+        if (phase % gcd == other.second % gcd) {
+          // The overlap frequency is 1 / lcm, scaled by this query's interval.
+          overlap += other.first->cost * gcd / other.first->interval;
+        }
+      }
+
+      if (phase == 0 || overlap < best_overlap) {
+        best_phase = phase;
+        best_overlap = overlap;
+      }
+    }
+
+    phases[query.name] = best_phase;
+    placed.push_back(std::make_pair(&query, best_phase));
+  }
+  return phases;
+}
+
 void SchedulerRunner::calculateTimeDriftAndMaybePause(
     std::chrono::milliseconds loop_step_duration) {
   if (loop_step_duration + time_drift_ < interval_) {
@@ -200,13 +651,110 @@ void SchedulerRunner::maybeScheduleCarves(uint64_t time_step) {
   }
 }
 
+ScheduleReload getScheduleReload(const ScheduleReloadMeasures& measures,
+                                 uint64_t fragmentation,
+                                 uint64_t min_free) {
+  ScheduleReload reload;
+  if (fragmentation > 0 && measures.heap > 0 &&
+      measures.heap_free >= min_free &&
+      measures.heap_free * 100 >= measures.heap * fragmentation) {
+    reload.database = true;
+  }
+
+  if (measures.database_budget > 0 &&
+      measures.database_used > measures.database_budget) {
+    reload.database = true;
+  }
+
+  if (measures.sqlite_baseline > 0 &&
+      measures.sqlite_used > measures.sqlite_baseline * 2) {
+    reload.sql = true;
+  }
+  return reload;
+}
+
+ScheduleReloadMeasures SchedulerRunner::measureScheduleReload() {
+  ScheduleReloadMeasures measures;
+
+  // Only memory that cannot be released counts as fragmented.
+  uint64_t min_free = uint64_t{FLAGS_malloc_trim_threshold} * 1024 * 1024;
+  if (min_free > 0) {
+    releaseAllocatorMemory(min_free);
+  }
+
+  AllocatorStats heap;
+  if (getAllocatorStats(heap).ok()) {
+    measures.heap = heap.heap;
+    measures.heap_free = heap.free;
+  }
+
+  DatabaseMemoryUsage database;
+  if (getDatabaseMemoryUsage(database).ok()) {
+    measures.database_budget = database.budget;
+    measures.database_used = database.block_cache + database.table_readers;
+  }
+
+  sqlite3_int64 used = 0;
+  sqlite3_int64 highwater = 0;
+  if (sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &used, &highwater, 0) ==
+      SQLITE_OK) {
+    // The first measurement after a reset is the baseline.
+    if (sqlite_baseline_ == 0) {
+      sqlite_baseline_ = static_cast<uint64_t>(highwater);
+    }
+    measures.sqlite_used = static_cast<uint64_t>(used);
+    measures.sqlite_baseline = sqlite_baseline_;
+  }
+  return measures;
+}
+
 void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
-  if (FLAGS_schedule_reload > 0 && (time_step % FLAGS_schedule_reload) == 0) {
-    if (FLAGS_schedule_reload_sql) {
-      SQLiteDBManager::resetPrimary();
+  if (FLAGS_schedule_reload == 0) {
+    return;
+  }
+
+  ScheduleReload reload;
+  if (FLAGS_schedule_reload_fragmentation == 0) {
+    if ((time_step % FLAGS_schedule_reload) != 0) {
+      return;
+    }
+    reload.database = true;
+  } else {
+    // Measured reloads wait for a gap in the schedule to avoid stalls.
+    if ((time_step % kScheduleReloadCheckInterval) != 0 ||
+        time_step < last_reload_ + kScheduleReloadMinInterval ||
+        !isScheduleIdle(time_step)) {
+      return;
     }
+
+    reload = getScheduleReload(
+        measureScheduleReload(),
+        FLAGS_schedule_reload_fragmentation,
+        uint64_t{FLAGS_malloc_trim_threshold} * 1024 * 1024);
+    if (!reload.database && !reload.sql) {
+      return;
+    }
+    last_reload_ = time_step;
+  }
+
+  if (reload.sql || (reload.database && FLAGS_schedule_reload_sql)) {
+    VLOG(1) << "Reloading the SQL implementation";
+    SQLiteDBManager::resetPrimary();
+
+    // Measure a new high-water mark from the fresh connections.
+    sqlite3_int64 used = 0;
+    sqlite3_int64 highwater = 0;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &used, &highwater, 1);
+    sqlite_baseline_ = 0;
+  }
+
+  if (reload.database) {
     resetDatabase();
   }
+
+  if (FLAGS_schedule_reload_fragmentation > 0) {
+    releaseAllocatorMemory();
+  }
 }
 
 void SchedulerRunner::maybeFlushLogs(uint64_t time_step) {
@@ -216,34 +764,299 @@ void SchedulerRunner::maybeFlushLogs(uint64_t time_step) {
   }
 }
 
+void SchedulerRunner::maybeRecordDatabaseStats(uint64_t time_step) {
+  if (!FLAGS_enable_numeric_monitoring ||
+      (time_step % kDatabaseStatsInterval) != 0) {
+    return;
+  }
+
+  std::vector<DatabaseDomainStats> stats;
+  if (!getDatabaseDomainStats(stats).ok()) {
+    return;
+  }
+
+  for (const auto& domain : stats) {
+    auto path = "database.domain." + domain.domain + ".";
+    const std::map<std::string, uint64_t> values = {
+        {"keys", domain.keys},
+        {"memtables", domain.memtables},
+        {"sst_files", domain.sst_files},
+        {"sst_bytes", domain.sst_bytes},
+        {"live_bytes", domain.live_bytes},
+        {"pending_compaction_bytes", domain.pending_compaction_bytes},
+        {"write_slowdowns", domain.write_slowdowns},
+        {"write_stops", domain.write_stops},
+        {"write_stopped", domain.write_stopped ? 1U : 0U},
+    };
+    for (const auto& value : values) {
+      monitoring::record(path + value.first,
+                         static_cast<monitoring::ValueType>(value.second));
+    }
+  }
+}
+
+void SchedulerRunner::maybeRecordMemoryStats(uint64_t time_step) {
+  if (!FLAGS_enable_numeric_monitoring ||
+      (time_step % kMemoryStatsInterval) != 0) {
+    return;
+  }
+
+  AllocatorStats stats;
+  if (getAllocatorStats(stats).ok()) {
+    const std::map<std::string, uint64_t> values = {
+        {"heap", stats.heap},
+        {"in_use", stats.in_use},
+        {"free", stats.free},
+        {"free_chunks", stats.free_chunks},
+        {"mapped", stats.mapped},
+        {"releasable", stats.releasable},
+    };
+    for (const auto& value : values) {
+      monitoring::record("memory.allocator." + value.first,
+                         static_cast<monitoring::ValueType>(value.second));
+    }
+  }
+
+  for (const auto& held : getSubsystemMemory()) {
+    auto path = "memory." + held.subsystem + "." + held.name + ".";
+    if (held.bytes >= 0) {
+      monitoring::record(path + "bytes", held.bytes);
+    }
+    if (held.items >= 0) {
+      monitoring::record(path + "items", held.items);
+    }
+  }
+}
+
+void SchedulerRunner::maybeReleaseMemory(uint64_t time_step) {
+  if (FLAGS_malloc_trim_threshold == 0 ||
+      (time_step % kMemoryReleaseInterval) != 0 || !isScheduleIdle(time_step)) {
+    return;
+  }
+
+  // Query results freed by the workers stay in the heap arenas otherwise.
+  releaseAllocatorMemory(uint64_t{FLAGS_malloc_trim_threshold} * 1024 * 1024);
+}
+
+bool SchedulerRunner::isScheduleIdle(uint64_t time_step) const {
+  // Queries due at this step were already taken from the queue.
+  return due_.empty() || due_.top().first > time_step + kMaintenanceIdleSteps;
+}
+
+void SchedulerRunner::maybeMaintainDatabase(uint64_t time_step) {
+  if (FLAGS_schedule_maintenance == 0) {
+    return;
+  }
+
+  // The database is compacted when opened, the first maintenance waits.
+  // A lazy startup skipped that compaction, it runs shortly after instead.
+  if (next_maintenance_ == 0) {
+    auto delay = FLAGS_schedule_maintenance;
+    if (FLAGS_lazy_startup) {
+      delay = std::min<uint64_t>(kStartupMaintenanceDelay, delay);
+    }
+    next_maintenance_ = time_step + delay;
+  }
+
+  // Once due, maintenance waits for a gap in the schedule.
+  if (time_step < next_maintenance_ || kDatabaseMaintenanceRunning ||
+      !isScheduleIdle(time_step)) {
+    return;
+  }
+
+  next_maintenance_ = time_step + FLAGS_schedule_maintenance;
+  Dispatcher::addService(std::make_shared<DatabaseMaintenanceRunner>());
+}
+
+uint64_t SchedulerRunner::nextDueStep(const CompiledScheduledQuery& query,
+                                      uint64_t time_step) const {
+  auto interval = query.query->splayed_interval;
+  uint64_t phase = 0;
+  auto it = phases_.find(query.name);
+  if (it != phases_.end()) {
+    phase = it->second % interval;
+  }
+  return time_step + (phase + interval - (time_step % interval)) % interval;
+}
+
+void SchedulerRunner::maybeCompileSchedule(uint64_t time_step) {
+  auto generation = Config::get().scheduleGeneration();
+  bool changed =
+      generation != compiled_generation_ || time_step >= next_compile_;
+  if (changed) {
+    // Keep the registered metrics of queries that are still scheduled.
+    std::map<std::string, std::shared_ptr<ScheduledQueryMetrics>> metrics;
+    for (auto& query : compiled_) {
+      if (query.metrics != nullptr) {
+        metrics[query.name] = std::move(query.metrics);
+      }
+    }
+
+    // Names are built, and the denylist is checked, once per compile.
+    compiled_.clear();
+    Config::get().scheduledQueries(([this, &metrics](
+                                        const std::string& name,
+                                        const ScheduledQuery& query) {
+      if (query.splayed_interval == 0) {
+        return;
+      }
+
+      CompiledScheduledQuery compiled{name, copyScheduledQuery(query)};
+      if (FLAGS_enable_numeric_monitoring) {
+        auto it = metrics.find(name);
+        if (it != metrics.end() && it->second->oncall == query.oncall) {
+          compiled.metrics = std::move(it->second);
+        } else {
+          compiled.metrics = std::make_shared<ScheduledQueryMetrics>(query);
+        }
+      }
+      compiled_.push_back(std::move(compiled));
+    }));
+    compiled_generation_ = generation;
+    next_compile_ = time_step + kScheduleCompileInterval;
+  }
+
+  if (maybeBalanceSchedule(time_step, changed) || changed) {
+    queueQueries(time_step);
+  }
+}
+
+void SchedulerRunner::queueQueries(uint64_t time_step) {
+  decltype(due_)().swap(due_);
+  for (size_t i = 0; i < compiled_.size(); ++i) {
+    due_.push(std::make_pair(nextDueStep(compiled_[i], time_step), i));
+  }
+}
+
+std::vector<size_t> SchedulerRunner::takeDueQueries(uint64_t time_step) {
+  // Queries due together run in the config's order.
+  std::vector<size_t> due;
+  while (!due_.empty() && due_.top().first <= time_step) {
+    due.push_back(due_.top().second);
+    due_.pop();
+  }
+
+  for (auto index : due) {
+    const auto& query = compiled_[index];
+    due_.push(
+        std::make_pair(time_step + query.query->splayed_interval, index));
+  }
+  return due;
+}
+
+bool SchedulerRunner::maybeBalanceSchedule(uint64_t time_step,
+                                           bool compiled) {
+  if (!FLAGS_schedule_cost_splay) {
+    if (phases_.empty()) {
+      return false;
+    }
+    phases_.clear();
+    balanced_intervals_.clear();
+    return true;
+  }
+
+  // The intervals only change when the schedule is compiled.
+  if (!compiled && !phases_.empty() &&
+      (time_step % kScheduleBalanceInterval) != 0) {
+    return false;
+  }
+
+  std::map<std::string, uint64_t> intervals;
+  for (const auto& query : compiled_) {
+    intervals[query.name] = query.query->splayed_interval;
+  }
+
+  if (intervals == balanced_intervals_ &&
+      (time_step % kScheduleBalanceInterval) != 0) {
+    return false;
+  }
+
+  std::vector<ScheduledQueryCost> costs;
+  for (const auto& it : intervals) {
+    ScheduledQueryCost query;
+    query.name = it.first;
+    query.interval = it.second;
+    // Queries without history have a nominal cost, so they are spread too.
+    query.cost = 1;
+    Config::get().getPerformanceStats(
+        it.first, ([&query](const QueryPerformance& perf) {
+          if (perf.executions > 0) {
+            query.cost += static_cast<double>(perf.user_time + perf.system_time +
+                                              perf.wall_time * 1000) /
+                          perf.executions;
+          }
+        }));
+    costs.push_back(std::move(query));
+  }
+
+  auto phases = balanceSchedulePhases(std::move(costs));
+  balanced_intervals_ = std::move(intervals);
+  if (phases == phases_) {
+    return false;
+  }
+  phases_ = std::move(phases);
+  return true;
+}
+
+void SchedulerRunner::runQueriesInParallel(uint64_t time_step,
+                                           const std::vector<size_t>& due) {
+  if (due.empty()) {
+    return;
+  }
+
+  // The compiled queries are copies, so the schedule lock is not held while
+  // they run. Queries such as osquery_schedule read the schedule themselves.
+  std::vector<std::function<void()>> tasks;
+  for (auto index : due) {
+    auto name = compiled_[index].name;
+    auto query = compiled_[index].query;
+    auto metrics = compiled_[index].metrics;
+    tasks.push_back([name, query, metrics]() {
+      runScheduledQuery(name, *query, metrics.get());
+    });
+  }
+
+  // Queries of a step share the step, their intervals differ.
+  TablePlugin::kCacheStep = time_step;
+
+  // Each worker acquires its own SQLite connection when the primary is busy.
+  workers_->run(std::move(tasks));
+}
+
 void SchedulerRunner::start() {
   // Start the counter at the second.
   auto i = osquery::getUnixTime();
   // Timeout is the number of seconds from starting.
   timeout_ += (timeout_ == 0) ? 0 : i;
 
+  if (FLAGS_schedule_threads > 1) {
+    workers_ = std::make_unique<ScheduledQueryWorkers>(
+        static_cast<size_t>(FLAGS_schedule_threads));
+  }
+
   for (; (timeout_ == 0) || (i <= timeout_); ++i) {
     auto start_time_point = std::chrono::steady_clock::now();
-    Config::get().scheduledQueries(([&i](const std::string& name,
-                                         const ScheduledQuery& query) {
-      if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-        TablePlugin::kCacheInterval = query.splayed_interval;
+    maybeCompileSchedule(i);
+    auto due = takeDueQueries(i);
+    if (workers_ != nullptr) {
+      runQueriesInParallel(i, due);
+    } else {
+      for (auto index : due) {
+        const auto& query = compiled_[index];
+        TablePlugin::kCacheInterval = query.query->splayed_interval;
         TablePlugin::kCacheStep = i;
-        const auto status = launchQuery(name, query);
-        monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
-                            query.pack_name % query.name %
-                            (status.ok() ? "success" : "failure"))
-                               .str(),
-                           1,
-                           monitoring::PreAggregationType::Sum,
-                           true);
+        runScheduledQuery(query.name, *query.query, query.metrics.get());
       }
-    }));
+    }
 
     maybeRunDecorators(i);
     maybeReloadSchedule(i);
     maybeFlushLogs(i);
     maybeScheduleCarves(i);
+    maybeMaintainDatabase(i);
+    maybeRecordDatabaseStats(i);
+    maybeRecordMemoryStats(i);
+    maybeReleaseMemory(i);
 
     auto loop_step_duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(
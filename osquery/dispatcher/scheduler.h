@@ -10,14 +10,114 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/profiler/code_profiler.h>
 
 #include "osquery/sql/sqlite_util.h"
 
 namespace osquery {
 
+class ScheduledQueryWorkers;
+
+/// The measured cost of a scheduled query, used to balance the schedule.
+struct ScheduledQueryCost {
+  /// The scheduled query name.
+  std::string name;
+
+  /// The splayed interval of the query.
+  uint64_t interval{0};
+
+  /// The average cost of one execution.
+  double cost{0};
+};
+
+/**
+ * @brief Choose an execution phase for each scheduled query.
+ *
+ * A query with phase p runs on steps where (step % interval) == p. Queries
+ * are placed from most to least expensive, each at the phase where it
+ * overlaps the least cost of the queries already placed. Two queries overlap
+ * once every lcm of their intervals when their phases agree modulo the gcd.
+ *
+ * @param queries the scheduled queries and their costs.
+ * @return the phase for each query name.
+ */
+std::map<std::string, uint64_t> balanceSchedulePhases(
+    std::vector<ScheduledQueryCost> queries);
+
+/// Memory measured while the schedule is idle, to decide on a reload.
+struct ScheduleReloadMeasures {
+  /// Bytes of heap and of free heap after free memory was released, 0 if
+  /// the allocator has no statistics.
+  uint64_t heap{0};
+  uint64_t heap_free{0};
+
+  /// The database's memory budget, 0 if unbounded, and memory held.
+  uint64_t database_budget{0};
+  uint64_t database_used{0};
+
+  /// SQLite heap in use, and the high-water mark measured after SQLite was
+  /// last reset, or 0 if not yet measured.
+  uint64_t sqlite_used{0};
+  uint64_t sqlite_baseline{0};
+};
+
+/// The parts of osquery a schedule reload resets.
+struct ScheduleReload {
+  bool database{false};
+  bool sql{false};
+};
+
+/**
+ * @brief Choose what to reset from the measured memory.
+ *
+ * The database is reset when at least fragmentation percent of the heap is
+ * free, and at least min_free bytes, after releasing free memory to the
+ * system. Memory that cannot be released is scattered between allocations.
+ * It is also reset when it holds more than its memory budget. SQLite alone
+ * is reset when its idle heap grew past twice its high-water mark after the
+ * previous reset.
+ */
+ScheduleReload getScheduleReload(const ScheduleReloadMeasures& measures,
+                                 uint64_t fragmentation,
+                                 uint64_t min_free);
+
+/// The numeric monitoring metrics of a scheduled query, registered once.
+struct ScheduledQueryMetrics {
+  explicit ScheduledQueryMetrics(const ScheduledQuery& query);
+
+  /// The owner included in the metric paths.
+  std::string oncall;
+
+  /// The resources used by each execution.
+  CodeProfilerMetrics profiler;
+
+  /// Counts of successful and failed executions.
+  monitoring::Metric success;
+  monitoring::Metric failure;
+};
+
+/// A scheduled query copied from the config, see SchedulerRunner.
+struct CompiledScheduledQuery {
+  /// The scheduled query name, including its pack.
+  std::string name;
+
+  /// A copy of the query, which may run without the schedule lock.
+  std::shared_ptr<ScheduledQuery> query;
+
+  /// Set while numeric monitoring is enabled.
+  std::shared_ptr<ScheduledQueryMetrics> metrics;
+};
+
 /// A Dispatcher service thread that watches an ExtensionManagerHandler.
 class SchedulerRunner : public InternalRunnable {
  public:
@@ -31,6 +131,8 @@ class SchedulerRunner : public InternalRunnable {
         time_drift_{std::chrono::milliseconds::zero()},
         max_time_drift_{max_time_drift} {}
 
+  virtual ~SchedulerRunner() override;
+
  public:
   /// The Dispatcher thread entry point.
   void start() override;
@@ -48,15 +150,53 @@ class SchedulerRunner : public InternalRunnable {
   /// Check interval-based decorators.
   void maybeRunDecorators(uint64_t time_step);
 
-  /// Check relative configuration flags.
+  /// Reset the database and SQLite when due, or when memory measures it.
   void maybeReloadSchedule(uint64_t time_step);
 
+  /// Measure the memory that decides an adaptive reload.
+  ScheduleReloadMeasures measureScheduleReload();
+
   /// Check if buffered status logs should be flushed.
   void maybeFlushLogs(uint64_t time_step);
 
   /// Check if carve requests should be scheduled.
   void maybeScheduleCarves(uint64_t time_step);
 
+  /// Execute the queries due at this step on the worker threads.
+  void runQueriesInParallel(uint64_t time_step,
+                            const std::vector<size_t>& due);
+
+  /// The first step, from time_step, a scheduled query is due at.
+  uint64_t nextDueStep(const CompiledScheduledQuery& query,
+                       uint64_t time_step) const;
+
+  /// Copy the config's schedule when it changed, and queue its queries.
+  void maybeCompileSchedule(uint64_t time_step);
+
+  /// Order the compiled queries by the next step each is due at.
+  void queueQueries(uint64_t time_step);
+
+  /// Take the compiled queries due at this step, and queue their next run.
+  std::vector<size_t> takeDueQueries(uint64_t time_step);
+
+  /// Recompute query phases, true if they changed.
+  bool maybeBalanceSchedule(uint64_t time_step, bool compiled);
+
+  /// Start database maintenance when it is due and the schedule is idle.
+  void maybeMaintainDatabase(uint64_t time_step);
+
+  /// Record the database's per-domain statistics to numeric monitoring.
+  void maybeRecordDatabaseStats(uint64_t time_step);
+
+  /// Record the allocator and subsystem memory to numeric monitoring.
+  void maybeRecordMemoryStats(uint64_t time_step);
+
+  /// Return free heap memory to the system while the schedule is idle.
+  void maybeReleaseMemory(uint64_t time_step);
+
+  /// Check if no scheduled query is due in the steps following this one.
+  bool isScheduleIdle(uint64_t time_step) const;
+
  private:
   /// Interval in seconds between schedule steps.
   const std::chrono::milliseconds interval_;
@@ -70,9 +210,56 @@ class SchedulerRunner : public InternalRunnable {
   std::chrono::milliseconds time_drift_;
 
   const std::chrono::milliseconds max_time_drift_;
+
+  /// Worker threads used when scheduled queries run in parallel.
+  std::unique_ptr<ScheduledQueryWorkers> workers_;
+
+  /// The schedule as of the last compile, in the config's order.
+  std::vector<CompiledScheduledQuery> compiled_;
+
+  /// The next due step and index of each compiled query, earliest first.
+  std::priority_queue<std::pair<uint64_t, size_t>,
+                      std::vector<std::pair<uint64_t, size_t>>,
+                      std::greater<std::pair<uint64_t, size_t>>>
+      due_;
+
+  /// The config schedule generation that was compiled.
+  uint64_t compiled_generation_{0};
+
+  /// The step at which the schedule is compiled again regardless.
+  uint64_t next_compile_{0};
+
+  /// Execution phase of each query when cost-aware splay is enabled.
+  std::map<std::string, uint64_t> phases_;
+
+  /// The query intervals the phases were computed for.
+  std::map<std::string, uint64_t> balanced_intervals_;
+
+  /// The step after which database maintenance is next due.
+  uint64_t next_maintenance_{0};
+
+  /// The step of the last adaptive reload.
+  uint64_t last_reload_{0};
+
+  /// SQLite's high-water mark after its last reset, 0 until measured.
+  uint64_t sqlite_baseline_{0};
 };
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
+/**
+ * @brief A digest of snapshot results that does not depend on row order.
+ *
+ * Each column's name, type and value are hashed, with the rows sorted.
+ */
+std::string getSnapshotFingerprint(const QueryDataTyped& rows);
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const ScheduledQueryMetrics* metrics = nullptr);
+
+/// Execute a scheduled query, then diff and log its results.
+Status launchQuery(const std::string& name,
+                   const ScheduledQuery& query,
+                   const ScheduledQueryMetrics* metrics = nullptr);
 
 /// Start querying according to the config's schedule
 void startScheduler();
@@ -137,6 +137,63 @@ TEST_F(DispatcherTests, test_interruption) {
   EXPECT_TRUE(r1->hasRun());
 }
 
+class PeriodicTestRunnable : public PeriodicRunnable {
+ public:
+  PeriodicTestRunnable(size_t ticks, std::chrono::milliseconds delay)
+      : PeriodicRunnable("PeriodicTestRunnable"),
+        ticks_(ticks),
+        delay_(delay) {}
+
+  size_t count() {
+    return count_;
+  }
+
+ protected:
+  std::chrono::milliseconds tick() override {
+    return (++count_ >= ticks_) ? kDone : delay_;
+  }
+
+  std::chrono::milliseconds firstDelay() override {
+    return delay_;
+  }
+
+ private:
+  size_t ticks_;
+  std::chrono::milliseconds delay_;
+  std::atomic<size_t> count_{0};
+};
+
+TEST_F(DispatcherTests, test_periodic_run) {
+  auto service_count = Dispatcher::instance().serviceCount();
+
+  // More services than pool threads, each ticks until it is done.
+  std::vector<std::shared_ptr<PeriodicTestRunnable>> runnables;
+  for (size_t i = 0; i < 8; i++) {
+    runnables.push_back(std::make_shared<PeriodicTestRunnable>(
+        3, std::chrono::milliseconds(1)));
+    EXPECT_TRUE(Dispatcher::addService(runnables.back()));
+  }
+  Dispatcher::joinServices();
+
+  for (const auto& runnable : runnables) {
+    EXPECT_TRUE(runnable->hasRun());
+    EXPECT_EQ(3U, runnable->count());
+  }
+  EXPECT_EQ(service_count, Dispatcher::instance().serviceCount());
+}
+
+TEST_F(DispatcherTests, test_periodic_interruption) {
+  // This service would normally wait for 100 seconds between ticks.
+  auto r1 =
+      std::make_shared<PeriodicTestRunnable>(10, std::chrono::seconds(100));
+  Dispatcher::addService(r1);
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+  EXPECT_TRUE(r1->hasRun());
+  EXPECT_EQ(0U, r1->count());
+}
+
 TEST_F(DispatcherTests, test_stop_dispatcher) {
   Dispatcher::stopServices();
 
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core/system.h>
@@ -23,6 +25,7 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_uint64(schedule_reload);
+DECLARE_uint64(schedule_threads);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -178,6 +181,84 @@ TEST_F(SchedulerTests, test_scheduler) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_scheduler_parallel) {
+  auto backup_threads = FLAGS_schedule_threads;
+  FLAGS_schedule_threads = 4;
+
+  std::string config = R"config(
+  {
+    "packs": {
+      "parallel": {
+        "queries": {
+          "1": {"query": "select 1 as number", "interval": 1},
+          "2": {"query": "select 2 as number", "interval": 1},
+          "3": {"query": "select * from osquery_info", "interval": 1},
+          "4": {"query": "select * from time", "interval": 1},
+          "5": {"query": "select 5 as number", "interval": 1}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  // Run the scheduler for 1 second with a second interval.
+  SchedulerRunner runner(static_cast<unsigned long int>(1), 1);
+  runner.start();
+
+  // Every query should have executed at least once.
+  for (const auto& name : {"1", "2", "3", "4", "5"}) {
+    QueryPerformance perf;
+    Config::get().getPerformanceStats(
+        std::string("pack_parallel_") + name,
+        ([&perf](const QueryPerformance& r) { perf = r; }));
+    EXPECT_GE(perf.executions, 1U) << "query " << name;
+  }
+
+  FLAGS_schedule_threads = backup_threads;
+}
+
+TEST_F(SchedulerTests, test_scheduler_compiled) {
+  std::string config = R"config(
+  {
+    "packs": {
+      "compiled": {
+        "queries": {
+          "1": {"query": "select 1 as number", "interval": 1},
+          "2": {"query": "select 2 as number", "interval": 1}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  auto executions = [](const std::string& name) {
+    QueryPerformance perf;
+    Config::get().getPerformanceStats(
+        "pack_compiled_" + name,
+        ([&perf](const QueryPerformance& r) { perf = r; }));
+    return perf.executions;
+  };
+
+  // Run 4 steps without pausing, the queue is refilled after each step.
+  {
+    SchedulerRunner runner(
+        static_cast<unsigned long int>(3), size_t{0}, std::chrono::seconds{10});
+    runner.start();
+  }
+  EXPECT_EQ(executions("1"), 4U);
+  EXPECT_EQ(executions("2"), 4U);
+
+  // A denylisted query changes the schedule, and is no longer compiled.
+  Config::get().denylistQuery("pack_compiled_2");
+  {
+    SchedulerRunner runner(
+        static_cast<unsigned long int>(3), size_t{0}, std::chrono::seconds{10});
+    runner.start();
+  }
+  EXPECT_EQ(executions("1"), 8U);
+  EXPECT_EQ(executions("2"), 4U);
+}
+
 TEST_F(SchedulerTests, test_scheduler_zero_drift) {
   const auto backup_step = TablePlugin::kCacheStep;
   const auto backup_interval = TablePlugin::kCacheInterval;
@@ -251,6 +332,94 @@ TEST_F(SchedulerTests, test_scheduler_drift_accumulation) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_balance_schedule_phases) {
+  std::vector<ScheduledQueryCost> queries = {
+      {"cheap", 10, 1},
+      {"expensive", 10, 100},
+      {"medium", 10, 10},
+      {"coprime", 7, 50},
+  };
+
+  auto phases = balanceSchedulePhases(queries);
+  ASSERT_EQ(phases.size(), 4U);
+
+  // The most expensive query is placed first.
+  EXPECT_EQ(phases["expensive"], 0U);
+
+  // Queries sharing an interval are spread over distinct phases.
+  EXPECT_NE(phases["medium"], phases["expensive"]);
+  EXPECT_NE(phases["cheap"], phases["expensive"]);
+  EXPECT_NE(phases["cheap"], phases["medium"]);
+
+  // Phases are always within the interval.
+  EXPECT_LT(phases["coprime"], 7U);
+
+  // The result does not depend on the input order.
+  std::reverse(queries.begin(), queries.end());
+  EXPECT_EQ(balanceSchedulePhases(queries), phases);
+}
+
+TEST_F(SchedulerTests, test_schedule_reload_measures) {
+  ScheduleReloadMeasures measures;
+  measures.heap = 100 << 20;
+  measures.heap_free = 10 << 20;
+  measures.database_budget = 64 << 20;
+  measures.database_used = 32 << 20;
+  measures.sqlite_used = 8 << 20;
+  measures.sqlite_baseline = 6 << 20;
+
+  // A healthy host is not reloaded.
+  auto reload = getScheduleReload(measures, 50, 1 << 20);
+  EXPECT_FALSE(reload.database);
+  EXPECT_FALSE(reload.sql);
+
+  // Half of the heap is free but could not be released.
+  measures.heap_free = 50 << 20;
+  EXPECT_TRUE(getScheduleReload(measures, 50, 1 << 20).database);
+  EXPECT_FALSE(getScheduleReload(measures, 50, 64 << 20).database);
+  EXPECT_FALSE(getScheduleReload(measures, 0, 0).database);
+  measures.heap_free = 10 << 20;
+
+  measures.database_used = 65 << 20;
+  reload = getScheduleReload(measures, 50, 1 << 20);
+  EXPECT_TRUE(reload.database);
+  EXPECT_FALSE(reload.sql);
+  measures.database_budget = 0;
+  EXPECT_FALSE(getScheduleReload(measures, 50, 1 << 20).database);
+
+  // SQLite alone is reset once its idle heap doubles its high-water mark.
+  measures.sqlite_used = 13 << 20;
+  reload = getScheduleReload(measures, 50, 1 << 20);
+  EXPECT_TRUE(reload.sql);
+  EXPECT_FALSE(reload.database);
+  measures.sqlite_baseline = 0;
+  EXPECT_FALSE(getScheduleReload(measures, 50, 1 << 20).sql);
+}
+
+TEST_F(SchedulerTests, test_snapshot_fingerprint) {
+  QueryDataTyped rows = {
+      {{"name", std::string("a")}, {"size", 1LL}},
+      {{"name", std::string("b")}, {"size", 2.5}},
+  };
+
+  auto fingerprint = getSnapshotFingerprint(rows);
+  EXPECT_EQ(fingerprint.size(), 64U);
+
+  // The row order does not change the fingerprint.
+  std::reverse(rows.begin(), rows.end());
+  EXPECT_EQ(getSnapshotFingerprint(rows), fingerprint);
+
+  // Values and their types do.
+  rows[0]["size"] = std::string("2.5");
+  EXPECT_NE(getSnapshotFingerprint(rows), fingerprint);
+  rows[0]["size"] = 2.5;
+  EXPECT_EQ(getSnapshotFingerprint(rows), fingerprint);
+
+  rows.push_back({});
+  EXPECT_NE(getSnapshotFingerprint(rows), fingerprint);
+  EXPECT_NE(getSnapshotFingerprint({}), fingerprint);
+}
+
 TEST_F(SchedulerTests, test_scheduler_reload) {
   std::string config =
       "{\"schedule\":{\"1\":{"
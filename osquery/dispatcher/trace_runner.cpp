@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/trace.h>
+#include <osquery/dispatcher/trace_runner.h>
+#include <osquery/logger/logger.h>
+
+namespace osquery {
+
+FLAG(string,
+     trace_spans_path,
+     "",
+     "File the recorded spans are written to in the Chrome trace format");
+
+FLAG(uint64,
+     trace_spans_interval,
+     60,
+     "Seconds between writing the recorded spans (default 60)");
+
+DECLARE_bool(trace_spans);
+
+std::chrono::milliseconds TraceRunner::firstDelay() {
+  return std::chrono::seconds(FLAGS_trace_spans_interval);
+}
+
+std::chrono::milliseconds TraceRunner::tick() {
+  auto status = writeTrace(FLAGS_trace_spans_path);
+  if (!status.ok()) {
+    LOG(WARNING) << "Cannot write spans to " << FLAGS_trace_spans_path << ": "
+                 << status.getMessage();
+  }
+  return std::chrono::seconds(FLAGS_trace_spans_interval);
+}
+
+Status startTraceRunner() {
+#ifdef OSQUERY_TRACING
+  if (FLAGS_trace_spans && !FLAGS_trace_spans_path.empty()) {
+    Dispatcher::addService(std::make_shared<TraceRunner>());
+    return Status::success();
+  }
+  return Status::failure("Spans are not recorded or written");
+#else
+  return Status::failure("Spans are not built into this osquery");
+#endif
+}
+} // namespace osquery
@@ -0,0 +1,31 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/dispatcher/dispatcher.h>
+
+namespace osquery {
+
+/// A Dispatcher service that periodically writes the recorded spans.
+class TraceRunner : public PeriodicRunnable {
+ public:
+  virtual ~TraceRunner() {}
+  TraceRunner() : PeriodicRunnable("TraceRunner") {}
+
+ protected:
+  /// Write the recorded spans.
+  std::chrono::milliseconds tick() override;
+
+  std::chrono::milliseconds firstDelay() override;
+};
+
+/// Start writing spans to --trace_spans_path if spans are recorded.
+Status startTraceRunner();
+} // namespace osquery
@@ -7,7 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 #include <osquery/core/plugins/logger.h>
@@ -33,9 +36,33 @@ FLAG(bool,
      true,
      "Disable distributed queries (default true)");
 
+FLAG(uint64,
+     distributed_threads,
+     0,
+     "Number of threads running distributed queries in parallel, each result "
+     "is written as it completes (0 or 1 runs them sequentially)");
+
+FLAG(string,
+     distributed_results_format,
+     "rows",
+     "Distributed result encoding: rows, an object per row, or columns, the "
+     "column names once and an array per row (default rows)");
+
+FLAG(uint64,
+     distributed_write_max_size,
+     0,
+     "Split distributed results into writes of about this many bytes, a "
+     "single query's results are not split (default 0, unlimited)");
+
+FLAG(uint64,
+     distributed_long_poll,
+     0,
+     "Seconds the distributed plugin may hold a request for new queries open "
+     "(default 0, poll every distributed_interval)");
+
 const std::string kDistributedQueryPrefix{"distributed."};
 
-std::string Distributed::currentRequestId_{""};
+thread_local std::string Distributed::currentRequestId_{""};
 
 Status DistributedPlugin::call(const PluginRequest& request,
                                PluginResponse& response) {
@@ -86,59 +113,206 @@ size_t Distributed::getPendingQueryCount() {
 }
 
 size_t Distributed::getCompletedCount() {
+  ReadLock lock(results_mutex_);
   return results_.size();
 }
 
+namespace {
+
+void writeString(rj::Writer<rj::StringBuffer>& writer, const std::string& s) {
+  writer.String(s.data(), static_cast<rj::SizeType>(s.size()));
+}
+
+void writeKey(rj::Writer<rj::StringBuffer>& writer, const std::string& s) {
+  writer.Key(s.data(), static_cast<rj::SizeType>(s.size()));
+}
+
+/// Write the rows of a result as objects, see serializeQueryData.
+void writeResultRows(rj::Writer<rj::StringBuffer>& writer,
+                     const DistributedQueryResult& result) {
+  writer.StartArray();
+  for (const auto& row : result.results) {
+    writeRow(row, result.columns, writer);
+  }
+  writer.EndArray();
+}
+
+/// Write the column names of a result once, and each row as an array.
+void writeResultColumns(rj::Writer<rj::StringBuffer>& writer,
+                        const DistributedQueryResult& result) {
+  auto columns = result.columns;
+  if (columns.empty() && !result.results.empty()) {
+    for (const auto& column : result.results.front()) {
+      columns.push_back(column.first);
+    }
+  }
+
+  writer.StartObject();
+  writer.Key("columns");
+  writer.StartArray();
+  for (const auto& column : columns) {
+    writeString(writer, column);
+  }
+  writer.EndArray();
+
+  writer.Key("rows");
+  writer.StartArray();
+  for (const auto& row : result.results) {
+    writer.StartArray();
+    for (const auto& column : columns) {
+      auto value = row.find(column);
+      if (value != row.end()) {
+        writeString(writer, value->second);
+      } else {
+        writer.Null();
+      }
+    }
+    writer.EndArray();
+  }
+  writer.EndArray();
+  writer.EndObject();
+}
+
+} // namespace
+
 Status Distributed::serializeResults(std::string& json) {
-  auto doc = JSON::newObject();
-  auto queries_obj = doc.getObject();
-  auto statuses_obj = doc.getObject();
-  auto messages_obj = doc.getObject();
-  for (const auto& result : results_) {
-    auto arr = doc.getArray();
-    auto s = serializeQueryData(result.results, result.columns, doc, arr);
-    if (!s.ok()) {
-      return s;
+  serializeResults(0, json);
+  return Status::success();
+}
+
+size_t Distributed::serializeResults(size_t max_size, std::string& json) {
+  // Write the body directly, a document would hold every row a second time.
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  auto columns = FLAGS_distributed_results_format == "columns";
+
+  writer.StartObject();
+  writer.Key("queries");
+  writer.StartObject();
+  size_t count = 0;
+  while (count < results_.size()) {
+    const auto& result = results_[count++];
+    writeKey(writer, result.request.id);
+    if (columns) {
+      writeResultColumns(writer, result);
+    } else {
+      writeResultRows(writer, result);
+    }
+
+    // A single result is never split, the next write continues after it.
+    if (max_size > 0 && sb.GetSize() >= max_size) {
+      break;
     }
-    doc.add(result.request.id, arr, queries_obj);
-    doc.add(result.request.id, result.status.getCode(), statuses_obj);
-    doc.add(result.request.id, result.message, messages_obj);
   }
+  writer.EndObject();
 
-  doc.add("queries", queries_obj);
-  doc.add("statuses", statuses_obj);
-  doc.add("messages", messages_obj);
-  return doc.toString(json);
+  writer.Key("statuses");
+  writer.StartObject();
+  for (size_t i = 0; i < count; i++) {
+    writeKey(writer, results_[i].request.id);
+    writer.Int(results_[i].status.getCode());
+  }
+  writer.EndObject();
+
+  writer.Key("messages");
+  writer.StartObject();
+  for (size_t i = 0; i < count; i++) {
+    writeKey(writer, results_[i].request.id);
+    writeString(writer, results_[i].message);
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  json.assign(sb.GetString(), sb.GetSize());
+  return count;
 }
 
 void Distributed::addResult(const DistributedQueryResult& result) {
+  WriteLock lock(results_mutex_);
   results_.push_back(result);
 }
 
+void Distributed::addResult(DistributedQueryResult&& result) {
+  WriteLock lock(results_mutex_);
+  results_.push_back(std::move(result));
+}
+
+void Distributed::runRequest(const DistributedQueryRequest& request) {
+  LOG(INFO) << "Executing distributed query: " << request.id << ": "
+            << request.query;
+
+  // Keep track of the currently executing request
+  Distributed::setCurrentRequestId(request.id);
+
+  SQL sql(request.query);
+  const auto ok = sql.getStatus().ok();
+  const auto& msg = ok ? "" : sql.getMessageString();
+  if (!ok) {
+    LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
+               << msg;
+  }
+  DistributedQueryResult result;
+  result.request = request;
+  result.results = std::move(sql.rows());
+  result.columns = sql.columns();
+  result.status = sql.getStatus();
+  result.message = msg;
+  addResult(std::move(result));
+}
+
 Status Distributed::runQueries() {
+  if (FLAGS_distributed_threads > 1) {
+    return runQueriesInParallel(static_cast<size_t>(FLAGS_distributed_threads));
+  }
+
   while (getPendingQueryCount() > 0) {
-    auto request = popRequest();
-    LOG(INFO) << "Executing distributed query: " << request.id << ": "
-              << request.query;
-
-    // Keep track of the currently executing request
-    Distributed::setCurrentRequestId(request.id);
-
-    SQL sql(request.query);
-    const auto ok = sql.getStatus().ok();
-    const auto& msg = ok ? "" : sql.getMessageString();
-    if (!ok) {
-      LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
-                 << msg;
-    }
-    DistributedQueryResult result(
-        request, sql.rows(), sql.columns(), sql.getStatus(), msg);
-    addResult(result);
+    runRequest(popRequest());
   }
   return flushCompleted();
 }
 
+Status Distributed::runQueriesInParallel(size_t threads) {
+  std::vector<DistributedQueryRequest> requests;
+  while (getPendingQueryCount() > 0) {
+    requests.push_back(popRequest());
+  }
+
+  // Each thread acquires its own SQLite connection when the primary is busy.
+  std::atomic<size_t> next{0};
+  Mutex status_mutex;
+  Status status;
+  auto worker = [&]() {
+    for (auto i = next++; i < requests.size(); i = next++) {
+      runRequest(requests[i]);
+      // Write the result now, rather than waiting for slower queries.
+      auto s = flushCompleted();
+      if (!s.ok()) {
+        WriteLock lock(status_mutex);
+        status = s;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  auto count = std::min(threads, requests.size());
+  for (size_t i = 1; i < count; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  // Results of a failed write are retried once with the remaining results.
+  if (!status.ok()) {
+    status = flushCompleted();
+  }
+  return status;
+}
+
 Status Distributed::flushCompleted() {
+  // One write at a time, results completed meanwhile join the next write.
+  WriteLock flush_lock(flush_mutex_);
   if (getCompletedCount() == 0) {
     return Status::success();
   }
@@ -148,25 +322,34 @@ Status Distributed::flushCompleted() {
     return Status(1, "Missing distributed plugin " + distributed_plugin);
   }
 
-  std::string results;
-  auto s = serializeResults(results);
-  if (!s.ok()) {
-    return s;
-  }
+  // Results beyond --distributed_write_max_size are sent by further writes.
+  while (getCompletedCount() > 0) {
+    std::string results;
+    size_t count = 0;
+    {
+      ReadLock lock(results_mutex_);
+      count = serializeResults(
+          static_cast<size_t>(FLAGS_distributed_write_max_size), results);
+    }
 
-  PluginResponse response;
-  s = Registry::call("distributed",
-                     {{"action", "writeResults"}, {"results", results}},
-                     response);
-  if (s.ok()) {
-    results_.clear();
+    PluginResponse response;
+    auto s = Registry::call("distributed",
+                            {{"action", "writeResults"}, {"results", results}},
+                            response);
+    if (!s.ok()) {
+      return s;
+    }
+
+    // Only this write removes results, the first count were written.
+    WriteLock lock(results_mutex_);
+    results_.erase(results_.begin(), results_.begin() + count);
   }
-  return s;
+  return Status::success();
 }
 
 Status Distributed::acceptWork(const std::string& work) {
   auto doc = JSON::newObject();
-  if (!doc.fromString(work) || !doc.doc().IsObject()) {
+  if (!doc.fromStringInsitu(work) || !doc.doc().IsObject()) {
     return Status(1, "Error Parsing JSON");
   }
 
@@ -294,7 +477,7 @@ Status deserializeDistributedQueryRequest(const rj::Value& obj,
 Status deserializeDistributedQueryRequestJSON(const std::string& json,
                                               DistributedQueryRequest& r) {
   auto doc = JSON::newObject();
-  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+  if (!doc.fromStringInsitu(json) || !doc.doc().IsObject()) {
     return Status(1, "Error Parsing JSON");
   }
   return deserializeDistributedQueryRequest(doc.doc(), r);
@@ -14,6 +14,7 @@
 
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/core/query.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
@@ -228,7 +229,7 @@ class Distributed {
   /// Get the number of results which are waiting to be flushed
   size_t getCompletedCount();
 
-  /// Serialize result data into a JSON string and clear the results
+  /// Serialize result data into a JSON string
   Status serializeResults(std::string& json);
 
   /// Process and execute queued queries
@@ -262,6 +263,27 @@ class Distributed {
    * @param result is a DistributedQueryResult object to be sent to the server
    */
   void addResult(const DistributedQueryResult& result);
+  void addResult(DistributedQueryResult&& result);
+
+  /**
+   * @brief Serialize the first results, in order, into a write request.
+   *
+   * Results are added until the body reaches max_size bytes, 0 for all.
+   * The caller holds results_mutex_.
+   *
+   * @return the number of results serialized.
+   */
+  size_t serializeResults(size_t max_size, std::string& json);
+
+  /// Execute a single request and queue its result.
+  void runRequest(const DistributedQueryRequest& request);
+
+  /**
+   * @brief Execute every queued query using up to threads threads.
+   *
+   * Each result is flushed as soon as its query completes.
+   */
+  Status runQueriesInParallel(size_t threads);
 
   /**
    * @brief Flush all of the collected results to the server
@@ -273,11 +295,18 @@ class Distributed {
 
   std::vector<DistributedQueryResult> results_;
 
-  // ID of the currently executing query
-  static std::string currentRequestId_;
+  /// Protects results_ from queries running in parallel.
+  mutable Mutex results_mutex_;
+
+  /// Serializes writes of completed results.
+  Mutex flush_mutex_;
+
+  // ID of the query executing within the calling thread
+  static thread_local std::string currentRequestId_;
 
  private:
   friend class DistributedTests;
   FRIEND_TEST(DistributedTests, test_workflow);
+  FRIEND_TEST(DistributedTests, test_serialize_results);
 };
 } // namespace osquery
@@ -189,6 +189,44 @@ TEST_F(DistributedTests, test_deserialize_distributed_query_result_json) {
   EXPECT_EQ(r.results[0]["foo"], "bar");
 }
 
+TEST_F(DistributedTests, test_serialize_results) {
+  auto dist = Distributed();
+  DistributedQueryResult r;
+  r.request.id = "foo";
+  r.columns = {"a", "b"};
+  r.results = {{{"a", "1"}, {"b", "2"}}, {{"a", "3"}}};
+  dist.addResult(r);
+  r.request.id = "bar";
+  dist.addResult(r);
+
+  std::string json;
+  EXPECT_EQ(dist.serializeResults(0, json), 2U);
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(json).ok());
+  const auto& rows = doc.doc()["queries"]["foo"];
+  ASSERT_TRUE(rows.IsArray());
+  ASSERT_EQ(rows.Size(), 2U);
+  EXPECT_EQ(std::string(rows[0]["b"].GetString()), "2");
+  EXPECT_FALSE(rows[1].HasMember("b"));
+  EXPECT_EQ(doc.doc()["statuses"]["bar"].GetInt(), 0);
+
+  auto format = Flag::getValue("distributed_results_format");
+  Flag::updateValue("distributed_results_format", "columns");
+  // The first result exceeds the size, the second is left for another write.
+  EXPECT_EQ(dist.serializeResults(1, json), 1U);
+  Flag::updateValue("distributed_results_format", format);
+
+  auto columns_doc = JSON::newObject();
+  ASSERT_TRUE(columns_doc.fromString(json).ok());
+  EXPECT_FALSE(columns_doc.doc()["queries"].HasMember("bar"));
+  const auto& table = columns_doc.doc()["queries"]["foo"];
+  ASSERT_EQ(table["columns"].Size(), 2U);
+  EXPECT_EQ(std::string(table["columns"][1].GetString()), "b");
+  ASSERT_EQ(table["rows"].Size(), 2U);
+  EXPECT_EQ(std::string(table["rows"][0][1].GetString()), "2");
+  EXPECT_TRUE(table["rows"][1][1].IsNull());
+}
+
 TEST_F(DistributedTests, test_workflow) {
   ASSERT_TRUE(startServer());
 
@@ -206,4 +244,24 @@ TEST_F(DistributedTests, test_workflow) {
   EXPECT_EQ(dist.getPendingQueryCount(), 0U);
   EXPECT_EQ(dist.results_.size(), 0U);
 }
+
+TEST_F(DistributedTests, test_workflow_parallel) {
+  ASSERT_TRUE(startServer());
+
+  auto distributed_threads = Flag::getValue("distributed_threads");
+  Flag::updateValue("distributed_threads", "2");
+
+  auto dist = Distributed();
+  auto s = dist.pullUpdates();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  EXPECT_EQ(dist.getPendingQueryCount(), 2U);
+  s = dist.runQueries();
+  Flag::updateValue("distributed_threads", distributed_threads);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  // Each result was written as its query completed.
+  EXPECT_EQ(dist.getPendingQueryCount(), 0U);
+  EXPECT_EQ(dist.getCompletedCount(), 0U);
+}
 } // namespace osquery
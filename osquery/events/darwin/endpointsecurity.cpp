@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <bsm/libbsm.h>
+#include <mach/mach.h>
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/utils/conversions/split.h>
+
+#include "osquery/events/darwin/endpointsecurity.h"
+
+namespace osquery {
+
+FLAG(bool,
+     disable_endpointsecurity,
+     true,
+     "Disable receiving events from the EndpointSecurity subsystem");
+
+FLAG(string,
+     es_mute_path_literal,
+     "",
+     "Comma-delimited executable paths whose EndpointSecurity events the "
+     "kernel drops");
+
+FLAG(string,
+     es_mute_path_prefix,
+     "",
+     "Comma-delimited executable path prefixes whose EndpointSecurity events "
+     "the kernel drops");
+
+REGISTER(EndpointSecurityPublisher, "event_publisher", "endpointsecurity");
+
+namespace {
+
+std::string getString(const es_string_token_t& token) {
+  if (token.data == nullptr || token.length == 0) {
+    return "";
+  }
+  return std::string(token.data, token.length);
+}
+
+std::string getEventName(es_event_type_t event_type) {
+  switch (event_type) {
+  case ES_EVENT_TYPE_NOTIFY_EXEC:
+    return "exec";
+  case ES_EVENT_TYPE_NOTIFY_FORK:
+    return "fork";
+  case ES_EVENT_TYPE_NOTIFY_EXIT:
+    return "exit";
+  default:
+    return "unknown";
+  }
+}
+
+void setProcessFields(const es_process_t* process,
+                      EndpointSecurityEventContext& ec) {
+  ec.pid = audit_token_to_pid(process->audit_token);
+  ec.pidversion = audit_token_to_pidversion(process->audit_token);
+  ec.ppid = process->ppid;
+  ec.original_ppid = process->original_ppid;
+  ec.uid = audit_token_to_ruid(process->audit_token);
+  ec.euid = audit_token_to_euid(process->audit_token);
+  ec.gid = audit_token_to_rgid(process->audit_token);
+  ec.egid = audit_token_to_egid(process->audit_token);
+  ec.platform_binary = process->is_platform_binary;
+  ec.signing_id = getString(process->signing_id);
+  ec.team_id = getString(process->team_id);
+  if (process->executable != nullptr) {
+    ec.path = getString(process->executable->path);
+  }
+
+  std::stringstream cdhash;
+  for (size_t i = 0; i < sizeof(process->cdhash); i++) {
+    cdhash << std::hex << std::setw(2) << std::setfill('0')
+           << static_cast<unsigned int>(process->cdhash[i]);
+  }
+  ec.cdhash = cdhash.str();
+}
+
+} // namespace
+
+Status EndpointSecurityPublisher::setUp() {
+  if (FLAGS_disable_endpointsecurity) {
+    return Status::failure("Publisher disabled via configuration");
+  }
+
+  WriteLock lock(mutex_);
+  auto result = es_new_client(
+      &client_, ^(es_client_t* client, const es_message_t* message) {
+        handleMessage(message);
+      });
+
+  switch (result) {
+  case ES_NEW_CLIENT_RESULT_SUCCESS:
+    break;
+  case ES_NEW_CLIENT_RESULT_ERR_NOT_ENTITLED:
+    return Status::failure("Missing the EndpointSecurity entitlement");
+  case ES_NEW_CLIENT_RESULT_ERR_NOT_PERMITTED:
+    return Status::failure("Missing Full Disk Access for EndpointSecurity");
+  case ES_NEW_CLIENT_RESULT_ERR_NOT_PRIVILEGED:
+    return Status::failure("EndpointSecurity requires root");
+  default:
+    return Status::failure("Cannot create the EndpointSecurity client: " +
+                           std::to_string(result));
+  }
+
+  // The events of this process would feed back into its own tables.
+  audit_token_t token;
+  mach_msg_type_number_t count = TASK_AUDIT_TOKEN_COUNT;
+  if (task_info(mach_task_self(),
+                TASK_AUDIT_TOKEN,
+                reinterpret_cast<task_info_t>(&token),
+                &count) == KERN_SUCCESS) {
+    es_mute_process(client_, &token);
+  }
+
+  return Status::success();
+}
+
+void EndpointSecurityPublisher::configureMutedPaths() {
+  es_unmute_all_paths(client_);
+
+  for (const auto& path : osquery::split(FLAGS_es_mute_path_literal, ",")) {
+    if (es_mute_path_literal(client_, path.c_str()) != ES_RETURN_SUCCESS) {
+      LOG(WARNING) << "Cannot mute EndpointSecurity path: " << path;
+    }
+  }
+
+  for (const auto& path : osquery::split(FLAGS_es_mute_path_prefix, ",")) {
+    if (es_mute_path_prefix(client_, path.c_str()) != ES_RETURN_SUCCESS) {
+      LOG(WARNING) << "Cannot mute EndpointSecurity path prefix: " << path;
+    }
+  }
+}
+
+void EndpointSecurityPublisher::configure() {
+  std::set<es_event_type_t> event_types;
+  {
+    ReadLock lock(subscription_lock_);
+    for (const auto& sub : subscriptions_) {
+      // Paused subscribers do not need their events delivered.
+      auto es = sub->getSubscriber();
+      if (es == nullptr || es->state() != EventState::EVENT_RUNNING) {
+        continue;
+      }
+
+      auto sc = getSubscriptionContext(sub->context);
+      event_types.insert(sc->event_types.begin(), sc->event_types.end());
+    }
+  }
+
+  WriteLock lock(mutex_);
+  if (client_ == nullptr) {
+    return;
+  }
+
+  configureMutedPaths();
+
+  std::vector<es_event_type_t> removed;
+  for (const auto& event_type : event_types_) {
+    if (event_types.count(event_type) == 0) {
+      removed.push_back(event_type);
+    }
+  }
+
+  std::vector<es_event_type_t> added;
+  for (const auto& event_type : event_types) {
+    if (event_types_.count(event_type) == 0) {
+      added.push_back(event_type);
+    }
+  }
+
+  if (!removed.empty() &&
+      es_unsubscribe(client_, removed.data(), removed.size()) !=
+          ES_RETURN_SUCCESS) {
+    LOG(WARNING) << "Cannot unsubscribe from EndpointSecurity events";
+  }
+
+  if (!added.empty() && es_subscribe(client_, added.data(), added.size()) !=
+                            ES_RETURN_SUCCESS) {
+    LOG(WARNING) << "Cannot subscribe to EndpointSecurity events";
+    for (const auto& event_type : added) {
+      event_types.erase(event_type);
+    }
+  }
+
+  event_types_ = std::move(event_types);
+}
+
+void EndpointSecurityPublisher::tearDown() {
+  WriteLock lock(mutex_);
+  if (client_ != nullptr) {
+    es_unsubscribe_all(client_);
+    es_delete_client(client_);
+    client_ = nullptr;
+  }
+  event_types_.clear();
+}
+
+Status EndpointSecurityPublisher::run() {
+  pause(std::chrono::milliseconds(1000));
+  return Status::success();
+}
+
+void EndpointSecurityPublisher::handleMessage(const es_message_t* message) {
+  auto ec = createEventContext();
+  ec->event_type = message->event_type;
+  ec->event = getEventName(message->event_type);
+  ec->time = message->time.tv_sec;
+  ec->seq_num = message->seq_num;
+
+  switch (message->event_type) {
+  case ES_EVENT_TYPE_NOTIFY_EXEC: {
+    // The target is the process image after the exec.
+    const auto& exec = message->event.exec;
+    setProcessFields(exec.target, *ec);
+
+    auto argc = es_exec_arg_count(&exec);
+    for (uint32_t i = 0; i < argc; i++) {
+      if (i > 0) {
+        ec->cmdline += ' ';
+      }
+      ec->cmdline += getString(es_exec_arg(&exec, i));
+    }
+
+    if (message->version >= 3 && exec.cwd != nullptr) {
+      ec->cwd = getString(exec.cwd->path);
+    }
+    break;
+  }
+  case ES_EVENT_TYPE_NOTIFY_FORK:
+    setProcessFields(message->process, *ec);
+    ec->child_pid = audit_token_to_pid(message->event.fork.child->audit_token);
+    break;
+  case ES_EVENT_TYPE_NOTIFY_EXIT:
+    setProcessFields(message->process, *ec);
+    ec->exit_code = message->event.exit.stat;
+    break;
+  default:
+    setProcessFields(message->process, *ec);
+    break;
+  }
+
+  fire(ec, ec->time);
+}
+
+bool EndpointSecurityPublisher::shouldFire(
+    const EndpointSecuritySubscriptionContextRef& sc,
+    const EndpointSecurityEventContextRef& ec) const {
+  for (const auto& event_type : sc->event_types) {
+    if (event_type == ec->event_type) {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace osquery
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <EndpointSecurity/EndpointSecurity.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <osquery/events/eventsubscriber.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+struct EndpointSecuritySubscriptionContext : public SubscriptionContext {
+  /// The EndpointSecurity NOTIFY event types this subscription requires.
+  std::vector<es_event_type_t> event_types;
+};
+
+/**
+ * @brief A message copied out of the EndpointSecurity client's queue.
+ *
+ * Messages are only valid within the client's handler, the fields used by
+ * subscribers are copied before the event is fired.
+ */
+struct EndpointSecurityEventContext : public EventContext {
+  es_event_type_t event_type{ES_EVENT_TYPE_LAST};
+
+  /// The name of the event type, such as 'exec', 'fork' or 'exit'.
+  std::string event;
+
+  /// The process that caused the event.
+  pid_t pid{0};
+  int pidversion{0};
+  pid_t ppid{0};
+  pid_t original_ppid{0};
+  uid_t uid{0};
+  uid_t euid{0};
+  gid_t gid{0};
+  gid_t egid{0};
+  std::string path;
+  std::string signing_id;
+  std::string team_id;
+  std::string cdhash;
+  bool platform_binary{false};
+
+  /// The target of an exec, the new image replaces the process above.
+  std::string cwd;
+  std::string cmdline;
+
+  /// The new process of a fork.
+  pid_t child_pid{0};
+
+  /// The status of an exit.
+  int exit_code{0};
+
+  /// The sequence number of the event type, gaps mean dropped messages.
+  uint64_t seq_num{0};
+};
+
+using EndpointSecurityEventContextRef =
+    std::shared_ptr<EndpointSecurityEventContext>;
+using EndpointSecuritySubscriptionContextRef =
+    std::shared_ptr<EndpointSecuritySubscriptionContext>;
+
+/**
+ * @brief An osquery EventPublisher for the macOS EndpointSecurity framework.
+ *
+ * The kernel delivers only the NOTIFY event types that running subscribers
+ * request, and drops events from processes at muted paths, so no audit
+ * token stream is parsed in userspace. The client needs the EndpointSecurity
+ * entitlement and Full Disk Access.
+ */
+class EndpointSecurityPublisher
+    : public EventPublisher<EndpointSecuritySubscriptionContext,
+                            EndpointSecurityEventContext> {
+  DECLARE_PUBLISHER("endpointsecurity");
+
+ public:
+  EndpointSecurityPublisher(
+      const std::string& name = "EndpointSecurityPublisher")
+      : EventPublisher() {
+    runnable_name_ = name;
+  }
+
+  Status setUp() override;
+
+  /// Subscribe to the union of the running subscribers' event types.
+  void configure() override;
+
+  void tearDown() override;
+
+  /// Events are delivered on the client's queue, this only waits.
+  Status run() override;
+
+  bool shouldFire(const EndpointSecuritySubscriptionContextRef& sc,
+                  const EndpointSecurityEventContextRef& ec) const override;
+
+ private:
+  /// Copy the fields of a message into an event context and fire it.
+  void handleMessage(const es_message_t* message);
+
+  /// Replace the muted paths with the configured literals and prefixes.
+  void configureMutedPaths();
+
+ private:
+  /// The client, created by setUp and deleted by tearDown.
+  es_client_t* client_{nullptr};
+
+  /// The event types the client is subscribed to.
+  std::set<es_event_type_t> event_types_;
+
+  /// Access to the client and its subscriptions.
+  Mutex mutex_;
+};
+} // namespace osquery
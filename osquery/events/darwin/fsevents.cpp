@@ -9,6 +9,8 @@
 
 #include <fnmatch.h>
 
+#include <unordered_map>
+
 #include <boost/filesystem.hpp>
 
 #include <osquery/config/config.h>
@@ -52,6 +54,35 @@ std::map<FSEventStreamEventFlags, std::string> kMaskActions = {
 
 REGISTER(FSEventsEventPublisher, "event_publisher", "fsevents");
 
+namespace {
+
+/// The union of the flags reported as actions.
+FSEventStreamEventFlags actionFlags() {
+  FSEventStreamEventFlags flags = 0;
+  for (const auto& action : kMaskActions) {
+    flags |= action.first;
+  }
+  return flags;
+}
+
+/// The components of a subscription glob, wildcard components match any.
+PathTrie::Path subscriptionComponents(const std::string& pattern) {
+  auto path = patternedPath::createPath(pattern);
+  if (path.size() == 1 && path[0].empty()) {
+    // The filesystem root.
+    path.clear();
+  }
+
+  for (auto& component : path) {
+    if (component.find_first_of("*?[") != std::string::npos) {
+      component = "*";
+    }
+  }
+  return path;
+}
+
+} // namespace
+
 void FSEventsSubscriptionContext::requireAction(const std::string& action) {
   for (const auto& bit : kMaskActions) {
     if (action == bit.second) {
@@ -98,10 +129,11 @@ void FSEventsEventPublisher::restart() {
     flags |= kFSEventStreamCreateFlagIgnoreSelf;
   }
 
-  // Create the FSEvent stream.
+  // Create the FSEvent stream, the callback is given this publisher.
+  FSEventStreamContext context = {0, this, nullptr, nullptr, nullptr};
   stream_ = FSEventStreamCreate(nullptr,
                                 &FSEventsEventPublisher::Callback,
-                                nullptr,
+                                &context,
                                 watch_list,
                                 kFSEventStreamEventIdSinceNow,
                                 1,
@@ -218,6 +250,39 @@ void FSEventsEventPublisher::buildExcludePathsSet() {
   }
 }
 
+void FSEventsEventPublisher::buildSubscribedPathsTrie() {
+  subscribed_paths_.clear();
+
+  ReadLock lock(subscription_lock_);
+  for (const auto& sub : subscriptions_) {
+    auto sc = getSubscriptionContext(sub->context);
+    if (sc->recursive && !sc->recursive_match) {
+      // The path is a string prefix, anything within its directory may match.
+      auto directory = sc->path.substr(0, sc->path.rfind('/') + 1);
+      subscribed_paths_.insert(subscriptionComponents(directory), true);
+      continue;
+    }
+
+    // A superset of the shouldFire glob, one component per path component.
+    auto path = subscriptionComponents(sc->path + "*");
+    subscribed_paths_.insert(path, false);
+    if (sc->recursive_match) {
+      subscribed_paths_.insert(path, true);
+    }
+  }
+}
+
+bool FSEventsEventPublisher::isExcluded(const std::string& path) const {
+  if (exclude_paths_.empty()) {
+    return false;
+  }
+
+  // Need to have two finds,
+  // what if somebody excluded an individual file inside a directory
+  return exclude_paths_.find(path.substr(0, path.rfind('/'))) ||
+         exclude_paths_.find(path);
+}
+
 void FSEventsEventPublisher::configure() {
   if (!FLAGS_enable_file_events) {
     return;
@@ -241,6 +306,7 @@ void FSEventsEventPublisher::configure() {
     }
   }
 
+  buildSubscribedPathsTrie();
   restart();
 }
 
@@ -276,52 +342,79 @@ void FSEventsEventPublisher::Callback(
     void* event_paths,
     const FSEventStreamEventFlags fsevent_flags[],
     const FSEventStreamEventId fsevent_ids[]) {
+  auto publisher = static_cast<FSEventsEventPublisher*>(callback_info);
+  static const auto kActionFlags = actionFlags();
+
+  // The flags already published for each path within this latency window.
+  // FSEvents accumulates the flags of a path, a build rewriting a file
+  // reports every earlier action again with each write.
+  std::unordered_map<std::string, FSEventStreamEventFlags> published_flags;
+
+  std::vector<EventContextRef> event_contexts;
   for (size_t i = 0; i < num_events; ++i) {
-    auto ec = createEventContext();
-    ec->fsevent_stream = stream;
-    ec->fsevent_flags = fsevent_flags[i];
-    ec->transaction_id = fsevent_ids[i];
-    ec->path = std::string(((char**)event_paths)[i]);
+    std::string path(((char**)event_paths)[i]);
+    auto flags = fsevent_flags[i];
 
-    if (ec->fsevent_flags & kFSEventStreamEventFlagMustScanSubDirs) {
+    if (flags & kFSEventStreamEventFlagMustScanSubDirs) {
       // The FSEvents thread coalesced events within and will report a root.
-      TLOG << "FSEvents collision, root: " << ec->path;
+      TLOG << "FSEvents collision, root: " << path;
     }
 
-    if (ec->fsevent_flags & kFSEventStreamEventFlagRootChanged) {
+    if (flags & kFSEventStreamEventFlagRootChanged) {
       // Must rescan for the changed root.
     }
 
-    if (ec->fsevent_flags & kFSEventStreamEventFlagUnmount) {
+    if (flags & kFSEventStreamEventFlagUnmount) {
       // Should remove the watch on this path.
     }
 
-    if (ec->fsevent_flags & kFSEventStreamEventFlagMount) {
+    if (flags & kFSEventStreamEventFlagMount) {
       auto mc = std::make_shared<FSEventsSubscriptionContext>();
-      mc->path = ec->path + "/*";
+      mc->path = path + "/*";
       auto subscription = Subscription::create("file_events", mc);
       auto status = EventFactory::addSubscription("fsevents", subscription);
       auto pub = EventFactory::getEventPublisher("fsevents");
       pub->configure();
     }
 
-    // Record the string-version of the first matched mask bit.
-    bool has_action = false;
+    if (!publisher->subscribed_paths_.find(path) ||
+        publisher->isExcluded(path)) {
+      continue;
+    }
+
+    auto published = published_flags.emplace(path, 0);
+    auto& previous = published.first->second;
+    auto actions = flags & kActionFlags & ~previous;
+    previous |= flags;
+    if (!published.second && actions == 0) {
+      // Every action of this event was already published for the path.
+      continue;
+    }
+
+    auto create = [&](const std::string& action) {
+      auto ec = createEventContext();
+      ec->fsevent_stream = stream;
+      ec->fsevent_flags = flags;
+      ec->transaction_id = fsevent_ids[i];
+      ec->path = path;
+      ec->action = action;
+      event_contexts.push_back(std::move(ec));
+    };
+
+    // Actions may be multiplexed. Fire an event for each.
     for (const auto& action : kMaskActions) {
-      if (ec->fsevent_flags & action.first) {
-        // Actions may be multiplexed. Fire and event for each.
-        ec->action = action.second;
-        EventFactory::fire<FSEventsEventPublisher>(ec);
-        has_action = true;
+      if (actions & action.first) {
+        create(action.second);
       }
     }
 
-    if (!has_action) {
+    if (actions == 0) {
       // If no action was matched for this path event, fire and unknown.
-      ec->action = "UNKNOWN";
-      EventFactory::fire<FSEventsEventPublisher>(ec);
+      create("UNKNOWN");
     }
   }
+
+  publisher->fireBatch(event_contexts);
 }
 
 bool FSEventsEventPublisher::shouldFire(
@@ -346,15 +439,7 @@ bool FSEventsEventPublisher::shouldFire(
     return false;
   }
 
-  auto path = ec->path.substr(0, ec->path.rfind('/'));
-  // Need to have two finds,
-  // what if somebody excluded an individual file inside a directory
-  if (!exclude_paths_.empty() &&
-      (exclude_paths_.find(path) || exclude_paths_.find(ec->path))) {
-    return false;
-  }
-
-  return true;
+  return !isExcluded(ec->path);
 }
 
 void FSEventsEventPublisher::flush(bool async) {
@@ -78,7 +78,7 @@ using FSEventsEventContextRef = std::shared_ptr<FSEventsEventContext>;
 using FSEventsSubscriptionContextRef =
     std::shared_ptr<FSEventsSubscriptionContext>;
 
-using ExcludePathSet = PathSet<patternedPath>;
+using ExcludePathSet = PathTrie;
 
 /**
  * @brief An osquery EventPublisher for the Apple FSEvents notification API.
@@ -146,6 +146,12 @@ class FSEventsEventPublisher
   /// Build the set of excluded paths for which events are not to be propagated.
   void buildExcludePathsSet();
 
+  /// Build the trie of paths that any subscription may match.
+  void buildSubscribedPathsTrie();
+
+  /// Check if a path, or its parent directory, is excluded.
+  bool isExcluded(const std::string& path) const;
+
  private:
   /// Check if the stream (and run loop) are running.
   bool isStreamRunning() const;
@@ -166,6 +172,14 @@ class FSEventsEventPublisher
   /// Events pertaining to these paths not to be propagated.
   ExcludePathSet exclude_paths_;
 
+  /**
+   * @brief Paths any subscription may match, folded for case.
+   *
+   * FSEvents watches are recursive, this drops events below a watched path
+   * that no subscription could match before any event context is created.
+   */
+  PathTrie subscribed_paths_{false};
+
   /// Reference to the run loop for this thread.
   CFRunLoopRef run_loop_{nullptr};
 
@@ -189,5 +203,6 @@ class FSEventsEventPublisher
   FRIEND_TEST(FSEventsTests, test_fsevents_event_action);
   FRIEND_TEST(FSEventsTests, test_fsevents_embedded_wildcards);
   FRIEND_TEST(FSEventsTests, test_fsevents_match_subscription);
+  FRIEND_TEST(FSEventsTests, test_fsevents_coalesce_events);
 };
 }
@@ -9,9 +9,12 @@
 
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
+#include <osquery/core/plugins/logger.h>
 #include <osquery/core/system.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventsubscriber.h>
+#include <osquery/extensions/shared_ring.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
@@ -34,6 +37,33 @@ struct SubscriberExpirationDetails {
   size_t query_count{0};
 };
 
+/// Lookup a logger plugin within this process, nullptr if it is external.
+std::shared_ptr<LoggerPlugin> getLocalLogger(const std::string& name) {
+  if (!Registry::get().exists("logger", name, true)) {
+    return nullptr;
+  }
+  return std::dynamic_pointer_cast<LoggerPlugin>(
+      Registry::get().plugin("logger", name));
+}
+
+/// Report the rows each subscriber has queued for storage.
+void reportEventsMemory(std::vector<SubsystemMemory>& memory) {
+  for (const auto& name : EventFactory::subscriberNames()) {
+    auto subscriber = EventFactory::getEventSubscriber(name);
+    if (subscriber == nullptr) {
+      continue;
+    }
+
+    SubsystemMemory queued;
+    queued.name = name;
+    queued.items = static_cast<int64_t>(subscriber->numQueuedEvents());
+    memory.push_back(std::move(queued));
+  }
+}
+
+const bool kEventsMemoryReporter =
+    registerMemoryReporter("events", reportEventsMemory);
+
 } // namespace
 
 FLAG(bool, disable_events, false, "Disable osquery publish/subscribe system");
@@ -94,12 +124,15 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
   if (!status) {
     base_sub->disabled = true;
   }
+  base_sub->configureRollup();
+  base_sub->configureLimits();
   base_sub->state(EventState::EVENT_SETUP);
 
   // Let the subscriber initialize any Subscriptions.
   if (!FLAGS_disable_events && !base_sub->disabled) {
     status = base_sub->init();
     base_sub->state(EventState::EVENT_RUNNING);
+    EventSubscriberPlugin::startEventQueue(base_sub);
   } else {
     base_sub->state(EventState::EVENT_PAUSED);
   }
@@ -108,6 +141,7 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
   {
     RecursiveLock lock(ef.factory_lock_);
     ef.event_subs_[name] = base_sub;
+    ef.subscriber_generation_++;
   }
 
   // Set state of subscriber.
@@ -175,6 +209,7 @@ Status EventFactory::deregisterEventSubscriber(const std::string& sub) {
 
   auto subscriber = subscriber_it->second;
   ef.event_subs_.erase(subscriber_it);
+  ef.subscriber_generation_++;
 
   subscriber->tearDown();
   subscriber->state(EventState::EVENT_NONE);
@@ -275,6 +310,10 @@ bool EventFactory::exists(const std::string& name_id) {
   return (getInstance().event_subs_.count(name_id) > 0);
 }
 
+size_t EventFactory::subscriberGeneration() {
+  return getInstance().subscriber_generation_.load();
+}
+
 std::vector<std::string> EventFactory::publisherTypes() {
   RecursiveLock lock(getInstance().factory_lock_);
   std::vector<std::string> types;
@@ -297,13 +336,58 @@ void EventFactory::addForwarder(const std::string& logger) {
   getInstance().loggers_.push_back(logger);
 }
 
+bool EventFactory::hasForwarders() {
+  return !getInstance().loggers_.empty();
+}
+
 void EventFactory::forwardEvent(const std::string& event) {
   for (const auto& logger : getInstance().loggers_) {
-    Registry::call("logger", logger, {{"event", event}});
+    auto plugin = getLocalLogger(logger);
+    if (plugin != nullptr) {
+      plugin->logEvent(event);
+    } else {
+      Registry::call("logger", logger, {{"event", event}});
+    }
+  }
+}
+
+void EventFactory::forwardEvents(const std::string& events) {
+  for (const auto& logger : getInstance().loggers_) {
+    auto plugin = getLocalLogger(logger);
+    if (plugin != nullptr) {
+      plugin->logEventBatch(events);
+      continue;
+    }
+
+    if (callSharedRing("logger", logger, "event_batch", events).ok()) {
+      continue;
+    }
+
+    // Otherwise extension loggers are called once for each event.
+    size_t start = 0;
+    while (start < events.size()) {
+      auto end = events.find('\n', start);
+      if (end == std::string::npos) {
+        end = events.size();
+      }
+      Registry::call(
+          "logger", logger, {{"event", events.substr(start, end - start)}});
+      start = end + 1;
+    }
   }
 }
 
 void EventFactory::configUpdate() {
+  scheduleUpdate();
+
+  // If events are enabled configure the subscribers before publishers.
+  if (!FLAGS_disable_events) {
+    RegistryFactory::get().registry("event_subscriber")->configure();
+    RegistryFactory::get().registry("event_publisher")->configure();
+  }
+}
+
+void EventFactory::scheduleUpdate() {
   // Scan the schedule for queries that touch "_events" tables.
   // We will count the queries
   std::map<std::string, SubscriberExpirationDetails> subscriber_details;
@@ -356,12 +440,6 @@ void EventFactory::configUpdate() {
     WriteLock subscriber_lock(subscriber->event_query_record_);
     subscriber->queries_.clear();
   }
-
-  // If events are enabled configure the subscribers before publishers.
-  if (!FLAGS_disable_events) {
-    RegistryFactory::get().registry("event_subscriber")->configure();
-    RegistryFactory::get().registry("event_publisher")->configure();
-  }
 }
 
 Status EventFactory::run(const std::string& type_id) {
@@ -467,6 +545,7 @@ void EventFactory::end(bool join) {
     // Threads may still be executing, when they finish, release publishers.
     ef.event_pubs_.clear();
     ef.event_subs_.clear();
+    ef.subscriber_generation_++;
   }
 }
 
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <vector>
@@ -137,6 +138,9 @@ class EventFactory : private boost::noncopyable {
   /// Check if an event subscriber exists.
   static bool exists(const std::string& sub);
 
+  /// Changes whenever an EventSubscriber is registered or removed.
+  static size_t subscriberGeneration();
+
   /// Return a list of publisher types, these are their registry names.
   static std::vector<std::string> publisherTypes();
 
@@ -149,6 +153,17 @@ class EventFactory : private boost::noncopyable {
   /// Optionally forward events to loggers.
   static void forwardEvent(const std::string& event);
 
+  /**
+   * @brief Optionally forward a batch of events to loggers.
+   *
+   * The batch holds one serialized event per line, each newline-terminated.
+   * Local loggers receive the shared buffer in a single logEventBatch call.
+   */
+  static void forwardEvents(const std::string& events);
+
+  /// Check if any logger has requested events to be forwarded.
+  static bool hasForwarders();
+
   /**
    * @brief The event factory, subscribers, and publishers respond to updates.
    *
@@ -159,6 +174,14 @@ class EventFactory : private boost::noncopyable {
    */
   static void configUpdate();
 
+  /**
+   * @brief Update subscriber expirations after only the schedule changed.
+   *
+   * Subscribers and publishers are not reconfigured, watches and event
+   * streams are left untouched.
+   */
+  static void scheduleUpdate();
+
  public:
   /// The dispatched event thread's entry-point (if needed).
   static Status run(const std::string& type_id);
@@ -226,6 +249,9 @@ class EventFactory : private boost::noncopyable {
 
   /// Factory publisher state manipulation.
   RecursiveMutex factory_lock_;
+
+  /// Invalidates the subscribers cached by each Subscription.
+  std::atomic<size_t> subscriber_generation_{1};
 };
 
 } // namespace osquery
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include <osquery/events/eventindex.h>
+
+namespace osquery {
+
+namespace {
+
+bool batchTimeLess(const EventBatch& batch, EventTime time) {
+  return batch.time() < time;
+}
+
+bool timeBatchLess(EventTime time, const EventBatch& batch) {
+  return time < batch.time();
+}
+
+} // namespace
+
+void EventBatch::add(EventID id) {
+  if (count_ == 0U) {
+    first_ = {id, id};
+
+  } else {
+    auto& last_range = overflow_.empty() ? first_ : overflow_.back();
+    if (id == last_range.last + 1U) {
+      last_range.last = id;
+    } else {
+      overflow_.push_back({id, id});
+    }
+  }
+
+  ++count_;
+}
+
+void EventIndex::add(EventTime time, EventID id) {
+  getBatch(time).add(id);
+  ++event_count_;
+}
+
+void EventIndex::add(EventTime time, const EventIDList& id_list) {
+  if (id_list.empty()) {
+    return;
+  }
+
+  auto& batch = getBatch(time);
+  for (const auto& id : id_list) {
+    batch.add(id);
+  }
+
+  event_count_ += id_list.size();
+}
+
+EventIndex EventIndex::removeOldest(std::size_t count) {
+  return split(std::min(count, batches_.size()));
+}
+
+EventIndex EventIndex::removeUntil(EventTime time) {
+  return split(static_cast<std::size_t>(upperBound(time) - batches_.begin()));
+}
+
+EventIndex::const_iterator EventIndex::lowerBound(EventTime time) const {
+  return std::lower_bound(
+      batches_.begin(), batches_.end(), time, batchTimeLess);
+}
+
+EventIndex::const_iterator EventIndex::upperBound(EventTime time) const {
+  return std::upper_bound(
+      batches_.begin(), batches_.end(), time, timeBatchLess);
+}
+
+void EventIndex::clear() {
+  batches_.clear();
+  event_count_ = 0U;
+}
+
+EventBatch& EventIndex::getBatch(EventTime time) {
+  // Events are stored as they happen, the newest batch is the common case.
+  if (batches_.empty() || batches_.back().time() < time) {
+    batches_.emplace_back(time);
+    return batches_.back();
+
+  } else if (batches_.back().time() == time) {
+    return batches_.back();
+  }
+
+  auto it =
+      std::lower_bound(batches_.begin(), batches_.end(), time, batchTimeLess);
+  if (it == batches_.end() || it->time() != time) {
+    it = batches_.emplace(it, time);
+  }
+
+  return *it;
+}
+
+EventIndex EventIndex::split(std::size_t count) {
+  EventIndex removed;
+  if (count == 0U) {
+    return removed;
+  }
+
+  auto range_end = std::next(batches_.begin(), count);
+  for (auto it = batches_.begin(); it != range_end; ++it) {
+    removed.event_count_ += it->size();
+  }
+
+  removed.batches_.insert(removed.batches_.end(),
+                          std::make_move_iterator(batches_.begin()),
+                          std::make_move_iterator(range_end));
+
+  // Erasing from the front of a deque does not move the remaining batches.
+  batches_.erase(batches_.begin(), range_end);
+  event_count_ -= removed.event_count_;
+
+  return removed;
+}
+
+} // namespace osquery
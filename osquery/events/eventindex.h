@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <osquery/events/types.h>
+
+namespace osquery {
+
+/// An inclusive range of contiguous event identifiers.
+struct EventIDRange final {
+  EventID first{0U};
+  EventID last{0U};
+
+  std::size_t size() const {
+    return static_cast<std::size_t>(last - first + 1U);
+  }
+};
+
+/**
+ * @brief The identifiers of the events stored at a single event time.
+ *
+ * Identifiers are allocated sequentially, so a batch is nearly always a
+ * single range; it is kept inline and only fragmented batches allocate.
+ * Ranges are kept in insertion order.
+ */
+class EventBatch final {
+ public:
+  explicit EventBatch(EventTime time) : time_(time) {}
+
+  /// Append an identifier, extending the last range when contiguous.
+  void add(EventID id);
+
+  EventTime time() const {
+    return time_;
+  }
+
+  std::size_t rangeCount() const {
+    return (count_ == 0U) ? 0U : 1U + overflow_.size();
+  }
+
+  const EventIDRange& range(std::size_t index) const {
+    return (index == 0U) ? first_ : overflow_[index - 1U];
+  }
+
+  /// The number of event identifiers in the batch.
+  std::size_t size() const {
+    return count_;
+  }
+
+ private:
+  EventTime time_{0U};
+  std::size_t count_{0U};
+  EventIDRange first_;
+  std::vector<EventIDRange> overflow_;
+};
+
+/**
+ * @brief The in-memory index of a subscriber's stored events.
+ *
+ * Batches are kept ordered by time in a deque, so lookups are a binary
+ * search and the oldest batches are expired from the front without moving
+ * the rest. Events are nearly always added at the newest time.
+ */
+class EventIndex final {
+ public:
+  using const_iterator = std::deque<EventBatch>::const_iterator;
+  using const_reverse_iterator =
+      std::deque<EventBatch>::const_reverse_iterator;
+
+  /// Record an event identifier stored at a time.
+  void add(EventTime time, EventID id);
+
+  /// Record a list of event identifiers stored at a time.
+  void add(EventTime time, const EventIDList& id_list);
+
+  /// Remove and return the oldest batches.
+  EventIndex removeOldest(std::size_t count);
+
+  /// Remove and return the batches with a time up to, and including, time.
+  EventIndex removeUntil(EventTime time);
+
+  /// The first batch with a time not before time.
+  const_iterator lowerBound(EventTime time) const;
+
+  /// The first batch with a time after time.
+  const_iterator upperBound(EventTime time) const;
+
+  const_iterator begin() const {
+    return batches_.begin();
+  }
+
+  const_iterator end() const {
+    return batches_.end();
+  }
+
+  /// The number of batches, which is the number of distinct event times.
+  std::size_t size() const {
+    return batches_.size();
+  }
+
+  bool empty() const {
+    return batches_.empty();
+  }
+
+  /// The number of event identifiers across all batches.
+  std::size_t eventCount() const {
+    return event_count_;
+  }
+
+  void clear();
+
+ private:
+  /// Find, or insert, the batch for a time.
+  EventBatch& getBatch(EventTime time);
+
+  /// Move the first count batches into a new index.
+  EventIndex split(std::size_t count);
+
+ private:
+  std::deque<EventBatch> batches_;
+  std::size_t event_count_{0U};
+};
+
+} // namespace osquery
@@ -127,6 +127,7 @@ class EventPublisher : public EventPublisherPlugin {
   FRIEND_TEST(EventsTests, test_event_subscriber_subscribe);
   FRIEND_TEST(EventsTests, test_event_subscriber_context);
   FRIEND_TEST(EventsTests, test_fire_event);
+  FRIEND_TEST(EventsTests, test_fire_batch);
 };
 
 } // namespace osquery
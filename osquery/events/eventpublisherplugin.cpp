@@ -61,6 +61,50 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
     return;
   }
 
+  prepareEventContext(ec, time);
+
+  ReadLock lock(subscription_lock_);
+  for (const auto& subscription : subscriptions_) {
+    auto es = subscription->getSubscriber();
+    if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
+      fireCallback(subscription, ec);
+    }
+  }
+}
+
+void EventPublisherPlugin::fireBatch(const std::vector<EventContextRef>& ecs,
+                                     EventTime time) {
+  if (isEnding() || ecs.empty()) {
+    return;
+  }
+
+  if (time == 0) {
+    time = getUnixTime();
+  }
+
+  for (const auto& ec : ecs) {
+    prepareEventContext(ec, time);
+  }
+
+  ReadLock lock(subscription_lock_);
+  for (const auto& subscription : subscriptions_) {
+    auto es = subscription->getSubscriber();
+    if (es == nullptr) {
+      continue;
+    }
+
+    for (const auto& ec : ecs) {
+      // A subscriber may be paused or fail while the batch is delivered.
+      if (es->state() != EventState::EVENT_RUNNING) {
+        break;
+      }
+      fireCallback(subscription, ec);
+    }
+  }
+}
+
+void EventPublisherPlugin::prepareEventContext(const EventContextRef& ec,
+                                               EventTime time) {
   EventContextID ec_id = 0;
   ec_id = next_ec_id_.fetch_add(1);
 
@@ -74,14 +118,6 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
       ec->time = time;
     }
   }
-
-  ReadLock lock(subscription_lock_);
-  for (const auto& subscription : subscriptions_) {
-    auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
-    if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
-      fireCallback(subscription, ec);
-    }
-  }
 }
 
 void EventPublisherPlugin::configure() {}
@@ -138,6 +138,21 @@ class EventPublisherPlugin : public Plugin,
    */
   void fire(const EventContextRef& ec, EventTime time = 0);
 
+  /**
+   * @brief Fire a batch of events, in order, to each Subscription.
+   *
+   * Subscriptions are locked and their subscribers resolved once per batch
+   * rather than once per event. Publishers that read several events at a
+   * time should prefer this to calling `fire` for each.
+   *
+   * @param ecs The EventContext%s created by the EventPublisher.
+   * @param time The most accurate time associated with the events.
+   */
+  void fireBatch(const std::vector<EventContextRef>& ecs, EventTime time = 0);
+
+  /// Assign the EventContext ID, and the time if the publisher did not.
+  void prepareEventContext(const EventContextRef& ec, EventTime time);
+
   /// The internal fire method used by the typed EventPublisher.
   virtual void fireCallback(const SubscriptionRef& sub,
                             const EventContextRef& ec) const = 0;
@@ -173,5 +188,6 @@ class EventPublisherPlugin : public Plugin,
 
   FRIEND_TEST(EventsTests, test_event_publisher);
   FRIEND_TEST(EventsTests, test_fire_event);
+  FRIEND_TEST(EventsTests, test_fire_batch);
 };
 } // namespace osquery
@@ -7,14 +7,21 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/database/database.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventsubscriberplugin.h>
+#include <osquery/experimental/events_stream/events_stream.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/tool_type.h>
 #include <osquery/utils/system/time.h>
@@ -26,6 +33,9 @@ namespace {
 /// Checkpoint interval to inspect max event buffering.
 const EventContextID kEventsCheckpoint{256U};
 
+/// Number of event rows requested from the database at a time.
+const std::size_t kEventsBatchReadSize{1024U};
+
 void removeDeprecatedEventKeysOnceHelper() {
   std::vector<std::string> key_list;
   auto status = scanDatabaseKeys(kEvents, key_list);
@@ -70,6 +80,20 @@ void removeDeprecatedEventKeysOnce() {
 
 } // namespace
 
+/// Stores the rows a subscriber queued from its publisher's thread.
+class EventQueueRunner : public InternalRunnable {
+ public:
+  explicit EventQueueRunner(const EventSubscriberRef& subscriber)
+      : InternalRunnable("EventQueueRunner"), subscriber_(subscriber) {}
+
+ protected:
+  void start() override;
+
+ private:
+  /// The worker does not keep a removed subscriber alive.
+  std::weak_ptr<EventSubscriberPlugin> subscriber_;
+};
+
 FLAG(bool,
      events_optimize,
      true,
@@ -86,6 +110,71 @@ FLAG(uint64,
      50000,
      "Maximum number of event batches per type to buffer");
 
+FLAG(uint64,
+     events_queue_max,
+     0,
+     "Maximum rows each subscriber queues for asynchronous storage (0 stores "
+     "from the publisher thread)");
+
+FLAG(string,
+     events_rollup,
+     "",
+     "Comma-separated list of event subscribers storing each distinct event "
+     "once per window, with a count");
+
+FLAG(uint64,
+     events_rollup_window,
+     60,
+     "Seconds over which events of --events_rollup subscribers are counted");
+
+FLAG(string,
+     events_rollup_ignore,
+     "",
+     "Comma-separated list of columns removed from events of --events_rollup "
+     "subscribers before they are compared");
+
+FLAG(string,
+     events_rate_limit,
+     "",
+     "Comma-separated list of subscriber:rows_per_second[:burst] rate limits "
+     "of the stored events");
+
+FLAG(string,
+     events_sample,
+     "",
+     "Comma-separated list of subscriber:N storing one of every N events");
+
+FLAG(string,
+     events_limit_key,
+     "",
+     "Comma-separated list of subscriber:column applying the rate limit and "
+     "sampling to each value of the column separately");
+
+DECLARE_bool(lazy_startup);
+
+namespace {
+
+/// Columns that differ between every event, never compared.
+const std::vector<std::string> kRollupIgnoredColumns = {"time", "uptime", "eid"};
+
+/// The max number of distinct rows in a window, more end the window early.
+const size_t kRollupMaxEntries = 100000;
+
+/// The options of a subscriber in a list of subscriber:options, split by ':'.
+std::vector<std::string> subscriberOptions(const std::string& flag,
+                                           const std::string& name) {
+  for (const auto& item : split(flag, ",")) {
+    auto options = split(item, ":");
+    if (options.size() > 1 && options[0] == name) {
+      options.erase(options.begin());
+      return options;
+    }
+  }
+  return {};
+}
+
+} // namespace
+
 CREATE_REGISTRY(EventSubscriberPlugin, "event_subscriber");
 
 EventSubscriberPlugin::EventSubscriberPlugin(bool enabled)
@@ -105,12 +194,283 @@ Status EventSubscriberPlugin::add(const Row& r) {
 }
 
 Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list) {
-  return addBatch(row_list, getUnixTime());
+  limitBatch(row_list);
+  if (row_list.empty()) {
+    return Status::success();
+  }
+
+  if (rollup_.enabled) {
+    return rollupBatch(row_list);
+  }
+
+  // The event time is taken when the rows are queued, not when stored.
+  return queueBatch(row_list, getUnixTime());
+}
+
+Status EventSubscriberPlugin::queueBatch(std::vector<Row>& row_list,
+                                         EventTime event_time) {
+  if (!event_queue_.enabled || row_list.empty()) {
+    return addBatch(row_list, event_time);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(event_queue_.mutex);
+    if (event_queue_.rows + row_list.size() > FLAGS_events_queue_max) {
+      event_queue_.dropped += row_list.size();
+      return Status::failure("The event queue of " + getName() + " is full");
+    }
+
+    event_queue_.rows += row_list.size();
+    event_queue_.batches.emplace_back(event_time, std::move(row_list));
+  }
+  event_queue_.cv.notify_one();
+
+  row_list.clear();
+  return Status::success();
+}
+
+Status EventSubscriberPlugin::rollupBatch(std::vector<Row>& row_list) {
+  auto now = getUnixTime();
+  std::unordered_map<std::string, EventRollup::Entry> ended_window;
+  {
+    std::lock_guard<std::mutex> lock(rollup_.mutex);
+    if (rollup_.window_start == 0) {
+      rollup_.window_start = now;
+    } else if (now >= rollup_.window_start + FLAGS_events_rollup_window ||
+               rollup_.entries.size() >= kRollupMaxEntries) {
+      ended_window.swap(rollup_.entries);
+      rollup_.window_start = now;
+    }
+
+    std::string key;
+    for (auto& row : row_list) {
+      for (const auto& column : kRollupIgnoredColumns) {
+        row.erase(column);
+      }
+      for (const auto& column : rollup_.ignored_columns) {
+        row.erase(column);
+      }
+
+      // Rows are sorted maps, equal rows have equal keys.
+      key.clear();
+      for (const auto& cell : row) {
+        key.append(cell.first);
+        key.push_back('\0');
+        key.append(cell.second);
+        key.push_back('\0');
+      }
+
+      auto& entry = rollup_.entries[key];
+      if (entry.count == 0) {
+        entry.row = std::move(row);
+        entry.first_time = now;
+      }
+      entry.count++;
+      entry.last_time = now;
+    }
+  }
+  row_list.clear();
+
+  return storeRollup(ended_window);
+}
+
+Status EventSubscriberPlugin::flushRollup(bool force) {
+  if (!rollup_.enabled) {
+    return Status::success();
+  }
+
+  std::unordered_map<std::string, EventRollup::Entry> ended_window;
+  {
+    std::lock_guard<std::mutex> lock(rollup_.mutex);
+    if (force || getUnixTime() >=
+                     rollup_.window_start + FLAGS_events_rollup_window) {
+      ended_window.swap(rollup_.entries);
+      rollup_.window_start = 0;
+    }
+  }
+
+  return storeRollup(ended_window);
+}
+
+Status EventSubscriberPlugin::storeRollup(
+    std::unordered_map<std::string, EventRollup::Entry>& ended_window) {
+  // Rows are stored at the time of their first event.
+  std::map<EventTime, std::vector<Row>> batches;
+  for (auto& entry : ended_window) {
+    auto& row = entry.second.row;
+    row["rollup_count"] = std::to_string(entry.second.count);
+    row["rollup_last_time"] = std::to_string(entry.second.last_time);
+    batches[entry.second.first_time].push_back(std::move(row));
+  }
+
+  Status status;
+  for (auto& batch : batches) {
+    auto batch_status = queueBatch(batch.second, batch.first);
+    if (!batch_status.ok()) {
+      status = batch_status;
+    }
+  }
+  return status;
+}
+
+void EventSubscriberPlugin::configureRollup() {
+  auto rollup_subscribers = split(FLAGS_events_rollup, ",");
+  rollup_.enabled =
+      std::find(rollup_subscribers.begin(),
+                rollup_subscribers.end(),
+                getName()) != rollup_subscribers.end();
+
+  std::lock_guard<std::mutex> lock(rollup_.mutex);
+  rollup_.ignored_columns = split(FLAGS_events_rollup_ignore, ",");
+}
+
+void EventSubscriberPlugin::configureLimits() {
+  std::lock_guard<std::mutex> lock(limits_.mutex);
+  limits_.rate = 0;
+  limits_.burst = 0;
+  limits_.sample = 1;
+
+  auto rate = subscriberOptions(FLAGS_events_rate_limit, getName());
+  if (!rate.empty()) {
+    limits_.rate = tryTo<std::size_t>(rate[0]).takeOr(std::size_t{0});
+    limits_.burst = limits_.rate;
+    if (rate.size() > 1) {
+      limits_.burst = tryTo<std::size_t>(rate[1]).takeOr(limits_.rate);
+    }
+  }
+
+  auto sample = subscriberOptions(FLAGS_events_sample, getName());
+  if (!sample.empty()) {
+    limits_.sample =
+        std::max(tryTo<std::size_t>(sample[0]).takeOr(std::size_t{1}),
+                 std::size_t{1});
+  }
+
+  auto key_column = subscriberOptions(FLAGS_events_limit_key, getName());
+  limits_.key_column = key_column.empty() ? "" : key_column[0];
+
+  // Buckets start full.
+  limits_.state = EventLimits::State();
+  limits_.state.tokens = static_cast<double>(limits_.burst);
+  limits_.state.refill_time = std::chrono::steady_clock::now();
+  limits_.key_states.clear();
+  limits_.enabled = limits_.rate > 0 || limits_.sample > 1;
+}
+
+void EventSubscriberPlugin::limitBatch(std::vector<Row>& row_list) {
+  if (!limits_.enabled || row_list.empty()) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  size_t limited = 0;
+  size_t sampled_out = 0;
+  {
+    std::lock_guard<std::mutex> lock(limits_.mutex);
+    auto kept = row_list.begin();
+    for (auto& row : row_list) {
+      auto* state = &limits_.state;
+      if (!limits_.key_column.empty()) {
+        auto it = row.find(limits_.key_column);
+        const auto& key = (it != row.end()) ? it->second : std::string();
+        state = limits_.key_states.get(key);
+        if (state == nullptr) {
+          EventLimits::State key_state;
+          key_state.tokens = static_cast<double>(limits_.burst);
+          key_state.refill_time = now;
+          state = limits_.key_states.insert(key, key_state);
+        }
+      }
+
+      // Sampling keeps the first of every sample rows, it costs no token.
+      if (state->seen++ % limits_.sample != 0) {
+        sampled_out++;
+        continue;
+      }
+
+      if (limits_.rate > 0) {
+        std::chrono::duration<double> elapsed = now - state->refill_time;
+        auto tokens = state->tokens + elapsed.count() * limits_.rate;
+        state->tokens = std::min(static_cast<double>(limits_.burst), tokens);
+        state->refill_time = now;
+        if (state->tokens < 1) {
+          limited++;
+          continue;
+        }
+        state->tokens -= 1;
+      }
+
+      if (&*kept != &row) {
+        *kept = std::move(row);
+      }
+      ++kept;
+    }
+    row_list.erase(kept, row_list.end());
+  }
+
+  limits_.limited += limited;
+  limits_.sampled_out += sampled_out;
+}
+
+void EventSubscriberPlugin::startEventQueue(
+    const EventSubscriberRef& subscriber) {
+  if (FLAGS_events_queue_max == 0 || subscriber->event_queue_.enabled) {
+    return;
+  }
+
+  subscriber->event_queue_.enabled = true;
+  Dispatcher::addService(std::make_shared<EventQueueRunner>(subscriber));
+}
+
+void EventSubscriberPlugin::storeQueuedEvents() {
+  std::deque<std::pair<EventTime, std::vector<Row>>> batches;
+  {
+    std::unique_lock<std::mutex> lock(event_queue_.mutex);
+    event_queue_.cv.wait_for(lock, std::chrono::seconds(1), [this]() {
+      return !event_queue_.batches.empty();
+    });
+
+    batches.swap(event_queue_.batches);
+    event_queue_.rows = 0;
+  }
+
+  // Batches queued within the same second are stored as one.
+  while (!batches.empty()) {
+    auto event_time = batches.front().first;
+    auto row_list = std::move(batches.front().second);
+    batches.pop_front();
+
+    while (!batches.empty() && batches.front().first == event_time) {
+      auto& next = batches.front().second;
+      row_list.insert(row_list.end(),
+                      std::make_move_iterator(next.begin()),
+                      std::make_move_iterator(next.end()));
+      batches.pop_front();
+    }
+
+    auto status = addBatch(row_list, event_time);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to store queued events for " << getName() << ": "
+              << status.getMessage();
+    }
+  }
+}
+
+void EventQueueRunner::start() {
+  while (!interrupted()) {
+    auto subscriber = subscriber_.lock();
+    if (subscriber == nullptr) {
+      break;
+    }
+
+    subscriber->storeQueuedEvents();
+  }
 }
 
 Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
                                        EventTime custom_event_time) {
   removeDeprecatedEventKeysOnce();
+  waitForEventIndex();
 
   DatabaseStringValueList database_data;
   database_data.reserve(row_list.size());
@@ -121,6 +481,18 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
   auto event_time = custom_event_time != 0 ? custom_event_time : getUnixTime();
   auto string_event_time = std::to_string(event_time);
 
+  // Rows forwarded to loggers share one newline-terminated buffer.
+  std::string forwarded_rows;
+  bool forwarding = EventFactory::hasForwarders();
+
+  // Rows streamed to the events streaming plugin are dispatched as one batch.
+  events::SerializedEvents streamed_rows;
+  bool streaming = events::isEventStreamingEnabled();
+  if (streaming) {
+    streamed_rows.source = getName();
+    streamed_rows.offsets.reserve(row_list.size());
+  }
+
   for (auto& row : row_list) {
     auto event_identifier = getEventID();
     event_id_list.push_back(event_identifier);
@@ -130,29 +502,57 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
     row["time"] = string_event_time;
     row["eid"] = string_event_identifier;
 
+    // Logger plugins may request events to be forwarded directly.
+    // If no active logger is marked 'usesLogEvent' then this is a no-op.
+    if (forwarding || streaming) {
+      std::string json_row;
+      auto status = serializeRowJSON(row, json_row);
+      if (!status.ok()) {
+        VLOG(1) << status.getMessage();
+        continue;
+      }
+
+      // Then remove the newline.
+      if (json_row.size() > 0 && json_row.back() == '\n') {
+        json_row.pop_back();
+      }
+      if (forwarding) {
+        forwarded_rows.append(json_row);
+        forwarded_rows.push_back('\n');
+      }
+      if (streaming) {
+        streamed_rows.add(json_row);
+      }
+    }
+
     // Serialize and store the row data, for query-time retrieval.
     std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
+    std::pair<std::string, std::string> new_schema;
+    auto status = serializeEventRow(context, row, serialized_row, new_schema);
     if (!status.ok()) {
       VLOG(1) << status.getMessage();
       continue;
     }
 
-    // Then remove the newline.
-    if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
-      serialized_row.pop_back();
+    // A new schema is written in the same batch, ahead of its first row.
+    if (!new_schema.first.empty()) {
+      database_data.push_back(std::move(new_schema));
     }
 
-    // Logger plugins may request events to be forwarded directly.
-    // If no active logger is marked 'usesLogEvent' then this is a no-op.
-    EventFactory::forwardEvent(serialized_row);
-
     // Store the event data in the batch
     database_data.push_back(
         std::make_pair("data." + dbNamespace() + "." + string_event_identifier,
                        serialized_row));
   }
 
+  if (!forwarded_rows.empty()) {
+    EventFactory::forwardEvents(forwarded_rows);
+  }
+
+  if (!streamed_rows.empty()) {
+    events::dispatchSerializedEvents(streamed_rows);
+  }
+
   if (database_data.empty()) {
     return Status(1, "Failed to process the rows");
   }
@@ -165,18 +565,12 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
 
     auto status = setDatabaseBatch(kEvents, database_data);
     if (!status.ok()) {
+      // Schemas assigned in this batch were not persisted, forget them.
+      loadRowSchemas(context, getOsqueryDatabase());
       return status;
     }
 
-    auto it = context.event_index.find(event_time);
-    if (it == context.event_index.end()) {
-      context.event_index.insert({event_time, event_id_list});
-
-    } else {
-      auto& index_entry = it->second;
-      index_entry.insert(
-          index_entry.end(), event_id_list.begin(), event_id_list.end());
-    }
+    context.event_index.add(event_time, event_id_list);
 
     event_count_ += row_list.size();
     cleanup_events = ((event_count_ % kEventsCheckpoint) == 0U);
@@ -199,6 +593,12 @@ Status EventSubscriberPlugin::generateEventDataIndex() {
   return generateEventDataIndex(context, getOsqueryDatabase());
 }
 
+void EventSubscriberPlugin::waitForEventIndex() const {
+  if (event_index_loaded_.valid()) {
+    event_index_loaded_.wait();
+  }
+}
+
 EventID EventSubscriberPlugin::getEventID() {
   return generateEventIdentifier(context);
 }
@@ -212,12 +612,24 @@ size_t EventSubscriberPlugin::getEventBatchesMax() {
 }
 
 void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
+  // Rows counted over a window that ended are stored before being read.
+  auto status = flushRollup(false);
+  if (!status.ok()) {
+    VLOG(1) << "Failed to store the event rollup of " << getName() << ": "
+            << status.getMessage();
+  }
+
+  // Events stored before startup are selected once they are indexed.
+  waitForEventIndex();
+
   // Stop is an unsigned (-1), our end of time equivalent.
   EventTime start = 0, stop = 0;
   if (context.constraints["time"].getAll().size() > 0) {
     // Use the 'time' constraint to optimize backing-store lookups.
     for (const auto& constraint : context.constraints["time"].getAll()) {
-      EventTime expr = timeFromRecord(constraint.expr);
+      long long value = 0;
+      constraint.getValue(value);
+      auto expr = static_cast<EventTime>(value);
       if (constraint.op == EQUALS) {
         stop = start = expr;
         break;
@@ -257,8 +669,16 @@ void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
     yield(TableRowHolder(new DynamicTableRow(std::move(row))));
   };
 
-  generateRows(
-      this->context, getOsqueryDatabase(), generateRowsCallback, start, stop);
+  // The event index is ordered by time, SQLite may skip its sort.
+  bool descending = false;
+  context.isOrderedBy("time", descending);
+  generateRows(this->context,
+               getOsqueryDatabase(),
+               generateRowsCallback,
+               start,
+               stop,
+               descending,
+               context.limit ? *context.limit : 0U);
 
   if (FLAGS_events_optimize) {
     setOptimizeData(getOsqueryDatabase(), optimize_time_, optimize_eid_);
@@ -275,6 +695,23 @@ EventContextID EventSubscriberPlugin::numEvents() const {
   return event_count_;
 }
 
+size_t EventSubscriberPlugin::numDroppedEvents() const {
+  return event_queue_.dropped;
+}
+
+size_t EventSubscriberPlugin::numQueuedEvents() {
+  std::lock_guard<std::mutex> lock(event_queue_.mutex);
+  return event_queue_.rows;
+}
+
+size_t EventSubscriberPlugin::numLimitedEvents() const {
+  return limits_.limited;
+}
+
+size_t EventSubscriberPlugin::numSampledOutEvents() const {
+  return limits_.sampled_out;
+}
+
 bool EventSubscriberPlugin::executedAllQueries() const {
   ReadLock lock(event_query_record_);
   return queries_.size() >= query_count_;
@@ -299,11 +736,10 @@ void EventSubscriberPlugin::setOptimizeData(IDatabaseInterface& db_interface,
     return;
   }
 
-  db_interface.setDatabaseValue(
-      kEvents, "optimize." + query_name, std::to_string(time));
-
-  db_interface.setDatabaseValue(
-      kEvents, "optimize_eid." + query_name, toIndex(eid));
+  db_interface.setDatabaseBatch(
+      kEvents,
+      {{"optimize." + query_name, std::to_string(time)},
+       {"optimize_eid." + query_name, toIndex(eid)}});
 }
 
 EventTime EventSubscriberPlugin::timeFromRecord(const std::string& record) {
@@ -360,6 +796,11 @@ Status EventSubscriberPlugin::generateEventDataIndex(
     return status;
   }
 
+  status = loadRowSchemas(context, db_interface);
+  if (!status.ok()) {
+    return status;
+  }
+
   std::vector<std::string> invalid_data_key_list;
   std::size_t event_count{0U};
 
@@ -396,7 +837,7 @@ Status EventSubscriberPlugin::generateEventDataIndex(
       }
 
       Row row;
-      if (!deserializeRowJSON(serialized_row, row)) {
+      if (!deserializeEventRow(context, serialized_row, row)) {
         invalid_data_key_list.push_back(key);
         continue;
       }
@@ -409,15 +850,7 @@ Status EventSubscriberPlugin::generateEventDataIndex(
       event_time = boost::lexical_cast<EventTime>(row.at("time"));
     }
 
-    auto it = event_index.find(event_time);
-    if (it == event_index.end()) {
-      auto insert_status = event_index.insert({event_time, {}});
-      it = insert_status.first;
-    }
-
-    auto& event_id_list = it->second;
-    event_id_list.push_back(event_identifier);
-
+    event_index.add(event_time, event_identifier);
     ++event_count;
   }
 
@@ -453,6 +886,125 @@ std::string EventSubscriberPlugin::databaseKeyForEventId(Context& context,
          string_event_id;
 }
 
+std::string EventSubscriberPlugin::databaseKeyForRowSchema(Context& context,
+                                                           RowSchemaID id) {
+  return std::string("schema.") + context.database_namespace + "." +
+         std::to_string(id);
+}
+
+Status EventSubscriberPlugin::loadRowSchemas(Context& context,
+                                             IDatabaseInterface& db_interface) {
+  std::vector<std::string> key_list;
+
+  std::string prefix = "schema." + context.database_namespace + ".";
+  auto status = db_interface.scanDatabaseKeys(kEvents, key_list, prefix, 0);
+  if (!status.ok()) {
+    return status;
+  }
+
+  WriteLock lock(context.row_schemas_mutex);
+  context.row_schemas.clear();
+  for (const auto& key : key_list) {
+    auto id = tryTo<RowSchemaID>(key.substr(prefix.size()));
+    if (id.isError()) {
+      continue;
+    }
+
+    std::string stored;
+    status = db_interface.getDatabaseValue(kEvents, key, stored);
+    if (status.ok()) {
+      context.row_schemas.addSchema(id.get(), deserializeRowSchema(stored));
+    }
+  }
+  return Status::success();
+}
+
+Status EventSubscriberPlugin::serializeEventRow(
+    Context& context,
+    const Row& row,
+    std::string& serialized_row,
+    std::pair<std::string, std::string>& new_schema) {
+  WriteLock lock(context.row_schemas_mutex);
+
+  bool added = false;
+  auto id = context.row_schemas.getID(row, added);
+  const auto& schema = *context.row_schemas.getSchema(id);
+  if (added) {
+    new_schema = std::make_pair(databaseKeyForRowSchema(context, id),
+                                serializeRowSchema(schema));
+  }
+  return serializeRowBinary(row, id, schema, serialized_row);
+}
+
+Status EventSubscriberPlugin::deserializeEventRow(
+    const Context& context, const std::string& serialized_row, Row& row) {
+  if (!isBinaryRow(serialized_row)) {
+    // Events stored before the binary encoding are JSON objects.
+    return deserializeRowJSON(serialized_row, row);
+  }
+
+  RowSchemaID id{0};
+  auto status = getRowBinarySchema(serialized_row, id);
+  if (!status.ok()) {
+    return status;
+  }
+
+  ReadLock lock(context.row_schemas_mutex);
+  const auto* schema = context.row_schemas.getSchema(id);
+  if (schema == nullptr) {
+    return Status::failure("Unknown event row schema: " + std::to_string(id));
+  }
+  return deserializeRowBinary(serialized_row, *schema, row);
+}
+
+std::size_t EventSubscriberPlugin::deleteEventBatches(
+    Context& context,
+    IDatabaseInterface& db_interface,
+    const EventIndex& event_batch_list) {
+  std::vector<EventIDRange> range_list;
+  for (const auto& batch : event_batch_list) {
+    for (std::size_t i = 0U; i < batch.rangeCount(); ++i) {
+      range_list.push_back(batch.range(i));
+    }
+  }
+
+  std::sort(range_list.begin(),
+            range_list.end(),
+            [](const EventIDRange& lhs, const EventIDRange& rhs) {
+              return lhs.first < rhs.first;
+            });
+
+  std::size_t error_count{};
+  for (std::size_t i = 0U; i < range_list.size();) {
+    // Merge the ranges that continue the one starting at i.
+    auto run = range_list[i];
+    auto run_end = i + 1U;
+    while (run_end < range_list.size() &&
+           range_list[run_end].first <= run.last + 1U) {
+      run.last = std::max(run.last, range_list[run_end].last);
+      ++run_end;
+    }
+
+    auto low_key = databaseKeyForEventId(context, run.first);
+
+    Status status;
+    if (run.first == run.last) {
+      status = db_interface.deleteDatabaseValue(kEvents, low_key);
+    } else {
+      auto high_key = databaseKeyForEventId(context, run.last);
+      status = db_interface.deleteDatabaseRange(kEvents, low_key, high_key);
+    }
+
+    if (!status.ok()) {
+      error_count += run.size();
+    }
+
+    i = run_end;
+  }
+
+  return error_count;
+}
+
 void EventSubscriberPlugin::removeOverflowingEventBatches(
     Context& context,
     IDatabaseInterface& db_interface,
@@ -470,13 +1022,8 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     }
 
     auto batches_to_remove = context.event_index.size() - max_event_batches;
-    auto range_start = context.event_index.begin();
-    auto range_end = std::next(range_start, batches_to_remove);
-
-    excess_event_batch_list.insert(std::make_move_iterator(range_start),
-                                   std::make_move_iterator(range_end));
-
-    context.event_index.erase(range_start, range_end);
+    excess_event_batch_list =
+        context.event_index.removeOldest(batches_to_remove);
   }
 
   if (excess_event_batch_list.empty()) {
@@ -499,23 +1046,11 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     string_last_query_time = buffer.data();
   }
 
-  std::size_t batches_removed{};
-  for (const auto& p : excess_event_batch_list) {
-    const auto& event_identifier_list = p.second;
-
-    for (auto event_id : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_id);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (status.ok()) {
-        ++batches_removed;
-      }
-    }
-  }
-
-  auto failed_delete_count = (excess_event_batch_list.size() - batches_removed);
+  auto failed_delete_count =
+      deleteEventBatches(context, db_interface, excess_event_batch_list);
 
   std::stringstream message;
-  message << "Removed " << batches_removed << " event batches ";
+  message << "Removed " << excess_event_batch_list.size() << " event batches ";
 
   if (failed_delete_count > 0U) {
     message << "(with " << failed_delete_count << " delete errors)  ";
@@ -546,34 +1081,17 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
 
     auto oldest_valid_time = current_time - events_expiry;
 
-    auto oldest_event_time = context.event_index.begin()->first;
+    auto oldest_event_time = context.event_index.begin()->time();
     if (oldest_event_time >= oldest_valid_time) {
       return;
     }
 
-    auto range_start = context.event_index.begin();
-    auto range_end = context.event_index.upper_bound(oldest_valid_time);
-
-    expired_event_batch_list.insert(std::make_move_iterator(range_start),
-                                    std::make_move_iterator(range_end));
-
-    context.event_index.erase(range_start, range_end);
+    expired_event_batch_list =
+        context.event_index.removeUntil(oldest_valid_time);
   }
 
-  // TODO(alessandro): Implement deleteDatabaseBatch
-  std::size_t error_count{};
-
-  for (const auto& p : expired_event_batch_list) {
-    const auto& event_identifier_list = p.second;
-
-    for (const auto& event_identifier : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_identifier);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (!status.ok()) {
-        ++error_count;
-      }
-    }
-  }
+  auto error_count =
+      deleteEventBatches(context, db_interface, expired_event_batch_list);
 
   if (error_count > 0U) {
     LOG(ERROR) << "Failed to expire " << error_count
@@ -585,17 +1103,19 @@ void EventSubscriberPlugin::generateRows(Context& context,
                                          IDatabaseInterface& db_interface,
                                          std::function<void(Row)> callback,
                                          EventTime start_time,
-                                         EventTime end_time) {
+                                         EventTime end_time,
+                                         bool descending,
+                                         std::size_t max_rows) {
   if (end_time != 0 && start_time > end_time) {
     return;
   }
 
-  EventIndex::iterator lower_bound_it;
+  EventIndex::const_iterator lower_bound_it;
   if (start_time == 0U) {
     lower_bound_it = context.event_index.begin();
 
   } else {
-    lower_bound_it = context.event_index.lower_bound(start_time);
+    lower_bound_it = context.event_index.lowerBound(start_time);
     if (lower_bound_it == context.event_index.end()) {
       return;
     }
@@ -603,34 +1123,97 @@ void EventSubscriberPlugin::generateRows(Context& context,
 
   auto upper_bound_it = (end_time == 0U)
                             ? context.event_index.end()
-                            : context.event_index.upper_bound(end_time);
+                            : context.event_index.upperBound(end_time);
 
   std::vector<std::string> invalid_key_list;
 
-  for (auto it = lower_bound_it; it != upper_bound_it; ++it) {
-    const auto& event_id_list = it->second;
+  std::vector<std::string> key_list;
+  std::vector<std::string> value_list;
+  key_list.reserve(kEventsBatchReadSize);
 
-    for (const auto& event_identifier : event_id_list) {
-      auto key = databaseKeyForEventId(context, event_identifier);
+  std::size_t emitted_row_count{0U};
+  auto L_LimitReached = [&]() -> bool {
+    return max_rows != 0U && emitted_row_count >= max_rows;
+  };
 
-      std::string serialized_row;
-      auto status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
+  auto L_FlushKeyList = [&]() {
+    auto status = db_interface.getDatabaseValues(kEvents, key_list, value_list);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to read event rows: " << status.getMessage();
+      key_list.clear();
+      return;
+    }
+
+    for (std::size_t i = 0U; i < key_list.size(); ++i) {
+      const auto& serialized_row = value_list[i];
       if (serialized_row.empty()) {
-        invalid_key_list.push_back(key);
+        invalid_key_list.push_back(std::move(key_list[i]));
         continue;
       }
 
       Row row = {};
-      status = deserializeRowJSON(serialized_row, row);
+      status = deserializeEventRow(context, serialized_row, row);
       if (!status.ok()) {
-        invalid_key_list.push_back(key);
+        invalid_key_list.push_back(std::move(key_list[i]));
         continue;
       }
 
       callback(std::move(row));
+      ++emitted_row_count;
+      if (L_LimitReached()) {
+        break;
+      }
+    }
+
+    key_list.clear();
+  };
+
+  auto L_AddEvent = [&](EventID event_identifier) {
+    key_list.push_back(databaseKeyForEventId(context, event_identifier));
+
+    // Avoid reading more events than the caller may still accept.
+    auto batch_size = kEventsBatchReadSize;
+    if (max_rows != 0U) {
+      batch_size = std::min(batch_size, max_rows - emitted_row_count);
+    }
+
+    if (key_list.size() >= batch_size) {
+      L_FlushKeyList();
+    }
+  };
+
+  if (!descending) {
+    for (auto it = lower_bound_it; it != upper_bound_it && !L_LimitReached();
+         ++it) {
+      for (std::size_t i = 0U; i < it->rangeCount() && !L_LimitReached();
+           ++i) {
+        const auto& range = it->range(i);
+        for (auto id = range.first; id <= range.last && !L_LimitReached();
+             ++id) {
+          L_AddEvent(id);
+        }
+      }
+    }
+
+  } else {
+    for (auto it = EventIndex::const_reverse_iterator(upper_bound_it);
+         it != EventIndex::const_reverse_iterator(lower_bound_it) &&
+         !L_LimitReached();
+         ++it) {
+      for (auto i = it->rangeCount(); i > 0U && !L_LimitReached(); --i) {
+        const auto& range = it->range(i - 1U);
+        for (auto id = range.last + 1U; id > range.first && !L_LimitReached();
+             --id) {
+          L_AddEvent(id - 1U);
+        }
+      }
     }
   }
 
+  if (!key_list.empty()) {
+    L_FlushKeyList();
+  }
+
   if (!invalid_key_list.empty()) {
     std::size_t erased_key_count{0U};
 
@@ -667,13 +1250,25 @@ void EventSubscriberPlugin::removeSubscriptions() {
 
 Status EventSubscriberPlugin::setUp() {
   setDatabaseNamespace(context, getType(), getName());
-  generateEventDataIndex();
 
-  expireEventBatches(
-      context, getOsqueryDatabase(), getEventsExpiry(), getUnixTime());
+  auto events_expiry = getEventsExpiry();
+  auto event_batches_max = getEventBatchesMax();
+  auto load_index = [this, events_expiry, event_batches_max]() {
+    generateEventDataIndex();
+
+    expireEventBatches(
+        context, getOsqueryDatabase(), events_expiry, getUnixTime());
+
+    removeOverflowingEventBatches(
+        context, getOsqueryDatabase(), event_batches_max);
+  };
 
-  removeOverflowingEventBatches(
-      context, getOsqueryDatabase(), getEventBatchesMax());
+  if (FLAGS_lazy_startup) {
+    // New events and queries wait for the index, startup does not.
+    event_index_loaded_ = std::async(std::launch::async, load_index).share();
+  } else {
+    load_index();
+  }
 
   return Status::success();
 }
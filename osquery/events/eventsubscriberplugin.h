@@ -9,13 +9,24 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
 #include <gtest/gtest_prod.h>
 
 #include <osquery/core/plugins/plugin.h>
+#include <osquery/core/sql/binary_row.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/events/eventer.h>
+#include <osquery/events/eventindex.h>
 #include <osquery/events/types.h>
+#include <osquery/utils/caches/clock.h>
 #include <osquery/utils/mutex.h>
 
 namespace osquery {
@@ -60,9 +71,20 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * The backing store data retrieval is optimized by time-based indexes. It
    * is important to added EventTime as it relates to "when the event occurred".
    *
+   * When --events_queue_max is set the rows are moved into a queue and
+   * stored by a worker of this subscriber, rather than on the publisher's
+   * thread. Rows that do not fit in a full queue are dropped and counted.
+   *
+   * When the subscriber is listed in --events_rollup, equal rows are counted
+   * over a window of --events_rollup_window seconds and each distinct row is
+   * stored once the window ends, with its count and last event time.
+   *
+   * Rows beyond the --events_rate_limit of the subscriber, or not kept by its
+   * --events_sample, are dropped and counted first.
+   *
    * @param row_list A (writable) vector of osquery Row elements.
    *
-   * @return Was the element added to the backing store.
+   * @return Was the element added to the backing store, or queue.
    */
   Status addBatch(std::vector<Row>& row_list);
 
@@ -74,6 +96,33 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Scans the database to enumerate all the data keys and build a new index
   Status generateEventDataIndex();
 
+  /// Wait for the stored events indexed in the background, if any.
+  void waitForEventIndex() const;
+
+  /// Start the worker storing queued rows, if --events_queue_max is set.
+  static void startEventQueue(const EventSubscriberRef& subscriber);
+
+  /// Wait briefly for queued rows, then store them.
+  void storeQueuedEvents();
+
+  /// Queue the rows, or store them if there is no storage worker.
+  Status queueBatch(std::vector<Row>& row_list, EventTime event_time);
+
+  /// Apply --events_rollup and --events_rollup_ignore to this subscriber.
+  void configureRollup();
+
+  /// Count the rows in the current rollup window, storing the previous one.
+  Status rollupBatch(std::vector<Row>& row_list);
+
+  /// Store the rows of the rollup window if it ended, or if forced.
+  Status flushRollup(bool force);
+
+  /// Apply --events_rate_limit, --events_sample and --events_limit_key.
+  void configureLimits();
+
+  /// Remove the rows beyond the rate limit or not kept by sampling.
+  void limitBatch(std::vector<Row>& row_list);
+
   /**
    * @brief Get a unique storage-related EventID.
    *
@@ -143,6 +192,18 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// The number of events this EventSubscriber has received.
   EventContextID numEvents() const;
 
+  /// The number of events dropped because the storage queue was full.
+  size_t numDroppedEvents() const;
+
+  /// The number of rows queued for storage.
+  size_t numQueuedEvents();
+
+  /// The number of events dropped by the rate limit of this subscriber.
+  size_t numLimitedEvents() const;
+
+  /// The number of events not kept by the sampling of this subscriber.
+  size_t numSampledOutEvents() const;
+
   /// Compare the number of queries run against the queries configured.
   bool executedAllQueries() const;
 
@@ -153,6 +214,10 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
     std::size_t last_query_time{0U};
     std::atomic<EventID> last_event_id{0U};
+
+    /// Column name sets of the binary encoded events for this subscriber.
+    RowSchemaCatalog row_schemas;
+    mutable Mutex row_schemas_mutex;
   };
 
   static std::string toIndex(std::uint64_t i);
@@ -179,6 +244,45 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
   static std::string databaseKeyForEventId(Context& context, EventID event_id);
 
+  static std::string databaseKeyForRowSchema(Context& context, RowSchemaID id);
+
+  /// Restore the persisted binary row schemas for this subscriber.
+  static Status loadRowSchemas(Context& context,
+                               IDatabaseInterface& db_interface);
+
+  /**
+   * @brief Encode an event row for storage.
+   *
+   * @param context the subscriber context owning the schema catalog.
+   * @param row the event row.
+   * @param serialized_row [output] the binary encoding.
+   * @param new_schema [output] a (key, value) pair to persist if a new schema
+   * was assigned, otherwise left empty.
+   */
+  static Status serializeEventRow(
+      Context& context,
+      const Row& row,
+      std::string& serialized_row,
+      std::pair<std::string, std::string>& new_schema);
+
+  /// Decode a stored event row, either binary or legacy JSON encoded.
+  static Status deserializeEventRow(const Context& context,
+                                    const std::string& serialized_row,
+                                    Row& row);
+
+  /**
+   * @brief Delete the stored rows of events removed from the index.
+   *
+   * Event identifiers are allocated sequentially, so expired events are
+   * mostly contiguous key ranges which are deleted with a single range
+   * removal.
+   *
+   * @return the number of events that could not be deleted.
+   */
+  static std::size_t deleteEventBatches(Context& context,
+                                        IDatabaseInterface& db_interface,
+                                        const EventIndex& event_batch_list);
+
   static void removeOverflowingEventBatches(Context& context,
                                             IDatabaseInterface& db_interface,
                                             std::size_t max_event_batches);
@@ -196,6 +300,8 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param yield The Row yield method.
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
+   * @param descending Emit the newest events first.
+   * @param max_rows Stop after emitting this many rows, 0 for no limit.
    * @return Set of event rows matching time limits.
    */
 
@@ -203,7 +309,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
                            IDatabaseInterface& db_interface,
                            std::function<void(Row)> callback,
                            EventTime start_time,
-                           EventTime end_time);
+                           EventTime end_time,
+                           bool descending = false,
+                           std::size_t max_rows = 0U);
 
   explicit EventSubscriberPlugin(EventSubscriberPlugin const&) = delete;
   EventSubscriberPlugin& operator=(EventSubscriberPlugin const&) = delete;
@@ -280,8 +388,99 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Lock used when recording queries executing against this subscriber.
   mutable Mutex event_query_record_;
 
+  /// Rows waiting for the storage worker, batched with their event time.
+  struct EventQueue final {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::pair<EventTime, std::vector<Row>>> batches;
+
+    /// The number of rows in batches.
+    size_t rows{0};
+
+    /// Rows dropped while the queue was full.
+    std::atomic<size_t> dropped{0};
+
+    /// Set once the storage worker is started, rows are queued from then on.
+    std::atomic<bool> enabled{false};
+  };
+
+  EventQueue event_queue_;
+
+  /// Distinct rows counted over the current window, for --events_rollup.
+  struct EventRollup final {
+    struct Entry final {
+      Row row;
+      size_t count{0};
+      EventTime first_time{0};
+      EventTime last_time{0};
+    };
+
+    std::mutex mutex;
+
+    /// Rows by their columns and values.
+    std::unordered_map<std::string, Entry> entries;
+
+    /// The time of the first row of the window.
+    EventTime window_start{0};
+
+    /// Columns removed from rows before they are compared.
+    std::vector<std::string> ignored_columns;
+
+    /// Set when the subscriber is listed in --events_rollup.
+    std::atomic<bool> enabled{false};
+  };
+
+  EventRollup rollup_;
+
+  /// Store the rows of an ended rollup window, with their counts.
+  Status storeRollup(
+      std::unordered_map<std::string, EventRollup::Entry>& ended_window);
+
+  /// Rate limit and sampling of the rows, for --events_rate_limit and
+  /// --events_sample, per subscriber or per value of a --events_limit_key.
+  struct EventLimits final {
+    /// A token bucket and the count of events seen, to sample them.
+    struct State final {
+      double tokens{0};
+      std::chrono::steady_clock::time_point refill_time;
+      size_t seen{0};
+    };
+
+    std::mutex mutex;
+
+    /// Rows per second, and the max rows in a burst. A rate of 0 is no limit.
+    size_t rate{0};
+    size_t burst{0};
+
+    /// Keep one of every sample rows.
+    size_t sample{1};
+
+    /// The column whose values are limited separately, if any.
+    std::string key_column;
+
+    /// The state of the subscriber, without a key column.
+    State state;
+
+    /// The state of the most recently seen key values.
+    caches::Clock<std::string, State> key_states{4096};
+
+    /// Rows dropped by the rate limit.
+    std::atomic<size_t> limited{0};
+
+    /// Rows not kept by sampling.
+    std::atomic<size_t> sampled_out{0};
+
+    /// Set if a rate limit or sampling applies to this subscriber.
+    std::atomic<bool> enabled{false};
+  };
+
+  EventLimits limits_;
+
   Context context;
 
+  /// Indexes the stored events after startup, if --lazy_startup is set.
+  std::shared_future<void> event_index_loaded_;
+
   /**
    * @brief Allow subscriber implementations to default disable themselves.
    *
@@ -297,9 +496,14 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
   friend class EventFactory;
   friend class EventPublisherPlugin;
+  friend class EventQueueRunner;
 
   FRIEND_TEST(EventsTests, test_event_subscriber_configure);
   FRIEND_TEST(EventsTests, test_event_toggle_subscribers);
+  FRIEND_TEST(EventsTests, test_event_queue);
+  FRIEND_TEST(EventsTests, test_event_rollup);
+  FRIEND_TEST(EventsTests, test_event_limits);
+  FRIEND_TEST(EventsTests, test_event_streaming);
 
   friend class DBFakeEventSubscriber;
   friend class BenchmarkEventSubscriber;
@@ -13,4 +13,10 @@ namespace osquery {
 
 FLAG(bool, enable_file_events, false, "Enables the file_events publisher");
 
+FLAG(bool,
+     file_events_fanotify,
+     false,
+     "Use fanotify filesystem marks instead of inotify watches for "
+     "file_events (Linux 5.9+)");
+
 } // namespace osquery
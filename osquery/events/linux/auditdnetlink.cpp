@@ -12,8 +12,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 #include <boost/utility/string_ref.hpp>
 
@@ -55,6 +58,12 @@ FLAG(int32, audit_backlog_wait_time, 0, "The audit backlog wait time");
 /// This value is passed directly to the audit API.
 FLAG(int32, audit_backlog_limit, 4096, "The audit backlog limit");
 
+/// Records are partitioned across parsers by audit event serial.
+FLAG(uint32,
+     audit_parser_threads,
+     2,
+     "Number of threads parsing audit records (default 2)");
+
 // External flags; they are used to determine which rules need to be installed
 DECLARE_bool(audit_allow_config);
 DECLARE_bool(audit_allow_fim_events);
@@ -125,13 +134,17 @@ enum AuditStatus {
 
 AuditdNetlink::AuditdNetlink() {
   try {
-    auditd_context_ = std::make_shared<AuditdContext>();
+    auto partition_count =
+        static_cast<std::size_t>(std::max(FLAGS_audit_parser_threads, 1U));
+    auditd_context_ = std::make_shared<AuditdContext>(partition_count);
 
     Dispatcher::addService(
         std::make_shared<AuditdNetlinkReader>(auditd_context_));
 
-    Dispatcher::addService(
-        std::make_shared<AuditdNetlinkParser>(auditd_context_));
+    for (std::size_t i = 0; i < partition_count; i++) {
+      Dispatcher::addService(
+          std::make_shared<AuditdNetlinkParser>(auditd_context_, i));
+    }
 
   } catch (const std::bad_alloc&) {
     VLOG(1) << "Failed to initialize the AuditdNetlink services due to a "
@@ -140,18 +153,58 @@ AuditdNetlink::AuditdNetlink() {
   }
 }
 
+AuditdContext::AuditdContext(std::size_t partition_count) {
+  partitions.reserve(partition_count);
+  for (std::size_t i = 0; i < partition_count; i++) {
+    partitions.push_back(std::make_unique<AuditdPartition>());
+  }
+}
+
+void AuditdContext::notifyParser(AuditdPartition& partition) {
+  // Taking the mutex orders the push before a sleeping parser's empty check
+  { std::lock_guard<std::mutex> lock(partition.unprocessed_records_mutex); }
+  partition.unprocessed_records_cv.notify_one();
+}
+
+void AuditdContext::notifyPublisher() {
+  { std::lock_guard<std::mutex> lock(processed_events_mutex); }
+  processed_records_cv.notify_one();
+}
+
 std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
-  std::vector<AuditEventRecord> record_list;
+  auto l_hasEvents = [this]() -> bool {
+    for (const auto& partition : auditd_context_->partitions) {
+      if (!partition->processed_events.empty()) {
+        return true;
+      }
+    }
+    return false;
+  };
 
   {
     std::unique_lock<std::mutex> queue_lock(
         auditd_context_->processed_events_mutex);
 
-    if (auditd_context_->processed_records_cv.wait_for(
-            queue_lock, std::chrono::seconds(1)) ==
-        std::cv_status::no_timeout) {
-      record_list = std::move(auditd_context_->processed_events);
-      auditd_context_->processed_events.clear();
+    if (!auditd_context_->processed_records_cv.wait_for(
+            queue_lock, std::chrono::seconds(1), l_hasEvents)) {
+      return {};
+    }
+  }
+
+  // The records of an event are all in one partition, in order; events of
+  // different partitions may interleave
+  std::vector<AuditEventRecord> record_list;
+  std::vector<AuditEventRecord> batch;
+  for (auto& partition : auditd_context_->partitions) {
+    while (partition->processed_events.pop(batch)) {
+      if (record_list.empty()) {
+        record_list = std::move(batch);
+      } else {
+        record_list.insert(record_list.end(),
+                           std::make_move_iterator(batch.begin()),
+                           std::make_move_iterator(batch.end()));
+      }
+      batch.clear();
     }
   }
 
@@ -161,7 +214,36 @@ std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
 AuditdNetlinkReader::AuditdNetlinkReader(AuditdContextRef context)
     : InternalRunnable("AuditdNetlinkReader"),
       auditd_context_(std::move(context)),
-      read_buffer_(4096U) {}
+      read_buffer_(4096U),
+      pending_records_(auditd_context_->partitions.size()) {}
+
+std::uint64_t AuditdNetlinkReader::GetAuditSerial(
+    const audit_reply& reply) noexcept {
+  // The message starts with the event id: audit(1501323932.710:7670542):
+  auto length = std::min(static_cast<std::size_t>(reply.msg.nlh.nlmsg_len),
+                         sizeof(reply.msg.data));
+  boost::string_ref message_view(reply.msg.data, length);
+  if (!message_view.starts_with("audit(")) {
+    return 0U;
+  }
+
+  auto id_end = message_view.find(')');
+  auto serial_start = message_view.find(':');
+  if (id_end == boost::string_ref::npos || serial_start >= id_end) {
+    return 0U;
+  }
+
+  std::uint64_t serial = 0U;
+  for (auto i = serial_start + 1; i < id_end; i++) {
+    auto c = message_view[i];
+    if (c < '0' || c > '9') {
+      return 0U;
+    }
+    serial = serial * 10U + static_cast<std::uint64_t>(c - '0');
+  }
+
+  return serial;
+}
 
 void AuditdNetlinkReader::start() {
   int counter_to_next_status_request = 0;
@@ -209,6 +291,8 @@ void AuditdNetlinkReader::start() {
     if (!acquireMessages()) {
       auditd_context_->acquire_handle = true;
     }
+
+    queuePendingRecords();
   }
 }
 
@@ -219,7 +303,9 @@ void AuditdNetlinkReader::stop() {
 
   VLOG(1) << "Releasing the audit handle...";
 
-  auditd_context_->unprocessed_records_cv.notify_all();
+  for (auto& partition : auditd_context_->partitions) {
+    partition->unprocessed_records_cv.notify_all();
+  }
 
   if (FLAGS_audit_allow_config) {
     restoreAuditServiceConfiguration();
@@ -302,19 +388,10 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
     read_buffer_[events_received] = reply;
   }
 
-  if (events_received != 0) {
-    std::unique_lock<std::mutex> lock(
-        auditd_context_->unprocessed_records_mutex);
-
-    auditd_context_->unprocessed_records.reserve(
-        auditd_context_->unprocessed_records.size() + events_received);
-
-    auditd_context_->unprocessed_records.insert(
-        auditd_context_->unprocessed_records.end(),
-        read_buffer_.begin(),
-        std::next(read_buffer_.begin(), events_received));
-
-    auditd_context_->unprocessed_records_cv.notify_all();
+  for (size_t i = 0; i < events_received; i++) {
+    const auto& reply = read_buffer_[i];
+    auto partition = GetAuditSerial(reply) % pending_records_.size();
+    pending_records_[partition].push_back(reply);
   }
 
   if (reset_handle) {
@@ -325,6 +402,23 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
   return true;
 }
 
+void AuditdNetlinkReader::queuePendingRecords() {
+  for (std::size_t i = 0; i < pending_records_.size(); i++) {
+    auto& pending = pending_records_[i];
+    if (pending.empty()) {
+      continue;
+    }
+
+    // A parser behind on a burst leaves its records pending here, they are
+    // retried after the next read rather than dropped
+    auto& partition = *auditd_context_->partitions[i];
+    if (partition.unprocessed_records.push(pending)) {
+      pending.clear();
+      auditd_context_->notifyParser(partition);
+    }
+  }
+}
+
 bool AuditdNetlinkReader::configureAuditService() noexcept {
   VLOG(1) << "Attempting to configure the audit service";
 
@@ -683,29 +777,134 @@ NetlinkStatus AuditdNetlinkReader::acquireHandle() noexcept {
   return NetlinkStatus::ActiveMutable;
 }
 
-AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context)
+void AuditFieldMap::parse(boost::string_ref message) {
+  message_ = std::make_shared<const std::string>(message.to_string());
+  fields_.clear();
+
+  // There are several ways of representing value data (enclosed strings,
+  // etc). Every key and value is a contiguous range of the message.
+  const auto& text = *message_;
+  std::size_t key_begin{0U};
+  std::size_t key_end{0U};
+  std::size_t value_begin{0U};
+  bool found_assignment{false};
+  bool found_enclose{false};
+
+  auto l_addField = [&](std::size_t value_end) {
+    if (key_end == key_begin) {
+      return;
+    }
+
+    Field field;
+    field.first =
+        boost::string_ref(text.data() + key_begin, key_end - key_begin);
+    if (found_assignment) {
+      field.second = boost::string_ref(text.data() + value_begin,
+                                       value_end - value_begin);
+    }
+    fields_.push_back(field);
+  };
+
+  for (std::size_t i = 0; i < text.size(); i++) {
+    // Iterate over each character in the audit message.
+    auto c = text[i];
+    if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
+      // This is a terminating sequence, the end of an enclosure or space
+      // tok. Multiple space tokens are supported.
+      l_addField((c == '"') ? i + 1 : i);
+
+      found_enclose = false;
+      found_assignment = false;
+      key_begin = key_end = i + 1;
+
+    } else if (found_assignment) {
+      // Enclosure sequences appear immediately following assignment.
+      if (c == '"') {
+        found_enclose = true;
+      }
+
+    } else if (c == '=') {
+      found_assignment = true;
+      value_begin = i + 1;
+
+    } else {
+      key_end = i + 1;
+    }
+  }
+
+  // Last step, if there was no trailing tokenizer.
+  l_addField(text.size());
+
+  // Lookups are binary searches; as with a map, the first duplicate is kept
+  std::stable_sort(
+      fields_.begin(), fields_.end(), [](const Field& a, const Field& b) {
+        return a.first < b.first;
+      });
+
+  auto last = std::unique(
+      fields_.begin(), fields_.end(), [](const Field& a, const Field& b) {
+        return a.first == b.first;
+      });
+  fields_.erase(last, fields_.end());
+}
+
+AuditFieldMap::const_iterator AuditFieldMap::find(
+    boost::string_ref key) const {
+  auto it = std::lower_bound(fields_.begin(),
+                             fields_.end(),
+                             key,
+                             [](const Field& a, boost::string_ref b) {
+                               return a.first < b;
+                             });
+
+  return (it != fields_.end() && it->first == key) ? it : fields_.end();
+}
+
+boost::string_ref AuditFieldMap::at(boost::string_ref key) const {
+  auto it = find(key);
+  if (it == end()) {
+    throw std::out_of_range("Missing audit record field: " + key.to_string());
+  }
+
+  return it->second;
+}
+
+AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context,
+                                         std::size_t partition)
     : InternalRunnable("AuditdNetlinkParser"),
-      auditd_context_(std::move(context)) {}
+      auditd_context_(std::move(context)),
+      partition_(partition) {}
 
 void AuditdNetlinkParser::start() {
+  auto& partition = *auditd_context_->partitions.at(partition_);
+
+  std::vector<audit_reply> queue;
+  std::vector<AuditEventRecord> audit_event_record_queue;
+
   while (!interrupted()) {
-    std::vector<audit_reply> queue;
+    // Save the new records and notify the publisher; when its queue is full
+    // the records are kept and handed over with the next batch
+    if (!audit_event_record_queue.empty() &&
+        partition.processed_events.push(audit_event_record_queue)) {
+      audit_event_record_queue.clear();
+      auditd_context_->notifyPublisher();
+    }
 
-    {
-      std::unique_lock<std::mutex> lock(
-          auditd_context_->unprocessed_records_mutex);
+    if (!partition.unprocessed_records.pop(queue)) {
+      auto timeout = audit_event_record_queue.empty()
+                         ? std::chrono::milliseconds(1000)
+                         : std::chrono::milliseconds(100);
 
-      while (auditd_context_->unprocessed_records.empty() && !interrupted()) {
-        auditd_context_->unprocessed_records_cv.wait_for(
-            lock, std::chrono::seconds(1));
-      }
+      std::unique_lock<std::mutex> lock(partition.unprocessed_records_mutex);
+      partition.unprocessed_records_cv.wait_for(lock, timeout, [&]() {
+        return !partition.unprocessed_records.empty() || interrupted();
+      });
 
-      queue = std::move(auditd_context_->unprocessed_records);
-      auditd_context_->unprocessed_records.clear();
+      continue;
     }
 
-    std::vector<AuditEventRecord> audit_event_record_queue;
-    audit_event_record_queue.reserve(queue.size());
+    audit_event_record_queue.reserve(audit_event_record_queue.size() +
+                                     queue.size());
 
     for (auto& reply : queue) {
       if (interrupted()) {
@@ -745,28 +944,10 @@ void AuditdNetlinkParser::start() {
         continue;
       }
 
-      audit_event_record_queue.push_back(audit_event_record);
-    }
-
-    // Save the new records and notify the reader
-    if (!audit_event_record_queue.empty()) {
-      std::lock_guard<std::mutex> queue_lock(
-          auditd_context_->processed_events_mutex);
-
-      auditd_context_->processed_events.reserve(
-          auditd_context_->processed_events.size() +
-          audit_event_record_queue.size());
-
-      auditd_context_->processed_events.insert(
-          auditd_context_->processed_events.end(),
-          audit_event_record_queue.begin(),
-          audit_event_record_queue.end());
-
-      auditd_context_->processed_records_cv.notify_all();
+      audit_event_record_queue.push_back(std::move(audit_event_record));
     }
 
     queue.clear();
-    audit_event_record_queue.clear();
   }
 }
 
@@ -804,65 +985,7 @@ bool AuditdNetlinkParser::ParseAuditReply(
     event_record.raw_data = reply.message;
   }
 
-  // Tokenize the message
-  boost::string_ref field_view(message_view.substr(preamble_end + 3));
-
-  // The linear search will construct series of key value pairs.
-  std::string key, value;
-  key.reserve(20);
-  value.reserve(256);
-
-  // There are several ways of representing value data (enclosed strings,
-  // etc).
-  bool found_assignment{false};
-  bool found_enclose{false};
-
-  for (const auto& c : field_view) {
-    // Iterate over each character in the audit message.
-    if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
-      if (c == '"') {
-        value += c;
-      }
-
-      // This is a terminating sequence, the end of an enclosure or space
-      // tok.
-      if (!key.empty()) {
-        // Multiple space tokens are supported.
-        event_record.fields.emplace(
-            std::make_pair(std::move(key), std::move(value)));
-      }
-
-      found_enclose = false;
-      found_assignment = false;
-
-      key.clear();
-      value.clear();
-
-    } else if (!found_assignment && c == ' ') {
-      // A field tokenizer.
-
-    } else if (found_assignment) {
-      // Enclosure sequences appear immediately following assignment.
-      if (c == '"') {
-        found_enclose = true;
-      }
-
-      value += c;
-
-    } else if (c == '=') {
-      found_assignment = true;
-
-    } else {
-      key += c;
-    }
-  }
-
-  // Last step, if there was no trailing tokenizer.
-  if (!key.empty()) {
-    event_record.fields.emplace(
-        std::make_pair(std::move(key), std::move(value)));
-  }
-
+  event_record.fields.parse(message_view.substr(preamble_end + 3));
   return true;
 }
 
@@ -16,13 +16,17 @@
 #include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <boost/algorithm/hex.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/events/linux/auditdqueue.h>
 
 namespace osquery {
 
@@ -32,6 +36,59 @@ enum class NetlinkStatus { ActiveMutable, ActiveImmutable, Disabled, Error };
 /// Contains an audit_rule_data structure
 using AuditRuleDataObject = std::vector<std::uint8_t>;
 
+/**
+ * @brief The key=value fields of an audit record.
+ *
+ * The fields are tokenized in place over a single copy of the message; keys
+ * and values are views into it, sorted by key. Copies of a record share the
+ * message, so neither parsing nor handing records over allocates per field.
+ */
+class AuditFieldMap final {
+ public:
+  struct Field final {
+    boost::string_ref first;
+    boost::string_ref second;
+  };
+
+  using const_iterator = std::vector<Field>::const_iterator;
+
+  /// Tokenizes the fields of a message, replacing the current ones
+  void parse(boost::string_ref message);
+
+  /// Returns the field with the given key, or end()
+  const_iterator find(boost::string_ref key) const;
+
+  /// Returns the value of the given key, throws std::out_of_range if missing
+  boost::string_ref at(boost::string_ref key) const;
+
+  std::size_t count(boost::string_ref key) const {
+    return (find(key) != end()) ? 1U : 0U;
+  }
+
+  const_iterator begin() const {
+    return fields_.begin();
+  }
+
+  const_iterator end() const {
+    return fields_.end();
+  }
+
+  std::size_t size() const {
+    return fields_.size();
+  }
+
+  bool empty() const {
+    return fields_.empty();
+  }
+
+ private:
+  /// The message the fields point into
+  std::shared_ptr<const std::string> message_;
+
+  /// Fields sorted by key; the first of duplicated keys is kept
+  std::vector<Field> fields_;
+};
+
 /// A single, prepared audit event record.
 struct AuditEventRecord final {
   /// Record type (i.e.: AUDIT_SYSCALL, AUDIT_PATH, ...)
@@ -45,7 +102,7 @@ struct AuditEventRecord final {
 
   /// The field list for this record. Valid for everything except SELinux and
   /// AppArmor records
-  std::map<std::string, std::string> fields;
+  AuditFieldMap fields;
 
   /// The raw message, only valid for SELinux and AppArmor records (because they
   /// have broken syntax)
@@ -55,28 +112,51 @@ struct AuditEventRecord final {
 static_assert(std::is_move_constructible<AuditEventRecord>::value,
               "not move constructible");
 
+/// The number of record batches each queue between the audit services holds
+const std::size_t kAuditdQueueBatches{64U};
+
+/**
+ * @brief The queues of a single parser.
+ *
+ * Records are partitioned by audit event serial, so every record of an event
+ * is parsed, in order, by the same parser.
+ */
+struct AuditdPartition final {
+  AuditdPartition()
+      : unprocessed_records(kAuditdQueueBatches),
+        processed_events(kAuditdQueueBatches) {}
+
+  /// Unprocessed audit records, from the reader
+  AuditdQueue<std::vector<audit_reply>> unprocessed_records;
+
+  /// Processed events, to the publisher
+  AuditdQueue<std::vector<AuditEventRecord>> processed_events;
+
+  /// Only used by the parser to sleep while the queue is empty
+  std::mutex unprocessed_records_mutex;
+
+  /// Used to wake up the parser when records are queued
+  std::condition_variable unprocessed_records_cv;
+};
+
 // This structure is used to share data between the reading and processing
 // services
 struct AuditdContext final {
-  /// Unprocessed audit records
-  std::vector<audit_reply> unprocessed_records;
-  static_assert(
-      std::is_move_constructible<decltype(unprocessed_records)>::value,
-      "not move constructible");
+  explicit AuditdContext(std::size_t partition_count);
 
-  /// Mutex for the list of unprocessed records
-  std::mutex unprocessed_records_mutex;
+  /// Wake up the parser of a partition after queueing records
+  void notifyParser(AuditdPartition& partition);
 
-  /// Processed events condition variable
-  std::condition_variable unprocessed_records_cv;
+  /// Wake up the publisher after queueing processed events
+  void notifyPublisher();
 
-  /// This queue contains processed events
-  std::vector<AuditEventRecord> processed_events;
+  /// One partition for each parser
+  std::vector<std::unique_ptr<AuditdPartition>> partitions;
 
-  /// Processed events queue mutex.
+  /// Only used by the publisher to sleep while there are no processed events
   std::mutex processed_events_mutex;
 
-  /// Used to wake up the thread that processes the raw audit records
+  /// Used to wake up the publisher when processed events are queued
   std::condition_variable processed_records_cv;
 
   /// When set to true, the audit handle is (re)acquired
@@ -90,6 +170,9 @@ class AuditdNetlinkReader final : public InternalRunnable {
  public:
   explicit AuditdNetlinkReader(AuditdContextRef context);
 
+  /// Returns the serial of the audit event owning a raw record, or 0
+  static std::uint64_t GetAuditSerial(const audit_reply& reply) noexcept;
+
  protected:
   virtual void start() override;
   virtual void stop() override;
@@ -113,6 +196,9 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// (Re)acquire the netlink handle.
   NetlinkStatus acquireHandle() noexcept;
 
+  /// Hands the pending records over to the parsers that have room for them
+  void queuePendingRecords();
+
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
@@ -120,6 +206,9 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// Read buffer used when receiving events from the netlink
   std::vector<audit_reply> read_buffer_;
 
+  /// Records waiting for room in the queue of each partition
+  std::vector<std::vector<audit_reply>> pending_records_;
+
   /// The set of rules we applied (and that we'll uninstall when exiting)
   std::vector<audit_rule_data> installed_rule_list_;
 
@@ -133,7 +222,7 @@ class AuditdNetlinkReader final : public InternalRunnable {
 /// This service parses the raw audit records
 class AuditdNetlinkParser final : public InternalRunnable {
  public:
-  explicit AuditdNetlinkParser(AuditdContextRef context);
+  AuditdNetlinkParser(AuditdContextRef context, std::size_t partition);
   virtual void start() override;
 
   /// Parses an audit_reply structure into an AuditEventRecord object
@@ -146,6 +235,9 @@ class AuditdNetlinkParser final : public InternalRunnable {
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
+
+  /// The partition whose records this parser handles
+  std::size_t partition_{0U};
 };
 
 /// This class provides access to the audit netlink data
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief A bounded, lock-free, single-producer single-consumer queue.
+ *
+ * The audit services hand over batches of records through these queues, so
+ * the reader never waits on a parser and a parser never waits on the
+ * publisher. Each end must only be used from a single thread.
+ */
+template <typename T>
+class AuditdQueue final {
+ public:
+  explicit AuditdQueue(std::size_t capacity) : slots_(capacity + 1) {}
+
+  /// Producer only; the value is left untouched when the queue is full.
+  bool push(T& value) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer only; returns false when the queue is empty.
+  bool pop(T& value) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    value = std::move(slots_[head]);
+    slots_[head] = T();
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::size_t increment(std::size_t index) const {
+    return (index + 1 == slots_.size()) ? 0 : index + 1;
+  }
+
+ private:
+  std::vector<T> slots_;
+
+  /// The next slot to pop, written by the consumer.
+  alignas(64) std::atomic<std::size_t> head_{0};
+
+  /// The next slot to push, written by the producer.
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+} // namespace osquery
@@ -35,6 +35,9 @@ namespace {
 
 const std::string kAppArmorEventMarker{"apparmor"};
 
+/// Events missing their terminator are dropped within 300 seconds
+const std::time_t kAuditTraceGeneration{150};
+
 bool IsPublisherEnabled() noexcept {
   if (FLAGS_disable_audit) {
     return false;
@@ -50,6 +53,50 @@ bool IsPublisherEnabled() noexcept {
 
 std::string AuditEventPublisher::executable_path_;
 
+AuditEvent* AuditTraceContext::find(const std::string& audit_id) {
+  auto it = current_.find(audit_id);
+  if (it != current_.end()) {
+    return &it->second;
+  }
+
+  it = previous_.find(audit_id);
+  return (it != previous_.end()) ? &it->second : nullptr;
+}
+
+AuditEvent& AuditTraceContext::insert(const std::string& audit_id,
+                                      AuditEvent audit_event) {
+  previous_.erase(audit_id);
+  auto& entry = current_[audit_id];
+  entry = std::move(audit_event);
+  return entry;
+}
+
+void AuditTraceContext::erase(const std::string& audit_id) {
+  if (current_.erase(audit_id) == 0) {
+    previous_.erase(audit_id);
+  }
+}
+
+void AuditTraceContext::expire(std::time_t current_time) {
+  if (generation_start_ == 0) {
+    generation_start_ = current_time;
+  }
+
+  if (current_time - generation_start_ < kAuditTraceGeneration) {
+    return;
+  }
+
+  // We have failed to receive the end of record for the events left from the
+  // previous generation and will never complete them correctly
+  previous_ = std::move(current_);
+  current_.clear();
+  generation_start_ = current_time;
+}
+
+std::size_t AuditTraceContext::size() const {
+  return current_.size() + previous_.size();
+}
+
 Status AuditEventPublisher::setUp() {
   if (!IsPublisherEnabled()) {
     return Status(1, "Publisher disabled via configuration");
@@ -113,7 +160,7 @@ void AuditEventPublisher::ProcessEvents(
   // Assemble each record into a AuditEvent object; multi-record events
   // are complete when we receive the terminator (AUDIT_EOE)
   for (const auto& audit_event_record : record_list) {
-    auto audit_event_it = trace_context.find(audit_event_record.audit_id);
+    auto pending_event = trace_context.find(audit_event_record.audit_id);
 
     // We have two entry points here; the first one is for user messages, while
     // the second one is for syscalls
@@ -181,16 +228,16 @@ void AuditEventPublisher::ProcessEvents(
         event_context->audit_events.push_back(audit_event);
       }
     } else if (audit_event_record.type == AUDIT_SYSCALL) {
-      if (audit_event_it != trace_context.end()) {
+      if (pending_event != nullptr) {
         VLOG(1) << "Received a duplicated event.";
-        trace_context.erase(audit_event_it);
+        trace_context.erase(audit_event_record.audit_id);
       }
 
-      AuditEvent audit_event;
-      audit_event.type = AuditEvent::Type::Syscall;
+      AuditEvent syscall_event;
+      syscall_event.type = AuditEvent::Type::Syscall;
 
       // Estimate based on the process_file_events_tests.cpp records
-      audit_event.record_list.reserve(4U);
+      syscall_event.record_list.reserve(4U);
 
       SyscallAuditEventData data;
 
@@ -249,7 +296,7 @@ void AuditEventPublisher::ProcessEvents(
 
       data.process_id = static_cast<pid_t>(process_id);
       data.parent_process_id = static_cast<pid_t>(parent_process_id);
-      audit_event.data = data;
+      syscall_event.data = data;
 
       std::uint64_t process_uid;
       if (!GetIntegerFieldFromMap(
@@ -333,61 +380,31 @@ void AuditEventPublisher::ProcessEvents(
       data.process_fsgid = static_cast<gid_t>(process_fsgid);
       data.process_sgid = static_cast<gid_t>(process_sgid);
 
-      audit_event.record_list.push_back(audit_event_record);
-      trace_context[audit_event_record.audit_id] = std::move(audit_event);
+      syscall_event.record_list.push_back(audit_event_record);
+      trace_context.insert(audit_event_record.audit_id,
+                           std::move(syscall_event));
 
       // This is the terminator for multi-record audit events
     } else if (audit_event_record.type == AUDIT_EOE) {
-      if (audit_event_it == trace_context.end()) {
+      if (pending_event == nullptr) {
         continue;
       }
 
-      auto completed_audit_event = audit_event_it->second;
-      trace_context.erase(audit_event_it);
-
-      event_context->audit_events.push_back(std::move(completed_audit_event));
+      event_context->audit_events.push_back(std::move(*pending_event));
+      trace_context.erase(audit_event_record.audit_id);
 
     } else {
-      if (audit_event_it == trace_context.end()) {
+      if (pending_event == nullptr) {
         continue;
       }
 
-      audit_event_it->second.record_list.push_back(audit_event_record);
+      pending_event->record_list.push_back(audit_event_record);
     }
   }
 
-  // Drop events that are older than 5 minutes; it means that we have failed to
-  // receive the end of record and will never complete them correctly
-
   std::time_t current_time;
   std::time(&current_time);
-
-  std::unordered_map<std::string, std::time_t> timestamp_cache;
-
-  // The first part of the audit id is a timestamp: 1501323932.710:7670542
-  for (auto event_it = trace_context.begin();
-       event_it != trace_context.end();) {
-    const auto& audit_event_id = event_it->first;
-    std::time_t event_timestamp;
-
-    auto timestamp_it = timestamp_cache.find(audit_event_id);
-    if (timestamp_it == timestamp_cache.end()) {
-      std::string string_timestamp = audit_event_id.substr(0, 10);
-
-      event_timestamp = tryTo<long long>(string_timestamp).takeOr(0ll);
-
-      timestamp_cache[audit_event_id] = event_timestamp;
-
-    } else {
-      event_timestamp = timestamp_it->second;
-    }
-
-    if (current_time - event_timestamp >= 300) {
-      event_it = trace_context.erase(event_it);
-    } else {
-      event_it++;
-    }
-  }
+  trace_context.expire(current_time);
 }
 
 const AuditEventRecord* GetEventRecord(const AuditEvent& event,
@@ -406,7 +423,7 @@ const AuditEventRecord* GetEventRecord(const AuditEvent& event,
 };
 
 bool GetStringFieldFromMap(std::string& value,
-                           const std::map<std::string, std::string>& fields,
+                           const AuditFieldMap& fields,
                            const std::string& name,
                            const std::string& default_value) noexcept {
   auto it = fields.find(name);
@@ -415,12 +432,12 @@ bool GetStringFieldFromMap(std::string& value,
     return false;
   }
 
-  value = it->second;
+  value.assign(it->second.data(), it->second.size());
   return true;
 }
 
 bool GetIntegerFieldFromMap(std::uint64_t& value,
-                            const std::map<std::string, std::string>& field_map,
+                            const AuditFieldMap& field_map,
                             const std::string& field_name,
                             std::size_t base,
                             std::uint64_t default_value) noexcept {
@@ -435,7 +452,7 @@ bool GetIntegerFieldFromMap(std::uint64_t& value,
 }
 
 void CopyFieldFromMap(Row& row,
-                      const std::map<std::string, std::string>& fields,
+                      const AuditFieldMap& fields,
                       const std::string& name,
                       const std::string& default_value) noexcept {
   GetStringFieldFromMap(row[name], fields, name, default_value);
@@ -10,8 +10,11 @@
 #pragma once
 
 #include <cstdint>
+#include <ctime>
 #include <limits>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include <boost/variant.hpp>
 
@@ -92,8 +95,40 @@ struct AuditEventContext final : public EventContext {
 using AuditEventContextRef = std::shared_ptr<AuditEventContext>;
 using AuditSubscriptionContextRef = std::shared_ptr<AuditSubscriptionContext>;
 
-/// This type maps audit event id with the corresponding audit event object
-using AuditTraceContext = std::map<std::string, AuditEvent>;
+/**
+ * @brief Maps audit event ids to the audit events being assembled.
+ *
+ * Events that never receive their terminator are dropped after their
+ * generation expires. Entries move between two hash tables rather than being
+ * scanned for their age, so expiring is constant time per event.
+ */
+class AuditTraceContext final {
+ public:
+  /// Returns the event being assembled for the given id, or nullptr
+  AuditEvent* find(const std::string& audit_id);
+
+  /// Starts assembling a new event, replacing any event with the same id
+  AuditEvent& insert(const std::string& audit_id, AuditEvent audit_event);
+
+  /// Stops assembling the event with the given id
+  void erase(const std::string& audit_id);
+
+  /// Drops the events that are at least one expired generation old
+  void expire(std::time_t current_time);
+
+  /// The number of events being assembled
+  std::size_t size() const;
+
+ private:
+  /// Events started during the current generation
+  std::unordered_map<std::string, AuditEvent> current_;
+
+  /// Events started during the previous generation
+  std::unordered_map<std::string, AuditEvent> previous_;
+
+  /// When the current generation started
+  std::time_t generation_start_{0};
+};
 
 class AuditEventPublisher final
     : public EventPublisher<AuditSubscriptionContext, AuditEventContext> {
@@ -129,17 +164,17 @@ class AuditEventPublisher final
 const AuditEventRecord* GetEventRecord(const AuditEvent& event,
                                        int record_type) noexcept;
 
-/// Extracts the specified string key from the given string map
+/// Extracts the specified string key from the given field map
 bool GetStringFieldFromMap(
     std::string& value,
-    const std::map<std::string, std::string>& fields,
+    const AuditFieldMap& fields,
     const std::string& name,
     const std::string& default_value = std::string()) noexcept;
 
-/// Extracts the specified integer key from the given string map
+/// Extracts the specified integer key from the given field map
 bool GetIntegerFieldFromMap(
     std::uint64_t& value,
-    const std::map<std::string, std::string>& field_map,
+    const AuditFieldMap& field_map,
     const std::string& field_name,
     std::size_t base = 10,
     std::uint64_t default_value =
@@ -148,7 +183,7 @@ bool GetIntegerFieldFromMap(
 /// Copies a named field from the 'fields' map to the specified row
 void CopyFieldFromMap(
     Row& row,
-    const std::map<std::string, std::string>& fields,
+    const AuditFieldMap& fields,
     const std::string& name,
     const std::string& default_value = std::string()) noexcept;
 
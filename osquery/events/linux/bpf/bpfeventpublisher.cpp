@@ -9,6 +9,7 @@
 
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/bpf/bpfeventpublisher.h>
+#include <osquery/events/linux/bpf/eventreorderbuffer.h>
 #include <osquery/events/linux/bpf/setrlimit.h>
 #include <osquery/events/linux/bpf/systemstatetracker.h>
 #include <osquery/logger/logger.h>
@@ -16,7 +17,7 @@
 #include <osquery/utils/system/time.h>
 
 #include <fcntl.h>
-#include <sys/sysinfo.h>
+#include <time.h>
 
 namespace osquery {
 
@@ -33,42 +34,78 @@ using EventHandlerMap = std::unordered_map<std::uint64_t, EventHandler>;
 using BufferStorageMap =
     std::unordered_map<std::uint8_t, tob::ebpfpub::IBufferStorage::Ref>;
 
+/// Subscribers that need the events of a tracer.
+enum TracerConsumer : std::uint8_t {
+  kProcessEventsConsumer = 1U,
+  kSocketEventsConsumer = 2U,
+  kAllConsumers = kProcessEventsConsumer | kSocketEventsConsumer,
+};
+
+/// The consumer of each subscriber, others consume every tracer.
+const std::unordered_map<std::string, std::uint8_t> kTracerConsumerNames = {
+    {"bpf_process_events", kProcessEventsConsumer},
+    {"bpf_socket_events", kSocketEventsConsumer},
+};
+
 struct FunctionTracerAllocator final {
   std::string syscall_name;
   EventHandler event_handler;
   std::uint8_t buffer_storage_pool{0U};
+  std::uint8_t consumers{kAllConsumers};
 };
 
 using FunctionTracerAllocatorList = std::vector<FunctionTracerAllocator>;
 
-// Format: syscall, handler, memory pool id
+using BPFEventReorderBuffer =
+    EventReorderBuffer<tob::ebpfpub::IFunctionTracer::Event>;
+
+std::uint64_t getEventTimestamp(
+    const tob::ebpfpub::IFunctionTracer::Event& event) {
+  return event.header.timestamp;
+}
+
+/// Nanoseconds on the clock used for BPF event timestamps.
+std::uint64_t getMonotonicTime() {
+  struct timespec now {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<std::uint64_t>(now.tv_sec) * 1000000000ULL +
+         static_cast<std::uint64_t>(now.tv_nsec);
+}
+
+// Process and file descriptor state is needed by every subscriber. Paths and
+// working directories are only reported by process events, sockets only by
+// socket events.
+//
+// Format: syscall, handler, memory pool id, consumers
+// clang-format off
 const FunctionTracerAllocatorList kFunctionTracerAllocators = {
-    {"fork", &BPFEventPublisher::processForkEvent, 0U},
-    {"vfork", &BPFEventPublisher::processVforkEvent, 0U},
-    {"clone", &BPFEventPublisher::processCloneEvent, 0U},
-    {"close", &BPFEventPublisher::processCloseEvent, 0U},
-    {"dup", &BPFEventPublisher::processDupEvent, 0U},
-    {"dup2", &BPFEventPublisher::processDup2Event, 0U},
-    {"dup3", &BPFEventPublisher::processDup3Event, 0U},
-    {"creat", &BPFEventPublisher::processCreatEvent, 1U},
-    {"mknod", &BPFEventPublisher::processMknodatEvent, 1U},
-    {"mknodat", &BPFEventPublisher::processMknodatEvent, 1U},
-    {"name_to_handle_at", &BPFEventPublisher::processNameToHandleAtEvent, 1U},
-    {"open_by_handle_at", &BPFEventPublisher::processOpenByHandleAtEvent, 1U},
-    {"open", &BPFEventPublisher::processOpenEvent, 2U},
-    {"openat", &BPFEventPublisher::processOpenatEvent, 2U},
-    {"openat2", &BPFEventPublisher::processOpenat2Event, 1U},
-    {"execve", &BPFEventPublisher::processExecveEvent, 3U},
-    {"execveat", &BPFEventPublisher::processExecveatEvent, 3U},
-    {"socket", &BPFEventPublisher::processSocketEvent, 4U},
-    {"fcntl", &BPFEventPublisher::processFcntlEvent, 4U},
-    {"connect", &BPFEventPublisher::processConnectEvent, 4U},
-    {"accept", &BPFEventPublisher::processAcceptEvent, 4U},
-    {"accept4", &BPFEventPublisher::processAccept4Event, 4U},
-    {"bind", &BPFEventPublisher::processBindEvent, 4U},
-    {"listen", &BPFEventPublisher::processListenEvent, 4U},
-    {"chdir", &BPFEventPublisher::processChdirEvent, 5U},
-    {"fchdir", &BPFEventPublisher::processFchdirEvent, 5U}};
+    {"fork", &BPFEventPublisher::processForkEvent, 0U, kAllConsumers},
+    {"vfork", &BPFEventPublisher::processVforkEvent, 0U, kAllConsumers},
+    {"clone", &BPFEventPublisher::processCloneEvent, 0U, kAllConsumers},
+    {"close", &BPFEventPublisher::processCloseEvent, 0U, kAllConsumers},
+    {"dup", &BPFEventPublisher::processDupEvent, 0U, kAllConsumers},
+    {"dup2", &BPFEventPublisher::processDup2Event, 0U, kAllConsumers},
+    {"dup3", &BPFEventPublisher::processDup3Event, 0U, kAllConsumers},
+    {"creat", &BPFEventPublisher::processCreatEvent, 1U, kProcessEventsConsumer},
+    {"mknod", &BPFEventPublisher::processMknodatEvent, 1U, kProcessEventsConsumer},
+    {"mknodat", &BPFEventPublisher::processMknodatEvent, 1U, kProcessEventsConsumer},
+    {"name_to_handle_at", &BPFEventPublisher::processNameToHandleAtEvent, 1U, kProcessEventsConsumer},
+    {"open_by_handle_at", &BPFEventPublisher::processOpenByHandleAtEvent, 1U, kProcessEventsConsumer},
+    {"open", &BPFEventPublisher::processOpenEvent, 2U, kProcessEventsConsumer},
+    {"openat", &BPFEventPublisher::processOpenatEvent, 2U, kProcessEventsConsumer},
+    {"openat2", &BPFEventPublisher::processOpenat2Event, 1U, kProcessEventsConsumer},
+    {"execve", &BPFEventPublisher::processExecveEvent, 3U, kAllConsumers},
+    {"execveat", &BPFEventPublisher::processExecveatEvent, 3U, kAllConsumers},
+    {"socket", &BPFEventPublisher::processSocketEvent, 4U, kSocketEventsConsumer},
+    {"fcntl", &BPFEventPublisher::processFcntlEvent, 4U, kAllConsumers},
+    {"connect", &BPFEventPublisher::processConnectEvent, 4U, kSocketEventsConsumer},
+    {"accept", &BPFEventPublisher::processAcceptEvent, 4U, kSocketEventsConsumer},
+    {"accept4", &BPFEventPublisher::processAccept4Event, 4U, kSocketEventsConsumer},
+    {"bind", &BPFEventPublisher::processBindEvent, 4U, kSocketEventsConsumer},
+    {"listen", &BPFEventPublisher::processListenEvent, 4U, kSocketEventsConsumer},
+    {"chdir", &BPFEventPublisher::processChdirEvent, 5U, kProcessEventsConsumer},
+    {"fchdir", &BPFEventPublisher::processFchdirEvent, 5U, kProcessEventsConsumer}};
+// clang-format on
 
 } // namespace
 
@@ -87,6 +124,24 @@ FLAG(uint64,
      512ULL,
      "How many slots each buffer storage should have");
 
+FLAG(uint64,
+     bpf_reorder_window,
+     5000ULL,
+     "Milliseconds to hold BPF events so they are processed in timestamp "
+     "order");
+
+FLAG(bool,
+     bpf_scan_processes,
+     false,
+     "Capture every running process from procfs before starting the BPF "
+     "probes, instead of on the first event of each process");
+
+FLAG(uint64,
+     bpf_max_process_contexts,
+     32768ULL,
+     "Maximum number of processes tracked by the BPF publisher (0 = no "
+     "limit)");
+
 REGISTER(BPFEventPublisher, "event_publisher", "BPFEventPublisher");
 
 struct BPFEventPublisher::PrivateData final {
@@ -97,7 +152,8 @@ struct BPFEventPublisher::PrivateData final {
   BufferStorageMap buffer_storage_map;
   EventHandlerMap event_handler_map;
 
-  std::map<std::uint64_t, tob::ebpfpub::IFunctionTracer::Event> event_queue;
+  BPFEventReorderBuffer event_queue{&getEventTimestamp};
+  bool tracers_loaded{false};
   ISystemStateTracker::Ref system_state_tracker;
 };
 
@@ -131,7 +187,47 @@ Status BPFEventPublisher::setUp() {
 
   d->perf_event_reader = perf_event_reader_exp.takeValue();
 
+  d->system_state_tracker = SystemStateTracker::create(
+      FLAGS_bpf_scan_processes,
+      static_cast<std::size_t>(FLAGS_bpf_max_process_contexts));
+  if (!d->system_state_tracker) {
+    return Status::failure("Failed to create the system state tracker object");
+  }
+
+  d->initialized = true;
+  return Status::success();
+}
+
+Status BPFEventPublisher::loadTracers() {
+  if (d->tracers_loaded) {
+    return Status::success();
+  }
+
+  // Subscribers have subscribed by the time the run loop starts.
+  std::uint8_t consumers{0U};
+  {
+    ReadLock lock(subscription_lock_);
+    for (const auto& subscription : subscriptions_) {
+      auto consumer_it =
+          kTracerConsumerNames.find(subscription->subscriber_name);
+      consumers |= (consumer_it == kTracerConsumerNames.end())
+                       ? static_cast<std::uint8_t>(kAllConsumers)
+                       : consumer_it->second;
+    }
+  }
+
+  if (consumers == 0U) {
+    return Status::failure("No subscriber consumes BPF events");
+  }
+
   for (const auto& tracer_allocator : kFunctionTracerAllocators) {
+    if ((tracer_allocator.consumers & consumers) == 0U) {
+      VLOG(1) << "Skipping the BPF probe for syscall "
+              << tracer_allocator.syscall_name
+              << " since no subscriber consumes it";
+      continue;
+    }
+
     auto buffer_storage_it =
         d->buffer_storage_map.find(tracer_allocator.buffer_storage_pool);
 
@@ -189,12 +285,7 @@ Status BPFEventPublisher::setUp() {
     d->perf_event_reader->insert(std::move(function_tracer));
   }
 
-  d->system_state_tracker = SystemStateTracker::create();
-  if (!d->system_state_tracker) {
-    return Status::failure("Failed to create the system state tracker object");
-  }
-
-  d->initialized = true;
+  d->tracers_loaded = true;
   return Status::success();
 }
 
@@ -224,6 +315,13 @@ Status BPFEventPublisher::run() {
         "Halting the publisher since initialization has failed");
   }
 
+  auto status = loadTracers();
+  if (!status.ok()) {
+    // Tracers may be partially loaded, a restarted run loop must not reload.
+    d->initialized = false;
+    return status;
+  }
+
   tob::ebpfpub::IPerfEventReader::ErrorCounters error_counters{};
   auto last_error_counters_report = getUnixTime();
 
@@ -243,10 +341,7 @@ Status BPFEventPublisher::run() {
           error_counters.invalid_event_data +=
               new_error_counters.invalid_event_data;
 
-          for (auto& event : event_list) {
-            auto rel_timestamp = event.header.timestamp;
-            d->event_queue.insert({rel_timestamp, std::move(event)});
-          }
+          d->event_queue.push(event_list);
         });
 
     auto current_time = getUnixTime();
@@ -277,34 +372,27 @@ Status BPFEventPublisher::run() {
     std::size_t invalid_event_count = 0U;
     auto& state = *d->system_state_tracker.get();
 
-    struct sysinfo system_info {};
-    sysinfo(&system_info);
-
-    for (auto event_it = d->event_queue.begin();
-         event_it != d->event_queue.end();) {
-      const auto& rel_timestamp = event_it->first / 1000000000ULL;
-      if (system_info.uptime - rel_timestamp < 5ULL) {
-        ++event_it;
-        continue;
-      }
-
-      auto event = std::move(event_it->second);
-      event_it = d->event_queue.erase(event_it);
-
-      auto event_handler_it = d->event_handler_map.find(event.identifier);
-      if (event_handler_it == d->event_handler_map.end()) {
-        VLOG(1) << "Unhandled event received in BPFEventPublisher: "
-                << event.identifier;
-        continue;
-      }
+    // Events are processed once every perf buffer has been read past them.
+    auto window = FLAGS_bpf_reorder_window * 1000000ULL;
+    auto now = getMonotonicTime();
+    auto cutoff = (now > window) ? now - window : 0ULL;
+
+    d->event_queue.pop(
+        cutoff, [&](tob::ebpfpub::IFunctionTracer::Event event) {
+          auto event_handler_it = d->event_handler_map.find(event.identifier);
+          if (event_handler_it == d->event_handler_map.end()) {
+            VLOG(1) << "Unhandled event received in BPFEventPublisher: "
+                    << event.identifier;
+            return;
+          }
 
-      const auto& event_handler = event_handler_it->second;
-      if (!event_handler(state, event)) {
-        VLOG(1) << "BPFEventPublisher failed to process event from tracer #"
-                << event.identifier;
-        ++invalid_event_count;
-      }
-    }
+          const auto& event_handler = event_handler_it->second;
+          if (!event_handler(state, event)) {
+            VLOG(1) << "BPFEventPublisher failed to process event from tracer #"
+                    << event.identifier;
+            ++invalid_event_count;
+          }
+        });
 
     if (invalid_event_count != 0U) {
       LOG(ERROR) << "BPFEventPublisher has encountered " << invalid_event_count
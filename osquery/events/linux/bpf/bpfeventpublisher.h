@@ -41,6 +41,9 @@ class BPFEventPublisher final : public EventPublisher<BPFEventSC, BPFEventEC> {
  private:
   DECLARE_PUBLISHER("BPFEventPublisher");
 
+  /// Load the tracers of the syscalls that subscribers consume.
+  Status loadTracers();
+
   struct PrivateData;
   std::unique_ptr<PrivateData> d;
 
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief Restore the global timestamp order of events read from perf buffers.
+ *
+ * Events read from a single per-CPU perf buffer are already ordered, the
+ * reader hands them over as the concatenation of those ordered runs. Each run
+ * is appended to an ordered sequence that it continues, so the buffer holds
+ * about one sequence per CPU rather than a node per event. Events older than
+ * the reorder window are released in timestamp order by a k-way merge.
+ */
+template <typename Event>
+class EventReorderBuffer final {
+ public:
+  using Timestamp = std::uint64_t;
+  using TimestampGetter = Timestamp (*)(const Event&);
+  using EventList = std::vector<Event>;
+
+  explicit EventReorderBuffer(TimestampGetter timestamp)
+      : timestamp_(timestamp) {}
+
+  /// Buffer a batch of events made of one or more ordered runs.
+  void push(const EventList& events) {
+    auto run_begin = events.begin();
+    for (auto it = events.begin(); it != events.end(); ++it) {
+      if (it != run_begin && timestamp_(*it) < timestamp_(*(it - 1))) {
+        append(run_begin, it);
+        run_begin = it;
+      }
+    }
+    append(run_begin, events.end());
+  }
+
+  /// Release, in timestamp order, the events with a timestamp before cutoff.
+  template <typename Callback>
+  void pop(Timestamp cutoff, Callback callback) {
+    using Head = std::pair<Timestamp, std::size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (std::size_t i = 0; i < sequences_.size(); i++) {
+      if (!sequences_[i].empty()) {
+        heads.emplace(timestamp_(sequences_[i].front()), i);
+      }
+    }
+
+    while (!heads.empty() && heads.top().first < cutoff) {
+      auto& sequence = sequences_[heads.top().second];
+      auto index = heads.top().second;
+      heads.pop();
+
+      auto event = std::move(sequence.front());
+      sequence.pop_front();
+      size_--;
+      if (!sequence.empty()) {
+        heads.emplace(timestamp_(sequence.front()), index);
+      }
+      callback(std::move(event));
+    }
+
+    sequences_.erase(std::remove_if(sequences_.begin(),
+                                    sequences_.end(),
+                                    [](const std::deque<Event>& sequence) {
+                                      return sequence.empty();
+                                    }),
+                     sequences_.end());
+  }
+
+  /// The number of buffered events.
+  std::size_t size() const {
+    return size_;
+  }
+
+  /// The number of ordered sequences being merged.
+  std::size_t sequences() const {
+    return sequences_.size();
+  }
+
+ private:
+  using Iterator = typename EventList::const_iterator;
+
+  /// Continue the sequence with the latest tail that precedes the run.
+  void append(Iterator begin, Iterator end) {
+    if (begin == end) {
+      return;
+    }
+
+    auto first = timestamp_(*begin);
+    std::deque<Event>* target{nullptr};
+    for (auto& sequence : sequences_) {
+      if (sequence.empty()) {
+        continue;
+      }
+
+      auto tail = timestamp_(sequence.back());
+      if (tail <= first &&
+          (target == nullptr || tail > timestamp_(target->back()))) {
+        target = &sequence;
+      }
+    }
+
+    if (target == nullptr) {
+      sequences_.emplace_back();
+      target = &sequences_.back();
+    }
+
+    size_ += static_cast<std::size_t>(end - begin);
+    target->insert(target->end(), begin, end);
+  }
+
+ private:
+  TimestampGetter timestamp_;
+  std::vector<std::deque<Event>> sequences_;
+  std::size_t size_{0U};
+};
+
+} // namespace osquery
@@ -13,6 +13,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include <boost/container/flat_map.hpp>
+
 #include <osquery/events/linux/bpf/ifilesystem.h>
 
 namespace osquery {
@@ -58,7 +60,9 @@ struct ProcessContext final {
     bool close_on_exec{false};
   };
 
-  using FileDescriptorMap = std::unordered_map<int, FileDescriptor>;
+  /// Descriptors are small integers kept in one sorted array, which makes
+  /// copying the table on every fork a single allocation
+  using FileDescriptorMap = boost::container::flat_map<int, FileDescriptor>;
 
   /// Parent process id
   pid_t parent_process_id{};
@@ -82,10 +86,10 @@ using ProcessContextMap = std::unordered_map<pid_t, ProcessContext>;
 /// This class is used to create ProcessContext objects based on
 /// running processes using procfs.
 ///
-/// Then BPF is used, osquery will take a full system snapshot which
-/// is then kept up to date using the incoming events. In case one
-/// of the processes is not found, the captureSingleProcess method
-/// is used to add missing processes on the fly
+/// When BPF is used, a process is captured the first time an event
+/// references it and is then kept up to date using the incoming events.
+/// A full system snapshot can be taken at startup instead, with the
+/// captureAllProcesses method
 class IProcessContextFactory {
  public:
   using Ref = std::unique_ptr<IProcessContextFactory>;
@@ -98,6 +102,9 @@ class IProcessContextFactory {
   /// Creates a system snapshot, using captureSingleProcess on all processes
   virtual bool captureAllProcesses(ProcessContextMap& process_map) const = 0;
 
+  /// Returns true if the given process is still running
+  virtual bool processExists(pid_t process_id) const = 0;
+
   IProcessContextFactory() = default;
   virtual ~IProcessContextFactory() = default;
 
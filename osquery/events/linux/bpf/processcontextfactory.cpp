@@ -11,6 +11,9 @@
 #include <osquery/events/linux/bpf/uniquedir.h>
 #include <osquery/utils/conversions/tryto.h>
 
+#include <algorithm>
+#include <thread>
+
 #include <dirent.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -27,6 +30,12 @@ namespace {
 const std::size_t kMaxFileSize{1024 * 100};
 const std::string kProcFsRoot{"/proc/"};
 
+/// Upper bound of the threads capturing the running processes
+const std::size_t kMaxScanThreads{8U};
+
+/// Processes are only split between threads above this count
+const std::size_t kMinProcessesPerThread{64U};
+
 } // namespace
 
 bool ProcessContextFactory::captureSingleProcess(
@@ -39,6 +48,10 @@ bool ProcessContextFactory::captureAllProcesses(
   return captureAllProcesses(*fs.get(), process_map);
 }
 
+bool ProcessContextFactory::processExists(pid_t process_id) const {
+  return processExists(*fs.get(), process_id);
+}
+
 ProcessContextFactory::ProcessContextFactory(
     IFilesystem::Ref filesystem_interface) {
   fs = std::move(filesystem_interface);
@@ -164,7 +177,7 @@ bool ProcessContextFactory::captureAllProcesses(
     return false;
   }
 
-  ProcessContextMap output;
+  std::vector<pid_t> process_id_list;
 
   // clang-format off
   auto succeeded = fs.enumFiles(
@@ -180,21 +193,60 @@ bool ProcessContextFactory::captureAllProcesses(
         return;
       }
 
-      auto pid = pid_exp.take();
-
-      ProcessContext process_context = {};
-      if (captureSingleProcess(fs, process_context, pid)) {
-        output.insert({pid, std::move(process_context)});
-      } else {
-      }
+      process_id_list.push_back(static_cast<pid_t>(pid_exp.take()));
     }
   );
   // clang-format on
 
+  // Each process costs a few opens and reads of its procfs folder, which
+  // adds up on hosts running thousands of containers. Split them between
+  // a few threads that each fill their own slots
+  std::vector<ProcessContext> process_context_list(process_id_list.size());
+  std::vector<char> captured_list(process_id_list.size(), 0);
+
+  auto worker_count = std::min<std::size_t>(
+      std::max(std::thread::hardware_concurrency(), 1U), kMaxScanThreads);
+
+  worker_count = std::min(
+      worker_count, (process_id_list.size() / kMinProcessesPerThread) + 1U);
+
+  auto L_worker = [&](std::size_t first_index) {
+    for (auto i = first_index; i < process_id_list.size(); i += worker_count) {
+      captured_list[i] = captureSingleProcess(
+          fs, process_context_list[i], process_id_list[i]);
+    }
+  };
+
+  std::vector<std::thread> worker_list;
+  for (std::size_t i = 1U; i < worker_count; ++i) {
+    worker_list.emplace_back(L_worker, i);
+  }
+
+  L_worker(0U);
+
+  for (auto& worker : worker_list) {
+    worker.join();
+  }
+
+  ProcessContextMap output;
+  output.reserve(process_id_list.size());
+
+  for (std::size_t i = 0U; i < process_id_list.size(); ++i) {
+    if (captured_list[i] != 0) {
+      output.insert({process_id_list[i], std::move(process_context_list[i])});
+    }
+  }
+
   process_map = std::move(output);
   return succeeded;
 }
 
+bool ProcessContextFactory::processExists(IFilesystem& fs, pid_t process_id) {
+  tob::utils::UniqueFd process_root;
+  return fs.open(
+      process_root, kProcFsRoot + std::to_string(process_id), O_DIRECTORY);
+}
+
 bool ProcessContextFactory::getArgvFromCmdlineFile(
     IFilesystem& fs, std::vector<std::string>& argv, int fd) {
   argv = {};
@@ -23,6 +23,8 @@ class ProcessContextFactory final : public IProcessContextFactory {
   virtual bool captureAllProcesses(
       ProcessContextMap& process_map) const override;
 
+  virtual bool processExists(pid_t process_id) const override;
+
  private:
   IFilesystem::Ref fs;
 
@@ -36,6 +38,8 @@ class ProcessContextFactory final : public IProcessContextFactory {
   static bool captureAllProcesses(IFilesystem& fs,
                                   ProcessContextMap& process_map);
 
+  static bool processExists(IFilesystem& fs, pid_t process_id);
+
   static bool getArgvFromCmdlineFile(IFilesystem& fs,
                                      std::vector<std::string>& argv,
                                      int fd);
@@ -26,6 +26,9 @@ namespace {
 
 const std::size_t kMaxFileHandleEntryCount{512U};
 
+/// The share (1/N) of the process contexts freed when the limit is reached
+const std::size_t kProcessContextHeadroom{4U};
+
 }
 
 struct SystemStateTracker::PrivateData final {
@@ -33,21 +36,28 @@ struct SystemStateTracker::PrivateData final {
   IProcessContextFactory::Ref process_context_factory;
 };
 
-SystemStateTracker::Ref SystemStateTracker::create() {
+SystemStateTracker::Ref SystemStateTracker::create(
+    bool scan_processes, std::size_t max_process_contexts) {
   IProcessContextFactory::Ref process_context_factory;
   auto status = IProcessContextFactory::create(process_context_factory);
   if (!status) {
     throw status;
   }
 
-  return create(std::move(process_context_factory));
+  return create(std::move(process_context_factory),
+                scan_processes,
+                max_process_contexts);
 }
 
 SystemStateTracker::Ref SystemStateTracker::create(
-    IProcessContextFactory::Ref process_context_factory) {
+    IProcessContextFactory::Ref process_context_factory,
+    bool scan_processes,
+    std::size_t max_process_contexts) {
   try {
     return SystemStateTracker::Ref(
-        new SystemStateTracker(std::move(process_context_factory)));
+        new SystemStateTracker(std::move(process_context_factory),
+                               scan_processes,
+                               max_process_contexts));
 
   } catch (const Status& status) {
     LOG(ERROR) << "Failed to create the state tracker: " << status.getMessage();
@@ -230,9 +240,16 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
 }
 
 SystemStateTracker::SystemStateTracker(
-    IProcessContextFactory::Ref process_context_factory)
+    IProcessContextFactory::Ref process_context_factory,
+    bool scan_processes,
+    std::size_t max_process_contexts)
     : d(new PrivateData) {
   d->process_context_factory = std::move(process_context_factory);
+  d->context.max_process_contexts = max_process_contexts;
+
+  if (!scan_processes) {
+    return;
+  }
 
   if (!d->process_context_factory->captureAllProcesses(
           d->context.process_map)) {
@@ -257,6 +274,8 @@ ProcessContext& SystemStateTracker::getProcessContext(
               << ". Fields will show up empty";
     }
 
+    expireProcessContexts(context, process_context_factory, process_id);
+
     auto status =
         context.process_map.insert({process_id, std::move(process_context)});
 
@@ -291,8 +310,11 @@ bool SystemStateTracker::createProcess(
 
   context.event_list.push_back(std::move(event));
 
-  context.process_map.insert(
-      {child_process_id, std::move(child_process_context)});
+  // Process exits are not traced, a reused pid replaces the stale context
+  // rather than inheriting its binary, working directory and descriptors
+  expireProcessContexts(context, process_context_factory, child_process_id);
+  context.process_map.insert_or_assign(child_process_id,
+                                       std::move(child_process_context));
 
   return true;
 }
@@ -1194,6 +1216,39 @@ void SystemStateTracker::expireFileHandleEntries(Context& context,
   context.file_handle_struct_index.erase(start_range, end_range);
 }
 
+void SystemStateTracker::expireProcessContexts(
+    Context& context,
+    IProcessContextFactory& process_context_factory,
+    pid_t process_id) {
+  if (context.max_process_contexts == 0U ||
+      context.process_map.size() < context.max_process_contexts ||
+      context.process_map.count(process_id) != 0U) {
+    return;
+  }
+
+  // Most contexts belong to processes that have exited
+  for (auto it = context.process_map.begin();
+       it != context.process_map.end();) {
+    if (process_context_factory.processExists(it->first)) {
+      ++it;
+    } else {
+      it = context.process_map.erase(it);
+    }
+  }
+
+  // Leave some room so that a full map of running processes is not
+  // checked again on each new process. Dropped contexts are captured
+  // again from procfs on their next event
+  auto max_size = context.max_process_contexts - 1U -
+                  (context.max_process_contexts / kProcessContextHeadroom);
+
+  for (auto it = context.process_map.begin();
+       it != context.process_map.end() &&
+       context.process_map.size() > max_size;) {
+    it = context.process_map.erase(it);
+  }
+}
+
 SystemStateTracker::Context SystemStateTracker::getContextCopy() const {
   return d->context;
 }
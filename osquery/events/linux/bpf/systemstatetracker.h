@@ -22,8 +22,13 @@ namespace osquery {
 
 class SystemStateTracker final : public ISystemStateTracker {
  public:
-  static Ref create();
-  static Ref create(IProcessContextFactory::Ref process_context_factory);
+  /// When scan_processes is false, processes are captured on their first
+  /// event. A max_process_contexts of 0 does not limit the process count
+  static Ref create(bool scan_processes, std::size_t max_process_contexts);
+
+  static Ref create(IProcessContextFactory::Ref process_context_factory,
+                    bool scan_processes = true,
+                    std::size_t max_process_contexts = 0U);
 
   virtual ~SystemStateTracker() override;
 
@@ -105,7 +110,9 @@ class SystemStateTracker final : public ISystemStateTracker {
   Context getContextCopy() const;
 
  private:
-  SystemStateTracker(IProcessContextFactory::Ref process_context_factory);
+  SystemStateTracker(IProcessContextFactory::Ref process_context_factory,
+                     bool scan_processes,
+                     std::size_t max_process_contexts);
 
  public:
   struct PrivateData;
@@ -123,6 +130,9 @@ class SystemStateTracker final : public ISystemStateTracker {
     ProcessContextMap process_map;
     EventList event_list;
 
+    /// Process exits are not traced, contexts are expired above this count
+    std::size_t max_process_contexts{0U};
+
     std::vector<std::string> file_handle_struct_index;
     FileHandleStructMap file_handle_struct_map;
   };
@@ -261,6 +271,11 @@ class SystemStateTracker final : public ISystemStateTracker {
                              int flag);
 
   static void expireFileHandleEntries(Context& context, std::size_t max_size);
+
+  static void expireProcessContexts(
+      Context& context,
+      IProcessContextFactory& process_context_factory,
+      pid_t process_id);
 };
 
 } // namespace osquery
@@ -0,0 +1,281 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <osquery/events/linux/fanotify.h>
+
+namespace osquery {
+
+#ifdef FAN_REPORT_DFID_NAME
+
+// The events are translated to inotify actions by their bits.
+static_assert(FAN_ACCESS == IN_ACCESS && FAN_MODIFY == IN_MODIFY &&
+                  FAN_ATTRIB == IN_ATTRIB &&
+                  FAN_CLOSE_WRITE == IN_CLOSE_WRITE && FAN_OPEN == IN_OPEN &&
+                  FAN_MOVED_FROM == IN_MOVED_FROM &&
+                  FAN_MOVED_TO == IN_MOVED_TO && FAN_CREATE == IN_CREATE &&
+                  FAN_DELETE == IN_DELETE && FAN_ONDIR == IN_ISDIR,
+              "fanotify and inotify event bits differ");
+
+/// The cached directory paths are dropped once there are this many.
+static const size_t kMaxDirectoryPaths = 8192;
+
+static std::pair<int, int> getFilesystemId(const void* fsid) {
+  int val[2];
+  memcpy(val, fsid, sizeof(val));
+  return std::make_pair(val[0], val[1]);
+}
+
+Status FanotifyFilesystemWatch::open() {
+  close();
+
+  fd_ = ::fanotify_init(
+      FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+      O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+  if (fd_ == -1) {
+    return Status::failure("Could not start fanotify: " +
+                           std::string(strerror(errno)));
+  }
+  return Status::success();
+}
+
+void FanotifyFilesystemWatch::close() {
+  clearMarks();
+
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+void FanotifyFilesystemWatch::clearMarks() {
+  if (fd_ != -1) {
+    ::fanotify_mark(
+        fd_, FAN_MARK_FLUSH | FAN_MARK_FILESYSTEM, 0, AT_FDCWD, nullptr);
+    ::fanotify_mark(fd_, FAN_MARK_FLUSH, 0, AT_FDCWD, nullptr);
+  }
+
+  for (const auto& mount_fd : mount_fds_) {
+    ::close(mount_fd.second);
+  }
+  mount_fds_.clear();
+  directory_paths_.clear();
+}
+
+Status FanotifyFilesystemWatch::markFilesystem(const std::string& path,
+                                               uint64_t mask) {
+  struct statfs st;
+  if (::statfs(path.c_str(), &st) != 0) {
+    return Status::failure("Could not stat the filesystem of: " + path);
+  }
+
+  if (::fanotify_mark(fd_,
+                      FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                      mask | FAN_ONDIR,
+                      AT_FDCWD,
+                      path.c_str()) != 0) {
+    return Status::failure("Could not add fanotify mark on: " + path + ": " +
+                           strerror(errno));
+  }
+
+  auto fsid = getFilesystemId(&st.f_fsid);
+  if (mount_fds_.count(fsid) == 0) {
+    // Handles are not resolved relative to O_PATH descriptors, open the
+    // directory (or the parent of a file) instead.
+    auto mount_fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (mount_fd == -1) {
+      auto parent = path.substr(0, path.rfind('/') + 1);
+      mount_fd = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    if (mount_fd == -1) {
+      return Status::failure("Could not open: " + path);
+    }
+    mount_fds_[fsid] = mount_fd;
+  }
+  return Status::success();
+}
+
+Status FanotifyFilesystemWatch::ignorePath(const std::string& path,
+                                           uint64_t mask) {
+  if (::fanotify_mark(fd_,
+                      FAN_MARK_ADD | FAN_MARK_IGNORED_MASK |
+                          FAN_MARK_IGNORED_SURV_MODIFY,
+                      mask | FAN_EVENT_ON_CHILD,
+                      AT_FDCWD,
+                      path.c_str()) != 0) {
+    return Status::failure("Could not ignore fanotify events on: " + path +
+                           ": " + strerror(errno));
+  }
+  return Status::success();
+}
+
+bool FanotifyFilesystemWatch::resolveDirectory(const std::pair<int, int>& fsid,
+                                               const void* handle,
+                                               std::string& path) {
+  auto file_handle = static_cast<const struct file_handle*>(handle);
+
+  std::string key(reinterpret_cast<const char*>(&fsid), sizeof(fsid));
+  key.append(static_cast<const char*>(handle),
+             sizeof(struct file_handle) + file_handle->handle_bytes);
+
+  auto it = directory_paths_.find(key);
+  if (it != directory_paths_.end()) {
+    path = it->second;
+    return true;
+  }
+
+  auto mount_fd = mount_fds_.find(fsid);
+  if (mount_fd == mount_fds_.end()) {
+    return false;
+  }
+
+  auto fd = ::open_by_handle_at(mount_fd->second,
+                                const_cast<struct file_handle*>(file_handle),
+                                O_PATH | O_CLOEXEC);
+  if (fd == -1) {
+    // The directory was removed since the event.
+    return false;
+  }
+
+  char buffer[PATH_MAX];
+  auto link = "/proc/self/fd/" + std::to_string(fd);
+  auto size = ::readlink(link.c_str(), buffer, sizeof(buffer));
+  ::close(fd);
+  if (size <= 0 || static_cast<size_t>(size) >= sizeof(buffer)) {
+    return false;
+  }
+
+  path.assign(buffer, static_cast<size_t>(size));
+  if (directory_paths_.size() >= kMaxDirectoryPaths) {
+    directory_paths_.clear();
+  }
+  directory_paths_[key] = path;
+  return true;
+}
+
+std::vector<FanotifyEvent> FanotifyFilesystemWatch::parseEvents(
+    const char* buffer, size_t size, bool& overflow) {
+  std::vector<FanotifyEvent> events;
+  overflow = false;
+
+  auto length = static_cast<int>(size);
+  auto metadata =
+      reinterpret_cast<const struct fanotify_event_metadata*>(buffer);
+  for (; FAN_EVENT_OK(metadata, length);
+       metadata = FAN_EVENT_NEXT(metadata, length)) {
+    if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+      break;
+    }
+
+    if (metadata->fd >= 0) {
+      ::close(metadata->fd);
+    }
+
+    if (metadata->mask & FAN_Q_OVERFLOW) {
+      overflow = true;
+      continue;
+    }
+
+    auto record = reinterpret_cast<const char*>(metadata);
+    auto info = record + metadata->metadata_len;
+    auto end = record + metadata->event_len;
+    while (info + sizeof(struct fanotify_event_info_header) <= end) {
+      auto header =
+          reinterpret_cast<const struct fanotify_event_info_header*>(info);
+      if (header->len == 0 || info + header->len > end) {
+        break;
+      }
+
+      if (header->info_type != FAN_EVENT_INFO_TYPE_DFID_NAME &&
+          header->info_type != FAN_EVENT_INFO_TYPE_DFID) {
+        info += header->len;
+        continue;
+      }
+
+      auto fid = reinterpret_cast<const struct fanotify_event_info_fid*>(info);
+      auto file_handle =
+          reinterpret_cast<const struct file_handle*>(fid->handle);
+
+      FanotifyEvent event;
+      event.mask = metadata->mask;
+      if (!resolveDirectory(
+              getFilesystemId(&fid->fsid), file_handle, event.path)) {
+        break;
+      }
+
+      if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+        // The entry name follows the directory handle.
+        auto name = reinterpret_cast<const char*>(file_handle->f_handle) +
+                    file_handle->handle_bytes;
+        std::string entry(name, strnlen(name, info + header->len - name));
+        if (!entry.empty() && entry != ".") {
+          if (event.path.back() != '/') {
+            event.path += '/';
+          }
+          event.path += entry;
+        }
+      }
+
+      events.push_back(std::move(event));
+      break;
+    }
+
+    // The paths of the directories below a moved or removed one changed.
+    if ((metadata->mask & FAN_ONDIR) &&
+        (metadata->mask & (FAN_MOVED_FROM | FAN_MOVED_TO | FAN_DELETE))) {
+      directory_paths_.clear();
+    }
+  }
+
+  return events;
+}
+
+#else
+
+Status FanotifyFilesystemWatch::open() {
+  return Status::failure("fanotify filesystem marks are not supported");
+}
+
+void FanotifyFilesystemWatch::close() {}
+
+void FanotifyFilesystemWatch::clearMarks() {}
+
+Status FanotifyFilesystemWatch::markFilesystem(const std::string& path,
+                                               uint64_t mask) {
+  return Status::failure("fanotify filesystem marks are not supported");
+}
+
+Status FanotifyFilesystemWatch::ignorePath(const std::string& path,
+                                           uint64_t mask) {
+  return Status::failure("fanotify filesystem marks are not supported");
+}
+
+bool FanotifyFilesystemWatch::resolveDirectory(const std::pair<int, int>& fsid,
+                                               const void* handle,
+                                               std::string& path) {
+  return false;
+}
+
+std::vector<FanotifyEvent> FanotifyFilesystemWatch::parseEvents(
+    const char* buffer, size_t size, bool& overflow) {
+  overflow = false;
+  return {};
+}
+
+#endif
+} // namespace osquery
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A change reported by a FanotifyFilesystemWatch.
+struct FanotifyEvent {
+  /// The event bits, these are the same as the equivalent inotify bits.
+  uint64_t mask{0};
+
+  /// The changed path.
+  std::string path;
+};
+
+/**
+ * @brief A fanotify group reporting the changes of whole filesystems.
+ *
+ * Unlike inotify, which needs a watch per directory, one filesystem mark
+ * reports the changes to every file on that filesystem. Events identify
+ * the parent directory by a file handle and the changed entry by name
+ * (FAN_REPORT_DFID_NAME, Linux 5.9+); directory handles are resolved to
+ * paths and cached until a directory is renamed or deleted.
+ *
+ * The group needs CAP_SYS_ADMIN.
+ */
+class FanotifyFilesystemWatch : private boost::noncopyable {
+ public:
+  ~FanotifyFilesystemWatch() {
+    close();
+  }
+
+  /// Create the fanotify group.
+  Status open();
+
+  /// Remove every mark and release the fanotify group.
+  void close();
+
+  /// The fanotify group descriptor, -1 if not open.
+  int getHandle() const {
+    return fd_;
+  }
+
+  /// Remove every filesystem mark and ignored path.
+  void clearMarks();
+
+  /// Report the events in mask on the filesystem containing path.
+  Status markFilesystem(const std::string& path, uint64_t mask);
+
+  /// Do not report the events in mask on path, or the entries of a directory.
+  Status ignorePath(const std::string& path, uint64_t mask);
+
+  /**
+   * @brief Parse the events of a read from the fanotify group.
+   *
+   * @param buffer the read events.
+   * @param size the size of the read.
+   * @param overflow set if the kernel queue overflowed and events were lost.
+   * @return the events whose path could be resolved.
+   */
+  std::vector<FanotifyEvent> parseEvents(const char* buffer,
+                                         size_t size,
+                                         bool& overflow);
+
+ private:
+  /// Resolve a directory file handle to its path.
+  bool resolveDirectory(const std::pair<int, int>& fsid,
+                        const void* handle,
+                        std::string& path);
+
+ private:
+  /// The fanotify group descriptor.
+  int fd_{-1};
+
+  /// Filesystem ID => a descriptor on that filesystem for handle lookups.
+  std::map<std::pair<int, int>, int> mount_fds_;
+
+  /// Filesystem ID and directory handle bytes => directory path.
+  std::unordered_map<std::string, std::string> directory_paths_;
+};
+} // namespace osquery
@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <set>
 #include <sstream>
+#include <unordered_map>
 
 #include <fnmatch.h>
 #include <linux/limits.h>
@@ -29,8 +31,9 @@ namespace fs = boost::filesystem;
 namespace osquery {
 
 DECLARE_bool(enable_file_events);
+DECLARE_bool(file_events_fanotify);
 
-static const size_t kINotifyMaxEvents = 512;
+static const size_t kINotifyMaxEvents = 1024;
 static const size_t kINotifyEventSize =
     sizeof(struct inotify_event) + (NAME_MAX + 1);
 static const size_t kINotifyBufferSize =
@@ -60,10 +63,21 @@ Status INotifyEventPublisher::setUp() {
     return Status(1, "Publisher disabled via configuration");
   }
 
-  inotify_handle_ = ::inotify_init();
-  // If this does not work throw an exception.
-  if (inotify_handle_ == -1) {
-    return Status(1, "Could not start inotify: inotify_init failed");
+  if (FLAGS_file_events_fanotify) {
+    auto status = fanotify_.open();
+    if (status.ok()) {
+      use_fanotify_ = true;
+    } else {
+      LOG(WARNING) << status.getMessage() << ", falling back to inotify";
+    }
+  }
+
+  if (!use_fanotify_) {
+    inotify_handle_ = ::inotify_init();
+    // If this does not work throw an exception.
+    if (inotify_handle_ == -1) {
+      return Status(1, "Could not start inotify: inotify_init failed");
+    }
   }
 
   WriteLock lock(scratch_mutex_);
@@ -79,6 +93,18 @@ bool INotifyEventPublisher::needMonitoring(const std::string& path,
                                            uint32_t mask,
                                            bool recursive,
                                            bool add_watch) {
+  if (use_fanotify_) {
+    // A filesystem mark also reports the changes in new subdirectories.
+    WriteLock lock(path_mutex_);
+    auto status = fanotify_.markFilesystem(
+        path, (isc->mask == 0) ? kFileDefaultMasks : isc->mask);
+    if (!status.ok()) {
+      LOG(WARNING) << status.getMessage();
+      return false;
+    }
+    return true;
+  }
+
   bool rc = true;
   struct stat file_dir_stat;
   time_t sc_time = isc->path_sc_time_[path];
@@ -152,6 +178,17 @@ void INotifyEventPublisher::buildExcludePathsSet() {
         continue;
       }
       exclude_paths_.insert(pattern);
+
+      // Literal paths are also ignored by the kernel, patterns are only
+      // filtered when the events are fired.
+      if (use_fanotify_ && pattern.find_first_of("%*") == std::string::npos) {
+        WriteLock path_lock(path_mutex_);
+        auto status = fanotify_.ignorePath(
+            pattern, kFileDefaultMasks | kFileAccessMasks);
+        if (!status.ok()) {
+          VLOG(1) << status.getMessage();
+        }
+      }
     }
   }
 }
@@ -161,7 +198,7 @@ void INotifyEventPublisher::configure() {
     return;
   }
 
-  if (inotify_handle_ == -1) {
+  if (inotify_handle_ == -1 && !use_fanotify_) {
     // This publisher has not been setup correctly.
     return;
   }
@@ -192,6 +229,12 @@ void INotifyEventPublisher::configure() {
   }
   delete_subscriptions.clear();
 
+  if (use_fanotify_) {
+    // Marks are cheap to add, they are recreated for the new subscriptions.
+    WriteLock lock(path_mutex_);
+    fanotify_.clearMarks();
+  }
+
   buildExcludePathsSet();
 
   for (auto& sub : subscriptions_) {
@@ -213,6 +256,12 @@ void INotifyEventPublisher::tearDown() {
   }
   inotify_handle_ = -1;
 
+  {
+    WriteLock lock(path_mutex_);
+    fanotify_.close();
+    use_fanotify_ = false;
+  }
+
   WriteLock lock(scratch_mutex_);
   if (scratch_ != nullptr) {
     free(scratch_);
@@ -221,16 +270,157 @@ void INotifyEventPublisher::tearDown() {
 }
 
 void INotifyEventPublisher::handleOverflow() {
-  if (inotify_events_ < kINotifyMaxEvents) {
-    VLOG(1) << "inotify was overflown: increasing scratch buffer";
-    // Exponential increment.
-    inotify_events_ = inotify_events_ * 2;
-  } else if (last_overflow_ != -1 && getUnixTime() - last_overflow_ < 60) {
+  if (last_overflow_ != -1 && getUnixTime() - last_overflow_ < 60) {
     return;
-  } else {
-    VLOG(1) << "inotify was overflown";
-    last_overflow_ = getUnixTime();
   }
+
+  VLOG(1) << "inotify was overflown";
+  last_overflow_ = getUnixTime();
+}
+
+std::vector<EventContextRef> INotifyEventPublisher::processEventBuffer(
+    const char* buffer, size_t size) {
+  std::vector<EventContextRef> event_contexts;
+
+  // The last event kept for each path, to coalesce repeated modifications.
+  std::unordered_map<std::string, uint32_t> last_masks;
+
+  for (const char* p = buffer; p < buffer + size;) {
+    // Events are parsed in place, the name follows the fixed-size header.
+    auto event = reinterpret_cast<const struct inotify_event*>(p);
+    p += (sizeof(struct inotify_event)) + event->len;
+
+    if (event->mask & IN_Q_OVERFLOW) {
+      // The inotify queue was overflown and events were dropped.
+      handleOverflow();
+    } else if (event->mask & IN_IGNORED) {
+      // This inotify watch was removed.
+      removeMonitor(event->wd, false);
+    } else if (event->mask & IN_MOVE_SELF) {
+      // This inotify path was moved, but is still watched.
+      removeMonitor(event->wd, true);
+    } else if (event->mask & IN_DELETE_SELF) {
+      // A file was moved to replace the watched path.
+      removeMonitor(event->wd, false);
+    } else {
+      auto ec = createEventContextFrom(event);
+      if (ec->action.empty()) {
+        continue;
+      }
+
+      // A write is reported as a modification per write call, only the first
+      // of a run of modifications to a path is kept.
+      auto& last_mask = last_masks[ec->path];
+      auto mask = event->mask & ~IN_ISDIR;
+      if (mask == IN_MODIFY && last_mask == IN_MODIFY) {
+        continue;
+      }
+
+      last_mask = mask;
+      event_contexts.push_back(std::move(ec));
+    }
+  }
+
+  return event_contexts;
+}
+
+std::vector<EventContextRef> INotifyEventPublisher::processFanotifyBuffer(
+    const char* buffer, size_t size) {
+  bool overflow = false;
+  std::vector<FanotifyEvent> events;
+  {
+    WriteLock lock(path_mutex_);
+    events = fanotify_.parseEvents(buffer, size, overflow);
+  }
+
+  if (overflow) {
+    handleOverflow();
+  }
+
+  std::vector<INotifySubscriptionContextRef> subscription_contexts;
+  {
+    ReadLock lock(subscription_lock_);
+    for (const auto& subscription : subscriptions_) {
+      subscription_contexts.push_back(
+          getSubscriptionContext(subscription->context));
+    }
+  }
+
+  std::vector<EventContextRef> event_contexts;
+
+  // The last event kept for each path, to coalesce repeated modifications.
+  std::unordered_map<std::string, uint32_t> last_masks;
+
+  for (const auto& event : events) {
+    // The fanotify event bits are the same as the inotify ones. The kernel
+    // merges the queued events of a path, each action is fired in turn.
+    auto event_mask = static_cast<uint32_t>(event.mask);
+    std::set<std::string> actions;
+    for (const auto& bit : kMaskActions) {
+      if (!(event_mask & bit.first) || !actions.insert(bit.second).second) {
+        continue;
+      }
+
+      auto& last_mask = last_masks[event.path];
+      auto mask = static_cast<uint32_t>(bit.first);
+      if (mask == IN_MODIFY && last_mask == IN_MODIFY) {
+        continue;
+      }
+      last_mask = mask;
+
+      // A filesystem mark is shared, each subscription gets its own context.
+      for (const auto& sc : subscription_contexts) {
+        if (sc->mark_for_deletion || !isPathSubscribed(*sc, event.path)) {
+          continue;
+        }
+
+        auto ec = createEventContext();
+        ec->event.mask = mask | (event_mask & IN_ISDIR);
+        ec->path = event.path;
+        ec->action = bit.second;
+        ec->isub_ctx = sc;
+        event_contexts.push_back(std::move(ec));
+      }
+    }
+  }
+
+  return event_contexts;
+}
+
+bool INotifyEventPublisher::isPathSubscribed(
+    const INotifySubscriptionContext& sc, const std::string& path) {
+  auto matches = [](const std::string& pattern, const std::string& candidate) {
+    if (pattern.find('*') == std::string::npos) {
+      return pattern == candidate;
+    }
+    return ::fnmatch(pattern.c_str(), candidate.c_str(), FNM_PATHNAME) == 0;
+  };
+
+  const auto& pattern = sc.path;
+  if (pattern.empty()) {
+    return false;
+  }
+
+  if (sc.recursive) {
+    // The subscription directory is any of the path's parents, or the path.
+    auto directory = (pattern.back() == '/') ? pattern : pattern + '/';
+    auto candidate = path + '/';
+    for (auto slash = candidate.find('/'); slash != std::string::npos;
+         slash = candidate.find('/', slash + 1)) {
+      if (matches(directory, candidate.substr(0, slash + 1))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (pattern.back() == '/') {
+    // A directory reports the changes of its entries and of itself.
+    return matches(pattern, path.substr(0, path.rfind('/') + 1)) ||
+           matches(pattern, path + '/');
+  }
+
+  return matches(pattern, path);
 }
 
 Status INotifyEventPublisher::run() {
@@ -238,8 +428,10 @@ Status INotifyEventPublisher::run() {
     return Status(1, "Publisher disabled via configuration");
   }
 
+  auto handle = use_fanotify_ ? fanotify_.getHandle() : getHandle();
+
   struct pollfd fds[1];
-  fds[0].fd = getHandle();
+  fds[0].fd = handle;
   fds[0].events = POLLIN;
   int selector = ::poll(fds, 1, 1000);
   if (selector == -1) {
@@ -260,56 +452,41 @@ Status INotifyEventPublisher::run() {
   }
 
   WriteLock lock(scratch_mutex_);
-  ssize_t record_num =
-      ::read(getHandle(), scratch_, inotify_events_ * kINotifyEventSize);
+  ssize_t record_num = ::read(handle, scratch_, kINotifyBufferSize);
+  if (record_num == -1 && errno == EAGAIN) {
+    // The fanotify group is non-blocking.
+    return Status::success();
+  }
+
   if (record_num == 0 || record_num == -1) {
     return Status(1, "INotify read failed");
   }
 
-  for (char* p = scratch_; p < scratch_ + record_num;) {
-    // Cast the inotify struct, make shared pointer, and append to contexts.
-    auto event = reinterpret_cast<struct inotify_event*>(p);
-    if (event->mask & IN_Q_OVERFLOW) {
-      // The inotify queue was overflown (try to receive more events from OS).
-      handleOverflow();
-    } else if (event->mask & IN_IGNORED) {
-      // This inotify watch was removed.
-      removeMonitor(event->wd, false);
-    } else if (event->mask & IN_MOVE_SELF) {
-      // This inotify path was moved, but is still watched.
-      removeMonitor(event->wd, true);
-    } else if (event->mask & IN_DELETE_SELF) {
-      // A file was moved to replace the watched path.
-      removeMonitor(event->wd, false);
-    } else {
-      auto ec = createEventContextFrom(event);
-      if (!ec->action.empty()) {
-        fire(ec);
-      }
-    }
-    // Continue to iterate
-    p += (sizeof(struct inotify_event)) + event->len;
-  }
+  auto size = static_cast<size_t>(record_num);
+  fireBatch(use_fanotify_ ? processFanotifyBuffer(scratch_, size)
+                          : processEventBuffer(scratch_, size));
 
   return Status::success();
 }
 
 INotifyEventContextRef INotifyEventPublisher::createEventContextFrom(
-    struct inotify_event* event) const {
+    const struct inotify_event* event) const {
   auto ec = createEventContext();
-  ec->event = std::make_unique<struct inotify_event>(*event);
+  ec->event.wd = event->wd;
+  ec->event.mask = event->mask;
+  ec->event.cookie = event->cookie;
 
   // Get the pathname the watch fired on.
   {
-    WriteLock lock(path_mutex_);
-    if (descriptor_inosubctx_.find(event->wd) == descriptor_inosubctx_.end()) {
+    ReadLock lock(path_mutex_);
+    auto it = descriptor_inosubctx_.find(event->wd);
+    if (it == descriptor_inosubctx_.end()) {
       // return a blank event context if we can't find the paths for the event
       return ec;
-    } else {
-      auto isc = descriptor_inosubctx_.at(event->wd);
-      ec->path = isc->descriptor_paths_.at(event->wd);
-      ec->isub_ctx = isc;
     }
+
+    ec->isub_ctx = it->second;
+    ec->path = it->second->descriptor_paths_.at(event->wd);
   }
 
   if (event->len > 1) {
@@ -333,12 +510,13 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
   }
 
   // The subscription may supply a required event mask.
-  if (sc->mask != 0 && !(ec->event->mask & sc->mask)) {
+  if (sc->mask != 0 && !(ec->event.mask & sc->mask)) {
     return false;
   }
 
   // inotify will not monitor recursively, new directories need watches.
-  if (sc->recursive && ec->action == "CREATED" && isDirectory(ec->path)) {
+  if (!use_fanotify_ && sc->recursive && ec->action == "CREATED" &&
+      isDirectory(ec->path)) {
     const_cast<INotifyEventPublisher*>(this)->addMonitor(
         ec->path + '/',
         const_cast<INotifySubscriptionContextRef&>(sc),
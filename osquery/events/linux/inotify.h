@@ -10,12 +10,14 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include <sys/inotify.h>
 #include <sys/stat.h>
 
 #include <osquery/events/eventpublisher.h>
+#include <osquery/events/linux/fanotify.h>
 #include <osquery/events/pathset.h>
 #include <osquery/events/subscription.h>
 
@@ -27,9 +29,9 @@ extern const uint32_t kFileDefaultMasks;
 extern const uint32_t kFileAccessMasks;
 
 // INotifySubscriptionContext containers
-using PathDescriptorMap = std::map<std::string, int>;
-using DescriptorPathMap = std::map<int, std::string>;
-using PathStatusChangeTimeMap = std::map<std::string, time_t>;
+using PathDescriptorMap = std::unordered_map<std::string, int>;
+using DescriptorPathMap = std::unordered_map<int, std::string>;
+using PathStatusChangeTimeMap = std::unordered_map<std::string, time_t>;
 
 /**
  * @brief Subscription details for INotifyEventPublisher events.
@@ -99,12 +101,19 @@ inline bool operator==(const INotifySubscriptionContext& lsc,
 using INotifySubscriptionContextRef =
     std::shared_ptr<INotifySubscriptionContext>;
 
+/// The fixed-size fields of an inotify_event, the name is parsed into a path.
+struct INotifyEvent {
+  int wd{-1};
+  uint32_t mask{0};
+  uint32_t cookie{0};
+};
+
 /**
  * @brief Event details for INotifyEventPublisher events.
  */
 struct INotifyEventContext : public EventContext {
-  /// The inotify_event structure if the EventSubscriber want to interact.
-  std::unique_ptr<struct inotify_event> event{nullptr};
+  /// The inotify_event fields if the EventSubscriber want to interact.
+  INotifyEvent event;
 
   /// A string path parsed from the inotify_event.
   std::string path;
@@ -122,7 +131,8 @@ struct INotifyEventContext : public EventContext {
 using INotifyEventContextRef = std::shared_ptr<INotifyEventContext>;
 
 // Publisher container
-using DescriptorINotifySubCtxMap = std::map<int, INotifySubscriptionContextRef>;
+using DescriptorINotifySubCtxMap =
+    std::unordered_map<int, INotifySubscriptionContextRef>;
 
 using ExcludePathSet = PathSet<patternedPath>;
 
@@ -137,6 +147,10 @@ using ExcludePathSet = PathSet<patternedPath>;
  *
  * Uses INotifySubscriptionContext and INotifyEventContext for subscriptioning,
  *eventing.
+ *
+ * With --file_events_fanotify the subscriptions are served by fanotify
+ * filesystem marks instead: one mark per filesystem replaces the watches of
+ * every directory, and events are matched to subscriptions by path.
  */
 class INotifyEventPublisher
     : public EventPublisher<INotifySubscriptionContext, INotifyEventContext> {
@@ -172,7 +186,19 @@ class INotifyEventPublisher
  private:
   /// Helper/specialized event context creation.
   INotifyEventContextRef createEventContextFrom(
-      struct inotify_event* event) const;
+      const struct inotify_event* event) const;
+
+  /// Parse the events of a read from the inotify handle.
+  std::vector<EventContextRef> processEventBuffer(const char* buffer,
+                                                  size_t size);
+
+  /// Parse the events of a read from the fanotify group.
+  std::vector<EventContextRef> processFanotifyBuffer(const char* buffer,
+                                                     size_t size);
+
+  /// Check if a path is within a subscription, as its watches would report.
+  static bool isPathSubscribed(const INotifySubscriptionContext& sc,
+                               const std::string& path);
 
   /// Check if the application-global `inotify` handle is alive.
   bool isHandleOpen() const {
@@ -242,7 +268,7 @@ class INotifyEventPublisher
     return descriptor_inosubctx_.size();
   }
 
-  /// If we overflow, try to read more events from OS at time.
+  /// The inotify queue overflowed and events were lost.
   void handleOverflow();
 
   /// Map of watched path string to inotify watch file descriptor.
@@ -258,12 +284,15 @@ class INotifyEventPublisher
   /// The inotify file descriptor handle.
   std::atomic<int> inotify_handle_{-1};
 
+  /// The fanotify group used instead of inotify, see --file_events_fanotify.
+  FanotifyFilesystemWatch fanotify_;
+
+  /// The subscriptions are served by fanotify filesystem marks.
+  std::atomic<bool> use_fanotify_{false};
+
   /// Time in seconds of the last inotify overflow.
   std::atomic<int> last_overflow_{-1};
 
-  /// Tracks how many events to be received from OS.
-  size_t inotify_events_{16};
-
   /// Enable for sanity check from unit test(s).
   bool inotify_sanity_check{false};
 
@@ -271,14 +300,14 @@ class INotifyEventPublisher
    * @brief Scratch space for reading INotify responses.
    *
    * We place this here, and include a mutex to do heap/lazy allocation of the
-   * near-3k buffer when the publisher loads. This reduces the need to stack
-   * allocate a local buffer every 200mils and also improves the eventless-case.
+   * buffer when the publisher loads. Each read drains as much of the queue as
+   * fits and events are parsed in place, without copying each record.
    *
    * Allocated during setUp, removed in tearDown, protected by scratch_mutex_.
    */
   char* scratch_{nullptr};
 
-  /// Access to path and descriptor mappings.
+  /// Access to path and descriptor mappings, and the fanotify marks.
   mutable Mutex path_mutex_;
 
   /// Access the Inofity response scratch space.
@@ -291,5 +320,7 @@ class INotifyEventPublisher
   FRIEND_TEST(INotifyTests, DISABLED_test_inotify_recursion);
   FRIEND_TEST(INotifyTests, test_inotify_match_subscription);
   FRIEND_TEST(INotifyTests, test_inotify_embedded_wildcards);
+  FRIEND_TEST(INotifyTests, test_inotify_coalesce_modify);
+  FRIEND_TEST(INotifyTests, test_fanotify_path_subscribed);
 };
 }
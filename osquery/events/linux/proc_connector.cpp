@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+
+#include "osquery/events/linux/proc_connector.h"
+
+namespace osquery {
+
+FLAG(bool,
+     enable_proc_connector_events,
+     false,
+     "Enables the netlink process connector publisher");
+
+REGISTER(ProcConnectorEventPublisher, "event_publisher", "proc_connector");
+
+namespace {
+
+/// Enough for a few hundred process events per read.
+const size_t kProcConnectorBufferSize = 64 * 1024;
+
+/// The kernel socket buffer, events are dropped once it is full.
+const int kProcConnectorSocketBufferSize = 4 * 1024 * 1024;
+
+/// Reads between the checks for a tearDown.
+const size_t kProcConnectorMaxReads = 64;
+
+/// Dropped events are reported at most this often.
+const std::chrono::minutes kProcConnectorOverflowLogInterval{1};
+
+} // namespace
+
+Status ProcConnectorEventPublisher::setUp() {
+  if (!FLAGS_enable_proc_connector_events) {
+    return Status::failure("Publisher disabled via configuration");
+  }
+
+  WriteLock lock(mutex_);
+  socket_ = ::socket(PF_NETLINK,
+                     SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                     NETLINK_CONNECTOR);
+  if (socket_ == -1) {
+    return Status::failure("Could not create the process connector socket: " +
+                           std::string(strerror(errno)));
+  }
+
+  // Bursts of process creation easily outrun the default socket buffer.
+  if (::setsockopt(socket_,
+                   SOL_SOCKET,
+                   SO_RCVBUFFORCE,
+                   &kProcConnectorSocketBufferSize,
+                   sizeof(kProcConnectorSocketBufferSize)) != 0) {
+    ::setsockopt(socket_,
+                 SOL_SOCKET,
+                 SO_RCVBUF,
+                 &kProcConnectorSocketBufferSize,
+                 sizeof(kProcConnectorSocketBufferSize));
+  }
+
+  struct sockaddr_nl address;
+  memset(&address, 0, sizeof(address));
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = CN_IDX_PROC;
+  // Let the kernel pick the port ID, the process may own other sockets.
+  address.nl_pid = 0;
+  if (::bind(socket_, reinterpret_cast<struct sockaddr*>(&address),
+             sizeof(address)) != 0) {
+    auto error = std::string(strerror(errno));
+    ::close(socket_);
+    socket_ = -1;
+    return Status::failure("Could not bind the process connector socket: " +
+                           error);
+  }
+
+  auto status = setListening(true);
+  if (!status.ok()) {
+    ::close(socket_);
+    socket_ = -1;
+    return status;
+  }
+
+  buffer_.resize(kProcConnectorBufferSize);
+  return Status::success();
+}
+
+void ProcConnectorEventPublisher::tearDown() {
+  WriteLock lock(mutex_);
+  if (socket_ != -1) {
+    setListening(false);
+    ::close(socket_);
+    socket_ = -1;
+  }
+}
+
+Status ProcConnectorEventPublisher::setListening(bool listen) {
+  // The connector message ends in a flexible array, build it in a buffer.
+  alignas(struct nlmsghdr) char
+      request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(proc_cn_mcast_op))];
+  memset(request, 0, sizeof(request));
+
+  auto header = reinterpret_cast<struct nlmsghdr*>(request);
+  header->nlmsg_len =
+      NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(proc_cn_mcast_op));
+  header->nlmsg_type = NLMSG_DONE;
+
+  auto message = static_cast<struct cn_msg*>(NLMSG_DATA(header));
+  message->id.idx = CN_IDX_PROC;
+  message->id.val = CN_VAL_PROC;
+  message->len = sizeof(proc_cn_mcast_op);
+
+  auto op = listen ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+  memcpy(message->data, &op, sizeof(op));
+
+  if (::send(socket_, request, header->nlmsg_len, 0) == -1) {
+    return Status::failure("Could not subscribe to process events: " +
+                           std::string(strerror(errno)));
+  }
+  return Status::success();
+}
+
+Status ProcConnectorEventPublisher::run() {
+  {
+    WriteLock lock(mutex_);
+    if (socket_ == -1) {
+      return Status::failure("Process connector not set up");
+    }
+
+    struct pollfd fds[1];
+    fds[0].fd = socket_;
+    fds[0].events = POLLIN;
+
+    int selector = ::poll(fds, 1, 1000);
+    if (selector == -1 && errno != EINTR && errno != EAGAIN) {
+      LOG(ERROR) << "Could not poll the process connector: "
+                 << strerror(errno);
+      return Status::failure("Process connector failed");
+    }
+
+    if (selector <= 0 || !(fds[0].revents & POLLIN)) {
+      // Read timeout.
+      return Status::success();
+    }
+
+    for (size_t reads = 0; reads < kProcConnectorMaxReads; ++reads) {
+      struct sockaddr_nl sender;
+      socklen_t sender_size = sizeof(sender);
+      auto size = ::recvfrom(socket_,
+                             buffer_.data(),
+                             buffer_.size(),
+                             0,
+                             reinterpret_cast<struct sockaddr*>(&sender),
+                             &sender_size);
+      if (size == -1) {
+        if (errno == ENOBUFS) {
+          // The socket buffer filled up and events were dropped.
+          static auto last_log = std::chrono::steady_clock::time_point();
+          auto now = std::chrono::steady_clock::now();
+          if (now - last_log >= kProcConnectorOverflowLogInterval) {
+            last_log = now;
+            LOG(WARNING) << "Process connector events were dropped";
+          }
+          continue;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          LOG(ERROR) << "Could not read the process connector: "
+                     << strerror(errno);
+        }
+        break;
+      }
+
+      // Only the kernel may send process events.
+      if (sender.nl_pid != 0) {
+        continue;
+      }
+
+      // Fire every read right away, subscribers read /proc while the
+      // processes are likely still running.
+      std::vector<EventContextRef> event_contexts;
+      for (const auto& event :
+           parseMessages(buffer_.data(), static_cast<size_t>(size))) {
+        auto ec = createEventContext();
+        ec->event = event;
+        event_contexts.push_back(ec);
+      }
+      fireBatch(event_contexts);
+    }
+  }
+
+  return Status::success();
+}
+
+std::vector<ProcConnectorEvent> ProcConnectorEventPublisher::parseMessages(
+    const char* buffer, size_t size) {
+  std::vector<ProcConnectorEvent> events;
+
+  auto length = static_cast<int>(size);
+  auto header = reinterpret_cast<const struct nlmsghdr*>(buffer);
+  for (; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+    if (header->nlmsg_type == NLMSG_NOOP) {
+      continue;
+    }
+    if (header->nlmsg_type == NLMSG_ERROR ||
+        header->nlmsg_type == NLMSG_OVERRUN) {
+      break;
+    }
+
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct cn_msg))) {
+      continue;
+    }
+
+    auto message = static_cast<const struct cn_msg*>(
+        NLMSG_DATA(const_cast<struct nlmsghdr*>(header)));
+    if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) {
+      continue;
+    }
+
+    // Events from older kernels may be shorter than the current struct,
+    // the fork, exec and exit fields have not moved.
+    auto available = header->nlmsg_len - NLMSG_LENGTH(sizeof(struct cn_msg));
+    if (message->len > available ||
+        message->len < offsetof(struct proc_event, event_data)) {
+      continue;
+    }
+
+    struct proc_event proc;
+    memset(&proc, 0, sizeof(proc));
+    memcpy(&proc, message->data, std::min<size_t>(message->len, sizeof(proc)));
+
+    ProcConnectorEvent event;
+    event.timestamp = proc.timestamp_ns;
+    switch (proc.what) {
+    case proc_event::PROC_EVENT_FORK:
+      // A new thread has the thread group of its creator.
+      if (proc.event_data.fork.child_pid != proc.event_data.fork.child_tgid) {
+        continue;
+      }
+      event.action = PROC_CONNECTOR_FORK;
+      event.pid = proc.event_data.fork.child_tgid;
+      event.parent = proc.event_data.fork.parent_tgid;
+      break;
+    case proc_event::PROC_EVENT_EXEC:
+      event.action = PROC_CONNECTOR_EXEC;
+      event.pid = proc.event_data.exec.process_tgid;
+      break;
+    case proc_event::PROC_EVENT_EXIT:
+      if (proc.event_data.exit.process_pid !=
+          proc.event_data.exit.process_tgid) {
+        continue;
+      }
+      event.action = PROC_CONNECTOR_EXIT;
+      event.pid = proc.event_data.exit.process_tgid;
+      event.exit_code = proc.event_data.exit.exit_code;
+      break;
+    default:
+      continue;
+    }
+
+    events.push_back(event);
+  }
+
+  return events;
+}
+
+bool ProcConnectorEventPublisher::shouldFire(
+    const ProcConnectorSubscriptionContextRef& sc,
+    const ProcConnectorEventContextRef& ec) const {
+  return (sc->actions & ec->event.action) != 0;
+}
+} // namespace osquery
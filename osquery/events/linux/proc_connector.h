@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <osquery/events/eventpublisher.h>
+#include <osquery/events/eventsubscriber.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The process events reported by the kernel process connector.
+enum ProcConnectorAction : uint32_t {
+  PROC_CONNECTOR_FORK = 1 << 0,
+  PROC_CONNECTOR_EXEC = 1 << 1,
+  PROC_CONNECTOR_EXIT = 1 << 2,
+};
+
+/// A process event read from the process connector.
+struct ProcConnectorEvent {
+  ProcConnectorAction action{PROC_CONNECTOR_EXEC};
+
+  /// The process, the child of a fork.
+  pid_t pid{0};
+
+  /// The parent process of a fork, 0 otherwise.
+  pid_t parent{0};
+
+  /// The exit status of an exit, as returned by wait.
+  uint32_t exit_code{0};
+
+  /// Nanoseconds since boot.
+  uint64_t timestamp{0};
+};
+
+/**
+ * @brief Subscription details for ProcConnectorEventPublisher events.
+ */
+struct ProcConnectorSubscriptionContext : public SubscriptionContext {
+  /// A mask of the ProcConnectorAction values to receive.
+  uint32_t actions{PROC_CONNECTOR_EXEC};
+};
+
+/**
+ * @brief Event details for ProcConnectorEventPublisher events.
+ *
+ * The kernel only reports process IDs; subscribers read anything else from
+ * /proc while handling the event, which may fail for short-lived processes.
+ */
+struct ProcConnectorEventContext : public EventContext {
+  ProcConnectorEvent event;
+};
+
+using ProcConnectorEventContextRef = std::shared_ptr<ProcConnectorEventContext>;
+using ProcConnectorSubscriptionContextRef =
+    std::shared_ptr<ProcConnectorSubscriptionContext>;
+
+/**
+ * @brief A Linux netlink process connector EventPublisher.
+ *
+ * The process connector (CONFIG_PROC_EVENTS, Linux 2.6.15+) multicasts a
+ * small message for every fork, exec and exit. Unlike audit it installs no
+ * rules and does not conflict with auditd, and unlike eBPF it works on old
+ * kernels. Thread creation and exit are dropped.
+ *
+ * Listening needs CAP_NET_ADMIN, the publisher is disabled unless
+ * --enable_proc_connector_events is set.
+ */
+class ProcConnectorEventPublisher
+    : public EventPublisher<ProcConnectorSubscriptionContext,
+                            ProcConnectorEventContext> {
+  DECLARE_PUBLISHER("proc_connector");
+
+ public:
+  virtual ~ProcConnectorEventPublisher() {
+    tearDown();
+  }
+
+  Status setUp() override;
+
+  void tearDown() override;
+
+  Status run() override;
+
+  /**
+   * @brief Parse the netlink messages of a read from the process connector.
+   *
+   * @param buffer the read messages.
+   * @param size the size of the read.
+   * @return the process (not thread) fork, exec and exit events.
+   */
+  static std::vector<ProcConnectorEvent> parseMessages(const char* buffer,
+                                                       size_t size);
+
+ private:
+  /// Ask the kernel to start or stop multicasting process events.
+  Status setListening(bool listen);
+
+  /// Check subscription details.
+  bool shouldFire(const ProcConnectorSubscriptionContextRef& sc,
+                  const ProcConnectorEventContextRef& ec) const override;
+
+ private:
+  /// The NETLINK_CONNECTOR socket.
+  int socket_{-1};
+
+  /// Receive buffer, messages are small but arrive in bursts.
+  std::vector<char> buffer_;
+
+  /// Protection around the socket.
+  Mutex mutex_;
+};
+} // namespace osquery
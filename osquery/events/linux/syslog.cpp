@@ -15,14 +15,13 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <istream>
 #include <string>
 
-#include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/json_parser.hpp>
-#include <boost/tokenizer.hpp>
 #include <osquery/registry/registry_factory.h>
 
 #include <osquery/core/flags.h>
@@ -57,6 +56,60 @@ const std::vector<std::string> kCsvFields = {
     "time", "host", "severity", "facility", "tag", "message"};
 const size_t kErrorThreshold = 10;
 
+/// The characters boost::trim removes in the classic locale.
+const char* kCsvSpaces = " \t\n\v\f\r";
+
+std::string_view trimCsvField(std::string_view value) {
+  auto begin = value.find_first_not_of(kCsvSpaces);
+  if (begin == std::string_view::npos) {
+    return std::string_view();
+  }
+  auto end = value.find_last_not_of(kCsvSpaces);
+  return value.substr(begin, end - begin + 1);
+}
+
+bool RsyslogCsvScanner::next(std::string& field) {
+  field.clear();
+  if (rest_.empty()) {
+    if (last_) {
+      // The last character was a comma, so we got an empty field at the end
+      last_ = false;
+      return true;
+    }
+    return false;
+  }
+
+  last_ = false;
+  bool in_quote = false;
+  while (!rest_.empty()) {
+    // Within quotes only a quote ends the run of copied characters.
+    auto pos = in_quote ? rest_.find('"') : rest_.find_first_of(",\"");
+    field.append(rest_.data(), std::min(pos, rest_.size()));
+    if (pos == std::string_view::npos) {
+      rest_ = std::string_view();
+      break;
+    }
+
+    if (rest_[pos] == ',') {
+      rest_.remove_prefix(pos + 1);
+      last_ = true;
+      break;
+    }
+
+    if (!in_quote) {
+      in_quote = true;
+    } else if (pos + 1 < rest_.size() && rest_[pos + 1] == '"') {
+      // rsyslog escapes " with "", so reverse this by inserting "
+      field.push_back('"');
+      ++pos;
+    } else {
+      in_quote = false;
+    }
+    rest_.remove_prefix(pos + 1);
+  }
+  return true;
+}
+
 Status NonBlockingFStream::openReadOnly(const std::string& path) {
   WriteLock lock(fd_mutex_);
 
@@ -73,6 +126,7 @@ Status NonBlockingFStream::openReadOnly(const std::string& path) {
 
 Status NonBlockingFStream::getline(std::string& output) {
   output.clear();
+  compact();
 
   char* buffer_end = nullptr;
   if (offset_ > 0) {
@@ -123,11 +177,79 @@ Status NonBlockingFStream::getline(std::string& output) {
   offset_ = offset_ - line_size - 1;
   if (offset_ > 0) {
     // Shift bytes down.
-    memcpy(buffer_.data(), buffer_end + 1, offset_);
+    memmove(buffer_.data(), buffer_end + 1, offset_);
   }
   return Status::success();
 }
 
+void NonBlockingFStream::compact() {
+  if (consumed_ == 0) {
+    return;
+  }
+
+  offset_ -= consumed_;
+  if (offset_ > 0) {
+    memmove(buffer_.data(), buffer_.data() + consumed_, offset_);
+  }
+  consumed_ = 0;
+}
+
+bool NonBlockingFStream::readAvailable() {
+  WriteLock lock(fd_mutex_);
+
+  // Poll for available data with a near-instant delay.
+  fd_set set;
+  struct timeval timeout = {0, 200};
+  FD_ZERO(&set);
+  FD_SET(fd_, &set);
+  if (::select(FD_SETSIZE, &set, nullptr, nullptr, &timeout) <= 0) {
+    return false;
+  }
+
+  auto bytes_read =
+      ::read(fd_, buffer_.data() + offset_, buffer_.capacity() - offset_);
+  if (bytes_read <= 0) {
+    return false;
+  }
+  offset_ += bytes_read;
+  return true;
+}
+
+Status NonBlockingFStream::getlines(std::vector<std::string_view>& lines,
+                                    size_t max_lines) {
+  lines.clear();
+  compact();
+
+  // Lines start after the consumed bytes, the rest was searched already.
+  size_t searched = 0;
+  while (lines.size() < max_lines) {
+    auto line_end = static_cast<char*>(memchr(
+        buffer_.data() + searched, '\n', offset_ - searched));
+    if (line_end != nullptr) {
+      auto line_start = buffer_.data() + consumed_;
+      lines.emplace_back(line_start, line_end - line_start);
+      consumed_ = searched = line_end - buffer_.data() + 1;
+      continue;
+    }
+
+    searched = offset_;
+    if (offset_ == buffer_.capacity() || !readAvailable()) {
+      break;
+    }
+  }
+
+  if (!lines.empty()) {
+    return Status::success();
+  }
+
+  if (offset_ == buffer_.capacity()) {
+    // This is a problem we cannot handle.
+    offset_ = 0;
+    return Status::failure("Too much data");
+  }
+  return Status::failure("No data to read");
+}
+
 Status NonBlockingFStream::close() {
   WriteLock lock(fd_mutex_);
 
@@ -233,17 +355,23 @@ Status SyslogEventPublisher::run() {
   // weird and there is a huge amount of input, we limit how many logs we
   // take in per run to avoid pegging the CPU.
 
-  std::string line;
-  for (size_t i = 0; i < FLAGS_syslog_rate_limit; ++i) {
-    if (!readStream_.getline(line) || line.empty()) {
-      // Not enough data was available, fall through an wait.
-      break;
+  std::vector<std::string_view> lines;
+  if (!readStream_.getlines(lines, FLAGS_syslog_rate_limit)) {
+    // Not enough data was available, fall through an wait.
+    return Status::success();
+  }
+
+  std::vector<EventContextRef> event_contexts;
+  event_contexts.reserve(lines.size());
+  for (const auto& line : lines) {
+    if (line.empty()) {
+      continue;
     }
 
     auto ec = createEventContext();
     Status status = populateEventContext(line, ec);
     if (status.ok()) {
-      fire(ec);
+      event_contexts.push_back(std::move(ec));
       if (errorCount_ > 0) {
         --errorCount_;
       }
@@ -251,10 +379,13 @@ Status SyslogEventPublisher::run() {
       LOG(ERROR) << status.getMessage() << " in line: " << line;
       ++errorCount_;
       if (errorCount_ >= kErrorThreshold) {
+        fireBatch(event_contexts);
         return Status(1, "Too many errors in syslog parsing.");
       }
     }
   }
+
+  fireBatch(event_contexts);
   return Status::success();
 }
 
@@ -263,21 +394,23 @@ void SyslogEventPublisher::tearDown() {
   unlockPipe();
 }
 
-Status SyslogEventPublisher::populateEventContext(const std::string& line,
+Status SyslogEventPublisher::populateEventContext(std::string_view line,
                                                   SyslogEventContextRef& ec) {
-  boost::tokenizer<RsyslogCsvSeparator> tokenizer(line);
+  RsyslogCsvScanner scanner(line);
   auto key = kCsvFields.begin();
-  for (std::string value : tokenizer) {
+  std::string field;
+  while (scanner.next(field)) {
     if (key == kCsvFields.end()) {
       return Status(1, "Received more fields than expected");
     }
 
-    boost::trim(value);
+    auto value = trimCsvField(field);
     if (*key == "time") {
-      ec->fields["datetime"] = value;
+      ec->fields["datetime"] = std::string(value);
     } else if (*key == "tag" && !value.empty() && value.back() == ':') {
       // rsyslog sends "tag" with a trailing colon that we don't need
-      ec->fields.emplace(*key, value.substr(0, value.size() - 1));
+      value.remove_suffix(1);
+      ec->fields.emplace(*key, value);
     } else {
       ec->fields.emplace(*key, value);
     }
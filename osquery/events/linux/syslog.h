@@ -16,6 +16,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <map>
+#include <string_view>
 #include <vector>
 
 #include <stdio.h>
@@ -92,11 +93,30 @@ class NonBlockingFStream : public boost::noncopyable {
    */
   Status getline(std::string& output);
 
+  /**
+   * @brief Read up to max_lines complete lines.
+   *
+   * Lines already buffered are returned first, then the stream is read until
+   * enough lines are found, no data is available, or the buffer is full. The
+   * lines point into the internal buffer and are valid until the next read.
+   *
+   * If the buffer fills without a complete line the data is dropped, as with
+   * getline.
+   */
+  Status getlines(std::vector<std::string_view>& lines, size_t max_lines);
+
   /// Inspect the internal offset.
   size_t offset() {
-    return offset_;
+    return offset_ - consumed_;
   }
 
+ private:
+  /// Move the bytes not yet returned to the front of the buffer.
+  void compact();
+
+  /// Read the available data into the buffer, false if there is none.
+  bool readAvailable();
+
  private:
   /// The managed descriptor for the stream.
   int fd_{-1};
@@ -115,6 +135,9 @@ class NonBlockingFStream : public boost::noncopyable {
    */
   size_t offset_{0};
 
+  /// Bytes at the front of the buffer returned by getlines.
+  size_t consumed_{0};
+
  private:
   FRIEND_TEST(SyslogTests, test_nonblockingfstream);
 };
@@ -141,7 +164,15 @@ class SyslogEventPublisher
   Status run() override;
 
  public:
-  SyslogEventPublisher() : EventPublisher(), errorCount_(0), lockFd_(-1) {}
+  SyslogEventPublisher()
+      : EventPublisher(),
+        readStream_(kPipeBufferSize),
+        errorCount_(0),
+        lockFd_(-1) {}
+
+ private:
+  /// Read as much as a full pipe, lines may be as long.
+  static constexpr size_t kPipeBufferSize{65536};
 
  private:
   /// Apply normal subscription to event matching logic.
@@ -182,7 +213,7 @@ class SyslogEventPublisher
    * Performs basic cleanup on the JSON data as it is populated into the
    * context.
    */
-  static Status populateEventContext(const std::string& line,
+  static Status populateEventContext(std::string_view line,
                                      SyslogEventContextRef& ec);
 
   /**
@@ -276,4 +307,26 @@ class RsyslogCsvSeparator {
  private:
   bool last_;
 };
+
+/**
+ * @brief Split rsyslog CSV data as RsyslogCsvSeparator does.
+ *
+ * The publisher parses many lines per run; rather than appending one
+ * character at a time, the scanner searches for the next delimiter and
+ * copies the run of characters before it.
+ */
+class RsyslogCsvScanner {
+ public:
+  explicit RsyslogCsvScanner(std::string_view line) : rest_(line) {}
+
+  /// Read the next field, false once the line is consumed.
+  bool next(std::string& field);
+
+ private:
+  /// The remainder of the line.
+  std::string_view rest_;
+
+  /// The last field ended with a comma, an empty field follows.
+  bool last_{false};
+};
 } // namespace osquery
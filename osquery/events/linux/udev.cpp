@@ -9,6 +9,7 @@
 
 #include <poll.h>
 
+#include <osquery/events/linux/udev_device_cache.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
@@ -41,12 +42,16 @@ Status UdevEventPublisher::setUp() {
   }
 
   udev_monitor_enable_receiving(monitor_);
+
+  // Tables may keep device snapshots while the monitor events are received.
+  UdevDeviceCache::get().setMonitored(true);
   return Status::success();
 }
 
 void UdevEventPublisher::tearDown() {
   WriteLock lock(mutex_);
   if (monitor_ != nullptr) {
+    UdevDeviceCache::get().setMonitored(false);
     udev_monitor_unref(monitor_);
     monitor_ = nullptr;
   }
@@ -91,6 +96,8 @@ Status UdevEventPublisher::run() {
       return Status::failure("udev monitor failed");
     }
 
+    UdevDeviceCache::get().update(device);
+
     auto ec = createEventContextFrom(device);
     fire(ec);
 
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+
+#include <osquery/events/linux/udev_device_cache.h>
+
+namespace osquery {
+
+namespace {
+
+/// Snapshots are enumerated again after this long, monitor events may be lost.
+const std::chrono::minutes kUdevSnapshotMaxAge{5};
+
+} // namespace
+
+UdevDeviceCache& UdevDeviceCache::get() {
+  // Never destroyed, the publisher may tear down during static destruction.
+  static auto cache = new UdevDeviceCache();
+  return *cache;
+}
+
+Status UdevDeviceCache::walk(const std::string& subsystem,
+                             const DeviceCallback& callback) {
+  WriteLock lock(mutex_);
+
+  Snapshot unmonitored;
+  Snapshot* snapshot = &unmonitored;
+  if (monitored_) {
+    snapshot = &snapshots_[subsystem];
+    auto age = std::chrono::steady_clock::now() - snapshot->built;
+    if (snapshot->devices.empty() || age > kUdevSnapshotMaxAge) {
+      snapshot->devices.clear();
+      auto status = enumerate(subsystem, *snapshot);
+      if (!status.ok()) {
+        snapshots_.erase(subsystem);
+        return status;
+      }
+    }
+  } else {
+    auto status = enumerate(subsystem, unmonitored);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  for (const auto& device : snapshot->devices) {
+    if (callback(device.second.get())) {
+      break;
+    }
+  }
+  return Status::success();
+}
+
+void UdevDeviceCache::setMonitored(bool monitored) {
+  WriteLock lock(mutex_);
+  monitored_ = monitored;
+  snapshots_.clear();
+}
+
+void UdevDeviceCache::update(udev_device* device) {
+  auto subsystem = udev_device_get_subsystem(device);
+  auto syspath = udev_device_get_syspath(device);
+  if (subsystem == nullptr || syspath == nullptr) {
+    return;
+  }
+
+  WriteLock lock(mutex_);
+  auto snapshot = snapshots_.find(subsystem);
+  if (!monitored_ || snapshot == snapshots_.end()) {
+    return;
+  }
+
+  auto& devices = snapshot->second.devices;
+  devices.erase(syspath);
+
+  // A moved device is dropped from its previous path.
+  auto devpath = udev_device_get_devpath(device);
+  auto old_devpath = udev_device_get_property_value(device, "DEVPATH_OLD");
+  if (devpath != nullptr && old_devpath != nullptr) {
+    std::string path(syspath);
+    auto devpath_size = std::strlen(devpath);
+    if (path.size() >= devpath_size) {
+      devices.erase(path.substr(0, path.size() - devpath_size) + old_devpath);
+    }
+  }
+
+  auto action = udev_device_get_action(device);
+  if (action != nullptr && std::strcmp(action, "remove") == 0) {
+    return;
+  }
+
+  // The monitor's device belongs to the publisher's handle, read it again.
+  auto current = udev_device_new_from_syspath(handle_, syspath);
+  if (current != nullptr) {
+    devices.emplace(syspath, DeviceRef(current));
+  }
+}
+
+Status UdevDeviceCache::enumerate(const std::string& subsystem,
+                                  Snapshot& snapshot) {
+  if (handle_ == nullptr) {
+    handle_ = udev_new();
+    if (handle_ == nullptr) {
+      return Status::failure("Could not get udev handle");
+    }
+  }
+
+  auto enumerate = udev_enumerate_new(handle_);
+  if (enumerate == nullptr) {
+    return Status::failure("Could not get udev_enumerate handle");
+  }
+
+  udev_enumerate_add_match_subsystem(enumerate, subsystem.c_str());
+  udev_enumerate_scan_devices(enumerate);
+
+  udev_list_entry* entry;
+  udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+    const char* path = udev_list_entry_get_name(entry);
+    if (path == nullptr) {
+      continue;
+    }
+
+    auto device = udev_device_new_from_syspath(handle_, path);
+    if (device != nullptr) {
+      snapshot.devices.emplace(path, DeviceRef(device));
+    }
+  }
+
+  udev_enumerate_unref(enumerate);
+  snapshot.built = std::chrono::steady_clock::now();
+  return Status::success();
+}
+} // namespace osquery
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <libudev.h>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief A snapshot of the udev devices of each subsystem, shared by tables.
+ *
+ * Hardware tables enumerated udev devices on every query, which is slow on
+ * hosts with many block devices. While the UdevEventPublisher runs, a
+ * subsystem is enumerated once and its snapshot is kept current by the udev
+ * monitor events. Otherwise each walk enumerates the subsystem again.
+ *
+ * udev devices are not thread safe, walks are serialized and callbacks must
+ * not keep a device after they return.
+ */
+class UdevDeviceCache : private boost::noncopyable {
+ public:
+  /// Called with each device, return true to stop the walk.
+  using DeviceCallback = std::function<bool(udev_device*)>;
+
+  static UdevDeviceCache& get();
+
+  /// Call the callback with each device of a subsystem, in syspath order.
+  Status walk(const std::string& subsystem, const DeviceCallback& callback);
+
+  /**
+   * @brief Set whether the udev monitor events are applied to the snapshots.
+   *
+   * Snapshots are dropped either way, events may have been missed before.
+   */
+  void setMonitored(bool monitored);
+
+  /// Apply a device received from the udev monitor.
+  void update(udev_device* device);
+
+ private:
+  UdevDeviceCache() = default;
+
+  struct DeviceDeleter {
+    void operator()(udev_device* device) const {
+      udev_device_unref(device);
+    }
+  };
+
+  using DeviceRef = std::unique_ptr<udev_device, DeviceDeleter>;
+
+  struct Snapshot {
+    std::chrono::steady_clock::time_point built;
+
+    /// The devices by syspath.
+    std::map<std::string, DeviceRef> devices;
+  };
+
+  /// Enumerate the devices of a subsystem, the lock must be held.
+  Status enumerate(const std::string& subsystem, Snapshot& snapshot);
+
+ private:
+  /// udev handle owning the snapshot devices.
+  udev* handle_{nullptr};
+
+  bool monitored_{false};
+
+  std::map<std::string, Snapshot> snapshots_;
+
+  Mutex mutex_;
+};
+} // namespace osquery
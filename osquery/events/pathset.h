@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -155,4 +159,134 @@ class patternedPath {
   }
 };
 
+/**
+ * @brief A trie of path components, matching a path against many patterns in
+ * a single walk of its components.
+ *
+ * A '*' component matches any one component. Each pattern either matches
+ * paths of exactly its depth, or as a prefix, every path below it. Patterns
+ * inserted as strings follow the patternedPath rules, so a PathTrie can
+ * replace a PathSet<patternedPath> without the cost of a comparison per
+ * component for every pattern.
+ *
+ * The trie is protected by lock. It is threadsafe.
+ */
+class PathTrie : private boost::noncopyable {
+ public:
+  typedef std::vector<std::string> Path;
+
+  explicit PathTrie(bool case_sensitive = true)
+      : case_sensitive_(case_sensitive) {}
+
+  /// Insert a '%' or '*' and '%%' or '**' pattern, see patternedPath.
+  void insert(const std::string& str) {
+    auto pattern = str;
+    replaceGlobWildcards(pattern);
+    auto path = patternedPath::createPath(pattern);
+
+    WriteLock lock(lock_);
+    auto recursive = std::find(path.begin(), path.end(), "**");
+    if (recursive != path.end()) {
+      // A recursive pattern matches its parent and everything below it.
+      path.erase(recursive, path.end());
+      insertPath(path, false);
+      insertPath(path, true);
+    } else {
+      insertPath(path, false);
+      if (!path.empty() && path.back() == "*") {
+        // A trailing wildcard also matches everything below it.
+        insertPath(path, true);
+      }
+    }
+  }
+
+  /// Insert the components of a pattern, a prefix matches paths below it.
+  void insert(const Path& path, bool prefix) {
+    WriteLock lock(lock_);
+    insertPath(path, prefix);
+  }
+
+  bool find(const std::string& str) const {
+    auto path = patternedPath::createPath(str);
+
+    ReadLock lock(lock_);
+    return matches(root_, path, 0);
+  }
+
+  void clear() {
+    WriteLock lock(lock_);
+    root_ = Node();
+    empty_ = true;
+  }
+
+  bool empty() const {
+    ReadLock lock(lock_);
+    return empty_;
+  }
+
+ private:
+  struct Node {
+    std::map<std::string, std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> any;
+    bool exact{false};
+    bool prefix{false};
+  };
+
+  std::string fold(const std::string& component) const {
+    if (case_sensitive_) {
+      return component;
+    }
+
+    auto folded = component;
+    std::transform(
+        folded.begin(), folded.end(), folded.begin(), [](unsigned char c) {
+          return static_cast<char>(std::tolower(c));
+        });
+    return folded;
+  }
+
+  void insertPath(const Path& path, bool prefix) {
+    auto node = &root_;
+    for (const auto& component : path) {
+      auto& next =
+          (component == "*") ? node->any : node->children[fold(component)];
+      if (next == nullptr) {
+        next = std::make_unique<Node>();
+      }
+      node = next.get();
+    }
+
+    if (prefix) {
+      node->prefix = true;
+    } else {
+      node->exact = true;
+    }
+    empty_ = false;
+  }
+
+  bool matches(const Node& node, const Path& path, size_t index) const {
+    if (index == path.size()) {
+      return node.exact;
+    }
+
+    if (node.prefix) {
+      return true;
+    }
+
+    if (node.any != nullptr && matches(*node.any, path, index + 1)) {
+      return true;
+    }
+
+    auto child = node.children.find(fold(path[index]));
+    return child != node.children.end() &&
+           matches(*child->second, path, index + 1);
+  }
+
+ private:
+  Node root_;
+  bool empty_{true};
+  const bool case_sensitive_;
+  mutable Mutex lock_;
+};
+
 } // namespace osquery
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/events/eventfactory.h>
 #include <osquery/events/subscription.h>
 
 namespace osquery {
@@ -27,4 +28,21 @@ SubscriptionRef Subscription::create(const std::string& name,
   return subscription;
 }
 
+EventSubscriberRef Subscription::getSubscriber() const {
+  auto generation = EventFactory::subscriberGeneration();
+  {
+    ReadLock lock(subscriber_lock_);
+    if (subscriber_generation_ == generation) {
+      return subscriber_;
+    }
+  }
+
+  auto subscriber = EventFactory::getEventSubscriber(subscriber_name);
+
+  WriteLock lock(subscriber_lock_);
+  subscriber_ = subscriber;
+  subscriber_generation_ = generation;
+  return subscriber;
+}
+
 } // namespace osquery
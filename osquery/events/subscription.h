@@ -15,6 +15,7 @@
 
 #include <boost/core/noncopyable.hpp>
 #include <osquery/events/types.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
@@ -71,8 +72,27 @@ struct Subscription : private boost::noncopyable {
                                 const SubscriptionContextRef& mc,
                                 EventCallback ec = nullptr);
 
+  /**
+   * @brief The EventSubscriber named by this subscription.
+   *
+   * The lookup is cached until an EventSubscriber is registered or removed,
+   * so a publisher firing events does not search the EventFactory for every
+   * event and subscription.
+   */
+  EventSubscriberRef getSubscriber() const;
+
  public:
   Subscription() = delete;
+
+ private:
+  /// Protects the cached subscriber, publishers may fire from many threads.
+  mutable Mutex subscriber_lock_;
+
+  /// The resolved subscriber, which may be nullptr.
+  mutable EventSubscriberRef subscriber_;
+
+  /// The EventFactory subscriber generation the cache was resolved for.
+  mutable size_t subscriber_generation_{0};
 };
 
 } // namespace osquery
@@ -453,4 +453,42 @@ TEST_F(FSEventsTests, test_fsevents_embedded_wildcards) {
   s = EventFactory::deregisterEventPublisher("fsevents");
   ASSERT_TRUE(s.ok());
 }
+TEST_F(FSEventsTests, test_fsevents_coalesce_events) {
+  event_pub_ = std::make_shared<FSEventsEventPublisher>();
+  auto s = EventFactory::registerEventPublisher(event_pub_);
+  ASSERT_TRUE(s.ok());
+
+  auto sub = std::make_shared<TestFSEventsEventSubscriber>();
+  s = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(s.ok());
+
+  auto sc = sub->GetSubscription(real_test_dir + "/*");
+  sub->subscribe(&TestFSEventsEventSubscriber::Callback, sc);
+  event_pub_->configure();
+
+  // A burst of writes to one file reports the earlier actions again.
+  auto file = real_test_dir + "/file";
+  auto nested = real_test_dir + "/build/object.o";
+  const char* paths[] = {
+      file.c_str(), file.c_str(), file.c_str(), nested.c_str()};
+  FSEventStreamEventFlags flags[] = {
+      kFSEventStreamEventFlagItemCreated,
+      kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemModified,
+      kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemModified,
+      kFSEventStreamEventFlagItemCreated,
+  };
+  FSEventStreamEventId ids[] = {1, 2, 3, 4};
+  FSEventsEventPublisher::Callback(
+      nullptr, event_pub_.get(), 4, paths, flags, ids);
+
+  // The nested path is below the watch but cannot match the subscription.
+  {
+    WriteLock lock(sub->mutex_);
+    std::vector<std::string> expected = {"CREATED", "UPDATED"};
+    EXPECT_EQ(sub->actions_, expected);
+  }
+
+  s = EventFactory::deregisterEventPublisher("fsevents");
+  ASSERT_TRUE(s.ok());
+}
 }
@@ -19,11 +19,22 @@
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/events.h>
 #include <osquery/events/eventsubscriber.h>
+#include <osquery/experimental/events_stream/events_stream.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/info/tool_type.h>
 
+#include "osquery/events/pathset.h"
+
 namespace osquery {
 
+DECLARE_uint64(events_queue_max);
+DECLARE_string(events_rollup);
+DECLARE_string(events_rollup_ignore);
+DECLARE_string(events_rate_limit);
+DECLARE_string(events_sample);
+DECLARE_string(events_limit_key);
+DECLARE_string(events_streaming_plugin);
+
 class EventsTests : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -553,6 +564,227 @@ TEST_F(EventsTests, test_fire_event) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(EventsTests, test_fire_batch) {
+  auto pub = std::make_shared<BasicEventPublisher>();
+  pub->setName("BasicPublisher");
+  auto status = EventFactory::registerEventPublisher(pub);
+  ASSERT_TRUE(status.ok());
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  auto subscription = Subscription::create("fake_events");
+  subscription->callback = TestTheeCallback;
+  status = EventFactory::addSubscription("BasicPublisher", subscription);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(subscription->getSubscriber(), sub);
+
+  std::vector<EventContextRef> ecs = {pub->createEventContext(),
+                                      pub->createEventContext()};
+  kBellHathTolled = 0;
+  pub->fireBatch(ecs);
+  EXPECT_EQ(kBellHathTolled, 2);
+  EXPECT_NE(ecs[0]->id, ecs[1]->id);
+  EXPECT_NE(ecs[0]->time, 0U);
+
+  // Removing the subscriber invalidates the cached lookup.
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(subscription->getSubscriber(), nullptr);
+
+  pub->fireBatch(ecs);
+  EXPECT_EQ(kBellHathTolled, 2);
+
+  status = EventFactory::deregisterEventPublisher(pub->type());
+  EXPECT_TRUE(status.ok());
+}
+
+TEST_F(EventsTests, test_event_queue) {
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  auto status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  // Queue rows without a worker, the test stores them.
+  auto queue_max = FLAGS_events_queue_max;
+  FLAGS_events_queue_max = 2;
+  sub->event_queue_.enabled = true;
+
+  std::vector<Row> row_list = {{{"value", "1"}}, {{"value", "2"}}};
+  EXPECT_TRUE(sub->addBatch(row_list).ok());
+  EXPECT_TRUE(row_list.empty());
+
+  // A full queue drops and counts the rows.
+  row_list = {{{"value", "3"}}};
+  EXPECT_FALSE(sub->addBatch(row_list).ok());
+  EXPECT_EQ(sub->numDroppedEvents(), 1U);
+  EXPECT_EQ(sub->numEvents(), 0U);
+
+  sub->storeQueuedEvents();
+  EXPECT_EQ(sub->numEvents(), 2U);
+
+  // The queue has room again.
+  EXPECT_TRUE(sub->addBatch(row_list).ok());
+  sub->storeQueuedEvents();
+  EXPECT_EQ(sub->numEvents(), 3U);
+
+  FLAGS_events_queue_max = queue_max;
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+}
+
+TEST_F(EventsTests, test_event_rollup) {
+  auto rollup = FLAGS_events_rollup;
+  auto rollup_ignore = FLAGS_events_rollup_ignore;
+  FLAGS_events_rollup = "other_events,fake_events";
+  FLAGS_events_rollup_ignore = "pid";
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  auto status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(sub->rollup_.enabled);
+
+  // Rows equal but for the ignored columns are counted, not stored.
+  std::vector<Row> row_list = {
+      {{"path", "/a"}, {"pid", "1"}, {"uptime", "10"}},
+      {{"path", "/a"}, {"pid", "2"}, {"uptime", "11"}},
+      {{"path", "/b"}, {"pid", "3"}, {"uptime", "12"}},
+  };
+  EXPECT_TRUE(sub->addBatch(row_list).ok());
+  row_list = {{{"path", "/a"}, {"pid", "4"}}};
+  EXPECT_TRUE(sub->addBatch(row_list).ok());
+  EXPECT_EQ(sub->numEvents(), 0U);
+
+  // Ending the window stores each distinct row once.
+  EXPECT_TRUE(sub->flushRollup(true).ok());
+  EXPECT_EQ(sub->numEvents(), 2U);
+
+  std::map<std::string, Row> stored_rows;
+  EventSubscriberPlugin::generateRows(
+      sub->context,
+      getOsqueryDatabase(),
+      [&stored_rows](Row row) { stored_rows[row["path"]] = std::move(row); },
+      0,
+      0);
+  ASSERT_EQ(stored_rows.size(), 2U);
+  EXPECT_EQ(stored_rows["/a"]["rollup_count"], "3");
+  EXPECT_EQ(stored_rows["/b"]["rollup_count"], "1");
+  EXPECT_EQ(stored_rows["/a"].count("pid"), 0U);
+  EXPECT_EQ(stored_rows["/a"].count("uptime"), 0U);
+  EXPECT_FALSE(stored_rows["/a"]["rollup_last_time"].empty());
+
+  // Nothing is left to store.
+  EXPECT_TRUE(sub->flushRollup(true).ok());
+  EXPECT_EQ(sub->numEvents(), 2U);
+
+  FLAGS_events_rollup = rollup;
+  FLAGS_events_rollup_ignore = rollup_ignore;
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+}
+
+class BatchEventsStreamPlugin : public EventsStreamPlugin {
+ public:
+  Status streamEvents(const events::SerializedEvents& events) override {
+    batches++;
+    source = events.source;
+    for (size_t i = 0; i < events.size(); ++i) {
+      streamed.emplace_back(events.at(i));
+    }
+    return Status::success();
+  }
+
+  size_t batches{0};
+  std::string source;
+  std::vector<std::string> streamed;
+};
+
+TEST_F(EventsTests, test_event_streaming) {
+  events::SerializedEvents batch;
+  batch.add("{\"a\":1}");
+  batch.add("");
+  batch.add("{\"b\":2}");
+  ASSERT_EQ(batch.size(), 3U);
+  EXPECT_EQ(batch.at(0), "{\"a\":1}");
+  EXPECT_TRUE(batch.at(1).empty());
+  EXPECT_EQ(batch.at(2), "{\"b\":2}");
+
+  auto& registry = RegistryFactory::get();
+  auto plugin = std::make_shared<BatchEventsStreamPlugin>();
+  registry.registry(events::streamRegistryName())
+      ->add("batch_stream", plugin);
+
+  auto streaming_plugin = FLAGS_events_streaming_plugin;
+  FLAGS_events_streaming_plugin = "batch_stream";
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  auto status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  // Each stored batch of rows is streamed with one call.
+  std::vector<Row> row_list = {{{"value", "1"}}, {{"value", "2"}}};
+  EXPECT_TRUE(sub->addBatch(row_list).ok());
+  EXPECT_EQ(plugin->batches, 1U);
+  EXPECT_EQ(plugin->source, "fake_events");
+  ASSERT_EQ(plugin->streamed.size(), 2U);
+  EXPECT_NE(plugin->streamed[0].find("\"value\":\"1\""), std::string::npos);
+  EXPECT_NE(plugin->streamed[1].find("\"value\":\"2\""), std::string::npos);
+  EXPECT_NE(plugin->streamed[1].back(), '\n');
+
+  FLAGS_events_streaming_plugin = streaming_plugin;
+  registry.registry(events::streamRegistryName())->remove("batch_stream");
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+}
+
+TEST_F(EventsTests, test_event_limits) {
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  sub->configureLimits();
+  EXPECT_FALSE(sub->limits_.enabled);
+
+  // Each path has a burst of 3 rows, refilled at 1 row per second.
+  auto rate_limit = FLAGS_events_rate_limit;
+  auto limit_key = FLAGS_events_limit_key;
+  FLAGS_events_rate_limit = "other_events:10,fake_events:1:3";
+  FLAGS_events_limit_key = "fake_events:path";
+  sub->configureLimits();
+  EXPECT_TRUE(sub->limits_.enabled);
+
+  std::vector<Row> row_list;
+  for (size_t i = 0; i < 5; i++) {
+    row_list.push_back({{"path", "/a"}, {"pid", std::to_string(i)}});
+  }
+  row_list.push_back({{"path", "/b"}, {"pid", "5"}});
+  sub->limitBatch(row_list);
+  ASSERT_EQ(row_list.size(), 4U);
+  EXPECT_EQ(row_list[2]["pid"], "2");
+  EXPECT_EQ(row_list[3]["path"], "/b");
+  EXPECT_EQ(sub->numLimitedEvents(), 2U);
+  EXPECT_EQ(sub->numSampledOutEvents(), 0U);
+
+  // Sampling keeps the first of every 3 rows of the subscriber.
+  auto sample = FLAGS_events_sample;
+  FLAGS_events_rate_limit = "";
+  FLAGS_events_limit_key = "";
+  FLAGS_events_sample = "fake_events:3";
+  sub->configureLimits();
+
+  row_list.clear();
+  for (size_t i = 0; i < 7; i++) {
+    row_list.push_back({{"pid", std::to_string(i)}});
+  }
+  sub->limitBatch(row_list);
+  ASSERT_EQ(row_list.size(), 3U);
+  EXPECT_EQ(row_list[0]["pid"], "0");
+  EXPECT_EQ(row_list[1]["pid"], "3");
+  EXPECT_EQ(row_list[2]["pid"], "6");
+  EXPECT_EQ(sub->numSampledOutEvents(), 4U);
+
+  FLAGS_events_rate_limit = rate_limit;
+  FLAGS_events_limit_key = limit_key;
+  FLAGS_events_sample = sample;
+}
+
 class SubFakeEventSubscriber : public FakeEventSubscriber {
  public:
   SubFakeEventSubscriber() : FakeEventSubscriber(true) {
@@ -598,4 +830,35 @@ TEST_F(EventsTests, test_event_toggle_subscribers) {
   status = EventFactory::deregisterEventSubscriber(sub->getName());
   EXPECT_TRUE(status.ok());
 }
+TEST_F(EventsTests, test_path_trie) {
+  PathTrie trie;
+  EXPECT_TRUE(trie.empty());
+  trie.insert("/etc/ssh/%%");
+  trie.insert("/etc/ssl/openssl.cnf");
+  trie.insert("/var/%/log");
+  trie.insert("/tmp/%");
+
+  EXPECT_TRUE(trie.find("/etc/ssh"));
+  EXPECT_TRUE(trie.find("/etc/ssh/sshd_config"));
+  EXPECT_TRUE(trie.find("/etc/ssl/openssl.cnf"));
+  EXPECT_FALSE(trie.find("/etc/ssl"));
+  EXPECT_TRUE(trie.find("/var/db/log"));
+  EXPECT_FALSE(trie.find("/var/db/log/system.log"));
+  // A trailing wildcard matches everything below it, as a PathSet does.
+  EXPECT_TRUE(trie.find("/tmp/a/b"));
+  EXPECT_FALSE(trie.find("/tmp"));
+  EXPECT_FALSE(trie.find("/ETC/ssh"));
+
+  PathTrie folded(false);
+  folded.insert({"Users", "*"}, false);
+  folded.insert({"Library"}, true);
+  EXPECT_TRUE(folded.find("/users/admin"));
+  EXPECT_FALSE(folded.find("/Users/admin/Desktop"));
+  EXPECT_TRUE(folded.find("/library/Caches/a"));
+  EXPECT_FALSE(folded.find("/Library"));
+
+  trie.clear();
+  EXPECT_TRUE(trie.empty());
+  EXPECT_FALSE(trie.find("/etc/ssh"));
+}
 } // namespace osquery
@@ -54,6 +54,52 @@ TEST_F(EventSubscriberPluginTests, generateEventDataIndex) {
   EXPECT_EQ(context.event_index.size(), 10U);
 }
 
+TEST_F(EventSubscriberPluginTests, serializeEventRow) {
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  Row row = {{"eid", "1"}, {"path", "/tmp"}, {"time", "10"}};
+  std::string serialized_row;
+  std::pair<std::string, std::string> new_schema;
+  auto status = EventSubscriberPlugin::serializeEventRow(
+      context, row, serialized_row, new_schema);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(isBinaryRow(serialized_row));
+  EXPECT_EQ(new_schema.first, "schema.type.name.1");
+  EXPECT_EQ(new_schema.second, "eid\npath\ntime");
+
+  // The same columns reuse the schema.
+  Row second_row = {{"eid", "2"}, {"path", ""}, {"time", "11"}};
+  std::string second_serialized_row;
+  new_schema = {};
+  status = EventSubscriberPlugin::serializeEventRow(
+      context, second_row, second_serialized_row, new_schema);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(new_schema.first.empty());
+
+  Row output;
+  status = EventSubscriberPlugin::deserializeEventRow(
+      context, second_serialized_row, output);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(output, second_row);
+
+  // Rows stored before the binary encoding are still readable.
+  std::string json_row;
+  ASSERT_TRUE(serializeRowJSON(row, json_row).ok());
+  output.clear();
+  status =
+      EventSubscriberPlugin::deserializeEventRow(context, json_row, output);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(output, row);
+
+  // A row referencing an unknown schema cannot be decoded.
+  EventSubscriberPlugin::Context other_context;
+  output.clear();
+  status = EventSubscriberPlugin::deserializeEventRow(
+      other_context, serialized_row, output);
+  EXPECT_FALSE(status.ok());
+}
+
 TEST_F(EventSubscriberPluginTests, toIndex) {
   auto index = EventSubscriberPlugin::toIndex(1);
   EXPECT_EQ(index, "0000000001");
@@ -185,6 +231,72 @@ TEST_F(EventSubscriberPluginTests, expireEventBatches) {
   EXPECT_EQ(context.event_index.size(), 5U);
 }
 
+TEST_F(EventSubscriberPluginTests, deleteEventBatches) {
+  MockedOsqueryDatabase mocked_database;
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  mocked_database.key_map.clear();
+  for (EventID event_id = 1U; event_id <= 8U; ++event_id) {
+    auto key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    mocked_database.key_map.insert({key, "value"});
+  }
+
+  // Identifiers 1-3 and 6-7 are contiguous, 5 is on its own
+  EventIndex event_batch_list;
+  event_batch_list.add(1U, EventIDList{1U, 2U});
+  event_batch_list.add(2U, EventIDList{5U, 3U});
+  event_batch_list.add(4U, EventIDList{6U, 7U});
+  auto error_count = EventSubscriberPlugin::deleteEventBatches(
+      context, mocked_database, event_batch_list);
+
+  EXPECT_EQ(error_count, 0U);
+  ASSERT_EQ(mocked_database.key_map.size(), 2U);
+  EXPECT_EQ(mocked_database.key_map.count(
+                EventSubscriberPlugin::databaseKeyForEventId(context, 4U)),
+            1U);
+  EXPECT_EQ(mocked_database.key_map.count(
+                EventSubscriberPlugin::databaseKeyForEventId(context, 8U)),
+            1U);
+}
+
+TEST_F(EventSubscriberPluginTests, eventIndex) {
+  EventIndex event_index;
+  event_index.add(10U, EventIDList{1U, 2U, 3U});
+  event_index.add(12U, 4U);
+  event_index.add(10U, 5U);
+  event_index.add(11U, 6U);
+  event_index.add(12U, 7U);
+
+  ASSERT_EQ(event_index.size(), 3U);
+  EXPECT_EQ(event_index.eventCount(), 7U);
+
+  // Contiguous identifiers share a range.
+  const auto& first_batch = *event_index.begin();
+  EXPECT_EQ(first_batch.time(), 10U);
+  EXPECT_EQ(first_batch.size(), 4U);
+  ASSERT_EQ(first_batch.rangeCount(), 2U);
+  EXPECT_EQ(first_batch.range(0).first, 1U);
+  EXPECT_EQ(first_batch.range(0).last, 3U);
+  EXPECT_EQ(first_batch.range(1).first, 5U);
+
+  EXPECT_EQ(event_index.lowerBound(11U)->time(), 11U);
+  EXPECT_EQ(event_index.upperBound(11U)->time(), 12U);
+  EXPECT_EQ(event_index.lowerBound(13U), event_index.end());
+
+  auto expired = event_index.removeUntil(11U);
+  EXPECT_EQ(expired.size(), 2U);
+  EXPECT_EQ(expired.eventCount(), 5U);
+  ASSERT_EQ(event_index.size(), 1U);
+  EXPECT_EQ(event_index.eventCount(), 2U);
+
+  auto oldest = event_index.removeOldest(5U);
+  EXPECT_EQ(oldest.size(), 1U);
+  EXPECT_TRUE(event_index.empty());
+  EXPECT_EQ(event_index.eventCount(), 0U);
+}
+
 TEST_F(EventSubscriberPluginTests, generateRows) {
   MockedOsqueryDatabase mocked_database;
   EXPECT_EQ(mocked_database.key_map.size(), 20U);
@@ -15,11 +15,13 @@
 #include <ctime>
 
 #include <sstream>
+#include <stdexcept>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 
 #include "osquery/events/linux/auditdnetlink.h"
+#include "osquery/events/linux/auditeventpublisher.h"
 #include "osquery/tests/test_util.h"
 
 namespace osquery {
@@ -73,10 +75,10 @@ TEST_F(AuditTests, test_handle_reply) {
   EXPECT_EQ("1440542781.644:403030", audit_event_record.audit_id);
   EXPECT_EQ(audit_event_record.fields.size(), 4U);
   EXPECT_EQ(audit_event_record.fields.count("argc"), 1U);
-  EXPECT_EQ(audit_event_record.fields["argc"], "3");
-  EXPECT_EQ(audit_event_record.fields["a0"], "\"H=1 \"");
-  EXPECT_EQ(audit_event_record.fields["a1"], "\"/bin/sh\"");
-  EXPECT_EQ(audit_event_record.fields["a2"], "c");
+  EXPECT_EQ(audit_event_record.fields.at("argc").to_string(), "3");
+  EXPECT_EQ(audit_event_record.fields.at("a0").to_string(), "\"H=1 \"");
+  EXPECT_EQ(audit_event_record.fields.at("a1").to_string(), "\"/bin/sh\"");
+  EXPECT_EQ(audit_event_record.fields.at("a2").to_string(), "c");
 }
 
 TEST_F(AuditTests, test_audit_value_decode) {
@@ -133,4 +135,103 @@ TEST_F(AuditTests, test_parse_sock_addr) {
   EXPECT_EQ(r4["socket"], "/tmp/osquery.em");
   FLAGS_audit_allow_unix = socket_flag;
 }
+
+TEST_F(AuditTests, test_audit_field_map) {
+  AuditFieldMap copy;
+  {
+    AuditFieldMap fields;
+    fields.parse("pid=1 flag  name=\"a b\" pid=2 empty=");
+    copy = fields;
+  }
+
+  // Copies share the message the fields point into
+  ASSERT_EQ(copy.size(), 4U);
+  EXPECT_EQ(copy.at("pid").to_string(), "1");
+  EXPECT_EQ(copy.at("name").to_string(), "\"a b\"");
+  EXPECT_EQ(copy.count("flag"), 1U);
+  EXPECT_TRUE(copy.at("flag").empty());
+  EXPECT_TRUE(copy.at("empty").empty());
+  EXPECT_EQ(copy.find("missing"), copy.end());
+  EXPECT_THROW(copy.at("missing"), std::out_of_range);
+
+  // Fields are iterated in key order
+  std::vector<std::string> keys;
+  for (const auto& field : copy) {
+    keys.push_back(field.first.to_string());
+  }
+  EXPECT_EQ(keys, std::vector<std::string>({"empty", "flag", "name", "pid"}));
+}
+
+TEST_F(AuditTests, test_audit_serial) {
+  auto l_makeReply = [](const std::string& message) -> audit_reply {
+    audit_reply reply = {};
+    reply.msg.nlh.nlmsg_len = static_cast<std::uint32_t>(message.size());
+    memcpy(reply.msg.data, message.c_str(), message.size());
+    return reply;
+  };
+
+  auto reply = l_makeReply("audit(1440542781.644:403030): argc=3 a0=ls");
+  EXPECT_EQ(AuditdNetlinkReader::GetAuditSerial(reply), 403030U);
+
+  // Records without an event id are all in the first partition
+  reply = l_makeReply("enabled=1 failure=1");
+  EXPECT_EQ(AuditdNetlinkReader::GetAuditSerial(reply), 0U);
+
+  reply = l_makeReply("audit(1440542781.644:40x030): argc=3");
+  EXPECT_EQ(AuditdNetlinkReader::GetAuditSerial(reply), 0U);
+
+  // The length bounds the message, the id must be complete
+  reply = l_makeReply("audit(1440542781.644:403030): argc=3");
+  reply.msg.nlh.nlmsg_len = 20;
+  EXPECT_EQ(AuditdNetlinkReader::GetAuditSerial(reply), 0U);
+}
+
+TEST_F(AuditTests, test_auditd_queue) {
+  AuditdQueue<std::vector<int>> queue(2);
+  EXPECT_TRUE(queue.empty());
+
+  std::vector<int> batch = {1, 2};
+  EXPECT_TRUE(queue.push(batch));
+  batch = {3};
+  EXPECT_TRUE(queue.push(batch));
+
+  // A full queue leaves the batch with the producer
+  batch = {4};
+  EXPECT_FALSE(queue.push(batch));
+  EXPECT_EQ(batch, std::vector<int>({4}));
+
+  std::vector<int> popped;
+  EXPECT_TRUE(queue.pop(popped));
+  EXPECT_EQ(popped, std::vector<int>({1, 2}));
+  EXPECT_TRUE(queue.push(batch));
+
+  EXPECT_TRUE(queue.pop(popped));
+  EXPECT_EQ(popped, std::vector<int>({3}));
+  EXPECT_TRUE(queue.pop(popped));
+  EXPECT_EQ(popped, std::vector<int>({4}));
+  EXPECT_FALSE(queue.pop(popped));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(AuditTests, test_trace_context_expire) {
+  AuditTraceContext trace_context;
+  trace_context.expire(1000);
+
+  trace_context.insert("1000.000:1", AuditEvent{});
+  trace_context.expire(1100);
+  EXPECT_NE(trace_context.find("1000.000:1"), nullptr);
+
+  // The event survives one generation, records may still be appended
+  trace_context.expire(1150);
+  trace_context.insert("1150.000:2", AuditEvent{});
+  ASSERT_NE(trace_context.find("1000.000:1"), nullptr);
+  EXPECT_EQ(trace_context.size(), 2U);
+
+  trace_context.expire(1300);
+  EXPECT_EQ(trace_context.find("1000.000:1"), nullptr);
+  EXPECT_NE(trace_context.find("1150.000:2"), nullptr);
+
+  trace_context.erase("1150.000:2");
+  EXPECT_EQ(trace_context.size(), 0U);
+}
 }
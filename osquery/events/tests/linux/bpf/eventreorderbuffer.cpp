@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "bpftestsmain.h"
+
+#include <osquery/events/linux/bpf/eventreorderbuffer.h>
+
+namespace osquery {
+
+namespace {
+
+struct TestEvent final {
+  std::uint64_t timestamp;
+  std::size_t cpu;
+};
+
+std::uint64_t getTestEventTimestamp(const TestEvent& event) {
+  return event.timestamp;
+}
+
+using TestEventReorderBuffer = EventReorderBuffer<TestEvent>;
+
+std::vector<std::uint64_t> popTimestamps(TestEventReorderBuffer& buffer,
+                                         std::uint64_t cutoff) {
+  std::vector<std::uint64_t> timestamps;
+  buffer.pop(cutoff, [&timestamps](TestEvent event) {
+    timestamps.push_back(event.timestamp);
+  });
+  return timestamps;
+}
+
+} // namespace
+
+TEST_F(EventReorderBufferTests, merge_perf_buffer_runs) {
+  TestEventReorderBuffer buffer(&getTestEventTimestamp);
+
+  // Each batch holds the ordered events of two CPUs, one after the other.
+  buffer.push({{10, 0}, {30, 0}, {50, 0}, {20, 1}, {40, 1}});
+  buffer.push({{60, 0}, {80, 0}, {45, 1}, {70, 1}});
+  EXPECT_EQ(buffer.size(), 9U);
+
+  // The runs of the second batch continue the sequences of the first.
+  EXPECT_EQ(buffer.sequences(), 2U);
+
+  // Only the events before the cutoff are released, in timestamp order.
+  auto timestamps = popTimestamps(buffer, 50);
+  EXPECT_EQ(timestamps, std::vector<std::uint64_t>({10, 20, 30, 40, 45}));
+  EXPECT_EQ(buffer.size(), 4U);
+
+  timestamps = popTimestamps(buffer, 100);
+  EXPECT_EQ(timestamps, std::vector<std::uint64_t>({50, 60, 70, 80}));
+  EXPECT_EQ(buffer.size(), 0U);
+  EXPECT_EQ(buffer.sequences(), 0U);
+}
+
+TEST_F(EventReorderBufferTests, duplicate_timestamps) {
+  TestEventReorderBuffer buffer(&getTestEventTimestamp);
+
+  // Events sharing a timestamp are all kept.
+  buffer.push({{10, 0}, {10, 0}, {10, 1}});
+  auto timestamps = popTimestamps(buffer, 11);
+  EXPECT_EQ(timestamps, std::vector<std::uint64_t>({10, 10, 10}));
+}
+
+TEST_F(EventReorderBufferTests, late_run) {
+  TestEventReorderBuffer buffer(&getTestEventTimestamp);
+
+  buffer.push({{100, 0}, {200, 0}});
+  EXPECT_EQ(popTimestamps(buffer, 150), std::vector<std::uint64_t>({100}));
+
+  // A run older than every sequence tail starts a new sequence.
+  buffer.push({{120, 1}, {130, 1}});
+  EXPECT_EQ(buffer.sequences(), 2U);
+  EXPECT_EQ(popTimestamps(buffer, 1000),
+            std::vector<std::uint64_t>({120, 130, 200}));
+}
+
+} // namespace osquery
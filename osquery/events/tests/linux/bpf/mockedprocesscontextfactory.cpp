@@ -98,4 +98,12 @@ bool MockedProcessContextFactory::captureAllProcesses(
   return true;
 }
 
+bool MockedProcessContextFactory::processExists(pid_t process_id) const {
+  return exited_processes.count(process_id) == 0U;
+}
+
+void MockedProcessContextFactory::setExitedProcess(pid_t process_id) {
+  exited_processes.insert(process_id);
+}
+
 } // namespace osquery
@@ -11,6 +11,8 @@
 
 #include <osquery/events/linux/bpf/iprocesscontextfactory.h>
 
+#include <unordered_set>
+
 namespace osquery {
 
 class MockedProcessContextFactory final : public IProcessContextFactory {
@@ -27,9 +29,14 @@ class MockedProcessContextFactory final : public IProcessContextFactory {
   virtual bool captureAllProcesses(
       ProcessContextMap& process_map) const override;
 
+  virtual bool processExists(pid_t process_id) const override;
+
+  void setExitedProcess(pid_t process_id);
+
  private:
   mutable bool fail_next_request{false};
   mutable std::size_t invocation_count{false};
+  std::unordered_set<pid_t> exited_processes;
 };
 
 } // namespace osquery
@@ -216,6 +216,33 @@ TEST_F(SystemStateTrackerTests, create_process) {
   EXPECT_TRUE(std::holds_alternative<std::monostate>(fork_event2.data));
 }
 
+TEST_F(SystemStateTrackerTests, create_process_with_reused_pid) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  auto bpf_event_header = kBaseBPFEventHeader;
+  bpf_event_header.process_id = 1001;
+  bpf_event_header.exit_code = 0;
+
+  SystemStateTracker::Context context;
+  ASSERT_TRUE(SystemStateTracker::createProcess(
+      context, *process_context_factory.get(), bpf_event_header, 1000, 1001));
+
+  // The exit of pid 1001 was never seen, its state is stale
+  auto& stale_process = context.process_map.at(1001);
+  stale_process.binary_path = "/usr/bin/stale";
+  stale_process.fd_map.clear();
+
+  // A new process reusing the pid inherits from its real parent
+  ASSERT_TRUE(SystemStateTracker::createProcess(
+      context, *process_context_factory.get(), bpf_event_header, 1000, 1001));
+
+  const auto& parent_process = context.process_map.at(1000);
+  const auto& child_process = context.process_map.at(1001);
+  EXPECT_EQ(child_process.binary_path, parent_process.binary_path);
+  EXPECT_EQ(child_process.fd_map.size(), parent_process.fd_map.size());
+}
+
 TEST_F(SystemStateTrackerTests, execute_binary_with_absolute_path) {
   auto bpf_event_header = kBaseBPFEventHeader;
   bpf_event_header.process_id = 1001;
@@ -1363,4 +1390,56 @@ TEST_F(SystemStateTrackerTests, expireFileHandleEntries) {
   EXPECT_EQ(context.file_handle_struct_map.size(), 1U);
   EXPECT_EQ(context.file_handle_struct_index.size(), 1U);
 }
+
+TEST_F(SystemStateTrackerTests, expireProcessContexts) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  SystemStateTracker::Context context;
+  for (pid_t process_id = 1; process_id <= 8; ++process_id) {
+    context.process_map.insert({process_id, ProcessContext{}});
+  }
+
+  process_context_factory->setExitedProcess(3);
+
+  // No limit
+  SystemStateTracker::expireProcessContexts(
+      context, *process_context_factory.get(), 100);
+  EXPECT_EQ(context.process_map.size(), 8U);
+
+  // Replacing a tracked process does not grow the map
+  context.max_process_contexts = 8U;
+  SystemStateTracker::expireProcessContexts(
+      context, *process_context_factory.get(), 1);
+  EXPECT_EQ(context.process_map.size(), 8U);
+
+  // Exited processes go first, then enough contexts to leave some room
+  SystemStateTracker::expireProcessContexts(
+      context, *process_context_factory.get(), 100);
+  EXPECT_EQ(context.process_map.count(3), 0U);
+  EXPECT_EQ(context.process_map.size(), 5U);
+
+  SystemStateTracker::expireProcessContexts(
+      context, *process_context_factory.get(), 100);
+  EXPECT_EQ(context.process_map.size(), 5U);
+}
+
+TEST_F(SystemStateTrackerTests, lazy_process_contexts) {
+  auto state_tracker_ref = SystemStateTracker::create(
+      std::make_unique<MockedProcessContextFactory>(), false, 0U);
+  ASSERT_NE(state_tracker_ref, nullptr);
+
+  auto& state_tracker =
+      static_cast<SystemStateTracker&>(*state_tracker_ref.get());
+
+  EXPECT_TRUE(state_tracker.getContextCopy().process_map.empty());
+
+  // The process is captured on its first event
+  EXPECT_TRUE(state_tracker.setWorkingDirectory(1000, "/tmp"));
+
+  auto context = state_tracker.getContextCopy();
+  ASSERT_EQ(context.process_map.size(), 1U);
+  EXPECT_EQ(context.process_map.at(1000).binary_path, "/usr/bin/zsh");
+  EXPECT_EQ(context.process_map.at(1000).cwd, "/tmp");
+}
 } // namespace osquery
@@ -8,6 +8,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
@@ -525,6 +526,38 @@ TEST_F(INotifyTests, DISABLED_test_inotify_recursion) {
   EventFactory::deregisterEventPublisher("inotify");
 }
 
+TEST_F(INotifyTests, test_inotify_coalesce_modify) {
+  event_pub_ = std::make_shared<INotifyEventPublisher>(true);
+  EventFactory::registerEventPublisher(event_pub_);
+
+  FILE* fd = fopen(real_test_path.c_str(), "w");
+  fclose(fd);
+  addMonitor(real_test_path, 0, false, true);
+  ASSERT_EQ(event_pub_->path_descriptors_.count(real_test_path), 1U);
+  auto wd = event_pub_->path_descriptors_.at(real_test_path);
+
+  // Repeated modifications are coalesced until another action is seen.
+  std::vector<uint32_t> masks = {
+      IN_MODIFY, IN_MODIFY, IN_MODIFY, IN_CLOSE_WRITE, IN_MODIFY};
+  std::vector<char> buffer(masks.size() * sizeof(struct inotify_event));
+  for (size_t i = 0; i < masks.size(); i++) {
+    struct inotify_event event {};
+    event.wd = wd;
+    event.mask = masks[i];
+    memcpy(&buffer[i * sizeof(event)], &event, sizeof(event));
+  }
+
+  auto event_contexts =
+      event_pub_->processEventBuffer(buffer.data(), buffer.size());
+  ASSERT_EQ(event_contexts.size(), 3U);
+
+  auto ec = std::static_pointer_cast<INotifyEventContext>(event_contexts[1]);
+  EXPECT_EQ(ec->event.mask, static_cast<uint32_t>(IN_CLOSE_WRITE));
+  EXPECT_EQ(ec->path, real_test_path);
+
+  EventFactory::deregisterEventPublisher("inotify");
+}
+
 TEST_F(INotifyTests, test_inotify_embedded_wildcards) {
   // Assume event type is not registered.
   event_pub_ = std::make_shared<INotifyEventPublisher>(true);
@@ -551,4 +584,39 @@ TEST_F(INotifyTests, test_inotify_embedded_wildcards) {
   ASSERT_EQ(event_pub_->numDescriptors(), 1U);
   EXPECT_EQ(event_pub_->path_descriptors_.count(real_test_dir + "/2/1/"), 1U);
 }
+
+TEST_F(INotifyTests, test_fanotify_path_subscribed) {
+  INotifySubscriptionContext sc;
+
+  // A file subscription matches only that path.
+  sc.path = "/etc/passwd";
+  EXPECT_TRUE(INotifyEventPublisher::isPathSubscribed(sc, "/etc/passwd"));
+  EXPECT_FALSE(INotifyEventPublisher::isPathSubscribed(sc, "/etc/passwd-"));
+
+  // A directory matches itself and its entries.
+  sc.path = "/etc/";
+  EXPECT_TRUE(INotifyEventPublisher::isPathSubscribed(sc, "/etc"));
+  EXPECT_TRUE(INotifyEventPublisher::isPathSubscribed(sc, "/etc/hosts"));
+  EXPECT_FALSE(
+      INotifyEventPublisher::isPathSubscribed(sc, "/etc/ssh/sshd_config"));
+  EXPECT_FALSE(INotifyEventPublisher::isPathSubscribed(sc, "/etcetera"));
+
+  // A recursive directory matches everything below it.
+  sc.recursive = true;
+  EXPECT_TRUE(
+      INotifyEventPublisher::isPathSubscribed(sc, "/etc/ssh/sshd_config"));
+  EXPECT_FALSE(INotifyEventPublisher::isPathSubscribed(sc, "/etcetera/1"));
+
+  // Wildcards match within a path component.
+  sc.recursive = false;
+  sc.path = "/home/*/.ssh/";
+  EXPECT_TRUE(INotifyEventPublisher::isPathSubscribed(
+      sc, "/home/user/.ssh/authorized_keys"));
+  EXPECT_FALSE(INotifyEventPublisher::isPathSubscribed(
+      sc, "/home/user/1/.ssh/authorized_keys"));
+
+  sc.path = "/var/log/*.log";
+  EXPECT_TRUE(INotifyEventPublisher::isPathSubscribed(sc, "/var/log/1.log"));
+  EXPECT_FALSE(INotifyEventPublisher::isPathSubscribed(sc, "/var/log/1.txt"));
+}
 }
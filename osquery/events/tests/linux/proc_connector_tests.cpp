@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+
+#include <gtest/gtest.h>
+
+#include <osquery/events/linux/proc_connector.h>
+
+namespace osquery {
+
+class ProcConnectorTests : public testing::Test {
+ protected:
+  /// Append a process connector message to a read buffer.
+  void addMessage(std::vector<char>& buffer, const struct proc_event& event) {
+    auto offset = buffer.size();
+    auto length = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(event));
+    buffer.resize(offset + NLMSG_ALIGN(length));
+
+    auto header = reinterpret_cast<struct nlmsghdr*>(buffer.data() + offset);
+    header->nlmsg_len = length;
+    header->nlmsg_type = NLMSG_DONE;
+
+    auto message = static_cast<struct cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(event);
+    memcpy(message->data, &event, sizeof(event));
+  }
+
+  struct proc_event makeEvent(enum proc_event::what what) {
+    struct proc_event event;
+    memset(&event, 0, sizeof(event));
+    event.what = what;
+    event.timestamp_ns = 5000000000ULL;
+    return event;
+  }
+};
+
+TEST_F(ProcConnectorTests, test_parse_messages) {
+  std::vector<char> buffer;
+
+  auto fork = makeEvent(proc_event::PROC_EVENT_FORK);
+  fork.event_data.fork.parent_pid = 10;
+  fork.event_data.fork.parent_tgid = 10;
+  fork.event_data.fork.child_pid = 11;
+  fork.event_data.fork.child_tgid = 11;
+  addMessage(buffer, fork);
+
+  // A new thread of the parent.
+  fork.event_data.fork.child_pid = 12;
+  fork.event_data.fork.child_tgid = 10;
+  addMessage(buffer, fork);
+
+  auto exec = makeEvent(proc_event::PROC_EVENT_EXEC);
+  exec.event_data.exec.process_pid = 11;
+  exec.event_data.exec.process_tgid = 11;
+  addMessage(buffer, exec);
+
+  // Events without a publisher action are dropped.
+  auto uid = makeEvent(proc_event::PROC_EVENT_UID);
+  addMessage(buffer, uid);
+
+  auto exit = makeEvent(proc_event::PROC_EVENT_EXIT);
+  exit.event_data.exit.process_pid = 12;
+  exit.event_data.exit.process_tgid = 10;
+  addMessage(buffer, exit);
+
+  exit.event_data.exit.process_pid = 11;
+  exit.event_data.exit.process_tgid = 11;
+  exit.event_data.exit.exit_code = 256;
+  addMessage(buffer, exit);
+
+  auto events =
+      ProcConnectorEventPublisher::parseMessages(buffer.data(), buffer.size());
+  ASSERT_EQ(events.size(), 3U);
+
+  EXPECT_EQ(events[0].action, PROC_CONNECTOR_FORK);
+  EXPECT_EQ(events[0].pid, 11);
+  EXPECT_EQ(events[0].parent, 10);
+  EXPECT_EQ(events[0].timestamp, 5000000000ULL);
+
+  EXPECT_EQ(events[1].action, PROC_CONNECTOR_EXEC);
+  EXPECT_EQ(events[1].pid, 11);
+
+  EXPECT_EQ(events[2].action, PROC_CONNECTOR_EXIT);
+  EXPECT_EQ(events[2].pid, 11);
+  EXPECT_EQ(events[2].exit_code, 256U);
+}
+
+TEST_F(ProcConnectorTests, test_parse_truncated_messages) {
+  std::vector<char> buffer;
+
+  auto exec = makeEvent(proc_event::PROC_EVENT_EXEC);
+  exec.event_data.exec.process_pid = 11;
+  exec.event_data.exec.process_tgid = 11;
+  addMessage(buffer, exec);
+
+  // A message claiming more data than was read.
+  auto header = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+  auto message = static_cast<struct cn_msg*>(NLMSG_DATA(header));
+  message->len = sizeof(struct proc_event) + 64;
+  EXPECT_TRUE(
+      ProcConnectorEventPublisher::parseMessages(buffer.data(), buffer.size())
+          .empty());
+
+  // A partial read.
+  message->len = sizeof(struct proc_event);
+  EXPECT_TRUE(ProcConnectorEventPublisher::parseMessages(
+                  buffer.data(), sizeof(struct nlmsghdr) + 4)
+                  .empty());
+
+  // Messages from other connectors.
+  message->id.idx = CN_IDX_PROC + 1;
+  EXPECT_TRUE(
+      ProcConnectorEventPublisher::parseMessages(buffer.data(), buffer.size())
+          .empty());
+}
+} // namespace osquery
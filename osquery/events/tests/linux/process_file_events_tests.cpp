@@ -89,7 +89,8 @@ TEST_F(AuditdFimTests, row_emission) {
 
   // Configure what we want to log and what we want to ignore
   AuditdFimContext fim_context;
-  fim_context.included_path_list = included_file_paths;
+  fim_context.included_paths.insert(included_file_paths.begin(),
+                                    included_file_paths.end());
 
   // Emit the rows, showing only writes
   std::vector<Row> emitted_row_list;
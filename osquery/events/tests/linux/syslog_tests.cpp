@@ -152,6 +152,55 @@ TEST_F(SyslogTests, test_nonblockingfstream) {
   }
 }
 
+TEST_F(SyslogTests, test_nonblockingfstream_getlines) {
+  auto pipe_path = test_working_dir_ / "pipe";
+  auto ret = mkfifo(pipe_path.string().c_str(), 0660);
+  ASSERT_EQ(ret, 0);
+
+  NonBlockingFStream nbfs(20);
+  auto s = nbfs.openReadOnly(pipe_path.string());
+  EXPECT_TRUE(s.ok());
+
+  auto fd = open(pipe_path.string().c_str(), O_WRONLY | O_NONBLOCK);
+  ASSERT_GT(fd, 0);
+
+  std::vector<std::string_view> lines;
+  s = nbfs.getlines(lines, 10);
+  EXPECT_FALSE(s.ok());
+  EXPECT_TRUE(lines.empty());
+
+  // Many lines are read at once, the partial line stays buffered.
+  std::string fill = "a\nbb\n\nccc\ndd";
+  ASSERT_EQ(static_cast<ssize_t>(fill.size()),
+            write(fd, fill.data(), fill.size()));
+  s = nbfs.getlines(lines, 10);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string_view>({"a", "bb", "", "ccc"}), lines);
+  EXPECT_EQ(2U, nbfs.offset());
+
+  fill = "d\ne\nf\n";
+  ASSERT_EQ(static_cast<ssize_t>(fill.size()),
+            write(fd, fill.data(), fill.size()));
+  s = nbfs.getlines(lines, 2);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string_view>({"ddd", "e"}), lines);
+
+  // The remaining lines are buffered.
+  s = nbfs.getlines(lines, 2);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string_view>({"f"}), lines);
+  EXPECT_EQ(0U, nbfs.offset());
+
+  // A line longer than the buffer is dropped.
+  fill = std::string(20, 'A');
+  ASSERT_EQ(static_cast<ssize_t>(fill.size()),
+            write(fd, fill.data(), fill.size()));
+  s = nbfs.getlines(lines, 2);
+  EXPECT_FALSE(s.ok());
+  EXPECT_EQ(0U, nbfs.offset());
+  close(fd);
+}
+
 TEST_F(SyslogTests, test_populate_event_context) {
   std::string line =
       R"|("2016-03-22T21:17:01.701882+00:00","vagrant-ubuntu-trusty-64","6","cron","CRON[16538]:"," (root) CMD (   cd / && run-parts --report /etc/cron.hourly)")|";
@@ -204,4 +253,29 @@ TEST_F(SyslogTests, test_csv_separator) {
   ASSERT_EQ(std::vector<std::string>({"\",f\\ø\"o,", "\",bá\\'r", "baz\\,\""}),
             splitCsv("\"\"\",f\\ø\"\"o,\",\"\"\",bá\\'r\",\"baz\\,\"\"\""));
 }
+
+TEST_F(SyslogTests, test_csv_scanner) {
+  std::vector<std::string> lines = {
+      "",
+      ",,,,",
+      " , , , , ",
+      "foo,bar,baz",
+      "\"foo\",\"bar\",\"baz\"",
+      "\",foo,\",\",bar\",\"baz,\"",
+      "\"\"\",f\\o\"\"o,\",\"\"\",ba\\'r\",\"baz\\,\"\"\"",
+      "a\"b,c\"d,e\"",
+      "\"unterminated,quote",
+  };
+
+  // The scanner splits lines as the separator does.
+  for (const auto& line : lines) {
+    std::vector<std::string> fields;
+    RsyslogCsvScanner scanner(line);
+    std::string field;
+    while (scanner.next(field)) {
+      fields.push_back(field);
+    }
+    EXPECT_EQ(splitCsv(line), fields) << line;
+  }
+}
 }
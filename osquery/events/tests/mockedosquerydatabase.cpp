@@ -98,6 +98,21 @@ Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
       "MockedOsqueryDatabase: Unsupported getDatabaseValue call");
 }
 
+Status MockedOsqueryDatabase::getDatabaseValues(
+    const std::string& domain,
+    const std::vector<std::string>& keys,
+    std::vector<std::string>& values) const {
+  values = {};
+
+  for (const auto& key : keys) {
+    std::string value;
+    getDatabaseValue(domain, key, value);
+    values.push_back(std::move(value));
+  }
+
+  return Status::success();
+}
+
 Status MockedOsqueryDatabase::setDatabaseValue(const std::string& domain,
                                                const std::string& key,
                                                const std::string& value) const {
@@ -126,8 +141,13 @@ Status MockedOsqueryDatabase::setDatabaseValue(const std::string& domain,
 
 Status MockedOsqueryDatabase::setDatabaseBatch(
     const std::string& domain, const DatabaseStringValueList& data) const {
-  return Status::failure(
-      "MockedOsqueryDatabase: Unsupported setDatabaseBatch call");
+  for (const auto& p : data) {
+    auto status = setDatabaseValue(domain, p.first, p.second);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::deleteDatabaseValue(
@@ -154,8 +174,19 @@ Status MockedOsqueryDatabase::deleteDatabaseRange(
     const std::string& domain,
     const std::string& low,
     const std::string& high) const {
-  return Status::failure(
-      "MockedOsqueryDatabase: Unsupported deleteDatabaseRange call");
+  if (domain != kEvents) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid domain passed to "
+        "deleteDatabaseRange: " +
+        domain);
+  }
+
+  if (low > high) {
+    return Status::failure("Invalid range: low > high");
+  }
+
+  key_map.erase(key_map.lower_bound(low), key_map.upper_bound(high));
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
@@ -189,4 +220,21 @@ Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
   return Status::success();
 }
 
+Status MockedOsqueryDatabase::scanDatabaseValues(
+    const std::string& domain,
+    DatabaseStringValueList& values,
+    const std::string& prefix,
+    size_t max) const {
+  return Status::failure(
+      "MockedOsqueryDatabase: Unsupported scanDatabaseValues call");
+}
+
+Status MockedOsqueryDatabase::openDatabaseCursor(
+    const std::string& domain,
+    const DatabaseCursorOptions& options,
+    DatabaseCursorRef& cursor) const {
+  return Status::failure(
+      "MockedOsqueryDatabase: Unsupported openDatabaseCursor call");
+}
+
 } // namespace osquery
@@ -28,6 +28,11 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
                                   const std::string& key,
                                   int& value) const override;
 
+  virtual Status getDatabaseValues(
+      const std::string& domain,
+      const std::vector<std::string>& keys,
+      std::vector<std::string>& values) const override;
+
   virtual Status setDatabaseValue(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) const override;
@@ -55,6 +60,15 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
                                   std::vector<std::string>& keys,
                                   const std::string& prefix,
                                   size_t max) const override;
+
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    DatabaseStringValueList& values,
+                                    const std::string& prefix,
+                                    size_t max) const override;
+
+  virtual Status openDatabaseCursor(const std::string& domain,
+                                    const DatabaseCursorOptions& options,
+                                    DatabaseCursorRef& cursor) const override;
 };
 
 } // namespace osquery
@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include <winsock2.h>
+
+#include "osquery/events/windows/etw_kernel_publisher.h"
+
+namespace osquery {
+class EtwKernelPublisherTests : public testing::Test {};
+
+namespace {
+
+/// Builds an event payload field by field.
+class Payload {
+ public:
+  template <typename T>
+  Payload& add(T value) {
+    auto bytes = reinterpret_cast<const std::uint8_t*>(&value);
+    data_.insert(data_.end(), bytes, bytes + sizeof(T));
+    return *this;
+  }
+
+  Payload& addBytes(std::vector<std::uint8_t> bytes) {
+    data_.insert(data_.end(), bytes.begin(), bytes.end());
+    return *this;
+  }
+
+  Payload& addString(const std::wstring& value) {
+    for (auto character : value) {
+      add(static_cast<std::uint16_t>(character));
+    }
+    return add(std::uint16_t{0});
+  }
+
+  bool parse(EtwKernelProvider provider,
+             std::uint16_t id,
+             std::uint8_t version,
+             std::size_t pointer_size,
+             EtwKernelEvent& event) const {
+    return EtwKernelEventPublisher::parseEvent(
+        provider, id, version, pointer_size, data_.data(), data_.size(), event);
+  }
+
+  std::size_t size() const {
+    return data_.size();
+  }
+
+ private:
+  std::vector<std::uint8_t> data_;
+};
+
+} // namespace
+
+TEST_F(EtwKernelPublisherTests, test_parse_process_events) {
+  // ProcessStart, version 0 has no flags.
+  for (std::uint8_t version : {0, 3}) {
+    Payload start;
+    start.add(std::uint32_t{1234})
+        .add(std::uint64_t{0})
+        .add(std::uint32_t{567})
+        .add(std::uint32_t{2});
+    if (version > 0) {
+      start.add(std::uint32_t{0});
+    }
+    start.addString(L"\\Device\\HarddiskVolume3\\Windows\\notepad.exe")
+        .add(std::uint32_t{0});
+
+    EtwKernelEvent event;
+    ASSERT_TRUE(start.parse(EtwKernelProvider::Process, 1, version, 8, event));
+    EXPECT_EQ(event.action, ETW_PROCESS_START);
+    EXPECT_EQ(event.pid, 1234U);
+    EXPECT_EQ(event.parent, 567U);
+    EXPECT_EQ(event.session_id, 2U);
+    EXPECT_EQ(event.path, L"\\Device\\HarddiskVolume3\\Windows\\notepad.exe");
+  }
+
+  Payload stop;
+  stop.add(std::uint32_t{1234})
+      .add(std::uint64_t{0})
+      .add(std::uint64_t{0})
+      .add(std::uint32_t{259});
+  EtwKernelEvent event;
+  ASSERT_TRUE(stop.parse(EtwKernelProvider::Process, 2, 0, 8, event));
+  EXPECT_EQ(event.action, ETW_PROCESS_STOP);
+  EXPECT_EQ(event.pid, 1234U);
+  EXPECT_EQ(event.exit_code, 259U);
+
+  // ImageLoad pointers follow the pointer size of the event.
+  for (std::size_t pointer_size : {4, 8}) {
+    Payload load;
+    if (pointer_size == 4) {
+      load.add(std::uint32_t{0x10000}).add(std::uint32_t{0x2000});
+    } else {
+      load.add(std::uint64_t{0x10000}).add(std::uint64_t{0x2000});
+    }
+    load.add(std::uint32_t{1234}).add(std::uint32_t{0}).add(std::uint32_t{0});
+    if (pointer_size == 4) {
+      load.add(std::uint32_t{0});
+    } else {
+      load.add(std::uint64_t{0});
+    }
+    load.addString(L"C:\\Windows\\System32\\ntdll.dll");
+
+    ASSERT_TRUE(
+        load.parse(EtwKernelProvider::Process, 5, 0, pointer_size, event));
+    EXPECT_EQ(event.action, ETW_IMAGE_LOAD);
+    EXPECT_EQ(event.pid, 1234U);
+    EXPECT_EQ(event.image_base, 0x10000U);
+    EXPECT_EQ(event.image_size, 0x2000U);
+    EXPECT_EQ(event.path, L"C:\\Windows\\System32\\ntdll.dll");
+  }
+
+  // Other events, and truncated ones, are dropped.
+  EXPECT_FALSE(stop.parse(EtwKernelProvider::Process, 3, 0, 8, event));
+  Payload truncated;
+  truncated.add(std::uint32_t{1234});
+  EXPECT_FALSE(truncated.parse(EtwKernelProvider::Process, 2, 0, 8, event));
+}
+
+TEST_F(EtwKernelPublisherTests, test_parse_network_events) {
+  // Connect, IPv4: the destination comes before the source.
+  Payload connect;
+  connect.add(std::uint32_t{1234})
+      .add(std::uint32_t{0})
+      .addBytes({93, 184, 216, 34})
+      .addBytes({10, 0, 0, 5})
+      .addBytes({0x01, 0xbb})
+      .addBytes({0xc3, 0x50})
+      .add(std::uint16_t{1460});
+
+  EtwKernelEvent event;
+  ASSERT_TRUE(connect.parse(EtwKernelProvider::Network, 12, 0, 8, event));
+  EXPECT_EQ(event.action, ETW_SOCKET_CONNECT);
+  EXPECT_EQ(event.pid, 1234U);
+  EXPECT_EQ(event.family, AF_INET);
+  EXPECT_EQ(event.remote_address[0], 93);
+  EXPECT_EQ(event.remote_address[3], 34);
+  EXPECT_EQ(event.local_address[0], 10);
+  EXPECT_EQ(event.remote_port, 443);
+  EXPECT_EQ(event.local_port, 50000);
+
+  // Accept, IPv6.
+  std::vector<std::uint8_t> loopback(16, 0);
+  loopback[15] = 1;
+  Payload accept;
+  accept.add(std::uint32_t{4})
+      .add(std::uint32_t{0})
+      .addBytes(loopback)
+      .addBytes(loopback)
+      .addBytes({0xc3, 0x50})
+      .addBytes({0x00, 0x50});
+
+  ASSERT_TRUE(accept.parse(EtwKernelProvider::Network, 31, 0, 8, event));
+  EXPECT_EQ(event.action, ETW_SOCKET_ACCEPT);
+  EXPECT_EQ(event.family, AF_INET6);
+  EXPECT_EQ(event.local_address[15], 1);
+  EXPECT_EQ(event.local_port, 80);
+  EXPECT_EQ(event.remote_port, 50000);
+
+  // Send and receive events are not parsed.
+  EXPECT_FALSE(connect.parse(EtwKernelProvider::Network, 10, 0, 8, event));
+}
+
+TEST_F(EtwKernelPublisherTests, test_get_dos_path) {
+  std::vector<std::pair<std::wstring, std::wstring>> devices = {
+      {L"\\Device\\HarddiskVolume1", L"D:"},
+      {L"\\Device\\HarddiskVolume3", L"C:"},
+  };
+
+  EXPECT_EQ(EtwKernelEventPublisher::getDosPath(
+                L"\\Device\\HarddiskVolume3\\Windows\\notepad.exe", devices),
+            L"C:\\Windows\\notepad.exe");
+
+  // A device name is only a prefix of a whole path component.
+  EXPECT_EQ(EtwKernelEventPublisher::getDosPath(
+                L"\\Device\\HarddiskVolume10\\a.exe", devices),
+            L"\\Device\\HarddiskVolume10\\a.exe");
+  EXPECT_EQ(EtwKernelEventPublisher::getDosPath(L"C:\\a.exe", devices),
+            L"C:\\a.exe");
+}
+} // namespace osquery
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include "osquery/events/windows/ntfs_event_publisher.h"
+#include "osquery/tests/test_util.h"
+
+namespace osquery {
+class NTFSEventPublisherTests : public testing::Test {};
+
+namespace {
+USNJournalEventRecord directoryRecord(USNJournalEventRecord::Type type,
+                                      std::uint64_t ref,
+                                      std::uint64_t parent_ref,
+                                      const std::string& name) {
+  USNJournalEventRecord record = {};
+  record.type = type;
+  record.drive_letter = 'C';
+  record.attributes = FILE_ATTRIBUTE_DIRECTORY;
+  record.node_ref_number = USNFileReferenceNumber(ref);
+  record.parent_ref_number = USNFileReferenceNumber(parent_ref);
+  record.name = name;
+  return record;
+}
+} // namespace
+
+TEST_F(NTFSEventPublisherTests, test_frn_cache_resolve) {
+  FRNCache cache;
+  cache.setRoot(USNFileReferenceNumber(5U), 'C');
+
+  cache.update(directoryRecord(
+      USNJournalEventRecord::Type::DirectoryCreation, 10U, 5U, "Users"));
+  cache.update(directoryRecord(
+      USNJournalEventRecord::Type::DirectoryCreation, 11U, 10U, "admin"));
+
+  std::string path;
+  USNFileReferenceNumber missing;
+  ASSERT_TRUE(cache.resolve(path, USNFileReferenceNumber(11U), missing));
+  EXPECT_EQ(path, "C:\\Users\\admin");
+
+  ASSERT_TRUE(cache.resolve(path, USNFileReferenceNumber(5U), missing));
+  EXPECT_EQ(path, "C:\\");
+
+  // Files are not cached, only their directories are needed
+  auto file_record = directoryRecord(
+      USNJournalEventRecord::Type::FileCreation, 12U, 11U, "a.txt");
+  file_record.attributes = FILE_ATTRIBUTE_NORMAL;
+  cache.update(file_record);
+  EXPECT_EQ(cache.size(), 2U);
+
+  // An unknown ancestor is reported so that only it is queried
+  cache.insert(USNFileReferenceNumber(21U), USNFileReferenceNumber(20U), "b");
+  EXPECT_FALSE(cache.resolve(path, USNFileReferenceNumber(21U), missing));
+  EXPECT_EQ(missing, USNFileReferenceNumber(20U));
+
+  cache.insertPath(USNFileReferenceNumber(20U), "C:\\Windows\\");
+  ASSERT_TRUE(cache.resolve(path, USNFileReferenceNumber(21U), missing));
+  EXPECT_EQ(path, "C:\\Windows\\b");
+}
+
+TEST_F(NTFSEventPublisherTests, test_frn_cache_invalidation) {
+  FRNCache cache;
+  cache.setRoot(USNFileReferenceNumber(5U), 'C');
+
+  cache.insert(USNFileReferenceNumber(10U), USNFileReferenceNumber(5U), "a");
+  cache.insert(USNFileReferenceNumber(11U), USNFileReferenceNumber(10U), "b");
+  cache.insertPath(USNFileReferenceNumber(20U), "C:\\a\\b\\c");
+
+  // Renaming a directory is reflected by its descendants
+  cache.update(directoryRecord(
+      USNJournalEventRecord::Type::DirectoryRename_OldName, 10U, 5U, "a"));
+  cache.update(directoryRecord(
+      USNJournalEventRecord::Type::DirectoryRename_NewName, 10U, 5U, "z"));
+
+  std::string path;
+  USNFileReferenceNumber missing;
+  ASSERT_TRUE(cache.resolve(path, USNFileReferenceNumber(11U), missing));
+  EXPECT_EQ(path, "C:\\z\\b");
+
+  // Paths resolved by the volume may contain the renamed directory
+  EXPECT_FALSE(cache.resolve(path, USNFileReferenceNumber(20U), missing));
+
+  cache.update(directoryRecord(
+      USNJournalEventRecord::Type::DirectoryDeletion, 11U, 10U, "b"));
+  EXPECT_FALSE(cache.resolve(path, USNFileReferenceNumber(11U), missing));
+  EXPECT_EQ(missing, USNFileReferenceNumber(11U));
+}
+
+TEST_F(NTFSEventPublisherTests, test_frn_cache_bounded) {
+  FRNCache cache(4U);
+  cache.setRoot(USNFileReferenceNumber(5U), 'C');
+
+  for (std::uint64_t ref = 10U; ref < 30U; ++ref) {
+    cache.insert(USNFileReferenceNumber(ref), USNFileReferenceNumber(5U), "d");
+    EXPECT_LE(cache.size(), 4U);
+  }
+
+  EXPECT_TRUE(cache.full());
+}
+} // namespace osquery
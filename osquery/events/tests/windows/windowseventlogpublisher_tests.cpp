@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/events/windows/windowseventlogpublisher.h>
+
+namespace osquery {
+class WindowsEventLogPublisherTests : public testing::Test {};
+
+TEST_F(WindowsEventLogPublisherTests, test_build_event_query) {
+  EXPECT_EQ(WindowsEventLogPublisher::buildEventQuery({}, {}), "*");
+
+  EXPECT_EQ(WindowsEventLogPublisher::buildEventQuery({4624}, {}),
+            "*[System[(EventID=4624)]]");
+
+  // Duplicates are dropped, runs of three or more become ranges.
+  EXPECT_EQ(WindowsEventLogPublisher::buildEventQuery(
+                {4771, 4625, 4768, 4624, 4769, 4770, 4624, 1102}, {}),
+            "*[System[(EventID=1102 or EventID=4624 or EventID=4625 or "
+            "(EventID>=4768 and EventID<=4771))]]");
+
+  EXPECT_EQ(WindowsEventLogPublisher::buildEventQuery(
+                {7045}, {"Service Control Manager", "Other"}),
+            "*[System[(EventID=7045) and Provider[@Name='Service Control "
+            "Manager' or @Name='Other']]]");
+
+  EXPECT_EQ(WindowsEventLogPublisher::buildEventQuery({}, {"Provider"}),
+            "*[System[Provider[@Name='Provider']]]");
+}
+
+TEST_F(WindowsEventLogPublisherTests, test_get_channel_queries) {
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(R"json({
+    "Security": {"event_ids": [4625, 4624]},
+    "System": "*[System[Level<=2]]",
+    "Application": {"providers": ["MsiInstaller"]}
+  })json")
+                  .ok());
+
+  WindowsEventLogPublisher::ChannelQueries queries;
+  ASSERT_TRUE(
+      WindowsEventLogPublisher::getChannelQueries(doc.doc(), queries).ok());
+
+  WindowsEventLogPublisher::ChannelQueries expected = {
+      {"security", "*[System[(EventID=4624 or EventID=4625)]]"},
+      {"system", "*[System[Level<=2]]"},
+      {"application", "*[System[Provider[@Name='MsiInstaller']]]"},
+  };
+  EXPECT_EQ(queries, expected);
+
+  const std::vector<std::string> invalid_configs = {
+      R"json([])json",
+      R"json({"Security": 4624})json",
+      R"json({"Security": ""})json",
+      R"json({"Security": {"event_ids": 4624}})json",
+      R"json({"Security": {"event_ids": [-1]}})json",
+      R"json({"Security": {"event_ids": [65536]}})json",
+      R"json({"Security": {"event_ids": ["4624"]}})json",
+      R"json({"Security": {"providers": "A"}})json",
+      R"json({"Security": {"providers": [""]}})json",
+      R"json({"Security": {"providers": ["A' or '1'='1"]}})json",
+  };
+
+  for (const auto& config : invalid_configs) {
+    auto invalid_doc = JSON::newObject();
+    ASSERT_TRUE(invalid_doc.fromString(config).ok()) << config;
+
+    EXPECT_FALSE(
+        WindowsEventLogPublisher::getChannelQueries(invalid_doc.doc(), queries)
+            .ok())
+        << config;
+    EXPECT_TRUE(queries.empty()) << config;
+  }
+}
+} // namespace osquery
@@ -23,7 +23,6 @@ using EventTime = uint64_t;
 using EventRecord = std::pair<std::string, EventTime>;
 using EventID = std::uint64_t;
 using EventIDList = std::vector<EventID>;
-using EventIndex = std::map<EventTime, EventIDList>;
 
 /**
  * @brief An EventSubscriber EventCallback method will receive an EventContext.
@@ -0,0 +1,516 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstddef>
+#include <cstring>
+
+#include <winsock2.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+
+#include "osquery/events/windows/etw_kernel_publisher.h"
+
+namespace osquery {
+
+FLAG(bool,
+     enable_etw_kernel_events,
+     false,
+     "Enables the ETW kernel process and network event publisher");
+
+REGISTER(EtwKernelEventPublisher, "event_publisher", "etw_kernel");
+
+namespace {
+
+/// The name of the real-time session, one per host.
+const wchar_t kEtwKernelSessionName[] = L"osquery-etw-kernel";
+
+/// Microsoft-Windows-Kernel-Process
+const GUID kKernelProcessProvider = {
+    0x22fb2cd6,
+    0x0e7b,
+    0x422b,
+    {0xa0, 0xc7, 0x2f, 0xad, 0x1f, 0xd0, 0xe7, 0x16}};
+
+/// Microsoft-Windows-Kernel-Network
+const GUID kKernelNetworkProvider = {
+    0x7dd42a49,
+    0x5329,
+    0x4832,
+    {0x8d, 0xfd, 0x43, 0xd9, 0x79, 0x15, 0x3a, 0x88}};
+
+/// Kernel-Process keywords.
+const ULONGLONG kKeywordProcess = 0x10;
+const ULONGLONG kKeywordImage = 0x40;
+
+/// Kernel-Network keywords.
+const ULONGLONG kKeywordIPv4 = 0x10;
+const ULONGLONG kKeywordIPv6 = 0x20;
+
+/// Kernel-Process event IDs.
+const std::uint16_t kProcessStartId = 1;
+const std::uint16_t kProcessStopId = 2;
+const std::uint16_t kImageLoadId = 5;
+
+/// Kernel-Network TCP event IDs.
+const std::uint16_t kConnectIPv4Id = 12;
+const std::uint16_t kAcceptIPv4Id = 15;
+const std::uint16_t kConnectIPv6Id = 28;
+const std::uint16_t kAcceptIPv6Id = 31;
+
+/// Session buffers in KB, bursts of process creation fill them quickly.
+const ULONG kEtwBufferSize = 64;
+const ULONG kEtwMinimumBuffers = 4;
+const ULONG kEtwMaximumBuffers = 64;
+
+/// Reads the fields of an event payload, in order.
+class PayloadReader {
+ public:
+  PayloadReader(const std::uint8_t* data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  template <typename T>
+  bool read(T& value) {
+    if (data_ == nullptr || size_ - offset_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, data_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool readBytes(std::uint8_t* value, std::size_t size) {
+    if (data_ == nullptr || size_ - offset_ < size) {
+      return false;
+    }
+    std::memcpy(value, data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  bool readPointer(std::size_t pointer_size, std::uint64_t& value) {
+    if (pointer_size == 4) {
+      std::uint32_t pointer = 0;
+      if (!read(pointer)) {
+        return false;
+      }
+      value = pointer;
+      return true;
+    }
+    return read(value);
+  }
+
+  /// Ports are in network order.
+  bool readPort(std::uint16_t& value) {
+    std::uint8_t port[2];
+    if (!readBytes(port, sizeof(port))) {
+      return false;
+    }
+    value = static_cast<std::uint16_t>((port[0] << 8) | port[1]);
+    return true;
+  }
+
+  /// A NULL-terminated UTF-16 string, which may be cut by the payload end.
+  bool readString(std::wstring& value) {
+    value.clear();
+    std::uint16_t character = 0;
+    while (read(character) && character != 0) {
+      value.push_back(static_cast<wchar_t>(character));
+    }
+    return true;
+  }
+
+ private:
+  const std::uint8_t* data_{nullptr};
+  std::size_t size_{0};
+  std::size_t offset_{0};
+};
+
+bool parseProcessEvent(std::uint16_t id,
+                       std::uint8_t version,
+                       std::size_t pointer_size,
+                       PayloadReader& reader,
+                       EtwKernelEvent& event) {
+  std::uint64_t create_time = 0;
+  switch (id) {
+  case kProcessStartId: {
+    event.action = ETW_PROCESS_START;
+    if (!reader.read(event.pid) || !reader.read(create_time) ||
+        !reader.read(event.parent) || !reader.read(event.session_id)) {
+      return false;
+    }
+
+    // Flags were added after the first version.
+    std::uint32_t flags = 0;
+    if (version >= 1 && !reader.read(flags)) {
+      return false;
+    }
+    return reader.readString(event.path);
+  }
+
+  case kProcessStopId: {
+    event.action = ETW_PROCESS_STOP;
+    std::uint64_t exit_time = 0;
+    return reader.read(event.pid) && reader.read(create_time) &&
+           reader.read(exit_time) && reader.read(event.exit_code);
+  }
+
+  case kImageLoadId: {
+    event.action = ETW_IMAGE_LOAD;
+    std::uint32_t checksum = 0;
+    std::uint32_t time_date_stamp = 0;
+    std::uint64_t default_base = 0;
+    if (!reader.readPointer(pointer_size, event.image_base) ||
+        !reader.readPointer(pointer_size, event.image_size) ||
+        !reader.read(event.pid) || !reader.read(checksum) ||
+        !reader.read(time_date_stamp) ||
+        !reader.readPointer(pointer_size, default_base)) {
+      return false;
+    }
+    return reader.readString(event.path);
+  }
+
+  default:
+    return false;
+  }
+}
+
+bool parseNetworkEvent(std::uint16_t id,
+                       PayloadReader& reader,
+                       EtwKernelEvent& event) {
+  std::size_t address_size = 0;
+  switch (id) {
+  case kConnectIPv4Id:
+  case kAcceptIPv4Id:
+    event.family = AF_INET;
+    address_size = 4;
+    break;
+  case kConnectIPv6Id:
+  case kAcceptIPv6Id:
+    event.family = AF_INET6;
+    address_size = 16;
+    break;
+  default:
+    return false;
+  }
+
+  event.action = (id == kConnectIPv4Id || id == kConnectIPv6Id)
+                     ? ETW_SOCKET_CONNECT
+                     : ETW_SOCKET_ACCEPT;
+
+  // Every TCP event starts with the process, the size of the transfer and
+  // the destination and source endpoints.
+  std::uint32_t transfer_size = 0;
+  return reader.read(event.pid) && reader.read(transfer_size) &&
+         reader.readBytes(event.remote_address.data(), address_size) &&
+         reader.readBytes(event.local_address.data(), address_size) &&
+         reader.readPort(event.remote_port) &&
+         reader.readPort(event.local_port);
+}
+
+/// Reset the session properties, ControlTrace writes to them.
+EVENT_TRACE_PROPERTIES* initProperties(std::vector<std::uint8_t>& buffer) {
+  buffer.assign(sizeof(EVENT_TRACE_PROPERTIES) + sizeof(kEtwKernelSessionName),
+                0);
+
+  auto properties = reinterpret_cast<EVENT_TRACE_PROPERTIES*>(buffer.data());
+  properties->Wnode.BufferSize = static_cast<ULONG>(buffer.size());
+  properties->Wnode.Flags = WNODE_FLAG_TRACED_GUID;
+  // Timestamps are only used to order the events, the cheapest clock works.
+  properties->Wnode.ClientContext = 2;
+  properties->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
+  properties->BufferSize = kEtwBufferSize;
+  properties->MinimumBuffers = kEtwMinimumBuffers;
+  properties->MaximumBuffers = kEtwMaximumBuffers;
+  properties->FlushTimer = 1;
+  properties->LoggerNameOffset = sizeof(EVENT_TRACE_PROPERTIES);
+  return properties;
+}
+
+/// Enable a provider for some of its events, disable it for none.
+ULONG enableProvider(TRACEHANDLE session,
+                     const GUID& provider,
+                     ULONGLONG keywords,
+                     const std::vector<USHORT>& ids) {
+  if (ids.empty()) {
+    return ::EnableTraceEx2(session,
+                            &provider,
+                            EVENT_CONTROL_CODE_DISABLE_PROVIDER,
+                            TRACE_LEVEL_INFORMATION,
+                            0,
+                            0,
+                            0,
+                            nullptr);
+  }
+
+  // The keywords enable whole groups of events, the event IDs are filtered
+  // in the session so the others are never delivered.
+  std::vector<std::uint8_t> filter(offsetof(EVENT_FILTER_EVENT_ID, Events) +
+                                   ids.size() * sizeof(USHORT));
+  auto event_ids = reinterpret_cast<EVENT_FILTER_EVENT_ID*>(filter.data());
+  event_ids->FilterIn = TRUE;
+  event_ids->Count = static_cast<USHORT>(ids.size());
+  std::memcpy(event_ids->Events, ids.data(), ids.size() * sizeof(USHORT));
+
+  EVENT_FILTER_DESCRIPTOR descriptor = {};
+  descriptor.Ptr = reinterpret_cast<ULONGLONG>(filter.data());
+  descriptor.Size = static_cast<ULONG>(filter.size());
+  descriptor.Type = EVENT_FILTER_TYPE_EVENT_ID;
+
+  ENABLE_TRACE_PARAMETERS parameters = {};
+  parameters.Version = ENABLE_TRACE_PARAMETERS_VERSION_2;
+  parameters.EnableFilterDesc = &descriptor;
+  parameters.FilterDescCount = 1;
+
+  auto error = ::EnableTraceEx2(session,
+                                &provider,
+                                EVENT_CONTROL_CODE_ENABLE_PROVIDER,
+                                TRACE_LEVEL_INFORMATION,
+                                keywords,
+                                0,
+                                0,
+                                &parameters);
+  if (error == ERROR_SUCCESS) {
+    return error;
+  }
+
+  // Event ID filters need Windows 8.1, parseEvent drops the other events.
+  return ::EnableTraceEx2(session,
+                          &provider,
+                          EVENT_CONTROL_CODE_ENABLE_PROVIDER,
+                          TRACE_LEVEL_INFORMATION,
+                          keywords,
+                          0,
+                          0,
+                          nullptr);
+}
+
+std::vector<std::pair<std::wstring, std::wstring>> getDeviceNames() {
+  std::vector<std::pair<std::wstring, std::wstring>> devices;
+
+  wchar_t drives[512] = {};
+  auto length = ::GetLogicalDriveStringsW(ARRAYSIZE(drives) - 1, drives);
+  if (length == 0 || length >= ARRAYSIZE(drives)) {
+    return devices;
+  }
+
+  // The drives are NULL-separated, such as C:\, ending in an empty one.
+  for (auto drive = drives; *drive != L'\0'; drive += wcslen(drive) + 1) {
+    std::wstring letter(drive, 2);
+    wchar_t device[MAX_PATH] = {};
+    if (::QueryDosDeviceW(letter.c_str(), device, MAX_PATH) != 0) {
+      devices.emplace_back(device, letter);
+    }
+  }
+  return devices;
+}
+
+} // namespace
+
+bool EtwKernelEventPublisher::parseEvent(EtwKernelProvider provider,
+                                         std::uint16_t id,
+                                         std::uint8_t version,
+                                         std::size_t pointer_size,
+                                         const std::uint8_t* data,
+                                         std::size_t size,
+                                         EtwKernelEvent& event) {
+  PayloadReader reader(data, size);
+  if (provider == EtwKernelProvider::Process) {
+    return parseProcessEvent(id, version, pointer_size, reader, event);
+  }
+  return parseNetworkEvent(id, reader, event);
+}
+
+std::wstring EtwKernelEventPublisher::getDosPath(
+    const std::wstring& path,
+    const std::vector<std::pair<std::wstring, std::wstring>>& devices) {
+  for (const auto& device : devices) {
+    const auto& name = device.first;
+    if (path.size() > name.size() && path[name.size()] == L'\\' &&
+        path.compare(0, name.size(), name) == 0) {
+      return device.second + path.substr(name.size());
+    }
+  }
+  return path;
+}
+
+Status EtwKernelEventPublisher::setUp() {
+  if (!FLAGS_enable_etw_kernel_events) {
+    return Status::failure("Publisher disabled via configuration");
+  }
+
+  WriteLock lock(mutex_);
+  devices_ = getDeviceNames();
+
+  auto properties = initProperties(properties_);
+  auto error = ::StartTraceW(&session_, kEtwKernelSessionName, properties);
+  if (error == ERROR_ALREADY_EXISTS) {
+    // Left behind by an osquery that did not stop, sessions outlive it.
+    properties = initProperties(properties_);
+    ::ControlTraceW(
+        0, kEtwKernelSessionName, properties, EVENT_TRACE_CONTROL_STOP);
+
+    properties = initProperties(properties_);
+    error = ::StartTraceW(&session_, kEtwKernelSessionName, properties);
+  }
+
+  if (error != ERROR_SUCCESS) {
+    session_ = 0;
+    return Status::failure("Could not start the ETW session: " +
+                           std::to_string(error));
+  }
+
+  EVENT_TRACE_LOGFILEW logfile = {};
+  logfile.LoggerName = const_cast<LPWSTR>(kEtwKernelSessionName);
+  logfile.ProcessTraceMode =
+      PROCESS_TRACE_MODE_REAL_TIME | PROCESS_TRACE_MODE_EVENT_RECORD;
+  logfile.EventRecordCallback = &EtwKernelEventPublisher::onEventRecord;
+  logfile.Context = this;
+
+  trace_ = ::OpenTraceW(&logfile);
+  if (trace_ == INVALID_PROCESSTRACE_HANDLE) {
+    auto open_error = ::GetLastError();
+    stopSession();
+    return Status::failure("Could not open the ETW session: " +
+                           std::to_string(open_error));
+  }
+
+  return Status::success();
+}
+
+void EtwKernelEventPublisher::stopSession() {
+  if (session_ != 0) {
+    auto properties = initProperties(properties_);
+    ::ControlTraceW(session_, nullptr, properties, EVENT_TRACE_CONTROL_STOP);
+    session_ = 0;
+  }
+}
+
+void EtwKernelEventPublisher::stop() {
+  WriteLock lock(mutex_);
+  stopSession();
+}
+
+void EtwKernelEventPublisher::tearDown() {
+  WriteLock lock(mutex_);
+  stopSession();
+  if (trace_ != INVALID_PROCESSTRACE_HANDLE) {
+    ::CloseTrace(trace_);
+    trace_ = INVALID_PROCESSTRACE_HANDLE;
+  }
+}
+
+Status EtwKernelEventPublisher::run() {
+  TRACEHANDLE trace = INVALID_PROCESSTRACE_HANDLE;
+  {
+    WriteLock lock(mutex_);
+    if (session_ == 0 || trace_ == INVALID_PROCESSTRACE_HANDLE) {
+      return Status::failure("ETW session not set up");
+    }
+
+    std::uint32_t actions = 0;
+    for (const auto& subscription : subscriptions_) {
+      actions |= getSubscriptionContext(subscription->context)->actions;
+    }
+
+    std::vector<USHORT> process_ids;
+    ULONGLONG process_keywords = 0;
+    if (actions & ETW_PROCESS_START) {
+      process_ids.push_back(kProcessStartId);
+      process_keywords |= kKeywordProcess;
+    }
+    if (actions & ETW_PROCESS_STOP) {
+      process_ids.push_back(kProcessStopId);
+      process_keywords |= kKeywordProcess;
+    }
+    if (actions & ETW_IMAGE_LOAD) {
+      process_ids.push_back(kImageLoadId);
+      process_keywords |= kKeywordImage;
+    }
+
+    std::vector<USHORT> network_ids;
+    if (actions & ETW_SOCKET_CONNECT) {
+      network_ids.push_back(kConnectIPv4Id);
+      network_ids.push_back(kConnectIPv6Id);
+    }
+    if (actions & ETW_SOCKET_ACCEPT) {
+      network_ids.push_back(kAcceptIPv4Id);
+      network_ids.push_back(kAcceptIPv6Id);
+    }
+
+    auto error = enableProvider(
+        session_, kKernelProcessProvider, process_keywords, process_ids);
+    if (error == ERROR_SUCCESS) {
+      error = enableProvider(session_,
+                             kKernelNetworkProvider,
+                             kKeywordIPv4 | kKeywordIPv6,
+                             network_ids);
+    }
+    if (error != ERROR_SUCCESS) {
+      return Status::failure("Could not enable the ETW kernel providers: " +
+                             std::to_string(error));
+    }
+    trace = trace_;
+  }
+
+  // Events are delivered to onEventRecord until stop ends the session.
+  auto error = ::ProcessTrace(&trace, 1, nullptr, nullptr);
+  if (isEnding()) {
+    return Status::success();
+  }
+  return Status::failure("The ETW session ended: " + std::to_string(error));
+}
+
+void WINAPI EtwKernelEventPublisher::onEventRecord(PEVENT_RECORD record) {
+  auto publisher = static_cast<EtwKernelEventPublisher*>(record->UserContext);
+  if (publisher != nullptr) {
+    publisher->handleEventRecord(*record);
+  }
+}
+
+void EtwKernelEventPublisher::handleEventRecord(const EVENT_RECORD& record) {
+  const auto& header = record.EventHeader;
+
+  EtwKernelProvider provider;
+  if (::IsEqualGUID(header.ProviderId, kKernelProcessProvider)) {
+    provider = EtwKernelProvider::Process;
+  } else if (::IsEqualGUID(header.ProviderId, kKernelNetworkProvider)) {
+    provider = EtwKernelProvider::Network;
+  } else {
+    return;
+  }
+
+  auto pointer_size =
+      (header.Flags & EVENT_HEADER_FLAG_32_BIT_HEADER) != 0 ? 4U : 8U;
+
+  auto ec = createEventContext();
+  if (!parseEvent(provider,
+                  header.EventDescriptor.Id,
+                  header.EventDescriptor.Version,
+                  pointer_size,
+                  static_cast<const std::uint8_t*>(record.UserData),
+                  record.UserDataLength,
+                  ec->event)) {
+    return;
+  }
+
+  // The kernel reports NT paths, such as \Device\HarddiskVolume3\Windows.
+  if (!ec->event.path.empty()) {
+    ec->event.path = getDosPath(ec->event.path, devices_);
+  }
+  fire(ec);
+}
+
+bool EtwKernelEventPublisher::shouldFire(
+    const EtwKernelSubscriptionContextRef& sc,
+    const EtwKernelEventContextRef& ec) const {
+  return (sc->actions & ec->event.action) != 0;
+}
+} // namespace osquery
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <osquery/events/eventpublisher.h>
+#include <osquery/events/eventsubscriber.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+#include <windows.h>
+
+#include <evntcons.h>
+#include <evntrace.h>
+
+namespace osquery {
+
+/// The kernel events read from the ETW session.
+enum EtwKernelAction : std::uint32_t {
+  ETW_PROCESS_START = 1 << 0,
+  ETW_PROCESS_STOP = 1 << 1,
+  ETW_IMAGE_LOAD = 1 << 2,
+  ETW_SOCKET_CONNECT = 1 << 3,
+  ETW_SOCKET_ACCEPT = 1 << 4,
+};
+
+/// The providers of the kernel events.
+enum class EtwKernelProvider {
+  /// Microsoft-Windows-Kernel-Process, process and image events.
+  Process,
+
+  /// Microsoft-Windows-Kernel-Network, TCP/IP events.
+  Network,
+};
+
+/// A kernel event parsed from the binary payload of an ETW event.
+struct EtwKernelEvent {
+  EtwKernelAction action{ETW_PROCESS_START};
+
+  /// The process starting, stopping, loading an image or owning a socket.
+  std::uint32_t pid{0};
+
+  /// The parent of a started process.
+  std::uint32_t parent{0};
+
+  /// The session of a started process.
+  std::uint32_t session_id{0};
+
+  /// The exit code of a stopped process.
+  std::uint32_t exit_code{0};
+
+  /// The NT path of a started process or a loaded image.
+  std::wstring path;
+
+  /// The address range of a loaded image.
+  std::uint64_t image_base{0};
+  std::uint64_t image_size{0};
+
+  /// AF_INET or AF_INET6 for sockets, the addresses in network order.
+  int family{0};
+  std::array<std::uint8_t, 16> local_address{};
+  std::array<std::uint8_t, 16> remote_address{};
+  std::uint16_t local_port{0};
+  std::uint16_t remote_port{0};
+};
+
+/**
+ * @brief Subscription details for EtwKernelEventPublisher events.
+ */
+struct EtwKernelSubscriptionContext : public SubscriptionContext {
+  /// A mask of the EtwKernelAction values to receive.
+  std::uint32_t actions{0};
+};
+
+/**
+ * @brief Event details for EtwKernelEventPublisher events.
+ */
+struct EtwKernelEventContext : public EventContext {
+  EtwKernelEvent event;
+};
+
+using EtwKernelEventContextRef = std::shared_ptr<EtwKernelEventContext>;
+using EtwKernelSubscriptionContextRef =
+    std::shared_ptr<EtwKernelSubscriptionContext>;
+
+/**
+ * @brief A Windows ETW real-time EventPublisher for kernel events.
+ *
+ * The Kernel-Process and Kernel-Network providers are enabled in a private
+ * real-time session. Only the event IDs of the subscribed actions are
+ * enabled, the session filters the rest. Events are parsed from their
+ * binary payload, which is much cheaper than rendering and parsing the XML
+ * of the Windows event log.
+ *
+ * The session needs administrator rights, the publisher is disabled unless
+ * --enable_etw_kernel_events is set.
+ */
+class EtwKernelEventPublisher
+    : public EventPublisher<EtwKernelSubscriptionContext,
+                            EtwKernelEventContext> {
+  DECLARE_PUBLISHER("etw_kernel");
+
+ public:
+  virtual ~EtwKernelEventPublisher() {
+    tearDown();
+  }
+
+  Status setUp() override;
+
+  void tearDown() override;
+
+  /// Stop the session, this ends the blocking ProcessTrace in run.
+  void stop() override;
+
+  Status run() override;
+
+  /**
+   * @brief Parse the binary payload of a kernel event.
+   *
+   * @param provider the provider of the event.
+   * @param id the event ID.
+   * @param version the version of the event.
+   * @param pointer_size 4 or 8, the pointer size of the event.
+   * @param data the payload.
+   * @param size the size of the payload.
+   * @param event the parsed event.
+   * @return false if the event is not one of the actions or is truncated.
+   */
+  static bool parseEvent(EtwKernelProvider provider,
+                         std::uint16_t id,
+                         std::uint8_t version,
+                         std::size_t pointer_size,
+                         const std::uint8_t* data,
+                         std::size_t size,
+                         EtwKernelEvent& event);
+
+  /// Replace the NT device prefix of a path by its drive letter.
+  static std::wstring getDosPath(
+      const std::wstring& path,
+      const std::vector<std::pair<std::wstring, std::wstring>>& devices);
+
+ private:
+  /// Start the session and enable the providers of the subscribed actions.
+  Status startSession(std::uint32_t actions);
+
+  /// Stop the session and close the consumer.
+  void stopSession();
+
+  /// The ProcessTrace callback, runs on the publisher thread.
+  static void WINAPI onEventRecord(PEVENT_RECORD record);
+
+  /// Parse and fire one event.
+  void handleEventRecord(const EVENT_RECORD& record);
+
+  /// Check subscription details.
+  bool shouldFire(const EtwKernelSubscriptionContextRef& sc,
+                  const EtwKernelEventContextRef& ec) const override;
+
+ private:
+  /// The controller handle of the session.
+  TRACEHANDLE session_{0};
+
+  /// The consumer handle of the session.
+  TRACEHANDLE trace_{INVALID_PROCESSTRACE_HANDLE};
+
+  /// The session properties, followed by room for the session name.
+  std::vector<std::uint8_t> properties_;
+
+  /// NT device names and their drive letters, e.g. \Device\HarddiskVolume3.
+  std::vector<std::pair<std::wstring, std::wstring>> devices_;
+
+  /// Protection around the session handles.
+  Mutex mutex_;
+};
+} // namespace osquery
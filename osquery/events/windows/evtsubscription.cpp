@@ -10,12 +10,20 @@
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
 
 #include <osquery/events/windows/evtsubscription.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/windows/strings.h>
 
 namespace osquery {
+namespace {
+/// Characters reserved to render events, most events fit without growing it.
+const std::size_t kRenderBufferSize{4096U};
+} // namespace
+
 // Note: Windows ignores the exit code of this function
 DWORD WINAPI EvtSubscriptionCallbackDispatcher(
     EVT_SUBSCRIBE_NOTIFY_ACTION action, PVOID context, EVT_HANDLE event) {
@@ -50,11 +58,12 @@ struct EvtSubscription::PrivateData final {
 };
 
 Status EvtSubscription::create(EvtSubscription::Ref& obj,
-                               const std::string& channel) {
+                               const std::string& channel,
+                               const std::string& query) {
   obj.reset();
 
   try {
-    obj.reset(new EvtSubscription(channel));
+    obj.reset(new EvtSubscription(channel, query));
     return Status::success();
 
   } catch (const std::bad_alloc&) {
@@ -93,15 +102,21 @@ EvtSubscription::EventList EvtSubscription::getEvents() {
   return event_list;
 }
 
-EvtSubscription::EvtSubscription(const std::string& channel)
+EvtSubscription::EvtSubscription(const std::string& channel,
+                                 const std::string& query)
     : d_(new PrivateData) {
   d_->channel = channel;
   auto channel_utf16 = stringToWstring(channel);
+  auto query_utf16 = stringToWstring(query);
+
+  // A structured query names its own channels.
+  auto structured_query = boost::starts_with(query, "<");
 
   auto subscription = EvtSubscribe(nullptr,
                                    nullptr,
-                                   channel_utf16.c_str(),
-                                   L"*",
+                                   structured_query ? nullptr
+                                                    : channel_utf16.c_str(),
+                                   query_utf16.c_str(),
                                    nullptr,
                                    this,
                                    EvtSubscriptionCallbackDispatcher,
@@ -110,50 +125,64 @@ EvtSubscription::EvtSubscription(const std::string& channel)
   if (subscription == nullptr) {
     auto error = GetLastError();
     throw Status::failure("Failed to subscribe to the channel named " +
-                          channel + ". Error " + std::to_string(error));
+                          channel + " with the query " + query + ". Error " +
+                          std::to_string(error));
   }
 
   d_->handle = subscription;
 }
 
 void EvtSubscription::processEvent(EVT_HANDLE event) {
+  // Events render into a buffer reused by the callback thread, it only grows
+  // when an event does not fit instead of asking each event for its size.
+  thread_local std::vector<wchar_t> render_buffer(kRenderBufferSize);
+
   DWORD buffer_size{0U};
   DWORD property_count{0U};
 
-  if (!EvtRender(nullptr,
-                 event,
-                 EvtRenderEventXml,
-                 0U,
-                 nullptr,
-                 &buffer_size,
-                 &property_count)) {
+  auto rendered =
+      EvtRender(nullptr,
+                event,
+                EvtRenderEventXml,
+                static_cast<DWORD>(render_buffer.size() * sizeof(wchar_t)),
+                render_buffer.data(),
+                &buffer_size,
+                &property_count);
+
+  if (!rendered) {
     auto error = GetLastError();
 
     if (error != ERROR_INSUFFICIENT_BUFFER) {
-      LOG(ERROR) << "Failed to allocated the necessary memory to handle an "
-                    "event for channel "
-                 << d_->channel;
+      LOG(ERROR) << "Failed to process an event for channel " << d_->channel
+                 << ". Error: " << error;
 
       return;
     }
-  }
 
-  std::wstring buffer(buffer_size / 2U, L'\0');
-  if (!EvtRender(nullptr,
-                 event,
-                 EvtRenderEventXml,
-                 buffer_size,
-                 &buffer[0],
-                 &buffer_size,
-                 &property_count)) {
-    auto error = GetLastError();
+    render_buffer.resize(buffer_size / sizeof(wchar_t));
+    rendered =
+        EvtRender(nullptr,
+                  event,
+                  EvtRenderEventXml,
+                  static_cast<DWORD>(render_buffer.size() * sizeof(wchar_t)),
+                  render_buffer.data(),
+                  &buffer_size,
+                  &property_count);
+
+    if (!rendered) {
+      error = GetLastError();
 
-    LOG(ERROR) << "Failed to process an event for channel " << d_->channel
-               << ". Error: " << error;
+      LOG(ERROR) << "Failed to process an event for channel " << d_->channel
+                 << ". Error: " << error;
 
-    return;
+      return;
+    }
   }
 
+  // The rendered size includes the null terminator
+  auto length = buffer_size / sizeof(wchar_t);
+  std::wstring buffer(render_buffer.data(), length > 0U ? length - 1U : 0U);
+
   {
     std::lock_guard<std::mutex> lock(d_->event_list_mutex);
     d_->event_list.push_back(std::move(buffer));
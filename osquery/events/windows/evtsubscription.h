@@ -28,7 +28,15 @@ class EvtSubscription final {
   using Event = std::wstring;
   using EventList = std::vector<Event>;
 
-  static Status create(Ref& obj, const std::string& channel);
+  /**
+   * @brief Subscribe to the future events of a channel.
+   *
+   * The query is an XPath filter, such as "*[System[EventID=4624]]", or a
+   * structured <QueryList> query. Events it excludes are never rendered.
+   */
+  static Status create(Ref& obj,
+                       const std::string& channel,
+                       const std::string& query = "*");
   ~EvtSubscription();
 
   const std::string channel() const;
@@ -41,7 +49,7 @@ class EvtSubscription final {
   struct PrivateData;
   std::unique_ptr<PrivateData> d_;
 
-  EvtSubscription(const std::string& channel);
+  EvtSubscription(const std::string& channel, const std::string& query);
   void processEvent(EVT_HANDLE event);
 
   friend DWORD WINAPI EvtSubscriptionCallbackDispatcher(
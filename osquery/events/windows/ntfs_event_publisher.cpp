@@ -37,11 +37,31 @@ HIDDEN_FLAG(bool,
             false,
             "Debug the NTFS event publisher");
 
+FLAG(uint64,
+     ntfs_event_publisher_frn_cache_size,
+     50000,
+     "Directories per volume cached to resolve NTFS event paths");
+
+FLAG(bool,
+     ntfs_event_publisher_seed_frn_cache,
+     false,
+     "Seed the NTFS directory cache by enumerating the MFT on startup");
+
 REGISTER(NTFSEventPublisher, "event_publisher", "ntfs_event_publisher");
 
 namespace {
 namespace boostfs = boost::filesystem;
 
+/// Ancestors walked when building a path, guards against stale loops
+const std::size_t kFRNCacheMaxDepth = 256U;
+
+/// Output buffer used to enumerate the MFT
+const std::size_t kMFTEnumBufferSize = 64U * 1024U;
+
+bool isDirectoryRecord(const USNJournalEventRecord& record) {
+  return (record.attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
 std::ostream& operator<<(std::ostream& stream, const NTFSEventRecord& event) {
   std::ios_base::fmtflags original_stream_settings(stream.flags());
 
@@ -63,6 +83,130 @@ std::ostream& operator<<(std::ostream& stream, const NTFSEventRecord& event) {
 };
 } // namespace
 
+FRNCache::FRNCache(std::size_t max_size) : entries_(max_size) {}
+
+void FRNCache::setRoot(const USNFileReferenceNumber& root_ref,
+                       char drive_letter) {
+  root_ref_ = root_ref;
+  drive_letter_ = drive_letter;
+}
+
+bool FRNCache::hasRoot() const {
+  return drive_letter_ != 0U;
+}
+
+void FRNCache::update(const USNJournalEventRecord& record) {
+  if (!isDirectoryRecord(record)) {
+    return;
+  }
+
+  switch (record.type) {
+  case USNJournalEventRecord::Type::DirectoryDeletion:
+  case USNJournalEventRecord::Type::DirectoryRename_OldName:
+    remove(record.node_ref_number);
+    break;
+
+  case USNJournalEventRecord::Type::DirectoryRename_NewName:
+    removeAbsolutePaths();
+    insert(record.node_ref_number, record.parent_ref_number, record.name);
+    break;
+
+  default:
+    // Every record carries the current name and parent of the directory
+    insert(record.node_ref_number, record.parent_ref_number, record.name);
+    break;
+  }
+}
+
+void FRNCache::insert(const USNFileReferenceNumber& ref,
+                      const USNFileReferenceNumber& parent_ref,
+                      const std::string& name) {
+  auto entry = entries_.get(ref);
+  if (entry != nullptr && !entry->absolute && entry->parent_ref == parent_ref &&
+      entry->name == name) {
+    return;
+  }
+
+  // A full cache evicts the directories not used since the last sweep
+  entries_.insert(ref, {parent_ref, name, false});
+}
+
+void FRNCache::insertPath(const USNFileReferenceNumber& ref,
+                          const std::string& path) {
+  entries_.insert(ref, {{}, path, true});
+}
+
+void FRNCache::remove(const USNFileReferenceNumber& ref) {
+  entries_.erase(ref);
+}
+
+bool FRNCache::resolve(std::string& path,
+                       const USNFileReferenceNumber& ref,
+                       USNFileReferenceNumber& missing) {
+  path.clear();
+
+  std::vector<const std::string*> names;
+  std::string prefix;
+
+  auto current = &ref;
+  for (std::size_t depth = 0U;; ++depth) {
+    if (depth == kFRNCacheMaxDepth) {
+      missing = ref;
+      return false;
+    }
+
+    if (hasRoot() && *current == root_ref_) {
+      prefix.push_back(drive_letter_);
+      prefix.push_back(':');
+      break;
+    }
+
+    auto cached = entries_.get(*current);
+    if (cached == nullptr) {
+      missing = *current;
+      return false;
+    }
+
+    const auto& entry = *cached;
+    if (entry.absolute) {
+      prefix = entry.name;
+      if (!prefix.empty() && prefix.back() == '\\') {
+        prefix.pop_back();
+      }
+      break;
+    }
+
+    names.push_back(&entry.name);
+    current = &entry.parent_ref;
+  }
+
+  path = std::move(prefix);
+  if (names.empty()) {
+    path.push_back('\\');
+    return true;
+  }
+
+  for (auto it = names.rbegin(); it != names.rend(); ++it) {
+    path.push_back('\\');
+    path.append(**it);
+  }
+
+  return true;
+}
+
+bool FRNCache::full() const {
+  return entries_.size() >= entries_.capacity();
+}
+
+std::size_t FRNCache::size() const {
+  return entries_.size();
+}
+
+void FRNCache::removeAbsolutePaths() {
+  entries_.eraseIf([](const USNFileReferenceNumber&,
+                       const FRNCacheEntry& entry) { return entry.absolute; });
+}
+
 /// Private class data
 struct NTFSEventPublisher::PrivateData final {
   /// Each reader service instance is mapped to the drive letter it is
@@ -101,6 +245,7 @@ void NTFSEventPublisher::restartJournalReaderServices(
     USNJournalReaderInstance instance = {};
     instance.reader = service;
     instance.context = context;
+    instance.frn_cache = FRNCache(FLAGS_ntfs_event_publisher_frn_cache_size);
     d_->reader_service_map.insert({drive_letter, instance});
 
     Dispatcher::addService(service);
@@ -286,25 +431,119 @@ Status NTFSEventPublisher::getPathFromReferenceNumber(
 
 Status NTFSEventPublisher::getPathFromParentFRN(
     std::string& path,
-    ParentFRNCache& parent_frn_cache,
+    FRNCache& frn_cache,
     char drive_letter,
     const std::string& basename,
     const USNFileReferenceNumber& ref) {
-  auto& it = parent_frn_cache.find(ref);
-
-  if (it == parent_frn_cache.end()) {
-    Status status = getPathFromReferenceNumber(path, drive_letter, ref);
-
+  USNFileReferenceNumber missing;
+  if (!frn_cache.resolve(path, ref, missing)) {
+    // Query the volume for the first unknown ancestor only; the directories
+    // below it are already known
+    std::string ancestor_path;
+    auto status =
+        getPathFromReferenceNumber(ancestor_path, drive_letter, missing);
     if (!status.ok()) {
       return status;
     }
 
-    parent_frn_cache[ref] = path;
-  } else {
-    path = it->second;
+    frn_cache.insertPath(missing, ancestor_path);
+    if (!frn_cache.resolve(path, ref, missing)) {
+      return Status::failure("Failed to resolve the parent directory");
+    }
   }
 
-  path.append("\\" + basename);
+  if (path.back() != '\\') {
+    path.push_back('\\');
+  }
+  path.append(basename);
+
+  return Status::success();
+}
+
+Status NTFSEventPublisher::initializeFRNCache(FRNCache& frn_cache,
+                                              char drive_letter) {
+  VolumeData volume_data = {};
+  auto status = getVolumeData(volume_data, drive_letter);
+  if (!status.ok()) {
+    return status;
+  }
+
+  frn_cache.setRoot(volume_data.root_ref, drive_letter);
+  if (!FLAGS_ntfs_event_publisher_seed_frn_cache) {
+    return Status::success();
+  }
+
+  MFT_ENUM_DATA_V0 enum_data = {};
+  enum_data.StartFileReferenceNumber = 0U;
+  enum_data.LowUsn = 0;
+  enum_data.HighUsn = MAXLONGLONG;
+
+  std::vector<std::uint8_t> buffer(kMFTEnumBufferSize);
+
+  while (!frn_cache.full()) {
+    DWORD bytes_read = 0U;
+    if (!::DeviceIoControl(volume_data.volume_handle,
+                           FSCTL_ENUM_USN_DATA,
+                           &enum_data,
+                           sizeof(enum_data),
+                           buffer.data(),
+                           static_cast<DWORD>(buffer.size()),
+                           &bytes_read,
+                           nullptr)) {
+      auto error_code = ::GetLastError();
+      if (error_code == ERROR_HANDLE_EOF) {
+        break;
+      }
+
+      std::stringstream message;
+      message << "Failed to enumerate the MFT of volume " << drive_letter
+              << ":\\. Error: ";
+
+      std::wstring description;
+      if (!getWindowsErrorDescription(description, error_code)) {
+        description = L"Unknown error";
+      }
+
+      message << wstringToString(description.c_str());
+      return Status::failure(message.str());
+    }
+
+    if (bytes_read <= sizeof(DWORDLONG)) {
+      break;
+    }
+
+    // The output starts with the reference number to continue from
+    enum_data.StartFileReferenceNumber =
+        *reinterpret_cast<DWORDLONG*>(buffer.data());
+
+    for (auto offset = sizeof(DWORDLONG); offset < bytes_read;) {
+      auto record = reinterpret_cast<const USN_RECORD*>(&buffer[offset]);
+      if (record->RecordLength == 0U) {
+        break;
+      }
+      offset += record->RecordLength;
+
+      DWORD attributes = 0U;
+      if (!USNParsers::GetAttributes(attributes, record) ||
+          (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        continue;
+      }
+
+      USNFileReferenceNumber ref;
+      USNFileReferenceNumber parent_ref;
+      std::string name;
+      if (!USNParsers::GetFileReferenceNumber(ref, record) ||
+          !USNParsers::GetParentFileReferenceNumber(parent_ref, record) ||
+          !USNParsers::GetEventString(name, record)) {
+        continue;
+      }
+
+      frn_cache.insert(ref, parent_ref, name);
+    }
+  }
+
+  VLOG(1) << "Seeded the FRN cache of volume " << drive_letter << ":\\ with "
+          << frn_cache.size() << " directories";
 
   return Status::success();
 }
@@ -482,9 +721,21 @@ Status NTFSEventPublisher::run() {
 
     auto& service_instance = service_it->second;
 
-    auto& parent_frn_cache = service_instance.parent_frn_cache;
+    auto& frn_cache = service_instance.frn_cache;
     auto& rename_path_mapper = service_instance.rename_path_mapper;
 
+    if (!frn_cache.hasRoot()) {
+      auto status = initializeFRNCache(frn_cache, journal_record.drive_letter);
+      if (!status.ok()) {
+        VLOG(1) << "Failed to initialize the FRN cache: "
+                << status.getMessage();
+      }
+    }
+
+    // Paths are built from the parent directory, so the record can update
+    // its own entry before being resolved
+    frn_cache.update(journal_record);
+
     // Track rename records so that we can merge them into a single event
     bool skip_record = false;
     USNJournalEventRecord old_name_record = {};
@@ -499,19 +750,7 @@ Status NTFSEventPublisher::run() {
       break;
     }
 
-    case USNJournalEventRecord::Type::DirectoryRename_NewName: {
-      // If we're renaming a directory, update the parent FRN cache.
-      std::string dir;
-      auto status = getPathFromReferenceNumber(
-          dir, journal_record.drive_letter, journal_record.node_ref_number);
-
-      if (!status.ok()) {
-        TLOG << "Failed to get directory for parent FRN cache update";
-      } else {
-        parent_frn_cache[journal_record.node_ref_number] = dir;
-      }
-      // Intentional fallthrough.
-    }
+    case USNJournalEventRecord::Type::DirectoryRename_NewName:
     case USNJournalEventRecord::Type::FileRename_NewName: {
       auto it = rename_path_mapper.find(journal_record.node_ref_number);
       if (it == rename_path_mapper.end()) {
@@ -532,26 +771,23 @@ Status NTFSEventPublisher::run() {
     // Generate the new event
     NTFSEventRecord event(journal_record);
 
-    // TODO(woodruffw): This is failing occasionally for files that do exist
-    // on disk, but only on the first call to look them up. I'm not
-    // sure why yet, but falling back on the parent FRN cache and
-    // building the path from it works for now.
-    // See https://github.com/osquery/osquery/issues/5848
-    auto status = getPathFromReferenceNumber(event.path,
-                                             journal_record.drive_letter,
-                                             journal_record.node_ref_number);
+    // Build the path from the cached parent directories first; deleted files
+    // can no longer be opened by their reference number
+    auto status = getPathFromParentFRN(event.path,
+                                       frn_cache,
+                                       journal_record.drive_letter,
+                                       journal_record.name,
+                                       journal_record.parent_ref_number);
     if (!status.ok()) {
-      TLOG << "FRN pathname lookup failed, trying parent: "
-           << status.getMessage();
+      VLOG(1) << "Parent FRN lookup failed, trying the FRN: "
+              << status.getMessage();
 
-      status = getPathFromParentFRN(event.path,
-                                    parent_frn_cache,
-                                    journal_record.drive_letter,
-                                    journal_record.name,
-                                    journal_record.parent_ref_number);
+      status = getPathFromReferenceNumber(event.path,
+                                          journal_record.drive_letter,
+                                          journal_record.node_ref_number);
 
       if (!status.ok()) {
-        VLOG(1) << "Parent FRN lookup failed: " << status.getMessage();
+        VLOG(1) << "FRN pathname lookup failed: " << status.getMessage();
 
         event.path = journal_record.name;
         event.partial = true;
@@ -560,7 +796,7 @@ Status NTFSEventPublisher::run() {
 
     if (old_name_record.drive_letter != 0U) {
       status = getPathFromParentFRN(event.old_path,
-                                    parent_frn_cache,
+                                    frn_cache,
                                     old_name_record.drive_letter,
                                     old_name_record.name,
                                     old_name_record.parent_ref_number);
@@ -577,13 +813,10 @@ Status NTFSEventPublisher::run() {
     event_context->event_list.push_back(std::move(event));
   }
 
-  // Put a limit on the size of the caches we are using
-  // NOTE(woodruffw): We could also try to incrementally free up
-  // the parent FRN cache by tracking DirectoryDeletions.
+  // Put a limit on the size of the caches we are using; the FRN cache
+  // bounds itself
   for (auto& p : d_->reader_service_map) {
     auto& service_instance = p.second;
-
-    auto& parent_frn_cache = service_instance.parent_frn_cache;
     auto& rename_path_mapper = service_instance.rename_path_mapper;
 
     if (rename_path_mapper.size() >= 2000U) {
@@ -592,13 +825,6 @@ Status NTFSEventPublisher::run() {
 
       rename_path_mapper.erase(range_start, range_end);
     }
-
-    if (parent_frn_cache.size() >= 2000U) {
-      auto range_start = parent_frn_cache.begin();
-      auto range_end = std::next(range_start, 1000U);
-
-      parent_frn_cache.erase(range_start, range_end);
-    }
   }
 
   fire(event_context);
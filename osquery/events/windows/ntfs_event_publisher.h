@@ -14,10 +14,12 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "osquery/events/windows/usn_journal_reader.h"
 #include <osquery/events/eventpublisher.h>
+#include <osquery/utils/caches/clock.h>
 
 namespace osquery {
 /// The subscription context contains the list of paths the subscriber is
@@ -116,8 +118,70 @@ struct NTFSEventContext final : public EventContext {
 
 using NTFSEventContextRef = std::shared_ptr<NTFSEventContext>;
 
-/// The ParentFRNCache maps parent FRNs to directory names
-using ParentFRNCache = std::unordered_map<USNFileReferenceNumber, std::string>;
+/// A directory known to the FRN cache
+struct FRNCacheEntry final {
+  /// Reference number of the directory containing this one
+  USNFileReferenceNumber parent_ref;
+
+  /// Directory name, or the full path when `absolute` is set
+  std::string name;
+
+  /// If true, the path was resolved by the volume rather than built from
+  /// the journal records
+  bool absolute{false};
+};
+
+/// The FRNCache maps directory FRNs to their parent FRN and name, so that
+/// paths can be built from the journal records without querying the volume
+class FRNCache final {
+ public:
+  explicit FRNCache(std::size_t max_size = 50000U);
+
+  /// Sets the volume root; paths are built up to this directory
+  void setRoot(const USNFileReferenceNumber& root_ref, char drive_letter);
+
+  /// Returns true if the volume root has been set
+  bool hasRoot() const;
+
+  /// Updates the cache from a journal record, tracking directory creations,
+  /// renames and deletions
+  void update(const USNJournalEventRecord& record);
+
+  /// Adds or replaces a directory
+  void insert(const USNFileReferenceNumber& ref,
+              const USNFileReferenceNumber& parent_ref,
+              const std::string& name);
+
+  /// Adds a directory whose full path has been resolved by the volume
+  void insertPath(const USNFileReferenceNumber& ref, const std::string& path);
+
+  /// Removes a directory
+  void remove(const USNFileReferenceNumber& ref);
+
+  /// Builds the full path of a directory; on failure, `missing` is set to
+  /// the first ancestor that is not in the cache
+  bool resolve(std::string& path,
+               const USNFileReferenceNumber& ref,
+               USNFileReferenceNumber& missing);
+
+  /// Returns true if no more directories can be added without evicting
+  bool full() const;
+
+  /// Returns the number of cached directories
+  std::size_t size() const;
+
+ private:
+  /// Removes the paths resolved by the volume, as a directory they contain
+  /// may have been renamed
+  void removeAbsolutePaths();
+
+  /// Directories evict with the CLOCK policy, the ones paths are built
+  /// through stay cached
+  caches::Clock<USNFileReferenceNumber, FRNCacheEntry> entries_;
+
+  USNFileReferenceNumber root_ref_;
+  char drive_letter_{0U};
+};
 
 /// This structure describes a running USNJournalReader instance
 struct USNJournalReaderInstance final {
@@ -127,8 +191,8 @@ struct USNJournalReaderInstance final {
   /// The shared context
   USNJournalReaderContextRef context;
 
-  /// This cache contains a mapping from parent FRN to directory name.
-  ParentFRNCache parent_frn_cache;
+  /// This cache maps directory FRNs to their parent FRN and name
+  FRNCache frn_cache;
 
   /// This map is used to merge the rename records (old name and new name) into
   /// a single event. It is ordered so that we can delete data starting from the
@@ -168,13 +232,18 @@ class NTFSEventPublisher final
                                     char drive_letter,
                                     const USNFileReferenceNumber& ref);
 
-  /// Attempts to get the full path for `basename` via its parent FRN.
+  /// Attempts to get the full path for `basename` via its parent FRN,
+  /// querying the volume only for directories missing from the cache
   Status getPathFromParentFRN(std::string& path,
-                              ParentFRNCache& parent_frn_cache,
+                              FRNCache& frn_cache,
                               char drive_letter,
                               const std::string& basename,
                               const USNFileReferenceNumber& ref);
 
+  /// Sets the volume root of the FRN cache and, if enabled, seeds it with
+  /// the directories enumerated from the MFT
+  Status initializeFRNCache(FRNCache& frn_cache, char drive_letter);
+
   /// Returns a VolumeData structure containing the volume handle and the
   /// root folder reference number
   Status getVolumeData(VolumeData& volume, char drive_letter);
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <ctime>
 #include <iomanip>
 #include <map>
@@ -41,6 +42,16 @@ HIDDEN_FLAG(bool,
             false,
             "Debug USN journal messages");
 
+FLAG(uint32,
+     usn_journal_reader_max_buffer_size,
+     1024 * 1024,
+     "Largest buffer, in bytes, used to read a busy USN journal");
+
+FLAG(uint32,
+     usn_journal_reader_max_poll_interval,
+     2000,
+     "Longest pause, in milliseconds, between reads of an idle USN journal");
+
 // clang-format off
 const std::unordered_map<int, std::string> kWindowsFileAttributeMap = {
     {FILE_ATTRIBUTE_ARCHIVE, "FILE_ATTRIBUTE_ARCHIVE"},
@@ -102,8 +113,12 @@ const std::unordered_map<USNJournalEventRecord::Type, std::string>
 // clang-format on
 
 namespace {
-/// Read buffer size
-const size_t kUSNJournalReaderBufferSize = 4096U;
+/// Smallest read buffer size, used while the journal is quiet
+const size_t kUSNJournalReaderMinBufferSize = 4096U;
+
+/// Pause between reads once the journal has become idle; it doubles on each
+/// empty read up to --usn_journal_reader_max_poll_interval
+const std::chrono::milliseconds kUSNJournalReaderMinPollInterval{50};
 
 /// This variable holds the list of change events we are interested in. Order
 /// is important, as it determines the priority when decompressing/splitting
@@ -162,6 +177,9 @@ const std::unordered_map<int, std::pair<USNJournalEventRecord::Type, USNJournalE
 };
 // clang-format on
 
+/// The number of events a single journal record can be split into
+const size_t kUSNChangeReasonFlagCount = 20U;
+
 /// Aggregates the flag list into a bit mask; this is used to avoid having to
 /// repeat the flag list twice in two different formats
 DWORD GetUSNChangeReasonFlagMask() {
@@ -204,8 +222,12 @@ struct USNJournalReader::PrivateData final {
   /// journal_reader_context->drive_letter
   HANDLE volume_handle{INVALID_HANDLE_VALUE};
 
-  /// Read buffer
-  std::array<std::uint8_t, kUSNJournalReaderBufferSize> read_buffer;
+  /// Read buffer; it grows while reads fill it and shrinks back when the
+  /// journal is quiet
+  std::vector<std::uint8_t> read_buffer;
+
+  /// Pause before the next read; zero while the journal is busy
+  std::chrono::milliseconds poll_interval{0};
 
   /// How many bytes the service was able to read during the last acquireRecords
   /// call
@@ -301,14 +323,11 @@ Status USNJournalReader::acquireRecords() {
   // V3 records, as V2 are disabled when range tracking is activated. We are
   // skipping them for now, but we can easily enable them by changing the last
   // field in this structure (the code will automatically skip them for now)
-  READ_USN_JOURNAL_DATA_V1 read_data_command = {0U,
-                                                flag_mask,
-                                                0U,
-                                                1U,
-                                                kUSNJournalReaderBufferSize,
-                                                d_->journal_id,
-                                                2U,
-                                                3U};
+  //
+  // The read does not wait for new records (BytesToWaitFor is zero), the
+  // polling cadence is controlled by adaptReadCadence instead
+  READ_USN_JOURNAL_DATA_V1 read_data_command = {
+      0U, flag_mask, 0U, 0U, 0U, d_->journal_id, 2U, 3U};
 
   read_data_command.StartUsn = d_->next_update_seq_number;
 
@@ -352,6 +371,46 @@ Status USNJournalReader::acquireRecords() {
   return Status::success();
 }
 
+void USNJournalReader::adaptReadCadence() {
+  auto buffer_size = d_->read_buffer.size();
+  auto max_buffer_size = std::max<size_t>(
+      FLAGS_usn_journal_reader_max_buffer_size, kUSNJournalReaderMinBufferSize);
+
+  // The first bytes only hold the next sequence number
+  auto record_bytes = d_->bytes_received - sizeof(USN);
+
+  if (record_bytes >= buffer_size / 2U) {
+    // Busy journal: read again right away, with a larger buffer once the
+    // reads come close to filling it
+    d_->poll_interval = std::chrono::milliseconds(0);
+    if (record_bytes >= (buffer_size / 4U) * 3U &&
+        buffer_size < max_buffer_size) {
+      d_->read_buffer.resize(std::min(buffer_size * 2U, max_buffer_size));
+    }
+
+    return;
+  }
+
+  if (buffer_size > kUSNJournalReaderMinBufferSize &&
+      record_bytes < buffer_size / 8U) {
+    d_->read_buffer.resize(
+        std::max(buffer_size / 2U, kUSNJournalReaderMinBufferSize));
+    d_->read_buffer.shrink_to_fit();
+  }
+
+  if (record_bytes != 0U) {
+    d_->poll_interval = kUSNJournalReaderMinPollInterval;
+    return;
+  }
+
+  // Idle journal: back off, up to the configured interval
+  auto max_poll_interval =
+      std::chrono::milliseconds(FLAGS_usn_journal_reader_max_poll_interval);
+  d_->poll_interval = std::min(
+      std::max(d_->poll_interval * 2, kUSNJournalReaderMinPollInterval),
+      max_poll_interval);
+}
+
 // V4 records are only used for range tracking; they are not useful for us since
 // they are emitted only after a file has been closed.
 //
@@ -396,7 +455,7 @@ Status USNJournalReader::processAcquiredRecords(
 }
 
 void USNJournalReader::dispatchEventRecords(
-    const std::vector<USNJournalEventRecord>& record_list) {
+    std::vector<USNJournalEventRecord>& record_list) {
   if (record_list.empty()) {
     return;
   }
@@ -407,12 +466,15 @@ void USNJournalReader::dispatchEventRecords(
   {
     WriteLock lock(context->processed_records_mutex);
 
-    context->processed_record_list.reserve(
-        context->processed_record_list.size() + record_list.size());
-
-    context->processed_record_list.insert(context->processed_record_list.end(),
-                                          record_list.begin(),
-                                          record_list.end());
+    auto& processed_record_list = context->processed_record_list;
+    if (processed_record_list.empty()) {
+      processed_record_list = std::move(record_list);
+    } else {
+      processed_record_list.insert(
+          processed_record_list.end(),
+          std::make_move_iterator(record_list.begin()),
+          std::make_move_iterator(record_list.end()));
+    }
 
     context->processed_records_cv.notify_all();
   }
@@ -427,8 +489,17 @@ void USNJournalReader::start() {
     return;
   }
 
+  d_->read_buffer.resize(kUSNJournalReaderMinBufferSize);
+
   // Enter the main loop, listening for journal changes
   while (!interrupted() && !d_->journal_reader_context->terminate) {
+    if (d_->poll_interval.count() != 0) {
+      pause(d_->poll_interval);
+      if (interrupted() || d_->journal_reader_context->terminate) {
+        break;
+      }
+    }
+
     status = acquireRecords();
     if (!status.ok()) {
       LOG(ERROR) << status.getMessage();
@@ -445,6 +516,7 @@ void USNJournalReader::start() {
 
     // Send the new records to the event publisher
     dispatchEventRecords(record_list);
+    adaptReadCadence();
   }
 }
 
@@ -474,40 +546,40 @@ USNJournalReader::~USNJournalReader() {}
  */
 Status USNJournalReader::DecompressRecord(
     std::vector<USNJournalEventRecord>& new_records,
-    const USNJournalEventRecord& base_record,
+    USNJournalEventRecord base_record,
     DWORD journal_record_reason,
     USNPerFileLastRecordType& per_file_last_record_type_map) {
+  // Select the event types first, so that the base record is only copied
+  // when the journal record is split into several events
+  assert(kUSNChangeReasonFlagList.size() <= kUSNChangeReasonFlagCount);
+  std::array<USNJournalEventRecord::Type, kUSNChangeReasonFlagCount>
+      event_types;
+  size_t event_count = 0U;
+
   for (const auto& reason_bit : kUSNChangeReasonFlagList) {
     if ((journal_record_reason & reason_bit) == 0) {
       continue;
     }
 
-    auto new_record = base_record;
+    USNJournalEventRecord::Type event_type;
     if (!USNParsers::GetEventType(
-            new_record.type, reason_bit, base_record.attributes)) {
+            event_type, reason_bit, base_record.attributes)) {
       return Status::failure("Failed to get the event type");
     }
 
-    bool emit_record = true;
     auto last_file_state_it =
-        per_file_last_record_type_map.find(new_record.node_ref_number);
+        per_file_last_record_type_map.find(base_record.node_ref_number);
 
-    if (last_file_state_it == per_file_last_record_type_map.end()) {
-      emit_record = true;
-
-    } else {
-      auto last_file_state = last_file_state_it->second;
-      emit_record = last_file_state != new_record.type;
-    }
-
-    if (emit_record) {
-      if (FLAGS_usn_journal_reader_debug) {
-        TLOG << new_record;
+    if (last_file_state_it != per_file_last_record_type_map.end()) {
+      if (last_file_state_it->second == event_type) {
+        continue;
       }
 
-      new_records.push_back(std::move(new_record));
-      per_file_last_record_type_map[new_record.node_ref_number] =
-          new_record.type;
+      last_file_state_it->second = event_type;
+
+    } else {
+      per_file_last_record_type_map.insert(
+          {base_record.node_ref_number, event_type});
 
       // clear out space if map if hit size limit (oldest records, first)
       if (per_file_last_record_type_map.size() >= 20000U) {
@@ -517,6 +589,18 @@ Status USNJournalReader::DecompressRecord(
         per_file_last_record_type_map.erase(range_start, range_end);
       }
     }
+
+    event_types[event_count++] = event_type;
+  }
+
+  for (size_t i = 0U; i < event_count; ++i) {
+    if (i + 1U == event_count) {
+      base_record.type = event_types[i];
+      new_records.push_back(std::move(base_record));
+    } else {
+      new_records.push_back(base_record);
+      new_records.back().type = event_types[i];
+    }
   }
 
   return Status::success();
@@ -563,22 +647,43 @@ Status USNJournalReader::ProcessAndAppendUSNRecord(
     return Status::failure("Failed to get the file attributes");
   }
 
-  if (!USNParsers::GetEventString(base_event_record.name, record)) {
-    return Status::failure("Failed to acquire the file name");
-  }
-
   // Now decompress the record by splitting the `reason` field
   DWORD reason;
   if (!USNParsers::GetReason(reason, record)) {
     return Status::failure("Failed to get the `reason` field from the record");
   }
 
-  auto status = DecompressRecord(
-      record_list, base_event_record, reason, per_file_last_record_type_map);
+  auto first_new_record = record_list.size();
+  auto status = DecompressRecord(record_list,
+                                 std::move(base_event_record),
+                                 reason,
+                                 per_file_last_record_type_map);
   if (!status.ok()) {
     return status;
   }
 
+  // The name is only converted for the records that have not been
+  // deduplicated, and only once per journal record
+  if (first_new_record == record_list.size()) {
+    return Status::success();
+  }
+
+  auto& name = record_list[first_new_record].name;
+  if (!USNParsers::GetEventString(name, record)) {
+    record_list.resize(first_new_record);
+    return Status::failure("Failed to acquire the file name");
+  }
+
+  for (auto i = first_new_record; i < record_list.size(); ++i) {
+    if (i != first_new_record) {
+      record_list[i].name = record_list[first_new_record].name;
+    }
+
+    if (FLAGS_usn_journal_reader_debug) {
+      TLOG << record_list[i];
+    }
+  }
+
   return Status::success();
 }
 
@@ -187,9 +187,12 @@ class USNJournalReader final : public InternalRunnable {
   Status processAcquiredRecords(
       std::vector<USNJournalEventRecord>& record_list);
 
-  /// Sends the given record vector to the publisher
-  void dispatchEventRecords(
-      const std::vector<USNJournalEventRecord>& record_list);
+  /// Moves the given records to the publisher
+  void dispatchEventRecords(std::vector<USNJournalEventRecord>& record_list);
+
+  /// Adapts the read buffer size and the pause between reads to the amount
+  /// of data returned by the last read
+  void adaptReadCadence();
 
  protected:
   /// Service entry point
@@ -208,7 +211,7 @@ class USNJournalReader final : public InternalRunnable {
   /// Decompresses the record by generating distinct events
   static Status DecompressRecord(
       std::vector<USNJournalEventRecord>& new_records,
-      const USNJournalEventRecord& base_record,
+      USNJournalEventRecord base_record,
       DWORD journal_record_reason,
       USNPerFileLastRecordType& per_file_last_record_type_map);
 
@@ -7,9 +7,14 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <sstream>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/property_tree/detail/rapidxml.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
@@ -19,9 +24,287 @@
 #include <osquery/utils/conversions/windows/strings.h>
 
 namespace pt = boost::property_tree;
+namespace rx = boost::property_tree::detail::rapidxml;
 
 namespace osquery {
 
+namespace {
+
+using XmlNode = rx::xml_node<char>;
+
+/// The rapidxml flags read_xml uses by default.
+const int kXmlParseFlags = rx::parse_comment_nodes;
+
+Status validateWindowsEvent(const WELEvent& event) {
+  if (event.datetime.empty()) {
+    return Status::failure(
+        "Invalid Windows event object: the TimeCreated::SystemTime attribute "
+        "is missing or not valid");
+  }
+
+  if (event.source.empty()) {
+    return Status::failure(
+        "Invalid Windows event object: the Event.System.Channel tag is missing "
+        "or not valid");
+  }
+
+  if (event.provider_name.empty()) {
+    return Status::failure(
+        "Invalid Windows event object: the Provider::Name attribute is missing "
+        "or not valid");
+  }
+
+  if (event.event_id == -1) {
+    return Status::failure(
+        "Invalid Windows event object: the System.EventID tag is missing or "
+        "not valid");
+  }
+
+  if (event.task_id == -1) {
+    return Status::failure(
+        "Invalid Windows event object: the System.Task tag is missing or not "
+        "valid");
+  }
+
+  if (event.level == -1) {
+    return Status::failure(
+        "Invalid Windows event object: the System.Level tag is missing or not "
+        "valid");
+  }
+
+  return Status::success();
+}
+
+/// The text of an element, concatenated as read_xml stores it.
+std::string nodeText(const XmlNode* node) {
+  std::string text;
+  if (node == nullptr) {
+    return text;
+  }
+
+  for (auto child = node->first_node(); child != nullptr;
+       child = child->next_sibling()) {
+    if (child->type() == rx::node_data || child->type() == rx::node_cdata) {
+      text.append(child->value(), child->value_size());
+    }
+  }
+  return text;
+}
+
+std::string attributeValue(const XmlNode* node, const char* name) {
+  if (node == nullptr) {
+    return {};
+  }
+
+  auto attribute = node->first_attribute(name);
+  if (attribute == nullptr) {
+    return {};
+  }
+  return std::string(attribute->value(), attribute->value_size());
+}
+
+const XmlNode* childNode(const XmlNode* node, const char* name) {
+  return node != nullptr ? node->first_node(name) : nullptr;
+}
+
+/// Translate an integer the way property_tree does, or return -1.
+std::int64_t translateInteger(const std::string& text) {
+  if (text.empty()) {
+    return -1;
+  }
+
+  errno = 0;
+  char* end = nullptr;
+  auto value = std::strtoll(text.c_str(), &end, 10);
+  if (end == text.c_str() || errno == ERANGE || value < INT_MIN ||
+      value > INT_MAX) {
+    return -1;
+  }
+
+  for (; *end != '\0'; ++end) {
+    if (!std::isspace(static_cast<unsigned char>(*end))) {
+      return -1;
+    }
+  }
+  return static_cast<std::int64_t>(value);
+}
+
+/// Does the element have property_tree children: attributes, elements or
+/// comments.
+bool hasPtreeChildren(const XmlNode& node) {
+  if (node.first_attribute() != nullptr) {
+    return true;
+  }
+
+  for (auto child = node.first_node(); child != nullptr;
+       child = child->next_sibling()) {
+    if (child->type() == rx::node_element ||
+        child->type() == rx::node_comment) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Quote a string the way property_tree's write_json escapes it.
+void appendJSONString(std::string& output, const char* data, size_t size) {
+  static const char* kHexDigits = "0123456789ABCDEF";
+
+  output += '"';
+  for (size_t i = 0; i < size; ++i) {
+    auto c = static_cast<unsigned char>(data[i]);
+    if (c == 0x20 || c == 0x21 || (c >= 0x23 && c <= 0x2E) ||
+        (c >= 0x30 && c <= 0x5B) || c >= 0x5D) {
+      output += data[i];
+    } else if (c == '\b') {
+      output += "\\b";
+    } else if (c == '\f') {
+      output += "\\f";
+    } else if (c == '\n') {
+      output += "\\n";
+    } else if (c == '\r') {
+      output += "\\r";
+    } else if (c == '\t') {
+      output += "\\t";
+    } else if (c == '/') {
+      output += "\\/";
+    } else if (c == '"') {
+      output += "\\\"";
+    } else if (c == '\\') {
+      output += "\\\\";
+    } else {
+      output += "\\u00";
+      output += kHexDigits[c >> 4];
+      output += kHexDigits[c & 0xF];
+    }
+  }
+  output += '"';
+}
+
+std::string quoteJSON(const std::string& value) {
+  std::string output;
+  appendJSONString(output, value.data(), value.size());
+  return output;
+}
+
+using JSONEntries = std::vector<std::pair<std::string, std::string>>;
+
+/// Write entries as property_tree does: a value, an array or an object.
+std::string serializeEntries(const JSONEntries& entries) {
+  if (entries.empty()) {
+    return "\"\"";
+  }
+
+  bool as_array = true;
+  for (const auto& entry : entries) {
+    if (!entry.first.empty()) {
+      as_array = false;
+      break;
+    }
+  }
+
+  std::string output(1, as_array ? '[' : '{');
+  for (const auto& entry : entries) {
+    if (output.size() > 1) {
+      output += ',';
+    }
+    if (!as_array) {
+      appendJSONString(output, entry.first.data(), entry.first.size());
+      output += ':';
+    }
+    output += entry.second;
+  }
+  output += as_array ? ']' : '}';
+  return output;
+}
+
+/**
+ * @brief Serialize an EventData or UserData element directly to JSON.
+ *
+ * This produces the output of parseChildNodeToJSONPtree and write_json for
+ * the element without building a property_tree. Names that property_tree
+ * would treat as paths, and Data names it would replace, return false so the
+ * event is parsed through the property_tree instead.
+ */
+bool serializeEventData(const XmlNode& node, std::string& output) {
+  JSONEntries entries;
+  bool detect_data_type{true};
+  bool as_array{false};
+
+  if (node.first_attribute() != nullptr) {
+    JSONEntries attributes;
+    for (auto attribute = node.first_attribute(); attribute != nullptr;
+         attribute = attribute->next_attribute()) {
+      std::string name(attribute->name(), attribute->name_size());
+      if (name == "Data" || name.find('.') != std::string::npos) {
+        return false;
+      }
+      attributes.emplace_back(
+          std::move(name),
+          quoteJSON(std::string(attribute->value(), attribute->value_size())));
+    }
+    entries.emplace_back("<xmlattr>", serializeEntries(attributes));
+  }
+
+  for (auto child = node.first_node(); child != nullptr;
+       child = child->next_sibling()) {
+    if (child->type() == rx::node_comment) {
+      entries.emplace_back(
+          "<xmlcomment>",
+          quoteJSON(std::string(child->value(), child->value_size())));
+      continue;
+    }
+
+    if (child->type() != rx::node_element) {
+      continue;
+    }
+
+    std::string name(child->name(), child->name_size());
+    if (name == "Data") {
+      auto data_name = attributeValue(child, "Name");
+      if (detect_data_type) {
+        as_array = data_name.empty();
+        detect_data_type = false;
+      }
+
+      if (as_array) {
+        entries.emplace_back("", quoteJSON(nodeText(child)));
+        continue;
+      }
+
+      if (data_name.empty() || data_name.find('.') != std::string::npos) {
+        return false;
+      }
+      for (const auto& entry : entries) {
+        if (entry.first == data_name) {
+          return false;
+        }
+      }
+      entries.emplace_back(std::move(data_name), quoteJSON(nodeText(child)));
+
+    } else {
+      if (name.find('.') != std::string::npos) {
+        return false;
+      }
+
+      if (!hasPtreeChildren(*child)) {
+        entries.emplace_back(std::move(name), quoteJSON(nodeText(child)));
+      } else {
+        std::string nested;
+        if (!serializeEventData(*child, nested)) {
+          return false;
+        }
+        entries.emplace_back(std::move(name), std::move(nested));
+      }
+    }
+  }
+
+  output = serializeEntries(entries);
+  return true;
+}
+
+} // namespace
+
 static inline pt::ptree parseChildNodeToJSONPtree(
     const pt::ptree& event_data_node) {
   pt::ptree event_data;
@@ -102,52 +385,21 @@ Status parseWindowsEventLogPTree(WELEvent& windows_event,
 
   output.datetime =
       event_object.get("Event.System.TimeCreated.<xmlattr>.SystemTime", "");
-
-  if (output.datetime.empty()) {
-    return Status::failure(
-        "Invalid Windows event object: the TimeCreated::SystemTime attribute "
-        "is missing or not valid");
-  }
-
   output.source = event_object.get("Event.System.Channel", "");
-  if (output.source.empty()) {
-    return Status::failure(
-        "Invalid Windows event object: the Event.System.Channel tag is missing "
-        "or not valid");
-  }
-
   output.provider_name =
       event_object.get("Event.System.Provider.<xmlattr>.Name", "");
 
-  if (output.provider_name.empty()) {
-    return Status::failure(
-        "Invalid Windows event object: the Provider::Name attribute is missing "
-        "or not valid");
-  }
-
   // This field may be missing
   output.provider_guid =
       event_object.get("Event.System.Provider.<xmlattr>.Guid", "");
 
   output.event_id = event_object.get("Event.System.EventID", -1);
-  if (output.event_id == -1) {
-    return Status::failure(
-        "Invalid Windows event object: the System.EventID tag is missing or "
-        "not valid");
-  }
-
   output.task_id = event_object.get("Event.System.Task", -1);
-  if (output.task_id == -1) {
-    return Status::failure(
-        "Invalid Windows event object: the System.Task tag is missing or not "
-        "valid");
-  }
-
   output.level = event_object.get("Event.System.Level", -1);
-  if (output.level == -1) {
-    return Status::failure(
-        "Invalid Windows event object: the System.Level tag is missing or not "
-        "valid");
+
+  auto status = validateWindowsEvent(output);
+  if (!status.ok()) {
+    return status;
   }
 
   // Some events may not have associated ProcessID and ThreadID; fallback value
@@ -161,6 +413,15 @@ Status parseWindowsEventLogPTree(WELEvent& windows_event,
   // sqlite does not have an unsigned version for sqlite3_result_int64
   output.keywords = event_object.get("Event.System.Keywords", "");
 
+  auto event_data_opt = event_object.get_child_optional("Event.EventData");
+  if (event_data_opt) {
+    output.has_event_data = true;
+    for (const auto& p : event_data_opt.value()) {
+      output.event_data.emplace_back(p.second.get("<xmlattr>.Name", ""),
+                                     p.second.data());
+    }
+  }
+
   pt::ptree property_list;
   auto getDataFromPtree = [&](std::string node_name) -> void {
     auto event_data_node_opt = event_object.get_child_optional(node_name);
@@ -177,9 +438,15 @@ Status parseWindowsEventLogPTree(WELEvent& windows_event,
   getDataFromPtree("Event.EventData");
   getDataFromPtree("Event.UserData");
 
+  auto property_list_opt = property_list.get_child_optional("Event");
+  if (!property_list_opt) {
+    return Status::failure(
+        "Invalid Windows event object: the EventData output is empty");
+  }
+
   try {
     std::stringstream stream;
-    pt::write_json(stream, property_list.get_child("Event"), false);
+    pt::write_json(stream, property_list_opt.value(), false);
 
     output.data = stream.str();
 
@@ -199,4 +466,99 @@ Status parseWindowsEventLogPTree(WELEvent& windows_event,
   windows_event = std::move(output);
   return Status::success();
 }
+
+Status parseWindowsEventLog(WELEvent& windows_event,
+                            const std::wstring& xml_event) {
+  windows_event = {};
+
+  // rapidxml parses in place, the converted string is its buffer.
+  auto buffer = wstringToString(xml_event.c_str());
+  rx::xml_document<char> document;
+  try {
+    document.parse<kXmlParseFlags>(&buffer[0]);
+  } catch (const rx::parse_error& e) {
+    return Status::failure(std::string("Failed to parse the XML event: ") +
+                           e.what());
+  }
+
+  const auto event = document.first_node("Event");
+  const auto system = childNode(event, "System");
+  const auto provider = childNode(system, "Provider");
+  const auto execution = childNode(system, "Execution");
+
+  WELEvent output;
+  output.osquery_time = std::time(nullptr);
+  output.datetime =
+      attributeValue(childNode(system, "TimeCreated"), "SystemTime");
+  output.source = nodeText(childNode(system, "Channel"));
+  output.provider_name = attributeValue(provider, "Name");
+  output.provider_guid = attributeValue(provider, "Guid");
+  output.event_id = translateInteger(nodeText(childNode(system, "EventID")));
+  output.task_id = translateInteger(nodeText(childNode(system, "Task")));
+  output.level = translateInteger(nodeText(childNode(system, "Level")));
+
+  auto status = validateWindowsEvent(output);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Some events may not have associated ProcessID and ThreadID
+  output.pid = translateInteger(attributeValue(execution, "ProcessID"));
+  output.tid = translateInteger(attributeValue(execution, "ThreadID"));
+
+  output.keywords = nodeText(childNode(system, "Keywords"));
+
+  const auto event_data = childNode(event, "EventData");
+  const auto user_data = childNode(event, "UserData");
+  if (event_data != nullptr) {
+    output.has_event_data = true;
+    if (event_data->first_attribute() != nullptr) {
+      output.event_data.emplace_back("", "");
+    }
+    for (auto child = event_data->first_node(); child != nullptr;
+         child = child->next_sibling()) {
+      if (child->type() == rx::node_element) {
+        output.event_data.emplace_back(attributeValue(child, "Name"),
+                                       nodeText(child));
+      } else if (child->type() == rx::node_comment) {
+        output.event_data.emplace_back(
+            "", std::string(child->value(), child->value_size()));
+      }
+    }
+  }
+
+  if (event_data == nullptr && user_data == nullptr) {
+    return Status::failure(
+        "Invalid Windows event object: the EventData output is empty");
+  }
+
+  JSONEntries data_entries;
+  bool serialized = true;
+  for (const auto node : {event_data, user_data}) {
+    if (node == nullptr) {
+      continue;
+    }
+    std::string data;
+    if (!serializeEventData(*node, data)) {
+      serialized = false;
+      break;
+    }
+    data_entries.emplace_back(std::string(node->name(), node->name_size()),
+                              std::move(data));
+  }
+
+  if (!serialized) {
+    // Rare names need the property_tree path semantics.
+    pt::ptree event_object;
+    status = parseWindowsEventLogXML(event_object, xml_event);
+    if (!status.ok()) {
+      return status;
+    }
+    return parseWindowsEventLogPTree(windows_event, event_object);
+  }
+
+  output.data = serializeEntries(data_entries);
+  windows_event = std::move(output);
+  return Status::success();
+}
 } // namespace osquery
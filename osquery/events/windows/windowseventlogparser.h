@@ -10,6 +10,9 @@
 #pragma once
 
 #include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -34,8 +37,16 @@ struct WELEvent final {
 
   std::string keywords;
   std::string data;
+
+  // The Name attribute and text of each Event.EventData child, in order
+  std::vector<std::pair<std::string, std::string>> event_data;
+  bool has_event_data{false};
 };
 
+// Parse a rendered event directly into its fields, without a property_tree
+Status parseWindowsEventLog(WELEvent& windows_event,
+                            const std::wstring& xml_event);
+
 // Process event log and generate the property_tree object
 Status parseWindowsEventLogXML(boost::property_tree::ptree& event_object,
                                const std::wstring& xml_event);
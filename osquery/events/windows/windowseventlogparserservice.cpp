@@ -8,10 +8,12 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <thread>
+#include <vector>
 
-#include <boost/property_tree/xml_parser.hpp>
-
+#include <osquery/core/flags.h>
 #include <osquery/events/windows/windowseventlogparser.h>
 #include <osquery/events/windows/windowseventlogpublisher.h>
 #include <osquery/logger/logger.h>
@@ -19,15 +21,35 @@
 #include <osquery/utils/system/system.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     windows_events_parser_threads,
+     2,
+     "Threads parsing Windows events, each channel is parsed by one thread");
+
+FLAG(uint64,
+     windows_events_parser_queue,
+     100000,
+     "Windows events queued for parsing before new events are dropped");
+
 namespace {
 using ChannelQueue =
     std::unordered_map<std::string, EvtSubscription::EventList>;
-}
 
-struct WindowsEventLogParserService::PrivateData final {
+/// A parser thread and the queues of the channels assigned to it.
+struct ParserWorker final {
   ChannelQueue channel_queue;
   std::mutex channel_queue_mutex;
   std::condition_variable channel_queue_cv;
+};
+} // namespace
+
+struct WindowsEventLogParserService::PrivateData final {
+  std::vector<std::unique_ptr<ParserWorker>> workers;
+
+  /// Events waiting in the channel queues of every worker.
+  std::atomic<std::size_t> queued_events{0U};
+  std::atomic<std::size_t> dropped_events{0U};
 
   ChannelEventObjects channel_event_objects;
   std::mutex channel_event_objects_mutex;
@@ -35,25 +57,47 @@ struct WindowsEventLogParserService::PrivateData final {
 };
 
 WindowsEventLogParserService::WindowsEventLogParserService()
-    : InternalRunnable("WindowsEventLogParserService"), d_(new PrivateData) {}
+    : InternalRunnable("WindowsEventLogParserService"), d_(new PrivateData) {
+  auto worker_count =
+      std::max<std::size_t>(FLAGS_windows_events_parser_threads, 1U);
+  for (std::size_t i = 0U; i < worker_count; ++i) {
+    d_->workers.push_back(std::make_unique<ParserWorker>());
+  }
+}
 
 WindowsEventLogParserService::~WindowsEventLogParserService() {}
 
 void WindowsEventLogParserService::start() {
+  // The first worker runs on the service thread.
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1U; i < d_->workers.size(); ++i) {
+    threads.emplace_back([this, i]() { parseChannels(i); });
+  }
+
+  parseChannels(0U);
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void WindowsEventLogParserService::parseChannels(std::size_t worker_index) {
+  auto& worker = *d_->workers[worker_index];
+
   while (!interrupted()) {
     ChannelQueue channel_queue = {};
 
     {
-      std::unique_lock<std::mutex> lock(d_->channel_queue_mutex);
+      std::unique_lock<std::mutex> lock(worker.channel_queue_mutex);
 
-      auto ready = d_->channel_queue_cv.wait_for(
-          lock, std::chrono::seconds(1U), [=]() -> bool {
-            return !d_->channel_queue.empty();
+      auto ready = worker.channel_queue_cv.wait_for(
+          lock, std::chrono::seconds(1U), [&worker]() -> bool {
+            return !worker.channel_queue.empty();
           });
 
       if (ready) {
-        channel_queue = std::move(d_->channel_queue);
-        d_->channel_queue = {};
+        channel_queue = std::move(worker.channel_queue);
+        worker.channel_queue = {};
       }
     }
 
@@ -62,22 +106,17 @@ void WindowsEventLogParserService::start() {
     }
 
     ChannelEventObjects channel_event_objects = {};
+    std::size_t parsed_events{0U};
 
     for (const auto& p : channel_queue) {
       const auto& channel = p.first;
       const auto& raw_event_list = p.second;
 
-      auto channel_output_it = channel_event_objects.find(channel);
-      if (channel_output_it == channel_event_objects.end()) {
-        auto insert_status = channel_event_objects.insert({channel, {}});
-        channel_output_it = insert_status.first;
-      }
-
-      auto& channel_output = channel_output_it->second;
-
+      auto& channel_output = channel_event_objects[channel];
+      channel_output.reserve(raw_event_list.size());
       for (const auto& raw_event : raw_event_list) {
-        boost::property_tree::ptree event_object;
-        auto status = parseWindowsEventLogXML(event_object, raw_event);
+        WELEvent event_object;
+        auto status = parseWindowsEventLog(event_object, raw_event);
         if (!status.ok()) {
           LOG(ERROR) << status.getMessage();
           continue;
@@ -85,14 +124,26 @@ void WindowsEventLogParserService::start() {
 
         channel_output.push_back(std::move(event_object));
       }
+
+      parsed_events += raw_event_list.size();
     }
 
-    if (!channel_event_objects.empty()) {
+    d_->queued_events -= parsed_events;
+
+    {
+      // A channel is only parsed by this worker, appending keeps its order.
       std::lock_guard<std::mutex> lock(d_->channel_event_objects_mutex);
 
-      d_->channel_event_objects.insert(
-          std::make_move_iterator(channel_event_objects.begin()),
-          std::make_move_iterator(channel_event_objects.end()));
+      for (auto& p : channel_event_objects) {
+        auto& output = d_->channel_event_objects[p.first];
+        if (output.empty()) {
+          output = std::move(p.second);
+        } else {
+          output.insert(output.end(),
+                        std::make_move_iterator(p.second.begin()),
+                        std::make_move_iterator(p.second.end()));
+        }
+      }
     }
 
     d_->channel_event_objects_cv.notify_one();
@@ -107,23 +158,31 @@ void WindowsEventLogParserService::addEventList(
     return;
   }
 
-  {
-    std::lock_guard<std::mutex> lock(d_->channel_queue_mutex);
+  // Bound the backlog, the oldest events are already waiting to be parsed.
+  auto event_count = event_list.size();
+  if (d_->queued_events + event_count > FLAGS_windows_events_parser_queue) {
+    auto dropped = d_->dropped_events.fetch_add(event_count) + event_count;
+    LOG(WARNING) << "The Windows event parser backlog is full, dropped "
+                 << event_count << " events from channel " << channel << " ("
+                 << dropped << " in total)";
+    return;
+  }
 
-    auto channel_queue_it = d_->channel_queue.find(channel);
-    if (channel_queue_it == d_->channel_queue.end()) {
-      auto insert_status = d_->channel_queue.insert({channel, {}});
-      channel_queue_it = insert_status.first;
-    }
+  d_->queued_events += event_count;
 
-    auto& queue = channel_queue_it->second;
+  auto worker_index = std::hash<std::string>()(channel) % d_->workers.size();
+  auto& worker = *d_->workers[worker_index];
+
+  {
+    std::lock_guard<std::mutex> lock(worker.channel_queue_mutex);
 
+    auto& queue = worker.channel_queue[channel];
     queue.insert(queue.end(),
                  std::make_move_iterator(event_list.begin()),
                  std::make_move_iterator(event_list.end()));
   }
 
-  d_->channel_queue_cv.notify_one();
+  worker.channel_queue_cv.notify_one();
 }
 
 WindowsEventLogParserService::ChannelEventObjects
@@ -11,17 +11,16 @@
 
 #include <memory>
 
-#include <boost/property_tree/ptree.hpp>
-
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/windows/evtsubscription.h>
+#include <osquery/events/windows/windowseventlogparser.h>
 #include <osquery/utils/system/system.h>
 
 namespace osquery {
 class WindowsEventLogParserService final : public InternalRunnable {
  public:
-  using PropertyTreeList = std::vector<boost::property_tree::ptree>;
-  using ChannelEventObjects = std::unordered_map<std::string, PropertyTreeList>;
+  using WELEventList = std::vector<WELEvent>;
+  using ChannelEventObjects = std::unordered_map<std::string, WELEventList>;
 
   WindowsEventLogParserService();
   virtual ~WindowsEventLogParserService() override;
@@ -35,6 +34,9 @@ class WindowsEventLogParserService final : public InternalRunnable {
   ChannelEventObjects getChannelEventObjects();
 
  private:
+  /// Parse the channels assigned to a worker until the service stops.
+  void parseChannels(std::size_t worker_index);
+
   struct PrivateData;
   std::unique_ptr<PrivateData> d_;
 };
@@ -7,6 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/join.hpp>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/events/windows/windowseventlogpublisher.h>
@@ -21,6 +26,32 @@ namespace osquery {
 namespace {
 const int kCharFreqVectorLen{256};
 
+/// The events configuration key with the per-channel queries.
+const std::string kWindowsEventQueriesKey{"windows_event_queries"};
+
+/// Event IDs are 16-bit values.
+const std::uint32_t kMaxEventId{0xFFFF};
+
+Status loadChannelQueries(
+    WindowsEventLogPublisher::ChannelQueries& channel_queries) {
+  channel_queries = {};
+
+  auto parser = Config::getParser("events");
+  if (parser == nullptr) {
+    return Status::success();
+  }
+
+  const auto& config = parser->getData().doc();
+  if (!config.IsObject() || !config.HasMember("events") ||
+      !config["events"].IsObject() ||
+      !config["events"].HasMember(kWindowsEventQueriesKey)) {
+    return Status::success();
+  }
+
+  return WindowsEventLogPublisher::getChannelQueries(
+      config["events"][kWindowsEventQueriesKey], channel_queries);
+}
+
 Status loadCharacterFrequencyMap(std::vector<double>& character_frequency_map) {
   character_frequency_map = {};
 
@@ -115,6 +146,14 @@ void WindowsEventLogPublisher::configure() {
     LOG(ERROR) << status.getMessage();
   }
 
+  // Channels without a query receive all of their events.
+  ChannelQueries channel_queries;
+  status = loadChannelQueries(channel_queries);
+  if (!status.ok()) {
+    LOG(ERROR) << "Ignoring the Windows event queries: "
+               << status.getMessage();
+  }
+
   for (auto& current_subscriber : subscriptions_) {
     auto sc = getSubscriptionContext(current_subscriber->context);
     sc->character_frequency_map = character_frequency_map;
@@ -123,10 +162,16 @@ void WindowsEventLogPublisher::configure() {
     for (const auto& channel : channel_list) {
       EvtSubscription::Ref subscription = {};
 
-      status = EvtSubscription::create(subscription, channel);
+      std::string query{"*"};
+      auto query_it = channel_queries.find(channel);
+      if (query_it != channel_queries.end()) {
+        query = query_it->second;
+        VLOG(1) << "Subscribing to " << channel << " with the query " << query;
+      }
+
+      status = EvtSubscription::create(subscription, channel, query);
       if (!status.ok()) {
-        auto error = GetLastError();
-        LOG(WARNING) << "Failed to subscribe to " << channel << ": " << error;
+        LOG(WARNING) << status.getMessage();
 
       } else {
         d_->subscription_list.push_back(std::move(subscription));
@@ -183,6 +228,7 @@ Status WindowsEventLogPublisher::run() {
 
     auto current_time = std::chrono::steady_clock::now();
     if (current_time - last_fired_event_time >= std::chrono::seconds(2U)) {
+      std::vector<EventContextRef> event_contexts;
       for (auto& p : channel_event_objects) {
         const auto& channel_name = p.first;
         auto& event_objects = p.second;
@@ -191,9 +237,11 @@ Status WindowsEventLogPublisher::run() {
         event_context->channel = channel_name;
         event_context->event_objects = std::move(event_objects);
 
-        fire(event_context);
+        event_contexts.push_back(std::move(event_context));
       }
 
+      fireBatch(event_contexts);
+
       channel_event_objects = {};
 
       last_fired_event_time = std::chrono::steady_clock::now();
@@ -230,6 +278,130 @@ double WindowsEventLogPublisher::cosineSimilarity(
   return dot / (mag1 * mag2);
 }
 
+std::string WindowsEventLogPublisher::buildEventQuery(
+    std::vector<std::uint32_t> event_ids,
+    const std::vector<std::string>& providers) {
+  std::sort(event_ids.begin(), event_ids.end());
+  event_ids.erase(std::unique(event_ids.begin(), event_ids.end()),
+                  event_ids.end());
+
+  std::vector<std::string> id_expressions;
+  for (std::size_t first = 0; first < event_ids.size();) {
+    auto last = first;
+    while (last + 1 < event_ids.size() &&
+           event_ids[last + 1] == event_ids[last] + 1) {
+      ++last;
+    }
+
+    if (last - first >= 2) {
+      id_expressions.push_back(
+          "(EventID>=" + std::to_string(event_ids[first]) +
+          " and EventID<=" + std::to_string(event_ids[last]) + ")");
+    } else {
+      for (auto i = first; i <= last; ++i) {
+        id_expressions.push_back("EventID=" + std::to_string(event_ids[i]));
+      }
+    }
+    first = last + 1;
+  }
+
+  std::vector<std::string> provider_expressions;
+  for (const auto& provider : providers) {
+    provider_expressions.push_back("@Name='" + provider + "'");
+  }
+
+  std::vector<std::string> conditions;
+  if (!id_expressions.empty()) {
+    conditions.push_back("(" + boost::algorithm::join(id_expressions, " or ") +
+                         ")");
+  }
+
+  if (!provider_expressions.empty()) {
+    conditions.push_back("Provider[" +
+                         boost::algorithm::join(provider_expressions, " or ") +
+                         "]");
+  }
+
+  if (conditions.empty()) {
+    return "*";
+  }
+
+  return "*[System[" + boost::algorithm::join(conditions, " and ") + "]]";
+}
+
+Status WindowsEventLogPublisher::getChannelQueries(
+    const rapidjson::Value& queries, ChannelQueries& channel_queries) {
+  channel_queries = {};
+
+  if (!queries.IsObject()) {
+    return Status::failure(kWindowsEventQueriesKey + " is not an object");
+  }
+
+  // A configuration with an error is ignored as a whole.
+  ChannelQueries parsed_queries;
+  for (const auto& query : queries.GetObject()) {
+    auto channel = boost::algorithm::to_lower_copy(
+        std::string(query.name.GetString()));
+
+    if (query.value.IsString()) {
+      std::string value = query.value.GetString();
+      if (value.empty()) {
+        return Status::failure("The query of channel " + channel +
+                               " is empty");
+      }
+
+      parsed_queries[channel] = value;
+      continue;
+    }
+
+    if (!query.value.IsObject()) {
+      return Status::failure("The query of channel " + channel +
+                             " is not a string or an object");
+    }
+
+    std::vector<std::uint32_t> event_ids;
+    if (query.value.HasMember("event_ids")) {
+      const auto& ids = query.value["event_ids"];
+      if (!ids.IsArray()) {
+        return Status::failure("The event_ids of channel " + channel +
+                               " are not an array");
+      }
+
+      for (const auto& id : ids.GetArray()) {
+        if (!id.IsUint() || id.GetUint() > kMaxEventId) {
+          return Status::failure("The event_ids of channel " + channel +
+                                 " contain an invalid event ID");
+        }
+        event_ids.push_back(id.GetUint());
+      }
+    }
+
+    std::vector<std::string> providers;
+    if (query.value.HasMember("providers")) {
+      const auto& names = query.value["providers"];
+      if (!names.IsArray()) {
+        return Status::failure("The providers of channel " + channel +
+                               " are not an array");
+      }
+
+      for (const auto& name : names.GetArray()) {
+        // Names are quoted in the query, a quote would end them early.
+        if (!name.IsString() || name.GetStringLength() == 0 ||
+            std::string(name.GetString()).find('\'') != std::string::npos) {
+          return Status::failure("The providers of channel " + channel +
+                                 " contain an invalid provider name");
+        }
+        providers.push_back(name.GetString());
+      }
+    }
+
+    parsed_queries[channel] = buildEventQuery(event_ids, providers);
+  }
+
+  channel_queries = std::move(parsed_queries);
+  return Status::success();
+}
+
 void WindowsEventLogPublisher::tearDown() {
   if (!FLAGS_enable_windows_events_publisher) {
     return;
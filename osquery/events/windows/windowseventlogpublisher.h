@@ -9,11 +9,16 @@
 
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/windows/windowseventlogparserservice.h>
+#include <osquery/utils/json/json.h>
 
 namespace osquery {
 struct WindowsEventLogSubscriptionContext : public SubscriptionContext {
@@ -26,7 +31,7 @@ struct WindowsEventLogSubscriptionContext : public SubscriptionContext {
 
 struct WindowsEventLogEC : public EventContext {
   std::string channel;
-  WindowsEventLogParserService::PropertyTreeList event_objects;
+  WindowsEventLogParserService::WELEventList event_objects;
 };
 
 using WindowsEventLogECRef = std::shared_ptr<WindowsEventLogEC>;
@@ -49,6 +54,27 @@ class WindowsEventLogPublisher
   static double cosineSimilarity(const std::string& buffer,
                                  const std::vector<double>& global_freqs);
 
+  /// Subscription queries by lowercase channel name.
+  using ChannelQueries = std::map<std::string, std::string>;
+
+  /**
+   * @brief Build the XPath query selecting events by ID and provider.
+   *
+   * Consecutive IDs are merged into ranges, the event log rejects queries
+   * with too many expressions.
+   */
+  static std::string buildEventQuery(std::vector<std::uint32_t> event_ids,
+                                     const std::vector<std::string>& providers);
+
+  /**
+   * @brief Read the windows_event_queries object of the events configuration.
+   *
+   * Each channel maps to an XPath or structured query string, or to an
+   * object with "event_ids" and "providers" arrays.
+   */
+  static Status getChannelQueries(const rapidjson::Value& queries,
+                                  ChannelQueries& channel_queries);
+
  private:
   DECLARE_PUBLISHER("WindowsEventLogPublisher");
 
@@ -11,8 +11,10 @@
 #include <osquery/experimental/events_stream/events_stream_registry.h>
 
 #include <osquery/core/flags.h>
+#include <osquery/extensions/shared_ring.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/registry/registry_factory.h>
 
 #include <boost/io/detail/quoted_manip.hpp>
 
@@ -24,11 +26,23 @@ DEFINE_string(events_streaming_plugin,
 
 namespace events {
 
+bool isEventStreamingEnabled() {
+  return !FLAGS_events_streaming_plugin.empty();
+}
+
 void dispatchSerializedEvent(const std::string& serialized_event) {
   if (FLAGS_events_streaming_plugin.empty()) {
     LOG(INFO) << "New event: " << serialized_event;
     return;
   }
+  if (callSharedRing(streamRegistryName(),
+                     FLAGS_events_streaming_plugin,
+                     "event",
+                     serialized_event)
+          .ok()) {
+    return;
+  }
+
   auto status = Registry::call(streamRegistryName(),
                                FLAGS_events_streaming_plugin,
                                {
@@ -40,5 +54,65 @@ void dispatchSerializedEvent(const std::string& serialized_event) {
   }
 }
 
+void dispatchSerializedEvents(const SerializedEvents& events) {
+  if (events.empty()) {
+    return;
+  }
+
+  if (FLAGS_events_streaming_plugin.empty()) {
+    for (size_t i = 0; i < events.size(); ++i) {
+      LOG(INFO) << "New event: " << events.at(i);
+    }
+    return;
+  }
+
+  // A local plugin receives the whole batch, without copying each event.
+  auto& registry = RegistryFactory::get();
+  if (registry.exists(
+          streamRegistryName(), FLAGS_events_streaming_plugin, true)) {
+    auto plugin = std::dynamic_pointer_cast<EventsStreamPlugin>(
+        registry.plugin(streamRegistryName(), FLAGS_events_streaming_plugin));
+    auto status = (plugin != nullptr)
+                      ? plugin->streamEvents(events)
+                      : Status::failure("Unknown events streaming plugin");
+    if (!status.ok()) {
+      LOG(ERROR) << "Data loss. A batch of " << events.size() << " events from "
+                 << events.source << " dispatch failed because "
+                 << status.what();
+    }
+    return;
+  }
+
+  size_t failed = 0;
+  Status status;
+  std::string event;
+  for (size_t i = 0; i < events.size(); ++i) {
+    event.assign(events.at(i));
+    if (callSharedRing(streamRegistryName(),
+                       FLAGS_events_streaming_plugin,
+                       "event",
+                       event)
+            .ok()) {
+      continue;
+    }
+
+    auto event_status = Registry::call(streamRegistryName(),
+                                       FLAGS_events_streaming_plugin,
+                                       {
+                                           {"event", event},
+                                       });
+    if (!event_status.ok()) {
+      status = event_status;
+      ++failed;
+    }
+  }
+
+  if (failed > 0) {
+    LOG(ERROR) << "Data loss. " << failed << " of " << events.size()
+               << " events from " << events.source
+               << " dispatch failed because " << status.what();
+  }
+}
+
 } // namespace events
 } // namespace osquery
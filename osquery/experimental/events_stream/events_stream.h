@@ -11,10 +11,24 @@
 
 #include <string>
 
+#include <osquery/experimental/events_stream/events_stream_registry.h>
+
 namespace osquery {
 namespace events {
 
+/// True if events are streamed to a plugin, see --events_streaming_plugin.
+bool isEventStreamingEnabled();
+
 void dispatchSerializedEvent(const std::string& event);
 
+/**
+ * @brief Dispatch a batch of serialized events to the streaming plugin.
+ *
+ * A plugin within this process receives the whole batch with one
+ * EventsStreamPlugin::streamEvents call. An extension plugin receives each
+ * event as a shared ring record, or a Thrift call when the ring is unavailable.
+ */
+void dispatchSerializedEvents(const SerializedEvents& events);
+
 } // namespace events
 } // namespace osquery
@@ -23,6 +23,19 @@ Status EventsStreamPlugin::call(const PluginRequest& request,
   return Status::success();
 }
 
+Status EventsStreamPlugin::streamEvents(
+    const events::SerializedEvents& events) {
+  Status status;
+  for (size_t i = 0; i < events.size(); ++i) {
+    PluginResponse response;
+    auto event_status = call({{"event", std::string(events.at(i))}}, response);
+    if (!event_status.ok()) {
+      status = event_status;
+    }
+  }
+  return status;
+}
+
 namespace events {
 
 char const* streamRegistryName() {
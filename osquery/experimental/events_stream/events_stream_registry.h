@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/core/query.h>
 #include <osquery/utils/expected/expected.h>
@@ -16,10 +20,57 @@
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 
 namespace osquery {
+namespace events {
+
+/**
+ * @brief A batch of serialized events sharing one buffer.
+ *
+ * Each event is appended to the buffer and its end offset recorded, so a
+ * batch of any size costs a few allocations and is dispatched in one call.
+ */
+struct SerializedEvents {
+  /// The subscriber that generated the events.
+  std::string source;
+
+  /// The events, back to back and without separators.
+  std::string buffer;
+
+  /// The end offset of each event within the buffer.
+  std::vector<size_t> offsets;
+
+  void add(std::string_view event) {
+    buffer.append(event.data(), event.size());
+    offsets.push_back(buffer.size());
+  }
+
+  size_t size() const {
+    return offsets.size();
+  }
+
+  bool empty() const {
+    return offsets.empty();
+  }
+
+  /// The i-th event, valid while the batch is not modified.
+  std::string_view at(size_t i) const {
+    auto start = (i == 0) ? 0 : offsets[i - 1];
+    return std::string_view(buffer).substr(start, offsets[i] - start);
+  }
+};
+
+} // namespace events
 
 class EventsStreamPlugin : public Plugin {
  public:
   Status call(const PluginRequest& request, PluginResponse& response) override;
+
+  /**
+   * @brief Receive a batch of events in one call.
+   *
+   * Plugins streaming high-rate events should override this. The default
+   * calls the plugin with an {"event": ...} request for each event.
+   */
+  virtual Status streamEvents(const events::SerializedEvents& events);
 };
 
 namespace events {
@@ -7,10 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <boost/algorithm/string/trim.hpp>
@@ -177,7 +180,41 @@ Status applyExtensionDelay(std::function<Status(bool& stop)> predicate) {
   return status;
 }
 
+/**
+ * @brief Run a call on a pooled client to an extension or extension manager.
+ *
+ * A reused client may have been closed by a restarted server, a call that
+ * fails on one is retried on a new connection. Errors on the new connection
+ * throw like a caller-owned client would.
+ */
+template <typename Client>
+Status withPooledClient(const std::string& path,
+                        const std::function<Status(Client&)>& call) {
+  auto& pool = ExtensionClientPool::get();
+  auto manager = std::is_same<Client, ExtensionManagerClient>::value;
+  auto client = pool.take(path, manager);
+  if (client != nullptr) {
+    try {
+      auto status = call(static_cast<Client&>(*client));
+      pool.put(std::move(client));
+      return status;
+    } catch (const std::exception& /* e */) {
+      VLOG(1) << "Reconnecting to extension socket: " << path;
+    }
+  }
+
+  auto fresh = std::make_unique<Client>(path);
+  auto status = call(*fresh);
+  pool.put(std::move(fresh));
+  return status;
+}
+
 Status extensionPathActive(const std::string& path, bool use_timeout = false) {
+  // A connected client is proof enough, skip the connect and ping.
+  if (ExtensionClientPool::get().active(path)) {
+    return Status::success();
+  }
+
   return applyExtensionDelay(([path, &use_timeout](bool& stop) {
     if (socketExists(path)) {
       try {
@@ -245,6 +282,7 @@ void ExtensionManagerWatcher::start() {
       continue;
     }
   }
+  ExtensionClientPool::get().clear();
 }
 
 void ExtensionWatcher::exitFatal(int return_code) {
@@ -277,8 +315,8 @@ void ExtensionWatcher::watch() {
         }
       } else {
         // Ping the extension manager to check it's still there
-        ExtensionManagerClient client(path_);
-        status = client.ping();
+        status = withPooledClient<ExtensionManagerClient>(
+            path_, [](ExtensionManagerClient& client) { return client.ping(); });
         if (status.getCode() != (int)ExtensionCode::EXT_SUCCESS && fatal_) {
           // The core may be healthy but return a failed ping status.
           LOG(ERROR) << "Extension watcher ping failed: "
@@ -322,9 +360,9 @@ void ExtensionManagerWatcher::watch() {
     failures_[uuid] = 1;
     if (exists.ok()) {
       try {
-        ExtensionClient client(path);
         // Ping the extension until it goes down.
-        status = client.ping();
+        status = withPooledClient<ExtensionClient>(
+            path, [](ExtensionClient& client) { return client.ping(); });
       } catch (const std::exception& /* e */) {
         failures_[uuid] += 1;
         continue;
@@ -347,6 +385,7 @@ void ExtensionManagerWatcher::watch() {
     if (uuid.second > 1) {
       LOG(INFO) << "Extension UUID " << uuid.first << " has gone away";
       RegistryFactory::get().removeBroadcast(uuid.first);
+      ExtensionClientPool::get().remove(getExtensionSocket(uuid.first));
       failures_[uuid.first] = 1;
     }
   }
@@ -576,8 +615,10 @@ Status ExternalSQLPlugin::query(const std::string& query,
   }
 
   try {
-    ExtensionManagerClient client(FLAGS_extensions_socket);
-    status = client.query(query, results);
+    status = withPooledClient<ExtensionManagerClient>(
+        FLAGS_extensions_socket, [&](ExtensionManagerClient& client) {
+          return client.query(query, results);
+        });
   } catch (const std::exception& e) {
     return Status(1, "Extension call failed: " + std::string(e.what()));
   }
@@ -595,8 +636,10 @@ Status ExternalSQLPlugin::getQueryColumns(const std::string& query,
 
   QueryData qd;
   try {
-    ExtensionManagerClient client(FLAGS_extensions_socket);
-    status = client.getQueryColumns(query, qd);
+    status = withPooledClient<ExtensionManagerClient>(
+        FLAGS_extensions_socket, [&](ExtensionManagerClient& client) {
+          return client.getQueryColumns(query, qd);
+        });
   } catch (const std::exception& e) {
     return Status(1, "Extension call failed: " + std::string(e.what()));
   }
@@ -624,8 +667,8 @@ Status pingExtension(const std::string& path) {
   }
 
   try {
-    ExtensionClient client(path);
-    status = client.ping();
+    status = withPooledClient<ExtensionClient>(
+        path, [](ExtensionClient& client) { return client.ping(); });
   } catch (const std::exception& e) {
     return Status(1, "Extension call failed: " + std::string(e.what()));
   }
@@ -650,8 +693,11 @@ Status getExtensions(const std::string& manager_path,
 
   ExtensionList ext_list;
   try {
-    ExtensionManagerClient client(manager_path);
-    ext_list = client.extensions();
+    withPooledClient<ExtensionManagerClient>(
+        manager_path, [&](ExtensionManagerClient& client) {
+          ext_list = client.extensions();
+          return Status::success();
+        });
   } catch (const std::exception& e) {
     return Status(1, "Extension call failed: " + std::string(e.what()));
   }
@@ -694,8 +740,10 @@ Status callExtension(const std::string& extension_path,
   }
 
   try {
-    ExtensionClient client(extension_path);
-    status = client.call(registry, item, request, response);
+    status = withPooledClient<ExtensionClient>(
+        extension_path, [&](ExtensionClient& client) {
+          return client.call(registry, item, request, response);
+        });
   } catch (const std::exception& e) {
     return Status(1, "Extension call failed: " + std::string(e.what()));
   }
@@ -8,12 +8,17 @@
  */
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 
+#include <thrift/TApplicationException.h>
+#include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/ThreadManager.h>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TThreadPoolServer.h>
 #include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 
@@ -23,6 +28,8 @@
 #include <thrift/transport/TPipe.h>
 #include <thrift/transport/TPipeServer.h>
 #else
+#include <poll.h>
+
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSocket.h>
 #endif
@@ -32,7 +39,11 @@
 
 #include "osquery/extensions/interface.h"
 
+#include <algorithm>
+#include <chrono>
 #include <limits>
+#include <set>
+#include <unordered_map>
 
 #include <boost/chrono/include.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -41,6 +52,18 @@
 
 namespace osquery {
 
+FLAG(uint32,
+     extensions_server_threads,
+     0,
+     "Worker threads started by each extension Thrift server, 0 starts a "
+     "thread per connection (default 0)");
+
+FLAG(uint32,
+     extensions_server_max_connections,
+     0,
+     "Concurrent connections accepted by each extension Thrift server, 0 is "
+     "unlimited (default 0)");
+
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::transport;
@@ -95,6 +118,101 @@ class ThriftServerEventHandler : public TServerEventHandler,
   bool server_is_listening_;
 };
 
+/**
+ * @brief A Thrift server that runs connections on a pool of worker threads.
+ *
+ * TThreadedServer starts and joins a thread for every connection, while the
+ * core and its extensions connect to each other for many short calls. This
+ * server keeps its workers. A connection holds a worker until it closes and
+ * pooled clients stay connected, so the pool grows by a worker when none is
+ * idle. The server accepts no more connections than the pool may grow to,
+ * a new connection never waits on a worker held by an idle client.
+ */
+class ExtensionPoolServer : public TThreadPoolServer {
+ public:
+  ExtensionPoolServer(const std::shared_ptr<TProcessor>& processor,
+                      const std::shared_ptr<TServerTransport>& transport,
+                      const std::shared_ptr<TTransportFactory>& transport_fac,
+                      const std::shared_ptr<TProtocolFactory>& protocol_fac,
+                      const std::shared_ptr<ThreadManager>& thread_manager,
+                      size_t max_workers,
+                      const std::string& kind)
+      : TThreadPoolServer(
+            processor, transport, transport_fac, protocol_fac, thread_manager),
+        max_workers_(max_workers),
+        connections_(getMetric(
+            kind, "connections", monitoring::PreAggregationType::Max)),
+        workers_(
+            getMetric(kind, "workers", monitoring::PreAggregationType::Max)),
+        queued_(
+            getMetric(kind, "queued", monitoring::PreAggregationType::Sum)),
+        queue_time_(getMetric(
+            kind, "queue_time_ms", monitoring::PreAggregationType::Max)) {
+    setConcurrentClientLimit(static_cast<int64_t>(max_workers_));
+  }
+
+ protected:
+  void onClientConnected(
+      const std::shared_ptr<TConnectedClient>& client) override {
+    auto manager = getThreadManager();
+    if (manager->idleWorkerCount() <= manager->pendingTaskCount()) {
+      if (manager->workerCount() < max_workers_) {
+        manager->addWorker(1);
+      } else {
+        queued_.record(1);
+      }
+    }
+
+    connections_.record(getConcurrentClientCount());
+    workers_.record(manager->workerCount());
+    manager->add(std::make_shared<QueuedClient>(client, queue_time_),
+                 getTimeout(),
+                 getTaskExpiration());
+  }
+
+ private:
+  static monitoring::Metric getMetric(const std::string& kind,
+                                      const std::string& name,
+                                      monitoring::PreAggregationType type) {
+    return monitoring::Metric::get("extensions.server." + kind + "." + name,
+                                   type);
+  }
+
+  /// A connection waiting for a worker, recording how long it waited.
+  class QueuedClient : public Runnable {
+   public:
+    QueuedClient(std::shared_ptr<TConnectedClient> client,
+                 monitoring::Metric queue_time)
+        : client_(std::move(client)),
+          queue_time_(queue_time),
+          queued_at_(std::chrono::steady_clock::now()) {}
+
+    void run() override {
+      queue_time_.record(std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - queued_at_)
+                             .count());
+      client_->run();
+
+      // Disconnect now, the server counts the connection until then.
+      client_.reset();
+    }
+
+   private:
+    std::shared_ptr<TConnectedClient> client_;
+    monitoring::Metric queue_time_;
+    std::chrono::steady_clock::time_point queued_at_;
+  };
+
+ private:
+  /// The pool grows up to this many workers, and as many connections.
+  size_t max_workers_;
+
+  monitoring::Metric connections_;
+  monitoring::Metric workers_;
+  monitoring::Metric queued_;
+  monitoring::Metric queue_time_;
+};
+
 class ExtensionHandler : virtual public extensions::ExtensionIf,
                          public ExtensionInterface {
  public:
@@ -114,6 +232,11 @@ class ExtensionHandler : virtual public extensions::ExtensionIf,
   using ExtensionInterface::shutdown;
   void shutdown() override;
 
+  void callColumnar(extensions::ExtensionColumnarResponse& _return,
+                    const std::string& registry,
+                    const std::string& item,
+                    const extensions::ExtensionPluginRequest& request) override;
+
  protected:
   /// UUID accessor.
   RouteUUID getUUID() const;
@@ -167,7 +290,7 @@ class ExtensionManagerHandler : virtual public extensions::ExtensionManagerIf,
 
 struct ImplExtensionRunner {
   std::shared_ptr<TServerTransport> transport;
-  std::shared_ptr<TThreadedServer> server;
+  std::shared_ptr<TServerFramework> server;
   std::shared_ptr<TProcessor> processor;
   std::shared_ptr<ThriftServerEventHandler> server_event_handler;
 };
@@ -213,6 +336,94 @@ void ExtensionHandler::call(extensions::ExtensionResponse& _return,
 
 void ExtensionHandler::shutdown() {}
 
+/// Send plugin response rows by column, each column name is sent once.
+static void toColumnarResponse(PluginResponse& response,
+                               extensions::ExtensionColumnarResponse& columnar) {
+  std::unordered_map<std::string, size_t> indexes;
+  for (const auto& row : response) {
+    for (const auto& column : row) {
+      if (indexes.emplace(column.first, columnar.columns.size()).second) {
+        columnar.columns.push_back(column.first);
+      }
+    }
+  }
+
+  auto rows = response.size();
+  columnar.rows = static_cast<int32_t>(rows);
+  columnar.values.resize(columnar.columns.size() * rows);
+  std::vector<bool> set(columnar.values.size(), false);
+  for (size_t i = 0; i < rows; i++) {
+    for (auto& column : response[i]) {
+      auto index = indexes[column.first] * rows + i;
+      columnar.values[index] = std::move(column.second);
+      set[index] = true;
+    }
+  }
+
+  for (size_t index = 0; index < set.size(); index++) {
+    if (!set[index]) {
+      columnar.absent.push_back(static_cast<int32_t>(index));
+    }
+  }
+}
+
+/// Rebuild the plugin response rows from a columnar response.
+static Status fromColumnarResponse(
+    extensions::ExtensionColumnarResponse& columnar,
+    PluginResponse& response) {
+  if (columnar.rows < 0) {
+    return Status::failure("Invalid columnar response row count");
+  }
+
+  auto rows = static_cast<size_t>(columnar.rows);
+  auto& values = columnar.values;
+  if (values.size() != columnar.columns.size() * rows) {
+    return Status::failure("Invalid columnar response value count");
+  }
+
+  std::vector<bool> absent(values.size(), false);
+  for (auto index : columnar.absent) {
+    if (index < 0 || static_cast<size_t>(index) >= values.size()) {
+      return Status::failure("Invalid columnar response absent index");
+    }
+    absent[index] = true;
+  }
+
+  auto first = response.size();
+  response.resize(first + rows);
+  for (size_t j = 0; j < columnar.columns.size(); j++) {
+    const auto& column = columnar.columns[j];
+    for (size_t i = 0; i < rows; i++) {
+      auto index = j * rows + i;
+      if (!absent[index]) {
+        response[first + i][column] = std::move(values[index]);
+      }
+    }
+  }
+  return Status::success();
+}
+
+void ExtensionHandler::callColumnar(
+    extensions::ExtensionColumnarResponse& _return,
+    const std::string& registry,
+    const std::string& item,
+    const extensions::ExtensionPluginRequest& request) {
+  PluginRequest plugin_request;
+  for (const auto& request_item : request) {
+    plugin_request[request_item.first] = request_item.second;
+  }
+
+  PluginResponse response;
+  auto s = ExtensionInterface::call(registry, item, plugin_request, response);
+  _return.status.code = s.getCode();
+  _return.status.message = s.getMessage();
+  _return.status.uuid = getUUID();
+
+  if (s.ok()) {
+    toColumnarResponse(response, _return);
+  }
+}
+
 RouteUUID ExtensionHandler::getUUID() const {
   return uuid_;
 }
@@ -348,8 +559,30 @@ void ExtensionRunnerInterface::connect() {
   auto transport_fac = std::make_shared<TBufferedTransportFactory>();
   auto protocol_fac = std::make_shared<TBinaryProtocolFactory>();
 
-  server_->server = std::make_shared<TThreadedServer>(
-      server_->processor, server_->transport, transport_fac, protocol_fac);
+  auto threads = static_cast<size_t>(FLAGS_extensions_server_threads);
+  auto max_connections =
+      static_cast<size_t>(FLAGS_extensions_server_max_connections);
+  if (threads == 0) {
+    server_->server = std::make_shared<TThreadedServer>(
+        server_->processor, server_->transport, transport_fac, protocol_fac);
+    if (max_connections > 0) {
+      server_->server->setConcurrentClientLimit(
+          static_cast<int64_t>(max_connections));
+    }
+  } else {
+    auto thread_manager = ThreadManager::newSimpleThreadManager(threads);
+    thread_manager->threadFactory(std::make_shared<ThreadFactory>());
+    thread_manager->start();
+
+    server_->server = std::make_shared<ExtensionPoolServer>(
+        server_->processor,
+        server_->transport,
+        transport_fac,
+        protocol_fac,
+        thread_manager,
+        std::max(threads, max_connections),
+        manager_ ? "manager" : "extension");
+  }
 
   server_->server_event_handler = std::make_shared<ThriftServerEventHandler>();
   server_->server->setServerEventHandler(server_->server_event_handler);
@@ -430,6 +663,28 @@ bool ExtensionClientCore::manager() {
   return manager_;
 }
 
+const std::string& ExtensionClientCore::path() const {
+  return path_;
+}
+
+bool ExtensionClientCore::healthy() {
+  if (!client_->transport->isOpen()) {
+    return false;
+  }
+
+#ifndef WIN32
+  struct pollfd fds;
+  fds.fd = static_cast<int>(client_->socket->getSocketFD());
+  fds.events = POLLIN;
+  fds.revents = 0;
+  if (::poll(&fds, 1, 0) != 0) {
+    // Either the server closed the connection or left a stray response.
+    return false;
+  }
+#endif
+  return true;
+}
+
 ExtensionClient::ExtensionClient(const std::string& path, size_t timeout) {
   init(path, false);
   setTimeouts(timeout);
@@ -451,12 +706,50 @@ Status ExtensionClient::ping() {
   return Status(1);
 }
 
+/// Servers built before callColumnar, they are only sent call.
+static Mutex kColumnarUnsupportedMutex;
+static std::set<std::string> columnar_unsupported;
+
+static bool isColumnarSupported(const std::string& path) {
+  WriteLock lock(kColumnarUnsupportedMutex);
+  return columnar_unsupported.count(path) == 0;
+}
+
+static void setColumnarUnsupported(const std::string& path) {
+  WriteLock lock(kColumnarUnsupportedMutex);
+  columnar_unsupported.insert(path);
+}
+
 Status ExtensionClient::call(const std::string& registry,
                              const std::string& item,
                              const PluginRequest& request,
                              PluginResponse& response) {
-  extensions::ExtensionResponse er;
   auto client = manager() ? client_->em : client_->e;
+
+  // Table rows are the large responses, request those by column.
+  if (registry == "table" && isColumnarSupported(path_)) {
+    extensions::ExtensionColumnarResponse ecr;
+    try {
+      client->callColumnar(ecr, registry, item, request);
+      auto status = Status(ecr.status.code, ecr.status.message);
+      if (status.ok()) {
+        auto s = fromColumnarResponse(ecr, response);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+      return status;
+    } catch (const TApplicationException& e) {
+      if (e.getType() != TApplicationException::UNKNOWN_METHOD) {
+        throw;
+      }
+      VLOG(1) << "Extension socket " << path_
+              << " does not support columnar responses";
+      setColumnarUnsupported(path_);
+    }
+  }
+
+  extensions::ExtensionResponse er;
   client->call(er, registry, item, request);
   for (const auto& r : er.response) {
     response.push_back(r);
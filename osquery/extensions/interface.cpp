@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <string>
@@ -21,6 +22,7 @@
 #include <osquery/sql/sql.h>
 
 #include "osquery/extensions/interface.h"
+#include "osquery/extensions/shared_ring.h"
 
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
@@ -34,6 +36,9 @@ const std::vector<std::string> kSDKVersionChanges = {
     {"1.7.7"},
 };
 
+/// Idle clients kept per server socket, each holds a server thread.
+const size_t kExtensionMaxIdleClients{4};
+
 Status ExtensionInterface::ping() {
   // Need to translate return code into 0 and extract the UUID.
   assert(uuid_ < INT_MAX);
@@ -53,6 +58,12 @@ Status ExtensionInterface::call(const std::string& registry,
     local_item = RegistryFactory::get().getActive(registry);
   }
 
+  // Core offers a shared ring for bulk data, the plugin receives its records.
+  auto action = request.find("action");
+  if (action != request.end() && action->second == "shared_ring") {
+    return acceptSharedRing(registry, local_item, request, response);
+  }
+
   return RegistryFactory::call(registry, local_item, request, response);
 }
 
@@ -275,4 +286,68 @@ void ExtensionManagerRunner::start() {
                  << path_ << ") (" << e.what() << ")";
   }
 }
+
+std::unique_ptr<ExtensionClient> ExtensionClientPool::take(
+    const std::string& path, bool manager) {
+  WriteLock lock(mutex_);
+  auto clients = clients_.find(path);
+  if (clients == clients_.end()) {
+    return nullptr;
+  }
+
+  // Prefer the most recently used client, drop those the server closed.
+  auto& idle = clients->second;
+  for (size_t i = idle.size(); i > 0; i--) {
+    if (idle[i - 1]->manager() != manager) {
+      continue;
+    }
+
+    auto client = std::move(idle[i - 1]);
+    idle.erase(idle.begin() + (i - 1));
+    if (client->healthy()) {
+      return client;
+    }
+  }
+  return nullptr;
+}
+
+void ExtensionClientPool::put(std::unique_ptr<ExtensionClient> client) {
+  WriteLock lock(mutex_);
+  auto& idle = clients_[client->path()];
+  if (idle.size() < kExtensionMaxIdleClients) {
+    idle.push_back(std::move(client));
+  }
+}
+
+bool ExtensionClientPool::active(const std::string& path) {
+  WriteLock lock(mutex_);
+  auto clients = clients_.find(path);
+  if (clients == clients_.end()) {
+    return false;
+  }
+
+  auto& idle = clients->second;
+  idle.erase(std::remove_if(idle.begin(),
+                            idle.end(),
+                            [](std::unique_ptr<ExtensionClient>& client) {
+                              return !client->healthy();
+                            }),
+             idle.end());
+  return !idle.empty();
+}
+
+void ExtensionClientPool::remove(const std::string& path) {
+  WriteLock lock(mutex_);
+  clients_.erase(path);
+}
+
+void ExtensionClientPool::clear() {
+  WriteLock lock(mutex_);
+  clients_.clear();
+}
+
+ExtensionClientPool& ExtensionClientPool::get() {
+  static ExtensionClientPool pool;
+  return pool;
+}
 } // namespace osquery
@@ -9,9 +9,14 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <vector>
+
 #include <osquery/core/query.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/extensions/extensions.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -328,6 +333,17 @@ class ExtensionClientCore : private boost::noncopyable {
   /// Check if the client is an extension manager.
   bool manager();
 
+  /// Path to the server socket this client is connected to.
+  const std::string& path() const;
+
+  /**
+   * @brief Check if an idle client can still be used.
+   *
+   * The server never writes without a request, so a readable socket means it
+   * closed the connection.
+   */
+  bool healthy();
+
  protected:
   /// Path to extension server socket.
   std::string path_;
@@ -406,6 +422,42 @@ class ExtensionManagerClient : public ExtensionClient,
   Status getQueryColumns(const std::string& sql, QueryData& qd) override;
 };
 
+/**
+ * @brief Idle extension clients kept connected for reuse.
+ *
+ * Extension tables, config, and logger plugins call into an extension for
+ * every request. Returning the client to this pool keeps its socket open so
+ * the next call skips the connect. A client is only used by one caller at a
+ * time, concurrent callers take or create their own.
+ */
+class ExtensionClientPool : private boost::noncopyable {
+ public:
+  /// Take a healthy idle client for a path, or nullptr if there are none.
+  std::unique_ptr<ExtensionClient> take(const std::string& path, bool manager);
+
+  /// Return a client after a successful call.
+  void put(std::unique_ptr<ExtensionClient> client);
+
+  /// Check for a healthy idle client, meaning the server is active.
+  bool active(const std::string& path);
+
+  /// Close the idle clients for a path, such as an extension that went away.
+  void remove(const std::string& path);
+
+  /// Close all idle clients.
+  void clear();
+
+  /// The process-wide pool.
+  static ExtensionClientPool& get();
+
+ private:
+  Mutex mutex_;
+
+  /// Idle clients by server socket path.
+  std::map<std::string, std::vector<std::unique_ptr<ExtensionClient>>>
+      clients_;
+};
+
 /// Attempt to remove all stale extension sockets.
 void removeStalePaths(const std::string& manager);
 } // namespace osquery
@@ -0,0 +1,463 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <new>
+
+#include <osquery/core/flags.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/extensions/shared_ring.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     extensions_shared_ring_size,
+     0,
+     "Bytes of shared memory for bulk logger and event data sent to each "
+     "extension plugin (default 0, disabled)");
+
+namespace {
+
+const uint32_t kSharedRingMagic{0x6f737172};
+const uint32_t kSharedRingVersion{1};
+
+/// Records are aligned so that a record header never wraps.
+const size_t kSharedRingAlignment{8};
+
+/// Marks the unused end of the ring, the next record starts at offset 0.
+const uint32_t kSharedRingWrap{0xffffffff};
+
+/// The longest idle wait, in milliseconds, of a reader with an empty ring.
+const size_t kSharedRingMaxIdle{50};
+
+struct SharedRingRecord {
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+size_t alignRecord(size_t size) {
+  return (size + kSharedRingAlignment - 1) & ~(kSharedRingAlignment - 1);
+}
+
+} // namespace
+
+/// The start of the mapping, head and tail only ever increase.
+struct SharedRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> closed;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared ring positions must be lock free across processes");
+
+/// Records begin on a separate cache line from the positions.
+const size_t kSharedRingDataOffset{64};
+
+static_assert(sizeof(SharedRingHeader) <= kSharedRingDataOffset,
+              "Shared ring header must fit before the records");
+
+SharedRing::SharedRing(const std::string& name,
+                       void* mapping,
+                       size_t mapping_size,
+                       size_t capacity)
+    : name_(name),
+      mapping_(mapping),
+      mapping_size_(mapping_size),
+      capacity_(capacity) {
+  header_ = static_cast<SharedRingHeader*>(mapping_);
+  data_ = static_cast<char*>(mapping_) + kSharedRingDataOffset;
+}
+
+SharedRing::~SharedRing() {
+#ifndef WIN32
+  ::munmap(mapping_, mapping_size_);
+#endif
+}
+
+Status SharedRing::create(const std::string& name,
+                          size_t capacity,
+                          std::unique_ptr<SharedRing>& ring) {
+#ifdef WIN32
+  return Status::failure("Shared rings are not supported on this platform");
+#else
+  capacity = alignRecord(capacity);
+  if (capacity < kSharedRingAlignment * 2) {
+    return Status::failure("Shared ring capacity is too small");
+  }
+
+  auto fd =
+      ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd == -1) {
+    return Status::failure("Cannot create shared ring " + name + ": " +
+                           std::strerror(errno));
+  }
+
+  auto mapping_size = kSharedRingDataOffset + capacity;
+  if (::ftruncate(fd, static_cast<off_t>(mapping_size)) == -1) {
+    ::close(fd);
+    ::shm_unlink(name.c_str());
+    return Status::failure("Cannot size shared ring " + name);
+  }
+
+  auto mapping = ::mmap(
+      nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    return Status::failure("Cannot map shared ring " + name);
+  }
+
+  auto header = new (mapping) SharedRingHeader();
+  header->magic = kSharedRingMagic;
+  header->version = kSharedRingVersion;
+  header->capacity = capacity;
+  header->head = 0;
+  header->tail = 0;
+  header->closed = 0;
+
+  ring.reset(new SharedRing(name, mapping, mapping_size, capacity));
+  return Status::success();
+#endif
+}
+
+Status SharedRing::open(const std::string& name,
+                        std::unique_ptr<SharedRing>& ring) {
+#ifdef WIN32
+  return Status::failure("Shared rings are not supported on this platform");
+#else
+  auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    return Status::failure("Cannot open shared ring " + name + ": " +
+                           std::strerror(errno));
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) == -1 ||
+      static_cast<size_t>(st.st_size) <=
+          kSharedRingDataOffset + kSharedRingAlignment) {
+    ::close(fd);
+    return Status::failure("Invalid shared ring size " + name);
+  }
+
+  auto mapping_size = static_cast<size_t>(st.st_size);
+  auto mapping = ::mmap(
+      nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return Status::failure("Cannot map shared ring " + name);
+  }
+
+  // Some platforms round the size up to a page, trust the header's capacity.
+  auto header = static_cast<SharedRingHeader*>(mapping);
+  auto capacity = static_cast<size_t>(header->capacity);
+  if (header->magic != kSharedRingMagic ||
+      header->version != kSharedRingVersion ||
+      capacity > mapping_size - kSharedRingDataOffset ||
+      capacity < kSharedRingAlignment * 2 ||
+      capacity % kSharedRingAlignment != 0) {
+    ::munmap(mapping, mapping_size);
+    return Status::failure("Invalid shared ring header " + name);
+  }
+
+  ring.reset(new SharedRing(name, mapping, mapping_size, capacity));
+  return Status::success();
+#endif
+}
+
+void SharedRing::unlink() {
+#ifndef WIN32
+  ::shm_unlink(name_.c_str());
+#endif
+}
+
+bool SharedRing::write(const std::string& key, const std::string& value) {
+  auto size = alignRecord(sizeof(SharedRingRecord) + key.size() + value.size());
+  if (size > capacity_ || key.size() >= kSharedRingWrap ||
+      value.size() >= kSharedRingWrap) {
+    return false;
+  }
+
+  auto head = header_->head.load(std::memory_order_relaxed);
+  auto tail = header_->tail.load(std::memory_order_acquire);
+  auto offset = head % capacity_;
+
+  // A record that does not fit before the end of the ring starts at 0.
+  size_t skip = (capacity_ - offset < size) ? capacity_ - offset : 0;
+  if (head + skip + size - tail > capacity_) {
+    return false;
+  }
+
+  SharedRingRecord record;
+  if (skip > 0) {
+    record.key_size = kSharedRingWrap;
+    record.value_size = 0;
+    std::memcpy(data_ + offset, &record, sizeof(record));
+    offset = 0;
+  }
+
+  record.key_size = static_cast<uint32_t>(key.size());
+  record.value_size = static_cast<uint32_t>(value.size());
+  auto start = data_ + offset;
+  std::memcpy(start, &record, sizeof(record));
+  std::memcpy(start + sizeof(record), key.data(), key.size());
+  std::memcpy(start + sizeof(record) + key.size(), value.data(), value.size());
+
+  header_->head.store(head + skip + size, std::memory_order_release);
+  return true;
+}
+
+bool SharedRing::read(std::string& key, std::string& value) {
+  auto tail = header_->tail.load(std::memory_order_relaxed);
+  auto head = header_->head.load(std::memory_order_acquire);
+
+  while (tail != head) {
+    auto offset = tail % capacity_;
+    SharedRingRecord record;
+    std::memcpy(&record, data_ + offset, sizeof(record));
+    if (record.key_size == kSharedRingWrap) {
+      tail += capacity_ - offset;
+      continue;
+    }
+
+    auto size = sizeof(record) + static_cast<size_t>(record.key_size) +
+                record.value_size;
+    if (size > capacity_ - offset) {
+      // The writer never produces this, stop reading a corrupt ring.
+      header_->closed.store(1);
+      return false;
+    }
+
+    auto start = data_ + offset + sizeof(record);
+    key.assign(start, record.key_size);
+    value.assign(start + record.key_size, record.value_size);
+    header_->tail.store(tail + alignRecord(size), std::memory_order_release);
+    return true;
+  }
+
+  header_->tail.store(tail, std::memory_order_release);
+  return false;
+}
+
+void SharedRing::close() {
+  header_->closed.store(1);
+}
+
+bool SharedRing::closed() const {
+  return header_->closed.load() != 0;
+}
+
+namespace {
+
+/// The rings core created for extension plugins.
+class SharedRingWriters : private boost::noncopyable {
+ public:
+  Status write(const std::string& registry,
+               const std::string& item,
+               const std::string& key,
+               const std::string& value);
+
+ private:
+  struct Writer {
+    /// The extension that accepted, or declined, the ring.
+    RouteUUID uuid{0};
+
+    /// Empty when the extension does not support shared rings.
+    std::unique_ptr<SharedRing> ring;
+
+    Mutex mutex;
+  };
+
+  /// Offer a new ring to the extension plugin.
+  std::shared_ptr<Writer> offer(const std::string& registry,
+                                const std::string& item,
+                                RouteUUID uuid);
+
+ private:
+  Mutex mutex_;
+  std::map<std::string, std::shared_ptr<Writer>> writers_;
+  size_t next_id_{0};
+};
+
+SharedRingWriters kSharedRingWriters;
+
+Status SharedRingWriters::write(const std::string& registry,
+                                const std::string& item,
+                                const std::string& key,
+                                const std::string& value) {
+  if (FLAGS_extensions_shared_ring_size == 0) {
+    return Status::failure("Shared rings are disabled");
+  }
+
+  if (!RegistryFactory::get().exists(registry)) {
+    return Status::failure("Unknown registry: " + registry);
+  }
+
+  auto external = RegistryFactory::get().registry(registry)->getExternal();
+  auto route = external.find(item);
+  if (route == external.end()) {
+    return Status::failure("Not an extension plugin: " + item);
+  }
+
+  std::shared_ptr<Writer> writer;
+  {
+    WriteLock lock(mutex_);
+    auto& known = writers_[registry + "." + item];
+    if (known == nullptr || known->uuid != route->second) {
+      // The extension registered again, its previous ring has no reader.
+      if (known != nullptr && known->ring != nullptr) {
+        known->ring->close();
+      }
+      known = offer(registry, item, route->second);
+    }
+    writer = known;
+  }
+
+  if (writer->ring == nullptr) {
+    return Status::failure("Extension does not support shared rings");
+  }
+
+  WriteLock lock(writer->mutex);
+  if (!writer->ring->write(key, value)) {
+    return Status::failure("Shared ring is full");
+  }
+  return Status::success();
+}
+
+std::shared_ptr<SharedRingWriters::Writer> SharedRingWriters::offer(
+    const std::string& registry, const std::string& item, RouteUUID uuid) {
+  auto writer = std::make_shared<Writer>();
+  writer->uuid = uuid;
+
+#ifndef WIN32
+  auto name = "/osquery." + std::to_string(::getpid()) + "." +
+              std::to_string(uuid) + "." + std::to_string(++next_id_);
+#else
+  auto name = std::to_string(++next_id_);
+#endif
+
+  std::unique_ptr<SharedRing> ring;
+  auto status = SharedRing::create(
+      name, static_cast<size_t>(FLAGS_extensions_shared_ring_size), ring);
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage();
+    return writer;
+  }
+
+  PluginResponse response;
+  status = Registry::call(
+      registry, item, {{"action", "shared_ring"}, {"name", name}}, response);
+  // Both processes have mapped the ring, or the extension declined it.
+  ring->unlink();
+
+  if (status.ok() && !response.empty() &&
+      response[0].count("shared_ring") > 0 &&
+      response[0].at("shared_ring") == "1") {
+    VLOG(1) << "Sending " << registry << " plugin " << item
+            << " bulk data through shared ring " << name;
+    writer->ring = std::move(ring);
+  }
+  return writer;
+}
+
+/// Read an extension's ring and call the local plugin with each record.
+class SharedRingReader : public InternalRunnable {
+ public:
+  SharedRingReader(const std::string& registry,
+                   const std::string& item,
+                   std::unique_ptr<SharedRing> ring)
+      : InternalRunnable("SharedRingReader"),
+        registry_(registry),
+        item_(item),
+        ring_(std::move(ring)) {}
+
+ protected:
+  void start() override {
+    size_t idle = 1;
+    std::string key;
+    std::string value;
+    while (!interrupted()) {
+      if (ring_->read(key, value)) {
+        PluginResponse response;
+        auto status =
+            RegistryFactory::call(registry_, item_, {{key, value}}, response);
+        if (!status.ok()) {
+          VLOG(1) << "Shared ring " << ring_->name() << " call to " << item_
+                  << " failed: " << status.getMessage();
+        }
+        idle = 1;
+        continue;
+      }
+
+      if (ring_->closed()) {
+        break;
+      }
+      pause(std::chrono::milliseconds(idle));
+      idle = std::min(idle * 2, kSharedRingMaxIdle);
+    }
+  }
+
+ private:
+  std::string registry_;
+  std::string item_;
+  std::unique_ptr<SharedRing> ring_;
+};
+
+} // namespace
+
+Status callSharedRing(const std::string& registry,
+                      const std::string& item,
+                      const std::string& key,
+                      const std::string& value) {
+  return kSharedRingWriters.write(registry, item, key, value);
+}
+
+Status acceptSharedRing(const std::string& registry,
+                        const std::string& item,
+                        const PluginRequest& request,
+                        PluginResponse& response) {
+  auto name = request.find("name");
+  if (name == request.end()) {
+    return Status::failure("Shared ring action must include a name");
+  }
+
+  std::unique_ptr<SharedRing> ring;
+  auto status = SharedRing::open(name->second, ring);
+  if (!status.ok()) {
+    return status;
+  }
+
+  status = Dispatcher::addService(
+      std::make_shared<SharedRingReader>(registry, item, std::move(ring)));
+  if (!status.ok()) {
+    return status;
+  }
+
+  response.push_back({{"shared_ring", "1"}});
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/plugins/plugin.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+struct SharedRingHeader;
+
+/**
+ * @brief A single-producer, single-consumer ring buffer in shared memory.
+ *
+ * osquery core creates a ring for each extension plugin that receives bulk
+ * data, such as logger batches and streamed events. Each record is a
+ * single-key plugin request. The extension maps the ring by name, which core
+ * then removes, so only the two processes hold it.
+ *
+ * The writer only trusts its own copy of the capacity. A reader cannot make
+ * the writer touch memory outside of the mapping.
+ */
+class SharedRing : private boost::noncopyable {
+ public:
+  ~SharedRing();
+
+  /// Create and map a new ring holding capacity bytes of records.
+  static Status create(const std::string& name,
+                       size_t capacity,
+                       std::unique_ptr<SharedRing>& ring);
+
+  /// Map a ring created by another process.
+  static Status open(const std::string& name, std::unique_ptr<SharedRing>& ring);
+
+  /// Remove the ring's name, processes that mapped it keep using it.
+  void unlink();
+
+  /// Append a record, false if the ring does not have space for it.
+  bool write(const std::string& key, const std::string& value);
+
+  /// Take the next record, false if the ring is empty.
+  bool read(std::string& key, std::string& value);
+
+  /// Tell the reader no more records will be written.
+  void close();
+
+  /// True once the writer closed the ring.
+  bool closed() const;
+
+  const std::string& name() const {
+    return name_;
+  }
+
+ private:
+  SharedRing(const std::string& name,
+             void* mapping,
+             size_t mapping_size,
+             size_t capacity);
+
+ private:
+  std::string name_;
+  void* mapping_{nullptr};
+  size_t mapping_size_{0};
+
+  /// The bytes available to records, never read back from the mapping.
+  size_t capacity_{0};
+
+  SharedRingHeader* header_{nullptr};
+  char* data_{nullptr};
+};
+
+/**
+ * @brief Deliver a single-key request to an extension plugin's shared ring.
+ *
+ * The first call for an extension plugin creates a ring and offers it with
+ * the "shared_ring" plugin action. Extensions built without support, and
+ * every call while --extensions_shared_ring_size is 0, fail. Callers then
+ * send the request with Registry::call.
+ *
+ * @param registry The registry name of the extension plugin.
+ * @param item The extension plugin name.
+ * @param key The request key, the plugin receives {key: value}.
+ * @param value The request value.
+ * @return success if the record was written to the ring.
+ */
+Status callSharedRing(const std::string& registry,
+                      const std::string& item,
+                      const std::string& key,
+                      const std::string& value);
+
+/**
+ * @brief Handle an offered shared ring within an extension.
+ *
+ * A dispatcher service reads the ring and calls the local plugin with each
+ * record. The response acknowledges the ring to core.
+ */
+Status acceptSharedRing(const std::string& registry,
+                        const std::string& item,
+                        const PluginRequest& request,
+                        PluginResponse& response);
+
+} // namespace osquery
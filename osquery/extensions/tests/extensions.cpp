@@ -24,8 +24,10 @@
 
 #include <osquery/database/database.h>
 #include <osquery/extensions/interface.h>
+#include <osquery/extensions/shared_ring.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/process/process.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 #include <boost/filesystem.hpp>
 
@@ -34,6 +36,8 @@ namespace fs = boost::filesystem;
 namespace osquery {
 
 DECLARE_string(extensions_require);
+DECLARE_uint32(extensions_server_threads);
+DECLARE_uint32(extensions_server_max_connections);
 
 const int kDelay = 20;
 const int kTimeout = 3000;
@@ -169,6 +173,89 @@ TEST_F(ExtensionsTest, test_extension_runnable) {
   EXPECT_TRUE(ping());
 }
 
+TEST_F(ExtensionsTest, test_extension_pooled_clients) {
+  auto status = startExtensionManager(socket_path);
+  EXPECT_TRUE(status.ok()) << " error " << status.what();
+  EXPECT_TRUE(socketExistsLocal(socket_path));
+
+  auto& pool = ExtensionClientPool::get();
+  EXPECT_FALSE(pool.active(socket_path));
+  EXPECT_FALSE(registeredExtensions().empty());
+
+  // The manager client used to list extensions stays connected.
+  EXPECT_TRUE(pool.active(socket_path));
+  EXPECT_EQ(pool.take(socket_path, false), nullptr);
+  auto client = pool.take(socket_path, true);
+  ASSERT_NE(client, nullptr);
+  EXPECT_EQ(pool.take(socket_path, true), nullptr);
+  EXPECT_EQ(client->ping().getCode(), (int)ExtensionCode::EXT_SUCCESS);
+
+  pool.put(std::move(client));
+  EXPECT_TRUE(pool.active(socket_path));
+  pool.remove(socket_path);
+  EXPECT_FALSE(pool.active(socket_path));
+}
+
+TEST_F(ExtensionsTest, test_extension_pooled_server) {
+  FLAGS_extensions_server_threads = 1;
+  FLAGS_extensions_server_max_connections = 2;
+  auto status = startExtensionManager(socket_path);
+  EXPECT_TRUE(status.ok()) << " error " << status.what();
+  EXPECT_TRUE(socketExistsLocal(socket_path));
+
+  // A second connection is served while the first stays open.
+  ExtensionManagerClient first(socket_path);
+  EXPECT_EQ(first.ping().getCode(), (int)ExtensionCode::EXT_SUCCESS);
+  ExtensionManagerClient second(socket_path);
+  EXPECT_EQ(second.ping().getCode(), (int)ExtensionCode::EXT_SUCCESS);
+  EXPECT_EQ(first.ping().getCode(), (int)ExtensionCode::EXT_SUCCESS);
+
+  FLAGS_extensions_server_threads = 0;
+  FLAGS_extensions_server_max_connections = 0;
+}
+
+class ColumnarTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("value", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& /* context */) override {
+    TableRows results;
+    results.push_back(make_table_row({{"name", "a"}, {"value", ""}}));
+    results.push_back(make_table_row({{"name", "b"}}));
+    results.push_back(make_table_row({{"value", "c"}}));
+    return results;
+  }
+};
+
+TEST_F(ExtensionsTest, test_extension_columnar_call) {
+  auto status = startExtensionManager(socket_path);
+  EXPECT_TRUE(status.ok()) << " error " << status.what();
+  EXPECT_TRUE(socketExistsLocal(socket_path));
+
+  auto& rf = RegistryFactory::get();
+  rf.registry("table")->add("columnar_test",
+                            std::make_shared<ColumnarTablePlugin>());
+
+  // Table calls are sent and returned by column, absent columns stay absent.
+  PluginResponse response;
+  status = callExtension(socket_path,
+                         "table",
+                         "columnar_test",
+                         {{"action", "generate"}},
+                         response);
+  ASSERT_TRUE(status.ok()) << status.what();
+  PluginResponse expected = {
+      {{"name", "a"}, {"value", ""}}, {{"name", "b"}}, {{"value", "c"}}};
+  EXPECT_EQ(response, expected);
+
+  rf.registry("table")->remove("columnar_test");
+}
+
 TEST_F(ExtensionsTest, test_extension_start) {
   auto status = startExtensionManager(socket_path);
   EXPECT_TRUE(status.ok());
@@ -287,4 +374,46 @@ TEST_F(ExtensionsTest, test_extension_broadcast) {
   rf.allowDuplicates(false);
 }
 
+TEST_F(ExtensionsTest, test_shared_ring) {
+  if (isPlatform(PlatformType::TYPE_WINDOWS)) {
+    return;
+  }
+
+  // macOS limits shared memory names to 31 characters.
+  auto name = "/osquery.test." + fs::unique_path("%%%%.%%%%").string();
+  std::unique_ptr<SharedRing> writer;
+  ASSERT_TRUE(SharedRing::create(name, 128, writer).ok());
+
+  std::unique_ptr<SharedRing> reader;
+  ASSERT_TRUE(SharedRing::open(name, reader).ok());
+  writer->unlink();
+  EXPECT_FALSE(SharedRing::open(name, reader).ok());
+
+  // Records larger than the ring are never written.
+  EXPECT_FALSE(writer->write("event", std::string(256, 'x')));
+
+  // Fill and drain the ring enough times to wrap around its end.
+  std::string key;
+  std::string value;
+  size_t written = 0;
+  size_t read = 0;
+  for (size_t i = 0; i < 64; i++) {
+    auto expected = std::string(i % 24, 'a');
+    while (writer->write("event", expected)) {
+      written++;
+    }
+    while (reader->read(key, value)) {
+      EXPECT_EQ(key, "event");
+      EXPECT_EQ(value, expected);
+      read++;
+    }
+  }
+  EXPECT_EQ(written, read);
+  EXPECT_GT(read, 64U);
+
+  EXPECT_FALSE(reader->closed());
+  writer->close();
+  EXPECT_TRUE(reader->closed());
+}
+
 } // namespace osquery
@@ -525,6 +525,246 @@ uint32_t Extension_shutdown_presult::read(::apache::thrift::protocol::TProtocol*
   return xfer;
 }
 
+Extension_callColumnar_args::~Extension_callColumnar_args() noexcept {}
+
+uint32_t Extension_callColumnar_args::read(::apache::thrift::protocol::TProtocol* iprot) {
+
+  ::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TType ftype;
+  int16_t fid;
+
+  xfer += iprot->readStructBegin(fname);
+
+  using ::apache::thrift::protocol::TProtocolException;
+
+
+  while (true)
+  {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == ::apache::thrift::protocol::T_STOP) {
+      break;
+    }
+    switch (fid)
+    {
+      case 1:
+        if (ftype == ::apache::thrift::protocol::T_STRING) {
+          xfer += iprot->readString(this->registry);
+          this->__isset.registry = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 2:
+        if (ftype == ::apache::thrift::protocol::T_STRING) {
+          xfer += iprot->readString(this->item);
+          this->__isset.item = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 3:
+        if (ftype == ::apache::thrift::protocol::T_MAP) {
+          {
+            this->request.clear();
+            uint32_t _size134;
+            ::apache::thrift::protocol::TType _ktype135;
+            ::apache::thrift::protocol::TType _vtype136;
+            xfer += iprot->readMapBegin(_ktype135, _vtype136, _size134);
+            uint32_t _i138;
+            for (_i138 = 0; _i138 < _size134; ++_i138) {
+              std::string _key139;
+              xfer += iprot->readString(_key139);
+              std::string& _val140 = this->request[_key139];
+              xfer += iprot->readString(_val140);
+            }
+            xfer += iprot->readMapEnd();
+          }
+          this->__isset.request = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      default:
+        xfer += iprot->skip(ftype);
+        break;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  return xfer;
+}
+
+uint32_t Extension_callColumnar_args::write(::apache::thrift::protocol::TProtocol* oprot) const {
+  uint32_t xfer = 0;
+  ::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+  xfer += oprot->writeStructBegin("Extension_callColumnar_args");
+
+  xfer += oprot->writeFieldBegin("registry", ::apache::thrift::protocol::T_STRING, 1);
+  xfer += oprot->writeString(this->registry);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("item", ::apache::thrift::protocol::T_STRING, 2);
+  xfer += oprot->writeString(this->item);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("request", ::apache::thrift::protocol::T_MAP, 3);
+  {
+    xfer += oprot->writeMapBegin(::apache::thrift::protocol::T_STRING, ::apache::thrift::protocol::T_STRING, static_cast<uint32_t>(this->request.size()));
+    std::map<std::string, std::string>::const_iterator _iter141;
+    for (_iter141 = this->request.begin(); _iter141 != this->request.end();
+         ++_iter141) {
+      xfer += oprot->writeString(_iter141->first);
+      xfer += oprot->writeString(_iter141->second);
+    }
+    xfer += oprot->writeMapEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+Extension_callColumnar_pargs::~Extension_callColumnar_pargs() noexcept {}
+
+uint32_t Extension_callColumnar_pargs::write(::apache::thrift::protocol::TProtocol* oprot) const {
+  uint32_t xfer = 0;
+  ::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+  xfer += oprot->writeStructBegin("Extension_callColumnar_pargs");
+
+  xfer += oprot->writeFieldBegin("registry", ::apache::thrift::protocol::T_STRING, 1);
+  xfer += oprot->writeString((*(this->registry)));
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("item", ::apache::thrift::protocol::T_STRING, 2);
+  xfer += oprot->writeString((*(this->item)));
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("request", ::apache::thrift::protocol::T_MAP, 3);
+  {
+    xfer += oprot->writeMapBegin(::apache::thrift::protocol::T_STRING, ::apache::thrift::protocol::T_STRING, static_cast<uint32_t>((*(this->request)).size()));
+    std::map<std::string, std::string>::const_iterator _iter142;
+    for (_iter142 = (*(this->request)).begin();
+         _iter142 != (*(this->request)).end();
+         ++_iter142) {
+      xfer += oprot->writeString(_iter142->first);
+      xfer += oprot->writeString(_iter142->second);
+    }
+    xfer += oprot->writeMapEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+Extension_callColumnar_result::~Extension_callColumnar_result() noexcept {}
+
+uint32_t Extension_callColumnar_result::read(::apache::thrift::protocol::TProtocol* iprot) {
+
+  ::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TType ftype;
+  int16_t fid;
+
+  xfer += iprot->readStructBegin(fname);
+
+  using ::apache::thrift::protocol::TProtocolException;
+
+
+  while (true)
+  {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == ::apache::thrift::protocol::T_STOP) {
+      break;
+    }
+    switch (fid)
+    {
+      case 0:
+        if (ftype == ::apache::thrift::protocol::T_STRUCT) {
+          xfer += this->success.read(iprot);
+          this->__isset.success = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      default:
+        xfer += iprot->skip(ftype);
+        break;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  return xfer;
+}
+
+uint32_t Extension_callColumnar_result::write(::apache::thrift::protocol::TProtocol* oprot) const {
+
+  uint32_t xfer = 0;
+
+  xfer += oprot->writeStructBegin("Extension_callColumnar_result");
+
+  if (this->__isset.success) {
+    xfer += oprot->writeFieldBegin("success", ::apache::thrift::protocol::T_STRUCT, 0);
+    xfer += this->success.write(oprot);
+    xfer += oprot->writeFieldEnd();
+  }
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+Extension_callColumnar_presult::~Extension_callColumnar_presult() noexcept {}
+
+uint32_t Extension_callColumnar_presult::read(::apache::thrift::protocol::TProtocol* iprot) {
+
+  ::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TType ftype;
+  int16_t fid;
+
+  xfer += iprot->readStructBegin(fname);
+
+  using ::apache::thrift::protocol::TProtocolException;
+
+
+  while (true)
+  {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == ::apache::thrift::protocol::T_STOP) {
+      break;
+    }
+    switch (fid)
+    {
+      case 0:
+        if (ftype == ::apache::thrift::protocol::T_STRUCT) {
+          xfer += (*(this->success)).read(iprot);
+          this->__isset.success = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      default:
+        xfer += iprot->skip(ftype);
+        break;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  return xfer;
+}
+
 void ExtensionClient::ping(ExtensionStatus& _return)
 {
   send_ping();
@@ -694,6 +934,66 @@ void ExtensionClient::recv_shutdown()
   return;
 }
 
+void ExtensionClient::callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request)
+{
+  send_callColumnar(registry, item, request);
+  recv_callColumnar(_return);
+}
+
+void ExtensionClient::send_callColumnar(const std::string& registry, const std::string& item, const ExtensionPluginRequest& request)
+{
+  int32_t cseqid = 0;
+  oprot_->writeMessageBegin("callColumnar", ::apache::thrift::protocol::T_CALL, cseqid);
+
+  Extension_callColumnar_pargs args;
+  args.registry = &registry;
+  args.item = &item;
+  args.request = &request;
+  args.write(oprot_);
+
+  oprot_->writeMessageEnd();
+  oprot_->getTransport()->writeEnd();
+  oprot_->getTransport()->flush();
+}
+
+void ExtensionClient::recv_callColumnar(ExtensionColumnarResponse& _return)
+{
+
+  int32_t rseqid = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TMessageType mtype;
+
+  iprot_->readMessageBegin(fname, mtype, rseqid);
+  if (mtype == ::apache::thrift::protocol::T_EXCEPTION) {
+    ::apache::thrift::TApplicationException x;
+    x.read(iprot_);
+    iprot_->readMessageEnd();
+    iprot_->getTransport()->readEnd();
+    throw x;
+  }
+  if (mtype != ::apache::thrift::protocol::T_REPLY) {
+    iprot_->skip(::apache::thrift::protocol::T_STRUCT);
+    iprot_->readMessageEnd();
+    iprot_->getTransport()->readEnd();
+  }
+  if (fname.compare("callColumnar") != 0) {
+    iprot_->skip(::apache::thrift::protocol::T_STRUCT);
+    iprot_->readMessageEnd();
+    iprot_->getTransport()->readEnd();
+  }
+  Extension_callColumnar_presult result;
+  result.success = &_return;
+  result.read(iprot_);
+  iprot_->readMessageEnd();
+  iprot_->getTransport()->readEnd();
+
+  if (result.__isset.success) {
+    // _return pointer has now been filled
+    return;
+  }
+  throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::MISSING_RESULT, "callColumnar failed: unknown result");
+}
+
 bool ExtensionProcessor::dispatchCall(::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, const std::string& fname, int32_t seqid, void* callContext) {
   ProcessMap::iterator pfn;
   pfn = processMap_.find(fname);
@@ -874,6 +1174,60 @@ void ExtensionProcessor::process_shutdown(int32_t seqid, ::apache::thrift::proto
   }
 }
 
+void ExtensionProcessor::process_callColumnar(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext)
+{
+  void* ctx = NULL;
+  if (this->eventHandler_.get() != NULL) {
+    ctx = this->eventHandler_->getContext("Extension.callColumnar", callContext);
+  }
+  ::apache::thrift::TProcessorContextFreer freer(this->eventHandler_.get(), ctx, "Extension.callColumnar");
+
+  if (this->eventHandler_.get() != NULL) {
+    this->eventHandler_->preRead(ctx, "Extension.callColumnar");
+  }
+
+  Extension_callColumnar_args args;
+  args.read(iprot);
+  iprot->readMessageEnd();
+  uint32_t bytes = iprot->getTransport()->readEnd();
+
+  if (this->eventHandler_.get() != NULL) {
+    this->eventHandler_->postRead(ctx, "Extension.callColumnar", bytes);
+  }
+
+  Extension_callColumnar_result result;
+  try {
+    iface_->callColumnar(result.success, args.registry, args.item, args.request);
+    result.__isset.success = true;
+  } catch (const std::exception& e) {
+    if (this->eventHandler_.get() != NULL) {
+      this->eventHandler_->handlerError(ctx, "Extension.callColumnar");
+    }
+
+    ::apache::thrift::TApplicationException x(e.what());
+    oprot->writeMessageBegin("callColumnar", ::apache::thrift::protocol::T_EXCEPTION, seqid);
+    x.write(oprot);
+    oprot->writeMessageEnd();
+    oprot->getTransport()->writeEnd();
+    oprot->getTransport()->flush();
+    return;
+  }
+
+  if (this->eventHandler_.get() != NULL) {
+    this->eventHandler_->preWrite(ctx, "Extension.callColumnar");
+  }
+
+  oprot->writeMessageBegin("callColumnar", ::apache::thrift::protocol::T_REPLY, seqid);
+  result.write(oprot);
+  oprot->writeMessageEnd();
+  bytes = oprot->getTransport()->writeEnd();
+  oprot->getTransport()->flush();
+
+  if (this->eventHandler_.get() != NULL) {
+    this->eventHandler_->postWrite(ctx, "Extension.callColumnar", bytes);
+  }
+}
+
 ::std::shared_ptr<::apache::thrift::TProcessor>
 ExtensionProcessorFactory::getProcessor(
     const ::apache::thrift::TConnectionInfo& connInfo) {
@@ -1134,5 +1488,92 @@ void ExtensionConcurrentClient::recv_shutdown(const int32_t seqid)
   } // end while(true)
 }
 
+void ExtensionConcurrentClient::callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request)
+{
+  int32_t seqid = send_callColumnar(registry, item, request);
+  recv_callColumnar(_return, seqid);
+}
+
+int32_t ExtensionConcurrentClient::send_callColumnar(const std::string& registry, const std::string& item, const ExtensionPluginRequest& request)
+{
+  int32_t cseqid = this->sync_->generateSeqId();
+  ::apache::thrift::async::TConcurrentSendSentry sentry(this->sync_.get());
+  oprot_->writeMessageBegin("callColumnar", ::apache::thrift::protocol::T_CALL, cseqid);
+
+  Extension_callColumnar_pargs args;
+  args.registry = &registry;
+  args.item = &item;
+  args.request = &request;
+  args.write(oprot_);
+
+  oprot_->writeMessageEnd();
+  oprot_->getTransport()->writeEnd();
+  oprot_->getTransport()->flush();
+
+  sentry.commit();
+  return cseqid;
+}
+
+void ExtensionConcurrentClient::recv_callColumnar(ExtensionColumnarResponse& _return, const int32_t seqid)
+{
+
+  int32_t rseqid = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TMessageType mtype;
+
+  // the read mutex gets dropped and reacquired as part of waitForWork()
+  // The destructor of this sentry wakes up other clients
+  ::apache::thrift::async::TConcurrentRecvSentry sentry(this->sync_.get(),
+                                                        seqid);
+
+  while(true) {
+    if (!this->sync_->getPending(fname, mtype, rseqid)) {
+      iprot_->readMessageBegin(fname, mtype, rseqid);
+    }
+    if(seqid == rseqid) {
+      if (mtype == ::apache::thrift::protocol::T_EXCEPTION) {
+        ::apache::thrift::TApplicationException x;
+        x.read(iprot_);
+        iprot_->readMessageEnd();
+        iprot_->getTransport()->readEnd();
+        sentry.commit();
+        throw x;
+      }
+      if (mtype != ::apache::thrift::protocol::T_REPLY) {
+        iprot_->skip(::apache::thrift::protocol::T_STRUCT);
+        iprot_->readMessageEnd();
+        iprot_->getTransport()->readEnd();
+      }
+      if (fname.compare("callColumnar") != 0) {
+        iprot_->skip(::apache::thrift::protocol::T_STRUCT);
+        iprot_->readMessageEnd();
+        iprot_->getTransport()->readEnd();
+
+        // in a bad state, don't commit
+        using ::apache::thrift::protocol::TProtocolException;
+        throw TProtocolException(TProtocolException::INVALID_DATA);
+      }
+      Extension_callColumnar_presult result;
+      result.success = &_return;
+      result.read(iprot_);
+      iprot_->readMessageEnd();
+      iprot_->getTransport()->readEnd();
+
+      if (result.__isset.success) {
+        // _return pointer has now been filled
+        sentry.commit();
+        return;
+      }
+      // in a bad state, don't commit
+      throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::MISSING_RESULT, "callColumnar failed: unknown result");
+    }
+    // seqid != rseqid
+    this->sync_->updatePending(fname, mtype, rseqid);
+
+    // this will temporarily unlock the readMutex, and let other clients get work done
+    this->sync_->waitForWork(seqid);
+  } // end while(true)
+}
+
 }} // namespace
 
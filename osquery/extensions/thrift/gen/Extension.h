@@ -25,6 +25,7 @@ class ExtensionIf {
   virtual void ping(ExtensionStatus& _return) = 0;
   virtual void call(ExtensionResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) = 0;
   virtual void shutdown() = 0;
+  virtual void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) = 0;
 };
 
 class ExtensionIfFactory {
@@ -64,6 +65,9 @@ class ExtensionNull : virtual public ExtensionIf {
   void shutdown() {
     return;
   }
+  void callColumnar(ExtensionColumnarResponse& /* _return */, const std::string& /* registry */, const std::string& /* item */, const ExtensionPluginRequest& /* request */) {
+    return;
+  }
 };
 
 
@@ -350,6 +354,124 @@ class Extension_shutdown_presult {
 
 };
 
+typedef struct _Extension_callColumnar_args__isset {
+  _Extension_callColumnar_args__isset() : registry(false), item(false), request(false) {}
+  bool registry :1;
+  bool item :1;
+  bool request :1;
+} _Extension_callColumnar_args__isset;
+
+class Extension_callColumnar_args {
+ public:
+
+  Extension_callColumnar_args(const Extension_callColumnar_args&);
+  Extension_callColumnar_args(Extension_callColumnar_args&&);
+  Extension_callColumnar_args& operator=(const Extension_callColumnar_args&);
+  Extension_callColumnar_args& operator=(Extension_callColumnar_args&&);
+  Extension_callColumnar_args() : registry(), item() {
+  }
+
+  virtual ~Extension_callColumnar_args() noexcept;
+  std::string registry;
+  std::string item;
+  ExtensionPluginRequest request;
+
+  _Extension_callColumnar_args__isset __isset;
+
+  void __set_registry(const std::string& val);
+
+  void __set_item(const std::string& val);
+
+  void __set_request(const ExtensionPluginRequest& val);
+
+  bool operator == (const Extension_callColumnar_args & rhs) const
+  {
+    if (!(registry == rhs.registry))
+      return false;
+    if (!(item == rhs.item))
+      return false;
+    if (!(request == rhs.request))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_callColumnar_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_callColumnar_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+
+class Extension_callColumnar_pargs {
+ public:
+  virtual ~Extension_callColumnar_pargs() noexcept;
+  const std::string* registry;
+  const std::string* item;
+  const ExtensionPluginRequest* request;
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_callColumnar_result__isset {
+  _Extension_callColumnar_result__isset() : success(false) {}
+  bool success :1;
+} _Extension_callColumnar_result__isset;
+
+class Extension_callColumnar_result {
+ public:
+
+  Extension_callColumnar_result(const Extension_callColumnar_result&);
+  Extension_callColumnar_result(Extension_callColumnar_result&&);
+  Extension_callColumnar_result& operator=(const Extension_callColumnar_result&);
+  Extension_callColumnar_result& operator=(Extension_callColumnar_result&&);
+  Extension_callColumnar_result() {
+  }
+
+  virtual ~Extension_callColumnar_result() noexcept;
+  ExtensionColumnarResponse success;
+
+  _Extension_callColumnar_result__isset __isset;
+
+  void __set_success(const ExtensionColumnarResponse& val);
+
+  bool operator == (const Extension_callColumnar_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_callColumnar_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_callColumnar_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_callColumnar_presult__isset {
+  _Extension_callColumnar_presult__isset() : success(false) {}
+  bool success :1;
+} _Extension_callColumnar_presult__isset;
+
+class Extension_callColumnar_presult {
+ public:
+  virtual ~Extension_callColumnar_presult() noexcept;
+  ExtensionColumnarResponse* success;
+
+  _Extension_callColumnar_presult__isset __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
 class ExtensionClient : virtual public ExtensionIf {
  public:
   ExtensionClient(std::shared_ptr<::apache::thrift::protocol::TProtocol> prot) {
@@ -391,6 +513,9 @@ class ExtensionClient : virtual public ExtensionIf {
   void shutdown();
   void send_shutdown();
   void recv_shutdown();
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  void send_callColumnar(const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  void recv_callColumnar(ExtensionColumnarResponse& _return);
  protected:
   std::shared_ptr<::apache::thrift::protocol::TProtocol> piprot_;
   std::shared_ptr<::apache::thrift::protocol::TProtocol> poprot_;
@@ -409,11 +534,13 @@ class ExtensionProcessor : public ::apache::thrift::TDispatchProcessor {
   void process_ping(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
   void process_call(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
   void process_shutdown(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
+  void process_callColumnar(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
  public:
   ExtensionProcessor(::std::shared_ptr<ExtensionIf> iface) : iface_(iface) {
     processMap_["ping"] = &ExtensionProcessor::process_ping;
     processMap_["call"] = &ExtensionProcessor::process_call;
     processMap_["shutdown"] = &ExtensionProcessor::process_shutdown;
+    processMap_["callColumnar"] = &ExtensionProcessor::process_callColumnar;
   }
 
   virtual ~ExtensionProcessor() {}
@@ -474,6 +601,16 @@ class ExtensionMultiface : virtual public ExtensionIf {
     ifaces_[i]->shutdown();
   }
 
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) {
+    size_t sz = ifaces_.size();
+    size_t i = 0;
+    for (; i < (sz - 1); ++i) {
+      ifaces_[i]->callColumnar(_return, registry, item, request);
+    }
+    ifaces_[i]->callColumnar(_return, registry, item, request);
+    return;
+  }
+
 };
 
 // The 'concurrent' client is a thread safe client that correctly handles
@@ -525,6 +662,9 @@ class ExtensionConcurrentClient : virtual public ExtensionIf {
   void shutdown();
   int32_t send_shutdown();
   void recv_shutdown(const int32_t seqid);
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  int32_t send_callColumnar(const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  void recv_callColumnar(ExtensionColumnarResponse& _return, const int32_t seqid);
  protected:
   std::shared_ptr<::apache::thrift::protocol::TProtocol> piprot_;
   std::shared_ptr<::apache::thrift::protocol::TProtocol> poprot_;
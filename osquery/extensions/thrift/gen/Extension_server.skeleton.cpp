@@ -35,6 +35,11 @@ class ExtensionHandler : virtual public ExtensionIf {
     printf("shutdown\n");
   }
 
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) {
+    // Your implementation goes here
+    printf("callColumnar\n");
+  }
+
 };
 
 int main(int argc, char **argv) {
@@ -662,6 +662,252 @@ void ExtensionResponse::printTo(std::ostream& out) const {
   out << ")";
 }
 
+ExtensionColumnarResponse::~ExtensionColumnarResponse() noexcept {}
+
+void ExtensionColumnarResponse::__set_status(const ExtensionStatus& val) {
+  this->status = val;
+}
+
+void ExtensionColumnarResponse::__set_columns(const std::vector<std::string> & val) {
+  this->columns = val;
+}
+
+void ExtensionColumnarResponse::__set_rows(const int32_t val) {
+  this->rows = val;
+}
+
+void ExtensionColumnarResponse::__set_values(const std::vector<std::string> & val) {
+  this->values = val;
+}
+
+void ExtensionColumnarResponse::__set_absent(const std::vector<int32_t> & val) {
+  this->absent = val;
+}
+std::ostream& operator<<(std::ostream& out, const ExtensionColumnarResponse& obj)
+{
+  obj.printTo(out);
+  return out;
+}
+
+
+uint32_t ExtensionColumnarResponse::read(::apache::thrift::protocol::TProtocol* iprot) {
+
+  ::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TType ftype;
+  int16_t fid;
+
+  xfer += iprot->readStructBegin(fname);
+
+  using ::apache::thrift::protocol::TProtocolException;
+
+
+  while (true)
+  {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == ::apache::thrift::protocol::T_STOP) {
+      break;
+    }
+    switch (fid)
+    {
+      case 1:
+        if (ftype == ::apache::thrift::protocol::T_STRUCT) {
+          xfer += this->status.read(iprot);
+          this->__isset.status = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 2:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->columns.clear();
+            uint32_t _size30;
+            ::apache::thrift::protocol::TType _etype33;
+            xfer += iprot->readListBegin(_etype33, _size30);
+            this->columns.resize(_size30);
+            uint32_t _i34;
+            for (_i34 = 0; _i34 < _size30; ++_i34)
+            {
+              xfer += iprot->readString(this->columns[_i34]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.columns = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 3:
+        if (ftype == ::apache::thrift::protocol::T_I32) {
+          xfer += iprot->readI32(this->rows);
+          this->__isset.rows = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 4:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->values.clear();
+            uint32_t _size35;
+            ::apache::thrift::protocol::TType _etype38;
+            xfer += iprot->readListBegin(_etype38, _size35);
+            this->values.resize(_size35);
+            uint32_t _i39;
+            for (_i39 = 0; _i39 < _size35; ++_i39)
+            {
+              xfer += iprot->readString(this->values[_i39]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.values = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 5:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->absent.clear();
+            uint32_t _size40;
+            ::apache::thrift::protocol::TType _etype43;
+            xfer += iprot->readListBegin(_etype43, _size40);
+            this->absent.resize(_size40);
+            uint32_t _i44;
+            for (_i44 = 0; _i44 < _size40; ++_i44)
+            {
+              xfer += iprot->readI32(this->absent[_i44]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.absent = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      default:
+        xfer += iprot->skip(ftype);
+        break;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  return xfer;
+}
+
+uint32_t ExtensionColumnarResponse::write(::apache::thrift::protocol::TProtocol* oprot) const {
+  uint32_t xfer = 0;
+  ::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+  xfer += oprot->writeStructBegin("ExtensionColumnarResponse");
+
+  xfer += oprot->writeFieldBegin("status", ::apache::thrift::protocol::T_STRUCT, 1);
+  xfer += this->status.write(oprot);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("columns", ::apache::thrift::protocol::T_LIST, 2);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRING, static_cast<uint32_t>(this->columns.size()));
+    std::vector<std::string> ::const_iterator _iter45;
+    for (_iter45 = this->columns.begin(); _iter45 != this->columns.end(); ++_iter45)
+    {
+      xfer += oprot->writeString((*_iter45));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("rows", ::apache::thrift::protocol::T_I32, 3);
+  xfer += oprot->writeI32(this->rows);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("values", ::apache::thrift::protocol::T_LIST, 4);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRING, static_cast<uint32_t>(this->values.size()));
+    std::vector<std::string> ::const_iterator _iter46;
+    for (_iter46 = this->values.begin(); _iter46 != this->values.end(); ++_iter46)
+    {
+      xfer += oprot->writeString((*_iter46));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("absent", ::apache::thrift::protocol::T_LIST, 5);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_I32, static_cast<uint32_t>(this->absent.size()));
+    std::vector<int32_t> ::const_iterator _iter47;
+    for (_iter47 = this->absent.begin(); _iter47 != this->absent.end(); ++_iter47)
+    {
+      xfer += oprot->writeI32((*_iter47));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+void swap(ExtensionColumnarResponse &a, ExtensionColumnarResponse &b) {
+  using ::std::swap;
+  swap(a.status, b.status);
+  swap(a.columns, b.columns);
+  swap(a.rows, b.rows);
+  swap(a.values, b.values);
+  swap(a.absent, b.absent);
+  swap(a.__isset, b.__isset);
+}
+
+ExtensionColumnarResponse::ExtensionColumnarResponse(const ExtensionColumnarResponse& other48) {
+  status = other48.status;
+  columns = other48.columns;
+  rows = other48.rows;
+  values = other48.values;
+  absent = other48.absent;
+  __isset = other48.__isset;
+}
+ExtensionColumnarResponse::ExtensionColumnarResponse( ExtensionColumnarResponse&& other49) {
+  status = std::move(other49.status);
+  columns = std::move(other49.columns);
+  rows = std::move(other49.rows);
+  values = std::move(other49.values);
+  absent = std::move(other49.absent);
+  __isset = std::move(other49.__isset);
+}
+ExtensionColumnarResponse& ExtensionColumnarResponse::operator=(const ExtensionColumnarResponse& other50) {
+  status = other50.status;
+  columns = other50.columns;
+  rows = other50.rows;
+  values = other50.values;
+  absent = other50.absent;
+  __isset = other50.__isset;
+  return *this;
+}
+ExtensionColumnarResponse& ExtensionColumnarResponse::operator=(ExtensionColumnarResponse&& other51) {
+  status = std::move(other51.status);
+  columns = std::move(other51.columns);
+  rows = std::move(other51.rows);
+  values = std::move(other51.values);
+  absent = std::move(other51.absent);
+  __isset = std::move(other51.__isset);
+  return *this;
+}
+void ExtensionColumnarResponse::printTo(std::ostream& out) const {
+  using ::apache::thrift::to_string;
+  out << "ExtensionColumnarResponse(";
+  out << "status=" << to_string(status);
+  out << ", " << "columns=" << to_string(columns);
+  out << ", " << "rows=" << to_string(rows);
+  out << ", " << "values=" << to_string(values);
+  out << ", " << "absent=" << to_string(absent);
+  out << ")";
+}
+
 ExtensionException::~ExtensionException() noexcept {}
 
 void ExtensionException::__set_code(const int32_t val) {
@@ -769,34 +1015,34 @@ void swap(ExtensionException &a, ExtensionException &b) {
   swap(a.__isset, b.__isset);
 }
 
-ExtensionException::ExtensionException(const ExtensionException& other30)
+ExtensionException::ExtensionException(const ExtensionException& other52)
     : TException() {
-  code = other30.code;
-  message = other30.message;
-  uuid = other30.uuid;
-  __isset = other30.__isset;
+  code = other52.code;
+  message = other52.message;
+  uuid = other52.uuid;
+  __isset = other52.__isset;
 }
-ExtensionException::ExtensionException(ExtensionException&& other31)
+ExtensionException::ExtensionException(ExtensionException&& other53)
     : TException() {
-  code = std::move(other31.code);
-  message = std::move(other31.message);
-  uuid = std::move(other31.uuid);
-  __isset = std::move(other31.__isset);
+  code = std::move(other53.code);
+  message = std::move(other53.message);
+  uuid = std::move(other53.uuid);
+  __isset = std::move(other53.__isset);
 }
 ExtensionException& ExtensionException::operator=(
-    const ExtensionException& other32) {
-  code = other32.code;
-  message = other32.message;
-  uuid = other32.uuid;
-  __isset = other32.__isset;
+    const ExtensionException& other54) {
+  code = other54.code;
+  message = other54.message;
+  uuid = other54.uuid;
+  __isset = other54.__isset;
   return *this;
 }
 ExtensionException& ExtensionException::operator=(
-    ExtensionException&& other33) {
-  code = std::move(other33.code);
-  message = std::move(other33.message);
-  uuid = std::move(other33.uuid);
-  __isset = std::move(other33.__isset);
+    ExtensionException&& other55) {
+  code = std::move(other55.code);
+  message = std::move(other55.message);
+  uuid = std::move(other55.uuid);
+  __isset = std::move(other55.__isset);
   return *this;
 }
 void ExtensionException::printTo(std::ostream& out) const {
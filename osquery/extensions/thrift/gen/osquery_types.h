@@ -56,6 +56,8 @@ class ExtensionStatus;
 
 class ExtensionResponse;
 
+class ExtensionColumnarResponse;
+
 class ExtensionException;
 
 typedef struct _InternalOptionInfo__isset {
@@ -282,6 +284,74 @@ void swap(ExtensionResponse &a, ExtensionResponse &b);
 
 std::ostream& operator<<(std::ostream& out, const ExtensionResponse& obj);
 
+typedef struct _ExtensionColumnarResponse__isset {
+  _ExtensionColumnarResponse__isset() : status(false), columns(false), rows(false), values(false), absent(false) {}
+  bool status :1;
+  bool columns :1;
+  bool rows :1;
+  bool values :1;
+  bool absent :1;
+} _ExtensionColumnarResponse__isset;
+
+class ExtensionColumnarResponse : public virtual ::apache::thrift::TBase {
+ public:
+
+  ExtensionColumnarResponse(const ExtensionColumnarResponse&);
+  ExtensionColumnarResponse(ExtensionColumnarResponse&&);
+  ExtensionColumnarResponse& operator=(const ExtensionColumnarResponse&);
+  ExtensionColumnarResponse& operator=(ExtensionColumnarResponse&&);
+  ExtensionColumnarResponse() : rows(0) {
+  }
+
+  virtual ~ExtensionColumnarResponse() noexcept;
+  ExtensionStatus status;
+  std::vector<std::string>  columns;
+  int32_t rows;
+  std::vector<std::string>  values;
+  std::vector<int32_t>  absent;
+
+  _ExtensionColumnarResponse__isset __isset;
+
+  void __set_status(const ExtensionStatus& val);
+
+  void __set_columns(const std::vector<std::string> & val);
+
+  void __set_rows(const int32_t val);
+
+  void __set_values(const std::vector<std::string> & val);
+
+  void __set_absent(const std::vector<int32_t> & val);
+
+  bool operator == (const ExtensionColumnarResponse & rhs) const
+  {
+    if (!(status == rhs.status))
+      return false;
+    if (!(columns == rhs.columns))
+      return false;
+    if (!(rows == rhs.rows))
+      return false;
+    if (!(values == rhs.values))
+      return false;
+    if (!(absent == rhs.absent))
+      return false;
+    return true;
+  }
+  bool operator != (const ExtensionColumnarResponse &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const ExtensionColumnarResponse & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+  virtual void printTo(std::ostream& out) const;
+};
+
+void swap(ExtensionColumnarResponse &a, ExtensionColumnarResponse &b);
+
+std::ostream& operator<<(std::ostream& out, const ExtensionColumnarResponse& obj);
+
 typedef struct _ExtensionException__isset {
   _ExtensionException__isset() : code(false), message(false), uuid(false) {}
   bool code :1;
@@ -59,6 +59,18 @@ struct ExtensionResponse {
   2:ExtensionPluginResponse response,
 }
 
+/// Table rows sent by column, so each column name is serialized once.
+struct ExtensionColumnarResponse {
+  1:ExtensionStatus status,
+  /// The column names, in the order their values are listed.
+  2:list<string> columns,
+  3:i32 rows,
+  /// Values by column: row i of column j is at index (j * rows + i).
+  4:list<string> values,
+  /// Indexes into values for columns that are not set in their row.
+  5:list<i32> absent,
+}
+
 exception ExtensionException {
   1:i32 code,
   2:string message,
@@ -78,6 +90,13 @@ service Extension {
     3:ExtensionPluginRequest request),
   /// Request that an extension shutdown (does not apply to managers).
   void shutdown(),
+  /// Call a registry plugin that responds with rows, and return them by column.
+  /// Extensions built before this call reply with an unknown method error,
+  /// and the caller falls back to call.
+  ExtensionColumnarResponse callColumnar(
+    1:string registry,
+    2:string item,
+    3:ExtensionPluginRequest request),
 }
 
 /// The extension manager is run by the osquery core process.
@@ -161,18 +161,11 @@ Status decompress(const boost::filesystem::path& in,
   return Status(0);
 }
 
-Status archive(const std::set<boost::filesystem::path>& paths,
-               const boost::filesystem::path& out, std::size_t block_size) {
-  auto arch = archive_write_new();
-  if (arch == nullptr) {
-    return Status(1, "Failed to create tar archive");
-  }
-  archive_write_set_format_pax_restricted(arch);
-  auto ret = archive_write_open_filename(arch, out.string().c_str());
-  if (ret == ARCHIVE_FATAL) {
-    archive_write_free(arch);
-    return Status(1, "Failed to open tar archive for writing");
-  }
+static void writeArchiveEntries(
+    struct archive* arch,
+    const std::set<boost::filesystem::path>& paths,
+    std::size_t block_size) {
+  std::vector<char> block(block_size, 0);
   for (const auto& f : paths) {
     PlatformFile pFile(f, PF_OPEN_EXISTING | PF_READ);
 
@@ -186,17 +179,146 @@ Status archive(const std::set<boost::filesystem::path>& paths,
     auto blkCount = static_cast<size_t>(ceil(static_cast<double>(pFile.size()) /
                                              static_cast<double>(block_size)));
     for (size_t i = 0; i < blkCount; i++) {
-      std::vector<char> block(block_size, 0);
       auto r = pFile.read(block.data(), block_size);
-      if (r > 0 && static_cast<std::size_t>(r) != block_size) {
-        // resize the buffer to size we read as last block is likely smaller
-        block.resize(static_cast<std::size_t>(r));
+      if (r <= 0) {
+        break;
       }
-      archive_write_data(arch, block.data(), block.size());
+      archive_write_data(arch, block.data(), static_cast<std::size_t>(r));
     }
     archive_entry_free(entry);
   }
+}
+
+Status archive(const std::set<boost::filesystem::path>& paths,
+               const boost::filesystem::path& out, std::size_t block_size) {
+  auto arch = archive_write_new();
+  if (arch == nullptr) {
+    return Status(1, "Failed to create tar archive");
+  }
+  archive_write_set_format_pax_restricted(arch);
+  auto ret = archive_write_open_filename(arch, out.string().c_str());
+  if (ret == ARCHIVE_FATAL) {
+    archive_write_free(arch);
+    return Status(1, "Failed to open tar archive for writing");
+  }
+  writeArchiveEntries(arch, paths, block_size);
   archive_write_free(arch);
   return Status::success();
 };
+
+namespace {
+
+/// The destination of a streamed archive, compressing when a stream is set.
+struct ArchiveSink {
+  PlatformFile* file{nullptr};
+  ZSTD_CStream* cstream{nullptr};
+  const ArchiveObserver* observer{nullptr};
+  std::vector<char> buffer;
+};
+
+bool writeArchiveSink(ArchiveSink& sink, const void* data, size_t size) {
+  if (size == 0) {
+    return true;
+  }
+  auto written = sink.file->write(data, size);
+  if (written < 0 || static_cast<size_t>(written) != size) {
+    return false;
+  }
+  if (*sink.observer) {
+    (*sink.observer)(data, size);
+  }
+  return true;
+}
+
+la_ssize_t writeArchiveCallback(struct archive*,
+                                void* client_data,
+                                const void* buffer,
+                                size_t length) {
+  auto& sink = *static_cast<ArchiveSink*>(client_data);
+  if (sink.cstream == nullptr) {
+    return writeArchiveSink(sink, buffer, length)
+               ? static_cast<la_ssize_t>(length)
+               : -1;
+  }
+
+  ZSTD_inBuffer input = {buffer, length, 0};
+  while (input.pos < input.size) {
+    ZSTD_outBuffer output = {sink.buffer.data(), sink.buffer.size(), 0};
+    auto rc = ZSTD_compressStream(sink.cstream, &output, &input);
+    if (ZSTD_isError(rc) || !writeArchiveSink(sink, output.dst, output.pos)) {
+      return -1;
+    }
+  }
+  return static_cast<la_ssize_t>(length);
+}
+
+int closeArchiveCallback(struct archive*, void* client_data) {
+  auto& sink = *static_cast<ArchiveSink*>(client_data);
+  if (sink.cstream == nullptr) {
+    return ARCHIVE_OK;
+  }
+
+  size_t remaining = 0;
+  do {
+    ZSTD_outBuffer output = {sink.buffer.data(), sink.buffer.size(), 0};
+    remaining = ZSTD_endStream(sink.cstream, &output);
+    if (ZSTD_isError(remaining) ||
+        !writeArchiveSink(sink, output.dst, output.pos)) {
+      return ARCHIVE_FATAL;
+    }
+  } while (remaining > 0);
+  return ARCHIVE_OK;
+}
+
+} // namespace
+
+Status streamArchive(const std::set<boost::filesystem::path>& paths,
+                     const boost::filesystem::path& out,
+                     std::size_t block_size,
+                     bool compress,
+                     const ArchiveObserver& observer) {
+  PlatformFile outFile(out, PF_CREATE_ALWAYS | PF_WRITE);
+  if (!outFile.isValid()) {
+    return Status::failure("Could not open out file: " + out.string() +
+                           " for archiving");
+  }
+
+  ArchiveSink sink;
+  sink.file = &outFile;
+  sink.observer = &observer;
+  if (compress) {
+    sink.cstream = ZSTD_createCStream();
+    if (sink.cstream == nullptr) {
+      return Status::failure("Couldn't create compression stream");
+    }
+    if (ZSTD_isError(ZSTD_initCStream(sink.cstream, 1))) {
+      ZSTD_freeCStream(sink.cstream);
+      return Status::failure("Couldn't initialize compression stream");
+    }
+    sink.buffer.resize(ZSTD_CStreamOutSize());
+  }
+
+  auto arch = archive_write_new();
+  if (arch == nullptr) {
+    ZSTD_freeCStream(sink.cstream);
+    return Status::failure("Failed to create tar archive");
+  }
+  archive_write_set_format_pax_restricted(arch);
+  auto ret = archive_write_open(
+      arch, &sink, nullptr, writeArchiveCallback, closeArchiveCallback);
+  if (ret == ARCHIVE_FATAL) {
+    archive_write_free(arch);
+    ZSTD_freeCStream(sink.cstream);
+    return Status::failure("Failed to open tar archive for writing");
+  }
+
+  writeArchiveEntries(arch, paths, block_size);
+  ret = archive_write_close(arch);
+  archive_write_free(arch);
+  ZSTD_freeCStream(sink.cstream);
+  if (ret != ARCHIVE_OK) {
+    return Status::failure("Failed to write archive: " + out.string());
+  }
+  return Status::success();
+}
 } // namespace osquery
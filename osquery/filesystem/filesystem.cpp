@@ -7,15 +7,18 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include <fcntl.h>
 #include <sys/stat.h>
 
 #ifndef WIN32
+#include <dirent.h>
 #include <glob.h>
 #include <pwd.h>
 #include <sys/time.h>
+#include <unistd.h>
 #endif
 
 #include <boost/algorithm/string.hpp>
@@ -25,6 +28,7 @@
 
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
@@ -158,8 +162,12 @@ Status readFile(const fs::path& path,
     block_size = (block_size < 4096) ? 4096 : block_size;
     ssize_t part_bytes = 0;
     bool overflow = false;
+    std::string part;
     do {
-      std::string part(block_size, '\0');
+      // Reuse the block unless the predicate kept or replaced it.
+      if (part.size() != block_size) {
+        part.assign(block_size, '\0');
+      }
       part_bytes = handle.fd->read(&part[0], block_size);
       if (part_bytes > 0) {
         total_bytes += static_cast<off_t>(part_bytes);
@@ -291,6 +299,7 @@ Status removePath(const fs::path& path) {
   return Status(0, std::to_string(removed_files));
 }
 
+#ifdef WIN32
 static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
   if (path.empty() || path.back() != '/') {
     return false;
@@ -315,12 +324,188 @@ static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
   }
   return false;
 }
+#endif
+
+#ifndef WIN32
+namespace {
+
+/// A directory to list for a recursive glob.
+struct GlobDirectory {
+  /// The directory path, with a trailing '/'.
+  std::string path;
+
+  /// The glob level of the directory's entries.
+  size_t depth{0};
+
+  /// The device and inode of every directory above it, to break loops.
+  std::vector<std::pair<dev_t, ino_t>> ancestors;
+};
+
+using GlobEntry = std::pair<size_t, std::string>;
+
+/**
+ * @brief List a directory as a '*' glob with GLOB_MARK would.
+ *
+ * Hidden entries are skipped and directories, including symlinks to
+ * directories, are marked with a trailing '/'. Only symlinks and entries of
+ * an unknown type are stat-ed, relative to the open directory.
+ */
+void listGlobDirectory(const GlobDirectory& directory,
+                       size_t max_depth,
+                       std::vector<GlobEntry>& entries,
+                       std::vector<GlobDirectory>& subdirectories) {
+  int fd = ::open(directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat dir_stat;
+  if (::fstat(fd, &dir_stat) != 0) {
+    ::close(fd);
+    return;
+  }
+
+  auto id = std::make_pair(dir_stat.st_dev, dir_stat.st_ino);
+  if (std::find(directory.ancestors.begin(), directory.ancestors.end(), id) !=
+      directory.ancestors.end()) {
+    VLOG(1) << "Symlink loop detected. Ignoring: " << directory.path;
+    ::close(fd);
+    return;
+  }
+
+  auto dir = ::fdopendir(fd);
+  if (dir == nullptr) {
+    ::close(fd);
+    return;
+  }
+
+  struct dirent* entry = nullptr;
+  while ((entry = ::readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    bool is_directory = (entry->d_type == DT_DIR);
+    if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+      struct stat entry_stat;
+      is_directory =
+          ::fstatat(::dirfd(dir), entry->d_name, &entry_stat, 0) == 0 &&
+          S_ISDIR(entry_stat.st_mode);
+    }
+
+    auto path = directory.path + entry->d_name;
+    if (is_directory) {
+      path += '/';
+      if (directory.depth < max_depth) {
+        GlobDirectory subdirectory;
+        subdirectory.path = path;
+        subdirectory.depth = directory.depth + 1;
+        subdirectory.ancestors = directory.ancestors;
+        subdirectory.ancestors.push_back(id);
+        subdirectories.push_back(std::move(subdirectory));
+      }
+    }
+    entries.emplace_back(directory.depth, std::move(path));
+  }
+
+  ::closedir(dir);
+}
+
+/**
+ * @brief Expand a trailing recursive wildcard below the first level matches.
+ *
+ * The directories are listed once each by the table workers, which share a
+ * queue of the directories left to list. Results are ordered as the repeated
+ * globs of each level were: by level, then by path.
+ */
+void genRecursiveGlobs(const std::vector<std::string>& roots,
+                       size_t max_depth,
+                       std::vector<std::string>& results) {
+  std::vector<GlobDirectory> pending;
+  for (const auto& root : roots) {
+    if (!root.empty() && root.back() == '/') {
+      GlobDirectory directory;
+      directory.path = root;
+      directory.depth = 2;
+      pending.push_back(std::move(directory));
+    }
+  }
+
+  if (pending.empty() || max_depth < 2) {
+    return;
+  }
+
+  Mutex mutex;
+  ConditionVariable changed;
+  size_t listing = 0;
+
+  auto workers = getTableWorkerCount();
+  std::vector<std::vector<GlobEntry>> entries(workers);
+  runTableTasks(workers, [&](size_t index) {
+    std::vector<GlobDirectory> subdirectories;
+    WriteLock lock(mutex);
+    while (true) {
+      if (pending.empty()) {
+        if (listing == 0) {
+          changed.notify_all();
+          return;
+        }
+        changed.wait(lock);
+        continue;
+      }
+
+      // Take the newest directory to keep the queue short.
+      auto directory = std::move(pending.back());
+      pending.pop_back();
+      listing++;
+
+      lock.unlock();
+      listGlobDirectory(directory, max_depth, entries[index], subdirectories);
+      lock.lock();
+
+      listing--;
+      std::move(subdirectories.begin(),
+                subdirectories.end(),
+                std::back_inserter(pending));
+      subdirectories.clear();
+      changed.notify_all();
+    }
+  });
+
+  std::vector<GlobEntry> found;
+  for (auto& worker_entries : entries) {
+    std::move(worker_entries.begin(),
+              worker_entries.end(),
+              std::back_inserter(found));
+  }
+  std::sort(found.begin(), found.end());
+
+  results.reserve(results.size() + found.size());
+  for (auto& entry : found) {
+    results.push_back(std::move(entry.second));
+  }
+}
+
+} // namespace
+#endif
 
 static void genGlobs(std::string path,
                      std::vector<std::string>& results,
                      GlobLimits limits) {
   // Use our helped escape/replace for wildcards.
   replaceGlobWildcards(path, limits);
+
+#ifndef WIN32
+  auto glob_results = platformGlob(path);
+  results.insert(results.end(), glob_results.begin(), glob_results.end());
+
+  // A trailing double star, optionally followed by a '/', lists every level
+  // below the matches of the first level with one pass over the directories.
+  size_t wild = path.rfind("**");
+  if (wild != std::string::npos && wild + 3 >= path.size()) {
+    genRecursiveGlobs(glob_results, kMaxRecursiveGlobs - 1, results);
+  }
+#else
   // inodes of directory symlinks for loop detection
   std::set<int> dsym_inos;
 
@@ -346,6 +531,7 @@ static void genGlobs(std::string path,
 
     path += "/**";
   }
+#endif
 
   // Prune results based on settings/requested glob limitations.
   auto end = std::remove_if(
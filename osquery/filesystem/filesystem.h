@@ -11,6 +11,7 @@
 
 #include <osquery/filesystem/fileops.h>
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -78,7 +79,12 @@ Status forensicReadFile(const boost::filesystem::path& path,
  */
 Status readFile(const boost::filesystem::path& path, bool blocking = false);
 
-/// Internal representation for predicate-based chunk reading.
+/**
+ * @brief Internal representation for predicate-based chunk reading.
+ *
+ * With blocking reads the block is reused between calls, a predicate that
+ * needs the data after it returns may move or swap the buffer.
+ */
 Status readFile(const boost::filesystem::path& path,
                 size_t size,
                 size_t block_size,
@@ -371,6 +377,28 @@ Status readRawMem(size_t base, size_t length, void** buffer);
 Status archive(const std::set<boost::filesystem::path>& path,
                const boost::filesystem::path& out, std::size_t block_size = 8192);
 
+/// Observes each chunk of an archive as it is written.
+using ArchiveObserver = std::function<void(const void* data, size_t size)>;
+
+/*
+ * @brief Archive files into a single, optionally zstd compressed, file.
+ *
+ * The sources are read, archived and compressed in one pass, neither copies
+ * of the sources nor an uncompressed archive are written to disk.
+ *
+ * @param paths The paths that you want bundled into the archive
+ * @param out The path where the archive will be written to
+ * @param block_size The size of each read from the sources
+ * @param compress Compress the archive stream using zstd
+ * @param observer Optionally called with every chunk written to out
+ * @return A status containing the success or failure of the operation
+ */
+Status streamArchive(const std::set<boost::filesystem::path>& paths,
+                     const boost::filesystem::path& out,
+                     std::size_t block_size,
+                     bool compress,
+                     const ArchiveObserver& observer = nullptr);
+
 /*
  * @brief Given a path, compress it with zstd and save to out.
  *
@@ -0,0 +1,684 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <linux/bpf.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/bpf_task_iterator.h>
+#include <osquery/logger/logger.h>
+
+namespace osquery {
+
+FLAG(bool,
+     enable_bpf_task_iterator,
+     false,
+     "Read process details with a BPF task iterator (Linux 5.8+) instead of "
+     "/proc when possible");
+
+namespace {
+
+const std::string kKernelBtfPath = "/sys/kernel/btf/vmlinux";
+
+// The values of the commands, types and helpers of Linux 5.8, defined here
+// so the iterator builds with older kernel headers.
+const int kBpfProgLoad = 5;
+const int kBpfLinkCreate = 28;
+const int kBpfIterCreate = 33;
+const uint32_t kBpfProgTypeTracing = 26;
+const uint32_t kBpfTraceIter = 28;
+const int32_t kBpfFuncProbeReadKernel = 113;
+const int32_t kBpfFuncSeqWrite = 127;
+
+// BTF type kinds.
+const uint32_t kBtfKindInt = 1;
+const uint32_t kBtfKindArray = 3;
+const uint32_t kBtfKindStruct = 4;
+const uint32_t kBtfKindUnion = 5;
+const uint32_t kBtfKindEnum = 6;
+const uint32_t kBtfKindTypedef = 8;
+const uint32_t kBtfKindVolatile = 9;
+const uint32_t kBtfKindConst = 10;
+const uint32_t kBtfKindRestrict = 11;
+const uint32_t kBtfKindFunc = 12;
+const uint32_t kBtfKindFuncProto = 13;
+const uint32_t kBtfKindVar = 14;
+const uint32_t kBtfKindDatasec = 15;
+const uint32_t kBtfKindDeclTag = 17;
+const uint32_t kBtfKindTypeTag = 18;
+const uint32_t kBtfKindEnum64 = 19;
+
+const uint16_t kBtfMagic = 0xeB9F;
+
+/// Anonymous members nested deeper than this are not searched.
+const size_t kMaxBtfNesting = 8;
+
+/// The record the iterator program writes for each process.
+struct BpfTaskRecord {
+  uint32_t pid;
+  uint32_t parent;
+  uint32_t ids[6];
+  int32_t nice;
+  int32_t threads;
+  uint64_t start_time;
+  char comm[16];
+};
+
+static_assert(sizeof(BpfTaskRecord) == 64, "BPF task records are 64 bytes");
+
+/// The members of struct cred copied to BpfTaskRecord::ids, in order.
+const std::vector<std::string> kCredIds = {
+    "uid", "euid", "suid", "gid", "egid", "sgid"};
+
+/// The program_load attributes of Linux 5.8.
+struct BpfProgLoadAttr {
+  uint32_t prog_type;
+  uint32_t insn_cnt;
+  uint64_t insns;
+  uint64_t license;
+  uint32_t log_level;
+  uint32_t log_size;
+  uint64_t log_buf;
+  uint32_t kern_version;
+  uint32_t prog_flags;
+  char prog_name[16];
+  uint32_t prog_ifindex;
+  uint32_t expected_attach_type;
+  uint32_t prog_btf_fd;
+  uint32_t func_info_rec_size;
+  uint64_t func_info;
+  uint32_t func_info_cnt;
+  uint32_t line_info_rec_size;
+  uint64_t line_info;
+  uint32_t line_info_cnt;
+  uint32_t attach_btf_id;
+  uint32_t attach_prog_fd;
+  uint32_t padding;
+};
+
+static_assert(offsetof(BpfProgLoadAttr, attach_btf_id) == 108,
+              "Unexpected BPF_PROG_LOAD attribute layout");
+
+struct BpfLinkCreateAttr {
+  uint32_t prog_fd;
+  uint32_t target_fd;
+  uint32_t attach_type;
+  uint32_t flags;
+};
+
+struct BpfIterCreateAttr {
+  uint32_t link_fd;
+  uint32_t flags;
+};
+
+template <typename Attr>
+int bpf(int command, Attr& attr) {
+  return static_cast<int>(::syscall(__NR_bpf, command, &attr, sizeof(attr)));
+}
+
+/// A small assembler for the iterator program.
+class BpfProgram {
+ public:
+  void mov(uint8_t dst, uint8_t src) {
+    add(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0);
+  }
+
+  void movImm(uint8_t dst, int32_t imm) {
+    add(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm);
+  }
+
+  void addImm(uint8_t dst, int32_t imm) {
+    add(BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm);
+  }
+
+  void load(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+    add(BPF_LDX | BPF_MEM | size, dst, src, off, 0);
+  }
+
+  void store(uint8_t size, uint8_t dst, int16_t off, uint8_t src) {
+    add(BPF_STX | BPF_MEM | size, dst, src, off, 0);
+  }
+
+  /// Jump to the end of the program if dst == imm.
+  void exitIfEqualImm(uint8_t dst, int32_t imm) {
+    exits_.push_back(insns_.size());
+    add(BPF_JMP | BPF_JEQ | BPF_K, dst, 0, 0, imm);
+  }
+
+  /// Jump to the end of the program if dst != src.
+  void exitIfNotEqual(uint8_t dst, uint8_t src) {
+    exits_.push_back(insns_.size());
+    add(BPF_JMP | BPF_JNE | BPF_X, dst, src, 0, 0);
+  }
+
+  void call(int32_t helper) {
+    add(BPF_JMP | BPF_CALL, 0, 0, 0, helper);
+  }
+
+  /// Return 0 and resolve the jumps to the end.
+  const std::vector<struct bpf_insn>& finish() {
+    for (auto index : exits_) {
+      insns_[index].off = static_cast<int16_t>(insns_.size() - index - 1);
+    }
+    movImm(BPF_REG_0, 0);
+    add(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    return insns_;
+  }
+
+ private:
+  void add(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    struct bpf_insn insn;
+    memset(&insn, 0, sizeof(insn));
+    insn.code = code;
+    insn.dst_reg = dst;
+    insn.src_reg = src;
+    insn.off = off;
+    insn.imm = imm;
+    insns_.push_back(insn);
+  }
+
+ private:
+  std::vector<struct bpf_insn> insns_;
+  std::vector<size_t> exits_;
+};
+
+/// Find a member offset usable as a load offset.
+Status findOffset(const KernelBtf& btf,
+                  const std::string& structure,
+                  const std::string& member,
+                  int16_t& offset) {
+  uint32_t value = 0;
+  auto status = btf.memberOffset(structure, member, value);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (value > INT16_MAX) {
+    return Status::failure("The offset of " + structure + "::" + member +
+                           " is out of range");
+  }
+  offset = static_cast<int16_t>(value);
+  return Status::success();
+}
+
+/// Assemble the task iterator program for the running kernel.
+Status assembleProgram(const KernelBtf& btf,
+                       std::vector<struct bpf_insn>& insns) {
+  int16_t pid, tgid, real_parent, real_cred, static_prio, signal, start_time,
+      comm, nr_threads;
+  std::vector<int16_t> cred_ids(kCredIds.size());
+
+  auto status = findOffset(btf, "task_struct", "pid", pid);
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "tgid", tgid);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "real_parent", real_parent);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "real_cred", real_cred);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "static_prio", static_prio);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "signal", signal);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "start_boottime", start_time);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "task_struct", "comm", comm);
+  }
+  if (status.ok()) {
+    status = findOffset(btf, "signal_struct", "nr_threads", nr_threads);
+  }
+  for (size_t i = 0; status.ok() && i < kCredIds.size(); ++i) {
+    status = findOffset(btf, "cred", kCredIds[i], cred_ids[i]);
+  }
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The record is built on the stack.
+  const int16_t record = -static_cast<int16_t>(sizeof(BpfTaskRecord));
+  auto field = [record](size_t offset) {
+    return static_cast<int16_t>(record + offset);
+  };
+
+  BpfProgram program;
+  // The context is a struct bpf_iter__task: the iterator meta, then the task.
+  program.mov(BPF_REG_6, BPF_REG_1);
+  program.load(BPF_DW, BPF_REG_7, BPF_REG_6, 0);
+  program.load(BPF_DW, BPF_REG_7, BPF_REG_7, 0); // meta->seq
+  program.load(BPF_DW, BPF_REG_8, BPF_REG_6, 8);
+  program.exitIfEqualImm(BPF_REG_8, 0);
+
+  // Only write processes, not their threads.
+  program.load(BPF_W, BPF_REG_1, BPF_REG_8, pid);
+  program.load(BPF_W, BPF_REG_2, BPF_REG_8, tgid);
+  program.exitIfNotEqual(BPF_REG_1, BPF_REG_2);
+  program.store(
+      BPF_W, BPF_REG_10, field(offsetof(BpfTaskRecord, pid)), BPF_REG_2);
+
+  program.load(BPF_DW, BPF_REG_1, BPF_REG_8, real_parent);
+  program.load(BPF_W, BPF_REG_1, BPF_REG_1, tgid);
+  program.store(
+      BPF_W, BPF_REG_10, field(offsetof(BpfTaskRecord, parent)), BPF_REG_1);
+
+  program.load(BPF_DW, BPF_REG_9, BPF_REG_8, real_cred);
+  for (size_t i = 0; i < cred_ids.size(); ++i) {
+    program.load(BPF_W, BPF_REG_1, BPF_REG_9, cred_ids[i]);
+    program.store(BPF_W,
+                  BPF_REG_10,
+                  field(offsetof(BpfTaskRecord, ids) + i * sizeof(uint32_t)),
+                  BPF_REG_1);
+  }
+
+  // The nice value is the static priority less the default priority.
+  program.load(BPF_W, BPF_REG_1, BPF_REG_8, static_prio);
+  program.addImm(BPF_REG_1, -120);
+  program.store(
+      BPF_W, BPF_REG_10, field(offsetof(BpfTaskRecord, nice)), BPF_REG_1);
+
+  program.load(BPF_DW, BPF_REG_1, BPF_REG_8, signal);
+  program.load(BPF_W, BPF_REG_1, BPF_REG_1, nr_threads);
+  program.store(
+      BPF_W, BPF_REG_10, field(offsetof(BpfTaskRecord, threads)), BPF_REG_1);
+
+  program.load(BPF_DW, BPF_REG_1, BPF_REG_8, start_time);
+  program.store(BPF_DW,
+                BPF_REG_10,
+                field(offsetof(BpfTaskRecord, start_time)),
+                BPF_REG_1);
+
+  program.mov(BPF_REG_1, BPF_REG_10);
+  program.addImm(BPF_REG_1, field(offsetof(BpfTaskRecord, comm)));
+  program.movImm(BPF_REG_2, sizeof(BpfTaskRecord::comm));
+  program.mov(BPF_REG_3, BPF_REG_8);
+  program.addImm(BPF_REG_3, comm);
+  program.call(kBpfFuncProbeReadKernel);
+
+  program.mov(BPF_REG_1, BPF_REG_7);
+  program.mov(BPF_REG_2, BPF_REG_10);
+  program.addImm(BPF_REG_2, record);
+  program.movImm(BPF_REG_3, sizeof(BpfTaskRecord));
+  program.call(kBpfFuncSeqWrite);
+
+  insns = program.finish();
+  return Status::success();
+}
+
+} // namespace
+
+Status KernelBtf::parse(std::string data) {
+  struct {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t hdr_len;
+    uint32_t type_off;
+    uint32_t type_len;
+    uint32_t str_off;
+    uint32_t str_len;
+  } header;
+
+  types_.clear();
+  strings_.clear();
+
+  if (data.size() < sizeof(header)) {
+    return Status::failure("BTF data is too short");
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kBtfMagic) {
+    return Status::failure("Unsupported BTF data");
+  }
+
+  uint64_t type_start = uint64_t{header.hdr_len} + header.type_off;
+  uint64_t type_end = type_start + header.type_len;
+  uint64_t str_start = uint64_t{header.hdr_len} + header.str_off;
+  uint64_t str_end = str_start + header.str_len;
+  if (type_end > data.size() || str_end > data.size()) {
+    return Status::failure("Truncated BTF data");
+  }
+  strings_ = data.substr(str_start, header.str_len);
+
+  auto read32 = [&data](uint64_t offset) {
+    uint32_t value;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+  };
+
+  // Type 0 is void.
+  types_.push_back(Type{0, 0, 0, {}});
+  for (auto offset = type_start; offset + 12 <= type_end;) {
+    Type type;
+    type.name = read32(offset);
+    auto info = read32(offset + 4);
+    type.type = read32(offset + 8);
+    type.kind = (info >> 24) & 0x1f;
+    auto vlen = info & 0xffff;
+    auto kind_flag = (info >> 31) != 0;
+    offset += 12;
+
+    uint64_t extra = 0;
+    switch (type.kind) {
+    case kBtfKindInt:
+    case kBtfKindVar:
+    case kBtfKindDeclTag:
+      extra = 4;
+      break;
+    case kBtfKindArray:
+      extra = 12;
+      break;
+    case kBtfKindStruct:
+    case kBtfKindUnion:
+      extra = 12 * uint64_t{vlen};
+      if (offset + extra > type_end) {
+        break;
+      }
+      for (uint32_t i = 0; i < vlen; ++i) {
+        auto member_offset = read32(offset + i * 12 + 8);
+        // With kind_flag the bitfield size is in the top 8 bits.
+        type.members.push_back(Member{
+            read32(offset + i * 12),
+            read32(offset + i * 12 + 4),
+            kind_flag ? (member_offset & 0xffffff) : member_offset});
+      }
+      break;
+    case kBtfKindEnum:
+    case kBtfKindFuncProto:
+      extra = 8 * uint64_t{vlen};
+      break;
+    case kBtfKindDatasec:
+    case kBtfKindEnum64:
+      extra = 12 * uint64_t{vlen};
+      break;
+    case 2: // PTR
+    case 7: // FWD
+    case kBtfKindTypedef:
+    case kBtfKindVolatile:
+    case kBtfKindConst:
+    case kBtfKindRestrict:
+    case kBtfKindFunc:
+    case 16: // FLOAT
+    case kBtfKindTypeTag:
+      break;
+    default:
+      return Status::failure("Unknown BTF type kind " +
+                             std::to_string(type.kind));
+    }
+
+    if (offset + extra > type_end) {
+      return Status::failure("Truncated BTF type");
+    }
+    offset += extra;
+    types_.push_back(std::move(type));
+  }
+
+  return Status::success();
+}
+
+std::string KernelBtf::name(uint32_t offset) const {
+  if (offset >= strings_.size()) {
+    return "";
+  }
+  return std::string(strings_.c_str() + offset);
+}
+
+uint32_t KernelBtf::findType(uint32_t kind, const std::string& type) const {
+  for (uint32_t id = 1; id < types_.size(); ++id) {
+    if (types_[id].kind == kind && name(types_[id].name) == type) {
+      return id;
+    }
+  }
+  return 0;
+}
+
+bool KernelBtf::findMember(uint32_t type,
+                           const std::string& member,
+                           uint32_t& bit_offset,
+                           size_t depth) const {
+  for (const auto& candidate : types_[type].members) {
+    if (candidate.name != 0) {
+      if (name(candidate.name) == member) {
+        bit_offset = candidate.bit_offset;
+        return true;
+      }
+      continue;
+    }
+
+    // Look through the qualifiers and typedefs of an anonymous member.
+    auto id = candidate.type;
+    while (id < types_.size() &&
+           (types_[id].kind == kBtfKindTypedef ||
+            types_[id].kind == kBtfKindVolatile ||
+            types_[id].kind == kBtfKindConst ||
+            types_[id].kind == kBtfKindRestrict ||
+            types_[id].kind == kBtfKindTypeTag)) {
+      id = types_[id].type;
+    }
+
+    if (id >= types_.size() || depth >= kMaxBtfNesting ||
+        (types_[id].kind != kBtfKindStruct &&
+         types_[id].kind != kBtfKindUnion)) {
+      continue;
+    }
+
+    uint32_t nested_offset = 0;
+    if (findMember(id, member, nested_offset, depth + 1)) {
+      bit_offset = candidate.bit_offset + nested_offset;
+      return true;
+    }
+  }
+  return false;
+}
+
+Status KernelBtf::memberOffset(const std::string& structure,
+                               const std::string& member,
+                               uint32_t& offset) const {
+  auto type = findType(kBtfKindStruct, structure);
+  if (type == 0) {
+    return Status::failure("Kernel structure not found: " + structure);
+  }
+
+  uint32_t bit_offset = 0;
+  if (!findMember(type, member, bit_offset, 0)) {
+    return Status::failure("Kernel structure member not found: " + structure +
+                           "::" + member);
+  }
+
+  if (bit_offset % 8 != 0) {
+    return Status::failure("Kernel structure member is a bitfield: " +
+                           structure + "::" + member);
+  }
+  offset = bit_offset / 8;
+  return Status::success();
+}
+
+Status KernelBtf::functionId(const std::string& function, uint32_t& id) const {
+  id = findType(kBtfKindFunc, function);
+  if (id == 0) {
+    return Status::failure("Kernel function not found: " + function);
+  }
+  return Status::success();
+}
+
+BpfTaskIterator::~BpfTaskIterator() {
+  if (link_fd_ != -1) {
+    ::close(link_fd_);
+  }
+  if (program_fd_ != -1) {
+    ::close(program_fd_);
+  }
+}
+
+BpfTaskIterator& BpfTaskIterator::get() {
+  static BpfTaskIterator iterator;
+  return iterator;
+}
+
+Status BpfTaskIterator::load() {
+  std::string data;
+  auto status = readFile(kKernelBtfPath, data);
+  if (!status.ok()) {
+    return Status::failure("The kernel has no BTF: " + status.getMessage());
+  }
+
+  uint32_t attach_id = 0;
+  std::vector<struct bpf_insn> insns;
+  {
+    KernelBtf btf;
+    status = btf.parse(std::move(data));
+    if (status.ok()) {
+      // Iterator targets are described by a bpf_iter_<target> function.
+      status = btf.functionId("bpf_iter_task", attach_id);
+    }
+    if (status.ok()) {
+      status = assembleProgram(btf, insns);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  const char license[] = "GPL";
+  BpfProgLoadAttr load_attr;
+  memset(&load_attr, 0, sizeof(load_attr));
+  load_attr.prog_type = kBpfProgTypeTracing;
+  load_attr.expected_attach_type = kBpfTraceIter;
+  load_attr.attach_btf_id = attach_id;
+  load_attr.insn_cnt = static_cast<uint32_t>(insns.size());
+  load_attr.insns = reinterpret_cast<uint64_t>(insns.data());
+  load_attr.license = reinterpret_cast<uint64_t>(license);
+  strncpy(load_attr.prog_name, "osquery_tasks", sizeof(load_attr.prog_name) - 1);
+
+  program_fd_ = bpf(kBpfProgLoad, load_attr);
+  if (program_fd_ == -1) {
+    auto error = std::string(strerror(errno));
+
+    // Load again for the verifier log.
+    std::vector<char> log(64 * 1024);
+    load_attr.log_level = 1;
+    load_attr.log_size = static_cast<uint32_t>(log.size());
+    load_attr.log_buf = reinterpret_cast<uint64_t>(log.data());
+    auto fd = bpf(kBpfProgLoad, load_attr);
+    if (fd != -1) {
+      ::close(fd);
+    }
+    VLOG(1) << "BPF task iterator verifier log: " << log.data();
+    return Status::failure("Could not load the BPF task iterator: " + error);
+  }
+
+  BpfLinkCreateAttr link_attr;
+  memset(&link_attr, 0, sizeof(link_attr));
+  link_attr.prog_fd = static_cast<uint32_t>(program_fd_);
+  link_attr.attach_type = kBpfTraceIter;
+  link_fd_ = bpf(kBpfLinkCreate, link_attr);
+  if (link_fd_ == -1) {
+    return Status::failure("Could not attach the BPF task iterator: " +
+                           std::string(strerror(errno)));
+  }
+
+  return Status::success();
+}
+
+Status BpfTaskIterator::dump(std::vector<BpfTaskInfo>& tasks) {
+  tasks.clear();
+  if (!FLAGS_enable_bpf_task_iterator) {
+    return Status::failure("The BPF task iterator is disabled");
+  }
+
+  int iter_fd = -1;
+  {
+    WriteLock lock(mutex_);
+    if (!loaded_) {
+      load_status_ = load();
+      loaded_ = true;
+      if (!load_status_.ok()) {
+        LOG(WARNING) << load_status_.getMessage()
+                     << ", reading processes from /proc";
+      }
+    }
+
+    if (!load_status_.ok()) {
+      return load_status_;
+    }
+
+    BpfIterCreateAttr iter_attr;
+    memset(&iter_attr, 0, sizeof(iter_attr));
+    iter_attr.link_fd = static_cast<uint32_t>(link_fd_);
+    iter_fd = bpf(kBpfIterCreate, iter_attr);
+  }
+
+  if (iter_fd == -1) {
+    return Status::failure("Could not create a BPF task iterator: " +
+                           std::string(strerror(errno)));
+  }
+
+  // Read until the iterator has visited the last task.
+  std::string buffer;
+  std::vector<char> chunk(64 * 1024);
+  while (true) {
+    auto size = ::read(iter_fd, chunk.data(), chunk.size());
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      if (size < 0) {
+        auto error = std::string(strerror(errno));
+        ::close(iter_fd);
+        return Status::failure("Could not read the BPF task iterator: " +
+                               error);
+      }
+      break;
+    }
+    buffer.append(chunk.data(), static_cast<size_t>(size));
+  }
+  ::close(iter_fd);
+
+  bool found_self = false;
+  auto self = ::getpid();
+  tasks.reserve(buffer.size() / sizeof(BpfTaskRecord));
+  for (size_t offset = 0; offset + sizeof(BpfTaskRecord) <= buffer.size();
+       offset += sizeof(BpfTaskRecord)) {
+    BpfTaskRecord record;
+    memcpy(&record, buffer.data() + offset, sizeof(record));
+
+    BpfTaskInfo task;
+    task.pid = static_cast<pid_t>(record.pid);
+    task.parent = static_cast<pid_t>(record.parent);
+    task.uid = record.ids[0];
+    task.euid = record.ids[1];
+    task.suid = record.ids[2];
+    task.gid = record.ids[3];
+    task.egid = record.ids[4];
+    task.sgid = record.ids[5];
+    task.nice = record.nice;
+    task.threads = record.threads;
+    task.start_time = record.start_time;
+    task.name.assign(record.comm, strnlen(record.comm, sizeof(record.comm)));
+    found_self = found_self || task.pid == self;
+    tasks.push_back(std::move(task));
+  }
+
+  // The iterator reports the PIDs of the initial PID namespace.
+  if (!found_self) {
+    tasks.clear();
+    return Status::failure("The BPF task iterator PIDs do not match /proc");
+  }
+  return Status::success();
+}
+} // namespace osquery
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The details of a process read by the BPF task iterator.
+struct BpfTaskInfo {
+  pid_t pid{0};
+  pid_t parent{0};
+
+  uid_t uid{0};
+  uid_t euid{0};
+  uid_t suid{0};
+  gid_t gid{0};
+  gid_t egid{0};
+  gid_t sgid{0};
+
+  int nice{0};
+  int threads{0};
+
+  /// Nanoseconds between boot and the process start.
+  uint64_t start_time{0};
+
+  /// The command name, as in /proc/<pid>/comm.
+  std::string name;
+};
+
+/**
+ * @brief The kernel BPF Type Format (BTF) description of its structures.
+ *
+ * Used to find the kernel structure layouts the task iterator reads, which
+ * differ between kernel builds.
+ */
+class KernelBtf : private boost::noncopyable {
+ public:
+  /// Parse raw BTF, such as /sys/kernel/btf/vmlinux.
+  Status parse(std::string data);
+
+  /**
+   * @brief Find the byte offset of a member of a structure.
+   *
+   * Members of anonymous nested structures and unions are found too.
+   */
+  Status memberOffset(const std::string& structure,
+                      const std::string& member,
+                      uint32_t& offset) const;
+
+  /// Find the type ID of a function.
+  Status functionId(const std::string& function, uint32_t& id) const;
+
+ private:
+  struct Member {
+    uint32_t name;
+    uint32_t type;
+    uint32_t bit_offset;
+  };
+
+  struct Type {
+    uint32_t name;
+    uint32_t kind;
+    uint32_t type;
+    std::vector<Member> members;
+  };
+
+  /// Find a type by kind and name, 0 if there is none.
+  uint32_t findType(uint32_t kind, const std::string& name) const;
+
+  /// Search a structure or union and its anonymous members for a member.
+  bool findMember(uint32_t type,
+                  const std::string& member,
+                  uint32_t& bit_offset,
+                  size_t depth) const;
+
+  /// The name at an offset of the string section.
+  std::string name(uint32_t offset) const;
+
+ private:
+  std::string strings_;
+
+  /// Types, indexed by their ID.
+  std::vector<Type> types_;
+};
+
+/**
+ * @brief Read every process in one pass of a BPF task iterator (Linux 5.8+).
+ *
+ * Listing /proc and reading each process' stat and status files costs a few
+ * system calls and text parses per process, which adds up to seconds on hosts
+ * with tens of thousands of processes. A task iterator program walks the
+ * kernel task list once and writes a fixed-size record per process.
+ *
+ * The program is assembled at runtime from the kernel BTF, no compiler or
+ * BPF object files are needed. It needs CAP_BPF (or CAP_SYS_ADMIN) and is
+ * only used when --enable_bpf_task_iterator is set.
+ */
+class BpfTaskIterator : private boost::noncopyable {
+ public:
+  ~BpfTaskIterator();
+
+  /// The iterator shared by the process tables.
+  static BpfTaskIterator& get();
+
+  /**
+   * @brief Read the details of every process.
+   *
+   * Fails if the iterator is disabled, not supported by the kernel, or
+   * osquery runs in a PID namespace, callers fall back to /proc.
+   */
+  Status dump(std::vector<BpfTaskInfo>& tasks);
+
+ private:
+  /// Load and attach the iterator program.
+  Status load();
+
+ private:
+  Mutex mutex_;
+
+  bool loaded_{false};
+  Status load_status_;
+
+  int program_fd_{-1};
+  int link_fd_{-1};
+};
+} // namespace osquery
@@ -18,9 +18,6 @@
 #include <osquery/utils/conversions/split.h>
 
 namespace osquery {
-const std::vector<std::string> kUserNamespaceList = {
-    "cgroup", "ipc", "mnt", "net", "pid", "user", "uts"};
-
 Status procGetNamespaceInode(ino_t& inode,
                              const std::string& namespace_name,
                              const std::string& process_namespace_root) {
@@ -73,6 +73,10 @@ const std::vector<std::string> tcp_states = {"UNKNOWN",
 
 using ProcessNamespaceList = std::map<std::string, ino_t>;
 
+/// The namespaces procGetProcessNamespaces reads when none are named.
+const std::vector<std::string> kUserNamespaceList = {
+    "cgroup", "ipc", "mnt", "net", "pid", "user", "uts"};
+
 Status procGetProcessNamespaces(
     const std::string& process_id,
     ProcessNamespaceList& namespace_list,
@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/proc_snapshot.h>
+#include <osquery/filesystem/linux/read_batch.h>
+
+namespace osquery {
+
+std::set<std::string> ProcSnapshot::processes() {
+  WriteLock lock(mutex_);
+  if (!enumerated_) {
+    std::vector<BpfTaskInfo> tasks;
+    if (BpfTaskIterator::get().dump(tasks).ok()) {
+      for (auto& task : tasks) {
+        auto pid = std::to_string(task.pid);
+        processes_.insert(pid);
+        tasks_.emplace(std::move(pid), std::move(task));
+      }
+    } else {
+      auto status = procProcesses(processes_);
+      if (!status.ok()) {
+        VLOG(1) << "Failed to acquire pid list: " << status.what();
+      }
+    }
+    enumerated_ = true;
+  }
+  return processes_;
+}
+
+bool ProcSnapshot::task(const std::string& pid, BpfTaskInfo& info) {
+  WriteLock lock(mutex_);
+  auto it = tasks_.find(pid);
+  if (it == tasks_.end()) {
+    return false;
+  }
+  info = it->second;
+  return true;
+}
+
+bool ProcSnapshot::exists(const std::string& pid) {
+  {
+    WriteLock lock(mutex_);
+    if (enumerated_) {
+      return processes_.count(pid) > 0;
+    }
+  }
+  return isDirectory(kLinuxProcPath + "/" + pid).ok();
+}
+
+Status ProcSnapshot::readFile(const std::string& pid,
+                              const std::string& file,
+                              std::string& content) {
+  WriteLock lock(mutex_);
+  auto& files = entries_[pid].files;
+  auto it = files.find(file);
+  if (it == files.end()) {
+    std::string read_content;
+    auto path = kLinuxProcPath + "/" + pid + "/" + file;
+    bool read = osquery::readFile(path, read_content).ok();
+    it = files.emplace(file, std::make_pair(read, std::move(read_content)))
+             .first;
+  }
+
+  if (!it->second.first) {
+    return Status::failure("Cannot read /proc/" + pid + "/" + file);
+  }
+  content = it->second.second;
+  return Status::success();
+}
+
+void ProcSnapshot::prefetch(const std::vector<std::string>& pids,
+                            const std::vector<std::string>& files) {
+  std::vector<BatchFileRead> reads;
+  std::vector<std::pair<std::string, std::string>> keys;
+  {
+    WriteLock lock(mutex_);
+    for (const auto& pid : pids) {
+      if (tasks_.count(pid) > 0) {
+        continue;
+      }
+
+      auto& entry = entries_[pid];
+      for (const auto& file : files) {
+        if (entry.files.count(file) == 0) {
+          reads.emplace_back();
+          reads.back().path = kLinuxProcPath + "/" + pid + "/" + file;
+          keys.emplace_back(pid, file);
+        }
+      }
+    }
+  }
+
+  readFileBatch(reads);
+
+  WriteLock lock(mutex_);
+  for (size_t i = 0; i < reads.size(); ++i) {
+    entries_[keys[i].first].files.emplace(
+        keys[i].second,
+        std::make_pair(reads[i].status.ok(), std::move(reads[i].content)));
+  }
+}
+
+Status ProcSnapshot::descriptors(
+    const std::string& pid, std::map<std::string, std::string>& descriptors) {
+  WriteLock lock(mutex_);
+  auto& entry = entries_[pid];
+  if (!entry.descriptors_read) {
+    entry.descriptors_ok = procDescriptors(pid, entry.descriptors).ok();
+    entry.descriptors_read = true;
+  }
+
+  if (!entry.descriptors_ok) {
+    return Status::failure("Cannot read /proc/" + pid + "/fd");
+  }
+  descriptors = entry.descriptors;
+  return Status::success();
+}
+
+Status ProcSnapshot::namespaces(const std::string& pid,
+                                ProcessNamespaceList& namespace_list,
+                                const std::vector<std::string>& namespaces) {
+  namespace_list.clear();
+
+  WriteLock lock(mutex_);
+  auto& entry = entries_[pid];
+  auto process_namespace_root = kLinuxProcPath + "/" + pid + "/ns";
+  for (const auto& namespace_name :
+       namespaces.empty() ? kUserNamespaceList : namespaces) {
+    if (entry.namespaces_read.insert(namespace_name).second) {
+      ino_t namespace_inode;
+      auto status = procGetNamespaceInode(
+          namespace_inode, namespace_name, process_namespace_root);
+      if (status.ok()) {
+        entry.namespaces[namespace_name] = namespace_inode;
+      }
+    }
+
+    auto it = entry.namespaces.find(namespace_name);
+    if (it != entry.namespaces.end()) {
+      namespace_list.insert(*it);
+    }
+  }
+
+  return Status::success();
+}
+
+std::shared_ptr<ProcSnapshot> getProcSnapshot(QueryContext& context) {
+  return context.getQueryScope()->get<ProcSnapshot>("proc");
+}
+
+} // namespace osquery
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <osquery/core/tables.h>
+#include <osquery/filesystem/linux/bpf_task_iterator.h>
+#include <osquery/filesystem/linux/proc.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief A lazily read view of /proc shared by the process tables of a query.
+ *
+ * The pid list is enumerated once and each process' stat, status, file
+ * descriptors and namespaces are read once, on first use, then kept for the
+ * rest of the query. Joins across the process tables read /proc once and see
+ * the same processes in every table.
+ *
+ * Larger files, such as maps and environ, are not kept.
+ *
+ * With --enable_bpf_task_iterator the pid list and the most used process
+ * details come from one BPF task iterator pass instead.
+ *
+ * Tables reading the same files of every process prefetch them together.
+ */
+class ProcSnapshot final {
+ public:
+  /// The pids found when /proc was first enumerated.
+  std::set<std::string> processes();
+
+  /**
+   * @brief The BPF task iterator details of a process.
+   *
+   * Only available for the processes enumerated by the iterator.
+   */
+  bool task(const std::string& pid, BpfTaskInfo& info);
+
+  /// Check if a pid is in the snapshot, or exists if it was not enumerated.
+  bool exists(const std::string& pid);
+
+  /// Read /proc/<pid>/stat or /proc/<pid>/status.
+  Status readFile(const std::string& pid,
+                  const std::string& file,
+                  std::string& content);
+
+  /**
+   * @brief Read files of many processes at once, see readFileBatch.
+   *
+   * Processes with BPF task iterator details are skipped.
+   */
+  void prefetch(const std::vector<std::string>& pids,
+                const std::vector<std::string>& files);
+
+  /// The /proc/<pid>/fd descriptors and their link destinations.
+  Status descriptors(const std::string& pid,
+                     std::map<std::string, std::string>& descriptors);
+
+  /// The namespaces of a process, see procGetProcessNamespaces.
+  Status namespaces(const std::string& pid,
+                    ProcessNamespaceList& namespace_list,
+                    const std::vector<std::string>& namespaces = {});
+
+ private:
+  struct ProcessEntry final {
+    /// Read files and whether the read succeeded.
+    std::map<std::string, std::pair<bool, std::string>> files;
+
+    bool descriptors_read{false};
+    bool descriptors_ok{false};
+    std::map<std::string, std::string> descriptors;
+
+    /// Namespaces looked up, and the ones that were found.
+    std::set<std::string> namespaces_read;
+    ProcessNamespaceList namespaces;
+  };
+
+ private:
+  Mutex mutex_;
+
+  bool enumerated_{false};
+  std::set<std::string> processes_;
+  std::unordered_map<std::string, BpfTaskInfo> tasks_;
+  std::unordered_map<std::string, ProcessEntry> entries_;
+};
+
+/// The /proc snapshot of the query a table context is part of.
+std::shared_ptr<ProcSnapshot> getProcSnapshot(QueryContext& context);
+
+} // namespace osquery
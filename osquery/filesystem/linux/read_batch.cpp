@@ -0,0 +1,442 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/read_batch.h>
+#include <osquery/logger/logger.h>
+
+namespace osquery {
+
+FLAG(bool,
+     enable_io_uring_reads,
+     false,
+     "Read batches of small files, such as procfs and sysfs attributes, "
+     "through io_uring (Linux 5.7+)");
+
+DECLARE_uint64(read_max);
+
+namespace {
+
+// The io_uring interface of Linux 5.7, defined here so the reader builds with
+// older kernel headers.
+const long kSysIoUringSetup = 425;
+const long kSysIoUringEnter = 426;
+
+const uint8_t kOpOpenat = 18;
+const uint8_t kOpClose = 19;
+const uint8_t kOpRead = 22;
+
+const uint32_t kFeatSingleMmap = 1U << 0;
+const uint32_t kFeatNoDrop = 1U << 1;
+const uint32_t kFeatSubmitStable = 1U << 2;
+
+const uint32_t kEnterGetEvents = 1U << 0;
+
+const off_t kOffSqes = 0x10000000;
+
+struct SqRingOffsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct CqRingOffsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct IoUringParams {
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t resv[3];
+  SqRingOffsets sq_off;
+  CqRingOffsets cq_off;
+};
+
+struct IoUringSqe {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t op_flags;
+  uint64_t user_data;
+  uint16_t buf_index;
+  uint16_t personality;
+  int32_t splice_fd_in;
+  uint64_t pad[2];
+};
+
+struct IoUringCqe {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+static_assert(sizeof(IoUringParams) == 120, "Unexpected io_uring_params size");
+static_assert(sizeof(IoUringSqe) == 64, "Unexpected io_uring_sqe size");
+static_assert(sizeof(IoUringCqe) == 16, "Unexpected io_uring_cqe size");
+
+/// Files submitted together, the submission queue size.
+const size_t kRingEntries = 256;
+
+/// The first read of each file, doubled while the file has more data.
+const size_t kReadBlockSize = 4096;
+
+/// A submission and completion queue pair, used by a single thread.
+class IoUring : private boost::noncopyable {
+ public:
+  ~IoUring();
+
+  /// Create the queues.
+  Status setUp();
+
+  /**
+   * @brief Submit entries and wait for all of their completions.
+   *
+   * @param entries at most kRingEntries entries.
+   * @param results the result of each entry, in the order of the entries.
+   */
+  Status run(const std::vector<IoUringSqe>& entries, std::vector<int>& results);
+
+  /// A failed submission leaves the queues in an unknown state.
+  bool broken() const {
+    return broken_;
+  }
+
+ private:
+  /// Move the completions to the results.
+  size_t reap(std::vector<int>& results);
+
+ private:
+  int fd_{-1};
+  bool broken_{false};
+
+  void* ring_{MAP_FAILED};
+  size_t ring_size_{0};
+
+  IoUringSqe* sqes_{nullptr};
+  size_t sqes_size_{0};
+
+  uint32_t* sq_tail_{nullptr};
+  uint32_t* sq_mask_{nullptr};
+  uint32_t* sq_array_{nullptr};
+
+  uint32_t* cq_head_{nullptr};
+  uint32_t* cq_tail_{nullptr};
+  uint32_t* cq_mask_{nullptr};
+  IoUringCqe* cqes_{nullptr};
+};
+
+IoUring::~IoUring() {
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if (ring_ != MAP_FAILED) {
+    ::munmap(ring_, ring_size_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+Status IoUring::setUp() {
+  IoUringParams params;
+  memset(&params, 0, sizeof(params));
+
+  fd_ = static_cast<int>(::syscall(kSysIoUringSetup, kRingEntries, &params));
+  if (fd_ < 0) {
+    return Status::failure(std::string("Cannot create an io_uring: ") +
+                           strerror(errno));
+  }
+
+  // A stable submission means paths and buffers are read when submitted.
+  auto required = kFeatSingleMmap | kFeatNoDrop | kFeatSubmitStable;
+  if ((params.features & required) != required) {
+    return Status::failure("io_uring reads need Linux 5.7 or later");
+  }
+
+  ring_size_ = std::max<size_t>(
+      params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+      params.cq_off.cqes + params.cq_entries * sizeof(IoUringCqe));
+  ring_ = ::mmap(nullptr,
+                 ring_size_,
+                 PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE,
+                 fd_,
+                 0);
+  if (ring_ == MAP_FAILED) {
+    return Status::failure("Cannot map the io_uring queues");
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(IoUringSqe);
+  auto sqes = ::mmap(nullptr,
+                     sqes_size_,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE,
+                     fd_,
+                     kOffSqes);
+  if (sqes == MAP_FAILED) {
+    return Status::failure("Cannot map the io_uring submission entries");
+  }
+  sqes_ = static_cast<IoUringSqe*>(sqes);
+
+  auto ring = static_cast<char*>(ring_);
+  sq_tail_ = reinterpret_cast<uint32_t*>(ring + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<uint32_t*>(ring + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<uint32_t*>(ring + params.sq_off.array);
+  cq_head_ = reinterpret_cast<uint32_t*>(ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t*>(ring + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<uint32_t*>(ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<IoUringCqe*>(ring + params.cq_off.cqes);
+  return Status::success();
+}
+
+size_t IoUring::reap(std::vector<int>& results) {
+  size_t count = 0;
+  auto head = *cq_head_;
+  auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head, ++count) {
+    const auto& cqe = cqes_[head & *cq_mask_];
+    if (cqe.user_data < results.size()) {
+      results[cqe.user_data] = cqe.res;
+    }
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  return count;
+}
+
+Status IoUring::run(const std::vector<IoUringSqe>& entries,
+                    std::vector<int>& results) {
+  results.assign(entries.size(), -ECANCELED);
+
+  // The kernel only reads the tail, this thread is the only writer.
+  auto tail = *sq_tail_;
+  for (size_t i = 0; i < entries.size(); ++i, ++tail) {
+    auto index = tail & *sq_mask_;
+    sqes_[index] = entries[i];
+    sqes_[index].user_data = i;
+    sq_array_[index] = index;
+  }
+  __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+  size_t submitted = 0;
+  size_t completed = 0;
+  while (completed < entries.size()) {
+    // The kernel does not wait when only part of the entries are submitted.
+    auto to_submit = entries.size() - submitted;
+    auto result = ::syscall(kSysIoUringEnter,
+                            fd_,
+                            to_submit,
+                            entries.size() - completed,
+                            kEnterGetEvents,
+                            nullptr,
+                            0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (result < 0 || (to_submit > 0 && result == 0)) {
+      broken_ = true;
+      return Status::failure(std::string("Cannot submit to the io_uring: ") +
+                             strerror(errno));
+    }
+
+    submitted += std::min<size_t>(static_cast<size_t>(result), to_submit);
+    completed += reap(results);
+  }
+
+  return Status::success();
+}
+
+/// The io_uring of the calling thread, nullptr if io_uring is not available.
+IoUring* getIoUring() {
+  static std::atomic<bool> unavailable{false};
+  thread_local std::unique_ptr<IoUring> ring;
+
+  if (ring == nullptr && !unavailable) {
+    ring = std::make_unique<IoUring>();
+    auto status = ring->setUp();
+    if (!status.ok()) {
+      ring.reset();
+      if (!unavailable.exchange(true)) {
+        VLOG(1) << status.getMessage() << ", reading files one at a time";
+      }
+    }
+  }
+
+  return (ring == nullptr || ring->broken()) ? nullptr : ring.get();
+}
+
+/// Read files through an io_uring, a failure leaves them to be read again.
+Status readFiles(IoUring& ring,
+                 std::vector<BatchFileRead>& files,
+                 size_t first,
+                 size_t count) {
+  std::vector<IoUringSqe> entries;
+  std::vector<int> results;
+
+  auto prepare = [&entries](uint8_t opcode, int fd) -> IoUringSqe& {
+    entries.emplace_back();
+    auto& entry = entries.back();
+    memset(&entry, 0, sizeof(entry));
+    entry.opcode = opcode;
+    entry.fd = fd;
+    return entry;
+  };
+
+  for (size_t i = first; i < first + count; ++i) {
+    auto& entry = prepare(kOpOpenat, AT_FDCWD);
+    entry.addr = reinterpret_cast<uint64_t>(files[i].path.c_str());
+    entry.op_flags = O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK;
+  }
+
+  auto status = ring.run(entries, results);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The open files, then the bytes read of each.
+  std::vector<int> fds(count, -1);
+  std::vector<size_t> sizes(count, 0);
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < count; ++i) {
+    auto& file = files[first + i];
+    file.content.clear();
+    if (results[i] < 0) {
+      file.status =
+          Status::failure("Cannot open file for reading: " + file.path);
+      continue;
+    }
+    fds[i] = results[i];
+    pending.push_back(i);
+  }
+
+  // Read every open file until it reports the end of its data.
+  auto read_max = static_cast<size_t>(FLAGS_read_max);
+  while (status.ok() && !pending.empty()) {
+    entries.clear();
+    for (auto i : pending) {
+      auto& content = files[first + i].content;
+      content.resize(sizes[i] + std::max(kReadBlockSize, sizes[i]));
+
+      auto& entry = prepare(kOpRead, fds[i]);
+      entry.addr = reinterpret_cast<uint64_t>(&content[sizes[i]]);
+      entry.len = static_cast<uint32_t>(content.size() - sizes[i]);
+      entry.off = sizes[i];
+    }
+
+    status = ring.run(entries, results);
+    if (!status.ok()) {
+      break;
+    }
+
+    std::vector<size_t> reading;
+    for (size_t j = 0; j < pending.size(); ++j) {
+      auto i = pending[j];
+      auto& file = files[first + i];
+      if (results[j] < 0) {
+        file.status = Status::failure("Cannot read file: " + file.path);
+      } else if (results[j] > 0 && sizes[i] + results[j] >= read_max) {
+        file.status = Status::failure("File exceeds read limits");
+      } else if (results[j] > 0) {
+        sizes[i] += static_cast<size_t>(results[j]);
+        reading.push_back(i);
+        continue;
+      } else {
+        file.status = Status::success();
+      }
+      file.content.resize(file.status.ok() ? sizes[i] : 0);
+    }
+    pending = std::move(reading);
+  }
+
+  if (!status.ok()) {
+    for (auto fd : fds) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return status;
+  }
+
+  entries.clear();
+  for (auto fd : fds) {
+    if (fd >= 0) {
+      prepare(kOpClose, fd);
+    }
+  }
+
+  // Some descriptors may be closed already, closing them again is unsafe.
+  if (!entries.empty() && !ring.run(entries, results).ok()) {
+    LOG(WARNING) << "Cannot close files read through the io_uring";
+  }
+  return Status::success();
+}
+
+} // namespace
+
+void readFileBatch(std::vector<BatchFileRead>& files) {
+  size_t index = 0;
+
+  auto ring = FLAGS_enable_io_uring_reads ? getIoUring() : nullptr;
+  if (ring != nullptr) {
+    for (; index < files.size(); index += kRingEntries) {
+      auto count = std::min(kRingEntries, files.size() - index);
+      auto status = readFiles(*ring, files, index, count);
+      if (!status.ok()) {
+        LOG(WARNING) << status.getMessage() << ", reading files one at a time";
+        break;
+      }
+    }
+  }
+
+  for (; index < files.size(); ++index) {
+    auto& file = files[index];
+    file.content.clear();
+    file.status = readFile(file.path, file.content);
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A file read by readFileBatch.
+struct BatchFileRead {
+  /// The path of the file, set by the caller.
+  std::string path;
+
+  /// The result of the read.
+  Status status;
+
+  /// The content of the file, empty if the read failed.
+  std::string content;
+};
+
+/**
+ * @brief Read a set of small files, such as procfs and sysfs attributes.
+ *
+ * Each file costs an open, a few reads and a close, tables reading thousands
+ * of small files spend most of their time in these system calls, more so when
+ * seccomp or syscall auditing hooks each of them.
+ *
+ * With --enable_io_uring_reads the opens, reads and closes of up to 256 files
+ * are submitted together through an io_uring (Linux 5.7+). Files are read
+ * with readFile, one at a time, when io_uring is disabled or not available.
+ *
+ * @param files the files to read, the status and content of each are set.
+ */
+void readFileBatch(std::vector<BatchFileRead>& files);
+
+} // namespace osquery
@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/mapped_file.h>
+#include <osquery/logger/logger.h>
+
+namespace osquery {
+
+DECLARE_uint64(read_max);
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void MappedFile::close() {
+#ifndef WIN32
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_size_);
+  }
+#endif
+
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  buffer_.clear();
+  data_ = {};
+}
+
+Status MappedFile::open(const boost::filesystem::path& path) {
+  close();
+
+#ifndef WIN32
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    return Status::failure("Cannot open file for reading: " + path.string());
+  }
+
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) &&
+      file_stat.st_size > 0) {
+    auto size = static_cast<size_t>(file_stat.st_size);
+    if (size > FLAGS_read_max) {
+      ::close(fd);
+      LOG(WARNING) << "Cannot read file that exceeds size limit: "
+                   << path.string();
+      VLOG(1) << "Cannot read " << path.string()
+              << " size exceeds limit: " << size << " > " << FLAGS_read_max;
+      return Status::failure("File exceeds read limits");
+    }
+
+    auto mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      ::close(fd);
+      ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+      mapping_ = mapping;
+      mapping_size_ = size;
+      data_ = std::string_view(static_cast<const char*>(mapping), size);
+      return Status::success();
+    }
+  }
+  ::close(fd);
+#endif
+
+  // Files without a size are read until their end.
+  auto status = readFile(path, buffer_);
+  if (!status.ok()) {
+    buffer_.clear();
+    return status;
+  }
+
+  data_ = buffer_;
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Read-only access to a file's content without copying it.
+ *
+ * readFile copies a file into a string, which holds the file twice in memory
+ * (in the page cache and in the string) while a table parses it. A mapped
+ * file is read from the page cache directly, and only the pages a parser
+ * touches are read from disk.
+ *
+ * Files without a size, such as procfs files and pipes, and all files on
+ * Windows, are read with readFile instead. The read_max limit applies to
+ * both.
+ *
+ * A file truncated while it is mapped makes reads of the missing pages fail
+ * with SIGBUS. Only map files that are replaced rather than rewritten in
+ * place, such as package manager databases and lists.
+ */
+class MappedFile : private boost::noncopyable {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  /// Map, or read, a file. Replaces the content of an open file.
+  Status open(const boost::filesystem::path& path);
+
+  /// The content of the file, valid until the file is closed.
+  std::string_view data() const {
+    return data_;
+  }
+
+  /// Check if the content is mapped rather than read.
+  bool isMapped() const {
+    return mapping_ != nullptr;
+  }
+
+  /// Release the content.
+  void close();
+
+ private:
+  std::string_view data_;
+
+  void* mapping_{nullptr};
+  size_t mapping_size_{0};
+
+  /// The content of files that are not mapped.
+  std::string buffer_;
+};
+
+} // namespace osquery
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/posix/file_tail.h>
+
+namespace osquery {
+
+DECLARE_uint64(read_max);
+
+namespace {
+
+/// Bytes before the offset checked for changes.
+const size_t kTailSize{4096};
+
+/// Read size bytes from offset, the file may be shorter.
+bool readAt(int fd, off_t offset, size_t size, std::string& data) {
+  data.resize(size);
+  size_t total = 0;
+  while (total < size) {
+    auto bytes = ::pread(
+        fd, &data[total], size - total, offset + static_cast<off_t>(total));
+    if (bytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (bytes == 0) {
+      break;
+    }
+    total += static_cast<size_t>(bytes);
+  }
+  data.resize(total);
+  return true;
+}
+
+} // namespace
+
+void FileTail::setTail(const char* bytes, size_t size, off_t offset) {
+  tail_size_ = std::min(size, kTailSize);
+  tail_hash_ = std::hash<std::string_view>{}(
+      std::string_view(bytes + size - tail_size_, tail_size_));
+  offset_ = offset;
+}
+
+Status FileTail::read(const std::string& path,
+                      std::string& data,
+                      bool& restarted) {
+  data.clear();
+  restarted = false;
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open " + path);
+  }
+
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    ::close(fd);
+    return Status::failure("Not a regular file: " + path);
+  }
+
+  if (static_cast<uint64_t>(file_stat.st_size) > FLAGS_read_max) {
+    ::close(fd);
+    return Status::failure("File exceeds read limits: " + path);
+  }
+
+  // Continue from the offset when the bytes before it are unchanged.
+  std::string tail;
+  if (file_stat.st_dev == device_ && file_stat.st_ino == inode_ &&
+      file_stat.st_size >= offset_ &&
+      readAt(fd, offset_ - static_cast<off_t>(tail_size_), tail_size_, tail) &&
+      tail.size() == tail_size_ &&
+      std::hash<std::string_view>{}(tail) == tail_hash_) {
+    if (!readAt(fd,
+                offset_,
+                static_cast<size_t>(file_stat.st_size - offset_),
+                data)) {
+      ::close(fd);
+      return Status::failure("Cannot read " + path);
+    }
+
+    auto offset = offset_ + static_cast<off_t>(data.size());
+    if (data.size() >= kTailSize) {
+      setTail(data.data(), data.size(), offset);
+    } else if (!data.empty()) {
+      tail.append(data);
+      setTail(tail.data(), tail.size(), offset);
+    }
+    ::close(fd);
+    return Status::success();
+  }
+
+  restarted = true;
+  *this = FileTail();
+  if (!readAt(fd, 0, static_cast<size_t>(file_stat.st_size), data)) {
+    ::close(fd);
+    return Status::failure("Cannot read " + path);
+  }
+  ::close(fd);
+
+  device_ = file_stat.st_dev;
+  inode_ = file_stat.st_ino;
+  setTail(data.data(), data.size(), static_cast<off_t>(data.size()));
+  return Status::success();
+}
+} // namespace osquery
@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <sys/types.h>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Incremental reads of a file that is appended to.
+ *
+ * Remembers the device and inode of the file, the offset read up to, and a
+ * hash of the bytes before that offset. The next read continues from the
+ * offset if the file is the same one and those bytes are unchanged.
+ * Otherwise the file was replaced or rewritten, and it is read again from
+ * the start.
+ */
+class FileTail {
+ public:
+  /**
+   * @brief Read the data appended to a regular file since the last read.
+   *
+   * @param path the file to read.
+   * @param data the data read, from the start of the file if restarted.
+   * @param restarted set if the data does not follow the previous read,
+   * and state built from earlier data should be dropped.
+   */
+  Status read(const std::string& path, std::string& data, bool& restarted);
+
+ private:
+  /// Remember the end of the file, the last bytes read end at offset.
+  void setTail(const char* bytes, size_t size, off_t offset);
+
+ private:
+  dev_t device_{0};
+  ino_t inode_{0};
+
+  /// The size of the file when last read.
+  off_t offset_{0};
+
+  /// The hash of up to kTailSize bytes ending at offset_.
+  size_t tail_hash_{0};
+  size_t tail_size_{0};
+};
+} // namespace osquery
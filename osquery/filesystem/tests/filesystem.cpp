@@ -17,6 +17,7 @@
 #include <boost/filesystem.hpp>
 
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/mapped_file.h>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
@@ -193,6 +194,36 @@ TEST_F(FilesystemTests, test_read_size) {
   EXPECT_EQ(content.size(), s);
 }
 
+TEST_F(FilesystemTests, test_mapped_file) {
+  MappedFile file;
+  ASSERT_TRUE(file.open(fake_directory_ / "root.txt").ok());
+  EXPECT_EQ(file.data(), "root");
+  EXPECT_EQ(file.isMapped(), !isPlatform(PlatformType::TYPE_WINDOWS));
+
+  // Reopening replaces the content, an empty file is read rather than mapped.
+  auto test_file = test_working_dir_ / "fstests-mapped";
+  ASSERT_TRUE(writeTextFile(test_file, "").ok());
+  ASSERT_TRUE(file.open(test_file).ok());
+  EXPECT_TRUE(file.data().empty());
+  EXPECT_FALSE(file.isMapped());
+  removePath(test_file);
+
+  EXPECT_FALSE(file.open(fake_directory_ / "missing.txt").ok());
+  EXPECT_TRUE(file.data().empty());
+
+  auto max = FLAGS_read_max;
+  FLAGS_read_max = 3;
+  EXPECT_FALSE(file.open(fake_directory_ / "root.txt").ok());
+  FLAGS_read_max = max;
+
+#ifdef __linux__
+  // Files without a size are read.
+  ASSERT_TRUE(file.open("/proc/self/status").ok());
+  EXPECT_FALSE(file.isMapped());
+  EXPECT_EQ(file.data().find("Name:"), 0U);
+#endif
+}
+
 TEST_F(FilesystemTests, test_list_files_missing_directory) {
   std::vector<std::string> results;
   auto status = listFilesInDirectory("/foo/bar", results);
@@ -348,6 +379,29 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+#ifndef WIN32
+TEST_F(FilesystemTests, test_wildcard_double_symlink_loop) {
+  // A directory symlink to an ancestor is listed but not walked into.
+  fs::create_symlink(fake_directory_ / "deep1", fake_directory_ / "deep1/up");
+
+  std::vector<std::string> results;
+  auto status = resolveFilePattern(fake_directory_ / "%%", results);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 21U);
+  EXPECT_TRUE(contains(results, (fake_directory_ / "deep1/up/").string()));
+  EXPECT_FALSE(
+      contains(results, (fake_directory_ / "deep1/up/level1.txt").string()));
+
+  // Shallower levels are returned first.
+  auto level1 = std::find(
+      results.begin(), results.end(), (fake_directory_ / "root.txt").string());
+  auto level2 = std::find(results.begin(),
+                          results.end(),
+                          (fake_directory_ / "deep1/level1.txt").string());
+  EXPECT_LT(level1, level2);
+}
+#endif
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(fake_directory_ / "%11/%sh", results);
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/filesystem/linux/bpf_task_iterator.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace osquery {
+namespace {
+
+/// Builds raw BTF data.
+class BtfBuilder {
+ public:
+  BtfBuilder() {
+    strings_.push_back('\0');
+  }
+
+  uint32_t addString(const std::string& value) {
+    auto offset = static_cast<uint32_t>(strings_.size());
+    strings_ += value;
+    strings_.push_back('\0');
+    return offset;
+  }
+
+  /// Add a type, returning its ID.
+  uint32_t addType(const std::string& name,
+                   uint32_t kind,
+                   uint32_t vlen,
+                   uint32_t size_or_type,
+                   bool kind_flag = false) {
+    add(name.empty() ? 0 : addString(name));
+    add((kind << 24) | vlen | (kind_flag ? (1U << 31) : 0));
+    add(size_or_type);
+    return ++count_;
+  }
+
+  void addMember(const std::string& name, uint32_t type, uint32_t offset) {
+    add(name.empty() ? 0 : addString(name));
+    add(type);
+    add(offset);
+  }
+
+  void add(uint32_t value) {
+    types_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  std::string build() const {
+    struct {
+      uint16_t magic;
+      uint8_t version;
+      uint8_t flags;
+      uint32_t hdr_len;
+      uint32_t type_off;
+      uint32_t type_len;
+      uint32_t str_off;
+      uint32_t str_len;
+    } header{0xeB9F,
+             1,
+             0,
+             24,
+             0,
+             static_cast<uint32_t>(types_.size()),
+             static_cast<uint32_t>(types_.size()),
+             static_cast<uint32_t>(strings_.size())};
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    return data + types_ + strings_;
+  }
+
+ private:
+  uint32_t count_{0};
+  std::string types_;
+  std::string strings_;
+};
+
+} // namespace
+
+class BpfTaskIteratorTests : public testing::Test {};
+
+TEST_F(BpfTaskIteratorTests, test_btf_member_offsets) {
+  BtfBuilder builder;
+
+  // int
+  auto int_type = builder.addType("int", 1, 0, 4);
+  builder.add(32);
+
+  // An anonymous union { int a; int b; } behind a const.
+  auto inner = builder.addType("", 5, 2, 4);
+  builder.addMember("a", int_type, 0);
+  builder.addMember("b", int_type, 0);
+  auto const_inner = builder.addType("", 10, 0, inner);
+
+  // struct task_struct { int pid; union {...}; int flags:4; int tgid; }
+  builder.addType("task_struct", 4, 4, 16, true);
+  builder.addMember("pid", int_type, 0);
+  builder.addMember("", const_inner, 32);
+  builder.addMember("flags", int_type, (4U << 24) | 68);
+  builder.addMember("tgid", int_type, 96);
+
+  auto func_proto = builder.addType("", 13, 0, 0);
+  builder.addType("bpf_iter_task", 12, 0, func_proto);
+
+  KernelBtf btf;
+  ASSERT_TRUE(btf.parse(builder.build()).ok());
+
+  uint32_t offset = 0;
+  ASSERT_TRUE(btf.memberOffset("task_struct", "pid", offset).ok());
+  EXPECT_EQ(offset, 0U);
+  ASSERT_TRUE(btf.memberOffset("task_struct", "tgid", offset).ok());
+  EXPECT_EQ(offset, 12U);
+
+  // Members of anonymous unions are found at the union's offset.
+  ASSERT_TRUE(btf.memberOffset("task_struct", "b", offset).ok());
+  EXPECT_EQ(offset, 4U);
+
+  // Bitfields cannot be loaded on their own.
+  EXPECT_FALSE(btf.memberOffset("task_struct", "flags", offset).ok());
+  EXPECT_FALSE(btf.memberOffset("task_struct", "comm", offset).ok());
+  EXPECT_FALSE(btf.memberOffset("cred", "uid", offset).ok());
+
+  uint32_t id = 0;
+  ASSERT_TRUE(btf.functionId("bpf_iter_task", id).ok());
+  EXPECT_EQ(id, 6U);
+  EXPECT_FALSE(btf.functionId("bpf_iter_tcp", id).ok());
+}
+
+TEST_F(BpfTaskIteratorTests, test_btf_invalid) {
+  KernelBtf btf;
+  EXPECT_FALSE(btf.parse("").ok());
+  EXPECT_FALSE(btf.parse(std::string(24, '\0')).ok());
+
+  // A structure whose members run past the type section.
+  BtfBuilder builder;
+  builder.addType("task_struct", 4, 8, 16);
+  builder.addMember("pid", 0, 0);
+  EXPECT_FALSE(btf.parse(builder.build()).ok());
+}
+
+TEST_F(BpfTaskIteratorTests, test_dump_disabled) {
+  // The iterator is disabled by default, the tables read /proc.
+  std::vector<BpfTaskInfo> tasks;
+  EXPECT_FALSE(BpfTaskIterator::get().dump(tasks).ok());
+  EXPECT_TRUE(tasks.empty());
+}
+} // namespace osquery
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/read_batch.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_bool(enable_io_uring_reads);
+
+class ReadBatchTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    enable_io_uring_reads_ = FLAGS_enable_io_uring_reads;
+
+    test_dir_ = fs::temp_directory_path() /
+                fs::unique_path("osquery.read_batch.%%%%.%%%%");
+    fs::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    FLAGS_enable_io_uring_reads = enable_io_uring_reads_;
+    fs::remove_all(test_dir_);
+  }
+
+  std::string createFile(const std::string& name, const std::string& content) {
+    auto path = (test_dir_ / name).string();
+    EXPECT_TRUE(writeTextFile(path, content).ok());
+    return path;
+  }
+
+ protected:
+  fs::path test_dir_;
+
+ private:
+  bool enable_io_uring_reads_{false};
+};
+
+TEST_F(ReadBatchTests, test_read_files) {
+  // Larger than the first read of each file.
+  std::string large(20000, 'x');
+
+  auto small_path = createFile("small", "value\n");
+  auto empty_path = createFile("empty", "");
+  auto large_path = createFile("large", large);
+
+  // Without io_uring, or if it is not available, files are read one by one.
+  for (auto io_uring : {false, true}) {
+    FLAGS_enable_io_uring_reads = io_uring;
+
+    std::vector<BatchFileRead> files(4);
+    files[0].path = small_path;
+    files[1].path = empty_path;
+    files[2].path = large_path;
+    files[3].path = (test_dir_ / "missing").string();
+
+    readFileBatch(files);
+
+    ASSERT_TRUE(files[0].status.ok());
+    EXPECT_EQ(files[0].content, "value\n");
+    ASSERT_TRUE(files[1].status.ok());
+    EXPECT_TRUE(files[1].content.empty());
+    ASSERT_TRUE(files[2].status.ok());
+    EXPECT_EQ(files[2].content, large);
+    EXPECT_FALSE(files[3].status.ok());
+    EXPECT_TRUE(files[3].content.empty());
+  }
+}
+
+TEST_F(ReadBatchTests, test_read_procfs) {
+  for (auto io_uring : {false, true}) {
+    FLAGS_enable_io_uring_reads = io_uring;
+
+    // Files without a size, more of them than are submitted together.
+    std::vector<BatchFileRead> files(300);
+    for (auto& file : files) {
+      file.path = "/proc/self/status";
+    }
+
+    readFileBatch(files);
+
+    for (const auto& file : files) {
+      ASSERT_TRUE(file.status.ok());
+      EXPECT_EQ(file.content.find("Name:"), 0U);
+    }
+  }
+}
+} // namespace osquery
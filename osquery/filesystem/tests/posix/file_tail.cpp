@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <fstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/filesystem/posix/file_tail.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+class FileTailTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = fs::temp_directory_path() /
+                 fs::unique_path("osquery.file_tail_tests.%%%%-%%%%");
+    ASSERT_TRUE(fs::create_directory(directory_));
+    path_ = (directory_ / "history").string();
+  }
+
+  void TearDown() override {
+    fs::remove_all(directory_);
+  }
+
+  void write(const std::string& content, bool append) {
+    std::ofstream output(path_,
+                         std::ios::binary |
+                             (append ? std::ios::app : std::ios::trunc));
+    output << content;
+  }
+
+ protected:
+  fs::path directory_;
+  std::string path_;
+};
+
+TEST_F(FileTailTests, test_appended_data) {
+  FileTail tail;
+  std::string data;
+  bool restarted = false;
+
+  write("first\n", false);
+  ASSERT_TRUE(tail.read(path_, data, restarted).ok());
+  EXPECT_TRUE(restarted);
+  EXPECT_EQ("first\n", data);
+
+  // Only appended data is read.
+  write("second\n", true);
+  ASSERT_TRUE(tail.read(path_, data, restarted).ok());
+  EXPECT_FALSE(restarted);
+  EXPECT_EQ("second\n", data);
+
+  ASSERT_TRUE(tail.read(path_, data, restarted).ok());
+  EXPECT_FALSE(restarted);
+  EXPECT_TRUE(data.empty());
+
+  // A rewritten file of the same size is read again.
+  write("FIRST\nsecond\n", false);
+  ASSERT_TRUE(tail.read(path_, data, restarted).ok());
+  EXPECT_TRUE(restarted);
+  EXPECT_EQ("FIRST\nsecond\n", data);
+
+  // So is a truncated one.
+  write("third\n", false);
+  ASSERT_TRUE(tail.read(path_, data, restarted).ok());
+  EXPECT_TRUE(restarted);
+  EXPECT_EQ("third\n", data);
+
+  // And a replaced one.
+  fs::remove(path_);
+  EXPECT_FALSE(tail.read(path_, data, restarted).ok());
+  write("fourth\n", false);
+  ASSERT_TRUE(tail.read(path_, data, restarted).ok());
+  EXPECT_TRUE(restarted);
+  EXPECT_EQ("fourth\n", data);
+}
+
+TEST_F(FileTailTests, test_not_regular_file) {
+  FileTail tail;
+  std::string data;
+  bool restarted = false;
+  EXPECT_FALSE(tail.read(directory_.string(), data, restarted).ok());
+}
+} // namespace osquery
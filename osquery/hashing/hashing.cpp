@@ -8,8 +8,13 @@
  */
 
 #include <algorithm>
+#include <condition_variable>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -19,13 +24,104 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/utils/base64.h>
-#include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
 
 /// The buffer read size from file IO to hashing structures.
-const size_t kHashChunkSize{4096};
+const size_t kHashChunkSize{256 * 1024};
+
+/// Files larger than this compute each digest on its own thread.
+const size_t kHashParallelSize{4 * 1024 * 1024};
+
+namespace {
+
+/**
+ * @brief Compute several digests of a stream concurrently.
+ *
+ * Each digest is updated on its own thread. A chunk is swapped out of the
+ * reader's buffer, so the next chunk is read while the current one is hashed.
+ */
+class ParallelHasher : private boost::noncopyable {
+ public:
+  explicit ParallelHasher(const std::vector<Hash*>& hashes) {
+    for (auto hash : hashes) {
+      threads_.emplace_back([this, hash]() { work(hash); });
+    }
+  }
+
+  ~ParallelHasher() {
+    finish();
+  }
+
+  /// Hand over a chunk once the previous one is hashed.
+  void update(std::string& buffer, size_t size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return pending_ == 0; });
+
+    std::swap(chunk_, buffer);
+    size_ = size;
+    pending_ = threads_.size();
+    generation_++;
+    cv_.notify_all();
+  }
+
+  /// Wait for the last chunk and stop the threads.
+  void finish() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return pending_ == 0; });
+      stop_ = true;
+      cv_.notify_all();
+    }
+
+    for (auto& thread : threads_) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+ private:
+  void work(Hash* hash) {
+    size_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this, seen]() { return stop_ || generation_ != seen; });
+      if (generation_ == seen) {
+        return;
+      }
+
+      seen = generation_;
+      lock.unlock();
+      hash->update(chunk_.data(), size_);
+      lock.lock();
+
+      if (--pending_ == 0) {
+        cv_.notify_all();
+      }
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  /// The chunk being hashed, read-only while pending_ is not 0.
+  std::string chunk_;
+  size_t size_{0};
+
+  /// Each handed over chunk starts a generation.
+  size_t generation_{0};
+
+  /// The number of digests still updating with the current chunk.
+  size_t pending_{0};
+
+  bool stop_{false};
+  std::vector<std::thread> threads_;
+};
+
+} // namespace
 
 Hash::~Hash() {
   if (ctx_ != nullptr) {
@@ -109,20 +205,46 @@ MultiHashes hashMultiFromFile(int mask, const std::string& path) {
       {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
   };
 
-  auto blocking = isPlatform(PlatformType::TYPE_WINDOWS);
+  std::vector<Hash*> selected;
+  for (auto& hash : hashes) {
+    if (mask & hash.first) {
+      selected.push_back(hash.second.get());
+    }
+  }
+
+  // Digests are only computed concurrently once a file proves to be large.
+  auto concurrent =
+      selected.size() > 1 && std::thread::hardware_concurrency() > 1;
+  std::unique_ptr<ParallelHasher> parallel;
+  size_t total = 0;
+
+  // Blocking reads hash a file in chunks rather than reading it whole.
   auto s = readFile(path,
                     0,
                     kHashChunkSize,
                     false,
                     true,
-                    ([&hashes, &mask](std::string& buffer, size_t size) {
-                      for (auto& hash : hashes) {
-                        if (mask & hash.first) {
-                          hash.second->update(&buffer[0], size);
-                        }
+                    ([&](std::string& buffer, size_t size) {
+                      total += size;
+                      if (parallel == nullptr && concurrent &&
+                          total > kHashParallelSize) {
+                        parallel = std::make_unique<ParallelHasher>(selected);
+                      }
+
+                      if (parallel != nullptr) {
+                        parallel->update(buffer, size);
+                        return;
+                      }
+
+                      for (auto hash : selected) {
+                        hash->update(&buffer[0], size);
                       }
                     }),
-                    blocking);
+                    true);
+
+  if (parallel != nullptr) {
+    parallel->finish();
+  }
 
   MultiHashes mh = {};
   if (!s.ok()) {
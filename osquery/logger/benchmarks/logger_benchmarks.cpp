@@ -9,14 +9,27 @@
 
 #include <benchmark/benchmark.h>
 
+#include <boost/filesystem.hpp>
+
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query.h>
+#include <osquery/database/database.h>
+#include <osquery/dispatcher/scheduler.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/conversions/split.h>
+
+#include <plugins/logger/buffered.h>
+#include <plugins/logger/filesystem_logger.h>
+
+namespace fs = boost::filesystem;
 
 namespace osquery {
 
 DECLARE_bool(disable_logging);
+DECLARE_string(database_path);
+DECLARE_uint64(buffered_log_max);
 
 class DummyLoggerPlugin : public LoggerPlugin {
  public:
@@ -83,4 +96,272 @@ static void LOGGER_logstring_plugin(benchmark::State& state) {
 }
 
 BENCHMARK(LOGGER_logstring_plugin);
+
+/// Build a process-like row, a mix of short and long strings and integers.
+RowTyped getExampleEventRow(size_t columns, size_t index) {
+  RowTyped r;
+  r["pid"] = static_cast<long long>(index);
+  r["uid"] = static_cast<long long>(index % 500);
+  r["path"] = "/usr/local/bin/example_process_" + std::to_string(index);
+  r["cmdline"] = "example_process_" + std::to_string(index) +
+                 " --flagfile /etc/osquery/osquery.flags --verbose";
+  for (size_t i = 4; i < columns; i++) {
+    r["column" + std::to_string(i)] = std::to_string(i) + "content";
+  }
+  return r;
+}
+
+QueryLogItem getExampleLogItem(size_t columns, size_t rows) {
+  QueryLogItem item;
+  item.name = "pack_benchmark_processes";
+  item.identifier = "benchmark.example.com";
+  item.time = 1589600136;
+  item.calendar_time = "Sat May 16 03:35:36 2020 UTC";
+  item.decorations = {
+      {"host_uuid", "4740D59F-699E-5B29-960B-979AAF9BBEEB"},
+      {"hostname", "benchmark.example.com"},
+      {"osquery_version", "4.5.0"},
+  };
+
+  item.results.added.reserve(rows);
+  for (size_t i = 0; i < rows; i++) {
+    item.results.added.push_back(getExampleEventRow(columns, i));
+  }
+  return item;
+}
+
+static void LOGGER_serialize_events_decorated(benchmark::State& state) {
+  auto item = getExampleLogItem(state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    std::vector<std::string> items;
+    serializeQueryLogItemAsEventsJSON(item, items);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+BENCHMARK(LOGGER_serialize_events_decorated)
+    ->ArgPair(4, 1)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000)
+    ->ArgPair(50, 1000);
+
+static void LOGGER_serialize_event_lines_decorated(benchmark::State& state) {
+  auto item = getExampleLogItem(state.range(0), state.range(1));
+  std::string lines;
+  while (state.KeepRunning()) {
+    serializeQueryLogItemAsEventLines(item, lines);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+BENCHMARK(LOGGER_serialize_event_lines_decorated)
+    ->ArgPair(4, 1)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000)
+    ->ArgPair(50, 1000);
+
+/// Serialize a log item into event lines, the input of the write paths.
+std::string getExampleEventLines(size_t rows) {
+  std::string lines;
+  serializeQueryLogItemAsEventLines(getExampleLogItem(10, rows), lines);
+  return lines;
+}
+
+static void LOGGER_filesystem_write(benchmark::State& state) {
+  auto path = fs::temp_directory_path() /
+              fs::unique_path("osquery.benchmark.%%%%.%%%%.log");
+  auto lines = split(getExampleEventLines(state.range(0)), "\n");
+
+  {
+    FilesystemLogWriter writer(path);
+    while (state.KeepRunning()) {
+      for (const auto& line : lines) {
+        writer.write(line);
+      }
+    }
+    writer.flush();
+  }
+
+  state.SetItemsProcessed(state.iterations() * lines.size());
+  fs::remove(path);
+}
+
+BENCHMARK(LOGGER_filesystem_write)->Arg(1)->Arg(100)->Arg(10000);
+
+static void LOGGER_filesystem_write_lines(benchmark::State& state) {
+  auto path = fs::temp_directory_path() /
+              fs::unique_path("osquery.benchmark.%%%%.%%%%.log");
+  auto lines = getExampleEventLines(state.range(0));
+
+  {
+    FilesystemLogWriter writer(path);
+    while (state.KeepRunning()) {
+      writer.writeLines(lines);
+    }
+    writer.flush();
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  fs::remove(path);
+}
+
+BENCHMARK(LOGGER_filesystem_write_lines)->Arg(1)->Arg(100)->Arg(10000);
+
+/**
+ * @brief Use a temporary RocksDB database for the scope of a benchmark.
+ *
+ * The buffered forwarders and differentials are bound by database writes,
+ * the in-memory database would hide their cost.
+ */
+class BenchmarkDatabase {
+ public:
+  BenchmarkDatabase() {
+    auto& rf = RegistryFactory::get();
+    previous_plugin_ = rf.getActive("database");
+    rf.plugin("database", previous_plugin_)->tearDown();
+
+    previous_path_ = FLAGS_database_path;
+    path_ = fs::temp_directory_path() /
+            fs::unique_path("osquery.benchmark.%%%%.%%%%.db");
+    FLAGS_database_path = path_.string();
+
+    auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+        rf.plugin("database", "rocksdb"));
+    plugin->reset();
+    rf.setActive("database", "rocksdb");
+  }
+
+  ~BenchmarkDatabase() {
+    auto& rf = RegistryFactory::get();
+    rf.plugin("database", "rocksdb")->tearDown();
+    rf.setActive("database", previous_plugin_);
+    fs::remove_all(path_);
+    FLAGS_database_path = previous_path_;
+  }
+
+ private:
+  std::string previous_plugin_;
+  std::string previous_path_;
+  fs::path path_;
+};
+
+class BenchmarkLogForwarder : public BufferedLogForwarder {
+ public:
+  explicit BenchmarkLogForwarder(uint64_t max_log_lines)
+      : BufferedLogForwarder("BenchmarkLogForwarder",
+                             "benchmark",
+                             std::chrono::seconds(0),
+                             max_log_lines) {}
+
+  using BufferedLogForwarder::check;
+  using BufferedLogForwarder::purge;
+
+ protected:
+  Status send(std::vector<std::string>& log_data,
+              const std::string& log_type) override {
+    return Status::success();
+  }
+};
+
+static void LOGGER_buffered_enqueue(benchmark::State& state) {
+  BenchmarkDatabase database;
+  BenchmarkLogForwarder forwarder(1024);
+  forwarder.setUp();
+
+  auto lines = split(getExampleEventLines(1), "\n");
+  while (state.KeepRunning()) {
+    forwarder.logString(lines.front());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(LOGGER_buffered_enqueue);
+
+static void LOGGER_buffered_check(benchmark::State& state) {
+  BenchmarkDatabase database;
+  BenchmarkLogForwarder forwarder(state.range(0));
+  forwarder.setUp();
+
+  auto lines = split(getExampleEventLines(state.range(0)), "\n");
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (const auto& line : lines) {
+      forwarder.logString(line);
+    }
+    state.ResumeTiming();
+
+    // Every buffered line is sent and removed in a single check.
+    forwarder.check();
+  }
+  state.SetItemsProcessed(state.iterations() * lines.size());
+}
+
+BENCHMARK(LOGGER_buffered_check)->Arg(100)->Arg(1024)->Arg(10000);
+
+static void LOGGER_buffered_purge(benchmark::State& state) {
+  BenchmarkDatabase database;
+  BenchmarkLogForwarder forwarder(1024);
+  forwarder.setUp();
+
+  auto buffered_log_max = FLAGS_buffered_log_max;
+  auto lines = split(getExampleEventLines(state.range(0)), "\n");
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    FLAGS_buffered_log_max = 0;
+    for (const auto& line : lines) {
+      forwarder.logString(line);
+    }
+    FLAGS_buffered_log_max = lines.size() / 10;
+    state.ResumeTiming();
+
+    // The oldest 90% of the buffered lines are purged.
+    forwarder.purge();
+
+    state.PauseTiming();
+    forwarder.check();
+    state.ResumeTiming();
+  }
+
+  FLAGS_buffered_log_max = buffered_log_max;
+  state.SetItemsProcessed(state.iterations() * lines.size());
+}
+
+BENCHMARK(LOGGER_buffered_purge)->Arg(1000)->Arg(10000);
+
+static void LOGGER_launch_query_differential(benchmark::State& state) {
+  BenchmarkDatabase database;
+
+  FLAGS_disable_logging = false;
+  auto& rf = RegistryFactory::get();
+  rf.registry("logger")->add("dummy", std::make_shared<DummyLoggerPlugin>());
+  auto active = rf.getActive("logger");
+  rf.setActive("logger", "dummy");
+
+  // Every tenth row changes between executions, the rest are unchanged.
+  auto rows = std::to_string(state.range(0));
+  ScheduledQuery query(
+      "benchmark_pack",
+      "differential",
+      "with recursive n(i) as (select 1 union all select i + 1 from n where i "
+      "< " + rows +
+          ") select i as pid, i % 500 as uid, '/usr/local/bin/example_' || i "
+          "as path, case when i % 10 = 0 then random() else i end as value "
+          "from n");
+  query.interval = 10;
+
+  // The first execution stores the initial results.
+  launchQuery("pack_benchmark_differential", query);
+  while (state.KeepRunning()) {
+    launchQuery("pack_benchmark_differential", query);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+
+  rf.setActive("logger", active);
+  FLAGS_disable_logging = true;
+}
+
+BENCHMARK(LOGGER_launch_query_differential)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
 }
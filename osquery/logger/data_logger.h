@@ -125,6 +125,9 @@ void relayStatusLogs(bool async = false);
 /// Inspect the number of internal-buffered status log lines.
 size_t queuedStatuses();
 
+/// Inspect the number of result batches waiting for the logger queue thread.
+size_t queuedResults();
+
 /// Inspect the number of active internal status log sender threads.
 size_t queuedSenders();
 
@@ -12,20 +12,30 @@
 #endif
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <iomanip>
+#include <mutex>
 #include <queue>
+#include <sstream>
 #include <thread>
 
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
 #include <osquery/core/plugins/logger.h>
 #include <osquery/core/system.h>
+#include <osquery/core/trace.h>
 #include <osquery/database/database.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/extensions/extensions.h>
+#include <osquery/extensions/shared_ring.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
+#include <osquery/logger/status_log_buffer.h>
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry_factory.h>
 
@@ -81,6 +91,22 @@ HIDDEN_FLAG(bool,
             false,
             "Always send status logs synchronously");
 
+FLAG(uint32,
+     logger_status_buffer_size,
+     8192,
+     "Status logs buffered between relays to the logger plugins, further "
+     "status logs are dropped and counted (default 8192)");
+
+FLAG(uint64,
+     logger_queue_size,
+     0,
+     "Result batches queued for an asynchronous logger thread (default 0)");
+
+FLAG(string,
+     logger_queue_policy,
+     "block",
+     "Full logger queue policy: block, drop_oldest or spill");
+
 DECLARE_bool(enable_numeric_monitoring);
 
 /**
@@ -126,8 +152,8 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
   void WaitTillSent() override;
 
  public:
-  /// Accessor/mutator to dump all of the buffered logs.
-  std::vector<StatusLogLine>& dump();
+  /// The buffered logs, drained by the status log relay.
+  StatusLogBuffer& buffer();
 
   /// Add the buffered log sink to Glog.
   void enable();
@@ -163,14 +189,15 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
 
  private:
   /// Create the log sink as buffering or forwarding.
-  BufferedLogSink() = default;
+  BufferedLogSink()
+      : logs_(std::max<size_t>(FLAGS_logger_status_buffer_size, 1)) {}
 
   /// Stop the log sink.
   ~BufferedLogSink();
 
  private:
-  /// Intermediate log storage until an osquery logger is initialized.
-  std::vector<StatusLogLine> logs_;
+  /// Intermediate log storage until the next relay to the loggers.
+  StatusLogBuffer logs_;
 
   /**
    * @Brief Is the logger temporarily disabled.
@@ -184,8 +211,8 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
   std::vector<std::string> sinks_;
 };
 
-/// Mutex protecting accesses to buffered status logs.
-Mutex kBufferedLogSinkLogs;
+/// Mutex allowing one status log relay to drain the buffer at a time.
+Mutex kBufferedLogSinkRelay;
 
 /// Mutex protecting queued status log futures.
 Mutex kBufferedLogSinkSenders;
@@ -318,16 +345,13 @@ void BufferedLogSink::send(google::LogSeverity severity,
                            size_t message_len) {
   // WARNING, be extremely careful when accessing data here.
   // This should not cause any persistent storage or logging actions.
-  {
-    WriteLock lock(kBufferedLogSinkLogs);
-    logs_.push_back({(StatusLogSeverity)severity,
-                     std::string(base_filename),
-                     static_cast<size_t>(line),
-                     std::string(message, message_len),
-                     toAsciiTimeUTC(tm_time),
-                     toUnixTime(tm_time),
-                     std::string()});
-  }
+  logs_.push({(StatusLogSeverity)severity,
+              std::string(base_filename),
+              static_cast<size_t>(line),
+              std::string(message, message_len),
+              toAsciiTimeUTC(tm_time),
+              toUnixTime(tm_time),
+              std::string()});
 
   // The daemon will relay according to the schedule.
   if (enabled_ && !isDaemon()) {
@@ -355,7 +379,7 @@ void BufferedLogSink::WaitTillSent() {
   }
 }
 
-std::vector<StatusLogLine>& BufferedLogSink::dump() {
+StatusLogBuffer& BufferedLogSink::buffer() {
   return logs_;
 }
 
@@ -375,6 +399,50 @@ BufferedLogSink::~BufferedLogSink() {
   enabled_ = false;
 }
 
+namespace {
+
+using LoggerItems = PluginHandle<LoggerPlugin>::Items;
+
+/// The active logger plugins, resolved again when the registry changes.
+const PluginHandle<LoggerPlugin> kActiveLoggers("logger");
+
+/// Check if the resolved items are the comma-separated receiver.
+bool isReceiver(const LoggerItems& items, const std::string& receiver) {
+  size_t position = 0;
+  for (const auto& item : items) {
+    if (position > 0 && receiver.compare(position++, 1, ",") != 0) {
+      return false;
+    }
+    if (receiver.compare(position, item.name.size(), item.name) != 0) {
+      return false;
+    }
+    position += item.name.size();
+  }
+  return position == receiver.size();
+}
+
+/// The logger plugins of a receiver, usually the resolved active ones.
+std::shared_ptr<const LoggerItems> getLoggers(const std::string& receiver) {
+  auto active = kActiveLoggers.items();
+  if (isReceiver(*active, receiver)) {
+    return active;
+  }
+
+  auto loggers = std::make_shared<LoggerItems>();
+  for (const auto& logger : osquery::split(receiver, ",")) {
+    LoggerItems::value_type item;
+    item.name = logger;
+    if (Registry::get().exists("logger", logger, true)) {
+      item.plugin = std::dynamic_pointer_cast<LoggerPlugin>(
+          Registry::get().plugin("logger", logger));
+    }
+    loggers->push_back(std::move(item));
+  }
+  return loggers;
+}
+
+} // namespace
+
 Status logString(const std::string& message, const std::string& category) {
   return logString(
       message, category, RegistryFactory::get().getActive("logger"));
@@ -387,15 +455,14 @@ Status logString(const std::string& message,
     return Status::success();
   }
 
+  OSQUERY_TRACE_SPAN_DETAIL("logger", "send", receiver);
   Status status;
-  for (const auto& logger : osquery::split(receiver, ",")) {
-    if (Registry::get().exists("logger", logger, true)) {
-      auto plugin = Registry::get().plugin("logger", logger);
-      auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-      status = logger_plugin->logString(message);
+  for (const auto& logger : *getLoggers(receiver)) {
+    if (logger.plugin != nullptr) {
+      status = logger.plugin->logString(message);
     } else {
       status = Registry::call(
-          "logger", logger, {{"string", message}, {"category", category}});
+          "logger", logger.name, {{"string", message}, {"category", category}});
     }
   }
   return status;
@@ -403,8 +470,258 @@ Status logString(const std::string& message,
 
 namespace {
 const std::string kTotalQueryCounterMonitorPath("query.total.count");
+const std::string kLoggerQueueDepthMonitorPath("logger.queue.depth");
+const std::string kLoggerQueueDroppedMonitorPath("logger.queue.dropped");
+const std::string kLoggerQueueSpilledMonitorPath("logger.queue.spilled");
+
+/// Database key prefix, within kLogs, of spilled logger queue items.
+const std::string kLoggerQueueSpillPrefix{"logger_queue."};
+
+/// The number of spilled items read from the database at a time.
+const size_t kLoggerQueueSpillReadSize{64};
+
+/// Log newline-terminated results, local plugins receive the whole batch.
+Status logStringBatch(const std::string& batch, const std::string& receiver) {
+  OSQUERY_TRACE_SPAN_DETAIL("logger", "sendBatch", receiver);
+  Status status;
+  for (const auto& logger : *getLoggers(receiver)) {
+    if (logger.plugin != nullptr) {
+      status = logger.plugin->logStringBatch(batch);
+      continue;
+    }
+
+    // Trusted extensions may read whole batches from shared memory.
+    if (callSharedRing("logger", logger.name, "string_batch", batch).ok()) {
+      status = Status::success();
+      continue;
+    }
+
+    size_t start = 0;
+    while (start < batch.size()) {
+      auto end = batch.find('\n', start);
+      if (end == std::string::npos) {
+        end = batch.size();
+      }
+      status = Registry::call(
+          "logger",
+          logger.name,
+          {{"string", batch.substr(start, end - start)}, {"category", "event"}});
+      start = end + 1;
+    }
+  }
+  return status;
+}
+
+/// A serialized result log request.
+struct LoggerQueueItem {
+  /// The comma-delimited logger plugin names.
+  std::string receiver;
+
+  /// A single result, or newline-terminated results if batch is set.
+  std::string data;
+
+  bool batch{false};
+};
+
+Status deliverLoggerQueueItem(const LoggerQueueItem& item) {
+  if (item.batch) {
+    return logStringBatch(item.data, item.receiver);
+  }
+  return logString(item.data, "event", item.receiver);
 }
 
+/**
+ * @brief Deliver query results to the logger plugins from a dedicated thread.
+ *
+ * The scheduler serializes results and queues them, slow logger plugins no
+ * longer stall query execution. When more than --logger_queue_size batches
+ * are waiting the --logger_queue_policy applies: the producer blocks, the
+ * oldest batch is dropped, or the batch is spilled to the database and
+ * delivered once the in-memory queue drains.
+ */
+class LoggerQueueRunner : public InternalRunnable {
+ public:
+  LoggerQueueRunner() : InternalRunnable("LoggerQueueRunner") {}
+
+  /// Access the runner, starting its service on first use.
+  static std::shared_ptr<LoggerQueueRunner> get();
+
+  /// Queue an item, or deliver it inline if the runner stopped.
+  Status enqueue(LoggerQueueItem item);
+
+  /// The number of items queued or being delivered.
+  size_t depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + delivering_;
+  }
+
+ protected:
+  void start() override;
+
+  void stop() override;
+
+ private:
+  /// Store an item in the database, for delivery after the queue drains.
+  void spill(const LoggerQueueItem& item);
+
+  /// Deliver up to a chunk of spilled items, false if none remain.
+  bool drainSpilled();
+
+  void recordDepth(size_t depth);
+
+ private:
+  std::deque<LoggerQueueItem> queue_;
+
+  /// Set while an item popped from the queue is being delivered.
+  size_t delivering_{0};
+
+  /// Spilled items may exist, including from a previous process.
+  bool spilled_{true};
+
+  /// Orders spilled items within a second.
+  size_t spill_sequence_{0};
+
+  bool stopping_{false};
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+std::shared_ptr<LoggerQueueRunner> LoggerQueueRunner::get() {
+  static auto runner = std::make_shared<LoggerQueueRunner>();
+  static std::once_flag started;
+  std::call_once(started, []() { Dispatcher::addService(runner); });
+  return runner;
+}
+
+void LoggerQueueRunner::recordDepth(size_t depth) {
+  if (FLAGS_enable_numeric_monitoring) {
+    monitoring::record(kLoggerQueueDepthMonitorPath,
+                       depth,
+                       monitoring::PreAggregationType::Max);
+  }
+}
+
+Status LoggerQueueRunner::enqueue(LoggerQueueItem item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_ && queue_.size() >= FLAGS_logger_queue_size) {
+    if (FLAGS_logger_queue_policy == "drop_oldest") {
+      queue_.pop_front();
+      if (FLAGS_enable_numeric_monitoring) {
+        monitoring::record(kLoggerQueueDroppedMonitorPath,
+                           1,
+                           monitoring::PreAggregationType::Sum);
+      }
+    } else if (FLAGS_logger_queue_policy == "spill") {
+      spill(item);
+      spilled_ = true;
+      return Status::success();
+    } else {
+      not_full_.wait(lock);
+    }
+  }
+
+  if (stopping_) {
+    lock.unlock();
+    return deliverLoggerQueueItem(item);
+  }
+
+  queue_.push_back(std::move(item));
+  recordDepth(queue_.size() + delivering_);
+  not_empty_.notify_one();
+  return Status::success();
+}
+
+void LoggerQueueRunner::spill(const LoggerQueueItem& item) {
+  std::stringstream key;
+  key << kLoggerQueueSpillPrefix << std::setfill('0') << std::setw(10)
+      << getUnixTime() << "." << std::setw(10) << spill_sequence_++;
+
+  auto value = item.receiver + '\n' + ((item.batch) ? 'b' : 's') + item.data;
+  auto status = setDatabaseValue(kLogs, key.str(), value);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot spill logger queue item: " << status.getMessage();
+  } else if (FLAGS_enable_numeric_monitoring) {
+    monitoring::record(
+        kLoggerQueueSpilledMonitorPath, 1, monitoring::PreAggregationType::Sum);
+  }
+}
+
+bool LoggerQueueRunner::drainSpilled() {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kLogs, keys, kLoggerQueueSpillPrefix, 0);
+  if (keys.empty()) {
+    return false;
+  }
+
+  // Keys are ordered by spill time then sequence.
+  std::sort(keys.begin(), keys.end());
+  if (keys.size() > kLoggerQueueSpillReadSize) {
+    keys.resize(kLoggerQueueSpillReadSize);
+  }
+
+  for (const auto& key : keys) {
+    std::string value;
+    if (getDatabaseValue(kLogs, key, value).ok()) {
+      auto receiver_end = value.find('\n');
+      if (receiver_end != std::string::npos && receiver_end + 1 < value.size()) {
+        LoggerQueueItem item;
+        item.receiver = value.substr(0, receiver_end);
+        item.batch = value[receiver_end + 1] == 'b';
+        item.data = value.substr(receiver_end + 2);
+        deliverLoggerQueueItem(item);
+      }
+    }
+    deleteDatabaseValue(kLogs, key);
+  }
+  return true;
+}
+
+void LoggerQueueRunner::start() {
+  while (true) {
+    LoggerQueueItem item;
+    bool drain = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this]() {
+        return stopping_ || !queue_.empty() || spilled_;
+      });
+
+      if (!queue_.empty()) {
+        item = std::move(queue_.front());
+        queue_.pop_front();
+        delivering_ = 1;
+        not_full_.notify_all();
+      } else if (stopping_) {
+        break;
+      } else {
+        drain = true;
+      }
+    }
+
+    if (drain) {
+      // Spilled items are delivered once the in-memory queue is empty.
+      bool remaining = drainSpilled();
+      std::lock_guard<std::mutex> lock(mutex_);
+      spilled_ = remaining;
+      continue;
+    }
+
+    deliverLoggerQueueItem(item);
+    std::lock_guard<std::mutex> lock(mutex_);
+    delivering_ = 0;
+  }
+}
+
+void LoggerQueueRunner::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopping_ = true;
+  not_empty_.notify_all();
+  not_full_.notify_all();
+}
+} // namespace
+
 Status logQueryLogItem(const QueryLogItem& results) {
   return logQueryLogItem(results, RegistryFactory::get().getActive("logger"));
 }
@@ -420,23 +737,25 @@ Status logQueryLogItem(const QueryLogItem& results,
         kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
   }
 
-  std::vector<std::string> json_items;
+  LoggerQueueItem item;
+  item.receiver = receiver;
+  item.batch = FLAGS_logger_event_type;
+
   Status status;
-  if (FLAGS_logger_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(results, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(results, json);
-    json_items.emplace_back(json);
+  {
+    OSQUERY_TRACE_SPAN_DETAIL("logger", "serialize", results.name);
+    status = (item.batch)
+                 ? serializeQueryLogItemAsEventLines(results, item.data)
+                 : serializeQueryLogItemJSON(results, item.data);
   }
   if (!status.ok()) {
     return status;
   }
 
-  for (const auto& json : json_items) {
-    status = logString(json, "event", receiver);
+  if (FLAGS_logger_queue_size > 0) {
+    return LoggerQueueRunner::get()->enqueue(std::move(item));
   }
-  return status;
+  return deliverLoggerQueueItem(item);
 }
 
 Status logSnapshotQuery(const QueryLogItem& item) {
@@ -451,7 +770,7 @@ Status logSnapshotQuery(const QueryLogItem& item) {
 
   std::vector<std::string> json_items;
   Status status;
-  if (FLAGS_logger_snapshot_event_type) {
+  if (FLAGS_logger_snapshot_event_type && !item.snapshot_unchanged) {
     status = serializeQueryLogItemAsEventsJSON(item, json_items);
   } else {
     std::string json;
@@ -462,15 +781,13 @@ Status logSnapshotQuery(const QueryLogItem& item) {
     return status;
   }
 
+  auto loggers = kActiveLoggers.items();
   for (const auto& json : json_items) {
-    auto receiver = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(receiver, ",")) {
-      if (Registry::get().exists("logger", logger, true)) {
-        auto plugin = Registry::get().plugin("logger", logger);
-        auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-        status = logger_plugin->logSnapshot(json);
+    for (const auto& logger : *loggers) {
+      if (logger.plugin != nullptr) {
+        status = logger.plugin->logSnapshot(json);
       } else {
-        status = Registry::call("logger", logger, {{"snapshot", json}});
+        status = Registry::call("logger", logger.name, {{"snapshot", json}});
       }
     }
   }
@@ -479,8 +796,14 @@ Status logSnapshotQuery(const QueryLogItem& item) {
 }
 
 size_t queuedStatuses() {
-  ReadLock lock(kBufferedLogSinkLogs);
-  return BufferedLogSink::get().dump().size();
+  return BufferedLogSink::get().buffer().size();
+}
+
+size_t queuedResults() {
+  if (FLAGS_logger_queue_size == 0) {
+    return 0;
+  }
+  return LoggerQueueRunner::get()->depth();
 }
 
 size_t queuedSenders() {
@@ -488,6 +811,26 @@ size_t queuedSenders() {
   return BufferedLogSink::get().senders.size();
 }
 
+namespace {
+
+/// Report the status logs and results waiting for the logger plugins.
+void reportLoggerMemory(std::vector<SubsystemMemory>& memory) {
+  SubsystemMemory statuses;
+  statuses.name = "status_logs";
+  statuses.items = static_cast<int64_t>(queuedStatuses());
+  memory.push_back(std::move(statuses));
+
+  SubsystemMemory results;
+  results.name = "results_queue";
+  results.items = static_cast<int64_t>(queuedResults());
+  memory.push_back(std::move(results));
+}
+
+const bool kLoggerMemoryReporter =
+    registerMemoryReporter("logger", reportLoggerMemory);
+
+} // namespace
+
 void relayStatusLogs(bool async) {
   if (FLAGS_disable_logging || !databaseInitialized()) {
     // The logger plugins may not be setUp if logging is disabled.
@@ -496,40 +839,62 @@ void relayStatusLogs(bool async) {
     return;
   }
 
-  {
-    ReadLock lock(kBufferedLogSinkLogs);
-    if (BufferedLogSink::get().dump().size() == 0) {
-      return;
-    }
+  if (BufferedLogSink::get().buffer().size() == 0) {
+    return;
   }
 
   auto sender = ([]() {
-    auto identifier = getHostIdentifier();
-
-    // Construct a status log plugin request.
-    PluginRequest request = {{"status", "true"}};
+    std::vector<StatusLogLine> status_logs;
+    size_t dropped = 0;
     {
-      WriteLock lock(kBufferedLogSinkLogs);
-      auto& status_logs = BufferedLogSink::get().dump();
-      for (auto& log : status_logs) {
-        // Copy the host identifier into each status log.
-        log.identifier = identifier;
-      }
+      WriteLock lock(kBufferedLogSinkRelay);
+      BufferedLogSink::get().buffer().drain(status_logs);
+      dropped = BufferedLogSink::get().buffer().takeDropped();
+    }
+
+    if (dropped > 0) {
+      status_logs.push_back({O_WARNING,
+                             "logger.cpp",
+                             static_cast<uint64_t>(__LINE__),
+                             std::to_string(dropped) +
+                                 " status logs were dropped because the "
+                                 "status log buffer was full",
+                             getAsciiTime(),
+                             getUnixTime(),
+                             std::string()});
+    }
 
-      serializeIntermediateLog(status_logs, request);
+    if (status_logs.empty()) {
+      return;
+    }
 
-      // Flush the buffered status logs.
-      status_logs.clear();
+    // Copy the host identifier into each status log.
+    auto identifier = getHostIdentifier();
+    for (auto& log : status_logs) {
+      log.identifier = identifier;
     }
 
-    auto logger_plugin = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(logger_plugin, ",")) {
-      auto& enabled = BufferedLogSink::get().enabledPlugins();
-      if (std::find(enabled.begin(), enabled.end(), logger) != enabled.end()) {
-        // Skip the registry's logic, and send directly to the core's logger.
-        PluginResponse response;
-        Registry::call("logger", logger, request, response);
+    // Local plugins receive the lines, others a serialized plugin request.
+    PluginRequest request;
+    const auto& enabled = BufferedLogSink::get().enabledPlugins();
+    for (const auto& logger : *kActiveLoggers.items()) {
+      if (std::find(enabled.begin(), enabled.end(), logger.name) ==
+          enabled.end()) {
+        continue;
       }
+
+      if (logger.plugin != nullptr) {
+        logger.plugin->logStatus(status_logs);
+        continue;
+      }
+
+      if (request.empty()) {
+        request["status"] = "true";
+        serializeIntermediateLog(status_logs, request);
+      }
+
+      PluginResponse response;
+      Registry::call("logger", logger.name, request, response);
     }
   });
 
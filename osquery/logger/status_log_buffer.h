@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/plugins/logger.h>
+
+namespace osquery {
+
+/**
+ * @brief A bounded buffer of status logs, written without locks.
+ *
+ * Every thread that logs a status writes to this buffer, so writers only
+ * claim a slot with an atomic increment and never wait for each other or the
+ * relay. The relay is the single reader, callers must not drain concurrently.
+ * A status log is dropped and counted when the buffer is full.
+ */
+class StatusLogBuffer : private boost::noncopyable {
+ public:
+  /// The capacity is rounded up to a power of two.
+  explicit StatusLogBuffer(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+
+    mask_ = size - 1;
+    slots_ = std::make_unique<Slot[]>(size);
+    for (size_t i = 0; i < size; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /// Add a status log, false if the buffer was full and the log was dropped.
+  bool push(StatusLogLine&& line) {
+    auto position = tail_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots_[position & mask_];
+      auto sequence = slot->sequence.load(std::memory_order_acquire);
+      auto difference = static_cast<intptr_t>(sequence) -
+                        static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (tail_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->line = std::move(line);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Move the buffered status logs, in order, to the end of lines.
+  size_t drain(std::vector<StatusLogLine>& lines) {
+    size_t count = 0;
+    auto position = head_.load(std::memory_order_relaxed);
+    while (true) {
+      auto& slot = slots_[position & mask_];
+      if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+        // The buffer is empty, or the next log is still being written.
+        break;
+      }
+
+      lines.push_back(std::move(slot.line));
+      slot.line = StatusLogLine();
+      slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+      ++position;
+      ++count;
+    }
+
+    head_.store(position, std::memory_order_relaxed);
+    return count;
+  }
+
+  /// The approximate count of buffered status logs.
+  size_t size() const {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_relaxed);
+    return (tail > head) ? tail - head : 0;
+  }
+
+  /// Return and reset the count of status logs dropped since the last call.
+  size_t takeDropped() {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    StatusLogLine line;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_{0};
+
+  /// The next slot read by the relay.
+  alignas(64) std::atomic<size_t> head_{0};
+
+  /// The next slot claimed by a writer.
+  alignas(64) std::atomic<size_t> tail_{0};
+
+  std::atomic<size_t> dropped_{0};
+};
+
+} // namespace osquery
@@ -16,6 +16,7 @@
 #include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
+#include <osquery/logger/status_log_buffer.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/system/time.h>
@@ -30,6 +31,7 @@ DECLARE_bool(logger_event_type);
 DECLARE_bool(logger_snapshot_event_type);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_uint64(logger_queue_size);
 
 class LoggerTests : public testing::Test {
  public:
@@ -46,6 +48,7 @@ class LoggerTests : public testing::Test {
     log_lines.clear();
     status_messages.clear();
     statuses_logged = 0;
+    events_logged = 0;
     last_status = {O_INFO, "", 10, "", "cal_time", 0, "host"};
   }
 
@@ -243,6 +246,19 @@ TEST_F(LoggerTests, test_feature_request) {
   EXPECT_EQ(LOGGER_FEATURE_LOGSTATUS, status.getCode());
 }
 
+TEST_F(LoggerTests, test_log_event_batch) {
+  auto plugin = RegistryFactory::get().plugin("logger", "test");
+  auto logger = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
+
+  // Each newline-terminated event is forwarded to logEvent.
+  auto status = logger->logEventBatch("{\"a\":\"1\"}\n{\"a\":\"2\"}\n");
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(2U, LoggerTests::events_logged);
+
+  EXPECT_TRUE(logger->logEventBatch("").ok());
+  EXPECT_EQ(2U, LoggerTests::events_logged);
+}
+
 TEST_F(LoggerTests, test_logger_variations) {
   // Retrieve the test logger plugin.
   auto plugin = RegistryFactory::get().plugin("logger", "test");
@@ -375,6 +391,36 @@ TEST_F(LoggerTests, test_logger_scheduled_query) {
   EXPECT_EQ(LoggerTests::log_lines.back(), expected);
 }
 
+TEST_F(LoggerTests, test_logger_scheduled_query_queue) {
+  RegistryFactory::get().setActive("logger", "test");
+  initLogger("scheduled_query");
+
+  QueryLogItem item;
+  item.name = "test_query";
+  item.identifier = "unknown_test_host";
+  item.time = 0;
+  item.calendar_time = "no_time";
+  item.epoch = 0L;
+  item.counter = 0L;
+  item.results.added.push_back({{"test_column", "test_value"}});
+  item.results.removed.push_back({{"test_column", "test_old_value"}});
+
+  auto backup_queue_size = FLAGS_logger_queue_size;
+  FLAGS_logger_queue_size = 4;
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(logQueryLogItem(item));
+  }
+
+  // The logger thread delivers every queued result.
+  for (size_t i = 0; i < 100 && queuedResults() > 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_EQ(0U, queuedResults());
+  EXPECT_EQ(6U, LoggerTests::log_lines.size());
+
+  FLAGS_logger_queue_size = backup_queue_size;
+}
+
 TEST_F(LoggerTests, test_logger_numeric_flag) {
   RegistryFactory::get().setActive("logger", "test");
   initLogger("scheduled_query");
@@ -412,6 +458,57 @@ TEST_F(LoggerTests, test_logger_numeric_flag) {
   EXPECT_EQ(LoggerTests::log_lines.back(), expected);
 }
 
+TEST_F(LoggerTests, test_status_log_buffer) {
+  StatusLogBuffer buffer(3);
+  for (size_t i = 0; i < 5; ++i) {
+    StatusLogLine line{O_INFO, "file", i, std::to_string(i), "", 0, ""};
+    EXPECT_EQ(buffer.push(std::move(line)), i < 4);
+  }
+
+  // The capacity is rounded up to 4, the last log was dropped.
+  EXPECT_EQ(buffer.size(), 4U);
+  EXPECT_EQ(buffer.takeDropped(), 1U);
+  EXPECT_EQ(buffer.takeDropped(), 0U);
+
+  std::vector<StatusLogLine> lines;
+  EXPECT_EQ(buffer.drain(lines), 4U);
+  ASSERT_EQ(lines.size(), 4U);
+  EXPECT_EQ(lines[0].message, "0");
+  EXPECT_EQ(lines[3].message, "3");
+  EXPECT_EQ(buffer.size(), 0U);
+
+  // Writers on several threads, the relay drains while they write.
+  const size_t kThreads = 4;
+  const size_t kLines = 1000;
+  std::vector<std::thread> writers;
+  for (size_t t = 0; t < kThreads; ++t) {
+    writers.emplace_back([&buffer, t]() {
+      for (size_t i = 0; i < kLines; ++i) {
+        StatusLogLine line{O_INFO, "file", i, std::to_string(t), "", 0, ""};
+        while (!buffer.push(std::move(line))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  lines.clear();
+  while (lines.size() < kThreads * kLines) {
+    buffer.drain(lines);
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  // Each thread's logs are drained in the order it wrote them.
+  std::vector<size_t> next(kThreads, 0);
+  for (const auto& line : lines) {
+    auto& expected = next[std::stoul(line.message)];
+    EXPECT_EQ(line.line, expected);
+    expected = line.line + 1;
+  }
+}
+
 class RecursiveLoggerPlugin : public LoggerPlugin {
  protected:
   bool usesLogStatus() override {
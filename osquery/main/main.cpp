@@ -11,6 +11,7 @@
 #include <io.h>
 #endif
 
+#include <chrono>
 #include <iostream>
 
 #include <boost/algorithm/string/predicate.hpp>
@@ -24,6 +25,7 @@
 #include <osquery/devtools/devtools.h>
 #include <osquery/dispatcher/distributed_runner.h>
 #include <osquery/dispatcher/scheduler.h>
+#include <osquery/dispatcher/trace_runner.h>
 #include <osquery/extensions/extensions.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/logger/logger.h>
@@ -76,6 +78,8 @@ int profile(int argc, char* argv[]) {
   osquery::RegistryFactory::get().setActive("database", "ephemeral");
 
   auto dbc = osquery::SQLiteDBManager::get();
+  size_t rows = 0;
+  auto start = std::chrono::steady_clock::now();
   for (size_t i = 0; i < static_cast<size_t>(osquery::FLAGS_profile); ++i) {
     osquery::QueryData results;
     auto status = osquery::queryInternal(query, results, dbc);
@@ -85,7 +89,16 @@ int profile(int argc, char* argv[]) {
                 << "): " << status.what() << std::endl;
       return status.getCode();
     }
+    rows = results.size();
   }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // Report the rows and time of each run, without the delays, for
+  // tools/analysis/profile.py.
+  std::cout << "{\"iterations\":" << osquery::FLAGS_profile
+            << ",\"rows\":" << rows << ",\"time_ms\":"
+            << elapsed.count() / osquery::FLAGS_profile << "}" << std::endl;
 
   if (osquery::FLAGS_profile_delay > 0) {
     osquery::sleepFor(osquery::FLAGS_profile_delay * 1000);
@@ -103,6 +116,9 @@ void startDaemon(Initializer& runner) {
     VLOG(1) << "Not starting the distributed query service: " << s.toString();
   }
 
+  // Write recorded spans while the daemon runs.
+  startTraceRunner();
+
   // Begin the schedule runloop.
   startScheduler();
 
@@ -132,6 +148,7 @@ int startShell(osquery::Initializer& runner, int argc, char* argv[]) {
       runner.waitForShutdown();
       retcode = getShutdownExitCode();
     } else {
+      startTraceRunner();
       // Virtual tables will be attached to the shell's in-memory SQLite DB.
       retcode = osquery::launchIntoShell(argc, argv);
     }
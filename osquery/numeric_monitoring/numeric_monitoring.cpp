@@ -7,7 +7,14 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <array>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/io/detail/quoted_manip.hpp>
 
@@ -61,7 +68,8 @@ const auto& getAggregationTypeToStringTable() {
           {PreAggregationType::P10, "p10"},
           {PreAggregationType::P50, "p50"},
           {PreAggregationType::P95, "p95"},
-          {PreAggregationType::P99, "p99"}};
+          {PreAggregationType::P99, "p99"},
+          {PreAggregationType::Histogram, "histogram"}};
   return table;
 }
 
@@ -101,6 +109,204 @@ namespace monitoring {
 
 namespace {
 
+/// Per-thread metric counters are allocated in blocks of this many metrics.
+const size_t kMetricBlockSize{256};
+
+/// The most blocks, and so metrics, a thread may have.
+const size_t kMaxMetricBlocks{256};
+
+/// A registered metric path.
+struct MetricPath {
+  std::string path;
+  PreAggregationType pre_aggregation;
+};
+
+/// The paths of every metric, indexed by the metric id.
+class MetricPaths final {
+ public:
+  static MetricPaths& get() {
+    static MetricPaths instance;
+    return instance;
+  }
+
+  size_t add(const std::string& path, PreAggregationType pre_aggregation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(path, pre_aggregation);
+    auto it = ids_.find(key);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+
+    if (paths_.size() >= kMetricBlockSize * kMaxMetricBlocks) {
+      return static_cast<size_t>(-1);
+    }
+    ids_[key] = paths_.size();
+    paths_.push_back({path, pre_aggregation});
+    return paths_.size() - 1;
+  }
+
+  MetricPath at(size_t id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return paths_.at(id);
+  }
+
+  std::vector<MetricPath> copy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return paths_;
+  }
+
+ private:
+  std::map<std::pair<std::string, PreAggregationType>, size_t> ids_;
+  std::vector<MetricPath> paths_;
+  mutable std::mutex mutex_;
+};
+
+/**
+ * @brief The pre-aggregated value of a metric on one thread.
+ *
+ * Only the owning thread records, the flusher exchanges the value for the
+ * initial value of its aggregation.
+ */
+struct MetricSlot {
+  std::atomic<ValueType> value{0};
+  std::atomic<uint64_t> count{0};
+  std::atomic<bool> armed{false};
+};
+
+struct MetricBlock {
+  std::array<MetricSlot, kMetricBlockSize> slots;
+};
+
+ValueType initialValue(PreAggregationType pre_aggregation) {
+  if (pre_aggregation == PreAggregationType::Min) {
+    return std::numeric_limits<ValueType>::max();
+  } else if (pre_aggregation == PreAggregationType::Max) {
+    return std::numeric_limits<ValueType>::min();
+  }
+  return 0;
+}
+
+class ThreadMetrics final {
+ public:
+  ~ThreadMetrics() {
+    for (auto& block : blocks_) {
+      delete block.load();
+    }
+  }
+
+  /// Called by the owning thread only.
+  void record(size_t id, PreAggregationType pre_aggregation, ValueType value) {
+    auto& block = blocks_[id / kMetricBlockSize];
+    auto current = block.load(std::memory_order_acquire);
+    if (current == nullptr) {
+      current = new MetricBlock();
+      block.store(current, std::memory_order_release);
+    }
+
+    auto& slot = current->slots[id % kMetricBlockSize];
+    if (!slot.armed.load(std::memory_order_relaxed)) {
+      slot.value.store(initialValue(pre_aggregation));
+      slot.armed.store(true, std::memory_order_release);
+    }
+
+    auto previous = slot.value.load(std::memory_order_relaxed);
+    switch (pre_aggregation) {
+    case PreAggregationType::Min:
+      while (value < previous &&
+             !slot.value.compare_exchange_weak(previous, value)) {
+      }
+      break;
+    case PreAggregationType::Max:
+      while (value > previous &&
+             !slot.value.compare_exchange_weak(previous, value)) {
+      }
+      break;
+    default:
+      slot.value.fetch_add(value, std::memory_order_relaxed);
+      break;
+    }
+    slot.count.fetch_add(1, std::memory_order_release);
+  }
+
+  /// Take the pre-aggregated values, called by the flusher.
+  void take(const std::vector<MetricPath>& paths,
+            const TimePoint& time_point,
+            std::vector<Point>& points) {
+    for (size_t b = 0; b < kMaxMetricBlocks; ++b) {
+      auto block = blocks_[b].load(std::memory_order_acquire);
+      if (block == nullptr) {
+        continue;
+      }
+
+      for (size_t i = 0; i < kMetricBlockSize; ++i) {
+        auto id = b * kMetricBlockSize + i;
+        auto& slot = block->slots[i];
+        if (id >= paths.size() || !slot.armed.load(std::memory_order_acquire) ||
+            slot.count.exchange(0, std::memory_order_acquire) == 0) {
+          continue;
+        }
+
+        const auto& path = paths[id];
+        auto value = slot.value.exchange(initialValue(path.pre_aggregation));
+        points.emplace_back(path.path, value, path.pre_aggregation, time_point);
+      }
+    }
+  }
+
+  /// Set when the owning thread exits, its values are taken once more.
+  std::atomic<bool> exited{false};
+
+ private:
+  std::array<std::atomic<MetricBlock*>, kMaxMetricBlocks> blocks_{};
+};
+
+/// Every thread that recorded into a metric.
+class MetricThreads final {
+ public:
+  static MetricThreads& get() {
+    static MetricThreads instance;
+    return instance;
+  }
+
+  ThreadMetrics& current() {
+    thread_local ThreadMetricsHolder holder;
+    if (holder.metrics == nullptr) {
+      holder.metrics = std::make_shared<ThreadMetrics>();
+      std::lock_guard<std::mutex> lock(mutex_);
+      threads_.push_back(holder.metrics);
+    }
+    return *holder.metrics;
+  }
+
+  std::vector<Point> take() {
+    auto paths = MetricPaths::get().copy();
+    auto time_point = Clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Point> points;
+    for (auto it = threads_.begin(); it != threads_.end();) {
+      auto exited = (*it)->exited.load(std::memory_order_acquire);
+      (*it)->take(paths, time_point, points);
+      it = exited ? threads_.erase(it) : it + 1;
+    }
+    return points;
+  }
+
+ private:
+  struct ThreadMetricsHolder {
+    ~ThreadMetricsHolder() {
+      if (metrics != nullptr) {
+        metrics->exited.store(true, std::memory_order_release);
+      }
+    }
+
+    std::shared_ptr<ThreadMetrics> metrics;
+  };
+
+  std::vector<std::shared_ptr<ThreadMetrics>> threads_;
+  std::mutex mutex_;
+};
+
 class FlusherIsScheduled {};
 FlusherIsScheduled schedule();
 
@@ -119,7 +325,7 @@ class PreAggregationBuffer final {
               const bool sync,
               const TimePoint& time_point) {
     if (0 == FLAGS_numeric_monitoring_pre_aggregation_time || sync) {
-      dispatchOne(path, value, pre_aggregation, sync, time_point);
+      dispatchOne(Point(path, value, pre_aggregation, time_point), sync);
     } else {
       std::lock_guard<std::mutex> lock(mutex_);
       cache_.addPoint(Point(path, value, pre_aggregation, time_point));
@@ -129,34 +335,36 @@ class PreAggregationBuffer final {
   void flush() {
     auto points = takeCachedPoints();
     for (const auto& pt : points) {
-      dispatchOne(
-          pt.path_, pt.value_, pt.pre_aggregation_type_, false, pt.time_point_);
+      dispatchOne(pt, false);
     }
   }
 
  private:
   std::vector<Point> takeCachedPoints() {
+    auto metric_points = MetricThreads::get().take();
     std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& point : metric_points) {
+      cache_.addPoint(std::move(point));
+    }
     auto points = cache_.takePoints();
     return points;
   }
 
-  void dispatchOne(const std::string& path,
-                   const ValueType& value,
-                   const PreAggregationType& pre_aggregation,
-                   const bool sync,
-                   const TimePoint& time_point) {
-    auto status = Registry::call(
-        registryName(),
-        FLAGS_numeric_monitoring_plugins,
-        {
-            {recordKeys().path, path},
-            {recordKeys().value, std::to_string(value)},
-            {recordKeys().pre_aggregation, to<std::string>(pre_aggregation)},
-            {recordKeys().timestamp,
-             std::to_string(time_point.time_since_epoch().count())},
-            {recordKeys().sync, sync ? "true" : "false"},
-        });
+  void dispatchOne(const Point& point, const bool sync) {
+    PluginRequest request = {
+        {recordKeys().path, point.path_},
+        {recordKeys().value, std::to_string(point.value_)},
+        {recordKeys().pre_aggregation,
+         to<std::string>(point.pre_aggregation_type_)},
+        {recordKeys().timestamp,
+         std::to_string(point.time_point_.time_since_epoch().count())},
+        {recordKeys().sync, sync ? "true" : "false"},
+    };
+    if (point.histogram_ != nullptr) {
+      request[recordKeys().histogram] = point.histogram_->serialize();
+    }
+    auto status =
+        Registry::call(registryName(), FLAGS_numeric_monitoring_plugins, request);
     if (!status.ok()) {
       LOG(ERROR) << "Data loss. Numeric monitoring point dispatch failed: "
                  << status.what();
@@ -168,18 +376,22 @@ class PreAggregationBuffer final {
   std::mutex mutex_;
 };
 
-class PreAggregationFlusher : public InternalRunnable {
+class PreAggregationFlusher : public PeriodicRunnable {
  public:
   explicit PreAggregationFlusher()
-      : InternalRunnable("numeric_monitoring_pre_aggregation_buffer_flusher") {}
+      : PeriodicRunnable("numeric_monitoring_pre_aggregation_buffer_flusher") {}
 
-  void start() override {
-    while (!interrupted() &&
-           0 != FLAGS_numeric_monitoring_pre_aggregation_time) {
-      pause(
-          std::chrono::seconds(FLAGS_numeric_monitoring_pre_aggregation_time));
-      PreAggregationBuffer::get().flush();
+ protected:
+  std::chrono::milliseconds tick() override {
+    if (0 == FLAGS_numeric_monitoring_pre_aggregation_time) {
+      return kDone;
     }
+    PreAggregationBuffer::get().flush();
+    return firstDelay();
+  }
+
+  std::chrono::milliseconds firstDelay() override {
+    return std::chrono::seconds(FLAGS_numeric_monitoring_pre_aggregation_time);
   }
 };
 
@@ -206,5 +418,40 @@ void record(const std::string& path,
       path, value, pre_aggregation, sync, std::move(time_point));
 }
 
+Metric Metric::get(const std::string& path,
+                   PreAggregationType pre_aggregation) {
+  // Records are collected by the pre-aggregation buffer's flusher.
+  PreAggregationBuffer::get();
+
+  auto id = MetricPaths::get().add(path, pre_aggregation);
+  if (id == kInvalidId) {
+    LOG(ERROR) << "Too many numeric monitoring metrics to register "
+               << boost::io::quoted(path);
+    return Metric();
+  }
+  return Metric(id, pre_aggregation);
+}
+
+void Metric::record(ValueType value) const {
+  if (!FLAGS_enable_numeric_monitoring || !valid()) {
+    return;
+  }
+
+  switch (pre_aggregation_) {
+  case PreAggregationType::Sum:
+  case PreAggregationType::Min:
+  case PreAggregationType::Max:
+    if (FLAGS_numeric_monitoring_pre_aggregation_time != 0) {
+      MetricThreads::get().current().record(id_, pre_aggregation_, value);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+
+  monitoring::record(MetricPaths::get().at(id_).path, value, pre_aggregation_);
+}
+
 } // namespace monitoring
 } // namespace osquery
@@ -25,6 +25,7 @@ struct RecordKeys {
   std::string timestamp;
   std::string pre_aggregation;
   std::string sync;
+  std::string histogram;
 };
 
 struct HostIdentifierKeys {
@@ -57,6 +58,7 @@ enum class PreAggregationType {
   P50, // Estimates 50th percentile
   P95, // Estimates 95th percentile
   P99, // Estimates 99th percentile
+  Histogram, // Records the distribution, @see Histogram
   // not existing PreAggregationType, upper limit definition
   InvalidTypeUpperLimit,
 };
@@ -89,6 +91,50 @@ void record(const std::string& path,
             const bool sync = false,
             TimePoint time_point = Clock::now());
 
+/**
+ * @brief A numeric monitoring path registered once, for frequent records.
+ *
+ * Recording into a Metric does not build the path or take a lock. Sum, Min
+ * and Max values are pre-aggregated in counters owned by the recording
+ * thread, and collected when the pre-aggregation buffer is flushed. Other
+ * pre-aggregation types are passed to record.
+ *
+ * Registered paths are kept for the life of the process, only register paths
+ * from a bounded set such as the scheduled query names.
+ *
+ * @code{.cpp}
+ * static const auto metric = monitoring::Metric::get(
+ *     "watched.parameter.path", monitoring::PreAggregationType::Sum);
+ * metric.record(1);
+ * @endcode
+ */
+class Metric {
+ public:
+  /// A metric that records nothing.
+  Metric() = default;
+
+  /// Register a path, or find the metric already registered for it.
+  static Metric get(const std::string& path,
+                    PreAggregationType pre_aggregation);
+
+  /// Record a new point, at the time the buffer is flushed.
+  void record(ValueType value) const;
+
+  bool valid() const {
+    return id_ != kInvalidId;
+  }
+
+ private:
+  Metric(size_t id, PreAggregationType pre_aggregation)
+      : id_(id), pre_aggregation_(pre_aggregation) {}
+
+ private:
+  static constexpr size_t kInvalidId{static_cast<size_t>(-1)};
+
+  size_t id_{kInvalidId};
+  PreAggregationType pre_aggregation_{PreAggregationType::None};
+};
+
 /**
  * Force flush the pre-aggregation buffer.
  * Please use it, only when it's totally necessary.
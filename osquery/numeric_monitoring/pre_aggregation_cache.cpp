@@ -7,15 +7,169 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include <boost/io/detail/quoted_manip.hpp>
 
 #include "osquery/numeric_monitoring/pre_aggregation_cache.h"
 #include <osquery/logger/logger.h>
+#include <osquery/utils/json/json.h>
 
 namespace osquery {
 
 namespace monitoring {
 
+namespace {
+
+const double kGamma =
+    (1 + Histogram::kRelativeAccuracy) / (1 - Histogram::kRelativeAccuracy);
+const double kLogGamma = std::log(kGamma);
+
+int bucketIndex(ValueType value) {
+  return static_cast<int>(
+      std::ceil(std::log(static_cast<double>(value)) / kLogGamma));
+}
+
+double bucketValue(int index) {
+  return 2 * std::pow(kGamma, index) / (kGamma + 1);
+}
+
+double percentile(PreAggregationType type) {
+  switch (type) {
+  case PreAggregationType::P10:
+    return 0.10;
+  case PreAggregationType::P50:
+    return 0.50;
+  case PreAggregationType::P95:
+    return 0.95;
+  case PreAggregationType::P99:
+    return 0.99;
+  default:
+    return 0;
+  }
+}
+
+bool isDistribution(PreAggregationType type) {
+  return type == PreAggregationType::Histogram || percentile(type) > 0;
+}
+
+void addBuckets(JSON& doc,
+                const char* name,
+                const std::map<int, std::uint64_t>& buckets) {
+  auto obj = doc.getObject();
+  for (const auto& bucket : buckets) {
+    doc.add(std::to_string(bucket.first),
+            static_cast<unsigned long long>(bucket.second),
+            obj);
+  }
+  doc.add(name, obj);
+}
+
+} // namespace
+
+void Histogram::add(ValueType value, std::uint64_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (count_ == 0) {
+    min_ = max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  count_ += count;
+  sum_ += value * static_cast<ValueType>(count);
+  if (value > 0) {
+    positive_[bucketIndex(value)] += count;
+  } else if (value < 0) {
+    negative_[bucketIndex(-value)] += count;
+  } else {
+    zero_ += count;
+  }
+}
+
+void Histogram::merge(const Histogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  if (count_ == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  } else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  zero_ += other.zero_;
+  for (const auto& bucket : other.positive_) {
+    positive_[bucket.first] += bucket.second;
+  }
+  for (const auto& bucket : other.negative_) {
+    negative_[bucket.first] += bucket.second;
+  }
+}
+
+ValueType Histogram::quantile(double quantile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  quantile = std::max(0.0, std::min(1.0, quantile));
+  // The rank of the requested value, counting from the smallest.
+  auto rank = static_cast<std::uint64_t>(quantile * (count_ - 1));
+  if (rank == 0) {
+    return min_;
+  } else if (rank == count_ - 1) {
+    return max_;
+  }
+
+  double estimate = 0;
+  std::uint64_t seen = 0;
+  bool found = false;
+  // The most negative values are in the highest negative buckets.
+  for (auto it = negative_.rbegin(); it != negative_.rend(); ++it) {
+    seen += it->second;
+    if (seen > rank) {
+      estimate = -bucketValue(it->first);
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    seen += zero_;
+    found = seen > rank;
+  }
+  if (!found) {
+    for (const auto& bucket : positive_) {
+      seen += bucket.second;
+      if (seen > rank) {
+        estimate = bucketValue(bucket.first);
+        break;
+      }
+    }
+  }
+
+  auto value = static_cast<ValueType>(std::llround(estimate));
+  return std::max(min_, std::min(max_, value));
+}
+
+std::string Histogram::serialize() const {
+  auto doc = JSON::newObject();
+  doc.add("relative_accuracy", kRelativeAccuracy);
+  doc.add("count", static_cast<unsigned long long>(count_));
+  doc.add("sum", sum_);
+  doc.add("min", min_);
+  doc.add("max", max_);
+  doc.add("zero", static_cast<unsigned long long>(zero_));
+  addBuckets(doc, "positive", positive_);
+  addBuckets(doc, "negative", negative_);
+
+  std::string output;
+  doc.toString(output);
+  return output;
+}
+
 Point::Point(std::string path,
              ValueType value,
              PreAggregationType pre_aggregation_type,
@@ -23,7 +177,15 @@ Point::Point(std::string path,
     : path_(std::move(path)),
       value_(std::move(value)),
       pre_aggregation_type_(std::move(pre_aggregation_type)),
-      time_point_(std::move(time_point)) {}
+      time_point_(std::move(time_point)) {
+  if (isDistribution(pre_aggregation_type_)) {
+    histogram_ = std::make_shared<Histogram>();
+    histogram_->add(value_);
+    if (pre_aggregation_type_ == PreAggregationType::Histogram) {
+      value_ = 1;
+    }
+  }
+}
 
 bool Point::tryToAggregate(const Point& new_point) {
   if (path_ != new_point.path_) {
@@ -48,11 +210,26 @@ bool Point::tryToAggregate(const Point& new_point) {
   case PreAggregationType::None:
   case PreAggregationType::Avg:
   case PreAggregationType::Stddev:
+    return false;
   case PreAggregationType::P10:
   case PreAggregationType::P50:
   case PreAggregationType::P95:
   case PreAggregationType::P99:
-    return false;
+  case PreAggregationType::Histogram:
+    if (histogram_ == nullptr || new_point.histogram_ == nullptr) {
+      return false;
+    }
+    if (histogram_.use_count() > 1) {
+      // Points are copied around, do not change a shared distribution.
+      histogram_ = std::make_shared<Histogram>(*histogram_);
+    }
+    histogram_->merge(*new_point.histogram_);
+    if (pre_aggregation_type_ == PreAggregationType::Histogram) {
+      value_ = static_cast<ValueType>(histogram_->count());
+    } else {
+      value_ = histogram_->quantile(percentile(pre_aggregation_type_));
+    }
+    break;
   case PreAggregationType::Sum:
     value_ = value_ + new_point.value_;
     break;
@@ -72,14 +249,15 @@ bool Point::tryToAggregate(const Point& new_point) {
 }
 
 void PreAggregationCache::addPoint(Point point) {
-  auto previous_index = points_index_.find(point.path_);
+  auto key = std::make_pair(point.path_, point.pre_aggregation_type_);
+  auto previous_index = points_index_.find(key);
   if (previous_index == points_index_.end()) {
-    points_index_.emplace(point.path_, points_.size());
+    points_index_.emplace(std::move(key), points_.size());
     points_.push_back(std::move(point));
   } else {
     auto& previous = points_[previous_index->second];
     if (!previous.tryToAggregate(point)) {
-      points_index_[point.path_] = points_.size();
+      previous_index->second = points_.size();
       points_.push_back(std::move(point));
     }
   }
@@ -9,7 +9,12 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 
@@ -17,6 +22,40 @@ namespace osquery {
 
 namespace monitoring {
 
+/**
+ * Mergeable distribution of observed values.
+ * Values are counted in logarithmic buckets, so every estimated quantile is
+ * within kRelativeAccuracy of a value that was actually observed. Histograms
+ * of the same path merge exactly by adding bucket counts.
+ */
+class Histogram {
+ public:
+  static constexpr double kRelativeAccuracy = 0.01;
+
+  void add(ValueType value, std::uint64_t count = 1);
+
+  void merge(const Histogram& other);
+
+  /// Estimate the value at quantile q, within [0, 1].
+  ValueType quantile(double quantile) const;
+
+  std::uint64_t count() const noexcept {
+    return count_;
+  }
+
+  /// The histogram as a JSON document of counts per bucket index.
+  std::string serialize() const;
+
+ private:
+  std::map<int, std::uint64_t> positive_;
+  std::map<int, std::uint64_t> negative_;
+  std::uint64_t zero_{0};
+  std::uint64_t count_{0};
+  ValueType sum_{0};
+  ValueType min_{0};
+  ValueType max_{0};
+};
+
 /**
  * Monitoring system smallest unit
  * Consists of watched value itself, watching time, unique name for this set of
@@ -54,8 +93,16 @@ class Point {
   ValueType value_;
   PreAggregationType pre_aggregation_type_;
   TimePoint time_point_;
+
+  /// Observed values of percentile and histogram points, null otherwise.
+  std::shared_ptr<Histogram> histogram_;
 };
 
+/**
+ * Pre-aggregation cache
+ * Points with the same path and pre-aggregation type are aggregated into
+ * one point, a path may be recorded with several types.
+ */
 class PreAggregationCache {
  public:
   explicit PreAggregationCache() = default;
@@ -69,7 +116,16 @@ class PreAggregationCache {
   }
 
  private:
-  std::unordered_map<std::string, std::size_t> points_index_;
+  using PointKey = std::pair<std::string, PreAggregationType>;
+
+  struct PointKeyHash {
+    std::size_t operator()(const PointKey& key) const {
+      return std::hash<std::string>()(key.first) ^
+             static_cast<std::size_t>(key.second);
+    }
+  };
+
+  std::unordered_map<PointKey, std::size_t, PointKeyHash> points_index_;
   std::vector<Point> points_;
 };
 
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <boost/filesystem.hpp>
@@ -138,6 +141,66 @@ TEST_F(NumericMonitoringTests, record_with_buffer) {
   Dispatcher::joinServices();
 }
 
+TEST_F(NumericMonitoringTests, record_metric) {
+  const auto isEnabled = FLAGS_enable_numeric_monitoring;
+  const auto plugins = FLAGS_numeric_monitoring_plugins;
+  const auto pre_aggregation_time =
+      FLAGS_numeric_monitoring_pre_aggregation_time;
+
+  FLAGS_enable_numeric_monitoring = true;
+  FLAGS_numeric_monitoring_plugins = kNameForTestPlugin;
+  FLAGS_numeric_monitoring_pre_aggregation_time = 1;
+
+  auto status = RegistryFactory::get().setActive(
+      monitoring::registryName(), FLAGS_numeric_monitoring_plugins);
+  ASSERT_TRUE(status.ok());
+
+  monitoring::flush();
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+
+  const auto monitoring_path = "some.path.to.metric";
+  auto sum = monitoring::Metric::get(monitoring_path,
+                                     monitoring::PreAggregationType::Sum);
+  auto max = monitoring::Metric::get(monitoring_path,
+                                     monitoring::PreAggregationType::Max);
+  EXPECT_TRUE(sum.valid());
+
+  // Each thread records into its own counters, merged by the flush.
+  sum.record(1);
+  max.record(7);
+  std::thread thread([&sum, &max]() {
+    sum.record(2);
+    max.record(3);
+  });
+  thread.join();
+  // Paths recorded directly are aggregated with the metric.
+  monitoring::record(
+      monitoring_path, 4, monitoring::PreAggregationType::Sum, false);
+  monitoring::flush();
+
+  std::map<std::string, long long> values;
+  for (const auto& point : NumericMonitoringInMemoryTestPlugin::points) {
+    EXPECT_EQ(monitoring_path, point.at(monitoring::recordKeys().path));
+    values[point.at(monitoring::recordKeys().pre_aggregation)] =
+        std::stoll(point.at(monitoring::recordKeys().value));
+  }
+  EXPECT_EQ(2U, values.size());
+  EXPECT_EQ(7, values["sum"]);
+  EXPECT_EQ(7, values["max"]);
+
+  // Nothing is recorded until the metric is used again.
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+  monitoring::flush();
+  EXPECT_TRUE(NumericMonitoringInMemoryTestPlugin::points.empty());
+
+  FLAGS_enable_numeric_monitoring = isEnabled;
+  FLAGS_numeric_monitoring_plugins = plugins;
+  FLAGS_numeric_monitoring_pre_aggregation_time = pre_aggregation_time;
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
+
 TEST_F(NumericMonitoringTests, record_without_buffer) {
   const auto isEnabled = FLAGS_enable_numeric_monitoring;
   const auto plugins = FLAGS_numeric_monitoring_plugins;
@@ -31,11 +31,7 @@ GTEST_TEST(PreAggregationPoint, tryToUpdate_same_path_different_types) {
   const std::set<monitoring::PreAggregationType> nonaggregatable = {
       monitoring::PreAggregationType::None,
       monitoring::PreAggregationType::Avg,
-      monitoring::PreAggregationType::Stddev,
-      monitoring::PreAggregationType::P10,
-      monitoring::PreAggregationType::P50,
-      monitoring::PreAggregationType::P95,
-      monitoring::PreAggregationType::P99};
+      monitoring::PreAggregationType::Stddev};
   const auto now = monitoring::Clock::now();
   const auto path = "test.path.to.nowhere/paranoid";
   using UnderType = std::underlying_type<monitoring::PreAggregationType>::type;
@@ -111,6 +107,63 @@ GTEST_TEST(PreAggregationPoint, tryToUpdate_max) {
   EXPECT_EQ(42, prev_pt.value_);
 }
 
+GTEST_TEST(PreAggregationPoint, tryToUpdate_percentile) {
+  const auto now = monitoring::Clock::now();
+  const auto path = "test.path.to.nowhere";
+  auto p50 =
+      monitoring::Point(path, 1, monitoring::PreAggregationType::P50, now);
+  auto p99 =
+      monitoring::Point(path, 1, monitoring::PreAggregationType::P99, now);
+  for (auto value = 2; value <= 1000; ++value) {
+    ASSERT_TRUE(p50.tryToAggregate(monitoring::Point(
+        path, value, monitoring::PreAggregationType::P50, now)));
+    ASSERT_TRUE(p99.tryToAggregate(monitoring::Point(
+        path, value, monitoring::PreAggregationType::P99, now)));
+  }
+  EXPECT_NEAR(500, p50.value_, 500 * 0.02);
+  EXPECT_NEAR(990, p99.value_, 990 * 0.02);
+  ASSERT_NE(nullptr, p50.histogram_);
+  EXPECT_EQ(1000U, p50.histogram_->count());
+}
+
+GTEST_TEST(PreAggregationPoint, tryToUpdate_histogram) {
+  const auto now = monitoring::Clock::now();
+  const auto path = "test.path.to.nowhere";
+  auto prev_pt = monitoring::Point(
+      path, -7, monitoring::PreAggregationType::Histogram, now);
+  auto new_pt = monitoring::Point(
+      path, 0, monitoring::PreAggregationType::Histogram, now);
+  auto copy = new_pt;
+  ASSERT_TRUE(prev_pt.tryToAggregate(new_pt));
+  ASSERT_TRUE(prev_pt.tryToAggregate(monitoring::Point(
+      path, 12, monitoring::PreAggregationType::Histogram, now)));
+  // The value of a histogram point is the number of observed values.
+  EXPECT_EQ(3, prev_pt.value_);
+  EXPECT_EQ(-7, prev_pt.histogram_->quantile(0));
+  EXPECT_EQ(0, prev_pt.histogram_->quantile(0.5));
+  EXPECT_EQ(12, prev_pt.histogram_->quantile(1));
+
+  // Aggregating into a copied point leaves the original distribution alone.
+  ASSERT_TRUE(copy.tryToAggregate(prev_pt));
+  EXPECT_EQ(4, copy.value_);
+  EXPECT_EQ(1U, new_pt.histogram_->count());
+}
+
+GTEST_TEST(PreAggregationHistogram, merge) {
+  auto first = monitoring::Histogram{};
+  auto second = monitoring::Histogram{};
+  for (auto value = 1; value <= 100; ++value) {
+    first.add(value);
+    second.add(value * 100);
+  }
+  first.merge(second);
+  EXPECT_EQ(200U, first.count());
+  EXPECT_EQ(1, first.quantile(0));
+  EXPECT_EQ(10000, first.quantile(1));
+  EXPECT_NEAR(5000, first.quantile(0.75), 5000 * 0.02);
+  EXPECT_EQ(0, monitoring::Histogram{}.quantile(0.5));
+}
+
 GTEST_TEST(PreAggregationCache, life_cycle) {
   const auto now = monitoring::Clock::now();
   auto cache = monitoring::PreAggregationCache{};
@@ -208,4 +261,27 @@ GTEST_TEST(PreAggregationCache, life_cycle) {
   EXPECT_EQ(1, counters[max_path]);
 }
 
+GTEST_TEST(PreAggregationCache, same_path_different_types) {
+  const auto now = monitoring::Clock::now();
+  auto cache = monitoring::PreAggregationCache{};
+  const auto path = "test.path.to.nowhere";
+  cache.addPoint(
+      monitoring::Point(path, 3, monitoring::PreAggregationType::Min, now));
+  cache.addPoint(
+      monitoring::Point(path, 3, monitoring::PreAggregationType::Sum, now));
+  cache.addPoint(
+      monitoring::Point(path, 1, monitoring::PreAggregationType::Min, now));
+  cache.addPoint(
+      monitoring::Point(path, 1, monitoring::PreAggregationType::Sum, now));
+  ASSERT_EQ(2, cache.size());
+
+  for (const auto& p : cache.takePoints()) {
+    if (p.pre_aggregation_type_ == monitoring::PreAggregationType::Sum) {
+      EXPECT_EQ(4, p.value_);
+    } else {
+      EXPECT_EQ(1, p.value_);
+    }
+  }
+}
+
 } // namespace osquery
@@ -16,16 +16,42 @@
 
 namespace osquery {
 
+/**
+ * @brief The numeric monitoring metrics of a set of profiled names.
+ *
+ * Build this once for names that are profiled repeatedly, such as those of a
+ * scheduled query. Each profile then records into registered metrics instead
+ * of building every path.
+ */
+class CodeProfilerMetrics final {
+ public:
+  explicit CodeProfilerMetrics(const std::vector<std::string>& names);
+
+  ~CodeProfilerMetrics();
+
+ private:
+  class Metrics;
+
+  const std::unique_ptr<Metrics> metrics_;
+
+ private:
+  friend class CodeProfiler;
+};
+
 class CodeProfiler final {
  public:
   CodeProfiler(const std::initializer_list<std::string>& names);
 
+  /// Profile into metrics, which must outlive the profiler.
+  explicit CodeProfiler(const CodeProfilerMetrics& metrics);
+
   ~CodeProfiler();
 
  private:
   class CodeProfilerData;
 
   const std::vector<std::string> names_;
+  const CodeProfilerMetrics* metrics_{nullptr};
   const std::unique_ptr<CodeProfilerData> code_profiler_data_;
 };
 
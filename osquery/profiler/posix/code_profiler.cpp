@@ -14,9 +14,11 @@
 #endif
 #endif
 
+#include <array>
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <utility>
 
 #include <sys/resource.h>
 #include <sys/time.h>
@@ -31,18 +33,39 @@
 namespace osquery {
 namespace {
 
-void record(const std::vector<std::string>& names,
-            const std::string& metricName,
-            monitoring::ValueType measurement) {
-  for (const std::string& name : names) {
-    const std::string entity = name + "." + metricName;
-    monitoring::record(
-        entity, measurement, monitoring::PreAggregationType::Min, true);
-
-    monitoring::record(
-        entity, measurement, monitoring::PreAggregationType::Sum, true);
-  }
-}
+/// The measurements of a profile, recorded for each name.
+enum ProfilerStat : size_t {
+  kRssMax,
+  kRssIncrease,
+  kInputLoad,
+  kOutputLoad,
+  kTimeUser,
+  kTimeSystem,
+  kTimeTotal,
+  kTimeWall,
+  kProfilerStatCount,
+};
+
+const std::array<const char*, kProfilerStatCount> kProfilerStatNames = {
+    "rss.max.kb",
+    "rss.increase.kb",
+    "input.load",
+    "output.load",
+    "time.user.millis",
+    "time.system.millis",
+    "time.total.millis",
+    "time.wall.millis",
+};
+
+/// Each stat is recorded with these pre-aggregations.
+const std::array<monitoring::PreAggregationType, 2> kProfilerAggregations = {
+    monitoring::PreAggregationType::Min,
+    monitoring::PreAggregationType::Sum,
+};
+
+/// The measured value of each stat, if it was measured.
+using ProfilerStats =
+    std::array<std::pair<bool, monitoring::ValueType>, kProfilerStatCount>;
 
 int getRusageWho() {
   return
@@ -68,18 +91,18 @@ static Expected<struct rusage, RusageError> callRusage() {
   }
 }
 
-void recordRusageStatDifference(const std::vector<std::string>& names,
-                                const std::string& stat_name,
-                                int64_t start_stat,
-                                int64_t end_stat) {
+void setStatDifference(ProfilerStats& stats,
+                       ProfilerStat stat,
+                       int64_t start_stat,
+                       int64_t end_stat) {
   if (end_stat == 0) {
-    TLOG << "rusage field " << boost::io::quoted(stat_name)
+    TLOG << "rusage field " << boost::io::quoted(kProfilerStatNames[stat])
          << " is not supported";
   } else if (start_stat <= end_stat) {
-    record(names, stat_name, end_stat - start_stat);
+    stats[stat] = std::make_pair(true, end_stat - start_stat);
   } else {
     LOG(WARNING) << "Possible overflow detected in rusage field: "
-                 << boost::io::quoted(stat_name);
+                 << boost::io::quoted(kProfilerStatNames[stat]);
   }
 }
 
@@ -90,42 +113,94 @@ int64_t covertToMilliseconds(const struct timeval& timepoint) {
       .count();
 }
 
-void recordRusageStatDifference(const std::vector<std::string>& names,
-                                const std::string& stat_name,
-                                const struct timeval& start_stat,
-                                const struct timeval& end_stat) {
-  recordRusageStatDifference(names,
-                             stat_name + ".millis",
-                             covertToMilliseconds(start_stat),
-                             covertToMilliseconds(end_stat));
+void setStatDifference(ProfilerStats& stats,
+                       ProfilerStat stat,
+                       const struct timeval& start_stat,
+                       const struct timeval& end_stat) {
+  setStatDifference(stats,
+                    stat,
+                    covertToMilliseconds(start_stat),
+                    covertToMilliseconds(end_stat));
 }
 
-void recordRusageStatDifference(const std::vector<std::string>& names,
-                                const struct rusage& start_stats,
-                                const struct rusage& end_stats) {
-  recordRusageStatDifference(names, "rss.max.kb", 0, end_stats.ru_maxrss);
+void setRusageStatDifference(ProfilerStats& stats,
+                             const struct rusage& start_stats,
+                             const struct rusage& end_stats) {
+  setStatDifference(stats, kRssMax, 0, end_stats.ru_maxrss);
 
-  recordRusageStatDifference(
-      names, "rss.increase.kb", start_stats.ru_maxrss, end_stats.ru_maxrss);
+  setStatDifference(
+      stats, kRssIncrease, start_stats.ru_maxrss, end_stats.ru_maxrss);
 
-  recordRusageStatDifference(
-      names, "input.load", start_stats.ru_inblock, end_stats.ru_inblock);
+  setStatDifference(
+      stats, kInputLoad, start_stats.ru_inblock, end_stats.ru_inblock);
 
-  recordRusageStatDifference(
-      names, "output.load", start_stats.ru_oublock, end_stats.ru_oublock);
+  setStatDifference(
+      stats, kOutputLoad, start_stats.ru_oublock, end_stats.ru_oublock);
 
-  recordRusageStatDifference(
-      names, "time.user", start_stats.ru_utime, end_stats.ru_utime);
+  setStatDifference(stats, kTimeUser, start_stats.ru_utime, end_stats.ru_utime);
 
-  recordRusageStatDifference(
-      names, "time.system", start_stats.ru_stime, end_stats.ru_stime);
+  setStatDifference(
+      stats, kTimeSystem, start_stats.ru_stime, end_stats.ru_stime);
 
-  recordRusageStatDifference(names,
-                             "time.total.millis",
-                             covertToMilliseconds(start_stats.ru_utime) +
-                                 covertToMilliseconds(start_stats.ru_stime),
-                             covertToMilliseconds(end_stats.ru_utime) +
-                                 covertToMilliseconds(end_stats.ru_stime));
+  setStatDifference(stats,
+                    kTimeTotal,
+                    covertToMilliseconds(start_stats.ru_utime) +
+                        covertToMilliseconds(start_stats.ru_stime),
+                    covertToMilliseconds(end_stats.ru_utime) +
+                        covertToMilliseconds(end_stats.ru_stime));
+}
+
+} // namespace
+
+class CodeProfilerMetrics::Metrics {
+ public:
+  explicit Metrics(const std::vector<std::string>& names) {
+    for (size_t stat = 0; stat < kProfilerStatCount; ++stat) {
+      for (const auto& name : names) {
+        const std::string entity = name + "." + kProfilerStatNames[stat];
+        for (auto pre_aggregation : kProfilerAggregations) {
+          metrics_[stat].push_back(
+              monitoring::Metric::get(entity, pre_aggregation));
+        }
+      }
+    }
+  }
+
+  void record(const ProfilerStats& stats) const {
+    for (size_t stat = 0; stat < kProfilerStatCount; ++stat) {
+      if (stats[stat].first) {
+        for (const auto& metric : metrics_[stat]) {
+          metric.record(stats[stat].second);
+        }
+      }
+    }
+  }
+
+ private:
+  std::array<std::vector<monitoring::Metric>, kProfilerStatCount> metrics_;
+};
+
+CodeProfilerMetrics::CodeProfilerMetrics(const std::vector<std::string>& names)
+    : metrics_(std::make_unique<Metrics>(names)) {}
+
+CodeProfilerMetrics::~CodeProfilerMetrics() = default;
+
+namespace {
+
+void record(const std::vector<std::string>& names,
+            const ProfilerStats& stats) {
+  for (size_t stat = 0; stat < kProfilerStatCount; ++stat) {
+    if (!stats[stat].first) {
+      continue;
+    }
+
+    for (const std::string& name : names) {
+      const std::string entity = name + "." + kProfilerStatNames[stat];
+      for (auto pre_aggregation : kProfilerAggregations) {
+        monitoring::record(entity, stats[stat].second, pre_aggregation, true);
+      }
+    }
+  }
 }
 
 } // namespace
@@ -151,6 +226,9 @@ class CodeProfiler::CodeProfilerData {
 CodeProfiler::CodeProfiler(const std::initializer_list<std::string>& names)
     : names_(names), code_profiler_data_(new CodeProfilerData()) {}
 
+CodeProfiler::CodeProfiler(const CodeProfilerMetrics& metrics)
+    : metrics_(&metrics), code_profiler_data_(new CodeProfilerData()) {}
+
 CodeProfiler::~CodeProfiler() {
   CodeProfilerData code_profiler_data_end;
 
@@ -158,19 +236,27 @@ CodeProfiler::~CodeProfiler() {
   if (!rusage_start) {
     LOG(ERROR) << "rusage_start error: "
                << rusage_start.getError().getMessage();
+    return;
+  }
+
+  ProfilerStats stats{};
+  auto rusage_end = code_profiler_data_end.takeRusageData();
+  if (!rusage_end) {
+    LOG(ERROR) << "rusage_end error: " << rusage_end.getError().getMessage();
   } else {
-    auto rusage_end = code_profiler_data_end.takeRusageData();
-    if (!rusage_end) {
-      LOG(ERROR) << "rusage_end error: " << rusage_end.getError().getMessage();
-    } else {
-      recordRusageStatDifference(names_, *rusage_start, *rusage_end);
-    }
+    setRusageStatDifference(stats, *rusage_start, *rusage_end);
+  }
 
-    const auto query_duration =
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            code_profiler_data_end.getWallTime() -
-            code_profiler_data_->getWallTime());
-    record(names_, "time.wall.millis", query_duration.count());
+  const auto query_duration =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          code_profiler_data_end.getWallTime() -
+          code_profiler_data_->getWallTime());
+  stats[kTimeWall] = std::make_pair(true, query_duration.count());
+
+  if (metrics_ != nullptr) {
+    metrics_->metrics_->record(stats);
+  } else {
+    record(names_, stats);
   }
 }
 
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#ifdef __linux__
+// Needed for linux specific RUSAGE_THREAD, before including anything else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include <osquery/profiler/query_resource_meter.h>
+
+namespace osquery {
+namespace {
+
+uint64_t toMilliseconds(const struct timeval& tv) {
+  return static_cast<uint64_t>(tv.tv_sec) * 1000 +
+         static_cast<uint64_t>(tv.tv_usec) / 1000;
+}
+
+#ifdef __APPLE__
+void sampleCpuTime(QueryResourceUsage& usage) {
+  auto thread = mach_thread_self();
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  if (thread_info(thread,
+                  THREAD_BASIC_INFO,
+                  reinterpret_cast<thread_info_t>(&info),
+                  &count) == KERN_SUCCESS) {
+    usage.user_time = static_cast<uint64_t>(info.user_time.seconds) * 1000 +
+                      info.user_time.microseconds / 1000;
+    usage.system_time =
+        static_cast<uint64_t>(info.system_time.seconds) * 1000 +
+        info.system_time.microseconds / 1000;
+  }
+  mach_port_deallocate(mach_task_self(), thread);
+}
+
+void sampleResidentSize(QueryResourceUsage& usage) {
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+                MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info),
+                &count) == KERN_SUCCESS) {
+    usage.resident_size = info.resident_size;
+  }
+}
+#else
+void sampleCpuTime(QueryResourceUsage& usage) {
+  struct rusage stats;
+#ifdef __linux__
+  auto who = RUSAGE_THREAD;
+#else
+  auto who = RUSAGE_SELF;
+#endif
+  if (getrusage(who, &stats) == 0) {
+    usage.user_time = toMilliseconds(stats.ru_utime);
+    usage.system_time = toMilliseconds(stats.ru_stime);
+  }
+}
+
+void sampleResidentSize(QueryResourceUsage& usage) {
+#ifdef __linux__
+  // The second field of statm is the resident set size in pages.
+  auto fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  char buffer[128];
+  auto size = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (size <= 0) {
+    return;
+  }
+  buffer[size] = '\0';
+
+  char* end = nullptr;
+  std::strtoull(buffer, &end, 10);
+  auto pages = std::strtoull(end, nullptr, 10);
+  usage.resident_size = pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+  struct rusage stats;
+  if (getrusage(RUSAGE_SELF, &stats) == 0) {
+    // Only the peak resident size is available, in kilobytes.
+    usage.resident_size = static_cast<uint64_t>(stats.ru_maxrss) * 1024;
+  }
+#endif
+}
+#endif
+
+} // namespace
+
+QueryResourceUsage QueryResourceMeter::sample() {
+  QueryResourceUsage usage;
+  sampleCpuTime(usage);
+  sampleResidentSize(usage);
+  return usage;
+}
+
+} // namespace osquery
@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/core/sql/query_performance.h>
+
+namespace osquery {
+
+/**
+ * @brief Measure the resources used by a query on the calling thread.
+ *
+ * CPU times are read for the calling thread where the platform allows it, so
+ * queries executing concurrently on other threads are not accounted for. The
+ * resident size is sampled for the whole process.
+ */
+class QueryResourceMeter final {
+ public:
+  /// Take the starting sample.
+  QueryResourceMeter() : start_(sample()) {}
+
+  /// The sample taken at construction.
+  const QueryResourceUsage& start() const {
+    return start_;
+  }
+
+  /// Take a sample of the current resource usage.
+  static QueryResourceUsage sample();
+
+ private:
+  const QueryResourceUsage start_;
+};
+
+} // namespace osquery
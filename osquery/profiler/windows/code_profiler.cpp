@@ -28,6 +28,30 @@ void record(const std::vector<std::string>& names,
 }
 } // namespace
 
+class CodeProfilerMetrics::Metrics {
+ public:
+  explicit Metrics(const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+      paths_.push_back(name + "." + ".time.wall.millis");
+    }
+  }
+
+  void record(monitoring::ValueType measurement) const {
+    for (const auto& path : paths_) {
+      monitoring::record(
+          path, measurement, monitoring::PreAggregationType::None);
+    }
+  }
+
+ private:
+  std::vector<std::string> paths_;
+};
+
+CodeProfilerMetrics::CodeProfilerMetrics(const std::vector<std::string>& names)
+    : metrics_(std::make_unique<Metrics>(names)) {}
+
+CodeProfilerMetrics::~CodeProfilerMetrics() = default;
+
 class CodeProfiler::CodeProfilerData {
  public:
   CodeProfilerData() : wall_time_(std::chrono::steady_clock::now()) {}
@@ -43,6 +67,9 @@ class CodeProfiler::CodeProfilerData {
 CodeProfiler::CodeProfiler(const std::initializer_list<std::string>& names)
     : names_(names), code_profiler_data_(new CodeProfilerData()) {}
 
+CodeProfiler::CodeProfiler(const CodeProfilerMetrics& metrics)
+    : metrics_(&metrics), code_profiler_data_(new CodeProfilerData()) {}
+
 CodeProfiler::~CodeProfiler() {
   CodeProfilerData code_profiler_data_end;
 
@@ -51,6 +78,10 @@ CodeProfiler::~CodeProfiler() {
           code_profiler_data_end.getWallTime() -
           code_profiler_data_->getWallTime());
 
-  record(names_, ".time.wall.millis", query_duration.count());
+  if (metrics_ != nullptr) {
+    metrics_->metrics_->record(query_duration.count());
+  } else {
+    record(names_, ".time.wall.millis", query_duration.count());
+  }
 }
 } // namespace osquery
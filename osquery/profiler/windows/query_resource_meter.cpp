@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/utils/system/system.h>
+
+#include <psapi.h>
+
+#include <osquery/profiler/query_resource_meter.h>
+
+namespace osquery {
+namespace {
+
+/// FILETIME values are in 100 nanosecond units.
+uint64_t toMilliseconds(const FILETIME& ft) {
+  ULARGE_INTEGER value;
+  value.LowPart = ft.dwLowDateTime;
+  value.HighPart = ft.dwHighDateTime;
+  return value.QuadPart / 10000;
+}
+
+} // namespace
+
+QueryResourceUsage QueryResourceMeter::sample() {
+  QueryResourceUsage usage;
+
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (GetThreadTimes(GetCurrentThread(),
+                     &creation_time,
+                     &exit_time,
+                     &kernel_time,
+                     &user_time)) {
+    usage.user_time = toMilliseconds(user_time);
+    usage.system_time = toMilliseconds(kernel_time);
+  }
+
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(
+          GetCurrentProcess(), &counters, sizeof(counters))) {
+    usage.resident_size = counters.WorkingSetSize;
+  }
+
+  return usage;
+}
+
+} // namespace osquery
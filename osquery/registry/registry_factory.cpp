@@ -34,6 +34,7 @@ void RegistryFactory::add(const std::string& name, RegistryInterfaceRef reg) {
     throw std::runtime_error("Cannot add duplicate registry: " + name);
   }
   registries_[name] = std::move(reg);
+  invalidateHandles();
 }
 
 RegistryInterfaceRef RegistryFactory::registry(const std::string& t) const {
@@ -9,9 +9,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
 
@@ -160,7 +163,17 @@ class RegistryFactory : private boost::noncopyable {
     return external_;
   }
 
+  /// Incremented when registry items, routes or active plugins change.
+  uint64_t generation() const {
+    return generation_;
+  }
+
  private:
+  /// Invalidate every PluginHandle, they resolve their items again.
+  void invalidateHandles() {
+    generation_++;
+  }
+
   /// Check if the registries are locked.
   bool locked() {
     return locked_;
@@ -202,10 +215,107 @@ class RegistryFactory : private boost::noncopyable {
   /// Protector for broadcast lookups and external registry mutations.
   mutable Mutex mutex_;
 
+  /// See generation(), compared by each PluginHandle.
+  std::atomic<uint64_t> generation_{0};
+
  private:
   friend class RegistryInterface;
 };
 
+/**
+ * @brief A registry item resolved once and reused until the registry changes.
+ *
+ * Looking up a plugin by name takes the registry locks, searches its maps and
+ * casts the plugin on every call. Callers on hot paths, such as table scans,
+ * database calls and logger dispatch, keep a handle instead. The handle
+ * resolves its item again only after the registry generation changes, when
+ * a plugin, extension route or active plugin is added or removed.
+ */
+template <class PluginType>
+class PluginHandle : private boost::noncopyable {
+ public:
+  using PluginTypeRef = std::shared_ptr<PluginType>;
+
+  /// A resolved item, a multiplexed active plugin resolves to several.
+  struct Item {
+    std::string name;
+
+    /// The typed plugin, nullptr if it is not local, such as an extension's.
+    PluginTypeRef plugin;
+  };
+
+  using Items = std::vector<Item>;
+
+  /**
+   * @param registry_name The registry containing the item.
+   * @param item_name The item, or empty for the registry's active plugin.
+   */
+  explicit PluginHandle(std::string registry_name, std::string item_name = "")
+      : registry_name_(std::move(registry_name)),
+        item_name_(std::move(item_name)) {}
+
+  /// The resolved items, empty if the registry or its active plugin is not set.
+  std::shared_ptr<const Items> items() const {
+    auto resolved = std::atomic_load(&resolved_);
+    auto generation = RegistryFactory::get().generation();
+    if (resolved == nullptr || resolved->generation != generation) {
+      resolved = resolve(generation);
+      std::atomic_store(&resolved_, resolved);
+    }
+    return std::shared_ptr<const Items>(resolved, &resolved->items);
+  }
+
+  /// The local plugin, nullptr if it is unknown, external or multiplexed.
+  PluginTypeRef get() const {
+    auto resolved = items();
+    return (resolved->size() == 1) ? resolved->front().plugin : nullptr;
+  }
+
+ private:
+  struct Resolved {
+    uint64_t generation{0};
+    Items items;
+  };
+
+  std::shared_ptr<const Resolved> resolve(uint64_t generation) const {
+    // The generation is read first, a change while resolving is seen later.
+    auto resolved = std::make_shared<Resolved>();
+    resolved->generation = generation;
+
+    auto& registry = RegistryFactory::get();
+    if (!registry.exists(registry_name_)) {
+      return resolved;
+    }
+
+    auto names = item_name_.empty() ? registry.getActive(registry_name_)
+                                    : item_name_;
+    size_t start = 0;
+    while (start < names.size()) {
+      auto end = names.find(',', start);
+      if (end == std::string::npos) {
+        end = names.size();
+      }
+
+      Item item;
+      item.name = names.substr(start, end - start);
+      if (registry.exists(registry_name_, item.name, true)) {
+        item.plugin = std::dynamic_pointer_cast<PluginType>(
+            registry.plugin(registry_name_, item.name));
+      }
+      resolved->items.push_back(std::move(item));
+      start = end + 1;
+    }
+    return resolved;
+  }
+
+ private:
+  std::string registry_name_;
+  std::string item_name_;
+
+  /// Accessed with the std::atomic_load and std::atomic_store overloads.
+  mutable std::shared_ptr<const Resolved> resolved_;
+};
+
 /**
  * @brief The osquery Registry, refer to RegistryFactory for the caller API.
  *
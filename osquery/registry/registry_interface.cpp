@@ -30,6 +30,7 @@ void RegistryInterface::removeUnsafe(const std::string& item_name) {
   for (const auto& alias : removed_aliases) {
     aliases_.erase(alias);
   }
+  RegistryFactory::get().invalidateHandles();
 }
 
 void RegistryInterface::remove(const std::string& item_name) {
@@ -82,6 +83,7 @@ Status RegistryInterface::setActive(const std::string& item_name) {
     WriteUpgradeLock wlock(lock);
     active_ = item_name;
   }
+  RegistryFactory::get().invalidateHandles();
 
   // The active plugin is setup when initialized.
   for (const auto& item : osquery::split(item_name, ",")) {
@@ -177,6 +179,7 @@ Status RegistryInterface::addAlias(const std::string& item_name,
     return Status::failure("Duplicate alias: " + alias);
   }
   aliases_[alias] = item_name;
+  RegistryFactory::get().invalidateHandles();
   return Status::success();
 }
 
@@ -205,6 +208,7 @@ Status RegistryInterface::addPlugin(const std::string& plugin_name,
   if (internal) {
     internal_.push_back(plugin_name);
   }
+  RegistryFactory::get().invalidateHandles();
 
   return Status::success();
 }
@@ -269,9 +273,11 @@ Status RegistryInterface::addExternal(const RouteUUID& uuid,
       WriteLock wlock(mutex_);
       external_[route.first] = uuid;
     } else {
+      RegistryFactory::get().invalidateHandles();
       return status;
     }
   }
+  RegistryFactory::get().invalidateHandles();
 
   return Status::success();
 }
@@ -302,6 +308,7 @@ void RegistryInterface::removeExternal(const RouteUUID& uuid) {
       routes_.erase(item);
     }
   }
+  RegistryFactory::get().invalidateHandles();
 }
 
 /// Facility method to check if a registry item exists.
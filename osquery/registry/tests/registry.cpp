@@ -235,6 +235,42 @@ TEST_F(RegistryTests, test_registry_api) {
   EXPECT_EQ(response[0].at("secret_power"), "magic");
 }
 
+TEST_F(RegistryTests, test_plugin_handle) {
+  TestCoreRegistry::get().add(
+      "handles", std::make_shared<RegistryType<CatPlugin>>("handles"));
+  auto handles = TestCoreRegistry::get().registry("handles");
+  ASSERT_TRUE(handles->add("tabby", std::make_shared<HouseCat>()).ok());
+  ASSERT_TRUE(handles->add("calico", std::make_shared<HouseCat>()).ok());
+
+  PluginHandle<CatPlugin> tabby("handles", "tabby");
+  auto plugin = tabby.get();
+  ASSERT_NE(plugin, nullptr);
+  EXPECT_EQ(plugin, TestCoreRegistry::get().plugin("handles", "tabby"));
+  EXPECT_EQ(tabby.get(), plugin);
+
+  // The active handle follows the registry's active plugins.
+  PluginHandle<CatPlugin> active("handles");
+  EXPECT_TRUE(active.items()->empty());
+  ASSERT_TRUE(TestCoreRegistry::get().setActive("handles", "tabby,calico"));
+  auto items = active.items();
+  ASSERT_EQ(items->size(), 2U);
+  EXPECT_EQ(items->at(0).name, "tabby");
+  EXPECT_EQ(items->at(0).plugin, plugin);
+  EXPECT_EQ(items->at(1).name, "calico");
+  EXPECT_EQ(active.get(), nullptr);
+
+  // Removed and replaced items are resolved again.
+  handles->remove("tabby");
+  EXPECT_EQ(tabby.get(), nullptr);
+  ASSERT_TRUE(handles->add("tabby", std::make_shared<HouseCat>()).ok());
+  ASSERT_NE(tabby.get(), nullptr);
+  EXPECT_NE(tabby.get(), plugin);
+
+  PluginHandle<CatPlugin> unknown("no_such_registry", "tabby");
+  EXPECT_EQ(unknown.get(), nullptr);
+  EXPECT_TRUE(unknown.items()->empty());
+}
+
 TEST_F(RegistryTests, test_real_registry) {
   EXPECT_TRUE(Registry::get().count() > 0U);
 
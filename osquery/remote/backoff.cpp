@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/remote/backoff.h>
+
+namespace osquery {
+
+CLI_FLAG(uint64,
+         tls_backoff_max,
+         600,
+         "Maximum seconds remote requests wait after failures or throttling");
+
+CLI_FLAG(uint64,
+         tls_jitter_percent,
+         10,
+         "Percent to randomly spread remote request periods and retries");
+
+/// The throttling window of the first reply without a Retry-After.
+const uint64_t kBackoffBase = 1000;
+
+RemoteBackoff& RemoteBackoff::get() {
+  static RemoteBackoff instance;
+  return instance;
+}
+
+uint64_t RemoteBackoff::random(uint64_t low, uint64_t high) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::uniform_int_distribution<uint64_t>(low, high)(generator_);
+}
+
+uint64_t RemoteBackoff::retryDelay(size_t attempt) {
+  // Retries keep the quadratic growth, at least half of each is jittered.
+  uint64_t delay = std::min<uint64_t>(kBackoffBase * attempt * attempt,
+                                      FLAGS_tls_backoff_max * 1000);
+  delay = random(delay / 2, delay);
+  return std::max(delay, throttled());
+}
+
+void RemoteBackoff::throttle(uint64_t retry_after) {
+  uint64_t window = 0;
+  if (retry_after > 0) {
+    // The remote asked for a time, only later retries are spread.
+    window = std::min(retry_after, FLAGS_tls_backoff_max) * 1000;
+    window += random(0, window * FLAGS_tls_jitter_percent / 100);
+  } else {
+    size_t level = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      level = std::min<size_t>(level_, 30);
+    }
+    window = std::min<uint64_t>(kBackoffBase << level,
+                                FLAGS_tls_backoff_max * 1000);
+    window = random(window / 2, window);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  level_++;
+  auto until =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(window);
+  until_ = std::max(until_, until);
+}
+
+void RemoteBackoff::succeed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  level_ = 0;
+}
+
+uint64_t RemoteBackoff::throttled() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = std::chrono::steady_clock::now();
+  if (until_ <= now) {
+    return 0;
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(until_ - now)
+      .count();
+}
+
+uint64_t RemoteBackoff::jitter(uint64_t period) {
+  auto spread = period * std::min<uint64_t>(FLAGS_tls_jitter_percent, 100) / 100;
+  return random(period - spread, period + spread);
+}
+} // namespace osquery
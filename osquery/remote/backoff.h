@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+#include <osquery/core/flags.h>
+
+namespace osquery {
+
+DECLARE_uint64(tls_backoff_max);
+DECLARE_uint64(tls_jitter_percent);
+
+/**
+ * @brief The timing of remote requests, shared by the TLS plugins.
+ *
+ * The nodes of a fleet start, and reconnect after an outage, at about the
+ * same time. Periods and retries are jittered so nodes spread their requests.
+ * A remote replying 429 or 503 throttles the requests of every plugin until
+ * its Retry-After passed, or for a window doubling with each such reply.
+ */
+class RemoteBackoff {
+ public:
+  static RemoteBackoff& get();
+
+  /// Milliseconds to wait before retrying after a failed attempt.
+  uint64_t retryDelay(size_t attempt);
+
+  /// Record a throttling reply, retry_after is 0 if the remote sent none.
+  void throttle(uint64_t retry_after);
+
+  /// Record a reply that was not throttled.
+  void succeed();
+
+  /// Milliseconds until requests may be sent again, 0 if not throttled.
+  uint64_t throttled();
+
+  /// Spread a period of milliseconds by tls_jitter_percent either way.
+  uint64_t jitter(uint64_t period);
+
+ private:
+  RemoteBackoff() = default;
+
+  /// A uniformly random number of the closed range.
+  uint64_t random(uint64_t low, uint64_t high);
+
+ private:
+  /// Requests are throttled until this time.
+  std::chrono::steady_clock::time_point until_;
+
+  /// The throttling replies since the last reply that was not throttled.
+  size_t level_{0};
+
+  std::mt19937_64 generator_{std::random_device{}()};
+
+  std::mutex mutex_;
+};
+} // namespace osquery
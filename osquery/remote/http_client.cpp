@@ -7,6 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include <osquery/logger/logger.h>
 #include <osquery/remote/http_client.h>
 
@@ -21,6 +25,55 @@ const std::string kProxyDefaultPort{"3128"};
 
 const long kSSLShortReadError{0x140000dbL};
 
+namespace {
+
+/// The most remotes whose TLS sessions are kept.
+const size_t kMaxTLSSessions = 64;
+
+/**
+ * @brief Resumable TLS sessions shared by every Client.
+ *
+ * After a disconnect, such as a backend restart, a new connection resumes
+ * the session with an abbreviated handshake instead of a full one.
+ */
+class TLSSessionCache {
+ public:
+  static TLSSessionCache& get() {
+    static TLSSessionCache instance;
+    return instance;
+  }
+
+  std::shared_ptr<SSL_SESSION> find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(key);
+    if (it == sessions_.end()) {
+      return nullptr;
+    }
+    return it->second;
+  }
+
+  /// Keep a session, taking ownership of its reference.
+  void store(const std::string& key, SSL_SESSION* session) {
+    std::shared_ptr<SSL_SESSION> ref(session, ::SSL_SESSION_free);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sessions_.size() >= kMaxTLSSessions && sessions_.count(key) == 0) {
+      sessions_.clear();
+    }
+    sessions_[key] = std::move(ref);
+  }
+
+  void erase(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.erase(key);
+  }
+
+ private:
+  std::map<std::string, std::shared_ptr<SSL_SESSION>> sessions_;
+  std::mutex mutex_;
+};
+
+} // namespace
+
 void Client::callNetworkOperation(std::function<void()> callback) {
   if (client_options_.timeout_) {
     timer_.async_wait(
@@ -228,10 +281,32 @@ void Client::encryptConnection() {
                              boost::asio::ssl::context::pem);
   }
 
+  if (client_options_.session_resumption_) {
+    // A resumed session skips verification, it must have passed the same.
+    session_key_ = *client_options_.remote_hostname_ + ':' +
+                   *client_options_.remote_port_ + '|' +
+                   client_options_.server_certificate_.value_or("") + '|' +
+                   client_options_.verify_path_.value_or("") + '|' +
+                   client_options_.client_certificate_file_.value_or("") +
+                   '|' + (client_options_.always_verify_peer_ ? "1" : "0");
+    SSL_CTX_set_session_cache_mode(
+        ctx.native_handle(),
+        SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    ::SSL_CTX_sess_set_new_cb(ctx.native_handle(), &Client::newSessionCallback);
+  }
+
   ssl_sock_ = std::make_shared<ssl_stream>(sock_, ctx);
   ::SSL_set_tlsext_host_name(ssl_sock_->native_handle(),
                              client_options_.remote_hostname_->c_str());
 
+  if (client_options_.session_resumption_) {
+    SSL_set_app_data(ssl_sock_->native_handle(), this);
+    auto session = TLSSessionCache::get().find(session_key_);
+    if (session != nullptr && ::SSL_SESSION_is_resumable(session.get())) {
+      ::SSL_set_session(ssl_sock_->native_handle(), session.get());
+    }
+  }
+
   ssl_sock_->set_verify_callback(boost::asio::ssl::rfc2818_verification(
       *client_options_.remote_hostname_));
 
@@ -242,10 +317,23 @@ void Client::encryptConnection() {
   });
 
   if (ec_) {
+    if (client_options_.session_resumption_) {
+      TLSSessionCache::get().erase(session_key_);
+    }
     throw std::system_error(ec_);
   }
 }
 
+int Client::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  auto* client = static_cast<Client*>(SSL_get_app_data(ssl));
+  if (client == nullptr || client->session_key_.empty()) {
+    return 0;
+  }
+
+  TLSSessionCache::get().store(client->session_key_, session);
+  return 1;
+}
+
 template <typename STREAM_TYPE>
 void Client::sendRequest(STREAM_TYPE& stream,
                          Request& req,
@@ -288,6 +376,11 @@ void Client::sendRequest(STREAM_TYPE& stream,
     throw std::system_error(ec_);
   }
 
+  // The body is parsed into the response as it arrives, only the buffered
+  // reads are held in between.
+  if (client_options_.max_response_size_ > 0) {
+    resp.body_limit(client_options_.max_response_size_);
+  }
   boost::beast::flat_buffer b;
 
   callNetworkOperation([&]() {
@@ -443,7 +536,9 @@ Response Client::sendHTTPRequest(Request& req) {
       }
     } catch (std::exception const& /* e */) {
       closeSocket();
-      if (init_request && ec_ != boost::asio::error::timed_out) {
+      // Retrying a response that exceeded the limit would download it again.
+      if (init_request && ec_ != boost::asio::error::timed_out &&
+          ec_ != beast_http::error::body_limit) {
         init_request = false;
       } else {
         ec_.clear();
@@ -90,10 +90,12 @@ class Client {
    public:
     Options()
         : ssl_options_(0),
+          max_response_size_(0),
           timeout_(0),
           always_verify_peer_(false),
           follow_redirects_(false),
           keep_alive_(false),
+          session_resumption_(false),
           ssl_connection_(false) {}
 
     Options& ssl_connection(bool ct) {
@@ -106,6 +108,12 @@ class Client {
       return *this;
     }
 
+    /// Resume TLS sessions from earlier connections with the same settings.
+    Options& session_resumption(bool sr) {
+      session_resumption_ = sr;
+      return *this;
+    }
+
     Options& follow_redirects(bool fr) {
       follow_redirects_ = fr;
       return *this;
@@ -121,6 +129,12 @@ class Client {
       return *this;
     }
 
+    /// Fail responses with larger bodies, 0 keeps the parser's default limit.
+    Options& max_response_size(uint64_t size) {
+      max_response_size_ = size;
+      return *this;
+    }
+
     Options& openssl_ciphers(std::string const& ciphers) {
       ciphers_ = ciphers;
       return *this;
@@ -176,10 +190,10 @@ class Client {
              (remote_hostname_ == ropts.remote_hostname_) &&
              (remote_port_ == ropts.remote_port_) &&
              (ssl_options_ == ropts.ssl_options_) &&
-             (timeout_ == ropts.timeout_) &&
              (always_verify_peer_ == ropts.always_verify_peer_) &&
              (follow_redirects_ == ropts.follow_redirects_) &&
              (keep_alive_ == ropts.keep_alive_) &&
+             (session_resumption_ == ropts.session_resumption_) &&
              (ssl_connection_ == ropts.ssl_connection_);
     }
 
@@ -193,10 +207,12 @@ class Client {
     boost::optional<std::string> remote_hostname_;
     boost::optional<std::string> remote_port_;
     long ssl_options_;
+    uint64_t max_response_size_;
     int timeout_;
     bool always_verify_peer_;
     bool follow_redirects_;
     bool keep_alive_;
+    bool session_resumption_;
     bool ssl_connection_;
     friend class Client;
   };
@@ -216,10 +232,21 @@ class Client {
   }
 
   void setOptions(Options const& opts) {
-    new_client_options_ = !(client_options_ == opts);
+    // A remote taken from the previous request is compared when sending.
+    auto next = opts;
+    if (!next.remote_hostname_) {
+      next.remote_hostname_ = client_options_.remote_hostname_;
+      next.remote_port_ = client_options_.remote_port_;
+      next.ssl_connection_ = client_options_.ssl_connection_;
+    }
+
+    new_client_options_ = !(client_options_ == next);
     if (new_client_options_) {
-      client_options_ = opts;
+      client_options_ = next;
     }
+    // The limits apply to each request, changing them keeps the connection.
+    client_options_.timeout_ = opts.timeout_;
+    client_options_.max_response_size_ = opts.max_response_size_;
   }
 
   /// HTTP put request method.
@@ -262,6 +289,9 @@ class Client {
   /// Convert plain socket to TLS socket.
   void encryptConnection();
 
+  /// Keep the sessions and tickets the server issues for later connections.
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
+
   template <typename STREAM_TYPE>
   void sendRequest(STREAM_TYPE& stream,
                    Request& req,
@@ -333,6 +363,9 @@ class Client {
   std::shared_ptr<ssl_stream> ssl_sock_;
   boost::system::error_code ec_;
   bool new_client_options_{true};
+
+  /// The remote and verification settings a resumable session must match.
+  std::string session_key_;
 };
 
 /**
@@ -11,6 +11,9 @@
 #include <string>
 
 #include <zlib.h>
+#include <zstd.h>
+
+#include <osquery/remote/requests.h>
 
 namespace osquery {
 
@@ -56,4 +59,91 @@ std::string compressString(const std::string& data) {
 
   return output;
 }
+
+namespace {
+
+/// Responses that inflate past this size are rejected.
+const size_t kMaxDecompressedSize = 128 * 1024 * 1024;
+
+Status inflateString(const std::string& data, std::string& output) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+
+  // Detect both gzip and zlib headers.
+  if (inflateInit2(&zs, MOD_GZIP_ZLIB_WINDOWSIZE + 32) != Z_OK) {
+    return Status::failure("Cannot initialize gzip decompression");
+  }
+
+  zs.next_in = (Bytef*)data.data();
+  zs.avail_in = static_cast<uInt>(data.size());
+
+  int ret = Z_OK;
+  char buffer[16384] = {0};
+  while (ret == Z_OK && output.size() <= kMaxDecompressedSize) {
+    zs.next_out = reinterpret_cast<Bytef*>(buffer);
+    zs.avail_out = sizeof(buffer);
+
+    ret = inflate(&zs, Z_NO_FLUSH);
+    if (ret == Z_OK || ret == Z_STREAM_END) {
+      output.append(buffer, sizeof(buffer) - zs.avail_out);
+    }
+  }
+
+  inflateEnd(&zs);
+  if (ret != Z_STREAM_END) {
+    return Status::failure("Cannot decompress gzip content");
+  }
+  return Status::success();
+}
+
+Status zstdDecompressString(const std::string& data, std::string& output) {
+  ZSTD_DStream* const dstream = ZSTD_createDStream();
+  if (dstream == nullptr) {
+    return Status::failure("Cannot initialize zstd decompression");
+  }
+  ZSTD_initDStream(dstream);
+
+  ZSTD_inBuffer input = {data.data(), data.size(), 0};
+  std::string buffer(ZSTD_DStreamOutSize(), '\0');
+  size_t ret = 1;
+  // A full output buffer may leave decoded content to flush.
+  bool flush = true;
+  while ((input.pos < input.size || flush) &&
+         output.size() <= kMaxDecompressedSize) {
+    ZSTD_outBuffer out = {&buffer[0], buffer.size(), 0};
+    ret = ZSTD_decompressStream(dstream, &out, &input);
+    if (ZSTD_isError(ret)) {
+      break;
+    }
+    output.append(buffer.data(), out.pos);
+    flush = (out.pos == out.size);
+  }
+
+  ZSTD_freeDStream(dstream);
+  if (ZSTD_isError(ret) || ret != 0) {
+    return Status::failure("Cannot decompress zstd content");
+  }
+  return Status::success();
+}
+
+} // namespace
+
+Status decompressString(const std::string& data,
+                        const std::string& encoding,
+                        std::string& output) {
+  output.clear();
+  Status status;
+  if (encoding == "gzip" || encoding == "deflate") {
+    status = inflateString(data, output);
+  } else if (encoding == "zstd") {
+    status = zstdDecompressString(data, output);
+  } else {
+    return Status::failure("Unsupported content encoding: " + encoding);
+  }
+
+  if (status.ok() && output.size() > kMaxDecompressedSize) {
+    return Status::failure("Decompressed content exceeds the size limit");
+  }
+  return status;
 }
+} // namespace osquery
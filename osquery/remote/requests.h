@@ -34,6 +34,17 @@ class Serializer;
  */
 std::string compressString(const std::string& data);
 
+/**
+ * @brief Decompress a response body with a gzip, deflate, or zstd encoding.
+ *
+ * @param data The encoded response body.
+ * @param encoding The Content-Encoding of the response.
+ * @param output The decoded body.
+ */
+Status decompressString(const std::string& data,
+                        const std::string& encoding,
+                        std::string& output);
+
 /**
  * @brief Abstract base class for remote transport implementations
  *
@@ -74,13 +85,15 @@ class Transport {
   /**
    * @brief Send a simple request to the destination with parameters
    *
+   * The parameters are taken by value so that transports can move them into
+   * the request body instead of copying them.
+   *
    * @param params A string representing the serialized parameters
    * @param compress True of the request was requested to be compressed
    *
    * @return success or failure of the operation
    */
-  virtual Status sendRequest(const std::string& params,
-                             bool compress = false) = 0;
+  virtual Status sendRequest(std::string params, bool compress = false) = 0;
 
   /**
    * @brief Get the status of the response
@@ -98,6 +111,24 @@ class Transport {
     return response_params_;
   }
 
+  /**
+   * @brief Get the entity tag the remote returned with the response
+   *
+   * @return The tag, empty if the remote did not tag the response
+   */
+  const std::string& getResponseTag() const {
+    return response_tag_;
+  }
+
+  /**
+   * @brief Check if the remote replied the requested entity did not change
+   *
+   * A not modified response has no parameters, the caller keeps its copy.
+   */
+  bool isNotModified() const {
+    return response_not_modified_;
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -121,6 +152,12 @@ class Transport {
   /// storage for response parameters
   JSON response_params_;
 
+  /// storage for the response entity tag
+  std::string response_tag_;
+
+  /// true if the response was not modified since the tagged request
+  bool response_not_modified_{false};
+
   /// options from request call (use defined by specific transport)
   JSON options_;
 };
@@ -237,7 +274,21 @@ class Request {
       compress = it->value.GetBool();
     }
 
-    return transport_->sendRequest(serialized, compress);
+    return transport_->sendRequest(std::move(serialized), compress);
+  }
+
+  /**
+   * @brief Send a request with an already serialized body
+   *
+   * The body is sent as-is, transports that support a "content_encoding"
+   * option will declare it for bodies that were compressed by the caller.
+   *
+   * @param serialized the serialized, and optionally encoded, body
+   *
+   * @return success or failure of the operation
+   */
+  Status callSerialized(const std::string& serialized) {
+    return transport_->sendRequest(serialized, false);
   }
 
   /**
@@ -250,6 +301,16 @@ class Request {
     return transport_->getResponseStatus();
   }
 
+  /// Get the entity tag of the response, empty if not tagged.
+  const std::string& getResponseTag() const {
+    return transport_->getResponseTag();
+  }
+
+  /// True if the remote replied the tagged entity was not modified.
+  bool isNotModified() const {
+    return transport_->isNotModified();
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/remote/backoff.h>
+
+namespace osquery {
+
+class RemoteBackoffTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    backoff_max_ = FLAGS_tls_backoff_max;
+    jitter_percent_ = FLAGS_tls_jitter_percent;
+  }
+
+  void TearDown() override {
+    FLAGS_tls_backoff_max = backoff_max_;
+    FLAGS_tls_jitter_percent = jitter_percent_;
+  }
+
+ private:
+  uint64_t backoff_max_{0};
+  uint64_t jitter_percent_{0};
+};
+
+TEST_F(RemoteBackoffTests, test_jitter) {
+  auto& backoff = RemoteBackoff::get();
+  FLAGS_tls_jitter_percent = 10;
+  for (size_t i = 0; i < 100; i++) {
+    auto period = backoff.jitter(10000);
+    EXPECT_GE(period, 9000U);
+    EXPECT_LE(period, 11000U);
+  }
+  EXPECT_EQ(0U, backoff.jitter(0));
+
+  FLAGS_tls_jitter_percent = 0;
+  EXPECT_EQ(10000U, backoff.jitter(10000));
+}
+
+TEST_F(RemoteBackoffTests, test_retry_delay) {
+  auto& backoff = RemoteBackoff::get();
+  for (size_t attempt = 1; attempt < 5; attempt++) {
+    auto delay = backoff.retryDelay(attempt);
+    EXPECT_GE(delay, 500U * attempt * attempt);
+    EXPECT_LE(delay, 1000U * attempt * attempt);
+  }
+
+  FLAGS_tls_backoff_max = 2;
+  EXPECT_LE(backoff.retryDelay(10), 2000U);
+}
+
+TEST_F(RemoteBackoffTests, test_throttle) {
+  auto& backoff = RemoteBackoff::get();
+  FLAGS_tls_backoff_max = 5;
+  FLAGS_tls_jitter_percent = 10;
+
+  // A Retry-After is honored, and retries wait for it.
+  backoff.throttle(2);
+  auto throttled = backoff.throttled();
+  EXPECT_GT(throttled, 1000U);
+  EXPECT_LE(throttled, 2200U);
+  auto delay = backoff.retryDelay(1);
+  EXPECT_GE(delay, backoff.throttled());
+
+  // A longer Retry-After is limited, and never shortens the window.
+  backoff.throttle(3600);
+  throttled = backoff.throttled();
+  EXPECT_GT(throttled, 4000U);
+  EXPECT_LE(throttled, 5500U);
+  backoff.throttle(1);
+  EXPECT_GT(backoff.throttled(), 2200U);
+
+  backoff.succeed();
+}
+} // namespace osquery
@@ -9,6 +9,8 @@
 
 #include <gtest/gtest.h>
 
+#include <zstd.h>
+
 #include <osquery/remote/requests.h>
 #include <osquery/remote/serializers/json.h>
 #include <osquery/remote/transports/tls.h>
@@ -29,7 +31,7 @@ class MockTransport : public Transport {
     return response_status_;
   }
 
-  Status sendRequest(const std::string& params, bool compress) override {
+  Status sendRequest(std::string params, bool compress) override {
     response_params_.add("foo", "baz");
     response_status_ = Status(0, "OK");
     return response_status_;
@@ -107,7 +109,7 @@ class CopyTransport : public Transport {
     return response_status_;
   }
 
-  Status sendRequest(const std::string& params, bool compress) override {
+  Status sendRequest(std::string params, bool compress) override {
     // Optionally compress.
     response_status_ = Status(0, (compress) ? compressString(params) : params);
     return response_status_;
@@ -177,4 +179,35 @@ TEST_F(RequestsTests, test_compression) {
   EXPECT_EQ(compressed.substr(10), expected2);
   EXPECT_LT(compressed.size(), uncompressed.size());
 }
+
+TEST_F(RequestsTests, test_decompression) {
+  std::string uncompressed = "stringstringstringstring";
+  for (size_t i = 0; i < 10; i++) {
+    uncompressed += uncompressed;
+  }
+
+  std::string decompressed;
+  auto status =
+      decompressString(compressString(uncompressed), "gzip", decompressed);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(decompressed, uncompressed);
+
+  std::string zstd_compressed(ZSTD_compressBound(uncompressed.size()), '\0');
+  auto size = ZSTD_compress(&zstd_compressed[0],
+                            zstd_compressed.size(),
+                            uncompressed.data(),
+                            uncompressed.size(),
+                            1);
+  ASSERT_FALSE(ZSTD_isError(size));
+  zstd_compressed.resize(size);
+  status = decompressString(zstd_compressed, "zstd", decompressed);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(decompressed, uncompressed);
+
+  // Truncated and unknown encodings are errors.
+  zstd_compressed.resize(size / 2);
+  EXPECT_FALSE(decompressString(zstd_compressed, "zstd", decompressed).ok());
+  EXPECT_FALSE(decompressString(uncompressed, "gzip", decompressed).ok());
+  EXPECT_FALSE(decompressString(uncompressed, "br", decompressed).ok());
+}
 }
@@ -98,6 +98,24 @@ TEST_F(TLSTransportsTests, test_call) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(TLSTransportsTests, test_call_shared_session) {
+  startServer();
+
+  // Requests from different threads take turns on the pooled sessions.
+  auto url = "https://localhost:" + port_;
+  for (size_t i = 0; i < 3; i++) {
+    std::thread([&url, this]() {
+      auto t = std::make_shared<TLSTransport>();
+      t->disableVerifyPeer();
+      Request<TLSTransport, JSONSerializer> r(url, t);
+
+      Status status;
+      ASSERT_NO_THROW(status = r.call());
+      EXPECT_TRUE(status.ok()) << getTLSError(status);
+    }).join();
+  }
+}
+
 TEST_F(TLSTransportsTests, test_call_with_params) {
   startServer();
 
@@ -10,8 +10,14 @@
 #include "tls.h"
 
 #include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+
 #include <osquery/core/core.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/remote/backoff.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/config/default_paths.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/info/version.h>
@@ -54,12 +60,30 @@ CLI_FLAG(string,
 /// Reuse TLS session sockets.
 CLI_FLAG(bool, tls_session_reuse, true, "Reuse TLS session sockets");
 
+/// Resume TLS sessions when a new connection is made.
+CLI_FLAG(bool,
+         tls_session_resumption,
+         true,
+         "Resume TLS sessions of earlier connections with session tickets");
+
+/// Idle sessions kept for each remote.
+CLI_FLAG(uint32,
+         tls_session_pool_size,
+         4,
+         "Idle TLS sessions to each remote shared by the TLS plugins");
+
 /// Tear down TLS sessions after a custom timeout.
 CLI_FLAG(uint32,
          tls_session_timeout,
          3600,
          "TLS session keep alive timeout in seconds");
 
+/// Limit the memory a single response may use.
+CLI_FLAG(uint64,
+         tls_max_response_size,
+         8 * 1024 * 1024,
+         "Maximum size in bytes of a TLS/HTTPS response body (default 8MB)");
+
 #ifndef NDEBUG
 HIDDEN_FLAG(bool,
             tls_allow_unsafe,
@@ -85,10 +109,63 @@ TLSTransport::TLSTransport() {
   }
 }
 
+Status TLSTransport::checkThrottled() {
+  auto throttled = RemoteBackoff::get().throttled();
+  if (throttled > 0) {
+    return Status::failure("Remote requests are throttled for another " +
+                           std::to_string(throttled) + "ms");
+  }
+  return Status::success();
+}
+
 void TLSTransport::decorateRequest(http::Request& r) {
   r << http::Request::Header("Content-Type", serializer_->getContentType());
   r << http::Request::Header("Accept", serializer_->getContentType());
   r << http::Request::Header("User-Agent", kTLSUserAgentBase + kVersion);
+  r << http::Request::Header("Accept-Encoding", "gzip, zstd");
+
+  // A caller holding a tagged copy of the response asks to skip the transfer.
+  auto tag = options_.doc().FindMember("if_none_match");
+  if (tag != options_.doc().MemberEnd() && tag->value.IsString() &&
+      tag->value.GetStringLength() > 0) {
+    r << http::Request::Header("If-None-Match", tag->value.GetString());
+  }
+}
+
+Status TLSTransport::readResponse() {
+  // The requests of every plugin wait while the remote sheds load.
+  auto code = response_.status();
+  if (code == 429 || code == 503) {
+    auto retry_after = response_.headers()["Retry-After"];
+    RemoteBackoff::get().throttle(
+        tryTo<uint64_t>(retry_after, 10).takeOr(uint64_t{0}));
+    return Status::failure("Remote is throttling requests (HTTP " +
+                           std::to_string(code) + ")");
+  }
+  RemoteBackoff::get().succeed();
+
+  response_tag_ = response_.headers()["ETag"];
+  response_not_modified_ = (response_.status() == 304);
+  if (response_not_modified_) {
+    response_params_ = JSON::newObject();
+    return Status::success();
+  }
+
+  const std::string* response_body = &response_.body();
+  std::string decoded;
+  auto encoding = response_.headers()["Content-Encoding"];
+  if (!encoding.empty() && encoding != "identity") {
+    auto status = decompressString(*response_body, encoding, decoded);
+    if (!status.ok()) {
+      return status;
+    }
+    response_body = &decoded;
+  }
+
+  if (FLAGS_verbose && FLAGS_tls_dump) {
+    fprintf(stdout, "%s\n", response_body->c_str());
+  }
+  return serializer_->deserialize(*response_body, response_params_);
 }
 
 http::Client::Options TLSTransport::getOptions() {
@@ -147,6 +224,14 @@ http::Client::Options TLSTransport::getInternalOptions() {
   auto options = getOptions();
 
   options.keep_alive(FLAGS_tls_session_reuse);
+  options.session_resumption(FLAGS_tls_session_resumption);
+  options.max_response_size(FLAGS_tls_max_response_size);
+
+  // Requests such as distributed long polls may wait longer for a response.
+  auto timeout = options_.doc().FindMember("timeout");
+  if (timeout != options_.doc().MemberEnd() && timeout->value.IsInt()) {
+    options.timeout(timeout->value.GetInt());
+  }
 
   if (FLAGS_proxy_hostname.size() > 0) {
     options.proxy_hostname(FLAGS_proxy_hostname);
@@ -179,69 +264,133 @@ inline bool tlsFailure(const std::string& what) {
   return true;
 }
 
-static auto getClient() {
-  std::shared_ptr<http::Client> client = nullptr;
-  if (FLAGS_tls_session_reuse) {
-    thread_local std::shared_ptr<http::Client> tl_client;
-    thread_local auto last_time_reseted = std::chrono::system_clock::now();
-    client = tl_client;
+namespace {
+
+struct TLSSession {
+  std::shared_ptr<http::Client> client;
+  std::chrono::steady_clock::time_point created;
+
+  bool expired() const {
+    return FLAGS_tls_session_timeout > 0 &&
+           std::chrono::steady_clock::now() - created >
+               std::chrono::seconds(FLAGS_tls_session_timeout);
+  }
+};
 
-    if (client.get() == nullptr) {
-      tl_client = client = std::make_shared<http::Client>();
+/**
+ * @brief Idle TLS sessions shared by every TLSTransport.
+ *
+ * A session carries one request at a time, concurrent requests use separate
+ * sessions. Requests that follow each other, from the config, logger,
+ * distributed and carver threads, share the sessions to the same remote.
+ */
+class TLSSessionPool {
+ public:
+  static TLSSessionPool& get() {
+    static TLSSessionPool instance;
+    return instance;
+  }
+
+  TLSSession acquire(const std::string& remote) {
+    if (FLAGS_tls_session_reuse) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& idle = idle_[remote];
+      while (!idle.empty()) {
+        auto session = std::move(idle.back());
+        idle.pop_back();
+        if (!session.expired()) {
+          return session;
+        }
+      }
     }
+    return {std::make_shared<http::Client>(),
+            std::chrono::steady_clock::now()};
+  }
 
-    if (FLAGS_tls_session_timeout > 0 &&
-        std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::system_clock::now() - last_time_reseted)
-                .count() > FLAGS_tls_session_timeout) {
-      tl_client.reset();
-      last_time_reseted = std::chrono::system_clock::now();
+  /// Keep a session after a completed request, failed sessions are dropped.
+  void release(const std::string& remote, TLSSession session) {
+    if (!FLAGS_tls_session_reuse || session.expired()) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& idle = idle_[remote];
+    if (idle.size() < FLAGS_tls_session_pool_size) {
+      idle.push_back(std::move(session));
     }
-  } else {
-    client = std::make_shared<http::Client>();
   }
-  return client;
+
+ private:
+  std::map<std::string, std::vector<TLSSession>> idle_;
+  std::mutex mutex_;
+};
+
+/// Send a request on a pooled session, which is kept if no error is thrown.
+template <typename Send>
+http::Response sendOnSession(http::Request& r,
+                             const http::Client::Options& options,
+                             Send send) {
+  auto remote = (r.remoteHost() ? *r.remoteHost() : "") + ":" +
+                (r.remotePort() ? *r.remotePort() : "");
+  auto session = TLSSessionPool::get().acquire(remote);
+  session.client->setOptions(options);
+  auto response = send(*session.client);
+  TLSSessionPool::get().release(remote, std::move(session));
+  return response;
 }
 
+} // namespace
+
 Status TLSTransport::sendRequest() {
   if (destination_.find("https://") == std::string::npos) {
     return Status::failure(
         "Cannot create TLS request for non-HTTPS protocol URI");
   }
 
+  auto status = checkThrottled();
+  if (!status.ok()) {
+    return status;
+  }
+
   http::Request r(destination_);
   decorateRequest(r);
 
   VLOG(1) << "TLS/HTTPS GET request to URI: " << destination_;
   try {
-    std::shared_ptr<http::Client> client = getClient();
-
-    client->setOptions(getInternalOptions());
-    response_ = client->get(r);
-
-    const auto& response_body = response_.body();
-    if (FLAGS_verbose && FLAGS_tls_dump) {
-      fprintf(stdout, "%s\n", response_body.c_str());
-    }
-    response_status_ =
-        serializer_->deserialize(response_body, response_params_);
+    response_ = sendOnSession(r, getInternalOptions(), [&r](auto& client) {
+      return client.get(r);
+    });
+    response_status_ = readResponse();
   } catch (const std::exception& e) {
     return Status::failure(std::string("Request error: ") + e.what());
   }
   return response_status_;
 }
 
-Status TLSTransport::sendRequest(const std::string& params, bool compress) {
+Status TLSTransport::sendRequest(std::string params, bool compress) {
   if (destination_.find("https://") == std::string::npos) {
     return Status::failure(
         "Cannot create TLS request for non-HTTPS protocol URI");
   }
 
+  auto status = checkThrottled();
+  if (!status.ok()) {
+    return status;
+  }
+
   http::Request r(destination_);
   decorateRequest(r);
   if (compress) {
     // Later, when posting/putting, the data will be optionally compressed.
     r << http::Request::Header("Content-Encoding", "gzip");
+  } else {
+    // The caller may provide a body that is already compressed.
+    auto encoding = options_.doc().FindMember("content_encoding");
+    if (encoding != options_.doc().MemberEnd() &&
+        encoding->value.IsString()) {
+      r << http::Request::Header("Content-Encoding",
+                                 encoding->value.GetString());
+    }
   }
 
   // Allow request calls to override the default HTTP POST verb.
@@ -258,22 +407,19 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
     fprintf(stdout, "%s\n", params.c_str());
   }
 
-  try {
-    std::shared_ptr<http::Client> client = getClient();
-    client->setOptions(getInternalOptions());
-
-    if (verb == HTTP_POST) {
-      response_ = client->post(r, (compress) ? compressString(params) : params);
-    } else {
-      response_ = client->put(r, (compress) ? compressString(params) : params);
-    }
+  if (compress) {
+    // Release the uncompressed parameters before the request is sent.
+    params = compressString(params);
+  }
 
-    const auto& response_body = response_.body();
-    if (FLAGS_verbose && FLAGS_tls_dump) {
-      fprintf(stdout, "%s\n", response_body.c_str());
-    }
-    response_status_ =
-        serializer_->deserialize(response_body, response_params_);
+  try {
+    response_ = sendOnSession(r, getInternalOptions(), [&](auto& client) {
+      if (verb == HTTP_POST) {
+        return client.post(r, std::move(params));
+      }
+      return client.put(r, std::move(params));
+    });
+    response_status_ = readResponse();
   } catch (const std::exception& e) {
     return Status::failure(std::string("Request error: ") + e.what());
   }
@@ -67,7 +67,7 @@ class TLSTransport : public Transport {
    * Return code (1) for general connectivity problems, return code (2) for TLS
    * specific errors.
    */
-  Status sendRequest(const std::string& params, bool compress = false) override;
+  Status sendRequest(std::string params, bool compress = false) override;
 
   /**
    * @brief Class destructor
@@ -134,6 +134,17 @@ class TLSTransport : public Transport {
    */
   void decorateRequest(http::Request& r);
 
+  /// Fail without a request while the remote throttles requests.
+  Status checkThrottled();
+
+  /**
+   * @brief Decode and deserialize the response
+   *
+   * Compressed bodies are decompressed, a not modified response keeps no
+   * parameters and records that the caller's copy is current.
+   */
+  Status readResponse();
+
  protected:
   /// Storage for the HTTP response object
   http::Response response_;
@@ -20,6 +20,7 @@
 #include <osquery/core/system.h>
 
 #include <osquery/process/process.h>
+#include <osquery/remote/backoff.h>
 #include <osquery/remote/requests.h>
 
 namespace osquery {
@@ -30,6 +31,20 @@ DECLARE_bool(tls_node_api);
 DECLARE_bool(tls_secret_always);
 DECLARE_bool(disable_reenrollment);
 
+/**
+ * @brief The entity tag state of a conditional TLS request.
+ *
+ * A caller holding the tag of a previous response sends it as If-None-Match,
+ * the remote may then reply that the content did not change.
+ */
+struct TLSConditional {
+  /// The tag of the caller's copy, updated with the tag of each response.
+  std::string tag;
+
+  /// Set when the remote replied the caller's copy is current.
+  bool not_modified{false};
+};
+
 /**
  * @brief Helper class for allowing TLS plugins to easily kick off requests
  *
@@ -74,13 +89,17 @@ class TLSRequestHelper : private boost::noncopyable {
    * This isn't const because it will be modified to include node_key.
    * @param output is the JSON which will be populated with the deserialized
    * results
+   * @param conditional optional entity tag state, output is left empty if the
+   * remote replies the tagged content is not modified
    *
    * @return a Status object indicating the success or failure of the operation
    */
   template <class TSerializer>
-  static Status go(const std::string& uri, JSON& params, JSON& output) {
+  static Status go(const std::string& uri,
+                   JSON& params,
+                   JSON& output,
+                   TLSConditional* conditional = nullptr) {
     auto& params_doc = params.doc();
-    auto& output_doc = output.doc();
 
     auto node_key = getNodeKey("tls");
 
@@ -104,6 +123,17 @@ class TLSRequestHelper : private boost::noncopyable {
       params_doc.RemoveMember("_compress");
     }
 
+    // The caller-supplied parameters may extend the request timeout.
+    int timeout = 0;
+    it = params_doc.FindMember("_timeout");
+    if (it != params_doc.MemberEnd()) {
+      if (it->value.IsInt()) {
+        timeout = it->value.GetInt();
+        request.setOption("timeout", timeout);
+      }
+      params_doc.RemoveMember("_timeout");
+    }
+
     // The caller-supplied parameters may force a POST request.
     bool force_post = false;
     it = params_doc.FindMember("_verb");
@@ -120,6 +150,11 @@ class TLSRequestHelper : private boost::noncopyable {
       use_post = false;
       params_doc.RemoveMember("_get");
     }
+    if (conditional != nullptr) {
+      conditional->not_modified = false;
+      request.setOption("if_none_match", conditional->tag);
+    }
+
     bool should_post = (use_post || force_post);
     auto status = (should_post) ? request.call(params) : request.call();
 
@@ -132,50 +167,71 @@ class TLSRequestHelper : private boost::noncopyable {
       params.add("_compress", true);
     }
 
+    if (timeout > 0) {
+      params.add("_timeout", timeout);
+    }
+
     if (!status.ok()) {
       return status;
     }
 
+    if (conditional != nullptr) {
+      conditional->not_modified = request.isNotModified();
+      if (!request.getResponseTag().empty()) {
+        conditional->tag = request.getResponseTag();
+      }
+    }
+
     // The call succeeded, store the enrolled key.
     status = request.getResponse(output);
     if (!status.ok()) {
       return status;
     }
 
-    // Receive config or key rejection
-    it = output_doc.FindMember("node_invalid");
-    if (it != output_doc.MemberEnd()) {
-      assert(it->value.IsBool());
-
-      if (it->value.GetBool()) {
-        if (!FLAGS_disable_reenrollment) {
-          clearNodeKey();
-        }
-
-        std::string message = "Request failed: Invalid node key";
+    return checkResponse(output);
+  }
 
-        it = output_doc.FindMember("error");
-        if (it != output_doc.MemberEnd()) {
-          message +=
-              ": " + std::string(it->value.IsString() ? it->value.GetString()
-                                                      : "<unknown>");
-        }
+  /**
+   * @brief Send a TLS request with a serialized and encoded body
+   *
+   * Unlike the JSON variants the body must already contain the node_key when
+   * the node API is not used.
+   *
+   * @param uri is the URI to send the request to
+   * @param body is the serialized request body
+   * @param encoding is the Content-Encoding of the body, empty for none
+   * @param output is the JSON which will be populated with the deserialized
+   * results
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status goEncoded(const std::string& uri,
+                          const std::string& body,
+                          const std::string& encoding,
+                          JSON& output) {
+    std::string uri_suffix;
+    if (FLAGS_tls_node_api) {
+      uri_suffix = "&node_key=" + getNodeKey("tls");
+    }
 
-        return Status(1, message);
-      }
+    Request<TLSTransport, TSerializer> request(uri + uri_suffix);
+    request.setOption("hostname", FLAGS_tls_hostname);
+    if (!encoding.empty()) {
+      request.setOption("content_encoding", encoding);
     }
 
-    it = output_doc.FindMember("error");
-    if (it != output_doc.MemberEnd()) {
-      std::string message =
-          "Request failed: " + std::string(it->value.IsString()
-                                               ? it->value.GetString()
-                                               : "<unknown>");
+    auto status = request.callSerialized(body);
+    if (!status.ok()) {
+      return status;
+    }
 
-      return Status(1, message);
+    status = request.getResponse(output);
+    if (!status.ok()) {
+      return status;
     }
 
-    return Status::success();
+    return checkResponse(output);
   }
 
   /**
@@ -240,6 +296,8 @@ class TLSRequestHelper : private boost::noncopyable {
    * @param output is the string which will be populated with the deserialized
    * results
    * @param attempts is the number of attempts to make if the request fails
+   * @param conditional optional entity tag state, output is left empty if the
+   * remote replies the tagged content is not modified
    *
    * @return a Status object indicating the success or failure of the operation
    */
@@ -247,7 +305,8 @@ class TLSRequestHelper : private boost::noncopyable {
   static Status go(const std::string& uri,
                    JSON& params,
                    std::string& output,
-                   const uint64_t attempts) {
+                   const uint64_t attempts,
+                   TLSConditional* conditional = nullptr) {
     Status s;
     JSON override_params;
     const auto& params_doc = params.doc();
@@ -261,9 +320,15 @@ class TLSRequestHelper : private boost::noncopyable {
     }
 
     for (size_t i = 1; i <= attempts; i++) {
-      s = TLSRequestHelper::go<TSerializer>(uri, params, output);
+      JSON recv;
+      s = TLSRequestHelper::go<TSerializer>(uri, params, recv, conditional);
       if (s.ok()) {
-        return s;
+        output.clear();
+        if (conditional != nullptr && conditional->not_modified) {
+          return s;
+        }
+        auto serializer = TSerializer();
+        return serializer.serialize(recv, output);
       }
       if (i == attempts) {
         break;
@@ -271,7 +336,7 @@ class TLSRequestHelper : private boost::noncopyable {
       for (auto& m : override_params_doc.GetObject()) {
         params.add(m.name.GetString(), m.value);
       }
-      sleepFor(i * i * 1000);
+      sleepFor(RemoteBackoff::get().retryDelay(i));
     }
     return s;
   }
@@ -294,5 +359,46 @@ class TLSRequestHelper : private boost::noncopyable {
     params.add("_get", true);
     return TLSRequestHelper::go<TSerializer>(uri, params, output, attempts);
   }
+
+ private:
+  /// Check a response for errors and key rejection.
+  static Status checkResponse(JSON& output) {
+    auto& output_doc = output.doc();
+
+    // Receive config or key rejection
+    auto it = output_doc.FindMember("node_invalid");
+    if (it != output_doc.MemberEnd()) {
+      assert(it->value.IsBool());
+
+      if (it->value.GetBool()) {
+        if (!FLAGS_disable_reenrollment) {
+          clearNodeKey();
+        }
+
+        std::string message = "Request failed: Invalid node key";
+
+        it = output_doc.FindMember("error");
+        if (it != output_doc.MemberEnd()) {
+          message +=
+              ": " + std::string(it->value.IsString() ? it->value.GetString()
+                                                      : "<unknown>");
+        }
+
+        return Status(1, message);
+      }
+    }
+
+    it = output_doc.FindMember("error");
+    if (it != output_doc.MemberEnd()) {
+      std::string message =
+          "Request failed: " + std::string(it->value.IsString()
+                                               ? it->value.GetString()
+                                               : "<unknown>");
+
+      return Status(1, message);
+    }
+
+    return Status::success();
+  }
 };
 }
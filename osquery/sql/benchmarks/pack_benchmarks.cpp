@@ -0,0 +1,380 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+/**
+ * Replay the queries of a pack against recorded table fixtures.
+ *
+ * Each pack query becomes a benchmark named PACK_<query>, with an argument
+ * that repeats the fixture rows to build large result sets. The stages of a
+ * scheduled query execution are reported as per-iteration counters:
+ *   - prepare_us: parsing and planning, including every xBestIndex call.
+ *   - generate_us: fixture table generation within xFilter.
+ *   - step_us: stepping the statement, less generation (xColumn, joins).
+ *   - diff_us: a differential against the previous results.
+ *   - serialize_us: JSON serialization of the results for logging.
+ *   - allocs: heap allocations made during the iteration.
+ *
+ * The pack and fixtures default to the files in the fixtures directory and
+ * may be overridden with OSQUERY_BENCHMARK_PACK and OSQUERY_BENCHMARK_FIXTURES.
+ * A fixture file maps table names to arrays of rows, the output of
+ * `osqueryi --json "select * from <table>"` can be used for each table.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/config/config.h>
+#include <osquery/core/core.h>
+#include <osquery/core/sql/hashed_results.h>
+#include <osquery/core/sql/query_batch.h>
+#include <osquery/core/tables.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/registry/registry.h>
+#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/json/json.h>
+#include <osquery/utils/system/env.h>
+
+#include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/virtual_table.h"
+
+namespace {
+
+/// Heap allocations made by the benchmark process.
+std::atomic<size_t> kAllocations{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+  kAllocations++;
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace osquery {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Time spent generating fixture rows, in nanoseconds.
+std::atomic<long long> kGenerateNanos{0};
+
+struct FixtureTable {
+  TableColumns columns;
+  QueryData rows;
+};
+
+std::string fixturePath(const std::string& variable, const std::string& name) {
+  auto path = getEnvVar(variable);
+  if (path.is_initialized()) {
+    return *path;
+  }
+  return (boost::filesystem::path(__FILE__).parent_path() / "fixtures" / name)
+      .string();
+}
+
+/// Integer columns of repeated rows are offset so join keys stay distinct.
+void scaleFixtures(size_t scale,
+                   std::map<std::string, FixtureTable>& fixtures) {
+  std::map<std::string, long long> strides;
+  for (const auto& fixture : fixtures) {
+    for (const auto& column : fixture.second.columns) {
+      if (std::get<1>(column) != BIGINT_TYPE) {
+        continue;
+      }
+
+      auto& stride = strides[std::get<0>(column)];
+      for (const auto& row : fixture.second.rows) {
+        const auto& value_text = row.at(std::get<0>(column));
+        auto value = tryTo<long long>(value_text).takeOr(0LL);
+        stride = std::max(stride, value + 1);
+      }
+    }
+  }
+
+  for (auto& fixture : fixtures) {
+    auto& rows = fixture.second.rows;
+    auto recorded = rows.size();
+    for (size_t copy = 1; copy < scale; copy++) {
+      for (size_t i = 0; i < recorded; i++) {
+        auto row = rows[i];
+        for (const auto& column : fixture.second.columns) {
+          const auto& name = std::get<0>(column);
+          if (std::get<1>(column) == BIGINT_TYPE) {
+            auto value = tryTo<long long>(row[name]).takeOr(0LL);
+            row[name] = std::to_string(value + strides[name] * copy);
+          }
+        }
+        rows.push_back(std::move(row));
+      }
+    }
+  }
+}
+
+Status loadFixtures(size_t scale,
+                    std::map<std::string, FixtureTable>& fixtures) {
+  std::string content;
+  auto path = fixturePath("OSQUERY_BENCHMARK_FIXTURES", "pack_fixtures.json");
+  auto status = readFile(path, content);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto doc = JSON::newObject();
+  status = doc.fromString(content);
+  if (!status.ok() || !doc.doc().IsObject()) {
+    return Status::failure("Cannot parse fixtures: " + path);
+  }
+
+  for (const auto& table : doc.doc().GetObject()) {
+    if (!table.value.IsArray()) {
+      continue;
+    }
+
+    auto& fixture = fixtures[table.name.GetString()];
+    std::map<std::string, bool> integers;
+    for (const auto& value : table.value.GetArray()) {
+      if (!value.IsObject()) {
+        continue;
+      }
+
+      Row row;
+      for (const auto& cell : value.GetObject()) {
+        std::string column = cell.name.GetString();
+        row[column] =
+            cell.value.IsString() ? cell.value.GetString() : std::string();
+        auto integer = integers.emplace(column, true).first;
+        integer->second =
+            integer->second && tryTo<long long>(row[column]).isValue();
+      }
+      fixture.rows.push_back(std::move(row));
+    }
+
+    for (const auto& integer : integers) {
+      fixture.columns.push_back(
+          std::make_tuple(integer.first,
+                          integer.second ? BIGINT_TYPE : TEXT_TYPE,
+                          ColumnOptions::DEFAULT));
+    }
+
+    // Recorded rows may omit columns, every row must have all of them.
+    for (auto& row : fixture.rows) {
+      for (const auto& integer : integers) {
+        row.emplace(integer.first, "");
+      }
+    }
+  }
+
+  scaleFixtures(scale, fixtures);
+  return Status::success();
+}
+
+class FixtureTablePlugin : public TablePlugin {
+ public:
+  explicit FixtureTablePlugin(FixtureTable fixture)
+      : fixture_(std::move(fixture)) {}
+
+ private:
+  TableColumns columns() const override {
+    return fixture_.columns;
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    auto start = Clock::now();
+    QueryData rows = fixture_.rows;
+    auto results = tableRowsFromQueryData(std::move(rows));
+    kGenerateNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          Clock::now() - start)
+                          .count();
+    return results;
+  }
+
+ private:
+  FixtureTable fixture_;
+};
+
+/// Attach every fixture table to a new database, at the benchmark's scale.
+Status attachFixtures(size_t scale, SQLiteDBInstanceRef& dbc) {
+  std::map<std::string, FixtureTable> fixtures;
+  auto status = loadFixtures(scale, fixtures);
+  if (!status.ok()) {
+    return status;
+  }
+
+  dbc = SQLiteDBManager::getUnique();
+  auto tables = RegistryFactory::get().registry("table");
+  for (auto& fixture : fixtures) {
+    const auto& name = fixture.first;
+    // Replace a real table of the same name, the query must use the fixture.
+    tables->remove(name);
+    auto plugin =
+        std::make_shared<FixtureTablePlugin>(std::move(fixture.second));
+    tables->add(name, plugin);
+
+    PluginResponse res;
+    Registry::call("table", name, {{"action", "columns"}}, res);
+    status = attachTableInternal(
+        name, columnDefinition(res, false, false), dbc, false);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
+}
+
+long long elapsed(Clock::time_point& start) {
+  auto now = Clock::now();
+  auto nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+  start = now;
+  return nanos;
+}
+
+benchmark::Counter perIteration(long long nanos) {
+  return benchmark::Counter(static_cast<double>(nanos) / 1000,
+                            benchmark::Counter::kAvgIterations);
+}
+
+/// Execute a query outside of the measured loop.
+Status runQuery(const std::string& query,
+                const SQLiteDBInstanceRef& dbc,
+                QueryBatch& results) {
+  sqlite3_stmt* stmt{nullptr};
+  auto rc = sqlite3_prepare_v2(dbc->db(), query.c_str(), -1, &stmt, nullptr);
+  if (rc != SQLITE_OK) {
+    return Status::failure(sqlite3_errmsg(dbc->db()));
+  }
+
+  auto status = readRows(stmt, results, dbc);
+  sqlite3_finalize(stmt);
+  dbc->clearAffectedTables();
+  return status;
+}
+
+void PACK_query(benchmark::State& state, const std::string& query) {
+  SQLiteDBInstanceRef dbc;
+  auto status = attachFixtures(state.range(0), dbc);
+  if (!status.ok()) {
+    state.SkipWithError(status.getMessage().c_str());
+    return;
+  }
+
+  // The previous results of a scheduled query, as stored for differentials.
+  std::string previous;
+  {
+    QueryBatch results;
+    status = runQuery(query, dbc, results);
+    if (!status.ok()) {
+      state.SkipWithError(status.getMessage().c_str());
+      return;
+    }
+    serializeHashedResults(results, previous);
+  }
+
+  long long prepare = 0;
+  long long generate = 0;
+  long long step = 0;
+  long long diff = 0;
+  long long serialize = 0;
+  size_t allocations = 0;
+  size_t rows = 0;
+  for (auto _ : state) {
+    auto allocated = kAllocations.load();
+    kGenerateNanos = 0;
+    auto start = Clock::now();
+
+    sqlite3_stmt* stmt{nullptr};
+    sqlite3_prepare_v2(dbc->db(), query.c_str(), -1, &stmt, nullptr);
+    prepare += elapsed(start);
+
+    QueryBatch results;
+    readRows(stmt, results, dbc);
+    sqlite3_finalize(stmt);
+    dbc->clearAffectedTables();
+    auto stepped = elapsed(start);
+    generate += kGenerateNanos;
+    step += stepped - kGenerateNanos;
+
+    DiffResults dr;
+    std::string next;
+    diffHashedResults(previous, results, dr, next);
+    diff += elapsed(start);
+
+    std::string json;
+    serializeQueryBatchJSON(results, json, true);
+    serialize += elapsed(start);
+
+    benchmark::DoNotOptimize(json);
+    allocations += kAllocations - allocated;
+    rows += results.size();
+  }
+
+  state.counters["prepare_us"] = perIteration(prepare);
+  state.counters["generate_us"] = perIteration(generate);
+  state.counters["step_us"] = perIteration(step);
+  state.counters["diff_us"] = perIteration(diff);
+  state.counters["serialize_us"] = perIteration(serialize);
+  state.counters["allocs"] = benchmark::Counter(
+      static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+  state.counters["rows"] = benchmark::Counter(
+      static_cast<double>(rows), benchmark::Counter::kAvgIterations);
+}
+
+/// Register a benchmark for every query in the pack.
+bool registerPackBenchmarks() {
+  std::string content;
+  auto path = fixturePath("OSQUERY_BENCHMARK_PACK", "pack_queries.conf");
+  if (!readFile(path, content).ok()) {
+    return false;
+  }
+
+  stripConfigComments(content);
+  auto doc = JSON::newObject();
+  if (!doc.fromString(content).ok() || !doc.doc().IsObject() ||
+      !doc.doc().HasMember("queries") || !doc.doc()["queries"].IsObject()) {
+    return false;
+  }
+
+  for (const auto& query : doc.doc()["queries"].GetObject()) {
+    if (!query.value.IsObject() || !query.value.HasMember("query") ||
+        !query.value["query"].IsString()) {
+      continue;
+    }
+
+    std::string name = "PACK_" + std::string(query.name.GetString());
+    benchmark::RegisterBenchmark(
+        name.c_str(), PACK_query, std::string(query.value["query"].GetString()))
+        ->Arg(1)
+        ->Arg(10)
+        ->Arg(100);
+  }
+  return true;
+}
+
+const bool kPackBenchmarks = registerPackBenchmarks();
+
+} // namespace
+} // namespace osquery
@@ -17,6 +17,7 @@
 
 #include <osquery/core/plugins/sql.h>
 
+#include <osquery/utils/chars.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/tool_type.h>
 
@@ -61,7 +62,12 @@ std::string SQL::getMessageString() const {
 }
 
 static inline void escapeNonPrintableBytes(std::string& data) {
-  std::string escaped;
+  // Most cells need no escaping, leave them untouched.
+  auto next = findNonPrintableByte(data.data(), data.size());
+  if (next == data.size()) {
+    return;
+  }
+
   // clang-format off
   char const hex_chars[16] = {
     '0', '1', '2', '3', '4', '5', '6', '7',
@@ -69,22 +75,22 @@ static inline void escapeNonPrintableBytes(std::string& data) {
   };
   // clang-format on
 
-  bool needs_replacement = false;
-  for (size_t i = 0; i < data.length(); i++) {
-    if (((unsigned char)data[i]) < 0x20 || ((unsigned char)data[i]) >= 0x80) {
-      needs_replacement = true;
-      escaped += "\\x";
-      escaped += hex_chars[(((unsigned char)data[i])) >> 4];
-      escaped += hex_chars[((unsigned char)data[i] & 0x0F) >> 0];
-    } else {
-      escaped += data[i];
-    }
+  std::string escaped;
+  escaped.reserve(data.size() + 3);
+  escaped.append(data, 0, next);
+  while (next < data.size()) {
+    auto ch = static_cast<unsigned char>(data[next++]);
+    escaped += "\\x";
+    escaped += hex_chars[ch >> 4];
+    escaped += hex_chars[ch & 0x0F];
+
+    // Copy the printable run up to the next escape in bulk.
+    auto run = findNonPrintableByte(data.data() + next, data.size() - next);
+    escaped.append(data, next, run);
+    next += run;
   }
 
-  // Only replace if any escapes were made.
-  if (needs_replacement) {
-    data = std::move(escaped);
-  }
+  data = std::move(escaped);
 }
 
 void escapeNonPrintableBytesEx(std::string& data) {
@@ -16,8 +16,11 @@
 #endif
 
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <osquery/core/flags.h>
@@ -35,6 +38,66 @@ HIDDEN_FLAG(
     "Defines the maximum size in bytes of a regex that can be used with the "
     "regex_match and regex_split functions");
 
+/// The most compiled patterns kept for each connection and function.
+const size_t kRegexCacheSize = 64;
+
+using RegexRef = std::shared_ptr<const std::regex>;
+
+/**
+ * @brief Compiled regular expressions keyed by their pattern.
+ *
+ * Each regex function owns a cache per connection, so the patterns of the
+ * scheduled queries are compiled once instead of for every row and run.
+ */
+class RegexCache {
+ public:
+  /// Compile the pattern or reuse it, throws std::regex_error.
+  RegexRef get(const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = patterns_.find(pattern);
+    if (it != patterns_.end()) {
+      return it->second;
+    }
+
+    auto regex = std::make_shared<const std::regex>(pattern);
+    if (patterns_.size() >= kRegexCacheSize) {
+      patterns_.clear();
+    }
+    patterns_.emplace(pattern, regex);
+    return regex;
+  }
+
+ private:
+  std::unordered_map<std::string, RegexRef> patterns_;
+  std::mutex mutex_;
+};
+
+/**
+ * @brief Get the compiled pattern of a function argument.
+ *
+ * The expression is also kept as auxiliary data, so a constant pattern is
+ * only looked up once per statement. Throws std::regex_error.
+ */
+static RegexRef getRegex(sqlite3_context* context,
+                         int arg,
+                         const std::string& pattern) {
+  auto* cached = static_cast<RegexRef*>(sqlite3_get_auxdata(context, arg));
+  if (cached != nullptr) {
+    return *cached;
+  }
+
+  auto* cache = static_cast<RegexCache*>(sqlite3_user_data(context));
+  auto regex = cache->get(pattern);
+  sqlite3_set_auxdata(context, arg, new RegexRef(regex), [](void* p) {
+    delete static_cast<RegexRef*>(p);
+  });
+  return regex;
+}
+
+static void deleteRegexCache(void* p) {
+  delete static_cast<RegexCache*>(p);
+}
+
 using SplitResult = std::vector<std::string>;
 using StringSplitFunction = std::function<SplitResult(
     const std::string& input, const std::string& tokens)>;
@@ -73,7 +136,8 @@ static SplitResult tokenSplit(const std::string& input,
  *   3. SELECT SPLIT(ip_address, "\.0", 0) from addresses;
  *      192.168
  */
-static SplitResult regexSplit(const std::string& input,
+static SplitResult regexSplit(sqlite3_context* context,
+                              const std::string& input,
                               const std::string& token) {
   // Split using the token as a regex to support multi-character tokens.
   // Exceptions are caught by the caller, as that's where the sql context is
@@ -83,9 +147,9 @@ static SplitResult regexSplit(const std::string& input,
     throw std::regex_error(std::regex_constants::error_complexity);
   }
 
-  std::regex pattern = std::regex(token);
+  auto pattern = getRegex(context, 1, token);
   std::sregex_token_iterator iter_begin(
-      input.begin(), input.end(), pattern, -1);
+      input.begin(), input.end(), *pattern, -1);
   std::sregex_token_iterator iter_end;
   std::copy(iter_begin, iter_end, std::back_inserter(result));
 
@@ -140,7 +204,13 @@ static void regexStringSplitFunc(sqlite3_context* context,
                                  int argc,
                                  sqlite3_value** argv) {
   try {
-    callStringSplitFunc(context, argc, argv, regexSplit);
+    callStringSplitFunc(
+        context,
+        argc,
+        argv,
+        [context](const std::string& input, const std::string& token) {
+          return regexSplit(context, input, token);
+        });
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -187,7 +257,8 @@ static void regexStringMatchFunc(sqlite3_context* context,
   }
 
   try {
-    isMatchFound = std::regex_search(input, results, std::regex(regex));
+    isMatchFound =
+        std::regex_search(input, results, *getRegex(context, 1, regex));
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -210,6 +281,43 @@ static void regexStringMatchFunc(sqlite3_context* context,
                       SQLITE_TRANSIENT);
 }
 
+/**
+ * @brief Implement the REGEXP operator, 'X REGEXP Y' calls regexp(Y, X).
+ */
+static void regexpFunc(sqlite3_context* context,
+                       int argc,
+                       sqlite3_value** argv) {
+  assert(argc == 2);
+  if (SQLITE_NULL == sqlite3_value_type(argv[0]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[1])) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  const std::string input(
+      reinterpret_cast<const char*>(sqlite3_value_text(argv[1])));
+  const std::string pattern(
+      reinterpret_cast<const char*>(sqlite3_value_text(argv[0])));
+  if (pattern.size() > FLAGS_regex_max_size) {
+    std::string error = "Invalid regex: too big, max size is " +
+                        std::to_string(FLAGS_regex_max_size) + " bytes";
+    LOG(INFO) << error;
+    sqlite3_result_error(context, error.c_str(), -1);
+    return;
+  }
+
+  RegexRef regex;
+  try {
+    regex = getRegex(context, 0, pattern);
+  } catch (const std::regex_error& e) {
+    LOG(INFO) << "Invalid regex: " << e.what();
+    sqlite3_result_error(context, "Invalid regex", -1);
+    return;
+  }
+
+  sqlite3_result_int(context, std::regex_search(input, *regex) ? 1 : 0);
+}
+
 /**
  * @brief Convert an IPv4 string address to decimal.
  */
@@ -247,14 +355,15 @@ void registerStringExtensions(sqlite3* db) {
                           tokenStringSplitFunc,
                           nullptr,
                           nullptr);
-  sqlite3_create_function(db,
-                          "regex_split",
-                          3,
-                          SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-                          nullptr,
-                          regexStringSplitFunc,
-                          nullptr,
-                          nullptr);
+  sqlite3_create_function_v2(db,
+                             "regex_split",
+                             3,
+                             SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                             new RegexCache(),
+                             regexStringSplitFunc,
+                             nullptr,
+                             nullptr,
+                             deleteRegexCache);
   sqlite3_create_function(db,
                           "inet_aton",
                           1,
@@ -263,13 +372,23 @@ void registerStringExtensions(sqlite3* db) {
                           ip4StringToDecimalFunc,
                           nullptr,
                           nullptr);
-  sqlite3_create_function(db,
-                          "regex_match",
-                          3,
-                          SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-                          nullptr,
-                          regexStringMatchFunc,
-                          nullptr,
-                          nullptr);
+  sqlite3_create_function_v2(db,
+                             "regexp",
+                             2,
+                             SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                             new RegexCache(),
+                             regexpFunc,
+                             nullptr,
+                             nullptr,
+                             deleteRegexCache);
+  sqlite3_create_function_v2(db,
+                             "regex_match",
+                             3,
+                             SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                             new RegexCache(),
+                             regexStringMatchFunc,
+                             nullptr,
+                             nullptr,
+                             deleteRegexCache);
 }
 } // namespace osquery
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include "osquery/sql/sqlite_util.h"
 #include "osquery/sql/virtual_table.h"
 
@@ -16,6 +18,7 @@
 
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
@@ -39,6 +42,26 @@ FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     statement_cache_size,
+     64,
+     "Number of prepared SQL statements to cache, 0 disables the cache");
+
+FLAG(uint32,
+     sqlite_lookaside_slots,
+     256,
+     "Lookaside slots each SQLite connection reuses for small allocations");
+
+FLAG(uint32,
+     sqlite_connection_pool_size,
+     4,
+     "Transient SQLite databases kept for concurrent queries, 0 disables it");
+
+FLAG(uint32,
+     sqlite_page_cache_pages,
+     16,
+     "Pages each SQLite connection allocates up front for its page cache");
+
 using OpReg = QueryPlanner::Opcode::Register;
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
@@ -71,6 +94,12 @@ const std::map<std::string, std::string> kMemoryDBSettings = {
 };
 // clang-format on
 
+/// The size of each lookaside slot, the SQLite default.
+const int kSQLiteLookasideSlotSize{1200};
+
+/// The page size of the in-memory databases, the SQLite default.
+const int kSQLitePageSize{4096};
+
 #define OpComparator(x)                                                        \
   { x, QueryPlanner::Opcode(OpReg::P2, INTEGER_TYPE) }
 #define Arithmetic(x)                                                          \
@@ -181,10 +210,17 @@ Status SQLiteSQLPlugin::getQueryTables(const std::string& query,
   return Status(0);
 }
 
-SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
+SQLInternal::SQLInternal(const std::string& query,
+                         bool use_cache,
+                         bool columnar)
+    : columnar_(columnar) {
   auto dbc = SQLiteDBManager::get();
   dbc->useCache(use_cache);
-  status_ = queryInternal(query, resultsTyped_, dbc);
+  if (columnar_) {
+    status_ = queryInternal(query, resultsBatch_, dbc);
+  } else {
+    status_ = queryInternal(query, resultsTyped_, dbc);
+  }
 
   // One of the advantages of using SQLInternal (aside from the Registry-bypass)
   // is the ability to "deep-inspect" the table attributes and actions.
@@ -194,9 +230,23 @@ SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
 }
 
 QueryDataTyped& SQLInternal::rowsTyped() {
+  if (columnar_) {
+    resultsTyped_ = resultsBatch_.toRows();
+    resultsBatch_.clear();
+    columnar_ = false;
+  }
   return resultsTyped_;
 }
 
+QueryBatch& SQLInternal::rowsBatch() {
+  if (!columnar_) {
+    resultsBatch_ = QueryBatch::fromRows(resultsTyped_);
+    resultsTyped_.clear();
+    columnar_ = true;
+  }
+  return resultsBatch_;
+}
+
 const Status& SQLInternal::getStatus() const {
   return status_;
 }
@@ -225,6 +275,12 @@ class StringEscaperVisitor : public boost::static_visitor<> {
 
 void SQLInternal::escapeResults() {
   StringEscaperVisitor visitor;
+  if (columnar_) {
+    // Each distinct string of the batch is escaped once.
+    resultsBatch_.transformStrings(escapeNonPrintableBytesEx);
+    return;
+  }
+
   for (auto& rowTyped : resultsTyped_) {
     for (auto& column : rowTyped) {
       boost::apply_visitor(visitor, column.second);
@@ -248,6 +304,9 @@ Status SQLiteSQLPlugin::attach(const std::string& name) {
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
 
+  // Pooled transient databases do not have the new table.
+  SQLiteDBManager::invalidatePool();
+
   // Attach as an extension, allowing read/write tables
   return attachTableInternal(name, statement, dbc, is_extension);
 }
@@ -257,6 +316,7 @@ Status SQLiteSQLPlugin::detach(const std::string& name) {
   // primary database. To allow this, getConnection can explicitly request the
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
+  SQLiteDBManager::invalidatePool();
   return detachTableInternal(name, dbc);
 }
 
@@ -265,9 +325,8 @@ SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
   if (lock_.owns_lock()) {
     primary_ = true;
   } else {
+    // The manager provides a pooled or new transient database.
     db_ = nullptr;
-    VLOG(1) << "DBManager contention: opening transient SQLite database";
-    init();
   }
 }
 
@@ -298,9 +357,47 @@ int sqliteAuthorizer(void* userData,
   return SQLITE_DENY;
 }
 
+/**
+ * @brief Describe the tables and views of a database.
+ *
+ * Queries may create tables and views, a pooled database is only reused if
+ * its schema is the one it had once its virtual tables were attached.
+ */
+static std::string getSchemaFingerprint(sqlite3* db) {
+  sqlite3_stmt* stmt = nullptr;
+  auto rc = sqlite3_prepare_v2(
+      db,
+      "SELECT count(*), total(length(sql)) FROM (SELECT sql FROM sqlite_master "
+      "UNION ALL SELECT sql FROM sqlite_temp_master)",
+      -1,
+      &stmt,
+      nullptr);
+  if (rc != SQLITE_OK) {
+    return "";
+  }
+
+  std::string fingerprint;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    fingerprint = std::to_string(sqlite3_column_int64(stmt, 0)) + ":" +
+                  std::to_string(sqlite3_column_int64(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+  return fingerprint;
+}
+
 static inline void openOptimized(sqlite3*& db) {
   sqlite3_open(":memory:", &db);
 
+  // Statements and cursors allocate small objects from the lookaside slots,
+  // which are allocated once with the connection and reused by each query.
+  if (FLAGS_sqlite_lookaside_slots > 0) {
+    sqlite3_db_config(db,
+                      SQLITE_DBCONFIG_LOOKASIDE,
+                      nullptr,
+                      kSQLiteLookasideSlotSize,
+                      static_cast<int>(FLAGS_sqlite_lookaside_slots));
+  }
+
   std::string settings;
   for (const auto& setting : kMemoryDBSettings) {
     settings += "PRAGMA " + setting.first + "=" + setting.second + "; ";
@@ -356,6 +453,18 @@ bool SQLiteDBInstance::tableCalled(VirtualTableContent const& table) {
   return (affected_tables_.count(table.name) > 0);
 }
 
+std::shared_ptr<QueryScope> SQLiteDBInstance::getQueryScope() {
+  if (isPrimary() && !managed_) {
+    // Similarly to clearAffectedTables, the connection may be forwarded.
+    return SQLiteDBManager::getConnection(true)->getQueryScope();
+  }
+
+  if (query_scope_ == nullptr) {
+    query_scope_ = std::make_shared<QueryScope>();
+  }
+  return query_scope_;
+}
+
 TableAttributes SQLiteDBInstance::getAttributes() const {
   const SQLiteDBInstance* rdbc = this;
   if (isPrimary() && !managed_) {
@@ -370,6 +479,41 @@ TableAttributes SQLiteDBInstance::getAttributes() const {
   return attributes;
 }
 
+void SQLiteDBInstance::addPlannedTable(
+    std::shared_ptr<VirtualTableContent> table, size_t index) {
+  planned_tables_.push_back(std::make_pair(std::move(table), index));
+}
+
+std::vector<VirtualTablePlan> SQLiteDBInstance::takePlans() {
+  if (isPrimary() && !managed_) {
+    // Similarly to clearAffectedTables, the connection may be forwarded.
+    return SQLiteDBManager::getConnection(true)->takePlans();
+  }
+
+  std::vector<VirtualTablePlan> plans;
+  for (const auto& planned : planned_tables_) {
+    const auto& content = planned.first;
+    VirtualTablePlan plan;
+    plan.content = content;
+    plan.index = planned.second;
+    if (content->constraints.count(plan.index) > 0) {
+      plan.constraints = content->constraints.at(plan.index);
+    }
+    if (content->colsUsed.count(plan.index) > 0) {
+      plan.columns = content->colsUsed.at(plan.index);
+    }
+    if (content->colsUsedBitsets.count(plan.index) > 0) {
+      plan.columns_bitset = content->colsUsedBitsets.at(plan.index);
+    }
+    if (content->hints.count(plan.index) > 0) {
+      plan.hints = content->hints.at(plan.index);
+    }
+    plans.push_back(std::move(plan));
+  }
+  planned_tables_.clear();
+  return plans;
+}
+
 void SQLiteDBInstance::clearAffectedTables() {
   if (isPrimary() && !managed_) {
     // A primary instance must forward clear requests to the DB manager's
@@ -383,22 +527,70 @@ void SQLiteDBInstance::clearAffectedTables() {
     table.second->cache.clear();
     table.second->colsUsed.clear();
     table.second->colsUsedBitsets.clear();
+    table.second->hints.clear();
+    table.second->batchedScans.clear();
   }
   // Since the affected tables are cleared, there are no more affected tables.
   // There is no concept of compounding tables between queries.
   affected_tables_.clear();
+  planned_tables_.clear();
+  query_scope_.reset();
   use_cache_ = false;
 }
 
 SQLiteDBInstance::~SQLiteDBInstance() {
-  if (!isPrimary() && db_ != nullptr) {
+  if (!isPrimary() && db_ != nullptr && pooled_) {
+    SQLiteDBManager::instance().releasePooled(*this);
+  } else if (!isPrimary() && db_ != nullptr) {
     sqlite3_close(db_);
   } else {
     db_ = nullptr;
   }
 }
 
+static void configureSQLiteMemory() {
+  if (FLAGS_sqlite_page_cache_pages == 0) {
+    return;
+  }
+
+  // Each connection allocates its page cache lines in bulk when it opens.
+  int header = 0;
+  auto rc = sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &header);
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_config(SQLITE_CONFIG_PAGECACHE,
+                        nullptr,
+                        kSQLitePageSize + header,
+                        static_cast<int>(FLAGS_sqlite_page_cache_pages));
+  }
+  if (rc != SQLITE_OK) {
+    // SQLite was initialized before the manager, keep its default cache.
+    VLOG(1) << "Cannot configure the SQLite page cache: "
+            << getStringForSQLiteReturnCode(rc);
+  }
+}
+
+/// Report SQLite's heap, shared by every connection, and its page cache.
+static void reportSQLiteMemory(std::vector<SubsystemMemory>& memory) {
+  SubsystemMemory heap;
+  heap.name = "sqlite_heap";
+  heap.bytes = sqlite3_memory_used();
+  memory.push_back(std::move(heap));
+
+  sqlite3_int64 pages = 0;
+  sqlite3_int64 highwater = 0;
+  if (sqlite3_status64(SQLITE_STATUS_PAGECACHE_USED, &pages, &highwater, 0) ==
+      SQLITE_OK) {
+    SubsystemMemory page_cache;
+    page_cache.name = "sqlite_page_cache";
+    page_cache.bytes = pages * kSQLitePageSize;
+    page_cache.items = pages;
+    memory.push_back(std::move(page_cache));
+  }
+}
+
 SQLiteDBManager::SQLiteDBManager() : db_(nullptr) {
+  configureSQLiteMemory();
+  registerMemoryReporter("sql", reportSQLiteMemory);
   sqlite3_soft_heap_limit64(1);
   setDisabledTables(Flag::getValue("disable_tables"));
   setEnabledTables(Flag::getValue("enable_tables"));
@@ -442,12 +634,15 @@ bool SQLiteDBManager::isDisabled(const std::string& table_name) {
 
 void SQLiteDBManager::resetPrimary() {
   auto& self = instance();
+  invalidatePool();
 
   WriteLock connection_lock(self.mutex_);
   self.connection_.reset();
 
   {
     WriteLock create_lock(self.create_mutex_);
+    // Statements must be finalized before their database is closed.
+    self.statement_cache_.invalidate();
     sqlite3_close(self.db_);
     self.db_ = nullptr;
   }
@@ -489,21 +684,174 @@ SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
 
   // Create a 'database connection' for the managed database instance.
   auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
-  if (!instance->isPrimary()) {
+  if (!instance->isPrimary() && !self.acquirePooled(*instance)) {
+    VLOG(1) << "DBManager contention: opening transient SQLite database";
+    {
+      WriteLock pool_lock(self.pool_mutex_);
+      instance->pool_generation_ = self.pool_generation_;
+    }
+
+    instance->init();
     attachVirtualTables(instance);
+    instance->pool_schema_ = getSchemaFingerprint(instance->db());
+    instance->pooled_ = true;
   }
 
   return instance;
 }
 
+bool SQLiteDBManager::acquirePooled(SQLiteDBInstance& instance) {
+  WriteLock lock(pool_mutex_);
+  if (pool_.empty()) {
+    return false;
+  }
+
+  auto& pooled = pool_.back();
+  instance.db_ = pooled.db;
+  instance.pool_generation_ = pooled.generation;
+  instance.pool_schema_ = std::move(pooled.schema);
+  instance.pooled_ = true;
+  pool_.pop_back();
+  return true;
+}
+
+void SQLiteDBManager::releasePooled(SQLiteDBInstance& instance) {
+  auto db = instance.db_;
+  instance.db_ = nullptr;
+
+  // A database is reset before it is reused: it must not have statements or
+  // a transaction left, nor tables or views created by a query.
+  bool reusable = sqlite3_next_stmt(db, nullptr) == nullptr &&
+                  sqlite3_get_autocommit(db) != 0 &&
+                  getSchemaFingerprint(db) == instance.pool_schema_;
+
+  if (reusable) {
+    sqlite3_db_release_memory(db);
+
+    WriteLock lock(pool_mutex_);
+    if (instance.pool_generation_ == pool_generation_ &&
+        pool_.size() < FLAGS_sqlite_connection_pool_size) {
+      pool_.push_back({db, instance.pool_generation_, instance.pool_schema_});
+      return;
+    }
+  }
+
+  sqlite3_close(db);
+}
+
+void SQLiteDBManager::invalidatePool() {
+  auto& self = instance();
+
+  std::vector<PooledDatabase> pool;
+  {
+    WriteLock lock(self.pool_mutex_);
+    self.pool_generation_++;
+    pool.swap(self.pool_);
+  }
+
+  for (auto& pooled : pool) {
+    sqlite3_close(pooled.db);
+  }
+}
+
+size_t SQLiteDBManager::poolSize() {
+  auto& self = instance();
+  WriteLock lock(self.pool_mutex_);
+  return self.pool_.size();
+}
+
 SQLiteDBManager::~SQLiteDBManager() {
   connection_ = nullptr;
+  statement_cache_.invalidate();
+  for (auto& pooled : pool_) {
+    sqlite3_close(pooled.db);
+  }
+  pool_.clear();
   if (db_ != nullptr) {
     sqlite3_close(db_);
     db_ = nullptr;
   }
 }
 
+CachedStatement::~CachedStatement() {
+  if (statement != nullptr) {
+    sqlite3_finalize(statement);
+  }
+}
+
+CachedStatementRef SQLiteStatementCache::acquire(sqlite3* db,
+                                                 const std::string& query) {
+  WriteLock lock(mutex_);
+  auto it = index_.find(query);
+  if (it == index_.end()) {
+    stats_.misses++;
+    return nullptr;
+  }
+
+  auto statement = std::move(*it->second);
+  statements_.erase(it->second);
+  index_.erase(it);
+  if (statement->db != db || statement->generation != generation_) {
+    stats_.misses++;
+    return nullptr;
+  }
+
+  stats_.hits++;
+  return statement;
+}
+
+void SQLiteStatementCache::release(CachedStatementRef statement) {
+  // Resetting closes the statement's virtual table cursors.
+  auto rc = sqlite3_reset(statement->statement);
+  auto reprepares = sqlite3_stmt_status(
+      statement->statement, SQLITE_STMTSTATUS_REPREPARE, 0);
+  if (rc != SQLITE_OK || reprepares != statement->reprepares) {
+    // SQLite planned the statement again, the recorded scan plans are stale.
+    return;
+  }
+
+  WriteLock lock(mutex_);
+  if (statement->generation != generation_ ||
+      FLAGS_statement_cache_size == 0 || index_.count(statement->query) > 0) {
+    return;
+  }
+
+  while (statements_.size() >= FLAGS_statement_cache_size) {
+    index_.erase(statements_.back()->query);
+    statements_.pop_back();
+    stats_.evictions++;
+  }
+
+  auto query = statement->query;
+  statements_.push_front(std::move(statement));
+  index_[query] = statements_.begin();
+}
+
+size_t SQLiteStatementCache::generation() const {
+  WriteLock lock(mutex_);
+  return generation_;
+}
+
+void SQLiteStatementCache::invalidate() {
+  WriteLock lock(mutex_);
+  generation_++;
+  if (!statements_.empty()) {
+    stats_.invalidations++;
+  }
+  index_.clear();
+  statements_.clear();
+}
+
+size_t SQLiteStatementCache::size() const {
+  WriteLock lock(mutex_);
+  return statements_.size();
+}
+
+StatementCacheStats SQLiteStatementCache::stats() const {
+  WriteLock lock(mutex_);
+  return stats_;
+}
+
 QueryPlanner::QueryPlanner(const std::string& query,
                            const SQLiteDBInstanceRef& instance) {
   QueryData plan;
@@ -643,28 +991,148 @@ Status readRows(sqlite3_stmt* prepared_statement,
     } while (SQLITE_ROW == rc);
   }
   if (rc != SQLITE_DONE) {
-    auto s = Status::failure(sqlite3_errmsg(instance->db()));
-    sqlite3_finalize(prepared_statement);
-    return s;
+    return Status::failure(sqlite3_errmsg(instance->db()));
   }
 
-  rc = sqlite3_finalize(prepared_statement);
-  if (rc != SQLITE_OK) {
+  return Status::success();
+}
+
+Status readRows(sqlite3_stmt* prepared_statement,
+                QueryBatch& results,
+                const SQLiteDBInstanceRef& instance) {
+  if (prepared_statement == nullptr) {
+    return Status::success();
+  }
+  int rc = sqlite3_step(prepared_statement);
+  if (SQLITE_ROW == rc) {
+    // Map each statement column into the batch column dictionary once.
+    int num_columns = sqlite3_column_count(prepared_statement);
+    std::vector<size_t> indexes;
+    indexes.reserve(num_columns);
+    for (int i = 0; i < num_columns; i++) {
+      indexes.push_back(
+          results.addColumn(sqlite3_column_name(prepared_statement, i)));
+    }
+
+    // Statements may repeat a column name, or follow a statement with more
+    // columns. Both require the sparse append path.
+    std::vector<size_t> distinct(indexes);
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                   distinct.end());
+    bool dense = distinct.size() == results.columns().size();
+
+    do {
+      std::vector<RowDataTyped> cells(results.columns().size());
+      for (int i = 0; i < num_columns; i++) {
+        auto& cell = cells[indexes[i]];
+        switch (sqlite3_column_type(prepared_statement, i)) {
+        case SQLITE_INTEGER:
+          cell = static_cast<long long>(
+              sqlite3_column_int64(prepared_statement, i));
+          break;
+        case SQLITE_FLOAT:
+          cell = sqlite3_column_double(prepared_statement, i);
+          break;
+        case SQLITE_NULL:
+          cell = FLAGS_nullvalue;
+          break;
+        default:
+          cell = std::string(reinterpret_cast<const char*>(
+              sqlite3_column_text(prepared_statement, i)));
+        }
+      }
+
+      if (dense) {
+        results.appendRow(std::move(cells));
+      } else {
+        RowTyped row;
+        for (auto index : distinct) {
+          row[results.columns()[index]] = std::move(cells[index]);
+        }
+        results.appendRow(row);
+      }
+      rc = sqlite3_step(prepared_statement);
+    } while (SQLITE_ROW == rc);
+  }
+  if (rc != SQLITE_DONE) {
     return Status::failure(sqlite3_errmsg(instance->db()));
   }
 
   return Status::success();
 }
 
-Status queryInternal(const std::string& query,
-                     QueryDataTyped& results,
-                     const SQLiteDBInstanceRef& instance) {
+namespace {
+
+/// SQLite VM steps between calls to a query interrupt check.
+const int kInterruptCheckSteps{10000};
+
+thread_local QueryInterruptCheck* kQueryInterruptCheck{nullptr};
+
+int interruptProgressHandler(void*) {
+  return QueryInterruptCheck::interrupted() ? 1 : 0;
+}
+
+} // namespace
+
+QueryInterruptCheck::QueryInterruptCheck(std::function<Status()> check)
+    : check_(std::move(check)), previous_(kQueryInterruptCheck) {
+  kQueryInterruptCheck = this;
+}
+
+QueryInterruptCheck::~QueryInterruptCheck() {
+  kQueryInterruptCheck = previous_;
+}
+
+bool QueryInterruptCheck::interrupted() {
+  auto check = kQueryInterruptCheck;
+  if (check == nullptr) {
+    return false;
+  }
+
+  if (check->status_.ok()) {
+    check->status_ = check->check_();
+  }
+  return !check->status_.ok();
+}
+
+Status QueryInterruptCheck::current() {
+  if (kQueryInterruptCheck == nullptr) {
+    return Status::success();
+  }
+  return kQueryInterruptCheck->status_;
+}
+
+static void restorePlans(const std::vector<VirtualTablePlan>& plans) {
+  for (const auto& plan : plans) {
+    plan.content->constraints[plan.index] = plan.constraints;
+    plan.content->colsUsed[plan.index] = plan.columns;
+    plan.content->colsUsedBitsets[plan.index] = plan.columns_bitset;
+    plan.content->hints[plan.index] = plan.hints;
+  }
+}
+
+static bool onlyWhitespace(const char* sql) {
+  while (isspace(sql[0])) {
+    sql++;
+  }
+  return sql[0] == '\0';
+}
+
+template <typename T>
+static Status queryInternalImpl(const std::string& query,
+                                T& results,
+                                const SQLiteDBInstanceRef& instance) {
   sqlite3_stmt* prepared_statement{nullptr}; /* Statement to execute. */
 
   int rc = SQLITE_OK; /* Return Code */
   const char* leftover_sql = nullptr; /* Tail of unprocessed SQL */
   const char* sql = query.c_str(); /* SQL to be processed */
 
+  // Single statement queries on the primary database may reuse a statement.
+  auto& cache = SQLiteDBManager::statementCache();
+  bool cacheable = instance->isPrimary() && FLAGS_statement_cache_size > 0;
+
   /* The big while loop.  One iteration per statement */
   while ((sql[0] != '\0') && (SQLITE_OK == rc)) {
     const auto lock = instance->attachLock();
@@ -673,25 +1141,91 @@ Status queryInternal(const std::string& query,
     while (isspace(sql[0])) {
       sql++;
     }
-    rc = sqlite3_prepare_v2(
-        instance->db(), sql, -1, &prepared_statement, &leftover_sql);
-    if (rc != SQLITE_OK) {
-      Status s = Status::failure(sqlite3_errmsg(instance->db()));
-      sqlite3_finalize(prepared_statement);
-      return s;
+
+    CachedStatementRef cached;
+    if (cacheable) {
+      cached = cache.acquire(instance->db(), query);
     }
 
+    if (cached != nullptr) {
+      restorePlans(cached->plans);
+      prepared_statement = cached->statement;
+      leftover_sql = query.c_str() + query.size();
+    } else {
+      auto generation = cache.generation();
+      if (cacheable) {
+        // Only record the scan plans of this statement.
+        instance->takePlans();
+      }
+
+      rc = sqlite3_prepare_v2(
+          instance->db(), sql, -1, &prepared_statement, &leftover_sql);
+      if (rc != SQLITE_OK) {
+        Status s = Status::failure(sqlite3_errmsg(instance->db()));
+        sqlite3_finalize(prepared_statement);
+        return s;
+      }
+
+      if (cacheable && prepared_statement != nullptr &&
+          onlyWhitespace(leftover_sql)) {
+        cached = std::make_unique<CachedStatement>();
+        cached->query = query;
+        cached->db = instance->db();
+        cached->statement = prepared_statement;
+        cached->generation = generation;
+        cached->reprepares = sqlite3_stmt_status(
+            prepared_statement, SQLITE_STMTSTATUS_REPREPARE, 0);
+        cached->plans = instance->takePlans();
+      }
+    }
+
+    // The connection may be shared, only install the handler while stepping.
+    bool checked = kQueryInterruptCheck != nullptr;
+    if (checked) {
+      sqlite3_progress_handler(instance->db(),
+                               kInterruptCheckSteps,
+                               interruptProgressHandler,
+                               nullptr);
+    }
     Status s = readRows(prepared_statement, results, instance);
+    if (checked) {
+      sqlite3_progress_handler(instance->db(), 0, nullptr, nullptr);
+      if (!s.ok() && !QueryInterruptCheck::current().ok()) {
+        s = QueryInterruptCheck::current();
+      }
+    }
+    if (cached != nullptr) {
+      cache.release(std::move(cached));
+    } else if (prepared_statement != nullptr) {
+      rc = sqlite3_finalize(prepared_statement);
+      if (s.ok() && rc != SQLITE_OK) {
+        s = Status::failure(sqlite3_errmsg(instance->db()));
+      }
+    }
     if (!s.ok()) {
       return s;
     }
 
     sql = leftover_sql;
+    // Only the first statement of a query is looked up.
+    cacheable = false;
   } /* end while */
   sqlite3_db_release_memory(instance->db());
   return Status::success();
 }
 
+Status queryInternal(const std::string& query,
+                     QueryDataTyped& results,
+                     const SQLiteDBInstanceRef& instance) {
+  return queryInternalImpl(query, results, instance);
+}
+
+Status queryInternal(const std::string& query,
+                     QueryBatch& results,
+                     const SQLiteDBInstanceRef& instance) {
+  return queryInternalImpl(query, results, instance);
+}
+
 Status getQueryColumnsInternal(const std::string& q,
                                TableColumns& columns,
                                const SQLiteDBInstanceRef& instance) {
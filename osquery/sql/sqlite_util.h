@@ -10,9 +10,13 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
+#include <list>
 #include <map>
 #include <mutex>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <sqlite3.h>
 
@@ -79,6 +83,98 @@ const std::unordered_set<std::string> kAllowedSQLitePragmas = {
 
 class SQLiteDBManager;
 
+/**
+ * @brief The xBestIndex state of a virtual table scan within a statement.
+ *
+ * Virtual tables record constraints and used columns per index number while
+ * a statement is prepared, and this state is cleared after every query. A
+ * cached statement keeps a copy so it can be restored before the statement is
+ * stepped again.
+ */
+struct VirtualTablePlan {
+  std::shared_ptr<VirtualTableContent> content;
+  size_t index{0};
+  ConstraintSet constraints;
+  UsedColumns columns;
+  UsedColumnsBitset columns_bitset;
+  QueryPlanHints hints;
+};
+
+/// Counters describing the use of the prepared statement cache.
+struct StatementCacheStats {
+  size_t hits{0};
+  size_t misses{0};
+  size_t evictions{0};
+  size_t invalidations{0};
+};
+
+/// A prepared statement owned by, or checked out of, the statement cache.
+struct CachedStatement : private boost::noncopyable {
+  ~CachedStatement();
+
+  /// The complete query text, the cache key.
+  std::string query;
+
+  /// The database the statement was prepared against.
+  sqlite3* db{nullptr};
+
+  sqlite3_stmt* statement{nullptr};
+
+  /// The cache generation when the statement was prepared.
+  size_t generation{0};
+
+  /// The SQLite re-prepare count when the statement was prepared.
+  int reprepares{0};
+
+  /// Virtual table scan plans to restore before each execution.
+  std::vector<VirtualTablePlan> plans;
+};
+
+using CachedStatementRef = std::unique_ptr<CachedStatement>;
+
+/**
+ * @brief A cache of prepared statements for the primary database.
+ *
+ * Scheduled and distributed queries run the same text many times, caching the
+ * statement skips parsing, planning and xBestIndex negotiation. Statements are
+ * checked out while they run such that a nested query with the same text
+ * prepares its own. Attaching or detaching a table invalidates the cache.
+ */
+class SQLiteStatementCache : private boost::noncopyable {
+ public:
+  /// Check out the statement prepared for a query, nullptr on a miss.
+  CachedStatementRef acquire(sqlite3* db, const std::string& query);
+
+  /// Return a statement once its results were read, it is reset or dropped.
+  void release(CachedStatementRef statement);
+
+  /// The current generation, statements from a previous one are dropped.
+  size_t generation() const;
+
+  /// Finalize every cached statement.
+  void invalidate();
+
+  /// The number of cached statements.
+  size_t size() const;
+
+  /// Access a copy of the cache counters.
+  StatementCacheStats stats() const;
+
+ private:
+  /// Cached statements, most recently used first.
+  std::list<CachedStatementRef> statements_;
+
+  /// Lookup from query text to the statement's position in statements_.
+  std::unordered_map<std::string, std::list<CachedStatementRef>::iterator>
+      index_;
+
+  size_t generation_{0};
+
+  StatementCacheStats stats_;
+
+  mutable Mutex mutex_;
+};
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -120,9 +216,19 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Clear per-query state of a table affected by the use of this instance.
   void clearAffectedTables();
 
+  /// Allow a virtual table implementation to record a scan plan (xBestIndex).
+  void addPlannedTable(std::shared_ptr<VirtualTableContent> table,
+                       size_t index);
+
+  /// Copy, and stop tracking, the scan plans recorded since the last call.
+  std::vector<VirtualTablePlan> takePlans();
+
   /// Check if a virtual table had been called already.
   bool tableCalled(VirtualTableContent const& table);
 
+  /// The state shared by the tables of the current query.
+  std::shared_ptr<QueryScope> getQueryScope();
+
   /// Request that virtual tables use a warm cache for their results.
   void useCache(bool use_cache);
 
@@ -177,6 +283,22 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, std::shared_ptr<VirtualTableContent>> affected_tables_;
 
+  /// Tables and index numbers planned since the last plans were taken.
+  std::vector<std::pair<std::shared_ptr<VirtualTableContent>, size_t>>
+      planned_tables_;
+
+  /// State shared by the tables of the current query, released with it.
+  std::shared_ptr<QueryScope> query_scope_;
+
+  /// A transient database returned to the manager's pool when released.
+  bool pooled_{false};
+
+  /// The pool generation the transient database's tables were attached in.
+  size_t pool_generation_{0};
+
+  /// The schema of the transient database once its tables were attached.
+  std::string pool_schema_;
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
@@ -234,6 +356,17 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static void resetPrimary();
 
+  /**
+   * @brief Close the pooled transient databases.
+   *
+   * Pooled databases have the tables attached when they were created, they
+   * are dropped when a table is attached or detached.
+   */
+  static void invalidatePool();
+
+  /// The number of idle transient databases in the pool.
+  static size_t poolSize();
+
   /**
    * @brief Check if `table_name` is disabled.
    *
@@ -246,6 +379,11 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static bool isDisabled(const std::string& table_name);
 
+  /// Access the prepared statement cache of the primary database.
+  static SQLiteStatementCache& statementCache() {
+    return instance().statement_cache_;
+  }
+
  protected:
   SQLiteDBManager();
   virtual ~SQLiteDBManager();
@@ -267,6 +405,9 @@ class SQLiteDBManager : private boost::noncopyable {
   /// A write mutex for initializing the primary database.
   Mutex create_mutex_;
 
+  /// Prepared statements for the primary database.
+  SQLiteStatementCache statement_cache_;
+
   /// Member variable to hold set of disabled tables.
   std::unordered_set<std::string> disabled_tables_;
 
@@ -282,6 +423,28 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /// Give a transient instance an idle pooled database, false if none.
+  bool acquirePooled(SQLiteDBInstance& instance);
+
+  /// Return the database of a transient instance, closed if not reusable.
+  void releasePooled(SQLiteDBInstance& instance);
+
+  /// An idle transient database with its virtual tables attached.
+  struct PooledDatabase {
+    sqlite3* db{nullptr};
+    size_t generation{0};
+    std::string schema;
+  };
+
+  /// Transient databases kept for contended connections.
+  std::vector<PooledDatabase> pool_;
+
+  /// Incremented when tables change, older databases are not reused.
+  size_t pool_generation_{0};
+
+  /// Protects the pool.
+  Mutex pool_mutex_;
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
@@ -358,6 +521,36 @@ class QueryPlanner : private boost::noncopyable {
 /// Specific SQLite opcodes that change column/expression type.
 extern const std::map<std::string, QueryPlanner::Opcode> kSQLOpcodes;
 
+/**
+ * @brief Cooperatively interrupt the queries executing on a thread.
+ *
+ * While an instance is in scope, queries executing on the constructing thread
+ * call the check every few thousand SQLite VM steps and before each table
+ * scan. The first failed check interrupts the query, which then fails with
+ * the check's message.
+ */
+class QueryInterruptCheck : private boost::noncopyable {
+ public:
+  explicit QueryInterruptCheck(std::function<Status()> check);
+  ~QueryInterruptCheck();
+
+  /// The failure that interrupted a query, success if none did.
+  const Status& getStatus() const {
+    return status_;
+  }
+
+  /// Run the calling thread's check, true if the query should stop.
+  static bool interrupted();
+
+  /// The failure of the calling thread's check, success if none failed.
+  static Status current();
+
+ private:
+  std::function<Status()> check_;
+  Status status_;
+  QueryInterruptCheck* previous_{nullptr};
+};
+
 /**
  * @brief SQLite Internal: Execute a query on a specific database
  *
@@ -392,6 +585,32 @@ Status queryInternal(const std::string& q,
                      QueryData& results,
                      const SQLiteDBInstanceRef& instance);
 
+/**
+ * @brief SQLite Internal: Execute a query and emit columnar results.
+ *
+ * @param q the query to execute
+ * @param results The QueryBatch to emit rows into on query success.
+ * @param db the SQLite3 database to execute query q against
+ *
+ * @return A status indicating SQL query results.
+ */
+Status queryInternal(const std::string& q,
+                     QueryBatch& results,
+                     const SQLiteDBInstanceRef& instance);
+
+/**
+ * @brief SQLite Internal: Step a prepared statement and emit its rows.
+ *
+ * @param prepared_statement the statement to step, may be nullptr.
+ * @param results The QueryBatch to emit rows into.
+ * @param instance the database the statement was prepared on.
+ *
+ * @return A status indicating SQL query results.
+ */
+Status readRows(sqlite3_stmt* prepared_statement,
+                QueryBatch& results,
+                const SQLiteDBInstanceRef& instance);
+
 /**
  * @brief SQLite Intern: Analyze a query, providing information about the
  * result columns
@@ -422,17 +641,33 @@ class SQLInternal : private only_movable {
    *
    * @param query An osquery SQL query.
    * @param use_cache [optional] Set true to use the query cache.
+   * @param columnar [optional] Set true to collect results as a QueryBatch.
    */
-  explicit SQLInternal(const std::string& query, bool use_cache = false);
+  explicit SQLInternal(const std::string& query,
+                       bool use_cache = false,
+                       bool columnar = false);
 
  public:
   /**
    * @brief Const accessor for the rows returned by the query.
    *
+   * When the results were collected in columnar form they are materialized
+   * into rows on first access.
+   *
    * @return A QueryDataTyped object of the query results.
    */
   QueryDataTyped& rowsTyped();
 
+  /**
+   * @brief Accessor for the columnar results returned by the query.
+   *
+   * When the results were collected as rows they are converted on first
+   * access.
+   *
+   * @return A QueryBatch object of the query results.
+   */
+  QueryBatch& rowsBatch();
+
   const Status& getStatus() const;
 
   /**
@@ -455,6 +690,12 @@ class SQLInternal : private only_movable {
   /// The internal member which holds the typed results of the query.
   QueryDataTyped resultsTyped_;
 
+  /// The internal member which holds the columnar results of the query.
+  QueryBatch resultsBatch_;
+
+  /// True if the query results were collected into resultsBatch_.
+  bool columnar_{false};
+
   /// The internal member which holds the status of the query.
   Status status_;
   /// Before completing the execution, store a check for EVENT_BASED.
@@ -116,6 +116,10 @@ TEST_F(SQLTests, test_sql_escape) {
   input = "The quick brown fox jumps over the lazy dog.";
   escapeNonPrintableBytesEx(input);
   EXPECT_EQ(input, "The quick brown fox jumps over the lazy dog.");
+
+  input = "The quick brown fox\tjumps over the lazy dog.\n";
+  escapeNonPrintableBytesEx(input);
+  EXPECT_EQ(input, "The quick brown fox\\x09jumps over the lazy dog.\\x0A");
 }
 
 TEST_F(SQLTests, test_sql_base64_encode) {
@@ -212,6 +216,20 @@ TEST_F(SQLTests, test_regex_match_complex) {
   EXPECT_EQ(d[0]["t3"], "");
 }
 
+TEST_F(SQLTests, test_regex_match_per_row_patterns) {
+  QueryData d;
+
+  // Patterns that vary per row must not reuse another row's expression.
+  query(
+      "with patterns(p) as (values ('(l+)o'), ('(w)o'), ('(l+)o')) \
+       select regex_match('hello world', p, 1) as t from patterns",
+      d);
+  ASSERT_EQ(d.size(), 3U);
+  EXPECT_EQ(d[0]["t"], "ll");
+  EXPECT_EQ(d[1]["t"], "w");
+  EXPECT_EQ(d[2]["t"], "ll");
+}
+
 TEST_F(SQLTests, test_regex_match_fileextract) {
   QueryData d;
 
@@ -265,6 +283,29 @@ TEST_F(SQLTests, test_regex_match_too_big) {
             0);
 }
 
+/*
+ * regexp
+ */
+
+TEST_F(SQLTests, test_regexp_operator) {
+  QueryData d;
+  query(
+      "select 'hello world' REGEXP '^hel+o' as t0, \
+              'hello world' REGEXP 'z+' as t1, \
+              NULL REGEXP 'a' as t2",
+      d);
+  ASSERT_EQ(d.size(), 1U);
+  EXPECT_EQ(d[0]["t0"], "1");
+  EXPECT_EQ(d[0]["t1"], "0");
+  EXPECT_EQ(d[0]["t2"], "");
+}
+
+TEST_F(SQLTests, test_regexp_operator_invalid) {
+  QueryData d;
+  auto status = query("select 'foo/bar' REGEXP '(/'", d);
+  EXPECT_FALSE(status.ok());
+}
+
 /*
  * split
  */
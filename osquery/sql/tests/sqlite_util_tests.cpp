@@ -13,6 +13,7 @@
 #include <osquery/registry/registry_interface.h>
 #include <osquery/sql/sql.h>
 #include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/virtual_table.h>
 #include <osquery/sql/tests/sql_test_utils.h>
 #include <osquery/utils/info/platform_type.h>
 
@@ -124,6 +125,32 @@ TEST_F(SQLiteUtilTests, test_direct_query_execution) {
   EXPECT_EQ(results, getTestDBExpectedResults());
 }
 
+TEST_F(SQLiteUtilTests, test_query_interrupt_check) {
+  auto dbc = getTestDBC();
+  const std::string query =
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x "
+      "< 1000000) SELECT count(*) AS total FROM c";
+
+  size_t checks = 0;
+  {
+    QueryInterruptCheck check([&checks]() {
+      return (++checks < 3) ? Status::success() : Status::failure("stopped");
+    });
+    QueryDataTyped results;
+    auto status = queryInternal(query, results, dbc);
+    EXPECT_FALSE(status.ok());
+    EXPECT_EQ(status.getMessage(), "stopped");
+    EXPECT_EQ(check.getStatus().getMessage(), "stopped");
+    EXPECT_EQ(checks, 3U);
+  }
+
+  // Without a check the same query, and connection, complete.
+  QueryDataTyped results;
+  EXPECT_TRUE(queryInternal(query, results, dbc).ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["total"], RowDataTyped(1000000LL));
+}
+
 TEST_F(SQLiteUtilTests, test_aggregate_query) {
   auto dbc = getTestDBC();
   QueryDataTyped results;
@@ -185,6 +212,108 @@ TEST_F(SQLiteUtilTests, test_affected_tables) {
   EXPECT_EQ(dbc->affected_tables_.size(), 0U);
 }
 
+TEST_F(SQLiteUtilTests, test_query_scope) {
+  auto dbc = getTestDBC();
+
+  // Tables of the same query share the scope and its entries.
+  auto scope = dbc->getQueryScope();
+  EXPECT_EQ(scope, dbc->getQueryScope());
+  *scope->get<int>("counter") = 1;
+  EXPECT_EQ(*dbc->getQueryScope()->get<int>("counter"), 1);
+
+  // The next query starts with an empty scope.
+  dbc->clearAffectedTables();
+  EXPECT_NE(scope, dbc->getQueryScope());
+  EXPECT_EQ(*dbc->getQueryScope()->get<int>("counter"), 0);
+
+  // A context used outside of a query has a scope of its own.
+  QueryContext context;
+  EXPECT_EQ(context.getQueryScope(), context.getQueryScope());
+  EXPECT_NE(context.getQueryScope(), dbc->getQueryScope());
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache) {
+  auto& cache = SQLiteDBManager::statementCache();
+  cache.invalidate();
+
+  const std::string query = "SELECT unix_time > 0 AS valid FROM time";
+  for (size_t i = 0; i < 3; i++) {
+    auto dbc = SQLiteDBManager::get();
+    ASSERT_TRUE(dbc->isPrimary());
+
+    QueryDataTyped results;
+    auto status = queryInternal(query, results, dbc);
+    dbc->clearAffectedTables();
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0]["valid"], RowDataTyped(1LL));
+  }
+
+  auto stats = cache.stats();
+  EXPECT_EQ(cache.size(), 1U);
+  EXPECT_GE(stats.hits, 2U);
+
+  // Multiple statements are not cached.
+  {
+    auto dbc = SQLiteDBManager::get();
+    QueryDataTyped results;
+    EXPECT_TRUE(queryInternal("SELECT 1; SELECT 2", results, dbc).ok());
+    EXPECT_EQ(results.size(), 2U);
+  }
+  EXPECT_EQ(cache.size(), 1U);
+
+  // Detaching a table invalidates the cached statements.
+  auto generation = cache.generation();
+  {
+    auto dbc = SQLiteDBManager::get();
+    ASSERT_TRUE(dbc->isPrimary());
+    EXPECT_TRUE(detachTableInternal("not_a_table", dbc).ok());
+  }
+  EXPECT_GT(cache.generation(), generation);
+  EXPECT_EQ(cache.size(), 0U);
+}
+
+TEST_F(SQLiteUtilTests, test_connection_pool) {
+  SQLiteDBManager::invalidatePool();
+
+  sqlite3* transient_db = nullptr;
+  {
+    auto primary = SQLiteDBManager::get();
+    auto dbc = SQLiteDBManager::get();
+    ASSERT_FALSE(dbc->isPrimary());
+    transient_db = dbc->db();
+
+    QueryDataTyped results;
+    auto status = queryInternal("SELECT * FROM time", results, dbc);
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    EXPECT_EQ(results.size(), 1U);
+  }
+  EXPECT_EQ(SQLiteDBManager::poolSize(), 1U);
+
+  // A contended connection reuses the warm database.
+  {
+    auto primary = SQLiteDBManager::get();
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_EQ(dbc->db(), transient_db);
+    EXPECT_EQ(SQLiteDBManager::poolSize(), 0U);
+
+    // A database with a view created by a query is not reused.
+    QueryDataTyped results;
+    queryInternal("CREATE VIEW pool_view AS SELECT 1", results, dbc);
+  }
+  EXPECT_EQ(SQLiteDBManager::poolSize(), 0U);
+
+  {
+    auto primary = SQLiteDBManager::get();
+    auto dbc = SQLiteDBManager::get();
+  }
+  EXPECT_EQ(SQLiteDBManager::poolSize(), 1U);
+
+  // Attaching or detaching tables drops the pooled databases.
+  SQLiteDBManager::invalidatePool();
+  EXPECT_EQ(SQLiteDBManager::poolSize(), 0U);
+}
+
 TEST_F(SQLiteUtilTests, test_table_attributes_event_based) {
   {
     SQLInternal sql_internal("select * from process_events");
@@ -464,4 +593,17 @@ TEST_F(SQLiteUtilTests, test_sqlite_authorizer) {
   EXPECT_EQ(SQLITE_OK, rc);
 }
 
+TEST_F(SQLiteUtilTests, test_lookaside_reused) {
+  auto dbc = getTestDBC();
+  QueryData results;
+  ASSERT_TRUE(queryInternal("select * from test_table", results, dbc).ok());
+
+  // The statements allocated small objects from the connection's lookaside.
+  int current = 0;
+  int highwater = 0;
+  sqlite3_db_status(
+      dbc->db(), SQLITE_DBSTATUS_LOOKASIDE_USED, &current, &highwater, 0);
+  EXPECT_GT(highwater, 0);
+}
+
 } // namespace osquery
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core/core.h>
@@ -22,6 +24,9 @@
 namespace osquery {
 
 DECLARE_bool(table_exceptions);
+DECLARE_bool(schedule_table_cache);
+DECLARE_bool(table_statistics);
+DECLARE_bool(lazy_startup);
 
 class VirtualTableTests : public testing::Test {
  public:
@@ -191,7 +196,7 @@ TEST_F(VirtualTableTests, test_tableplugin_aliases) {
       {{"id", "columnAlias"}, {"name", "name1"}, {"target", "name"}},
       {{"id", "columnAlias"}, {"name", "name2"}, {"target", "name"}},
       {{"id", "columnAlias"}, {"name", "user_name"}, {"target", "username"}},
-      {{"attributes", "0"}, {"id", "attributes"}},
+      {{"attributes", "64"}, {"id", "attributes"}},
   };
   EXPECT_EQ(response, expected_response);
 
@@ -204,6 +209,53 @@ TEST_F(VirtualTableTests, test_tableplugin_aliases) {
   EXPECT_EQ(expected_statement, columnDefinition(response, false, false));
 }
 
+class cursorTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("x", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& /* context */) override {
+    TableRows results;
+    for (size_t i = 0; i < 5; i++) {
+      results.push_back(make_table_row({{"x", INTEGER(i)}}));
+    }
+    return results;
+  }
+};
+
+TEST_F(VirtualTableTests, test_tableplugin_cursor_actions) {
+  auto table = std::make_shared<cursorTablePlugin>();
+  PluginResponse response;
+  ASSERT_TRUE(table->call({{"action", "open"}}, response).ok());
+  ASSERT_EQ(response.size(), 1U);
+  auto cursor = response[0]["cursor"];
+  EXPECT_FALSE(cursor.empty());
+
+  // Full batches keep the cursor open, a short batch finishes it.
+  PluginRequest next = {{"action", "next"}, {"cursor", cursor}, {"batch", "2"}};
+  ASSERT_TRUE(table->call(next, response).ok());
+  ASSERT_EQ(response.size(), 2U);
+  EXPECT_EQ(response[0]["x"], "0");
+  EXPECT_EQ(response[1]["x"], "1");
+
+  next["batch"] = "4";
+  ASSERT_TRUE(table->call(next, response).ok());
+  ASSERT_EQ(response.size(), 3U);
+  EXPECT_EQ(response[2]["x"], "4");
+  EXPECT_FALSE(table->call(next, response).ok());
+
+  // A closed cursor cannot be read.
+  ASSERT_TRUE(table->call({{"action", "open"}}, response).ok());
+  cursor = response[0]["cursor"];
+  ASSERT_TRUE(table->call({{"action", "close"}, {"cursor", cursor}}, response)
+                  .ok());
+  next["cursor"] = cursor;
+  EXPECT_FALSE(table->call(next, response).ok());
+}
+
 TEST_F(VirtualTableTests, test_sqlite3_attach_vtable) {
   auto table = std::make_shared<sampleTablePlugin>();
   table->setName("sample");
@@ -240,6 +292,34 @@ TEST_F(VirtualTableTests, test_sqlite3_attach_vtable) {
       results[0]["sql"]);
 }
 
+TEST_F(VirtualTableTests, test_sqlite3_lazy_attach_vtables) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("lazy_aliases", std::make_shared<aliasesTablePlugin>());
+
+  FLAGS_lazy_startup = true;
+  auto dbc = SQLiteDBManager::getUnique();
+  FLAGS_lazy_startup = false;
+
+  // Only the table modules were registered.
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT name FROM sqlite_temp_master WHERE name = 'osquery_info'",
+      results,
+      dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(results.empty());
+
+  // Tables are connected when first used.
+  status = queryInternal("SELECT pid FROM osquery_info", results, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(results.size(), 1U);
+
+  // Table aliases resolve before their table is connected.
+  results.clear();
+  status = queryInternal("SELECT * FROM aliases1", results, dbc);
+  EXPECT_TRUE(status.ok()) << status.getMessage();
+}
+
 TEST_F(VirtualTableTests, test_sqlite3_table_joins) {
   // Get a database connection.
   auto dbc = SQLiteDBManager::getUnique();
@@ -636,6 +716,85 @@ TEST_F(VirtualTableTests, test_table_results_cache_colcheck) {
   EXPECT_EQ(cache->generates_, 2U);
 }
 
+class sharedResultsTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("d", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    generates_++;
+    TableRows result;
+    for (const auto& i : {"1", "2"}) {
+      auto r = make_table_row();
+      r["i"] = i;
+      r["d"] = "data";
+      result.push_back(std::move(r));
+    }
+    return result;
+  }
+
+  size_t generates_{0};
+};
+
+TEST_F(VirtualTableTests, test_table_results_shared_step) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto shared = std::make_shared<sharedResultsTablePlugin>();
+  tables->add("shared_results", shared);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "shared_results", shared->columnDefinition(false), dbc, false);
+
+  auto backup_flag = FLAGS_schedule_table_cache;
+  auto backup_step = TablePlugin::kCacheStep;
+  FLAGS_schedule_table_cache = true;
+  TablePlugin::kCacheStep = 10;
+  TableResultsCache::get().clear();
+
+  // Without a scheduled (cache-using) connection nothing is shared.
+  QueryData results;
+  queryInternal("SELECT * FROM shared_results", results, dbc);
+  queryInternal("SELECT * FROM shared_results", results, dbc);
+  EXPECT_EQ(shared->generates_, 2U);
+
+  dbc->useCache(true);
+  results.clear();
+  queryInternal("SELECT * FROM shared_results", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 3U);
+
+  // An identical scan within the same step reuses the results.
+  results.clear();
+  queryInternal("SELECT * FROM shared_results", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 3U);
+
+  // Different constraints or columns are a different scan.
+  results.clear();
+  queryInternal("SELECT * FROM shared_results WHERE i = '1'", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(shared->generates_, 4U);
+
+  results.clear();
+  queryInternal("SELECT i FROM shared_results", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 5U);
+
+  // The next step expires every shared result.
+  TablePlugin::kCacheStep = 11;
+  results.clear();
+  queryInternal("SELECT * FROM shared_results", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 6U);
+
+  TableResultsCache::get().clear();
+  TablePlugin::kCacheStep = backup_step;
+  FLAGS_schedule_table_cache = backup_flag;
+}
+
 class yieldTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -681,6 +840,71 @@ TEST_F(VirtualTableTests, test_yield_generator) {
   EXPECT_EQ(results[0]["index"], "10");
 }
 
+class iteratorTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("index", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  class CountingIterator : public TableRowIterator {
+   public:
+    explicit CountingIterator(size_t& generated) : generated_(generated) {}
+
+    bool next(TableRowHolder& row) override {
+      if (index_ >= 10) {
+        return false;
+      }
+
+      auto r = make_table_row();
+      r["index"] = std::to_string(index_++);
+      row = std::move(r);
+      generated_++;
+      return true;
+    }
+
+   private:
+    size_t& generated_;
+    size_t index_{0};
+  };
+
+ public:
+  bool usesIterator() const override {
+    return true;
+  }
+
+  TableRowIteratorRef iterate(QueryContext context) override {
+    return std::make_unique<CountingIterator>(generated);
+  }
+
+  size_t generated{0};
+};
+
+TEST_F(VirtualTableTests, test_row_iterator) {
+  auto table = std::make_shared<iteratorTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("iterator", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("iterator", table->columnDefinition(false), dbc, false);
+
+  QueryData results;
+  queryInternal("SELECT * from iterator", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 10U);
+  EXPECT_EQ(results[9]["index"], "9");
+  EXPECT_EQ(table->generated, 10U);
+
+  // Rows are only generated while SQLite steps the cursor.
+  table->generated = 0;
+  results.clear();
+  queryInternal("SELECT * from iterator LIMIT 2", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_LE(table->generated, 3U);
+}
+
 class likeTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -930,6 +1154,120 @@ TEST_F(VirtualTableTests, test_indexing_costs) {
   EXPECT_EQ(10U, j->scans);
 }
 
+class batchedLookupsTablePlugin : public indexIOptimizedTablePlugin {
+ private:
+  TableAttributes attributes() const override {
+    return TableAttributes::BATCHED_LOOKUPS;
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    lookups.push_back(context.constraints["i"].getAll<int>(EQUALS).size());
+    return indexIOptimizedTablePlugin::generate(context);
+  }
+
+  /// The number of values of each lookup, 0 for a scan.
+  std::vector<size_t> lookups;
+};
+
+TEST_F(VirtualTableTests, test_batched_lookups) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto batched = std::make_shared<batchedLookupsTablePlugin>();
+  table_registry->add("batched_i", batched);
+  attachTableInternal(
+      "batched_i", batched->columnDefinition(false), dbc, false);
+
+  auto default_scan = std::make_shared<defaultScanTablePlugin>();
+  table_registry->add("batched_outer", default_scan);
+  attachTableInternal(
+      "batched_outer", default_scan->columnDefinition(false), dbc, false);
+
+  // The first lookups are answered by the table, then a single scan.
+  QueryData results;
+  queryInternal(
+      "SELECT batched_outer.i AS i, batched_i.text AS text FROM batched_outer "
+      "JOIN batched_i USING (i)",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 10U);
+  EXPECT_EQ(1U, default_scan->scans);
+  EXPECT_EQ(batched->lookups, std::vector<size_t>({1, 1, 0}));
+  for (const auto& row : results) {
+    EXPECT_EQ(row.at("text"), (row.at("i") < "2") ? "none" : "some");
+  }
+
+#if SQLITE_VERSION_NUMBER >= 3038000
+  // Every IN value is passed to one generate call.
+  batched->lookups.clear();
+  results.clear();
+  queryInternal("SELECT * FROM batched_i WHERE i IN (1, 2, 3)", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(batched->lookups, std::vector<size_t>({3}));
+#endif
+}
+
+TEST_F(VirtualTableTests, test_table_statistics) {
+  ConstraintSet constraints;
+  constraints.push_back(std::make_pair("j", Constraint(EQUALS)));
+  constraints.push_back(std::make_pair("i", Constraint(EQUALS)));
+  constraints.push_back(std::make_pair("i", Constraint(GREATER_THAN)));
+
+  // Keys only depend on the constrained columns.
+  auto key = TableStatistics::key("stats_table", constraints);
+  std::reverse(constraints.begin(), constraints.end());
+  EXPECT_EQ(key, TableStatistics::key("stats_table", constraints));
+  EXPECT_NE(key, TableStatistics::key("stats_table", {}));
+
+  auto& statistics = TableStatistics::get();
+  statistics.clear();
+  TableScanStats stats;
+  EXPECT_FALSE(statistics.lookup(key, stats));
+
+  statistics.record(key, 8, std::chrono::microseconds(80));
+  ASSERT_TRUE(statistics.lookup(key, stats));
+  EXPECT_EQ(stats.scans, 1U);
+  EXPECT_EQ(stats.rows, 8);
+  EXPECT_EQ(stats.micros, 80);
+
+  // Later scans move the averages towards their observations.
+  statistics.record(key, 16, std::chrono::microseconds(160));
+  ASSERT_TRUE(statistics.lookup(key, stats));
+  EXPECT_EQ(stats.scans, 2U);
+  EXPECT_EQ(stats.rows, 9);
+  EXPECT_EQ(stats.micros, 90);
+
+  // Completed scans are recorded when the statistics are enabled.
+  auto backup_flag = FLAGS_table_statistics;
+  FLAGS_table_statistics = true;
+
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table = std::make_shared<defaultScanTablePlugin>();
+  RegistryFactory::get().registry("table")->add("stats_scan", table);
+  attachTableInternal("stats_scan", table->columnDefinition(false), dbc, false);
+
+  QueryData results;
+  queryInternal("SELECT * FROM stats_scan", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 10U);
+  ASSERT_TRUE(
+      statistics.lookup(TableStatistics::key("stats_scan", {}), stats));
+  EXPECT_EQ(stats.scans, 1U);
+  EXPECT_EQ(stats.rows, 10);
+
+  // The estimates do not change the results.
+  results.clear();
+  queryInternal("SELECT * FROM stats_scan", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 10U);
+
+  statistics.clear();
+  FLAGS_table_statistics = backup_flag;
+}
+
 class colsUsedTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -1140,6 +1478,95 @@ TEST_F(VirtualTableTests, test_used_columns_default) {
   }
 }
 
+class orderedTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", INTEGER_TYPE, ColumnOptions::SORTABLE),
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    ordered_ = context.isOrderedBy("id", descending_);
+    limit_ = context.limit;
+
+    TableRows results;
+    for (int i = 1; i <= 5; i++) {
+      if (limit_ && results.size() >= *limit_) {
+        break;
+      }
+      auto id = (ordered_ && descending_) ? 6 - i : i;
+      auto r = make_table_row();
+      r["id"] = INTEGER(id);
+      r["name"] = "name" + std::to_string(6 - id);
+      results.push_back(std::move(r));
+    }
+    return results;
+  }
+
+  bool ordered_{false};
+  bool descending_{false};
+  boost::optional<size_t> limit_;
+};
+
+TEST_F(VirtualTableTests, test_order_by_and_limit_hints) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto ordered = std::make_shared<orderedTablePlugin>();
+  tables->add("ordered", ordered);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("ordered", ordered->columnDefinition(false), dbc, false);
+
+  {
+    // The table produces the requested order.
+    QueryData results;
+    auto status =
+        queryInternal("SELECT id FROM ordered ORDER BY id DESC", results, dbc);
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(results.size(), 5U);
+    EXPECT_TRUE(ordered->ordered_);
+    EXPECT_TRUE(ordered->descending_);
+    EXPECT_EQ(results[0]["id"], "5");
+    EXPECT_EQ(results[4]["id"], "1");
+  }
+
+  {
+    // Other columns are sorted by SQLite.
+    QueryData results;
+    auto status =
+        queryInternal("SELECT id FROM ordered ORDER BY name", results, dbc);
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(results.size(), 5U);
+    EXPECT_FALSE(ordered->ordered_);
+    EXPECT_EQ(results[0]["id"], "5");
+  }
+
+  {
+    QueryData results;
+    auto status = queryInternal(
+        "SELECT id FROM ordered ORDER BY id LIMIT 2 OFFSET 1", results, dbc);
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(results.size(), 2U);
+    EXPECT_EQ(results[0]["id"], "2");
+    EXPECT_EQ(results[1]["id"], "3");
+#ifdef SQLITE_INDEX_CONSTRAINT_LIMIT
+    ASSERT_TRUE(ordered->limit_);
+    EXPECT_EQ(*ordered->limit_, 3U);
+#endif
+  }
+
+  {
+    // SQLite filters the rows, the LIMIT does not bound the table.
+    QueryData results;
+    auto status = queryInternal(
+        "SELECT id FROM ordered WHERE name != 'name1' LIMIT 2", results, dbc);
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(results.size(), 2U);
+    EXPECT_FALSE(ordered->limit_);
+  }
+}
+
 /*
  * Query this with
  *  "SELECT * FROM table WHERE name IN ('alpha','beta','charlie','delta')"
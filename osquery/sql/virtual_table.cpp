@@ -7,17 +7,27 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <stdexcept>
+#include <string_view>
 #include <unordered_set>
+#include <vector>
+
+#include <boost/container/pmr/map.hpp>
+#include <boost/container/pmr/monotonic_buffer_resource.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/core/trace.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/sql/virtual_table.h>
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 
 namespace osquery {
@@ -34,14 +44,275 @@ FLAG(bool,
      true,
      "Enable INDEX on all extension table columns (default true)");
 
+FLAG(string,
+     extensions_default_index_exclude,
+     "",
+     "Comma-delimited table.column list extensions_default_index skips");
+
+FLAG(uint32,
+     extensions_table_batch_rows,
+     1024,
+     "Rows read per request from extension tables, 0 reads whole results");
+
 FLAG(bool, table_exceptions, false, "Allow tables to throw exceptions");
 
 SHELL_FLAG(bool, planner, false, "Enable osquery runtime planner output");
 
+FLAG(bool,
+     schedule_table_cache,
+     false,
+     "Share table results between scheduled queries within a schedule step");
+
+FLAG(bool,
+     table_statistics,
+     false,
+     "Estimate virtual table scan costs from previous scans");
+
 DECLARE_bool(disable_events);
+DECLARE_bool(lazy_startup);
 
 RecursiveMutex kAttachMutex;
 
+namespace {
+
+/// Check if extensions_default_index should leave an extension column alone.
+bool isDefaultIndexExcluded(const std::string& table,
+                            const std::string& column) {
+  if (FLAGS_extensions_default_index_exclude.empty()) {
+    return false;
+  }
+
+  auto name = table + "." + column;
+  for (const auto& excluded :
+       split(FLAGS_extensions_default_index_exclude, ",")) {
+    if (excluded == name || excluded == table + ".*") {
+      return true;
+    }
+  }
+  return false;
+}
+
+TableRows copyTableRows(const TableRows& rows) {
+  TableRows copy;
+  copy.reserve(rows.size());
+  for (const auto& row : rows) {
+    copy.push_back(row->clone());
+  }
+  return copy;
+}
+
+/**
+ * @brief Read an extension table's rows in batches.
+ *
+ * The next batch is requested once SQLite stepped through the last one, so
+ * neither process holds the whole result. The extension closes a cursor it
+ * finished, a cursor left early is closed by the destructor.
+ */
+class ExtensionTableIterator : public TableRowIterator {
+ public:
+  ExtensionTableIterator(std::string table, PluginRequest request, size_t batch)
+      : table_(std::move(table)), request_(std::move(request)), batch_(batch) {}
+
+  ~ExtensionTableIterator() override {
+    if (cursor_.empty() || done_) {
+      return;
+    }
+
+    try {
+      PluginResponse response;
+      Registry::call(
+          "table", table_, {{"action", "close"}, {"cursor", cursor_}}, response);
+    } catch (const std::exception& /* e */) {
+      // The extension may have gone away, it expires unread cursors.
+    }
+  }
+
+  bool next(TableRowHolder& row) override {
+    while (next_ >= rows_.size()) {
+      if (done_) {
+        return false;
+      }
+      fetch();
+    }
+
+    row = std::move(rows_[next_++]);
+    return true;
+  }
+
+ private:
+  void fetch() {
+    QueryData qd;
+    if (cursor_.empty()) {
+      request_["action"] = "open";
+      auto status = Registry::call("table", table_, request_, qd);
+      if (!status.ok() || qd.empty() || qd[0].count("cursor") == 0) {
+        done_ = true;
+        throw std::runtime_error("Cannot open extension table cursor: " +
+                                 status.getMessage());
+      }
+      cursor_ = qd[0]["cursor"];
+      qd.clear();
+    }
+
+    auto status = Registry::call("table",
+                                 table_,
+                                 {{"action", "next"},
+                                  {"cursor", cursor_},
+                                  {"batch", std::to_string(batch_)}},
+                                 qd);
+    if (!status.ok()) {
+      done_ = true;
+      throw std::runtime_error("Cannot read extension table cursor: " +
+                               status.getMessage());
+    }
+
+    done_ = qd.size() < batch_;
+    rows_ = tableRowsFromQueryData(std::move(qd));
+    next_ = 0;
+  }
+
+ private:
+  std::string table_;
+  PluginRequest request_;
+  size_t batch_;
+
+  std::string cursor_;
+  bool done_{false};
+
+  TableRows rows_;
+  size_t next_{0};
+};
+
+} // namespace
+
+TableResultsCache& TableResultsCache::get() {
+  static TableResultsCache cache;
+  return cache;
+}
+
+std::string TableResultsCache::key(const std::string& table,
+                                   const QueryContext& context) {
+  // Constraints are ordered by column, then by operator and expression.
+  std::string key = table;
+  for (const auto& column : context.constraints) {
+    std::vector<std::pair<unsigned char, std::string>> constraints;
+    for (const auto& constraint : column.second.getAll()) {
+      constraints.push_back(std::make_pair(constraint.op, constraint.expr));
+    }
+
+    if (constraints.empty()) {
+      continue;
+    }
+
+    std::sort(constraints.begin(), constraints.end());
+    key += '\0' + column.first;
+    for (const auto& constraint : constraints) {
+      key += '\0' + std::to_string(constraint.first) + '\0' + constraint.second;
+    }
+  }
+
+  key += '\0';
+  if (context.colsUsedBitset) {
+    key += context.colsUsedBitset->to_string();
+  }
+  return key;
+}
+
+bool TableResultsCache::lookup(uint64_t step,
+                               const std::string& key,
+                               TableRows& rows) const {
+  ReadLock lock(mutex_);
+  if (step != step_) {
+    return false;
+  }
+
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  rows = copyTableRows(it->second);
+  return true;
+}
+
+void TableResultsCache::store(uint64_t step,
+                              const std::string& key,
+                              const TableRows& rows) {
+  auto copy = copyTableRows(rows);
+
+  WriteLock lock(mutex_);
+  if (step != step_) {
+    entries_.clear();
+    step_ = step;
+  }
+  entries_[key] = std::move(copy);
+}
+
+void TableResultsCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+  step_ = 0;
+}
+
+TableStatistics& TableStatistics::get() {
+  static TableStatistics statistics;
+  return statistics;
+}
+
+std::string TableStatistics::key(const std::string& table,
+                                 const ConstraintSet& constraints) {
+  std::vector<std::string> columns;
+  for (const auto& constraint : constraints) {
+    columns.push_back(constraint.first);
+  }
+  std::sort(columns.begin(), columns.end());
+  columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+  std::string key = table;
+  for (const auto& column : columns) {
+    key += '\0' + column;
+  }
+  return key;
+}
+
+void TableStatistics::record(
+    const std::string& key,
+    size_t rows,
+    std::chrono::steady_clock::duration generate_time) {
+  auto micros = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::microseconds>(generate_time)
+          .count());
+
+  WriteLock lock(mutex_);
+  auto& stats = entries_[key];
+  if (stats.scans == 0) {
+    stats.rows = static_cast<double>(rows);
+    stats.micros = micros;
+  } else {
+    // Weigh recent scans higher, tables grow and shrink over time.
+    stats.rows += (static_cast<double>(rows) - stats.rows) / 8;
+    stats.micros += (micros - stats.micros) / 8;
+  }
+  stats.scans++;
+}
+
+bool TableStatistics::lookup(const std::string& key,
+                             TableScanStats& stats) const {
+  ReadLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  stats = it->second;
+  return true;
+}
+
+void TableStatistics::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+}
+
 namespace tables {
 namespace sqlite {
 /// For planner and debugging an incrementing cursor ID is used.
@@ -293,6 +564,145 @@ static void plan(const std::string& output) {
   }
 }
 
+/**
+ * @brief Set a constraint's expression from an xFilter argument.
+ *
+ * @return false if SQLite did not expose the value.
+ */
+static bool setConstraintValue(Constraint& constraint, sqlite3_value* value) {
+  // Read the typed value first, a text conversion may change it.
+  auto type = sqlite3_value_type(value);
+  long long integer = 0;
+  double real = 0;
+  if (type == SQLITE_INTEGER) {
+    integer = sqlite3_value_int64(value);
+  } else if (type == SQLITE_FLOAT) {
+    real = sqlite3_value_double(value);
+  }
+  auto expr = (const char*)sqlite3_value_text(value);
+  if (expr == nullptr || expr[0] == 0) {
+    return false;
+  }
+
+  if (type == SQLITE_INTEGER) {
+    constraint.setInteger(integer, expr);
+  } else if (type == SQLITE_FLOAT) {
+    constraint.setDouble(real, expr);
+  } else if (type == SQLITE_BLOB) {
+    // Blobs may contain NUL bytes, keep the complete payload.
+    constraint.setText(std::string(expr, sqlite3_value_bytes(value)));
+    constraint.type = SQLITE_BLOB;
+  } else {
+    constraint.setText(expr);
+  }
+  return true;
+}
+
+/// Lookups answered by the table before a batched scan is generated.
+const size_t kBatchedLookupThreshold{2};
+
+/// Stack memory for a filter's column options, wide tables spill to the heap.
+const size_t kFilterArenaSize{4096};
+
+/**
+ * @brief Serve a repeated lookup of a BATCHED_LOOKUPS table from one scan.
+ *
+ * The inner loop of a JOIN filters the table once for each outer row. After
+ * a few lookups using the same plan, the table is scanned once without
+ * constraints and the following lookups are served from that scan.
+ *
+ * @return true if the rows were served from the batched scan.
+ */
+static bool generateBatchedLookup(
+    const std::shared_ptr<VirtualTableContent>& content,
+    size_t index,
+    const ConstraintSet& constraints,
+    TablePlugin& table,
+    const QueryContext& context,
+    TableRows& rows) {
+  if ((content->attributes & TableAttributes::BATCHED_LOOKUPS) == 0 ||
+      constraints.size() != 1 || constraints[0].second.op != EQUALS) {
+    return false;
+  }
+
+  // Rows are matched by their text values, which real numbers may not share.
+  const auto& column = constraints[0].first;
+  const auto& list = context.constraints.at(column);
+  auto values = list.getAll(EQUALS);
+  if (values.empty() || list.affinity == DOUBLE_TYPE) {
+    return false;
+  }
+
+  auto& scan = content->batchedScans[index];
+  if (!scan.generated) {
+    if (++scan.lookups <= kBatchedLookupThreshold) {
+      return false;
+    }
+
+    QueryContext unconstrained(content);
+    unconstrained.useCache(context.useCache());
+    for (size_t i = 0; i < content->columns.size(); i++) {
+      const auto& name = std::get<0>(content->columns[i]);
+      unconstrained.constraints[name].affinity =
+          std::get<1>(content->columns[i]);
+
+      // The lookup column is needed to group the rows.
+      if (name == column && context.colsUsed && context.colsUsedBitset) {
+        unconstrained.colsUsed = context.colsUsed;
+        unconstrained.colsUsed->insert(column);
+        unconstrained.colsUsedBitset = context.colsUsedBitset;
+        unconstrained.colsUsedBitset->set(i < 63 ? i : 63U);
+      }
+    }
+
+    scan.generated = true;
+    for (auto& row : table.generate(unconstrained)) {
+      auto r = static_cast<Row>(*row);
+      auto value = r.find(column);
+      if (value != r.end()) {
+        scan.rows[value->second].push_back(std::move(row));
+      }
+    }
+  }
+
+  for (const auto& value : values) {
+    auto it = scan.rows.find(value);
+    if (it == scan.rows.end()) {
+      continue;
+    }
+    for (const auto& row : it->second) {
+      rows.push_back(row->clone());
+    }
+  }
+  return true;
+}
+
+/// Add the time spent within a scope to the cursor's scan statistics.
+class ScopedGenerateTimer : private boost::noncopyable {
+ public:
+  explicit ScopedGenerateTimer(BaseCursor* cursor)
+      : cursor_(cursor), start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedGenerateTimer() {
+    if (!cursor_->stats_key.empty()) {
+      cursor_->generate_time += std::chrono::steady_clock::now() - start_;
+    }
+  }
+
+ private:
+  BaseCursor* cursor_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/// Record the statistics of a cursor's completed scan.
+static void recordScanStatistics(BaseCursor* pCur) {
+  if (!pCur->stats_key.empty()) {
+    TableStatistics::get().record(
+        pCur->stats_key, pCur->row, pCur->generate_time);
+    pCur->stats_key.clear();
+  }
+}
+
 int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
   auto* pCur = new BaseCursor;
   auto* pVtab = (VirtualTable*)tab;
@@ -316,17 +726,28 @@ int xClose(sqlite3_vtab_cursor* cur) {
 
 int xEof(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
+  if (pCur->uses_iterator) {
+    if (pCur->current != nullptr) {
+      return false;
+    }
+    pCur->iterator = nullptr;
+    recordScanStatistics(pCur);
+    return true;
+  }
+
   if (pCur->uses_generator) {
     if (*pCur->generator) {
       return false;
     }
     pCur->generator = nullptr;
+    recordScanStatistics(pCur);
     return true;
   }
 
   if (pCur->row >= pCur->n) {
     // If the requested row exceeds the size of the row set then all rows
     // have been visited, clear the data container.
+    recordScanStatistics(pCur);
     return true;
   }
   return false;
@@ -338,9 +759,34 @@ int xDestroy(sqlite3_vtab* p) {
   return SQLITE_OK;
 }
 
+/// Pull the next row from a cursor's iterator, clearing it when exhausted.
+static bool nextIteratorRow(BaseCursor* pCur) {
+  auto* pVtab = (VirtualTable*)pCur->base.pVtab;
+  try {
+    if (!pCur->iterator->next(pCur->current)) {
+      pCur->current = nullptr;
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Exception while executing table " << pVtab->content->name
+               << ": " << e.what();
+    setTableErrorMessage(pCur->base.pVtab, e.what());
+    pCur->current = nullptr;
+    if (FLAGS_table_exceptions) {
+      throw;
+    }
+    return false;
+  }
+  return true;
+}
+
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
-  if (pCur->uses_generator) {
+  ScopedGenerateTimer timer(pCur);
+  if (pCur->uses_iterator) {
+    if (!nextIteratorRow(pCur)) {
+      return SQLITE_ERROR;
+    }
+  } else if (pCur->uses_generator) {
     pCur->generator->operator()();
     if (*pCur->generator) {
       pCur->current = pCur->generator->get();
@@ -354,6 +800,13 @@ int xRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
   *pRowid = 0;
 
   const BaseCursor* pCur = (BaseCursor*)cur;
+  if (pCur->uses_iterator) {
+    if (pCur->current == nullptr) {
+      return SQLITE_ERROR;
+    }
+    return pCur->current->get_rowid(pCur->row, pRowid);
+  }
+
   auto data_it = std::next(pCur->rows.begin(), pCur->row);
   if (data_it >= pCur->rows.end()) {
     return SQLITE_ERROR;
@@ -561,6 +1014,7 @@ int xCreate(sqlite3* db,
   PluginResponse response;
   pVtab->content->name = std::string(argv[0]);
   const auto& name = pVtab->content->name;
+  pVtab->plugin = std::make_unique<PluginHandle<TablePlugin>>("table", name);
 
   // Get the table column information.
   auto status =
@@ -616,7 +1070,8 @@ int xCreate(sqlite3* db,
         }
       }
 
-      if (is_extension && FLAGS_extensions_default_index) {
+      if (is_extension && FLAGS_extensions_default_index &&
+          !isDefaultIndexExcluded(name, cname->second)) {
         if (ColumnOptions::DEFAULT == options) {
           options = ColumnOptions::INDEX;
         } else {
@@ -684,13 +1139,16 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
     // Requested column index greater than column set size.
     return SQLITE_ERROR;
   }
-  if (!pCur->uses_generator && pCur->row >= pCur->rows.size()) {
+  bool streaming = pCur->uses_generator || pCur->uses_iterator;
+  if (!streaming && pCur->row >= pCur->rows.size()) {
     // Request row index greater than row set size.
     return SQLITE_ERROR;
   }
 
-  TableRowHolder& row =
-      pCur->uses_generator ? pCur->current : pCur->rows[pCur->row];
+  TableRowHolder& row = streaming ? pCur->current : pCur->rows[pCur->row];
+  if (row == nullptr) {
+    return SQLITE_ERROR;
+  }
   return row->get_column(ctx, cur->pVtab, col);
 }
 
@@ -706,6 +1164,7 @@ static inline bool sensibleComparison(ColumnType type, unsigned char op) {
 
 static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   auto* pVtab = (VirtualTable*)tab;
+  OSQUERY_TRACE_SPAN_DETAIL("sql", "xBestIndex", pVtab->content->name);
   const auto& columns = pVtab->content->columns;
 
   ConstraintSet constraints;
@@ -719,6 +1178,12 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   bool hasRequiredColumns = false;
   bool hasRequiredConstraints = false;
 
+  // The LIMIT and OFFSET are only hints if SQLite evaluates other constraints.
+  bool hasOtherConstraints = false;
+  int limit_constraint = -1;
+  int offset_constraint = -1;
+  QueryPlanHints hints;
+
   // Expressions operating on the same virtual table are loosely identified by
   // the consecutive sets of terms each of the constraint sets are applied onto.
   // Subsequent attempts from failed (unusable) constraints replace the set,
@@ -734,6 +1199,17 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
              " term=" + std::to_string((int)constraint_info.iTermOffset) +
              " usable=" + std::to_string((int)constraint_info.usable) + "]");
       }
+#ifdef SQLITE_INDEX_CONSTRAINT_LIMIT
+      if (constraint_info.op == SQLITE_INDEX_CONSTRAINT_LIMIT) {
+        limit_constraint = static_cast<int>(i);
+        continue;
+      } else if (constraint_info.op == SQLITE_INDEX_CONSTRAINT_OFFSET) {
+        offset_constraint = static_cast<int>(i);
+        continue;
+      }
+#endif
+      hasOtherConstraints = true;
+
       if (!constraint_info.usable) {
         continue;
       }
@@ -779,6 +1255,16 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
 
       pIdxInfo->aConstraintUsage[i].argvIndex = static_cast<int>(++expr_index);
 
+#if SQLITE_VERSION_NUMBER >= 3038000
+      // Tables that batch lookups receive every value of an IN list at once.
+      if ((pVtab->content->attributes & TableAttributes::BATCHED_LOOKUPS) &&
+          constraint_info.op == EQUALS &&
+          sqlite3_vtab_in(pIdxInfo, static_cast<int>(i), -1)) {
+        sqlite3_vtab_in(pIdxInfo, static_cast<int>(i), 1);
+        hints.inConstraints.insert(constraints.size() - 1);
+      }
+#endif
+
       if (FLAGS_planner) {
         plan("xBestIndex Adding index constraint for table: " +
              pVtab->content->name + " [column=" + name +
@@ -823,6 +1309,60 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   // For example, you can't do a hash of a file if path not provided.
   if (hasRequiredColumns && !hasRequiredConstraints) {
     cost = kMaxIndexCost;
+  } else if (FLAGS_table_statistics) {
+    // Prefer the cost observed when scanning with the same constraints.
+    TableScanStats stats;
+    auto key = TableStatistics::key(pVtab->content->name, constraints);
+    if (TableStatistics::get().lookup(key, stats)) {
+      // SQLite spends roughly a microsecond on each row a table emits.
+      cost = std::min(kMaxIndexCost - 1,
+                      std::max(1.0, stats.micros + stats.rows));
+      pIdxInfo->estimatedRows =
+          std::max<sqlite3_int64>(1, static_cast<sqlite3_int64>(stats.rows));
+      if (FLAGS_planner) {
+        plan("xBestIndex Using statistics for table: " + pVtab->content->name +
+             " [scans=" + std::to_string(stats.scans) +
+             " rows=" + std::to_string(stats.rows) +
+             " micros=" + std::to_string(stats.micros) + "]");
+      }
+    }
+  }
+
+  // A single SORTABLE ORDER BY term is produced in order by the table.
+  if (pIdxInfo->nOrderBy == 1) {
+    const auto& order_by = pIdxInfo->aOrderBy[0];
+    if (order_by.iColumn >= 0 &&
+        static_cast<size_t>(order_by.iColumn) < columns.size() &&
+        (std::get<2>(columns[order_by.iColumn]) & ColumnOptions::SORTABLE) &&
+        !extension_table_list.contains(pVtab->content->name)) {
+      hints.orderBy.push_back(
+          {std::get<0>(columns[order_by.iColumn]), order_by.desc != 0});
+      pIdxInfo->orderByConsumed = 1;
+    }
+  }
+
+  // The rows read are only bounded by the LIMIT if SQLite does not discard
+  // or reorder the rows the table emits.
+  if (!hasOtherConstraints &&
+      (pIdxInfo->nOrderBy == 0 || pIdxInfo->orderByConsumed)) {
+    if (limit_constraint >= 0) {
+      pIdxInfo->aConstraintUsage[limit_constraint].argvIndex =
+          static_cast<int>(++expr_index);
+      hints.limitArgument = expr_index;
+    }
+    if (limit_constraint >= 0 && offset_constraint >= 0) {
+      pIdxInfo->aConstraintUsage[offset_constraint].argvIndex =
+          static_cast<int>(++expr_index);
+      hints.offsetArgument = expr_index;
+    }
+  }
+
+  if (FLAGS_planner && (!hints.orderBy.empty() || hints.limitArgument > 0)) {
+    plan("xBestIndex Recording hints for table: " + pVtab->content->name +
+         " [order_by=" +
+         (hints.orderBy.empty() ? std::string("none")
+                                : hints.orderBy[0].column) +
+         " limit_index=" + std::to_string(hints.limitArgument) + "]");
   }
 
   pIdxInfo->idxNum = static_cast<int>(kConstraintIndexID++);
@@ -836,8 +1376,12 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
   pVtab->content->colsUsed[pIdxInfo->idxNum] = std::move(colsUsed);
   pVtab->content->colsUsedBitsets[pIdxInfo->idxNum] = colsUsedBitset;
+  pVtab->content->hints[pIdxInfo->idxNum] = std::move(hints);
   pIdxInfo->estimatedCost = cost;
 
+  // Cached statements restore the recorded sets before they are stepped.
+  pVtab->instance->addPlannedTable(pVtab->content, pIdxInfo->idxNum);
+
   return SQLITE_OK;
 }
 
@@ -849,6 +1393,12 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   BaseCursor* pCur = (BaseCursor*)pVtabCursor;
   auto* pVtab = (VirtualTable*)pVtabCursor->pVtab;
   auto content = pVtab->content;
+  OSQUERY_TRACE_SPAN_DETAIL("sql", "xFilter", content->name);
+  // Stop before generating another table once the query was interrupted.
+  if (QueryInterruptCheck::interrupted()) {
+    return SQLITE_INTERRUPT;
+  }
+
   if (FLAGS_table_delay > 0 && pVtab->instance->tableCalled(*content)) {
     // Apply an optional sleep between table calls.
     sleepFor(FLAGS_table_delay);
@@ -857,10 +1407,13 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 
   pCur->row = 0;
   pCur->n = 0;
+  pCur->stats_key.clear();
+  pCur->generate_time = std::chrono::steady_clock::duration::zero();
   QueryContext context(content);
 
   // The SQLite instance communicates to the TablePlugin via the context.
   context.useCache(pVtab->instance->useCache());
+  context.setQueryScope(pVtab->instance->getQueryScope());
 
   // Track required columns, this is different than the requirements check
   // that occurs within BestIndex because this scan includes a cursor.
@@ -879,11 +1432,16 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
       ((content->attributes & TableAttributes::EVENT_BASED) == 0 ||
        !FLAGS_disable_events);
 
-  std::map<std::string, ColumnOptions> options;
+  // Joins filter the inner table once per outer row, the column options are
+  // kept in memory local to this call rather than the heap.
+  std::array<char, kFilterArenaSize> arena_buffer;
+  boost::container::pmr::monotonic_buffer_resource arena(
+      arena_buffer.data(), arena_buffer.size());
+  boost::container::pmr::map<std::string_view, ColumnOptions> options(&arena);
   for (size_t i = 0; i < content->columns.size(); ++i) {
     // Set the column affinity for each optional constraint list.
     // There is a separate list for each column name.
-    auto column_name = std::get<0>(content->columns[i]);
+    const auto& column_name = std::get<0>(content->columns[i]);
     context.constraints[column_name].affinity =
         std::get<1>(content->columns[i]);
     // Save the column options for comparison within constraints enumeration.
@@ -903,18 +1461,40 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   }
 
   // Iterate over every argument to xFilter, filling in constraint values.
-  if (content->constraints.size() > 0) {
-    auto& constraints = content->constraints[idxNum];
+  auto hints_it = content->hints.find(idxNum);
+  auto constraints_it = content->constraints.find(idxNum);
+  if (constraints_it != content->constraints.end()) {
+    auto& constraints = constraints_it->second;
     if (argc > 0) {
-      for (size_t i = 0; i < static_cast<size_t>(argc); ++i) {
-        auto expr = (const char*)sqlite3_value_text(argv[i]);
-        if (expr == nullptr || expr[0] == 0) {
-          // SQLite did not expose the expression value.
+      auto count = std::min(static_cast<size_t>(argc), constraints.size());
+      for (size_t i = 0; i < count; ++i) {
+        auto& constraint = constraints[i];
+        if (hints_it != content->hints.end() &&
+            hints_it->second.inConstraints.count(i) > 0) {
+#if SQLITE_VERSION_NUMBER >= 3038000
+          // The argument holds every value of the IN list.
+          sqlite3_value* in_value = nullptr;
+          for (auto rc = sqlite3_vtab_in_first(argv[i], &in_value);
+               rc == SQLITE_OK && in_value != nullptr;
+               rc = sqlite3_vtab_in_next(argv[i], &in_value)) {
+            auto in_constraint = constraint.second;
+            if (setConstraintValue(in_constraint, in_value)) {
+              context.constraints[constraint.first].add(in_constraint);
+            }
+          }
+          if (FLAGS_planner) {
+            plan("xFilter Adding IN constraints to cursor (" +
+                 std::to_string(pCur->id) + "): " + constraint.first);
+          }
+#endif
           continue;
         }
+
         // Set the expression from SQLite's now-populated argv.
-        auto& constraint = constraints[i];
-        constraint.second.expr = std::string(expr);
+        if (!setConstraintValue(constraint.second, argv[i])) {
+          // SQLite did not expose the expression value.
+          continue;
+        }
         if (FLAGS_planner) {
           plan("xFilter Adding constraint to cursor (" +
                std::to_string(pCur->id) + "): " + constraint.first + " " +
@@ -943,18 +1523,39 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     }
   }
 
-  if (!content->colsUsedBitsets.empty()) {
+  if (content->colsUsedBitsets.count(idxNum) > 0) {
     context.colsUsedBitset = content->colsUsedBitsets[idxNum];
   } else {
     // Unspecified; have to assume all columns are used
-    context.colsUsedBitset->set();
+    context.colsUsedBitset = UsedColumnsBitset().set();
   }
-  if (content->colsUsed.size() > 0) {
+  if (content->colsUsed.count(idxNum) > 0) {
     context.colsUsed = content->colsUsed[idxNum];
   }
 
+  if (hints_it != content->hints.end()) {
+    const auto& hints = hints_it->second;
+    context.orderBy = hints.orderBy;
+    if (hints.limitArgument > 0 &&
+        hints.limitArgument <= static_cast<size_t>(argc)) {
+      // A negative LIMIT has no upper bound, a negative OFFSET is ignored.
+      auto limit = sqlite3_value_int64(argv[hints.limitArgument - 1]);
+      if (limit >= 0) {
+        sqlite3_int64 offset = 0;
+        if (hints.offsetArgument > 0 &&
+            hints.offsetArgument <= static_cast<size_t>(argc)) {
+          offset = std::max<sqlite3_int64>(
+              0, sqlite3_value_int64(argv[hints.offsetArgument - 1]));
+        }
+        context.limit = static_cast<size_t>(limit + offset);
+      }
+    }
+  }
+
   // Reset the virtual table contents.
   pCur->rows.clear();
+  pCur->iterator = nullptr;
+  pCur->current = nullptr;
   options.clear();
 
   if (!user_based_satisfied) {
@@ -983,12 +1584,29 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     }
   }
 
+  // Measure the scan, later plans estimate their costs from it.
+  if (FLAGS_table_statistics) {
+    pCur->stats_key =
+        (constraints_it != content->constraints.end())
+            ? TableStatistics::key(content->name, constraints_it->second)
+            : TableStatistics::key(content->name, {});
+  }
+  ScopedGenerateTimer timer(pCur);
+
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
-  if (Registry::get().exists("table", pVtab->content->name, true)) {
-    auto plugin = Registry::get().plugin("table", pVtab->content->name);
-    auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
+  auto table = pVtab->plugin->get();
+  if (table != nullptr) {
     try {
+      if (table->usesIterator()) {
+        pCur->uses_iterator = true;
+        pCur->iterator = table->iterate(std::move(context));
+        if (!nextIteratorRow(pCur)) {
+          return SQLITE_ERROR;
+        }
+        return SQLITE_OK;
+      }
+
       if (table->usesGenerator()) {
         pCur->uses_generator = true;
         pCur->generator = std::make_unique<RowGenerator::pull_type>(
@@ -1001,7 +1619,36 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
         }
         return SQLITE_OK;
       }
-      pCur->rows = table->generate(context);
+
+      // Scheduled queries may share the results of an identical scan.
+      // Event-based tables track per-query state and are never shared.
+      bool share_results =
+          FLAGS_schedule_table_cache && context.useCache() &&
+          (content->attributes & TableAttributes::EVENT_BASED) == 0;
+      if (constraints_it != content->constraints.end() &&
+          generateBatchedLookup(content,
+                                static_cast<size_t>(idxNum),
+                                constraints_it->second,
+                                *table,
+                                context,
+                                pCur->rows)) {
+        if (FLAGS_planner) {
+          plan("xFilter " + content->name + " using a batched scan");
+        }
+      } else if (share_results) {
+        auto step = TablePlugin::kCacheStep;
+        auto key = TableResultsCache::key(content->name, context);
+        if (!TableResultsCache::get().lookup(step, key, pCur->rows)) {
+          OSQUERY_TRACE_SPAN_DETAIL("table", "generate", content->name);
+          pCur->rows = table->generate(context);
+          TableResultsCache::get().store(step, key, pCur->rows);
+        } else if (FLAGS_planner) {
+          plan("xFilter " + content->name + " using shared step results");
+        }
+      } else {
+        OSQUERY_TRACE_SPAN_DETAIL("table", "generate", content->name);
+        pCur->rows = table->generate(context);
+      }
     } catch (const std::exception& e) {
       LOG(ERROR) << "Exception while executing table " << pVtab->content->name
                  << ": " << e.what();
@@ -1011,6 +1658,18 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
       }
       return SQLITE_ERROR;
     }
+  } else if (FLAGS_extensions_table_batch_rows > 0 &&
+             (content->attributes & TableAttributes::CURSOR_ACTIONS)) {
+    // Extensions built with cursor support stream rows in batches.
+    PluginRequest request;
+    TablePlugin::setRequestFromContext(context, request);
+    pCur->uses_iterator = true;
+    pCur->iterator = std::make_unique<ExtensionTableIterator>(
+        content->name, std::move(request), FLAGS_extensions_table_batch_rows);
+    if (!nextIteratorRow(pCur)) {
+      return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
   } else {
     PluginRequest request = {{"action", "generate"}};
     TablePlugin::setRequestFromContext(context, request);
@@ -1103,6 +1762,10 @@ Status attachTableInternal(const std::string& name,
 
     rc =
         sqlite3_exec(instance->db(), format.c_str(), nullptr, nullptr, nullptr);
+    if (rc == SQLITE_OK && instance->isPrimary()) {
+      // Cached statements were planned without this table.
+      SQLiteDBManager::statementCache().invalidate();
+    }
 
   } else {
     LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
@@ -1111,10 +1774,52 @@ Status attachTableInternal(const std::string& name,
   return Status(rc, getStringForSQLiteReturnCode(rc));
 }
 
+/// Register a table's module, SQLite connects the table when first used.
+Status attachTableModule(const std::string& name,
+                         const std::vector<std::string>& aliases,
+                         const SQLiteDBInstanceRef& instance) {
+  if (SQLiteDBManager::isDisabled(name)) {
+    VLOG(1) << "Table " << name << " is disabled, not attaching";
+    return Status(0, getStringForSQLiteReturnCode(0));
+  }
+
+  struct sqlite3_module* module =
+      tables::sqlite::getVirtualTableModule(name, false);
+  if (module == nullptr) {
+    VLOG(1) << "Failed to retrieve the virtual table module for \"" << name
+            << "\"";
+    return Status(1);
+  }
+
+  auto lock(instance->attachLock());
+
+  // The module's xCreate is its xConnect, making it an eponymous table.
+  int rc = sqlite3_create_module(
+      instance->db(), name.c_str(), module, (void*)&(*instance));
+  if (rc != SQLITE_OK && rc != SQLITE_MISUSE) {
+    LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
+    return Status(rc, getStringForSQLiteReturnCode(rc));
+  }
+
+  // Aliases must resolve before the table is first connected.
+  rc = SQLITE_OK;
+  for (const auto& alias : aliases) {
+    auto statement =
+        "CREATE VIEW IF NOT EXISTS " + alias + " AS SELECT * FROM " + name;
+    rc = sqlite3_exec(
+        instance->db(), statement.c_str(), nullptr, nullptr, nullptr);
+  }
+  return Status(rc, getStringForSQLiteReturnCode(rc));
+}
+
 Status detachTableInternal(const std::string& name,
                            const SQLiteDBInstanceRef& instance) {
   auto lock(instance->attachLock());
   auto format = "DROP TABLE IF EXISTS temp." + name;
+  if (instance->isPrimary()) {
+    // Cached statements may reference the table.
+    SQLiteDBManager::statementCache().invalidate();
+  }
   int rc = sqlite3_exec(instance->db(), format.c_str(), nullptr, nullptr, 0);
   if (rc != SQLITE_OK) {
     LOG(ERROR) << "Error detaching table: " << name << " (" << rc << ")";
@@ -1155,6 +1860,17 @@ void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
   bool is_extension = false;
 
   for (const auto& name : RegistryFactory::get().names("table")) {
+    if (FLAGS_lazy_startup && Registry::get().exists("table", name, true)) {
+      // Internal tables are connected by SQLite on first use, extension
+      // tables are still created up front.
+      auto table = std::dynamic_pointer_cast<TablePlugin>(
+          Registry::get().plugin("table", name));
+      if (table != nullptr) {
+        attachTableModule(name, table->aliases(), instance);
+        continue;
+      }
+    }
+
     // Column information is nice for virtual table create call.
     auto status =
         Registry::call("table", name, {{"action", "columns"}}, response);
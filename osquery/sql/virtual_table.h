@@ -9,11 +9,15 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/tables.h>
+#include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sqlite_util.h>
 
 namespace osquery {
@@ -53,11 +57,23 @@ struct BaseCursor : private boost::noncopyable {
   /// Does the backing local table use a generator type.
   bool uses_generator{false};
 
+  /// Pull-based row source, the current row is its last result.
+  TableRowIteratorRef iterator{nullptr};
+
+  /// Does the backing local table use an iterator type.
+  bool uses_iterator{false};
+
   /// Current cursor position.
   size_t row{0};
 
   /// Total number of rows.
   size_t n{0};
+
+  /// The TableStatistics key of the current scan, empty if not recorded.
+  std::string stats_key;
+
+  /// Time spent generating rows for the current scan.
+  std::chrono::steady_clock::duration generate_time{0};
 };
 
 /**
@@ -75,6 +91,99 @@ struct VirtualTable : private boost::noncopyable {
 
   /// Added structure: The thread-local DB instance associated with the query.
   SQLiteDBInstance* instance{nullptr};
+
+  /// Added structure: The table plugin, resolved again if the registry changes.
+  std::unique_ptr<PluginHandle<TablePlugin>> plugin;
+};
+
+/**
+ * @brief Table results shared by the scheduled queries of one schedule step.
+ *
+ * Several scheduled queries often scan the same table, with the same
+ * constraints, within the same second. Results are keyed by the table name,
+ * the normalized constraints and the used columns, and are only valid for
+ * the schedule step that generated them.
+ */
+class TableResultsCache : private boost::noncopyable {
+ public:
+  /// Access the process-wide cache.
+  static TableResultsCache& get();
+
+  /// Build the cache key for a table scan.
+  static std::string key(const std::string& table, const QueryContext& context);
+
+  /**
+   * @brief Copy the cached results of a scan generated at the given step.
+   *
+   * @return true if the results were found.
+   */
+  bool lookup(uint64_t step, const std::string& key, TableRows& rows) const;
+
+  /// Save a copy of the results of a scan, entries of older steps are dropped.
+  void store(uint64_t step, const std::string& key, const TableRows& rows);
+
+  /// Remove all entries.
+  void clear();
+
+ private:
+  mutable Mutex mutex_;
+
+  /// The schedule step all entries belong to.
+  uint64_t step_{0};
+
+  /// Table results by scan key.
+  std::unordered_map<std::string, TableRows> entries_;
+};
+
+/// Observed averages of the scans of a table with a set of constraints.
+struct TableScanStats {
+  /// The number of completed scans.
+  size_t scans{0};
+
+  /// The average number of rows generated.
+  double rows{0};
+
+  /// The average generation time in microseconds.
+  double micros{0};
+};
+
+/**
+ * @brief Runtime statistics of virtual table scans.
+ *
+ * Scans are keyed by the table name and the columns whose constraints were
+ * passed to the table. When enabled, xBestIndex estimates the cost and row
+ * count of a plan from the previous scans instead of static costs, so the
+ * planner picks the cheaper join order.
+ */
+class TableStatistics : private boost::noncopyable {
+ public:
+  /// Access the process-wide statistics.
+  static TableStatistics& get();
+
+  /// Build the statistics key for a table and its usable constraints.
+  static std::string key(const std::string& table,
+                         const ConstraintSet& constraints);
+
+  /// Record a completed scan.
+  void record(const std::string& key,
+              size_t rows,
+              std::chrono::steady_clock::duration generate_time);
+
+  /**
+   * @brief Copy the statistics of previous scans.
+   *
+   * @return true if at least one scan was recorded.
+   */
+  bool lookup(const std::string& key, TableScanStats& stats) const;
+
+  /// Remove all entries.
+  void clear();
+
+ private:
+  mutable Mutex mutex_;
+
+  /// Scan statistics by key.
+  std::unordered_map<std::string, TableScanStats> entries_;
 };
 
 /// Attach a table plugin name to an in-memory SQLite database.
@@ -9,6 +9,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
@@ -70,15 +71,24 @@ QueryData genAtomPackages(QueryContext& context) {
     confDirs.insert({uid->second, fs::path(directory->second) / ".atom"});
   }
 
-  for (const auto& confDir : confDirs) {
+  // Read the packages of each config directory on the table workers.
+  std::vector<std::pair<std::string, fs::path>> dirs(confDirs.begin(),
+                                                     confDirs.end());
+  std::vector<QueryData> dir_results(dirs.size());
+  runTableTasks(dirs.size(), [&dirs, &dir_results](size_t i) {
     std::vector<std::string> packages;
-    resolveFilePattern(confDir.second / "packages" / "%" / "package.json",
+    resolveFilePattern(dirs[i].second / "packages" / "%" / "package.json",
                        packages);
     for (const auto& package : packages) {
-      genReadJSONAndAddRow(confDir.first, package, results);
+      genReadJSONAndAddRow(dirs[i].first, package, dir_results[i]);
     }
-  }
+  });
 
+  for (auto& dir_result : dir_results) {
+    results.insert(results.end(),
+                   std::make_move_iterator(dir_result.begin()),
+                   std::make_move_iterator(dir_result.end()));
+  }
   return results;
 }
 } // namespace tables
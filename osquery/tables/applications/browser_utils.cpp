@@ -52,40 +52,46 @@ const std::string kMatchesKey = "matches";
 
 std::vector<ChromeUserExtensions> chromeExtensionPathsByUser(
     const QueryData& users, const std::vector<fs::path>& chromePaths) {
-  std::vector<ChromeUserExtensions> extensionPathsByUser;
-
-  for (const auto& row : users) {
-    if (row.count("uid") == 0 || row.count("directory") == 0) {
-      continue;
-    }
-
-    // For each user, enumerate all of their chrome profiles.
-    for (const auto& chromePath : chromePaths) {
-      std::vector<std::string> profiles;
-      fs::path extension_path = row.at("directory") / chromePath;
-      if (!resolveFilePattern(extension_path, profiles, GLOB_FOLDERS).ok()) {
-        continue;
-      }
-
-      // For each profile list each extension in the Extensions directory.
-      for (const auto& profile : profiles) {
-        std::vector<std::string> unversionedExtensions = {};
-        listDirectoriesInDirectory(profile, unversionedExtensions);
+  // Profiles are listed for many users in parallel.
+  auto pathsPerUser = generatePerUser<std::vector<ChromeUserExtensions>>(
+      users,
+      [&chromePaths](const Row& row,
+                     std::vector<ChromeUserExtensions>& userExtensionPaths) {
+        // For each user, enumerate all of their chrome profiles.
+        for (const auto& chromePath : chromePaths) {
+          std::vector<std::string> profiles;
+          fs::path extension_path = row.at("directory") / chromePath;
+          if (!resolveFilePattern(extension_path, profiles, GLOB_FOLDERS)
+                   .ok()) {
+            continue;
+          }
 
-        if (unversionedExtensions.empty()) {
-          continue;
-        }
-        std::vector<std::string> extensionPaths;
-        for (const auto& unversionedExtension : unversionedExtensions) {
-          listDirectoriesInDirectory(unversionedExtension, extensionPaths);
+          // For each profile list each extension in the Extensions directory.
+          for (const auto& profile : profiles) {
+            std::vector<std::string> unversionedExtensions = {};
+            listDirectoriesInDirectory(profile, unversionedExtensions);
+
+            if (unversionedExtensions.empty()) {
+              continue;
+            }
+            std::vector<std::string> extensionPaths;
+            for (const auto& unversionedExtension : unversionedExtensions) {
+              listDirectoriesInDirectory(unversionedExtension, extensionPaths);
+            }
+
+            userExtensionPaths.push_back(
+                std::make_tuple(row.at("uid"), extensionPaths));
+          }
         }
+      });
 
-        extensionPathsByUser.push_back(
-            std::make_tuple(row.at("uid"), extensionPaths));
-      }
-    }
+  std::vector<ChromeUserExtensions> extensionPathsByUser;
+  for (auto& userExtensionPaths : pathsPerUser) {
+    extensionPathsByUser.insert(
+        extensionPathsByUser.end(),
+        std::make_move_iterator(userExtensionPaths.begin()),
+        std::make_move_iterator(userExtensionPaths.end()));
   }
-
   return extensionPathsByUser;
 }
 
@@ -306,12 +312,13 @@ void genExtensionContentScripts(
 
 QueryData genChromeBasedExtensions(QueryContext& context,
                                    const std::vector<fs::path>& chromePaths) {
-  QueryData results;
-
   const auto& extensionPathsByUser =
       chromeExtensionPathsByUser(usersFromContext(context), chromePaths);
 
-  for (const auto& userExtensionPaths : extensionPathsByUser) {
+  // The manifests of each profile are read on the table workers.
+  std::vector<QueryData> profileResults(extensionPathsByUser.size());
+  runTableTasks(extensionPathsByUser.size(), [&](size_t i) {
+    const auto& userExtensionPaths = extensionPathsByUser[i];
     const auto& uid = std::get<0>(userExtensionPaths);
     std::map<fs::path, std::string> profileNameMap;
 
@@ -332,10 +339,17 @@ QueryData genChromeBasedExtensions(QueryContext& context,
         }
       }
 
-      genExtension(uid, version, profileNameMap[profile_path], results);
+      genExtension(
+          uid, version, profileNameMap[profile_path], profileResults[i]);
     }
-  }
+  });
 
+  QueryData results;
+  for (auto& profileResult : profileResults) {
+    results.insert(results.end(),
+                   std::make_move_iterator(profileResult.begin()),
+                   std::make_move_iterator(profileResult.end()));
+  }
   return results;
 }
 
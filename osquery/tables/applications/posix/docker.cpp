@@ -10,14 +10,20 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <regex>
+#include <sstream>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/asio.hpp>
 #include <boost/foreach.hpp>
+#include <boost/optional.hpp>
 
 #if !defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
 #error Boost error: Local sockets not available
@@ -29,6 +35,7 @@
 #include <osquery/utils/conversions/join.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 
 // When building on linux, the extended schema of docker_containers will
 // add some additional columns to support user namespaces
@@ -54,6 +61,144 @@ FLAG(string,
 
 namespace tables {
 
+/// Idle keep-alive connections to the docker socket kept for later calls.
+const size_t kDockerMaxIdleConnections{8};
+
+namespace {
+
+using DockerStream = local::stream_protocol::iostream;
+
+/**
+ * @brief Idle connections to the docker socket.
+ *
+ * Docker API calls use HTTP/1.1 keep-alive, a connection is returned here
+ * once its response is read and reused by the next call.
+ */
+class DockerConnectionPool final {
+ public:
+  static DockerConnectionPool& get() {
+    static DockerConnectionPool pool;
+    return pool;
+  }
+
+  /// Take an idle connection to the socket, or nullptr if there is none.
+  std::unique_ptr<DockerStream> take(const std::string& socket) {
+    WriteLock lock(mutex_);
+    if (socket != socket_) {
+      idle_.clear();
+      socket_ = socket;
+    }
+
+    if (idle_.empty()) {
+      return nullptr;
+    }
+    auto stream = std::move(idle_.back());
+    idle_.pop_back();
+    return stream;
+  }
+
+  /// Keep a connection whose response was completely read.
+  void put(const std::string& socket, std::unique_ptr<DockerStream> stream) {
+    WriteLock lock(mutex_);
+    if (socket == socket_ && idle_.size() < kDockerMaxIdleConnections) {
+      idle_.push_back(std::move(stream));
+    }
+  }
+
+ private:
+  Mutex mutex_;
+
+  /// The socket the idle connections are connected to.
+  std::string socket_;
+
+  std::vector<std::unique_ptr<DockerStream>> idle_;
+};
+
+/**
+ * @brief Send a GET request and read the whole response body.
+ *
+ * @param received Set once the response status line is read.
+ * @param keep_alive Set if the connection may be used for another request.
+ */
+Status dockerRequest(DockerStream& stream,
+                     const std::string& uri,
+                     std::string& body,
+                     bool& received,
+                     bool& keep_alive) {
+  static const std::regex httpOkRegex("HTTP/1\\.(0|1) 200 OK\\\r");
+
+  stream << "GET " << uri
+         << " HTTP/1.1\r\nHost: docker\r\nAccept: */*\r\n\r\n"
+         << std::flush;
+
+  // All status responses are expected to be 200
+  std::string str;
+  if (!getline(stream, str)) {
+    return Status(1, "Empty docker API response for: " + uri);
+  }
+  received = true;
+
+  std::smatch match;
+  if (!std::regex_match(str, match, httpOkRegex)) {
+    return Status(1, "Invalid docker API response for " + uri + ": " + str);
+  }
+
+  // Read the headers, up to the empty line before the body
+  keep_alive = boost::starts_with(str, "HTTP/1.1");
+  bool chunked = false;
+  boost::optional<size_t> content_length;
+  while (getline(stream, str) && str != "\r") {
+    auto separator = str.find(':');
+    if (separator == std::string::npos) {
+      continue;
+    }
+
+    auto name = boost::algorithm::to_lower_copy(str.substr(0, separator));
+    auto value = boost::algorithm::to_lower_copy(
+        boost::algorithm::trim_copy(str.substr(separator + 1)));
+    if (name == "content-length") {
+      content_length = std::stoul(value);
+    } else if (name == "transfer-encoding") {
+      chunked = (value == "chunked");
+    } else if (name == "connection" && value == "close") {
+      keep_alive = false;
+    }
+  }
+
+  if (chunked) {
+    while (getline(stream, str)) {
+      auto size = std::stoul(str, nullptr, 16);
+      if (size == 0) {
+        // Skip the trailers
+        while (getline(stream, str) && str != "\r") {
+        }
+        break;
+      }
+
+      auto offset = body.size();
+      body.resize(offset + size);
+      stream.read(&body[offset], size);
+      getline(stream, str);
+    }
+  } else if (content_length) {
+    body.resize(*content_length);
+    stream.read(&body[0], *content_length);
+  } else {
+    // Without a length the body ends with the connection
+    keep_alive = false;
+    body.assign(std::istreambuf_iterator<char>(stream),
+                std::istreambuf_iterator<char>());
+    return Status(0);
+  }
+
+  if (!stream) {
+    return Status(1, "Truncated docker API response for: " + uri);
+  }
+  return Status(0);
+}
+
+} // namespace
+
 /**
  * @brief Makes API calls to the docker UNIX socket.
  *
@@ -63,54 +208,119 @@ namespace tables {
  *         message.
  */
 Status dockerApi(const std::string& uri, pt::ptree& tree) {
-  static const std::regex httpOkRegex("HTTP/1\\.(0|1) 200 OK\\\r");
-
   try {
-    local::stream_protocol::endpoint ep(FLAGS_docker_socket);
-    local::stream_protocol::iostream stream(ep);
-    if (!stream) {
-      return Status(
-          1, "Error connecting to docker sock: " + stream.error().message());
-    }
+    auto& pool = DockerConnectionPool::get();
+    auto socket = FLAGS_docker_socket;
+
+    // The daemon may close a connection while it is idle. A call that gets
+    // no response on a reused connection is retried on a new one.
+    for (size_t attempt = 0; attempt < 2; attempt++) {
+      auto stream = (attempt == 0) ? pool.take(socket) : nullptr;
+      bool reused = (stream != nullptr);
+      if (!reused) {
+        local::stream_protocol::endpoint ep(socket);
+        stream = std::make_unique<DockerStream>(ep);
+        if (!*stream) {
+          return Status(1,
+                        "Error connecting to docker sock: " +
+                            stream->error().message());
+        }
+      }
 
-    // Since keep-alive connections are not used, use HTTP/1.0
-    stream << "GET " << uri
-           << " HTTP/1.0\r\nAccept: */*\r\nConnection: close\r\n\r\n"
-           << std::flush;
-    if (stream.eof()) {
-      stream.close();
-      return Status(1, "Empty docker API response for: " + uri);
-    }
+      std::string body;
+      bool received = false;
+      bool keep_alive = false;
+      auto s = dockerRequest(*stream, uri, body, received, keep_alive);
+      if (!s.ok()) {
+        if (reused && !received) {
+          continue;
+        }
+        return s;
+      }
 
-    // All status responses are expected to be 200
-    std::string str;
-    getline(stream, str);
+      if (keep_alive) {
+        pool.put(socket, std::move(stream));
+      }
 
-    std::smatch match;
-    if (!std::regex_match(str, match, httpOkRegex)) {
-      stream.close();
-      return Status(1, "Invalid docker API response for " + uri + ": " + str);
+      try {
+        std::istringstream json(body);
+        pt::read_json(json, tree);
+      } catch (const pt::ptree_error& e) {
+        return Status(1,
+                      "Error reading docker API response for " + uri + ": " +
+                          e.what());
+      }
+      return Status(0);
     }
+  } catch (const std::exception& e) {
+    return Status(1, std::string("Error calling docker API: ") + e.what());
+  }
 
-    // Skip empty line between header and body
-    while (!stream.eof() && str != "\r") {
-      getline(stream, str);
-    }
+  return Status(1, "Error calling docker API: no response for " + uri);
+}
 
-    try {
-      pt::read_json(stream, tree);
-    } catch (const pt::ptree_error& e) {
-      stream.close();
-      return Status(
-          1, "Error reading docker API response for " + uri + ": " + e.what());
+namespace {
+
+/// Docker API responses of a query, shared by the docker tables it uses.
+class DockerResponses final {
+ public:
+  Status get(const std::string& uri, pt::ptree& tree) {
+    {
+      WriteLock lock(mutex_);
+      auto it = responses_.find(uri);
+      if (it != responses_.end()) {
+        tree = it->second.second;
+        return it->second.first;
+      }
     }
 
-    stream.close();
-  } catch (const std::exception& e) {
-    return Status(1, std::string("Error calling docker API: ") + e.what());
+    auto status = dockerApi(uri, tree);
+    WriteLock lock(mutex_);
+    responses_.emplace(uri, std::make_pair(status, tree));
+    return status;
   }
 
-  return Status(0);
+ private:
+  Mutex mutex_;
+  std::map<std::string, std::pair<Status, pt::ptree>> responses_;
+};
+
+} // namespace
+
+/**
+ * @brief Makes API calls to the docker UNIX socket, once per query.
+ *
+ * The docker tables of a query share their responses, so joins across them
+ * do not ask docker for the same object again.
+ */
+Status dockerApi(QueryContext& context,
+                 const std::string& uri,
+                 pt::ptree& tree) {
+  return context.getQueryScope()->get<DockerResponses>("docker")->get(uri,
+                                                                      tree);
+}
+
+/**
+ * @brief Generate the rows of many docker objects with concurrent API calls.
+ *
+ * Docker answers each per-object request on its own, and collecting stats
+ * includes sampling the container's usage. The calls for the items are made
+ * on the table I/O workers and the rows are merged in item order.
+ */
+template <typename Generator>
+QueryData genDockerRowsParallel(const std::vector<std::string>& items,
+                                Generator generator) {
+  std::vector<QueryData> results(items.size());
+  runTableIOTasks(items.size(),
+                  [&](size_t i) { generator(items[i], results[i]); });
+
+  QueryData rows;
+  for (auto& result : results) {
+    rows.insert(rows.end(),
+                std::make_move_iterator(result.begin()),
+                std::make_move_iterator(result.end()));
+  }
+  return rows;
 }
 
 /**
@@ -119,7 +329,7 @@ Status dockerApi(const std::string& uri, pt::ptree& tree) {
 QueryData genVersion(QueryContext& context) {
   QueryData results;
   pt::ptree tree;
-  Status s = dockerApi("/version", tree);
+  Status s = dockerApi(context, "/version", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker version: " << s.what();
     return results;
@@ -146,7 +356,7 @@ QueryData genVersion(QueryContext& context) {
 QueryData genInfo(QueryContext& context) {
   QueryData results;
   pt::ptree tree;
-  Status s = dockerApi("/info", tree);
+  Status s = dockerApi(context, "/info", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker info: " << s.what();
     return results;
@@ -218,6 +428,19 @@ bool checkConstraintValue(const std::string& str) {
   return true;
 }
 
+/**
+ * @brief Utility method to get the valid values of the "id" constraints.
+ */
+std::vector<std::string> getConstraintIds(QueryContext& context) {
+  std::vector<std::string> ids;
+  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
+    if (checkConstraintValue(id)) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
 /**
  * @brief Utility method to create query arguments for docker API URI.
  *
@@ -323,7 +546,7 @@ QueryData getLabels(QueryContext& context,
   QueryData results;
   pt::ptree tree;
   const std::string& url_qs = filter ? (url + query) : url;
-  Status s = dockerApi(url_qs, tree);
+  Status s = dockerApi(context, url_qs, tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker " << type << ": " << s.what();
     return results;
@@ -360,7 +583,7 @@ Status getContainers(QueryContext& context,
   std::string query;
   getQuery(context, "id", query, ids, true);
 
-  Status s = dockerApi("/containers/json" + query, containers);
+  Status s = dockerApi(context, "/containers/json" + query, containers);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker containers: " << s.what();
     return s;
@@ -401,9 +624,16 @@ QueryData genContainers(QueryContext& context) {
     r["state"] = container.get<std::string>("State", "");
     r["status"] = container.get<std::string>("Status", "");
 
+    results.push_back(r);
+  }
+
+  // Inspect the containers concurrently.
+  runTableIOTasks(results.size(), [&context, &results](size_t i) {
+    auto& r = results[i];
     pt::ptree container_details;
-    s = dockerApi("/containers/" + r["id"] + "/json?stream=false",
-                  container_details);
+    auto s = dockerApi(context,
+                       "/containers/" + r["id"] + "/json?stream=false",
+                       container_details);
     if (s.ok()) {
       r["pid"] =
           BIGINT(container_details.get_child("State").get<pid_t>("Pid", -1));
@@ -462,9 +692,7 @@ QueryData genContainers(QueryContext& context) {
       }
     }
 #endif
-
-    results.push_back(r);
-  }
+  });
 
   return results;
 }
@@ -594,93 +822,97 @@ QueryData genContainerPorts(QueryContext& context) {
 }
 
 /**
- * @brief Entry point for docker_container_processes table.
+ * @brief Process extractor for docker_container_processes table
  */
-QueryData genContainerProcesses(QueryContext& context) {
-  QueryData results;
+void getContainerProcesses(QueryContext& context,
+                           const std::string& id,
+                           QueryData& results) {
   std::string ps_args;
+  pt::ptree container;
+
+  if (isPlatform(PlatformType::TYPE_OSX)) {
+    // osx: 19 fields
+    // currently OS X Docker API will only return
+    // "PID","USER","TIME","COMMAND" fields
+    ps_args =
+        "pid,state,uid,gid,svuid,svgid,rss,vsz,etime,ppid,pgid,wq,nice,user,"
+        "time,pcpu,pmem,comm,command";
+  } else if (isPlatform(PlatformType::TYPE_LINUX)) {
+    // linux: 21 fields
+    ps_args =
+        "pid,state,uid,gid,euid,egid,suid,sgid,rss,vsz,etime,ppid,pgrp,nlwp,"
+        "nice,user,time,pcpu,pmem,comm,cmd";
+  } else {
+    return;
+  }
 
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
-
-    pt::ptree container;
-
-    if (isPlatform(PlatformType::TYPE_OSX)) {
-      // osx: 19 fields
-      // currently OS X Docker API will only return
-      // "PID","USER","TIME","COMMAND" fields
-      ps_args =
-          "pid,state,uid,gid,svuid,svgid,rss,vsz,etime,ppid,pgid,wq,nice,user,"
-          "time,pcpu,pmem,comm,command";
-    } else if (isPlatform(PlatformType::TYPE_LINUX)) {
-      // linux: 21 fields
-      ps_args =
-          "pid,state,uid,gid,euid,egid,suid,sgid,rss,vsz,etime,ppid,pgrp,nlwp,"
-          "nice,user,time,pcpu,pmem,comm,cmd";
-    } else {
-      continue;
-    }
-
-    auto s = dockerApi("/containers/" + id + "/top?ps_args=axwwo%20" + ps_args,
-                       container);
-
-    if (!s.ok()) {
-      VLOG(1) << "Error getting docker container " << id << ": " << s.what();
-      continue;
-    }
+  auto s = dockerApi(context,
+                     "/containers/" + id + "/top?ps_args=axwwo%20" + ps_args,
+                     container);
 
-    try {
-      for (const auto& processes : container.get_child("Processes")) {
-        std::vector<std::string> vector;
-        for (const auto& v : processes.second) {
-          vector.push_back(v.second.data());
-        }
+  if (!s.ok()) {
+    VLOG(1) << "Error getting docker container " << id << ": " << s.what();
+    return;
+  }
 
-        Row r;
-        r["id"] = id;
-        r["pid"] = BIGINT(vector.at(0));
-        r["wired_size"] = BIGINT(0); // No support for unpagable counters
-        if (isPlatform(PlatformType::TYPE_OSX) && vector.size() == 4) {
-          r["uid"] = BIGINT(vector.at(1));
-          r["time"] = vector.at(2);
-          r["cmdline"] = vector.at(3);
-        } else if (isPlatform(PlatformType::TYPE_LINUX) &&
-                   vector.size() == 21) {
-          r["state"] = vector.at(1);
-          r["uid"] = BIGINT(vector.at(2));
-          r["gid"] = BIGINT(vector.at(3));
-          r["euid"] = BIGINT(vector.at(4));
-          r["egid"] = BIGINT(vector.at(5));
-          r["suid"] = BIGINT(vector.at(6));
-          r["sgid"] = BIGINT(vector.at(7));
-          r["resident_size"] = BIGINT(vector.at(8) + "000");
-          r["total_size"] = BIGINT(vector.at(9) + "000");
-          r["start_time"] = BIGINT(vector.at(10));
-          r["parent"] = BIGINT(vector.at(11));
-          r["pgroup"] = BIGINT(vector.at(12));
-          r["threads"] = INTEGER(vector.at(13));
-          r["nice"] = INTEGER(vector.at(14));
-          r["user"] = vector.at(15);
-          r["time"] = vector.at(16);
-          r["cpu"] = DOUBLE(vector.at(17));
-          r["mem"] = DOUBLE(vector.at(18));
-          r["name"] = vector.at(19);
-          r["cmdline"] = vector.at(20);
-        } else {
-          continue;
-        }
+  try {
+    for (const auto& processes : container.get_child("Processes")) {
+      std::vector<std::string> vector;
+      for (const auto& v : processes.second) {
+        vector.push_back(v.second.data());
+      }
 
-        results.push_back(r);
+      Row r;
+      r["id"] = id;
+      r["pid"] = BIGINT(vector.at(0));
+      r["wired_size"] = BIGINT(0); // No support for unpagable counters
+      if (isPlatform(PlatformType::TYPE_OSX) && vector.size() == 4) {
+        r["uid"] = BIGINT(vector.at(1));
+        r["time"] = vector.at(2);
+        r["cmdline"] = vector.at(3);
+      } else if (isPlatform(PlatformType::TYPE_LINUX) &&
+                 vector.size() == 21) {
+        r["state"] = vector.at(1);
+        r["uid"] = BIGINT(vector.at(2));
+        r["gid"] = BIGINT(vector.at(3));
+        r["euid"] = BIGINT(vector.at(4));
+        r["egid"] = BIGINT(vector.at(5));
+        r["suid"] = BIGINT(vector.at(6));
+        r["sgid"] = BIGINT(vector.at(7));
+        r["resident_size"] = BIGINT(vector.at(8) + "000");
+        r["total_size"] = BIGINT(vector.at(9) + "000");
+        r["start_time"] = BIGINT(vector.at(10));
+        r["parent"] = BIGINT(vector.at(11));
+        r["pgroup"] = BIGINT(vector.at(12));
+        r["threads"] = INTEGER(vector.at(13));
+        r["nice"] = INTEGER(vector.at(14));
+        r["user"] = vector.at(15);
+        r["time"] = vector.at(16);
+        r["cpu"] = DOUBLE(vector.at(17));
+        r["mem"] = DOUBLE(vector.at(18));
+        r["name"] = vector.at(19);
+        r["cmdline"] = vector.at(20);
+      } else {
+        continue;
       }
-    } catch (const pt::ptree_error& e) {
-      VLOG(1) << "Error getting docker container processes " << id << ": "
-              << e.what();
+
+      results.push_back(r);
     }
+  } catch (const pt::ptree_error& e) {
+    VLOG(1) << "Error getting docker container processes " << id << ": "
+            << e.what();
   }
+}
 
-  return results;
+/**
+ * @brief Entry point for docker_container_processes table.
+ */
+QueryData genContainerProcesses(QueryContext& context) {
+  return genDockerRowsParallel(
+      getConstraintIds(context),
+      [&context](const std::string& id, QueryData& results) {
+        getContainerProcesses(context, id, results);
+      });
 }
 
 /**
@@ -700,43 +932,47 @@ char getFsChangeType(int type_id) {
 }
 
 /**
- * @brief Entry point for docker_container_fs_changes table.
+ * @brief File system changes extractor for docker_container_fs_changes table
  */
-QueryData genContainerFsChanges(QueryContext& context) {
-  QueryData results;
-
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
-
-    pt::ptree tree;
-    auto s = dockerApi("/containers/" + id + "/changes", tree);
-    if (!s.ok()) {
-      VLOG(1) << "Error getting docker container fs changes" << id << ": "
-              << s.what();
-      continue;
-    }
+void getContainerFsChanges(QueryContext& context,
+                           const std::string& id,
+                           QueryData& results) {
+  pt::ptree tree;
+  auto s = dockerApi(context, "/containers/" + id + "/changes", tree);
+  if (!s.ok()) {
+    VLOG(1) << "Error getting docker container fs changes" << id << ": "
+            << s.what();
+    return;
+  }
 
-    for (const auto& entry : tree) {
-      try {
-        const pt::ptree& node = entry.second;
-        char change_type = getFsChangeType(node.get<int>("Kind"));
-        if (change_type == ' ') {
-          continue;
-        }
-        Row r;
-        r["id"] = id;
-        r["path"] = node.get<std::string>("Path");
-        r["change_type"] = change_type;
-        results.push_back(r);
-      } catch (const pt::ptree_error& e) {
-        VLOG(1) << "Error getting docker container fs changes details: "
-                << e.what();
+  for (const auto& entry : tree) {
+    try {
+      const pt::ptree& node = entry.second;
+      char change_type = getFsChangeType(node.get<int>("Kind"));
+      if (change_type == ' ') {
+        continue;
       }
+      Row r;
+      r["id"] = id;
+      r["path"] = node.get<std::string>("Path");
+      r["change_type"] = change_type;
+      results.push_back(r);
+    } catch (const pt::ptree_error& e) {
+      VLOG(1) << "Error getting docker container fs changes details: "
+              << e.what();
     }
   }
-  return results;
+}
+
+/**
+ * @brief Entry point for docker_container_fs_changes table.
+ */
+QueryData genContainerFsChanges(QueryContext& context) {
+  return genDockerRowsParallel(
+      getConstraintIds(context),
+      [&context](const std::string& id, QueryData& results) {
+        getContainerFsChanges(context, id, results);
+      });
 }
 
 /**
@@ -834,82 +1070,86 @@ std::string getNetworkBytes(const pt::ptree& tree, const std::string& key) {
 }
 
 /**
- * @brief Entry point for docker_container_stats table.
+ * @brief Stats extractor for docker_container_stats table
  */
-QueryData genContainerStats(QueryContext& context) {
-  QueryData results;
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
-
-    pt::ptree container;
-    Status s =
-        dockerApi("/containers/" + id + "/stats?stream=false", container);
-    if (!s.ok()) {
-      VLOG(1) << "Error getting docker container " << id << ": " << s.what();
-      continue;
-    }
+void getContainerStats(QueryContext& context,
+                       const std::string& id,
+                       QueryData& results) {
+  pt::ptree container;
+  Status s = dockerApi(
+      context, "/containers/" + id + "/stats?stream=false", container);
+  if (!s.ok()) {
+    VLOG(1) << "Error getting docker container " << id << ": " << s.what();
+    return;
+  }
 
-    try {
-      Row r;
-      r["id"] = id;
-      r["name"] = container.get<std::string>("name", "");
-      r["pids"] = container.get<int>("pids_stats.current", 0);
-      const std::string& read = container.get<std::string>("read", "");
-      long read_unix_time = getUnixTime(read, false);
-      r["read"] = BIGINT(read_unix_time);
-      const std::string& preread = container.get<std::string>("preread", "");
-      long preread_unix_time = getUnixTime(preread, false);
-      r["preread"] = BIGINT(preread_unix_time);
-      long intervalNanos = ((read_unix_time - preread_unix_time) * 1000000000) +
-                           diffNanos(read, preread);
-      r["interval"] = BIGINT(intervalNanos);
-      r["disk_read"] = getIOBytes(
-          container.get_child("blkio_stats.io_service_bytes_recursive"),
-          "Read");
-      r["disk_write"] = getIOBytes(
-          container.get_child("blkio_stats.io_service_bytes_recursive"),
-          "Write");
-      r["num_procs"] = INTEGER(container.get<int>("num_procs", 0));
-      r["cpu_total_usage"] =
-          BIGINT(container.get<uint64_t>("cpu_stats.cpu_usage.total_usage", 0));
-      r["cpu_kernelmode_usage"] = BIGINT(container.get<uint64_t>(
-          "cpu_stats.cpu_usage.usage_in_kernelmode", 0));
-      r["cpu_usermode_usage"] = BIGINT(
-          container.get<uint64_t>("cpu_stats.cpu_usage.usage_in_usermode", 0));
-      r["system_cpu_usage"] =
-          BIGINT(container.get<uint64_t>("cpu_stats.system_cpu_usage", 0));
-      r["online_cpus"] =
-          INTEGER(container.get<uint64_t>("cpu_stats.online_cpus", 0));
-      r["pre_cpu_total_usage"] = BIGINT(
-          container.get<uint64_t>("precpu_stats.cpu_usage.total_usage", 0));
-      r["pre_cpu_kernelmode_usage"] = BIGINT(container.get<uint64_t>(
-          "precpu_stats.cpu_usage.usage_in_kernelmode", 0));
-      r["pre_cpu_usermode_usage"] = BIGINT(container.get<uint64_t>(
-          "precpu_stats.cpu_usage.usage_in_usermode", 0));
-      r["pre_system_cpu_usage"] =
-          BIGINT(container.get<uint64_t>("precpu_stats.system_cpu_usage", 0));
-      r["pre_online_cpus"] =
-          INTEGER(container.get<uint64_t>("precpu_stats.online_cpus", 0));
-      r["memory_usage"] =
-          BIGINT(container.get<uint64_t>("memory_stats.usage", 0));
-      r["memory_max_usage"] =
-          BIGINT(container.get<uint64_t>("memory_stats.max_usage", 0));
-      r["memory_limit"] =
-          BIGINT(container.get<uint64_t>("memory_stats.limit", 0));
-      r["network_rx_bytes"] =
-          getNetworkBytes(container.get_child("networks"), "rx_bytes");
-      r["network_tx_bytes"] =
-          getNetworkBytes(container.get_child("networks"), "tx_bytes");
-      results.push_back(r);
-    } catch (const pt::ptree_error& e) {
-      VLOG(1) << "Error getting docker container stats " << id << ": "
-              << e.what();
-    }
+  try {
+    Row r;
+    r["id"] = id;
+    r["name"] = container.get<std::string>("name", "");
+    r["pids"] = container.get<int>("pids_stats.current", 0);
+    const std::string& read = container.get<std::string>("read", "");
+    long read_unix_time = getUnixTime(read, false);
+    r["read"] = BIGINT(read_unix_time);
+    const std::string& preread = container.get<std::string>("preread", "");
+    long preread_unix_time = getUnixTime(preread, false);
+    r["preread"] = BIGINT(preread_unix_time);
+    long intervalNanos = ((read_unix_time - preread_unix_time) * 1000000000) +
+                         diffNanos(read, preread);
+    r["interval"] = BIGINT(intervalNanos);
+    r["disk_read"] = getIOBytes(
+        container.get_child("blkio_stats.io_service_bytes_recursive"),
+        "Read");
+    r["disk_write"] = getIOBytes(
+        container.get_child("blkio_stats.io_service_bytes_recursive"),
+        "Write");
+    r["num_procs"] = INTEGER(container.get<int>("num_procs", 0));
+    r["cpu_total_usage"] =
+        BIGINT(container.get<uint64_t>("cpu_stats.cpu_usage.total_usage", 0));
+    r["cpu_kernelmode_usage"] = BIGINT(container.get<uint64_t>(
+        "cpu_stats.cpu_usage.usage_in_kernelmode", 0));
+    r["cpu_usermode_usage"] = BIGINT(
+        container.get<uint64_t>("cpu_stats.cpu_usage.usage_in_usermode", 0));
+    r["system_cpu_usage"] =
+        BIGINT(container.get<uint64_t>("cpu_stats.system_cpu_usage", 0));
+    r["online_cpus"] =
+        INTEGER(container.get<uint64_t>("cpu_stats.online_cpus", 0));
+    r["pre_cpu_total_usage"] = BIGINT(
+        container.get<uint64_t>("precpu_stats.cpu_usage.total_usage", 0));
+    r["pre_cpu_kernelmode_usage"] = BIGINT(container.get<uint64_t>(
+        "precpu_stats.cpu_usage.usage_in_kernelmode", 0));
+    r["pre_cpu_usermode_usage"] = BIGINT(container.get<uint64_t>(
+        "precpu_stats.cpu_usage.usage_in_usermode", 0));
+    r["pre_system_cpu_usage"] =
+        BIGINT(container.get<uint64_t>("precpu_stats.system_cpu_usage", 0));
+    r["pre_online_cpus"] =
+        INTEGER(container.get<uint64_t>("precpu_stats.online_cpus", 0));
+    r["memory_usage"] =
+        BIGINT(container.get<uint64_t>("memory_stats.usage", 0));
+    r["memory_max_usage"] =
+        BIGINT(container.get<uint64_t>("memory_stats.max_usage", 0));
+    r["memory_limit"] =
+        BIGINT(container.get<uint64_t>("memory_stats.limit", 0));
+    r["network_rx_bytes"] =
+        getNetworkBytes(container.get_child("networks"), "rx_bytes");
+    r["network_tx_bytes"] =
+        getNetworkBytes(container.get_child("networks"), "tx_bytes");
+    results.push_back(r);
+  } catch (const pt::ptree_error& e) {
+    VLOG(1) << "Error getting docker container stats " << id << ": "
+            << e.what();
   }
+}
 
-  return results;
+/**
+ * @brief Entry point for docker_container_stats table.
+ */
+QueryData genContainerStats(QueryContext& context) {
+  return genDockerRowsParallel(
+      getConstraintIds(context),
+      [&context](const std::string& id, QueryData& results) {
+        getContainerStats(context, id, results);
+      });
 }
 
 /**
@@ -922,7 +1162,7 @@ QueryData genNetworks(QueryContext& context) {
 
   QueryData results;
   pt::ptree tree;
-  Status s = dockerApi("/networks" + query, tree);
+  Status s = dockerApi(context, "/networks" + query, tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker networks: " << s.what();
     return results;
@@ -978,7 +1218,7 @@ QueryData genVolumes(QueryContext& context) {
 
   QueryData results;
   pt::ptree tree;
-  Status s = dockerApi("/volumes" + query, tree);
+  Status s = dockerApi(context, "/volumes" + query, tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker volumes: " << s.what();
     return results;
@@ -1018,11 +1258,13 @@ QueryData genVolumeLabels(QueryContext& context) {
 /**
  * @brief Image layer extractor for docker_image_layers table
  */
-void getImageLayers(const std::string& image_id, QueryData& results) {
+void getImageLayers(QueryContext& context,
+                    const std::string& image_id,
+                    QueryData& results) {
   pt::ptree tree;
   std::vector<std::string> layers;
 
-  Status s = dockerApi("/images/" + image_id + "/json", tree);
+  Status s = dockerApi(context, "/images/" + image_id + "/json", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker images layers: " << s.what();
     return;
@@ -1053,9 +1295,9 @@ void getImageLayers(const std::string& image_id, QueryData& results) {
 /**
  * @brief Calls layer extractor for all images for docker_image_layers table
  */
-void getImageLayersAll(QueryData& results) {
+void getImageLayersAll(QueryContext& context, QueryData& results) {
   pt::ptree tree;
-  Status s = dockerApi("/images/json", tree);
+  Status s = dockerApi(context, "/images/json", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker images: " << s.what();
     return;
@@ -1067,7 +1309,7 @@ void getImageLayersAll(QueryData& results) {
       if (boost::starts_with(id, "sha256:")) {
         id.erase(0, 7);
       }
-      getImageLayers(id, results);
+      getImageLayers(context, id, results);
     } catch (const pt::ptree_error& e) {
       VLOG(1) << "Error getting docker image details: " << e.what();
     }
@@ -1088,10 +1330,10 @@ QueryData genImageLayers(QueryContext& context) {
       if (!checkConstraintValue(id)) {
         continue;
       }
-      getImageLayers(id, results);
+      getImageLayers(context, id, results);
     }
   } else { // get layers for all images
-    getImageLayersAll(results);
+    getImageLayersAll(context, results);
   }
   return results;
 }
@@ -1099,9 +1341,11 @@ QueryData genImageLayers(QueryContext& context) {
 /**
  * @brief Image history extractor for docker_image_history table
  */
-void getImageHistory(const std::string& image_id, QueryData& results) {
+void getImageHistory(QueryContext& context,
+                     const std::string& image_id,
+                     QueryData& results) {
   pt::ptree tree;
-  Status s = dockerApi("/images/" + image_id + "/history", tree);
+  Status s = dockerApi(context, "/images/" + image_id + "/history", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker images history: " << s.what();
     return;
@@ -1135,9 +1379,9 @@ void getImageHistory(const std::string& image_id, QueryData& results) {
 /**
  * @brief Calls history for all images for docker_image_history table
  */
-void getImageHistoryAll(QueryData& results) {
+void getImageHistoryAll(QueryContext& context, QueryData& results) {
   pt::ptree tree;
-  Status s = dockerApi("/images/json", tree);
+  Status s = dockerApi(context, "/images/json", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker images: " << s.what();
     return;
@@ -1149,7 +1393,7 @@ void getImageHistoryAll(QueryData& results) {
       if (boost::starts_with(id, "sha256:")) {
         id.erase(0, 7);
       }
-      getImageHistory(id, results);
+      getImageHistory(context, id, results);
     } catch (const pt::ptree_error& e) {
       VLOG(1) << "Error getting docker image history: " << e.what();
     }
@@ -1166,10 +1410,10 @@ QueryData genImageHistory(QueryContext& context) {
       if (!checkConstraintValue(id)) {
         continue;
       }
-      getImageHistory(id, results);
+      getImageHistory(context, id, results);
     }
   } else {
-    getImageHistoryAll(results);
+    getImageHistoryAll(context, results);
   }
   return results;
 }
@@ -1180,7 +1424,7 @@ QueryData genImageHistory(QueryContext& context) {
 QueryData genImages(QueryContext& context) {
   QueryData results;
   pt::ptree tree;
-  Status s = dockerApi("/images/json", tree);
+  Status s = dockerApi(context, "/images/json", tree);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker images: " << s.what();
     return results;
@@ -21,55 +21,88 @@
 #include <osquery/core/tables.h>
 #include <osquery/tables/applications/posix/prometheus_metrics.h>
 #include <osquery/utils/conversions/split.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 namespace tables {
 
+/// Seconds a scraped response is reused by other queries, by default.
+const size_t kDefaultScrapeCacheTTL{1};
+
+/// Responses of the recent scrapes, by target.
+Mutex kScrapeCacheMutex;
+std::map<std::string, PrometheusResponseData> kScrapeCache;
+
 void parseScrapeResults(
     const std::map<std::string, PrometheusResponseData>& scrapeResults,
-    QueryData& rows) {
+    QueryData& rows,
+    const std::set<std::string>& metrics) {
   for (auto const& target : scrapeResults) {
     std::stringstream ss(target.second.content);
     std::string dest;
 
     while (std::getline(ss, dest)) {
-      if (!dest.empty() && dest[0] != '#') {
-        auto metric(osquery::split(dest, " "));
-
-        if (metric.size() > 1) {
-          Row r;
-          r[kColTargetName] = target.first;
-          r[kColTimeStamp] = BIGINT(target.second.timestampMS.count());
-          r[kColMetric] = metric[0];
-          r[kColValue] = metric[1];
+      if (dest.empty() || dest[0] == '#') {
+        continue;
+      }
 
-          rows.push_back(r);
+      if (!metrics.empty()) {
+        // Skip unwanted series before splitting the line.
+        auto name_start = dest.find_first_not_of(' ');
+        if (name_start == std::string::npos) {
+          continue;
+        }
+        auto name_end = dest.find(' ', name_start);
+        if (metrics.count(dest.substr(name_start, name_end - name_start)) ==
+            0) {
+          continue;
         }
       }
+
+      auto metric(osquery::split(dest, " "));
+      if (metric.size() > 1) {
+        Row r;
+        r[kColTargetName] = target.first;
+        r[kColTimeStamp] = BIGINT(target.second.timestampMS.count());
+        r[kColMetric] = metric[0];
+        r[kColValue] = metric[1];
+
+        rows.push_back(r);
+      }
     }
   }
 }
 
-void scrapeTargets(std::map<std::string, PrometheusResponseData>& scrapeResults,
-                   size_t timeoutS) {
+void scrapeTarget(const std::string& url,
+                  PrometheusResponseData& data,
+                  size_t timeoutS) {
   http::Client client(
       http::Client::Options().follow_redirects(true).timeout(timeoutS));
 
+  try {
+    http::Request request(url);
+    http::Response response(client.get(request));
+
+    data.timestampMS = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    data.content = response.body();
+
+  } catch (std::exception& e) {
+    LOG(ERROR) << "Failed on scrape of target " << url << ": " << e.what();
+  }
+}
+
+void scrapeTargets(std::map<std::string, PrometheusResponseData>& scrapeResults,
+                   size_t timeoutS) {
+  std::vector<std::pair<const std::string, PrometheusResponseData>*> targets;
   for (auto& target : scrapeResults) {
-    try {
-      http::Request request(target.first);
-      http::Response response(client.get(request));
-
-      target.second.timestampMS =
-          std::chrono::duration_cast<std::chrono::milliseconds>(
-              std::chrono::system_clock::now().time_since_epoch());
-      target.second.content = response.body();
-
-    } catch (std::exception& e) {
-      LOG(ERROR) << "Failed on scrape of target " << target.first << ": "
-                 << e.what();
-    }
+    targets.push_back(&target);
   }
+
+  // Targets are mostly waited on, each scrape has its own client.
+  runTableIOTasks(targets.size(), [&targets, timeoutS](size_t i) {
+    scrapeTarget(targets[i]->first, targets[i]->second, timeoutS);
+  });
 }
 
 QueryData genPrometheusMetrics(QueryContext& context) {
@@ -97,19 +130,68 @@ QueryData genPrometheusMetrics(QueryContext& context) {
     return result;
   }
 
+  // Only the targets named by constraints are scraped.
+  auto targets = context.constraints[kColTargetName].getAll(EQUALS);
+
   std::map<std::string, PrometheusResponseData> sr;
   /* Below should be unreachable if there were no urls child node, but we set
    * handle with default value for consistency's sake and for added robustness.
    */
   const auto& urls = config["urls"];
   for (const auto& url : urls.GetArray()) {
-    sr[url.GetString()] = PrometheusResponseData{};
+    if (targets.empty() || targets.count(url.GetString()) > 0) {
+      sr[url.GetString()] = PrometheusResponseData{};
+    }
   }
 
   size_t timeout =
       (!config.HasMember("timeout")) ? 1 : config["timeout"].GetUint64();
-  scrapeTargets(sr, timeout);
-  parseScrapeResults(sr, result);
+  size_t ttl = (!config.HasMember("cache_ttl"))
+                   ? kDefaultScrapeCacheTTL
+                   : config["cache_ttl"].GetUint64();
+
+  // Queries in the same interval share the responses of the targets.
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  std::map<std::string, PrometheusResponseData> scrapes;
+  {
+    WriteLock lock(kScrapeCacheMutex);
+    for (auto& target : sr) {
+      auto cached = kScrapeCache.find(target.first);
+      if (cached != kScrapeCache.end() &&
+          now - cached->second.timestampMS < std::chrono::seconds(ttl)) {
+        target.second = cached->second;
+      } else {
+        scrapes[target.first] = PrometheusResponseData{};
+      }
+    }
+  }
+
+  scrapeTargets(scrapes, timeout);
+
+  {
+    WriteLock lock(kScrapeCacheMutex);
+    for (auto& scrape : scrapes) {
+      if (ttl > 0 && scrape.second.timestampMS.count() > 0) {
+        kScrapeCache[scrape.first] = scrape.second;
+      }
+    }
+
+    // Forget the responses that expired.
+    for (auto it = kScrapeCache.begin(); it != kScrapeCache.end();) {
+      if (now - it->second.timestampMS >= std::chrono::seconds(ttl)) {
+        it = kScrapeCache.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  for (auto& scrape : scrapes) {
+    sr[scrape.first] = std::move(scrape.second);
+  }
+  parseScrapeResults(
+      sr, result, context.constraints[kColMetric].getAll(EQUALS));
 
   return result;
 }
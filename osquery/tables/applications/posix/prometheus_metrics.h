@@ -11,6 +11,7 @@
 
 #include <chrono>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -35,14 +36,16 @@ struct PrometheusResponseData {
  * @param scrapeResults map where the key is the target url scraped and
  * value is the struct PrometheusResponseData of the corresponding target.
  *
+ * @param metrics the names of the metrics to return, all metrics if empty.
  */
 void parseScrapeResults(
     const std::map<std::string, PrometheusResponseData>& scrapeResults,
-    QueryData& rows);
+    QueryData& rows,
+    const std::set<std::string>& metrics = {});
 
 /**
- * @brief Scrapes the Prometheus targets and returns response payload and
- * timestamp.
+ * @brief Scrapes the Prometheus targets concurrently and returns response
+ * payload and timestamp.
  *
  * @param scrapeResults map where the key is the target url to be scraped and
  * value is the struct PrometheusResponseData where payload and timestamp are to
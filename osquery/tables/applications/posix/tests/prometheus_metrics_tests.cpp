@@ -411,5 +411,25 @@ TEST_F(PrometheusMetricsTest, happy_path_10_metrics_2_targets) {
 
   validate(sr, expected);
 }
+
+TEST_F(PrometheusMetricsTest, metric_name_filter) {
+  std::chrono::milliseconds now(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch()));
+  PrometheusResponseData r0 = PrometheusResponseData{
+      "# TYPE process_open_fds gauge\nprocess_open_fds 7\n"
+      "process_max_fds 1.048576e+06\n  process_open_fds_total 8\n",
+      now};
+  std::map<std::string, PrometheusResponseData> sr = {{"example1.com", r0}};
+
+  // Only the series of the named metrics are returned.
+  QueryData got;
+  parseScrapeResults(sr, got, {"process_open_fds", "process_open_fds_total"});
+  ASSERT_EQ(got.size(), 2U);
+  EXPECT_EQ(got[0][kColMetric], "process_open_fds");
+  EXPECT_EQ(got[0][kColValue], "7");
+  EXPECT_EQ(got[1][kColMetric], "process_open_fds_total");
+  EXPECT_EQ(got[1][kColValue], "8");
+}
 } // namespace tables
 } // namespace osquery
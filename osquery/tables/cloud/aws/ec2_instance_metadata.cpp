@@ -17,6 +17,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/cloud/metadata_cache.h>
 #include <osquery/utils/aws/aws_util.h>
 
 namespace pt = boost::property_tree;
@@ -34,12 +35,18 @@ class Ec2MetaData {
    */
   const std::string url_suffix_;
 
+  /**
+   * @brief True if the metadata never changes for the life of the instance.
+   */
+  const bool immutable_;
+
   /**
    * @brief Get metadata using HTTP.
    *
-   * @return HTTP body.
+   * @param url_suffix the metadata URL suffix.
+   * @param http_body set to the HTTP body, empty if there is no such data.
    */
-  std::string doGet() const;
+  static Status doGet(const std::string& url_suffix, std::string& http_body);
 
   /**
    * @brief Extract relevant data from return API call, pure virtual
@@ -50,8 +57,8 @@ class Ec2MetaData {
   virtual void extractResult(const std::string& http_body, Row& r) const = 0;
 
  public:
-  Ec2MetaData(const std::string urlSuffix)
-      : url_suffix_(std::move(urlSuffix)) {}
+  Ec2MetaData(const std::string urlSuffix, bool immutable)
+      : url_suffix_(std::move(urlSuffix)), immutable_(immutable) {}
 
   virtual ~Ec2MetaData() {}
 
@@ -61,7 +68,15 @@ class Ec2MetaData {
    * @param r The row to which the value need to be added
    */
   void get(Row& r) const {
-    const std::string http_body = doGet();
+    // Metadata is shared with other queries, see CloudMetadataCache.
+    std::string http_body;
+    CloudMetadataCache::get().value(
+        "ec2_metadata." + url_suffix_,
+        getCloudMetadataTTL(immutable_),
+        [suffix = url_suffix_](std::string& body) {
+          return doGet(suffix, body);
+        },
+        http_body);
     extractResult(http_body, r);
   }
 };
@@ -87,8 +102,9 @@ class SimpleEc2MetaData : public Ec2MetaData {
  public:
   SimpleEc2MetaData(const ColumnType sqlType,
                     const std::string columnName,
-                    const std::string urlSuffix)
-      : Ec2MetaData(urlSuffix),
+                    const std::string urlSuffix,
+                    bool immutable = true)
+      : Ec2MetaData(urlSuffix, immutable),
         sql_type_(std::move(sqlType)),
         column_name_(std::move(columnName)) {}
 
@@ -116,18 +132,20 @@ class JSONEc2MetaData : public Ec2MetaData {
  public:
   JSONEc2MetaData(const std::vector<std::string> columnNames,
                   const std::vector<std::string> keyNames,
-                  const std::string urlSuffix)
-      : Ec2MetaData(urlSuffix),
+                  const std::string urlSuffix,
+                  bool immutable = true)
+      : Ec2MetaData(urlSuffix, immutable),
         column_names_(std::move(columnNames)),
         key_names_(std::move(keyNames)) {}
 
   virtual ~JSONEc2MetaData() {}
 };
 
-std::string Ec2MetaData::doGet() const {
+Status Ec2MetaData::doGet(const std::string& url_suffix,
+                          std::string& http_body) {
   const static std::string ec2_metadata_url{kEc2MetadataUrl};
 
-  http::Request req(ec2_metadata_url + url_suffix_);
+  http::Request req(ec2_metadata_url + url_suffix);
   http::Client::Options options;
   options.timeout(3);
   http::Client client(options);
@@ -138,22 +156,24 @@ std::string Ec2MetaData::doGet() const {
 
     // Silently ignore 404
     if (http_status_code == 404) {
-      return "";
+      http_body.clear();
+      return Status::success();
     }
 
     // Log "hard" errors
     if (http_status_code != 200) {
-      VLOG(1) << "Unexpected HTTP response for: " << url_suffix_
+      VLOG(1) << "Unexpected HTTP response for: " << url_suffix
               << " Status: " << http_status_code;
-      return "";
+      return Status::failure("Unexpected HTTP response " +
+                             std::to_string(http_status_code));
     }
 
-    return res.body();
+    http_body = res.body();
+    return Status::success();
   } catch (std::system_error& e) {
-    VLOG(1) << "Request for " << url_suffix_ << " failed: " << e.what();
+    VLOG(1) << "Request for " << url_suffix << " failed: " << e.what();
+    return Status::failure(e.what());
   }
-
-  return "";
 }
 
 void setRowField(const ColumnType sql_type,
@@ -231,7 +251,8 @@ QueryData genEc2Metadata(QueryContext& context) {
        std::make_shared<JSONEc2MetaData>(
            JSONEc2MetaData(std::vector<std::string>({"iam_arn"}),
                            std::vector<std::string>({"InstanceProfileArn"}),
-                           "meta-data/iam/info")),
+                           "meta-data/iam/info",
+                           false)),
        std::make_shared<SimpleEc2MetaData>(
            SimpleEc2MetaData(TEXT_TYPE, "mac", "meta-data/mac")),
        std::make_shared<SimpleEc2MetaData>(SimpleEc2MetaData(
@@ -240,8 +261,11 @@ QueryData genEc2Metadata(QueryContext& context) {
            TEXT_TYPE, "ssh_public_key", "meta-data/public-keys/0/openssh-key")),
        std::make_shared<SimpleEc2MetaData>(SimpleEc2MetaData(
            TEXT_TYPE, "reservation_id", "meta-data/reservation-id")),
-       std::make_shared<SimpleEc2MetaData>(SimpleEc2MetaData(
-           TEXT_TYPE, "security_groups", "meta-data/security-groups"))});
+       std::make_shared<SimpleEc2MetaData>(
+           SimpleEc2MetaData(TEXT_TYPE,
+                             "security_groups",
+                             "meta-data/security-groups",
+                             false))});
 
   Row r;
   for (const auto& it : fields) {
@@ -13,8 +13,10 @@
 #include <aws/ec2/EC2Client.h>
 #include <aws/ec2/model/DescribeTagsRequest.h>
 
+#include <osquery/core/sql/query_data.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/cloud/metadata_cache.h>
 #include <osquery/utils/aws/aws_util.h>
 
 namespace osquery {
@@ -23,19 +25,14 @@ namespace tables {
 namespace ec2 = Aws::EC2;
 namespace model = Aws::EC2::Model;
 
-QueryData genEc2InstanceTags(QueryContext& context) {
-  QueryData results;
-  std::string instance_id, region;
-  getInstanceIDAndRegion(instance_id, region);
-  if (instance_id.empty() || region.empty()) {
-    return results;
-  }
-
+Status fetchEc2InstanceTags(const std::string& instance_id,
+                            const std::string& region,
+                            std::string& json) {
   std::shared_ptr<ec2::EC2Client> client;
   Status s = makeAWSClient<ec2::EC2Client>(client, region, false);
   if (!s.ok()) {
     VLOG(1) << "Failed to create EC2 client: " << s.what();
-    return results;
+    return s;
   }
 
   model::Filter filter;
@@ -49,9 +46,10 @@ QueryData genEc2InstanceTags(QueryContext& context) {
   if (!outcome.IsSuccess()) {
     VLOG(1) << "Error getting EC2 instance tags: "
             << outcome.GetError().GetMessage();
-    return results;
+    return Status::failure(outcome.GetError().GetMessage());
   }
 
+  QueryData results;
   model::DescribeTagsResponse response = outcome.GetResult();
   for (const auto& it : response.GetTags()) {
     Row r;
@@ -61,6 +59,30 @@ QueryData genEc2InstanceTags(QueryContext& context) {
     results.push_back(r);
   }
 
+  return serializeQueryDataJSON(results, json);
+}
+
+QueryData genEc2InstanceTags(QueryContext& context) {
+  QueryData results;
+  std::string instance_id, region;
+  getInstanceIDAndRegion(instance_id, region);
+  if (instance_id.empty() || region.empty()) {
+    return results;
+  }
+
+  // Tags are shared with other queries, see CloudMetadataCache.
+  std::string json;
+  auto s = CloudMetadataCache::get().value(
+      "ec2_tags." + instance_id,
+      getCloudMetadataTTL(false),
+      [instance_id, region](std::string& tags) {
+        return fetchEc2InstanceTags(instance_id, region, tags);
+      },
+      json);
+  if (!s.ok() || !deserializeQueryDataJSON(json, results).ok()) {
+    return QueryData();
+  }
+
   return results;
 }
 } // namespace tables
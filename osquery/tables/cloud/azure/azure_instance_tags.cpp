@@ -12,6 +12,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/cloud/metadata_cache.h>
 #include <osquery/utils/azure/azure_util.h>
 
 namespace osquery {
@@ -21,7 +22,15 @@ QueryData genAzureTags(QueryContext& context) {
   QueryData results;
   JSON doc;
 
-  Status s = fetchAzureMetadata(doc);
+  // Metadata is shared with other queries, see CloudMetadataCache.
+  std::string json;
+  Status s = CloudMetadataCache::get().value("azure_metadata",
+                                             getCloudMetadataTTL(false),
+                                             fetchAzureMetadataString,
+                                             json);
+  if (s.ok()) {
+    s = parseAzureMetadata(json, doc);
+  }
 
   if (!s.ok()) {
     TLOG << "Couldn't fetch metadata: " << s.what();
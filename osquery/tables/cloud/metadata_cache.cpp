@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/cloud/metadata_cache.h>
+#include <osquery/utils/info/tool_type.h>
+
+namespace osquery {
+
+FLAG(uint32,
+     cloud_metadata_ttl,
+     300,
+     "Seconds EC2 and Azure metadata and tags are cached (0 disables)");
+
+namespace {
+
+/// Values that never change are cached for at least this long.
+const std::chrono::seconds kImmutableMetadataTTL{3600};
+
+/// A failed fetch is retried after this long.
+const std::chrono::seconds kMetadataRetryInterval{30};
+
+/// Seconds between the background refreshes.
+const std::chrono::seconds kMetadataRefreshInterval{10};
+
+} // namespace
+
+CloudMetadataCache& CloudMetadataCache::get() {
+  static CloudMetadataCache cache;
+  return cache;
+}
+
+std::chrono::seconds getCloudMetadataTTL(bool immutable) {
+  std::chrono::seconds ttl(FLAGS_cloud_metadata_ttl);
+  if (ttl.count() == 0 || !immutable) {
+    return ttl;
+  }
+  return std::max(ttl, kImmutableMetadataTTL);
+}
+
+Status CloudMetadataCache::store(Entry& entry,
+                                 const Status& status,
+                                 const std::string& value,
+                                 std::chrono::steady_clock::time_point now) {
+  if (status.ok()) {
+    entry.value = value;
+    entry.valid = true;
+    entry.expires = now + entry.ttl;
+  } else {
+    entry.expires = now + std::min(entry.ttl, kMetadataRetryInterval);
+  }
+
+  // The last fetched value is used until a refetch succeeds.
+  entry.status = entry.valid ? Status::success() : status;
+  return entry.status;
+}
+
+Status CloudMetadataCache::value(const std::string& key,
+                                 std::chrono::seconds ttl,
+                                 Fetcher fetcher,
+                                 std::string& value) {
+  if (ttl.count() == 0) {
+    return fetcher(value);
+  }
+
+#ifndef OSQUERY_IS_FUZZING
+  static std::once_flag refresher_started;
+  if (isDaemon()) {
+    std::call_once(refresher_started, []() {
+      Dispatcher::addService(std::make_shared<CloudMetadataRefresher>());
+    });
+  }
+#endif
+
+  {
+    WriteLock lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end() &&
+        std::chrono::steady_clock::now() < it->second.expires) {
+      it->second.read = true;
+      value = it->second.value;
+      return it->second.status;
+    }
+  }
+
+  // Fetch without holding the lock, the metadata service may be slow.
+  std::string fetched;
+  auto status = fetcher(fetched);
+
+  WriteLock lock(mutex_);
+  auto& entry = entries_[key];
+  entry.ttl = ttl;
+  entry.fetcher = std::move(fetcher);
+  entry.read = true;
+  status = store(entry, status, fetched, std::chrono::steady_clock::now());
+  value = entry.value;
+  return status;
+}
+
+size_t CloudMetadataCache::refresh(std::chrono::seconds ahead) {
+  std::vector<std::pair<std::string, Fetcher>> due;
+  {
+    WriteLock lock(mutex_);
+    auto deadline = std::chrono::steady_clock::now() + ahead;
+    for (auto& entry : entries_) {
+      if (entry.second.read && !entry.second.refreshing &&
+          entry.second.expires <= deadline) {
+        // Values not read again are left to expire.
+        entry.second.read = false;
+        entry.second.refreshing = true;
+        due.emplace_back(entry.first, entry.second.fetcher);
+      }
+    }
+  }
+
+  for (const auto& key : due) {
+    std::string fetched;
+    auto status = key.second(fetched);
+
+    WriteLock lock(mutex_);
+    auto it = entries_.find(key.first);
+    if (it != entries_.end()) {
+      it->second.refreshing = false;
+      store(it->second, status, fetched, std::chrono::steady_clock::now());
+    }
+  }
+  return due.size();
+}
+
+void CloudMetadataCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+}
+
+std::chrono::milliseconds CloudMetadataRefresher::tick() {
+  CloudMetadataCache::get().refresh(kMetadataRefreshInterval * 2);
+  return kMetadataRefreshInterval;
+}
+} // namespace osquery
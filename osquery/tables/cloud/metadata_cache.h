@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Instance metadata shared by the cloud tables.
+ *
+ * The EC2 and Azure tables read their values from the instance metadata
+ * service and cloud APIs, which throttle frequent callers. Each value is
+ * fetched once per TTL, whichever table, query or decorator asks for it.
+ * Values read during their TTL are refetched in the background shortly
+ * before they expire, so queries rarely wait on the metadata service.
+ */
+class CloudMetadataCache : private boost::noncopyable {
+ public:
+  /// Fetches a value, called from a querying or the refreshing thread.
+  using Fetcher = std::function<Status(std::string& value)>;
+
+  /// The cache shared by the cloud tables.
+  static CloudMetadataCache& get();
+
+  /**
+   * @brief Get a value, fetching it if it is not cached or expired.
+   *
+   * A failed fetch is retried at most every 30 seconds. The last fetched
+   * value is returned meanwhile, if there is one.
+   *
+   * @param key the name of the value.
+   * @param ttl the time the value is reused, 0 to always fetch it.
+   * @param fetcher fetches the value, kept for the background refreshes.
+   * @param value set to the value.
+   */
+  Status value(const std::string& key,
+               std::chrono::seconds ttl,
+               Fetcher fetcher,
+               std::string& value);
+
+  /**
+   * @brief Refetch the values read since their last fetch that expire soon.
+   *
+   * @param ahead refresh the values expiring within this time.
+   * @return the number of refetched values.
+   */
+  size_t refresh(std::chrono::seconds ahead);
+
+  /// Forget every value.
+  void clear();
+
+ private:
+  struct Entry {
+    std::string value;
+    Status status;
+    bool valid{false};
+    bool read{false};
+    bool refreshing{false};
+    std::chrono::steady_clock::time_point expires;
+    std::chrono::seconds ttl{0};
+    Fetcher fetcher;
+  };
+
+  /// Store the result of a fetch, returning the status to report.
+  Status store(Entry& entry,
+               const Status& status,
+               const std::string& value,
+               std::chrono::steady_clock::time_point now);
+
+ private:
+  Mutex mutex_;
+  std::map<std::string, Entry> entries_;
+};
+
+/**
+ * @brief The TTL of cached cloud metadata, see --cloud_metadata_ttl.
+ *
+ * @param immutable true for values that do not change for the life of the
+ * instance, such as its ID or region.
+ */
+std::chrono::seconds getCloudMetadataTTL(bool immutable);
+
+/// Refreshes the cloud metadata read by recent queries before it expires.
+class CloudMetadataRefresher : public PeriodicRunnable {
+ public:
+  CloudMetadataRefresher() : PeriodicRunnable("CloudMetadataRefresher") {}
+
+ protected:
+  std::chrono::milliseconds tick() override;
+};
+} // namespace osquery
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/cloud/metadata_cache.h>
+
+namespace osquery {
+
+DECLARE_uint32(cloud_metadata_ttl);
+
+class CloudMetadataCacheTests : public testing::Test {
+ protected:
+  void TearDown() override {
+    CloudMetadataCache::get().clear();
+  }
+};
+
+TEST_F(CloudMetadataCacheTests, test_value_is_shared) {
+  auto& cache = CloudMetadataCache::get();
+
+  size_t fetches = 0;
+  auto fetcher = [&fetches](std::string& value) {
+    value = "value" + std::to_string(++fetches);
+    return Status::success();
+  };
+
+  std::string value;
+  ASSERT_TRUE(
+      cache.value("key", std::chrono::seconds(60), fetcher, value).ok());
+  EXPECT_EQ(value, "value1");
+  ASSERT_TRUE(
+      cache.value("key", std::chrono::seconds(60), fetcher, value).ok());
+  EXPECT_EQ(value, "value1");
+  EXPECT_EQ(fetches, 1U);
+
+  // Values read since their last fetch are refreshed before they expire.
+  EXPECT_EQ(cache.refresh(std::chrono::seconds(120)), 1U);
+  ASSERT_TRUE(
+      cache.value("key", std::chrono::seconds(60), fetcher, value).ok());
+  EXPECT_EQ(value, "value2");
+
+  // Without a TTL the value is always fetched.
+  ASSERT_TRUE(cache.value("key", std::chrono::seconds(0), fetcher, value).ok());
+  EXPECT_EQ(value, "value3");
+}
+
+TEST_F(CloudMetadataCacheTests, test_failed_fetch) {
+  auto& cache = CloudMetadataCache::get();
+
+  bool fail = false;
+  auto fetcher = [&fail](std::string& value) {
+    if (fail) {
+      return Status::failure("Throttled");
+    }
+    value = "value";
+    return Status::success();
+  };
+
+  std::string value;
+  ASSERT_TRUE(
+      cache.value("key", std::chrono::seconds(60), fetcher, value).ok());
+
+  // A failed refresh keeps the last value.
+  fail = true;
+  EXPECT_EQ(cache.refresh(std::chrono::seconds(120)), 1U);
+  value.clear();
+  auto s = cache.value("key", std::chrono::seconds(60), fetcher, value);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(value, "value");
+
+  // Values not read since their last fetch are left to expire.
+  EXPECT_EQ(cache.refresh(std::chrono::seconds(120)), 1U);
+  EXPECT_EQ(cache.refresh(std::chrono::seconds(120)), 0U);
+
+  // Without a last value the failure is reported.
+  s = cache.value("other", std::chrono::seconds(60), fetcher, value);
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(CloudMetadataCacheTests, test_ttl) {
+  auto ttl = FLAGS_cloud_metadata_ttl;
+  FLAGS_cloud_metadata_ttl = 60;
+  EXPECT_EQ(getCloudMetadataTTL(false), std::chrono::seconds(60));
+  EXPECT_EQ(getCloudMetadataTTL(true), std::chrono::seconds(3600));
+
+  FLAGS_cloud_metadata_ttl = 0;
+  EXPECT_EQ(getCloudMetadataTTL(true), std::chrono::seconds(0));
+  FLAGS_cloud_metadata_ttl = ttl;
+}
+} // namespace osquery
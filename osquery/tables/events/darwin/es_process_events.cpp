@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/tables.h>
+#include <osquery/events/darwin/endpointsecurity.h>
+#include <osquery/registry/registry_factory.h>
+
+namespace osquery {
+
+class ESProcessEventSubscriber
+    : public EventSubscriber<EndpointSecurityPublisher> {
+ public:
+  Status init() override;
+
+  Status Callback(const ECRef& ec, const SCRef& sc);
+};
+
+REGISTER(ESProcessEventSubscriber, "event_subscriber", "es_process_events");
+
+Status ESProcessEventSubscriber::init() {
+  auto sc = createSubscriptionContext();
+  sc->event_types = {
+      ES_EVENT_TYPE_NOTIFY_EXEC,
+      ES_EVENT_TYPE_NOTIFY_FORK,
+      ES_EVENT_TYPE_NOTIFY_EXIT,
+  };
+
+  subscribe(&ESProcessEventSubscriber::Callback, sc);
+  return Status::success();
+}
+
+Status ESProcessEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
+  Row r;
+  r["seq_num"] = BIGINT(ec->seq_num);
+  r["pid"] = BIGINT(ec->pid);
+  r["path"] = ec->path;
+  r["parent"] = BIGINT(ec->ppid);
+  r["original_parent"] = BIGINT(ec->original_ppid);
+  r["cmdline"] = ec->cmdline;
+  r["cwd"] = ec->cwd;
+  r["uid"] = BIGINT(ec->uid);
+  r["euid"] = BIGINT(ec->euid);
+  r["gid"] = BIGINT(ec->gid);
+  r["egid"] = BIGINT(ec->egid);
+  r["signing_id"] = ec->signing_id;
+  r["team_id"] = ec->team_id;
+  r["cdhash"] = ec->cdhash;
+  r["platform_binary"] = INTEGER(ec->platform_binary ? 1 : 0);
+  r["exit_code"] = INTEGER(ec->exit_code);
+  r["child_pid"] = BIGINT(ec->child_pid);
+  r["event_type"] = ec->event;
+
+  add(r);
+  return Status::success();
+}
+} // namespace osquery
@@ -112,7 +112,7 @@ Status FileEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
   r["action"] = ec->action;
   r["target_path"] = ec->path;
   r["category"] = sc->category;
-  r["transaction_id"] = INTEGER(ec->event->cookie);
+  r["transaction_id"] = INTEGER(ec->event.cookie);
 
   if ((sc->mask & kFileAccessMasks) != kFileAccessMasks) {
     // Add hashing and 'join' against the file table for stat-information.
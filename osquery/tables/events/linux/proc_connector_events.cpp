@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/tables.h>
+#include <osquery/events/linux/proc_connector.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/utils/conversions/split.h>
+
+namespace osquery {
+
+FLAG(bool,
+     proc_connector_fork_exit_events,
+     false,
+     "Also record process fork and exit events in proc_connector_events");
+
+namespace {
+
+/// Command lines and other /proc files are truncated to this size.
+const size_t kMaxProcFileSize = 32 * 1024;
+
+bool readProcFile(const std::string& path, std::string& content) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+
+  content.clear();
+  char buffer[4096];
+  while (content.size() < kMaxProcFileSize) {
+    auto size = ::read(fd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      break;
+    }
+    content.append(buffer, static_cast<size_t>(size));
+  }
+  ::close(fd);
+  return !content.empty();
+}
+
+std::string readProcLink(const std::string& path) {
+  char buffer[PATH_MAX];
+  auto size = ::readlink(path.c_str(), buffer, sizeof(buffer));
+  if (size <= 0 || static_cast<size_t>(size) >= sizeof(buffer)) {
+    return "";
+  }
+  return std::string(buffer, static_cast<size_t>(size));
+}
+
+/// Copy the real, effective, saved and filesystem IDs of a status line.
+void copyStatusIds(const std::string& line,
+                   const std::vector<std::string>& columns,
+                   Row& r) {
+  auto ids = split(line.substr(line.find(':') + 1), "\t ");
+  for (size_t i = 0; i < columns.size() && i < ids.size(); ++i) {
+    r[columns[i]] = ids[i];
+  }
+}
+
+/// Read the details of a running process from /proc.
+void readProcessDetails(pid_t pid, Row& r) {
+  auto root = "/proc/" + std::to_string(pid);
+
+  r["path"] = readProcLink(root + "/exe");
+  r["cwd"] = readProcLink(root + "/cwd");
+
+  std::string content;
+  if (readProcFile(root + "/cmdline", content)) {
+    // Arguments are NULL-separated, with a trailing NULL.
+    if (content.back() == '\0') {
+      content.pop_back();
+    }
+    std::replace(content.begin(), content.end(), '\0', ' ');
+    r["cmdline"] = content;
+  }
+
+  if (readProcFile(root + "/status", content)) {
+    for (const auto& line : split(content, "\n")) {
+      if (boost::starts_with(line, "PPid:") && r["parent"].empty()) {
+        copyStatusIds(line, {"parent"}, r);
+      } else if (boost::starts_with(line, "Uid:")) {
+        copyStatusIds(line, {"uid", "euid", "suid", "fsuid"}, r);
+      } else if (boost::starts_with(line, "Gid:")) {
+        copyStatusIds(line, {"gid", "egid", "sgid", "fsgid"}, r);
+      }
+    }
+  }
+
+  if (readProcFile(root + "/loginuid", content)) {
+    r["auid"] = content;
+  }
+
+  // The executable, even if it was replaced or deleted since.
+  struct stat file_stat;
+  if (!r["path"].empty() && ::stat((root + "/exe").c_str(), &file_stat) == 0) {
+    r["mode"] = lsperms(file_stat.st_mode);
+    r["owner_uid"] = BIGINT(file_stat.st_uid);
+    r["owner_gid"] = BIGINT(file_stat.st_gid);
+    r["btime"] = "0";
+    r["atime"] = BIGINT(file_stat.st_atime);
+    r["mtime"] = BIGINT(file_stat.st_mtime);
+    r["ctime"] = BIGINT(file_stat.st_ctime);
+  }
+}
+
+} // namespace
+
+/**
+ * @brief Track process executions using the netlink process connector.
+ *
+ * The rows are compatible with process_events, the details are read from
+ * /proc when the event is handled. Processes exiting before that only have
+ * their pid and parent.
+ */
+class ProcConnectorEventSubscriber
+    : public EventSubscriber<ProcConnectorEventPublisher> {
+ public:
+  Status init() override;
+
+  Status Callback(const ECRef& ec, const SCRef& sc);
+};
+
+REGISTER(ProcConnectorEventSubscriber,
+         "event_subscriber",
+         "proc_connector_events");
+
+Status ProcConnectorEventSubscriber::init() {
+  auto sc = createSubscriptionContext();
+  sc->actions = PROC_CONNECTOR_EXEC;
+  if (FLAGS_proc_connector_fork_exit_events) {
+    sc->actions |= PROC_CONNECTOR_FORK | PROC_CONNECTOR_EXIT;
+  }
+
+  subscribe(&ProcConnectorEventSubscriber::Callback, sc);
+  return Status::success();
+}
+
+Status ProcConnectorEventSubscriber::Callback(const ECRef& ec,
+                                              const SCRef& sc) {
+  const auto& event = ec->event;
+
+  Row r;
+  r["pid"] = BIGINT(event.pid);
+  r["uptime"] = BIGINT(event.timestamp / 1000000000ULL);
+  switch (event.action) {
+  case PROC_CONNECTOR_FORK:
+    r["action"] = "fork";
+    r["parent"] = BIGINT(event.parent);
+    break;
+  case PROC_CONNECTOR_EXEC:
+    r["action"] = "exec";
+    break;
+  case PROC_CONNECTOR_EXIT:
+    r["action"] = "exit";
+    r["exit_code"] = BIGINT(event.exit_code);
+    break;
+  }
+
+  // An exited process has nothing left to read.
+  if (event.action != PROC_CONNECTOR_EXIT) {
+    readProcessDetails(event.pid, r);
+  }
+
+  if (r["parent"].empty()) {
+    r["parent"] = "-1";
+  }
+
+  add(r);
+  return Status::success();
+}
+} // namespace osquery
@@ -275,7 +275,7 @@ Status AuditProcessEventSubscriber::ProcessExecveEventData(
       row["cmdline"] += ' ';
     }
 
-    row["cmdline"] += DecodeAuditPathValues(arg.second);
+    row["cmdline"] += DecodeAuditPathValues(arg.second.to_string());
   }
 
   row["cmdline_size"] = std::to_string(row["cmdline"].size());
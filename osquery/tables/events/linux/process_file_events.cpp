@@ -55,6 +55,12 @@ HIDDEN_FLAG(bool,
 REGISTER(ProcessFileEventSubscriber, "event_subscriber", "process_file_events");
 
 namespace {
+/// The max number of inodes whose path is remembered
+const std::size_t kMaxTrackedInodes = 20000;
+
+/// The max number of processes whose file descriptors are tracked
+const std::size_t kMaxTrackedProcesses = 4096;
+
 std::ostream& operator<<(std::ostream& stream,
                          AuditdFimSyscallContext::Type type) {
   switch (type) {
@@ -195,6 +201,33 @@ std::ostream& operator<<(std::ostream& stream,
   return stream;
 }
 
+/// Returns true if normalizing the absolute path would not change it
+bool IsNormalizedPath(const std::string& path) noexcept {
+  if (path.size() < 2 || path[0] != '/' || path.back() == '/') {
+    return false;
+  }
+
+  // Empty, "." and ".." components are the ones normalization resolves
+  std::size_t start = 1;
+  while (start < path.size()) {
+    auto end = path.find('/', start);
+    if (end == std::string::npos) {
+      end = path.size();
+    }
+
+    auto length = end - start;
+    bool is_dots = path[start] == '.' &&
+                   (length == 1 || (length == 2 && path[start + 1] == '.'));
+    if (length == 0 || is_dots) {
+      return false;
+    }
+
+    start = end + 1;
+  }
+
+  return true;
+}
+
 std::string NormalizePath(const std::string& cwd,
                           const std::string& path) noexcept {
   std::string translated_path;
@@ -220,6 +253,11 @@ std::string NormalizePath(const std::string& cwd,
     translated_path = translated_cwd + '/' + translated_path;
   }
 
+  // Most paths are already normalized, they are not parsed again
+  if (IsNormalizedPath(translated_path)) {
+    return translated_path;
+  }
+
   /*
     Normalize the path; we could have used 'canonicalize()' but that
     accesses the file system and we don't want that (because it may
@@ -239,9 +277,7 @@ bool EmitRowFromSyscallContext(
     const AuditdFimContext& fim_context,
     const AuditdFimSyscallContext& syscall_context) noexcept {
   auto L_IsPathIncluded = [&fim_context](const std::string& path) -> bool {
-    return (std::find(fim_context.included_path_list.begin(),
-                      fim_context.included_path_list.end(),
-                      path) != fim_context.included_path_list.end());
+    return fim_context.included_paths.count(path) > 0;
   };
 
   row.clear();
@@ -1190,12 +1226,8 @@ void ProcessFileEventSubscriber::configure() {
       StringList solved_path_list = {};
       resolveFilePattern(file, solved_path_list);
 
-      context_.included_path_list.reserve(context_.included_path_list.size() +
-                                          solved_path_list.size());
-
-      context_.included_path_list.insert(context_.included_path_list.end(),
-                                         solved_path_list.begin(),
-                                         solved_path_list.end());
+      context_.included_paths.insert(solved_path_list.begin(),
+                                     solved_path_list.end());
     }
   });
 }
@@ -1336,7 +1368,7 @@ const std::set<int>& ProcessFileEventSubscriber::GetSyscallSet() noexcept {
   return kProcessFileEventsSyscalls;
 }
 
-AuditdFimInodeMap::AuditdFimInodeMap() {
+AuditdFimInodeMap::AuditdFimInodeMap() : data_(kMaxTrackedInodes) {
   save(STDIN_FILENO, AuditdFimInodeDescriptor::Type::File, "stdin");
   save(STDOUT_FILENO, AuditdFimInodeDescriptor::Type::File, "stdout");
   save(STDERR_FILENO, AuditdFimInodeDescriptor::Type::File, "stderr");
@@ -1344,24 +1376,19 @@ AuditdFimInodeMap::AuditdFimInodeMap() {
 
 bool AuditdFimInodeMap::getReference(AuditdFimInodeDescriptor*& ino_desc,
                                      ino_t inode) {
-  auto it = data_.find(inode);
-  if (it == data_.end()) {
-    return false;
-  }
-
-  ino_desc = &it->second;
-  return true;
+  ino_desc = data_.get(inode);
+  return ino_desc != nullptr;
 }
 
 bool AuditdFimInodeMap::takeAndRemove(AuditdFimInodeDescriptor& ino_desc,
                                       ino_t inode) {
-  auto it = data_.find(inode);
-  if (it == data_.end()) {
+  auto cached = data_.get(inode);
+  if (cached == nullptr) {
     return false;
   }
 
-  ino_desc = it->second;
-  data_.erase(it);
+  ino_desc = std::move(*cached);
+  data_.erase(inode);
 
   return true;
 }
@@ -1373,11 +1400,8 @@ void AuditdFimInodeMap::save(ino_t inode,
   ino_desc.type = type;
   ino_desc.path = path;
 
-  data_[inode] = ino_desc;
-
-  if (data_.size() > 20000) {
-    data_.erase(data_.begin());
-  }
+  // The least recently used inodes make room for new ones
+  data_.insert(inode, std::move(ino_desc));
 }
 
 void AuditdFimInodeMap::remove(ino_t inode) {
@@ -1465,66 +1489,65 @@ void AuditdFimFdMap::printUntrackedFdWarning(std::uint64_t fd) {
   }
 }
 
+AuditdFimProcessMap::AuditdFimProcessMap() : data_(kMaxTrackedProcesses) {}
+
 bool AuditdFimProcessMap::getReference(AuditdFimFdDescriptor*& fd_desc,
                                        pid_t process_id,
                                        std::uint64_t fd) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
+  auto fd_map = data_.get(process_id);
+  if (fd_map == nullptr) {
     printUntrackedPidWarning(process_id);
     return false;
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.getReference(fd_desc, fd);
+  return fd_map->getReference(fd_desc, fd);
 }
 
 void AuditdFimProcessMap::create(pid_t process_id) {
-  auto process_it = data_.find(process_id);
-  if (process_it != data_.end()) {
-    process_it->second.clear();
+  auto fd_map = data_.get(process_id);
+  if (fd_map != nullptr) {
+    fd_map->clear();
   } else {
-    data_.insert({process_id, AuditdFimFdMap(process_id)});
+    data_.insert(process_id, AuditdFimFdMap(process_id));
   }
 }
 
 bool AuditdFimProcessMap::duplicate(pid_t process_id,
                                     std::uint64_t fd,
                                     std::uint64_t new_fd) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
+  auto fd_map = data_.get(process_id);
+  if (fd_map == nullptr) {
     printUntrackedPidWarning(process_id);
     return false;
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.duplicate(fd, new_fd);
+  return fd_map->duplicate(fd, new_fd);
 }
 
 bool AuditdFimProcessMap::clone(pid_t old_pid, pid_t new_pid) {
-  auto process_it = data_.find(old_pid);
-  if (process_it == data_.end()) {
+  auto old_fd_map = data_.get(old_pid);
+  if (old_fd_map == nullptr) {
     printUntrackedPidWarning(old_pid);
     return false;
   }
 
-  AuditdFimFdMap fd_map = process_it->second;
+  AuditdFimFdMap fd_map = *old_fd_map;
   fd_map.setProcessId(new_pid);
 
-  data_.insert({new_pid, fd_map});
+  data_.insert(new_pid, std::move(fd_map));
   return true;
 }
 
 bool AuditdFimProcessMap::takeAndRemove(AuditdFimFdDescriptor& fd_desc,
                                         pid_t process_id,
                                         std::uint64_t fd) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
+  auto fd_map = data_.get(process_id);
+  if (fd_map == nullptr) {
     printUntrackedPidWarning(process_id);
     return false;
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.takeAndRemove(fd_desc, fd);
+  return fd_map->takeAndRemove(fd_desc, fd);
 }
 
 void AuditdFimProcessMap::save(
@@ -1532,19 +1555,14 @@ void AuditdFimProcessMap::save(
     pid_t process_id,
     ino_t inode,
     AuditdFimFdDescriptor::OperationType last_operation) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
-    process_it = data_.insert({process_id, AuditdFimFdMap(process_id)}).first;
-
-    // Try to limit the amount of processes we are tracking. When
-    // removing, start from the oldest ones
-    if (data_.size() > 4096) {
-      data_.erase(data_.begin());
-    }
+  // The amount of processes we are tracking is limited, the least
+  // recently used ones make room for new ones
+  auto fd_map = data_.get(process_id);
+  if (fd_map == nullptr) {
+    fd_map = data_.insert(process_id, AuditdFimFdMap(process_id));
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.save(fd, inode, last_operation);
+  fd_map->save(fd, inode, last_operation);
 }
 
 void AuditdFimProcessMap::clear() {
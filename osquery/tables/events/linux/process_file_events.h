@@ -14,12 +14,14 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/variant.hpp>
 
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/events/linux/auditeventpublisher.h>
+#include <osquery/utils/caches/clock.h>
 
 namespace osquery {
 /// An inode descriptor, containing the file (or folder) path
@@ -38,7 +40,7 @@ struct AuditdFimFdDescriptor final {
   OperationType last_operation;
 };
 
-/// A global inode map
+/// A global inode map, keeping the most recently used inodes
 class AuditdFimInodeMap final {
  public:
   AuditdFimInodeMap();
@@ -62,12 +64,13 @@ class AuditdFimInodeMap final {
 
  private:
   /// The global inode map
-  std::map<ino_t, AuditdFimInodeDescriptor> data_;
+  caches::Clock<ino_t, AuditdFimInodeDescriptor> data_;
 };
 
 /// Contains
 class AuditdFimFdMap final {
  public:
+  AuditdFimFdMap() = default;
   AuditdFimFdMap(pid_t process_id);
 
   /// Sets the new process id that owns this fd map
@@ -97,7 +100,7 @@ class AuditdFimFdMap final {
 
  private:
   /// The process id that owns this fd map
-  pid_t process_id_;
+  pid_t process_id_{0};
 
   /// A time-based filter to avoid spamming the warning log
   std::time_t warning_suppression_timer_{0};
@@ -106,9 +109,12 @@ class AuditdFimFdMap final {
   std::unordered_map<std::uint64_t, AuditdFimFdDescriptor> data_;
 };
 
-/// A utility class to track processes and their fd maps
+/// A utility class to track processes and their fd maps, keeping the most
+/// recently used processes
 class AuditdFimProcessMap final {
  public:
+  AuditdFimProcessMap();
+
   /// Returns a reference to the specified fd object
   bool getReference(AuditdFimFdDescriptor*& fd_desc,
                     pid_t process_id,
@@ -147,7 +153,7 @@ class AuditdFimProcessMap final {
   std::map<pid_t, std::time_t> warning_suppression_filter_;
 
   /// An fd map for each process
-  std::map<pid_t, AuditdFimFdMap> data_;
+  caches::Clock<pid_t, AuditdFimFdMap> data_;
 };
 
 /// A simple vector of strings
@@ -156,7 +162,7 @@ using StringList = std::vector<std::string>;
 /// The fim context contains configuration and process state
 struct AuditdFimContext final {
   /// The paths included in the audit fim events
-  StringList included_path_list;
+  std::unordered_set<std::string> included_paths;
 
   /// The process map, containing an fd map for each process
   AuditdFimProcessMap process_map;
@@ -173,8 +173,9 @@ Status SocketEventSubscriber::ProcessEvents(
     CopyFieldFromMap(row, syscall_event_record->fields, "pid");
     GetStringFieldFromMap(row["fd"], syscall_event_record->fields, "a0");
 
-    row["path"] = DecodeAuditPathValues(syscall_event_record->fields.at("exe"));
-    row["fd"] = syscall_event_record->fields.at("a0");
+    row["path"] = DecodeAuditPathValues(
+        syscall_event_record->fields.at("exe").to_string());
+    row["fd"] = syscall_event_record->fields.at("a0").to_string();
     row["success"] =
         (syscall_event_record->fields.at("success") == "yes") ? "1" : "0";
     row["uptime"] = std::to_string(getUptime());
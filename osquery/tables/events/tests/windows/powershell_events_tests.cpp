@@ -29,9 +29,9 @@ Status initializePowershellEventsContext(
     const std::vector<std::reference_wrapper<const std::string>>&
         xml_event_list) {
   for (const auto& xml_event : xml_event_list) {
-    boost::property_tree::ptree event_object = {};
+    WELEvent event_object;
     auto status =
-        parseWindowsEventLogXML(event_object, stringToWstring(xml_event));
+        parseWindowsEventLog(event_object, stringToWstring(xml_event));
 
     if (!status.ok()) {
       return status;
@@ -47,9 +47,9 @@ Status initializePowershellEventsContext(
 class PowershellEventsTests : public testing::Test {};
 
 TEST_F(PowershellEventsTests, parse_simple_event) {
-  boost::property_tree::ptree event_object = {};
-  auto status = parseWindowsEventLogXML(event_object,
-                                        stringToWstring(kSingleScriptBlock));
+  WELEvent event_object;
+  auto status =
+      parseWindowsEventLog(event_object, stringToWstring(kSingleScriptBlock));
 
   ASSERT_TRUE(status.ok());
 
@@ -79,7 +79,7 @@ TEST_F(PowershellEventsTests, parse_simple_event) {
 
 TEST_F(PowershellEventsTests, process_broken_event) {
   PowershellEventSubscriber::Context context;
-  boost::property_tree::ptree event_object = {};
+  WELEvent event_object;
 
   auto status =
       PowershellEventSubscriber::processEventObject(context, event_object);
@@ -88,7 +88,7 @@ TEST_F(PowershellEventsTests, process_broken_event) {
 }
 
 TEST_F(PowershellEventsTests, parse_broken_event) {
-  boost::property_tree::ptree event_object = {};
+  WELEvent event_object;
   boost::optional<PowershellEventSubscriber::Context::ScriptMessage>
       script_message_opt;
 
@@ -140,10 +140,40 @@ TEST_F(WindowsEventsTests, test_recorded_events) {
 
       EXPECT_EQ(windows_event.data,
                 expected_event_data.get<std::string>("data"));
+
+      // The direct parser extracts the same fields without a property_tree
+      WELEvent direct_event;
+      status = parseWindowsEventLog(direct_event, wide_chars_buffer);
+      ASSERT_TRUE(status.ok()) << status.getMessage();
+      EXPECT_EQ(direct_event.datetime, windows_event.datetime);
+      EXPECT_EQ(direct_event.source, windows_event.source);
+      EXPECT_EQ(direct_event.provider_name, windows_event.provider_name);
+      EXPECT_EQ(direct_event.provider_guid, windows_event.provider_guid);
+      EXPECT_EQ(direct_event.event_id, windows_event.event_id);
+      EXPECT_EQ(direct_event.task_id, windows_event.task_id);
+      EXPECT_EQ(direct_event.level, windows_event.level);
+      EXPECT_EQ(direct_event.pid, windows_event.pid);
+      EXPECT_EQ(direct_event.tid, windows_event.tid);
+      EXPECT_EQ(direct_event.keywords, windows_event.keywords);
+      EXPECT_EQ(direct_event.data, windows_event.data);
+      EXPECT_EQ(direct_event.event_data, windows_event.event_data);
     }
   }
 }
 
+TEST_F(WindowsEventsTests, test_direct_parser_fallback) {
+  // Data names with dots are paths to property_tree, the direct parser defers
+  const std::string xml_event =
+      "<Event><System><Provider Name=\"p\"/><EventID>1</EventID><Task>2</Task>"
+      "<Level>3</Level><TimeCreated SystemTime=\"t\"/><Channel>c</Channel>"
+      "</System><EventData><Data Name=\"a.b\">1</Data></EventData></Event>";
+
+  WELEvent windows_event;
+  auto status = parseWindowsEventLog(windows_event, stringToWstring(xml_event));
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(windows_event.data, "{\"EventData\":{\"a\":{\"b\":\"1\"}}}");
+}
+
 TEST_F(WindowsEventsTests, invalid_event_parsing) {
   boost::property_tree::ptree event_object = {};
   WELEvent windows_event;
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/flags.h>
+#include <osquery/core/tables.h>
+#include <osquery/events/windows/etw_kernel_publisher.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/utils/conversions/windows/strings.h>
+
+namespace osquery {
+
+FLAG(bool,
+     etw_image_load_events,
+     false,
+     "Also record image (DLL and driver) loads in etw_process_events");
+
+/**
+ * @brief Track process starts and stops using the ETW kernel publisher.
+ *
+ * Image loads are many times more frequent than process starts, they are
+ * only recorded if --etw_image_load_events is set.
+ */
+class EtwProcessEventSubscriber
+    : public EventSubscriber<EtwKernelEventPublisher> {
+ public:
+  Status init() override;
+
+  Status Callback(const ECRef& ec, const SCRef& sc);
+};
+
+REGISTER(EtwProcessEventSubscriber, "event_subscriber", "etw_process_events");
+
+Status EtwProcessEventSubscriber::init() {
+  auto sc = createSubscriptionContext();
+  sc->actions = ETW_PROCESS_START | ETW_PROCESS_STOP;
+  if (FLAGS_etw_image_load_events) {
+    sc->actions |= ETW_IMAGE_LOAD;
+  }
+
+  subscribe(&EtwProcessEventSubscriber::Callback, sc);
+  return Status::success();
+}
+
+Status EtwProcessEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
+  const auto& event = ec->event;
+
+  Row r;
+  r["pid"] = BIGINT(event.pid);
+  r["path"] = wstringToString(event.path);
+  switch (event.action) {
+  case ETW_PROCESS_START:
+    r["action"] = "start";
+    r["parent"] = BIGINT(event.parent);
+    r["session_id"] = INTEGER(event.session_id);
+    break;
+  case ETW_PROCESS_STOP:
+    r["action"] = "stop";
+    r["exit_code"] = BIGINT(event.exit_code);
+    break;
+  case ETW_IMAGE_LOAD:
+    r["action"] = "load";
+    r["image_base"] = BIGINT(event.image_base);
+    r["image_size"] = BIGINT(event.image_size);
+    break;
+  default:
+    return Status::success();
+  }
+
+  add(r);
+  return Status::success();
+}
+} // namespace osquery
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <osquery/core/tables.h>
+#include <osquery/events/windows/etw_kernel_publisher.h>
+#include <osquery/registry/registry_factory.h>
+
+namespace osquery {
+
+namespace {
+
+std::string getAddressString(int family,
+                             const std::array<std::uint8_t, 16>& address) {
+  char buffer[INET6_ADDRSTRLEN] = {};
+  if (InetNtopA(family,
+                const_cast<std::uint8_t*>(address.data()),
+                buffer,
+                sizeof(buffer)) == nullptr) {
+    return "";
+  }
+  return buffer;
+}
+
+} // namespace
+
+/**
+ * @brief Track TCP connections using the ETW kernel publisher.
+ *
+ * The kernel reports the endpoints once a connection is established, failed
+ * connection attempts are not recorded.
+ */
+class EtwSocketEventSubscriber
+    : public EventSubscriber<EtwKernelEventPublisher> {
+ public:
+  Status init() override;
+
+  Status Callback(const ECRef& ec, const SCRef& sc);
+};
+
+REGISTER(EtwSocketEventSubscriber, "event_subscriber", "etw_socket_events");
+
+Status EtwSocketEventSubscriber::init() {
+  auto sc = createSubscriptionContext();
+  sc->actions = ETW_SOCKET_CONNECT | ETW_SOCKET_ACCEPT;
+
+  subscribe(&EtwSocketEventSubscriber::Callback, sc);
+  return Status::success();
+}
+
+Status EtwSocketEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
+  const auto& event = ec->event;
+
+  Row r;
+  r["action"] = event.action == ETW_SOCKET_CONNECT ? "connect" : "accept";
+  r["pid"] = BIGINT(event.pid);
+  r["family"] = INTEGER(event.family);
+  r["protocol"] = INTEGER(IPPROTO_TCP);
+  r["local_address"] = getAddressString(event.family, event.local_address);
+  r["local_port"] = INTEGER(event.local_port);
+  r["remote_address"] = getAddressString(event.family, event.remote_address);
+  r["remote_port"] = INTEGER(event.remote_port);
+
+  add(r);
+  return Status::success();
+}
+} // namespace osquery
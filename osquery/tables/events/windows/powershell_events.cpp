@@ -125,52 +125,36 @@ Status PowershellEventSubscriber::generateRow(
 
 Status PowershellEventSubscriber::parseScriptMessageEvent(
     boost::optional<Context::ScriptMessage>& script_message_opt,
-    const boost::property_tree::ptree& event) {
+    const WELEvent& event) {
   script_message_opt = {};
 
   // Get the event timestamp from the Event.System object
   Context::ScriptMessage output;
   output.osquery_time = std::time(nullptr);
 
-  auto time_created_obj_opt =
-      event.get_child_optional("Event.System.TimeCreated");
-
-  if (!time_created_obj_opt) {
-    return Status::failure(
-        "The Event.System.TimeCreated path was not accessible in the XML event "
-        "object");
-  }
-
-  const auto& time_created_obj = time_created_obj_opt.value();
-
-  output.event_time = time_created_obj.get("<xmlattr>.SystemTime", "");
+  output.event_time = event.datetime;
   if (output.event_time.empty()) {
     return Status::failure(
         "The SystemTime attribute in the TimeCreated object is missing");
   }
 
   // Parse the rest of the object
-  auto event_data_obj_opt = event.get_child_optional("Event.EventData");
-  if (!event_data_obj_opt) {
+  if (!event.has_event_data) {
     return Status::failure(
         "The Event.EventData path was not accessible in the XML event object");
   }
 
-  const auto& event_data_obj = event_data_obj_opt.value();
-
   std::size_t field_count{0U};
   bool malformed_field{false};
 
-  for (const auto& p : event_data_obj) {
-    const auto& node = p.second;
-
-    auto field_name = node.get("<xmlattr>.Name", "");
+  for (const auto& field : event.event_data) {
+    const auto& field_name = field.first;
     if (field_name.empty()) {
       malformed_field = true;
       break;
     }
 
-    auto field_string_value = node.data();
+    const auto& field_string_value = field.second;
 
     if (field_name == "MessageNumber") {
       auto field_integer_value_exp = tryTo<std::size_t>(field_string_value);
@@ -231,7 +215,7 @@ Status PowershellEventSubscriber::parseScriptMessageEvent(
 }
 
 Status PowershellEventSubscriber::processEventObject(
-    Context& context, const boost::property_tree::ptree& event) {
+    Context& context, const WELEvent& event) {
   // Parse the current event and initialize a new script message object
   boost::optional<Context::ScriptMessage> script_message_opt;
 
@@ -60,10 +60,9 @@ class PowershellEventSubscriber
 
   static Status parseScriptMessageEvent(
       boost::optional<Context::ScriptMessage>& script_message_opt,
-      const boost::property_tree::ptree& event);
+      const WELEvent& event);
 
-  static Status processEventObject(Context& context,
-                                   const boost::property_tree::ptree& event);
+  static Status processEventObject(Context& context, const WELEvent& event);
 
   static Status processEventExpiration(Context& context);
 
@@ -66,30 +66,14 @@ Status WindowsEventSubscriber::init() {
 WindowsEventSubscriber::~WindowsEventSubscriber() {}
 
 Status WindowsEventSubscriber::Callback(const ECRef& event, const SCRef&) {
-  std::vector<WELEvent> windows_event_list;
-  bool display_parsing_error{false};
-
-  for (const auto& event_object : event->event_objects) {
-    WELEvent windows_event = {};
-    auto status = parseWindowsEventLogPTree(windows_event, event_object);
-    if (!status.ok()) {
-      display_parsing_error = true;
-      LOG(ERROR) << status.getMessage();
-      continue;
-    }
-
-    windows_event_list.push_back(std::move(windows_event));
-  }
-
-  if (display_parsing_error) {
-    LOG(ERROR) << "Failed to process a Windows event log object";
-  }
-
+  // The parser service already extracted the fields of each event.
+  const auto& windows_event_list = event->event_objects;
   if (windows_event_list.empty()) {
     return Status::success();
   }
 
   std::vector<Row> row_list;
+  row_list.reserve(windows_event_list.size());
 
   for (const auto& windows_event : windows_event_list) {
     Row row = {};
@@ -15,10 +15,14 @@
 // clang-format on
 
 #include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
 
 #include <boost/numeric/conversion/cast.hpp>
 
 #include <osquery/logger/logger.h>
+#include <osquery/remote/uri.h>
 #include <osquery/utils/status/status.h>
 #include <osquery/core/tables.h>
 
@@ -27,9 +31,8 @@ namespace tables {
 
 const std::string kOsqueryUserAgent{"osquery"};
 
-Status processRequest(Row& r) {
+Status processRequest(osquery::http::Client& client, Row& r) {
   try {
-    osquery::http::Client client(TLSTransport().getOptions());
     osquery::http::Response response;
     osquery::http::Request request(r["url"]);
 
@@ -55,6 +58,48 @@ Status processRequest(Row& r) {
   return Status::success();
 }
 
+/// The scheme, host and port of a URL, requests to it may share a connection.
+static std::string getRequestAuthority(const std::string& url) {
+  try {
+    Uri uri(url);
+    return uri.scheme() + "://" + uri.host() + ":" + std::to_string(uri.port());
+  } catch (const std::exception&) {
+    return url;
+  }
+}
+
+/**
+ * @brief Make the requests to one host on a single keep-alive connection.
+ *
+ * A request that fails on a reused connection, which the server may have
+ * closed, is retried on a new one.
+ */
+static void processHostRequests(QueryData& rows,
+                                const std::vector<size_t>& indexes) {
+  auto options = TLSTransport().getOptions();
+  options.keep_alive(true);
+
+  auto client = std::make_unique<osquery::http::Client>(options);
+  bool reused = false;
+  for (auto index : indexes) {
+    auto& r = rows[index];
+    auto status = processRequest(*client, r);
+    if (!status.ok() && reused) {
+      client = std::make_unique<osquery::http::Client>(options);
+      status = processRequest(*client, r);
+    }
+
+    if (!status.ok()) {
+      LOG(WARNING) << "Error making request: " << status.getMessage();
+      // Do not reuse a connection left in an unknown state
+      client = std::make_unique<osquery::http::Client>(options);
+      reused = false;
+      continue;
+    }
+    reused = true;
+  }
+}
+
 QueryData genCurl(QueryContext& context) {
   QueryData results;
 
@@ -71,6 +116,9 @@ QueryData genCurl(QueryContext& context) {
     LOG(WARNING) << "Using LIKE clause for url is not supported";
   }
 
+  // Requests to the same host share a connection, hosts are requested
+  // concurrently on the table I/O workers.
+  std::map<std::string, std::vector<size_t>> hosts;
   for (const auto& request : requests) {
     Row r;
     r["url"] = request;
@@ -78,14 +126,18 @@ QueryData genCurl(QueryContext& context) {
     r["user_agent"] =
         user_agents.empty() ? kOsqueryUserAgent : *(user_agents.begin());
 
-    auto status = processRequest(r);
-    if (!status.ok()) {
-      LOG(WARNING) << "Error making request: " << status.getMessage();
-    }
-
+    hosts[getRequestAuthority(request)].push_back(results.size());
     results.push_back(r);
   }
 
+  std::vector<const std::vector<size_t>*> host_requests;
+  for (const auto& host : hosts) {
+    host_requests.push_back(&host.second);
+  }
+  runTableIOTasks(host_requests.size(), [&](size_t i) {
+    processHostRequests(results, *host_requests[i]);
+  });
+
   return results;
 }
 } // namespace tables
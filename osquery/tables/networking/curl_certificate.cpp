@@ -37,6 +37,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <string>
+#include <vector>
 
 namespace osquery {
 namespace tables {
@@ -414,6 +415,13 @@ Status getTLSCertificate(const std::string& hostname,
   if (sock < 0) {
     return Status::failure("Unable to create socket");
   }
+  auto const sock_guard = scope_guard::create([sock]() {
+#ifdef WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+  });
 
   if (timeout > 0) {
 #ifdef WIN32
@@ -423,8 +431,11 @@ Status getTLSCertificate(const std::string& hostname,
     tv.tv_sec = timeout;
     tv.tv_usec = 0;
 #endif
+    // The send timeout also bounds connect on Linux
     if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv) <
-        0) {
+            0 ||
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv) <
+            0) {
       return Status::failure("Unable to set socket options");
     }
   }
@@ -433,13 +444,6 @@ Status getTLSCertificate(const std::string& hostname,
       0) {
     return Status::failure("Failed to establish TCP connection");
   }
-  auto const sock_guard = scope_guard::create([sock]() {
-#ifdef WIN32
-    closesocket(sock);
-#else
-    close(sock);
-#endif
-  });
 
   auto ssl = SSL_new(ctx.get());
   if (ssl == nullptr) {
@@ -493,7 +497,7 @@ QueryData genTLSCertificate(QueryContext& context) {
   }
 
   if (context.hasConstraint("timeout", EQUALS)) {
-    auto timeout =
+    timeout =
         tryTo<int>(*(context.constraints["timeout"].getAll(EQUALS).begin()), 10)
             .takeOr(DEFAULT_READ_TIMEOUT);
     if (timeout < 0) {
@@ -502,12 +506,22 @@ QueryData genTLSCertificate(QueryContext& context) {
     }
   }
 
-  for (const auto& hostname : hostnames) {
-    auto s = getTLSCertificate(hostname, results, dump_certificate, timeout);
+  // Each host is a blocking handshake, run them concurrently.
+  std::vector<std::string> hosts(hostnames.begin(), hostnames.end());
+  std::vector<QueryData> host_results(hosts.size());
+  runTableIOTasks(hosts.size(), [&](size_t i) {
+    auto s = getTLSCertificate(
+        hosts[i], host_results[i], dump_certificate, timeout);
     if (!s.ok()) {
-      LOG(INFO) << "Cannot get certificate for " << hostname << ": "
+      LOG(INFO) << "Cannot get certificate for " << hosts[i] << ": "
                 << s.getMessage();
     }
+  });
+
+  for (auto& rows : host_results) {
+    for (auto& r : rows) {
+      results.push_back(std::move(r));
+    }
   }
 
   return results;
@@ -8,6 +8,12 @@
  */
 
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <linux/neighbour.h>
+#include <linux/rtnetlink.h>
 
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -15,13 +21,65 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/networking/linux/rtnetlink.h>
 
 namespace osquery {
 namespace tables {
 
 const std::string kLinuxArpTable = "/proc/net/arp";
 
-QueryData genArpCache(QueryContext& context) {
+/// Format a hardware address like /proc/net/arp does.
+static std::string getHardwareAddress(const unsigned char* address,
+                                      size_t length) {
+  std::stringstream mac;
+  for (size_t i = 0; i < length; i++) {
+    if (i > 0) {
+      mac << ":";
+    }
+    mac << std::hex << std::setfill('0') << std::setw(2)
+        << static_cast<int>(address[i]);
+  }
+  return mac.str();
+}
+
+static void genNeighborArpEntry(const nlmsghdr* message,
+                                const RtnetlinkSnapshot& snapshot,
+                                QueryData& results) {
+  // Like /proc/net/arp, skip the IPv6 and the NOARP neighbors.
+  auto neighbor = static_cast<const ndmsg*>(NLMSG_DATA(message));
+  if (neighbor->ndm_family != AF_INET ||
+      (neighbor->ndm_state & NUD_NOARP) != 0) {
+    return;
+  }
+
+  Row r;
+  r["mac"] = "00:00:00:00:00:00";
+
+  auto attr = reinterpret_cast<const rtattr*>(
+      reinterpret_cast<const char*>(neighbor) + NLMSG_ALIGN(sizeof(*neighbor)));
+  auto attr_size = static_cast<int>(NLMSG_PAYLOAD(message, sizeof(*neighbor)));
+  for (; RTA_OK(attr, attr_size); attr = RTA_NEXT(attr, attr_size)) {
+    if (attr->rta_type == NDA_DST && RTA_PAYLOAD(attr) == sizeof(in_addr)) {
+      char address[INET_ADDRSTRLEN] = {0};
+      inet_ntop(AF_INET, RTA_DATA(attr), address, sizeof(address));
+      r["address"] = address;
+    } else if (attr->rta_type == NDA_LLADDR) {
+      // Only neighbors with a valid state report their address.
+      r["mac"] = getHardwareAddress(
+          static_cast<const unsigned char*>(RTA_DATA(attr)), RTA_PAYLOAD(attr));
+    }
+  }
+
+  if (r.count("address") == 0) {
+    return;
+  }
+
+  r["interface"] = snapshot.getInterfaceName(neighbor->ndm_ifindex);
+  r["permanent"] = (neighbor->ndm_state & NUD_PERMANENT) != 0 ? "1" : "0";
+  results.push_back(std::move(r));
+}
+
+static QueryData genArpCacheFromProc() {
   QueryData results;
 
   boost::filesystem::path arp_path = kLinuxArpTable;
@@ -74,5 +132,18 @@ QueryData genArpCache(QueryContext& context) {
 
   return results;
 }
+
+QueryData genArpCache(QueryContext& context) {
+  RtnetlinkSnapshotRef snapshot;
+  if (!getRtnetlinkSnapshot(snapshot).ok()) {
+    return genArpCacheFromProc();
+  }
+
+  QueryData results;
+  for (const auto& message : snapshot->neighbors) {
+    genNeighborArpEntry(message.data(), *snapshot, results);
+  }
+  return results;
+}
 }
 }
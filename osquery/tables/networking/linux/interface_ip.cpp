@@ -7,9 +7,12 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <linux/rtnetlink.h>
+
 #include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/networking/linux/rtnetlink.h>
 #include <osquery/tables/networking/posix/interfaces.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -70,6 +73,18 @@ void genIpv6FromIntf(const std::string& iface, QueryData& results) {
 
 QueryData genInterfaceIpv6(QueryContext& context) {
   QueryData results;
+
+  // Only the interface names are needed, the shared snapshot has them.
+  RtnetlinkSnapshotRef snapshot;
+  if (getRtnetlinkSnapshot(snapshot).ok()) {
+    for (const auto& message : snapshot->links) {
+      auto link =
+          static_cast<const struct ifinfomsg*>(NLMSG_DATA(message.data()));
+      genIpv6FromIntf(snapshot->getInterfaceName(link->ifi_index), results);
+    }
+    return results;
+  }
+
   for (const auto& iface : genInterfaceDetails(context)) {
     genIpv6FromIntf(iface.at("interface"), results);
   }
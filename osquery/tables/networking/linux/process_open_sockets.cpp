@@ -11,13 +11,68 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
+#include <osquery/filesystem/linux/proc_snapshot.h>
+#include <osquery/rows/process_open_sockets.h>
+#include <osquery/tables/networking/linux/process_open_sockets.h>
+#include <osquery/tables/networking/linux/sock_diag.h>
+#include <osquery/utils/conversions/tryto.h>
+
+#include <netinet/tcp.h>
 
 namespace osquery {
 namespace tables {
 
-QueryData genOpenSockets(QueryContext& context) {
+namespace {
+
+/// The protocols the kernel reports through sock_diag.
+const std::vector<int> kSockDiagProtocols = {
+    IPPROTO_TCP, IPPROTO_UDP, IPPROTO_UDPLITE};
+
+/// Listening TCP sockets, and UDP sockets that are not connected.
+std::uint32_t getListeningStates(int protocol) {
+  return (protocol == IPPROTO_TCP) ? (1U << TCP_LISTEN) : (1U << TCP_CLOSE);
+}
+
+void genNamespaceSockets(int family,
+                         const std::string& pid,
+                         ino_t ns,
+                         SockDiag* sock_diag,
+                         bool listening,
+                         SocketInfoList& socket_list) {
+  const auto family_name = (family == AF_INET) ? "AF_INET " : "AF_INET6 ";
+  for (const auto& pair : kLinuxProtocolNames) {
+    auto use_sock_diag =
+        sock_diag != nullptr &&
+        std::find(kSockDiagProtocols.begin(),
+                  kSockDiagProtocols.end(),
+                  pair.first) != kSockDiagProtocols.end();
+
+    if (use_sock_diag) {
+      auto states =
+          listening ? getListeningStates(pair.first) : kSockDiagAllStates;
+      auto status = sock_diag->getSocketList(
+          family, pair.first, ns, states, socket_list);
+      if (status.ok()) {
+        continue;
+      }
+
+      // The protocol's diag module may not be available, use /proc instead.
+      VLOG(1) << "Failed to acquire socket information for " << family_name
+              << pair.second << " from sock_diag: " << status.what();
+    }
+
+    auto status = procGetSocketList(family, pair.first, ns, pid, socket_list);
+    if (!status.ok()) {
+      VLOG(1) << "Results for process_open_sockets might be incomplete. Failed "
+                 "to acquire basic socket information for "
+              << family_name << pair.second << ": " << status.what();
+    }
+  }
+}
+
+TableRows genSockets(QueryContext& context, bool listening) {
   Status status;
-  QueryData results;
+  TableRows results;
 
   /*
    * If filtering by pid, restrict results to the list of pids provided
@@ -32,13 +87,9 @@ QueryData genOpenSockets(QueryContext& context) {
   bool pid_filter = !(pids.empty() ||
                       std::find(pids.begin(), pids.end(), "-1") != pids.end());
 
+  auto snapshot = getProcSnapshot(context);
   if (!pid_filter) {
-    pids.clear();
-    status = osquery::procProcesses(pids);
-    if (!status.ok()) {
-      VLOG(1) << "Failed to acquire pid list: " << status.what();
-      return results;
-    }
+    pids = snapshot->processes();
   }
 
   /* Data for this table is fetched from 3 different sources and correlated.
@@ -57,21 +108,41 @@ QueryData genOpenSockets(QueryContext& context) {
    *
    * 3. Collect basic socket information for all sockets under a specifc network
    * namespace. This is done by reading through files under /proc/<pid>/net for
-   * the first pid we find in a certain namespace. Notice this will collect
-   * information for all sockets on the namespace not only for sockets
+   * the first pid we find in a certain namespace, or by asking the kernel
+   * through a NETLINK_SOCK_DIAG socket in that namespace. Notice this will
+   * collect information for all sockets on the namespace not only for sockets
    * associated with the specific pid, therefore only needs to be run once. From
    * this step we collect the inodes of each of the sockets, and will use that
    * to correlate the socket information with the information collect on steps
-   * 1 and 2.
+   * 1 and 2. When only listening sockets are wanted the kernel filters TCP and
+   * UDP sockets by state.
    */
 
+  ino_t own_ns = 0;
+  {
+    ProcessNamespaceList namespaces;
+    procGetProcessNamespaces("self", namespaces, {"net"});
+    if (namespaces.count("net") > 0) {
+      own_ns = namespaces["net"];
+    }
+  }
+
   /* Use a set to record the namespaces already processed */
   std::set<ino_t> netns_list;
   SocketInodeToProcessInfoMap inode_proc_map;
   SocketInfoList socket_list;
   for (const auto& pid : pids) {
     /* Step 1 */
-    status = procGetSocketInodeToProcessInfoMap(pid, inode_proc_map);
+    std::map<std::string, std::string> descriptors;
+    status = snapshot->descriptors(pid, descriptors);
+    for (const auto& descriptor : descriptors) {
+      const auto& link = descriptor.second;
+      if (link.find("socket:[") == 0) {
+        inode_proc_map[link.substr(8, link.size() - 9)] = {pid,
+                                                           descriptor.first};
+      }
+    }
+
     if (!status.ok()) {
       VLOG(1) << "Results for process_open_sockets might be incomplete. Failed "
                  "to acquire socket inode to process map for pid "
@@ -81,7 +152,7 @@ QueryData genOpenSockets(QueryContext& context) {
     /* Step 2 */
     ino_t ns;
     ProcessNamespaceList namespaces;
-    status = procGetProcessNamespaces(pid, namespaces, {"net"});
+    status = snapshot->namespaces(pid, namespaces, {"net"});
     if (status.ok()) {
       ns = namespaces["net"];
     } else {
@@ -99,24 +170,28 @@ QueryData genOpenSockets(QueryContext& context) {
       netns_list.insert(ns);
 
       /* Step 3 */
-      for (const auto& pair : kLinuxProtocolNames) {
-        status = procGetSocketList(AF_INET, pair.first, ns, pid, socket_list);
-        if (!status.ok()) {
-          VLOG(1)
-              << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire basic socket information for AF_INET "
-              << pair.second << ": " << status.what();
-        }
-
-        status = procGetSocketList(AF_INET6, pair.first, ns, pid, socket_list);
-        if (!status.ok()) {
-          VLOG(1)
-              << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire basic socket information for AF_INET6 "
-              << pair.second << ": " << status.what();
-        }
+      SockDiag sock_diag;
+      status = sock_diag.open(pid, ns == 0 || ns == own_ns);
+      if (!status.ok()) {
+        VLOG(1) << "Reading socket information from /proc: " << status.what();
       }
-      status = procGetSocketList(AF_UNIX, IPPROTO_IP, ns, pid, socket_list);
+
+      auto sock_diag_ptr = status.ok() ? &sock_diag : nullptr;
+      genNamespaceSockets(
+          AF_INET, pid, ns, sock_diag_ptr, listening, socket_list);
+      genNamespaceSockets(
+          AF_INET6, pid, ns, sock_diag_ptr, listening, socket_list);
+
+      status = Status::failure("sock_diag is not available");
+      if (sock_diag_ptr != nullptr) {
+        status = sock_diag.getSocketList(
+            AF_UNIX, IPPROTO_IP, ns, kSockDiagAllStates, socket_list);
+      }
+
+      if (!status.ok()) {
+        status = procGetSocketList(AF_UNIX, IPPROTO_IP, ns, pid, socket_list);
+      }
+
       if (!status.ok()) {
         VLOG(1)
             << "Results for process_open_sockets might be incomplete. Failed "
@@ -132,35 +207,46 @@ QueryData genOpenSockets(QueryContext& context) {
    * the inode to process information map.
    */
   for (const auto& info : socket_list) {
-    Row r;
+    auto r = std::make_unique<ProcessOpenSocketsRow>();
     auto proc_it = inode_proc_map.find(info.socket);
     if (proc_it != inode_proc_map.end()) {
-      r["pid"] = proc_it->second.pid;
-      r["fd"] = proc_it->second.fd;
+      r->pid_col = tryTo<int>(proc_it->second.pid).takeOr(-1);
+      r->fd_col = tryTo<long long>(proc_it->second.fd).takeOr(-1LL);
     } else if (!pid_filter) {
-      r["pid"] = "-1";
-      r["fd"] = "-1";
+      r->pid_col = -1;
+      r->fd_col = -1;
     } else {
       /* If we're filtering by pid we only care about sockets associated with
        * pids on the list.*/
       continue;
     }
 
-    r["socket"] = info.socket;
-    r["family"] = std::to_string(info.family);
-    r["protocol"] = std::to_string(info.protocol);
-    r["local_address"] = info.local_address;
-    r["local_port"] = std::to_string(info.local_port);
-    r["remote_address"] = info.remote_address;
-    r["remote_port"] = std::to_string(info.remote_port);
-    r["path"] = info.unix_socket_path;
-    r["state"] = info.state;
-    r["net_namespace"] = std::to_string(info.net_ns);
+    r->socket_col = tryTo<long long>(info.socket).takeOr(0LL);
+    r->family_col = info.family;
+    r->protocol_col = info.protocol;
+    r->local_address_col = info.local_address;
+    r->local_port_col = info.local_port;
+    r->remote_address_col = info.remote_address;
+    r->remote_port_col = info.remote_port;
+    r->path_col = info.unix_socket_path;
+    r->state_col = info.state;
+    r->net_namespace_col = std::to_string(info.net_ns);
 
     results.push_back(std::move(r));
   }
 
   return results;
 }
+
+} // namespace
+
+TableRows genOpenSockets(QueryContext& context) {
+  return genSockets(context, false);
+}
+
+TableRows genListeningSockets(QueryContext& context) {
+  return genSockets(context, true);
+}
+
 } // namespace tables
 } // namespace osquery
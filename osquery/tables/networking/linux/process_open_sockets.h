@@ -0,0 +1,27 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/core/tables.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Generate process_open_sockets rows for listening sockets only.
+ *
+ * TCP sockets are limited to LISTEN and UDP sockets to unconnected ones by the
+ * kernel, where sock_diag is available. UNIX, ICMP and raw sockets are
+ * reported as in process_open_sockets.
+ */
+TableRows genListeningSockets(QueryContext& context);
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,293 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <osquery/tables/networking/linux/rtnetlink.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+namespace {
+
+/// Receive buffer for dump replies, the kernel fills it with many messages.
+const size_t kRtnetlinkBufferSize{32768};
+
+/// A dump interrupted by a concurrent change is started again this often.
+const size_t kRtnetlinkDumpAttempts{3};
+
+/// Notifications read per snapshot, a busy host will be dumped again anyway.
+const size_t kRtnetlinkMaxNotificationReads{64};
+
+/// Notifications of changes to the objects in a snapshot.
+const unsigned int kRtnetlinkGroups =
+    RTMGRP_LINK | RTMGRP_NEIGH | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE |
+    RTMGRP_IPV6_IFADDR | RTMGRP_IPV6_ROUTE;
+
+int openRtnetlinkSocket(int flags) {
+  return ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | flags, NETLINK_ROUTE);
+}
+
+/// The size of the family header following the netlink header of a request.
+size_t getRequestSize(int type) {
+  switch (type) {
+  case RTM_GETLINK:
+    return sizeof(ifinfomsg);
+  case RTM_GETADDR:
+    return sizeof(ifaddrmsg);
+  case RTM_GETROUTE:
+    return sizeof(rtmsg);
+  default:
+    return sizeof(ndmsg);
+  }
+}
+
+Status dumpOnce(int fd,
+                int type,
+                std::vector<RtnetlinkMessage>& messages,
+                bool& interrupted) {
+  // Every family header starts with the address family, AF_UNSPEC is all.
+  struct {
+    nlmsghdr header;
+    union {
+      ifinfomsg link;
+      ifaddrmsg address;
+      rtmsg route;
+      ndmsg neighbor;
+    } body;
+  } request = {};
+
+  request.header.nlmsg_len = NLMSG_LENGTH(getRequestSize(type));
+  request.header.nlmsg_type = type;
+  request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+
+  if (::send(fd, &request, request.header.nlmsg_len, 0) < 0) {
+    return Status::failure("Could not send an rtnetlink request: " +
+                           std::string(std::strerror(errno)));
+  }
+
+  // Keep the buffer aligned for the message headers.
+  std::vector<nlmsghdr> buffer(kRtnetlinkBufferSize / sizeof(nlmsghdr));
+  while (true) {
+    auto received = ::recv(fd, buffer.data(), kRtnetlinkBufferSize, 0);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::failure("Could not receive an rtnetlink reply: " +
+                             std::string(std::strerror(errno)));
+    }
+
+    auto length = static_cast<int>(received);
+    for (auto header = buffer.data(); NLMSG_OK(header, length);
+         header = NLMSG_NEXT(header, length)) {
+      if ((header->nlmsg_flags & NLM_F_DUMP_INTR) != 0) {
+        interrupted = true;
+      }
+
+      if (header->nlmsg_type == NLMSG_DONE) {
+        return Status::success();
+      }
+
+      if (header->nlmsg_type == NLMSG_ERROR) {
+        auto error = static_cast<const nlmsgerr*>(NLMSG_DATA(header));
+        return Status::failure("The rtnetlink request failed: " +
+                               std::string(std::strerror(-error->error)));
+      }
+
+      // Replies are RTM_NEW* messages, RTM_GET* less two.
+      if (header->nlmsg_type == type - 2) {
+        RtnetlinkMessage message(
+            (header->nlmsg_len + sizeof(nlmsghdr) - 1) / sizeof(nlmsghdr));
+        std::memcpy(message.data(), header, header->nlmsg_len);
+        messages.push_back(std::move(message));
+      }
+    }
+
+    if (received == 0) {
+      return Status::failure("The rtnetlink reply was truncated");
+    }
+  }
+}
+
+Status dump(int fd, int type, std::vector<RtnetlinkMessage>& messages) {
+  for (size_t attempt = 0; attempt < kRtnetlinkDumpAttempts; attempt++) {
+    messages.clear();
+
+    bool interrupted = false;
+    auto status = dumpOnce(fd, type, messages, interrupted);
+    if (!status.ok() || !interrupted) {
+      return status;
+    }
+  }
+  return Status::failure("The rtnetlink dump was interrupted by changes");
+}
+
+void addInterfaceNames(RtnetlinkSnapshot& snapshot) {
+  for (const auto& message : snapshot.links) {
+    auto header = message.data();
+    auto link = static_cast<const ifinfomsg*>(NLMSG_DATA(header));
+    auto attr = IFLA_RTA(link);
+    auto attr_size = static_cast<int>(IFLA_PAYLOAD(header));
+    for (; RTA_OK(attr, attr_size); attr = RTA_NEXT(attr, attr_size)) {
+      if (attr->rta_type == IFLA_IFNAME) {
+        snapshot.names[link->ifi_index] =
+            std::string(static_cast<const char*>(RTA_DATA(attr)),
+                        ::strnlen(static_cast<const char*>(RTA_DATA(attr)),
+                                  RTA_PAYLOAD(attr)));
+        break;
+      }
+    }
+  }
+}
+
+class RtnetlinkCache final {
+ public:
+  static RtnetlinkCache& get() {
+    static RtnetlinkCache cache;
+    return cache;
+  }
+
+  ~RtnetlinkCache() {
+    if (monitor_ != -1) {
+      ::close(monitor_);
+    }
+  }
+
+  RtnetlinkCache(const RtnetlinkCache&) = delete;
+  RtnetlinkCache& operator=(const RtnetlinkCache&) = delete;
+
+  Status getSnapshot(RtnetlinkSnapshotRef& snapshot) {
+    WriteLock lock(mutex_);
+
+    // Notifications are read before dumping, a change during the dumps
+    // leaves one to be read by the next query.
+    if (!changed() && snapshot_ != nullptr) {
+      snapshot = snapshot_;
+      return Status::success();
+    }
+    snapshot_.reset();
+
+    int fd = openRtnetlinkSocket(0);
+    if (fd == -1) {
+      return Status::failure("Could not open an rtnetlink socket: " +
+                             std::string(std::strerror(errno)));
+    }
+
+    auto fresh = std::make_shared<RtnetlinkSnapshot>();
+    auto status = dump(fd, RTM_GETLINK, fresh->links);
+    if (status.ok()) {
+      status = dump(fd, RTM_GETADDR, fresh->addresses);
+    }
+    if (status.ok()) {
+      status = dump(fd, RTM_GETROUTE, fresh->routes);
+    }
+    if (status.ok()) {
+      status = dump(fd, RTM_GETNEIGH, fresh->neighbors);
+    }
+    ::close(fd);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    addInterfaceNames(*fresh);
+    snapshot_ = std::move(fresh);
+    snapshot = snapshot_;
+    return Status::success();
+  }
+
+ private:
+  RtnetlinkCache() = default;
+
+  /// Read the pending notifications, true if the snapshot may be stale.
+  bool changed() {
+    if (monitor_ == -1) {
+      monitor_ = openRtnetlinkSocket(SOCK_NONBLOCK);
+      if (monitor_ == -1) {
+        return true;
+      }
+
+      sockaddr_nl local = {};
+      local.nl_family = AF_NETLINK;
+      local.nl_groups = kRtnetlinkGroups;
+      if (::bind(monitor_,
+                 reinterpret_cast<sockaddr*>(&local),
+                 sizeof(local)) != 0) {
+        ::close(monitor_);
+        monitor_ = -1;
+      }
+
+      // Nothing is known about changes made before the socket was bound.
+      return true;
+    }
+
+    bool changed = false;
+    std::vector<nlmsghdr> buffer(kRtnetlinkBufferSize / sizeof(nlmsghdr));
+    for (size_t reads = 0; reads < kRtnetlinkMaxNotificationReads; reads++) {
+      auto received = ::recv(monitor_, buffer.data(), kRtnetlinkBufferSize, 0);
+      if (received > 0) {
+        changed = true;
+      } else if (received < 0 && errno == EINTR) {
+        continue;
+      } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return changed;
+      } else if (received < 0 && errno == ENOBUFS) {
+        // Notifications were dropped, the socket is still usable.
+        changed = true;
+      } else {
+        ::close(monitor_);
+        monitor_ = -1;
+        return true;
+      }
+    }
+    return true;
+  }
+
+ private:
+  Mutex mutex_;
+
+  /// A socket receiving change notifications, -1 if it could not be opened.
+  int monitor_{-1};
+
+  RtnetlinkSnapshotRef snapshot_;
+};
+
+} // namespace
+
+std::string RtnetlinkSnapshot::getInterfaceName(int index) const {
+  auto it = names.find(index);
+  return it != names.end() ? it->second : "";
+}
+
+Status getRtnetlinkSnapshot(RtnetlinkSnapshotRef& snapshot) {
+  return RtnetlinkCache::get().getSnapshot(snapshot);
+}
+
+Status dumpRtnetlink(int type, std::vector<RtnetlinkMessage>& messages) {
+  int fd = openRtnetlinkSocket(0);
+  if (fd == -1) {
+    return Status::failure("Could not open an rtnetlink socket: " +
+                           std::string(std::strerror(errno)));
+  }
+
+  auto status = dump(fd, type, messages);
+  ::close(fd);
+  if (!status.ok()) {
+    messages.clear();
+  }
+  return status;
+}
+
+} // namespace osquery
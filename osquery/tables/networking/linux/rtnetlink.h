@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/netlink.h>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A netlink message, with room for its attributes after the header.
+using RtnetlinkMessage = std::vector<nlmsghdr>;
+
+/**
+ * @brief A copy of the network configuration, from rtnetlink dumps.
+ *
+ * The lists hold the RTM_NEWLINK, RTM_NEWADDR, RTM_NEWROUTE and RTM_NEWNEIGH
+ * messages of each dump, tables parse the attributes they report.
+ */
+struct RtnetlinkSnapshot {
+  std::vector<RtnetlinkMessage> links;
+  std::vector<RtnetlinkMessage> addresses;
+  std::vector<RtnetlinkMessage> routes;
+  std::vector<RtnetlinkMessage> neighbors;
+
+  /// Interface names by index, from the links.
+  std::unordered_map<int, std::string> names;
+
+  /// The name of an interface, empty if it is not known.
+  std::string getInterfaceName(int index) const;
+};
+
+using RtnetlinkSnapshotRef = std::shared_ptr<const RtnetlinkSnapshot>;
+
+/**
+ * @brief Get the network configuration shared by the network tables.
+ *
+ * The interface, route and ARP tables are often joined, and each enumerated
+ * the configuration on its own. The links, addresses, routes and neighbors
+ * are dumped once and shared until an rtnetlink notification reports that
+ * one of them changed.
+ *
+ * Link statistics change without notifications, tables reporting them dump
+ * the links again with dumpRtnetlink.
+ */
+Status getRtnetlinkSnapshot(RtnetlinkSnapshotRef& snapshot);
+
+/**
+ * @brief Dump one kind of object, as the messages of the reply.
+ *
+ * @param type RTM_GETLINK, RTM_GETADDR, RTM_GETROUTE or RTM_GETNEIGH.
+ */
+Status dumpRtnetlink(int type, std::vector<RtnetlinkMessage>& messages);
+
+} // namespace osquery
@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <osquery/tables/networking/linux/inet_diag.h>
+#include <osquery/tables/networking/linux/sock_diag.h>
+
+namespace osquery {
+
+namespace {
+
+/// Receive buffer for dump replies, the kernel fills it with many messages.
+const size_t kSockDiagBufferSize{32768};
+
+int openSockDiagSocket() {
+  return ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+}
+
+std::string getAddressString(int family, const void* address) {
+  char buffer[INET6_ADDRSTRLEN] = {0};
+  inet_ntop(family, address, buffer, sizeof(buffer));
+  return std::string(buffer);
+}
+
+std::string getUnixSocketPath(const unix_diag_msg* msg, size_t length) {
+  auto attr_length = static_cast<int>(length - NLMSG_LENGTH(sizeof(*msg)));
+  auto attr = reinterpret_cast<const rtattr*>(msg + 1);
+  for (; RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length)) {
+    if (attr->rta_type != UNIX_DIAG_NAME) {
+      continue;
+    }
+
+    std::string path(static_cast<const char*>(RTA_DATA(attr)),
+                     RTA_PAYLOAD(attr));
+
+    // Abstract names start with a NUL byte, /proc/net/unix shows every NUL in
+    // them as an '@'. Path names may include their terminator.
+    if (!path.empty() && path[0] == '\0') {
+      std::replace(path.begin(), path.end(), '\0', '@');
+    } else {
+      path.resize(std::strlen(path.c_str()));
+    }
+    return path;
+  }
+
+  return "";
+}
+
+} // namespace
+
+SockDiag::~SockDiag() {
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+Status SockDiag::open(const std::string& pid, bool own_namespace) {
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  if (own_namespace) {
+    fd_ = openSockDiagSocket();
+    if (fd_ == -1) {
+      return Status::failure("Could not open a sock_diag socket: " +
+                             std::string(std::strerror(errno)));
+    }
+    return Status::success();
+  }
+
+  auto path = kLinuxProcPath + "/" + pid + "/ns/net";
+  int ns_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (ns_fd == -1) {
+    return Status::failure("Could not open the network namespace " + path);
+  }
+
+  // A socket stays in the namespace it was created in. Join the namespace
+  // from a thread that exits afterwards, so no other thread is moved.
+  int error = 0;
+  std::thread creator([&]() {
+    if (setns(ns_fd, CLONE_NEWNET) != 0) {
+      error = errno;
+      return;
+    }
+
+    fd_ = openSockDiagSocket();
+    if (fd_ == -1) {
+      error = errno;
+    }
+  });
+  creator.join();
+  ::close(ns_fd);
+
+  if (fd_ == -1) {
+    return Status::failure("Could not open a sock_diag socket in " + path +
+                           ": " + std::string(std::strerror(error)));
+  }
+  return Status::success();
+}
+
+template <typename Request, typename Callback>
+Status SockDiag::dump(const Request& request, Callback callback) {
+  struct {
+    nlmsghdr header;
+    Request request;
+  } message = {};
+
+  message.header.nlmsg_len = sizeof(message);
+  message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  message.request = request;
+
+  sockaddr_nl kernel = {};
+  kernel.nl_family = AF_NETLINK;
+
+  iovec iov = {&message, sizeof(message)};
+  msghdr msg = {};
+  msg.msg_name = &kernel;
+  msg.msg_namelen = sizeof(kernel);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  if (::sendmsg(fd_, &msg, 0) < 0) {
+    return Status::failure("Could not send a sock_diag request: " +
+                           std::string(std::strerror(errno)));
+  }
+
+  // Keep the buffer aligned for the message headers.
+  std::vector<nlmsghdr> buffer(kSockDiagBufferSize / sizeof(nlmsghdr));
+  while (true) {
+    auto received = ::recv(fd_, buffer.data(), kSockDiagBufferSize, 0);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::failure("Could not receive a sock_diag reply: " +
+                             std::string(std::strerror(errno)));
+    }
+
+    auto length = static_cast<int>(received);
+    for (auto header = buffer.data(); NLMSG_OK(header, length);
+         header = NLMSG_NEXT(header, length)) {
+      if (header->nlmsg_type == NLMSG_DONE) {
+        return Status::success();
+      }
+
+      if (header->nlmsg_type == NLMSG_ERROR) {
+        auto error = static_cast<const nlmsgerr*>(NLMSG_DATA(header));
+        return Status::failure("The sock_diag request failed: " +
+                               std::string(std::strerror(-error->error)));
+      }
+
+      if (header->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
+        callback(header);
+      }
+    }
+
+    if (received == 0) {
+      return Status::failure("The sock_diag reply was truncated");
+    }
+  }
+}
+
+Status SockDiag::getSocketList(int family,
+                               int protocol,
+                               ino_t net_ns,
+                               std::uint32_t states,
+                               SocketInfoList& result) {
+  // A failed dump leaves the list as it was, so callers may fall back to /proc.
+  auto previous_size = result.size();
+  auto status = dumpSocketList(family, protocol, net_ns, states, result);
+  if (!status.ok()) {
+    result.resize(previous_size);
+  }
+  return status;
+}
+
+Status SockDiag::dumpSocketList(int family,
+                                int protocol,
+                                ino_t net_ns,
+                                std::uint32_t states,
+                                SocketInfoList& result) {
+  if (fd_ == -1) {
+    return Status::failure("The sock_diag socket is not open");
+  }
+
+  if (family == AF_UNIX) {
+    if (protocol != IPPROTO_IP) {
+      return Status::failure("Invalid protocol " + std::to_string(protocol) +
+                             " for AF_UNIX family");
+    }
+
+    unix_diag_req request = {};
+    request.sdiag_family = AF_UNIX;
+    request.udiag_states = states;
+    request.udiag_show = UDIAG_SHOW_NAME;
+
+    return dump(request, [&](const nlmsghdr* header) {
+      if (header->nlmsg_len < NLMSG_LENGTH(sizeof(unix_diag_msg))) {
+        return;
+      }
+
+      auto msg = static_cast<const unix_diag_msg*>(NLMSG_DATA(header));
+      SocketInfo socket_info = {};
+      socket_info.socket = std::to_string(msg->udiag_ino);
+      socket_info.net_ns = net_ns;
+      socket_info.family = AF_UNIX;
+      socket_info.protocol = 0;
+      socket_info.unix_socket_path = getUnixSocketPath(msg, header->nlmsg_len);
+
+      result.push_back(std::move(socket_info));
+    });
+  }
+
+  if (family != AF_INET && family != AF_INET6) {
+    return Status::failure("Invalid family " + std::to_string(family));
+  }
+
+  if (protocol != IPPROTO_TCP && protocol != IPPROTO_UDP &&
+      protocol != IPPROTO_UDPLITE) {
+    return Status::failure("Unsupported sock_diag protocol " +
+                           std::to_string(protocol));
+  }
+
+  inet_diag_req_v2 request = {};
+  request.sdiag_family = static_cast<__u8>(family);
+  request.sdiag_protocol = static_cast<__u8>(protocol);
+  request.idiag_states = states;
+
+  return dump(request, [&](const nlmsghdr* header) {
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(inet_diag_msg))) {
+      return;
+    }
+
+    auto msg = static_cast<const inet_diag_msg*>(NLMSG_DATA(header));
+    SocketInfo socket_info = {};
+    socket_info.socket = std::to_string(msg->idiag_inode);
+    socket_info.net_ns = net_ns;
+    socket_info.family = family;
+    socket_info.protocol = protocol;
+    socket_info.local_address = getAddressString(family, msg->id.idiag_src);
+    socket_info.local_port = ntohs(msg->id.idiag_sport);
+    socket_info.remote_address = getAddressString(family, msg->id.idiag_dst);
+    socket_info.remote_port = ntohs(msg->id.idiag_dport);
+
+    if (protocol == IPPROTO_TCP) {
+      if (msg->idiag_state == 0 || msg->idiag_state >= tcp_states.size()) {
+        socket_info.state = "UNKNOWN";
+      } else {
+        socket_info.state = tcp_states[msg->idiag_state];
+      }
+    }
+
+    result.push_back(std::move(socket_info));
+  });
+}
+
+} // namespace osquery
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <osquery/filesystem/linux/proc.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A sock_diag state filter matching sockets in every state.
+const std::uint32_t kSockDiagAllStates = ~0U;
+
+/**
+ * @brief A NETLINK_SOCK_DIAG socket in a single network namespace.
+ *
+ * The kernel reports the sockets of the namespace the netlink socket was
+ * created in, and only those matching the requested states, so the tables do
+ * not have to parse, then discard, the full /proc/<pid>/net text tables.
+ */
+class SockDiag final {
+ public:
+  SockDiag() = default;
+  ~SockDiag();
+
+  SockDiag(const SockDiag&) = delete;
+  SockDiag& operator=(const SockDiag&) = delete;
+
+  /**
+   * @brief Open the socket in the network namespace of a process.
+   *
+   * When the process is not in our own namespace the socket is created by a
+   * short-lived thread that joins the namespace, the rest of the process is
+   * not moved.
+   */
+  Status open(const std::string& pid, bool own_namespace);
+
+  /**
+   * @brief Append the sockets of a family and protocol to a list.
+   *
+   * Supports IPPROTO_TCP, IPPROTO_UDP and IPPROTO_UDPLITE for AF_INET and
+   * AF_INET6, and IPPROTO_IP for AF_UNIX. The elements match the ones
+   * procGetSocketList would produce.
+   *
+   * @param states A mask of (1 << state) the kernel filters sockets by.
+   */
+  Status getSocketList(int family,
+                       int protocol,
+                       ino_t net_ns,
+                       std::uint32_t states,
+                       SocketInfoList& result);
+
+ private:
+  Status dumpSocketList(int family,
+                        int protocol,
+                        ino_t net_ns,
+                        std::uint32_t states,
+                        SocketInfoList& result);
+
+  /// Send a dump request and parse every reply with the callback.
+  template <typename Request, typename Callback>
+  Status dump(const Request& request, Callback callback);
+
+ private:
+  int fd_{-1};
+};
+
+} // namespace osquery
@@ -8,8 +8,13 @@
  */
 
 #include <osquery/core/tables.h>
+#include <osquery/rows/listening_ports.h>
 #include <osquery/sql/sql.h>
-#include <osquery/utils/info/platform_type.h>
+#include <osquery/utils/conversions/tryto.h>
+
+#ifdef __linux__
+#include <osquery/tables/networking/linux/process_open_sockets.h>
+#endif
 
 namespace {
 const std::string kAF_UNIX = "1";
@@ -19,10 +24,18 @@ const std::string kAF_INET6 = "10";
 
 namespace osquery {
 namespace tables {
-QueryData genListeningPorts(QueryContext& context) {
-  QueryData results;
+TableRows genListeningPorts(QueryContext& context) {
+  TableRows results;
 
+#ifdef __linux__
+  // Only ask the kernel for the sockets that may be listening.
+  QueryData sockets;
+  for (const auto& row : genListeningSockets(context)) {
+    sockets.push_back(static_cast<Row>(*row));
+  }
+#else
   auto sockets = SQL::selectAllFrom("process_open_sockets");
+#endif
 
   for (const auto& socket : sockets) {
     if (socket.at("family") == kAF_UNIX && socket.at("path").empty()) {
@@ -36,43 +49,39 @@ QueryData genListeningPorts(QueryContext& context) {
       continue;
     }
 
-    Row r;
-    r["pid"] = socket.at("pid");
+    auto r = std::make_unique<ListeningPortsRow>();
+    r->pid_col = tryTo<int>(socket.at("pid")).takeOr(0);
 
     if (socket.at("family") == kAF_UNIX) {
-      r["port"] = "0";
-      r["path"] = socket.at("path");
-      r["socket"] = "0";
+      r->path_col = socket.at("path");
+      r->set_null(ListeningPortsRow::ADDRESS);
     } else {
-      r["address"] = socket.at("local_address");
-      r["port"] = socket.at("local_port");
+      r->address_col = socket.at("local_address");
+      r->port_col = tryTo<int>(socket.at("local_port")).takeOr(0);
+      r->set_null(ListeningPortsRow::PATH);
 
       auto socket_it = socket.find("socket");
       if (socket_it != socket.end()) {
-        r["socket"] = socket_it->second;
-      } else {
-        r["socket"] = "0";
+        r->socket_col = tryTo<long long>(socket_it->second).takeOr(0LL);
       }
     }
 
-    r["protocol"] = socket.at("protocol");
-    r["family"] = socket.at("family");
+    r->protocol_col = tryTo<int>(socket.at("protocol")).takeOr(0);
+    r->family_col = tryTo<int>(socket.at("family")).takeOr(0);
 
     auto fd_it = socket.find("fd");
     if (fd_it != socket.end()) {
-      r["fd"] = fd_it->second;
-    } else {
-      r["fd"] = "0";
+      r->fd_col = tryTo<long long>(fd_it->second).takeOr(0LL);
     }
 
     // When running under linux, we also have the user namespace
     // column available. It can be used with the docker_containers
     // table
-    if (isPlatform(PlatformType::TYPE_LINUX)) {
-      r["net_namespace"] = socket.at("net_namespace");
-    }
+#ifdef __linux__
+    r->net_namespace_col = socket.at("net_namespace");
+#endif
 
-    results.push_back(r);
+    results.push_back(std::move(r));
   }
 
   return results;
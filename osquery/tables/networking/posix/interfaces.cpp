@@ -18,8 +18,11 @@
 
 #ifdef __linux__
 #include <limits>
+#include <unordered_map>
+
 #include <linux/ethtool.h>
 #include <linux/if_link.h>
+#include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #else //  Apple || FreeBSD
 #include <net/if_media.h>
@@ -30,6 +33,9 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#ifdef __linux__
+#include <osquery/tables/networking/linux/rtnetlink.h>
+#endif
 #include <osquery/tables/networking/posix/interfaces.h>
 #include <osquery/tables/networking/posix/utils.h>
 #include <osquery/utils/conversions/split.h>
@@ -98,6 +104,206 @@ static inline void flagsFromSysfs(const std::string& name, size_t& flags) {
     }
   }
 }
+
+/// Add the link speed and PCI slot of an interface named by the request.
+static void genEthtoolDetails(int fd,
+                              struct ifreq& ifr,
+                              Row& r,
+                              QueryContext& context) {
+  r["link_speed"] = "0";
+  if (context.isColumnUsed("link_speed")) {
+    struct ethtool_cmd cmd;
+    ifr.ifr_data = reinterpret_cast<char*>(&cmd);
+    cmd.cmd = ETHTOOL_GSET;
+
+    if (ioctl(fd, SIOCETHTOOL, &ifr) >= 0) {
+      auto speed = ethtool_cmd_speed(&cmd);
+
+      if (speed != std::numeric_limits<uint32_t>::max()) {
+        r["link_speed"] = BIGINT_FROM_UINT32(speed);
+      }
+    }
+  }
+  struct ethtool_drvinfo drvInfo;
+  ifr.ifr_data = reinterpret_cast<char*>(&drvInfo);
+  drvInfo.cmd = ETHTOOL_GDRVINFO;
+
+  if (ioctl(fd, SIOCETHTOOL, &ifr) >= 0) {
+    r["pci_slot"] = drvInfo.bus_info;
+  } else {
+    r["pci_slot"] = "-1";
+  }
+}
+
+/// Format an address like getnameinfo does for getifaddrs addresses.
+static std::string netlinkAddressAsString(int family,
+                                          const void* data,
+                                          size_t size,
+                                          int index) {
+  if (family == AF_INET && size == sizeof(struct in_addr)) {
+    return ipAsString(static_cast<const struct in_addr*>(data));
+  }
+
+  if (family != AF_INET6 || size != sizeof(struct in6_addr)) {
+    return "";
+  }
+
+  struct sockaddr_in6 addr = {};
+  addr.sin6_family = AF_INET6;
+  memcpy(&addr.sin6_addr, data, sizeof(addr.sin6_addr));
+  if (IN6_IS_ADDR_LINKLOCAL(&addr.sin6_addr) ||
+      IN6_IS_ADDR_MC_LINKLOCAL(&addr.sin6_addr)) {
+    addr.sin6_scope_id = index;
+  }
+  return ipAsString(reinterpret_cast<struct sockaddr*>(&addr));
+}
+
+/// Format the netmask of a prefix length.
+static std::string netlinkNetmaskAsString(int family, size_t prefix) {
+  unsigned char mask[sizeof(struct in6_addr)] = {0};
+  auto size = family == AF_INET ? sizeof(struct in_addr) : sizeof(mask);
+  prefix = std::min(prefix, size * 8);
+  for (size_t i = 0; i < prefix; i++) {
+    mask[i / 8] |= 0x80 >> (i % 8);
+  }
+  return netlinkAddressAsString(family, mask, size, 0);
+}
+
+static void genAddressesFromNetlink(
+    const struct nlmsghdr* message,
+    const RtnetlinkSnapshot& snapshot,
+    const std::unordered_map<int, unsigned int>& link_flags,
+    QueryData& results) {
+  auto ifa = static_cast<const struct ifaddrmsg*>(NLMSG_DATA(message));
+  if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6) {
+    return;
+  }
+
+  // Assign the addresses as getifaddrs does. A point-to-point address has
+  // both IFA_LOCAL, our end, and IFA_ADDRESS, the peer.
+  const struct rtattr* address = nullptr;
+  const struct rtattr* destination = nullptr;
+  std::string name = snapshot.getInterfaceName(ifa->ifa_index);
+  auto attr = IFA_RTA(ifa);
+  auto attr_size = static_cast<int>(IFA_PAYLOAD(message));
+  for (; RTA_OK(attr, attr_size); attr = RTA_NEXT(attr, attr_size)) {
+    switch (attr->rta_type) {
+    case IFA_ADDRESS:
+      if (address != nullptr) {
+        destination = attr;
+      } else {
+        address = attr;
+      }
+      break;
+    case IFA_LOCAL:
+      if (address != nullptr) {
+        destination = address;
+      }
+      address = attr;
+      break;
+    case IFA_BROADCAST:
+      destination = attr;
+      break;
+    case IFA_LABEL:
+      name = std::string(static_cast<const char*>(RTA_DATA(attr)),
+                         strnlen(static_cast<const char*>(RTA_DATA(attr)),
+                                 RTA_PAYLOAD(attr)));
+      break;
+    }
+  }
+
+  if (address == nullptr) {
+    return;
+  }
+
+  Row r;
+  r["interface"] = name;
+  r["address"] = netlinkAddressAsString(
+      ifa->ifa_family, RTA_DATA(address), RTA_PAYLOAD(address), ifa->ifa_index);
+  r["mask"] = netlinkNetmaskAsString(ifa->ifa_family, ifa->ifa_prefixlen);
+
+  // The destination address is used for either a broadcast or PtP address.
+  if (destination != nullptr) {
+    auto dest_address = netlinkAddressAsString(ifa->ifa_family,
+                                               RTA_DATA(destination),
+                                               RTA_PAYLOAD(destination),
+                                               ifa->ifa_index);
+    auto flags = link_flags.find(ifa->ifa_index);
+    if (flags != link_flags.end() && (flags->second & IFF_BROADCAST) != 0) {
+      r["broadcast"] = dest_address;
+    } else {
+      r["point_to_point"] = dest_address;
+    }
+  }
+  r["type"] = "unknown";
+  results.push_back(r);
+}
+
+static void genDetailsFromNetlink(const struct nlmsghdr* message,
+                                  int fd,
+                                  QueryData& results,
+                                  QueryContext& context) {
+  auto link = static_cast<const struct ifinfomsg*>(NLMSG_DATA(message));
+
+  Row r;
+  r["interface"] = "";
+  r["mtu"] = "0";
+  r["type"] = INTEGER_FROM_UCHAR(link->ifi_type);
+
+  // The metric of Linux interfaces is always 0.
+  r["metric"] = "0";
+
+  char mac[6] = {0};
+  auto attr = IFLA_RTA(link);
+  auto attr_size = static_cast<int>(IFLA_PAYLOAD(message));
+  for (; RTA_OK(attr, attr_size); attr = RTA_NEXT(attr, attr_size)) {
+    switch (attr->rta_type) {
+    case IFLA_IFNAME:
+      r["interface"] =
+          std::string(static_cast<const char*>(RTA_DATA(attr)),
+                      strnlen(static_cast<const char*>(RTA_DATA(attr)),
+                              RTA_PAYLOAD(attr)));
+      break;
+    case IFLA_ADDRESS:
+      memcpy(mac,
+             RTA_DATA(attr),
+             std::min<size_t>(RTA_PAYLOAD(attr), sizeof(mac)));
+      break;
+    case IFLA_MTU:
+      r["mtu"] = BIGINT_FROM_UINT32(*static_cast<uint32_t*>(RTA_DATA(attr)));
+      break;
+    case IFLA_STATS: {
+      auto ifd = static_cast<struct rtnl_link_stats*>(RTA_DATA(attr));
+      r["ipackets"] = BIGINT_FROM_UINT32(ifd->rx_packets);
+      r["opackets"] = BIGINT_FROM_UINT32(ifd->tx_packets);
+      r["ibytes"] = BIGINT_FROM_UINT32(ifd->rx_bytes);
+      r["obytes"] = BIGINT_FROM_UINT32(ifd->tx_bytes);
+      r["ierrors"] = BIGINT_FROM_UINT32(ifd->rx_errors);
+      r["oerrors"] = BIGINT_FROM_UINT32(ifd->tx_errors);
+      r["idrops"] = BIGINT_FROM_UINT32(ifd->rx_dropped);
+      r["odrops"] = BIGINT_FROM_UINT32(ifd->tx_dropped);
+      r["collisions"] = BIGINT_FROM_UINT32(ifd->collisions);
+      break;
+    }
+    }
+  }
+  r["mac"] = macAsString(mac);
+
+  if (fd >= 0) {
+    struct ifreq ifr = {};
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", r["interface"].c_str());
+    genEthtoolDetails(fd, ifr, r, context);
+  }
+
+  // Filter out sysfs flags, and populate them from sysfs.
+  size_t flags = link->ifi_flags & ~sysfsFlags;
+  flagsFromSysfs(r["interface"], flags);
+  r["flags"] = INTEGER(flags);
+
+  // Last change is not implemented in Linux.
+  r["last_change"] = "-1";
+  results.push_back(r);
+}
 #else //  Apple || FreeBSD
 // Based on IFM_SUBTYPE_ETHERNET_DESCRIPTIONS in if_media.h
 static int get_linkspeed(int ifm_subtype) {
@@ -186,30 +392,7 @@ void genDetailsFromAddr(const struct ifaddrs* addr,
         r["type"] = INTEGER_FROM_UCHAR(ifr.ifr_hwaddr.sa_family);
       }
 
-      r["link_speed"] = "0";
-      if (context.isColumnUsed("link_speed")) {
-        struct ethtool_cmd cmd;
-        ifr.ifr_data = reinterpret_cast<char*>(&cmd);
-        cmd.cmd = ETHTOOL_GSET;
-
-        if (ioctl(fd, SIOCETHTOOL, &ifr) >= 0) {
-          auto speed = ethtool_cmd_speed(&cmd);
-
-          if (speed != std::numeric_limits<uint32_t>::max()) {
-            r["link_speed"] = BIGINT_FROM_UINT32(speed);
-          }
-        }
-      }
-      struct ethtool_drvinfo drvInfo;
-      ifr.ifr_data = reinterpret_cast<char*>(&drvInfo);
-      drvInfo.cmd = ETHTOOL_GDRVINFO;
-
-      if (ioctl(fd, SIOCETHTOOL, &ifr) >= 0) {
-        r["pci_slot"] = drvInfo.bus_info;
-      } else {
-        r["pci_slot"] = "-1";
-      }
-
+      genEthtoolDetails(fd, ifr, r, context);
       close(fd);
     }
 
@@ -269,6 +452,23 @@ void genDetailsFromAddr(const struct ifaddrs* addr,
 QueryData genInterfaceAddresses(QueryContext& context) {
   QueryData results;
 
+#ifdef __linux__
+  RtnetlinkSnapshotRef snapshot;
+  if (getRtnetlinkSnapshot(snapshot).ok()) {
+    std::unordered_map<int, unsigned int> link_flags;
+    for (const auto& message : snapshot->links) {
+      auto link = static_cast<const struct ifinfomsg*>(
+          NLMSG_DATA(message.data()));
+      link_flags[link->ifi_index] = link->ifi_flags;
+    }
+
+    for (const auto& message : snapshot->addresses) {
+      genAddressesFromNetlink(message.data(), *snapshot, link_flags, results);
+    }
+    return results;
+  }
+#endif
+
   struct ifaddrs* if_addrs = nullptr;
   struct ifaddrs* if_addr = nullptr;
   if (getifaddrs(&if_addrs) != 0 || if_addrs == nullptr) {
@@ -292,6 +492,33 @@ QueryData genInterfaceAddresses(QueryContext& context) {
 QueryData genInterfaceDetails(QueryContext& context) {
   QueryData results;
 
+#ifdef __linux__
+  // Statistics change without notifications, dump the links when reported.
+  RtnetlinkSnapshotRef snapshot;
+  std::vector<RtnetlinkMessage> links;
+  auto status = context.isAnyColumnUsed({"ipackets",
+                                         "opackets",
+                                         "ibytes",
+                                         "obytes",
+                                         "ierrors",
+                                         "oerrors",
+                                         "idrops",
+                                         "odrops",
+                                         "collisions"})
+                    ? dumpRtnetlink(RTM_GETLINK, links)
+                    : getRtnetlinkSnapshot(snapshot);
+  if (status.ok()) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    for (const auto& message : snapshot != nullptr ? snapshot->links : links) {
+      genDetailsFromNetlink(message.data(), fd, results, context);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    return results;
+  }
+#endif
+
   struct ifaddrs* if_addrs = nullptr;
   struct ifaddrs* if_addr = nullptr;
   if (getifaddrs(&if_addrs) != 0 || if_addrs == nullptr) {
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+
+#include <osquery/tables/networking/linux/rtnetlink.h>
+
+namespace osquery {
+
+class RtnetlinkTests : public testing::Test {};
+
+TEST_F(RtnetlinkTests, test_snapshot) {
+  RtnetlinkSnapshotRef snapshot;
+  ASSERT_TRUE(getRtnetlinkSnapshot(snapshot).ok());
+  ASSERT_NE(snapshot, nullptr);
+
+  // Every network namespace has a loopback interface.
+  auto loopback = static_cast<int>(if_nametoindex("lo"));
+  ASSERT_NE(loopback, 0);
+  EXPECT_EQ(snapshot->getInterfaceName(loopback), "lo");
+  EXPECT_EQ(snapshot->getInterfaceName(-1), "");
+
+  // The messages are the replies of each dump.
+  EXPECT_FALSE(snapshot->links.empty());
+  for (const auto& message : snapshot->links) {
+    EXPECT_EQ(message.data()->nlmsg_type, RTM_NEWLINK);
+  }
+  for (const auto& message : snapshot->addresses) {
+    EXPECT_EQ(message.data()->nlmsg_type, RTM_NEWADDR);
+  }
+  for (const auto& message : snapshot->routes) {
+    EXPECT_EQ(message.data()->nlmsg_type, RTM_NEWROUTE);
+  }
+  for (const auto& message : snapshot->neighbors) {
+    EXPECT_EQ(message.data()->nlmsg_type, RTM_NEWNEIGH);
+  }
+
+  // A single dump reports the same links.
+  std::vector<RtnetlinkMessage> links;
+  ASSERT_TRUE(dumpRtnetlink(RTM_GETLINK, links).ok());
+  bool found = false;
+  for (const auto& message : links) {
+    auto link = static_cast<const ifinfomsg*>(NLMSG_DATA(message.data()));
+    found = found || link->ifi_index == loopback;
+  }
+  EXPECT_TRUE(found);
+}
+} // namespace osquery
@@ -7,7 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 
 #include <boost/filesystem.hpp>
@@ -36,6 +40,9 @@ const std::map<TSK_FS_META_TYPE_ENUM, std::string> kTSKTypeNames{
     {TSK_FS_META_TYPE_SOCK, "socket"},
 };
 
+/// Hash reads are sequential, TSK maps each read onto the file's runs.
+const TSK_OFF_T kHashReadSize{1024 * 1024};
+
 class DeviceHelper : private boost::noncopyable {
  public:
   explicit DeviceHelper(const std::string& device_path)
@@ -71,6 +78,25 @@ class DeviceHelper : private boost::noncopyable {
                      QueryData& results,
                      TSK_INUM_T inode = 0);
 
+  /// Iterate from the root, walking its subdirectories in parallel.
+  void generateTree(const std::string& partition,
+                    const TskVsPartInfo* part,
+                    TskFsInfo* fs,
+                    QueryData& results);
+
+  /**
+   * @brief Run a task for each of count items on the table workers.
+   *
+   * TSK filesystem handles are not shared between threads, each worker reads
+   * through a handle of its own opened on the partition. Items are taken in
+   * order by whichever worker is free, as their cost varies widely.
+   */
+  static void runPartitionTasks(
+      const TskVsPartInfo* part,
+      TskFsInfo* fs,
+      size_t count,
+      const std::function<void(TskFsInfo* fs, size_t i)>& task);
+
   /// Similar to generateFiles but only yield a row to results.
   void generateFile(const std::string& partition,
                     TskFsFile* file,
@@ -87,6 +113,7 @@ class DeviceHelper : private boost::noncopyable {
   void resetStack() {
     stack_ = 0;
     count_ = 0;
+    std::lock_guard<std::mutex> lock(loops_mutex_);
     std::set<std::string>().swap(loops_);
   }
 
@@ -94,6 +121,20 @@ class DeviceHelper : private boost::noncopyable {
   /// Attempt to open the provided device image and volume.
   bool open();
 
+  /// List a directory, collecting its subdirectories by inode.
+  void generateDirectory(const std::string& partition,
+                         TskFsInfo* fs,
+                         const std::string& path,
+                         TSK_INUM_T inode,
+                         QueryData& results,
+                         std::map<TSK_INUM_T, std::string>& subdirectories);
+
+  /// Mark a directory visited, false if it was already.
+  bool visit(const std::string& path) {
+    std::lock_guard<std::mutex> lock(loops_mutex_);
+    return loops_.insert(path).second;
+  }
+
  private:
   /// Has the device open been attempted.
   bool opened_{false};
@@ -110,9 +151,12 @@ class DeviceHelper : private boost::noncopyable {
   /// Filesystem path to the device node.
   std::string device_path_;
 
-  size_t stack_{0};
-  size_t count_{0};
+  /// Directories and entries listed by the walk, shared by its workers.
+  std::atomic<size_t> stack_{0};
+  std::atomic<size_t> count_{0};
+
   std::set<std::string> loops_;
+  std::mutex loops_mutex_;
 };
 
 bool DeviceHelper::open() {
@@ -197,6 +241,39 @@ void DeviceHelper::generateFile(const std::string& partition,
   results.push_back(r);
 }
 
+void DeviceHelper::runPartitionTasks(
+    const TskVsPartInfo* part,
+    TskFsInfo* fs,
+    size_t count,
+    const std::function<void(TskFsInfo* fs, size_t i)>& task) {
+  auto workers = std::min(getTableWorkerCount(), count);
+  if (workers <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(fs, i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_item{0};
+  runTableTasks(workers, [&](size_t worker) {
+    // The first worker reads through the caller's handle.
+    auto* worker_fs = fs;
+    std::unique_ptr<TskFsInfo> opened_fs;
+    if (worker > 0) {
+      opened_fs = std::make_unique<TskFsInfo>();
+      if (opened_fs->open(part, TSK_FS_TYPE_DETECT)) {
+        // The other workers take the items.
+        return;
+      }
+      worker_fs = opened_fs.get();
+    }
+
+    for (size_t i = next_item++; i < count; i = next_item++) {
+      task(worker_fs, i);
+    }
+  });
+}
+
 void DeviceHelper::generateFiles(const std::string& partition,
                                  TskFsInfo* fs,
                                  const std::string& path,
@@ -206,6 +283,60 @@ void DeviceHelper::generateFiles(const std::string& partition,
     return;
   }
 
+  std::map<TSK_INUM_T, std::string> additional;
+  generateDirectory(partition, fs, path, inode, results, additional);
+
+  // If we are recursing.
+  for (const auto& d : additional) {
+    if (visit(d.second)) {
+      generateFiles(partition, fs, d.second, results, d.first);
+    }
+  }
+}
+
+void DeviceHelper::generateTree(const std::string& partition,
+                                const TskVsPartInfo* part,
+                                TskFsInfo* fs,
+                                QueryData& results) {
+  if (stack_++ > 1024) {
+    return;
+  }
+
+  std::map<TSK_INUM_T, std::string> additional;
+  generateDirectory(partition, fs, "/", 0, results, additional);
+
+  std::vector<std::pair<TSK_INUM_T, std::string>> subtrees;
+  for (const auto& d : additional) {
+    if (visit(d.second)) {
+      subtrees.push_back(d);
+    }
+  }
+
+  // Rows are merged in the order of a serial walk.
+  std::vector<QueryData> subtree_results(subtrees.size());
+  runPartitionTasks(
+      part, fs, subtrees.size(), [&](TskFsInfo* worker_fs, size_t i) {
+        generateFiles(partition,
+                      worker_fs,
+                      subtrees[i].second,
+                      subtree_results[i],
+                      subtrees[i].first);
+      });
+
+  for (auto& subtree_result : subtree_results) {
+    results.insert(results.end(),
+                   std::make_move_iterator(subtree_result.begin()),
+                   std::make_move_iterator(subtree_result.end()));
+  }
+}
+
+void DeviceHelper::generateDirectory(
+    const std::string& partition,
+    TskFsInfo* fs,
+    const std::string& path,
+    TSK_INUM_T inode,
+    QueryData& results,
+    std::map<TSK_INUM_T, std::string>& additional) {
   auto* dir = new TskFsDir();
   if (dir->open(fs, ((inode == 0) ? fs->getRootINum() : inode))) {
     delete dir;
@@ -213,7 +344,6 @@ void DeviceHelper::generateFiles(const std::string& partition,
   }
 
   // Iterate through the directory.
-  std::map<TSK_INUM_T, std::string> additional;
   for (size_t i = 0; i < dir->getSize(); i++) {
     if (count_++ > 1024 * 10) {
       break;
@@ -252,14 +382,6 @@ void DeviceHelper::generateFiles(const std::string& partition,
     delete file;
   }
   delete dir;
-
-  // If we are recursing.
-  for (const auto& d : additional) {
-    if (std::find(loops_.begin(), loops_.end(), d.second) == loops_.end()) {
-      generateFiles(partition, fs, d.second, results, d.first);
-      loops_.insert(d.second);
-    }
-  }
 }
 
 MultiHashes hashInode(TskFsFile* file) {
@@ -281,7 +403,7 @@ MultiHashes hashInode(TskFsFile* file) {
   }
 
   // Allocate some heap memory and iterate over reading a chunk and updating.
-  auto buffer_size = (size < 4096) ? size : 4096;
+  auto buffer_size = (size < kHashReadSize) ? size : kHashReadSize;
   auto* buffer = (char*)malloc(buffer_size * sizeof(char));
   if (buffer != nullptr) {
     ssize_t chunk_size = 0;
@@ -342,23 +464,36 @@ QueryData genDeviceHash(QueryContext& context) {
         return;
       }
 
-      dh.inodes(inodes,
-                fs,
-                ([&results, &address, &dev](const std::string& inode,
-                                            TskFsFile* file,
-                                            const std::string& path) {
-                  Row r;
-                  r["device"] = dev;
-                  r["partition"] = address;
-                  r["inode"] = inode;
-
-                  auto hashes = hashInode(file);
-                  r["md5"] = std::move(hashes.md5);
-                  r["sha1"] = std::move(hashes.sha1);
-                  r["sha256"] = std::move(hashes.sha256);
-                  results.push_back(r);
-                }));
+      // Hash the inodes in parallel, rows are kept in constraint order.
+      std::vector<std::string> inode_list(inodes.begin(), inodes.end());
+      std::vector<QueryData> inode_results(inode_list.size());
+      DeviceHelper::runPartitionTasks(
+          part, fs, inode_list.size(), [&](TskFsInfo* worker_fs, size_t i) {
+            dh.inodes({inode_list[i]},
+                      worker_fs,
+                      ([&inode_results, &address, &dev, i](
+                           const std::string& inode,
+                           TskFsFile* file,
+                           const std::string& path) {
+                        Row r;
+                        r["device"] = dev;
+                        r["partition"] = address;
+                        r["inode"] = inode;
+
+                        auto hashes = hashInode(file);
+                        r["md5"] = std::move(hashes.md5);
+                        r["sha1"] = std::move(hashes.sha1);
+                        r["sha256"] = std::move(hashes.sha256);
+                        inode_results[i].push_back(r);
+                      }));
+          });
       delete fs;
+
+      for (auto& inode_result : inode_results) {
+        results.insert(results.end(),
+                       std::make_move_iterator(inode_result.begin()),
+                       std::make_move_iterator(inode_result.end()));
+      }
     }));
   }
 
@@ -404,7 +539,7 @@ QueryData genDeviceFile(QueryContext& context) {
       // If no inodes or paths were provided as constraints assume a walk of
       // the partition was requested.
       if (inodes.empty() && paths.empty()) {
-        dh.generateFiles(address, fs, "/", results);
+        dh.generateTree(address, part, fs, results);
         dh.resetStack();
       }
 
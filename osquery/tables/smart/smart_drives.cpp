@@ -10,12 +10,26 @@
 #include <smartmontools/libsmartctl.h>
 #include <smartmontools/smartctl_errs.h>
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
 #include <osquery/tables/smart/smart_drives.h>
+#include <osquery/utils/info/tool_type.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     smart_cache_max_age,
+     0,
+     "Seconds smart_drive_info rows are reused, refreshed in the background "
+     "(0 disables)");
+
 namespace tables {
 
 static inline std::ostream& operator<<(
@@ -101,70 +115,91 @@ void walkBlkDevices(
 }
 
 void querySmartDevices(
-    libsmartctl::ClientInterface& smartctl,
+    const SmartClientFactory& make_client,
     std::function<void(
         std::function<void(const std::string&, hardwareDriver*)>)> walk_func,
     QueryData& results) {
-  // hw_info is for tracking info retrieve with an explicit HW controller.  It
-  // is indexed by serial_number, since that's how you correlate the data with
-  // auto-detect retrieved SMART info.
-  std::map<std::string, Row> hw_info;
+  std::vector<std::pair<std::string, hardwareDriver*>> devices;
+  walk_func([&devices](const std::string& devname, hardwareDriver* type) {
+    devices.emplace_back(devname, type);
+  });
+
+  // Get autodetected info, the drives are queried in parallel.
+  std::vector<libsmartctl::DevInfoResp> autodetected(devices.size());
+  runTableTasks(devices.size(), [&](size_t i) {
+    auto smartctl = make_client();
+    autodetected[i] = smartctl->getDevInfo(devices[i].first, "");
+  });
 
-  // Flag for indicating found state utilizing hardware driver info.
-  bool found = false;
-  walk_func([&](const std::string& devname, hardwareDriver* type) {
-    // Get autodetected info..
-    auto resp = smartctl.getDevInfo(devname, "");
+  for (size_t i = 0; i < devices.size(); i++) {
+    auto& resp = autodetected[i];
     if (resp.err != NOERR) {
       LOG(INFO) << "There was an error retrieving drive information: "
                 << libsmartctl::errStr(resp.err);
-      // Don't return here, keep searching with fulltype.
+      // Don't skip here, keep searching with fulltype.
     } else {
-      resp.content["device_name"] = devname;
+      resp.content["device_name"] = devices[i].first;
       results.push_back(std::move(resp.content));
     }
+  }
 
-    // Get info via HW controllers if not found yet
-    if (found) {
-      return;
-    }
+  // hw_info is for tracking info retrieve with an explicit HW controller.  It
+  // is indexed by serial_number, since that's how you correlate the data with
+  // auto-detect retrieved SMART info.
+  std::map<std::string, Row> hw_info;
 
+  // Get info via HW controllers until one of the devices has it.
+  for (const auto& device : devices) {
+    const auto& devname = device.first;
+    auto type = device.second;
     if (type == nullptr) {
-      found = true;
-      return;
+      break;
     }
 
     // No need to check each individual software partition since they will
     // examined at the HW level below.
     if (devname.substr(devname.length() - 1).find_last_of("0123456789") !=
         std::string::npos) {
-      return;
+      continue;
     }
 
     // We now try to find device information based on any explicit storage
     // controller info.  Once we find one, we can search until the max ID of
     // that controller, and assume that all information with that controller
-    // has been retrieved.
-    for (size_t i = 0; i <= type->maxID; i++) {
+    // has been retrieved. The IDs are probed in parallel.
+    std::vector<libsmartctl::DevInfoResp> disks(type->maxID + 1);
+    std::vector<char> identified(disks.size(), 0);
+    runTableTasks(disks.size(), [&](size_t i) {
       std::string full_type = type->driver + std::to_string(i);
 
-      auto cant_id = smartctl.cantIdDev(devname, full_type);
+      auto smartctl = make_client();
+      auto cant_id = smartctl->cantIdDev(devname, full_type);
       if (cant_id.err != NOERR) {
         LOG(INFO) << "Error while trying to identify device: "
                   << libsmartctl::errStr(cant_id.err);
-        continue;
+        return;
       }
       // If device is not identifiable, the type is invalid, skip..
       if (cant_id.content) {
+        return;
+      }
+
+      identified[i] = 1;
+      disks[i] = smartctl->getDevInfo(devname, full_type);
+    });
+
+    bool found = false;
+    for (size_t i = 0; i < disks.size(); i++) {
+      if (!identified[i]) {
         continue;
       }
 
-      resp = smartctl.getDevInfo(devname, full_type);
+      auto& resp = disks[i];
       if (resp.err != NOERR) {
         LOG(WARNING) << "There was an error retrieving drive information with "
                         "hardware driver: "
                      << libsmartctl::errStr(resp.err);
-        return;
+        break;
       }
       // Only consider found if no error was returned.
       found = true;
@@ -179,7 +214,11 @@ void querySmartDevices(
         hw_info[serial->second] = resp.content;
       };
     }
-  });
+
+    if (found) {
+      break;
+    }
+  }
 
   // Join results..
   for (auto& entry : hw_info) {
@@ -205,11 +244,86 @@ void querySmartDevices(
   }
 }
 
-QueryData genSmartInfo(QueryContext& context) {
+/// Query the drives of the system.
+static QueryData collectSmartInfo() {
   QueryData results;
-  libsmartctl::Client smartctl;
-  querySmartDevices(smartctl, walkBlkDevices, results);
+  querySmartDevices(
+      []() { return std::make_unique<libsmartctl::Client>(); },
+      walkBlkDevices,
+      results);
+  return results;
+}
+
+/// The rows of the last collection, see --smart_cache_max_age.
+struct SmartInfoCache {
+  Mutex mutex;
+  QueryData rows;
+  bool valid{false};
+  bool read{false};
+  std::chrono::steady_clock::time_point collected;
+};
+
+static SmartInfoCache kSmartInfoCache;
+
+static void storeSmartInfo(const QueryData& rows) {
+  WriteLock lock(kSmartInfoCache.mutex);
+  kSmartInfoCache.rows = rows;
+  kSmartInfoCache.valid = true;
+  kSmartInfoCache.collected = std::chrono::steady_clock::now();
+}
+
+std::chrono::milliseconds SmartInfoRefresher::tick() {
+  std::chrono::seconds max_age(FLAGS_smart_cache_max_age);
+  if (max_age.count() == 0) {
+    return kDone;
+  }
+
+  bool due = false;
+  {
+    WriteLock lock(kSmartInfoCache.mutex);
+    // Drives are only polled while the table is queried.
+    due = kSmartInfoCache.read &&
+          std::chrono::steady_clock::now() - kSmartInfoCache.collected >=
+              max_age / 2;
+    if (due) {
+      kSmartInfoCache.read = false;
+    }
+  }
+
+  if (due) {
+    storeSmartInfo(collectSmartInfo());
+  }
+  return std::max<std::chrono::milliseconds>(max_age / 4,
+                                             std::chrono::seconds(1));
+}
+
+QueryData genSmartInfo(QueryContext& context) {
+  std::chrono::seconds max_age(FLAGS_smart_cache_max_age);
+  if (max_age.count() == 0) {
+    return collectSmartInfo();
+  }
+
+#ifndef OSQUERY_IS_FUZZING
+  static std::once_flag refresher_started;
+  if (isDaemon()) {
+    std::call_once(refresher_started, []() {
+      Dispatcher::addService(std::make_shared<SmartInfoRefresher>());
+    });
+  }
+#endif
+
+  {
+    WriteLock lock(kSmartInfoCache.mutex);
+    kSmartInfoCache.read = true;
+    if (kSmartInfoCache.valid &&
+        std::chrono::steady_clock::now() - kSmartInfoCache.collected <
+            max_age) {
+      return kSmartInfoCache.rows;
+    }
+  }
 
+  auto results = collectSmartInfo();
+  storeSmartInfo(results);
   return results;
 }
 } // namespace tables
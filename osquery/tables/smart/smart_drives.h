@@ -7,9 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <functional>
+#include <memory>
+
 #include <smartmontools/libsmartctl.h>
 
 #include <osquery/core/tables.h>
+#include <osquery/dispatcher/dispatcher.h>
 
 namespace osquery {
 namespace tables {
@@ -26,20 +30,36 @@ struct hardwareDriver {
   size_t maxID;
 };
 
+/// Creates a libsmartctl client, each concurrent query uses its own.
+using SmartClientFactory =
+    std::function<std::unique_ptr<libsmartctl::ClientInterface>()>;
+
 /**
  * @brief Queries SMART devices on the system by autodetection and explicit
  * storage controller arguments.
  *
- * @param client libsmartctl client
+ * The devices, and the disk IDs behind a hardware controller, are queried
+ * in parallel on the table workers.
+ *
+ * @param make_client creates the libsmartctl clients
  * @param walk_func function that walks the system devices and runs the handler
  * function on each device
  * @param results reference to QueryData to store results in
  */
 void querySmartDevices(
-    libsmartctl::ClientInterface& client,
+    const SmartClientFactory& make_client,
     std::function<void(
         std::function<void(const std::string&, hardwareDriver*)>)> walk_func,
     QueryData& results);
 
+/// Refreshes the cached smart_drive_info rows, see --smart_cache_max_age.
+class SmartInfoRefresher : public PeriodicRunnable {
+ public:
+  SmartInfoRefresher() : PeriodicRunnable("SmartInfoRefresher") {}
+
+ protected:
+  std::chrono::milliseconds tick() override;
+};
+
 } // namespace tables
 } // namespace osquery
@@ -104,6 +104,14 @@ genMockWalkFunc(const std::map<std::string, hardwareDriver*>& devices) {
       };
 }
 
+/// Creates mock clients, each with its own copy of the SMART data.
+SmartClientFactory genMockClientFactory(
+    std::map<std::string, std::map<std::string, std::string>>& data) {
+  return [&data]() -> std::unique_ptr<libsmartctl::ClientInterface> {
+    return std::make_unique<MockLibsmartctlClient>(data);
+  };
+}
+
 /// Generates mock SMART device data.
 std::map<std::string, std::string> genMockDeviceData(
     const std::string& devname) {
@@ -139,9 +147,9 @@ TEST_F(QuerySmartDevicesTest, no_hw_controllers) {
       },
   };
 
-  MockLibsmartctlClient mockClient(mockdb);
   QueryData got;
-  querySmartDevices(mockClient, genMockWalkFunc(devices), got);
+  querySmartDevices(
+      genMockClientFactory(mockdb), genMockWalkFunc(devices), got);
 
   EXPECT_EQ(got, expected);
 }
@@ -178,9 +186,34 @@ TEST_F(QuerySmartDevicesTest, with_hw_controllers) {
       },
   };
 
-  MockLibsmartctlClient mockClient(mockdb);
   QueryData got;
-  querySmartDevices(mockClient, genMockWalkFunc(devices), got);
+  querySmartDevices(
+      genMockClientFactory(mockdb), genMockWalkFunc(devices), got);
+
+  EXPECT_EQ(got, expected);
+}
+
+TEST_F(QuerySmartDevicesTest, results_keep_device_order) {
+  // The devices are queried in parallel, the rows keep the walk order.
+  std::map<std::string, std::map<std::string, std::string>> mockdb;
+  std::map<std::string, hardwareDriver*> devices;
+  QueryData expected;
+  for (char suffix = 'a'; suffix <= 'z'; suffix++) {
+    auto devname = std::string("device_") + suffix;
+    mockdb[devname] = genMockDeviceData(devname);
+    devices[devname] = nullptr;
+
+    auto row = genMockDeviceData(devname);
+    row["device_name"] = devname;
+    expected.push_back(row);
+  }
+
+  // A device without SMART data is skipped.
+  devices["device_missing"] = nullptr;
+
+  QueryData got;
+  querySmartDevices(
+      genMockClientFactory(mockdb), genMockWalkFunc(devices), got);
 
   EXPECT_EQ(got, expected);
 }
@@ -20,6 +20,7 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
+#include <osquery/tables/system/darwin/parsed_file_cache.h>
 #include <osquery/utils/conversions/darwin/cfstring.h>
 #include <osquery/utils/darwin/plist.h>
 
@@ -58,6 +59,12 @@ const std::vector<std::string> kSystemSearchPaths = {
     "/Users/Shared/Applications",
 };
 
+/// Info.plist files kept, hosts with Xcode and simulators have thousands.
+const size_t kMaxCachedAppInfo{8192};
+
+/// Threads parsing Info.plist files when many applications changed.
+const size_t kAppInfoParseThreads{4};
+
 enum AppSchemeFlags {
   kSchemeNormal = 0,
   // Default flag from the list of schemes on a default OS X 10.10 install.
@@ -176,10 +183,24 @@ void genApplicationsFromPath(const fs::path& path,
   }
 }
 
-void genApplication(const pt::ptree& tree,
-                    const fs::path& path,
-                    QueryData& results) {
-  Row r;
+/// Set the columns read from an Info.plist.
+void genApplicationInfo(const pt::ptree& tree, Row& r) {
+  // Loop through each column and its mapped Info.plist key name.
+  for (const auto& item : kAppsInfoPlistTopLevelStringKeys) {
+    r[item.second] = tree.get<std::string>(item.first, "");
+    // Change boolean values into integer 1, 0.
+    if (r[item.second] == "true" || r[item.second] == "YES" ||
+        r[item.second] == "Yes") {
+      r[item.second] = INTEGER(1);
+    } else if (r[item.second] == "false" || r[item.second] == "NO" ||
+               r[item.second] == "No") {
+      r[item.second] = INTEGER(0);
+    }
+  }
+}
+
+/// Set the columns that are not read from the Info.plist of an application.
+void genApplicationDetails(const fs::path& path, Row& r) {
   r["name"] = path.parent_path().parent_path().filename().string();
   r["path"] = path.parent_path().parent_path().string();
 
@@ -200,22 +221,35 @@ void genApplication(const pt::ptree& tree,
   } else {
     r["last_opened_time"] = INTEGER(-1);
   }
+}
 
-  // Loop through each column and its mapped Info.plist key name.
-  for (const auto& item : kAppsInfoPlistTopLevelStringKeys) {
-    r[item.second] = tree.get<std::string>(item.first, "");
-    // Change boolean values into integer 1, 0.
-    if (r[item.second] == "true" || r[item.second] == "YES" ||
-        r[item.second] == "Yes") {
-      r[item.second] = INTEGER(1);
-    } else if (r[item.second] == "false" || r[item.second] == "NO" ||
-               r[item.second] == "No") {
-      r[item.second] = INTEGER(0);
-    }
-  }
+void genApplication(const pt::ptree& tree,
+                    const fs::path& path,
+                    QueryData& results) {
+  Row r;
+  genApplicationDetails(path, r);
+  genApplicationInfo(tree, r);
   results.push_back(std::move(r));
 }
 
+bool parseApplicationInfo(const std::string& path, Row& r) {
+  pt::ptree tree;
+  if (!osquery::parsePlist(path, tree).ok()) {
+    TLOG << "Error parsing application plist: " << path;
+    return false;
+  }
+
+  genApplicationInfo(tree, r);
+  return true;
+}
+
+/// The Info.plist columns, parsed again only when the file changes.
+ParsedFileCache<Row>& getApplicationInfoCache() {
+  static ParsedFileCache<Row> cache(
+      parseApplicationInfo, kMaxCachedAppInfo, kAppInfoParseThreads);
+  return cache;
+}
+
 Status genAppsFromLaunchServices(std::set<std::string>& apps) {
   // Resolve the protected/private symbol safely.
   CFBundleRef ls_bundle =
@@ -280,24 +314,18 @@ QueryData genApps(QueryContext& context) {
       }
     }
 
-    // The osquery::parsePlist method will reset/clear a property tree.
-    // Keeping the data structure in a larger scope preserves allocations
-    // between similar-sized trees.
-    pt::ptree tree;
-
-    // For each found application (path with an Info.plist) parse the plist.
-    for (const auto& path : apps) {
-      if (!osquery::pathExists(path)) {
-        continue;
-      }
+    // Only the Info.plist files that changed since the last query are parsed.
+    std::vector<std::string> paths(apps.begin(), apps.end());
+    auto infos = getApplicationInfoCache().get(paths);
 
-      if (!osquery::parsePlist(path, tree).ok()) {
-        TLOG << "Error parsing application plist: " << path;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (infos[i] == nullptr) {
         continue;
       }
 
-      // Using the parsed plist, pull out each interesting key.
-      genApplication(tree, path, results);
+      Row r = *infos[i];
+      genApplicationDetails(paths[i], r);
+      results.push_back(std::move(r));
     }
   }
   return results;
@@ -17,6 +17,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
 #include <osquery/tables/system/darwin/packages.h>
+#include <osquery/tables/system/darwin/parsed_file_cache.h>
 #include <osquery/utils/darwin/plist.h>
 
 namespace fs = boost::filesystem;
@@ -36,6 +37,15 @@ const std::vector<std::string> kPkgReceiptUserPaths = {
 const std::string kPkgInstallHistoryPath =
     "/Library/Receipts/InstallHistory.plist";
 
+/// PackageKit writes its receipts here, the listing is kept until it changes.
+const std::string kPkgReceiptDatabasePath = "/private/var/db/receipts";
+
+/// Receipts kept, each installed package has one.
+const size_t kMaxCachedReceipts{8192};
+
+/// BOMs kept, their rows list every file of a package.
+const size_t kMaxCachedBOMs{16};
+
 const std::map<std::string, std::string> kPkgReceiptKeys = {
     {"PackageIdentifier", "package_id"},
     {"PackageFileName", "package_filename"},
@@ -276,27 +286,40 @@ void genPackageBOM(const std::string& path, QueryData& results) {
   }
 }
 
+bool parsePackageBOM(const std::string& path, QueryData& rows) {
+  genPackageBOM(path, rows);
+  return true;
+}
+
+/// The rows of each BOM, read again only when the file changes.
+ParsedFileCache<QueryData>& getPackageBOMCache() {
+  static ParsedFileCache<QueryData> cache(parsePackageBOM, kMaxCachedBOMs);
+  return cache;
+}
+
 QueryData genPackageBOM(QueryContext& context) {
   QueryData results;
   if (context.constraints["path"].exists(EQUALS)) {
     // If an explicit path was given, generate and return.
     auto paths = context.constraints["path"].getAll(EQUALS);
-    for (const auto& path : paths) {
-      genPackageBOM(path, results);
+    std::vector<std::string> bom_paths(paths.begin(), paths.end());
+    for (const auto& rows : getPackageBOMCache().get(bom_paths)) {
+      if (rows != nullptr) {
+        results.insert(results.end(), rows->begin(), rows->end());
+      }
     }
   }
 
   return results;
 }
 
-void genPackageReceipt(const std::string& path, QueryData& results) {
+bool parsePackageReceipt(const std::string& path, Row& r) {
   auto receipt = SQL::selectAllFrom("plist", "path", EQUALS, path);
   if (receipt.size() == 0) {
     // Fail if the file could not be plist-parsed.
-    return;
+    return false;
   }
 
-  Row r;
   r["path"] = path;
   for (const auto& row : receipt) {
     if (kPkgReceiptKeys.count(row.at("key")) > 0) {
@@ -304,11 +327,29 @@ void genPackageReceipt(const std::string& path, QueryData& results) {
     }
   }
 
-  if (!r["package_id"].empty()) {
-    results.push_back(std::move(r));
+  return !r["package_id"].empty();
+}
+
+/// The receipts, read again only when the file changes. The plist table is
+/// used to parse them, so they are parsed on the query thread.
+ParsedFileCache<Row>& getPackageReceiptCache() {
+  static ParsedFileCache<Row> cache(parsePackageReceipt, kMaxCachedReceipts);
+  return cache;
+}
+
+void genPackageReceiptsFromPaths(const std::vector<std::string>& paths,
+                                 QueryData& results) {
+  for (const auto& receipt : getPackageReceiptCache().get(paths)) {
+    if (receipt != nullptr) {
+      results.push_back(*receipt);
+    }
   }
 }
 
+void genPackageReceipt(const std::string& path, QueryData& results) {
+  genPackageReceiptsFromPaths({path}, results);
+}
+
 /**
  * @brief Try to use PackageKit to list installed packages.
  *
@@ -407,28 +448,31 @@ static inline bool genPackagesFromPackageKit(QueryData& results) {
  * @param results the output data.
  */
 static inline void genPackagesFromPlists(QueryData& results) {
+  std::vector<std::string> receipts;
   for (const auto& path : kPkgReceiptPaths) {
-    std::vector<std::string> receipts;
-    if (resolveFilePattern(path + "%.plist", receipts)) {
-      for (const auto& receipt : receipts) {
-        genPackageReceipt(receipt, results);
-      }
-    }
+    resolveFilePattern(path + "%.plist", receipts);
   }
 
   // User home directories may include user-specific receipt lists.
   auto users = getHomeDirectories();
   for (const auto& user : users) {
     for (const auto& path : kPkgReceiptUserPaths) {
-      std::vector<std::string> receipts;
       fs::path receipt_path = user / path;
-      if (resolveFilePattern(receipt_path.string() + "%.plist", receipts)) {
-        for (const auto& receipt : receipts) {
-          genPackageReceipt(receipt, results);
-        }
-      }
+      resolveFilePattern(receipt_path.string() + "%.plist", receipts);
     }
   }
+
+  genPackageReceiptsFromPaths(receipts, results);
+}
+
+bool parsePackagesFromPackageKit(const std::string&, QueryData& results) {
+  return genPackagesFromPackageKit(results);
+}
+
+/// The PackageKit listing, kept until a receipt is added or removed.
+ParsedFileCache<QueryData>& getPackageKitCache() {
+  static ParsedFileCache<QueryData> cache(parsePackagesFromPackageKit, 1);
+  return cache;
 }
 
 QueryData genPackageReceipts(QueryContext& context) {
@@ -454,7 +498,12 @@ QueryData genPackageReceipts(QueryContext& context) {
     return results;
   }
 
-  if (!genPackagesFromPackageKit(results)) {
+  // Receipts are added and removed by renaming them into the database, which
+  // changes the fingerprint of its directory.
+  auto packages = getPackageKitCache().get({kPkgReceiptDatabasePath});
+  if (packages[0] != nullptr) {
+    results = *packages[0];
+  } else {
     VLOG(1) << "Cannot list package receipts from PackageKit";
     genPackagesFromPlists(results);
   }
@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/stat.h>
+
+#include <osquery/tables/system/darwin/parsed_file_cache.h>
+
+namespace osquery {
+namespace tables {
+
+std::string getParsedFileFingerprint(const std::string& path) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    return "";
+  }
+
+  return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+         std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime) + ":" +
+         std::to_string(st.st_ctime);
+}
+
+} // namespace tables
+} // namespace osquery
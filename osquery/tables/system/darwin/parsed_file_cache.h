@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Fingerprint a file with its device, inode, size and change times.
+ *
+ * Bundles are updated by replacing or rewriting their files, either one
+ * changes the fingerprint.
+ *
+ * @return An empty string if the file does not exist.
+ */
+std::string getParsedFileFingerprint(const std::string& path);
+
+/// Files changed since the last query are parsed in parallel above this count.
+const size_t kParallelParseThreshold{16};
+
+/**
+ * @brief Values parsed from files, kept until the files change.
+ *
+ * Tables such as apps parse the same Info.plist files on every query while
+ * they rarely change. Each value is kept with the fingerprint of its file and
+ * served until the fingerprint changes. Files that fail to parse are also
+ * kept, as a nullptr value, until they change.
+ */
+template <typename T>
+class ParsedFileCache final {
+ public:
+  using Value = std::shared_ptr<const T>;
+
+  /// Parse a file, false if it is not valid. May run on several threads.
+  using Parser = std::function<bool(const std::string& path, T& value)>;
+
+  /**
+   * @param parser parses a changed file.
+   * @param max_entries files kept at most, the ones not asked for go first.
+   * @param threads parse threads used when many files changed, 1 if the
+   * parser is not thread safe.
+   */
+  ParsedFileCache(Parser parser, size_t max_entries, size_t threads = 1)
+      : parser_(std::move(parser)),
+        max_entries_(max_entries),
+        threads_(std::max<size_t>(threads, 1)) {}
+
+  ParsedFileCache(const ParsedFileCache&) = delete;
+  ParsedFileCache& operator=(const ParsedFileCache&) = delete;
+
+  /// The values of the paths, in order, nullptr if a file is missing or not
+  /// valid.
+  std::vector<Value> get(const std::vector<std::string>& paths) {
+    std::vector<std::string> fingerprints;
+    fingerprints.reserve(paths.size());
+    for (const auto& path : paths) {
+      fingerprints.push_back(getParsedFileFingerprint(path));
+    }
+
+    std::vector<Value> values(paths.size());
+    std::vector<size_t> changed;
+    {
+      WriteLock lock(mutex_);
+      for (size_t i = 0; i < paths.size(); ++i) {
+        if (fingerprints[i].empty()) {
+          continue;
+        }
+
+        auto it = entries_.find(paths[i]);
+        if (it != entries_.end() && it->second.fingerprint == fingerprints[i]) {
+          values[i] = it->second.value;
+        } else {
+          changed.push_back(i);
+        }
+      }
+    }
+
+    // Parse without the lock, a slow file should not block other queries.
+    parse(paths, changed, values);
+
+    WriteLock lock(mutex_);
+    for (auto i : changed) {
+      entries_[paths[i]] = {fingerprints[i], values[i]};
+    }
+    prune(paths);
+    return values;
+  }
+
+  /// Drop every cached value.
+  void clear() {
+    WriteLock lock(mutex_);
+    entries_.clear();
+  }
+
+  size_t size() {
+    WriteLock lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  Value parseOne(const std::string& path) {
+    auto value = std::make_shared<T>();
+    if (!parser_(path, *value)) {
+      return nullptr;
+    }
+    return value;
+  }
+
+  void parse(const std::vector<std::string>& paths,
+             const std::vector<size_t>& changed,
+             std::vector<Value>& values) {
+    auto threads = std::min(threads_, changed.size() / kParallelParseThreshold);
+    if (threads <= 1) {
+      for (auto i : changed) {
+        values[i] = parseOne(paths[i]);
+      }
+      return;
+    }
+
+    // Each thread takes the next changed file, they write distinct values.
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+      for (auto n = next++; n < changed.size(); n = next++) {
+        values[changed[n]] = parseOne(paths[changed[n]]);
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+      workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& thread : workers) {
+      thread.join();
+    }
+  }
+
+  /// Keep at most max_entries_, dropping files not asked for first.
+  void prune(const std::vector<std::string>& paths) {
+    if (entries_.size() <= max_entries_) {
+      return;
+    }
+
+    std::unordered_set<std::string> requested(paths.begin(), paths.end());
+    for (auto it = entries_.begin();
+         it != entries_.end() && entries_.size() > max_entries_;) {
+      if (requested.count(it->first) == 0) {
+        it = entries_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    while (entries_.size() > max_entries_) {
+      entries_.erase(entries_.begin());
+    }
+  }
+
+ private:
+  struct Entry {
+    std::string fingerprint;
+    Value value;
+  };
+
+  Parser parser_;
+  size_t max_entries_;
+  size_t threads_;
+
+  Mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace tables
+} // namespace osquery
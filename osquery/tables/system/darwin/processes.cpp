@@ -17,6 +17,7 @@
 #include <array>
 #include <map>
 #include <set>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
 
@@ -71,23 +72,22 @@ std::set<int> getProcList(const QueryContext& context) {
     return pidlist;
   }
 
-  int bufsize = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
-  if (bufsize <= 0) {
+  int num_pids = proc_listallpids(nullptr, 0);
+  if (num_pids <= 0) {
     VLOG(1) << "An error occurred retrieving the process list";
     return pidlist;
   }
 
   // Use twice the number of PIDs returned to handle races.
-  std::vector<pid_t> pids(2 * bufsize);
-
-  bufsize = proc_listpids(PROC_ALL_PIDS, 0, pids.data(), 2 * bufsize);
-  if (bufsize <= 0) {
+  std::vector<pid_t> pids(2 * num_pids);
+  num_pids = proc_listallpids(
+      pids.data(), static_cast<int>(pids.size() * sizeof(pid_t)));
+  if (num_pids <= 0) {
     VLOG(1) << "An error occurred retrieving the process list";
     return pidlist;
   }
 
-  size_t num_pids = bufsize / sizeof(pid_t);
-  for (size_t i = 0; i < num_pids; ++i) {
+  for (int i = 0; i < num_pids; ++i) {
     // If the pid is negative, it doesn't represent a real process so
     // continue the iterations so that we don't add it to the results set
     if (pids[i] < 0) {
@@ -109,25 +109,43 @@ struct proc_cred {
   } real, effective, saved;
 };
 
+static inline void setProcCred(const struct proc_bsdinfo& bsdinfo,
+                               proc_cred& cred) {
+  cred.parent = bsdinfo.pbi_ppid;
+  cred.group = bsdinfo.pbi_pgid;
+  cred.status = bsdinfo.pbi_status;
+  cred.nice = bsdinfo.pbi_nice;
+  cred.real.uid = bsdinfo.pbi_ruid;
+  cred.real.gid = bsdinfo.pbi_rgid;
+  cred.effective.uid = bsdinfo.pbi_uid;
+  cred.effective.gid = bsdinfo.pbi_gid;
+  cred.saved.uid = bsdinfo.pbi_svuid;
+  cred.saved.gid = bsdinfo.pbi_svgid;
+}
+
 inline bool genProcCred(QueryContext& context,
                         int pid,
                         proc_cred& cred,
                         ProcessesRow& r) {
+  struct proc_taskallinfo allinfo;
   struct proc_bsdinfo bsdinfo;
   struct proc_bsdshortinfo bsdinfo_short;
 
-  if (proc_pidinfo(pid, PROC_PIDTBSDINFO, 1, &bsdinfo, PROC_PIDTBSDINFO_SIZE) ==
-      PROC_PIDTBSDINFO_SIZE) {
-    cred.parent = bsdinfo.pbi_ppid;
-    cred.group = bsdinfo.pbi_pgid;
-    cred.status = bsdinfo.pbi_status;
-    cred.nice = bsdinfo.pbi_nice;
-    cred.real.uid = bsdinfo.pbi_ruid;
-    cred.real.gid = bsdinfo.pbi_rgid;
-    cred.effective.uid = bsdinfo.pbi_uid;
-    cred.effective.gid = bsdinfo.pbi_gid;
-    cred.saved.uid = bsdinfo.pbi_svuid;
-    cred.saved.gid = bsdinfo.pbi_svgid;
+  // The thread count shares a call with the credentials when it is used.
+  auto use_threads = context.isAnyColumnUsed(ProcessesRow::THREADS);
+  if (use_threads) {
+    r.threads_col = -1;
+  }
+
+  if (use_threads &&
+      proc_pidinfo(pid, PROC_PIDTASKALLINFO, 0, &allinfo, sizeof(allinfo)) ==
+          sizeof(allinfo)) {
+    setProcCred(allinfo.pbsd, cred);
+    r.threads_col = allinfo.ptinfo.pti_threadnum;
+  } else if (proc_pidinfo(
+                 pid, PROC_PIDTBSDINFO, 1, &bsdinfo, PROC_PIDTBSDINFO_SIZE) ==
+             PROC_PIDTBSDINFO_SIZE) {
+    setProcCred(bsdinfo, cred);
   } else if (proc_pidinfo(pid,
                           PROC_PIDT_SHORTBSDINFO,
                           1,
@@ -250,21 +268,6 @@ void genProcNamePathAndOnDisk(const QueryContext& context,
   }
 }
 
-void genProcNumThreads(QueryContext& context, int pid, ProcessesRow& r) {
-  if (!context.isAnyColumnUsed(ProcessesRow::THREADS)) {
-    return;
-  }
-
-  struct proc_taskinfo task_info;
-  int status =
-      proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &task_info, sizeof(task_info));
-  if (status == sizeof(task_info)) {
-    r.threads_col = task_info.pti_threadnum;
-  } else {
-    r.threads_col = -1;
-  }
-}
-
 void genProcUniquePid(QueryContext& context, int pid, ProcessesRow& r) {
   if (!context.isAnyColumnUsed(ProcessesRow::UPID | ProcessesRow::UPPID)) {
     return;
@@ -355,10 +358,11 @@ bool parseProcCmdline(std::string& args, size_t len) {
   return true;
 }
 
-std::map<std::string, std::string> getProcEnv(int pid, size_t argmax) {
+std::map<std::string, std::string> getProcEnv(int pid,
+                                              std::vector<char>& buffer) {
   std::map<std::string, std::string> env;
-  std::unique_ptr<char[]> pprocargs{new char[argmax]};
-  char* procargs = pprocargs.get();
+  char* procargs = buffer.data();
+  size_t argmax = buffer.size();
   int mib[3] = {CTL_KERN, KERN_PROCARGS2, pid};
   if (sysctl(mib, 3, procargs, &argmax, nullptr, 0) == -1 || argmax == 0) {
     return env;
@@ -396,25 +400,33 @@ std::map<std::string, std::string> getProcEnv(int pid, size_t argmax) {
   return env;
 }
 
-void genProcCmdline(const QueryContext& context, int pid, ProcessesRow& r) {
+void genProcCmdline(const QueryContext& context,
+                    int pid,
+                    std::vector<char>& buffer,
+                    ProcessesRow& r) {
   if (!context.isAnyColumnUsed(ProcessesRow::CMDLINE)) {
     return;
   }
 
-  size_t len = 0;
-  int mib[] = {CTL_KERN, KERN_PROCARGS2, pid};
-  // Estimate the size.
-  if (sysctl(mib, 3, nullptr, &len, nullptr, 0) != 0) {
-    return;
+  if (buffer.empty()) {
+    // A buffer of the max argument size is shared by every process, so the
+    // arguments are read without first asking for their size.
+    auto argmax = genMaxArgs();
+    if (argmax <= 0) {
+      return;
+    }
+    buffer.resize(argmax);
   }
 
-  len++;
-  std::string args(len, 0);
-  // Request content.
-  if (sysctl(mib, 3, &args[0], &len, nullptr, 0) != 0) {
+  size_t len = buffer.size();
+  int mib[] = {CTL_KERN, KERN_PROCARGS2, pid};
+  if (sysctl(mib, 3, buffer.data(), &len, nullptr, 0) != 0) {
     return;
   }
 
+  std::string args(buffer.data(), len);
+  args.push_back('\0');
+  len = args.size();
   if (parseProcCmdline(args, len)) {
     r.cmdline_col = std::move(args);
   }
@@ -479,33 +491,32 @@ TableRows genProcesses(QueryContext& context) {
   TableRows results;
 
   auto pidlist = getProcList(context);
+  std::vector<char> args_buffer;
   for (const auto& pid : pidlist) {
-    ProcessesRow* r = new ProcessesRow();
+    auto r = std::make_unique<ProcessesRow>();
     r->pid_col = pid;
 
-    genProcCmdline(context, pid, *r);
-
-    // The process relative root and current working directory.
-    genProcRootAndCWD(context, pid, *r);
-
+    // A process that cannot be inspected is skipped before any other reads.
     proc_cred cred;
     if (!genProcCred(context, pid, cred, *r)) {
       continue;
     }
 
+    genProcCmdline(context, pid, args_buffer, *r);
+
+    // The process relative root and current working directory.
+    genProcRootAndCWD(context, pid, *r);
+
     genProcNamePathAndOnDisk(context, pid, cred, *r);
 
     // systems usage and time information
     genProcResourceUsage(context, pid, *r);
 
-    genProcNumThreads(context, pid, *r);
-
     genProcUniquePid(context, pid, *r);
 
     genProcArch(context, pid, *r);
 
-    std::unique_ptr<TableRow> tr(r);
-    results.push_back(std::move(tr));
+    results.push_back(std::move(r));
   }
 
   return results;
@@ -516,8 +527,13 @@ QueryData genProcessEnvs(QueryContext& context) {
 
   auto pidlist = getProcList(context);
   int argmax = genMaxArgs();
+  if (argmax <= 0) {
+    return results;
+  }
+
+  std::vector<char> buffer(argmax);
   for (const auto& pid : pidlist) {
-    auto envs = getProcEnv(pid, argmax);
+    auto envs = getProcEnv(pid, buffer);
     for (const auto& env : envs) {
       Row r;
       r["pid"] = INTEGER(pid);
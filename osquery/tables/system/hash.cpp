@@ -20,18 +20,24 @@
 #include <fuzzy.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <set>
 #include <thread>
 
 #include <boost/filesystem.hpp>
 
 #include <osquery/core/flags.h>
+#include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
-#include <osquery/utils/mutex.h>
+#include <osquery/utils/caches/clock.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
@@ -46,6 +52,11 @@ FLAG(bool,
 
 FLAG(uint32, hash_cache_max, 500, "Size of LRU file hash cache");
 
+FLAG(uint32,
+     hash_cache_persist_max,
+     0,
+     "Number of file hashes kept in the database across restarts (0 disables)");
+
 HIDDEN_FLAG(uint32,
             hash_delay,
             20,
@@ -53,39 +64,43 @@ HIDDEN_FLAG(uint32,
 
 namespace tables {
 
-/// Clear this amount of rows every time cache eviction is triggered.
-const size_t kHashCacheEvictSize{5};
+/// Independently locked shards of the file hash cache.
+const size_t kHashCacheShards{8};
+
+/// Files hashed ahead of the cursor for each table worker.
+const size_t kHashFilesPerWorker{2};
+
+/// Trim the persisted hashes after this share of hash_cache_persist_max writes.
+const size_t kHashCachePersistTrimRatio{10};
 
 /**
  * @brief Implements persistent in-memory caching of files' hashes.
  *
- * This cache has LRU eviction policy. The hash is recalculated
- * every time the mtime or size of the file changes.
+ * This cache has CLOCK eviction policy, an approximation of LRU. The hash is
+ * recalculated every time the device, inode, size, mtime or ctime of the file
+ * changes. When
+ * hash_cache_persist_max is set, hashes are also stored in the database keyed
+ * by those attributes, so they survive a restart of the process.
  */
 struct FileHashCache {
   /// The file's modification time, changes with a touch.
   time_t file_mtime;
 
+  /// The file's status change time, changes with any write or chmod.
+  time_t file_ctime;
+
+  /// The device containing the file.
+  dev_t file_device;
+
   /// The file's serial or information number (inode).
   ino_t file_inode;
 
   /// The file's size.
   off_t file_size;
 
-  /// For eviction, the last time this cache item was used.
-  time_t cache_access_time;
-
   /// Cache content, the hashes.
   MultiHashes hashes;
 
-  /// Cache index, the file path.
-  std::string path;
-
-  /// Comparison function for organizing the LRU heap.
-  static bool greater(const FileHashCache* l, const FileHashCache* r) {
-    return l->cache_access_time > r->cache_access_time;
-  }
-
   /**
    * @brief Do-it-all access function.
    *
@@ -119,24 +134,109 @@ static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
     return true;
   }
 
-  if (st.st_size != fh.file_size) {
+  if (st.st_size != fh.file_size || st.st_dev != fh.file_device) {
     // Just in case there's tomfoolery.
     return true;
   }
-  return false;
+
+  // The mtime may be set back after a write, the ctime cannot be.
+  return st.st_ctime != fh.file_ctime;
+}
+
+/// The database key of a file's persisted hashes.
+static std::string persistedHashKey(dev_t device,
+                                    ino_t inode,
+                                    off_t size,
+                                    time_t mtime,
+                                    time_t ctime) {
+  return std::to_string(device) + "." + std::to_string(inode) + "." +
+         std::to_string(size) + "." + std::to_string(mtime) + "." +
+         std::to_string(ctime);
+}
+
+static std::string persistedHashKey(const struct stat& st) {
+  return persistedHashKey(
+      st.st_dev, st.st_ino, st.st_size, st.st_mtime, st.st_ctime);
+}
+
+/// Lookup the hashes persisted for a file with the same attributes.
+static bool loadPersistedHashes(const struct stat& st, MultiHashes& hashes) {
+  std::string value;
+  if (!getDatabaseValue(kHashes, persistedHashKey(st), value).ok() ||
+      value.empty()) {
+    return false;
+  }
+
+  // The write time, then the md5, sha1 and sha256 digests.
+  auto fields = split(value, "\n");
+  if (fields.size() != 4) {
+    return false;
+  }
+
+  hashes.mask = HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256;
+  hashes.md5 = std::move(fields[1]);
+  hashes.sha1 = std::move(fields[2]);
+  hashes.sha256 = std::move(fields[3]);
+  return true;
+}
+
+/// Remove the oldest persisted hashes beyond hash_cache_persist_max.
+static void trimPersistedHashes() {
+  DatabaseStringValueList entries;
+  if (!scanDatabaseValues(kHashes, entries, "").ok() ||
+      entries.size() <= FLAGS_hash_cache_persist_max) {
+    return;
+  }
+
+  std::vector<std::pair<uint64_t, std::string>> written;
+  written.reserve(entries.size());
+  for (auto& entry : entries) {
+    const auto& value = entry.second;
+    auto time = tryTo<uint64_t>(value.substr(0, value.find('\n')));
+    written.emplace_back(time.takeOr(uint64_t{0}), std::move(entry.first));
+  }
+
+  auto excess = written.size() - FLAGS_hash_cache_persist_max;
+  std::nth_element(written.begin(), written.begin() + excess, written.end());
+  for (size_t i = 0; i < excess; ++i) {
+    deleteDatabaseValue(kHashes, written[i].second);
+  }
+}
+
+/// Store the hashes of a file, replacing those of its previous attributes.
+static void persistHashes(const struct stat& st,
+                          const MultiHashes& hashes,
+                          const std::string& previous_key) {
+  if (hashes.md5.empty()) {
+    // Hashing failed, the file will be retried.
+    return;
+  }
+
+  if (!previous_key.empty()) {
+    deleteDatabaseValue(kHashes, previous_key);
+  }
+
+  auto value = std::to_string(time(nullptr)) + "\n" + hashes.md5 + "\n" +
+               hashes.sha1 + "\n" + hashes.sha256;
+  if (!setDatabaseValue(kHashes, persistedHashKey(st), value).ok()) {
+    return;
+  }
+
+  // Trimming scans the domain, amortize it over many writes.
+  static std::atomic<size_t> writes{0};
+  auto trim_interval = std::max<size_t>(
+      1, FLAGS_hash_cache_persist_max / kHashCachePersistTrimRatio);
+  if (++writes % trim_interval == 0) {
+    trimPersistedHashes();
+  }
 }
 
 bool FileHashCache::load(const std::string& path,
                          MultiHashes& out,
                          Logger& logger) {
-  // synchronize the access to cache
-  static Mutex mx;
-  // path => cache entry
-  static std::unordered_map<std::string, FileHashCache> cache;
-  // minheap on cache_access_time
-  static std::vector<FileHashCache*> lru;
-
-  WriteLock guard(mx);
+  // path => cache entry, the shards are locked independently
+  static caches::ShardedClock<std::string, FileHashCache> cache(
+      FLAGS_hash_cache_max, kHashCacheShards);
 
   struct stat st;
   if (stat(path.c_str(), &st) != 0) {
@@ -146,50 +246,43 @@ bool FileHashCache::load(const std::string& path,
     return false;
   }
 
-  auto entry = cache.find(path);
-  if (entry == cache.end()) { // none, load
-    if (cache.size() >= FLAGS_hash_cache_max) {
-      // too large, evict
-      for (size_t i = 0; i < kHashCacheEvictSize; ++i) {
-        if (lru.empty()) {
-          continue;
-        }
-        std::string key = lru[0]->path;
-        std::pop_heap(lru.begin(), lru.end(), FileHashCache::greater);
-        lru.pop_back();
-        if (cache.find(key) != cache.end()) {
-          cache.erase(key);
-        }
-      }
-    }
+  FileHashCache entry;
+  auto cached = cache.get(path, entry);
+  if (cached && !statInvalid(st, entry)) {
+    // ok, got it
+    out = std::move(entry.hashes);
+    return true;
+  }
 
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    FileHashCache rec = {st.st_mtime, // .file_mtime
-                         st.st_ino, // .file_inode
-                         st.st_size, // .file_size
-                         time(nullptr), // .cache_access_time
-                         std::move(hashes), // .hashes
-                         path}; // .path
-    cache[path] = std::move(rec);
-    lru.push_back(&cache[path]);
-    std::push_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = cache[path].hashes;
-  } else if (statInvalid(st, entry->second)) { // changed, update
-    auto hashes = hashMultiFromFile(
+  // A restarted process finds the hashes of files that have not changed.
+  auto persist = FLAGS_hash_cache_persist_max > 0;
+  MultiHashes hashes;
+  if (!persist || !loadPersistedHashes(st, hashes)) {
+    // Hash without holding a lock, files may be hashed by several threads.
+    hashes = hashMultiFromFile(
         HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    entry->second.cache_access_time = time(nullptr);
-    entry->second.file_inode = st.st_ino;
-    entry->second.file_mtime = st.st_mtime;
-    entry->second.file_size = st.st_size;
-    entry->second.hashes = std::move(hashes);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = entry->second.hashes;
-  } else { // ok, got it
-    out = entry->second.hashes;
-    entry->second.cache_access_time = time(nullptr);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
+
+    if (persist) {
+      std::string previous_key;
+      if (cached) {
+        previous_key = persistedHashKey(entry.file_device,
+                                        entry.file_inode,
+                                        entry.file_size,
+                                        entry.file_mtime,
+                                        entry.file_ctime);
+      }
+      persistHashes(st, hashes, previous_key);
+    }
   }
+
+  FileHashCache rec = {st.st_mtime, // .file_mtime
+                       st.st_ctime, // .file_ctime
+                       st.st_dev, // .file_device
+                       st.st_ino, // .file_inode
+                       st.st_size, // .file_size
+                       hashes}; // .hashes
+  cache.insert(path, std::move(rec));
+  out = std::move(hashes);
   return true;
 }
 
@@ -209,15 +302,15 @@ Status genSsdeepForFile(const std::string& path, std::string& ssdeep_hash) {
 #endif
 }
 
-void genHashForFile(const std::string& path,
-                    const std::string& dir,
-                    QueryContext& context,
-                    QueryData& results,
-                    Logger& logger) {
+TableRowHolder genHashRowForFile(const std::string& path,
+                                 const std::string& dir,
+                                 QueryContext& context,
+                                 Logger& logger) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
   auto tr = TableRowHolder(new DynamicTableRow());
   MultiHashes hashes;
+  auto start = std::chrono::steady_clock::now();
   if (!FLAGS_disable_hash_cache) {
     FileHashCache::load(path, hashes, logger);
   } else {
@@ -228,9 +321,13 @@ void genHashForFile(const std::string& path,
     } else {
       hashes = hashMultiFromFile(
           HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
+      if (!ScanThrottleScope::enabled()) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(FLAGS_hash_delay));
+      }
     }
   }
+  throttleScanItem(std::chrono::steady_clock::now() - start);
 
   DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
   r["path"] = path;
@@ -252,28 +349,24 @@ void genHashForFile(const std::string& path,
   }
 
   r["pid_with_namespace"] = "0";
+  return tr;
+}
 
+void genHashForFile(const std::string& path,
+                    const std::string& dir,
+                    QueryContext& context,
+                    QueryData& results,
+                    Logger& logger) {
+  auto tr = genHashRowForFile(path, dir, context, logger);
+  auto& r = *dynamic_cast<DynamicTableRow*>(tr.get());
   results.push_back(static_cast<Row>(r));
 }
 
 void expandFSPathConstraints(QueryContext& context,
                              const std::string& path_column_name,
                              std::set<std::string>& paths) {
-  context.expandConstraints(
-      path_column_name,
-      LIKE,
-      paths,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_ALL | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
-          }
-        }
-        return status;
-      }));
+  context.expandPathConstraints(
+      path_column_name, GLOB_ALL | GLOB_NO_CANON, paths);
 }
 
 QueryData genHashImpl(QueryContext& context, Logger& logger) {
@@ -322,13 +415,127 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
   return results;
 }
 
-QueryData genHash(QueryContext& context) {
+/**
+ * @brief Hash the files named by the path and directory constraints on demand.
+ *
+ * Paths are resolved up front, but files are only read and hashed when the
+ * cursor requests their rows, so a LIMIT stops hashing early. When the hash
+ * cache is enabled a few files are hashed at a time on the table workers.
+ */
+class HashRowIterator : public TableRowIterator {
+ public:
+  explicit HashRowIterator(QueryContext context)
+      : context_(std::move(context)) {
+    paths_ = context_.constraints["path"].getAll(EQUALS);
+    expandFSPathConstraints(context_, "path", paths_);
+    directories_ = context_.constraints["directory"].getAll(EQUALS);
+    expandFSPathConstraints(context_, "directory", directories_);
+
+    path_ = paths_.begin();
+    directory_ = directories_.begin();
+
+    // The in-query cache used without the hash cache is not thread safe.
+    if (!FLAGS_disable_hash_cache) {
+      window_ = getTableWorkerCount() * kHashFilesPerWorker;
+    }
+  }
+
+  bool next(TableRowHolder& row) override {
+    if (ready_ == rows_.size()) {
+      rows_.clear();
+      ready_ = 0;
+
+      std::vector<std::pair<std::string, std::string>> files;
+      std::string path;
+      std::string dir;
+      while (files.size() < window_ && nextFile(path, dir)) {
+        files.emplace_back(std::move(path), std::move(dir));
+      }
+
+      if (files.size() == 1) {
+        rows_.push_back(genHashRowForFile(
+            files[0].first, files[0].second, context_, logger_));
+      } else {
+        rows_ = generateRowsParallel(
+            files, [this](const auto& file, TableRows& rows) {
+              rows.push_back(genHashRowForFile(
+                  file.first, file.second, context_, logger_));
+            });
+      }
+
+      if (rows_.empty()) {
+        return false;
+      }
+    }
+
+    row = std::move(rows_[ready_++]);
+    return true;
+  }
+
+ private:
+  /// Find the next regular file named by the constraints.
+  bool nextFile(std::string& file_path, std::string& dir) {
+    boost::system::error_code ec;
+    while (path_ != paths_.end()) {
+      const auto& path_string = *path_++;
+      boost::filesystem::path path = path_string;
+      if (boost::filesystem::is_regular_file(path, ec)) {
+        file_path = path_string;
+        dir = path.parent_path().string();
+        return true;
+      }
+    }
+
+    while (true) {
+      for (; file_ != boost::filesystem::directory_iterator(); ++file_) {
+        if (boost::filesystem::is_regular_file(file_->path(), ec)) {
+          file_path = file_->path().string();
+          dir = directory_string_;
+          ++file_;
+          return true;
+        }
+      }
+
+      // Move on to the next directory with files to hash.
+      if (directory_ == directories_.end()) {
+        return false;
+      }
+
+      directory_string_ = *directory_++;
+      if (boost::filesystem::is_directory(directory_string_, ec)) {
+        file_ = boost::filesystem::directory_iterator(directory_string_, ec);
+      }
+    }
+  }
+
+ private:
+  QueryContext context_;
+  GLOGLogger logger_;
+
+  std::set<std::string> paths_;
+  std::set<std::string>::const_iterator path_;
+
+  std::set<std::string> directories_;
+  std::set<std::string>::const_iterator directory_;
+
+  /// The directory currently being iterated, and its next entry.
+  std::string directory_string_;
+  boost::filesystem::directory_iterator file_;
+
+  /// The number of files hashed together, beyond a LIMIT this is wasted work.
+  size_t window_{1};
+
+  /// Rows hashed ahead of the cursor, and the next one to return.
+  TableRows rows_;
+  size_t ready_{0};
+};
+
+TableRowIteratorRef genHash(QueryContext context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "hash", genHashImpl);
-  } else {
-    GLOGLogger logger;
-    return genHashImpl(context, logger);
+    return makeTableRowIterator(tableRowsFromQueryData(
+        generateInNamespace(context, "hash", genHashImpl)));
   }
+  return std::make_unique<HashRowIterator>(std::move(context));
 }
 } // namespace tables
 } // namespace osquery
@@ -16,6 +16,7 @@
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
+#include <osquery/events/linux/udev_device_cache.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 
@@ -62,14 +63,12 @@ void populatePVChildren(lvm_t lvm,
   lvm_vg_close(vg);
 }
 
-static void getBlockDevice(struct udev_device* dev,
-                           QueryData& results,
-                           std::map<std::string, std::string>& lvm_lv2pv) {
-  Row r;
+/// Read the udev columns of a block device, false if it has no devnode.
+static bool getBlockDeviceAttrs(struct udev_device* dev, Row& r) {
   const char *name = udev_device_get_devnode(dev);
   if (name == nullptr) {
     // Cannot get devnode information from UDEV.
-    return;
+    return false;
   }
 
   // The device name may be blank but will have a string value.
@@ -79,8 +78,6 @@ static void getBlockDevice(struct udev_device* dev,
       udev_device_get_parent_with_subsystem_devtype(dev, "block", nullptr);
   if (subdev != nullptr) {
     r["parent"] = udev_device_get_devnode(subdev);
-  } else if (lvm_lv2pv.count(name)) {
-    r["parent"] = lvm_lv2pv[name];
   }
 
   const char *size = udev_device_get_sysattr_value(dev, "size");
@@ -106,8 +103,18 @@ static void getBlockDevice(struct udev_device* dev,
     boost::algorithm::trim(model_string);
     r["vendor"] = model_string;
   }
+  return true;
+}
+
+/// Probe the block device's superblock, LVM children are added to lvm_lv2pv.
+static void probeBlockDevice(Row& r,
+                             std::map<std::string, std::string>& lvm_lv2pv) {
+  const auto& name = r["name"];
+  if (r.count("parent") == 0 && lvm_lv2pv.count(name)) {
+    r["parent"] = lvm_lv2pv[name];
+  }
 
-  blkid_probe pr = blkid_new_probe_from_filename(name);
+  blkid_probe pr = blkid_new_probe_from_filename(name.c_str());
   if (pr != nullptr) {
     blkid_probe_enable_superblocks(pr, 1);
     blkid_probe_set_superblocks_flags(
@@ -134,8 +141,6 @@ static void getBlockDevice(struct udev_device* dev,
     }
     blkid_free_probe(pr);
   }
-
-  results.push_back(r);
 }
 
 QueryData genBlockDevs(QueryContext &context) {
@@ -145,30 +150,26 @@ QueryData genBlockDevs(QueryContext &context) {
 
   QueryData results;
 
-  struct udev *udev = udev_new();
-  if (udev == nullptr) {
+  // Only udev is read within the walk, the shared snapshot is not held while
+  // the devices are probed.
+  auto status = UdevDeviceCache::get().walk(
+      "block", [&results](struct udev_device* dev) {
+        Row r;
+        if (getBlockDeviceAttrs(dev, r)) {
+          results.push_back(std::move(r));
+        }
+        return false;
+      });
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage();
     return {};
   }
 
-  struct udev_enumerate *enumerate = udev_enumerate_new(udev);
-  udev_enumerate_add_match_subsystem(enumerate, "block");
-  udev_enumerate_scan_devices(enumerate);
-
   std::map<std::string, std::string> lvm_lv2pv;
-  struct udev_list_entry *devices, *dev_list_entry;
-  devices = udev_enumerate_get_list_entry(enumerate);
-  udev_list_entry_foreach(dev_list_entry, devices) {
-    const char *path = udev_list_entry_get_name(dev_list_entry);
-    struct udev_device *dev = udev_device_new_from_syspath(udev, path);
-    if (path != nullptr && dev != nullptr) {
-      getBlockDevice(dev, results, lvm_lv2pv);
-    }
-    udev_device_unref(dev);
+  for (auto& r : results) {
+    probeBlockDevice(r, lvm_lv2pv);
   }
 
-  udev_enumerate_unref(enumerate);
-  udev_unref(udev);
-
   return results;
 }
 }
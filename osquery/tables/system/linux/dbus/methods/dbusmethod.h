@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/linux/dbus/uniquedbusconnection.h>
 #include <osquery/tables/system/linux/dbus/uniquedbusmessage.h>
@@ -30,17 +34,11 @@ class DbusMethod final : public MethodHandler {
     output = {};
 
     UniqueDbusMessage message;
-    auto status = UniqueDbusMessage::create(message,
-                                            MethodHandler::kDestination,
-                                            object_path,
-                                            MethodHandler::kInterface,
-                                            MethodHandler::kMethod);
+    auto status = createMessage(message, object_path, args...);
     if (!status.ok()) {
       return status;
     }
 
-    processParameterList(message, args...);
-
     UniqueDbusMessage reply;
     status = sendMessage(connection, reply, message);
     if (!status.ok()) {
@@ -50,6 +48,65 @@ class DbusMethod final : public MethodHandler {
     return parseReply(output, reply);
   }
 
+  /**
+   * @brief Call the method on many objects with the same arguments.
+   *
+   * The calls are pipelined: up to kMaxPendingCalls requests are sent before
+   * waiting for their replies, instead of one round trip per object.
+   *
+   * @param outputs set to the output of each call, in object order.
+   * @param statuses set to the status of each call, in object order.
+   */
+  void callBatch(std::vector<Output>& outputs,
+                 std::vector<Status>& statuses,
+                 const UniqueDbusConnection& connection,
+                 const std::vector<std::string>& object_paths,
+                 ArgumentList... args) const {
+    outputs.assign(object_paths.size(), Output{});
+    statuses.assign(object_paths.size(), Status::success());
+
+    std::vector<DBusPendingCall*> pending_calls;
+    for (std::size_t begin{0U}; begin < object_paths.size();
+         begin += kMaxPendingCalls) {
+      auto end = std::min(begin + kMaxPendingCalls, object_paths.size());
+      pending_calls.assign(end - begin, nullptr);
+
+      for (auto i = begin; i < end; ++i) {
+        UniqueDbusMessage message;
+        statuses[i] = createMessage(message, object_paths[i], args...);
+        if (!statuses[i].ok()) {
+          continue;
+        }
+
+        if (!dbus_connection_send_with_reply(connection.get(),
+                                             message.get(),
+                                             &pending_calls[i - begin],
+                                             -1) ||
+            pending_calls[i - begin] == nullptr) {
+          statuses[i] = Status::failure("Failed to send the dbus request");
+        }
+      }
+
+      for (auto i = begin; i < end; ++i) {
+        auto pending_call = pending_calls[i - begin];
+        if (pending_call == nullptr) {
+          continue;
+        }
+
+        dbus_pending_call_block(pending_call);
+
+        UniqueDbusMessage reply;
+        reply.reset(dbus_pending_call_steal_reply(pending_call));
+        dbus_pending_call_unref(pending_call);
+
+        statuses[i] = checkReply(reply);
+        if (statuses[i].ok()) {
+          statuses[i] = parseReply(outputs[i], reply);
+        }
+      }
+    }
+  }
+
   DbusMethod() = default;
   virtual ~DbusMethod() override = default;
 
@@ -57,6 +114,42 @@ class DbusMethod final : public MethodHandler {
   DbusMethod& operator=(const DbusMethod&) = delete;
 
  private:
+  /// The bus daemon limits the replies a connection may await at once.
+  static constexpr std::size_t kMaxPendingCalls{64U};
+
+  Status createMessage(UniqueDbusMessage& message,
+                       const std::string& object_path,
+                       ArgumentList... args) const {
+    auto status = UniqueDbusMessage::create(message,
+                                            MethodHandler::kDestination,
+                                            object_path,
+                                            MethodHandler::kInterface,
+                                            MethodHandler::kMethod);
+    if (!status.ok()) {
+      return status;
+    }
+
+    return processParameterList(message, args...);
+  }
+
+  Status checkReply(const UniqueDbusMessage& reply) const {
+    if (!reply) {
+      return Status::failure("Failed to receive the dbus reply");
+    }
+
+    DBusError error DBUS_ERROR_INIT;
+    if (dbus_set_error_from_message(&error, reply.get())) {
+      std::stringstream message;
+      message << "Failed to call the dbus method: " << error.message << " ("
+              << error.name << ")";
+
+      dbus_error_free(&error);
+      return Status::failure(message.str());
+    }
+
+    return Status::success();
+  }
+
   Status sendMessage(const UniqueDbusConnection& connection,
                      UniqueDbusMessage& reply,
                      const UniqueDbusMessage& message) const {
@@ -101,6 +194,37 @@ class DbusMethod final : public MethodHandler {
     return true;
   }
 
+  bool processParameter(Status& status,
+                        DBusMessageIter& message_it,
+                        const std::vector<std::string>& param) const {
+    DBusMessageIter array_it{};
+    if (!dbus_message_iter_open_container(&message_it,
+                                          DBUS_TYPE_ARRAY,
+                                          DBUS_TYPE_STRING_AS_STRING,
+                                          &array_it)) {
+      status = Status::failure("Failed to open the array parameter");
+      return false;
+    }
+
+    for (const auto& element : param) {
+      auto string_ptr = element.c_str();
+      if (!dbus_message_iter_append_basic(
+              &array_it, DBUS_TYPE_STRING, &string_ptr)) {
+        dbus_message_iter_abandon_container(&message_it, &array_it);
+        status = Status::failure("Failed to append the array parameter");
+        return false;
+      }
+    }
+
+    if (!dbus_message_iter_close_container(&message_it, &array_it)) {
+      status = Status::failure("Failed to close the array parameter");
+      return false;
+    }
+
+    status = Status::success();
+    return true;
+  }
+
   template <class... ParameterList>
   Status processParameterList(UniqueDbusMessage& message,
                               ParameterList const&... parameter_list) const {
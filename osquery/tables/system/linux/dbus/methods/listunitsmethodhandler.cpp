@@ -13,8 +13,9 @@ namespace osquery {
 
 namespace {
 
-// Make sure we have an upper limit so we don't risk infinite loops
-const std::size_t kMaxSystemdUnitCount{1000U};
+// Make sure we have an upper limit so we don't risk infinite loops, hosts
+// running many containers have thousands of scope units
+const std::size_t kMaxSystemdUnitCount{100000U};
 
 } // namespace
 
@@ -34,6 +35,10 @@ Status ListUnitsMethodHandler::parseReply(
 
   DBusMessageIter array_it{};
   dbus_message_iter_recurse(&message_it, &array_it);
+  if (dbus_message_iter_get_arg_type(&array_it) == DBUS_TYPE_INVALID) {
+    // No unit matched
+    return Status::success();
+  }
 
   for (std::size_t i{0U}; i < kMaxSystemdUnitCount; ++i) {
     Unit unit = {};
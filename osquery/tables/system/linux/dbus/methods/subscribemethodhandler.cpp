@@ -0,0 +1,20 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/tables/system/linux/dbus/methods/subscribemethodhandler.h>
+
+namespace osquery {
+
+Status SubscribeMethodHandler::parseReply(
+    Output& output, const UniqueDbusMessage& reply) const {
+  output = {};
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/tables/system/linux/dbus/methods/dbusmethod.h>
+#include <osquery/utils/status/status.h>
+
+#include <dbus/dbus.h>
+
+namespace osquery {
+
+/// Asks systemd to send its manager and unit signals to this connection.
+class SubscribeMethodHandler {
+ public:
+  constexpr static auto kDestination{"org.freedesktop.systemd1"};
+  constexpr static auto kInterface{"org.freedesktop.systemd1.Manager"};
+  constexpr static auto kMethod{"Subscribe"};
+
+  struct Output final {};
+  Status parseReply(Output& output, const UniqueDbusMessage& reply) const;
+
+ protected:
+  SubscribeMethodHandler() = default;
+  virtual ~SubscribeMethodHandler() = default;
+};
+
+using SubscribeMethod = DbusMethod<SubscribeMethodHandler>;
+
+} // namespace osquery
@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <osquery/logger/logger.h>
+#include <osquery/tables/system/linux/dbus/methods/getstringproperty.h>
+#include <osquery/tables/system/linux/dbus/methods/subscribemethodhandler.h>
+#include <osquery/tables/system/linux/dbus/systemdunitlist.h>
+#include <osquery/tables/system/linux/dbus/uniquedbusmessage.h>
+
+namespace osquery {
+
+namespace {
+
+const std::string kSystemdObjectPath{"/org/freedesktop/systemd1"};
+const std::string kManagerInterface{"org.freedesktop.systemd1.Manager"};
+const std::string kUnitInterface{"org.freedesktop.systemd1.Unit"};
+const std::string kServiceInterface{"org.freedesktop.systemd1.Service"};
+
+// The unit file properties only change after these manager signals
+const std::vector<std::string> kReloadSignalList = {"Reloading",
+                                                    "UnitFilesChanged"};
+
+bool isUnitPattern(const std::string& id) {
+  return id.find_first_of("*?[\\") != std::string::npos;
+}
+
+} // namespace
+
+SystemdUnitList& SystemdUnitList::get() {
+  static SystemdUnitList list;
+  return list;
+}
+
+Status SystemdUnitList::connect() {
+  if (connection_ && dbus_connection_get_is_connected(connection_.get())) {
+    return Status::success();
+  }
+
+  unit_files_.clear();
+  subscribed_ = false;
+
+  auto status = UniqueDbusConnection::create(connection_, true);
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (const auto& signal : kReloadSignalList) {
+    auto rule = "type='signal',sender='org.freedesktop.systemd1',interface='" +
+                kManagerInterface + "',member='" + signal + "'";
+
+    DBusError error DBUS_ERROR_INIT;
+    dbus_bus_add_match(connection_.get(), rule.c_str(), &error);
+    if (dbus_error_is_set(&error)) {
+      VLOG(1) << "Failed to watch the systemd " << signal
+              << " signal, unit files are not cached: " << error.message;
+
+      dbus_error_free(&error);
+      return Status::success();
+    }
+  }
+
+  // systemd only sends its signals once a client has subscribed
+  SubscribeMethod subscribe_method;
+  SubscribeMethod::Output output;
+  status = subscribe_method.call(output, connection_, kSystemdObjectPath);
+  if (!status.ok()) {
+    VLOG(1) << "Failed to subscribe to the systemd signals, unit files are "
+               "not cached: "
+            << status.getMessage();
+    return Status::success();
+  }
+
+  subscribed_ = true;
+  return Status::success();
+}
+
+void SystemdUnitList::processSignals() {
+  // Read the signals received since the last query without blocking
+  dbus_connection_read_write(connection_.get(), 0);
+
+  for (;;) {
+    UniqueDbusMessage message;
+    message.reset(dbus_connection_pop_message(connection_.get()));
+    if (!message) {
+      break;
+    }
+
+    for (const auto& signal : kReloadSignalList) {
+      if (dbus_message_is_signal(
+              message.get(), kManagerInterface.c_str(), signal.c_str())) {
+        unit_files_.clear();
+      }
+    }
+  }
+}
+
+Status SystemdUnitList::listUnits(ListUnitsMethod::Output& units,
+                                  const std::set<std::string>& ids) {
+  if (!ids.empty() && std::none_of(ids.begin(), ids.end(), isUnitPattern)) {
+    ListUnitsByPatternsMethod list_units_method;
+    auto status = list_units_method.call(units,
+                                         connection_,
+                                         kSystemdObjectPath,
+                                         {},
+                                         {ids.begin(), ids.end()});
+    if (status.ok()) {
+      return status;
+    }
+
+    // ListUnitsByPatterns was added in systemd 230
+    VLOG(1) << "Failed to list the systemd units by name: "
+            << status.getMessage();
+  }
+
+  ListUnitsMethod list_units_method;
+  auto status =
+      list_units_method.call(units, connection_, kSystemdObjectPath);
+  if (!status.ok() || ids.empty()) {
+    return status;
+  }
+
+  auto is_filtered = [&ids](const ListUnitsMethodHandler::Unit& unit) {
+    return ids.count(unit.id) == 0;
+  };
+  units.erase(std::remove_if(units.begin(), units.end(), is_filtered),
+              units.end());
+
+  return Status::success();
+}
+
+void SystemdUnitList::fetchUnitFiles(const ListUnitsMethod::Output& units,
+                                     std::map<std::string, UnitFile>& fetched) {
+  std::vector<std::string> unit_paths;
+  std::vector<std::string> service_paths;
+  for (const auto& unit : units) {
+    if (unit_files_.count(unit.path) > 0) {
+      continue;
+    }
+
+    unit_paths.push_back(unit.path);
+    if (boost::algorithm::ends_with(unit.id, ".service")) {
+      service_paths.push_back(unit.path);
+    }
+  }
+
+  if (unit_paths.empty()) {
+    return;
+  }
+
+  GetStringPropertyMethod get_string_property_method;
+
+  std::vector<std::string> fragment_paths;
+  std::vector<Status> fragment_statuses;
+  get_string_property_method.callBatch(fragment_paths,
+                                       fragment_statuses,
+                                       connection_,
+                                       unit_paths,
+                                       kUnitInterface,
+                                       "FragmentPath");
+
+  std::vector<std::string> source_paths;
+  std::vector<Status> source_statuses;
+  get_string_property_method.callBatch(source_paths,
+                                       source_statuses,
+                                       connection_,
+                                       unit_paths,
+                                       kUnitInterface,
+                                       "SourcePath");
+
+  std::vector<std::string> users;
+  std::vector<Status> user_statuses;
+  get_string_property_method.callBatch(users,
+                                       user_statuses,
+                                       connection_,
+                                       service_paths,
+                                       kServiceInterface,
+                                       "User");
+
+  std::set<std::string> failed_paths;
+  for (std::size_t i{0U}; i < unit_paths.size(); ++i) {
+    auto& unit_file = fetched[unit_paths[i]];
+    unit_file.fragment_path = std::move(fragment_paths[i]);
+    unit_file.source_path = std::move(source_paths[i]);
+
+    if (!fragment_statuses[i].ok()) {
+      LOG(ERROR) << "Failed to query the property FragmentPath on the "
+                    "following systemd unit: "
+                 << unit_paths[i];
+      failed_paths.insert(unit_paths[i]);
+    }
+
+    if (!source_statuses[i].ok()) {
+      LOG(ERROR) << "Failed to query the property SourcePath on the "
+                    "following systemd unit: "
+                 << unit_paths[i];
+      failed_paths.insert(unit_paths[i]);
+    }
+  }
+
+  for (std::size_t i{0U}; i < service_paths.size(); ++i) {
+    fetched[service_paths[i]].user = std::move(users[i]);
+    if (!user_statuses[i].ok()) {
+      failed_paths.insert(service_paths[i]);
+    }
+  }
+
+  if (!subscribed_) {
+    return;
+  }
+
+  for (const auto& unit_file : fetched) {
+    if (failed_paths.count(unit_file.first) == 0) {
+      unit_files_.insert(unit_file);
+    }
+  }
+}
+
+Status SystemdUnitList::list(std::vector<SystemdUnit>& units,
+                             const std::set<std::string>& ids) {
+  units.clear();
+
+  WriteLock lock(mutex_);
+  auto status = connect();
+  if (!status.ok()) {
+    return status;
+  }
+
+  processSignals();
+
+  ListUnitsMethod::Output unit_list;
+  status = listUnits(unit_list, ids);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::map<std::string, UnitFile> fetched;
+  fetchUnitFiles(unit_list, fetched);
+
+  if (ids.empty()) {
+    // Forget the units that are no longer loaded
+    std::set<std::string> unit_paths;
+    for (const auto& unit : unit_list) {
+      unit_paths.insert(unit.path);
+    }
+
+    for (auto it = unit_files_.begin(); it != unit_files_.end();) {
+      if (unit_paths.count(it->first) == 0) {
+        it = unit_files_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  for (auto& unit : unit_list) {
+    SystemdUnit entry;
+
+    auto it = fetched.find(unit.path);
+    if (it == fetched.end()) {
+      it = unit_files_.find(unit.path);
+    }
+
+    entry.fragment_path = it->second.fragment_path;
+    entry.source_path = it->second.source_path;
+    entry.user = it->second.user;
+    entry.unit = std::move(unit);
+    units.push_back(std::move(entry));
+  }
+
+  return Status::success();
+}
+
+} // namespace osquery
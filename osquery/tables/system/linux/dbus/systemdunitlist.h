@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/tables/system/linux/dbus/methods/listunitsmethodhandler.h>
+#include <osquery/tables/system/linux/dbus/uniquedbusconnection.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A loaded systemd unit and the properties of its unit file.
+struct SystemdUnit final {
+  ListUnitsMethodHandler::Unit unit;
+  std::string fragment_path;
+  std::string source_path;
+
+  /// The configured user of a service unit.
+  std::string user;
+};
+
+/**
+ * @brief Lists the systemd units over a persistent system bus connection.
+ *
+ * The unit file properties are fetched with pipelined calls and cached per
+ * unit until systemd reports a reload or a change of the unit files, so
+ * repeated queries only list the units and their states.
+ */
+class SystemdUnitList final : private boost::noncopyable {
+ public:
+  /// The list shared by the systemd tables.
+  static SystemdUnitList& get();
+
+  /**
+   * @brief List the loaded units.
+   *
+   * @param units set to the units.
+   * @param ids list only the units with these names, all units if empty.
+   */
+  Status list(std::vector<SystemdUnit>& units,
+              const std::set<std::string>& ids = {});
+
+ private:
+  struct UnitFile final {
+    std::string fragment_path;
+    std::string source_path;
+    std::string user;
+  };
+
+  /// Connect to the system bus and subscribe to the reload signals.
+  Status connect();
+
+  /// Process the received signals, forgetting the unit files on reloads.
+  void processSignals();
+
+  /// List the units by name patterns if possible, or all of them.
+  Status listUnits(ListUnitsMethod::Output& units,
+                   const std::set<std::string>& ids);
+
+  /// Fetch the unit file properties of the units not cached.
+  void fetchUnitFiles(const ListUnitsMethod::Output& units,
+                      std::map<std::string, UnitFile>& fetched);
+
+ private:
+  Mutex mutex_;
+  UniqueDbusConnection connection_;
+
+  /// Unit files are only cached while systemd sends the reload signals.
+  bool subscribed_{false};
+
+  /// Unit object path => unit file properties.
+  std::map<std::string, UnitFile> unit_files_;
+};
+
+} // namespace osquery
@@ -16,6 +16,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/linux/package_inventory.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -31,6 +32,13 @@ namespace tables {
 
 static const std::string kDPKGPath{"/var/lib/dpkg"};
 
+/// dpkg replaces the status file, and journals to updates/ until it does.
+static const std::vector<std::string> kDPKGDatabasePaths{
+    kDPKGPath + "/status", kDPKGPath + "/updates"};
+
+/// The host's packages, read again only when the dpkg database changes.
+static PackageInventoryCache debPackagesCache;
+
 /// A comparator used to sort the packages array.
 int pkg_sorter(const void* a, const void* b) {
   const struct pkginfo* pa = *(const struct pkginfo**)a;
@@ -204,8 +212,17 @@ QueryData genDebPackages(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "deb_packages", genDebPackagesImpl);
   } else {
+    auto fingerprint = getPackageDatabaseFingerprint(kDPKGDatabasePaths);
+
+    QueryData results;
+    if (debPackagesCache.get(fingerprint, results)) {
+      return results;
+    }
+
     GLOGLogger logger;
-    return genDebPackagesImpl(context, logger);
+    results = genDebPackagesImpl(context, logger);
+    debPackagesCache.set(fingerprint, results);
+    return results;
   }
 }
 } // namespace tables
@@ -9,14 +9,20 @@
 
 #include <elf.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <libelfin/elf/elf++.hh>
 
+#include <list>
+#include <stdexcept>
 #include <unordered_map>
 
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 namespace tables {
@@ -27,6 +33,105 @@ const std::unordered_map<elf::ElfTypes::Word, std::string> kGNUTypes{
     {0x6474E552, "GNU_RELRO"},
 };
 
+/// The number of parsed ELF files a query keeps mapped.
+const size_t kElfFileCacheSize{64};
+
+namespace {
+
+/**
+ * @brief A read-only mapping of an ELF file.
+ *
+ * Section data, symbol tables and string tables are read in place from the
+ * mapping, nothing is copied.
+ */
+class ElfFileMapping final : public elf::loader {
+ public:
+  ElfFileMapping(void* base, size_t size) : base_(base), size_(size) {}
+
+  ~ElfFileMapping() override {
+    ::munmap(base_, size_);
+  }
+
+  const void* load(off_t offset, size_t size) override {
+    if (offset < 0 || static_cast<size_t>(offset) > size_ ||
+        size > size_ - static_cast<size_t>(offset)) {
+      throw std::range_error("offset exceeds file size");
+    }
+    return static_cast<const char*>(base_) + offset;
+  }
+
+ private:
+  void* base_{nullptr};
+  size_t size_{0};
+};
+
+/// Map a regular file, without blocking on special files.
+std::shared_ptr<ElfFileMapping> mapElfFile(const std::string& path) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::make_shared<ElfFileMapping>(base, st.st_size);
+}
+
+/**
+ * @brief The ELF files most recently parsed by the ELF tables of a query.
+ *
+ * Joins across elf_info, elf_sections, elf_segments, elf_symbols and
+ * elf_dynamic read the same files from each table. The file header, section
+ * and segment tables are parsed once, and the file stays mapped, while it is
+ * among the recently used files of the query.
+ */
+class ElfFileCache final {
+ public:
+  /// Get a parsed file, an invalid elf if it is not an ELF file.
+  elf::elf get(const std::string& path) {
+    WriteLock lock(mutex_);
+    for (auto it = files_.begin(); it != files_.end(); ++it) {
+      if (it->first == path) {
+        files_.splice(files_.begin(), files_, it);
+        return files_.front().second;
+      }
+    }
+
+    elf::elf file;
+    auto mapping = mapElfFile(path);
+    if (mapping != nullptr) {
+      try {
+        file = elf::elf(mapping);
+      } catch (const std::exception& e) {
+        VLOG(1) << "Could not read ELF header: " << path;
+      }
+    }
+
+    files_.emplace_front(path, file);
+    if (files_.size() > kElfFileCacheSize) {
+      files_.pop_back();
+    }
+    return file;
+  }
+
+ private:
+  Mutex mutex_;
+
+  /// Parsed files, most recently used first.
+  std::list<std::pair<std::string, elf::elf>> files_;
+};
+
+} // namespace
+
 void genElfInfo(
     QueryContext& ctx,
     std::function<void(const elf::elf&, const std::string&)> predicate) {
@@ -48,16 +153,17 @@ void genElfInfo(
         return status;
       }));
 
+  auto cache = ctx.getQueryScope()->get<ElfFileCache>("elf");
   for (const auto& path : paths) {
-    auto fd = open(path.c_str(), O_RDONLY);
-    if (fd >= 0) {
-      try {
-        elf::elf f(elf::create_mmap_loader(fd));
-        predicate(f, path);
-      } catch (const std::exception& e) {
-        VLOG(1) << "Could not read ELF header: " << path;
-      }
-      close(fd);
+    auto f = cache->get(path);
+    if (!f.valid()) {
+      continue;
+    }
+
+    try {
+      predicate(f, path);
+    } catch (const std::exception& e) {
+      VLOG(1) << "Could not read ELF file: " << path;
     }
   }
 }
@@ -9,54 +9,43 @@
 
 #include <set>
 
-#include <grp.h>
-
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
-#include <osquery/utils/mutex.h>
+#include <osquery/tables/system/posix/accounts.h>
 
 namespace osquery {
 namespace tables {
 
-Mutex grpEnumerationMutex;
-
-void setGroupRow(Row& r, const group* grp) {
-  r["groupname"] = TEXT(grp->gr_name);
-  r["gid"] = INTEGER(grp->gr_gid);
-  r["gid_signed"] = INTEGER((int32_t)grp->gr_gid);
+void setGroupRow(Row& r, const GroupEntry& group) {
+  r["groupname"] = TEXT(group.name);
+  r["gid"] = INTEGER(group.gid);
+  r["gid_signed"] = INTEGER((int32_t)group.gid);
 }
 
 QueryData genGroups(QueryContext& context) {
   QueryData results;
-  struct group* grp = nullptr;
 
   if (context.constraints["gid"].exists(EQUALS)) {
     auto gids = context.constraints["gid"].getAll<long long>(EQUALS);
     for (const auto& gid : gids) {
-      grp = getgrgid(gid);
-      if (grp == nullptr) {
+      auto group = getGroupByGid(gid);
+      if (!group) {
         continue;
       }
 
       Row r;
-      setGroupRow(r, grp);
+      setGroupRow(r, *group);
       results.push_back(r);
     }
   } else {
-    std::set<long> groups_in;
-    WriteLock lock(grpEnumerationMutex);
-    setgrent();
-    while ((grp = getgrent()) != nullptr) {
-      if (std::find(groups_in.begin(), groups_in.end(), grp->gr_gid) ==
-          groups_in.end()) {
+    std::set<gid_t> groups_in;
+    for (const auto& group : *getGroupEntries()) {
+      if (groups_in.insert(group.gid).second) {
         Row r;
-        setGroupRow(r, grp);
+        setGroupRow(r, group);
         results.push_back(r);
-        groups_in.insert(grp->gr_gid);
       }
     }
-    endgrent();
-    groups_in.clear();
   }
 
   return results;
@@ -25,6 +25,7 @@
 #include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/events/linux/udev.h>
+#include <osquery/events/linux/udev_device_cache.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/linux/md_tables.h>
@@ -80,40 +81,10 @@ static inline void getLines(std::vector<std::string>& lines) {
  */
 void walkUdevDevices(const std::string& systemName,
                      std::function<bool(udev_device* const&)> f) {
-  auto delUdev = [](udev* u) { udev_unref(u); };
-  std::unique_ptr<udev, decltype(delUdev)> handle(udev_new(), delUdev);
-  if (handle.get() == nullptr) {
-    LOG(ERROR) << "Could not get udev handle";
-    return;
-  }
-
-  auto delUdevEnum = [](udev_enumerate* e) { udev_enumerate_unref(e); };
-  std::unique_ptr<udev_enumerate, decltype(delUdevEnum)> udevEnum(
-      udev_enumerate_new(handle.get()), delUdevEnum);
-  if (udevEnum.get() == nullptr) {
-    LOG(ERROR) << "Could not get enumerate handle";
-    return;
-  }
-
-  udev_enumerate_add_match_subsystem(udevEnum.get(), systemName.c_str());
-  udev_enumerate_scan_devices(udevEnum.get());
-  udev_list_entry* device_entries =
-      udev_enumerate_get_list_entry(udevEnum.get());
-
-  udev_list_entry* entry;
-  udev_list_entry_foreach(entry, device_entries) {
-    const char* path = udev_list_entry_get_name(entry);
-
-    auto delUdevDevice = [](udev_device* d) { udev_device_unref(d); };
-    std::unique_ptr<udev_device, decltype(delUdevDevice)> device(
-        udev_device_new_from_syspath(handle.get(), path), delUdevDevice);
-    if (device.get() == nullptr) {
-      LOG(ERROR) << "Could not get udev device handle";
-      continue;
-    }
-    if (f(device.get()) == true) {
-      break;
-    }
+  auto status = UdevDeviceCache::get().walk(
+      systemName, [&f](udev_device* device) { return f(device); });
+  if (!status.ok()) {
+    LOG(ERROR) << status.getMessage();
   }
 }
 
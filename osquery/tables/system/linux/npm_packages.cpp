@@ -11,9 +11,11 @@
 
 #include <boost/filesystem.hpp>
 
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_manifests.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
@@ -21,81 +23,94 @@
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+DECLARE_uint32(package_manifest_cache_max);
+
 namespace tables {
 
 const std::vector<std::string> kPackageKeys{"name", "version", "description"};
 
 const std::string kLinuxNodeModulesPath{"/usr/lib/"};
 
-void genPackageResults(const std::string& directory,
-                       QueryData& results,
-                       Logger& logger) {
-  std::vector<std::string> packages;
-  resolveFilePattern(directory + "/node_modules/%/package.json", packages);
+Status genPackageManifest(const std::string& package_path, Row& r) {
+  std::string json;
+  if (!readFile(package_path, json).ok()) {
+    return Status::failure("Could not read package JSON: " + package_path);
+  }
 
-  for (const auto& package_path : packages) {
-    std::string json;
-    if (!readFile(package_path, json).ok()) {
-      logger.log(google::GLOG_WARNING,
-                 "Could not read package JSON: " + package_path);
-      continue;
-    }
+  auto doc = JSON::newObject();
+  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+    return Status::failure("Could not parse JSON from: " + package_path);
+  }
 
-    auto doc = JSON::newObject();
-    if (!doc.fromString(json) || !doc.doc().IsObject()) {
-      logger.log(google::GLOG_WARNING,
-                 "Could not parse JSON from: " + package_path);
-      continue;
+  for (const auto& key : kPackageKeys) {
+    if (doc.doc().HasMember(key)) {
+      const auto& value = doc.doc()[key];
+      // npm has a schema for package.json, but it is loosely enforced. Some
+      // keys may be missing, so populate the columns we can
+      r[key] = (value.IsString()) ? value.GetString() : "";
     }
+  }
 
-    Row r;
-    for (const auto& key : kPackageKeys) {
-      if (doc.doc().HasMember(key)) {
-        const auto& value = doc.doc()[key];
-        // npm has a schema for package.json, but it is loosely enforced. Some
-        // keys may be missing, so populate the columns we can
-        r[key] = (value.IsString()) ? value.GetString() : "";
+  // Manually get nested key (Author name)
+  if (doc.doc().HasMember("author")) {
+    const auto& author = doc.doc()["author"];
+    if (author.IsString()) {
+      r["author"] = author.GetString();
+    } else if (author.IsObject()) {
+      if (author.HasMember("name")) {
+        const auto& author_name = author["name"];
+        r["author"] = (author_name.IsString()) ? author_name.GetString() : "";
       }
     }
+  }
 
-    // Manually get nested key (Author name)
-    if (doc.doc().HasMember("author")) {
-      const auto& author = doc.doc()["author"];
-      if (author.IsString()) {
-          r["author"] = author.GetString();
-      } else if (author.IsObject()) {
-        if (author.HasMember("name")) {
-          const auto& author_name = author["name"];
-          r["author"] = (author_name.IsString()) ? author_name.GetString() : "";
+  // Manually get license to support deprecated licence schema.
+  // In the current schema it is a string, but in previous versions it is a
+  // dictionary with url and type
+  if (doc.doc().HasMember("license")) {
+    const auto& license = doc.doc()["license"];
+    if (license.IsString()) {
+      // Current license schema is just a top level string
+      r["license"] = license.GetString();
+    } else {
+      // If its not a string, is it a dict with 'url' ?
+      if (license.HasMember("url")) {
+        const auto& license_url = license["url"];
+        if (license_url.IsString()) {
+          // Fallback to displaying deprecated licence url
+          r["license"] = license_url.GetString();
         }
       }
     }
+  }
+  return Status::success();
+}
 
-    // Manually get license to support deprecated licence schema.
-    // In the current schema it is a string, but in previous versions it is a
-    // dictionary with url and type
-    if (doc.doc().HasMember("license")) {
-      const auto& license = doc.doc()["license"];
-      if (license.IsString()) {
-        // Current license schema is just a top level string
-        r["license"] = license.GetString();
-      } else {
-        // If its not a string, is it a dict with 'url' ?
-        if (license.HasMember("url")) {
-          const auto& license_url = license["url"];
-          if (license_url.IsString()) {
-            // Fallback to displaying deprecated licence url
-            r["license"] = license_url.GetString();
-          }
-        }
-      }
+void genPackageResults(const std::string& directory,
+                       QueryData& results,
+                       Logger& logger) {
+  std::vector<std::string> packages;
+  resolveFilePattern(directory + "/node_modules/%/package.json", packages);
+
+  // Unchanged packages are not read again.
+  static PackageManifestCache cache(FLAGS_package_manifest_cache_max,
+                                    genPackageManifest);
+
+  std::vector<Row> rows;
+  auto statuses = cache.parse(packages, rows);
+  for (size_t i = 0; i < packages.size(); ++i) {
+    if (!statuses[i].ok()) {
+      logger.log(google::GLOG_WARNING, statuses[i].getMessage());
+      continue;
     }
 
-    r["path"] = package_path;
+    auto& r = rows[i];
+    r["path"] = packages[i];
     r["directory"] = directory;
     r["pid_with_namespace"] = "0";
 
-    results.push_back(r);
+    results.push_back(std::move(r));
   }
 }
 
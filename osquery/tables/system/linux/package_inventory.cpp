@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/stat.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/system/linux/package_inventory.h>
+
+namespace osquery {
+
+FLAG(bool,
+     disable_package_cache,
+     false,
+     "Re-read package databases on every query, even if they did not change");
+
+namespace tables {
+
+std::string getPackageDatabaseFingerprint(
+    const std::vector<std::string>& paths) {
+  std::string fingerprint;
+  bool found = false;
+  for (const auto& path : paths) {
+    struct stat st;
+    fingerprint += path + ":";
+    if (::stat(path.c_str(), &st) != 0) {
+      fingerprint += "-;";
+      continue;
+    }
+
+    found = true;
+    fingerprint += std::to_string(st.st_dev) + ":" +
+                   std::to_string(st.st_ino) + ":" +
+                   std::to_string(st.st_size) + ":" +
+                   std::to_string(st.st_mtim.tv_sec) + "." +
+                   std::to_string(st.st_mtim.tv_nsec) + ";";
+  }
+
+  return found ? fingerprint : "";
+}
+
+bool PackageInventoryCache::get(const std::string& fingerprint,
+                                QueryData& results) {
+  if (FLAGS_disable_package_cache || fingerprint.empty()) {
+    return false;
+  }
+
+  WriteLock lock(mutex_);
+  if (fingerprint != fingerprint_) {
+    return false;
+  }
+  results = results_;
+  return true;
+}
+
+void PackageInventoryCache::set(const std::string& fingerprint,
+                                const QueryData& results) {
+  // Failed reads return no rows, keep trying those.
+  WriteLock lock(mutex_);
+  if (FLAGS_disable_package_cache || fingerprint.empty() || results.empty()) {
+    fingerprint_.clear();
+    results_.clear();
+    return;
+  }
+
+  fingerprint_ = fingerprint;
+  results_ = results;
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Fingerprint the files a package database is stored in.
+ *
+ * Each path contributes its device, inode, size and modification time. Package
+ * managers replace or append to these files when packages change, so an equal
+ * fingerprint means the database was not modified.
+ *
+ * @return An empty string if none of the paths exist.
+ */
+std::string getPackageDatabaseFingerprint(
+    const std::vector<std::string>& paths);
+
+/**
+ * @brief The rows last generated from a package database.
+ *
+ * Package tables are scheduled often while the installed packages rarely
+ * change. The rows are kept with the fingerprint of the database they were
+ * read from and returned until the fingerprint changes.
+ */
+class PackageInventoryCache final {
+ public:
+  /// Copy the cached rows if they were read from an equal fingerprint.
+  bool get(const std::string& fingerprint, QueryData& results);
+
+  /// Replace the cached rows, an empty result clears them.
+  void set(const std::string& fingerprint, const QueryData& results);
+
+ private:
+  Mutex mutex_;
+
+  std::string fingerprint_;
+  QueryData results_;
+};
+
+} // namespace tables
+} // namespace osquery
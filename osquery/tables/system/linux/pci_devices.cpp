@@ -7,19 +7,24 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <fstream>
 #include <locale>
 
+#include <sys/stat.h>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/events/linux/udev.h>
+#include <osquery/events/linux/udev_device_cache.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/linux/pci_devices.h>
 #include <osquery/utils/conversions/join.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 namespace tables {
@@ -41,122 +46,107 @@ const std::string kPciidsDeviceClassStartIndicator = "ffff";
 const std::string kPciidsValidHexChars = "0123456789abcdef";
 const char kPciidsCommentChar = '#';
 
-Status PciDB::parseVendor(std::string& line, PciVendor*& cur_vendor) {
-  if (line.size() < 7) {
-    return Status::failure("line is shorter than 7 characters");
-  }
+namespace {
 
-  auto vendor_id = line.substr(0, 4);
-  // Setup current vendor.
-  // Bump 2 chars to account for whitespace separation..
-  auto result =
-      db_.emplace(vendor_id,
-                  PciVendor{vendor_id,
-                            line.substr(6),
-                            std::unordered_map<std::string, PciModel>{}});
-  if (result.second != true) {
-    return Status::failure(
-        "failed to save to db for line because key already exists:: " + line);
+/// Parse a 4 digit pci.ids ID, -1 if it is not valid.
+int parsePciId(const std::string& id) {
+  if (id.size() != 4 ||
+      id.find_first_not_of(kPciidsValidHexChars) != std::string::npos) {
+    return -1;
   }
-
-  cur_vendor = &result.first->second;
-
-  return Status::success();
+  return static_cast<int>(std::stoul(id, nullptr, 16));
 }
 
-Status PciDB::parseModel(std::string& line,
-                         PciVendor* cur_vendor,
-                         PciModel*& cur_model) {
-  if (line.size() < 8) {
-    return Status::failure("line is shorter than 8 characters");
-  }
-
-  if (cur_vendor == nullptr) {
-    return Status::failure("cur_vendor is null for line: " + line);
-  }
-
-  auto model_id = line.substr(1, 4);
-  // Set up current model under the current vendor.
-  // Bump 2 chars to account for whitespace separation.
-  auto result = cur_vendor->models.emplace(
-      model_id,
-      PciModel{model_id,
-               line.substr(7),
-               std::unordered_map<std::string, std::string>{}});
-  if (result.second != true) {
-    return Status::failure(
-        "failed to save to models db for line because key already exists:: " +
-        line);
-  }
-
-  cur_model = &result.first->second;
+std::uint64_t makeModelKey(int vendor, int model) {
+  return (static_cast<std::uint64_t>(vendor) << 16) |
+         static_cast<std::uint64_t>(model);
+}
 
-  return Status::success();
+std::uint64_t makeSubsystemKey(int vendor,
+                               int model,
+                               int subsystem_vendor,
+                               int subsystem_model) {
+  return (makeModelKey(vendor, model) << 32) |
+         makeModelKey(subsystem_vendor, subsystem_model);
 }
 
-Status PciDB::parseSubsystem(std::string& line, PciModel* cur_model) {
-  if (line.size() < 12) {
-    return Status::failure("line is shorter than 12 characters");
-  }
+/// The system pci.ids index, with the fingerprint of the file it was read from.
+struct SystemPciDB {
+  Mutex mutex;
+  std::string fingerprint;
+  std::shared_ptr<const PciDB> pcidb;
+};
 
-  if (cur_model == nullptr) {
-    return Status::failure("cur_model is null for line: " + line);
-  }
+SystemPciDB& getSystemPciDBCache() {
+  static SystemPciDB cache;
+  return cache;
+}
 
-  // Store current subsystem information under current vendor and model.
-  auto subsystemInfo = line.substr(11);
-  boost::trim(subsystemInfo);
-  auto result = cur_model->subsystemInfo.emplace(line.substr(2, 9),
-                                                 std::move(subsystemInfo));
-  if (result.second != true) {
-    return Status::failure(
-        "failed to save to subsystems db for line because key already "
-        "exists: " +
-        line);
-  }
+} // namespace
 
-  return Status::success();
+void PciDB::addEntry(std::vector<Entry>& entries,
+                     std::uint64_t key,
+                     const std::string& name) {
+  entries.push_back({key,
+                     static_cast<std::uint32_t>(names_.size()),
+                     static_cast<std::uint32_t>(name.size())});
+  names_ += name;
 }
 
-bool PciDB::parseLine(std::string& line,
-                      PciVendor*& cur_vendor,
-                      PciModel*& cur_model) {
+bool PciDB::parseLine(const std::string& line, int& vendor, int& model) {
   switch (line.find_first_of(kPciidsValidHexChars)) {
   case 0: {
-    auto status = parseVendor(line, cur_vendor);
-    if (!status.ok()) {
-      VLOG(1) << "Unexpected error while parsing pci.ids vendor line: "
-              << status.getMessage();
+    model = -1;
+    if (line.size() < 7) {
+      VLOG(1) << "Unexpected error while parsing pci.ids vendor line: line is "
+                 "shorter than 7 characters";
+      vendor = -1;
       return true;
     }
 
-    // We don't currently handle device class device so remove from DB if we get
-    // the indicator.
-    if (cur_vendor->id == kPciidsDeviceClassStartIndicator) {
-      db_.erase(kPciidsDeviceClassStartIndicator);
+    // We don't currently handle device class device so stop at the indicator.
+    if (line.compare(0, 4, kPciidsDeviceClassStartIndicator) == 0) {
       return false;
     }
 
+    // Bump 2 chars to account for whitespace separation.
+    vendor = parsePciId(line.substr(0, 4));
+    if (vendor >= 0) {
+      addEntry(vendors_, vendor, line.substr(6));
+    }
     return true;
   }
 
   case 1: {
-    auto status = parseModel(line, cur_vendor, cur_model);
-    if (!status.ok()) {
-      VLOG(1) << "Unexpected error while parsing pci.ids model line: "
-              << status.getMessage();
+    if (line.size() < 8 || vendor < 0) {
+      VLOG(1) << "Unexpected error while parsing pci.ids model line: " << line;
+      model = -1;
+      return true;
     }
 
+    model = parsePciId(line.substr(1, 4));
+    if (model >= 0) {
+      addEntry(models_, makeModelKey(vendor, model), line.substr(7));
+    }
     return true;
   }
 
   case 2: {
-    auto status = parseSubsystem(line, cur_model);
-    if (!status.ok()) {
+    if (line.size() < 12 || model < 0) {
       VLOG(1) << "Unexpected error while parsing pci.ids subsystem line: "
-              << status.getMessage();
+              << line;
+      return true;
     }
 
+    auto subsystem_vendor = parsePciId(line.substr(2, 4));
+    auto subsystem_model = parsePciId(line.substr(7, 4));
+    if (subsystem_vendor >= 0 && subsystem_model >= 0 && line[6] == ' ') {
+      auto name = line.substr(11);
+      boost::trim(name);
+      addEntry(subsystems_,
+               makeSubsystemKey(vendor, model, subsystem_vendor, subsystem_model),
+               name);
+    }
     return true;
   }
 
@@ -169,47 +159,62 @@ bool PciDB::parseLine(std::string& line,
 PciDB::PciDB(std::istream& db_filestream) {
   // pci.ids keep track of subsystem information of vendor and models
   // sequentially so we keep track of what the current vendor and models are.
-  PciVendor* cur_vendor = nullptr;
-  PciModel* cur_model = nullptr;
+  int vendor = -1;
+  int model = -1;
 
   std::string line;
   while (std::getline(db_filestream, line)) {
     line = line.substr(0, line.find_first_of(kPciidsCommentChar));
     boost::trim_right(line);
 
-    if (parseLine(line, cur_vendor, cur_model) == false) {
-      return;
+    if (parseLine(line, vendor, model) == false) {
+      break;
     }
   }
+
+  // Duplicated IDs resolve to their first line.
+  std::stable_sort(vendors_.begin(), vendors_.end());
+  std::stable_sort(models_.begin(), models_.end());
+  std::stable_sort(subsystems_.begin(), subsystems_.end());
+
+  names_.shrink_to_fit();
+  vendors_.shrink_to_fit();
+  models_.shrink_to_fit();
+  subsystems_.shrink_to_fit();
+}
+
+Status PciDB::find(const std::vector<Entry>& entries,
+                   std::uint64_t key,
+                   std::string& name) const {
+  auto it = std::lower_bound(entries.begin(), entries.end(), Entry{key, 0, 0});
+  if (it == entries.end() || it->key != key) {
+    return Status::failure("ID does not exist");
+  }
+
+  name = names_.substr(it->offset, it->length);
+  return Status::success();
 }
 
 Status PciDB::getVendorName(const std::string& vendor_id,
                             std::string& name) const {
-  auto vendor_it = db_.find(vendor_id);
-  if (vendor_it == db_.end()) {
+  auto vendor = parsePciId(vendor_id);
+  if (vendor < 0 || !find(vendors_, vendor, name).ok()) {
     return Status::failure("Vendor ID does not exist");
   }
 
-  name = vendor_it->second.name;
-
   return Status::success();
 }
 
 Status PciDB::getModel(const std::string& vendor_id,
                        const std::string& model_id,
-                       std::string& model) const {
-  auto vendor_it = db_.find(vendor_id);
-  if (vendor_it == db_.end()) {
-    return Status::failure("Vendor ID does not exist");
-  }
-
-  auto model_it = vendor_it->second.models.find(model_id);
-  if (model_it == vendor_it->second.models.end()) {
+                       std::string& model_name) const {
+  auto vendor = parsePciId(vendor_id);
+  auto model = parsePciId(model_id);
+  if (vendor < 0 || model < 0 ||
+      !find(models_, makeModelKey(vendor, model), model_name).ok()) {
     return Status::failure("Model ID does not exist");
   }
 
-  model = model_it->second.desc;
-
   return Status::success();
 }
 
@@ -218,26 +223,60 @@ Status PciDB::getSubsystemInfo(const std::string& vendor_id,
                                const std::string& subsystem_vendor_id,
                                const std::string& subsystem_device_id,
                                std::string& subsystem) const {
-  auto vendor_it = db_.find(vendor_id);
-  if (vendor_it == db_.end()) {
-    return Status::failure("Vendor ID does not exist");
-  }
-
-  auto model_it = vendor_it->second.models.find(model_id);
-  if (model_it == vendor_it->second.models.end()) {
-    return Status::failure("Model ID does not exist");
-  }
+  auto vendor = parsePciId(vendor_id);
+  auto model = parsePciId(model_id);
+  auto subsystem_vendor = parsePciId(subsystem_vendor_id);
+  auto subsystem_model = parsePciId(subsystem_device_id);
 
   auto subsystem_id = subsystem_vendor_id + " " + subsystem_device_id;
-
-  auto subsystem_it = model_it->second.subsystemInfo.find(subsystem_id);
-  if (subsystem_it == model_it->second.subsystemInfo.end()) {
+  if (vendor < 0 || model < 0 || subsystem_vendor < 0 || subsystem_model < 0 ||
+      !find(subsystems_,
+            makeSubsystemKey(vendor, model, subsystem_vendor, subsystem_model),
+            subsystem)
+           .ok()) {
     return Status::failure("Subsystem ID does not exist in system pci.ids: " +
                            subsystem_id);
   }
 
-  subsystem = subsystem_it->second;
+  return Status::success();
+}
+
+Status getSystemPciDB(std::shared_ptr<const PciDB>& pcidb) {
+  // Check pci.ids path
+  std::string path;
+  struct stat st;
+  for (const std::string& pci_ids_path : kPciidsPathList) {
+    if (::stat(pci_ids_path.c_str(), &st) == 0) {
+      path = pci_ids_path;
+      break;
+    }
+  }
+
+  if (path.empty()) {
+    return Status::failure("Unable to find pci.ids at path: " +
+                           osquery::join(kPciidsPathList, " "));
+  }
+
+  auto fingerprint = path + ":" + std::to_string(st.st_dev) + ":" +
+                     std::to_string(st.st_ino) + ":" +
+                     std::to_string(st.st_size) + ":" +
+                     std::to_string(st.st_mtime);
+
+  auto& cache = getSystemPciDBCache();
+  WriteLock lock(cache.mutex);
+  if (cache.pcidb == nullptr || cache.fingerprint != fingerprint) {
+    std::ifstream raw(path);
+    if (!raw) {
+      return Status::failure("Unexpected error attempting to read pci.ids at "
+                             "path: " +
+                             path);
+    }
+
+    cache.pcidb = std::make_shared<const PciDB>(raw);
+    cache.fingerprint = std::move(fingerprint);
+  }
 
+  pcidb = cache.pcidb;
   return Status::success();
 }
 
@@ -336,19 +375,18 @@ Status extractVendorModelFromPciDBIfPresent(
   return Status::success();
 }
 
-Status extractPCIVendorModelInfo(
-    Row& row,
-    std::unique_ptr<udev_device, decltype(&udev_device_unref)>& device,
-    const PciDB& pcidb) {
+Status extractPCIVendorModelInfo(Row& row,
+                                 udev_device* device,
+                                 const PciDB& pcidb) {
   // Fallback data comes from UdevEventPublisher.
-  row["vendor"] = UdevEventPublisher::getValue(device.get(), kPCIKeyVendor);
-  row["model"] = UdevEventPublisher::getValue(device.get(), kPCIKeyModel);
+  row["vendor"] = UdevEventPublisher::getValue(device, kPCIKeyVendor);
+  row["model"] = UdevEventPublisher::getValue(device, kPCIKeyModel);
 
   // Now try PciDB for more up to date info.
   return extractVendorModelFromPciDBIfPresent(
       row,
-      UdevEventPublisher::getValue(device.get(), kPCIKeyID),
-      UdevEventPublisher::getValue(device.get(), kPCISubsysID),
+      UdevEventPublisher::getValue(device, kPCIKeyID),
+      UdevEventPublisher::getValue(device, kPCISubsysID),
       pcidb);
 }
 
@@ -380,79 +418,39 @@ Status extractPCIClassIDAttrs(Row& row, std::string pci_class_attr) {
 QueryData genPCIDevices(QueryContext& context) {
   QueryData results;
 
-  auto del_udev = [](udev* u) { udev_unref(u); };
-  std::unique_ptr<udev, decltype(del_udev)> udev_handle(udev_new(), del_udev);
-  if (udev_handle.get() == nullptr) {
-    VLOG(1) << "Could not get udev handle";
-    return results;
-  }
-
-  // Perform enumeration/search.
-  auto del_udev_enum = [](udev_enumerate* e) { udev_enumerate_unref(e); };
-  std::unique_ptr<udev_enumerate, decltype(del_udev_enum)> enumerate(
-      udev_enumerate_new(udev_handle.get()), del_udev_enum);
-  if (enumerate.get() == nullptr) {
-    VLOG(1) << "Could not get udev_enumerate handle";
-    return results;
-  }
-
-  // Check pci.ids path
-  std::ifstream raw;
-  for (const std::string& pci_ids_path : kPciidsPathList) {
-    if (pathExists(pci_ids_path)) {
-      raw.open(pci_ids_path);
-      if (raw) {
-        break;
-      }
-    }
-  }
-  if (!raw.is_open()) {
-    LOG(ERROR) << "Unexpected error attempting to read pci.ids at path: "
-               << osquery::join(kPciidsPathList, " ");
+  // The index is shared by queries and only rebuilt when pci.ids changes.
+  std::shared_ptr<const PciDB> pcidb;
+  auto status = getSystemPciDB(pcidb);
+  if (!status.ok()) {
+    LOG(ERROR) << status.getMessage();
     return results;
   }
 
-  PciDB pcidb(raw);
-
-  udev_enumerate_add_match_subsystem(enumerate.get(), "pci");
-  udev_enumerate_scan_devices(enumerate.get());
-
-  // Get list entries and iterate over entries.
-  struct udev_list_entry *device_entries, *entry;
-  device_entries = udev_enumerate_get_list_entry(enumerate.get());
-
-  udev_list_entry_foreach(entry, device_entries) {
-    const char* path = udev_list_entry_get_name(entry);
-
-    std::unique_ptr<udev_device, decltype(&udev_device_unref)> device(
-        udev_device_new_from_syspath(udev_handle.get(), path),
-        udev_device_unref);
-    if (device.get() == nullptr) {
-      VLOG(1) << "Could not get device";
-      return results;
-    }
-
+  status = UdevDeviceCache::get().walk("pci", [&](udev_device* device) {
     Row r;
-    r["pci_slot"] = UdevEventPublisher::getValue(device.get(), kPCIKeySlot);
-    r["pci_class"] = UdevEventPublisher::getValue(device.get(), kPCIKeyClass);
-    r["pci_subclass"] =
-        UdevEventPublisher::getValue(device.get(), kPCIKeySubclass);
-    r["driver"] = UdevEventPublisher::getValue(device.get(), kPCIKeyDriver);
-
-    auto status = extractPCIVendorModelInfo(r, device, pcidb);
-    if (!status.ok()) {
+    r["pci_slot"] = UdevEventPublisher::getValue(device, kPCIKeySlot);
+    r["pci_class"] = UdevEventPublisher::getValue(device, kPCIKeyClass);
+    r["pci_subclass"] = UdevEventPublisher::getValue(device, kPCIKeySubclass);
+    r["driver"] = UdevEventPublisher::getValue(device, kPCIKeyDriver);
+
+    auto device_status = extractPCIVendorModelInfo(r, device, *pcidb);
+    if (!device_status.ok()) {
       VLOG(1) << "Unexpected error extracting PCI Device information: "
-              << status.getMessage();
+              << device_status.getMessage();
     }
 
-    status = extractPCIClassIDAttrs(
-        r, UdevEventPublisher::getValue(device.get(), kPCIClassID));
-    if (!status.ok()) {
+    device_status = extractPCIClassIDAttrs(
+        r, UdevEventPublisher::getValue(device, kPCIClassID));
+    if (!device_status.ok()) {
       VLOG(1) << "Failed to extract PCI class attributes: "
-              << status.getMessage();
+              << device_status.getMessage();
     }
 
     results.emplace_back(std::move(r));
+    return false;
+  });
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage();
   }
 
   return results;
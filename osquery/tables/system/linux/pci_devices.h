@@ -7,37 +7,24 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <osquery/core/tables.h>
 
 namespace osquery {
 namespace tables {
 
-/// Represents a model related data for PCI devices of a given vendor and model.
-struct PciModel {
-  /// ID of PCI device.
-  std::string id;
-
-  /// Description of PCI device.
-  std::string desc;
-
-  /// Stores subsystem information keyed by
-  /// "<subsystem vendor id> <subsystem model id>". Key is preserved same as
-  /// they are in pci.ids since lookup always requires both attribute ids.
-  std::unordered_map<std::string, std::string> subsystemInfo;
-};
-
-/// Represents vendor related data for a PCI devices of a given vendor.
-struct PciVendor {
-  /// ID of vendor.
-  std::string id;
-
-  /// Name of vendor.
-  std::string name;
-
-  /// Stores device models information keyed by PCI device (model) ID.
-  std::unordered_map<std::string, PciModel> models;
-};
-
+/**
+ * @brief An index of the vendor, model and subsystem names of pci.ids.
+ *
+ * pci.ids has tens of thousands of lines, the names are copied into one
+ * buffer and located with sorted arrays of numeric IDs. The system database
+ * is indexed once and shared by queries, see getSystemPciDB.
+ */
 class PciDB {
  public:
   /**
@@ -87,34 +74,58 @@ class PciDB {
   PciDB(std::istream& db_filestream);
 
  private:
+  /// A name in names_, keyed by the IDs leading to it.
+  struct Entry {
+    std::uint64_t key;
+    std::uint32_t offset;
+    std::uint32_t length;
+
+    bool operator<(const Entry& other) const {
+      return key < other.key;
+    }
+  };
+
   /**
    * @brief parses line of pci.ids.
    *
    * @param line line to parse.
-   * @param cur_vendor PciVendor* reference that represents the current vendor.
-   * @param cur_model PciModel* reference that represents the current model.
+   * @param vendor the ID of the current vendor, if any.
+   * @param model the ID of the current model, if any.
    *
    * @return bool true to keep parsing, false to stop.
    */
-  bool parseLine(std::string& line,
-                 PciVendor*& cur_vendor,
-                 PciModel*& cur_model);
+  bool parseLine(const std::string& line, int& vendor, int& model);
 
-  /// Parses a vendor line.  Updates cur_vendor if no errors.
-  Status parseVendor(std::string& line, PciVendor*& cur_vendor);
+  /// Copy a name into names_ and index it.
+  void addEntry(std::vector<Entry>& entries,
+                std::uint64_t key,
+                const std::string& name);
 
-  /// Parses a model line.  Updates cur_model if no errors.
-  Status parseModel(std::string& line,
-                    PciVendor* cur_vendor,
-                    PciModel*& cur_model);
-
-  /// Parses a subsystem line.
-  Status parseSubsystem(std::string& line, PciModel* cur_model);
+  /// Find the first entry with a key.
+  Status find(const std::vector<Entry>& entries,
+              std::uint64_t key,
+              std::string& name) const;
 
  private:
-  std::unordered_map<std::string, PciVendor> db_;
+  std::string names_;
+
+  /// Keyed by vendor.
+  std::vector<Entry> vendors_;
+
+  /// Keyed by vendor and model.
+  std::vector<Entry> models_;
+
+  /// Keyed by vendor, model, subsystem vendor and subsystem model.
+  std::vector<Entry> subsystems_;
 };
 
+/**
+ * @brief The index of the system pci.ids, shared by queries.
+ *
+ * The database is indexed again when the file is replaced or modified.
+ */
+Status getSystemPciDB(std::shared_ptr<const PciDB>& pcidb);
+
 /// Extracts PCI device information into row for provided sysFS attributes.
 Status extractVendorModelFromPciDBIfPresent(
     Row& row,
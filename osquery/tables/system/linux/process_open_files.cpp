@@ -10,6 +10,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/proc_snapshot.h>
 #include <osquery/logger/logger.h>
 
 namespace osquery {
@@ -39,16 +40,17 @@ void genDescriptors(const std::string& process,
 QueryData genOpenFiles(QueryContext& context) {
   QueryData results;
 
+  auto snapshot = getProcSnapshot(context);
   std::set<std::string> pids;
   if (context.constraints["pid"].exists(EQUALS)) {
     pids = context.constraints["pid"].getAll(EQUALS);
   } else {
-    osquery::procProcesses(pids);
+    pids = snapshot->processes();
   }
 
   for (const auto& process : pids) {
     std::map<std::string, std::string> descriptors;
-    if (osquery::procDescriptors(process, descriptors).ok()) {
+    if (snapshot->descriptors(process, descriptors).ok()) {
       genDescriptors(process, descriptors, results);
     }
   }
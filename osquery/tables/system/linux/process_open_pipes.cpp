@@ -11,6 +11,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/proc_snapshot.h>
 #include <osquery/logger/logger.h>
 #include <regex>
 
@@ -200,11 +201,12 @@ QueryData genPipes(QueryContext& context) {
   InodeToPipesMap pipe_partners;
   std::vector<std::unique_ptr<pipe_info>> pipe_structs;
 
-  osquery::procProcesses(pids);
+  auto snapshot = getProcSnapshot(context);
+  pids = snapshot->processes();
 
   for (const auto& process : pids) {
     std::map<std::string, std::string> descriptors;
-    if (osquery::procDescriptors(process, descriptors).ok()) {
+    if (snapshot->descriptors(process, descriptors).ok()) {
       genPipePartners(
           process, descriptors, pipe_desc, pipe_partners, pipe_structs);
     }
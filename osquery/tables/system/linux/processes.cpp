@@ -7,9 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <map>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -23,6 +25,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
+#include <osquery/filesystem/linux/proc_snapshot.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/dynamic_table_row.h>
 
@@ -121,17 +124,18 @@ Status deletedMatchesInode(const std::string& path, const std::string& pid) {
   }
 }
 
-std::set<std::string> getProcList(const QueryContext& context) {
+std::set<std::string> getProcList(const QueryContext& context,
+                                  ProcSnapshot& snapshot) {
   std::set<std::string> pidlist;
   if (context.constraints.count("pid") > 0 &&
       context.constraints.at("pid").exists(EQUALS)) {
     for (const auto& pid : context.constraints.at("pid").getAll(EQUALS)) {
-      if (isDirectory("/proc/" + pid)) {
+      if (snapshot.exists(pid)) {
         pidlist.insert(pid);
       }
     }
   } else {
-    osquery::procProcesses(pidlist);
+    pidlist = snapshot.processes();
   }
 
   return pidlist;
@@ -227,12 +231,26 @@ struct SimpleProcStat : private boost::noncopyable {
   /// For errors processing proc data.
   Status status;
 
-  explicit SimpleProcStat(const std::string& pid);
+  /**
+   * @brief Parse the requested process details.
+   *
+   * @param snapshot The query's /proc snapshot the files are read from.
+   * @param pid The process identifier.
+   * @param stat Read /proc/N/stat (state, parent, times, threads).
+   * @param proc_status Read /proc/N/status (name, credentials, memory).
+   */
+  SimpleProcStat(ProcSnapshot& snapshot,
+                 const std::string& pid,
+                 bool stat,
+                 bool proc_status);
 };
 
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
+SimpleProcStat::SimpleProcStat(ProcSnapshot& snapshot,
+                               const std::string& pid,
+                               bool stat,
+                               bool proc_status) {
   std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
+  if (stat && snapshot.readFile(pid, "stat", content).ok()) {
     auto start = content.find_last_of(")");
     // Start parsing stats from ") <MODE>..."
     if (start == std::string::npos || content.size() <= start + 2) {
@@ -254,10 +272,18 @@ SimpleProcStat::SimpleProcStat(const std::string& pid) {
     this->nice = details.at(16);
     this->threads = details.at(17);
     this->start_time = details.at(19);
+  } else if (stat && !proc_status) {
+    // Without /proc/N/status the stat is the only proof of the process.
+    status = Status(1, "Cannot read /proc/stat");
+    return;
+  }
+
+  if (!proc_status) {
+    return;
   }
 
   // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
+  if (!snapshot.readFile(pid, "status", content).ok()) {
     status = Status(1, "Cannot read /proc/status");
     return;
   }
@@ -392,14 +418,49 @@ int getOnDisk(const std::string& pid, std::string& path) {
   }
 }
 
-void genProcess(const std::string& pid,
+/// Only open the /proc files that back a requested column.
+void getUsedProcFiles(const QueryContext& context,
+                      bool& use_stat,
+                      bool& use_status) {
+  use_stat = context.isAnyColumnUsed({"parent",
+                                      "pgroup",
+                                      "state",
+                                      "nice",
+                                      "threads",
+                                      "user_time",
+                                      "system_time",
+                                      "start_time"});
+  use_status = context.isAnyColumnUsed({"name",
+                                        "uid",
+                                        "euid",
+                                        "suid",
+                                        "gid",
+                                        "egid",
+                                        "sgid",
+                                        "resident_size",
+                                        "total_size"});
+}
+
+void genProcess(const QueryContext& context,
+                ProcSnapshot& snapshot,
+                const std::string& pid,
                 long system_boot_time,
                 TableRows& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-  // Parse the process io
-  SimpleProcIo proc_io(pid);
+  bool use_stat = false;
+  bool use_status = false;
+  getUsedProcFiles(context, use_stat, use_status);
+
+  // The BPF task iterator has all but the state, times, group and memory.
+  BpfTaskInfo task;
+  bool use_task = snapshot.task(pid, task);
+  if (use_task) {
+    use_stat = context.isAnyColumnUsed(
+        {"pgroup", "state", "user_time", "system_time"});
+    use_status = context.isAnyColumnUsed({"resident_size", "total_size"});
+  }
 
+  // Parse the process stat and status.
+  SimpleProcStat proc_stat(snapshot, pid, use_stat, use_status);
   if (!proc_stat.status.ok()) {
     VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
     return;
@@ -407,66 +468,110 @@ void genProcess(const std::string& pid,
 
   auto r = make_table_row();
   r["pid"] = pid;
-  r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
-  r["pgroup"] = proc_stat.group;
-  r["state"] = proc_stat.state;
-  r["nice"] = proc_stat.nice;
-  r["threads"] = proc_stat.threads;
-  // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
-
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
-
-  // size/memory information
-  r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
-
-  // time information
-  auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
-  r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
-  auto sys_time = std::strtoull(proc_stat.system_time.data(), nullptr, 10);
-  r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
-
-  auto proc_start_time_exp = tryTo<long>(proc_stat.start_time);
-  if (proc_start_time_exp.isValue() && system_boot_time > 0) {
-    r["start_time"] = INTEGER(system_boot_time + proc_start_time_exp.take() /
-                                                     sysconf(_SC_CLK_TCK));
-  } else {
-    r["start_time"] = "-1";
+  if (use_stat) {
+    r["parent"] = proc_stat.parent;
+    r["pgroup"] = proc_stat.group;
+    r["state"] = proc_stat.state;
+    r["nice"] = proc_stat.nice;
+    r["threads"] = proc_stat.threads;
+
+    // time information
+    auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
+    r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
+    auto sys_time = std::strtoull(proc_stat.system_time.data(), nullptr, 10);
+    r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
+
+    auto proc_start_time_exp = tryTo<long>(proc_stat.start_time);
+    if (proc_start_time_exp.isValue() && system_boot_time > 0) {
+      r["start_time"] = INTEGER(system_boot_time + proc_start_time_exp.take() /
+                                                       sysconf(_SC_CLK_TCK));
+    } else {
+      r["start_time"] = "-1";
+    }
   }
 
-  if (!proc_io.status.ok()) {
-    // /proc/<pid>/io can require root to access, so don't fail if we can't
-    VLOG(1) << proc_io.status.getMessage();
-  } else {
-    r["disk_bytes_read"] = proc_io.read_bytes;
-    long long write_bytes = tryTo<long long>(proc_io.write_bytes).takeOr(0ll);
-    long long cancelled_write_bytes =
-        tryTo<long long>(proc_io.cancelled_write_bytes).takeOr(0ll);
+  if (use_status) {
+    r["name"] = proc_stat.name;
+    r["uid"] = proc_stat.real_uid;
+    r["euid"] = proc_stat.effective_uid;
+    r["suid"] = proc_stat.saved_uid;
+    r["gid"] = proc_stat.real_gid;
+    r["egid"] = proc_stat.effective_gid;
+    r["sgid"] = proc_stat.saved_gid;
+
+    // size/memory information
+    r["resident_size"] = proc_stat.resident_size;
+    r["total_size"] = proc_stat.total_size;
+  }
 
-    r["disk_bytes_written"] =
-        std::to_string(write_bytes - cancelled_write_bytes);
+  if (use_task) {
+    r["parent"] = INTEGER(task.parent);
+    r["nice"] = INTEGER(task.nice);
+    r["threads"] = INTEGER(task.threads);
+    r["start_time"] = (system_boot_time > 0)
+                          ? INTEGER(system_boot_time + task.start_time /
+                                                           1000000000ULL)
+                          : "-1";
+    r["name"] = task.name;
+    r["uid"] = INTEGER(task.uid);
+    r["euid"] = INTEGER(task.euid);
+    r["suid"] = INTEGER(task.suid);
+    r["gid"] = INTEGER(task.gid);
+    r["egid"] = INTEGER(task.egid);
+    r["sgid"] = INTEGER(task.sgid);
+  }
+
+  // No support for unpagable counters in linux.
+  r["wired_size"] = "0";
+
+  if (context.isAnyColumnUsed({"path", "on_disk"})) {
+    r["path"] = readProcLink("exe", pid);
+    if (context.isColumnUsed("on_disk")) {
+      r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+    }
+  }
+
+  if (context.isColumnUsed("cmdline")) {
+    // Read/parse cmdline arguments.
+    r["cmdline"] = readProcCMDLine(pid);
+  }
+
+  if (context.isColumnUsed("cwd")) {
+    r["cwd"] = readProcLink("cwd", pid);
+  }
+
+  if (context.isColumnUsed("root")) {
+    r["root"] = readProcLink("root", pid);
+  }
+
+  if (context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})) {
+    // Parse the process io
+    SimpleProcIo proc_io(pid);
+    if (!proc_io.status.ok()) {
+      // /proc/<pid>/io can require root to access, so don't fail if we can't
+      VLOG(1) << proc_io.status.getMessage();
+    } else {
+      r["disk_bytes_read"] = proc_io.read_bytes;
+      long long write_bytes =
+          tryTo<long long>(proc_io.write_bytes).takeOr(0ll);
+      long long cancelled_write_bytes =
+          tryTo<long long>(proc_io.cancelled_write_bytes).takeOr(0ll);
+
+      r["disk_bytes_written"] =
+          std::to_string(write_bytes - cancelled_write_bytes);
+    }
   }
 
   results.push_back(r);
 }
 
-void genNamespaces(const std::string& pid, QueryData& results) {
+void genNamespaces(ProcSnapshot& snapshot,
+                   const std::string& pid,
+                   QueryData& results) {
   Row r;
 
   ProcessNamespaceList proc_ns;
-  Status status = procGetProcessNamespaces(pid, proc_ns);
+  Status status = snapshot.namespaces(pid, proc_ns);
   if (!status.ok()) {
     VLOG(1) << "Namespaces for pid " << pid
             << " are incomplete: " << status.what();
@@ -487,9 +592,44 @@ TableRows genProcesses(QueryContext& context) {
     system_boot_time = std::time(nullptr) - system_boot_time;
   }
 
-  auto pidlist = getProcList(context);
-  for (const auto& pid : pidlist) {
-    genProcess(pid, system_boot_time, results);
+  auto snapshot = getProcSnapshot(context);
+  auto pidlist = getProcList(context, *snapshot);
+  std::vector<std::string> pids(pidlist.begin(), pidlist.end());
+
+  bool descending = false;
+  if (context.isOrderedBy("pid", descending)) {
+    // The list is ordered as text, shorter decimal pids are smaller.
+    std::sort(pids.begin(),
+              pids.end(),
+              [descending](const std::string& a, const std::string& b) {
+                const auto& lhs = descending ? b : a;
+                const auto& rhs = descending ? a : b;
+                return lhs.size() != rhs.size() ? lhs.size() < rhs.size()
+                                                : lhs < rhs;
+              });
+  }
+
+  // Without a limit every process is read, read their files together.
+  if (!context.limit) {
+    bool use_stat = false;
+    bool use_status = false;
+    getUsedProcFiles(context, use_stat, use_status);
+
+    std::vector<std::string> files;
+    if (use_stat) {
+      files.push_back("stat");
+    }
+    if (use_status) {
+      files.push_back("status");
+    }
+    snapshot->prefetch(pids, files);
+  }
+
+  for (const auto& pid : pids) {
+    if (context.limit && results.size() >= *context.limit) {
+      break;
+    }
+    genProcess(context, *snapshot, pid, system_boot_time, results);
   }
 
   return results;
@@ -498,7 +638,7 @@ TableRows genProcesses(QueryContext& context) {
 QueryData genProcessEnvs(QueryContext& context) {
   QueryData results;
 
-  auto pidlist = getProcList(context);
+  auto pidlist = getProcList(context, *getProcSnapshot(context));
   for (const auto& pid : pidlist) {
     genProcessEnvironment(pid, results);
   }
@@ -509,7 +649,7 @@ QueryData genProcessEnvs(QueryContext& context) {
 QueryData genProcessMemoryMap(QueryContext& context) {
   QueryData results;
 
-  auto pidlist = getProcList(context);
+  auto pidlist = getProcList(context, *getProcSnapshot(context));
   for (const auto& pid : pidlist) {
     genProcessMap(pid, results);
   }
@@ -520,9 +660,10 @@ QueryData genProcessMemoryMap(QueryContext& context) {
 QueryData genProcessNamespaces(QueryContext& context) {
   QueryData results;
 
-  const auto pidlist = getProcList(context);
+  auto snapshot = getProcSnapshot(context);
+  const auto pidlist = getProcList(context, *snapshot);
   for (const auto& pid : pidlist) {
-    genNamespaces(pid, results);
+    genNamespaces(*snapshot, pid, results);
   }
 
   return results;
@@ -15,6 +15,8 @@
 #include <rpm/rpmpgp.h>
 #include <rpm/rpmts.h>
 
+#include <algorithm>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/system.h>
@@ -22,6 +24,7 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/tables/system/linux/package_inventory.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -39,6 +42,21 @@ namespace tables {
 // Maximum number of files per RPM.
 #define MAX_RPM_FILES (64 * 1024)
 
+/// The files of the Berkeley DB, NDB and SQLite rpmdb backends.
+static const std::vector<std::string> kRpmDatabasePaths{
+    "/var/lib/rpm/Packages",
+    "/var/lib/rpm/Packages.db",
+    "/var/lib/rpm/rpmdb.sqlite",
+    "/var/lib/rpm/rpmdb.sqlite-wal",
+    "/usr/lib/sysimage/rpm/Packages",
+    "/usr/lib/sysimage/rpm/Packages.db",
+    "/usr/lib/sysimage/rpm/rpmdb.sqlite",
+    "/usr/lib/sysimage/rpm/rpmdb.sqlite-wal",
+};
+
+/// The host's packages, read again only when the rpmdb changes.
+static PackageInventoryCache rpmPackagesCache;
+
 /**
  * @brief Return a string representation of the RPM tag type.
  *
@@ -186,10 +204,32 @@ QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
 QueryData genRpmPackages(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "rpm_packages", genRpmPackagesImpl);
-  } else {
-    GLOGLogger logger;
-    return genRpmPackagesImpl(context, logger);
   }
+
+  auto fingerprint = getPackageDatabaseFingerprint(kRpmDatabasePaths);
+
+  QueryData results;
+  if (rpmPackagesCache.get(fingerprint, results)) {
+    if (context.constraints["name"].exists(EQUALS)) {
+      auto names = context.constraints["name"].getAll(EQUALS);
+      results.erase(std::remove_if(results.begin(),
+                                   results.end(),
+                                   [&names](const Row& r) {
+                                     return names.count(r.at("name")) == 0;
+                                   }),
+                    results.end());
+    }
+    return results;
+  }
+
+  GLOGLogger logger;
+  results = genRpmPackagesImpl(context, logger);
+
+  // A name constraint only reads the matching headers.
+  if (!context.constraints["name"].exists(EQUALS)) {
+    rpmPackagesCache.set(fingerprint, results);
+  }
+  return results;
 }
 
 void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
@@ -14,9 +14,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
-#include <osquery/tables/system/linux/dbus/methods/getstringproperty.h>
-#include <osquery/tables/system/linux/dbus/methods/listunitsmethodhandler.h>
-#include <osquery/tables/system/linux/dbus/uniquedbusconnection.h>
+#include <osquery/tables/system/linux/dbus/systemdunitlist.h>
 #include <osquery/utils/conversions/split.h>
 
 namespace osquery {
@@ -84,61 +82,20 @@ void genAutoStartScripts(const std::string& sysdir, QueryData& results) {
 }
 
 Status genSystemdItems(QueryData& results) {
-  UniqueDbusConnection connection;
-  auto status = UniqueDbusConnection::create(connection, true);
+  std::vector<SystemdUnit> unit_list;
+  auto status = SystemdUnitList::get().list(unit_list);
   if (!status.ok()) {
     return status;
   }
 
-  ListUnitsMethod list_units_method;
-  ListUnitsMethod::Output unit_list;
-  status = list_units_method.call(
-      unit_list, connection, "/org/freedesktop/systemd1");
-  if (!status.ok()) {
-    return status;
-  }
-
-  GetStringPropertyMethod get_string_property_method;
-
-  for (const auto& unit : unit_list) {
+  for (const auto& entry : unit_list) {
     Row row = {};
-    row["name"] = unit.id;
+    row["name"] = entry.unit.id;
     row["type"] = "systemd unit";
-    row["status"] = unit.active_state;
-
-    std::string unit_path;
-    status = get_string_property_method.call(unit_path,
-                                             connection,
-                                             unit.path,
-                                             "org.freedesktop.systemd1.Unit",
-                                             "FragmentPath");
-    if (!status.ok()) {
-      return status;
-    }
-
-    row["path"] = unit_path;
-
-    std::string source_path;
-    status = get_string_property_method.call(source_path,
-                                             connection,
-                                             unit.path,
-                                             "org.freedesktop.systemd1.Unit",
-                                             "SourcePath");
-    if (!status.ok()) {
-      return status;
-    }
-
-    row["source"] = source_path;
-
-    std::string username;
-    status = get_string_property_method.call(username,
-                                             connection,
-                                             unit.path,
-                                             "org.freedesktop.systemd1.Service",
-                                             "User");
-
-    static_cast<void>(status);
-    row["username"] = username;
+    row["status"] = entry.unit.active_state;
+    row["path"] = entry.fragment_path;
+    row["source"] = entry.source_path;
+    row["username"] = entry.user;
 
     results.push_back(std::move(row));
   }
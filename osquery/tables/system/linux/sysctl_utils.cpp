@@ -13,6 +13,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/read_batch.h>
 #include <osquery/tables/system/posix/sysctl_utils.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/mutex.h>
@@ -24,46 +25,57 @@ namespace tables {
 
 const std::string kSystemControlPath = "/proc/sys/";
 
-void genControlInfo(const std::string& mib_path,
-                    QueryData& results,
-                    const std::map<std::string, std::string>& config) {
+/// Find the leaf controls of a control directory.
+void genControlPaths(const std::string& mib_path,
+                     std::vector<BatchFileRead>& controls) {
   if (isDirectory(mib_path).ok()) {
     // Iterate through the subitems and items.
     std::vector<std::string> items;
     if (listDirectoriesInDirectory(mib_path, items).ok()) {
       for (const auto& item : items) {
-        genControlInfo(item, results, config);
+        genControlPaths(item, controls);
       }
     }
 
     if (listFilesInDirectory(mib_path, items).ok()) {
       for (const auto& item : items) {
-        genControlInfo(item, results, config);
+        genControlPaths(item, controls);
       }
     }
     return;
   }
 
   // This is a file (leaf-control).
-  Row r;
-  r["name"] = mib_path.substr(kSystemControlPath.size());
+  controls.emplace_back();
+  controls.back().path = mib_path;
+}
 
-  std::replace(r["name"].begin(), r["name"].end(), '/', '.');
-  // No known way to convert name MIB to int array.
-  r["subsystem"] = osquery::split(r.at("name"), ".")[0];
+/// Read the leaf controls together, then report them.
+void genControlRows(std::vector<BatchFileRead>& controls,
+                    QueryData& results,
+                    const std::map<std::string, std::string>& config) {
+  readFileBatch(controls);
 
-  if (isReadable(mib_path).ok()) {
-    std::string content;
-    readFile(mib_path, content);
-    boost::trim(content);
-    r["current_value"] = content;
-  }
+  for (auto& control : controls) {
+    Row r;
+    r["name"] = control.path.substr(kSystemControlPath.size());
 
-  if (config.count(r.at("name")) > 0) {
-    r["config_value"] = config.at(r.at("name"));
+    std::replace(r["name"].begin(), r["name"].end(), '/', '.');
+    // No known way to convert name MIB to int array.
+    r["subsystem"] = osquery::split(r.at("name"), ".")[0];
+
+    // Write-only controls have no current value.
+    if (control.status.ok()) {
+      boost::trim(control.content);
+      r["current_value"] = std::move(control.content);
+    }
+
+    if (config.count(r.at("name")) > 0) {
+      r["config_value"] = config.at(r.at("name"));
+    }
+    r["type"] = "string";
+    results.push_back(r);
   }
-  r["type"] = "string";
-  results.push_back(r);
 }
 
 void genControlInfo(int* oid,
@@ -95,14 +107,16 @@ void genAllControls(QueryData& results,
     return;
   }
 
+  std::vector<BatchFileRead> controls;
   for (const auto& sub : subsystems) {
     if (subsystem.size() != 0 &&
         fs::path(sub).filename().string() != subsystem) {
       // Request is limiting subsystem.
       continue;
     }
-    genControlInfo(sub, results, config);
+    genControlPaths(sub, controls);
   }
+  genControlRows(controls, results, config);
 }
 
 void genControlInfoFromName(const std::string& name,
@@ -113,7 +127,9 @@ void genControlInfoFromName(const std::string& name,
   std::replace(name_path.begin(), name_path.end(), '.', '/');
   auto mib_path = fs::path(kSystemControlPath) / name_path;
 
-  genControlInfo(mib_path.string(), results, config);
+  std::vector<BatchFileRead> controls;
+  genControlPaths(mib_path.string(), controls);
+  genControlRows(controls, results, config);
 }
 }
 }
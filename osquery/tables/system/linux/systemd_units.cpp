@@ -9,41 +9,20 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
-#include <osquery/tables/system/linux/dbus/methods/getstringproperty.h>
-#include <osquery/tables/system/linux/dbus/methods/listunitsmethodhandler.h>
+#include <osquery/tables/system/linux/dbus/systemdunitlist.h>
 
 namespace osquery {
 
 namespace tables {
 
-namespace {
-struct PropertyQueryDesc final {
-  std::string property_name;
-  std::string column_name;
-  std::string interface;
-};
-
-const std::vector<PropertyQueryDesc> kStringPropertyQueryList = {
-    {"FragmentPath", "fragment_path", "org.freedesktop.systemd1.Unit"},
-    {"SourcePath", "source_path", "org.freedesktop.systemd1.Unit"},
-    {"User", "user", "org.freedesktop.systemd1.Service"},
-};
-} // namespace
-
 TableRows genSystemdUnits(QueryContext& context) {
-  UniqueDbusConnection connection;
-  auto status = UniqueDbusConnection::create(connection, true);
-  if (!status.ok()) {
-    LOG(ERROR) << "Failed to generate the systemd unit list: "
-               << status.getMessage();
-    return {};
+  std::set<std::string> ids;
+  if (context.hasConstraint("id", EQUALS)) {
+    ids = context.constraints["id"].getAll(EQUALS);
   }
 
-  ListUnitsMethod::Output unit_list;
-  ListUnitsMethod list_units_method;
-  status = list_units_method.call(
-      unit_list, connection, "/org/freedesktop/systemd1");
-
+  std::vector<SystemdUnit> unit_list;
+  auto status = SystemdUnitList::get().list(unit_list, ids);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to generate the systemd unit list: "
                << status.getMessage();
@@ -52,7 +31,8 @@ TableRows genSystemdUnits(QueryContext& context) {
 
   TableRows results;
 
-  for (const auto& unit : unit_list) {
+  for (const auto& entry : unit_list) {
+    const auto& unit = entry.unit;
     auto row = make_table_row();
 
     row["id"] = TEXT(unit.id);
@@ -65,23 +45,9 @@ TableRows genSystemdUnits(QueryContext& context) {
     row["job_id"] = BIGINT(unit.job_id);
     row["job_type"] = TEXT(unit.job_type);
     row["job_path"] = TEXT(unit.job_path);
-
-    for (const auto& query : kStringPropertyQueryList) {
-      std::string property_value;
-      GetStringPropertyMethod get_string_property_method;
-      status = get_string_property_method.call(property_value,
-                                               connection,
-                                               unit.path,
-                                               query.interface,
-                                               query.property_name);
-
-      if (!status.ok() && query.property_name != "User") {
-        LOG(ERROR) << "Failed to query the property " << query.property_name
-                   << " on the following systemd unit: " << unit.path;
-      }
-
-      row[query.column_name] = TEXT(property_value);
-    }
+    row["fragment_path"] = TEXT(entry.fragment_path);
+    row["user"] = TEXT(entry.user);
+    row["source_path"] = TEXT(entry.source_path);
 
     results.push_back(std::move(row));
   }
@@ -7,78 +7,53 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <pwd.h>
-
-#include <mutex>
-
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
+#include <osquery/tables/system/posix/accounts.h>
 #include <osquery/utils/conversions/tryto.h>
-#include <osquery/utils/mutex.h>
 
 namespace osquery {
 namespace tables {
 
-Mutex pwdEnumerationMutex;
-
-void genUser(const struct passwd* pwd, QueryData& results) {
+void genUser(const PasswdEntry& user, QueryData& results) {
   Row r;
-  r["uid"] = BIGINT(pwd->pw_uid);
-  r["gid"] = BIGINT(pwd->pw_gid);
-  r["uid_signed"] = BIGINT((int32_t)pwd->pw_uid);
-  r["gid_signed"] = BIGINT((int32_t)pwd->pw_gid);
-
-  if (pwd->pw_name != nullptr) {
-    r["username"] = TEXT(pwd->pw_name);
-  }
-
-  if (pwd->pw_gecos != nullptr) {
-    r["description"] = TEXT(pwd->pw_gecos);
-  }
-
-  if (pwd->pw_dir != nullptr) {
-    r["directory"] = TEXT(pwd->pw_dir);
-  }
-
-  if (pwd->pw_shell != nullptr) {
-    r["shell"] = TEXT(pwd->pw_shell);
-  }
+  r["uid"] = BIGINT(user.uid);
+  r["gid"] = BIGINT(user.gid);
+  r["uid_signed"] = BIGINT((int32_t)user.uid);
+  r["gid_signed"] = BIGINT((int32_t)user.gid);
+  r["username"] = TEXT(user.name);
+  r["description"] = TEXT(user.description);
+  r["directory"] = TEXT(user.directory);
+  r["shell"] = TEXT(user.shell);
   results.push_back(r);
 }
 
 QueryData genUsers(QueryContext& context) {
   QueryData results;
 
-  struct passwd* pwd = nullptr;
   if (context.constraints["uid"].exists(EQUALS)) {
     auto uids = context.constraints["uid"].getAll(EQUALS);
     for (const auto& uid : uids) {
       auto const auid_exp = tryTo<long>(uid, 10);
       if (auid_exp.isValue()) {
-        WriteLock lock(pwdEnumerationMutex);
-        pwd = getpwuid(auid_exp.get());
-        if (pwd != nullptr) {
-          genUser(pwd, results);
+        auto user = getPasswdByUid(auid_exp.get());
+        if (user) {
+          genUser(*user, results);
         }
       }
     }
   } else if (context.constraints["username"].exists(EQUALS)) {
     auto usernames = context.constraints["username"].getAll(EQUALS);
     for (const auto& username : usernames) {
-      WriteLock lock(pwdEnumerationMutex);
-      pwd = getpwnam(username.c_str());
-      if (pwd != nullptr) {
-        genUser(pwd, results);
+      auto user = getPasswdByName(username);
+      if (user) {
+        genUser(*user, results);
       }
     }
   } else {
-    WriteLock lock(pwdEnumerationMutex);
-    pwd = getpwent();
-    while (pwd != nullptr) {
-      genUser(pwd, results);
-      pwd = getpwent();
+    for (const auto& user : *getPasswdEntries()) {
+      genUser(user, results);
     }
-    endpwent();
   }
 
   return results;
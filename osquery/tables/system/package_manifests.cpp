@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// clang-format off
+#include <sys/types.h>
+#include <sys/stat.h>
+// clang-format on
+
+#include <osquery/core/flags.h>
+#include <osquery/core/tables.h>
+#include <osquery/tables/system/package_manifests.h>
+
+#if defined(WIN32)
+#define stat _stat
+#endif
+
+namespace osquery {
+
+FLAG(uint32,
+     package_manifest_cache_max,
+     100000,
+     "Number of parsed package manifests cached by each package table");
+
+namespace tables {
+
+/// Independently locked shards of a manifest cache.
+const size_t kManifestCacheShards{8};
+
+PackageManifestCache::PackageManifestCache(size_t capacity, Parser parser)
+    : parser_(std::move(parser)) {
+  if (capacity > 0) {
+    cache_ = std::make_unique<caches::ShardedClock<std::string, Manifest>>(
+        capacity, kManifestCacheShards);
+  }
+}
+
+Status PackageManifestCache::parseManifest(const std::string& path, Row& r) {
+  struct stat st;
+  if (cache_ == nullptr || stat(path.c_str(), &st) != 0) {
+    return parser_(path, r);
+  }
+
+  Manifest manifest;
+  if (cache_->get(path, manifest) &&
+      manifest.device == static_cast<std::uint64_t>(st.st_dev) &&
+      manifest.inode == static_cast<std::uint64_t>(st.st_ino) &&
+      manifest.size == static_cast<std::int64_t>(st.st_size) &&
+      manifest.mtime == static_cast<std::int64_t>(st.st_mtime)) {
+    r = std::move(manifest.row);
+    return manifest.status;
+  }
+
+  manifest.device = static_cast<std::uint64_t>(st.st_dev);
+  manifest.inode = static_cast<std::uint64_t>(st.st_ino);
+  manifest.size = static_cast<std::int64_t>(st.st_size);
+  manifest.mtime = static_cast<std::int64_t>(st.st_mtime);
+  manifest.row.clear();
+  manifest.status = parser_(path, manifest.row);
+
+  r = manifest.row;
+  auto status = manifest.status;
+  cache_->insert(path, std::move(manifest));
+  return status;
+}
+
+std::vector<Status> PackageManifestCache::parse(
+    const std::vector<std::string>& paths, std::vector<Row>& rows) {
+  std::vector<Status> statuses(paths.size());
+  rows.assign(paths.size(), Row());
+  runTableTasks(paths.size(), [this, &paths, &rows, &statuses](size_t i) {
+    statuses[i] = parseManifest(paths[i], rows[i]);
+  });
+  return statuses;
+}
+} // namespace tables
+} // namespace osquery
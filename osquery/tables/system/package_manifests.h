@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/utils/caches/clock.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Parses package manifests, reusing the rows of unchanged ones.
+ *
+ * Package tables such as npm_packages and python_packages read one manifest
+ * per installed package. The parsed row of each manifest is cached by path
+ * and reused while the manifest's device, inode, size and mtime are
+ * unchanged; new or changed manifests are parsed on the table workers.
+ */
+class PackageManifestCache {
+ public:
+  /// Parses the manifest at a path into a row, called from any thread.
+  using Parser = std::function<Status(const std::string& path, Row& r)>;
+
+  /**
+   * @param capacity the max number of cached manifests, 0 disables caching.
+   * @param parser the manifest parser.
+   */
+  PackageManifestCache(size_t capacity, Parser parser);
+
+  /**
+   * @brief Get the rows of many manifests.
+   *
+   * @param paths the manifest paths.
+   * @param rows set to the row of each manifest, in path order.
+   * @return the parser status of each manifest, in path order.
+   */
+  std::vector<Status> parse(const std::vector<std::string>& paths,
+                            std::vector<Row>& rows);
+
+ private:
+  struct Manifest {
+    std::uint64_t device{0};
+    std::uint64_t inode{0};
+    std::int64_t size{0};
+    std::int64_t mtime{0};
+    Status status;
+    Row row;
+  };
+
+  /// Parse the manifest at path, or copy its cached row.
+  Status parseManifest(const std::string& path, Row& r);
+
+ private:
+  Parser parser_;
+
+  /// Manifest path => parsed manifest, nullptr when caching is disabled.
+  std::unique_ptr<caches::ShardedClock<std::string, Manifest>> cache_;
+};
+} // namespace tables
+} // namespace osquery
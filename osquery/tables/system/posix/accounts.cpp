@@ -0,0 +1,342 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <unordered_map>
+
+#include <grp.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/system/posix/accounts.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     nss_cache_ttl,
+     60,
+     "Seconds user and group lookups are cached for (0 disables the cache)");
+
+namespace tables {
+
+namespace {
+
+/// Local account databases, a change drops the cache before the TTL.
+const std::vector<std::string> kAccountPaths = {"/etc/passwd", "/etc/group"};
+
+/// Reentrant lookups start with this buffer and double it on ERANGE.
+const size_t kLookupBufferSize{16384};
+
+/// Groups with many members need large buffers, stop somewhere.
+const size_t kMaxLookupBufferSize{16 * 1024 * 1024};
+
+/// Upper bound for the groups of a user, the Linux NGROUPS_MAX.
+const int kMaxUserGroups{65536};
+
+PasswdEntry makePasswdEntry(const struct passwd& pwd) {
+  PasswdEntry entry;
+  entry.uid = pwd.pw_uid;
+  entry.gid = pwd.pw_gid;
+  entry.name = pwd.pw_name != nullptr ? pwd.pw_name : "";
+  entry.description = pwd.pw_gecos != nullptr ? pwd.pw_gecos : "";
+  entry.directory = pwd.pw_dir != nullptr ? pwd.pw_dir : "";
+  entry.shell = pwd.pw_shell != nullptr ? pwd.pw_shell : "";
+  return entry;
+}
+
+GroupEntry makeGroupEntry(const struct group& grp) {
+  GroupEntry entry;
+  entry.gid = grp.gr_gid;
+  entry.name = grp.gr_name != nullptr ? grp.gr_name : "";
+  return entry;
+}
+
+/**
+ * @brief Run a getpwuid_r style lookup, growing the buffer as needed.
+ *
+ * Returns false if the lookup failed, rather than not finding the entry.
+ * Failures, such as an unreachable directory, are not cached.
+ */
+template <typename Record, typename Entry, typename Lookup, typename Make>
+bool lookupEntry(Lookup lookup, Make make, std::optional<Entry>& entry) {
+  std::vector<char> buffer(kLookupBufferSize);
+  while (true) {
+    Record record;
+    Record* result = nullptr;
+    int error = lookup(&record, buffer.data(), buffer.size(), &result);
+    if (error == ERANGE && buffer.size() < kMaxLookupBufferSize) {
+      buffer.resize(buffer.size() * 2);
+      continue;
+    }
+
+    // Some NSS modules report a missing entry as ENOENT.
+    if (error != 0 && error != ENOENT) {
+      return false;
+    }
+
+    entry = std::nullopt;
+    if (result != nullptr) {
+      entry = make(*result);
+    }
+    return true;
+  }
+}
+
+std::vector<gid_t> lookupGroupList(const PasswdEntry& user) {
+#ifdef __APPLE__
+  using group_id = int;
+#else
+  using group_id = gid_t;
+#endif
+
+  std::vector<group_id> groups(64);
+  while (true) {
+    auto size = static_cast<int>(groups.size());
+    int count = size;
+    if (::getgrouplist(user.name.c_str(),
+                       static_cast<group_id>(user.gid),
+                       groups.data(),
+                       &count) >= 0) {
+      groups.resize(static_cast<size_t>(std::max(count, 0)));
+      break;
+    }
+
+    // glibc reports the count needed, other platforms do not.
+    if (size >= kMaxUserGroups) {
+      return {};
+    }
+    groups.resize(static_cast<size_t>(std::max(count, size * 2)));
+  }
+  return std::vector<gid_t>(groups.begin(), groups.end());
+}
+
+std::string getAccountsFingerprint() {
+  std::string fingerprint;
+  for (const auto& path : kAccountPaths) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+      fingerprint += "-;";
+      continue;
+    }
+
+    fingerprint += std::to_string(st.st_ino) + ":" +
+                   std::to_string(st.st_size) + ":" +
+                   std::to_string(st.st_mtime) + ":" +
+                   std::to_string(st.st_ctime) + ";";
+  }
+  return fingerprint;
+}
+
+class AccountCache final {
+ public:
+  static AccountCache& get() {
+    static AccountCache cache;
+    return cache;
+  }
+
+  AccountCache(const AccountCache&) = delete;
+  AccountCache& operator=(const AccountCache&) = delete;
+
+  std::optional<PasswdEntry> getPasswdByUid(uid_t uid) {
+    WriteLock lock(mutex_);
+    refresh();
+
+    auto it = users_by_uid_.find(uid);
+    if (it != users_by_uid_.end()) {
+      return it->second;
+    }
+
+    std::optional<PasswdEntry> user;
+    auto lookup = [uid](auto... args) { return ::getpwuid_r(uid, args...); };
+    if (lookupEntry<struct passwd>(lookup, makePasswdEntry, user)) {
+      users_by_uid_.emplace(uid, user);
+    }
+    return user;
+  }
+
+  std::optional<PasswdEntry> getPasswdByName(const std::string& name) {
+    WriteLock lock(mutex_);
+    refresh();
+
+    auto it = users_by_name_.find(name);
+    if (it != users_by_name_.end()) {
+      return it->second;
+    }
+
+    std::optional<PasswdEntry> user;
+    auto lookup = [&name](auto... args) {
+      return ::getpwnam_r(name.c_str(), args...);
+    };
+    if (lookupEntry<struct passwd>(lookup, makePasswdEntry, user)) {
+      users_by_name_.emplace(name, user);
+    }
+    return user;
+  }
+
+  PasswdEntries getPasswdEntries() {
+    WriteLock lock(mutex_);
+    refresh();
+
+    if (users_ == nullptr) {
+      auto users = std::make_shared<std::vector<PasswdEntry>>();
+      ::setpwent();
+      for (auto pwd = ::getpwent(); pwd != nullptr; pwd = ::getpwent()) {
+        users->push_back(makePasswdEntry(*pwd));
+      }
+      ::endpwent();
+
+      // Like getpwuid, the first entry of a duplicated id is returned.
+      for (const auto& user : *users) {
+        users_by_uid_.emplace(user.uid, user);
+        users_by_name_.emplace(user.name, user);
+      }
+      users_ = std::move(users);
+    }
+    return users_;
+  }
+
+  std::optional<GroupEntry> getGroupByGid(gid_t gid) {
+    WriteLock lock(mutex_);
+    refresh();
+
+    auto it = groups_by_gid_.find(gid);
+    if (it != groups_by_gid_.end()) {
+      return it->second;
+    }
+
+    std::optional<GroupEntry> group;
+    auto lookup = [gid](auto... args) { return ::getgrgid_r(gid, args...); };
+    if (lookupEntry<struct group>(lookup, makeGroupEntry, group)) {
+      groups_by_gid_.emplace(gid, group);
+    }
+    return group;
+  }
+
+  GroupEntries getGroupEntries() {
+    WriteLock lock(mutex_);
+    refresh();
+
+    if (groups_ == nullptr) {
+      auto groups = std::make_shared<std::vector<GroupEntry>>();
+      ::setgrent();
+      for (auto grp = ::getgrent(); grp != nullptr; grp = ::getgrent()) {
+        groups->push_back(makeGroupEntry(*grp));
+      }
+      ::endgrent();
+
+      for (const auto& group : *groups) {
+        groups_by_gid_.emplace(group.gid, group);
+      }
+      groups_ = std::move(groups);
+    }
+    return groups_;
+  }
+
+  std::vector<gid_t> getGroupList(const PasswdEntry& user) {
+    WriteLock lock(mutex_);
+    refresh();
+
+    auto key = user.name + ":" + std::to_string(user.gid);
+    auto it = group_lists_.find(key);
+    if (it != group_lists_.end()) {
+      return it->second;
+    }
+
+    auto groups = lookupGroupList(user);
+    group_lists_.emplace(key, groups);
+    return groups;
+  }
+
+  void clear() {
+    WriteLock lock(mutex_);
+    reset();
+  }
+
+ private:
+  AccountCache() = default;
+
+  /// Drop the lookups once they expire or the local databases change.
+  void refresh() {
+    auto now = std::chrono::steady_clock::now();
+    auto fingerprint = getAccountsFingerprint();
+    if (FLAGS_nss_cache_ttl == 0 || now >= expires_ ||
+        fingerprint != fingerprint_) {
+      reset();
+      fingerprint_ = std::move(fingerprint);
+      expires_ = now + std::chrono::seconds(FLAGS_nss_cache_ttl);
+    }
+  }
+
+  void reset() {
+    users_.reset();
+    groups_.reset();
+    users_by_uid_.clear();
+    users_by_name_.clear();
+    groups_by_gid_.clear();
+    group_lists_.clear();
+    fingerprint_.clear();
+    expires_ = {};
+  }
+
+ private:
+  /// Also serializes the non-reentrant enumerations.
+  Mutex mutex_;
+
+  std::string fingerprint_;
+  std::chrono::steady_clock::time_point expires_;
+
+  PasswdEntries users_;
+  GroupEntries groups_;
+
+  /// Lookups by id or name, std::nullopt records an unknown one.
+  std::unordered_map<uid_t, std::optional<PasswdEntry>> users_by_uid_;
+  std::unordered_map<std::string, std::optional<PasswdEntry>> users_by_name_;
+  std::unordered_map<gid_t, std::optional<GroupEntry>> groups_by_gid_;
+
+  /// Group lists by user name and primary group.
+  std::unordered_map<std::string, std::vector<gid_t>> group_lists_;
+};
+
+} // namespace
+
+std::optional<PasswdEntry> getPasswdByUid(uid_t uid) {
+  return AccountCache::get().getPasswdByUid(uid);
+}
+
+std::optional<PasswdEntry> getPasswdByName(const std::string& name) {
+  return AccountCache::get().getPasswdByName(name);
+}
+
+PasswdEntries getPasswdEntries() {
+  return AccountCache::get().getPasswdEntries();
+}
+
+std::optional<GroupEntry> getGroupByGid(gid_t gid) {
+  return AccountCache::get().getGroupByGid(gid);
+}
+
+GroupEntries getGroupEntries() {
+  return AccountCache::get().getGroupEntries();
+}
+
+std::vector<gid_t> getGroupList(const PasswdEntry& user) {
+  return AccountCache::get().getGroupList(user);
+}
+
+void clearAccountCache() {
+  AccountCache::get().clear();
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace osquery {
+namespace tables {
+
+/// A user account, as resolved through NSS.
+struct PasswdEntry {
+  uid_t uid{0};
+  gid_t gid{0};
+  std::string name;
+  std::string description;
+  std::string directory;
+  std::string shell;
+};
+
+/// A group, as resolved through NSS.
+struct GroupEntry {
+  gid_t gid{0};
+  std::string name;
+};
+
+using PasswdEntries = std::shared_ptr<const std::vector<PasswdEntry>>;
+using GroupEntries = std::shared_ptr<const std::vector<GroupEntry>>;
+
+/**
+ * @brief User and group lookups shared by the tables.
+ *
+ * NSS lookups may be answered by SSSD or LDAP, where each one can take
+ * milliseconds and an enumeration can take seconds. Results, including
+ * unknown ids, are kept for --nss_cache_ttl seconds, and dropped early when
+ * /etc/passwd or /etc/group change.
+ *
+ * An enumeration also answers the lookups of the ids it returned. Ids it did
+ * not return are still looked up, directories may not enumerate every user.
+ */
+std::optional<PasswdEntry> getPasswdByUid(uid_t uid);
+
+std::optional<PasswdEntry> getPasswdByName(const std::string& name);
+
+/// Enumerate the users, as getpwent returns them.
+PasswdEntries getPasswdEntries();
+
+std::optional<GroupEntry> getGroupByGid(gid_t gid);
+
+/// Enumerate the groups, as getgrent returns them.
+GroupEntries getGroupEntries();
+
+/// The groups of a user, as getgrouplist returns them.
+std::vector<gid_t> getGroupList(const PasswdEntry& user);
+
+/// Drop every cached lookup.
+void clearAccountCache();
+
+} // namespace tables
+} // namespace osquery
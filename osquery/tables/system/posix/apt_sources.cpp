@@ -8,9 +8,11 @@
  */
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/mapped_file.h>
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/posix/apt_sources.h>
 #include <osquery/utils/conversions/join.h>
@@ -139,12 +141,21 @@ void genAptUrl(const std::string& source,
     return;
   }
 
-  std::string content;
-  if (!readFile(cache_files[0], content)) {
+  // Release files list the hash of every index, only the header is parsed.
+  MappedFile release;
+  if (!release.open(cache_files[0]).ok()) {
     return;
   }
 
-  for (const auto& header : osquery::split(content, "\n")) {
+  auto content = release.data();
+  for (size_t start = 0, end = 0; start < content.size(); start = end + 1) {
+    end = content.find('\n', start);
+    if (end == std::string_view::npos) {
+      end = content.size();
+    }
+
+    auto header = std::string(content.substr(start, end - start));
+    boost::algorithm::trim(header);
     if (header.empty()) {
       continue;
     }
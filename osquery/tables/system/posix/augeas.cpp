@@ -8,17 +8,23 @@
  */
 
 #include <augeas.h>
+#include <fnmatch.h>
 
+#include <map>
 #include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -41,6 +47,52 @@ FLAG(string,
 
 namespace tables {
 
+/// Files loaded for scoped queries before every lens file is loaded instead.
+const size_t kMaxScopedAugeasFiles{256};
+
+/// Tree paths with these are patterns and may match any loaded file.
+const std::string kAugeasPatternChars{"*?[]|$()"};
+
+/// The filesystem path of a literal "/files" tree path, empty otherwise.
+std::string getAugeasFilePath(const std::string& node) {
+  if (node.size() <= 7 || !boost::starts_with(node, "/files/") ||
+      node.find_first_of(kAugeasPatternChars) != std::string::npos ||
+      node.find("//") != std::string::npos) {
+    return "";
+  }
+  return node.substr(6);
+}
+
+/**
+ * @brief Add the files of a transform that a requested path needs.
+ *
+ * A requested path is a file, a directory, or a node within a file. Every
+ * leading part of it that a transform's include glob matches is a file to
+ * load. For a directory, the globs under it are kept as they are.
+ */
+bool addAugeasIncludes(const std::vector<std::string>& globs,
+                       const std::string& path,
+                       std::set<std::string>& includes) {
+  bool added = false;
+  for (const auto& glob : globs) {
+    if (boost::starts_with(glob, path + "/")) {
+      added |= includes.insert(glob).second;
+      continue;
+    }
+
+    for (auto end = path.find('/', 1);; end = path.find('/', end + 1)) {
+      auto prefix = path.substr(0, end);
+      if (::fnmatch(glob.c_str(), prefix.c_str(), FNM_PATHNAME) == 0) {
+        added |= includes.insert(prefix).second;
+      }
+      if (end == std::string::npos) {
+        break;
+      }
+    }
+  }
+  return added;
+}
+
 void reportAugeasError(augeas* aug) {
   const char* error_message = aug_error_message(aug);
   LOG(ERROR) << "An error has occurred while trying to query augeas: "
@@ -118,6 +170,9 @@ class AugeasHandle {
   augeas* aug{nullptr};
   bool error{false};
 
+  /// Queries share the tree, and its loaded files, one at a time.
+  Mutex mutex;
+
   void initialize() {
     std::call_once(initialized, [this]() {
       this->aug = aug_init(
@@ -134,16 +189,116 @@ class AugeasHandle {
             << "An error has occurred while trying to initialize augeas: "
             << aug_error_message(this->aug);
         aug_close(this->aug);
+      } else {
+        readTransforms();
       }
     });
   }
 
+  /**
+   * @brief Load the files requested paths need, or every lens file.
+   *
+   * The transforms under /augeas/load are narrowed to the files queries asked
+   * for so far, a query for /etc/hosts does not parse every configuration
+   * file. Augeas keeps loaded files and only parses them again when their
+   * mtime changes. Once every file is loaded the transforms stay complete.
+   *
+   * @param paths filesystem paths, empty to load every file.
+   */
+  void load(const std::vector<std::string>& paths) {
+    if (!paths.empty() && !complete_) {
+      bool added = !scoped_;
+      for (auto& transform : transforms_) {
+        for (const auto& path : paths) {
+          added |= addAugeasIncludes(
+              transform.globs, path, scoped_includes_[transform.name]);
+        }
+      }
+
+      size_t files = 0;
+      for (const auto& includes : scoped_includes_) {
+        files += includes.second.size();
+      }
+
+      if (files <= kMaxScopedAugeasFiles) {
+        if (added) {
+          for (const auto& transform : transforms_) {
+            setIncludes(transform.name, scoped_includes_[transform.name]);
+          }
+        }
+        scoped_ = true;
+        aug_load(aug);
+        return;
+      }
+    }
+
+    if (!complete_) {
+      for (const auto& transform : transforms_) {
+        setIncludes(transform.name,
+                    {transform.globs.begin(), transform.globs.end()});
+      }
+      scoped_includes_.clear();
+      complete_ = true;
+    }
+    aug_load(aug);
+  }
+
   ~AugeasHandle() {
     aug_close(aug);
   }
 
  private:
+  struct Transform {
+    std::string name;
+    std::vector<std::string> globs;
+  };
+
+  /// Keep the include globs of each lens transform.
+  void readTransforms() {
+    char** names = nullptr;
+    int count = aug_match(aug, "/augeas/load/*", &names);
+    for (int i = 0; i < count; i++) {
+      Transform transform;
+      transform.name = names[i];
+      free(names[i]);
+
+      char** incls = nullptr;
+      auto incl_path = transform.name + "/incl";
+      int incl_count = aug_match(aug, incl_path.c_str(), &incls);
+      for (int j = 0; j < incl_count; j++) {
+        const char* glob = nullptr;
+        if (aug_get(aug, incls[j], &glob) == 1 && glob != nullptr) {
+          transform.globs.push_back(glob);
+        }
+        free(incls[j]);
+      }
+      free(incls);
+      transforms_.push_back(std::move(transform));
+    }
+    free(names);
+  }
+
+  void setIncludes(const std::string& name,
+                   const std::set<std::string>& includes) {
+    aug_rm(aug, (name + "/incl").c_str());
+    auto incl_path = name + "/incl[last()+1]";
+    for (const auto& include : includes) {
+      aug_set(aug, incl_path.c_str(), include.c_str());
+    }
+  }
+
   std::once_flag initialized;
+
+  std::vector<Transform> transforms_;
+
+  /// The files loaded for each transform while the tree is scoped.
+  std::map<std::string, std::set<std::string>> scoped_includes_;
+
+  /// The transforms were narrowed to requested files.
+  bool scoped_{false};
+
+  /// The transforms load every lens file.
+  bool complete_{false};
 };
 
 static AugeasHandle kAugeasHandle;
@@ -156,14 +311,24 @@ QueryData genAugeas(QueryContext& context) {
   }
 
   augeas* aug = kAugeasHandle.aug;
-  aug_load(aug);
+  WriteLock lock(kAugeasHandle.mutex);
 
   QueryData results;
   std::unordered_set<std::string> patterns;
 
+  // Only the files of literal nodes and paths are loaded.
+  std::vector<std::string> file_paths;
+  bool scoped = true;
+
   if (context.hasConstraint("node", EQUALS)) {
     auto nodes = context.constraints["node"].getAll(EQUALS);
     patterns.insert(nodes.begin(), nodes.end());
+
+    for (const auto& node : nodes) {
+      auto file_path = getAugeasFilePath(node);
+      scoped &= !file_path.empty();
+      file_paths.push_back(std::move(file_path));
+    }
   }
 
   if (context.hasConstraint("path", EQUALS)) {
@@ -172,6 +337,10 @@ QueryData genAugeas(QueryContext& context) {
     std::ostringstream pattern;
 
     for (const auto& path : paths) {
+      auto file_path = getAugeasFilePath("/files" + path);
+      scoped &= !file_path.empty();
+      file_paths.push_back(std::move(file_path));
+
       pattern << "/files" << path;
       patterns.insert(pattern.str());
 
@@ -186,6 +355,11 @@ QueryData genAugeas(QueryContext& context) {
     }
   }
 
+  if (patterns.empty() || !scoped) {
+    file_paths.clear();
+  }
+  kAugeasHandle.load(file_paths);
+
   if (patterns.empty()) {
     matchAugeasPattern(aug, "/files//*", results, context);
   } else {
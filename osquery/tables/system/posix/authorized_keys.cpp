@@ -50,20 +50,15 @@ void genSSHkeysForUser(const std::string& uid,
 }
 
 QueryData getAuthorizedKeys(QueryContext& context) {
-  QueryData results;
-
   // Iterate over each user
-  QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto directory = row.find("directory");
-    if (uid != row.end() && gid != row.end() && directory != row.end()) {
-      genSSHkeysForUser(uid->second, gid->second, directory->second, results);
-    }
-  }
-
-  return results;
+  return generateForUsers(
+      usersFromContext(context), [](const Row& row, QueryData& results) {
+        auto gid = row.find("gid");
+        if (gid != row.end()) {
+          genSSHkeysForUser(
+              row.at("uid"), gid->second, row.at("directory"), results);
+        }
+      });
 }
 }
 }
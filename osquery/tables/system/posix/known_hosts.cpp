@@ -52,21 +52,15 @@ void genSSHkeysForHosts(const std::string& uid,
 } // namespace impl
 
 QueryData getKnownHostsKeys(QueryContext& context) {
-  QueryData results;
-
   // Iterate over each user
-  auto users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto directory = row.find("directory");
-    if (uid != row.end() && gid != row.end() && directory != row.end()) {
-      impl::genSSHkeysForHosts(
-          uid->second, gid->second, directory->second, results);
-    }
-  }
-
-  return results;
+  return generateForUsers(
+      usersFromContext(context), [](const Row& row, QueryData& results) {
+        auto gid = row.find("gid");
+        if (gid != row.end()) {
+          impl::genSSHkeysForHosts(
+              row.at("uid"), gid->second, row.at("directory"), results);
+        }
+      });
 }
 }
 }
@@ -7,12 +7,20 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstring>
+
 #include <utmpx.h>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
+#include <osquery/filesystem/posix/file_tail.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
+
+DECLARE_bool(incremental_history_tables);
+
 namespace tables {
 
 namespace impl {
@@ -32,8 +40,62 @@ void genLastAccessForRow(const utmpx& ut, QueryData& results) {
 
 } // namespace impl
 
+#if !defined(__APPLE__) && !defined(__FreeBSD__)
+/// The rows of the wtmp file, extended as records are appended.
+struct TailedLogins {
+  FileTail tail;
+
+  /// A record partially written when the file was read.
+  std::string partial;
+
+  QueryData rows;
+};
+
+Mutex kTailedLoginsMutex;
+TailedLogins kTailedLogins;
+
+/// Parse the records appended to the wtmp file since the last query.
+Status genTailedLastAccess(QueryData& results) {
+  WriteLock lock(kTailedLoginsMutex);
+  auto& logins = kTailedLogins;
+
+  std::string data;
+  bool restarted = false;
+  auto status = logins.tail.read(_PATH_WTMP, data, restarted);
+  if (!status.ok()) {
+    logins = TailedLogins();
+    return status;
+  }
+
+  if (restarted) {
+    logins.partial.clear();
+    logins.rows.clear();
+  }
+
+  // The file holds utmpx records, as read by getutxent.
+  logins.partial.append(data);
+  size_t offset = 0;
+  for (; offset + sizeof(struct utmpx) <= logins.partial.size();
+       offset += sizeof(struct utmpx)) {
+    struct utmpx ut;
+    memcpy(&ut, logins.partial.data() + offset, sizeof(ut));
+    impl::genLastAccessForRow(ut, logins.rows);
+  }
+  logins.partial.erase(0, offset);
+
+  results = logins.rows;
+  return Status::success();
+}
+#endif
+
 QueryData genLastAccess(QueryContext& context) {
   QueryData results;
+#if !defined(__APPLE__) && !defined(__FreeBSD__)
+  if (FLAGS_incremental_history_tables && genTailedLastAccess(results).ok()) {
+    return results;
+  }
+#endif
+
   struct utmpx* ut;
 #ifdef __APPLE__
   setutxent_wtmp(0); // 0 = reverse chronological order
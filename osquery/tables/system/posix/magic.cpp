@@ -8,8 +8,14 @@
  */
 
 #include <magic.h>
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
 #include <numeric>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <boost/algorithm/string/join.hpp>
@@ -17,6 +23,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 namespace tables {
@@ -29,63 +36,234 @@ const std::vector<std::string> kMagicFiles = {
 };
 
 constexpr char const* kMagicFileDBSep = ":";
+
+/// Idle cookies kept for each set of magic databases.
+const size_t kMaxIdleCookies{4};
+
+/// Paths are classified on several threads, each taking at least this many.
+const size_t kPathsPerThread{32};
+
+/// Threads used at most to classify paths.
+const size_t kMaxMagicThreads{4};
+
+/// Fingerprint the magic database files, a changed file needs a reload.
+std::string getMagicFingerprint(const std::vector<std::string>& files) {
+  std::string fingerprint;
+  for (const auto& path : files) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+      fingerprint += "-;";
+      continue;
+    }
+
+    fingerprint += std::to_string(st.st_dev) + ":" +
+                   std::to_string(st.st_ino) + ":" +
+                   std::to_string(st.st_size) + ":" +
+                   std::to_string(st.st_mtime) + ";";
+  }
+  return fingerprint;
+}
+
+/**
+ * @brief Loaded libmagic cookies, kept for the next query.
+ *
+ * Loading the compiled magic database costs far more than classifying a few
+ * files and the table is often joined against file results. A cookie is not
+ * thread safe, so each is used by one query at a time and returned after.
+ * Cookies are dropped when a magic database file changes.
+ */
+class MagicCookieCache final {
+ public:
+  using Key = std::pair<int, std::string>;
+
+  static MagicCookieCache& get() {
+    static MagicCookieCache cache;
+    return cache;
+  }
+
+  ~MagicCookieCache() {
+    for (auto& entry : entries_) {
+      for (auto cookie : entry.second.idle) {
+        magic_close(cookie);
+      }
+    }
+  }
+
+  /// Take a cookie loaded with the databases, nullptr if they cannot load.
+  magic_t acquire(int flags,
+                  const std::vector<std::string>& files,
+                  const std::string& db_files,
+                  std::string& fingerprint) {
+    fingerprint = getMagicFingerprint(files);
+    Key key(flags, db_files);
+    {
+      WriteLock lock(mutex_);
+      auto& entry = entries_[key];
+      if (entry.fingerprint != fingerprint) {
+        for (auto cookie : entry.idle) {
+          magic_close(cookie);
+        }
+        entry.idle.clear();
+        entry.fingerprint = fingerprint;
+      }
+
+      if (!entry.idle.empty()) {
+        auto cookie = entry.idle.back();
+        entry.idle.pop_back();
+        return cookie;
+      }
+    }
+
+    // Load without the lock, other queries may use their cookies meanwhile.
+    magic_t cookie = magic_open(flags);
+    if (cookie == nullptr) {
+      VLOG(1) << "Unable to initialize magic library";
+      return nullptr;
+    }
+
+    if (magic_load(cookie, db_files.c_str()) != 0) {
+      LOG(WARNING) << "Unable to load magic list of database: " << db_files
+                   << " because: " << magic_error(cookie);
+      magic_close(cookie);
+      return nullptr;
+    }
+    return cookie;
+  }
+
+  /// Return a cookie, closed if its databases changed since it was loaded.
+  void release(int flags,
+               const std::string& db_files,
+               const std::string& fingerprint,
+               magic_t cookie) {
+    magic_setflags(cookie, flags);
+
+    WriteLock lock(mutex_);
+    auto& entry = entries_[Key(flags, db_files)];
+    if (entry.fingerprint == fingerprint &&
+        entry.idle.size() < kMaxIdleCookies) {
+      entry.idle.push_back(cookie);
+      return;
+    }
+    magic_close(cookie);
+  }
+
+ private:
+  MagicCookieCache() = default;
+
+  struct Entry {
+    std::string fingerprint;
+    std::vector<magic_t> idle;
+  };
+
+  Mutex mutex_;
+  std::map<Key, Entry> entries_;
+};
+
+void classifyPath(magic_t magic_cookie, const std::string& path, Row& r) {
+  magic_setflags(magic_cookie, MAGIC_NONE);
+  auto data = magic_file(magic_cookie, path.c_str());
+  if (data != nullptr) {
+    r["data"] = data;
+  }
+
+  // Retrieve MIME type
+  magic_setflags(magic_cookie, MAGIC_MIME_TYPE);
+  auto mime_type = magic_file(magic_cookie, path.c_str());
+  if (mime_type != nullptr) {
+    r["mime_type"] = mime_type;
+  }
+
+  // Retrieve MIME encoding
+  magic_setflags(magic_cookie, MAGIC_MIME_ENCODING);
+  auto mime_encoding = magic_file(magic_cookie, path.c_str());
+  if (mime_encoding != nullptr) {
+    r["mime_encoding"] = mime_encoding;
+  }
+}
 } // namespace
 
 QueryData genMagicData(QueryContext& context) {
   QueryData results;
 
-  // No default flags
-  magic_t magic_cookie = magic_open(MAGIC_NONE);
-  if (magic_cookie == nullptr) {
-    VLOG(1) << "Unable to initialize magic library";
-    return results;
-  }
-
-  std::string magic_db_files;
+  std::vector<std::string> magic_files;
   if (context.hasConstraint("magic_db_files")) {
-    auto magic_files = context.constraints["magic_db_files"].getAll(EQUALS);
-    magic_db_files = boost::algorithm::join(magic_files, kMagicFileDBSep);
+    auto constraints = context.constraints["magic_db_files"].getAll(EQUALS);
+    magic_files.assign(constraints.begin(), constraints.end());
   } else {
-    magic_db_files = boost::algorithm::join(kMagicFiles, kMagicFileDBSep);
+    magic_files = kMagicFiles;
+  }
+  auto magic_db_files = boost::algorithm::join(magic_files, kMagicFileDBSep);
+
+  // A constraint may itself hold a colon separated list of databases.
+  std::vector<std::string> fingerprint_files;
+  for (const auto& file : magic_files) {
+    size_t start = 0;
+    for (auto end = file.find(kMagicFileDBSep); end != std::string::npos;
+         start = end + 1, end = file.find(kMagicFileDBSep, start)) {
+      fingerprint_files.push_back(file.substr(start, end - start));
+    }
+    fingerprint_files.push_back(file.substr(start));
+  }
+
+  auto constrained_paths = context.constraints["path"].getAll(EQUALS);
+  std::vector<std::string> paths(constrained_paths.begin(),
+                                 constrained_paths.end());
+  if (paths.empty()) {
+    return results;
   }
 
-  if (magic_load(magic_cookie, magic_db_files.c_str()) != 0) {
-    LOG(WARNING) << "Unable to load magic list of database: " << magic_db_files
-                 << " because: " << magic_error(magic_cookie);
-    magic_close(magic_cookie);
+  // No default flags
+  auto& cache = MagicCookieCache::get();
+  std::string fingerprint;
+  magic_t magic_cookie =
+      cache.acquire(MAGIC_NONE, fingerprint_files, magic_db_files, fingerprint);
+  if (magic_cookie == nullptr) {
     return results;
   }
 
-  // Iterate through all the provided paths
-  auto paths = context.constraints["path"].getAll(EQUALS);
-  for (const auto& path_string : paths) {
-    Row r;
-    r["path"] = path_string;
-    r["magic_db_files"] = magic_db_files;
+  results.resize(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    results[i]["path"] = paths[i];
+    results[i]["magic_db_files"] = magic_db_files;
+  }
 
-    auto data = magic_file(magic_cookie, path_string.c_str());
-    if (data != nullptr) {
-      r["data"] = data;
+  auto threads = std::min(kMaxMagicThreads, paths.size() / kPathsPerThread);
+  if (threads <= 1) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      classifyPath(magic_cookie, paths[i], results[i]);
     }
+    cache.release(MAGIC_NONE, magic_db_files, fingerprint, magic_cookie);
+    return results;
+  }
 
-    // Retrieve MIME type
-    magic_setflags(magic_cookie, MAGIC_MIME_TYPE);
-    auto mime_type = magic_file(magic_cookie, path_string.c_str());
-    if (mime_type != nullptr) {
-      r["mime_type"] = mime_type;
+  // Each thread classifies the next path with its own cookie.
+  std::atomic<size_t> next{0};
+  auto worker = [&](magic_t cookie) {
+    for (auto i = next++; i < paths.size(); i = next++) {
+      classifyPath(cookie, paths[i], results[i]);
     }
+  };
 
-    // Retrieve MIME encoding
-    magic_setflags(magic_cookie, MAGIC_MIME_ENCODING);
-    auto mime_encoding = magic_file(magic_cookie, path_string.c_str());
-    if (mime_encoding != nullptr) {
-      r["mime_encoding"] = mime_encoding;
+  std::vector<std::pair<std::thread, magic_t>> workers;
+  for (size_t t = 1; t < threads; ++t) {
+    std::string worker_fingerprint;
+    auto cookie = cache.acquire(
+        MAGIC_NONE, fingerprint_files, magic_db_files, worker_fingerprint);
+    if (cookie == nullptr || worker_fingerprint != fingerprint) {
+      if (cookie != nullptr) {
+        magic_close(cookie);
+      }
+      break;
     }
-
-    results.push_back(r);
+    workers.emplace_back(std::thread(worker, cookie), cookie);
   }
+  worker(magic_cookie);
 
-  magic_close(magic_cookie);
+  for (auto& thread : workers) {
+    thread.first.join();
+    cache.release(MAGIC_NONE, magic_db_files, fingerprint, thread.second);
+  }
+  cache.release(MAGIC_NONE, magic_db_files, fingerprint, magic_cookie);
   return results;
 }
 } // namespace tables
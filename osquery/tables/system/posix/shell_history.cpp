@@ -7,18 +7,28 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
 #include <regex>
 #include <string>
 #include <vector>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/posix/file_tail.h>
 #include <osquery/tables/system/posix/shell_history.h>
 #include <osquery/tables/system/system_utils.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/system.h>
 
 namespace osquery {
+
+FLAG(bool,
+     incremental_history_tables,
+     false,
+     "Cache shell_history and last records, reading only appended data");
+
 namespace tables {
 
 const std::vector<std::string> kShellHistoryFiles = {
@@ -29,84 +39,154 @@ const std::vector<std::string> kShellHistoryFiles = {
     ".sh_history",
 };
 
-struct HistoryState {
-  std::string content;
-  std::regex bash_timestamp_rx{"^#([0-9]+)$"};
-  std::regex zsh_timestamp_rx{"^: {0,10}([0-9]{1,11}):[0-9]+;(.*)$"};
-  std::string prev_bash_timestamp;
+/// A parsed history line.
+struct HistoryEntry {
+  std::string time;
+  std::string command;
+};
+
+/// Parses history data into entries, the data may end in a partial line.
+class HistoryParser {
+ public:
+  /// Parse the complete lines of data, buffering the partial last line.
+  void parse(const std::string& data,
+             const std::function<void(HistoryEntry&)>& emit) {
+    size_t line_start = 0;
+    auto newline = data.find('\n');
+    while (newline != std::string::npos) {
+      if (partial_.empty()) {
+        parseLine(data.substr(line_start, newline - line_start), emit);
+      } else {
+        partial_.append(data, line_start, newline - line_start);
+        parseLine(std::move(partial_), emit);
+        partial_.clear();
+      }
+
+      line_start = newline + 1;
+      newline = data.find('\n', line_start);
+    }
+    partial_.append(data, line_start, std::string::npos);
+  }
+
+  /// Parse the partial last line, which is kept for the next data.
+  void parsePartial(const std::function<void(HistoryEntry&)>& emit) const {
+    if (!partial_.empty()) {
+      auto parser = *this;
+      parser.parseLine(partial_, emit);
+    }
+  }
+
+ private:
+  void parseLine(std::string line,
+                 const std::function<void(HistoryEntry&)>& emit) {
+    static const std::regex bash_timestamp_rx{"^#([0-9]+)$"};
+    static const std::regex zsh_timestamp_rx{
+        "^: {0,10}([0-9]{1,11}):[0-9]+;(.*)$"};
+
+    std::smatch bash_timestamp_matches;
+    std::smatch zsh_timestamp_matches;
+
+    if (prev_bash_timestamp_.empty() &&
+        std::regex_search(line, bash_timestamp_matches, bash_timestamp_rx)) {
+      prev_bash_timestamp_ = bash_timestamp_matches[1];
+      return;
+    }
+
+    HistoryEntry entry;
+    if (!prev_bash_timestamp_.empty()) {
+      entry.time = std::move(prev_bash_timestamp_);
+      entry.command = std::move(line);
+      prev_bash_timestamp_.clear();
+    } else if (std::regex_search(
+                   line, zsh_timestamp_matches, zsh_timestamp_rx)) {
+      entry.time = zsh_timestamp_matches[1];
+      entry.command = zsh_timestamp_matches[2];
+    } else {
+      entry.time = "0";
+      entry.command = std::move(line);
+    }
+    emit(entry);
+  }
+
+ private:
+  std::string partial_;
+  std::string prev_bash_timestamp_;
 };
 
+/// The entries of a history file, extended as the file is appended to.
+struct TailedHistory {
+  FileTail tail;
+  HistoryParser parser;
+  std::vector<HistoryEntry> entries;
+};
+
+Mutex kTailedHistoriesMutex;
+std::map<std::string, TailedHistory> kTailedHistories;
+
 void genShellHistoryFromFile(
     const std::string& uid,
     const boost::filesystem::path& history_file,
     std::function<void(DynamicTableRowHolder& row)> predicate) {
-  struct HistoryState hState;
-
-  auto parseLine =
-      [&hState, &uid, &history_file, &predicate](std::string& line) {
-        std::smatch bash_timestamp_matches;
-        std::smatch zsh_timestamp_matches;
-
-        if (hState.prev_bash_timestamp.empty() &&
-            std::regex_search(
-                line, bash_timestamp_matches, hState.bash_timestamp_rx)) {
-          hState.prev_bash_timestamp = bash_timestamp_matches[1];
-          return;
-        }
-
-        auto r = make_table_row();
-
-        if (!hState.prev_bash_timestamp.empty()) {
-          r["time"] = INTEGER(hState.prev_bash_timestamp);
-          r["command"] = std::move(line);
-          hState.prev_bash_timestamp.clear();
-        } else if (std::regex_search(
-                       line, zsh_timestamp_matches, hState.zsh_timestamp_rx)) {
-          std::string timestamp = zsh_timestamp_matches[1];
-          r["time"] = INTEGER(timestamp);
-          r["command"] = zsh_timestamp_matches[2];
-        } else {
-          r["time"] = INTEGER(0);
-          r["command"] = std::move(line);
-        }
+  auto emit = [&uid, &history_file, &predicate](HistoryEntry& entry) {
+    auto r = make_table_row();
+    r["time"] = INTEGER(entry.time);
+    r["command"] = std::move(entry.command);
+    r["uid"] = uid;
+    r["history_file"] = history_file.string();
+    predicate(r);
+  };
 
-        r["uid"] = uid;
-        r["history_file"] = history_file.string();
-        predicate(r);
-      };
+  if (!FLAGS_incremental_history_tables) {
+    HistoryParser parser;
+    auto parseChunk = [&parser, &emit](std::string& buffer, size_t size) {
+      buffer.resize(size);
+      parser.parse(buffer, emit);
+    };
 
-  auto parseChunk = [&hState, &parseLine](std::string& buffer, size_t size) {
-    // We may be appending this chunk to the end of the previous.
-    if (buffer.size() == size) {
-      hState.content += std::move(buffer);
-    } else {
-      hState.content += buffer.substr(0, size);
+    if (!readFile(history_file, 0, 4096, false, false, parseChunk, false)) {
+      return;
     }
 
-    // Search for newlines and parse each.
-    size_t last_newline = 0;
-    auto newline = hState.content.find('\n');
-    while (newline != std::string::npos) {
-      auto line = hState.content.substr(last_newline, newline - last_newline);
-      parseLine(line);
+    // Parse the final line.
+    parser.parsePartial(emit);
+    return;
+  }
 
-      last_newline = newline + 1;
-      newline = hState.content.find('\n', last_newline);
+  std::vector<HistoryEntry> entries;
+  {
+    WriteLock lock(kTailedHistoriesMutex);
+    const auto& path = history_file.string();
+    if (!pathExists(history_file)) {
+      kTailedHistories.erase(path);
+      return;
     }
 
-    if (last_newline != hState.content.size() - 1) {
-      // We need to buffer the end of the string.
-      hState.content = hState.content.substr(last_newline);
+    auto& history = kTailedHistories[path];
+    std::string data;
+    bool restarted = false;
+    if (!history.tail.read(path, data, restarted)) {
+      kTailedHistories.erase(path);
+      return;
     }
-  };
 
-  if (!readFile(history_file, 0, 4096, false, false, parseChunk, false)) {
-    return;
+    if (restarted) {
+      history.parser = HistoryParser();
+      history.entries.clear();
+    }
+
+    // Only the appended data is parsed.
+    history.parser.parse(data, [&history](HistoryEntry& entry) {
+      history.entries.push_back(std::move(entry));
+    });
+
+    entries = history.entries;
+    history.parser.parsePartial([&entries](HistoryEntry& entry) {
+      entries.push_back(std::move(entry));
+    });
   }
 
-  // Parse the final line.
-  if (!hState.content.empty()) {
-    parseLine(hState.content);
+  for (auto& entry : entries) {
+    emit(entry);
   }
 }
 
@@ -142,17 +222,25 @@ void genShellHistoryFromBashSessions(
 }
 
 void genShellHistory(RowYield& yield, QueryContext& context) {
-  auto predicate = [&yield](DynamicTableRowHolder& r) { yield(std::move(r)); };
-
-  // Iterate over each user
-  QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto dir = row.find("directory");
-    if (uid != row.end() && gid != row.end() && dir != row.end()) {
-      genShellHistoryForUser(uid->second, gid->second, dir->second, predicate);
-      genShellHistoryFromBashSessions(uid->second, dir->second, predicate);
+  // Iterate over each user, the history files are read on the table workers.
+  auto rowsPerUser = generatePerUser<TableRows>(
+      usersFromContext(context), [](const Row& row, TableRows& rows) {
+        auto predicate = [&rows](DynamicTableRowHolder& r) {
+          rows.push_back(std::move(r));
+        };
+
+        auto gid = row.find("gid");
+        if (gid != row.end()) {
+          genShellHistoryForUser(
+              row.at("uid"), gid->second, row.at("directory"), predicate);
+          genShellHistoryFromBashSessions(
+              row.at("uid"), row.at("directory"), predicate);
+        }
+      });
+
+  for (auto& rows : rowsPerUser) {
+    for (auto& r : rows) {
+      yield(std::move(r));
     }
   }
 }
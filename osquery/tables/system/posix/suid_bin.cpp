@@ -7,8 +7,6 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <pwd.h>
-#include <grp.h>
 #include <sys/stat.h>
 
 #include <boost/filesystem.hpp>
@@ -16,6 +14,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/posix/accounts.h>
 
 namespace fs = boost::filesystem;
 
@@ -37,26 +36,12 @@ Status genBin(const fs::path& path, int perms, QueryData& results) {
   // store path
   Row r;
   r["path"] = path.string();
-  struct passwd* pw = getpwuid(info.st_uid);
-  struct group* gr = getgrgid(info.st_gid);
+  auto user = getPasswdByUid(info.st_uid);
+  auto group = getGroupByGid(info.st_gid);
 
   // get user name + group
-  std::string user;
-  if (pw != nullptr) {
-    user = std::string(pw->pw_name);
-  } else {
-    user = std::to_string(info.st_uid);
-  }
-
-  std::string group;
-  if (gr != nullptr) {
-    group = std::string(gr->gr_name);
-  } else {
-    group = std::to_string(info.st_gid);
-  }
-
-  r["username"] = user;
-  r["groupname"] = group;
+  r["username"] = user ? user->name : std::to_string(info.st_uid);
+  r["groupname"] = group ? group->name : std::to_string(info.st_gid);
 
   r["permissions"] = "";
   if ((perms & 04000) == 04000) {
@@ -12,9 +12,11 @@
 #include <stdlib.h>
 #include <string>
 
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_manifests.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
 
@@ -25,6 +27,9 @@
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+DECLARE_uint32(package_manifest_cache_max);
+
 namespace tables {
 
 /// Number of fields when splitting metadata and info.
@@ -44,11 +49,10 @@ const std::set<std::string> kDarwinPythonPath = {
 const std::string kWinPythonInstallKey =
     "SOFTWARE\\Python\\PythonCore\\%\\InstallPath";
 
-void genPackage(const std::string& path, Row& r) {
+Status genPackage(const std::string& path, Row& r) {
   std::string content;
   if (!readFile(path, content).ok()) {
-    TLOG << "Cannot find info file: " << path;
-    return;
+    return Status::failure("Cannot find info file: " + path);
   }
 
   auto lines = split(content, "\n");
@@ -73,6 +77,7 @@ void genPackage(const std::string& path, Row& r) {
       break;
     }
   }
+  return Status::success();
 }
 
 void genSiteDirectories(const std::string& site, QueryData& results) {
@@ -81,25 +86,38 @@ void genSiteDirectories(const std::string& site, QueryData& results) {
     return;
   }
 
+  std::vector<std::string> package_directories;
+  std::vector<std::string> manifests;
   for (const auto& directory : directories) {
     if (!isDirectory(directory).ok()) {
       continue;
     }
 
-    Row r;
     if (directory.find(".dist-info") != std::string::npos) {
-      auto path = directory + "/METADATA";
-      genPackage(path, r);
+      manifests.push_back(directory + "/METADATA");
     } else if (directory.find(".egg-info") != std::string::npos) {
-      auto path = directory + "/PKG-INFO";
-      genPackage(path, r);
+      manifests.push_back(directory + "/PKG-INFO");
     } else {
       continue;
     }
+    package_directories.push_back(directory);
+  }
+
+  // Unchanged packages are not read again.
+  static PackageManifestCache cache(FLAGS_package_manifest_cache_max,
+                                    genPackage);
+
+  std::vector<Row> rows;
+  auto statuses = cache.parse(manifests, rows);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (!statuses[i].ok()) {
+      TLOG << statuses[i].getMessage();
+    }
 
+    auto& r = rows[i];
     r["directory"] = site;
-    r["path"] = directory;
-    results.push_back(r);
+    r["path"] = package_directories[i];
+    results.push_back(std::move(r));
   }
 }
 
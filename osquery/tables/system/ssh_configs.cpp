@@ -75,18 +75,15 @@ void genSshConfigForUser(const std::string& uid,
   genSshConfig(uid, gid, ssh_config_file, results);
 }
 QueryData getSshConfigs(QueryContext& context) {
-  QueryData results;
-
   // Iterate over each user
-  QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto directory = row.find("directory");
-    if (uid != row.end() && gid != row.end() && directory != row.end()) {
-      genSshConfigForUser(uid->second, gid->second, directory->second, results);
-    }
-  }
+  auto results = generateForUsers(
+      usersFromContext(context), [](const Row& row, QueryData& user_results) {
+        auto gid = row.find("gid");
+        if (gid != row.end()) {
+          genSshConfigForUser(
+              row.at("uid"), gid->second, row.at("directory"), user_results);
+        }
+      });
 
   if (isPlatform(PlatformType::TYPE_WINDOWS)) {
     genSshConfig("0", "0", kWindowsSystemwideSshConfig, results);
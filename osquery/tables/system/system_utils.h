@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <osquery/core/tables.h>
 
 namespace osquery {
@@ -25,6 +27,50 @@ namespace tables {
  */
 QueryData usersFromContext(const QueryContext& context, bool all = false);
 
+/**
+ * @brief Run a per-user generator for many users in parallel.
+ *
+ * Tables reading files from each home directory spend most of their time
+ * waiting on the filesystem, so the users are spread over the table workers.
+ * Users without a uid or home directory are skipped. The generator is called
+ * once per user, possibly from a table worker thread, and must not touch the
+ * QueryContext cache.
+ *
+ * @param users the rows of the users table, see usersFromContext.
+ * @param generator a callable taking a user row and a Results output.
+ * @return the results of each user, in the order of the users.
+ */
+template <typename Results, typename Generator>
+std::vector<Results> generatePerUser(const QueryData& users,
+                                     Generator generator) {
+  std::vector<Results> results(users.size());
+  runTableTasks(users.size(), [&](size_t i) {
+    const auto& user = users[i];
+    if (user.count("uid") > 0 && user.count("directory") > 0) {
+      generator(user, results[i]);
+    }
+  });
+  return results;
+}
+
+/**
+ * @brief Generate the rows of many users in parallel, see generatePerUser.
+ *
+ * @return the merged rows of every user, in the order of the users.
+ */
+template <typename Generator>
+QueryData generateForUsers(const QueryData& users, Generator generator) {
+  auto results = generatePerUser<QueryData>(users, generator);
+
+  QueryData rows;
+  for (auto& result : results) {
+    rows.insert(rows.end(),
+                std::make_move_iterator(result.begin()),
+                std::make_move_iterator(result.end()));
+  }
+  return rows;
+}
+
 /**
  * Get a list of pids given a context.
  *
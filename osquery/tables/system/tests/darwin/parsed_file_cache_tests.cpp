@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/tables/system/darwin/parsed_file_cache.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+namespace tables {
+
+class ParsedFileCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = fs::temp_directory_path() /
+            fs::unique_path("osquery.parsed_file_cache.%%%%.%%%%");
+    fs::create_directories(root_);
+  }
+
+  void TearDown() override {
+    fs::remove_all(root_);
+  }
+
+  std::string writeFile(const std::string& name, const std::string& content) {
+    auto path = (root_ / name).string();
+    std::ofstream(path, std::ios::trunc) << content;
+    return path;
+  }
+
+  /// Parses the file content, "invalid" fails, counting the parses.
+  ParsedFileCache<std::string>::Parser countingParser() {
+    return [this](const std::string& path, std::string& value) {
+      ++parses_;
+      std::ifstream file(path);
+      std::getline(file, value);
+      return value != "invalid";
+    };
+  }
+
+  fs::path root_;
+  std::atomic<size_t> parses_{0};
+};
+
+TEST_F(ParsedFileCacheTests, test_reuse_until_changed) {
+  ParsedFileCache<std::string> cache(countingParser(), 16);
+
+  auto first = writeFile("first.plist", "one");
+  auto invalid = writeFile("invalid.plist", "invalid");
+  auto missing = (root_ / "missing.plist").string();
+
+  auto values = cache.get({first, invalid, missing});
+  ASSERT_EQ(values.size(), 3U);
+  ASSERT_NE(values[0], nullptr);
+  EXPECT_EQ(*values[0], "one");
+  EXPECT_EQ(values[1], nullptr);
+  EXPECT_EQ(values[2], nullptr);
+  EXPECT_EQ(parses_, 2U);
+
+  // Unchanged files, including the invalid one, are not parsed again.
+  values = cache.get({first, invalid, missing});
+  ASSERT_NE(values[0], nullptr);
+  EXPECT_EQ(*values[0], "one");
+  EXPECT_EQ(parses_, 2U);
+
+  // A replaced file has a new inode, a rewritten one a new size.
+  fs::remove(first);
+  writeFile("first.plist", "replaced");
+  writeFile("invalid.plist", "now valid");
+  values = cache.get({first, invalid, missing});
+  ASSERT_NE(values[0], nullptr);
+  EXPECT_EQ(*values[0], "replaced");
+  ASSERT_NE(values[1], nullptr);
+  EXPECT_EQ(*values[1], "now valid");
+  EXPECT_EQ(parses_, 4U);
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0U);
+  cache.get({first});
+  EXPECT_EQ(parses_, 5U);
+}
+
+TEST_F(ParsedFileCacheTests, test_parallel_parse) {
+  ParsedFileCache<std::string> cache(countingParser(), 1024, 4);
+
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < kParallelParseThreshold * 8; ++i) {
+    paths.push_back(writeFile(std::to_string(i), std::to_string(i)));
+  }
+
+  auto values = cache.get(paths);
+  ASSERT_EQ(values.size(), paths.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_NE(values[i], nullptr);
+    EXPECT_EQ(*values[i], std::to_string(i));
+  }
+  EXPECT_EQ(parses_, paths.size());
+
+  cache.get(paths);
+  EXPECT_EQ(parses_, paths.size());
+}
+
+TEST_F(ParsedFileCacheTests, test_max_entries) {
+  ParsedFileCache<std::string> cache(countingParser(), 2);
+
+  auto first = writeFile("first", "1");
+  auto second = writeFile("second", "2");
+  auto third = writeFile("third", "3");
+
+  cache.get({first, second});
+  EXPECT_EQ(cache.size(), 2U);
+
+  // The file not asked for is dropped first.
+  cache.get({second, third});
+  EXPECT_EQ(cache.size(), 2U);
+  EXPECT_EQ(parses_, 3U);
+
+  cache.get({second, third});
+  EXPECT_EQ(parses_, 3U);
+
+  cache.get({first});
+  EXPECT_EQ(cache.size(), 2U);
+  EXPECT_EQ(parses_, 4U);
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/system/linux/package_inventory.h>
+
+namespace osquery {
+namespace tables {
+
+class PackageInventoryTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    test_root_ = boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("osquery.tests.%%%%.%%%%");
+    boost::filesystem::create_directories(test_root_);
+    status_path_ = (test_root_ / "status").string();
+  }
+
+  void TearDown() override {
+    boost::filesystem::remove_all(test_root_);
+  }
+
+ protected:
+  boost::filesystem::path test_root_;
+  std::string status_path_;
+};
+
+TEST_F(PackageInventoryTests, test_fingerprint) {
+  // Nothing to fingerprint.
+  EXPECT_TRUE(getPackageDatabaseFingerprint({status_path_}).empty());
+
+  ASSERT_TRUE(writeTextFile(status_path_, "Package: dpkg\n").ok());
+  auto fingerprint = getPackageDatabaseFingerprint({status_path_});
+  EXPECT_FALSE(fingerprint.empty());
+  EXPECT_EQ(fingerprint, getPackageDatabaseFingerprint({status_path_}));
+
+  // Replacing the database changes the inode and size.
+  auto updated_path = (test_root_ / "status-new").string();
+  ASSERT_TRUE(writeTextFile(updated_path, "Package: dpkg\n\nPackage: tar\n")
+                  .ok());
+  boost::filesystem::rename(updated_path, status_path_);
+  EXPECT_NE(fingerprint, getPackageDatabaseFingerprint({status_path_}));
+}
+
+TEST_F(PackageInventoryTests, test_cache) {
+  PackageInventoryCache cache;
+  QueryData results;
+  EXPECT_FALSE(cache.get("a", results));
+
+  QueryData rows = {{{"name", "dpkg"}}, {{"name", "tar"}}};
+  cache.set("a", rows);
+  EXPECT_TRUE(cache.get("a", results));
+  EXPECT_EQ(results, rows);
+  EXPECT_FALSE(cache.get("b", results));
+
+  // Empty fingerprints and empty results are never cached.
+  cache.set("", rows);
+  EXPECT_FALSE(cache.get("", results));
+  EXPECT_FALSE(cache.get("a", results));
+
+  cache.set("c", {});
+  EXPECT_FALSE(cache.get("c", results));
+}
+
+} // namespace tables
+} // namespace osquery
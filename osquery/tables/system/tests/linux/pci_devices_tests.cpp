@@ -161,6 +161,53 @@ TEST_F(PciDevicesTest,
   EXPECT_EQ(expected, got);
 }
 
+TEST_F(PciDevicesTest, pcidb_lookups) {
+  std::istringstream test_db_stream(
+      "1000  First Vendor\n"
+      "\t0001  First Model  # Trailing comment\n"
+      "\t\t1000 0002  First Subsystem\n"
+      "\tzzzz  Invalid Model\n"
+      "\t0001  Duplicated Model\n"
+      "0f00  Second Vendor\n"
+      "\t0001  Second Model\n"
+      "1000  Duplicated Vendor\n"
+      "ffff  Illegal Vendor ID\n"
+      "C 00  Unclassified device\n"
+      "\t00  Non-VGA unclassified device\n");
+  PciDB pcidb(test_db_stream);
+
+  std::string name;
+  EXPECT_TRUE(pcidb.getVendorName("1000", name).ok());
+  EXPECT_EQ(name, "First Vendor");
+  EXPECT_TRUE(pcidb.getVendorName("0f00", name).ok());
+  EXPECT_EQ(name, "Second Vendor");
+
+  EXPECT_TRUE(pcidb.getModel("1000", "0001", name).ok());
+  EXPECT_EQ(name, "First Model");
+  EXPECT_TRUE(pcidb.getModel("0f00", "0001", name).ok());
+  EXPECT_EQ(name, "Second Model");
+
+  EXPECT_TRUE(pcidb.getSubsystemInfo("1000", "0001", "1000", "0002", name).ok());
+  EXPECT_EQ(name, "First Subsystem");
+
+  // Unknown and malformed IDs, and the device classes after ffff.
+  const std::vector<std::vector<std::string>> missing_models = {
+      {"1000", "0002"},
+      {"0f00", "zzzz"},
+      {"1000", "001"},
+      {"ffff", "0000"},
+      {"1000", ""},
+  };
+  for (const auto& ids : missing_models) {
+    EXPECT_FALSE(pcidb.getModel(ids[0], ids[1], name).ok()) << ids[1];
+  }
+
+  EXPECT_FALSE(pcidb.getVendorName("ffff", name).ok());
+  EXPECT_FALSE(pcidb.getVendorName("C 00", name).ok());
+  EXPECT_FALSE(
+      pcidb.getSubsystemInfo("0f00", "0001", "1000", "0002", name).ok());
+}
+
 TEST_F(PciDevicesTest, extract_pci_class_ids_single_digit_class_id) {
   Row expected = {
       {"pci_class_id", "0x08"},
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <unistd.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/system/posix/accounts.h>
+
+namespace osquery {
+
+DECLARE_uint64(nss_cache_ttl);
+
+namespace tables {
+
+class AccountsTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    ttl_ = FLAGS_nss_cache_ttl;
+    clearAccountCache();
+  }
+
+  void TearDown() override {
+    FLAGS_nss_cache_ttl = ttl_;
+    clearAccountCache();
+  }
+
+ private:
+  uint64_t ttl_{0};
+};
+
+TEST_F(AccountsTests, test_lookups) {
+  // Repeated lookups, from the cache or not, agree.
+  for (uint64_t ttl : {60, 0}) {
+    FLAGS_nss_cache_ttl = ttl;
+    for (size_t i = 0; i < 2; i++) {
+      auto root = getPasswdByUid(0);
+      ASSERT_TRUE(root.has_value());
+      EXPECT_EQ(root->uid, 0U);
+      EXPECT_FALSE(root->name.empty());
+
+      auto by_name = getPasswdByName(root->name);
+      ASSERT_TRUE(by_name.has_value());
+      EXPECT_EQ(by_name->uid, 0U);
+      EXPECT_EQ(by_name->directory, root->directory);
+
+      auto group = getGroupByGid(root->gid);
+      ASSERT_TRUE(group.has_value());
+      EXPECT_EQ(group->gid, root->gid);
+
+      auto groups = getGroupList(*root);
+      EXPECT_NE(std::find(groups.begin(), groups.end(), root->gid),
+                groups.end());
+
+      // Unknown ids are remembered as unknown.
+      EXPECT_FALSE(getPasswdByUid(static_cast<uid_t>(-2) - 1).has_value());
+      EXPECT_FALSE(getPasswdByName("osquery-no-such-user").has_value());
+    }
+  }
+}
+
+TEST_F(AccountsTests, test_enumeration) {
+  auto users = getPasswdEntries();
+  ASSERT_NE(users, nullptr);
+  auto root = std::find_if(users->begin(), users->end(), [](const auto& u) {
+    return u.uid == 0;
+  });
+  ASSERT_NE(root, users->end());
+
+  // The enumeration is shared until the cache is dropped.
+  EXPECT_EQ(getPasswdEntries(), users);
+  auto by_uid = getPasswdByUid(0);
+  ASSERT_TRUE(by_uid.has_value());
+  EXPECT_EQ(by_uid->name, root->name);
+
+  auto groups = getGroupEntries();
+  ASSERT_NE(groups, nullptr);
+  EXPECT_FALSE(groups->empty());
+  EXPECT_EQ(getGroupEntries(), groups);
+
+  clearAccountCache();
+  EXPECT_NE(getPasswdEntries(), users);
+}
+
+} // namespace tables
+} // namespace osquery
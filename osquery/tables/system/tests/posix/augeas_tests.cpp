@@ -87,5 +87,22 @@ TEST_F(AugeasTests, select_hosts_by_node) {
       << "Value is not empty. Got " << results.rows()[0].at("value")
       << "instead";
 }
+
+TEST_F(AugeasTests, select_files_loaded_by_earlier_queries) {
+  // Each query loads the files it asks for, earlier files stay loaded.
+  for (const auto& path : {"/etc/hosts", "/etc/resolv.conf", "/etc/hosts"}) {
+    auto results = SQL("select * from augeas where path = '" +
+                       std::string(path) + "' group by path");
+    ASSERT_EQ(results.rows().size(), 1U);
+    EXPECT_EQ(results.rows()[0].at("path"), path);
+  }
+
+  auto results =
+      SQL("select * from augeas where node = '/files/etc/hosts' or "
+          "node = '/files/etc/resolv.conf' group by path order by path");
+  ASSERT_EQ(results.rows().size(), 2U);
+  EXPECT_EQ(results.rows()[0].at("path"), "/etc/hosts");
+  EXPECT_EQ(results.rows()[1].at("path"), "/etc/resolv.conf");
+}
 } // namespace tables
 } // namespace osquery
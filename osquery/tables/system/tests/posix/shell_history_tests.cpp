@@ -13,12 +13,16 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/sql/sql.h>
 #include <osquery/tables/system/posix/shell_history.h>
 
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+DECLARE_bool(incremental_history_tables);
+
 namespace tables {
 
 class ShellHistoryTests : public testing::Test {};
@@ -153,5 +157,62 @@ TEST_F(ShellHistoryTests, bash_sessions_empty_ts) {
   fs::remove_all(directory);
 }
 
+TEST_F(ShellHistoryTests, incremental_history) {
+  FLAGS_incremental_history_tables = true;
+  std::vector<DynamicTableRowHolder> results;
+  auto predicate = [&results](DynamicTableRowHolder& r) {
+    results.push_back(std::move(r));
+  };
+
+  auto directory =
+      fs::temp_directory_path() /
+      fs::unique_path("osquery.shell_history_tests.incremental.%%%%-%%%%");
+  ASSERT_TRUE(fs::create_directory(directory));
+  auto filepath = directory / fs::path(".bash_history");
+  {
+    auto fout =
+        std::ofstream(filepath.native(), std::ios::out | std::ios::binary);
+    fout << "#1479082319\nfirst\nsec";
+  }
+
+  auto const uid = std::to_string(geteuid());
+  auto const gid = std::to_string(getegid());
+  genShellHistoryForUser(uid, gid, directory.native(), predicate);
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_EQ(results[0]["time"], "1479082319");
+  EXPECT_EQ(results[0]["command"], "first");
+  EXPECT_EQ(results[1]["command"], "sec");
+
+  // The partial line is completed by appended data.
+  {
+    auto fout = std::ofstream(filepath.native(),
+                              std::ios::out | std::ios::binary | std::ios::app);
+    fout << "ond\nthird\n";
+  }
+
+  results.clear();
+  genShellHistoryForUser(uid, gid, directory.native(), predicate);
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0]["command"], "first");
+  EXPECT_EQ(results[1]["command"], "second");
+  EXPECT_EQ(results[2]["command"], "third");
+  EXPECT_EQ(results[2]["history_file"], filepath.native());
+
+  // A rewritten history is parsed again.
+  {
+    auto fout =
+        std::ofstream(filepath.native(), std::ios::out | std::ios::binary);
+    fout << "rewritten\n";
+  }
+
+  results.clear();
+  genShellHistoryForUser(uid, gid, directory.native(), predicate);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0]["command"], "rewritten");
+
+  FLAGS_incremental_history_tables = false;
+  fs::remove_all(directory);
+}
+
 } // namespace tables
 } // namespace osquery
@@ -7,6 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
@@ -22,12 +27,17 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
+#include <osquery/tables/system/package_manifests.h>
+#include <osquery/tables/system/system_utils.h>
 #ifdef OSQUERY_WINDOWS
 #include <osquery/utils/conversions/windows/strings.h>
 #endif
 #include <osquery/utils/info/platform_type.h>
 
 namespace osquery {
+
+DECLARE_uint32(hash_cache_persist_max);
+
 namespace tables {
 
 class SystemsTablesTests : public testing::Test {
@@ -315,6 +325,9 @@ class HashTableTest : public testing::Test {
 
  protected:
   virtual void SetUp() {
+    registryAndPluginInit();
+    initDatabasePluginForTesting();
+
     tmpPath = boost::filesystem::temp_directory_path();
     tmpPath /= boost::filesystem::unique_path(
         "osquery_hash_t_test-%%%%-%%%%-%%%%-%%%%");
@@ -348,15 +361,8 @@ TEST_F(HashTableTest, hashes_are_correct) {
 }
 
 TEST_F(HashTableTest, test_cache_works) {
-  time_t last_mtime = 0;
+  SetContent(0);
   for (int i = 0; i < 2; ++i) {
-    SetContent(i);
-    if (last_mtime == 0) {
-      last_mtime = boost::filesystem::last_write_time(tmpPath);
-    } else {
-      // make sure mtime doesn't change
-      boost::filesystem::last_write_time(tmpPath, last_mtime);
-    }
     SQL results(qry);
     auto rows = results.rows();
     ASSERT_EQ(rows.size(), 1U);
@@ -364,6 +370,46 @@ TEST_F(HashTableTest, test_cache_works) {
   }
 }
 
+TEST_F(HashTableTest, test_cache_checks_ctime) {
+  if (!isPlatform(PlatformType::TYPE_POSIX)) {
+    // Windows reports the creation time as the ctime.
+    return;
+  }
+
+  SetContent(0);
+  auto last_mtime = boost::filesystem::last_write_time(tmpPath);
+  SQL r1(qry);
+  ASSERT_EQ(r1.rows().size(), 1U);
+
+  // The same size content with a restored mtime still changes the ctime.
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  SetContent(1);
+  boost::filesystem::last_write_time(tmpPath, last_mtime);
+  SQL r2(qry);
+  auto rows = r2.rows();
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0].at("md5"), badContentMd5);
+}
+
+TEST_F(HashTableTest, test_cache_persists) {
+  auto persist_max = FLAGS_hash_cache_persist_max;
+  FLAGS_hash_cache_persist_max = 10;
+
+  SetContent(0);
+  SQL results(qry);
+  ASSERT_EQ(results.rows().size(), 1U);
+
+  DatabaseStringValueList entries;
+  ASSERT_TRUE(scanDatabaseValues(kHashes, entries, "").ok());
+  auto persisted = std::any_of(
+      entries.begin(), entries.end(), [this](const auto& entry) {
+        return entry.second.find(contentSha256) != std::string::npos;
+      });
+  EXPECT_TRUE(persisted);
+
+  FLAGS_hash_cache_persist_max = persist_max;
+}
+
 TEST_F(HashTableTest, test_cache_updates) {
   SetContent(0);
   // cache the current state
@@ -379,5 +425,66 @@ TEST_F(HashTableTest, test_cache_updates) {
   EXPECT_NE(rows[0].at("md5"), contentMd5);
   EXPECT_EQ(rows[0].at("md5"), badContentMd5);
 }
+
+TEST_F(SystemsTablesTests, test_generate_for_users) {
+  QueryData users;
+  for (size_t i = 0; i < 64; ++i) {
+    users.push_back({{"uid", std::to_string(i)}, {"directory", "/home"}});
+  }
+  // Users without a home directory are skipped.
+  users.push_back({{"uid", "64"}});
+
+  auto results =
+      generateForUsers(users, [](const Row& user, QueryData& user_results) {
+        user_results.push_back({{"uid", user.at("uid")}, {"index", "0"}});
+        user_results.push_back({{"uid", user.at("uid")}, {"index", "1"}});
+      });
+
+  // Rows are in the order of the users.
+  ASSERT_EQ(results.size(), 128U);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results[i].at("uid"), std::to_string(i / 2));
+    EXPECT_EQ(results[i].at("index"), std::to_string(i % 2));
+  }
+}
+
+TEST_F(SystemsTablesTests, test_package_manifest_cache) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("osquery_manifest_%%%%%%%");
+  ASSERT_TRUE(writeTextFile(path, "first").ok());
+
+  std::atomic<size_t> parsed{0};
+  PackageManifestCache cache(
+      10, [&parsed](const std::string& manifest, Row& r) {
+        ++parsed;
+        std::string content;
+        auto s = readFile(manifest, content);
+        r["content"] = content;
+        return s;
+      });
+
+  std::vector<std::string> paths = {path.string(), path.string() + ".missing"};
+  std::vector<Row> rows;
+  auto statuses = cache.parse(paths, rows);
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_TRUE(statuses[0].ok());
+  EXPECT_EQ(rows[0]["content"], "first");
+  EXPECT_FALSE(statuses[1].ok());
+  EXPECT_EQ(parsed, 2U);
+
+  // Unchanged manifests are served from the cache, missing ones are not.
+  statuses = cache.parse(paths, rows);
+  EXPECT_EQ(rows[0]["content"], "first");
+  EXPECT_FALSE(statuses[1].ok());
+  EXPECT_EQ(parsed, 3U);
+
+  // A changed manifest is parsed again.
+  ASSERT_TRUE(writeTextFile(path, "second!").ok());
+  statuses = cache.parse(paths, rows);
+  EXPECT_EQ(rows[0]["content"], "second!");
+  EXPECT_EQ(parsed, 5U);
+
+  boost::filesystem::remove(path);
+}
 } // namespace tables
 } // namespace osquery
@@ -53,6 +53,32 @@ TEST_F(RegistryTablesTest, test_expand_registry_globs) {
   EXPECT_TRUE(results.empty());
 }
 
+TEST_F(RegistryTablesTest, test_expand_registry_globs_pushdown) {
+  // Only the branches matching each element are expanded.
+  std::set<std::string> results;
+  auto s = expandRegistryGlobs(kTestKey + "\\Micro%\\Windows", results);
+  ASSERT_TRUE(s.ok());
+  ASSERT_FALSE(results.empty());
+  for (const auto& key : results) {
+    EXPECT_TRUE(boost::istarts_with(key, kTestKey + "\\Micro"));
+    EXPECT_TRUE(boost::ends_with(key, "\\Windows"));
+  }
+
+  // Walking branches in parallel finds the same keys.
+  auto threads = Flag::getValue("registry_threads");
+  Flag::updateValue("registry_threads", "1");
+  std::set<std::string> serial_results;
+  s = expandRegistryGlobs("HKEY_USERS\\%\\SOFTWARE\\%", serial_results);
+  Flag::updateValue("registry_threads", "4");
+  std::set<std::string> parallel_results;
+  auto parallel_status =
+      expandRegistryGlobs("HKEY_USERS\\%\\SOFTWARE\\%", parallel_results);
+  Flag::updateValue("registry_threads", threads);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(parallel_status.ok());
+  EXPECT_EQ(serial_results, parallel_results);
+}
+
 TEST_F(RegistryTablesTest, test_query_multiple_registry_keys) {
   QueryData test_results;
   auto s = queryMultipleRegistryKeys({kTestKey}, test_results);
@@ -7,9 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
 #include <codecvt>
+#include <ctime>
 #include <map>
 #include <string>
+#include <unordered_map>
 
 // clang-format off
 #include <osquery/utils/system/system.h>
@@ -22,14 +26,37 @@
 #include <iomanip>
 // clang-format on
 
+#include <osquery/core/flags.h>
+#include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
 #include <osquery/core/tables.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/conversions/windows/strings.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     authenticode_cache_max,
+     10000,
+     "Size of the Authenticode verification cache (0 disables)");
+
+FLAG(uint32,
+     authenticode_cache_persist_max,
+     0,
+     "Number of Authenticode results kept in the database across restarts "
+     "(0 disables)");
+
+FLAG(uint32,
+     authenticode_cache_ttl,
+     86400,
+     "Seconds a cached Authenticode result is used before verifying again");
+
+/// Trim the persisted results after this share of the max in writes.
+const size_t kAuthenticodeCachePersistTrimRatio{10};
+
 template <typename T, typename DeleterType, DeleterType deleter>
 struct CustomUniquePtr final {
   using pointer = T;
@@ -478,12 +505,283 @@ Status querySignatureInformation(SignatureInformation& signature_info,
   return Status::success();
 }
 
+/// A verification result, without the path it was requested for.
+struct CachedSignature final {
+  /// When the file was verified; results expire after authenticode_cache_ttl.
+  std::time_t verified{0};
+
+  SignatureInformation info;
+};
+
+/**
+ * @brief Identifies the content of a file.
+ *
+ * The volume serial number and file id identify the file, the last write
+ * time and the size change when it is modified.
+ */
+bool getFileIdentity(const std::wstring& path, std::string& identity) {
+  auto handle = CreateFileW(path.c_str(),
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  BY_HANDLE_FILE_INFORMATION file_info = {};
+  auto succeeded = GetFileInformationByHandle(handle, &file_info);
+  CloseHandle(handle);
+  if (!succeeded) {
+    return false;
+  }
+
+  auto file_id = (static_cast<std::uint64_t>(file_info.nFileIndexHigh) << 32) |
+                 file_info.nFileIndexLow;
+  auto last_write =
+      (static_cast<std::uint64_t>(file_info.ftLastWriteTime.dwHighDateTime)
+       << 32) |
+      file_info.ftLastWriteTime.dwLowDateTime;
+  auto size = (static_cast<std::uint64_t>(file_info.nFileSizeHigh) << 32) |
+              file_info.nFileSizeLow;
+
+  identity = std::to_string(file_info.dwVolumeSerialNumber) + "." +
+             std::to_string(file_id) + "." + std::to_string(last_write) + "." +
+             std::to_string(size);
+  return true;
+}
+
+bool signatureExpired(const CachedSignature& signature, std::time_t now) {
+  return now - signature.verified >=
+         static_cast<std::time_t>(FLAGS_authenticode_cache_ttl);
+}
+
+/// Splits a persisted result, keeping the empty fields.
+std::vector<std::string> splitPersistedSignature(const std::string& value) {
+  std::vector<std::string> fields;
+  std::size_t start = 0;
+  while (true) {
+    auto end = value.find('\n', start);
+    fields.push_back(value.substr(start, end - start));
+    if (end == std::string::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+  return fields;
+}
+
+/// Lookup a result persisted for a file with the same identity.
+bool loadPersistedSignature(const std::string& identity,
+                            CachedSignature& signature) {
+  std::string value;
+  if (!getDatabaseValue(kAuthenticode, identity, value).ok() ||
+      value.empty()) {
+    return false;
+  }
+
+  // The verification time, result, program name, serial, issuer and subject.
+  auto fields = splitPersistedSignature(value);
+  if (fields.size() != 6) {
+    return false;
+  }
+
+  auto verified = tryTo<std::uint64_t>(fields[0]);
+  auto result = tryTo<int>(fields[1]);
+  if (verified.isError() || result.isError() || result.get() < 0 ||
+      result.get() >
+          static_cast<int>(SignatureInformation::Result::Untrusted)) {
+    return false;
+  }
+
+  signature.verified = static_cast<std::time_t>(verified.get());
+  signature.info.result =
+      static_cast<SignatureInformation::Result>(result.get());
+  signature.info.original_program_name = std::move(fields[2]);
+  signature.info.serial_number = std::move(fields[3]);
+  signature.info.issuer_name = std::move(fields[4]);
+  signature.info.subject_name = std::move(fields[5]);
+  return true;
+}
+
+/// Remove the oldest persisted results beyond authenticode_cache_persist_max.
+void trimPersistedSignatures() {
+  DatabaseStringValueList entries;
+  if (!scanDatabaseValues(kAuthenticode, entries, "").ok() ||
+      entries.size() <= FLAGS_authenticode_cache_persist_max) {
+    return;
+  }
+
+  std::vector<std::pair<std::uint64_t, std::string>> written;
+  written.reserve(entries.size());
+  for (auto& entry : entries) {
+    const auto& value = entry.second;
+    auto time = tryTo<std::uint64_t>(value.substr(0, value.find('\n')));
+    written.emplace_back(time.takeOr(std::uint64_t{0}),
+                         std::move(entry.first));
+  }
+
+  auto excess = written.size() - FLAGS_authenticode_cache_persist_max;
+  std::nth_element(written.begin(), written.begin() + excess, written.end());
+  for (size_t i = 0; i < excess; ++i) {
+    deleteDatabaseValue(kAuthenticode, written[i].second);
+  }
+}
+
+void persistSignature(const std::string& identity,
+                      const CachedSignature& signature) {
+  const auto& info = signature.info;
+  for (const auto* field : {&info.original_program_name,
+                            &info.serial_number,
+                            &info.issuer_name,
+                            &info.subject_name}) {
+    if (field->find('\n') != std::string::npos) {
+      return;
+    }
+  }
+
+  auto value = std::to_string(signature.verified) + "\n" +
+               std::to_string(static_cast<int>(info.result)) + "\n" +
+               info.original_program_name + "\n" + info.serial_number + "\n" +
+               info.issuer_name + "\n" + info.subject_name;
+  if (!setDatabaseValue(kAuthenticode, identity, value).ok()) {
+    return;
+  }
+
+  // Trimming scans the domain, amortize it over many writes.
+  static std::atomic<size_t> writes{0};
+  auto trim_interval =
+      std::max<size_t>(1,
+                       FLAGS_authenticode_cache_persist_max /
+                           kAuthenticodeCachePersistTrimRatio);
+  if (++writes % trim_interval == 0) {
+    trimPersistedSignatures();
+  }
+}
+
+/**
+ * @brief Caches verification results by file identity.
+ *
+ * WinVerifyTrust and the catalog lookups are only repeated when a file
+ * changes or its result is older than authenticode_cache_ttl, which also
+ * picks up revocations and catalog updates.
+ */
+class AuthenticodeCache final {
+ public:
+  static bool get(const std::string& identity, SignatureInformation& info) {
+    auto now = std::time(nullptr);
+    {
+      WriteLock lock(mutex());
+      auto& entries = cache();
+      auto it = entries.find(identity);
+      if (it != entries.end()) {
+        if (!signatureExpired(it->second, now)) {
+          info = it->second.info;
+          return true;
+        }
+        entries.erase(it);
+      }
+    }
+
+    CachedSignature signature;
+    if (FLAGS_authenticode_cache_persist_max == 0 ||
+        !loadPersistedSignature(identity, signature) ||
+        signatureExpired(signature, now)) {
+      return false;
+    }
+
+    info = signature.info;
+    insert(identity, std::move(signature));
+    return true;
+  }
+
+  static void put(const std::string& identity,
+                  const SignatureInformation& info) {
+    CachedSignature signature;
+    signature.verified = std::time(nullptr);
+    signature.info = info;
+    signature.info.path.clear();
+
+    if (FLAGS_authenticode_cache_persist_max > 0) {
+      persistSignature(identity, signature);
+    }
+
+    insert(identity, std::move(signature));
+  }
+
+ private:
+  static void insert(const std::string& identity, CachedSignature signature) {
+    if (FLAGS_authenticode_cache_max == 0) {
+      return;
+    }
+
+    WriteLock lock(mutex());
+    auto& entries = cache();
+    if (entries.size() >= FLAGS_authenticode_cache_max) {
+      // Drop the expired results first, then the oldest ones.
+      auto now = std::time(nullptr);
+      for (auto it = entries.begin(); it != entries.end();) {
+        if (signatureExpired(it->second, now)) {
+          it = entries.erase(it);
+        } else {
+          ++it;
+        }
+      }
+
+      while (entries.size() >= FLAGS_authenticode_cache_max) {
+        auto oldest = std::min_element(
+            entries.begin(), entries.end(), [](const auto& l, const auto& r) {
+              return l.second.verified < r.second.verified;
+            });
+        entries.erase(oldest);
+      }
+    }
+
+    entries[identity] = std::move(signature);
+  }
+
+  static Mutex& mutex() {
+    static Mutex instance;
+    return instance;
+  }
+
+  static std::unordered_map<std::string, CachedSignature>& cache() {
+    static std::unordered_map<std::string, CachedSignature> instance;
+    return instance;
+  }
+};
+
+Status queryCachedSignatureInformation(SignatureInformation& signature_info,
+                                       const std::string& path) {
+  std::string identity;
+  if ((FLAGS_authenticode_cache_max == 0 &&
+       FLAGS_authenticode_cache_persist_max == 0) ||
+      !getFileIdentity(stringToWstring(path), identity)) {
+    return querySignatureInformation(signature_info, path);
+  }
+
+  if (AuthenticodeCache::get(identity, signature_info)) {
+    signature_info.path = path;
+    return Status::success();
+  }
+
+  auto status = querySignatureInformation(signature_info, path);
+  if (status.ok()) {
+    AuthenticodeCache::put(identity, signature_info);
+  }
+
+  return status;
+}
+
 namespace tables {
 Status generateRow(Row& r, const std::string& path) {
   r = {};
 
   SignatureInformation signature_info;
-  auto status = querySignatureInformation(signature_info, path);
+  auto status = queryCachedSignatureInformation(signature_info, path);
   if (!status.ok()) {
     std::stringstream error_message;
     error_message << "Failed to verify the Authenticode signature for the "
@@ -17,25 +17,21 @@ namespace tables {
 QueryData genInstalledPatches(QueryContext& context) {
   QueryData results;
 
-  const WmiRequest wmiSystemReq("select * from Win32_QuickFixEngineering");
-  const auto& wmiResults = wmiSystemReq.results();
-
-  if (wmiResults.size() != 0) {
-    Row r;
-
-    for (const auto& item : wmiResults) {
-      item.GetString("CSName", r["csname"]);
-      item.GetString("HotFixID", r["hotfix_id"]);
-      item.GetString("Caption", r["caption"]);
-      item.GetString("Description", r["description"]);
-      item.GetString("FixComments", r["fix_comments"]);
-      item.GetString("InstalledBy", r["installed_by"]);
-      item.GetString("InstallDate", r["install_date"]);
-      item.GetString("InstalledOn", r["installed_on"]);
-
-      results.push_back(r);
-    }
-  }
+  WmiRequest::stream(
+      "select * from Win32_QuickFixEngineering",
+      [&results](const WmiResultItem& item) {
+        Row r;
+        item.GetString("CSName", r["csname"]);
+        item.GetString("HotFixID", r["hotfix_id"]);
+        item.GetString("Caption", r["caption"]);
+        item.GetString("Description", r["description"]);
+        item.GetString("FixComments", r["fix_comments"]);
+        item.GetString("InstalledBy", r["installed_by"]);
+        item.GetString("InstallDate", r["install_date"]);
+        item.GetString("InstalledOn", r["installed_on"]);
+
+        results.push_back(std::move(r));
+      });
 
   return results;
 }
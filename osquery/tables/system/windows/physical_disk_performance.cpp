@@ -19,12 +19,7 @@ QueryData genPhysicalDiskPerformance(QueryContext& context) {
   QueryData results;
 
   auto query = "SELECT * FROM Win32_PerfFormattedData_PerfDisk_PhysicalDisk";
-  const WmiRequest perfReq(query);
-  if (!perfReq.getStatus().ok()) {
-    return results;
-  }
-  const auto& perfRes = perfReq.results();
-  for (const auto& disk : perfRes) {
+  WmiRequest::stream(query, [&results](const WmiResultItem& disk) {
     Row r;
     std::string sPlaceHolder;
 
@@ -70,8 +65,8 @@ QueryData genPhysicalDiskPerformance(QueryContext& context) {
     r["percent_idle_time"] =
         INTEGER(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
 
-    results.push_back(r);
-  }
+    results.push_back(std::move(r));
+  });
   return results;
 }
 }
@@ -7,8 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <vector>
 
 #define _WIN32_DCOM
 
@@ -133,6 +135,83 @@ typedef struct _PROCESS_BASIC_INFORMATION {
   PVOID Reserved3;
 } PROCESS_BASIC_INFORMATION;
 
+/**
+ * NtQuerySystemInformation returns the processes and their counters in one
+ * call, winternl.h only declares the first fields of each entry.
+ */
+typedef NTSTATUS(NTAPI* NtQuerySystemInformationPtr)(
+    IN unsigned long SystemInformationClass,
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG ReturnLength OPTIONAL);
+
+NtQuerySystemInformationPtr kNtQuerySystemInformation = nullptr;
+
+const unsigned long kSystemProcessInformation = 5;
+
+typedef struct _SYSTEM_PROCESS_INFO {
+  ULONG NextEntryOffset;
+  ULONG NumberOfThreads;
+  LARGE_INTEGER WorkingSetPrivateSize;
+  ULONG HardFaultCount;
+  ULONG NumberOfThreadsHighWatermark;
+  ULONGLONG CycleTime;
+  LARGE_INTEGER CreateTime;
+  LARGE_INTEGER UserTime;
+  LARGE_INTEGER KernelTime;
+  UNICODE_STRING ImageName;
+  LONG BasePriority;
+  HANDLE UniqueProcessId;
+  HANDLE InheritedFromUniqueProcessId;
+  ULONG HandleCount;
+  ULONG SessionId;
+  ULONG_PTR UniqueProcessKey;
+  SIZE_T PeakVirtualSize;
+  SIZE_T VirtualSize;
+  ULONG PageFaultCount;
+  SIZE_T PeakWorkingSetSize;
+  SIZE_T WorkingSetSize;
+  SIZE_T QuotaPeakPagedPoolUsage;
+  SIZE_T QuotaPagedPoolUsage;
+  SIZE_T QuotaPeakNonPagedPoolUsage;
+  SIZE_T QuotaNonPagedPoolUsage;
+  SIZE_T PagefileUsage;
+  SIZE_T PeakPagefileUsage;
+  SIZE_T PrivatePageCount;
+  LARGE_INTEGER ReadOperationCount;
+  LARGE_INTEGER WriteOperationCount;
+  LARGE_INTEGER OtherOperationCount;
+  LARGE_INTEGER ReadTransferCount;
+  LARGE_INTEGER WriteTransferCount;
+  LARGE_INTEGER OtherTransferCount;
+} SYSTEM_PROCESS_INFO, *PSYSTEM_PROCESS_INFO;
+
+/// The first buffer for the process list, it grows if processes start.
+const ULONG kProcessInformationSize = 512 * 1024;
+
+/// A process from the system snapshot.
+struct ProcessEntry {
+  unsigned long pid{0};
+  unsigned long parent{0};
+  std::wstring name;
+  unsigned long threads{0};
+
+  /// The counters below were read with the list, no handle is needed.
+  bool has_counters{false};
+
+  /// Times in 100 nanosecond ticks.
+  ULONGLONG create_time{0};
+  ULONGLONG user_time{0};
+  ULONGLONG kernel_time{0};
+
+  ULONGLONG working_set{0};
+  ULONGLONG non_paged_pool{0};
+  ULONGLONG private_usage{0};
+  ULONGLONG read_bytes{0};
+  ULONGLONG write_bytes{0};
+  unsigned long handle_count{0};
+};
+
 /// Given a pid, enumerates all loaded modules and memory pages for that process
 Status genMemoryMap(unsigned long pid, QueryData& results) {
   auto proc = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
@@ -475,6 +554,139 @@ void genProcRssInfo(HANDLE& proc, DynamicTableRowHolder& r) {
   r["total_size"] = ret == TRUE ? BIGINT(mem_ctr.PrivateUsage) : BIGINT(-1);
 }
 
+/// List the processes and their counters with one system call.
+Status getProcessesFromSystemInformation(std::vector<ProcessEntry>& entries) {
+  if (kNtQuerySystemInformation == nullptr) {
+    kNtQuerySystemInformation =
+        reinterpret_cast<NtQuerySystemInformationPtr>(GetProcAddress(
+            GetModuleHandleA("ntdll.dll"), "NtQuerySystemInformation"));
+    if (kNtQuerySystemInformation == nullptr) {
+      return Status::failure("Failed to resolve NtQuerySystemInformation");
+    }
+  }
+
+  // Entries hold 64-bit counters, keep the buffer aligned for them.
+  std::vector<ULONGLONG> buffer;
+  ULONG size = kProcessInformationSize;
+  NTSTATUS status = STATUS_INFO_LENGTH_MISMATCH;
+  while (status == STATUS_INFO_LENGTH_MISMATCH) {
+    buffer.resize(size / sizeof(ULONGLONG) + 1);
+    ULONG required = 0;
+    status = kNtQuerySystemInformation(
+        kSystemProcessInformation,
+        buffer.data(),
+        static_cast<ULONG>(buffer.size() * sizeof(ULONGLONG)),
+        &required);
+    // Leave room for the processes started since.
+    size = std::max(size * 2, required + required / 4);
+  }
+
+  if (!NT_SUCCESS(status)) {
+    return Status::failure("NtQuerySystemInformation failed with " +
+                           std::to_string(status));
+  }
+
+  auto data = reinterpret_cast<const unsigned char*>(buffer.data());
+  for (size_t offset = 0;;) {
+    auto info = reinterpret_cast<const SYSTEM_PROCESS_INFO*>(data + offset);
+
+    ProcessEntry entry;
+    entry.pid = static_cast<unsigned long>(
+        reinterpret_cast<ULONG_PTR>(info->UniqueProcessId));
+    entry.parent = static_cast<unsigned long>(
+        reinterpret_cast<ULONG_PTR>(info->InheritedFromUniqueProcessId));
+    if (info->ImageName.Buffer != nullptr) {
+      entry.name.assign(info->ImageName.Buffer,
+                        info->ImageName.Length / sizeof(WCHAR));
+    } else if (entry.pid == 0) {
+      // The name Toolhelp uses for the idle process.
+      entry.name = L"[System Process]";
+    }
+    entry.threads = info->NumberOfThreads;
+
+    entry.has_counters = true;
+    entry.create_time = info->CreateTime.QuadPart;
+    entry.user_time = info->UserTime.QuadPart;
+    entry.kernel_time = info->KernelTime.QuadPart;
+    entry.working_set = info->WorkingSetSize;
+    entry.non_paged_pool = info->QuotaNonPagedPoolUsage;
+    entry.private_usage = info->PrivatePageCount;
+    entry.read_bytes = info->ReadTransferCount.QuadPart;
+    entry.write_bytes = info->WriteTransferCount.QuadPart;
+    entry.handle_count = info->HandleCount;
+    entries.push_back(std::move(entry));
+
+    if (info->NextEntryOffset == 0) {
+      break;
+    }
+    offset += info->NextEntryOffset;
+  }
+
+  return Status::success();
+}
+
+/// List the processes with Toolhelp, the counters need a process handle.
+Status getProcessesFromToolhelp(std::vector<ProcessEntry>& entries) {
+  auto proc_snap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+  if (proc_snap == INVALID_HANDLE_VALUE) {
+    return Status::failure("Failed to create snapshot of processes with " +
+                           std::to_string(GetLastError()));
+  }
+  auto const proc_snap_manager =
+      scope_guard::create([&proc_snap]() { CloseHandle(proc_snap); });
+
+  PROCESSENTRY32W proc;
+  proc.dwSize = sizeof(PROCESSENTRY32W);
+
+  auto ret = Process32FirstW(proc_snap, &proc);
+  if (ret == FALSE) {
+    return Status::failure(
+        "Failed to acquire first process information with " +
+        std::to_string(GetLastError()));
+  }
+
+  while (ret != FALSE) {
+    ProcessEntry entry;
+    entry.pid = proc.th32ProcessID;
+    entry.parent = proc.th32ParentProcessID;
+    entry.name = proc.szExeFile;
+    entry.threads = proc.cntThreads;
+    entries.push_back(std::move(entry));
+    ret = Process32NextW(proc_snap, &proc);
+  }
+
+  return Status::success();
+}
+
+/// Set the time, memory, I/O and handle columns from the system snapshot.
+void genProcessCounters(const ProcessEntry& entry, DynamicTableRowHolder& r) {
+  // Windows stores proc times in 100 nanosecond ticks
+  r["user_time"] = BIGINT(entry.user_time / 10000);
+  r["system_time"] = BIGINT(entry.kernel_time / 10000);
+  r["percent_processor_time"] = BIGINT(entry.user_time + entry.kernel_time);
+
+  // The idle and system processes have no creation time.
+  if (entry.create_time != 0) {
+    FILETIME create_time;
+    create_time.dwLowDateTime = static_cast<DWORD>(entry.create_time);
+    create_time.dwHighDateTime = static_cast<DWORD>(entry.create_time >> 32);
+    auto proc_create_time = osquery::filetimeToUnixtime(create_time);
+    r["start_time"] = BIGINT(proc_create_time);
+
+    FILETIME curr_ft_time;
+    GetSystemTimeAsFileTime(&curr_ft_time);
+    r["elapsed_time"] =
+        BIGINT(osquery::filetimeToUnixtime(curr_ft_time) - proc_create_time);
+  }
+
+  r["wired_size"] = BIGINT(entry.non_paged_pool);
+  r["resident_size"] = BIGINT(entry.working_set);
+  r["total_size"] = BIGINT(entry.private_usage);
+  r["disk_bytes_read"] = BIGINT(entry.read_bytes);
+  r["disk_bytes_written"] = BIGINT(entry.write_bytes);
+  r["handle_count"] = INTEGER(entry.handle_count);
+}
+
 TableRows genProcesses(QueryContext& context) {
   TableRows results;
 
@@ -490,39 +702,55 @@ TableRows genProcesses(QueryContext& context) {
     }
   }
 
-  auto proc_snap = CreateToolhelp32Snapshot(TH32CS_SNAPALL, NULL);
-  auto const proc_snap_manager =
-      scope_guard::create([&proc_snap]() { CloseHandle(proc_snap); });
-  if (proc_snap == INVALID_HANDLE_VALUE) {
-    LOG(ERROR) << "Failed to create snapshot of processes with "
-               << std::to_string(GetLastError());
-    return {};
+  // The system snapshot has the counters of every process, a terminal server
+  // with thousands of processes no longer opens each one for them.
+  std::vector<ProcessEntry> entries;
+  auto status = getProcessesFromSystemInformation(entries);
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage();
+    entries.clear();
+    status = getProcessesFromToolhelp(entries);
   }
-
-  PROCESSENTRY32W proc;
-  proc.dwSize = sizeof(PROCESSENTRY32W);
-
-  auto ret = Process32FirstW(proc_snap, &proc);
-  if (ret == FALSE) {
-    LOG(ERROR) << "Failed to acquire first process information with "
-               << std::to_string(GetLastError());
+  if (!status.ok()) {
+    LOG(ERROR) << status.getMessage();
     return {};
   }
 
-  while (ret != FALSE) {
-    auto pid = proc.th32ProcessID;
+  auto handle_columns = context.isAnyColumnUsed({"nice",
+                                                 "state",
+                                                 "cwd",
+                                                 "root",
+                                                 "path",
+                                                 "on_disk",
+                                                 "cmdline",
+                                                 "uid",
+                                                 "gid",
+                                                 "is_elevated_token"});
+  auto counter_columns = context.isAnyColumnUsed({"user_time",
+                                                  "system_time",
+                                                  "start_time",
+                                                  "elapsed_time",
+                                                  "percent_processor_time",
+                                                  "wired_size",
+                                                  "resident_size",
+                                                  "total_size",
+                                                  "disk_bytes_read",
+                                                  "disk_bytes_written",
+                                                  "handle_count"});
+
+  for (const auto& entry : entries) {
+    auto pid = entry.pid;
 
     bool wanted_pid = (pidlist.empty() || pidlist.count(pid) > 0);
     if (!wanted_pid) {
-      ret = Process32NextW(proc_snap, &proc);
       continue;
     }
 
     auto r = make_table_row();
     r["pid"] = BIGINT(pid);
-    r["parent"] = BIGINT(proc.th32ParentProcessID);
-    r["name"] = SQL_TEXT(wstringToString(proc.szExeFile));
-    r["threads"] = INTEGER(proc.cntThreads);
+    r["parent"] = BIGINT(entry.parent);
+    r["name"] = SQL_TEXT(wstringToString(entry.name));
+    r["threads"] = INTEGER(entry.threads);
 
     // Set default values for columns, in the event opening the process fails
     r["pgroup"] = BIGINT(-1);
@@ -549,27 +777,37 @@ TableRows genProcesses(QueryContext& context) {
 
     r["on_disk"] = BIGINT(-1);
 
-    auto proc_handle =
-        OpenProcess(PROCESS_ALL_ACCESS, FALSE, proc.th32ProcessID);
+    if (entry.has_counters) {
+      genProcessCounters(entry, r);
+    }
+
+    // Only open the process for the columns the snapshot does not have.
+    if (!handle_columns && (entry.has_counters || !counter_columns)) {
+      results.push_back(r);
+      continue;
+    }
+
+    auto proc_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
     auto const proc_handle_manager =
         scope_guard::create([&proc_handle]() { CloseHandle(proc_handle); });
 
     // If we fail to get all privs, open with less permissions
     if (proc_handle == NULL) {
-      proc_handle = OpenProcess(
-          PROCESS_QUERY_LIMITED_INFORMATION, FALSE, proc.th32ProcessID);
+      proc_handle =
+          OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
     }
 
     if (proc_handle == NULL) {
-      VLOG(1) << "Failed to open handle to process " << proc.th32ProcessID
-              << " with " << GetLastError();
+      VLOG(1) << "Failed to open handle to process " << pid << " with "
+              << GetLastError();
       results.push_back(r);
-      ret = Process32NextW(proc_snap, &proc);
       continue;
     }
 
-    auto nice = GetPriorityClass(proc_handle);
-    r["nice"] = nice != FALSE ? INTEGER(nice) : "-1";
+    if (context.isColumnUsed("nice")) {
+      auto nice = GetPriorityClass(proc_handle);
+      r["nice"] = nice != FALSE ? INTEGER(nice) : "-1";
+    }
 
     if (context.isAnyColumnUsed({"cwd", "root", "path", "on_disk"})) {
       getProcessPathInfo(proc_handle, pid, r);
@@ -589,11 +827,9 @@ TableRows genProcesses(QueryContext& context) {
       }
 
       std::string cmd{""};
-      auto s = getProcessCommandLine(
-          proc_handle, cmd, static_cast<unsigned long>(proc.th32ProcessID));
+      auto s = getProcessCommandLine(proc_handle, cmd, pid);
       if (!s.ok()) {
-        s = getProcessCommandLineLegacy(
-            proc_handle, cmd, static_cast<unsigned long>(proc.th32ProcessID));
+        s = getProcessCommandLineLegacy(proc_handle, cmd, pid);
       }
       r["cmdline"] = cmd;
     }
@@ -602,32 +838,34 @@ TableRows genProcesses(QueryContext& context) {
       genProcessUserTokenInfo(proc_handle, r);
     }
 
-    if (context.isAnyColumnUsed({"user_time",
-                                 "system_time",
-                                 "start_time",
-                                 "elapsed_time",
-                                 "percent_processor_time"})) {
-      genProcessTimeInfo(proc_handle, r);
-    }
+    if (!entry.has_counters) {
+      if (context.isAnyColumnUsed({"user_time",
+                                   "system_time",
+                                   "start_time",
+                                   "elapsed_time",
+                                   "percent_processor_time"})) {
+        genProcessTimeInfo(proc_handle, r);
+      }
 
-    if (context.isAnyColumnUsed(
-            {"wired_size", "resident_size", "total_size"})) {
-      genProcRssInfo(proc_handle, r);
-    }
+      if (context.isAnyColumnUsed(
+              {"wired_size", "resident_size", "total_size"})) {
+        genProcRssInfo(proc_handle, r);
+      }
 
-    if (context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})) {
-      IO_COUNTERS io_ctrs;
-      ret = GetProcessIoCounters(proc_handle, &io_ctrs);
-      r["disk_bytes_read"] =
-          ret == TRUE ? BIGINT(io_ctrs.ReadTransferCount) : BIGINT(-1);
-      r["disk_bytes_written"] =
-          ret == TRUE ? BIGINT(io_ctrs.WriteTransferCount) : BIGINT(-1);
-    }
+      if (context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})) {
+        IO_COUNTERS io_ctrs;
+        auto ret = GetProcessIoCounters(proc_handle, &io_ctrs);
+        r["disk_bytes_read"] =
+            ret == TRUE ? BIGINT(io_ctrs.ReadTransferCount) : BIGINT(-1);
+        r["disk_bytes_written"] =
+            ret == TRUE ? BIGINT(io_ctrs.WriteTransferCount) : BIGINT(-1);
+      }
 
-    if (context.isColumnUsed("handle_count")) {
-      unsigned long handle_count;
-      ret = GetProcessHandleCount(proc_handle, &handle_count);
-      r["handle_count"] = ret == TRUE ? INTEGER(handle_count) : "-1";
+      if (context.isColumnUsed("handle_count")) {
+        unsigned long handle_count;
+        auto ret = GetProcessHandleCount(proc_handle, &handle_count);
+        r["handle_count"] = ret == TRUE ? INTEGER(handle_count) : "-1";
+      }
     }
 
     /*
@@ -642,7 +880,6 @@ TableRows genProcesses(QueryContext& context) {
     }
 
     results.push_back(r);
-    ret = Process32NextW(proc_snap, &proc);
   }
 
   return results;
@@ -13,19 +13,22 @@
 #include <sddl.h>
 // clang-format on
 
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <iterator>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <boost/algorithm/hex.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/range/adaptor/map.hpp>
-#include <boost/range/algorithm.hpp>
 
 #include <sqlite3.h>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
@@ -43,6 +46,12 @@
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+FLAG(uint32,
+     registry_threads,
+     4,
+     "Threads used to walk independent registry branches and read keys");
+
 namespace tables {
 
 auto closeRegHandle = [](HKEY handle) { RegCloseKey(handle); };
@@ -413,64 +422,178 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
   return Status::success();
 }
 
-static inline void populateDefaultKeys(std::set<std::string>& rKeys) {
-  boost::copy(kRegistryHives | boost::adaptors::map_keys,
-              std::inserter(rKeys, rKeys.end()));
+/// Open a subkey relative to an already open parent key.
+static reg_handle_t openSubkey(HKEY parent, const std::string& subkey) {
+  HKEY hkey = nullptr;
+  auto ret = RegOpenKeyExW(
+      parent, stringToWstring(subkey).c_str(), 0, KEY_READ, &hkey);
+  return reg_handle_t((ret == ERROR_SUCCESS) ? hkey : nullptr, closeRegHandle);
 }
 
-static inline Status populateSubkeys(std::set<std::string>& rKeys,
-                                     bool replaceKeys = false) {
-  std::set<std::string> newKeys;
-  if (!replaceKeys) {
-    newKeys = rKeys;
-  }
-
-  for (const auto& key : rKeys) {
-    QueryData regResults;
-    auto ret = queryKey(key, regResults);
-    if (!ret.ok()) {
-      return ret;
+/// List the names of an open key's subkeys without reading its values.
+static Status enumerateSubkeys(HKEY handle, std::vector<std::string>& rNames) {
+  // Registry key names are limited to 255 characters.
+  WCHAR name[256];
+  for (DWORD i = 0;; i++) {
+    DWORD size = 256;
+    auto ret = RegEnumKeyExW(
+        handle, i, name, &size, nullptr, nullptr, nullptr, nullptr);
+    if (ret == ERROR_NO_MORE_ITEMS) {
+      break;
     }
-    for (const auto& r : regResults) {
-      if (r.at("type") == "subkey") {
-        newKeys.insert(r.at("path"));
-      }
+    if (ret != ERROR_SUCCESS) {
+      return Status(ret, "Failed to enumerate registry key");
     }
+    rNames.push_back(wstringToString(std::wstring(name, size)));
   }
-  rKeys = std::move(newKeys);
   return Status::success();
 }
 
-static inline void appendSubkeyToKeys(const std::string& subkey,
-                                      std::set<std::string>& rKeys) {
-  std::set<std::string> newKeys{};
-  for (auto& key : rKeys) {
-    newKeys.insert(std::move(key) + kRegSep + subkey);
+/// Run work(i) for every i in [0, count) on up to --registry_threads threads.
+template <typename Work>
+static void runRegistryWork(size_t count, const Work& work) {
+  auto threads = std::min(
+      static_cast<size_t>(std::max(FLAGS_registry_threads, 1U)), count);
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      work(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&next, &work, count]() {
+    for (auto i = next++; i < count; i = next++) {
+      work(i);
+    }
+  };
+
+  std::vector<std::future<void>> workers;
+  for (size_t i = 1; i < threads; i++) {
+    workers.push_back(std::async(std::launch::async, worker));
+  }
+  worker();
+  for (auto& w : workers) {
+    w.get();
   }
-  rKeys = std::move(newKeys);
 }
 
-static inline Status populateAllKeysRecursive(
-    std::set<std::string>& rKeys,
-    size_t currDepth = 1,
-    size_t maxDepth = kRegMaxRecursiveDepth) {
-  if (currDepth > maxDepth) {
-    return Status(1, "Max recursive depth reached");
+static void walkAllSubkeys(HKEY handle,
+                           const std::string& path,
+                           size_t depth,
+                           std::set<std::string>& rKeys,
+                           Status& status) {
+  rKeys.insert(path);
+  if (depth > kRegMaxRecursiveDepth) {
+    status = Status(1, "Max recursive depth reached");
+    return;
   }
 
-  auto size_pre = rKeys.size();
-  auto ret = populateSubkeys(rKeys);
+  std::vector<std::string> subkeys;
+  auto ret = enumerateSubkeys(handle, subkeys);
   if (!ret.ok()) {
-    return ret;
+    status = ret;
   }
-  if (size_pre < rKeys.size()) {
-    auto status = populateAllKeysRecursive(rKeys, ++currDepth);
-    if (!status.ok()) {
-      return status;
+  for (const auto& subkey : subkeys) {
+    auto child = openSubkey(handle, subkey);
+    if (child != nullptr) {
+      walkAllSubkeys(
+          child.get(), path + kRegSep + subkey, depth + 1, rKeys, status);
     }
   }
+}
 
-  return Status::success();
+/*
+ * Descend from an open key, matching each pattern element against the
+ * subkey names before opening them. Only branches that can match the
+ * pattern are opened, each relative to its parent's handle. When parallel
+ * is set the matching branches are walked on separate threads.
+ */
+static void walkRegistryPattern(HKEY handle,
+                                const std::string& path,
+                                const std::vector<std::string>& elems,
+                                size_t index,
+                                bool parallel,
+                                std::set<std::string>& rKeys,
+                                Status& status) {
+  if (index == elems.size()) {
+    rKeys.insert(path);
+    return;
+  }
+
+  // We only care about a recursive glob if it comes at the end of the
+  // pattern i.e. 'HKEY_LOCAL_MACHINE\SOFTWARE\%%'
+  const auto& elem = elems[index];
+  auto last = (index + 1 == elems.size());
+  if (last && boost::ends_with(elem, kSQLGlobRecursive)) {
+    walkAllSubkeys(handle, path, 1, rKeys, status);
+    return;
+  }
+
+  std::vector<std::string> subkeys;
+  if (elem.find(kSQLGlobWildcard) == std::string::npos) {
+    subkeys.push_back(elem);
+  } else {
+    auto ret = enumerateSubkeys(handle, subkeys);
+    if (!ret.ok()) {
+      status = ret;
+    }
+    subkeys.erase(std::remove_if(subkeys.begin(),
+                                 subkeys.end(),
+                                 [&elem](const std::string& name) {
+                                   return sqlite3_strlike(
+                                              elem.c_str(), name.c_str(), 0) !=
+                                          0;
+                                 }),
+                  subkeys.end());
+  }
+
+  if (last) {
+    // The final keys are opened when they are queried.
+    for (const auto& subkey : subkeys) {
+      rKeys.insert(path + kRegSep + subkey);
+    }
+    return;
+  }
+
+  if (!parallel || subkeys.size() < 2) {
+    for (const auto& subkey : subkeys) {
+      auto child = openSubkey(handle, subkey);
+      if (child != nullptr) {
+        walkRegistryPattern(child.get(),
+                            path + kRegSep + subkey,
+                            elems,
+                            index + 1,
+                            parallel,
+                            rKeys,
+                            status);
+      }
+    }
+    return;
+  }
+
+  // Branches such as each user's hive below HKEY_USERS are independent.
+  std::vector<std::set<std::string>> branch_keys(subkeys.size());
+  std::vector<Status> branch_status(subkeys.size());
+  runRegistryWork(subkeys.size(), [&](size_t i) {
+    auto child = openSubkey(handle, subkeys[i]);
+    if (child != nullptr) {
+      walkRegistryPattern(child.get(),
+                          path + kRegSep + subkeys[i],
+                          elems,
+                          index + 1,
+                          false,
+                          branch_keys[i],
+                          branch_status[i]);
+    }
+  });
+
+  for (size_t i = 0; i < subkeys.size(); i++) {
+    rKeys.insert(branch_keys[i].begin(), branch_keys[i].end());
+    if (!branch_status[i].ok()) {
+      status = branch_status[i];
+    }
+  }
 }
 
 Status expandRegistryGlobs(const std::string& pattern,
@@ -481,42 +604,31 @@ Status expandRegistryGlobs(const std::string& pattern,
     return Status::success();
   }
 
+  // The hive is matched like any other element, except that it is never
+  // expanded recursively on its own.
+  const auto& hivePattern = pathElems[0];
+  std::vector<std::string> elems(pathElems.begin() + 1, pathElems.end());
+
   /*
    * Pattern is '%%', grab everything.
    * Note that if '%%' is present but not at the end of the pattern,
    * then it is treated like a single glob.
    */
-  if (boost::ends_with(pathElems[0], kSQLGlobRecursive) &&
-      pathElems.size() == 1) {
-    populateDefaultKeys(results);
-    return populateAllKeysRecursive(results);
+  if (boost::ends_with(hivePattern, kSQLGlobRecursive) && elems.empty()) {
+    elems.push_back(kSQLGlobRecursive);
   }
 
-  // Special handling to insert default keys when glob present in first elem
-  if (pathElems[0].find(kSQLGlobWildcard) != std::string::npos) {
-    populateDefaultKeys(results);
-    pathElems.erase(pathElems.begin());
-  } else {
-    results.insert(pathElems[0]);
-    pathElems.erase(pathElems.begin());
-  }
-
-  for (auto&& elem = pathElems.begin(); elem != pathElems.end(); ++elem) {
-    // We only care about  a recursive glob if it comes at the end of the
-    // pattern i.e. 'HKEY_LOCAL_MACHINE\SOFTWARE\%%'
-    if (boost::ends_with(*elem, kSQLGlobRecursive) &&
-        *elem == pathElems.back()) {
-      return populateAllKeysRecursive(results);
-    } else if ((*elem).find(kSQLGlobWildcard) != std::string::npos) {
-      auto ret = populateSubkeys(results, true);
-      if (!ret.ok()) {
-        return ret;
-      }
-    } else {
-      appendSubkeyToKeys(*elem, results);
+  Status status;
+  auto wildcard = (hivePattern.find(kSQLGlobWildcard) != std::string::npos);
+  for (const auto& hive : kRegistryHives) {
+    if (wildcard ? sqlite3_strlike(hivePattern.c_str(), hive.first.c_str(), 0)
+                 : hivePattern != hive.first) {
+      continue;
     }
+    walkRegistryPattern(
+        hive.second, hive.first, elems, 0, true, results, status);
   }
-  return Status::success();
+  return status;
 }
 
 static inline void maybeWarnLocalUsers(const std::set<std::string>& rKeys) {
@@ -581,8 +693,14 @@ QueryData genRegistry(QueryContext& context) {
 
   maybeWarnLocalUsers(keys);
 
-  for (const auto& key : keys) {
-    queryKey(key, results);
+  // Each key is opened and read independently.
+  std::vector<std::string> key_list(keys.begin(), keys.end());
+  std::vector<QueryData> key_results(key_list.size());
+  runRegistryWork(key_list.size(),
+                  [&](size_t i) { queryKey(key_list[i], key_results[i]); });
+
+  for (auto& rows : key_results) {
+    std::move(rows.begin(), rows.end(), std::back_inserter(results));
   }
   return results;
 }
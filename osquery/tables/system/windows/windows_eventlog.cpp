@@ -34,18 +34,11 @@ const std::string kEventLogXmlPrefix = "<QueryList><Query Id=\"0\">";
 const std::string kEventLogXmlSuffix = "</Query></QueryList>";
 
 Status parseWelXml(QueryContext& context, std::wstring& xml_event, Row& row) {
-  pt::ptree propTree;
   WELEvent windows_event;
-  auto xml_status = parseWindowsEventLogXML(propTree, xml_event);
-  if (!xml_status.ok()) {
-    VLOG(1) << "Error parsing event log XML: " << xml_status.toString();
-    return xml_status;
-  }
-
-  auto pt_status = parseWindowsEventLogPTree(windows_event, propTree);
-  if (!pt_status.ok()) {
-    VLOG(1) << "Error parsing event log PTree: " << pt_status.toString();
-    return pt_status;
+  auto status = parseWindowsEventLog(windows_event, xml_event);
+  if (!status.ok()) {
+    VLOG(1) << "Error parsing event log XML: " << status.toString();
+    return status;
   }
 
   row["time"] = INTEGER(windows_event.osquery_time);
@@ -11,6 +11,20 @@
 #include <sys/stat.h>
 #endif
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/fileops.h>
@@ -25,7 +39,7 @@ namespace osquery {
 
 namespace tables {
 
-#if !defined(WIN32)
+#if !defined(WIN32) && !defined(__linux__)
 
 const std::map<fs::file_type, std::string> kTypeNames{
     {fs::regular_file, "regular"},
@@ -41,9 +55,190 @@ const std::map<fs::file_type, std::string> kTypeNames{
 
 #endif
 
+#if defined(__linux__)
+
+// The statx interface of Linux 4.11, defined here so the table builds with
+// C libraries that do not wrap it.
+struct FileStatxTimestamp {
+  int64_t tv_sec;
+  uint32_t tv_nsec;
+  int32_t reserved;
+};
+
+struct FileStatx {
+  uint32_t stx_mask;
+  uint32_t stx_blksize;
+  uint64_t stx_attributes;
+  uint32_t stx_nlink;
+  uint32_t stx_uid;
+  uint32_t stx_gid;
+  uint16_t stx_mode;
+  uint16_t spare0;
+  uint64_t stx_ino;
+  uint64_t stx_size;
+  uint64_t stx_blocks;
+  uint64_t stx_attributes_mask;
+  FileStatxTimestamp stx_atime;
+  FileStatxTimestamp stx_btime;
+  FileStatxTimestamp stx_ctime;
+  FileStatxTimestamp stx_mtime;
+  uint32_t stx_rdev_major;
+  uint32_t stx_rdev_minor;
+  uint32_t stx_dev_major;
+  uint32_t stx_dev_minor;
+  uint64_t spare2[14];
+};
+
+static_assert(sizeof(FileStatx) == 256, "Unexpected statx size");
+
+const uint32_t kStatxType = 0x1;
+const uint32_t kStatxMode = 0x2;
+const uint32_t kStatxNlink = 0x4;
+const uint32_t kStatxUid = 0x8;
+const uint32_t kStatxGid = 0x10;
+const uint32_t kStatxAtime = 0x20;
+const uint32_t kStatxMtime = 0x40;
+const uint32_t kStatxCtime = 0x80;
+const uint32_t kStatxIno = 0x100;
+const uint32_t kStatxSize = 0x200;
+const uint32_t kStatxBasicStats = 0x7ff;
+const uint32_t kStatxBtime = 0x800;
+
+const int kAtNoAutomount = 0x800;
+const int kAtStatxDontSync = 0x4000;
+
+/// The statx fields backing each column.
+const std::map<std::string, uint32_t> kStatxColumnFields{
+    {"inode", kStatxIno},
+    {"uid", kStatxUid},
+    {"gid", kStatxGid},
+    {"mode", kStatxMode},
+    {"size", kStatxSize},
+    {"hard_links", kStatxNlink},
+    {"atime", kStatxAtime},
+    {"mtime", kStatxMtime},
+    {"ctime", kStatxCtime},
+    {"btime", kStatxBtime},
+};
+
+/// Filesystems whose attributes are revalidated with the server on stat.
+const std::set<uint32_t> kNetworkFilesystems{
+    0x6969, // NFS
+    0x517b, // SMB
+    0xff534d42, // CIFS
+    0xfe534d42, // SMB2
+    0x00c36400, // Ceph
+    0x5346414f, // AFS
+    0x6b414653, // kAFS
+};
+
+#endif
+
+/// How file details are read, the same for each file of a query.
+struct FileStatRequest {
+#if defined(__linux__)
+  /// The statx fields of the used columns.
+  uint32_t mask{kStatxType};
+
+  /// Names are looked up relative to this directory.
+  int dirfd{AT_FDCWD};
+
+  /// Use the cached attributes of network filesystems.
+  bool dont_sync{false};
+#endif
+};
+
+#if defined(__linux__)
+
+/// Read the details of a file, with fstatat on kernels before 4.11.
+bool statFile(const FileStatRequest& request,
+              const char* name,
+              bool follow,
+              FileStatx& file_stat) {
+  auto flags = kAtNoAutomount | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+
+#if defined(SYS_statx)
+  static std::atomic<bool> statx_supported{true};
+  if (statx_supported) {
+    if (request.dont_sync) {
+      flags |= kAtStatxDontSync;
+    }
+    if (::syscall(SYS_statx,
+                  request.dirfd,
+                  name,
+                  flags,
+                  request.mask,
+                  &file_stat) == 0) {
+      return true;
+    }
+
+    if (errno != ENOSYS) {
+      return false;
+    }
+    statx_supported = false;
+    flags &= ~kAtStatxDontSync;
+  }
+#endif
+
+  struct stat legacy_stat;
+  if (::fstatat(request.dirfd, name, &legacy_stat, flags) != 0) {
+    return false;
+  }
+
+  file_stat = {};
+  file_stat.stx_mask = kStatxBasicStats;
+  file_stat.stx_blksize = static_cast<uint32_t>(legacy_stat.st_blksize);
+  file_stat.stx_nlink = static_cast<uint32_t>(legacy_stat.st_nlink);
+  file_stat.stx_uid = legacy_stat.st_uid;
+  file_stat.stx_gid = legacy_stat.st_gid;
+  file_stat.stx_mode = static_cast<uint16_t>(legacy_stat.st_mode);
+  file_stat.stx_ino = legacy_stat.st_ino;
+  file_stat.stx_size = static_cast<uint64_t>(legacy_stat.st_size);
+  file_stat.stx_atime.tv_sec = legacy_stat.st_atime;
+  file_stat.stx_mtime.tv_sec = legacy_stat.st_mtime;
+  file_stat.stx_ctime.tv_sec = legacy_stat.st_ctime;
+  file_stat.stx_rdev_major = major(legacy_stat.st_rdev);
+  file_stat.stx_rdev_minor = minor(legacy_stat.st_rdev);
+  return true;
+}
+
+/// The type name of a file mode, as the type column reports it.
+std::string getTypeName(uint16_t mode) {
+  switch (mode & S_IFMT) {
+  case S_IFREG:
+    return "regular";
+  case S_IFDIR:
+    return "directory";
+  case S_IFLNK:
+    return "symlink";
+  case S_IFBLK:
+    return "block";
+  case S_IFCHR:
+    return "character";
+  case S_IFIFO:
+    return "fifo";
+  case S_IFSOCK:
+    return "socket";
+  default:
+    return "unknown";
+  }
+}
+
+/// Check if a directory, or the directory of a file, is on a network.
+bool isNetworkFilesystem(int fd, const std::string& path) {
+  struct statfs fs_stat;
+  auto result = (fd >= 0) ? ::fstatfs(fd, &fs_stat)
+                          : ::statfs(path.c_str(), &fs_stat);
+  return result == 0 &&
+         kNetworkFilesystems.count(static_cast<uint32_t>(fs_stat.f_type)) > 0;
+}
+
+#endif
+
 void genFileInfo(const fs::path& path,
                  const fs::path& parent,
                  const std::string& pattern,
+                 const FileStatRequest& request,
                  QueryData& results) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
@@ -54,7 +249,71 @@ void genFileInfo(const fs::path& path,
   r["directory"] = parent.string();
   r["symlink"] = "0";
 
-#if !defined(WIN32)
+#if defined(__linux__)
+
+  // Directory entries are looked up by name in their open directory.
+  auto name = (request.dirfd == AT_FDCWD) ? path.string()
+                                          : path.filename().string();
+
+  FileStatx link_stat;
+  if (!statFile(request, name.c_str(), false, link_stat)) {
+    // Path was not real, had too may links, or could not be accessed.
+    return;
+  }
+
+  // Only links need a second lookup, of their target.
+  auto file_stat = link_stat;
+  r["type"] = getTypeName(link_stat.stx_mode);
+  if (S_ISLNK(link_stat.stx_mode)) {
+    r["symlink"] = "1";
+    if (statFile(request, name.c_str(), true, file_stat)) {
+      r["type"] = getTypeName(file_stat.stx_mode);
+    } else {
+      file_stat = link_stat;
+      r["type"] = (errno == ENOENT || errno == ENOTDIR) ? "unknown" : "error";
+    }
+  }
+
+  // Columns are only set for the requested, and returned, fields.
+  auto fields = request.mask & file_stat.stx_mask;
+  if (fields & kStatxIno) {
+    r["inode"] = BIGINT(file_stat.stx_ino);
+  }
+  if (fields & kStatxUid) {
+    r["uid"] = BIGINT(file_stat.stx_uid);
+  }
+  if (fields & kStatxGid) {
+    r["gid"] = BIGINT(file_stat.stx_gid);
+  }
+  if (fields & kStatxMode) {
+    r["mode"] = lsperms(file_stat.stx_mode);
+  }
+  r["device"] = BIGINT(
+      makedev(file_stat.stx_rdev_major, file_stat.stx_rdev_minor));
+  if (fields & kStatxSize) {
+    r["size"] = BIGINT(file_stat.stx_size);
+  }
+  r["block_size"] = INTEGER(file_stat.stx_blksize);
+  if (fields & kStatxNlink) {
+    r["hard_links"] = INTEGER(file_stat.stx_nlink);
+  }
+
+  if (fields & kStatxAtime) {
+    r["atime"] = BIGINT(file_stat.stx_atime.tv_sec);
+  }
+  if (fields & kStatxMtime) {
+    r["mtime"] = BIGINT(file_stat.stx_mtime.tv_sec);
+  }
+  if (fields & kStatxCtime) {
+    r["ctime"] = BIGINT(file_stat.stx_ctime.tv_sec);
+  }
+
+  // Filesystems without a birth time, and kernels before 4.11, report 0.
+  r["btime"] = (fields & kStatxBtime) ? BIGINT(file_stat.stx_btime.tv_sec)
+                                      : BIGINT(0);
+  r["pid_with_namespace"] = "0";
+
+#elif !defined(WIN32)
 
   struct stat file_stat;
 
@@ -85,13 +344,7 @@ void genFileInfo(const fs::path& path,
   r["mtime"] = BIGINT(file_stat.st_mtime);
   r["ctime"] = BIGINT(file_stat.st_ctime);
 
-#if defined(__linux__)
-  // No 'birth' or create time in Linux or Windows.
-  r["btime"] = "0";
-  r["pid_with_namespace"] = "0";
-#else
   r["btime"] = BIGINT(file_stat.st_birthtimespec.tv_sec);
-#endif
 
   // Type booleans
   boost::system::error_code ec;
@@ -148,50 +401,50 @@ void genFileInfo(const fs::path& path,
   results.push_back(r);
 }
 
+/// Only read the file details of the used columns.
+FileStatRequest getStatRequest(const QueryContext& context) {
+  FileStatRequest request;
+#if defined(__linux__)
+  for (const auto& column : kStatxColumnFields) {
+    if (context.isColumnUsed(column.first)) {
+      request.mask |= column.second;
+    }
+  }
+#endif
+  return request;
+}
+
 QueryData genFileImpl(QueryContext& context, Logger& logger) {
   QueryData results;
+  auto request = getStatRequest(context);
 
-  // Resolve file paths for EQUALS and LIKE operations.
+  // Resolve file paths for EQUALS and pattern operations.
   auto paths = context.constraints["path"].getAll(EQUALS);
-  context.expandConstraints(
-      "path",
-      LIKE,
-      paths,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_ALL | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
-          }
-        }
-        return status;
-      }));
+  context.expandPathConstraints("path", GLOB_ALL | GLOB_NO_CANON, paths);
 
   // Iterate through each of the resolved/supplied paths.
+#if defined(__linux__)
+  std::string last_parent;
+#endif
   for (const auto& path_string : paths) {
     fs::path path = path_string;
-    genFileInfo(path, path.parent_path(), "", results);
+
+#if defined(__linux__)
+    // Expanded patterns list files of the same directory together.
+    auto parent = path.parent_path().string();
+    if (parent != last_parent) {
+      request.dont_sync = isNetworkFilesystem(-1, parent);
+      last_parent = std::move(parent);
+    }
+#endif
+
+    genFileInfo(path, path.parent_path(), "", request, results);
   }
 
-  // Resolve directories for EQUALS and LIKE operations.
+  // Resolve directories for EQUALS and pattern operations.
   auto directories = context.constraints["directory"].getAll(EQUALS);
-  context.expandConstraints(
-      "directory",
-      LIKE,
-      directories,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_FOLDERS | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
-          }
-        }
-        return status;
-      }));
+  context.expandPathConstraints(
+      "directory", GLOB_FOLDERS | GLOB_NO_CANON, directories);
 
   // Now loop through constraints using the directory column constraint.
   for (const auto& directory_string : directories) {
@@ -199,15 +452,34 @@ QueryData genFileImpl(QueryContext& context, Logger& logger) {
       continue;
     }
 
+    auto directory_request = request;
+#if defined(__linux__)
+    directory_request.dirfd =
+        ::open(directory_string.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory_request.dirfd < 0) {
+      continue;
+    }
+    directory_request.dont_sync =
+        isNetworkFilesystem(directory_request.dirfd, directory_string);
+#endif
+
+    auto start = std::chrono::steady_clock::now();
     try {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
       for (; begin != end; ++begin) {
-        genFileInfo(begin->path(), directory_string, "", results);
+        genFileInfo(
+            begin->path(), directory_string, "", directory_request, results);
       }
     } catch (const fs::filesystem_error& /* e */) {
-      continue;
     }
+
+#if defined(__linux__)
+    ::close(directory_request.dirfd);
+#endif
+
+    // Large sweeps pause between directories, files are too cheap to pace.
+    throttleScanItem(std::chrono::steady_clock::now() - start);
   }
 
   return results;
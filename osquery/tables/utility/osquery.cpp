@@ -11,8 +11,10 @@
 #include <osquery/config/packs.h>
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/memory.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
+#include <osquery/database/database.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/eventsubscriber.h>
@@ -42,6 +44,9 @@ QueryData genOsqueryEvents(QueryContext& context) {
     r["name"] = publisher;
     r["publisher"] = publisher;
     r["type"] = "publisher";
+    r["dropped"] = "0";
+    r["limited"] = "0";
+    r["sampled_out"] = "0";
 
     auto pubref = EventFactory::getEventPublisher(publisher);
     if (pubref != nullptr) {
@@ -71,12 +76,18 @@ QueryData genOsqueryEvents(QueryContext& context) {
       r["publisher"] = subref->getType();
       r["subscriptions"] = INTEGER(subref->numSubscriptions());
       r["events"] = INTEGER(subref->numEvents());
+      r["dropped"] = INTEGER(subref->numDroppedEvents());
+      r["limited"] = INTEGER(subref->numLimitedEvents());
+      r["sampled_out"] = INTEGER(subref->numSampledOutEvents());
 
       // Subscribers are always active, even if their publisher is not.
       r["active"] = (subref->state() == EventState::EVENT_RUNNING) ? "1" : "0";
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
+      r["dropped"] = "0";
+      r["limited"] = "0";
+      r["sampled_out"] = "0";
       r["active"] = "-1";
     }
     results.push_back(r);
@@ -231,6 +242,81 @@ QueryData genOsqueryInfo(QueryContext& context) {
   return results;
 }
 
+QueryData genOsqueryDatabase(QueryContext& context) {
+  QueryData results;
+
+  DatabaseMemoryUsage usage;
+  if (!getDatabaseMemoryUsage(usage).ok()) {
+    return results;
+  }
+
+  Row r;
+  r["plugin"] = RegistryFactory::get().getActive("database");
+  r["memory_budget"] = BIGINT(usage.budget);
+  r["block_cache"] = BIGINT(usage.block_cache);
+  r["block_cache_pinned"] = BIGINT(usage.block_cache_pinned);
+  r["memtables"] = BIGINT(usage.memtables);
+  r["table_readers"] = BIGINT(usage.table_readers);
+  results.push_back(r);
+  return results;
+}
+
+QueryData genOsqueryDatabaseDomains(QueryContext& context) {
+  QueryData results;
+
+  std::vector<DatabaseDomainStats> stats;
+  if (!getDatabaseDomainStats(stats).ok()) {
+    return results;
+  }
+
+  for (const auto& domain : stats) {
+    Row r;
+    r["domain"] = domain.domain;
+    r["keys"] = BIGINT(domain.keys);
+    r["memtables"] = BIGINT(domain.memtables);
+    r["sst_files"] = BIGINT(domain.sst_files);
+    r["sst_bytes"] = BIGINT(domain.sst_bytes);
+    r["live_bytes"] = BIGINT(domain.live_bytes);
+    r["pending_compaction_bytes"] = BIGINT(domain.pending_compaction_bytes);
+    r["write_slowdowns"] = BIGINT(domain.write_slowdowns);
+    r["write_stops"] = BIGINT(domain.write_stops);
+    r["write_stopped"] = INTEGER(domain.write_stopped ? 1 : 0);
+    results.push_back(r);
+  }
+  return results;
+}
+
+QueryData genOsqueryMemory(QueryContext& context) {
+  QueryData results;
+
+  auto add = [&results](const std::string& subsystem,
+                        const std::string& name,
+                        int64_t bytes,
+                        int64_t items) {
+    Row r;
+    r["subsystem"] = subsystem;
+    r["name"] = name;
+    r["bytes"] = BIGINT(bytes);
+    r["items"] = BIGINT(items);
+    results.push_back(std::move(r));
+  };
+
+  AllocatorStats stats;
+  if (getAllocatorStats(stats).ok()) {
+    add("allocator", "heap", stats.heap, -1);
+    add("allocator", "in_use", stats.in_use, -1);
+    add("allocator", "free", stats.free, -1);
+    add("allocator", "free_chunks", -1, stats.free_chunks);
+    add("allocator", "mapped", stats.mapped, -1);
+    add("allocator", "releasable", stats.releasable, -1);
+  }
+
+  for (const auto& held : getSubsystemMemory()) {
+    add(held.subsystem, held.name, held.bytes, held.items);
+  }
+  return results;
+}
+
 QueryData genOsquerySchedule(QueryContext& context) {
   QueryData results;
 
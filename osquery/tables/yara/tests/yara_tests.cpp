@@ -9,7 +9,9 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/registry/registry_interface.h>
 #include <osquery/tables/yara/yara_utils.h>
 
 #include <boost/filesystem.hpp>
@@ -20,6 +22,8 @@ namespace fs = boost::filesystem;
 
 namespace osquery {
 
+DECLARE_bool(yara_persist_rules);
+
 const std::string alwaysTrue = "rule always_true { condition: true }";
 const std::string alwaysFalse = "rule always_false { condition: false }";
 
@@ -130,6 +134,52 @@ TEST_F(YARATest, should_skip_file) {
 #endif
 }
 
+TEST_F(YARATest, test_persisted_rules) {
+  registryAndPluginInit();
+  initDatabasePluginForTesting();
+  ASSERT_EQ(yr_initialize(), ERROR_SUCCESS);
+
+  auto persist_rules = FLAGS_yara_persist_rules;
+  FLAGS_yara_persist_rules = true;
+
+  const auto rule_file = fs::temp_directory_path() /
+                         fs::unique_path("osquery.tests.yara.%%%%.%%%%.sig");
+  writeTextFile(rule_file.string(), alwaysTrue);
+
+  YR_RULES* rules = nullptr;
+  ASSERT_TRUE(compileSingleFile(rule_file.string(), &rules).ok());
+  yr_rules_destroy(rules);
+
+  std::string persisted;
+  auto key = "file." + rule_file.string();
+  ASSERT_TRUE(getDatabaseValue(kYaraRules, key, persisted).ok());
+
+  // The unchanged file loads the persisted rules.
+  rules = nullptr;
+  ASSERT_TRUE(compileSingleFile(rule_file.string(), &rules).ok());
+  ASSERT_NE(rules, nullptr);
+  YR_RULE* rule = nullptr;
+  std::string identifiers;
+  yr_rules_foreach(rules, rule) {
+    identifiers += rule->identifier;
+  }
+  EXPECT_EQ(identifiers, "always_true");
+  yr_rules_destroy(rules);
+
+  // A changed file is compiled and replaces them.
+  writeTextFile(rule_file.string(), alwaysFalse);
+  rules = nullptr;
+  ASSERT_TRUE(compileSingleFile(rule_file.string(), &rules).ok());
+  yr_rules_destroy(rules);
+
+  std::string updated;
+  ASSERT_TRUE(getDatabaseValue(kYaraRules, key, updated).ok());
+  EXPECT_NE(persisted.substr(0, 64), updated.substr(0, 64));
+
+  FLAGS_yara_persist_rules = persist_rules;
+  fs::remove_all(rule_file);
+}
+
 TEST_F(YARATest, test_match_string_true) {
   Row r = scanString(alwaysTrue);
   // expect count 1
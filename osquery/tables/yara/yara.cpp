@@ -12,6 +12,10 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <regex>
 #include <thread>
 
@@ -54,6 +58,18 @@ FLAG(uint32,
      "Time in ms to sleep after scan of each file (default 50) to reduce "
      "memory spikes");
 
+FLAG(uint32,
+     yara_cpu_limit,
+     0,
+     "Percent of a CPU each YARA scan thread may use, replaces yara_delay "
+     "(default 0 keeps the delay)");
+
+FLAG(bool,
+     yara_persist_rules,
+     false,
+     "Keep compiled YARA signature files and groups in the database, and load "
+     "them while their sources are unchanged");
+
 HIDDEN_FLAG(bool,
             enable_yara_string,
             false,
@@ -155,7 +171,65 @@ Status getRuleFromURL(const std::string& url, std::string& rule) {
   return Status::success();
 }
 
-void doYARAScan(YR_RULES* rules,
+/**
+ * @brief The scanners of one scan thread, one for each set of rules.
+ *
+ * Creating a scanner allocates its matching state, so each thread keeps its
+ * scanners for all the files it scans.
+ */
+class YaraScanners final : boost::noncopyable {
+ public:
+  ~YaraScanners() {
+    for (auto& scanner : scanners_) {
+      yr_scanner_destroy(scanner.second);
+    }
+  }
+
+  /// The scanner for a set of rules, or nullptr if it cannot be created.
+  YR_SCANNER* get(YR_RULES* rules) {
+    auto it = scanners_.find(rules);
+    if (it != scanners_.end()) {
+      return it->second;
+    }
+
+    YR_SCANNER* scanner = nullptr;
+    if (yr_scanner_create(rules, &scanner) != ERROR_SUCCESS) {
+      return nullptr;
+    }
+
+    yr_scanner_set_flags(scanner, SCAN_FLAGS_FAST_MODE);
+    scanners_[rules] = scanner;
+    return scanner;
+  }
+
+ private:
+  std::map<YR_RULES*, YR_SCANNER*> scanners_;
+};
+
+/// Pause a scan thread after a file, to bound its CPU or memory use.
+static void throttleYARAScan(std::chrono::steady_clock::duration scan_time) {
+  // Throttled scans are paced by the host pressure instead.
+  if (ScanThrottleScope::enabled()) {
+    throttleScanItem(scan_time);
+    return;
+  }
+
+  if (FLAGS_yara_cpu_limit == 0) {
+    // sleep between each file to help smooth out malloc spikes
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_yara_delay));
+    return;
+  }
+
+  if (FLAGS_yara_cpu_limit >= 100) {
+    return;
+  }
+
+  // Idle long enough for the scan to have used the limit's share of a CPU.
+  std::this_thread::sleep_for(scan_time * (100 - FLAGS_yara_cpu_limit) /
+                              FLAGS_yara_cpu_limit);
+}
+
+void doYARAScan(YR_SCANNER* scanner,
                 const std::string& path,
                 QueryData& results,
                 YaraRuleType yr_type,
@@ -192,8 +266,8 @@ void doYARAScan(YR_RULES* rules,
   }
 
   // Perform the scan, using the static YARA subscriber callback.
-  int result = yr_rules_scan_file(
-      rules, path.c_str(), SCAN_FLAGS_FAST_MODE, YARACallback, (void*)&row, 0);
+  yr_scanner_set_callback(scanner, YARACallback, (void*)&row);
+  int result = yr_scanner_scan_file(scanner, path.c_str());
   if (result == ERROR_SUCCESS) {
     results.push_back(std::move(row));
   }
@@ -338,47 +412,61 @@ QueryData genYara(QueryContext& context) {
 
   // Get all the paths specified
   auto paths = context.constraints["path"].getAll(EQUALS);
-  context.expandConstraints(
-      "path",
-      LIKE,
-      paths,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_FILES | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            struct stat sb;
-            if (0 != stat(resolved.c_str(), &sb)) {
-              continue; // failed to stat the file
-            }
-
-            // Check that each resolved path is readable.
-            if (isReadable(resolved) &&
-                !yaraShouldSkipFile(resolved, sb.st_mode)) {
-              paths.insert(resolved);
-            }
-          }
-        }
-        return status;
-      }));
+  std::set<std::string> patterns;
+  context.expandPathConstraints("path", GLOB_FILES | GLOB_NO_CANON, patterns);
+  for (const auto& resolved : patterns) {
+    struct stat sb;
+    if (0 != stat(resolved.c_str(), &sb)) {
+      continue; // failed to stat the file
+    }
 
-  // Scan every path pair with the yara rules
+    // Check that each resolved path is readable.
+    if (isReadable(resolved) && !yaraShouldSkipFile(resolved, sb.st_mode)) {
+      paths.insert(resolved);
+    }
+  }
+
+  // Resolve the rules of the scan context before scanning in parallel.
   auto& rules = yaraParser->rules();
-  for (const auto& path : paths) {
-    for (const auto& sign : scanContext) {
-      if (rules.count(hashStr(sign.second, sign.first)) > 0) {
-        doYARAScan(rules[hashStr(sign.second, sign.first)],
-                   path.c_str(),
-                   results,
-                   sign.first,
-                   sign.second);
-
-        // sleep between each file to help smooth out malloc spikes
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(FLAGS_yara_delay));
+  std::vector<std::pair<YR_RULES*, const YaraScanContext::value_type*>> scans;
+  for (const auto& sign : scanContext) {
+    auto it = rules.find(hashStr(sign.second, sign.first));
+    if (it != rules.end()) {
+      scans.push_back(std::make_pair(it->second, &sign));
+    }
+  }
+
+  // Scan every path pair with the yara rules. Each scan thread takes the next
+  // path and keeps its own scanners, the rows are merged in path order.
+  std::vector<std::string> scan_paths(paths.begin(), paths.end());
+  std::vector<QueryData> path_results(scan_paths.size());
+  std::atomic<size_t> next_path{0};
+  auto scan_worker = [&](size_t) {
+    YaraScanners scanners;
+    for (size_t i = next_path++; i < scan_paths.size(); i = next_path++) {
+      for (const auto& scan : scans) {
+        auto scanner = scanners.get(scan.first);
+        if (scanner == nullptr) {
+          continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        doYARAScan(scanner,
+                   scan_paths[i],
+                   path_results[i],
+                   scan.second->first,
+                   scan.second->second);
+        throttleYARAScan(std::chrono::steady_clock::now() - start);
       }
     }
+  };
+  runTableTasks(std::min(getTableWorkerCount(), scan_paths.size()),
+                scan_worker);
+
+  for (auto& path_result : path_results) {
+    results.insert(results.end(),
+                   std::make_move_iterator(path_result.begin()),
+                   std::make_move_iterator(path_result.end()));
   }
 
   // Rule string is hashed before adding to the cache. There are
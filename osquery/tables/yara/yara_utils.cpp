@@ -7,10 +7,16 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <osquery/config/config.h>
+#include <osquery/database/database.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/tables/yara/yara_utils.h>
@@ -20,6 +26,120 @@
 namespace osquery {
 
 DECLARE_bool(enable_yara_string);
+DECLARE_bool(yara_persist_rules);
+
+namespace {
+
+/// Compiled rules are saved after the hash of the sources they came from.
+const size_t kYaraSourceHashSize{64};
+
+/// A YR_STREAM buffer, for saving and loading compiled rules.
+struct YaraRulesBuffer {
+  std::string data;
+  size_t offset{0};
+};
+
+size_t readYaraRulesBuffer(void* ptr,
+                           size_t size,
+                           size_t count,
+                           void* user_data) {
+  auto buffer = static_cast<YaraRulesBuffer*>(user_data);
+  if (size == 0 || buffer->offset > buffer->data.size()) {
+    return 0;
+  }
+
+  count = std::min(count, (buffer->data.size() - buffer->offset) / size);
+  std::memcpy(ptr, buffer->data.data() + buffer->offset, size * count);
+  buffer->offset += size * count;
+  return count;
+}
+
+size_t writeYaraRulesBuffer(const void* ptr,
+                            size_t size,
+                            size_t count,
+                            void* user_data) {
+  auto buffer = static_cast<YaraRulesBuffer*>(user_data);
+  buffer->data.append(static_cast<const char*>(ptr), size * count);
+  return count;
+}
+
+/**
+ * @brief Hash the paths and contents of the rule files compiled together.
+ *
+ * Returns an empty string, and the rules are not persisted, if a file cannot
+ * be read or includes other files, whose changes would not be noticed.
+ */
+std::string getRuleSourcesHash(const std::vector<std::string>& files) {
+  if (!FLAGS_yara_persist_rules) {
+    return "";
+  }
+
+  std::string sources;
+  for (const auto& file : files) {
+    std::string content;
+    if (!readFile(file, content).ok() ||
+        content.find("include") != std::string::npos) {
+      return "";
+    }
+
+    sources += file + '\0' + content + '\0';
+  }
+  return hashFromBuffer(HASH_TYPE_SHA256, sources.data(), sources.size());
+}
+
+/// Load rules persisted by an earlier compile of the same sources.
+bool loadPersistedRules(const std::string& name,
+                        const std::string& source_hash,
+                        YR_RULES** rules) {
+  if (source_hash.empty()) {
+    return false;
+  }
+
+  YaraRulesBuffer buffer;
+  if (!getDatabaseValue(kYaraRules, name, buffer.data).ok() ||
+      buffer.data.compare(0, kYaraSourceHashSize, source_hash) != 0) {
+    return false;
+  }
+
+  // Rules saved by another version of YARA fail to load and are compiled.
+  buffer.offset = kYaraSourceHashSize;
+  YR_STREAM stream = {};
+  stream.user_data = &buffer;
+  stream.read = readYaraRulesBuffer;
+  if (yr_rules_load_stream(&stream, rules) != ERROR_SUCCESS) {
+    return false;
+  }
+
+  VLOG(1) << "Loaded compiled YARA rules for " << name;
+  return true;
+}
+
+/// Persist compiled rules so they are loaded instead of compiled next time.
+void persistRules(const std::string& name,
+                  const std::string& source_hash,
+                  YR_RULES* rules) {
+  if (source_hash.empty()) {
+    return;
+  }
+
+  YaraRulesBuffer buffer;
+  buffer.data = source_hash;
+  YR_STREAM stream = {};
+  stream.user_data = &buffer;
+  stream.write = writeYaraRulesBuffer;
+  if (yr_rules_save_stream(rules, &stream) != ERROR_SUCCESS) {
+    VLOG(1) << "Could not save compiled YARA rules for " << name;
+    return;
+  }
+
+  auto status = setDatabaseValue(kYaraRules, name, buffer.data);
+  if (!status.ok()) {
+    VLOG(1) << "Could not persist compiled YARA rules for " << name << ": "
+            << status.getMessage();
+  }
+}
+
+} // namespace
 
 bool yaraShouldSkipFile(const std::string& path, mode_t st_mode) {
   // avoid special files /dev/x , /proc/x, FIFO's named-pipes, etc.
@@ -96,12 +216,17 @@ Status compileSingleFile(const std::string& file, YR_RULES** rules) {
   // If you want to use saved rule files you must have them all in a single
   // file. This is easy to accomplish with yarac(1).
   result = yr_rules_load(file.c_str(), &tmp_rules);
+  auto source_hash =
+      (result == ERROR_INVALID_FILE) ? getRuleSourcesHash({file}) : "";
   if (result != ERROR_SUCCESS && result != ERROR_INVALID_FILE) {
     yr_compiler_destroy(compiler);
     return Status::failure("Error loading YARA rules: " +
                            std::to_string(result));
   } else if (result == ERROR_SUCCESS) {
     *rules = tmp_rules;
+  } else if (loadPersistedRules("file." + file, source_hash, rules)) {
+    yr_compiler_destroy(compiler);
+    return Status::success();
   } else {
     compiled = true;
     // Try to compile the rules.
@@ -133,6 +258,7 @@ Status compileSingleFile(const std::string& file, YR_RULES** rules) {
       yr_compiler_destroy(compiler);
       return Status::failure("Insufficient memory to get YARA rules");
     }
+    persistRules("file." + file, source_hash, *rules);
   }
 
   if (compiler != nullptr) {
@@ -204,17 +330,35 @@ Status handleRuleFiles(const std::string& category,
 
   yr_compiler_set_callback(compiler, YARACompilerCallback, nullptr);
 
-  bool compiled = false;
+  std::vector<std::string> files;
   for (const auto& item : rule_files.GetArray()) {
     if (!item.IsString()) {
       continue;
     }
 
-    YR_RULES* tmp_rules = nullptr;
     std::string rule = item.GetString();
     if (boost::filesystem::path(rule).is_relative()) {
       rule = kYARAHome + rule;
     }
+    files.push_back(std::move(rule));
+  }
+
+  // A group that did not change since an earlier process compiled it.
+  auto source_hash = getRuleSourcesHash(files);
+  YR_RULES* persisted_rules = nullptr;
+  if (loadPersistedRules("group." + category, source_hash, &persisted_rules)) {
+    if (rules.count(category) > 0) {
+      yr_rules_destroy(rules[category]);
+    }
+
+    rules[category] = persisted_rules;
+    yr_compiler_destroy(compiler);
+    return Status::success();
+  }
+
+  bool compiled = false;
+  for (const auto& rule : files) {
+    YR_RULES* tmp_rules = nullptr;
 
     // First attempt to load the file, in case it is saved (pre-compiled)
     // rules. Sadly there is no way to load multiple compiled rules in
@@ -274,6 +418,7 @@ Status handleRuleFiles(const std::string& category,
       yr_compiler_destroy(compiler);
       return Status(1, "Insufficient memory to get YARA rules");
     }
+    persistRules("group." + category, source_hash, rules[category]);
   }
 
   if (compiler != nullptr) {
@@ -74,7 +74,7 @@ std::string getAzureKey(JSON& doc, const std::string& key) {
   return doc.doc()[key].GetString();
 }
 
-Status fetchAzureMetadata(JSON& doc) {
+Status fetchAzureMetadataString(std::string& json) {
   if (!isAzureInstance()) {
     return Status(1, "Not an Azure instance");
   }
@@ -102,7 +102,21 @@ Status fetchAzureMetadata(JSON& doc) {
                       std::to_string(response.result_int()));
   }
 
-  auto s = doc.fromString(response.body());
+  json = response.body();
+  return Status::success();
+}
+
+Status fetchAzureMetadata(JSON& doc) {
+  std::string json;
+  auto s = fetchAzureMetadataString(json);
+  if (!s.ok()) {
+    return s;
+  }
+  return parseAzureMetadata(json, doc);
+}
+
+Status parseAzureMetadata(const std::string& json, JSON& doc) {
+  auto s = doc.fromString(json);
   if (!s.ok()) {
     return s;
   }
@@ -18,4 +18,10 @@ std::string getAzureKey(JSON& doc, const std::string& key);
 
 Status fetchAzureMetadata(JSON& doc);
 
+/// Fetch the instance metadata document without parsing it.
+Status fetchAzureMetadataString(std::string& json);
+
+/// Parse an instance metadata document.
+Status parseAzureMetadata(const std::string& json, JSON& doc);
+
 } // namespace osquery
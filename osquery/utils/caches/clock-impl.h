@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+namespace osquery {
+namespace caches {
+
+namespace impl {
+
+/// Spread the bits of a hash, identity hashes would cluster the table.
+inline std::uint64_t mixHash(std::size_t hash) {
+  auto mixed = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+  return mixed ^ (mixed >> 32);
+}
+
+} // namespace impl
+
+template <typename KeyType, typename ValueType, typename Hash>
+Clock<KeyType, ValueType, Hash>::Clock(std::size_t capacity,
+                                       std::size_t max_weight)
+    : capacity_(std::max<std::size_t>(capacity, 1)), max_weight_(max_weight) {
+  // The table grows with the elements, a large capacity costs nothing upfront.
+  slots_.resize(kMinSlots);
+  mask_ = kMinSlots - 1;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+std::size_t Clock<KeyType, ValueType, Hash>::home(const KeyType& key) const {
+  return static_cast<std::size_t>(impl::mixHash(Hash()(key))) & mask_;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+std::size_t Clock<KeyType, ValueType, Hash>::find(const KeyType& key) const {
+  for (auto i = home(key);; i = (i + 1) & mask_) {
+    const auto& slot = slots_[i];
+    if (slot.state == SlotState::Empty) {
+      return kNotFound;
+    }
+    if (slot.state == SlotState::Full && slot.key == key) {
+      return i;
+    }
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+ValueType* Clock<KeyType, ValueType, Hash>::insert(const KeyType& key,
+                                                   ValueType value,
+                                                   std::size_t weight) {
+  // A replaced element keeps its mark, as an access would set it.
+  bool replaced = false;
+  auto found = find(key);
+  if (found != kNotFound) {
+    release(slots_[found]);
+    replaced = true;
+  }
+
+  if (size_ >= capacity_) {
+    evict();
+  }
+  while (max_weight_ > 0 && size_ > 0 && weight_ + weight > max_weight_) {
+    evict();
+  }
+
+  // Reuse the first deleted slot of the probe sequence.
+  auto i = home(key);
+  while (slots_[i].state == SlotState::Full) {
+    i = (i + 1) & mask_;
+  }
+  auto& slot = slots_[i];
+  if (slot.state == SlotState::Deleted) {
+    deleted_--;
+  }
+  slot.key = key;
+  slot.value = std::move(value);
+  slot.weight = weight;
+  slot.state = SlotState::Full;
+  slot.referenced = replaced;
+  size_++;
+  weight_ += weight;
+
+  // Deleted slots lengthen the probes of missing keys, as does a full table.
+  if ((size_ + deleted_) * 4 > slots_.size() * 3) {
+    rehash();
+    return &slots_[find(key)].value;
+  }
+  return &slot.value;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+ValueType* Clock<KeyType, ValueType, Hash>::get(const KeyType& key) {
+  auto found = find(key);
+  if (found == kNotFound) {
+    return nullptr;
+  }
+  slots_[found].referenced = true;
+  return &slots_[found].value;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool Clock<KeyType, ValueType, Hash>::erase(const KeyType& key) {
+  auto found = find(key);
+  if (found == kNotFound) {
+    return false;
+  }
+  release(slots_[found]);
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+template <typename Predicate>
+std::size_t Clock<KeyType, ValueType, Hash>::eraseIf(Predicate predicate) {
+  std::size_t erased = 0;
+  for (auto& slot : slots_) {
+    if (slot.state == SlotState::Full && predicate(slot.key, slot.value)) {
+      release(slot);
+      erased++;
+    }
+  }
+  return erased;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void Clock<KeyType, ValueType, Hash>::clear() {
+  for (auto& slot : slots_) {
+    slot = Slot();
+  }
+  hand_ = 0;
+  size_ = 0;
+  deleted_ = 0;
+  weight_ = 0;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void Clock<KeyType, ValueType, Hash>::release(Slot& slot) {
+  // Release what the element holds, the slot stays part of probe sequences.
+  slot.key = KeyType();
+  slot.value = ValueType();
+  slot.state = SlotState::Deleted;
+  slot.referenced = false;
+  weight_ -= slot.weight;
+  slot.weight = 0;
+  size_--;
+  deleted_++;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void Clock<KeyType, ValueType, Hash>::evict() {
+  if (size_ == 0) {
+    return;
+  }
+
+  // Within two sweeps every mark is cleared, an element is found.
+  while (true) {
+    auto& slot = slots_[hand_];
+    hand_ = (hand_ + 1) & mask_;
+    if (slot.state != SlotState::Full) {
+      continue;
+    }
+    if (slot.referenced) {
+      slot.referenced = false;
+      continue;
+    }
+    release(slot);
+    return;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void Clock<KeyType, ValueType, Hash>::rehash() {
+  // At most half of the new slots hold elements, probes stay short.
+  std::size_t count = kMinSlots;
+  while (count < size_ * 2) {
+    count *= 2;
+  }
+  std::vector<Slot> slots(count);
+  std::swap(slots, slots_);
+  mask_ = count - 1;
+  for (auto& slot : slots) {
+    if (slot.state != SlotState::Full) {
+      continue;
+    }
+    auto i = home(slot.key);
+    while (slots_[i].state == SlotState::Full) {
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = std::move(slot);
+  }
+  deleted_ = 0;
+  hand_ = 0;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+ShardedClock<KeyType, ValueType, Hash>::ShardedClock(std::size_t capacity,
+                                                     std::size_t shards,
+                                                     std::size_t max_weight) {
+  shards = std::max<std::size_t>(shards, 1);
+  auto shard_capacity = (capacity + shards - 1) / shards;
+  auto shard_weight = (max_weight + shards - 1) / shards;
+  for (std::size_t i = 0; i < shards; i++) {
+    shards_.push_back(std::make_unique<Shard>(shard_capacity, shard_weight));
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+typename ShardedClock<KeyType, ValueType, Hash>::Shard&
+ShardedClock<KeyType, ValueType, Hash>::shard(const KeyType& key) {
+  // The high bits pick the shard, the low bits pick the slot within it.
+  auto hash = impl::mixHash(Hash()(key));
+  return *shards_[static_cast<std::size_t>(hash >> 40) % shards_.size()];
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ShardedClock<KeyType, ValueType, Hash>::insert(const KeyType& key,
+                                                    ValueType value,
+                                                    std::size_t weight) {
+  auto& s = shard(key);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.cache.insert(key, std::move(value), weight);
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ShardedClock<KeyType, ValueType, Hash>::get(const KeyType& key,
+                                                 ValueType& value) {
+  auto& s = shard(key);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  auto cached = s.cache.get(key);
+  if (cached == nullptr) {
+    return false;
+  }
+  value = *cached;
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ShardedClock<KeyType, ValueType, Hash>::erase(const KeyType& key) {
+  auto& s = shard(key);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  return s.cache.erase(key);
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ShardedClock<KeyType, ValueType, Hash>::clear() {
+  for (auto& s : shards_) {
+    std::lock_guard<std::mutex> lock(s->mutex);
+    s->cache.clear();
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+std::size_t ShardedClock<KeyType, ValueType, Hash>::size() {
+  std::size_t size = 0;
+  for (auto& s : shards_) {
+    std::lock_guard<std::mutex> lock(s->mutex);
+    size += s->cache.size();
+  }
+  return size;
+}
+
+} // namespace caches
+} // namespace osquery
@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace osquery {
+namespace caches {
+
+/**
+ * A cache evicting with the CLOCK policy, an approximation of LRU.
+ *
+ * Entries are stored in a single open addressing table, so an entry costs no
+ * allocation of its own and lookups probe adjacent slots. Every access marks
+ * the entry as referenced. To evict, a hand sweeps the table clearing marks
+ * until it reaches an entry that was not referenced since the hand last
+ * passed it. Inserted entries start unmarked, so a scan of keys used once
+ * does not flush the entries used repeatedly.
+ *
+ * The capacity bounds the number of entries. An optional max weight also
+ * bounds the sum of the weights given at insertion, such as their bytes.
+ *
+ * Keys and values must be default constructible. Pointers returned by insert
+ * and get are valid until the cache is modified.
+ */
+template <typename KeyType_,
+          typename ValueType_,
+          typename Hash_ = std::hash<KeyType_>>
+class Clock {
+ public:
+  using KeyType = KeyType_;
+  using ValueType = ValueType_;
+  using Hash = Hash_;
+
+  /**
+   * @brief Create a cache with a certain capacity.
+   *
+   * @param capacity the max number of entries
+   * @param max_weight the max sum of the entries' weights, 0 for no limit
+   */
+  explicit Clock(std::size_t capacity, std::size_t max_weight = 0);
+
+  /**
+   * @brief Insert new key and value to the cache.
+   *
+   * @details Entries are evicted until the new one fits. If value with the
+   * same key exists in the cache it will be replaced with the new one.
+   *
+   * @param KeyType key of the inserting element
+   * @param ValueType the element to store in cache
+   * @param weight the weight of the element, counted against max_weight
+   *
+   * @returns pointer to cached element.
+   */
+  ValueType* insert(const KeyType& key,
+                    ValueType value,
+                    std::size_t weight = 0);
+
+  /**
+   * @brief Get value from cache by key if it is in the cache.
+   *
+   * @details The successful access marks the element as referenced.
+   *
+   * @param KeyType key of the element to search for
+   *
+   * @returns pointer to cached element, if there is no such key
+   * nullptr will be returned.
+   */
+  ValueType* get(const KeyType& key);
+
+  /**
+   * @brief Remove the element with the key.
+   *
+   * @returns true if the key was in the cache.
+   */
+  bool erase(const KeyType& key);
+
+  /**
+   * @brief Remove the elements the predicate accepts.
+   *
+   * @param predicate called with each key and value.
+   *
+   * @returns the number of removed elements.
+   */
+  template <typename Predicate>
+  std::size_t eraseIf(Predicate predicate);
+
+  /// Remove every element.
+  void clear();
+
+  /**
+   * @returns the number of cached elements.
+   */
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  /**
+   * @returns the capacity of the cache
+   */
+  std::size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  /**
+   * @returns the sum of the weights of the cached elements
+   */
+  std::size_t weight() const noexcept {
+    return weight_;
+  }
+
+  /**
+   * @brief Test if certain key exists in the cache. The element is not
+   * marked as referenced.
+   *
+   * @param KeyType key of the element to search for.
+   *
+   * @returns true if certain key exists in the cache.
+   */
+  bool has(const KeyType& key) const {
+    return find(key) != kNotFound;
+  }
+
+ private:
+  enum class SlotState : std::uint8_t { Empty, Full, Deleted };
+
+  struct Slot {
+    KeyType key{};
+    ValueType value{};
+    std::size_t weight{0};
+    SlotState state{SlotState::Empty};
+    bool referenced{false};
+  };
+
+  static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+  static constexpr std::size_t kMinSlots = 8;
+
+  /// The first slot probed for a key.
+  std::size_t home(const KeyType& key) const;
+
+  /// The slot holding the key, or kNotFound.
+  std::size_t find(const KeyType& key) const;
+
+  /// Remove the element of a full slot.
+  void release(Slot& slot);
+
+  /// Advance the hand to the first unreferenced element and remove it.
+  void evict();
+
+  /// Rebuild the table without the deleted slots, sized for the elements.
+  void rehash();
+
+ private:
+  std::vector<Slot> slots_;
+  std::size_t mask_{0};
+  std::size_t hand_{0};
+
+  std::size_t size_{0};
+  std::size_t deleted_{0};
+  std::size_t weight_{0};
+
+  std::size_t capacity_;
+  std::size_t max_weight_;
+};
+
+/**
+ * A Clock cache split into independently locked shards.
+ *
+ * Keys are spread across the shards by their hash, so threads using
+ * different keys rarely wait for each other. Values are copied out of the
+ * cache, as a shard may evict them as soon as its lock is released.
+ */
+template <typename KeyType_,
+          typename ValueType_,
+          typename Hash_ = std::hash<KeyType_>>
+class ShardedClock {
+ public:
+  using KeyType = KeyType_;
+  using ValueType = ValueType_;
+  using Hash = Hash_;
+
+  /**
+   * @brief Create a cache with a certain capacity, divided between shards.
+   *
+   * @param capacity the max number of entries
+   * @param shards the number of independently locked shards
+   * @param max_weight the max sum of the entries' weights, 0 for no limit
+   */
+  ShardedClock(std::size_t capacity,
+               std::size_t shards,
+               std::size_t max_weight = 0);
+
+  /// Insert or replace the value of a key.
+  void insert(const KeyType& key, ValueType value, std::size_t weight = 0);
+
+  /// Copy the value of a key to value, returns false if it is not cached.
+  bool get(const KeyType& key, ValueType& value);
+
+  /// Remove the element with the key.
+  bool erase(const KeyType& key);
+
+  /// Remove every element.
+  void clear();
+
+  /// The number of cached elements of every shard.
+  std::size_t size();
+
+ private:
+  struct Shard {
+    Shard(std::size_t capacity, std::size_t max_weight)
+        : cache(capacity, max_weight) {}
+
+    std::mutex mutex;
+    Clock<KeyType, ValueType, Hash> cache;
+  };
+
+  Shard& shard(const KeyType& key);
+
+ private:
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace caches
+} // namespace osquery
+
+#include <osquery/utils/caches/clock-impl.h>
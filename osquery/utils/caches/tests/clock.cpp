@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <osquery/utils/caches/clock.h>
+
+namespace osquery {
+namespace {
+
+class ClockCacheTests : public testing::Test {};
+
+TEST_F(ClockCacheTests, size_and_capacity) {
+  auto cache = caches::Clock<int, int>(7);
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.capacity(), 7u);
+  cache.insert(1, 20);
+  cache.insert(2, 21);
+  cache.insert(2, 22);
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(*cache.get(2), 22);
+  EXPECT_EQ(cache.get(13), nullptr);
+}
+
+TEST_F(ClockCacheTests, displace) {
+  auto cache = caches::Clock<int, int>(4);
+  for (int i = 0; i < 4; i++) {
+    cache.insert(i, i);
+  }
+
+  // Referenced elements survive the sweep, an unreferenced one goes.
+  cache.get(0);
+  cache.get(2);
+  cache.insert(4, 4);
+  EXPECT_EQ(cache.size(), 4u);
+  EXPECT_TRUE(cache.has(0));
+  EXPECT_NE(cache.has(1), cache.has(3));
+  EXPECT_TRUE(cache.has(2));
+  EXPECT_TRUE(cache.has(4));
+
+  // A scan of new keys does not flush the element used repeatedly.
+  for (int i = 100; i < 200; i++) {
+    cache.get(2);
+    cache.insert(i, i);
+    EXPECT_LE(cache.size(), 4u);
+  }
+  EXPECT_TRUE(cache.has(2));
+}
+
+TEST_F(ClockCacheTests, erase) {
+  auto cache = caches::Clock<int, std::string>(16);
+  for (int i = 0; i < 16; i++) {
+    cache.insert(i, std::to_string(i));
+  }
+  EXPECT_TRUE(cache.erase(3));
+  EXPECT_FALSE(cache.erase(3));
+  EXPECT_EQ(
+      cache.eraseIf([](int key, const std::string&) { return key % 2 == 0; }),
+      8u);
+  EXPECT_EQ(cache.size(), 7u);
+  EXPECT_FALSE(cache.has(4));
+  EXPECT_EQ(*cache.get(5), "5");
+
+  // Deleted slots are reused and cleaned up as the table churns.
+  for (int i = 0; i < 1000; i++) {
+    cache.insert(i % 40, std::to_string(i));
+    cache.erase((i + 20) % 40);
+  }
+  EXPECT_LE(cache.size(), 16u);
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.get(5), nullptr);
+}
+
+TEST_F(ClockCacheTests, weight) {
+  auto cache = caches::Clock<int, std::string>(100, 10);
+  cache.insert(1, "aaaa", 4);
+  cache.insert(2, "bbbb", 4);
+  EXPECT_EQ(cache.weight(), 8u);
+
+  cache.insert(3, "cccc", 4);
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_LE(cache.weight(), 10u);
+  EXPECT_TRUE(cache.has(3));
+
+  cache.insert(3, "cc", 2);
+  EXPECT_EQ(cache.weight(), 6u);
+}
+
+TEST_F(ClockCacheTests, sharded) {
+  caches::ShardedClock<std::string, int> cache(64, 4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&cache, t]() {
+      for (int i = 0; i < 1000; i++) {
+        auto key = std::to_string(t * 1000 + i % 50);
+        int value = 0;
+        if (!cache.get(key, value)) {
+          cache.insert(key, i % 50);
+        } else {
+          EXPECT_EQ(value, i % 50);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(cache.size(), 64u);
+
+  int value = 0;
+  cache.insert("key", 1);
+  EXPECT_TRUE(cache.get("key", value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(cache.erase("key"));
+  EXPECT_FALSE(cache.get("key", value));
+}
+
+} // namespace
+} // namespace osquery
@@ -10,6 +10,12 @@
 #include <string>
 #include <cstddef>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
 #include <osquery/logger/logger.h>
 
 #include <osquery/utils/chars.h>
@@ -26,6 +32,37 @@ bool isPrintable(const std::string& check) {
   return true;
 }
 
+size_t findNonPrintableByte(const char* data, size_t size) {
+  size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  // As signed bytes, 0x80-0xFF are negative and also compare below 0x20.
+  const auto low = _mm_set1_epi8(0x20);
+  for (; i + 16 <= size; i += 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (_mm_movemask_epi8(_mm_cmplt_epi8(chunk, low)) != 0) {
+      break;
+    }
+  }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  const auto low = vdupq_n_s8(0x20);
+  for (; i + 16 <= size; i += 16) {
+    auto chunk = vld1q_s8(reinterpret_cast<const int8_t*>(data + i));
+    if (vmaxvq_u8(vcltq_s8(chunk, low)) != 0) {
+      break;
+    }
+  }
+#endif
+
+  // The remaining tail, or the block containing the first match.
+  for (; i < size; i++) {
+    auto ch = static_cast<unsigned char>(data[i]);
+    if (ch < 0x20 || ch >= 0x80) {
+      return i;
+    }
+  }
+  return size;
+}
+
 size_t utf8StringSize(const std::string& str) {
   size_t res = 0;
   std::string::const_iterator it = str.begin();
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace osquery {
@@ -21,6 +22,16 @@ namespace osquery {
  */
 bool isPrintable(const std::string& check);
 
+/**
+ * @brief Find the first byte outside of 0x20-0x7F.
+ *
+ * Scans 16 bytes at a time with SSE2 or NEON where available, so strings
+ * that need no escaping are recognized without a byte-by-byte loop.
+ *
+ * @return The offset of the first such byte, or size if there is none.
+ */
+size_t findNonPrintableByte(const char* data, size_t size);
+
 /**
  * @brief In-line helper function for use with utf8StringSize
  */
@@ -296,6 +296,17 @@ Status JSON::toPrettyString(std::string& str, size_t indentCharCount) const {
   return Status::success();
 }
 
+static Status parseStatus(const rj::ParseResult& pr) {
+  if (!pr) {
+    std::string message{"Cannot parse JSON: "};
+    message += GetParseError_En(pr.Code());
+    message += " Offset: ";
+    message += std::to_string(pr.Offset());
+    return Status(1, message);
+  }
+  return Status::success();
+}
+
 Status JSON::fromString(const std::string& str, ParseMode mode) {
   rj::ParseResult pr;
   switch (mode) {
@@ -308,15 +319,25 @@ Status JSON::fromString(const std::string& str, ParseMode mode) {
     break;
   }
   }
+  return parseStatus(pr);
+}
 
-  if (!pr) {
-    std::string message{"Cannot parse JSON: "};
-    message += GetParseError_En(pr.Code());
-    message += " Offset: ";
-    message += std::to_string(pr.Offset());
-    return Status(1, message);
+Status JSON::fromStringInsitu(std::string str, ParseMode mode) {
+  // The previous values may point into the previous string until replaced.
+  auto insitu = std::make_unique<std::string>(std::move(str));
+  rj::ParseResult pr;
+  switch (mode) {
+  case ParseMode::Iterative: {
+    pr = doc_.ParseInsitu<rj::kParseIterativeFlag>(&(*insitu)[0]);
+    break;
   }
-  return Status::success();
+  case ParseMode::Recursive: {
+    pr = doc_.ParseInsitu(&(*insitu)[0]);
+    break;
+  }
+  }
+  insitu_ = std::move(insitu);
+  return parseStatus(pr);
 }
 
 void JSON::mergeObject(rj::Value& target_obj, rj::Value& source_obj) {
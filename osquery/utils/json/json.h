@@ -10,6 +10,8 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
+#include <string>
 
 #include <osquery/utils/only_movable.h>
 #include <osquery/utils/status/status.h>
@@ -356,6 +358,16 @@ class JSON : private only_movable {
   Status fromString(const std::string& str,
                     ParseMode parse_mode = ParseMode::Recursive);
 
+  /**
+   * @brief Parse a string in place, for documents that are only read.
+   *
+   * The document keeps the string and its string values point into it rather
+   * than being copied. Copies of the values made with copyFrom also reference
+   * the string, so they must not outlive this document.
+   */
+  Status fromStringInsitu(std::string str,
+                          ParseMode parse_mode = ParseMode::Recursive);
+
   /// Merge members of source into target, must both be objects.
   void mergeObject(rapidjson::Value& target_obj, rapidjson::Value& source_obj);
 
@@ -377,5 +389,8 @@ class JSON : private only_movable {
  private:
   rapidjson::Document doc_;
   decltype(rapidjson::kObjectType) type_;
+
+  /// The string parsed by fromStringInsitu, it moves with the document.
+  std::unique_ptr<std::string> insitu_;
 };
 } // namespace osquery
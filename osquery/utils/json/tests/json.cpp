@@ -99,6 +99,22 @@ TEST_F(ConversionsTests, test_json_from_string) {
   EXPECT_FALSE(doc.fromString(json).ok());
 }
 
+TEST_F(ConversionsTests, test_json_from_string_insitu) {
+  std::string json = "{\"key\":\"va\\\"lue\",\"key2\":{\"key3\":3}}";
+  auto doc = JSON::newObject();
+  EXPECT_TRUE(doc.fromStringInsitu(json).ok());
+
+  // The parsed string is owned by the document and moves with it.
+  auto moved = std::move(doc);
+  EXPECT_EQ(std::string(moved.doc()["key"].GetString()), "va\"lue");
+
+  std::string result;
+  EXPECT_TRUE(moved.toString(result));
+  EXPECT_EQ(json, result);
+
+  EXPECT_FALSE(moved.fromStringInsitu(json + ';').ok());
+}
+
 TEST_F(ConversionsTests, test_json_from_string_error) {
   std::string json = "{\"key\":\"value\",\"key2\":{\"key3\":'error'}}";
   auto doc = JSON::newObject();
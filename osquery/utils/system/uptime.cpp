@@ -9,13 +9,18 @@
 
 #include <osquery/utils/system/uptime.h>
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) || defined(__FreeBSD__)
 #include <errno.h>
 #include <sys/sysctl.h>
+#include <sys/types.h>
 #include <time.h>
 #elif defined(__linux__)
+#include <fstream>
+
 #include <sys/sysinfo.h>
 #elif defined(WIN32)
+#include <ctime>
+
 #include <osquery/utils/system/system.h>
 #endif
 
@@ -50,4 +55,30 @@ long getUptime() {
   return -1;
 }
 
+std::string getBootId() {
+#if defined(__APPLE__) || defined(__FreeBSD__)
+  struct timeval boot_time;
+  size_t len = sizeof(boot_time);
+  int mib[2] = {CTL_KERN, KERN_BOOTTIME};
+
+  if (sysctl(mib, 2, &boot_time, &len, nullptr, 0) < 0) {
+    return "";
+  }
+
+  return std::to_string(boot_time.tv_sec) + "." +
+         std::to_string(boot_time.tv_usec);
+#elif defined(__linux__)
+  std::ifstream boot_id("/proc/sys/kernel/random/boot_id");
+  std::string id;
+  std::getline(boot_id, id);
+  return id;
+#elif defined(WIN32)
+  // The boot time drifts with clock adjustments, a minute absorbs them.
+  auto boot_time = std::time(nullptr) - GetTickCount64() / 1000;
+  return std::to_string(boot_time / 60);
+#endif
+
+  return "";
+}
+
 } // namespace osquery
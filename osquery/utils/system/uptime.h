@@ -9,8 +9,17 @@
 
 #pragma once
 
+#include <string>
+
 namespace osquery {
 
 long getUptime();
 
+/**
+ * @brief An identifier of the current boot of the system.
+ *
+ * The identifier changes with every boot, and is empty if it is not known.
+ */
+std::string getBootId();
+
 } // namespace osquery
@@ -29,6 +29,24 @@ TEST_F(ConversionsTests, test_ascii_false) {
   EXPECT_FALSE(result);
 }
 
+TEST_F(ConversionsTests, test_find_non_printable_byte) {
+  std::string printable(40, 'a');
+  EXPECT_EQ(findNonPrintableByte(printable.data(), printable.size()), 40U);
+  EXPECT_EQ(findNonPrintableByte(printable.data(), 0), 0U);
+
+  // Every offset covers both the vectorized blocks and the tail.
+  for (size_t i = 0; i < printable.size(); i++) {
+    for (const char ch : {'\x00', '\x1F', '\x80', '\xFF'}) {
+      auto check = printable;
+      check[i] = ch;
+      EXPECT_EQ(findNonPrintableByte(check.data(), check.size()), i);
+    }
+  }
+
+  std::string edges = " ~\x7F";
+  EXPECT_EQ(findNonPrintableByte(edges.data(), edges.size()), 3U);
+}
+
 TEST_F(ConversionsTests, test_unicode_unescape) {
   std::vector<std::pair<std::string, std::string>> conversions = {
       std::make_pair("\\u0025hi", "%hi"),
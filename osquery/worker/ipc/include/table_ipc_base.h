@@ -9,11 +9,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
 #include <osquery/core/sql/query_data.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
 #include <osquery/worker/ipc/table_ipc_json_converter.h>
 
 #include <osquery/worker/logging/glog_logger_types.h>
@@ -22,24 +24,38 @@ namespace osquery {
 template <typename Derived>
 class TableIPCBase {
  public:
-  Status sendQueryData(const QueryData& query_data) {
-    JSON json_helper;
-    auto status =
-        TableIPCJSONConverter::queryDataToJSON(query_data, json_helper);
-
-    if (!status.ok()) {
-      return status;
-    }
+  /// The max number of rows in a QueryData batch.
+  static constexpr std::size_t kQueryDataBatchRows = 1024;
+
+  /**
+   * @brief Send rows of a result, in binary batches.
+   *
+   * The receiver decodes a batch while the next one is encoded and written.
+   *
+   * @param last false if more rows of the same result will follow.
+   */
+  Status sendQueryData(const QueryData& query_data, bool last = true) {
+    std::string message;
+    std::size_t begin = 0;
+    do {
+      auto end = std::min(begin + kQueryDataBatchRows, query_data.size());
+      auto status = TableIPCBinaryConverter::queryDataToBinary(
+          query_data, begin, end, last && end == query_data.size(), message);
+
+      if (!status.ok()) {
+        return status;
+      }
 
-    json_helper.add("Type", "QueryData");
+      status = static_cast<Derived&>(*this).sendStringMessage(message);
 
-    std::string json_string;
-    status = json_helper.toString(json_string);
+      if (!status.ok()) {
+        return status;
+      }
 
-    if (!status.ok())
-      return status;
+      begin = end;
+    } while (begin < query_data.size());
 
-    return static_cast<Derived&>(*this).sendJSONString(json_string);
+    return Status::success();
   }
 
   Status sendLogMessage(int severity,
@@ -62,7 +78,7 @@ class TableIPCBase {
       return status;
     }
 
-    return static_cast<Derived&>(*this).sendJSONString(json_string);
+    return static_cast<Derived&>(*this).sendStringMessage(json_string);
   }
 
   Status sendJob(const QueryContext& context) {
@@ -77,18 +93,13 @@ class TableIPCBase {
       return status;
     }
 
-    return static_cast<Derived&>(*this).sendJSONString(json_string);
+    return static_cast<Derived&>(*this).sendStringMessage(json_string);
   }
 
-  Status recvJSONMessage(JSON& json_message, JSONMessageType& message_type) {
-    std::string json_string;
-    auto status = static_cast<Derived&>(*this).recvJSONString(json_string);
-
-    if (!status.ok()) {
-      return status;
-    }
-
-    status = json_message.fromString(json_string);
+  static Status parseJSONMessage(const std::string& json_string,
+                                 JSON& json_message,
+                                 JSONMessageType& message_type) {
+    auto status = json_message.fromString(json_string);
 
     if (!status.ok()) {
       return status;
@@ -104,8 +115,28 @@ class TableIPCBase {
 
   Status processOneMessage(QueryData* query_results,
                            JSONMessageType& message_type) {
+    std::string message;
+    auto status = static_cast<Derived&>(*this).recvStringMessage(message);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (TableIPCBinaryConverter::isQueryDataBatch(message)) {
+      message_type = TableIPCBinaryConverter::isLastQueryDataBatch(message)
+                         ? JSONMessageType::QueryData
+                         : JSONMessageType::QueryDataBatch;
+
+      if (!query_results) {
+        return Status::failure(1, "Received unexpected QueryData message");
+      }
+
+      return static_cast<Derived&>(*this).processQueryDataMessage(
+          message, *query_results);
+    }
+
     JSON json_message;
-    Status status = recvJSONMessage(json_message, message_type);
+    status = parseJSONMessage(message, json_message, message_type);
 
     if (!status.ok()) {
       return status;
@@ -116,16 +147,6 @@ class TableIPCBase {
       status = static_cast<Derived&>(*this).processLogMessage(json_message);
       break;
     }
-    case JSONMessageType::QueryData: {
-      if (!query_results) {
-        status = Status::failure(1, "Received unexpected QueryData message");
-        break;
-      }
-
-      status = static_cast<Derived&>(*this).processQueryDataMessage(
-          json_message, *query_results);
-      break;
-    }
     case JSONMessageType::Job: {
       status = static_cast<Derived&>(*this).processJobMessage(json_message);
       break;
@@ -20,10 +20,13 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <vector>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/worker/ipc/posix/pipe_channel_factory.h>
 #include <osquery/worker/ipc/table_ipc_json_converter.h>
 
@@ -39,6 +42,12 @@ CLI_FLAG(bool,
          "Keep the container worker running to be reused instead of closing it "
          "after each query");
 
+CLI_FLAG(uint64,
+         container_worker_idle_timeout,
+         300,
+         "Seconds a container worker kept open may stay unused before it is "
+         "stopped");
+
 namespace {
 
 const std::string kProc = "/proc";
@@ -53,7 +62,14 @@ const std::string kMountNamespace = "/ns/mnt";
  */
 const int kMaxNamespaceIdLinkChars = 16;
 
-PlatformProcess current_running_process;
+struct ContainerWorker {
+  PlatformProcess process;
+  std::chrono::steady_clock::time_point last_used;
+};
+
+/// The running container workers, one per table.
+std::map<std::string, ContainerWorker> container_workers;
+Mutex container_workers_mutex;
 
 Status extractMountNamespaceId(const std::string& mount_namespace_path,
                                std::string& mount_namespace_id) {
@@ -145,6 +161,7 @@ Status LinuxTableContainerIPC::connectToContainer(
     bool keep_process_open,
     TableGeneratePtr function_ptr) {
   keep_process_open_ = keep_process_open;
+  table_name_ = table_name;
 
   auto current_pid = getpid();
   std::string original_mnt_path =
@@ -161,14 +178,20 @@ Status LinuxTableContainerIPC::connectToContainer(
         "Failed to open the original mount namespace of the worker");
   }
 
+  // Workers of the other tables are kept open while they are in use,
+  // so that queries alternating between tables reuse them.
+  if (keep_process_open_) {
+    stopIdleContainerWorkers();
+  }
+
   bool is_open = ipc_.setActiveChannelIfOpen(table_name);
 
-  if (!is_open) {
-    // This will stop any worker connected to another table,
-    // so that we only have one open each time
-    if (keep_process_open_) {
-      stopContainerWorker();
-    }
+  if (is_open) {
+    WriteLock lock(container_workers_mutex);
+    container_workers[table_name].last_used = std::chrono::steady_clock::now();
+  } else {
+    // A worker without an open channel cannot be reused.
+    stopContainerWorker();
 
     PipeChannelTicket channel_ticket = ipc_.createChannelTicket();
 
@@ -184,6 +207,10 @@ Status LinuxTableContainerIPC::connectToContainer(
         std::_Exit(1);
       }
 
+      // The channels to the workers of other tables were inherited, their
+      // pipes must be closed for those workers to see the parent closing them.
+      ipc_.closeAllChannels();
+
       try {
         ipc_.connectToParent(table_name, std::move(channel_ticket));
       } catch (const std::exception& e) {
@@ -196,26 +223,65 @@ Status LinuxTableContainerIPC::connectToContainer(
       return Status::failure("Failed to start container worker to table " +
                              table_name);
     } else {
-      current_running_process = PlatformProcess(pid);
+      {
+        WriteLock lock(container_workers_mutex);
+        auto& worker = container_workers[table_name];
+        worker.process = PlatformProcess(pid);
+        worker.last_used = std::chrono::steady_clock::now();
+      }
       ipc_.connectToChild(table_name, std::move(channel_ticket), pid);
     }
   }
 
   return Status::success();
 }
+
 void LinuxTableContainerIPC::stopContainerWorker() {
-  PlatformProcess child_process(std::move(current_running_process));
+  stopContainerWorker(table_name_);
+}
+
+void LinuxTableContainerIPC::stopIdleContainerWorkers() {
+  auto idle_timeout = std::chrono::seconds(FLAGS_container_worker_idle_timeout);
+  auto now = std::chrono::steady_clock::now();
+
+  std::vector<std::string> idle_tables;
+  {
+    WriteLock lock(container_workers_mutex);
+    for (const auto& worker : container_workers) {
+      if (worker.first != table_name_ &&
+          now - worker.second.last_used >= idle_timeout) {
+        idle_tables.push_back(worker.first);
+      }
+    }
+  }
+
+  for (const auto& table_name : idle_tables) {
+    stopContainerWorker(table_name);
+  }
+}
+
+void LinuxTableContainerIPC::stopContainerWorker(
+    const std::string& table_name) {
+  PlatformProcess child_process;
+  {
+    WriteLock lock(container_workers_mutex);
+    auto worker = container_workers.find(table_name);
+
+    if (worker == container_workers.end()) {
+      return;
+    }
+
+    child_process = std::move(worker->second.process);
+    container_workers.erase(worker);
+  }
 
   if (child_process.pid() == kInvalidPid) {
     return;
   }
 
-  std::string table_name = ipc_.isChannelOpen()
-                               ? ipc_.getTableName()
-                               : ipc_.getTableNameFromPid(child_process.pid());
-
-  ipc_.setActiveChannelIfOpen(table_name);
-  ipc_.closeActiveChannel();
+  if (ipc_.setActiveChannelIfOpen(table_name)) {
+    ipc_.closeActiveChannel();
+  }
 
   ProcessState process_state =
       checkProcessStateAndLog(child_process, table_name);
@@ -280,7 +346,7 @@ Status LinuxTableContainerIPC::handleLog(GLOGLogType log_type,
 }
 
 Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
-  QueryData query_data;
+  Status write_status;
   auto pids_with_namespace =
       context.constraints.at("pid_with_namespace").getAll<int>(EQUALS);
 
@@ -330,9 +396,15 @@ Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
       row["mount_namespace_id"] = mount_namespace_id;
     }
 
-    query_data.insert(query_data.end(),
-                      std::make_move_iterator(namespace_query_data.begin()),
-                      std::make_move_iterator(namespace_query_data.end()));
+    // Stream the rows of each namespace, the parent decodes them while the
+    // next namespace is queried.
+    if (!namespace_query_data.empty()) {
+      write_status = ipc_.sendQueryData(namespace_query_data, false);
+
+      if (!write_status.ok()) {
+        break;
+      }
+    }
   }
 
   /*
@@ -342,7 +414,9 @@ Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
     So after delivering the results, we return with an error so
     that the process will be always closed.
   */
-  auto write_status = ipc_.sendQueryData(query_data);
+  if (write_status.ok()) {
+    write_status = ipc_.sendQueryData({});
+  }
 
   if (keep_process_open_) {
     int result = static_cast<int>(syscall(SYS_setns, original_mnt_fd_, 0));
@@ -44,6 +44,8 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   Status retrieveQueryDataFromContainer(const QueryContext& context,
                                         QueryData& result);
   [[noreturn]] void executeQueryJobs();
+
+  /// Stop the worker of the table this connected to.
   void stopContainerWorker();
 
   Status handleLog(GLOGLogType log_type,
@@ -51,10 +53,17 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
                    const std::string& message) override;
   Status handleJob(QueryContext& context) override;
 
+ private:
+  void stopContainerWorker(const std::string& table_name);
+
+  /// Stop the workers of other tables, unused for the idle timeout.
+  void stopIdleContainerWorkers();
+
  private:
   LinuxTableIPC ipc_;
   LinuxTableIPCLogger logger_{ipc_};
   TableGeneratePtr table_generate_ptr_;
+  std::string table_name_;
   bool keep_process_open_{false};
   int original_mnt_fd_{-1};
 
@@ -78,6 +87,7 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   };
 
   FRIEND_TEST(WorkerTableContainerTests, test_ipc_container_connect);
+  FRIEND_TEST(WorkerTableContainerTests, test_ipc_container_workers_reuse);
 };
 
 inline bool hasNamespaceConstraint(const QueryContext& context) {
@@ -10,20 +10,20 @@
 #include "linux_table_ipc.h"
 
 namespace osquery {
-Status LinuxTableIPC::sendJSONString(const std::string& json_string) {
+Status LinuxTableIPC::sendStringMessage(const std::string& message) {
   if (active_channel_ == nullptr) {
     return Status::failure("No active channel to write to");
   }
 
-  return active_channel_->sendStringMessage(json_string);
+  return active_channel_->sendStringMessage(message);
 }
 
-Status LinuxTableIPC::recvJSONString(std::string& json_string) {
+Status LinuxTableIPC::recvStringMessage(std::string& message) {
   if (active_channel_ == nullptr) {
     return Status::failure("No active channel to read from");
   }
 
-  return active_channel_->recvStringMessage(json_string);
+  return active_channel_->recvStringMessage(message);
 }
 
 Status LinuxTableIPC::processLogMessage(const JSON& json_message) {
@@ -61,16 +61,9 @@ Status LinuxTableIPC::processJobMessage(const JSON& json_message) {
   return message_handler_->handleJob(context);
 }
 
-Status LinuxTableIPC::processQueryDataMessage(const JSON& json_message,
+Status LinuxTableIPC::processQueryDataMessage(const std::string& message,
                                               QueryData& query_results) {
-  auto status =
-      TableIPCJSONConverter::JSONToQueryData(json_message, query_results);
-
-  if (!status.ok()) {
-    return status;
-  }
-
-  return Status::success();
+  return TableIPCBinaryConverter::binaryToQueryData(message, query_results);
 }
 
 bool LinuxTableIPC::setActiveChannelIfOpen(const std::string table_name) {
@@ -107,6 +100,11 @@ void LinuxTableIPC::closeActiveChannel() {
   active_channel_ = nullptr;
 }
 
+void LinuxTableIPC::closeAllChannels() {
+  active_channel_ = nullptr;
+  factory_->clear();
+}
+
 std::string LinuxTableIPC::getTableNameFromPid(pid_t pid) {
   return factory_->getTableNameFromPid(pid);
 }
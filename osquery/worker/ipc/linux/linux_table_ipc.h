@@ -21,8 +21,8 @@ namespace osquery {
 
 /**
  * @brief The LinuxTableIPC class manages the communication and connection
- * between processes handling table logic, using JSON as message protocol and
- * blocking pipes as communication channel.
+ * between processes handling table logic, using JSON for logs and jobs, binary
+ * batches for results and blocking pipes as communication channel.
  *
  */
 class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
@@ -31,12 +31,12 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
                 TableIPCMessageHandler& message_handler)
       : factory_(&factory), message_handler_(&message_handler) {}
 
-  Status sendJSONString(const std::string& json_string);
-  Status recvJSONString(std::string& json_string);
+  Status sendStringMessage(const std::string& message);
+  Status recvStringMessage(std::string& message);
 
   Status processLogMessage(const JSON& json_message);
   Status processJobMessage(const JSON& json_message);
-  Status processQueryDataMessage(const JSON& json_message,
+  Status processQueryDataMessage(const std::string& message,
                                  QueryData& query_results);
 
   PipeChannelTicket createChannelTicket() {
@@ -49,6 +49,7 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
   void connectToParent(const std::string table_name,
                        PipeChannelTicket channel_ticket);
   void closeActiveChannel();
+  void closeAllChannels();
 
   std::string getTableNameFromPid(pid_t pid);
 
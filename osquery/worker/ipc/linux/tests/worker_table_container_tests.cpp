@@ -18,6 +18,7 @@ namespace osquery {
 
 DECLARE_bool(verbose);
 DECLARE_bool(disable_database);
+DECLARE_uint64(container_worker_idle_timeout);
 
 extern template std::set<int> ConstraintList::getAll<int>(
     ConstraintOperator) const;
@@ -39,6 +40,22 @@ QueryData genTest1(QueryContext&, Logger&) {
   return {r};
 }
 
+QueryData genTest2(QueryContext&, Logger&) {
+  Row r;
+  r["test"] = "World";
+  return {r};
+}
+
+QueryContext makeNamespaceContext() {
+  QueryContext context;
+  context.constraints["pid_with_namespace"].add(
+      Constraint(ConstraintOperator::EQUALS, std::to_string(getpid())));
+  UsedColumns columns_used;
+  columns_used.emplace("pid_with_namespace");
+  context.colsUsed = std::move(columns_used);
+  return context;
+}
+
 TEST_F(WorkerTableContainerTests, test_ipc_container_connect) {
   PipeChannelFactory factory;
 
@@ -71,4 +88,54 @@ TEST_F(WorkerTableContainerTests, test_ipc_container_connect) {
 
   container_ipc.stopContainerWorker();
 }
+
+TEST_F(WorkerTableContainerTests, test_ipc_container_workers_reuse) {
+  PipeChannelFactory factory;
+  auto context = makeNamespaceContext();
+
+  // Workers of different tables are kept open side by side.
+  LinuxTableContainerIPC ipc1(factory);
+  auto status = ipc1.connectToContainer("test1", true, genTest1);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  auto worker1_pid = ipc1.ipc_.getRemotePid();
+
+  QueryData results;
+  status = ipc1.retrieveQueryDataFromContainer(context, results);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  LinuxTableContainerIPC ipc2(factory);
+  status = ipc2.connectToContainer("test2", true, genTest2);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_NE(factory.getTableChannel("test1"), nullptr);
+
+  results.clear();
+  status = ipc2.retrieveQueryDataFromContainer(context, results);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0]["test"], "World");
+
+  // Connecting again reuses the worker.
+  LinuxTableContainerIPC ipc3(factory);
+  status = ipc3.connectToContainer("test1", true, genTest1);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(ipc3.ipc_.getRemotePid(), worker1_pid);
+
+  results.clear();
+  status = ipc3.retrieveQueryDataFromContainer(context, results);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0]["test"], "Hello");
+
+  // Workers of other tables unused for the idle timeout are stopped.
+  auto idle_timeout = FLAGS_container_worker_idle_timeout;
+  FLAGS_container_worker_idle_timeout = 0;
+  status = ipc3.connectToContainer("test1", true, genTest1);
+  FLAGS_container_worker_idle_timeout = idle_timeout;
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(factory.getTableChannel("test2"), nullptr);
+  EXPECT_NE(factory.getTableChannel("test1"), nullptr);
+
+  ipc3.stopContainerWorker();
+  EXPECT_EQ(factory.getTableChannel("test1"), nullptr);
+}
 } // namespace osquery
@@ -13,9 +13,48 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <cerrno>
 #include <limits>
 
 namespace osquery {
+namespace {
+
+/// Write all of a buffer, a pipe accepts large writes in parts.
+ssize_t writeAll(int fd, const char* buffer, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    auto result = write(fd, buffer + written, size - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return result;
+    }
+    written += static_cast<size_t>(result);
+  }
+  return static_cast<ssize_t>(written);
+}
+
+/// Read all of a buffer, a pipe returns what it holds at the time of the read.
+ssize_t readAll(int fd, char* buffer, size_t size) {
+  size_t read_size = 0;
+  while (read_size < size) {
+    auto result = read(fd, buffer + read_size, size - read_size);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return result;
+    }
+    if (result == 0) {
+      break;
+    }
+    read_size += static_cast<size_t>(result);
+  }
+  return static_cast<ssize_t>(read_size);
+}
+
+} // namespace
 PipeChannel::PipeChannel(const std::string& table_name,
                          int read_pipe_fd,
                          int write_pipe_fd,
@@ -39,9 +78,9 @@ Status PipeChannel::sendStringMessageImpl(const std::string& message) {
 
   auto old_mask = blockSIGPIPE();
 
-  ssize_t result = write(write_pipe_fd,
-                         reinterpret_cast<const char*>(&message_size),
-                         sizeof(message_size));
+  ssize_t result = writeAll(write_pipe_fd,
+                            reinterpret_cast<const char*>(&message_size),
+                            sizeof(message_size));
 
   if (result < 0) {
     restoreSIGPIPE(old_mask);
@@ -60,7 +99,8 @@ Status PipeChannel::sendStringMessageImpl(const std::string& message) {
         std::to_string(message_size) + " bytes");
   }
 
-  result = write(write_pipe_fd, &message[0], static_cast<size_t>(message_size));
+  result =
+      writeAll(write_pipe_fd, &message[0], static_cast<size_t>(message_size));
 
   restoreSIGPIPE(old_mask);
 
@@ -83,9 +123,9 @@ Status PipeChannel::sendStringMessageImpl(const std::string& message) {
 
 Status PipeChannel::recvStringMessageImpl(std::string& message) {
   ssize_t message_size;
-  ssize_t result = read(read_pipe_fd,
-                        reinterpret_cast<char*>(&message_size),
-                        sizeof(message_size));
+  ssize_t result = readAll(read_pipe_fd,
+                           reinterpret_cast<char*>(&message_size),
+                           sizeof(message_size));
 
   if (result < 0) {
     return Status::failure(
@@ -113,9 +153,9 @@ Status PipeChannel::recvStringMessageImpl(std::string& message) {
   }
 
   message.resize(static_cast<size_t>(message_size));
-  result = read(read_pipe_fd,
-                reinterpret_cast<char*>(&message[0]),
-                static_cast<size_t>(message_size));
+  result = readAll(read_pipe_fd,
+                   reinterpret_cast<char*>(&message[0]),
+                   static_cast<size_t>(message_size));
 
   if (result < 0) {
     return Status::failure(
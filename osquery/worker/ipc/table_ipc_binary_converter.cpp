@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_ipc_binary_converter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace osquery {
+namespace {
+
+const char kQueryDataBatch = '\x01';
+const char kLastQueryDataBatch = '\x02';
+
+const std::size_t kHeaderSize = 1 + 2 * sizeof(std::uint32_t);
+
+void appendUInt32(std::string& message, std::uint32_t value) {
+  message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// Bounds checked reads from a message.
+class BinaryReader {
+ public:
+  explicit BinaryReader(const std::string& message)
+      : data_(message.data()), left_(message.size()) {}
+
+  bool readUInt32(std::uint32_t& value) {
+    if (left_ < sizeof(value)) {
+      return false;
+    }
+    std::memcpy(&value, data_, sizeof(value));
+    skip(sizeof(value));
+    return true;
+  }
+
+  bool readBytes(std::size_t size, const char*& bytes) {
+    if (left_ < size) {
+      return false;
+    }
+    bytes = data_;
+    skip(size);
+    return true;
+  }
+
+  std::size_t left() const {
+    return left_;
+  }
+
+ private:
+  void skip(std::size_t size) {
+    data_ += size;
+    left_ -= size;
+  }
+
+  const char* data_;
+  std::size_t left_;
+};
+
+struct ColumnReader {
+  std::string name;
+  const char* lengths{nullptr};
+  const char* data{nullptr};
+  std::size_t data_size{0};
+};
+
+} // namespace
+
+bool TableIPCBinaryConverter::isQueryDataBatch(const std::string& message) {
+  return !message.empty() &&
+         (message[0] == kQueryDataBatch || message[0] == kLastQueryDataBatch);
+}
+
+bool TableIPCBinaryConverter::isLastQueryDataBatch(const std::string& message) {
+  return !message.empty() && message[0] == kLastQueryDataBatch;
+}
+
+Status TableIPCBinaryConverter::queryDataToBinary(const QueryData& query_data,
+                                                  std::size_t begin,
+                                                  std::size_t end,
+                                                  bool last,
+                                                  std::string& message) {
+  end = std::min(end, query_data.size());
+  begin = std::min(begin, end);
+  const auto row_count = end - begin;
+
+  // Rows are sorted maps, with sorted columns each row is a single merge.
+  std::unordered_set<std::string_view> seen;
+  std::vector<std::string_view> columns;
+  for (auto i = begin; i < end; ++i) {
+    for (const auto& cell : query_data[i]) {
+      if (seen.insert(cell.first).second) {
+        columns.push_back(cell.first);
+      }
+    }
+  }
+  std::sort(columns.begin(), columns.end());
+
+  if (row_count > std::numeric_limits<std::uint32_t>::max() ||
+      columns.size() > std::numeric_limits<std::uint32_t>::max()) {
+    return Status::failure("Too many rows or columns to encode, " +
+                           std::to_string(row_count) + " rows and " +
+                           std::to_string(columns.size()) + " columns");
+  }
+
+  // The cells of the batch, column major, nullptr for missing ones.
+  std::vector<const std::string*> cells(row_count * columns.size(), nullptr);
+  std::size_t total_size = kHeaderSize;
+  for (auto i = begin; i < end; ++i) {
+    std::size_t column = 0;
+    for (const auto& cell : query_data[i]) {
+      while (columns[column] != cell.first) {
+        ++column;
+      }
+      if (cell.second.size() >= std::numeric_limits<std::uint32_t>::max()) {
+        return Status::failure("Value too big to encode in column " +
+                               cell.first);
+      }
+      cells[column * row_count + (i - begin)] = &cell.second;
+      total_size += cell.second.size();
+    }
+  }
+  for (const auto& column : columns) {
+    total_size += sizeof(std::uint32_t) + column.size() +
+                  row_count * sizeof(std::uint32_t);
+  }
+
+  message.clear();
+  message.reserve(total_size);
+  message.push_back(last ? kLastQueryDataBatch : kQueryDataBatch);
+  appendUInt32(message, static_cast<std::uint32_t>(row_count));
+  appendUInt32(message, static_cast<std::uint32_t>(columns.size()));
+
+  for (std::size_t column = 0; column < columns.size(); ++column) {
+    appendUInt32(message, static_cast<std::uint32_t>(columns[column].size()));
+    message.append(columns[column]);
+
+    auto column_cells = cells.begin() + column * row_count;
+    for (std::size_t row = 0; row < row_count; ++row) {
+      const auto* value = column_cells[row];
+      appendUInt32(message,
+                   value == nullptr
+                       ? 0
+                       : static_cast<std::uint32_t>(value->size() + 1));
+    }
+    for (std::size_t row = 0; row < row_count; ++row) {
+      if (column_cells[row] != nullptr) {
+        message.append(*column_cells[row]);
+      }
+    }
+  }
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::binaryToQueryData(const std::string& message,
+                                                  QueryData& query_data) {
+  if (!isQueryDataBatch(message)) {
+    return Status::failure("Message is not a QueryData batch");
+  }
+
+  BinaryReader reader(message);
+  const char* tag = nullptr;
+  std::uint32_t row_count = 0;
+  std::uint32_t column_count = 0;
+  if (!reader.readBytes(1, tag) || !reader.readUInt32(row_count) ||
+      !reader.readUInt32(column_count)) {
+    return Status::failure("QueryData batch header is truncated");
+  }
+
+  // Every column takes at least its name length and cell lengths.
+  const std::size_t column_min_size =
+      sizeof(std::uint32_t) + std::size_t{row_count} * sizeof(std::uint32_t);
+  if (column_count > 0 && reader.left() / column_min_size < column_count) {
+    return Status::failure("QueryData batch is truncated");
+  }
+
+  std::vector<ColumnReader> columns(column_count);
+  for (auto& column : columns) {
+    std::uint32_t name_size = 0;
+    const char* name = nullptr;
+    if (!reader.readUInt32(name_size) || !reader.readBytes(name_size, name) ||
+        !reader.readBytes(std::size_t{row_count} * sizeof(std::uint32_t),
+                          column.lengths)) {
+      return Status::failure("QueryData batch column is truncated");
+    }
+    column.name.assign(name, name_size);
+
+    for (std::uint32_t row = 0; row < row_count; ++row) {
+      std::uint32_t length = 0;
+      std::memcpy(&length,
+                  column.lengths + row * sizeof(std::uint32_t),
+                  sizeof(length));
+      if (length > 0) {
+        column.data_size += length - 1;
+      }
+    }
+    if (!reader.readBytes(column.data_size, column.data)) {
+      return Status::failure("QueryData batch values of column " +
+                             column.name + " are truncated");
+    }
+  }
+
+  if (reader.left() != 0) {
+    return Status::failure("QueryData batch has trailing bytes");
+  }
+
+  query_data.reserve(query_data.size() + row_count);
+  for (std::uint32_t row = 0; row < row_count; ++row) {
+    Row r;
+    for (auto& column : columns) {
+      std::uint32_t length = 0;
+      std::memcpy(&length,
+                  column.lengths + row * sizeof(std::uint32_t),
+                  sizeof(length));
+      if (length == 0) {
+        continue;
+      }
+
+      // Columns are sorted, each one is inserted at the end of the row.
+      r.emplace_hint(r.end(), column.name, std::string(column.data, length - 1));
+      column.data += length - 1;
+    }
+    query_data.push_back(std::move(r));
+  }
+
+  return Status::success();
+}
+
+} // namespace osquery
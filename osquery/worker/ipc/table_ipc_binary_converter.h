@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Encodes table results as binary batches for the table worker IPC.
+ *
+ * A batch is columnar: the distinct column names, sorted, each followed by
+ * the lengths of its cells and then their bytes. A cell length of 0 marks a
+ * row without that column, other lengths are the size of the value plus one.
+ * Integers are in native byte order, both ends of the pipe are the same
+ * binary on the same host.
+ *
+ * The first byte of a batch tells it apart from the JSON messages, which
+ * always start with '{', and tells whether more batches of the same result
+ * follow.
+ */
+class TableIPCBinaryConverter {
+ public:
+  /// Returns true if the message is a binary QueryData batch.
+  static bool isQueryDataBatch(const std::string& message);
+
+  /// Returns true if the batch is the last one of a result.
+  static bool isLastQueryDataBatch(const std::string& message);
+
+  /**
+   * @brief Encode the rows [begin, end) of query_data as one batch.
+   *
+   * @param last marks the batch as the last one of the result.
+   */
+  static Status queryDataToBinary(const QueryData& query_data,
+                                  std::size_t begin,
+                                  std::size_t end,
+                                  bool last,
+                                  std::string& message);
+
+  /// Decode a batch, appending its rows to query_data.
+  static Status binaryToQueryData(const std::string& message,
+                                  QueryData& query_data);
+};
+} // namespace osquery
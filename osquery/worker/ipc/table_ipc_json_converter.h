@@ -17,7 +17,13 @@
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
-enum class JSONMessageType { None, QueryData, Log, Job };
+/**
+ * @brief The kinds of table worker messages.
+ *
+ * QueryData results arrive as binary batches, QueryDataBatch is any batch but
+ * the last one, QueryData the last one.
+ */
+enum class JSONMessageType { None, QueryData, QueryDataBatch, Log, Job };
 
 class TableIPCJSONConverter {
  public:
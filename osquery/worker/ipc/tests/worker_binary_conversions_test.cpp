@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+#include <osquery/worker/ipc/table_ipc_base.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
+
+namespace osquery {
+
+class TestBinaryTableIPC : public TableIPCBase<TestBinaryTableIPC> {
+ public:
+  Status sendStringMessage(const std::string& message) {
+    messages.push_back(message);
+    return Status::success();
+  }
+
+  Status recvStringMessage(std::string& message) {
+    if (messages.empty()) {
+      return Status::failure(2, "No message to read");
+    }
+
+    message = std::move(messages.front());
+    messages.pop_front();
+    return Status::success();
+  }
+
+  Status processQueryDataMessage(const std::string& message,
+                                 QueryData& query_results) {
+    return TableIPCBinaryConverter::binaryToQueryData(message, query_results);
+  }
+
+  Status processLogMessage(const JSON&) {
+    return Status::success();
+  }
+
+  Status processJobMessage(const JSON&) {
+    return Status::success();
+  }
+
+  std::deque<std::string> messages;
+};
+
+class WorkerBinaryConversionsTests : public testing::Test {};
+
+TEST_F(WorkerBinaryConversionsTests, test_querydata_and_binary_conversions) {
+  QueryData data;
+  Row r1;
+  r1["column1"] = "test";
+  r1["column2"] = "1";
+  data.push_back(r1);
+
+  // Rows may miss columns, and values may be empty or hold any byte.
+  Row r2;
+  r2["column2"] = "";
+  r2["column3"] = std::string("a\0b", 3);
+  data.push_back(r2);
+
+  data.push_back(Row());
+
+  std::string message;
+  auto status = TableIPCBinaryConverter::queryDataToBinary(
+      data, 0, data.size(), true, message);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(TableIPCBinaryConverter::isQueryDataBatch(message));
+  EXPECT_TRUE(TableIPCBinaryConverter::isLastQueryDataBatch(message));
+
+  // Decoded rows are appended.
+  QueryData read_query_data;
+  read_query_data.push_back(Row());
+  status = TableIPCBinaryConverter::binaryToQueryData(message, read_query_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  ASSERT_EQ(read_query_data.size(), 4U);
+  EXPECT_TRUE(read_query_data[0].empty());
+  EXPECT_EQ(read_query_data[1], r1);
+  EXPECT_EQ(read_query_data[2], r2);
+  EXPECT_EQ(read_query_data[2].count("column1"), 0U);
+  EXPECT_TRUE(read_query_data[3].empty());
+
+  // Only a range of rows is encoded.
+  status =
+      TableIPCBinaryConverter::queryDataToBinary(data, 1, 2, false, message);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_FALSE(TableIPCBinaryConverter::isLastQueryDataBatch(message));
+
+  read_query_data.clear();
+  status = TableIPCBinaryConverter::binaryToQueryData(message, read_query_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(read_query_data.size(), 1U);
+  EXPECT_EQ(read_query_data[0], r2);
+
+  // JSON messages are not batches.
+  EXPECT_FALSE(TableIPCBinaryConverter::isQueryDataBatch("{\"Type\":\"Log\"}"));
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_truncated_batch) {
+  QueryData data(3);
+  for (auto& row : data) {
+    row["column1"] = "value";
+    row["column2"] = "other value";
+  }
+
+  std::string message;
+  auto status = TableIPCBinaryConverter::queryDataToBinary(
+      data, 0, data.size(), true, message);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  for (size_t size = 1; size < message.size(); ++size) {
+    QueryData read_query_data;
+    status = TableIPCBinaryConverter::binaryToQueryData(message.substr(0, size),
+                                                        read_query_data);
+    EXPECT_FALSE(status.ok()) << size;
+    EXPECT_TRUE(read_query_data.empty());
+  }
+
+  QueryData read_query_data;
+  status = TableIPCBinaryConverter::binaryToQueryData(message + "x",
+                                                      read_query_data);
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_querydata_batches) {
+  const auto batch_rows = TestBinaryTableIPC::kQueryDataBatchRows;
+
+  QueryData data;
+  for (size_t i = 0; i < batch_rows * 2 + 1; ++i) {
+    Row r;
+    r["index"] = std::to_string(i);
+    data.push_back(std::move(r));
+  }
+
+  TestBinaryTableIPC ipc;
+  auto status = ipc.sendQueryData(data, false);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = ipc.sendQueryData(QueryData());
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(ipc.messages.size(), 4U);
+
+  QueryData read_query_data;
+  JSONMessageType message_type;
+  for (size_t i = 0; i < 3; ++i) {
+    status = ipc.processOneMessage(&read_query_data, message_type);
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    EXPECT_TRUE(message_type == JSONMessageType::QueryDataBatch);
+  }
+
+  status = ipc.processOneMessage(&read_query_data, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(message_type == JSONMessageType::QueryData);
+  EXPECT_EQ(read_query_data, data);
+
+  // Results are only expected after a job was sent.
+  ASSERT_TRUE(ipc.sendQueryData(data).ok());
+  status = ipc.processOneMessage(nullptr, message_type);
+  EXPECT_FALSE(status.ok());
+}
+} // namespace osquery
@@ -20,18 +20,25 @@ namespace osquery {
 
 class TestTableIPC : public TableIPCBase<TestTableIPC> {
  public:
-  Status sendJSONString(const std::string json_string) {
-    auto status = json_helper.fromString(json_string);
+  Status sendStringMessage(const std::string& message) {
+    auto status = json_helper.fromString(message);
 
     if (!status.ok()) {
-      return Status::failure(1, "Failed to parse json_string:\n" + json_string);
+      return Status::failure(1, "Failed to parse message:\n" + message);
     }
 
     return Status::success();
   }
 
-  Status recvJSONString(std::string& json_string) {
-    return json_helper.toString(json_string);
+  Status recvJSONMessage(JSON& json_message, JSONMessageType& message_type) {
+    std::string json_string;
+    auto status = json_helper.toString(json_string);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    return parseJSONMessage(json_string, json_message, message_type);
   }
 
   JSON json_helper;
@@ -60,8 +67,18 @@ TEST_F(WorkerJSONConversionsTests, test_querydata_and_json_conversions) {
   r2["column2"] = "2";
   data.push_back(r2);
 
+  // Results travel as binary batches, the JSON conversion remains available.
+  JSON query_data_json;
+  auto status = TableIPCJSONConverter::queryDataToJSON(data, query_data_json);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  query_data_json.add("Type", "QueryData");
+
+  std::string json_string;
+  status = query_data_json.toString(json_string);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
   TestTableIPC ipc;
-  auto status = ipc.sendQueryData(data);
+  status = ipc.sendStringMessage(json_string);
   ASSERT_TRUE(status.ok()) << status.getMessage();
 
   auto& rapidjson_doc = ipc.json_helper.doc();
@@ -180,6 +197,12 @@ TEST_F(WorkerJSONConversionsTests, test_job_and_json_conversions) {
   used_columns.emplace("job_test_3");
   context.colsUsed = std::move(used_columns);
 
+  OrderByTerm order_by;
+  order_by.column = "job_test_2";
+  order_by.descending = true;
+  context.orderBy.push_back(order_by);
+  context.limit = 10;
+
   auto status = ipc.sendJob(context);
 
   ASSERT_TRUE(status.ok()) << status.getMessage();
@@ -237,6 +260,12 @@ TEST_F(WorkerJSONConversionsTests, test_job_and_json_conversions) {
   ASSERT_EQ(read_query_context.colsUsed.get().count("job_test_2"), 1);
   ASSERT_EQ(read_query_context.colsUsed.get().count("job_test_3"), 1);
 
+  ASSERT_EQ(read_query_context.orderBy.size(), 1);
+  EXPECT_EQ(read_query_context.orderBy[0].column, "job_test_2");
+  EXPECT_TRUE(read_query_context.orderBy[0].descending);
+  ASSERT_TRUE(read_query_context.limit);
+  EXPECT_EQ(*read_query_context.limit, 10U);
+
   ASSERT_EQ(read_query_context.constraints.size(), 2);
   ASSERT_EQ(read_query_context.constraints.count("job_test_1"), 1);
   ASSERT_EQ(read_query_context.constraints.count("job_test_2"), 1);
@@ -7,6 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
+
+#include <boost/optional.hpp>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
@@ -24,6 +28,12 @@ FLAG(bool,
      false,
      "Add decorators as top level JSON objects");
 
+FLAG(uint64,
+     decorators_always_refresh,
+     1,
+     "Seconds the always decorator results are reused between scheduled "
+     "queries (0 runs them before every query)");
+
 /// Statically define the parser name to avoid mistakes.
 const std::string kDecorationsName{"decorators"};
 
@@ -100,12 +110,63 @@ class DecoratorsConfigParserPlugin : public ConfigParserPlugin {
 
   /// Protect the configuration controlled content.
   static Mutex kDecorationsConfigMutex;
+
+  /// The decorations of every source, shared until they change.
+  static std::shared_ptr<const KeyValueMap> kMerged;
+
+  /// When the always decorators last ran, if their results are still valid.
+  static boost::optional<std::chrono::steady_clock::time_point> kAlwaysRun;
+
+  /// Protect the always decorators run time.
+  static Mutex kAlwaysMutex;
 };
 } // namespace
 
 DecorationStore DecoratorsConfigParserPlugin::kDecorations;
 Mutex DecoratorsConfigParserPlugin::kDecorationsMutex;
 Mutex DecoratorsConfigParserPlugin::kDecorationsConfigMutex;
+std::shared_ptr<const KeyValueMap> DecoratorsConfigParserPlugin::kMerged =
+    std::make_shared<KeyValueMap>();
+boost::optional<std::chrono::steady_clock::time_point>
+    DecoratorsConfigParserPlugin::kAlwaysRun;
+Mutex DecoratorsConfigParserPlugin::kAlwaysMutex;
+
+namespace {
+
+/// Start a new window of the always decorators if the last one has expired.
+bool refreshAlwaysDecorators() {
+  if (FLAGS_decorators_always_refresh == 0) {
+    return true;
+  }
+
+  WriteLock lock(DecoratorsConfigParserPlugin::kAlwaysMutex);
+  auto now = std::chrono::steady_clock::now();
+  auto& last_run = DecoratorsConfigParserPlugin::kAlwaysRun;
+  if (last_run && now - *last_run < std::chrono::seconds(
+                                        FLAGS_decorators_always_refresh)) {
+    return false;
+  }
+  last_run = now;
+  return true;
+}
+
+/// Run the always decorators for the next query, their results were cleared.
+void expireAlwaysDecorators() {
+  WriteLock lock(DecoratorsConfigParserPlugin::kAlwaysMutex);
+  DecoratorsConfigParserPlugin::kAlwaysRun = boost::none;
+}
+
+/// Rebuild the shared decorations, requires the decorations lock.
+void mergeDecorations() {
+  auto merged = std::make_shared<KeyValueMap>();
+  for (const auto& source : DecoratorsConfigParserPlugin::kDecorations) {
+    for (const auto& decoration : source.second) {
+      (*merged)[decoration.first] = decoration.second;
+    }
+  }
+  DecoratorsConfigParserPlugin::kMerged = std::move(merged);
+}
+} // namespace
 
 Status DecoratorsConfigParserPlugin::setUp() {
   // Decorators are kept within customized data structures.
@@ -165,6 +226,7 @@ void DecoratorsConfigParserPlugin::reset() {
 
 void DecoratorsConfigParserPlugin::updateDecorations(const std::string& source,
                                                      const JSON& doc) {
+  expireAlwaysDecorators();
   WriteLock lock(DecoratorsConfigParserPlugin::kDecorationsConfigMutex);
   // Assign load decorators.
   auto& load_key = kDecorationPointKeys.at(DECORATE_LOAD);
@@ -236,7 +298,14 @@ inline void addDecoration(const std::string& source,
                           const std::string& name,
                           const std::string& value) {
   WriteLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
-  DecoratorsConfigParserPlugin::kDecorations[source][name] = value;
+  auto& decorations = DecoratorsConfigParserPlugin::kDecorations[source];
+  auto decoration = decorations.find(name);
+  if (decoration != decorations.end() && decoration->second == value) {
+    // Repeated runs usually find the same values, keep the shared copy.
+    return;
+  }
+  decorations[name] = value;
+  mergeDecorations();
 }
 
 inline void runDecorators(const std::string& source,
@@ -265,8 +334,10 @@ inline void runDecorators(const std::string& source,
 }
 
 void clearDecorations(const std::string& source) {
+  expireAlwaysDecorators();
   WriteLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
   DecoratorsConfigParserPlugin::kDecorations[source].clear();
+  mergeDecorations();
 }
 
 void runDecorators(DecorationPoint point,
@@ -276,15 +347,17 @@ void runDecorators(DecorationPoint point,
     return;
   }
 
-  auto parser = Config::getParser(kDecorationsName);
-  if (parser == nullptr) {
+  // Decorators run for every scheduled query, keep the resolved parser.
+  static const PluginHandle<DecoratorsConfigParserPlugin> parser(
+      "config_parser", kDecorationsName);
+  auto dp = parser.get();
+  if (dp == nullptr) {
     // The decorators parser does not exist.
     return;
   }
 
   // Abstract the use of the decorator parser API.
   ReadLock lock(DecoratorsConfigParserPlugin::kDecorationsConfigMutex);
-  auto dp = std::dynamic_pointer_cast<DecoratorsConfigParserPlugin>(parser);
   if (point == DECORATE_LOAD) {
     for (const auto& target_source : dp->load_) {
       if (source.empty() || target_source.first == source) {
@@ -292,6 +365,11 @@ void runDecorators(DecorationPoint point,
       }
     }
   } else if (point == DECORATE_ALWAYS) {
+    // Every scheduled query asks, the results are reused for a short time.
+    if (source.empty() && !refreshAlwaysDecorators()) {
+      return;
+    }
+
     for (const auto& target_source : dp->always_) {
       if (source.empty() || target_source.first == source) {
         runDecorators(target_source.first, target_source.second);
@@ -311,17 +389,20 @@ void runDecorators(DecorationPoint point,
 }
 
 void getDecorations(std::map<std::string, std::string>& results) {
+  auto decorations = getDecorations();
+  // Copy the decorations into the log_item.
+  for (const auto& decoration : *decorations) {
+    results[decoration.first] = decoration.second;
+  }
+}
+
+std::shared_ptr<const std::map<std::string, std::string>> getDecorations() {
   if (FLAGS_disable_decorators) {
-    return;
+    return std::make_shared<KeyValueMap>();
   }
 
   ReadLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
-  // Copy the decorations into the log_item.
-  for (const auto& source : DecoratorsConfigParserPlugin::kDecorations) {
-    for (const auto& decoration : source.second) {
-      results[decoration.first] = decoration.second;
-    }
-  }
+  return DecoratorsConfigParserPlugin::kMerged;
 }
 
 REGISTER_INTERNAL(DecoratorsConfigParserPlugin,
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <functional>
 
 #include <osquery/config/config.h>
@@ -54,6 +55,14 @@ void runDecorators(DecorationPoint point,
  */
 void getDecorations(std::map<std::string, std::string>& results);
 
+/**
+ * @brief Share the decorations without copying them.
+ *
+ * The map is rebuilt when a decoration changes, a returned map stays valid
+ * and unchanged for as long as it is held.
+ */
+std::shared_ptr<const std::map<std::string, std::string>> getDecorations();
+
 /// Clear decorations for a source when it updates.
 void clearDecorations(const std::string& source);
 }
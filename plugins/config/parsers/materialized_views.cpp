@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <mutex>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/database/database.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/sql.h>
+#include <osquery/utils/info/tool_type.h>
+#include <osquery/utils/system/time.h>
+#include <plugins/config/parsers/materialized_views.h>
+
+namespace osquery {
+
+namespace {
+
+/// Database key prefix of the stored rows of each view.
+const std::string kDatabaseKeyPrefix{"materialized_views."};
+
+/// Seconds between refreshes of a view without an interval.
+const uint64_t kDefaultViewInterval{3600};
+
+} // namespace
+
+std::map<std::string, MaterializedViewsConfigParserPlugin::View>
+    MaterializedViewsConfigParserPlugin::views_;
+Mutex MaterializedViewsConfigParserPlugin::views_mutex_;
+
+TableRows MaterializedViewPlugin::generate(QueryContext& context) {
+  std::string json;
+  auto s = getDatabaseValue(kQueries, kDatabaseKeyPrefix + view_name_, json);
+  if (!s.ok()) {
+    // The view was not refreshed yet.
+    return TableRows();
+  }
+
+  QueryData results;
+  s = deserializeQueryDataJSON(json, results);
+  if (!s.ok()) {
+    LOG(WARNING) << "Materialized view " << view_name_
+                 << ": Could not read the stored rows: " << s.getMessage();
+    return TableRows();
+  }
+  return tableRowsFromQueryData(std::move(results));
+}
+
+std::chrono::milliseconds MaterializedViewRunner::tick() {
+  MaterializedViewsConfigParserPlugin::refreshViews(getUnixTime());
+  return std::chrono::seconds(1);
+}
+
+size_t MaterializedViewsConfigParserPlugin::refreshViews(uint64_t now) {
+  std::map<std::string, std::string> due_views;
+  {
+    WriteLock lock(views_mutex_);
+    for (auto& view : views_) {
+      if (view.second.refresh_time == 0 ||
+          now >= view.second.refresh_time + view.second.interval) {
+        // A failing query is retried at the next interval, not every second.
+        view.second.refresh_time = now;
+        due_views[view.first] = view.second.query;
+      }
+    }
+  }
+
+  for (const auto& view : due_views) {
+    QueryData results;
+    auto s = osquery::query(view.second, results);
+    if (!s.ok()) {
+      LOG(WARNING) << "Materialized view " << view.first
+                   << ": Could not refresh: " << s.getMessage();
+      continue;
+    }
+
+    std::string json;
+    s = serializeQueryDataJSON(results, json);
+    if (s.ok()) {
+      s = setDatabaseValue(kQueries, kDatabaseKeyPrefix + view.first, json);
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Materialized view " << view.first
+                   << ": Could not store the rows: " << s.getMessage();
+    }
+  }
+  return due_views.size();
+}
+
+void MaterializedViewsConfigParserPlugin::removeViews(
+    const std::set<std::string>& views) {
+  auto registry_table = RegistryFactory::get().registry("table");
+  for (const auto& view : views) {
+    if (registry_table->exists(view)) {
+      registry_table->remove(view);
+      PluginResponse resp;
+      Registry::call(
+          "sql", "sql", {{"action", "detatch"}, {"table", view}}, resp);
+    }
+    deleteDatabaseValue(kQueries, kDatabaseKeyPrefix + view);
+    VLOG(1) << "Materialized view: " << view << " Removed";
+  }
+}
+
+Status MaterializedViewsConfigParserPlugin::update(const std::string& source,
+                                                   const ParserConfig& config) {
+  auto cv = config.find(kParserKey);
+  if (cv == config.end() || !cv->second.doc().IsObject()) {
+    return Status::success();
+  }
+
+  auto obj = data_.getObject();
+  data_.copyFrom(cv->second.doc(), obj);
+  data_.add(kParserKey, obj);
+
+  const auto& views = data_.doc()[kParserKey];
+  auto tables = RegistryFactory::get().registry("table");
+
+  std::set<std::string> removed;
+  {
+    WriteLock lock(views_mutex_);
+    for (const auto& view : views_) {
+      removed.insert(view.first);
+    }
+  }
+
+  for (const auto& view : views.GetObject()) {
+    if (!view.name.IsString() || !view.value.IsObject()) {
+      // This entry is not formatted correctly.
+      continue;
+    }
+
+    std::string view_name{view.name.GetString()};
+    auto params = view.value.GetObject();
+    std::string query{params.HasMember("query") && params["query"].IsString()
+                          ? params["query"].GetString()
+                          : ""};
+    uint64_t interval{params.HasMember("interval") &&
+                              params["interval"].IsUint64()
+                          ? params["interval"].GetUint64()
+                          : kDefaultViewInterval};
+    if (query.empty() || interval == 0) {
+      LOG(WARNING) << "Materialized view: Skipping " << view_name
+                   << " because it is misconfigured (missing query or "
+                      "interval)";
+      continue;
+    }
+
+    {
+      WriteLock lock(views_mutex_);
+      auto it = views_.find(view_name);
+      if (it != views_.end() && it->second.query == query) {
+        // The view hasn't changed, keep its table and stored rows.
+        it->second.interval = interval;
+        removed.erase(view_name);
+        continue;
+      }
+    }
+
+    if (removed.count(view_name) > 0) {
+      // Replace the view, its stored rows are results of the old query.
+      removeViews({view_name});
+      removed.erase(view_name);
+      WriteLock lock(views_mutex_);
+      views_.erase(view_name);
+    } else if (tables->exists(view_name)) {
+      LOG(WARNING) << "Materialized view: " << view_name
+                   << " overrides a table; Refusing registration";
+      continue;
+    }
+
+    TableColumns columns;
+    auto s = getQueryColumns(query, columns);
+    if (!s.ok()) {
+      LOG(WARNING) << "Materialized view: " << view_name
+                   << " has an invalid query: " << s.getMessage();
+      continue;
+    }
+
+    auto plugin = std::make_shared<MaterializedViewPlugin>(view_name, columns);
+    s = tables->add(view_name, plugin, true);
+    if (!s.ok()) {
+      LOG(WARNING) << "Materialized view: " << view_name << ": "
+                   << s.getMessage();
+      continue;
+    }
+
+    PluginResponse resp;
+    Registry::call(
+        "sql", "sql", {{"action", "attach"}, {"table", view_name}}, resp);
+
+    {
+      WriteLock lock(views_mutex_);
+      auto& registered = views_[view_name];
+      registered.query = query;
+      registered.interval = interval;
+    }
+    LOG(INFO) << "Materialized view: " << view_name << " Registered";
+  }
+
+  if (!removed.empty()) {
+    removeViews(removed);
+    WriteLock lock(views_mutex_);
+    for (const auto& view : removed) {
+      views_.erase(view);
+    }
+  }
+
+#ifndef OSQUERY_IS_FUZZING
+  bool has_views = false;
+  {
+    WriteLock lock(views_mutex_);
+    has_views = !views_.empty();
+  }
+
+  // Tests refresh the views themselves.
+  static std::once_flag runner_started;
+  if (has_views && (isDaemon() || isShell())) {
+    std::call_once(runner_started, []() {
+      Dispatcher::addService(std::make_shared<MaterializedViewRunner>());
+    });
+  }
+#endif
+  return Status::success();
+}
+
+REGISTER_INTERNAL(MaterializedViewsConfigParserPlugin,
+                  "config_parser",
+                  "materialized_views");
+} // namespace osquery
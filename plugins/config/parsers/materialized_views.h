@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+
+#include <osquery/config/config.h>
+#include <osquery/core/tables.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief A table returning the stored rows of a materialized view.
+ *
+ * The rows are the results of the view's query when it was last refreshed,
+ * the query itself never runs when the table is selected.
+ */
+class MaterializedViewPlugin : public TablePlugin {
+  TableColumns tc_columns_;
+  std::string view_name_;
+
+ protected:
+  TableColumns columns() const override {
+    return tc_columns_;
+  }
+
+ public:
+  MaterializedViewPlugin(const std::string& view_name,
+                         const TableColumns& tc_columns)
+      : tc_columns_(tc_columns), view_name_(view_name) {}
+
+  TableRows generate(QueryContext& context) override;
+};
+
+/// Refreshes the materialized views once their interval elapsed.
+class MaterializedViewRunner : public PeriodicRunnable {
+ public:
+  MaterializedViewRunner() : PeriodicRunnable("MaterializedViewRunner") {}
+
+ protected:
+  std::chrono::milliseconds tick() override;
+};
+
+/**
+ * @brief A ConfigParserPlugin for the "materialized_views" dictionary key.
+ *
+ * Each view has a query and a refresh interval in seconds. It is registered
+ * as a table of the columns of its query, whose rows are stored in the
+ * database by the MaterializedViewRunner.
+ */
+class MaterializedViewsConfigParserPlugin : public ConfigParserPlugin {
+  const std::string kParserKey{"materialized_views"};
+
+ public:
+  std::vector<std::string> keys() const override {
+    return {kParserKey};
+  }
+
+  Status update(const std::string& source, const ParserConfig& config) override;
+
+  /**
+   * @brief Run the queries of the views due at this time and store the rows.
+   *
+   * @return the number of views refreshed.
+   */
+  static size_t refreshViews(uint64_t now);
+
+ private:
+  /// Remove these views from the registry and database.
+  static void removeViews(const std::set<std::string>& views);
+
+ private:
+  struct View {
+    std::string query;
+    uint64_t interval{0};
+    uint64_t refresh_time{0};
+  };
+
+  /// The configured views by name, shared with the MaterializedViewRunner.
+  static std::map<std::string, View> views_;
+  static Mutex views_mutex_;
+};
+} // namespace osquery
@@ -22,6 +22,7 @@ namespace osquery {
 DECLARE_bool(disable_decorators);
 DECLARE_bool(decorations_top_level);
 DECLARE_bool(logger_numerics);
+DECLARE_uint64(decorators_always_refresh);
 
 class DecoratorsConfigParserPluginTests : public testing::Test {
  public:
@@ -117,6 +118,32 @@ TEST_F(DecoratorsConfigParserPluginTests, test_decorators_run_interval) {
   ASSERT_EQ(second_item.decorations.size(), 2U);
 }
 
+TEST_F(DecoratorsConfigParserPluginTests, test_decorators_run_always) {
+  // Prevent loads from executing.
+  FLAGS_disable_decorators = true;
+  auto status = Config::get().update(config_data_);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  auto refresh = FLAGS_decorators_always_refresh;
+  FLAGS_decorators_always_refresh = 3600;
+  FLAGS_disable_decorators = false;
+  runDecorators(DECORATE_ALWAYS);
+  auto decorations = getDecorations();
+  EXPECT_EQ(decorations->count("always_test"), 1U);
+
+  // Within the refresh window the shared decorations are reused.
+  runDecorators(DECORATE_ALWAYS);
+  EXPECT_EQ(getDecorations(), decorations);
+
+  // Clearing the results expires the window, the next query runs them.
+  clearDecorations("awesome");
+  EXPECT_EQ(getDecorations()->count("always_test"), 0U);
+  runDecorators(DECORATE_ALWAYS);
+  EXPECT_EQ(getDecorations()->count("always_test"), 1U);
+
+  FLAGS_decorators_always_refresh = refresh;
+}
+
 TEST_F(DecoratorsConfigParserPluginTests, test_decorators_run_load_top_level) {
   // Re-enable the decorators, then update the config.
   // The 'load' decorator set should run every time the config is updated.
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/config/config.h>
+#include <osquery/core/system.h>
+#include <osquery/database/database.h>
+#include <osquery/registry/registry.h>
+#include <osquery/sql/sql.h>
+#include <plugins/config/parsers/materialized_views.h>
+
+namespace osquery {
+
+class MaterializedViewsConfigParserPluginTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    static bool initialized = false;
+    if (!initialized) {
+      initialized = true;
+      platformSetup();
+      registryAndPluginInit();
+      initDatabasePluginForTesting();
+    }
+  }
+};
+
+TEST_F(MaterializedViewsConfigParserPluginTests, test_refresh_view) {
+  Config c;
+  auto s = c.update(
+      {{"awesome",
+        "{\"materialized_views\": {\"mv_test\": {\"query\": \"SELECT 1 AS "
+        "one, 'a' AS two\", \"interval\": 60}}}"}});
+  ASSERT_TRUE(s.ok());
+
+  auto tables = RegistryFactory::get().registry("table");
+  ASSERT_TRUE(tables->exists("mv_test"));
+
+  // The view has no rows until its first refresh.
+  QueryData results;
+  s = query("SELECT * FROM mv_test", results);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_TRUE(results.empty());
+
+  EXPECT_EQ(MaterializedViewsConfigParserPlugin::refreshViews(1000), 1U);
+  s = query("SELECT one, two FROM mv_test", results);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["one"], "1");
+  EXPECT_EQ(results[0]["two"], "a");
+
+  // Views are only refreshed once their interval elapsed.
+  EXPECT_EQ(MaterializedViewsConfigParserPlugin::refreshViews(1059), 0U);
+  EXPECT_EQ(MaterializedViewsConfigParserPlugin::refreshViews(1060), 1U);
+
+  // Views removed from the configuration are removed with their rows.
+  s = c.update({{"awesome", "{\"materialized_views\": {}}"}});
+  ASSERT_TRUE(s.ok());
+  EXPECT_FALSE(tables->exists("mv_test"));
+
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kQueries, keys, "materialized_views.");
+  EXPECT_TRUE(keys.empty());
+  c.reset();
+}
+
+TEST_F(MaterializedViewsConfigParserPluginTests, test_view_overrides_table) {
+  Config c;
+  auto s = c.update(
+      {{"awesome",
+        "{\"materialized_views\": {\"time\": {\"query\": \"SELECT 1\"}}}"}});
+  ASSERT_TRUE(s.ok());
+
+  // Existing tables are not replaced.
+  auto plugin = RegistryFactory::get().plugin("table", "time");
+  EXPECT_EQ(std::dynamic_pointer_cast<MaterializedViewPlugin>(plugin),
+            nullptr);
+  c.reset();
+}
+} // namespace osquery
@@ -54,6 +54,10 @@ class TLSConfigTests : public testing::Test {
     FLAGS_config_refresh = 0;
   }
 
+  bool notModified(const TLSConfigPlugin& plugin) {
+    return plugin.conditional_.not_modified;
+  }
+
   void TearDown() override {
     TLSServerRunner::unsetClientConfig();
     TLSServerRunner::stop();
@@ -104,6 +108,30 @@ TEST_F(TLSConfigTests, test_retrieve_config) {
   EXPECT_EQ("baz", response[0]["tls_plugin"]);
 }
 
+TEST_F(TLSConfigTests, test_conditional_config) {
+  Flag::updateValue("config_tls_endpoint", "/config_tagged");
+  Registry::get().setActive("config", "tls");
+
+  auto plugin = std::dynamic_pointer_cast<TLSConfigPlugin>(
+      Registry::get().plugin("config", "tls"));
+  ASSERT_NE(plugin, nullptr);
+
+  // The first request receives the compressed and tagged config.
+  std::map<std::string, std::string> config;
+  auto status = plugin->genConfig(config);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_FALSE(notModified(*plugin));
+  ASSERT_EQ(config.count("tls_plugin"), 1U);
+  EXPECT_NE(config["tls_plugin"].find("tls_proc"), std::string::npos);
+
+  // The second request presents the tag and keeps the same content.
+  std::map<std::string, std::string> unchanged;
+  status = plugin->genConfig(unchanged);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(notModified(*plugin));
+  EXPECT_EQ(unchanged, config);
+}
+
 TEST_F(TLSConfigTests, test_runner_and_scheduler) {
   Flag::updateValue("config_tls_endpoint", "/config");
   // Will cause another enroll.
@@ -61,15 +61,37 @@ Status TLSConfigPlugin::setUp() {
 }
 
 Status TLSConfigPlugin::genConfig(std::map<std::string, std::string>& config) {
+  WriteLock lock(config_mutex_);
+
   std::string json;
   JSON params;
   if (FLAGS_tls_node_api) {
     // The TLS node API morphs some verbs and variables.
     params.add("_get", true);
+  } else if (!config_.empty()) {
+    // Servers without entity tags may compare the hash of the applied config.
+    auto hash = Config::get().getHash("tls_plugin");
+    if (!hash.empty()) {
+      params.add("config_hash", hash);
+    }
+  }
+
+  if (config_.empty()) {
+    // Without a copy of the content a not modified reply cannot be used.
+    conditional_.tag.clear();
   }
 
   auto s = TLSRequestHelper::go<JSONSerializer>(
-      uri_, params, json, FLAGS_config_tls_max_attempts);
+      uri_, params, json, FLAGS_config_tls_max_attempts, &conditional_);
+  if (s.ok() && conditional_.not_modified) {
+    if (config_.empty()) {
+      return Status::failure("TLS config not modified but no config is held");
+    }
+    VLOG(1) << "TLS config not modified";
+    config["tls_plugin"] = config_;
+    return s;
+  }
+
   if (s.ok()) {
     if (FLAGS_tls_node_api) {
       // The node API embeds configuration data (JSON escaped).
@@ -89,6 +111,7 @@ Status TLSConfigPlugin::genConfig(std::map<std::string, std::string>& config) {
     } else {
       config["tls_plugin"] = json;
     }
+    config_ = config["tls_plugin"];
   }
 
   return s;
@@ -11,6 +11,8 @@
 
 #include <osquery/config/config.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/remote/utility.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -26,6 +28,16 @@ class TLSConfigPlugin : public ConfigPlugin,
   /// Calculate the URL once and cache the result.
   std::string uri_;
 
+ private:
+  /// Protects the last config and its entity tag.
+  Mutex config_mutex_;
+
+  /// The last config content, returned when the remote replies not modified.
+  std::string config_;
+
+  /// The entity tag of the last config content.
+  TLSConditional conditional_;
+
  private:
   friend class TLSConfigTests;
 };
@@ -9,9 +9,16 @@
 
 #include <sys/stat.h>
 
+#include <cstdlib>
+
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/rate_limiter.h>
+#include <rocksdb/table.h>
+#include <rocksdb/write_buffer_manager.h>
 
 #include <osquery/core/flags.h>
 #include <osquery/filesystem/fileops.h>
@@ -31,7 +38,30 @@ HIDDEN_FLAG(int32, rocksdb_merge_number, 4, "Min write buffer number to merge");
 HIDDEN_FLAG(int32, rocksdb_background_flushes, 4, "Max background flushes");
 HIDDEN_FLAG(int32, rocksdb_buffer_blocks, 256, "Write buffer blocks (4k)");
 
+FLAG(uint64,
+     rocksdb_memory_budget,
+     64,
+     "Megabytes shared by RocksDB block caches and memtables (0 is unbounded)");
+
+FLAG(uint64,
+     rocksdb_rate_limit,
+     0,
+     "Megabytes per second of RocksDB flush and compaction writes (0 is "
+     "unlimited)");
+
+FLAG(bool,
+     rocksdb_domain_profiles,
+     true,
+     "Tune RocksDB compaction and compression to each storage domain");
+
+FLAG(uint64,
+     rocksdb_compression_dictionary,
+     16,
+     "Kilobytes of the zstd dictionary trained for each compressed RocksDB "
+     "file of query results, logs and events (0 disables dictionaries)");
+
 DECLARE_string(database_path);
+DECLARE_bool(lazy_startup);
 
 /**
  * @brief Track external systems marking the RocksDB database as corrupted.
@@ -44,6 +74,202 @@ std::atomic<bool> kRocksDBCorruptionIndicator{false};
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(RocksDBDatabasePlugin, "database", "rocksdb");
 
+namespace {
+
+/// Bloom filter bits per key, about a 1% false positive rate.
+const int kBloomBitsPerKey{10};
+
+/// Block cache size when no memory budget is configured.
+const size_t kBlockCacheSize{8 * 1024 * 1024};
+
+/// Bytes sampled to train a dictionary, per byte of dictionary.
+const uint32_t kDictionaryTrainingRatio{100};
+
+/**
+ * @brief Compress with a zstd dictionary trained on the file's own values.
+ *
+ * Stored results and logs repeat the same JSON members and values. RocksDB
+ * samples the data of each file it writes, trains a dictionary and keeps it
+ * in the file, so reads need nothing else.
+ */
+void useCompressionDictionary(rocksdb::CompressionOptions& options) {
+  if (FLAGS_rocksdb_compression_dictionary == 0) {
+    return;
+  }
+
+  auto dict_bytes =
+      static_cast<uint32_t>(FLAGS_rocksdb_compression_dictionary * 1024);
+  options.max_dict_bytes = dict_bytes;
+  options.zstd_max_train_bytes = dict_bytes * kDictionaryTrainingRatio;
+  options.enabled = true;
+}
+
+/**
+ * @brief Tune a copy of the database options to a domain's workload.
+ *
+ * Every profile only changes options RocksDB accepts for an existing column
+ * family, so toggling profiles does not require a database migration.
+ */
+rocksdb::ColumnFamilyOptions getDomainOptions(
+    const std::string& domain,
+    const rocksdb::Options& options,
+    const std::shared_ptr<rocksdb::Cache>& cache) {
+  rocksdb::ColumnFamilyOptions cf_options(options);
+
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.block_cache = cache;
+  // Charge index and filter blocks to the cache so readers stay in budget.
+  table_options.cache_index_and_filter_blocks = true;
+  table_options.pin_l0_filter_and_index_blocks_in_cache = true;
+
+  if (FLAGS_rocksdb_domain_profiles) {
+    // Point lookups, such as batched event reads, skip files without the key.
+    table_options.filter_policy.reset(
+        rocksdb::NewBloomFilterPolicy(kBloomBitsPerKey, false));
+
+    if (domain == kEvents) {
+      // Events are appended in time order and expired in ranges. Universal
+      // compaction rewrites far less data than levels for this pattern.
+      cf_options.compaction_style = rocksdb::kCompactionStyleUniversal;
+      cf_options.compaction_options_universal.allow_trivial_move = true;
+      // Recent events are hot; only compress runs that reach the bottom.
+      cf_options.bottommost_compression = rocksdb::kZSTD;
+      useCompressionDictionary(cf_options.bottommost_compression_opts);
+    } else if (domain == kQueries) {
+      // A few large values rewritten every interval compress well.
+      cf_options.compression = rocksdb::kZSTD;
+      useCompressionDictionary(cf_options.compression_opts);
+    } else if (domain == kCarves) {
+      // Carved archives gain little from a dictionary.
+      cf_options.compression = rocksdb::kZSTD;
+    } else if (domain == kLogs) {
+      // Buffered logs are written once, read once and deleted. The ones that
+      // reach a file while the logger is behind repeat the same members.
+      cf_options.max_write_buffer_number = 4;
+      cf_options.min_write_buffer_number_to_merge = 1;
+      cf_options.compression = rocksdb::kZSTD;
+      useCompressionDictionary(cf_options.compression_opts);
+    } else if (domain == kPersistentSettings) {
+      // A handful of small settings do not need large memtables.
+      cf_options.write_buffer_size = 64 * 1024;
+      cf_options.max_write_buffer_number = 2;
+      cf_options.min_write_buffer_number_to_merge = 1;
+    }
+  }
+
+  cf_options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(table_options));
+  return cf_options;
+}
+
+/// The first key after every key beginning with prefix, empty if unbounded.
+std::string prefixSuccessor(std::string prefix) {
+  while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xff) {
+    prefix.pop_back();
+  }
+  if (!prefix.empty()) {
+    prefix.back()++;
+  }
+  return prefix;
+}
+
+/// The smallest of the explicit and the prefix upper bounds.
+std::string cursorUpperBound(const DatabaseCursorOptions& options) {
+  auto upper = prefixSuccessor(options.prefix);
+  if (upper.empty() || (!options.upper.empty() && options.upper < upper)) {
+    return options.upper;
+  }
+  return upper;
+}
+
+/// Read an integer from a map property, 0 if it is missing.
+uint64_t mapPropertyValue(const std::map<std::string, std::string>& values,
+                          const std::string& key) {
+  auto it = values.find(key);
+  if (it == values.end()) {
+    return 0;
+  }
+  // Stall counts may be formatted as doubles, only the integer part is read.
+  return std::strtoull(it->second.c_str(), nullptr, 10);
+}
+
+/**
+ * @brief A cursor streaming pairs from a RocksDB iterator.
+ *
+ * The upper bound is passed to RocksDB so the iterator does not read past the
+ * end of the range, and a requested snapshot is released with the cursor.
+ */
+class RocksDBDatabaseCursor : public DatabaseCursor {
+ public:
+  RocksDBDatabaseCursor(rocksdb::DB* db,
+                        rocksdb::ColumnFamilyHandle* handle,
+                        const DatabaseCursorOptions& options)
+      : db_(db),
+        prefix_(options.prefix),
+        upper_(cursorUpperBound(options)),
+        upper_slice_(upper_) {
+    auto read_options = rocksdb::ReadOptions();
+    read_options.verify_checksums = false;
+    read_options.fill_cache = false;
+    if (!upper_.empty()) {
+      read_options.iterate_upper_bound = &upper_slice_;
+    }
+    if (options.snapshot) {
+      snapshot_ = db_->GetSnapshot();
+      read_options.snapshot = snapshot_;
+    }
+
+    it_.reset(db_->NewIterator(read_options, handle));
+    it_->Seek(options.start());
+  }
+
+  ~RocksDBDatabaseCursor() override {
+    it_.reset();
+    if (snapshot_ != nullptr) {
+      db_->ReleaseSnapshot(snapshot_);
+    }
+  }
+
+  bool valid() const override {
+    return it_->Valid() && it_->key().starts_with(prefix_);
+  }
+
+  void next() override {
+    if (valid()) {
+      it_->Next();
+    }
+  }
+
+  std::string key() const override {
+    return it_->key().ToString();
+  }
+
+  std::string value() const override {
+    return it_->value().ToString();
+  }
+
+  Status status() const override {
+    auto s = it_->status();
+    if (!s.ok()) {
+      return Status(s.code(), s.ToString());
+    }
+    return Status::success();
+  }
+
+ private:
+  rocksdb::DB* db_{nullptr};
+  std::string prefix_;
+
+  /// The iterator holds a pointer to the upper bound slice.
+  std::string upper_;
+  rocksdb::Slice upper_slice_;
+
+  const rocksdb::Snapshot* snapshot_{nullptr};
+  std::unique_ptr<rocksdb::Iterator> it_;
+};
+
+} // namespace
+
 void GlogRocksDBLogger::Logv(const char* format, va_list ap) {
   // Convert RocksDB log to string and check if header or level-ed log.
   std::string log_line;
@@ -105,6 +331,25 @@ Status RocksDBDatabasePlugin::setUp() {
     options_.max_background_flushes =
         static_cast<int>(FLAGS_rocksdb_background_flushes);
 
+    // One budget bounds the block cache and memtables of every domain.
+    // Memtables reserve their memory in the cache and are flushed once
+    // they hold half of the budget.
+    if (FLAGS_rocksdb_memory_budget > 0) {
+      auto budget = FLAGS_rocksdb_memory_budget * 1024 * 1024;
+      cache_ = rocksdb::NewLRUCache(budget);
+      options_.write_buffer_manager =
+          std::make_shared<rocksdb::WriteBufferManager>(budget / 2, cache_);
+    } else {
+      cache_ = rocksdb::NewLRUCache(kBlockCacheSize);
+    }
+
+    // Background flushes and compactions share one disk bandwidth budget,
+    // so they do not starve query reads on slow disks.
+    if (FLAGS_rocksdb_rate_limit > 0) {
+      options_.rate_limiter.reset(rocksdb::NewGenericRateLimiter(
+          static_cast<int64_t>(FLAGS_rocksdb_rate_limit * 1024 * 1024)));
+    }
+
     // Create an environment to replace the default logger.
     if (logger_ == nullptr) {
       logger_ = std::make_shared<GlogRocksDBLogger>();
@@ -112,11 +357,12 @@ Status RocksDBDatabasePlugin::setUp() {
     options_.info_log = logger_;
 
     column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
-        rocksdb::kDefaultColumnFamilyName, options_));
+        rocksdb::kDefaultColumnFamilyName,
+        getDomainOptions(rocksdb::kDefaultColumnFamilyName, options_, cache_)));
 
     for (const auto& cf_name : kDomains) {
-      column_families_.push_back(
-          rocksdb::ColumnFamilyDescriptor(cf_name, options_));
+      column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
+          cf_name, getDomainOptions(cf_name, options_, cache_)));
     }
   }
 
@@ -157,6 +403,16 @@ Status RocksDBDatabasePlugin::setUp() {
     return Status(1, "Cannot set permissions on RocksDB path: " + path_);
   }
 
+  // Compaction may instead wait for the first maintenance.
+  compact_on_maintain_ = FLAGS_lazy_startup;
+  if (!FLAGS_lazy_startup) {
+    compactDomains();
+  }
+
+  return Status(0);
+}
+
+void RocksDBDatabasePlugin::compactDomains() {
   for (const auto& cf_name : kDomains) {
     if (cf_name != kEvents) {
       auto compact_status = compactFiles(cf_name);
@@ -166,8 +422,6 @@ Status RocksDBDatabasePlugin::setUp() {
       }
     }
   }
-
-  return Status(0);
 }
 
 Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
@@ -255,6 +509,75 @@ void RocksDBDatabasePlugin::repairDB() {
   LOG(WARNING) << "Destroying RocksDB database due to corruption";
 }
 
+Status RocksDBDatabasePlugin::getMemoryUsage(
+    DatabaseMemoryUsage& usage) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  usage = DatabaseMemoryUsage();
+  usage.budget = FLAGS_rocksdb_memory_budget * 1024 * 1024;
+  if (cache_ != nullptr) {
+    usage.block_cache = cache_->GetUsage();
+    usage.block_cache_pinned = cache_->GetPinnedUsage();
+  }
+
+  const auto& memtables = rocksdb::DB::Properties::kCurSizeAllMemTables;
+  const auto& readers = rocksdb::DB::Properties::kEstimateTableReadersMem;
+  for (auto handle : handles_) {
+    uint64_t value = 0;
+    if (getDB()->GetIntProperty(handle, memtables, &value)) {
+      usage.memtables += value;
+    }
+    if (getDB()->GetIntProperty(handle, readers, &value)) {
+      usage.table_readers += value;
+    }
+  }
+  return Status::success();
+}
+
+Status RocksDBDatabasePlugin::getDomainStats(
+    std::vector<DatabaseDomainStats>& stats) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  stats.clear();
+  uint64_t stopped = 0;
+  getDB()->GetIntProperty(rocksdb::DB::Properties::kIsWriteStopped, &stopped);
+
+  using Properties = rocksdb::DB::Properties;
+  for (size_t i = 0; i < handles_.size() && i < kDomains.size(); i++) {
+    auto handle = handles_[i];
+    DatabaseDomainStats domain;
+    domain.domain = kDomains[i];
+    domain.write_stopped = (stopped != 0);
+
+    getDB()->GetIntProperty(handle, Properties::kEstimateNumKeys, &domain.keys);
+    getDB()->GetIntProperty(
+        handle, Properties::kCurSizeAllMemTables, &domain.memtables);
+    getDB()->GetIntProperty(
+        handle, Properties::kEstimateLiveDataSize, &domain.live_bytes);
+    getDB()->GetIntProperty(handle,
+                            Properties::kEstimatePendingCompactionBytes,
+                            &domain.pending_compaction_bytes);
+
+    rocksdb::ColumnFamilyMetaData meta;
+    getDB()->GetColumnFamilyMetaData(handle, &meta);
+    domain.sst_files = meta.file_count;
+    domain.sst_bytes = meta.size;
+
+    std::map<std::string, std::string> cfstats;
+    if (getDB()->GetMapProperty(handle, Properties::kCFStats, &cfstats)) {
+      domain.write_slowdowns =
+          mapPropertyValue(cfstats, "io_stalls.total_slowdown");
+      domain.write_stops = mapPropertyValue(cfstats, "io_stalls.total_stop");
+    }
+    stats.push_back(std::move(domain));
+  }
+  return Status::success();
+}
+
 rocksdb::DB* RocksDBDatabasePlugin::getDB() const {
   return db_;
 }
@@ -298,10 +621,45 @@ Status RocksDBDatabasePlugin::get(const std::string& domain,
   }
   return s;
 }
+Status RocksDBDatabasePlugin::getBatch(const std::string& domain,
+                                       const std::vector<std::string>& keys,
+                                       std::vector<std::string>& values) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  std::vector<rocksdb::Slice> key_slices(keys.begin(), keys.end());
+  std::vector<rocksdb::ColumnFamilyHandle*> handles(keys.size(), cfh);
+
+  values.clear();
+  auto statuses = getDB()->MultiGet(
+      rocksdb::ReadOptions(), handles, key_slices, &values);
+  for (size_t i = 0; i < statuses.size(); i++) {
+    if (statuses[i].IsNotFound()) {
+      values[i].clear();
+    } else if (!statuses[i].ok()) {
+      return Status(statuses[i].code(), statuses[i].ToString());
+    }
+  }
+  return Status::success();
+}
+
 Status RocksDBDatabasePlugin::put(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) {
-  return putBatch(domain, {std::make_pair(key, value)});
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  // A single value is written from the caller's strings, without a copy.
+  rocksdb::WriteBatch batch;
+  batch.Put(cfh, key, value);
+  return write(domain, batch);
 }
 
 Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
@@ -311,14 +669,6 @@ Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
     return Status(1, "Could not get column family for " + domain);
   }
 
-  // Events should be fast, and do not need to force syncs.
-  auto options = rocksdb::WriteOptions();
-  if (kEvents == domain) {
-    options.disableWAL = true;
-  } else {
-    options.sync = true;
-  }
-
   rocksdb::WriteBatch batch;
   for (const auto& p : data) {
     const auto& key = p.first;
@@ -326,6 +676,18 @@ Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
 
     batch.Put(cfh, key, value);
   }
+  return write(domain, batch);
+}
+
+Status RocksDBDatabasePlugin::write(const std::string& domain,
+                                    rocksdb::WriteBatch& batch) {
+  // Events should be fast, and do not need to force syncs.
+  auto options = rocksdb::WriteOptions();
+  if (kEvents == domain) {
+    options.disableWAL = true;
+  } else {
+    options.sync = true;
+  }
 
   auto s = getDB()->Write(options, &batch);
   if (s.code() != 0 && s.IsIOError()) {
@@ -344,7 +706,7 @@ Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
 Status RocksDBDatabasePlugin::put(const std::string& domain,
                                   const std::string& key,
                                   int value) {
-  return putBatch(domain, {std::make_pair(key, std::to_string(value))});
+  return put(domain, key, std::to_string(value));
 }
 
 Status RocksDBDatabasePlugin::remove(const std::string& domain,
@@ -388,9 +750,66 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
   if (low <= high) {
     s = getDB()->Delete(options, cfh, high);
   }
+
+  if (s.ok()) {
+    // The range tombstones are compacted away by the next maintenance.
+    WriteLock lock(maintenance_mutex_);
+    auto it = reclaim_ranges_.find(domain);
+    if (it == reclaim_ranges_.end()) {
+      reclaim_ranges_[domain] = std::make_pair(low, high);
+    } else {
+      it->second.first = std::min(it->second.first, low);
+      it->second.second = std::max(it->second.second, high);
+    }
+  }
   return Status(s.code(), s.ToString());
 }
 
+Status RocksDBDatabasePlugin::maintain() {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  if (compact_on_maintain_.exchange(false)) {
+    compactDomains();
+  }
+
+  std::map<std::string, std::pair<std::string, std::string>> ranges;
+  {
+    WriteLock lock(maintenance_mutex_);
+    ranges.swap(reclaim_ranges_);
+  }
+
+  // Manual compactions run alongside, not instead of, background work.
+  auto options = rocksdb::CompactRangeOptions();
+  options.exclusive_manual_compaction = false;
+
+  // Removed ranges, such as expired events, are compacted to reclaim space.
+  for (const auto& range : ranges) {
+    auto handle = getHandleForColumnFamily(range.first);
+    if (handle == nullptr) {
+      continue;
+    }
+
+    rocksdb::Slice begin(range.second.first);
+    rocksdb::Slice end(range.second.second);
+    auto s = getDB()->CompactRange(options, handle, &begin, &end);
+    if (!s.ok()) {
+      return Status(s.code(), s.ToString());
+    }
+  }
+
+  // Differential results are rewritten in place, their old versions pile up.
+  auto handle = getHandleForColumnFamily(kQueries);
+  if (handle != nullptr) {
+    auto s = getDB()->CompactRange(options, handle, nullptr, nullptr);
+    if (!s.ok()) {
+      return Status(s.code(), s.ToString());
+    }
+  }
+  return Status::success();
+}
+
 Status RocksDBDatabasePlugin::scan(const std::string& domain,
                                    std::vector<std::string>& results,
                                    const std::string& prefix,
@@ -411,17 +830,68 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
     return Status(1, "Could not get iterator for " + domain);
   }
 
+  // Keys are ordered, those sharing the prefix are adjacent.
   size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+       it->Next()) {
+    results.push_back(it->key().ToString());
+    if (max > 0 && ++count >= max) {
+      break;
     }
   }
   delete it;
   return Status::success();
 }
+
+Status RocksDBDatabasePlugin::scanValues(const std::string& domain,
+                                         DatabaseStringValueList& results,
+                                         const std::string& prefix,
+                                         uint64_t max) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+  auto options = rocksdb::ReadOptions();
+  options.verify_checksums = false;
+  options.fill_cache = false;
+  std::unique_ptr<rocksdb::Iterator> it(getDB()->NewIterator(options, cfh));
+  if (it == nullptr) {
+    return Status(1, "Could not get iterator for " + domain);
+  }
+
+  size_t count = 0;
+  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+       it->Next()) {
+    results.push_back(
+        std::make_pair(it->key().ToString(), it->value().ToString()));
+    if (max > 0 && ++count >= max) {
+      break;
+    }
+  }
+
+  if (!it->status().ok()) {
+    return Status(it->status().code(), it->status().ToString());
+  }
+  return Status::success();
+}
+
+Status RocksDBDatabasePlugin::openCursor(const std::string& domain,
+                                         const DatabaseCursorOptions& options,
+                                         DatabaseCursorRef& cursor) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  cursor = std::make_unique<RocksDBDatabaseCursor>(getDB(), cfh, options);
+  return cursor->status();
+}
 } // namespace osquery
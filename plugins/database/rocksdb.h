@@ -8,8 +8,11 @@
  */
 
 #include <atomic>
+#include <map>
 
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
 
 #include <osquery/core/core.h>
 #include <osquery/database/database.h>
@@ -45,6 +48,11 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
              const std::string& key,
              int& value) const override;
 
+  /// Bulk data retrieval method, uses a single RocksDB MultiGet.
+  Status getBatch(const std::string& domain,
+                  const std::vector<std::string>& keys,
+                  std::vector<std::string>& values) const override;
+
   /// Data storage method.
   Status put(const std::string& domain,
              const std::string& key,
@@ -71,6 +79,26 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value scan method, a single iterator pass.
+  Status scanValues(const std::string& domain,
+                    DatabaseStringValueList& results,
+                    const std::string& prefix,
+                    uint64_t max) const override;
+
+  /// Key and value cursor method, streams a single iterator.
+  Status openCursor(const std::string& domain,
+                    const DatabaseCursorOptions& options,
+                    DatabaseCursorRef& cursor) const override;
+
+  /// Compact ranges removed since the last call, and the queries domain.
+  Status maintain() override;
+
+  /// Report the shared block cache and memtable usage.
+  Status getMemoryUsage(DatabaseMemoryUsage& usage) const override;
+
+  /// Report the size, compaction debt and write stalls of each domain.
+  Status getDomainStats(std::vector<DatabaseDomainStats>& stats) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -102,9 +130,15 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
    */
   rocksdb::DB* getDB() const;
 
+  /// Apply a write batch, synced unless it is for the events domain.
+  Status write(const std::string& domain, rocksdb::WriteBatch& batch);
+
   /// Request RocksDB compact each domain and level to that same level.
   Status compactFiles(const std::string& domain);
 
+  /// Compact every domain but events, as done when the database is opened.
+  void compactDomains();
+
   /**
    * @brief Helper method to repair a corrupted db. Best effort only.
    *
@@ -145,9 +179,21 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// The RocksDB connection options that are used to connect to RocksDB
   rocksdb::Options options_;
 
+  /// Block cache shared by every domain, memtables are charged against it.
+  std::shared_ptr<rocksdb::Cache> cache_{nullptr};
+
   /// Deconstruction mutex.
   Mutex close_mutex_;
 
+  /// The span of keys removed from each domain since the last maintenance.
+  std::map<std::string, std::pair<std::string, std::string>> reclaim_ranges_;
+
+  /// Protects the removed key spans.
+  Mutex maintenance_mutex_;
+
+  /// Set when opening skipped compaction, the first maintenance compacts.
+  std::atomic<bool> compact_on_maintain_{false};
+
  private:
   friend class GlogRocksDBLogger;
   FRIEND_TEST(RocksDBDatabasePluginTests, test_corruption);
@@ -292,4 +292,29 @@ Status SQLiteDatabasePlugin::scan(const std::string& domain,
 
   return Status::success();
 }
+
+Status SQLiteDatabasePlugin::scanValues(const std::string& domain,
+                                        DatabaseStringValueList& results,
+                                        const std::string& prefix,
+                                        uint64_t max) const {
+  QueryData _results;
+  char* err = nullptr;
+
+  std::string q = "select key, value from " + domain + " where key LIKE '" +
+                  prefix + "%' order by key";
+  if (max > 0) {
+    q += " limit " + std::to_string(max);
+  }
+  sqlite3_exec(db_, q.c_str(), getData, &_results, &err);
+  if (err != nullptr) {
+    sqlite3_free(err);
+  }
+
+  for (auto& r : _results) {
+    results.push_back(
+        std::make_pair(std::move(r["key"]), std::move(r["value"])));
+  }
+
+  return Status::success();
+}
 } // namespace osquery
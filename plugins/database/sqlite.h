@@ -55,6 +55,12 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value lookup method.
+  Status scanValues(const std::string& domain,
+                    DatabaseStringValueList& results,
+                    const std::string& prefix,
+                    uint64_t max) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
+#include <osquery/core/flags.h>
 #include <osquery/database/tests/test_utils.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/sql/sql.h>
@@ -14,6 +17,11 @@
 
 namespace osquery {
 
+DECLARE_bool(rocksdb_domain_profiles);
+DECLARE_uint64(rocksdb_compression_dictionary);
+DECLARE_uint64(rocksdb_memory_budget);
+DECLARE_string(database_path);
+
 class RocksDBDatabasePluginTests : public DatabasePluginTests {
  protected:
   std::string name() override {
@@ -51,4 +59,129 @@ TEST_F(RocksDBDatabasePluginTests, test_corruption) {
   resetDatabase();
   EXPECT_FALSE(pathExists(path_ + ".backup"));
 }
+
+TEST_F(RocksDBDatabasePluginTests, test_rocksdb_domain_profiles) {
+  auto profiles = FLAGS_rocksdb_domain_profiles;
+  auto database_path = FLAGS_database_path;
+  FLAGS_database_path = path_ + ".profiles";
+
+  // Write every domain using the same options for each.
+  FLAGS_rocksdb_domain_profiles = false;
+  {
+    RocksDBDatabasePlugin plugin;
+    ASSERT_TRUE(plugin.setUp().ok());
+    for (const auto& domain : kDomains) {
+      EXPECT_TRUE(plugin.put(domain, "profile", domain).ok());
+    }
+    plugin.tearDown();
+  }
+
+  // The same database opens, and reads, with the tuned domain profiles.
+  FLAGS_rocksdb_domain_profiles = true;
+  {
+    RocksDBDatabasePlugin plugin;
+    ASSERT_TRUE(plugin.setUp().ok());
+    for (const auto& domain : kDomains) {
+      std::string value;
+      EXPECT_TRUE(plugin.get(domain, "profile", value).ok());
+      EXPECT_EQ(value, domain);
+    }
+    plugin.tearDown();
+  }
+
+  removePath(FLAGS_database_path);
+  FLAGS_database_path = database_path;
+  FLAGS_rocksdb_domain_profiles = profiles;
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_rocksdb_compression_dictionary) {
+  auto dictionary = FLAGS_rocksdb_compression_dictionary;
+  auto database_path = FLAGS_database_path;
+  FLAGS_database_path = path_ + ".dictionary";
+
+  // Repetitive values, such as JSON results, are written to compressed files.
+  std::vector<std::string> values;
+  for (size_t i = 0; i < 512; i++) {
+    values.push_back("{\"name\":\"pack_query\",\"counter\":\"" +
+                     std::to_string(i) + "\",\"action\":\"added\"}");
+  }
+
+  // Files written with and without dictionaries open with either setting.
+  bool written = false;
+  for (auto kilobytes : {16U, 0U, 16U}) {
+    FLAGS_rocksdb_compression_dictionary = kilobytes;
+    RocksDBDatabasePlugin plugin;
+    ASSERT_TRUE(plugin.setUp().ok());
+    for (const auto& domain : {kQueries, kLogs}) {
+      for (size_t i = 0; i < values.size(); i++) {
+        std::string value;
+        auto status = plugin.get(domain, std::to_string(i), value);
+        EXPECT_EQ(status.ok(), written);
+        if (written) {
+          EXPECT_EQ(value, values[i]);
+        }
+        EXPECT_TRUE(plugin.put(domain, std::to_string(i), values[i]).ok());
+      }
+    }
+    written = true;
+    EXPECT_TRUE(plugin.maintain().ok());
+    plugin.tearDown();
+  }
+
+  removePath(FLAGS_database_path);
+  FLAGS_database_path = database_path;
+  FLAGS_rocksdb_compression_dictionary = dictionary;
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_rocksdb_memory_usage) {
+  ASSERT_TRUE(setDatabaseValue(kQueries, "memory", std::string(4096, 'a')));
+
+  DatabaseMemoryUsage usage;
+  ASSERT_TRUE(getDatabaseMemoryUsage(usage).ok());
+  EXPECT_EQ(usage.budget, FLAGS_rocksdb_memory_budget * 1024 * 1024);
+  EXPECT_GT(usage.memtables, 0U);
+  // Memtable memory is reserved within the shared cache.
+  EXPECT_GT(usage.block_cache, 0U);
+  EXPECT_LE(usage.block_cache, usage.budget);
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_rocksdb_maintain) {
+  for (size_t i = 0; i < 100; i++) {
+    auto key = "maintain." + std::to_string(1000 + i);
+    ASSERT_TRUE(setDatabaseValue(kEvents, key, std::string(1024, 'a')));
+  }
+  ASSERT_TRUE(deleteDatabaseRange(kEvents, "maintain.1000", "maintain.1099"));
+
+  // Removed ranges are compacted, and the remaining data is readable.
+  ASSERT_TRUE(setDatabaseValue(kQueries, "maintain", "value"));
+  EXPECT_TRUE(maintainDatabase().ok());
+
+  std::vector<std::string> keys;
+  ASSERT_TRUE(scanDatabaseKeys(kEvents, keys, "maintain."));
+  EXPECT_TRUE(keys.empty());
+
+  std::string value;
+  ASSERT_TRUE(getDatabaseValue(kQueries, "maintain", value));
+  EXPECT_EQ(value, "value");
+
+  // Nothing is pending for the next maintenance.
+  EXPECT_TRUE(maintainDatabase().ok());
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_rocksdb_domain_stats) {
+  ASSERT_TRUE(setDatabaseValue(kEvents, "stats", std::string(4096, 'a')));
+
+  std::vector<DatabaseDomainStats> stats;
+  ASSERT_TRUE(getDatabaseDomainStats(stats).ok());
+  ASSERT_EQ(stats.size(), kDomains.size());
+
+  auto events = std::find_if(
+      stats.begin(), stats.end(), [](const DatabaseDomainStats& domain) {
+        return domain.domain == kEvents;
+      });
+  ASSERT_NE(events, stats.end());
+  EXPECT_GT(events->memtables, 0U);
+  EXPECT_GT(events->keys, 0U);
+  EXPECT_FALSE(events->write_stopped);
+}
 }
@@ -18,7 +18,9 @@
 #include <osquery/distributed/distributed.h>
 #include <osquery/remote/enroll/enroll.h>
 #include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <plugins/logger/buffered.h>
 
 #include <osquery/utils/json/json.h>
 #include <osquery/remote/serializers/json.h>
@@ -27,6 +29,7 @@
 namespace osquery {
 
 DECLARE_bool(tls_node_api);
+DECLARE_uint64(distributed_long_poll);
 
 FLAG(string,
      distributed_tls_read_endpoint,
@@ -43,6 +46,14 @@ FLAG(uint64,
      3,
      "Number of times to attempt a request")
 
+FLAG(string,
+     distributed_tls_compression,
+     "",
+     "Compress distributed query results: gzip, zstd (default none)");
+
+/// Seconds, beyond the long poll, to wait for the server's response.
+const int kLongPollResponseTimeout{16};
+
 class TLSDistributedPlugin : public DistributedPlugin {
  public:
   Status setUp() override;
@@ -54,6 +65,9 @@ class TLSDistributedPlugin : public DistributedPlugin {
  protected:
   std::string read_uri_;
   std::string write_uri_;
+
+  /// The compression of written results.
+  BufferedLogCodec codec_{BufferedLogCodec::None};
 };
 
 REGISTER(TLSDistributedPlugin, "distributed", "tls");
@@ -61,27 +75,75 @@ REGISTER(TLSDistributedPlugin, "distributed", "tls");
 Status TLSDistributedPlugin::setUp() {
   read_uri_ = TLSRequestHelper::makeURI(FLAGS_distributed_tls_read_endpoint);
   write_uri_ = TLSRequestHelper::makeURI(FLAGS_distributed_tls_write_endpoint);
+
+  auto status =
+      parseBufferedLogCodec(FLAGS_distributed_tls_compression, codec_);
+  if (!status.ok()) {
+    LOG(WARNING) << status.getMessage() << ", sending uncompressed results";
+  }
   return Status(0, "OK");
 }
 
 Status TLSDistributedPlugin::getQueries(std::string& json) {
   JSON params;
   params.add("_verb", "POST");
+  if (FLAGS_distributed_long_poll > 0) {
+    // The server may hold the request until it has queries for this node.
+    params.add("long_poll", FLAGS_distributed_long_poll);
+    params.add("_timeout",
+               static_cast<int>(FLAGS_distributed_long_poll) +
+                   kLongPollResponseTimeout);
+  }
   return TLSRequestHelper::go<JSONSerializer>(
       read_uri_, params, json, FLAGS_distributed_tls_max_attempts);
 }
 
 Status TLSDistributedPlugin::writeResults(const std::string& json) {
-  JSON params;
-  Status s = params.fromString(json);
+  if (json.size() < 2 || json.front() != '{') {
+    return Status::failure("Distributed results are not a JSON object");
+  }
 
-  if (!s.ok()) {
-    return s;
+  // Add the node_key to the serialized results rather than parsing them.
+  std::string body;
+  if (!FLAGS_tls_node_api) {
+    JSON params;
+    params.add("node_key", getNodeKey("tls"));
+    auto s = params.toString(body);
+    if (!s.ok()) {
+      return s;
+    }
+    body.pop_back();
+    if (json.size() > 2) {
+      body.push_back(',');
+    }
+    body.append(json, 1, std::string::npos);
+  } else {
+    body = json;
+  }
+
+  if (codec_ != BufferedLogCodec::None) {
+    BufferedLogCompressor compressor(codec_);
+    auto s = compressor.append(body);
+    if (s.ok()) {
+      s = compressor.finish(body);
+    }
+    if (!s.ok()) {
+      return s;
+    }
   }
 
   // The response is ignored.
-  std::string response;
-  return TLSRequestHelper::go<JSONSerializer>(
-      write_uri_, params, response, FLAGS_distributed_tls_max_attempts);
+  JSON response;
+  auto encoding = getBufferedLogContentEncoding(codec_);
+  Status s;
+  for (size_t i = 1; i <= FLAGS_distributed_tls_max_attempts; i++) {
+    s = TLSRequestHelper::goEncoded<JSONSerializer>(
+        write_uri_, body, encoding, response);
+    if (s.ok() || i == FLAGS_distributed_tls_max_attempts) {
+      break;
+    }
+    sleepFor(RemoteBackoff::get().retryDelay(i));
+  }
+  return s;
 }
 }
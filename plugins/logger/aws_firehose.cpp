@@ -32,6 +32,11 @@ FLAG(uint64,
 
 FLAG(string, aws_firehose_stream, "", "Name of Firehose stream for logging")
 
+FLAG(bool,
+     aws_firehose_pack_records,
+     false,
+     "Pack many newline-delimited log lines into each Firehose record");
+
 Status FirehoseLoggerPlugin::setUp() {
   initAwsSdk();
 
@@ -109,6 +114,10 @@ bool FirehoseLogForwarder::appendNewlineSeparators() const {
   return true;
 }
 
+bool FirehoseLogForwarder::packRecords() const {
+  return FLAGS_aws_firehose_pack_records;
+}
+
 size_t FirehoseLogForwarder::getFailedRecordCount(Outcome& outcome) const {
   return static_cast<size_t>(outcome.GetResult().GetFailedPutCount());
 }
@@ -53,6 +53,7 @@ class FirehoseLogForwarder final : public IFirehoseLogForwarder {
   size_t getMaxRetryCount() const override;
   size_t getInitialRetryDelay() const override;
   bool appendNewlineSeparators() const override;
+  bool packRecords() const override;
 
   size_t getFailedRecordCount(Outcome& outcome) const override;
   Result getResult(Outcome& outcome) const override;
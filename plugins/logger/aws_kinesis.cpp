@@ -15,6 +15,7 @@
 #include <thread>
 
 #include <aws/core/client/AWSError.h>
+#include <aws/core/utils/HashingUtils.h>
 #include <aws/core/utils/Outcome.h>
 #include <aws/kinesis/model/PutRecordsRequest.h>
 #include <aws/kinesis/model/PutRecordsResult.h>
@@ -49,6 +50,84 @@ FLAG(bool,
      false,
      "Disable status logs processing");
 
+FLAG(bool,
+     aws_kinesis_aggregate_records,
+     false,
+     "Aggregate many log lines into each Kinesis record in the KPL format");
+
+namespace {
+
+/// The first bytes of a KPL aggregated record
+const std::string kKplMagic{"\xF3\x89\x9A\xC2"};
+
+/// The MD5 digest of the message ends the aggregated record
+const size_t kKplDigestSize{16};
+
+/// Protobuf keys of the AggregatedRecord and Record fields used
+const char kKplPartitionKeyTable{0x0A};
+const char kKplRecords{0x1A};
+const char kKplPartitionKeyIndex{0x08};
+const char kKplData{0x1A};
+
+size_t getVarintSize(size_t value) {
+  size_t size = 1;
+  for (; value >= 0x80; value >>= 7) {
+    ++size;
+  }
+  return size;
+}
+
+void appendVarint(std::string& output, size_t value) {
+  for (; value >= 0x80; value >>= 7) {
+    output += static_cast<char>((value & 0x7F) | 0x80);
+  }
+  output += static_cast<char>(value);
+}
+
+/// The size of a Record message, partition key index 0 and the data
+size_t getKplRecordSize(size_t line_size) {
+  return 2 + 1 + getVarintSize(line_size) + line_size;
+}
+
+} // namespace
+
+size_t getKinesisAggregatedLineBytes(size_t line_size) {
+  auto record_size = getKplRecordSize(line_size);
+  return 1 + getVarintSize(record_size) + record_size;
+}
+
+size_t getKinesisAggregatedRecordOverhead(size_t partition_key_size) {
+  return kKplMagic.size() + 1 + getVarintSize(partition_key_size) +
+         partition_key_size + kKplDigestSize;
+}
+
+std::string aggregateKinesisRecords(const std::string& partition_key,
+                                    const std::vector<std::string>& lines) {
+  std::string message;
+  message += kKplPartitionKeyTable;
+  appendVarint(message, partition_key.size());
+  message += partition_key;
+
+  for (const auto& line : lines) {
+    message += kKplRecords;
+    appendVarint(message, getKplRecordSize(line.size()));
+    message += kKplPartitionKeyIndex;
+    message += '\0';
+    message += kKplData;
+    appendVarint(message, line.size());
+    message += line;
+  }
+
+  auto digest = Aws::Utils::HashingUtils::CalculateMD5(
+      Aws::String(message.data(), message.size()));
+
+  std::string record = kKplMagic;
+  record += message;
+  record.append(reinterpret_cast<const char*>(digest.GetUnderlyingData()),
+                digest.GetLength());
+  return record;
+}
+
 Status KinesisLoggerPlugin::setUp() {
   initAwsSdk();
   forwarder_ = std::make_shared<KinesisLogForwarder>(
@@ -99,19 +178,19 @@ KinesisLogForwarder::Outcome KinesisLogForwarder::internalSend(
   return client_->PutRecords(request);
 }
 
-void KinesisLogForwarder::initializeRecord(
-    Record& record, Aws::Utils::ByteBuffer& buffer) const {
-  std::string record_partition_key;
+std::string KinesisLogForwarder::getPartitionKey() const {
   if (FLAGS_aws_kinesis_random_partition_key) {
     // Generate a random partition key for each record, ensuring that
     // records are spread evenly across shards.
     boost::uuids::uuid uuid = boost::uuids::random_generator()();
-    record_partition_key = boost::uuids::to_string(uuid);
-  } else {
-    record_partition_key = partition_key_;
+    return boost::uuids::to_string(uuid);
   }
+  return partition_key_;
+}
 
-  record.WithPartitionKey(record_partition_key).WithData(buffer);
+void KinesisLogForwarder::initializeRecord(
+    Record& record, Aws::Utils::ByteBuffer& buffer) const {
+  record.WithPartitionKey(getPartitionKey()).WithData(buffer);
 }
 
 size_t KinesisLogForwarder::getMaxBytesPerRecord() const {
@@ -139,6 +218,25 @@ bool KinesisLogForwarder::appendNewlineSeparators() const {
   return false;
 }
 
+bool KinesisLogForwarder::packRecords() const {
+  return FLAGS_aws_kinesis_aggregate_records;
+}
+
+size_t KinesisLogForwarder::getPackedRecordOverhead() const {
+  // Random partition keys are UUID strings.
+  return getKinesisAggregatedRecordOverhead(
+      std::max(partition_key_.size(), size_t{36}));
+}
+
+size_t KinesisLogForwarder::getPackedLineBytes(const std::string& line) const {
+  return getKinesisAggregatedLineBytes(line.size());
+}
+
+std::string KinesisLogForwarder::packRecord(
+    const std::vector<std::string>& lines) const {
+  return aggregateKinesisRecords(getPartitionKey(), lines);
+}
+
 size_t KinesisLogForwarder::getFailedRecordCount(Outcome& outcome) const {
   return static_cast<size_t>(outcome.GetResult().GetFailedRecordCount());
 }
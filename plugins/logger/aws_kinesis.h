@@ -26,6 +26,22 @@
 namespace osquery {
 DECLARE_uint64(aws_kinesis_period);
 
+/// The bytes a line of the given size adds to a KPL aggregated record
+size_t getKinesisAggregatedLineBytes(size_t line_size);
+
+/// The bytes of a KPL aggregated record besides its lines
+size_t getKinesisAggregatedRecordOverhead(size_t partition_key_size);
+
+/**
+ * @brief Encode lines as one record in the KPL aggregated record format
+ *
+ * The Kinesis Client Library and the Kinesis consumers of Firehose and Lambda
+ * split such a record back into one user record per line. Every line uses the
+ * given partition key.
+ */
+std::string aggregateKinesisRecords(const std::string& partition_key,
+                                    const std::vector<std::string>& lines);
+
 using IKinesisLogForwarder =
     AwsLogForwarder<Aws::Kinesis::Model::PutRecordsRequestEntry,
                     Aws::Kinesis::KinesisClient,
@@ -52,9 +68,18 @@ class KinesisLogForwarder final : public IKinesisLogForwarder {
   size_t getInitialRetryDelay() const override;
   bool appendNewlineSeparators() const override;
 
+  bool packRecords() const override;
+  size_t getPackedRecordOverhead() const override;
+  size_t getPackedLineBytes(const std::string& line) const override;
+  std::string packRecord(const std::vector<std::string>& lines) const override;
+
   size_t getFailedRecordCount(Outcome& outcome) const override;
   Result getResult(Outcome& outcome) const override;
 
+ private:
+  /// The partition key for a record, random if requested
+  std::string getPartitionKey() const;
+
  private:
   /// The partition key; ignored if aws_kinesis_random_partition_key is set
   std::string partition_key_;
@@ -11,6 +11,7 @@
 
 #include "plugins/logger/buffered.h"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <vector>
@@ -122,6 +123,33 @@ class AwsLogForwarder : public BufferedLogForwarder {
     Batch current_batch;
     size_t current_batch_byte_size = 0U;
 
+    auto add_record = [&](std::string& data) {
+      // Complete the current batch if it's full
+      if (current_batch_byte_size + data.size() >= getMaxBytesPerBatch() ||
+          (current_batch.size() >= getMaxRecordsPerBatch())) {
+        batch_list.push_back(current_batch);
+
+        current_batch.clear();
+        current_batch_byte_size = 0U;
+      }
+
+      // Initialize and store the new log record
+      auto buffer = Aws::Utils::ByteBuffer(
+          reinterpret_cast<unsigned char*>(&data[0]), data.size());
+
+      RecordType aws_record;
+      initializeRecord(aws_record, buffer);
+
+      current_batch.emplace_back(std::move(aws_record));
+      current_batch_byte_size += data.size();
+    };
+
+    // Lines waiting to be packed into the next record
+    std::vector<std::string> packed_lines;
+    size_t packed_byte_size = getPackedRecordOverhead();
+    auto max_record_bytes =
+        std::min(getMaxBytesPerRecord(), getMaxBytesPerBatch());
+
     for (auto& record : log_data) {
       // Initialize the line and make sure we are still within protocol limits
       Status status = appendLogTypeToJson(log_type, record);
@@ -135,39 +163,44 @@ class AwsLogForwarder : public BufferedLogForwarder {
         continue;
       }
 
-      size_t record_size = record.size();
-      if (appendNewlineSeparators()) {
-        ++record_size;
-      }
+      if (packRecords()) {
+        auto line_size = getPackedLineBytes(record);
+        if (getPackedRecordOverhead() + line_size >= max_record_bytes) {
+          discarded_records.push_back(std::move(record));
+          continue;
+        }
 
-      if (record_size >= getMaxBytesPerRecord() ||
-          record_size >= getMaxBytesPerBatch()) {
-        discarded_records.push_back(std::move(record));
-        continue;
-      }
+        if (packed_byte_size + line_size >= max_record_bytes) {
+          auto data = packRecord(packed_lines);
+          add_record(data);
 
-      // Complete the current batch if it's full
-      if (current_batch_byte_size + record_size >= getMaxBytesPerBatch() ||
-          (current_batch.size() >= getMaxRecordsPerBatch())) {
-        batch_list.push_back(current_batch);
+          packed_lines.clear();
+          packed_byte_size = getPackedRecordOverhead();
+        }
 
-        current_batch.clear();
-        current_batch_byte_size = 0U;
+        packed_lines.push_back(std::move(record));
+        packed_byte_size += line_size;
+        continue;
       }
 
-      // Initialize and store the new log record
-      auto buffer = Aws::Utils::ByteBuffer(
-          reinterpret_cast<unsigned char*>(&record[0]), record_size);
-
       if (appendNewlineSeparators()) {
-        buffer[record_size - 1] = '\n';
+        record.push_back('\n');
       }
 
-      RecordType aws_record;
-      initializeRecord(aws_record, buffer);
+      if (record.size() >= max_record_bytes) {
+        if (appendNewlineSeparators()) {
+          record.pop_back();
+        }
+        discarded_records.push_back(std::move(record));
+        continue;
+      }
 
-      current_batch.emplace_back(std::move(aws_record));
-      current_batch_byte_size += record_size;
+      add_record(record);
+    }
+
+    if (!packed_lines.empty()) {
+      auto data = packRecord(packed_lines);
+      add_record(data);
     }
 
     if (!current_batch.empty()) {
@@ -257,18 +290,8 @@ class AwsLogForwarder : public BufferedLogForwarder {
     return success;
   }
 
-  /// Sends the specified data in one or more batches, depending on the log size
-  Status send(std::vector<std::string>& log_data,
-              const std::string& log_type) override {
-    // Generate the batches, according to the protocol limits
-    std::vector<std::string> discarded_records;
-    auto batch_list =
-        consumeDataAndGenerateBatches(discarded_records, log_type, log_data);
-
-    dumpDiscardedRecordsToErrorLog(discarded_records);
-    discarded_records.clear();
-
-    // Send each batch
+  /// Sends each batch, returning the accumulated errors
+  Status sendBatchList(BatchList& batch_list, bool packed) {
     size_t error_count = 0;
     std::stringstream status_output;
 
@@ -277,7 +300,12 @@ class AwsLogForwarder : public BufferedLogForwarder {
       if (!sendBatch(batch, status_output)) {
         // We couldn't write some of the records; log them locally so that the
         // administrator will at least be able to inspect them
-        dumpBatchToErrorLog(batch);
+        if (packed) {
+          LOG(ERROR) << name_ << " logger: Failed to write " << batch.size()
+                     << " packed or compressed records";
+        } else {
+          dumpBatchToErrorLog(batch);
+        }
         error_count++;
       }
 
@@ -291,6 +319,95 @@ class AwsLogForwarder : public BufferedLogForwarder {
     return Status(0, "OK");
   }
 
+  /// Sends the specified data in one or more batches, depending on the log size
+  Status send(std::vector<std::string>& log_data,
+              const std::string& log_type) override {
+    // Generate the batches, according to the protocol limits
+    std::vector<std::string> discarded_records;
+    auto batch_list =
+        consumeDataAndGenerateBatches(discarded_records, log_type, log_data);
+
+    dumpDiscardedRecordsToErrorLog(discarded_records);
+    discarded_records.clear();
+
+    return sendBatchList(batch_list, packRecords());
+  }
+
+  /// Compressed batches hold newline-delimited records, one per AWS record
+  bool getCompressedFraming(const std::string& log_type,
+                            BufferedLogFraming& framing) override {
+    framing.delimiter = "\n";
+    if (appendNewlineSeparators()) {
+      framing.suffix = "\n";
+    }
+    framing.max_bytes = getMaxCompressedInputBytes();
+    return true;
+  }
+
+  /// Adds the log type and applies the record limits to a compressed line
+  bool prepareCompressedLine(std::string& line,
+                             const std::string& log_type) override {
+    Status status = appendLogTypeToJson(log_type, line);
+    if (!status.ok()) {
+      LOG(ERROR) << name_ << ": The following log record has been discarded "
+                             "because it was not in JSON format: "
+                 << line;
+      return false;
+    }
+
+    if (line.size() + 1 >= getMaxCompressedInputBytes()) {
+      dumpDiscardedRecordsToErrorLog({line});
+      return false;
+    }
+    return true;
+  }
+
+  /// Sends each compressed batch as a single record
+  Status sendCompressed(std::vector<std::string>& batches,
+                        const std::string& log_type) override {
+    BatchList batch_list;
+
+    Batch current_batch;
+    size_t current_batch_byte_size = 0U;
+
+    for (auto& data : batches) {
+      if (current_batch_byte_size + data.size() >= getMaxBytesPerBatch() ||
+          (current_batch.size() >= getMaxRecordsPerBatch())) {
+        batch_list.push_back(current_batch);
+
+        current_batch.clear();
+        current_batch_byte_size = 0U;
+      }
+
+      auto buffer = Aws::Utils::ByteBuffer(
+          reinterpret_cast<unsigned char*>(&data[0]), data.size());
+
+      RecordType aws_record;
+      initializeRecord(aws_record, buffer);
+
+      current_batch.emplace_back(std::move(aws_record));
+      current_batch_byte_size += data.size();
+    }
+
+    if (!current_batch.empty()) {
+      batch_list.push_back(current_batch);
+    }
+
+    batches.clear();
+    return sendBatchList(batch_list, true);
+  }
+
+  /**
+   * @brief The uncompressed bytes that always fit in one compressed record
+   *
+   * Incompressible input grows by less than 1/128th plus a small header with
+   * both gzip and zstd, so a batch of this size never exceeds the limits.
+   */
+  size_t getMaxCompressedInputBytes() const {
+    auto max_bytes = std::min(getMaxBytesPerRecord(), getMaxBytesPerBatch());
+    return max_bytes - max_bytes / 128 - 1024;
+  }
+
   /// Plugin-specific initialization is performed here
   virtual Status internalSetup() = 0;
 
@@ -319,6 +436,33 @@ class AwsLogForwarder : public BufferedLogForwarder {
   /// Must return true if records should be terminated with newlines
   virtual bool appendNewlineSeparators() const = 0;
 
+  /// Return true to pack several log lines into each record
+  virtual bool packRecords() const {
+    return false;
+  }
+
+  /// The bytes a packed record uses besides its lines
+  virtual size_t getPackedRecordOverhead() const {
+    return 0U;
+  }
+
+  /// The bytes a line uses in a packed record
+  virtual size_t getPackedLineBytes(const std::string& line) const {
+    return line.size() + (appendNewlineSeparators() ? 1U : 0U);
+  }
+
+  /// Packs lines into the data of one record, newline-delimited by default
+  virtual std::string packRecord(const std::vector<std::string>& lines) const {
+    std::string data;
+    for (const auto& line : lines) {
+      data += line;
+      if (appendNewlineSeparators()) {
+        data += '\n';
+      }
+    }
+    return data;
+  }
+
   /// Must return the amount of records that could not be sent
   virtual size_t getFailedRecordCount(Outcome& outcome) const = 0;
 
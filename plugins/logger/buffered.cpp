@@ -11,16 +11,23 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <iterator>
 #include <thread>
 
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <zlib.h>
+#include <zstd.h>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/remote/backoff.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/system/time.h>
@@ -35,10 +42,212 @@ FLAG(uint64,
      1000000,
      "Maximum number of logs in buffered output plugins (0 = unlimited)");
 
+FLAG(string,
+     buffered_log_compression,
+     "",
+     "Compress buffered output plugin batches: gzip, zstd (default none)");
+
 const std::chrono::seconds BufferedLogForwarder::kLogPeriod{
     std::chrono::seconds(4)};
 const uint64_t BufferedLogForwarder::kMaxLogLines{1024};
 
+namespace {
+
+/// Window bits for a deflate stream with a gzip header and trailer.
+const int kGzipWindowBits{15 + 16};
+
+/// Favor throughput, log batches are compressed on every check.
+const int kZstdLevel{3};
+
+/// The digits an index's incrementing count is padded to.
+const size_t kIndexWidth{10};
+
+/// The lines, or compressed batches, of a single log type read by a check.
+struct PendingLogs {
+  explicit PendingLogs(const std::string& t) : type(t) {}
+
+  /// The log type provided to a send.
+  std::string type;
+
+  /// Uncompressed lines, used when the forwarder does not compress.
+  std::vector<std::string> lines;
+
+  /// Completed compressed batches.
+  std::vector<std::string> batches;
+
+  /// The compressor of the current batch.
+  std::unique_ptr<BufferedLogCompressor> compressor;
+
+  /// The forwarder's framing of compressed lines.
+  BufferedLogFraming framing;
+
+  /// The number of lines in the current compressed batch.
+  size_t count{0};
+
+  /// The first compression error, the batches are not sent.
+  Status status;
+
+  /// The first and last index read, inclusive.
+  std::string low;
+  std::string high;
+
+  /// The number of indexes read.
+  size_t indexes{0};
+};
+
+} // namespace
+
+Status parseBufferedLogCodec(const std::string& name, BufferedLogCodec& codec) {
+  if (name.empty()) {
+    codec = BufferedLogCodec::None;
+  } else if (name == "gzip") {
+    codec = BufferedLogCodec::Gzip;
+  } else if (name == "zstd") {
+    codec = BufferedLogCodec::Zstd;
+  } else {
+    return Status::failure("Unknown buffered log compression: " + name);
+  }
+  return Status::success();
+}
+
+std::string getBufferedLogContentEncoding(BufferedLogCodec codec) {
+  switch (codec) {
+  case BufferedLogCodec::Gzip:
+    return "gzip";
+  case BufferedLogCodec::Zstd:
+    return "zstd";
+  default:
+    return "";
+  }
+}
+
+struct BufferedLogCompressor::Stream {
+  BufferedLogCodec codec{BufferedLogCodec::None};
+
+  /// The deflate stream, when using gzip.
+  z_stream zs;
+
+  /// The zstd stream, when using zstd.
+  ZSTD_CStream* zstd{nullptr};
+
+  /// A scratch buffer for compressed output.
+  std::vector<char> buffer;
+
+  /// True if the codec's stream was initialized.
+  bool ready{false};
+};
+
+BufferedLogCompressor::BufferedLogCompressor(BufferedLogCodec codec)
+    : stream_(std::make_unique<Stream>()) {
+  stream_->codec = codec;
+  if (codec == BufferedLogCodec::Gzip) {
+    memset(&stream_->zs, 0, sizeof(stream_->zs));
+    stream_->ready = (deflateInit2(&stream_->zs,
+                                   Z_DEFAULT_COMPRESSION,
+                                   Z_DEFLATED,
+                                   kGzipWindowBits,
+                                   8,
+                                   Z_DEFAULT_STRATEGY) == Z_OK);
+    stream_->buffer.resize(16384);
+  } else if (codec == BufferedLogCodec::Zstd) {
+    stream_->zstd = ZSTD_createCStream();
+    stream_->ready = stream_->zstd != nullptr &&
+                     !ZSTD_isError(ZSTD_initCStream(stream_->zstd, kZstdLevel));
+    stream_->buffer.resize(ZSTD_CStreamOutSize());
+  }
+}
+
+BufferedLogCompressor::~BufferedLogCompressor() {
+  if (stream_->codec == BufferedLogCodec::Gzip && stream_->ready) {
+    deflateEnd(&stream_->zs);
+  } else if (stream_->zstd != nullptr) {
+    ZSTD_freeCStream(stream_->zstd);
+  }
+}
+
+Status BufferedLogCompressor::append(const std::string& data) {
+  if (!stream_->ready) {
+    return Status::failure("Could not initialize compression stream");
+  }
+
+  auto& buffer = stream_->buffer;
+  if (stream_->codec == BufferedLogCodec::Gzip) {
+    auto& zs = stream_->zs;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    do {
+      zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+      zs.avail_out = static_cast<uInt>(buffer.size());
+      if (deflate(&zs, Z_NO_FLUSH) == Z_STREAM_ERROR) {
+        return Status::failure("Could not compress buffered logs");
+      }
+      output_.append(buffer.data(), buffer.size() - zs.avail_out);
+    } while (zs.avail_out == 0);
+  } else {
+    ZSTD_inBuffer input = {data.data(), data.size(), 0};
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = {buffer.data(), buffer.size(), 0};
+      auto result = ZSTD_compressStream(stream_->zstd, &output, &input);
+      if (ZSTD_isError(result)) {
+        return Status::failure(
+            std::string("Could not compress buffered logs: ") +
+            ZSTD_getErrorName(result));
+      }
+      output_.append(buffer.data(), output.pos);
+    }
+  }
+
+  size_ += data.size();
+  return Status::success();
+}
+
+Status BufferedLogCompressor::finish(std::string& output) {
+  if (!stream_->ready) {
+    return Status::failure("Could not initialize compression stream");
+  }
+
+  auto& buffer = stream_->buffer;
+  if (stream_->codec == BufferedLogCodec::Gzip) {
+    auto& zs = stream_->zs;
+    zs.avail_in = 0;
+    int ret = Z_OK;
+    do {
+      zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+      zs.avail_out = static_cast<uInt>(buffer.size());
+      ret = deflate(&zs, Z_FINISH);
+      if (ret == Z_STREAM_ERROR) {
+        break;
+      }
+      output_.append(buffer.data(), buffer.size() - zs.avail_out);
+    } while (ret != Z_STREAM_END);
+
+    deflateReset(&zs);
+    if (ret != Z_STREAM_END) {
+      output_.clear();
+      size_ = 0;
+      return Status::failure("Could not complete compressed buffered logs");
+    }
+  } else {
+    size_t remaining = 0;
+    do {
+      ZSTD_outBuffer out = {buffer.data(), buffer.size(), 0};
+      remaining = ZSTD_endStream(stream_->zstd, &out);
+      if (ZSTD_isError(remaining)) {
+        ZSTD_initCStream(stream_->zstd, kZstdLevel);
+        output_.clear();
+        size_ = 0;
+        return Status::failure("Could not complete compressed buffered logs");
+      }
+      output_.append(buffer.data(), out.pos);
+    } while (remaining != 0);
+  }
+
+  output = std::move(output_);
+  output_.clear();
+  size_ = 0;
+  return Status::success();
+}
+
 Status BufferedLogForwarder::setUp() {
   // initialize buffer_count_ by scanning the DB
   std::vector<std::string> indexes;
@@ -48,135 +257,387 @@ Status BufferedLogForwarder::setUp() {
     return Status(1, "Error scanning for buffered log count");
   }
 
-  RecursiveLock lock(count_mutex_);
-  buffer_count_ = indexes.size();
+  {
+    RecursiveLock lock(count_mutex_);
+    buffer_count_ = indexes.size();
+  }
+
+  // New indexes must sort after those buffered by a previous process.
+  {
+    WriteLock lock(write_mutex_);
+    size_t time_offset = genIndexPrefix(true).size();
+    for (const auto& index : indexes) {
+      if (index.size() <= time_offset) {
+        continue;
+      }
+
+      auto time = tryTo<std::uint64_t>(index.substr(
+          time_offset, index.find('_', time_offset) - time_offset));
+      if (time.isValue() && time.get() >= last_time_) {
+        last_time_ = time.get() + 1;
+      }
+    }
+  }
+
+  status = parseBufferedLogCodec(FLAGS_buffered_log_compression, codec_);
+  if (!status.ok()) {
+    LOG(WARNING) << status.getMessage() << ", sending uncompressed logs";
+  }
   return Status(0);
 }
 
-void BufferedLogForwarder::check() {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+BufferedLogForwarder::~BufferedLogForwarder() {
+  stopFlights();
+}
 
-  // For each index, accumulate the log line into the result or status set.
-  std::vector<std::string> results, statuses;
-  iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.emplace_back(std::move(value));
-            }
-          }));
+void BufferedLogForwarder::stop() {
+  stopFlights();
+}
 
-  // If any results/statuses were found in the flushed buffer, send.
-  if (results.size() > 0) {
-    status = send(results, "result");
+void BufferedLogForwarder::check() {
+  // Get all the buffered log items, with a max of 1024 lines per in-flight
+  // batch, in one pass.
+  auto lines = batchLines();
+  size_t flights = (lines > 0) ? std::max<size_t>(max_inflight_, 1) : 1;
+  DatabaseStringValueList logs;
+  {
+    WriteLock lock(write_mutex_);
+    auto status = scanDatabaseValues(
+        kLogs, logs, index_name_ + '_', lines * flights);
     if (!status.ok()) {
-      VLOG(1) << "Error sending results to logger: " << status.getMessage();
-    } else {
-      // Clear the results logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isResultIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+      VLOG(1) << "Error scanning buffered logs: " << status.getMessage();
     }
   }
 
-  if (statuses.size() > 0) {
-    status = send(statuses, "status");
-    if (!status.ok()) {
-      VLOG(1) << "Error sending status to logger: " << status.getMessage();
+  bool full = lines > 0 && logs.size() >= lines * flights;
+  bool scanned = !logs.empty();
+  auto send_start = std::chrono::steady_clock::now();
+  bool sent = true;
+  if (flights == 1 || logs.size() <= lines) {
+    sent = sendLogs(logs);
+  } else {
+    // Split the scan into contiguous batches, each is its own index range.
+    std::vector<DatabaseStringValueList> batches;
+    for (size_t offset = 0; offset < logs.size(); offset += lines) {
+      auto end = std::min<size_t>(logs.size(), offset + lines);
+      batches.emplace_back(std::make_move_iterator(logs.begin() + offset),
+                           std::make_move_iterator(logs.begin() + end));
+    }
+    DatabaseStringValueList().swap(logs);
+
+    bool queued = false;
+    {
+      std::lock_guard<std::mutex> lock(flight_mutex_);
+      if (!flight_stop_) {
+        while (flight_workers_.size() + 1 < flights) {
+          flight_workers_.emplace_back(&BufferedLogForwarder::flight, this);
+        }
+
+        for (size_t i = 1; i < batches.size(); i++) {
+          flight_queue_.push_back(&batches[i]);
+        }
+        flight_pending_ = batches.size() - 1;
+        flight_failed_ = 0;
+        queued = true;
+      }
+    }
+
+    if (queued) {
+      flight_queued_.notify_all();
+      sent = sendLogs(batches[0]);
+
+      std::unique_lock<std::mutex> lock(flight_mutex_);
+      flight_done_.wait(lock, [this]() { return flight_pending_ == 0; });
+      sent = sent && flight_failed_ == 0;
     } else {
-      // Clear the status logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isStatusIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+      for (auto& batch : batches) {
+        sent = sendLogs(batch) && sent;
+      }
     }
   }
 
+  // A full and acknowledged scan means the buffer may still be backlogged.
+  backlogged_ = flights > 1 && full && sent;
+
+  if (scanned) {
+    adaptBatchLines(sent, std::chrono::steady_clock::now() - send_start);
+  }
+
   // Purge any logs exceeding the max after our send attempt
   if (FLAGS_buffered_log_max > 0) {
     purge();
   }
 }
 
+uint64_t BufferedLogForwarder::batchLines() {
+  if (!adaptive_batches_ || max_log_lines_ == 0) {
+    return max_log_lines_;
+  }
+  if (batch_lines_ == 0 || batch_lines_ > max_log_lines_) {
+    batch_lines_ = max_log_lines_;
+  }
+  return batch_lines_;
+}
+
+void BufferedLogForwarder::adaptBatchLines(
+    bool sent, std::chrono::steady_clock::duration elapsed) {
+  if (!adaptive_batches_ || max_log_lines_ == 0) {
+    return;
+  }
+
+  // Back off quickly from a struggling remote, recover gradually.
+  bool slow = log_period_.count() > 0 && elapsed > log_period_;
+  if (!sent || slow) {
+    batch_lines_ = std::max<uint64_t>(batch_lines_ / 2, 1);
+  } else {
+    batch_lines_ = std::min<uint64_t>(
+        max_log_lines_,
+        batch_lines_ + std::max<uint64_t>(max_log_lines_ / 4, 1));
+  }
+}
+
+void BufferedLogForwarder::flight() {
+  std::unique_lock<std::mutex> lock(flight_mutex_);
+  while (true) {
+    flight_queued_.wait(
+        lock, [this]() { return flight_stop_ || !flight_queue_.empty(); });
+    if (flight_queue_.empty()) {
+      // Queued batches are always sent before a worker exits.
+      return;
+    }
+
+    auto logs = flight_queue_.front();
+    flight_queue_.pop_front();
+    lock.unlock();
+    bool sent = sendLogs(*logs);
+    lock.lock();
+
+    if (!sent) {
+      flight_failed_++;
+    }
+    if (--flight_pending_ == 0) {
+      flight_done_.notify_all();
+    }
+  }
+}
+
+void BufferedLogForwarder::stopFlights() {
+  {
+    std::lock_guard<std::mutex> lock(flight_mutex_);
+    flight_stop_ = true;
+  }
+  flight_queued_.notify_all();
+
+  for (auto& worker : flight_workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+bool BufferedLogForwarder::sendLogs(DatabaseStringValueList& logs) {
+  PendingLogs results("result"), statuses("status");
+  if (codec_ != BufferedLogCodec::None) {
+    for (auto* pending : {&results, &statuses}) {
+      if (getCompressedFraming(pending->type, pending->framing)) {
+        pending->compressor = std::make_unique<BufferedLogCompressor>(codec_);
+      }
+    }
+  }
+
+  auto finish_batch = [](PendingLogs& pending) {
+    auto& compressor = *pending.compressor;
+    pending.status = compressor.append(pending.framing.suffix);
+    if (pending.status.ok()) {
+      std::string batch;
+      pending.status = compressor.finish(batch);
+      pending.batches.push_back(std::move(batch));
+    }
+    pending.count = 0;
+  };
+
+  auto compress_line = [this, &finish_batch](PendingLogs& pending,
+                                             std::string& line) {
+    if (!pending.status.ok() || !prepareCompressedLine(line, pending.type)) {
+      return;
+    }
+
+    // Start a new batch if this line would overflow the forwarder's limit.
+    const auto& framing = pending.framing;
+    auto& compressor = *pending.compressor;
+    if (pending.count > 0 && framing.max_bytes > 0 &&
+        compressor.size() + framing.delimiter.size() + line.size() +
+                framing.suffix.size() >
+            framing.max_bytes) {
+      finish_batch(pending);
+      if (!pending.status.ok()) {
+        return;
+      }
+    }
+
+    pending.status = compressor.append(
+        (pending.count == 0) ? framing.prefix : framing.delimiter);
+    if (pending.status.ok()) {
+      pending.status = compressor.append(line);
+      pending.count++;
+    }
+  };
+
+  // For each index, accumulate the log line into the result or status set.
+  // Indexes of each type are adjacent, so each set is an index range.
+  iterate(logs,
+          ([&results, &statuses, &compress_line, this](
+               std::pair<std::string, std::string>& log) {
+            auto& target = isResultIndex(log.first) ? results : statuses;
+            if (target.indexes == 0) {
+              target.low = log.first;
+            }
+            target.high = std::move(log.first);
+            target.indexes++;
+
+            if (target.compressor == nullptr) {
+              target.lines.emplace_back(std::move(log.second));
+            } else {
+              compress_line(target, log.second);
+            }
+          }));
+  DatabaseStringValueList().swap(logs);
+
+  auto send_pending = [&finish_batch, this](PendingLogs& pending,
+                                            bool result_index) {
+    if (pending.indexes == 0) {
+      return true;
+    }
+
+    Status status;
+    if (pending.compressor == nullptr) {
+      status = send(pending.lines, pending.type);
+    } else {
+      if (pending.count > 0) {
+        finish_batch(pending);
+      }
+
+      status = pending.status;
+      if (status.ok() && !pending.batches.empty()) {
+        status = sendCompressed(pending.batches, pending.type);
+      }
+    }
+
+    if (!status.ok()) {
+      VLOG(1) << "Error sending " << (result_index ? "results" : "status")
+              << " to logger: " << status.getMessage();
+      return false;
+    }
+
+    // Clear the logs of this type once they were sent.
+    status = deleteRangeWithCount(
+        kLogs, pending.low, pending.high, pending.indexes);
+    if (!status.ok()) {
+      LOG(ERROR) << "Error deleting sent buffered logs: "
+                 << status.getMessage();
+    }
+    return true;
+  };
+
+  // If any results/statuses were found in the flushed buffer, send.
+  bool sent = send_pending(results, true);
+  return send_pending(statuses, false) && sent;
+}
+
 void BufferedLogForwarder::purge() {
-  RecursiveLock lock(count_mutex_);
-  if (buffer_count_ <= FLAGS_buffered_log_max) {
+  // The count is not held while scanning, writers lock it after write_mutex_.
+  unsigned long long int buffer_count = 0;
+  {
+    RecursiveLock lock(count_mutex_);
+    buffer_count = buffer_count_;
+  }
+
+  if (buffer_count <= FLAGS_buffered_log_max) {
     return;
   }
 
-  unsigned long long int purge_count = buffer_count_ - FLAGS_buffered_log_max;
+  unsigned long long int purge_count = buffer_count - FLAGS_buffered_log_max;
 
   // Collect purge_count indexes of each type (result/status) before
   // partitioning to find the oldest. Note this assumes that the indexes are
   // returned in ascending lexicographic order (true for RocksDB).
-  std::vector<std::string> indexes;
-  auto status =
-      scanDatabaseKeys(kLogs, indexes, genIndexPrefix(true), purge_count);
-  if (!status.ok()) {
-    LOG(ERROR) << "Error scanning DB during buffered log purge";
-    return;
-  }
-
-  LOG(WARNING) << "Purging buffered logs limit (" << FLAGS_buffered_log_max
-               << ") exceeded: " << buffer_count_;
+  std::vector<std::string> indexes, status_indexes;
+  {
+    WriteLock write_lock(write_mutex_);
+    auto status =
+        scanDatabaseKeys(kLogs, indexes, genIndexPrefix(true), purge_count);
+    if (!status.ok()) {
+      LOG(ERROR) << "Error scanning DB during buffered log purge";
+      return;
+    }
 
-  std::vector<std::string> status_indexes;
-  status = scanDatabaseKeys(
-      kLogs, status_indexes, genIndexPrefix(false), purge_count);
-  if (!status.ok()) {
-    LOG(ERROR) << "Error scanning DB during buffered log purge";
-    return;
+    status = scanDatabaseKeys(
+        kLogs, status_indexes, genIndexPrefix(false), purge_count);
+    if (!status.ok()) {
+      LOG(ERROR) << "Error scanning DB during buffered log purge";
+      return;
+    }
   }
 
-  indexes.insert(indexes.end(), status_indexes.begin(), status_indexes.end());
+  LOG(WARNING) << "Purging buffered logs limit (" << FLAGS_buffered_log_max
+               << ") exceeded: " << buffer_count;
 
-  if (indexes.size() < purge_count) {
+  if (indexes.size() + status_indexes.size() < purge_count) {
     LOG(ERROR) << "Trying to purge " << purge_count << " logs but only found "
-               << indexes.size();
+               << indexes.size() + status_indexes.size();
     return;
   }
 
+  // Both sets are ascending, merge them to find the oldest purge_count
+  // indexes. Skip the prefix when doing comparisons.
   size_t prefix_size = genIndexPrefix(true).size();
-  // Partition the indexes so that the first purge_count elements are the
-  // oldest indexes (the ones to be purged)
-  std::nth_element(indexes.begin(),
-                   indexes.begin() + (unsigned int)purge_count - 1,
-                   indexes.end(),
-                   [&](const std::string& a, const std::string& b) {
-                     // Skip the prefix when doing comparisons
-                     return a.compare(prefix_size,
-                                      std::string::npos,
-                                      b,
-                                      prefix_size,
-                                      std::string::npos) < 0;
-                   });
-  indexes.erase(indexes.begin() + (unsigned int)purge_count, indexes.end());
-
-  // Now only indexes of logs to be deleted remain
-  iterate(indexes, [this](const std::string& index) {
-    if (!deleteValueWithCount(kLogs, index).ok()) {
-      LOG(ERROR) << "Error deleting value during buffered log purge";
+  size_t results = 0;
+  size_t statuses = 0;
+  while (results + statuses < purge_count) {
+    if (statuses == status_indexes.size() ||
+        (results < indexes.size() &&
+         indexes[results].compare(prefix_size,
+                                  std::string::npos,
+                                  status_indexes[statuses],
+                                  prefix_size,
+                                  std::string::npos) < 0)) {
+      results++;
+    } else {
+      statuses++;
     }
-  });
+  }
+
+  // The oldest indexes of each type are a range starting at the first.
+  if (results > 0 &&
+      !deleteRangeWithCount(kLogs, indexes[0], indexes[results - 1], results)
+           .ok()) {
+    LOG(ERROR) << "Error deleting values during buffered log purge";
+  }
+
+  if (statuses > 0 && !deleteRangeWithCount(kLogs,
+                                            status_indexes[0],
+                                            status_indexes[statuses - 1],
+                                            statuses)
+                           .ok()) {
+    LOG(ERROR) << "Error deleting values during buffered log purge";
+  }
 }
 
 void BufferedLogForwarder::start() {
   while (!interrupted()) {
     check();
 
-    // Cool off and time wait the configured period.
-    pause(std::chrono::milliseconds(log_period_));
+    // Cool off and time wait the jittered period, unless catching up.
+    if (!backlogged_) {
+      pause(std::chrono::milliseconds(RemoteBackoff::get().jitter(
+          std::chrono::duration_cast<std::chrono::milliseconds>(log_period_)
+              .count())));
+    }
   }
 }
 
 Status BufferedLogForwarder::logString(const std::string& s, uint64_t time) {
+  WriteLock lock(write_mutex_);
   std::string index = genResultIndex(time);
   return addValueWithCount(kLogs, index, s);
 }
@@ -186,12 +647,12 @@ Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
   // Append decorations to status
   // Assemble a decorations tree to append to each status buffer line.
   pt::ptree dtree;
-  std::map<std::string, std::string> decorations;
-  getDecorations(decorations);
-  for (const auto& decoration : decorations) {
+  auto decorations = getDecorations();
+  for (const auto& decoration : *decorations) {
     dtree.put(decoration.first, decoration.second);
   }
 
+  DatabaseStringValueList lines;
   for (const auto& item : log) {
     // Convert the StatusLogLine into ptree format, to convert to JSON.
     pt::ptree buffer;
@@ -218,19 +679,18 @@ Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
       return Status(1, e.what());
     }
 
-    // Store the status line in a backing store.
     if (!json.empty()) {
       json.pop_back();
     }
-    std::string index = genStatusIndex(time);
-    Status status = addValueWithCount(kLogs, index, json);
-    if (!status.ok()) {
-      // Do not continue if any line fails.
-      return status;
-    }
+    lines.push_back(std::make_pair(std::string(), std::move(json)));
   }
 
-  return Status(0);
+  // Store every status line in the backing store with a single write.
+  WriteLock lock(write_mutex_);
+  for (auto& line : lines) {
+    line.first = genStatusIndex(time);
+  }
+  return addValuesWithCount(kLogs, lines);
 }
 
 bool BufferedLogForwarder::isIndex(const std::string& index, bool results) {
@@ -260,10 +720,16 @@ std::string BufferedLogForwarder::genIndexPrefix(bool results) {
 
 std::string BufferedLogForwarder::genIndex(bool results, uint64_t time) {
   if (time == 0) {
-    time = getUnixTime();
+    time = std::max(getUnixTime(), last_time_);
+    last_time_ = time;
+  }
+
+  // Pad the incrementing index so indexes sort in the order they are written.
+  auto index = std::to_string(++log_index_);
+  if (index.size() < kIndexWidth) {
+    index.insert(0, kIndexWidth - index.size(), '0');
   }
-  return genIndexPrefix(results) + std::to_string(time) + '_' +
-         std::to_string(++log_index_);
+  return genIndexPrefix(results) + std::to_string(time) + '_' + index;
 }
 
 Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
@@ -277,14 +743,28 @@ Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
   return status;
 }
 
-Status BufferedLogForwarder::deleteValueWithCount(const std::string& domain,
-                                                  const std::string& key) {
-  Status status = deleteDatabaseValue(domain, key);
+Status BufferedLogForwarder::addValuesWithCount(
+    const std::string& domain, const DatabaseStringValueList& values) {
+  if (values.empty()) {
+    return Status::success();
+  }
+
+  Status status = setDatabaseBatch(domain, values);
   if (status.ok()) {
     RecursiveLock lock(count_mutex_);
-    if (buffer_count_ > 0) {
-      buffer_count_--;
-    }
+    buffer_count_ += values.size();
+  }
+  return status;
+}
+
+Status BufferedLogForwarder::deleteRangeWithCount(const std::string& domain,
+                                                  const std::string& low,
+                                                  const std::string& high,
+                                                  size_t count) {
+  Status status = deleteDatabaseRange(domain, low, high);
+  if (status.ok()) {
+    RecursiveLock lock(count_mutex_);
+    buffer_count_ = (buffer_count_ > count) ? buffer_count_ - count : 0;
   }
   return status;
 }
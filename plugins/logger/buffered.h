@@ -10,14 +10,21 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <boost/noncopyable.hpp>
+
 #include <osquery/core/plugins/logger.h>
+#include <osquery/database/database.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -37,6 +44,83 @@ inline void iterate(std::vector<std::string>& input,
   }
 }
 
+/// Iterate through buffered key/value pairs, yielding during high utilization
+inline void iterate(
+    DatabaseStringValueList& input,
+    std::function<void(std::pair<std::string, std::string>&)> predicate) {
+  size_t count = 0;
+  for (auto& item : input) {
+    predicate(item);
+    if (++count % 100 == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+}
+
+/// Codecs available to compress buffered log batches.
+enum class BufferedLogCodec {
+  None,
+  Gzip,
+  Zstd,
+};
+
+/// Parse a buffered_log_compression value, an empty name is no compression.
+Status parseBufferedLogCodec(const std::string& name, BufferedLogCodec& codec);
+
+/// The HTTP Content-Encoding name of a codec.
+std::string getBufferedLogContentEncoding(BufferedLogCodec codec);
+
+/**
+ * @brief A streaming compressor for buffered log batches.
+ *
+ * Log lines are appended as they are read from the backing store, so a batch
+ * is never held uncompressed in its entirety. Calling finish() completes the
+ * compressed stream and resets the compressor for the next batch.
+ */
+class BufferedLogCompressor : private boost::noncopyable {
+ public:
+  explicit BufferedLogCompressor(BufferedLogCodec codec);
+  ~BufferedLogCompressor();
+
+  /// Compress and append data to the current stream.
+  Status append(const std::string& data);
+
+  /// Complete the current stream and move it into output.
+  Status finish(std::string& output);
+
+  /// The number of uncompressed bytes appended since the last finish.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  struct Stream;
+
+  /// The codec-specific stream state.
+  std::unique_ptr<Stream> stream_;
+
+  /// The compressed output of the current stream.
+  std::string output_;
+
+  /// Uncompressed bytes appended to the current stream.
+  size_t size_{0};
+};
+
+/// How a forwarder frames log lines within a compressed batch.
+struct BufferedLogFraming {
+  /// Written before the first line of each batch.
+  std::string prefix;
+
+  /// Written between each line.
+  std::string delimiter;
+
+  /// Written after the last line of each batch.
+  std::string suffix;
+
+  /// The maximum uncompressed bytes in a batch, 0 for unlimited.
+  size_t max_bytes{0};
+};
+
 /**
  * @brief A log forwarder thread flushing database-buffered logs.
  *
@@ -86,9 +170,14 @@ class BufferedLogForwarder : public InternalRunnable {
         index_name_(name) {}
 
  public:
+  ~BufferedLogForwarder() override;
+
   /// A simple wait lock, and flush based on settings.
   void start() override;
 
+  /// Stop any workers sending in-flight batches.
+  void stop() override;
+
   /**
    * @brief Set up the forwarder. May be used to init remote clients, etc.
    *
@@ -130,12 +219,49 @@ class BufferedLogForwarder : public InternalRunnable {
   virtual Status send(std::vector<std::string>& log_data,
                       const std::string& log_type) = 0;
 
+  /**
+   * @brief Describe how lines of a log type are framed when compressed.
+   *
+   * Forwarders supporting buffered_log_compression return true. Otherwise,
+   * and by default, lines are provided uncompressed to send().
+   */
+  virtual bool getCompressedFraming(const std::string& log_type,
+                                    BufferedLogFraming& framing) {
+    return false;
+  }
+
+  /**
+   * @brief Validate, and optionally rewrite, a line before it is compressed.
+   *
+   * Lines that are rejected are dropped once the batch has been sent.
+   */
+  virtual bool prepareCompressedLine(std::string& line,
+                                     const std::string& log_type) {
+    return true;
+  }
+
+  /**
+   * @brief Send compressed batches of a log type.
+   *
+   * Each batch is a complete compressed stream of framed lines.
+   */
+  virtual Status sendCompressed(std::vector<std::string>& batches,
+                                const std::string& log_type) {
+    return Status::failure("Compressed batches are not supported");
+  }
+
   /**
    * @brief Check for new logs and send.
    *
-   * Scan the logs domain for up to max_log_lines_ log lines.
-   * Sort those lines into status and request types then forward (send) each
-   * set. On success, clear the data and indexes. Calls purge upon completion.
+   * Scan the logs domain for up to max_log_lines_ log lines, reading keys and
+   * values in a single pass. Sort those lines into status and request types
+   * then forward (send) each set. When compression is enabled, and supported
+   * by the forwarder, lines are compressed as they are read. On success,
+   * remove the sent range of indexes. Calls purge upon completion.
+   *
+   * When max_inflight_ is above 1, up to that many batches of max_log_lines_
+   * are read and sent concurrently. Each batch is removed only once it is
+   * acknowledged. Adaptive batches may hold fewer lines.
    */
   void check();
 
@@ -167,6 +293,25 @@ class BufferedLogForwarder : public InternalRunnable {
   std::string genStatusIndex(uint64_t time = 0);
 
  private:
+  /**
+   * @brief Send one batch of buffered logs and remove the sent indexes
+   *
+   * @return true if every log type in the batch was sent.
+   */
+  bool sendLogs(DatabaseStringValueList& logs);
+
+  /// Worker loop sending queued in-flight batches.
+  void flight();
+
+  /// The lines of each batch of the next check.
+  uint64_t batchLines();
+
+  /// Shrink or grow adaptive batches from the outcome of a check.
+  void adaptBatchLines(bool sent, std::chrono::steady_clock::duration elapsed);
+
+  /// Stop and join the in-flight workers.
+  void stopFlights();
+
   std::string genIndexPrefix(bool results);
 
   std::string genIndex(bool results, uint64_t time = 0);
@@ -180,11 +325,20 @@ class BufferedLogForwarder : public InternalRunnable {
                            const std::string& value);
 
   /**
-   * @brief Delete a database value while maintaining count
+   * @brief Add several database values with a single write, maintaining count
    *
    */
-  Status deleteValueWithCount(const std::string& domain,
-                              const std::string& key);
+  Status addValuesWithCount(const std::string& domain,
+                            const DatabaseStringValueList& values);
+
+  /**
+   * @brief Delete an inclusive range of database values holding count values
+   *
+   */
+  Status deleteRangeWithCount(const std::string& domain,
+                              const std::string& low,
+                              const std::string& high,
+                              size_t count);
 
  protected:
   /// Seconds between flushing logs
@@ -193,6 +347,26 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Max number of logs to flush per check
   uint64_t max_log_lines_;
 
+  /// Codec used to compress batches, from buffered_log_compression
+  BufferedLogCodec codec_{BufferedLogCodec::None};
+
+  /**
+   * @brief Max number of batches sent concurrently per check
+   *
+   * Subclasses with a thread safe send() may raise this. Concurrent batches
+   * are sent from long-lived workers so each may reuse its connection.
+   */
+  size_t max_inflight_{1};
+
+  /**
+   * @brief Adapt the lines of each batch to the remote
+   *
+   * Subclasses sending to a shared remote may enable this. Batches halve
+   * while sends fail or outlast the period, and grow back toward
+   * max_log_lines_ while sends succeed within it.
+   */
+  bool adaptive_batches_{false};
+
   /**
    * @brief Name to use in index
    *
@@ -206,6 +380,47 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Hold an incrementing index for buffering logs
   std::atomic<size_t> log_index_{0};
 
+  /**
+   * @brief Serializes generating and writing indexes with scans
+   *
+   * Indexes are written in ascending order, so every index written after a
+   * scan sorts after the scanned ones and a sent range can be removed whole.
+   */
+  Mutex write_mutex_;
+
+  /// The latest time used in an index, the clock may step backwards
+  uint64_t last_time_{0};
+
+  /// True if the last check sent a full scan, more logs are likely buffered
+  bool backlogged_{false};
+
+  /// The lines of each adaptive batch, 0 until the first check
+  uint64_t batch_lines_{0};
+
+  /// Workers sending in-flight batches beyond the first
+  std::vector<std::thread> flight_workers_;
+
+  /// Batches waiting for a worker
+  std::deque<DatabaseStringValueList*> flight_queue_;
+
+  /// Batches queued or being sent by workers
+  size_t flight_pending_{0};
+
+  /// Batches sent by workers that were not acknowledged
+  size_t flight_failed_{0};
+
+  /// Set when workers should exit
+  bool flight_stop_{false};
+
+  /// Protects the in-flight queue and counters
+  std::mutex flight_mutex_;
+
+  /// Signals workers that a batch is queued, or to stop
+  std::condition_variable flight_queued_;
+
+  /// Signals check() that all queued batches completed
+  std::condition_variable flight_done_;
+
   /// Stores the count of buffered logs
   unsigned long long int buffer_count_{0};
 
@@ -9,7 +9,16 @@
 
 #include "filesystem_logger.h"
 
+#include <algorithm>
 #include <exception>
+#include <utility>
+
+#ifdef WIN32
+#include <osquery/utils/conversions/windows/strings.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
@@ -34,37 +43,397 @@ FLAG_ALIAS(std::string, osquery_log_dir, logger_path);
 
 FLAG(int32, logger_mode, 0640, "Decimal mode for log files (default '0640')");
 
+FLAG(uint64,
+     logger_flush_size,
+     0,
+     "Buffer up to this many bytes of results before writing (default 0)");
+
+FLAG(uint64,
+     logger_flush_interval,
+     3,
+     "Seconds buffered results may wait before they are written");
+
+FLAG(bool,
+     logger_fsync,
+     false,
+     "Sync results and snapshots logs to disk after each write");
+
+FLAG(bool,
+     logger_rotate,
+     false,
+     "Rotate the results and snapshots logs instead of relying on logrotate");
+
+FLAG(uint64,
+     logger_rotate_size,
+     25 * 1024 * 1024,
+     "Rotate results and snapshots logs at this many bytes");
+
+FLAG(uint64,
+     logger_rotate_age,
+     0,
+     "Rotate results and snapshots logs after this many seconds (default 0)");
+
+FLAG(bool,
+     logger_rotate_compress,
+     true,
+     "Compress rotated results and snapshots log segments with zstd");
+
+FLAG(uint64,
+     logger_rotate_max_bytes,
+     0,
+     "Maximum bytes of rotated segments kept per log (default 0, unlimited)");
+
 const std::string kFilesystemLoggerFilename = "osqueryd.results.log";
 const std::string kFilesystemLoggerSnapshots = "osqueryd.snapshots.log";
 
+namespace {
+
+const std::string kCompressedSegmentExtension = ".zst";
+
+/// Compress rotated segments, a failed segment is left uncompressed.
+void compressSegments(const std::vector<fs::path>& segments) {
+  for (const auto& segment : segments) {
+    auto compressed = segment.string() + kCompressedSegmentExtension;
+    auto status = compress(segment, compressed);
+    if (!status.ok()) {
+      VLOG(1) << "Cannot compress log segment: " << status.getMessage();
+      continue;
+    }
+
+    boost::system::error_code ec;
+    fs::remove(segment, ec);
+  }
+}
+
+/// Remove the oldest segments of a log beyond the retained byte limit.
+void expireSegments(const fs::path& log) {
+  auto prefix = log.filename().string() + ".";
+
+  boost::system::error_code ec;
+  std::vector<std::pair<std::string, uintmax_t>> segments;
+  for (fs::directory_iterator it(log.parent_path(), ec), end; !ec && it != end;
+       it.increment(ec)) {
+    auto name = it->path().filename().string();
+    if (name.compare(0, prefix.size(), prefix) == 0) {
+      auto size = fs::file_size(it->path(), ec);
+      segments.push_back(std::make_pair(name, (ec) ? 0 : size));
+      ec.clear();
+    }
+  }
+
+  // Segment names end in their rotation time, newest sort last.
+  std::sort(segments.rbegin(), segments.rend());
+  uintmax_t retained = 0;
+  for (const auto& segment : segments) {
+    retained += segment.second;
+    if (retained > FLAGS_logger_rotate_max_bytes) {
+      fs::remove(log.parent_path() / segment.first, ec);
+    }
+  }
+}
+
+} // namespace
+
+FilesystemLogWriter::~FilesystemLogWriter() {
+  flush();
+}
+
+Status FilesystemLogWriter::open() {
+  file_.reset();
+  auto file = std::make_unique<PlatformFile>(
+      path_, PF_OPEN_ALWAYS | PF_WRITE | PF_APPEND, FLAGS_logger_mode);
+  if (!file->isValid()) {
+    return Status(1, "Could not create file: " + path_.string());
+  }
+
+  // If the file existed with different permissions before our open
+  // they must be restricted.
+#if WIN32
+  const std::string p = wstringToString(path_.wstring());
+#else
+  const std::string p = path_.string();
+#endif
+  if (!platformChmod(p, FLAGS_logger_mode)) {
+    return Status(1, "Failed to change permissions for file: " + p);
+  }
+
+#ifndef WIN32
+  struct stat st;
+  if (fstat(file->nativeHandle(), &st) != 0) {
+    return Status(1, "Failed to stat file: " + p);
+  }
+  device_ = st.st_dev;
+  inode_ = st.st_ino;
+#endif
+
+  size_ = file->size();
+  opened_ = std::chrono::system_clock::now();
+  file_ = std::move(file);
+  return Status::success();
+}
+
+bool FilesystemLogWriter::shouldRotate(size_t pending) const {
+  if (!FLAGS_logger_rotate || size_ == 0) {
+    return false;
+  }
+
+  if (size_ + pending > FLAGS_logger_rotate_size) {
+    return true;
+  }
+
+  auto age = std::chrono::seconds(FLAGS_logger_rotate_age);
+  return FLAGS_logger_rotate_age > 0 &&
+         std::chrono::system_clock::now() - opened_ >= age;
+}
+
+Status FilesystemLogWriter::rotate() {
+  file_.reset();
+
+  auto now = std::chrono::system_clock::to_time_t(opened_);
+  auto segment = path_.string() + "." + std::to_string(now);
+  for (size_t i = 1; pathExists(segment).ok() ||
+                     pathExists(segment + kCompressedSegmentExtension).ok();
+       i++) {
+    segment = path_.string() + "." + std::to_string(now) + "-" +
+              std::to_string(i);
+  }
+
+  boost::system::error_code ec;
+  fs::rename(path_, segment, ec);
+  if (ec) {
+    return Status(1, "Cannot rotate " + path_.string() + ": " + ec.message());
+  }
+
+  if (FLAGS_logger_rotate_compress) {
+    segments_.push_back(segment);
+  }
+  return open();
+}
+
+std::vector<fs::path> FilesystemLogWriter::takeSegments() {
+  WriteLock lock(mutex_);
+  std::vector<fs::path> segments;
+  segments.swap(segments_);
+  return segments;
+}
+
+bool FilesystemLogWriter::rotated() const {
+#ifndef WIN32
+  struct stat st;
+  if (stat(path_.string().c_str(), &st) != 0) {
+    return true;
+  }
+  return st.st_dev != device_ || st.st_ino != inode_;
+#else
+  return !pathExists(path_).ok();
+#endif
+}
+
+Status FilesystemLogWriter::flushBuffer() {
+  if (file_ == nullptr || rotated()) {
+    auto status = open();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (buffer_.empty()) {
+    return Status::success();
+  }
+
+  if (shouldRotate(buffer_.size())) {
+    auto status = rotate();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  auto bytes = file_->write(buffer_.data(), buffer_.size());
+  if (bytes < 0 || static_cast<size_t>(bytes) != buffer_.size()) {
+    // Reopen on the next write, a partial write may have been rotated away.
+    file_.reset();
+    if (bytes > 0) {
+      buffer_.erase(0, static_cast<size_t>(bytes));
+    }
+    return Status(1, "Failed to write contents to file: " + path_.string());
+  }
+  size_ += buffer_.size();
+  buffer_.clear();
+
+  if (FLAGS_logger_fsync) {
+#if WIN32
+    FlushFileBuffers(file_->nativeHandle());
+#elif defined(__linux__)
+    fdatasync(file_->nativeHandle());
+#else
+    fsync(file_->nativeHandle());
+#endif
+  }
+  return Status::success();
+}
+
+Status FilesystemLogWriter::write(const std::string& s, bool empty) {
+  WriteLock lock(mutex_);
+  if (!empty) {
+    if (buffer_.empty()) {
+      buffered_since_ = std::chrono::steady_clock::now();
+    }
+    buffer_.append(s);
+    buffer_.push_back('\n');
+  }
+  return writeBuffered();
+}
+
+Status FilesystemLogWriter::writeLines(const std::string& lines) {
+  WriteLock lock(mutex_);
+  if (buffer_.empty()) {
+    buffered_since_ = std::chrono::steady_clock::now();
+  }
+  buffer_.append(lines);
+  return writeBuffered();
+}
+
+Status FilesystemLogWriter::writeBuffered() {
+  // The first write opens the file, later writes may be held in the buffer.
+  if (file_ != nullptr && buffer_.size() < FLAGS_logger_flush_size &&
+      !bufferExpired()) {
+    return Status::success();
+  }
+  return flushBuffer();
+}
+
+Status FilesystemLogWriter::flush() {
+  WriteLock lock(mutex_);
+  if (buffer_.empty()) {
+    return Status::success();
+  }
+  return flushBuffer();
+}
+
+Status FilesystemLogWriter::flushExpired() {
+  WriteLock lock(mutex_);
+  if (buffer_.empty() || !bufferExpired()) {
+    return Status::success();
+  }
+  return flushBuffer();
+}
+
+bool FilesystemLogWriter::bufferExpired() const {
+  auto interval = std::chrono::seconds(FLAGS_logger_flush_interval);
+  return std::chrono::steady_clock::now() - buffered_since_ >= interval;
+}
+
+std::chrono::milliseconds FilesystemLogFlusher::firstDelay() {
+  auto interval = std::max<uint64_t>(FLAGS_logger_flush_interval, 1);
+  if (FLAGS_logger_rotate) {
+    // Segments are compressed shortly after they are rotated.
+    interval = 1;
+  }
+  return std::chrono::seconds(interval);
+}
+
+std::chrono::milliseconds FilesystemLogFlusher::tick() {
+  for (const auto& writer : writers_) {
+    writer->flushExpired();
+    if (!FLAGS_logger_rotate) {
+      continue;
+    }
+
+    compressSegments(writer->takeSegments());
+    if (FLAGS_logger_rotate_max_bytes > 0) {
+      expireSegments(writer->path());
+    }
+  }
+  return firstDelay();
+}
+
+void FilesystemLogFlusher::stop() {
+  for (const auto& writer : writers_) {
+    writer->flush();
+  }
+}
+
 Status FilesystemLoggerPlugin::setUp() {
-  log_path_ = fs::path(FLAGS_logger_path);
+  {
+    WriteLock lock(mutex_);
+    log_path_ = fs::path(FLAGS_logger_path);
+    results_ = std::make_shared<FilesystemLogWriter>(
+        log_path_ / kFilesystemLoggerFilename);
+    snapshots_ = std::make_shared<FilesystemLogWriter>(
+        log_path_ / kFilesystemLoggerSnapshots);
+  }
 
   // Ensure that the Glog status logs use the same mode as our results log.
   // Glog 0.3.4 does not support a logfile mode.
   // FLAGS_logfile_mode = FLAGS_logger_mode;
 
+  if (FLAGS_logger_flush_size > 0 || FLAGS_logger_rotate) {
+    Dispatcher::addService(std::make_shared<FilesystemLogFlusher>(
+        std::vector<std::shared_ptr<FilesystemLogWriter>>{results_,
+                                                          snapshots_}));
+  }
+
   // Ensure that we create the results log here.
   return logStringToFile("", kFilesystemLoggerFilename, true);
 }
 
+void FilesystemLoggerPlugin::tearDown() {
+  flush();
+}
+
+Status FilesystemLoggerPlugin::flush() {
+  std::shared_ptr<FilesystemLogWriter> results;
+  std::shared_ptr<FilesystemLogWriter> snapshots;
+  {
+    WriteLock lock(mutex_);
+    results = results_;
+    snapshots = snapshots_;
+  }
+
+  if (results == nullptr) {
+    return Status::success();
+  }
+
+  auto status = results->flush();
+  auto snapshot_status = snapshots->flush();
+  return (status.ok()) ? snapshot_status : status;
+}
+
 Status FilesystemLoggerPlugin::logString(const std::string& s) {
   return logStringToFile(s, kFilesystemLoggerFilename);
 }
 
+Status FilesystemLoggerPlugin::logStringBatch(const std::string& batch) {
+  std::shared_ptr<FilesystemLogWriter> writer;
+  {
+    WriteLock lock(mutex_);
+    writer = results_;
+  }
+
+  if (writer == nullptr) {
+    return Status(1, "Filesystem logger is not set up");
+  }
+  return writer->writeLines(batch);
+}
+
 Status FilesystemLoggerPlugin::logStringToFile(const std::string& s,
                                                const std::string& filename,
                                                bool empty) {
-  WriteLock lock(mutex_);
-  Status status;
+  std::shared_ptr<FilesystemLogWriter> writer;
+  {
+    WriteLock lock(mutex_);
+    writer = (filename == kFilesystemLoggerSnapshots) ? snapshots_ : results_;
+  }
+
+  if (writer == nullptr) {
+    return Status(1, "Filesystem logger is not set up");
+  }
+
   try {
-    status = writeTextFile((log_path_ / filename).string(),
-                           (empty) ? "" : s + '\n',
-                           FLAGS_logger_mode);
+    return writer->write(s, empty);
   } catch (const std::exception& e) {
     return Status(1, e.what());
   }
-  return status;
 }
 
 Status FilesystemLoggerPlugin::logStatus(
@@ -9,22 +9,154 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
 #include <exception>
+#include <memory>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/types.h>
+#endif
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/plugins/logger.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
+/**
+ * @brief An append-only log file that is kept open between writes.
+ *
+ * Lines are coalesced into a user-space buffer and written when the buffer
+ * reaches --logger_flush_size bytes or is older than --logger_flush_interval
+ * seconds. Before writing, the writer checks that the path still names the
+ * open file and reopens it if the log was rotated or removed.
+ *
+ * With --logger_rotate the writer rotates the file itself: once it reaches
+ * --logger_rotate_size bytes, or was opened --logger_rotate_age seconds ago,
+ * it is renamed to a timestamped segment that the FilesystemLogFlusher later
+ * compresses and expires.
+ */
+class FilesystemLogWriter : private boost::noncopyable {
+ public:
+  explicit FilesystemLogWriter(boost::filesystem::path path)
+      : path_(std::move(path)) {}
+
+  ~FilesystemLogWriter();
+
+  /// Append a line, empty lines are not written but the file is created.
+  Status write(const std::string& s, bool empty = false);
+
+  /// Append newline-terminated lines.
+  Status writeLines(const std::string& lines);
+
+  /// Write all buffered lines.
+  Status flush();
+
+  /// Write all buffered lines if the oldest is past the flush interval.
+  Status flushExpired();
+
+  /// Remove and return the segments rotated since the last call.
+  std::vector<boost::filesystem::path> takeSegments();
+
+  /// The active log path, segments are named this path with a suffix.
+  const boost::filesystem::path& path() const {
+    return path_;
+  }
+
+ private:
+  /// Open or reopen the file, restricting its permissions.
+  Status open();
+
+  /// Check if the path no longer names the open file.
+  bool rotated() const;
+
+  /// Check if the oldest buffered line is past the flush interval.
+  bool bufferExpired() const;
+
+  /// Check if writing a number of bytes should first rotate the file.
+  bool shouldRotate(size_t pending) const;
+
+  /// Rename the open file to a new segment and open a new file.
+  Status rotate();
+
+  /// Write the buffer if it is full or expired, callers must hold the mutex.
+  Status writeBuffered();
+
+  /// Write the buffer, callers must hold the writer mutex.
+  Status flushBuffer();
+
+ private:
+  /// The results or snapshots log path.
+  const boost::filesystem::path path_;
+
+  /// The open log file, nullptr when closed.
+  std::unique_ptr<PlatformFile> file_;
+
+#ifndef WIN32
+  /// The identity of the open file, used to detect rotation.
+  dev_t device_{0};
+  ino_t inode_{0};
+#endif
+
+  /// The size of the open file.
+  size_t size_{0};
+
+  /// When the open file was opened.
+  std::chrono::system_clock::time_point opened_;
+
+  /// Rotated segments waiting to be compressed.
+  std::vector<boost::filesystem::path> segments_;
+
+  /// Lines waiting to be written.
+  std::string buffer_;
+
+  /// When the first line in buffer_ was added.
+  std::chrono::steady_clock::time_point buffered_since_;
+
+  /// Protects the file and the buffer.
+  Mutex mutex_;
+};
+
+/// Periodically write buffered lines, then compress and expire segments.
+class FilesystemLogFlusher : public PeriodicRunnable {
+ public:
+  explicit FilesystemLogFlusher(
+      std::vector<std::shared_ptr<FilesystemLogWriter>> writers)
+      : PeriodicRunnable("FilesystemLogFlusher"),
+        writers_(std::move(writers)) {}
+
+ protected:
+  std::chrono::milliseconds tick() override;
+
+  std::chrono::milliseconds firstDelay() override;
+
+  void stop() override;
+
+ private:
+  std::vector<std::shared_ptr<FilesystemLogWriter>> writers_;
+};
+
 class FilesystemLoggerPlugin : public LoggerPlugin {
  public:
   Status setUp() override;
 
+  /// Write any buffered results and snapshots.
+  void tearDown() override;
+
+  /// Write any buffered results and snapshots.
+  Status flush();
+
   /// Log results (differential) to a distinct path.
   Status logString(const std::string& s) override;
 
+  /// Log newline-terminated results with a single write.
+  Status logStringBatch(const std::string& batch) override;
+
   /// Log snapshot data to a distinct path.
   Status logSnapshot(const std::string& s) override;
 
@@ -51,7 +183,13 @@ class FilesystemLoggerPlugin : public LoggerPlugin {
   /// The folder where Glog and the result/snapshot files are written.
   boost::filesystem::path log_path_;
 
-  /// Filesystem writer mutex.
+  /// Writer for the results log.
+  std::shared_ptr<FilesystemLogWriter> results_;
+
+  /// Writer for the snapshots log.
+  std::shared_ptr<FilesystemLogWriter> snapshots_;
+
+  /// Protects replacing the writers during setUp.
   Mutex mutex_;
 
   /*
@@ -53,11 +53,34 @@ FLAG(string,
      "all",
      "The number of acknowledgments the leader has to receive (0, 1, 'all')");
 
-FLAG(
-    string,
-    logger_kafka_compression,
-    "none",
-    "Compression codec to use for compressing message sets ('none' or 'gzip')");
+FLAG(string,
+     logger_kafka_compression,
+     "none",
+     "Compression codec to use for compressing message sets ('none', 'gzip', "
+     "'snappy', 'lz4' or 'zstd')");
+
+FLAG(string,
+     logger_kafka_linger_ms,
+     "",
+     "Milliseconds to wait for messages to accumulate before sending a "
+     "message set (librdkafka default if empty)");
+
+FLAG(string,
+     logger_kafka_batch_num_messages,
+     "",
+     "Maximum number of messages batched in one message set (librdkafka "
+     "default if empty)");
+
+FLAG(string,
+     logger_kafka_partition_key,
+     "host",
+     "Message key used for partitioning ('host', 'name' for the query name, "
+     "or 'none' to spread messages across partitions)");
+
+FLAG(bool,
+     logger_kafka_aggregate_events,
+     false,
+     "Publish all event-formatted rows of a query result as one message");
 
 /// How often to poll Kafka broker for publish results.
 const std::chrono::seconds kKafkaPollDuration = std::chrono::seconds(5);
@@ -207,7 +230,10 @@ void KafkaProducerPlugin::init(const std::string& name,
 
   if (!setConf(conf, "client.id", hostname) ||
       !setConf(conf, "bootstrap.servers", FLAGS_logger_kafka_brokers) ||
-      !setConf(conf, "compression.codec", FLAGS_logger_kafka_compression)) {
+      !setConf(conf, "compression.codec", FLAGS_logger_kafka_compression) ||
+      !setConf(conf, "linger.ms", FLAGS_logger_kafka_linger_ms) ||
+      !setConf(
+          conf, "batch.num.messages", FLAGS_logger_kafka_batch_num_messages)) {
     return;
   }
 
@@ -248,8 +274,37 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
         1, "Cannot log because Kafka producer did not initiate properly.");
   }
 
-  std::string name(getMsgName(payload));
+  return publishPayload(getMsgName(payload), payload);
+}
+
+Status KafkaProducerPlugin::logStringBatch(const std::string& batch) {
+  if (!FLAGS_logger_kafka_aggregate_events) {
+    return LoggerPlugin::logStringBatch(batch);
+  }
 
+  if (!running_.load()) {
+    return Status(
+        1, "Cannot log because Kafka producer did not initiate properly.");
+  }
+
+  // Every line of a batch belongs to the same query, publish them together
+  // as newline-delimited JSON. The name is parsed from the first line only.
+  auto length = batch.size();
+  if (length > 0 && batch[length - 1] == '\n') {
+    length--;
+  }
+
+  if (length == 0) {
+    return Status::success();
+  }
+
+  auto payload = batch.substr(0, length);
+  return publishPayload(getMsgName(payload.substr(0, payload.find('\n'))),
+                        payload);
+}
+
+Status KafkaProducerPlugin::publishPayload(const std::string& name,
+                                           const std::string& payload) {
   rd_kafka_topic_t* topic = nullptr;
   try {
     topic = queryToTopics_.at(name);
@@ -265,7 +320,7 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
     return Status(2, errMsg);
   }
 
-  Status status = publishMsg(topic, payload);
+  Status status = publishMsg(topic, payload, getMsgKey(name));
   if (!status.ok()) {
     LOG(ERROR) << "Could not publish message: " << status.getMessage();
   }
@@ -276,15 +331,29 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
   return status;
 }
 
+const std::string& KafkaProducerPlugin::getMsgKey(
+    const std::string& name) const {
+  static const std::string kNoKey;
+  if (FLAGS_logger_kafka_partition_key == "none") {
+    return kNoKey;
+  } else if (FLAGS_logger_kafka_partition_key == "name" && !name.empty()) {
+    return name;
+  }
+  return msgKey_;
+}
+
 Status KafkaProducerPlugin::publishMsg(rd_kafka_topic_t* topic,
-                                       const std::string& payload) {
+                                       const std::string& payload,
+                                       const std::string& key) {
+  // An empty key leaves the partition choice to the partitioner, messages
+  // without a key are spread across partitions.
   if (rd_kafka_produce(topic,
                        RD_KAFKA_PARTITION_UA,
                        RD_KAFKA_MSG_F_COPY,
                        (char*)payload.c_str(),
                        payload.length(),
-                       msgKey_.c_str(), // Optional key
-                       msgKey_.length(), // key length
+                       key.empty() ? nullptr : key.c_str(), // Optional key
+                       key.length(), // key length
                        nullptr) == -1) {
     return Status(1,
                   "Failed to produce on Kafka topic " +
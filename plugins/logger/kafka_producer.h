@@ -37,6 +37,14 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   Status logString(const std::string& s) override;
 
+  /**
+   * @brief Logs the event-formatted rows of a query result.
+   *
+   * When --logger_kafka_aggregate_events is set the rows are published as a
+   * single newline-delimited message, otherwise each row is a message.
+   */
+  Status logStringBatch(const std::string& batch) override;
+
   /**
    * @brief Initializes the Kafka producer.
    *
@@ -73,11 +81,13 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    *
    * @param topic Kafka topic to publish to
    * @param msg message body
+   * @param key message key used for partitioning, may be empty
    *
    * @return Status of publish attempt
    */
   virtual Status publishMsg(rd_kafka_topic_t* topic,
-                            const std::string& payload);
+                            const std::string& payload,
+                            const std::string& key);
 
   /**
    * @brief Flushes all buffered messages to Kafka, waiting for a maximum of 3
@@ -101,6 +111,12 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
   /// Configures Kafka topics accordingly.
   bool configureTopics();
 
+  /// Publishes a payload to the topic configured for the query name.
+  Status publishPayload(const std::string& name, const std::string& payload);
+
+  /// Selects the message key according to --logger_kafka_partition_key.
+  const std::string& getMsgKey(const std::string& name) const;
+
   /// Initiates Kafka topic.  Caller needs to handle rd_kafka_topic_t* cleanup.
   rd_kafka_topic_t* initTopic(const std::string& topicName);
 
@@ -12,6 +12,7 @@
 #include <memory>
 #include <vector>
 
+#include <aws/core/utils/HashingUtils.h>
 #include <aws/kinesis/KinesisClient.h>
 #include <aws/kinesis/model/PutRecordsRequestEntry.h>
 #include <gtest/gtest.h>
@@ -23,6 +24,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_interface.h>
 
+#include "plugins/logger/aws_kinesis.h"
 #include "plugins/logger/aws_log_forwarder.h"
 #include "plugins/logger/buffered.h"
 
@@ -109,6 +111,10 @@ class DummyLogForwarder final : public IDummyLogForwarder {
     return true;
   }
 
+  bool packRecords() const override {
+    return pack_records_;
+  }
+
   std::size_t getFailedRecordCount(Outcome& outcome) const override {
     return 0U;
   }
@@ -119,6 +125,7 @@ class DummyLogForwarder final : public IDummyLogForwarder {
 
  public:
   RawBatchList emitted_batch_list_;
+  bool pack_records_{false};
 
   FRIEND_TEST(AwsLoggerTests, test_send);
 };
@@ -185,4 +192,56 @@ TEST_F(AwsLoggerTests, test_send) {
             "test\":\"2\",\"log_type\":\"result\"}\n");
   EXPECT_EQ(third_batch[1], "{\"batch3\":\"3\",\"log_type\":\"result\"}\n");
 }
+
+TEST_F(AwsLoggerTests, test_send_packed) {
+  DummyLogForwarder log_forwarder;
+  log_forwarder.pack_records_ = true;
+
+  // Each line is 30 bytes with its newline, two fit in an 80 byte record
+  for (size_t i = 1; i <= 5; ++i) {
+    log_forwarder.logString("{ \"a\": \"" + std::to_string(i) + "\" }");
+  }
+  log_forwarder.check();
+
+  // Three records do not fit in a 128 byte batch
+  ASSERT_EQ(log_forwarder.emitted_batch_list_.size(), 2U);
+  auto first_batch = log_forwarder.emitted_batch_list_[0];
+  ASSERT_EQ(first_batch.size(), 2U);
+  EXPECT_EQ(first_batch[0],
+            "{\"a\":\"1\",\"log_type\":\"result\"}\n"
+            "{\"a\":\"2\",\"log_type\":\"result\"}\n");
+  EXPECT_EQ(first_batch[1],
+            "{\"a\":\"3\",\"log_type\":\"result\"}\n"
+            "{\"a\":\"4\",\"log_type\":\"result\"}\n");
+
+  auto second_batch = log_forwarder.emitted_batch_list_[1];
+  ASSERT_EQ(second_batch.size(), 1U);
+  EXPECT_EQ(second_batch[0], "{\"a\":\"5\",\"log_type\":\"result\"}\n");
+}
+
+TEST_F(AwsLoggerTests, test_kinesis_aggregated_record) {
+  auto record = aggregateKinesisRecords("key", {"a", "bc"});
+  EXPECT_EQ(record.size(),
+            getKinesisAggregatedRecordOverhead(3) +
+                getKinesisAggregatedLineBytes(1) +
+                getKinesisAggregatedLineBytes(2));
+
+  // The magic, then the partition key table and a Record message per line
+  std::string message("\x0A\x03key"
+                      "\x1A\x05\x08\x00\x1A\x01"
+                      "a"
+                      "\x1A\x06\x08\x00\x1A\x02"
+                      "bc",
+                      20);
+  EXPECT_EQ(record.substr(0, 4), "\xF3\x89\x9A\xC2");
+  EXPECT_EQ(record.substr(4, message.size()), message);
+
+  // The record ends with the MD5 digest of the message
+  auto digest = Aws::Utils::HashingUtils::CalculateMD5(
+      Aws::String(message.data(), message.size()));
+  EXPECT_EQ(record.substr(4 + message.size()),
+            std::string(reinterpret_cast<const char*>(
+                            digest.GetUnderlyingData()),
+                        digest.GetLength()));
+}
 }
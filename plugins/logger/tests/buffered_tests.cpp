@@ -8,6 +8,7 @@
  */
 
 #include <chrono>
+#include <cstring>
 #include <thread>
 
 #include <gmock/gmock.h>
@@ -16,6 +17,9 @@
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <zlib.h>
+#include <zstd.h>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
@@ -34,6 +38,7 @@ namespace pt = boost::property_tree;
 namespace osquery {
 
 DECLARE_uint64(buffered_log_max);
+DECLARE_string(buffered_log_compression);
 
 // Check that the string matches the StatusLogLine
 MATCHER_P(MatchesStatus, expected, "") {
@@ -105,18 +110,85 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
   FRIEND_TEST(BufferedLogForwarderTests, test_split);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge_max);
+  FRIEND_TEST(BufferedLogForwarderTests, test_log_during_send);
+  FRIEND_TEST(BufferedLogForwarderTests, test_inflight);
+  FRIEND_TEST(BufferedLogForwarderTests, test_adaptive_batches);
 
  private:
   bool checked_{false};
 };
 
+class MockCompressedLogForwarder : public MockBufferedLogForwarder {
+ public:
+  using MockBufferedLogForwarder::MockBufferedLogForwarder;
+
+  bool getCompressedFraming(const std::string& log_type,
+                            BufferedLogFraming& framing) override {
+    framing.prefix = "[";
+    framing.delimiter = ",";
+    framing.suffix = "]";
+    framing.max_bytes = max_bytes_;
+    return true;
+  }
+
+  bool prepareCompressedLine(std::string& line,
+                             const std::string& log_type) override {
+    return line != "skip";
+  }
+
+  MOCK_METHOD2(sendCompressed,
+               Status(std::vector<std::string>& batches,
+                      const std::string& log_type));
+  FRIEND_TEST(BufferedLogForwarderTests, test_compressed);
+
+ private:
+  size_t max_bytes_{0};
+};
+
+std::string decompressBufferedLog(const std::string& data,
+                                  BufferedLogCodec codec) {
+  std::string output;
+  std::vector<char> buffer(16384);
+  if (codec == BufferedLogCodec::Gzip) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+      return output;
+    }
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+      zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+      zs.avail_out = static_cast<uInt>(buffer.size());
+      ret = inflate(&zs, Z_NO_FLUSH);
+      output.append(buffer.data(), buffer.size() - zs.avail_out);
+    }
+    inflateEnd(&zs);
+  } else {
+    auto stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+    ZSTD_inBuffer input = {data.data(), data.size(), 0};
+    while (input.pos < input.size) {
+      ZSTD_outBuffer out = {buffer.data(), buffer.size(), 0};
+      if (ZSTD_isError(ZSTD_decompressStream(stream, &out, &input))) {
+        break;
+      }
+      output.append(buffer.data(), out.pos);
+    }
+    ZSTD_freeDStream(stream);
+  }
+  return output;
+}
+
 TEST_F(BufferedLogForwarderTests, test_index) {
   MockBufferedLogForwarder runner;
   if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_1"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_2"));
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_3"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_4"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_0+1"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_0+2"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_0+3"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_0+4"));
   }
 
   EXPECT_TRUE(runner.isResultIndex(runner.genResultIndex()));
@@ -327,6 +399,157 @@ TEST_F(BufferedLogForwarderTests, test_purge) {
   runner.check();
 }
 
+TEST_F(BufferedLogForwarderTests, test_log_during_send) {
+  StrictMock<MockBufferedLogForwarder> runner;
+  runner.logString("foo");
+  runner.logString("bar");
+
+  // Only the sent range of indexes is removed.
+  EXPECT_CALL(runner, send(ElementsAre("foo", "bar"), "result"))
+      .WillOnce(DoAll(InvokeWithoutArgs([&runner]() {
+                        runner.logString("baz");
+                        runner.logString("qux");
+                      }),
+                      Return(Status(0))));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("baz", "qux"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  runner.check();
+}
+
+TEST_F(BufferedLogForwarderTests, test_inflight) {
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 2);
+  runner.max_inflight_ = 2;
+  for (const auto& line : {"a", "b", "c", "d", "e"}) {
+    runner.logString(line);
+  }
+
+  // Both batches are sent in the same check, only the acknowledged remove.
+  EXPECT_CALL(runner, send(ElementsAre("a", "b"), "result"))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre("c", "d"), "result"))
+      .WillOnce(Return(Status(1, "fail")))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("e"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  runner.check();
+}
+
+TEST_F(BufferedLogForwarderTests, test_adaptive_batches) {
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 4);
+  runner.adaptive_batches_ = true;
+  for (const auto& line : {"a", "b", "c", "d", "e", "f", "g"}) {
+    runner.logString(line);
+  }
+
+  // A failed send halves the next batch.
+  EXPECT_CALL(runner, send(ElementsAre("a", "b", "c", "d"), "result"))
+      .WillOnce(Return(Status(1, "fail")));
+  runner.check();
+
+  // Successful sends grow the batches back to the max.
+  EXPECT_CALL(runner, send(ElementsAre("a", "b"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("c", "d", "e"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("f", "g"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  for (const auto& line : {"h", "i", "j", "k", "l"}) {
+    runner.logString(line);
+  }
+  EXPECT_CALL(runner, send(ElementsAre("h", "i", "j", "k"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("l"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  runner.check();
+}
+
+TEST_F(BufferedLogForwarderTests, test_compressor) {
+  std::string input;
+  for (size_t i = 0; i < 1000; i++) {
+    input += "{\"name\":\"osquery\",\"action\":\"added\"}\n";
+  }
+
+  for (auto codec : {BufferedLogCodec::Gzip, BufferedLogCodec::Zstd}) {
+    BufferedLogCompressor compressor(codec);
+    ASSERT_TRUE(compressor.append(input).ok());
+    EXPECT_EQ(input.size(), compressor.size());
+
+    std::string output;
+    ASSERT_TRUE(compressor.finish(output).ok());
+    EXPECT_EQ(0U, compressor.size());
+    EXPECT_LT(output.size(), input.size() / 10);
+    EXPECT_EQ(input, decompressBufferedLog(output, codec));
+
+    // The compressor is reset for the next batch.
+    ASSERT_TRUE(compressor.append("foo").ok());
+    ASSERT_TRUE(compressor.append("bar").ok());
+    ASSERT_TRUE(compressor.finish(output).ok());
+    EXPECT_EQ("foobar", decompressBufferedLog(output, codec));
+  }
+
+  BufferedLogCodec codec;
+  EXPECT_TRUE(parseBufferedLogCodec("zstd", codec).ok());
+  EXPECT_EQ(BufferedLogCodec::Zstd, codec);
+  EXPECT_TRUE(parseBufferedLogCodec("", codec).ok());
+  EXPECT_EQ(BufferedLogCodec::None, codec);
+  EXPECT_FALSE(parseBufferedLogCodec("lz4", codec).ok());
+}
+
+TEST_F(BufferedLogForwarderTests, test_compressed) {
+  FLAGS_buffered_log_compression = "gzip";
+  StrictMock<MockCompressedLogForwarder> runner;
+  ASSERT_TRUE(runner.setUp().ok());
+
+  runner.logString("foo");
+  runner.logString("skip");
+  runner.logString("bar");
+
+  std::vector<std::string> batches;
+  EXPECT_CALL(runner, sendCompressed(_, "result"))
+      .WillOnce(DoAll(SaveArg<0>(&batches), Return(Status(0))));
+  runner.check();
+  ASSERT_EQ(1U, batches.size());
+  EXPECT_EQ("[foo,bar]",
+            decompressBufferedLog(batches[0], BufferedLogCodec::Gzip));
+
+  // Rejected lines are removed with the sent batch.
+  runner.check();
+
+  // Lines that would exceed the forwarder's limit start a new batch.
+  runner.max_bytes_ = 8;
+  runner.logString("foo");
+  runner.logString("bar");
+  EXPECT_CALL(runner, sendCompressed(_, "result"))
+      .WillOnce(Return(Status(1, "fail")))
+      .WillOnce(DoAll(SaveArg<0>(&batches), Return(Status(0))));
+  runner.check();
+  runner.check();
+  ASSERT_EQ(2U, batches.size());
+  EXPECT_EQ("[foo]", decompressBufferedLog(batches[0], BufferedLogCodec::Gzip));
+  EXPECT_EQ("[bar]", decompressBufferedLog(batches[1], BufferedLogCodec::Gzip));
+
+  runner.check();
+  FLAGS_buffered_log_compression = "";
+}
+
 // Verify that the max number of buffered logs is respected, and oldest logs
 // are purged first
 TEST_F(BufferedLogForwarderTests, test_purge_max) {
@@ -33,6 +33,11 @@ namespace osquery {
 DECLARE_string(logger_path);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_uint64(logger_flush_size);
+DECLARE_uint64(logger_flush_interval);
+DECLARE_bool(logger_rotate);
+DECLARE_uint64(logger_rotate_size);
+DECLARE_bool(logger_rotate_compress);
 
 class FilesystemLoggerTests : public testing::Test {
  public:
@@ -85,6 +90,89 @@ TEST_F(FilesystemLoggerTests, test_log_string) {
   EXPECT_EQ(content, "{\"json\": true}\n");
 }
 
+TEST_F(FilesystemLoggerTests, test_log_string_buffered) {
+  auto backup_size = FLAGS_logger_flush_size;
+  auto backup_interval = FLAGS_logger_flush_interval;
+  FLAGS_logger_flush_size = 4096;
+  FLAGS_logger_flush_interval = 3600;
+
+  EXPECT_TRUE(logString("{\"json\": 1}", "event"));
+  EXPECT_TRUE(logString("{\"json\": 2}", "event"));
+
+  // Both lines are held in the buffer.
+  std::string content;
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "");
+
+  auto plugin = std::dynamic_pointer_cast<FilesystemLoggerPlugin>(
+      Registry::get().plugin("logger", "filesystem"));
+  ASSERT_NE(plugin, nullptr);
+  EXPECT_TRUE(plugin->flush());
+
+  content.clear();
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "{\"json\": 1}\n{\"json\": 2}\n");
+
+  FLAGS_logger_flush_size = backup_size;
+  FLAGS_logger_flush_interval = backup_interval;
+}
+
+TEST_F(FilesystemLoggerTests, test_log_string_rotated) {
+  if (isPlatform(PlatformType::TYPE_WINDOWS)) {
+    // The open results log cannot be renamed on windows.
+    return;
+  }
+
+  EXPECT_TRUE(logString("{\"json\": 1}", "event"));
+
+  // Rotate the results log away from the open writer.
+  auto rotated_path = results_path_ + ".1";
+  fs::rename(results_path_, rotated_path);
+  EXPECT_TRUE(logString("{\"json\": 2}", "event"));
+
+  std::string content;
+  EXPECT_TRUE(readFile(rotated_path, content));
+  EXPECT_EQ(content, "{\"json\": 1}\n");
+
+  content.clear();
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "{\"json\": 2}\n");
+}
+
+TEST_F(FilesystemLoggerTests, test_log_string_rotate_size) {
+  auto backup_rotate = FLAGS_logger_rotate;
+  auto backup_size = FLAGS_logger_rotate_size;
+  auto backup_compress = FLAGS_logger_rotate_compress;
+  FLAGS_logger_rotate = true;
+  FLAGS_logger_rotate_size = 20;
+  FLAGS_logger_rotate_compress = false;
+
+  // The second line does not fit in the segment and rotates the log.
+  EXPECT_TRUE(logString("{\"json\": 1}", "event"));
+  EXPECT_TRUE(logString("{\"json\": 2}", "event"));
+
+  std::vector<fs::path> segments;
+  for (fs::directory_iterator it(FLAGS_logger_path), end; it != end; ++it) {
+    auto name = it->path().filename().string();
+    if (name.find("osqueryd.results.log.") == 0) {
+      segments.push_back(it->path());
+    }
+  }
+  ASSERT_EQ(segments.size(), 1U);
+
+  std::string content;
+  EXPECT_TRUE(readFile(segments[0], content));
+  EXPECT_EQ(content, "{\"json\": 1}\n");
+
+  content.clear();
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "{\"json\": 2}\n");
+
+  FLAGS_logger_rotate = backup_rotate;
+  FLAGS_logger_rotate_size = backup_size;
+  FLAGS_logger_rotate_compress = backup_compress;
+}
+
 class FilesystemTestLoggerPlugin : public LoggerPlugin {
  public:
   Status logString(const std::string& s) override {
@@ -29,6 +29,9 @@
 
 namespace osquery {
 
+DECLARE_string(logger_kafka_partition_key);
+DECLARE_bool(logger_kafka_aggregate_events);
+
 class MockKafkaProducerPlugin : public KafkaProducerPlugin {
  public:
   MockKafkaProducerPlugin() : timesFlushed_(0), timesPolled_(0) {
@@ -45,7 +48,10 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
 
  protected:
   Status publishMsg(rd_kafka_topic_t* topic,
-                    const std::string& payload) override {
+                    const std::string& payload,
+                    const std::string& key) override {
+    publishedKeys_.push_back(key);
+
     if (publishedMsgs_.find(topic) == publishedMsgs_.end()) {
       std::vector<std::string> msgs;
       publishedMsgs_[topic] = msgs;
@@ -67,6 +73,8 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
  public:
   std::map<rd_kafka_topic_t*, std::vector<std::string>> publishedMsgs_;
 
+  std::vector<std::string> publishedKeys_;
+
   std::atomic<int> timesFlushed_;
 
   std::atomic<int> timesPolled_;
@@ -355,6 +363,62 @@ TEST_F(KafkaProducerPluginTest, logString_multi_topic_happy_path) {
   EXPECT_TRUE(mkpp.timesPolled_.load() == 8);
 }
 
+TEST_F(KafkaProducerPluginTest, logStringBatch_aggregate_events) {
+  MockKafkaProducerPlugin mkpp;
+
+  std::map<std::string, rd_kafka_topic_t*> qToT;
+  rd_kafka_topic_t* topicBase = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  qToT[kKafkaBaseTopic] = topicBase;
+  rd_kafka_topic_t* topic1 = reinterpret_cast<rd_kafka_topic_t*>(0x692871);
+  qToT["topic1"] = topic1;
+  mkpp.setQueryToTopics(qToT);
+
+  std::string batch =
+      "{\"name\": \"topic1\", \"action\": \"added\"}\n"
+      "{\"name\": \"topic1\", \"action\": \"removed\"}\n";
+
+  // Without aggregation every row is a message.
+  EXPECT_TRUE(mkpp.logStringBatch(batch).ok());
+  std::vector<std::string> expected = {
+      "{\"name\": \"topic1\", \"action\": \"added\"}",
+      "{\"name\": \"topic1\", \"action\": \"removed\"}",
+  };
+  EXPECT_EQ(expected, mkpp.publishedMsgs_[topic1]);
+
+  auto aggregate = FLAGS_logger_kafka_aggregate_events;
+  FLAGS_logger_kafka_aggregate_events = true;
+  mkpp.publishedMsgs_.clear();
+  EXPECT_TRUE(mkpp.logStringBatch(batch).ok());
+  EXPECT_TRUE(mkpp.logStringBatch("").ok());
+  FLAGS_logger_kafka_aggregate_events = aggregate;
+
+  expected = {
+      "{\"name\": \"topic1\", \"action\": \"added\"}\n"
+      "{\"name\": \"topic1\", \"action\": \"removed\"}",
+  };
+  EXPECT_EQ(expected, mkpp.publishedMsgs_[topic1]);
+  EXPECT_TRUE(mkpp.publishedMsgs_[topicBase].empty());
+  EXPECT_EQ(mkpp.timesPolled_.load(), 3);
+}
+
+TEST_F(KafkaProducerPluginTest, logString_partition_key) {
+  MockKafkaProducerPlugin mkpp;
+
+  std::map<std::string, rd_kafka_topic_t*> qToT;
+  qToT[kKafkaBaseTopic] = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  mkpp.setQueryToTopics(qToT);
+
+  auto partition_key = FLAGS_logger_kafka_partition_key;
+  FLAGS_logger_kafka_partition_key = "name";
+  EXPECT_TRUE(mkpp.logString("{\"name\": \"test1\"}").ok());
+  FLAGS_logger_kafka_partition_key = "none";
+  EXPECT_TRUE(mkpp.logString("{\"name\": \"test1\"}").ok());
+  FLAGS_logger_kafka_partition_key = partition_key;
+
+  std::vector<std::string> expected = {"test1", ""};
+  EXPECT_EQ(expected, mkpp.publishedKeys_);
+}
+
 TEST_F(KafkaProducerPluginTest, flush_on_stop) {
   MockKafkaProducerPlugin mkpp;
 
@@ -19,6 +19,7 @@
 
 namespace osquery {
 DECLARE_bool(disable_database);
+DECLARE_string(logger_tls_endpoint);
 
 class TLSLoggerTests : public testing::Test {
  protected:
@@ -32,6 +33,32 @@ class TLSLoggerTests : public testing::Test {
   void runCheck(const std::shared_ptr<TLSLogForwarder>& runner) {
     runner->check();
   }
+
+  Status send(const std::shared_ptr<TLSLogForwarder>& runner,
+              std::vector<std::string> lines) {
+    return runner->send(lines, "result");
+  }
+
+  /// Address the content of the lines, and return them serialized.
+  std::vector<std::string> addressContent(
+      const std::shared_ptr<TLSLogForwarder>& runner,
+      const std::vector<std::string>& lines) {
+    std::vector<JSON> docs;
+    for (const auto& line : lines) {
+      JSON doc;
+      EXPECT_TRUE(doc.fromString(line).ok());
+      docs.push_back(std::move(doc));
+    }
+    EXPECT_TRUE(runner->addressContent(docs).ok());
+
+    std::vector<std::string> addressed;
+    for (const auto& doc : docs) {
+      std::string line;
+      EXPECT_TRUE(doc.toString(line).ok());
+      addressed.push_back(line);
+    }
+    return addressed;
+  }
 };
 
 TEST_F(TLSLoggerTests, test_database) {
@@ -83,4 +110,38 @@ TEST_F(TLSLoggerTests, test_send) {
   TLSServerRunner::unsetClientConfig();
   TLSServerRunner::stop();
 }
+
+TEST_F(TLSLoggerTests, test_content_hashes) {
+  ASSERT_TRUE(TLSServerRunner::start());
+  TLSServerRunner::setClientConfig();
+  auto endpoint = FLAGS_logger_tls_endpoint;
+  FLAGS_logger_tls_endpoint = "/log";
+
+  auto forwarder = std::make_shared<TLSLogForwarder>();
+  std::string snapshot =
+      "{\"name\":\"pack_tags\",\"snapshot\":[{\"key\":\"env\"}]}";
+  std::string other = "{\"name\":\"other\",\"diffResults\":{}}";
+  std::string status = "{\"message\":\"not a result\"}";
+
+  // The first line with unseen content keeps its body.
+  auto lines = addressContent(forwarder, {snapshot, snapshot, status});
+  ASSERT_EQ(3U, lines.size());
+  EXPECT_NE(std::string::npos, lines[0].find("\"snapshot\""));
+  EXPECT_NE(std::string::npos, lines[0].find("\"content_hash\""));
+  EXPECT_EQ(std::string::npos, lines[1].find("\"snapshot\""));
+  EXPECT_NE(std::string::npos, lines[1].find("\"content_hash\""));
+  EXPECT_EQ(status, lines[2]);
+
+  // Content the endpoint received is only referenced by its hash.
+  ASSERT_TRUE(send(forwarder, {lines[0]}).ok());
+  lines = addressContent(forwarder, {snapshot, other});
+  ASSERT_EQ(2U, lines.size());
+  EXPECT_EQ(std::string::npos, lines[0].find("\"snapshot\""));
+  EXPECT_NE(std::string::npos, lines[0].find("\"content_hash\""));
+  EXPECT_NE(std::string::npos, lines[1].find("\"diffResults\""));
+
+  FLAGS_logger_tls_endpoint = endpoint;
+  TLSServerRunner::unsetClientConfig();
+  TLSServerRunner::stop();
+}
 } // namespace osquery
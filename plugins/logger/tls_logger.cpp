@@ -15,11 +15,14 @@
 
 #include "tls_logger.h"
 
+#include <set>
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <osquery/remote/enroll/enroll.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/flagalias.h>
+#include <osquery/hashing/hashing.h>
 #include <osquery/registry/registry.h>
 
 #include <osquery/remote/serializers/json.h>
@@ -51,14 +54,58 @@ FLAG_ALIAS(google::uint64, logger_tls_max, logger_tls_max_linesize);
 
 FLAG(bool, logger_tls_compress, false, "GZip compress TLS/HTTPS request body");
 
+FLAG(uint64,
+     logger_tls_max_inflight,
+     1,
+     "Max number of log batches sent concurrently over TLS/HTTPS");
+
+FLAG(bool,
+     logger_tls_content_hashes,
+     false,
+     "Send query result bodies only if the TLS/HTTPS endpoint has not seen "
+     "their content hash");
+
 REGISTER(TLSLoggerPlugin, "logger", "tls");
 
+namespace {
+
+/// Members of a result line holding its query results.
+const std::vector<std::string> kResultContentMembers = {"snapshot",
+                                                        "diffResults"};
+
+/// Hash the query results of a line, empty if it has none.
+std::string getContentHash(const rapidjson::Value& line,
+                           std::string& member) {
+  if (!line.IsObject()) {
+    return "";
+  }
+
+  for (const auto& name : kResultContentMembers) {
+    auto it = line.FindMember(name);
+    if (it == line.MemberEnd()) {
+      continue;
+    }
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    it->value.Accept(writer);
+    member = name;
+    return hashFromBuffer(
+        HASH_TYPE_SHA256, buffer.GetString(), buffer.GetSize());
+  }
+  return "";
+}
+
+} // namespace
+
 TLSLogForwarder::TLSLogForwarder()
     : BufferedLogForwarder("TLSLogForwarder",
                            "tls",
                            std::chrono::seconds(FLAGS_logger_tls_period),
                            FLAGS_logger_tls_max_lines) {
   uri_ = TLSRequestHelper::makeURI(FLAGS_logger_tls_endpoint);
+  max_inflight_ = FLAGS_logger_tls_max_inflight;
+  adaptive_batches_ = true;
 }
 
 Status TLSLoggerPlugin::logString(const std::string& s) {
@@ -103,8 +150,8 @@ Status TLSLogForwarder::send(std::vector<std::string>& log_data,
   {
     // Read each logged line into JSON and populate a list of lines.
     // The result list will use the 'data' key.
-    auto children = params.newArray();
-    iterate(log_data, ([&params, &children](std::string& item) {
+    std::vector<JSON> lines;
+    iterate(log_data, ([&lines](std::string& item) {
               // Enforce a max log line size for TLS logging.
               if (item.size() > FLAGS_logger_tls_max_linesize) {
                 LOG(WARNING)
@@ -119,8 +166,20 @@ Status TLSLogForwarder::send(std::vector<std::string>& log_data,
                 return;
               }
               std::string().swap(item);
-              params.push(child.doc(), children.doc());
+              lines.push_back(std::move(child));
             }));
+
+    if (FLAGS_logger_tls_content_hashes && log_type == "result") {
+      auto status = addressContent(lines);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+
+    auto children = params.newArray();
+    for (auto& child : lines) {
+      params.push(child.doc(), children.doc());
+    }
     params.add("data", children.doc());
   }
 
@@ -132,4 +191,117 @@ Status TLSLogForwarder::send(std::vector<std::string>& log_data,
   }
   return TLSRequestHelper::go<JSONSerializer>(uri_, params, response);
 }
+
+Status TLSLogForwarder::addressContent(std::vector<JSON>& lines) {
+  std::vector<std::pair<std::string, std::string>> hashes(lines.size());
+  JSON params;
+  params.add("node_key", getNodeKey("tls"));
+  params.add("log_type", "result_hashes");
+  auto content_hashes = params.newArray();
+  std::set<std::string> unique;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    auto& hash = hashes[i].first;
+    hash = getContentHash(lines[i].doc(), hashes[i].second);
+    if (!hash.empty() && unique.insert(hash).second) {
+      params.pushCopy(hash, content_hashes.doc());
+    }
+  }
+
+  if (unique.empty()) {
+    return Status::success();
+  }
+  params.add("content_hashes", content_hashes.doc());
+
+  JSON response;
+  auto status = TLSRequestHelper::go<JSONSerializer>(uri_, params, response);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto missing_content = response.doc().FindMember("missing_content");
+  if (missing_content == response.doc().MemberEnd() ||
+      !missing_content->value.IsArray()) {
+    // An endpoint without content hashes receives every body.
+    VLOG(1) << "TLS logger endpoint did not list missing content hashes";
+    return Status::success();
+  }
+
+  std::set<std::string> missing;
+  for (const auto& hash : missing_content->value.GetArray()) {
+    if (hash.IsString()) {
+      missing.insert(hash.GetString());
+    }
+  }
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const auto& hash = hashes[i].first;
+    if (hash.empty()) {
+      continue;
+    }
+
+    // The first line with missing content sends it for every line.
+    if (missing.erase(hash) == 0) {
+      lines[i].doc().RemoveMember(hashes[i].second);
+    }
+    lines[i].addCopy("content_hash", hash);
+  }
+  return Status::success();
+}
+
+bool TLSLogForwarder::getCompressedFraming(const std::string& log_type,
+                                           BufferedLogFraming& framing) {
+  // Result bodies are replaced by content hashes line by line in send().
+  if (FLAGS_logger_tls_content_hashes && log_type == "result") {
+    return false;
+  }
+
+  // The request body matches send(), with each line copied into 'data'.
+  JSON params;
+  params.add("node_key", getNodeKey("tls"));
+  params.add("log_type", log_type);
+
+  std::string envelope;
+  if (!params.toString(envelope).ok() || envelope.empty()) {
+    return false;
+  }
+
+  envelope.pop_back();
+  framing.prefix = envelope + ",\"data\":[";
+  framing.delimiter = ",";
+  framing.suffix = "]}";
+  return true;
+}
+
+bool TLSLogForwarder::prepareCompressedLine(std::string& line,
+                                            const std::string& log_type) {
+  // Enforce a max log line size for TLS logging.
+  if (line.size() > FLAGS_logger_tls_max_linesize) {
+    LOG(WARNING) << "Linesize exceeds TLS logger maximum: " << line.size();
+    return false;
+  }
+
+  // The line is copied into the body as-is, only validate it is JSON.
+  rapidjson::Reader reader;
+  rapidjson::StringStream stream(line.c_str());
+  rapidjson::BaseReaderHandler<> handler;
+  return !reader.Parse<rapidjson::kParseIterativeFlag>(stream, handler)
+              .IsError();
+}
+
+Status TLSLogForwarder::sendCompressed(std::vector<std::string>& batches,
+                                       const std::string& log_type) {
+  // The response body is ignored (status is set appropriately by
+  // TLSRequestHelper::goEncoded())
+  JSON response;
+  auto encoding = getBufferedLogContentEncoding(codec_);
+  for (auto& batch : batches) {
+    auto status = TLSRequestHelper::goEncoded<JSONSerializer>(
+        uri_, batch, encoding, response);
+    if (!status.ok()) {
+      return status;
+    }
+    std::string().swap(batch);
+  }
+  return Status::success();
+}
 } // namespace osquery
@@ -13,6 +13,7 @@
 
 #include <osquery/core/plugins/logger.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/json/json.h>
 
 namespace osquery {
 
@@ -31,6 +32,25 @@ class TLSLogForwarder : public BufferedLogForwarder {
   Status send(std::vector<std::string>& log_data,
               const std::string& log_type) override;
 
+  bool getCompressedFraming(const std::string& log_type,
+                            BufferedLogFraming& framing) override;
+
+  bool prepareCompressedLine(std::string& line,
+                             const std::string& log_type) override;
+
+  Status sendCompressed(std::vector<std::string>& batches,
+                        const std::string& log_type) override;
+
+  /**
+   * @brief Replace result bodies the endpoint has already seen by hashes.
+   *
+   * The content hashes of the lines are sent first, the endpoint answers
+   * with those it has not seen. Only the first line with each of those keeps
+   * its body. Lines are left whole if the endpoint does not answer with a
+   * list of missing hashes.
+   */
+  Status addressContent(std::vector<JSON>& lines);
+
   /// Endpoint URI
   std::string uri_;
 
@@ -22,7 +22,8 @@ FLAG(string,
      numeric_monitoring_filesystem_path,
      OSQUERY_LOG_HOME "numeric_monitoring.log",
      "File to dump numeric monitoring records one per line. "
-     "The format of the line is <PATH><TAB><VALUE><TAB><TIMESTAMP>.");
+     "The format of the line is <PATH><TAB><VALUE><TAB><TIMESTAMP>, "
+     "histogram records append <TAB><HISTOGRAM>.");
 
 REGISTER(NumericMonitoringFilesystemPlugin,
          monitoring::registryName(),
@@ -57,6 +58,10 @@ Status NumericMonitoringFilesystemPlugin::formTheLine(
     }
     line.append(it->second).push_back(separator_);
   }
+  auto histogram = request.find(monitoring::recordKeys().histogram);
+  if (histogram != request.end()) {
+    line.append(histogram->second).push_back(separator_);
+  }
   // remove last separator
   line.pop_back();
   return Status();
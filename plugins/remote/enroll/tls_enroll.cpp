@@ -23,6 +23,7 @@
 #include <osquery/core/system.h>
 
 #include <osquery/process/process.h>
+#include <osquery/remote/backoff.h>
 #include <osquery/remote/requests.h>
 #include <osquery/remote/serializers/json.h>
 #include <osquery/utils/info/platform_type.h>
@@ -76,7 +77,7 @@ std::string TLSEnrollPlugin::enroll() {
 
     LOG(WARNING) << "Failed enrollment request to " << uri << " ("
                  << status.what() << ") retrying...";
-    sleepFor(i * i * 1000);
+    sleepFor(RemoteBackoff::get().retryDelay(i));
   }
 
   return node_key;
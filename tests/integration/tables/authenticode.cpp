@@ -44,5 +44,16 @@ TEST_F(authenticode, test_sanity) {
   // validate_rows(data, row_map);
 }
 
+TEST_F(authenticode, test_cached_result) {
+  // The second query is answered from the verification cache.
+  auto query =
+      "select * from authenticode where path = "
+      "'C:\\Windows\\System32\\notepad.exe'";
+  auto const first = execute_query(query);
+  auto const second = execute_query(query);
+  ASSERT_EQ(first.size(), 1ul);
+  EXPECT_EQ(first, second);
+}
+
 } // namespace table_tests
 } // namespace osquery
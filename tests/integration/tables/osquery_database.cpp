@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_database
+// Spec file: specs/utility/osquery_database.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryDatabase : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryDatabase, test_sanity) {
+  auto const data = execute_query("select * from osquery_database");
+  ASSERT_EQ(data.size(), 1ul);
+
+  ValidationMap row_map = {
+      {"plugin", NonEmptyString},
+      {"memory_budget", NonNegativeInt},
+      {"block_cache", NonNegativeInt},
+      {"block_cache_pinned", NonNegativeInt},
+      {"memtables", NonNegativeInt},
+      {"table_readers", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_database_domains
+// Spec file: specs/utility/osquery_database_domains.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryDatabaseDomains : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryDatabaseDomains, test_sanity) {
+  auto const data = execute_query("select * from osquery_database_domains");
+
+  ValidationMap row_map = {
+      {"domain", NonEmptyString},
+      {"keys", NonNegativeInt},
+      {"memtables", NonNegativeInt},
+      {"sst_files", NonNegativeInt},
+      {"sst_bytes", NonNegativeInt},
+      {"live_bytes", NonNegativeInt},
+      {"pending_compaction_bytes", NonNegativeInt},
+      {"write_slowdowns", NonNegativeInt},
+      {"write_stops", NonNegativeInt},
+      {"write_stopped", Bool},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -39,6 +39,9 @@ TEST_F(osqueryEvents, test_sanity) {
   //      {"subscriptions", IntType}
   //      {"events", IntType}
   //      {"refreshes", IntType}
+  //      {"dropped", IntType}
+  //      {"limited", IntType}
+  //      {"sampled_out", IntType}
   //      {"active", IntType}
   //}
   // 4. Perform validation
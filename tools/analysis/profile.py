@@ -11,7 +11,6 @@ import json
 import os
 import subprocess
 import sys
-import time
 
 try:
     import argparse
@@ -34,6 +33,9 @@ RANGES = {
     "duration": (0.8, 1, 3),
 }
 
+# Reported by the shell's profile mode, shown but not ranked.
+UNRANKED = ("rows", "rows_per_second")
+
 
 def check_leaks_linux(shell, query, count=1, supp_file=None):
     """Run valgrind using the shell and a query, parse leak reports."""
@@ -126,8 +128,7 @@ def profile_leaks(shell, queries, count=1, rounds=1, supp_file=None):
 
 def run_query(shell, query, timeout=0, count=1):
     """Execute the osqueryi shell in profile mode with a setup/teardown delay."""
-    start_time = time.time()
-    return utils.profile_cmd([
+    proc = subprocess.Popen([
         shell,
         "--profile",
         str(count),
@@ -135,12 +136,27 @@ def run_query(shell, query, timeout=0, count=1):
         "1",
         query,
         "--disable_extensions",
-    ], timeout=timeout, count=count)
+    ], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    result = utils.profile_cmd(None, proc=proc, timeout=timeout, count=count)
+
+    # The shell reports the rows and time of each run, without the delays.
+    try:
+        report = json.loads(proc.stdout.read().decode().splitlines()[-1])
+        result["rows"] = report["rows"]
+        result["rows_per_second"] = 0
+        if report["time_ms"] > 0:
+            result["rows_per_second"] = int(
+                report["rows"] * 1000 / report["time_ms"])
+    except (IndexError, KeyError, ValueError):
+        pass
+    return result
 
 
 def summary_line(name, result):
     if not args.n:
         for key, v in result.items():
+            if key in UNRANKED:
+                continue
             print("%s" % (
                 RANGES["colors"][v[0]]("%s:%s" % (
                     key[0].upper(), v[0]))),
@@ -174,6 +190,9 @@ def summary(results, display=False):
             else:
                 summary_result[key] = (rank(result[key], RANGES[key]),
                                        result[key])
+        for key in UNRANKED:
+            if key in result:
+                summary_result[key] = (0, result[key])
         if display and not args.check:
             summary_line(name, summary_result)
         summary_results[name] = summary_result
@@ -265,6 +284,10 @@ if __name__ == "__main__":
         "--query", metavar="STRING", default=None,
         help="Profile a single query."
     )
+    group.add_argument(
+        "--benchmark", action="store_true", default=False,
+        help="Profile a full scan, a narrow scan and the examples of tables."
+    )
 
     group = parser.add_argument_group("Run Options:")
     group.add_argument(
@@ -344,6 +367,9 @@ if __name__ == "__main__":
         queries["manual"] = args.query
     elif args.force:
         queries["force"] = True
+    elif args.benchmark:
+        queries = utils.benchmark_queries_from_tables(
+            args.tables, args.restrict)
     else:
         queries = utils.queries_from_tables(args.tables, args.restrict)
 
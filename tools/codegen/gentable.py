@@ -67,6 +67,7 @@ COLUMN_OPTIONS = {
     "required": "REQUIRED",
     "optimized": "OPTIMIZED",
     "hidden": "HIDDEN",
+    "sortable": "SORTABLE",
 }
 
 # Column options that render tables uncacheable.
@@ -82,6 +83,8 @@ TABLE_ATTRIBUTES = {
     "cacheable": "CACHEABLE",
     "utility": "UTILITY",
     "kernel_required": "KERNEL_REQUIRED", # Deprecated
+    "batched_lookups": "BATCHED_LOOKUPS",
+    "boot_static": "BOOT_STATIC",
 }
 
 
@@ -205,6 +208,7 @@ class TableState(Singleton):
         self.has_column_aliases = False
         self.strongly_typed_rows = False
         self.generator = False
+        self.iterator = False
 
     def columns(self):
         return [i for i in self.schema if isinstance(i, Column)]
@@ -221,6 +225,9 @@ class TableState(Singleton):
         for column in self.columns():
             column_options = []
             for option in column.options:
+                # Options may be platform-specific, e.g. sortable=LINUX().
+                if not column.options[option]:
+                    continue
                 # Only allow explicitly-defined options.
                 if option in COLUMN_OPTIONS:
                     column_options.append("ColumnOptions::" + COLUMN_OPTIONS[option])
@@ -236,13 +243,22 @@ class TableState(Singleton):
             self.has_options = True
         if "event_subscriber" in self.attributes:
             self.generator = True
-        if "strongly_typed_rows" in self.attributes:
+        if self.attributes.get("strongly_typed_rows"):
             self.strongly_typed_rows = True
         if "cacheable" in self.attributes:
-            if self.generator:
+            if self.generator or self.iterator:
                 print(lightred(
                     "Table cannot use a generator and be marked cacheable: %s" % (path)))
                 exit(1)
+        if "boot_static" in self.attributes:
+            if self.generator or self.iterator:
+                print(lightred(
+                    "Table cannot use a generator and be marked boot_static: %s" % (path)))
+                exit(1)
+        if self.generator and self.iterator:
+            print(lightred(
+                "Table cannot use both a generator and an iterator: %s" % (path)))
+            exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
             exit(1)
@@ -282,8 +298,9 @@ class TableState(Singleton):
             has_options=self.has_options,
             has_column_aliases=self.has_column_aliases,
             generator=self.generator,
+            iterator=self.iterator,
             strongly_typed_rows=self.strongly_typed_rows,
-            attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes if attr in TABLE_ATTRIBUTES],
+            attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes if attr in TABLE_ATTRIBUTES and self.attributes[attr]],
         )
 
         with open(path, "w+") as file_h:
@@ -389,13 +406,15 @@ def fuzz_paths(paths):
     table.fuzz_paths = paths
 
 
-def implementation(impl_string, generator=False):
+def implementation(impl_string, generator=False, iterator=False):
     """
     define the path to the implementation file and the function which
     implements the virtual table. You should use the following format:
       # the path is "osquery/table/implementations/foo.cpp"
       # the function is "QueryData genFoo();"
       implementation("foo@genFoo")
+    With iterator=True the function is
+      "TableRowIteratorRef genFoo(QueryContext context);"
     """
     logging.debug("- implementation")
     filename, function = impl_string.split("@")
@@ -410,6 +429,7 @@ def implementation(impl_string, generator=False):
     table.function = function
     table.class_name = class_name
     table.generator = generator
+    table.iterator = iterator
 
     '''Check if the table has a subscriber attribute, if so, enforce time.'''
     if "event_subscriber" in table.attributes:
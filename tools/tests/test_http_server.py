@@ -9,6 +9,8 @@
 
 import argparse
 import base64
+import gzip
+import hashlib
 import json
 import os
 import random
@@ -130,6 +132,7 @@ FAILED_ENROLL_RESPONSE = {"node_invalid": True}
 ENROLL_RESPONSE = {"node_key": "this_is_a_node_secret"}
 
 RECEIVED_REQUESTS = []
+SEEN_CONTENT = set()
 FILE_CARVE_DIR = '/tmp/'
 FILE_CARVE_MAP = {}
 
@@ -173,12 +176,17 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
     def do_POST(self):
         reset_timeout()
         debug("RealSimpleHandler::post %s" % self.path)
-        self._set_headers()
         content_len = int(self.headers.get('content-length', 0))
 
         body = self.rfile.read(content_len)
         request = json.loads(body)
 
+        # The tagged config endpoint chooses its own response status.
+        if self.path == '/config_tagged':
+            self.config_tagged(request)
+            return
+        self._set_headers()
+
         # This contains a base64 encoded block of a file printing to the screen
         # slows down carving and makes scroll back a pain
         if (self.path != "/carve_block"):
@@ -250,6 +258,34 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
             return
         self._reply(EXAMPLE_CONFIG)
 
+    def config_tagged(self, request):
+        '''A config endpoint with entity tags and compression'''
+
+        # The config is tagged with its hash, a client presenting the current
+        # tag receives a 304 without a body. Clients accepting gzip receive a
+        # compressed body.
+        self._push_request('config', request)
+        response_bytes = json.dumps(EXAMPLE_CONFIG).encode()
+        etag = '"%s"' % hashlib.sha1(response_bytes).hexdigest()
+
+        self.protocol_version = self.request_version
+        if self.headers.get('If-None-Match') == etag:
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('ETag', etag)
+        if 'gzip' in self.headers.get('Accept-Encoding', ''):
+            response_bytes = gzip.compress(response_bytes)
+            self.send_header('Content-Encoding', 'gzip')
+        if self.protocol_version == "HTTP/1.1":
+            self.send_header('Content-Length', len(response_bytes))
+        self.end_headers()
+        self.wfile.write(response_bytes)
+
     def distributed_read(self, request):
         '''A basic distributed read endpoint'''
         if "node_key" not in request or request["node_key"] not in NODE_KEYS:
@@ -262,6 +298,16 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
         self._reply({})
 
     def log(self, request):
+        if request.get('log_type') == 'result_hashes':
+            # Ask only for the result bodies not received before.
+            missing = [h for h in request.get('content_hashes', [])
+                       if h not in SEEN_CONTENT]
+            self._reply({'missing_content': missing})
+            return
+        for line in request.get('data', []):
+            if isinstance(line, dict) and 'content_hash' in line:
+                if 'snapshot' in line or 'diffResults' in line:
+                    SEEN_CONTENT.add(line['content_hash'])
         self._reply({})
 
     def test_read_requests(self):
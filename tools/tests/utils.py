@@ -127,6 +127,76 @@ def queries_from_tables(path, restrict):
     return queries
 
 
+class _SpecNames(dict):
+    """Names of a table spec, the ones not defined are ignored."""
+
+    def __missing__(self, key):
+        return lambda *args, **kwargs: None
+
+
+def read_table_spec(spec_path):
+    """Evaluate a table spec, keeping its name, columns and examples."""
+    spec = {"name": None, "columns": [], "examples": []}
+
+    def table_name(name, aliases=[]):
+        spec["name"] = name
+
+    def Column(name, col_type, description="", **kwargs):
+        spec["columns"].append((name, kwargs))
+
+    def examples(queries):
+        spec["examples"] = queries
+
+    names = _SpecNames(
+        table_name=table_name, Column=Column, examples=examples)
+    with open(spec_path, "r") as fh:
+        exec(fh.read(), {}, names)
+    return spec
+
+
+def benchmark_queries_from_tables(path, restrict):
+    """Construct representative queries for each table of this platform.
+
+    A full scan and a narrow scan of the first column, for tables without
+    required columns, and the examples of the spec, which usually apply
+    the constraints of the required and indexed columns.
+    """
+    restrict_tables = [t.strip() for t in restrict.split(",")]
+    platform_dirs = ["specs", "utility", platform()]
+    if platform() != "windows":
+        platform_dirs.append("posix")
+    if platform() in ["linux", "windows"]:
+        platform_dirs.append("linwin")
+    if platform() in ["darwin", "windows"]:
+        platform_dirs.append("macwin")
+
+    queries = {}
+    for base, _, files in os.walk(path):
+        spec_platform = os.path.basename(base)
+        if spec_platform not in platform_dirs:
+            continue
+        for spec_file in files:
+            if not spec_file.endswith(".table"):
+                continue
+            spec = read_table_spec(os.path.join(base, spec_file))
+            table = spec["name"]
+            if table is None:
+                continue
+            if len(restrict) > 0 and table not in restrict_tables:
+                continue
+
+            prefix = "%s.%s" % (spec_platform, table)
+            required = [c for c, options in spec["columns"]
+                        if options.get("required", False)]
+            if len(required) == 0 and len(spec["columns"]) > 0:
+                queries[prefix + ".full"] = "SELECT * FROM %s;" % table
+                queries[prefix + ".narrow"] = "SELECT %s FROM %s;" % (
+                    spec["columns"][0][0], table)
+            for i, example in enumerate(spec["examples"]):
+                queries["%s.example%d" % (prefix, i + 1)] = example
+    return queries
+
+
 def get_stats(p, interval=1):
     """Run psutil and downselect the information."""
     utilization = p.cpu_percent(interval=interval)